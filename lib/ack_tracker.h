@@ -34,6 +34,7 @@ struct _AckTracker
   LogSource *source;
   Bookmark* (*request_bookmark)(AckTracker *self);
   void (*track_msg)(AckTracker *self, LogMessage *msg);
+  /* only used by late trackers, early acks go directly to the source window */
   void (*manage_msg_ack)(AckTracker *self, LogMessage *msg, AckType ack_type);
 };
 
@@ -33,8 +33,19 @@
 
 typedef struct _AFInterSource AFInterSource;
 
+typedef struct _AFInterQueueNode AFInterQueueNode;
+struct _AFInterQueueNode
+{
+  AFInterQueueNode *next;
+  LogMessage *msg;
+};
+
+/* pushed to by any thread without locking, newest message first */
+static AFInterQueueNode *internal_msg_stack;
+/* messages taken from internal_msg_stack in their original order, only
+ * touched by the main thread */
+static AFInterQueueNode *internal_msg_batch;
 static GStaticMutex internal_msg_lock = G_STATIC_MUTEX_INIT;
-static GQueue *internal_msg_queue;
 static AFInterSource *current_internal_source;
 static StatsCounterItem *internal_queue_length;
 
@@ -57,24 +68,27 @@ static GStaticMutex internal_mark_target_lock = G_STATIC_MUTEX_INIT;
  * some care must be taken to make the internal() source multithreaded.
  * This is how it works:
  *
- * Whenever a thread decides to send a message using the msg_() API, it puts
- * an entry into the internal_msg_queue under the protection of
- * "internal_msg_lock".
+ * Whenever a thread decides to send a message using the msg_() API, it
+ * pushes an entry to internal_msg_stack, with a compare-and-swap, without
+ * taking any locks.
  *
  * The receiving side of this queue is in the main thread, where the
  * internal() source is operating.  This object will publish a pointer to
  * itself into current_internal_source.  This pointer will be set under the
  * protection of the internal_msg_lock.  The internal source will define an
- * ivykis event, a post is submitted to this event whenever a new message is
- * added to the queue.
+ * ivykis event, a post is submitted to this event whenever a message is
+ * added to an empty stack, subsequent messages ride along with it, so the
+ * lock is only taken once per batch.
  *
- * Once the event arrives to the main loop, it wakes up and feeds all
- * internal messages into the log path.
+ * Once the event arrives to the main loop, it wakes up, takes the whole
+ * stack in one go, and feeds the batch of internal messages into the log
+ * path.  Messages of the batch that do not fit into the window are kept in
+ * internal_msg_batch.
  *
  * If the window is depleted (e.g. flow control is enabled and the
  * destination is unable to process any more messages),
  * current_internal_source will be set to NULL, which means that messages
- * will be added to the queue, but the wakeup will not be done.
+ * will be added to the stack, but the wakeup will not be done.
  *
  * When the window becomes free, log_source_wakeup() is called, which
  * restores the current_internal_source pointer (e.g.  further messages will
@@ -95,32 +109,72 @@ struct _AFInterSource
   struct iv_event post;
   struct iv_event schedule_wakeup;
   struct iv_timer mark_timer;
+  struct iv_timer suppression_timer;
   struct iv_task restart_task;
   gboolean watches_running:1;
 };
 
 static void afinter_source_update_watches(AFInterSource *self);
 
+static gboolean
+afinter_has_pending_messages(void)
+{
+  return internal_msg_batch || g_atomic_pointer_get((gpointer *) &internal_msg_stack);
+}
+
+/* moves the contents of internal_msg_stack to internal_msg_batch */
+static gboolean
+afinter_take_batch(void)
+{
+  AFInterQueueNode *head, *next;
+
+  do
+    head = g_atomic_pointer_get((gpointer *) &internal_msg_stack);
+  while (head && !g_atomic_pointer_compare_and_exchange((gpointer *) &internal_msg_stack, head, NULL));
+
+  for (; head; head = next)
+    {
+      next = head->next;
+      head->next = internal_msg_batch;
+      internal_msg_batch = head;
+    }
+  return internal_msg_batch != NULL;
+}
+
 static void
 afinter_source_post(gpointer s)
 {
   AFInterSource *self = (AFInterSource *) s;
-  LogMessage *msg;
+  AFInterQueueNode *node;
 
   while (log_source_free_to_send(&self->super))
     {
-      g_static_mutex_lock(&internal_msg_lock);
-      msg = g_queue_pop_head(internal_msg_queue);
-      g_static_mutex_unlock(&internal_msg_lock);
-      if (!msg)
+      if (!internal_msg_batch && !afinter_take_batch())
         break;
 
+      node = internal_msg_batch;
+      internal_msg_batch = node->next;
+
       stats_counter_dec(internal_queue_length);
-      log_source_post(&self->super, msg);
+      log_source_post(&self->super, node->msg);
+      g_free(node);
     }
   afinter_source_update_watches(self);
 }
 
+static void
+afinter_source_flush_suppressed(gpointer s)
+{
+  AFInterSource *self = (AFInterSource *) s;
+
+  msg_flush_suppressed_messages();
+
+  iv_validate_now();
+  self->suppression_timer.expires = iv_now;
+  self->suppression_timer.expires.tv_sec++;
+  iv_timer_register(&self->suppression_timer);
+}
+
 static void
 afinter_source_mark(gpointer s)
 {
@@ -178,6 +232,9 @@ afinter_source_init_watches(AFInterSource *self)
   IV_TIMER_INIT(&self->mark_timer);
   self->mark_timer.cookie = self;
   self->mark_timer.handler = afinter_source_mark;
+  IV_TIMER_INIT(&self->suppression_timer);
+  self->suppression_timer.cookie = self;
+  self->suppression_timer.handler = afinter_source_flush_suppressed;
   IV_EVENT_INIT(&self->schedule_wakeup);
   self->schedule_wakeup.cookie = self;
   self->schedule_wakeup.handler = (void (*)(void *)) afinter_source_update_watches;
@@ -217,7 +274,7 @@ afinter_source_update_watches(AFInterSource *self)
     {
       /* ok, we go to sleep now. let's disable the post event by setting
        * current_internal_source to NULL.  Messages get accumulated into
-       * internal_msg_queue.  */
+       * internal_msg_stack.  */
       g_static_mutex_lock(&internal_msg_lock);
       current_internal_source = NULL;
       g_static_mutex_unlock(&internal_msg_lock);
@@ -252,16 +309,15 @@ afinter_source_update_watches(AFInterSource *self)
        * Our current_internal_source pointer is set to NULL here (in case
        * we're just waking up).  In case the sender submits a message, it'll
        * not trigger the self->post (since the pointer is NULL).  This is
-       * taken care of by the queue-length check in the locked region below.
-       * If the queue has elements, we need to wake up, because we may have
-       * lost a wakeup call.  If it happens after the locked region, that
-       * doesn't matter, in that case we already pointed
-       * current_internal_source to ourselves, thus the post event will also
-       * be triggered.
+       * taken care of by the pending messages check in the locked region
+       * below.  If there are messages, we need to wake up, because we may
+       * have lost a wakeup call.  If the message is pushed after the check,
+       * the sender will find current_internal_source pointing to ourselves
+       * once it gets the lock, thus the post event will also be triggered.
        */
 
       g_static_mutex_lock(&internal_msg_lock);
-      if (internal_msg_queue && g_queue_get_length(internal_msg_queue) > 0)
+      if (afinter_has_pending_messages())
         iv_task_register(&self->restart_task);
       current_internal_source = self;
       g_static_mutex_unlock(&internal_msg_lock);
@@ -287,8 +343,12 @@ afinter_source_init(LogPipe *s)
   iv_event_register(&self->schedule_wakeup);
 
   afinter_source_start_watches(self);
+  afinter_source_flush_suppressed(self);
 
+  /* messages pushed while there was no source did not post a wakeup */
   g_static_mutex_lock(&internal_msg_lock);
+  if (afinter_has_pending_messages())
+    iv_task_register(&self->restart_task);
   current_internal_source = self;
   g_static_mutex_unlock(&internal_msg_lock);
 
@@ -309,6 +369,8 @@ afinter_source_deinit(LogPipe *s)
 
   iv_event_unregister(&self->post);
   iv_event_unregister(&self->schedule_wakeup);
+  if (iv_timer_registered(&self->suppression_timer))
+    iv_timer_unregister(&self->suppression_timer);
 
   afinter_source_stop_watches(self);
   return log_source_deinit(s);
@@ -424,19 +486,23 @@ afinter_postpone_mark(gint mark_freq)
 void
 afinter_message_posted(LogMessage *msg)
 {
-  g_static_mutex_lock(&internal_msg_lock);
-  if (!internal_msg_queue)
-    {
-      internal_msg_queue = g_queue_new();
+  AFInterQueueNode *node = g_new(AFInterQueueNode, 1);
+  AFInterQueueNode *head;
 
-      stats_lock();
-      stats_register_counter(0, SCS_GLOBAL, "internal_queue_length", NULL, SC_TYPE_PROCESSED, &internal_queue_length);
-      stats_unlock();
+  node->msg = msg;
+  stats_counter_inc(internal_queue_length);
+  do
+    {
+      head = g_atomic_pointer_get((gpointer *) &internal_msg_stack);
+      node->next = head;
     }
+  while (!g_atomic_pointer_compare_and_exchange((gpointer *) &internal_msg_stack, head, node));
 
-  g_queue_push_tail(internal_msg_queue, msg);
-  stats_counter_inc(internal_queue_length);
+  /* the stack was not empty, the source has been woken up already */
+  if (head)
+    return;
 
+  g_static_mutex_lock(&internal_msg_lock);
   if (current_internal_source)
     iv_event_post(&current_internal_source->post);
   g_static_mutex_unlock(&internal_msg_lock);
@@ -445,6 +511,10 @@ afinter_message_posted(LogMessage *msg)
 static void
 afinter_register_posted_hook(gint hook_type, gpointer user_data)
 {
+  stats_lock();
+  stats_register_counter(0, SCS_GLOBAL, "internal_queue_length", NULL, SC_TYPE_PROCESSED, &internal_queue_length);
+  stats_unlock();
+
   msg_set_post_func(afinter_message_posted);
 }
 
@@ -26,10 +26,12 @@
 #include "messages.h"
 #include "children.h"
 #include "dnscache.h"
+#include "host-resolve.h"
 #include "alarms.h"
 #include "stats/stats-registry.h"
 #include "tags.h"
 #include "logmsg/logmsg.h"
+#include "logmsg/logmsg-slab.h"
 #include "timeutils.h"
 #include "logsource.h"
 #include "logwriter.h"
@@ -38,8 +40,10 @@
 #include "hostname.h"
 #include "scratch-buffers.h"
 #include "mainloop-call.h"
+#include "logmatcher.h"
 #include "service-management.h"
 #include "crypto.h"
+#include "cpu-topology.h"
 #include "value-pairs/value-pairs.h"
 
 #include <iv.h>
@@ -122,6 +126,7 @@ app_startup(void)
   iv_init();
   g_thread_init(NULL);
   crypto_init();
+  cpu_topology_global_init();
   hostname_global_init();
   dns_cache_global_init();
   dns_cache_thread_init();
@@ -170,6 +175,7 @@ app_shutdown(void)
   child_manager_deinit();
   g_list_foreach(application_hooks, (GFunc) g_free, NULL);
   g_list_free(application_hooks);
+  host_resolve_global_deinit();
   dns_cache_thread_deinit();
   dns_cache_global_deinit();
   hostname_global_deinit();
@@ -193,6 +199,7 @@ app_shutdown(void)
 void
 app_thread_start(void)
 {
+  log_msg_slab_thread_init();
   scratch_buffers_init();
   dns_cache_thread_init();
   main_loop_call_thread_init();
@@ -204,4 +211,6 @@ app_thread_stop(void)
   dns_cache_thread_deinit();
   scratch_buffers_free();
   main_loop_call_thread_deinit();
+  log_matcher_thread_deinit();
+  log_msg_slab_thread_deinit();
 }
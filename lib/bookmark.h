@@ -52,4 +52,13 @@ bookmark_init(Bookmark *self)
   self->destroy = NULL;
 }
 
+/* copies the state filled in by a LogProto, @self keeps its persist_state */
+static inline void
+bookmark_copy(Bookmark *self, const Bookmark *other)
+{
+  self->save = other->save;
+  self->destroy = other->destroy;
+  self->container = other->container;
+}
+
 #endif
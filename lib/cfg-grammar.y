@@ -219,6 +219,7 @@ extern struct _StatsOptions *last_stats_options;
 %token KW_FRAC_DIGITS                 10152
 
 %token KW_LOG_FIFO_SIZE               10160
+%token KW_LOG_FIFO_LOCKLESS           10161
 %token KW_LOG_FETCH_LIMIT             10162
 %token KW_LOG_IW_SIZE                 10163
 %token KW_LOG_PREFIX                  10164
@@ -227,6 +228,20 @@ extern struct _StatsOptions *last_stats_options;
 
 %token KW_THROTTLE                    10170
 %token KW_THREADED                    10171
+%token KW_LOG_MSG_ALLOC_CACHE         10172
+%token KW_LOG_FIFO_NUMA               10173
+%token KW_FLOW_CONTROL_BUDGET         10174
+%token KW_LOG_FIFO_LANES              10175
+%token KW_LOG_FIFO_WEIGHTED_LANES     10176
+%token KW_LOG_IW_SIZE_MIN             10177
+%token KW_LOG_IW_SIZE_MAX             10178
+%token KW_LOG_FIFO_BYTES              10179
+%token KW_QUEUE_MEMORY_BUDGET         10180
+%token KW_LOCKLESS_ACK_TRACKER        10181
+%token KW_BATCH_LINES                 10182
+%token KW_BATCH_BYTES                 10183
+%token KW_FLUSH_TIMEOUT_USEC          10184
+%token KW_FILTER_PROFILING            10185
 %token KW_PASS_UNIX_CREDENTIALS       10231
 
 /* log statement options */
@@ -239,6 +254,13 @@ extern struct _StatsOptions *last_stats_options;
 %token KW_SEND_TIME_ZONE              10203
 %token KW_LOCAL_TIME_ZONE             10204
 %token KW_FORMAT                      10205
+%token KW_PARSE_THREADS               10206
+
+/* early drop filters of readers */
+%token KW_EARLY_DROP_FACILITY         10215
+%token KW_EARLY_DROP_LEVEL            10216
+%token KW_EARLY_DROP_PREFIX           10217
+%token KW_EARLY_DROP_LITERAL          10218
 
 /* timers */
 %token KW_TIME_REOPEN                 10210
@@ -265,6 +287,7 @@ extern struct _StatsOptions *last_stats_options;
 %token KW_TEMPLATE                    10270
 %token KW_TEMPLATE_ESCAPE             10271
 %token KW_TEMPLATE_FUNCTION           10272
+%token KW_TEMPLATE_CACHE              10273
 
 %token KW_DEFAULT_FACILITY            10300
 %token KW_DEFAULT_LEVEL               10301
@@ -326,6 +349,17 @@ extern struct _StatsOptions *last_stats_options;
 %token KW_ON_ERROR                    10510
 
 %token KW_RETRIES                     10511
+%token KW_BATCH_TIMEOUT               10512
+%token KW_WORKERS                     10513
+%token KW_PARTITION_KEY               10514
+%token KW_CPU_AFFINITY                10515
+%token KW_NICE                        10516
+%token KW_SCHED_POLICY                10517
+%token KW_STATS_TRACE_SAMPLING        10518
+%token KW_RELOAD_SKIP_UNCHANGED       10519
+%token KW_PERSIST_SYNC_FREQ           10520
+%token KW_SKIP_UNREFERENCED_VALUES    10521
+%token KW_BACKGROUND                  10522
 
 /* END_DECLS */
 
@@ -431,6 +465,10 @@ StatsOptions *last_stats_options;
 %type   <ptr> string_list_build
 %type   <num> facility_string
 %type   <num> level_string
+%type   <num> early_drop_facility_list
+%type   <num> early_drop_facility
+%type   <num> early_drop_level_list
+%type   <num> early_drop_level
 
 /* END_DECLS */
 
@@ -826,6 +864,7 @@ template_content
 template_item
 	: KW_TEMPLATE '(' template_content_inner ')'
 	| KW_TEMPLATE_ESCAPE '(' yesno ')'	{ log_template_set_escape(last_template, $3); }
+	| KW_TEMPLATE_CACHE '(' yesno ')'	{ log_template_set_cache_results(last_template, $3); }
 	;
 
 
@@ -895,10 +934,18 @@ options_item
 	| KW_TIME_SLEEP '(' LL_NUMBER ')'	{}
 	| KW_SUPPRESS '(' LL_NUMBER ')'		{ configuration->suppress = $3; }
 	| KW_THREADED '(' yesno ')'		{ configuration->threaded = $3; }
+	| KW_LOG_MSG_ALLOC_CACHE '(' yesno ')'	{ configuration->log_msg_alloc_cache = $3; }
+	| KW_FILTER_PROFILING '(' yesno ')'	{ configuration->filter_profiling = $3; }
+	| KW_RELOAD_SKIP_UNCHANGED '(' yesno ')' { configuration->reload_skip_unchanged = $3; }
+	| KW_PERSIST_SYNC_FREQ '(' LL_NUMBER ')' { configuration->persist_sync_freq = $3; }
+	| KW_SKIP_UNREFERENCED_VALUES '(' yesno ')' { configuration->skip_unreferenced_values = $3; }
+	| KW_QUEUE_MEMORY_BUDGET '(' LL_NUMBER ')' { configuration->queue_memory_budget = $3; }
 	| KW_PASS_UNIX_CREDENTIALS '(' yesno ')' { configuration->pass_unix_credentials = $3; }
 	| KW_USE_RCPTID '(' yesno ')'		{ cfg_set_use_uniqid($3); }
 	| KW_USE_UNIQID '(' yesno ')'		{ cfg_set_use_uniqid($3); }
 	| KW_LOG_FIFO_SIZE '(' LL_NUMBER ')'	{ configuration->log_fifo_size = $3; }
+	| KW_LOG_FIFO_LOCKLESS '(' yesno ')'	{ configuration->log_fifo_lockless = $3; }
+	| KW_LOG_FIFO_NUMA '(' yesno ')'	{ configuration->log_fifo_numa = $3; }
 	| KW_LOG_IW_SIZE '(' LL_NUMBER ')'	{ msg_error("Using a global log-iw-size() option was removed, please use a per-source log-iw-size()", NULL); }
 	| KW_LOG_FETCH_LIMIT '(' LL_NUMBER ')'	{ msg_error("Using a global log-fetch-limit() option was removed, please use a per-source log-fetch-limit()", NULL); }
 	| KW_LOG_MSG_SIZE '(' LL_NUMBER ')'	{ configuration->log_msg_size = $3; }
@@ -934,6 +981,11 @@ stat_option
 	: KW_STATS_FREQ '(' LL_NUMBER ')'          { last_stats_options->log_freq = $3; }
 	| KW_STATS_LEVEL '(' LL_NUMBER ')'         { last_stats_options->level = $3; }
 	| KW_STATS_LIFETIME '(' LL_NUMBER ')'      { last_stats_options->lifetime = $3; }
+	| KW_STATS_TRACE_SAMPLING '(' LL_NUMBER ')'
+	  {
+	    CHECK_ERROR($3 >= 0, @3, "stats-trace-sampling() must not be negative");
+	    last_stats_options->trace_sampling = $3;
+	  }
 	;
 
 /* START_RULES */
@@ -952,7 +1004,8 @@ yesno
 
 dnsmode
 	: yesno					{ $$ = $1; }
-	| KW_PERSIST_ONLY                       { $$ = 2; }
+	| KW_PERSIST_ONLY                       { $$ = HOST_RESOLVE_DNS_PERSIST_ONLY; }
+	| KW_BACKGROUND                         { $$ = HOST_RESOLVE_DNS_BACKGROUND; }
 	;
 
 string_or_number
@@ -1014,6 +1067,9 @@ parser_opt
 source_option
         /* NOTE: plugins need to set "last_source_options" in order to incorporate this rule in their grammar */
 	: KW_LOG_IW_SIZE '(' LL_NUMBER ')'	{ last_source_options->init_window_size = $3; }
+	| KW_LOG_IW_SIZE_MIN '(' LL_NUMBER ')'	{ last_source_options->min_window_size = $3; }
+	| KW_LOG_IW_SIZE_MAX '(' LL_NUMBER ')'	{ last_source_options->max_window_size = $3; }
+	| KW_LOCKLESS_ACK_TRACKER '(' yesno ')'	{ last_source_options->lockless_ack_tracker = $3; }
 	| KW_CHAIN_HOSTNAMES '(' yesno ')'	{ last_source_options->chain_hostnames = $3; }
 	| KW_KEEP_HOSTNAME '(' yesno ')'	{ last_source_options->keep_hostname = $3; }
 	| KW_PROGRAM_OVERRIDE '(' string ')'	{ last_source_options->program_override = g_strdup($3); free($3); }
@@ -1070,12 +1126,41 @@ source_reader_option
 	: KW_CHECK_HOSTNAME '(' yesno ')'	{ last_reader_options->check_hostname = $3; }
 	| KW_FLAGS '(' source_reader_option_flags ')'
 	| KW_LOG_FETCH_LIMIT '(' LL_NUMBER ')'	{ last_reader_options->fetch_limit = $3; }
+	| KW_PARSE_THREADS '(' LL_NUMBER ')'
+          {
+            CHECK_ERROR($3 >= 1 && $3 <= LOG_READER_MAX_PARSE_THREADS, @3, "parse-threads() must be between 1 and %d", LOG_READER_MAX_PARSE_THREADS);
+            last_reader_options->parse_threads = $3;
+          }
         | KW_FORMAT '(' string ')'              { last_reader_options->parse_options.format = g_strdup($3); free($3); }
+        | KW_EARLY_DROP_FACILITY '(' early_drop_facility_list ')' { last_reader_options->early_drop.facility_mask |= $3; }
+        | KW_EARLY_DROP_LEVEL '(' early_drop_level_list ')'       { last_reader_options->early_drop.level_mask |= $3; }
+        | KW_EARLY_DROP_PREFIX '(' string_list ')'       { early_drop_filter_add_prefixes(&last_reader_options->early_drop, $3); }
+        | KW_EARLY_DROP_LITERAL '(' string_list ')'      { early_drop_filter_add_literals(&last_reader_options->early_drop, $3); }
         | { last_source_options = &last_reader_options->super; } source_option
         | { last_proto_server_options = &last_reader_options->proto_options.super; } source_proto_option
         | { last_msg_format_options = &last_reader_options->parse_options; } msg_format_option
 	;
 
+early_drop_facility_list
+        : early_drop_facility early_drop_facility_list   { $$ = $1 | $2; }
+        | early_drop_facility                    { $$ = $1; }
+        ;
+
+early_drop_facility
+        : facility_string LL_DOTDOT facility_string { $$ = syslog_make_range($1 >> 3, $3 >> 3); }
+        | facility_string                       { $$ = 1 << ($1 >> 3); }
+        ;
+
+early_drop_level_list
+        : early_drop_level early_drop_level_list { $$ = $1 | $2; }
+        | early_drop_level                      { $$ = $1; }
+        ;
+
+early_drop_level
+        : level_string LL_DOTDOT level_string   { $$ = syslog_make_range($1, $3); }
+        | level_string                          { $$ = 1 << $1; }
+        ;
+
 source_reader_option_flags
         : string source_reader_option_flags     { CHECK_ERROR(log_reader_options_process_flag(last_reader_options, $1), @1, "Unknown flag %s", $1); free($1); }
         | KW_CHECK_HOSTNAME source_reader_option_flags     { log_reader_options_process_flag(last_reader_options, "check-hostname"); }
@@ -1087,12 +1172,53 @@ threaded_dest_driver_option
         {
           log_threaded_dest_driver_set_max_retries(last_driver, $3);
         }
+	| KW_BATCH_LINES '(' LL_NUMBER ')'
+        {
+          CHECK_ERROR($3 >= 0, @3, "batch-lines() must not be negative");
+          log_threaded_dest_driver_set_batch_lines(last_driver, $3);
+        }
+	| KW_BATCH_TIMEOUT '(' LL_NUMBER ')'
+        {
+          CHECK_ERROR($3 >= 0, @3, "batch-timeout() must not be negative");
+          log_threaded_dest_driver_set_batch_timeout(last_driver, $3);
+        }
+	| KW_WORKERS '(' LL_NUMBER ')'
+        {
+          CHECK_ERROR($3 >= 1, @3, "workers() must be at least 1");
+          log_threaded_dest_driver_set_workers(last_driver, $3);
+        }
+	| KW_PARTITION_KEY '(' template_content ')'
+        {
+          log_threaded_dest_driver_set_partition_key(last_driver, $3);
+        }
+	| KW_CPU_AFFINITY '(' string ')'
+        {
+          CHECK_ERROR(log_threaded_dest_driver_set_cpu_affinity(last_driver, $3), @3, "Invalid CPU list in cpu-affinity(): %s", $3);
+          free($3);
+        }
+	| KW_NICE '(' LL_NUMBER ')'
+        {
+          CHECK_ERROR($3 >= -20 && $3 <= 19, @3, "nice() must be between -20 and 19");
+          log_threaded_dest_driver_set_nice(last_driver, $3);
+        }
+	| KW_SCHED_POLICY '(' string ')'
+        {
+          CHECK_ERROR(log_threaded_dest_driver_set_sched_policy(last_driver, $3), @3, "Unknown sched-policy(): %s, expected default, other, batch or idle", $3);
+          free($3);
+        }
+	;
 
 dest_driver_option
         /* NOTE: plugins need to set "last_driver" in order to incorporate this rule in their grammar */
 
 	: KW_LOG_FIFO_SIZE '(' LL_NUMBER ')'	{ ((LogDestDriver *) last_driver)->log_fifo_size = $3; }
+	| KW_LOG_FIFO_LOCKLESS '(' yesno ')'	{ ((LogDestDriver *) last_driver)->log_fifo_lockless = $3; }
+	| KW_LOG_FIFO_NUMA '(' yesno ')'	{ ((LogDestDriver *) last_driver)->log_fifo_numa = $3; }
+	| KW_LOG_FIFO_LANES '(' LL_NUMBER ')'	{ ((LogDestDriver *) last_driver)->log_fifo_lanes = $3; }
+	| KW_LOG_FIFO_WEIGHTED_LANES '(' yesno ')' { ((LogDestDriver *) last_driver)->log_fifo_weighted_lanes = $3; }
+	| KW_LOG_FIFO_BYTES '(' LL_NUMBER ')'	{ ((LogDestDriver *) last_driver)->log_fifo_bytes = $3; }
 	| KW_THROTTLE '(' LL_NUMBER ')'         { ((LogDestDriver *) last_driver)->throttle = $3; }
+	| KW_FLOW_CONTROL_BUDGET '(' LL_NUMBER ')' { ((LogDestDriver *) last_driver)->flow_control_budget = $3; }
         | LL_IDENTIFIER
           {
             Plugin *p;
@@ -1124,6 +1250,9 @@ dest_writer_option
 	: KW_FLAGS '(' dest_writer_options_flags ')' { last_writer_options->options = $3; }
 	| KW_FLUSH_LINES '(' LL_NUMBER ')'		{ last_writer_options->flush_lines = $3; }
 	| KW_FLUSH_TIMEOUT '(' LL_NUMBER ')'	{ last_writer_options->flush_timeout = $3; }
+	| KW_FLUSH_TIMEOUT_USEC '(' LL_NUMBER ')'	{ last_writer_options->flush_timeout_usec = $3; }
+	| KW_BATCH_LINES '(' LL_NUMBER ')'	{ last_writer_options->proto_options.super.batch_lines = $3; }
+	| KW_BATCH_BYTES '(' LL_NUMBER ')'	{ last_writer_options->proto_options.super.batch_bytes = $3; }
         | KW_SUPPRESS '(' LL_NUMBER ')'            { last_writer_options->suppress = $3; }
 	| KW_TEMPLATE '(' string ')'       	{
                                                   GError *error = NULL;
@@ -1202,7 +1331,11 @@ value_pair_option
             last_value_pairs = value_pairs_new();
           }
           '(' vp_options ')'
-          { $$ = last_value_pairs; }
+          {
+            if (value_pairs_may_select_any_value(last_value_pairs))
+              cfg_reference_all_values(configuration);
+            $$ = last_value_pairs;
+          }
 	;
 
 vp_options
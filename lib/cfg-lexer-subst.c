@@ -215,11 +215,35 @@ cfg_lexer_subst_invoke(CfgLexerSubst *self, const gchar *input, gssize input_len
   if (input_len < 0)
     input_len = strlen(input);
 
-  result = g_string_sized_new(32);
+  /* fast path, most included files and blocks contain no references */
+  if (!memchr(input, '`', input_len))
+    {
+      gchar *copy = g_malloc(input_len + 1);
+
+      memcpy(copy, input, input_len);
+      copy[input_len] = 0;
+      *output_length = input_len;
+      return copy;
+    }
+
+  result = g_string_sized_new(input_len + 32);
   self->result_buffer = result;
   p = input;
   while (p - input < input_len)
     {
+      if (!backtick && self->string_state == CLS_NOT_STRING)
+        {
+          /* copy everything up to the next character that matters in one go */
+          const gchar *end = p;
+
+          while (end - input < input_len && *end != '`' && *end != '"' && *end != '\'')
+            end++;
+          g_string_append_len(result, p, end - p);
+          p = end;
+          if (p - input >= input_len)
+            break;
+        }
+
       self->string_state = _track_string_state(self, self->string_state, p);
 
       if (!backtick && (*p) == '`')
@@ -159,63 +159,102 @@ cfg_lexer_subst_args(CfgArgs *globals, CfgArgs *defs, CfgArgs *args, const gchar
   return result;
 }
 
+/*
+ * Keyword tables are static arrays, scanning them linearly for every
+ * identifier is slow with large configurations.  Each table is indexed by
+ * name the first time it is used, the index lives as long as the process.
+ */
+typedef struct _CfgLexerKeywordIndex
+{
+  GHashTable *keywords;
+  /* the table ends with CFG_KEYWORD_STOP, e.g. unknown names are identifiers */
+  gboolean has_stop;
+} CfgLexerKeywordIndex;
+
+static GHashTable *cfg_lexer_keyword_indexes;
+
+static CfgLexerKeywordIndex *
+_get_keyword_index(CfgLexerKeyword *keywords)
+{
+  CfgLexerKeywordIndex *index;
+  gint i;
+
+  if (!cfg_lexer_keyword_indexes)
+    cfg_lexer_keyword_indexes = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+  index = g_hash_table_lookup(cfg_lexer_keyword_indexes, keywords);
+  if (index)
+    return index;
+
+  index = g_new0(CfgLexerKeywordIndex, 1);
+  index->keywords = g_hash_table_new(g_str_hash, g_str_equal);
+  for (i = 0; keywords[i].kw_name; i++)
+    {
+      if (strcmp(keywords[i].kw_name, CFG_KEYWORD_STOP) == 0)
+        {
+          index->has_stop = TRUE;
+          break;
+        }
+      /* the first one wins, just like with the linear search */
+      if (!g_hash_table_lookup(index->keywords, keywords[i].kw_name))
+        g_hash_table_insert(index->keywords, (gpointer) keywords[i].kw_name, &keywords[i]);
+    }
+  g_hash_table_insert(cfg_lexer_keyword_indexes, keywords, index);
+  return index;
+}
+
 int
 cfg_lexer_lookup_keyword(CfgLexer *self, YYSTYPE *yylval, YYLTYPE *yylloc, const char *token)
 {
+  gchar normalized_buf[128];
+  gchar *normalized;
+  gsize token_len = strlen(token);
+  CfgLexerKeyword *keyword = NULL;
   GList *l;
+  gint i;
 
-  l = self->context_stack;
-  while (l)
+  /* keywords are stored with underscores, but dashes are accepted too */
+  normalized = token_len < sizeof(normalized_buf) ? normalized_buf : g_malloc(token_len + 1);
+  for (i = 0; token[i]; i++)
+    normalized[i] = token[i] == '-' ? '_' : token[i];
+  normalized[i] = 0;
+
+  for (l = self->context_stack; l; l = l->next)
     {
       CfgLexerContext *context = ((CfgLexerContext *) l->data);
-      CfgLexerKeyword *keywords = context->keywords;
+      CfgLexerKeywordIndex *index;
 
-      if (keywords)
-        {
-          int i, j;
+      if (!context->keywords)
+        continue;
 
-          for (i = 0; keywords[i].kw_name; i++)
-            {
-              if (strcmp(keywords[i].kw_name, CFG_KEYWORD_STOP) == 0)
-                {
-                  yylval->type = LL_IDENTIFIER;
-                  yylval->cptr = strdup(token);
-                  return LL_IDENTIFIER;
-                }
+      index = _get_keyword_index(context->keywords);
+      keyword = g_hash_table_lookup(index->keywords, normalized);
+      if (keyword || index->has_stop)
+        break;
+    }
 
-              for (j = 0; token[j] && keywords[i].kw_name[j]; j++)
-                {
-                  if (token[j] == '-' || token[j] == '_')
-                    {
-                      if (keywords[i].kw_name[j] != '_')
-                        break;
-                    }
-                  else if (token[j] != keywords[i].kw_name[j])
-                    break;
-                }
-              if (token[j] == 0 && keywords[i].kw_name[j] == 0)
-                {
-                  /* match */
-                  switch (keywords[i].kw_status)
-                    {
-                    case KWS_OBSOLETE:
-                      msg_warning("WARNING: Your configuration file uses an obsoleted keyword, please update your configuration",
-                                  evt_tag_str("keyword", keywords[i].kw_name),
-                                  evt_tag_str("change", keywords[i].kw_explain),
-                                  NULL);
-                      break;
-                    default:
-                      break;
-                    }
-                  keywords[i].kw_status = KWS_NORMAL;
-                  yylval->type = LL_TOKEN;
-                  yylval->token = keywords[i].kw_token;
-                  return keywords[i].kw_token;
-                }
-            }
+  if (normalized != normalized_buf)
+    g_free(normalized);
+
+  if (keyword)
+    {
+      switch (keyword->kw_status)
+        {
+        case KWS_OBSOLETE:
+          msg_warning("WARNING: Your configuration file uses an obsoleted keyword, please update your configuration",
+                      evt_tag_str("keyword", keyword->kw_name),
+                      evt_tag_str("change", keyword->kw_explain),
+                      NULL);
+          break;
+        default:
+          break;
         }
-      l = l->next;
+      keyword->kw_status = KWS_NORMAL;
+      yylval->type = LL_TOKEN;
+      yylval->token = keyword->kw_token;
+      return keyword->kw_token;
     }
+
   yylval->type = LL_IDENTIFIER;
   yylval->cptr = strdup(token);
   return LL_IDENTIFIER;
@@ -84,9 +84,13 @@ static CfgLexerKeyword main_keywords[] = {
   { "stats_freq",         KW_STATS_FREQ },
   { "stats_lifetime",     KW_STATS_LIFETIME },
   { "stats_level",        KW_STATS_LEVEL },
+  { "stats_trace_sampling", KW_STATS_TRACE_SAMPLING },
   { "stats",              KW_STATS_FREQ, KWS_OBSOLETE, "stats_freq" },
   { "flush_lines",        KW_FLUSH_LINES },
   { "flush_timeout",      KW_FLUSH_TIMEOUT },
+  { "flush_timeout_usec", KW_FLUSH_TIMEOUT_USEC },
+  { "batch_lines",        KW_BATCH_LINES },
+  { "batch_bytes",        KW_BATCH_BYTES },
   { "suppress",           KW_SUPPRESS },
   { "sync_freq",          KW_FLUSH_LINES, KWS_OBSOLETE, "flush_lines" },
   { "sync",               KW_FLUSH_LINES, KWS_OBSOLETE, "flush_lines" },
@@ -122,13 +126,33 @@ static CfgLexerKeyword main_keywords[] = {
   { "use_uniqid",         KW_USE_UNIQID },
 
   { "log_fifo_size",      KW_LOG_FIFO_SIZE },
+  { "log_fifo_lockless",  KW_LOG_FIFO_LOCKLESS },
+  { "log_fifo_numa",      KW_LOG_FIFO_NUMA },
+  { "log_fifo_lanes",     KW_LOG_FIFO_LANES },
+  { "log_fifo_weighted_lanes", KW_LOG_FIFO_WEIGHTED_LANES },
+  { "log_fifo_bytes",     KW_LOG_FIFO_BYTES },
   { "log_fetch_limit",    KW_LOG_FETCH_LIMIT },
+  { "parse_threads",      KW_PARSE_THREADS },
+  { "early_drop_facility", KW_EARLY_DROP_FACILITY },
+  { "early_drop_level",   KW_EARLY_DROP_LEVEL },
+  { "early_drop_prefix",  KW_EARLY_DROP_PREFIX },
+  { "early_drop_literal", KW_EARLY_DROP_LITERAL },
   { "log_iw_size",        KW_LOG_IW_SIZE },
+  { "log_iw_size_min",    KW_LOG_IW_SIZE_MIN },
+  { "log_iw_size_max",    KW_LOG_IW_SIZE_MAX },
+  { "lockless_ack_tracker", KW_LOCKLESS_ACK_TRACKER },
   { "log_msg_size",       KW_LOG_MSG_SIZE },
+  { "log_msg_alloc_cache", KW_LOG_MSG_ALLOC_CACHE },
+  { "filter_profiling",   KW_FILTER_PROFILING },
+  { "reload_skip_unchanged", KW_RELOAD_SKIP_UNCHANGED },
+  { "persist_sync_freq",  KW_PERSIST_SYNC_FREQ },
+  { "skip_unreferenced_values", KW_SKIP_UNREFERENCED_VALUES },
+  { "queue_memory_budget", KW_QUEUE_MEMORY_BUDGET },
   { "log_prefix",         KW_LOG_PREFIX, KWS_OBSOLETE, "program_override" },
   { "program_override",   KW_PROGRAM_OVERRIDE },
   { "host_override",      KW_HOST_OVERRIDE },
   { "throttle",           KW_THROTTLE },
+  { "flow_control_budget", KW_FLOW_CONTROL_BUDGET },
 
   { "create_dirs",        KW_CREATE_DIRS },
   { "optional",           KW_OPTIONAL },
@@ -141,9 +165,11 @@ static CfgLexerKeyword main_keywords[] = {
   { "dir_perm",           KW_DIR_PERM },
   { "template",           KW_TEMPLATE },
   { "template_escape",    KW_TEMPLATE_ESCAPE },
+  { "template_cache",     KW_TEMPLATE_CACHE },
   { "template_function",  KW_TEMPLATE_FUNCTION },
   { "on_error",           KW_ON_ERROR },
   { "persist_only",       KW_PERSIST_ONLY },
+  { "background",         KW_BACKGROUND },
   { "dns_cache_hosts",    KW_DNS_CACHE_HOSTS },
   { "dns_cache",          KW_DNS_CACHE },
   { "dns_cache_size",     KW_DNS_CACHE_SIZE },
@@ -152,6 +178,12 @@ static CfgLexerKeyword main_keywords[] = {
   { "pass_unix_credentials", KW_PASS_UNIX_CREDENTIALS },
 
   { "retries",            KW_RETRIES },
+  { "batch_timeout",      KW_BATCH_TIMEOUT },
+  { "workers",            KW_WORKERS },
+  { "partition_key",      KW_PARTITION_KEY },
+  { "cpu_affinity",       KW_CPU_AFFINITY },
+  { "nice",               KW_NICE },
+  { "sched_policy",       KW_SCHED_POLICY },
 
   /* filter items */
   { "type",               KW_TYPE },
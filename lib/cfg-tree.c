@@ -1063,6 +1063,192 @@ cfg_tree_compile(CfgTree *self)
   return TRUE;
 }
 
+/*
+ * Stage fusion
+ *
+ * Filters, parsers and rewrite rules in a log path form linear chains of
+ * LogPipes, and each of them forwards the message to the next one with
+ * a separate log_pipe_queue() call.  Once the pipeline is initialized,
+ * the head of each such chain gets a queue() method that runs the
+ * stage() of all members in a loop and only forwards the message at the
+ * end of the chain.
+ *
+ * The members themselves are left intact, so anything that enters in
+ * the middle of a chain is still processed correctly, and the original
+ * hop-by-hop processing is used while the debugger is single stepping.
+ */
+typedef struct _CfgTreeFusedChain
+{
+  LogPipe *head;
+  GPtrArray *stages;
+} CfgTreeFusedChain;
+
+static void
+cfg_tree_fused_chain_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options, gpointer user_data)
+{
+  CfgTreeFusedChain *chain = (CfgTreeFusedChain *) user_data;
+  LogPipe *stage = NULL;
+  gint i;
+
+  if (G_UNLIKELY(pipe_single_step_hook))
+    {
+      log_pipe_stage_queue_method(s, msg, path_options, NULL);
+      return;
+    }
+
+  for (i = 0; i < chain->stages->len; i++)
+    {
+      stage = g_ptr_array_index(chain->stages, i);
+
+      if (stage->stage && !stage->stage(stage, &msg, path_options))
+        {
+          if (path_options->matched)
+            (*path_options->matched) = FALSE;
+          log_msg_drop(msg, path_options, AT_PROCESSED);
+          return;
+        }
+    }
+  log_pipe_forward_msg(stage, msg, path_options);
+}
+
+static void
+cfg_tree_fused_chain_free(CfgTreeFusedChain *chain)
+{
+  if (chain->head->queue == cfg_tree_fused_chain_queue)
+    {
+      chain->head->queue = log_pipe_stage_queue_method;
+      chain->head->queue_data = NULL;
+    }
+  g_ptr_array_free(chain->stages, TRUE);
+  g_free(chain);
+}
+
+static gboolean
+cfg_tree_is_fusable_head(LogPipe *pipe)
+{
+  return pipe->stage && pipe->queue == log_pipe_stage_queue_method && !pipe->queue_data;
+}
+
+/* stage pipes, and pipes that only forward the message */
+static gboolean
+cfg_tree_is_fusable_member(LogPipe *pipe)
+{
+  if (pipe->flags & PIF_HARD_FLOW_CONTROL)
+    return FALSE;
+  return cfg_tree_is_fusable_head(pipe) || (!pipe->queue && pipe->pipe_next);
+}
+
+static void
+cfg_tree_fuse_stages(CfgTree *self)
+{
+  GHashTable *non_heads;
+  gint i;
+
+  /* pipes that are reached from a fusable pipe are covered by the chain of that one */
+  non_heads = g_hash_table_new(g_direct_hash, g_direct_equal);
+  for (i = 0; i < self->initialized_pipes->len; i++)
+    {
+      LogPipe *pipe = g_ptr_array_index(self->initialized_pipes, i);
+
+      if (cfg_tree_is_fusable_member(pipe) && pipe->pipe_next && cfg_tree_is_fusable_member(pipe->pipe_next))
+        g_hash_table_insert(non_heads, pipe->pipe_next, pipe->pipe_next);
+    }
+
+  for (i = 0; i < self->initialized_pipes->len; i++)
+    {
+      LogPipe *pipe = g_ptr_array_index(self->initialized_pipes, i);
+      CfgTreeFusedChain *chain;
+      LogPipe *p;
+
+      if (!cfg_tree_is_fusable_head(pipe) || g_hash_table_lookup(non_heads, pipe))
+        continue;
+
+      if (!pipe->pipe_next || !cfg_tree_is_fusable_member(pipe->pipe_next))
+        continue;
+
+      chain = g_new0(CfgTreeFusedChain, 1);
+      chain->head = pipe;
+      chain->stages = g_ptr_array_new();
+      g_ptr_array_add(chain->stages, pipe);
+      for (p = pipe->pipe_next; p && cfg_tree_is_fusable_member(p); p = p->pipe_next)
+        {
+          /* guard against loops */
+          if (p == pipe)
+            break;
+          g_ptr_array_add(chain->stages, p);
+        }
+
+      pipe->queue = cfg_tree_fused_chain_queue;
+      pipe->queue_data = chain;
+      g_ptr_array_add(self->fused_chains, chain);
+    }
+  g_hash_table_destroy(non_heads);
+}
+
+static void
+cfg_tree_unfuse_stages(CfgTree *self)
+{
+  g_ptr_array_foreach(self->fused_chains, (GFunc) cfg_tree_fused_chain_free, NULL);
+  g_ptr_array_set_size(self->fused_chains, 0);
+}
+
+#define CFG_TREE_PRE_INIT_MAX_THREADS 16
+
+static void
+_pre_init_pipe(gpointer data, gpointer user_data)
+{
+  LogPipe *pipe = (LogPipe *) data;
+  gint *failed = (gint *) user_data;
+
+  if (!log_pipe_pre_init(pipe))
+    g_atomic_int_set(failed, TRUE);
+}
+
+/*
+ * Runs the pre_init() methods of all pipes in parallel, returns when all
+ * of them have finished, so that init() only does the quick parts on
+ * the main thread.
+ */
+static gboolean
+cfg_tree_pre_init_pipes(CfgTree *self)
+{
+  GHashTable *seen;
+  GPtrArray *pipes;
+  GThreadPool *pool = NULL;
+  gint failed = FALSE;
+  gint i;
+
+  seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+  pipes = g_ptr_array_new();
+  for (i = 0; i < self->initialized_pipes->len; i++)
+    {
+      LogPipe *pipe = g_ptr_array_index(self->initialized_pipes, i);
+
+      /* the same pipe may be referenced more than once */
+      if (!pipe->pre_init || (pipe->flags & PIF_INITIALIZED) || g_hash_table_lookup(seen, pipe))
+        continue;
+      g_hash_table_insert(seen, pipe, pipe);
+      g_ptr_array_add(pipes, pipe);
+    }
+  g_hash_table_destroy(seen);
+
+  if (pipes->len > 1)
+    pool = g_thread_pool_new(_pre_init_pipe, &failed, MIN(pipes->len, CFG_TREE_PRE_INIT_MAX_THREADS), TRUE, NULL);
+
+  for (i = 0; i < pipes->len; i++)
+    {
+      if (pool)
+        g_thread_pool_push(pool, g_ptr_array_index(pipes, i), NULL);
+      else
+        _pre_init_pipe(g_ptr_array_index(pipes, i), &failed);
+    }
+
+  if (pool)
+    g_thread_pool_free(pool, FALSE, TRUE);
+  g_ptr_array_free(pipes, TRUE);
+  return !g_atomic_int_get(&failed);
+}
+
 gboolean
 cfg_tree_start(CfgTree *self)
 {
@@ -1071,6 +1257,13 @@ cfg_tree_start(CfgTree *self)
   if (!cfg_tree_compile(self))
     return FALSE;
 
+  if (!cfg_tree_pre_init_pipes(self))
+    {
+      msg_error("Error initializing message pipeline",
+                NULL);
+      return FALSE;
+    }
+
   /*
    *   As there are pipes that are dynamically created during init, these
    *   pipes must be deinited before destroying the configuration, otherwise
@@ -1088,6 +1281,7 @@ cfg_tree_start(CfgTree *self)
           return FALSE;
         }
     }
+  cfg_tree_fuse_stages(self);
   return TRUE;
 }
 
@@ -1097,6 +1291,7 @@ cfg_tree_stop(CfgTree *self)
   gboolean success = TRUE;
   gint i;
 
+  cfg_tree_unfuse_stages(self);
   for (i = 0; i < self->initialized_pipes->len; i++)
     {
       if (!log_pipe_deinit(g_ptr_array_index(self->initialized_pipes, i)))
@@ -1113,12 +1308,16 @@ cfg_tree_init_instance(CfgTree *self, GlobalConfig *cfg)
   self->objects = g_hash_table_new_full(cfg_tree_objects_hash, cfg_tree_objects_equal, NULL, (GDestroyNotify) log_expr_node_free);
   self->templates = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify) log_template_unref);
   self->rules = g_ptr_array_new();
+  self->fused_chains = g_ptr_array_new();
   self->cfg = cfg;
 }
 
 void
 cfg_tree_free_instance(CfgTree *self)
 {
+  cfg_tree_unfuse_stages(self);
+  g_ptr_array_free(self->fused_chains, TRUE);
+
   g_ptr_array_foreach(self->initialized_pipes, (GFunc) log_pipe_unref, NULL);
   g_ptr_array_free(self->initialized_pipes, TRUE);
 
@@ -157,6 +157,8 @@ typedef struct _CfgTree
   /* list of top-level rules */
   GPtrArray *rules;
   GHashTable *templates;
+  /* LogPipe chains fused by cfg_tree_start(), see cfg_tree_fuse_stages() */
+  GPtrArray *fused_chains;
 } CfgTree;
 
 gboolean cfg_tree_add_object(CfgTree *self, LogExprNode *rule);
@@ -29,6 +29,8 @@
 #include "template/templates.h"
 #include "userdb.h"
 #include "logmsg/logmsg.h"
+#include "logmsg/logmsg-slab.h"
+#include "logqueue.h"
 #include "dnscache.h"
 #include "serialize.h"
 #include "plugin.h"
@@ -38,6 +40,7 @@
 #include "reloc.h"
 #include "hostname.h"
 #include "rcptid.h"
+#include "persist-state.h"
 #include "resolved-configurable-paths.h"
 
 #include <sys/types.h>
@@ -254,7 +257,11 @@ cfg_init(GlobalConfig *cfg)
 
   if (!rcptid_init(cfg->state, cfg->use_uniqid))
     return FALSE;
+  if (cfg->state)
+    persist_state_set_sync_freq(cfg->state, cfg->persist_sync_freq);
 
+  log_msg_slab_set_enabled(cfg->log_msg_alloc_cache);
+  log_queue_set_memory_budget(cfg->queue_memory_budget);
   stats_reinit(&cfg->stats_options);
   log_tags_reinit_stats(cfg);
 
@@ -264,7 +271,11 @@ cfg_init(GlobalConfig *cfg)
   log_template_options_init(&cfg->template_options, cfg);
   if (!cfg_init_modules(cfg))
     return FALSE;
-  return cfg_tree_start(&cfg->tree);
+  if (!cfg_tree_start(&cfg->tree))
+    return FALSE;
+  log_msg_registry_mark_config_handles();
+  cfg->value_references_frozen = cfg->skip_unreferenced_values;
+  return TRUE;
 }
 
 gboolean
@@ -275,6 +286,42 @@ cfg_deinit(GlobalConfig *cfg)
   return cfg_tree_stop(&cfg->tree);
 }
 
+/*
+ * Records that @handle is read by something in the configuration.  The
+ * set is complete once the configuration is started, anything that wants
+ * to read values by name after that (e.g. a template compiled at runtime)
+ * makes all values referenced, as parsers may already be skipping them.
+ */
+void
+cfg_reference_value(GlobalConfig *cfg, NVHandle handle)
+{
+  if (!cfg)
+    return;
+
+  if (cfg->value_references_frozen)
+    {
+      cfg->all_values_referenced = TRUE;
+      return;
+    }
+
+  if (handle >= cfg->referenced_values->len)
+    {
+      guint old_len = cfg->referenced_values->len;
+
+      g_byte_array_set_size(cfg->referenced_values, handle + 1);
+      memset(cfg->referenced_values->data + old_len, 0, handle + 1 - old_len);
+    }
+  cfg->referenced_values->data[handle] = 1;
+}
+
+/* for consumers that read values they don't know in advance */
+void
+cfg_reference_all_values(GlobalConfig *cfg)
+{
+  if (cfg)
+    cfg->all_values_referenced = TRUE;
+}
+
 void
 cfg_set_version(GlobalConfig *self, gint version)
 {
@@ -386,6 +433,8 @@ cfg_new(gint version)
   self->keep_timestamp = TRUE;
 
   self->use_uniqid = FALSE;
+  self->skip_unreferenced_values = TRUE;
+  self->referenced_values = g_byte_array_new();
   
   stats_options_defaults(&self->stats_options);
 
@@ -462,6 +511,28 @@ cfg_dump_processed_config(GString *preprocess_output, gchar *output_filename)
     }
 }
 
+/* takes ownership of @preprocess_output */
+static void
+cfg_set_preprocessed_config(GlobalConfig *self, GString *preprocess_output)
+{
+  if (self->preprocessed_config)
+    g_string_free(self->preprocessed_config, TRUE);
+  self->preprocessed_config = preprocess_output;
+}
+
+/*
+ * Whether two configurations were parsed from the same text, after
+ * preprocessing.  Files referenced by the configuration (certificates,
+ * pattern databases, etc.) are not considered, only their names.
+ */
+gboolean
+cfg_is_preprocessed_config_equal(GlobalConfig *self, GlobalConfig *other)
+{
+  if (!self->preprocessed_config || !other->preprocessed_config)
+    return FALSE;
+  return g_string_equal(self->preprocessed_config, other->preprocessed_config);
+}
+
 gboolean
 cfg_load_config(GlobalConfig *self, gchar *config_string, gboolean syntax_only, gchar *preprocess_into)
 {
@@ -477,7 +548,7 @@ cfg_load_config(GlobalConfig *self, gchar *config_string, gboolean syntax_only,
     {
       cfg_dump_processed_config(preprocess_output, preprocess_into);
     }
-  g_string_free(preprocess_output, TRUE);
+  cfg_set_preprocessed_config(self, preprocess_output);
   if (res)
     {
       return TRUE;
@@ -505,7 +576,7 @@ cfg_read_config(GlobalConfig *self, const gchar *fname, gboolean syntax_only, gc
         {
           cfg_dump_processed_config(preprocess_output, preprocess_into);
         }
-      g_string_free(preprocess_output, TRUE);
+      cfg_set_preprocessed_config(self, preprocess_output);
       if (res)
         {
           /* successfully parsed */
@@ -542,6 +613,9 @@ cfg_free(GlobalConfig *self)
   g_free(self->bad_hostname_re);
   g_free(self->dns_cache_hosts);
   g_free(self->custom_domain);
+  g_byte_array_free(self->referenced_values, TRUE);
+  if (self->preprocessed_config)
+    g_string_free(self->preprocessed_config, TRUE);
   plugin_free_plugins(self);
   plugin_free_candidate_modules(self);
   cfg_tree_free_instance(&self->tree);
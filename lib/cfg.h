@@ -31,6 +31,7 @@
 #include "cfg-parser.h"
 #include "persist-state.h"
 #include "template/templates.h"
+#include "logmsg/logmsg.h"
 #include "host-resolve.h"
 #include "type-hinting.h"
 #include "stats/stats.h"
@@ -67,6 +68,9 @@ struct _GlobalConfig
   GList *candidate_plugins;
   gboolean autoload_compiled_modules;
   CfgLexer *lexer;
+  /* the configuration as seen by the parser, includes and block
+   * references already expanded */
+  GString *preprocessed_config;
 
   StatsOptions stats_options;
   gint mark_freq;
@@ -90,7 +94,24 @@ struct _GlobalConfig
   gint type_cast_strictness;
 
   gint log_fifo_size;
+  gboolean log_fifo_lockless;
+  gboolean log_fifo_numa;
   gint log_msg_size;
+  gboolean log_msg_alloc_cache;
+  gboolean filter_profiling;
+  /* don't rebuild the pipeline if a reload finds the same configuration */
+  gboolean reload_skip_unchanged;
+  /* seconds between syncing the persist file to disk, 0 leaves it to the kernel */
+  gint persist_sync_freq;
+  /* bytes all queues may hold before sources are throttled, 0 means unlimited */
+  gint64 queue_memory_budget;
+  /* let parsers skip storing values nothing in the configuration reads */
+  gboolean skip_unreferenced_values;
+  /* one byte per NVHandle, non-zero if a template, filter, rewrite rule
+   * or destination reads that value */
+  GByteArray *referenced_values;
+  gboolean all_values_referenced;
+  gboolean value_references_frozen;
 
   gboolean create_dirs;
   gint file_uid;
@@ -147,6 +168,7 @@ GlobalConfig *cfg_new(gint version);
 gboolean cfg_run_parser(GlobalConfig *self, CfgLexer *lexer, CfgParser *parser, gpointer *result, gpointer arg);
 gboolean cfg_read_config(GlobalConfig *cfg, const gchar *fname, gboolean syntax_only, gchar *preprocess_into);
 gboolean cfg_load_config(GlobalConfig *self, gchar *config_string, gboolean syntax_only, gchar *preprocess_into);
+gboolean cfg_is_preprocessed_config_equal(GlobalConfig *self, GlobalConfig *other);
 void cfg_free(GlobalConfig *self);
 gboolean cfg_init(GlobalConfig *cfg);
 gboolean cfg_deinit(GlobalConfig *cfg);
@@ -174,6 +196,22 @@ cfg_set_use_uniqid(gboolean flag)
   configuration->use_uniqid = !!flag;
 }
 
+void cfg_reference_value(GlobalConfig *cfg, NVHandle handle);
+void cfg_reference_all_values(GlobalConfig *cfg);
+
+/*
+ * Whether parsers have to store the value @handle.  Until the
+ * configuration is started everything counts as referenced, as the list
+ * is still being collected, and so do the built-in values.
+ */
+static inline gboolean
+cfg_is_value_referenced(GlobalConfig *cfg, NVHandle handle)
+{
+  if (!cfg || !cfg->value_references_frozen || cfg->all_values_referenced || handle < LM_V_MAX)
+    return TRUE;
+  return handle < cfg->referenced_values->len && cfg->referenced_values->data[handle];
+}
+
 gint cfg_get_user_version(const GlobalConfig *cfg);
 gint cfg_get_parsed_version(const GlobalConfig *cfg);
 const gchar* cfg_get_filename(const GlobalConfig *cfg);
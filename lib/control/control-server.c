@@ -38,6 +38,13 @@ control_server_init_instance(ControlServer *self, const gchar *path, GList *cont
   self->control_commands = control_commands;
 }
 
+static void
+control_connection_free_reply_stream(ControlConnection *self)
+{
+  self->reply_stream->free_fn(self->reply_stream);
+  self->reply_stream = NULL;
+}
+
 void
 control_connection_free(ControlConnection *self)
 {
@@ -45,6 +52,8 @@ control_connection_free(ControlConnection *self)
     {
       self->free_fn(self);
     }
+  if (self->reply_stream)
+    control_connection_free_reply_stream(self);
   g_string_free(self->output_buffer, TRUE);
   g_string_free(self->input_buffer, TRUE);
   g_free(self);
@@ -67,6 +76,32 @@ control_connection_send_reply(ControlConnection *self, GString *reply)
   control_connection_update_watches(self);
 }
 
+static void
+control_connection_produce_reply_chunk(ControlConnection *self)
+{
+  g_string_truncate(self->output_buffer, 0);
+  self->pos = 0;
+
+  /* an empty chunk would stop the output watch, ask for more */
+  while (self->output_buffer->len == 0)
+    {
+      if (!self->reply_stream->next_chunk(self->reply_stream, self->output_buffer))
+        {
+          g_string_append(self->output_buffer, ".\n");
+          control_connection_free_reply_stream(self);
+          break;
+        }
+    }
+}
+
+static void
+control_connection_send_reply_stream(ControlConnection *self, ControlReplyStream *stream)
+{
+  self->reply_stream = stream;
+  control_connection_produce_reply_chunk(self);
+  control_connection_update_watches(self);
+}
+
 static void
 control_connection_io_output(gpointer s)
 {
@@ -89,6 +124,8 @@ control_connection_io_output(gpointer s)
   else
     {
       self->pos += rc;
+      if (self->pos == self->output_buffer->len && self->reply_stream)
+        control_connection_produce_reply_chunk(self);
     }
   control_connection_update_watches(self);
 }
@@ -164,9 +201,16 @@ control_connection_io_input(void *s)
 
   for (iter = self->server->control_commands; iter != NULL; iter = iter->next)
     {
-      if (strncmp(((ControlCommand*)iter->data)->command_name, command->str, strlen(((ControlCommand*)iter->data)->command_name)) == 0)
+      ControlCommand *cmd = (ControlCommand *) iter->data;
+
+      if (strncmp(cmd->command_name, command->str, strlen(cmd->command_name)) == 0)
         {
-          reply = ((ControlCommand*)iter->data)->func(command);
+          if (cmd->stream_func)
+            {
+              control_connection_send_reply_stream(self, cmd->stream_func(command));
+              break;
+            }
+          reply = cmd->func(command);
           control_connection_send_reply(self, reply);
           break;
         }
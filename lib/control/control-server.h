@@ -34,6 +34,7 @@ typedef struct _ControlCommand
   const gchar *command_name;
   const gchar *description;
   CommandFunction func;
+  StreamingCommandFunction stream_func;
 } ControlCommand;
 
 typedef struct _ControlServer ControlServer;
@@ -44,6 +45,8 @@ struct _ControlConnection
   GString *input_buffer;
   GString *output_buffer;
   gsize pos;
+  /* reply being streamed, the rest of it is produced as output_buffer drains */
+  ControlReplyStream *reply_stream;
   ControlServer *server;
   int (*read)(ControlConnection *self, gpointer buffer, gsize size);
   int (*write)(ControlConnection *self, gpointer buffer, gsize size);
@@ -27,12 +27,18 @@
 #include "gsocket.h"
 #include "messages.h"
 #include "stats/stats-csv.h"
+#include "stats/stats-prometheus.h"
+#include "stats/stats-query.h"
 #include "stats/stats-counter.h"
 #include "mainloop.h"
+#include "logmsg/logmsg.h"
+#include "filter/filter-profile.h"
+#include "memprof.h"
 
 #include <errno.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <iv.h>
 
 static ControlServer *control_server;
@@ -48,15 +54,75 @@ control_register_command(const gchar *command_name, const gchar *description, Co
   command_list = g_list_append(command_list, new_command);
 };
 
+void
+control_register_streaming_command(const gchar *command_name, const gchar *description, StreamingCommandFunction function)
+{
+  ControlCommand *new_command = g_new0(ControlCommand, 1);
+  new_command->command_name = command_name;
+  new_command->description = description;
+  new_command->stream_func = function;
+  command_list = g_list_append(command_list, new_command);
+}
+
+/* STATS [QUERY <pattern> [<session>]] */
 static GString *
 control_connection_send_stats(GString *command)
 {
-  gchar *stats = stats_generate_csv();
-  GString *result = g_string_new(stats);
-  g_free(stats);
+  gchar **cmds = g_strsplit(command->str, " ", 4);
+  GString *result;
+  gchar *stats;
+
+  if (!cmds[1])
+    {
+      stats = stats_generate_csv();
+      result = g_string_new(stats);
+      g_free(stats);
+    }
+  else if (g_str_equal(cmds[1], "QUERY") && cmds[2])
+    {
+      result = stats_query(cmds[2], cmds[3]);
+    }
+  else
+    result = g_string_new("Invalid arguments received");
+
+  g_strfreev(cmds);
   return result;
 }
 
+typedef struct _PrometheusStatsReply
+{
+  ControlReplyStream super;
+  StatsPrometheusQuery *query;
+} PrometheusStatsReply;
+
+static gboolean
+_prometheus_stats_next_chunk(ControlReplyStream *s, GString *output)
+{
+  PrometheusStatsReply *self = (PrometheusStatsReply *) s;
+
+  return stats_prometheus_query_format_chunk(self->query, output);
+}
+
+static void
+_prometheus_stats_free(ControlReplyStream *s)
+{
+  PrometheusStatsReply *self = (PrometheusStatsReply *) s;
+
+  stats_prometheus_query_free(self->query);
+  g_free(self);
+}
+
+static ControlReplyStream *
+control_connection_send_prometheus_stats(GString *command)
+{
+  PrometheusStatsReply *self = g_new0(PrometheusStatsReply, 1);
+
+  self->super.next_chunk = _prometheus_stats_next_chunk;
+  self->super.free_fn = _prometheus_stats_free;
+  self->query = stats_prometheus_query_new();
+  return &self->super;
+}
+
 static GString *
 control_connection_reset_stats(GString *command)
 {
@@ -65,6 +131,60 @@ control_connection_reset_stats(GString *command)
   return result;
 }
 
+static GString *
+control_connection_send_handle_stats(GString *command)
+{
+  GString *result = g_string_sized_new(128);
+  guint builtin, config, runtime;
+
+  log_msg_registry_get_handle_counts(&builtin, &config, &runtime);
+  g_string_printf(result, "builtin=%u\nconfig=%u\nruntime=%u", builtin, config, runtime);
+  return result;
+}
+
+static GString *
+control_connection_send_filter_stats(GString *command)
+{
+  return filter_profile_format_stats();
+}
+
+/* MEMPROF [START <sampling-rate>|STOP] */
+static GString *
+control_connection_memprof(GString *command)
+{
+  gchar **cmds = g_strsplit(command->str, " ", 3);
+  GString *result;
+  gint rate;
+
+  if (!cmds[1])
+    {
+      result = memprof_format_report();
+    }
+  else if (g_str_equal(cmds[1], "START"))
+    {
+      rate = cmds[2] ? atoi(cmds[2]) : 0;
+      if (rate > 0)
+        {
+          memprof_start(rate);
+          msg_info("Allocation profiling started", evt_tag_int("sampling_rate", rate), NULL);
+          result = g_string_new("OK");
+        }
+      else
+        result = g_string_new("Invalid arguments received, expected a positive sampling rate");
+    }
+  else if (g_str_equal(cmds[1], "STOP"))
+    {
+      memprof_stop();
+      msg_info("Allocation profiling stopped", NULL);
+      result = g_string_new("OK");
+    }
+  else
+    result = g_string_new("Invalid arguments received");
+
+  g_strfreev(cmds);
+  return result;
+}
+
 static GString *
 control_connection_message_log(GString *command)
 {
@@ -130,6 +250,9 @@ control_connection_reload(GString *command)
 ControlCommand default_commands[] = {
   { "STATS", NULL, control_connection_send_stats },
   { "RESET_STATS", NULL, control_connection_reset_stats },
+  { "HANDLE_STATS", NULL, control_connection_send_handle_stats },
+  { "FILTER_STATS", NULL, control_connection_send_filter_stats },
+  { "MEMPROF", NULL, control_connection_memprof },
   { "LOG", NULL, control_connection_message_log },
   { "STOP", NULL, control_connection_stop_process },
   { "RELOAD", NULL, control_connection_reload },
@@ -147,6 +270,8 @@ register_default_commands()
       cmd = &default_commands[i];
       control_register_command(cmd->command_name, cmd->description, cmd->func);
     }
+  /* NOTE: commands are matched by prefix, this must not start with "STATS" */
+  control_register_streaming_command("PROMETHEUS_STATS", NULL, control_connection_send_prometheus_stats);
 }
 
 void
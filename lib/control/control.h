@@ -29,8 +29,21 @@
 
 typedef GString* (*CommandFunction)(GString *);
 
+/* A reply that is produced in multiple chunks, as the previous chunk was
+ * written to the control socket.  next_chunk() appends complete lines to
+ * @output and returns FALSE after appending the last chunk. */
+typedef struct _ControlReplyStream ControlReplyStream;
+struct _ControlReplyStream
+{
+  gboolean (*next_chunk)(ControlReplyStream *self, GString *output);
+  void (*free_fn)(ControlReplyStream *self);
+};
+
+typedef ControlReplyStream *(*StreamingCommandFunction)(GString *);
+
 void  control_init(const gchar *control_name);
 void control_destroy(void);
 void control_register_command(const gchar *command_name, const gchar *description, CommandFunction function);
+void control_register_streaming_command(const gchar *command_name, const gchar *description, StreamingCommandFunction function);
 
 #endif
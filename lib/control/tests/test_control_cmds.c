@@ -140,6 +140,55 @@ test_reset_stats()
   return;
 }
 
+void
+test_stats_query()
+{
+  GString *reply = NULL;
+  GString *command = g_string_sized_new(128);
+  StatsCounterItem *processed = NULL, *dropped = NULL, *other = NULL;
+
+  stats_init();
+  stats_lock();
+  stats_register_counter(0, SCS_SOURCE | SCS_FILE, "s_file", "/var/log/messages", SC_TYPE_PROCESSED, &processed);
+  stats_register_counter(0, SCS_SOURCE | SCS_FILE, "s_file", "/var/log/messages", SC_TYPE_DROPPED, &dropped);
+  stats_register_counter(0, SCS_DESTINATION | SCS_FILE, "d_file", "/var/log/messages", SC_TYPE_PROCESSED, &other);
+  stats_counter_set(processed, 10);
+  stats_unlock();
+
+  g_string_assign(command, "STATS QUERY src.file;s_file;*;processed");
+  reply = control_connection_send_stats(command);
+  assert_string(reply->str, "SourceName;SourceId;SourceInstance;State;Type;Number\n"
+                "src.file;s_file;/var/log/messages;a;processed;10\n", "Bad reply");
+  g_string_free(reply, TRUE);
+
+  g_string_assign(command, "STATS QUERY *;d_file");
+  reply = control_connection_send_stats(command);
+  assert_string(reply->str, "SourceName;SourceId;SourceInstance;State;Type;Number\n"
+                "dst.file;d_file;/var/log/messages;a;processed;0\n", "Bad reply");
+  g_string_free(reply, TRUE);
+
+  g_string_assign(command, "STATS QUERY src.file;s_file;*;processed agent");
+  reply = control_connection_send_stats(command);
+  assert_string(reply->str, "SourceName;SourceId;SourceInstance;State;Type;Number\n"
+                "src.file;s_file;/var/log/messages;a;processed;10\n", "First query of a session should report absolute values");
+  g_string_free(reply, TRUE);
+
+  stats_counter_add(processed, 5);
+  reply = control_connection_send_stats(command);
+  assert_string(reply->str, "SourceName;SourceId;SourceInstance;State;Type;Number\n"
+                "src.file;s_file;/var/log/messages;a;processed;5\n", "Subsequent queries should report deltas");
+  g_string_free(reply, TRUE);
+
+  g_string_assign(command, "STATS QUERY");
+  reply = control_connection_send_stats(command);
+  assert_string(reply->str, "Invalid arguments received", "Bad reply");
+  g_string_free(reply, TRUE);
+
+  g_string_free(command, TRUE);
+  stats_destroy();
+  return;
+}
+
 int
 main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
 {
@@ -147,5 +196,6 @@ main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
   test_log();
   test_stats();
   test_reset_stats();
+  test_stats_query();
   return 0;
 }
@@ -147,6 +147,47 @@ ControlCommand command = {
    .func = test_command
 };
 
+typedef struct _CountingReplyStream
+{
+  ControlReplyStream super;
+  gint chunks;
+} CountingReplyStream;
+
+static gboolean
+counting_reply_stream_next_chunk(ControlReplyStream *s, GString *output)
+{
+  CountingReplyStream *self = (CountingReplyStream *) s;
+
+  self->chunks++;
+  /* an empty chunk in the middle must not end the reply */
+  if (self->chunks != 2)
+    g_string_append_printf(output, "chunk %d\n", self->chunks);
+  return self->chunks < 4;
+}
+
+static void
+counting_reply_stream_free(ControlReplyStream *s)
+{
+  g_free(s);
+}
+
+ControlReplyStream *
+test_stream_command(GString *command)
+{
+  CountingReplyStream *self = g_new0(CountingReplyStream, 1);
+
+  assert_string(command->str, "stream", "Bad command handling");
+  self->super.next_chunk = counting_reply_stream_next_chunk;
+  self->super.free_fn = counting_reply_stream_free;
+  return &self->super;
+}
+
+ControlCommand stream_command = {
+   .command_name = "stream",
+   .description = NULL,
+   .stream_func = test_stream_command
+};
+
 void
 control_connection_update_watches(ControlConnection *s)
 {
@@ -193,10 +234,22 @@ test_control_connection(gsize transaction_size)
   assert_string(result_string->str, "OK\n.\n", "BAD Behaviour transaction_size: %d",transaction_size);
 }
 
+void
+test_control_connection_streaming_reply(gsize transaction_size)
+{
+  moc_connection = (ControlConnectionMoc *)control_connection_moc_new(&moc_server);
+  g_string_assign(moc_connection->source_buffer->buffer,"stream\n");
+  moc_connection->transaction_size = transaction_size;
+  control_connection_start_watches((ControlConnection *)moc_connection);
+  assert_string(result_string->str, "chunk 1\nchunk 3\nchunk 4\n.\n",
+                "BAD streaming behaviour transaction_size: %d", transaction_size);
+}
+
 int
 main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
 {
   GList *commands = g_list_append(NULL, &command);
+  commands = g_list_append(commands, &stream_command);
   moc_server.control_commands = commands;
   gsize  i = 0;
   
@@ -204,6 +257,7 @@ main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
   for (i = 0; i < 100; i++)
     {
       test_control_connection(i);
+      test_control_connection_streaming_reply(i);
     }
   app_shutdown();
   g_list_free(commands);
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "cpu-topology.h"
+#include "messages.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#define CPU_TOPOLOGY_MAX_CPUS  1024
+#define CPU_TOPOLOGY_MAX_NODES 64
+#define CPU_TOPOLOGY_SYSFS_NODE_DIR "/sys/devices/system/node"
+
+static gint cpu_topology_num_nodes = 1;
+static gint cpu_topology_num_cpus = 0;
+static gint8 cpu_topology_node_of_cpu[CPU_TOPOLOGY_MAX_CPUS];
+
+gint
+cpu_topology_get_num_nodes(void)
+{
+  return cpu_topology_num_nodes;
+}
+
+gint
+cpu_topology_get_node_of_cpu(gint cpu)
+{
+  if (cpu < 0 || cpu >= cpu_topology_num_cpus)
+    return 0;
+  return cpu_topology_node_of_cpu[cpu];
+}
+
+gint
+cpu_topology_get_current_node(void)
+{
+#ifdef SYSLOG_NG_HAVE_SCHED_GETCPU
+  if (cpu_topology_num_nodes == 1)
+    return 0;
+
+  return cpu_topology_get_node_of_cpu(sched_getcpu());
+#else
+  return 0;
+#endif
+}
+
+gboolean
+cpu_topology_bind_thread_to_node(gint node)
+{
+#ifdef SYSLOG_NG_HAVE_SCHED_SETAFFINITY
+  cpu_set_t cpus;
+  gint cpu;
+
+  CPU_ZERO(&cpus);
+  for (cpu = 0; cpu < cpu_topology_num_cpus && cpu < CPU_SETSIZE; cpu++)
+    {
+      if (cpu_topology_node_of_cpu[cpu] == node)
+        CPU_SET(cpu, &cpus);
+    }
+  if (CPU_COUNT(&cpus) == 0)
+    return FALSE;
+
+  return sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+#else
+  return FALSE;
+#endif
+}
+
+typedef void (*CpuListFunc)(gint cpu, gpointer user_data);
+
+/* parses the "0-15,32-47" format used by the cpulist files */
+static gboolean
+_cpu_list_foreach(const gchar *cpu_list, CpuListFunc func, gpointer user_data)
+{
+  const gchar *p = cpu_list;
+
+  if (!*p)
+    return FALSE;
+
+  while (*p && *p != '\n')
+    {
+      gchar *end;
+      glong first, last;
+
+      first = last = strtol(p, &end, 10);
+      if (end == p || first < 0)
+        return FALSE;
+      p = end;
+      if (*p == '-')
+        {
+          p++;
+          last = strtol(p, &end, 10);
+          if (end == p || last < first)
+            return FALSE;
+          p = end;
+        }
+      if (*p == ',')
+        p++;
+      else if (*p && *p != '\n')
+        return FALSE;
+
+      for (; first <= last && first < CPU_TOPOLOGY_MAX_CPUS; first++)
+        func(first, user_data);
+    }
+  return TRUE;
+}
+
+static void
+_set_node_of_cpu(gint cpu, gpointer user_data)
+{
+  cpu_topology_node_of_cpu[cpu] = GPOINTER_TO_INT(user_data);
+  cpu_topology_num_cpus = MAX(cpu_topology_num_cpus, cpu + 1);
+}
+
+gboolean
+cpu_topology_parse_cpu_list(const gchar *cpu_list, gint node)
+{
+  if (node < 0 || node >= CPU_TOPOLOGY_MAX_NODES)
+    return FALSE;
+
+  if (!_cpu_list_foreach(cpu_list, _set_node_of_cpu, GINT_TO_POINTER(node)))
+    return FALSE;
+  cpu_topology_num_nodes = MAX(cpu_topology_num_nodes, node + 1);
+  return TRUE;
+}
+
+static void
+_ignore_cpu(gint cpu, gpointer user_data)
+{
+}
+
+gboolean
+cpu_topology_validate_cpu_list(const gchar *cpu_list)
+{
+  return _cpu_list_foreach(cpu_list, _ignore_cpu, NULL);
+}
+
+#ifdef SYSLOG_NG_HAVE_SCHED_SETAFFINITY
+static void
+_add_cpu_to_set(gint cpu, gpointer user_data)
+{
+  cpu_set_t *cpus = (cpu_set_t *) user_data;
+
+  if (cpu < CPU_SETSIZE)
+    CPU_SET(cpu, cpus);
+}
+#endif
+
+gboolean
+cpu_topology_bind_thread_to_cpu_list(const gchar *cpu_list)
+{
+#ifdef SYSLOG_NG_HAVE_SCHED_SETAFFINITY
+  cpu_set_t cpus;
+
+  CPU_ZERO(&cpus);
+  if (!_cpu_list_foreach(cpu_list, _add_cpu_to_set, &cpus) || CPU_COUNT(&cpus) == 0)
+    return FALSE;
+
+  return sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+#else
+  return FALSE;
+#endif
+}
+
+void
+cpu_topology_global_init(void)
+{
+  gint node;
+
+  cpu_topology_num_nodes = 1;
+  cpu_topology_num_cpus = 0;
+  memset(cpu_topology_node_of_cpu, 0, sizeof(cpu_topology_node_of_cpu));
+
+  for (node = 0; node < CPU_TOPOLOGY_MAX_NODES; node++)
+    {
+      gchar *filename = g_strdup_printf(CPU_TOPOLOGY_SYSFS_NODE_DIR "/node%d/cpulist", node);
+      gchar *cpu_list = NULL;
+
+      if (!g_file_get_contents(filename, &cpu_list, NULL, NULL))
+        {
+          g_free(filename);
+          break;
+        }
+      if (!cpu_topology_parse_cpu_list(cpu_list, node))
+        msg_debug("Error parsing NUMA node CPU list, ignoring",
+                  evt_tag_str("filename", filename),
+                  evt_tag_str("cpulist", cpu_list),
+                  NULL);
+      g_free(cpu_list);
+      g_free(filename);
+    }
+
+  msg_debug("CPU topology detected",
+            evt_tag_int("nodes", cpu_topology_num_nodes),
+            evt_tag_int("cpus", cpu_topology_num_cpus),
+            NULL);
+}
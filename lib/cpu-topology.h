@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef CPU_TOPOLOGY_H_INCLUDED
+#define CPU_TOPOLOGY_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/*
+ * NUMA node information as exported by the kernel in
+ * /sys/devices/system/node.  On systems where this is not available,
+ * every CPU is reported to be on node 0.
+ */
+
+gint cpu_topology_get_num_nodes(void);
+gint cpu_topology_get_node_of_cpu(gint cpu);
+gint cpu_topology_get_current_node(void);
+gboolean cpu_topology_bind_thread_to_node(gint node);
+gboolean cpu_topology_bind_thread_to_cpu_list(const gchar *cpu_list);
+
+gboolean cpu_topology_validate_cpu_list(const gchar *cpu_list);
+
+gboolean cpu_topology_parse_cpu_list(const gchar *cpu_list, gint node);
+
+void cpu_topology_global_init(void);
+
+#endif
@@ -24,6 +24,7 @@
 
 #include "debugger/debugger.h"
 #include "logpipe.h"
+#include "cfg.h"
 
 static Debugger *current_debugger;
 
@@ -38,6 +39,8 @@ debugger_start(GlobalConfig *cfg)
 {
   /* we don't support threaded mode (yet), force it to non-threaded */
   cfg->threaded = FALSE;
+  /* all values are displayed, parsers shouldn't skip any of them */
+  cfg_reference_all_values(cfg);
   current_debugger = debugger_new(cfg);
   pipe_single_step_hook = _pipe_hook;
   debugger_start_console(current_debugger);
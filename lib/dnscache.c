@@ -84,6 +84,33 @@ TLS_BLOCK_END;
 #define cache_hosts_mtime __tls_deref(cache_hosts_mtime)
 #define cache_hosts_checktime __tls_deref(cache_hosts_checktime)
 
+/*
+ * Lookups are stored in a cache shared by all threads, split into shards
+ * by the hash of the address to keep lock contention low.  The shards
+ * together hold dns_cache_size entries, evicting the least recently used
+ * ones.  A name resolved by one thread (or by the background resolver in
+ * host-resolve.c) is available to the others.
+ *
+ * In front of that, each thread keeps the most recently used entries of
+ * its own (and the persistent ones from the hosts file), this needs no
+ * locking on hits, but is small, to avoid keeping N copies of the cache.
+ * Entries expire the same way in both.
+ */
+#define DNS_CACHE_SHARDS 16
+#define DNS_CACHE_LOCAL_MAX_SIZE 256
+
+typedef struct _DNSCacheShard
+{
+  GStaticMutex lock;
+  GHashTable *cache;
+  DNSCacheEntry cache_first;
+  DNSCacheEntry cache_last;
+  /* keys with a resolution in progress */
+  GHashTable *pending;
+} DNSCacheShard;
+
+static DNSCacheShard dns_cache_shards[DNS_CACHE_SHARDS];
+
 static gint dns_cache_size = 1007;
 static gint dns_cache_expire = 3600;
 static gint dns_cache_expire_failed = 60;
@@ -135,6 +162,14 @@ dns_cache_entry_insert_before(DNSCacheEntry *elem, DNSCacheEntry *new_elem)
   elem->prev = new_elem;
 }
 
+static inline void
+dns_cache_entry_move_before(DNSCacheEntry *elem, DNSCacheEntry *e)
+{
+  e->prev->next = e->next;
+  e->next->prev = e->prev;
+  dns_cache_entry_insert_before(elem, e);
+}
+
 static void
 dns_cache_entry_free(DNSCacheEntry *e)
 {
@@ -253,6 +288,124 @@ dns_cache_check_hosts(glong t)
     }
 }
 
+static inline gboolean
+dns_cache_entry_is_expired(DNSCacheEntry *entry, time_t now)
+{
+  return entry->resolved &&
+         ((entry->positive && entry->resolved < now - dns_cache_expire) ||
+          (!entry->positive && entry->resolved < now - dns_cache_expire_failed));
+}
+
+static DNSCacheEntry *
+dns_cache_entry_new(DNSCacheKey *key, const gchar *hostname, gboolean positive, time_t resolved)
+{
+  DNSCacheEntry *entry = g_new(DNSCacheEntry, 1);
+
+  entry->key = *key;
+  entry->hostname = g_strdup(hostname);
+  entry->hostname_len = strlen(hostname);
+  entry->positive = positive;
+  entry->resolved = resolved;
+  return entry;
+}
+
+static inline DNSCacheShard *
+dns_cache_get_shard(DNSCacheKey *key)
+{
+  /* the hash of IPv4 addresses is the address itself, mix it so that a
+   * subnet is spread over all shards */
+  return &dns_cache_shards[((dns_cache_key_hash(key) * 2654435761U) >> 16) % DNS_CACHE_SHARDS];
+}
+
+static void dns_cache_store_local(DNSCacheKey *key, const gchar *hostname, gboolean positive, time_t resolved);
+
+/* copies a valid entry of the shared cache to the per-thread one */
+static DNSCacheEntry *
+dns_cache_lookup_shared(DNSCacheKey *key, time_t now)
+{
+  DNSCacheShard *shard = dns_cache_get_shard(key);
+  DNSCacheEntry *entry;
+  gchar *hostname = NULL;
+  gboolean positive = FALSE;
+  time_t resolved = 0;
+
+  g_static_mutex_lock(&shard->lock);
+  entry = g_hash_table_lookup(shard->cache, key);
+  if (entry && !dns_cache_entry_is_expired(entry, now))
+    {
+      dns_cache_entry_move_before(&shard->cache_last, entry);
+      hostname = g_strdup(entry->hostname);
+      positive = entry->positive;
+      resolved = entry->resolved;
+    }
+  g_static_mutex_unlock(&shard->lock);
+
+  if (!hostname)
+    return NULL;
+
+  /* keep the original resolution time, so the entry expires at the same time everywhere */
+  dns_cache_store_local(key, hostname, positive, resolved);
+  g_free(hostname);
+  return g_hash_table_lookup(cache, key);
+}
+
+static void
+dns_cache_store_shared(DNSCacheKey *key, const gchar *hostname, gboolean positive, time_t resolved)
+{
+  DNSCacheShard *shard = dns_cache_get_shard(key);
+  DNSCacheEntry *entry = dns_cache_entry_new(key, hostname, positive, resolved);
+
+  g_static_mutex_lock(&shard->lock);
+  dns_cache_entry_insert_before(&shard->cache_last, entry);
+  g_hash_table_replace(shard->cache, &entry->key, entry);
+  if (g_hash_table_size(shard->cache) > dns_cache_size / DNS_CACHE_SHARDS + 1)
+    g_hash_table_remove(shard->cache, &shard->cache_first.next->key);
+  g_static_mutex_unlock(&shard->lock);
+}
+
+/*
+ * Marks @addr as being resolved, returns FALSE if that was already the
+ * case, so that only one resolution is started for the same address.
+ */
+gboolean
+dns_cache_start_resolution(gint family, void *addr)
+{
+  DNSCacheKey key;
+  DNSCacheShard *shard;
+  gboolean started = FALSE;
+
+  dns_cache_fill_key(&key, family, addr);
+  shard = dns_cache_get_shard(&key);
+
+  g_static_mutex_lock(&shard->lock);
+  if (!g_hash_table_lookup(shard->pending, &key))
+    {
+      DNSCacheKey *pending_key = g_new(DNSCacheKey, 1);
+
+      *pending_key = key;
+      g_hash_table_insert(shard->pending, pending_key, pending_key);
+      started = TRUE;
+    }
+  g_static_mutex_unlock(&shard->lock);
+  return started;
+}
+
+/* stores the result of a resolution started by dns_cache_start_resolution() */
+void
+dns_cache_finish_resolution(gint family, void *addr, const gchar *hostname, gboolean positive)
+{
+  DNSCacheKey key;
+  DNSCacheShard *shard;
+
+  dns_cache_fill_key(&key, family, addr);
+  dns_cache_store_shared(&key, hostname, positive, cached_g_current_time_sec());
+
+  shard = dns_cache_get_shard(&key);
+  g_static_mutex_lock(&shard->lock);
+  g_hash_table_remove(shard->pending, &key);
+  g_static_mutex_unlock(&shard->lock);
+}
+
 /*
  * @hostname        is set to the stored hostname,
  * @positive        is set whether the match was a DNS match or failure
@@ -272,49 +425,41 @@ dns_cache_lookup(gint family, void *addr, const gchar **hostname, gsize *hostnam
 
   dns_cache_fill_key(&key, family, addr);
   entry = g_hash_table_lookup(cache, &key);
+  if (!entry || dns_cache_entry_is_expired(entry, now))
+    {
+      /* not present or the entry is not persistent and is too old */
+      entry = dns_cache_lookup_shared(&key, now);
+    }
+  else if (entry->resolved)
+    {
+      dns_cache_entry_move_before(&cache_last, entry);
+    }
+
   if (entry)
     {
-      if (entry->resolved &&
-          ((entry->positive && entry->resolved < now - dns_cache_expire) ||
-           (!entry->positive && entry->resolved < now - dns_cache_expire_failed)))
-        {
-          /* the entry is not persistent and is too old */
-        }
-      else
-        {
-          *hostname = entry->hostname;
-          *hostname_len = entry->hostname_len;
-          *positive = entry->positive;
-          return TRUE;
-        }
+      *hostname = entry->hostname;
+      *hostname_len = entry->hostname_len;
+      *positive = entry->positive;
+      return TRUE;
     }
   *hostname = NULL;
   *positive = FALSE;
   return FALSE;
 }
 
+/* @resolved is 0 for persistent entries */
 static void
-dns_cache_store(gboolean persistent, gint family, void *addr, const gchar *hostname, gboolean positive)
+dns_cache_store_local(DNSCacheKey *key, const gchar *hostname, gboolean positive, time_t resolved)
 {
   DNSCacheEntry *entry;
+  gboolean persistent = (resolved == 0);
   guint hash_size;
 
-  entry = g_new(DNSCacheEntry, 1);
-
-  dns_cache_fill_key(&entry->key, family, addr);
-  entry->hostname = g_strdup(hostname);
-  entry->hostname_len = strlen(hostname);
-  entry->positive = positive;
+  entry = dns_cache_entry_new(key, hostname, positive, resolved);
   if (!persistent)
-    {
-      entry->resolved = cached_g_current_time_sec();
-      dns_cache_entry_insert_before(&cache_last, entry);
-    }
+    dns_cache_entry_insert_before(&cache_last, entry);
   else
-    {
-      entry->resolved = 0;
-      dns_cache_entry_insert_before(&persist_last, entry);
-    }
+    dns_cache_entry_insert_before(&persist_last, entry);
   hash_size = g_hash_table_size(cache);
   g_hash_table_replace(cache, &entry->key, entry);
 
@@ -322,7 +467,7 @@ dns_cache_store(gboolean persistent, gint family, void *addr, const gchar *hostn
     dns_cache_persistent_count++;
 
   /* persistent elements are not counted */
-  if ((gint) (g_hash_table_size(cache) - dns_cache_persistent_count) > dns_cache_size)
+  if ((gint) (g_hash_table_size(cache) - dns_cache_persistent_count) > MIN(dns_cache_size, DNS_CACHE_LOCAL_MAX_SIZE))
     {
       /* remove oldest element */
       g_hash_table_remove(cache, &cache_first.next->key);
@@ -332,13 +477,21 @@ dns_cache_store(gboolean persistent, gint family, void *addr, const gchar *hostn
 void
 dns_cache_store_persistent(gint family, void *addr, const gchar *hostname)
 {
-  dns_cache_store(TRUE, family, addr, hostname, TRUE);
+  DNSCacheKey key;
+
+  dns_cache_fill_key(&key, family, addr);
+  dns_cache_store_local(&key, hostname, TRUE, 0);
 }
 
 void
 dns_cache_store_dynamic(gint family, void *addr, const gchar *hostname, gboolean positive)
 {
-  dns_cache_store(FALSE, family, addr, hostname, positive);
+  DNSCacheKey key;
+  time_t now = cached_g_current_time_sec();
+
+  dns_cache_fill_key(&key, family, addr);
+  dns_cache_store_local(&key, hostname, positive, now);
+  dns_cache_store_shared(&key, hostname, positive, now);
 }
 
 void
@@ -382,15 +535,42 @@ dns_cache_thread_deinit(void)
 void
 dns_cache_global_init(void)
 {
+  gint i;
+
   dns_cache_size = 1007;
   dns_cache_expire = 3600;
   dns_cache_expire_failed = 60;
   dns_cache_persistent_count = 0;
+
+  for (i = 0; i < DNS_CACHE_SHARDS; i++)
+    {
+      DNSCacheShard *shard = &dns_cache_shards[i];
+
+      g_static_mutex_init(&shard->lock);
+      shard->cache = g_hash_table_new_full((GHashFunc) dns_cache_key_hash, (GEqualFunc) dns_cache_key_equal, NULL, (GDestroyNotify) dns_cache_entry_free);
+      shard->cache_first.next = &shard->cache_last;
+      shard->cache_first.prev = NULL;
+      shard->cache_last.prev = &shard->cache_first;
+      shard->cache_last.next = NULL;
+      shard->pending = g_hash_table_new_full((GHashFunc) dns_cache_key_hash, (GEqualFunc) dns_cache_key_equal, g_free, NULL);
+    }
 }
 
 void
 dns_cache_global_deinit(void)
 {
+  gint i;
+
+  for (i = 0; i < DNS_CACHE_SHARDS; i++)
+    {
+      DNSCacheShard *shard = &dns_cache_shards[i];
+
+      g_hash_table_destroy(shard->cache);
+      g_hash_table_destroy(shard->pending);
+      shard->cache = shard->pending = NULL;
+      g_static_mutex_free(&shard->lock);
+    }
+
   if (dns_cache_hosts)
     g_free(dns_cache_hosts);
   dns_cache_hosts = NULL;
@@ -33,6 +33,9 @@ gboolean dns_cache_lookup(gint family, void *addr, const gchar **hostname, gsize
 void dns_cache_store_persistent(gint family, void *addr, const gchar *hostname);
 void dns_cache_store_dynamic(gint family, void *addr, const gchar *hostname, gboolean positive);
 
+gboolean dns_cache_start_resolution(gint family, void *addr);
+void dns_cache_finish_resolution(gint family, void *addr, const gchar *hostname, gboolean positive);
+
 void dns_cache_set_params(gint cache_size, gint expire, gint expire_failed, const gchar *hosts);
 
 void dns_cache_thread_init(void);
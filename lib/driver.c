@@ -202,8 +202,21 @@ log_dest_driver_acquire_queue_method(LogDestDriver *self, gchar *persist_name, g
 
   if (!queue)
     {
-      queue = log_queue_fifo_new(self->log_fifo_size < 0 ? cfg->log_fifo_size : self->log_fifo_size, persist_name);
+      gint log_fifo_size = self->log_fifo_size < 0 ? cfg->log_fifo_size : self->log_fifo_size;
+      gboolean log_fifo_lockless = self->log_fifo_lockless < 0 ? cfg->log_fifo_lockless : self->log_fifo_lockless;
+      gboolean log_fifo_numa = self->log_fifo_numa < 0 ? cfg->log_fifo_numa : self->log_fifo_numa;
+
+      if (log_fifo_numa)
+        queue = log_queue_fifo_new_numa(log_fifo_size, persist_name);
+      else if (log_fifo_lockless)
+        queue = log_queue_fifo_new_lockless(log_fifo_size, persist_name);
+      else
+        queue = log_queue_fifo_new(log_fifo_size, persist_name);
+      if (self->log_fifo_lanes > 1)
+        log_queue_fifo_set_lanes(queue, self->log_fifo_lanes, self->log_fifo_weighted_lanes);
+      log_queue_set_memory_limit(queue, self->log_fifo_bytes);
       log_queue_set_throttle(queue, self->throttle);
+      log_queue_set_flow_control_budget(queue, self->flow_control_budget);
     }
   return queue;
 }
@@ -297,7 +310,13 @@ log_dest_driver_init_instance(LogDestDriver *self, GlobalConfig *cfg)
   self->acquire_queue = log_dest_driver_acquire_queue_method;
   self->release_queue = log_dest_driver_release_queue_method;
   self->log_fifo_size = -1;
+  self->log_fifo_lockless = -1;
+  self->log_fifo_numa = -1;
+  self->log_fifo_lanes = 1;
+  self->log_fifo_weighted_lanes = FALSE;
+  self->log_fifo_bytes = 0;
   self->throttle = 0;
+  self->flow_control_budget = 0;
 }
 
 void
@@ -160,7 +160,16 @@ struct _LogDestDriver
   GList *queues;
 
   gint log_fifo_size;
+  /* -1 means to use the global setting */
+  gint log_fifo_lockless;
+  gint log_fifo_numa;
+  /* priority lanes, see log_queue_fifo_set_lanes() */
+  gint log_fifo_lanes;
+  gboolean log_fifo_weighted_lanes;
+  /* byte limit of the queue, 0 means unlimited */
+  gint64 log_fifo_bytes;
   gint throttle;
+  gint flow_control_budget;
   StatsCounterItem *queued_global_messages;
 };
 
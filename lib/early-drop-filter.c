@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "early-drop-filter.h"
+
+#include <string.h>
+
+typedef struct _EarlyDropLiteral
+{
+  gchar *str;
+  gsize len;
+} EarlyDropLiteral;
+
+static void
+_add_literals(GArray *array, GList *literals)
+{
+  GList *l;
+
+  for (l = literals; l; l = l->next)
+    {
+      EarlyDropLiteral literal;
+
+      literal.str = (gchar *) l->data;
+      literal.len = strlen(literal.str);
+      if (literal.len > 0)
+        g_array_append_val(array, literal);
+      else
+        g_free(literal.str);
+    }
+  g_list_free(literals);
+}
+
+static void
+_free_literals(GArray *array)
+{
+  gint i;
+
+  for (i = 0; i < array->len; i++)
+    g_free(g_array_index(array, EarlyDropLiteral, i).str);
+  g_array_free(array, TRUE);
+}
+
+/* takes ownership of the list and the strings in it */
+void
+early_drop_filter_add_prefixes(EarlyDropFilter *self, GList *prefixes)
+{
+  _add_literals(self->prefixes, prefixes);
+}
+
+/* takes ownership of the list and the strings in it */
+void
+early_drop_filter_add_literals(EarlyDropFilter *self, GList *literals)
+{
+  _add_literals(self->literals, literals);
+}
+
+/* skips the "<PRI>" part of the line, if there's one */
+static gint
+_extract_pri(const guchar **line, gsize *length)
+{
+  const guchar *p = *line;
+  const guchar *end = p + MIN(*length, 5);
+  gint pri = 0;
+
+  if (p == end || *p != '<')
+    return -1;
+
+  for (p++; p < end && g_ascii_isdigit(*p); p++)
+    pri = pri * 10 + (*p - '0');
+
+  if (p == end || *p != '>' || p == *line + 1 || pri > 191)
+    return -1;
+
+  p++;
+  *length -= p - *line;
+  *line = p;
+  return pri;
+}
+
+static gboolean
+_has_prefix(GArray *prefixes, const guchar *line, gsize length)
+{
+  gint i;
+
+  for (i = 0; i < prefixes->len; i++)
+    {
+      EarlyDropLiteral *prefix = &g_array_index(prefixes, EarlyDropLiteral, i);
+
+      if (prefix->len <= length && memcmp(line, prefix->str, prefix->len) == 0)
+        return TRUE;
+    }
+  return FALSE;
+}
+
+static gboolean
+_contains_literal(EarlyDropLiteral *literal, const guchar *line, gsize length)
+{
+  const guchar *p, *last;
+
+  if (literal->len > length)
+    return FALSE;
+
+  p = line;
+  last = line + length - literal->len;
+  while (p <= last && (p = memchr(p, literal->str[0], last - p + 1)) != NULL)
+    {
+      if (memcmp(p, literal->str, literal->len) == 0)
+        return TRUE;
+      p++;
+    }
+  return FALSE;
+}
+
+static gboolean
+_has_literal(GArray *literals, const guchar *line, gsize length)
+{
+  gint i;
+
+  for (i = 0; i < literals->len; i++)
+    {
+      if (_contains_literal(&g_array_index(literals, EarlyDropLiteral, i), line, length))
+        return TRUE;
+    }
+  return FALSE;
+}
+
+gboolean
+early_drop_filter_evaluate(EarlyDropFilter *self, const guchar *line, gsize length,
+                           gboolean parse_pri, guint16 default_pri)
+{
+  gint pri = -1;
+
+  if (parse_pri)
+    pri = _extract_pri(&line, &length);
+  if (pri < 0)
+    pri = default_pri;
+
+  if (self->facility_mask & (1 << (pri >> 3)))
+    return TRUE;
+  if (self->level_mask & (1 << (pri & 7)))
+    return TRUE;
+
+  return _has_prefix(self->prefixes, line, length) ||
+         _has_literal(self->literals, line, length);
+}
+
+void
+early_drop_filter_init(EarlyDropFilter *self)
+{
+  self->facility_mask = 0;
+  self->level_mask = 0;
+  self->prefixes = g_array_new(FALSE, FALSE, sizeof(EarlyDropLiteral));
+  self->literals = g_array_new(FALSE, FALSE, sizeof(EarlyDropLiteral));
+}
+
+void
+early_drop_filter_destroy(EarlyDropFilter *self)
+{
+  if (self->prefixes)
+    _free_literals(self->prefixes);
+  if (self->literals)
+    _free_literals(self->literals);
+  self->prefixes = NULL;
+  self->literals = NULL;
+}
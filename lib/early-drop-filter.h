@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef EARLY_DROP_FILTER_H_INCLUDED
+#define EARLY_DROP_FILTER_H_INCLUDED 1
+
+#include "syslog-ng.h"
+
+/*
+ * Filters evaluated by LogReader on the raw line, before a LogMessage is
+ * allocated and parsed: messages matching any of the conditions are
+ * discarded right away.
+ */
+typedef struct _EarlyDropFilter
+{
+  /* one bit per facility code (pri >> 3) and per level (pri & 7) */
+  guint32 facility_mask;
+  guint32 level_mask;
+  /* literals matched at the start of the line (after the PRI), or anywhere in it */
+  GArray *prefixes;
+  GArray *literals;
+} EarlyDropFilter;
+
+void early_drop_filter_init(EarlyDropFilter *self);
+void early_drop_filter_destroy(EarlyDropFilter *self);
+void early_drop_filter_add_prefixes(EarlyDropFilter *self, GList *prefixes);
+void early_drop_filter_add_literals(EarlyDropFilter *self, GList *literals);
+
+gboolean early_drop_filter_evaluate(EarlyDropFilter *self, const guchar *line, gsize length,
+                                    gboolean parse_pri, guint16 default_pri);
+
+static inline gboolean
+early_drop_filter_is_enabled(EarlyDropFilter *self)
+{
+  return self->facility_mask || self->level_mask || self->prefixes->len || self->literals->len;
+}
+
+/* returns TRUE if the line should be dropped */
+static inline gboolean
+early_drop_filter_matches(EarlyDropFilter *self, const guchar *line, gsize length,
+                          gboolean parse_pri, guint16 default_pri)
+{
+  if (G_LIKELY(!early_drop_filter_is_enabled(self)))
+    return FALSE;
+  return early_drop_filter_evaluate(self, line, length, parse_pri, default_pri);
+}
+
+#endif
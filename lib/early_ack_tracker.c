@@ -48,6 +48,7 @@ early_ack_tracker_request_bookmark(AckTracker *s)
   return &(self->ack_record_storage.bookmark);
 }
 
+/* the acknowledgements are handled by log_source_msg_ack_early() */
 static void
 early_ack_tracker_track_msg(AckTracker *s, LogMessage *msg)
 {
@@ -56,20 +57,6 @@ early_ack_tracker_track_msg(AckTracker *s, LogMessage *msg)
   msg->ack_record = (AckRecord *)(&self->ack_record_storage);
 }
 
-static void
-early_ack_tracker_manage_msg_ack(AckTracker *s, LogMessage *msg, AckType ack_type)
-{
-  EarlyAckTracker *self = (EarlyAckTracker *)s;
-
-  if (ack_type == AT_SUSPENDED)
-    log_source_flow_control_suspend(self->super.source);
-  else
-    log_source_flow_control_adjust(self->super.source, 1);
-
-  log_msg_unref(msg);
-  log_pipe_unref((LogPipe *)self->super.source);
-}
-
 static void
 early_ack_tracker_init_instance(EarlyAckTracker *self, LogSource *source)
 {
@@ -78,7 +65,6 @@ early_ack_tracker_init_instance(EarlyAckTracker *self, LogSource *source)
   source->ack_tracker = (AckTracker *)self;
   self->super.request_bookmark = early_ack_tracker_request_bookmark;
   self->super.track_msg = early_ack_tracker_track_msg;
-  self->super.manage_msg_ack = early_ack_tracker_manage_msg_ack;
   self->ack_record_storage.super.tracker = (AckTracker *)self;
 }
 
@@ -25,6 +25,8 @@
 #include "cfg.h"
 #include "filter-pipe.h"
 
+#include <string.h>
+
 typedef struct _FilterCall
 {
   FilterExprNode super;
@@ -50,6 +52,34 @@ filter_call_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
     }
 }
 
+static void
+filter_call_eval_batch(FilterExprNode *s, LogMessage **msgs, gint num_msg, guint32 *selection)
+{
+  FilterCall *self = (FilterCall *) s;
+  gint i;
+
+  if (s->comp)
+    {
+      /* an unreferenced filter() matches everything when negated */
+      if (self->filter_expr)
+        {
+          for (i = 0; i < num_msg; i++)
+            {
+              if (filter_selection_is_set(selection, i) && !filter_call_eval(s, &msgs[i], 1))
+                filter_selection_clear(selection, i);
+            }
+        }
+    }
+  else if (self->filter_expr)
+    {
+      filter_expr_eval_batch(self->filter_expr, msgs, num_msg, selection);
+    }
+  else
+    {
+      memset(selection, 0, FILTER_SELECTION_WORDS(num_msg) * sizeof(guint32));
+    }
+}
+
 static void
 filter_call_init(FilterExprNode *s, GlobalConfig *cfg)
 {
@@ -69,6 +99,7 @@ filter_call_init(FilterExprNode *s, GlobalConfig *cfg)
       self->filter_expr = filter_expr_ref(filter_pipe->expr);
       filter_expr_init(self->filter_expr, cfg);
       self->super.modify = self->filter_expr->modify;
+      self->super.cost = self->filter_expr->cost;
     }
   else
     {
@@ -78,6 +109,20 @@ filter_call_init(FilterExprNode *s, GlobalConfig *cfg)
     }
 }
 
+/*
+ * Returns the expression a non-negated filter() stands for, so that it
+ * can be inlined by the and/or operators.  Only valid after init.
+ */
+FilterExprNode *
+filter_call_get_expr(FilterExprNode *s)
+{
+  FilterCall *self = (FilterCall *) s;
+
+  if (s->eval != filter_call_eval || s->comp)
+    return NULL;
+  return self->filter_expr;
+}
+
 static void
 filter_call_free(FilterExprNode *s)
 {
@@ -96,6 +141,7 @@ filter_call_new(gchar *rule, GlobalConfig *cfg)
   filter_expr_node_init_instance(&self->super);
   self->super.init = filter_call_init;
   self->super.eval = filter_call_eval;
+  self->super.eval_batch = filter_call_eval_batch;
   self->super.free_fn = filter_call_free;
   self->super.type = g_strdup_printf("filter(%s)", rule);
   self->rule = g_strdup(rule);
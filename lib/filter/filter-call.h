@@ -28,5 +28,6 @@
 #include "filter-expr.h"
 
 FilterExprNode *filter_call_new(gchar *rule, struct _GlobalConfig *cfg);
+FilterExprNode *filter_call_get_expr(FilterExprNode *s);
 
 #endif
@@ -25,6 +25,7 @@
 #include "filter/filter-cmp.h"
 #include "filter/filter-expr-grammar.h"
 #include "scratch-buffers.h"
+#include "template/macros.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -34,31 +35,196 @@
 #define FCMP_GT  0x0004
 #define FCMP_NUM 0x0010
 
+/*
+ * Operands are classified when the filter is constructed, so that the
+ * common cases can avoid formatting the templates for every message:
+ *
+ *   - literals (e.g. "1000000") are formatted and parsed only once
+ *   - single name-value pairs (e.g. "${bytes}") are used directly from
+ *     the message payload
+ *   - single numeric macros (e.g. "$LEVEL_NUM") are expanded to a number
+ *     without a format-then-parse roundtrip
+ *
+ * Everything else is formatted as before.
+ */
+enum
+{
+  FCMP_OPERAND_TEMPLATE,
+  FCMP_OPERAND_CONSTANT,
+  FCMP_OPERAND_VALUE,
+  FCMP_OPERAND_MACRO,
+};
+
+typedef struct _FilterCmpOperand
+{
+  LogTemplate *template;
+  gint kind;
+  NVHandle value_handle;
+  /* FCMP_OPERAND_CONSTANT */
+  GString *constant;
+  gint64 number;
+} FilterCmpOperand;
+
 typedef struct _FilterCmp
 {
   FilterExprNode super;
-  LogTemplate *left, *right;
+  FilterCmpOperand left, right;
   gint cmp_op;
 } FilterCmp;
 
+/* atoi() compatible, but bounded by @len and saturating instead of overflowing */
+static gint64
+fop_cmp_parse_number(const gchar *value, gssize len)
+{
+  const gchar *p = value, *end = value + len;
+  gboolean negative = FALSE;
+  guint64 limit, result = 0;
+
+  while (p < end && g_ascii_isspace(*p))
+    p++;
+  if (p < end && (*p == '-' || *p == '+'))
+    {
+      negative = (*p == '-');
+      p++;
+    }
+
+  limit = negative ? (guint64) G_MAXINT64 + 1 : (guint64) G_MAXINT64;
+  for (; p < end && g_ascii_isdigit(*p); p++)
+    {
+      guint digit = *p - '0';
+
+      if (result > (limit - digit) / 10)
+        result = limit;
+      else
+        result = result * 10 + digit;
+    }
+
+  if (!negative)
+    return (gint64) result;
+  if (result == limit)
+    return G_MININT64;
+  return -(gint64) result;
+}
+
+/* strcmp() compatible comparison of two length-delimited strings */
+static gint
+fop_cmp_compare_strings(const gchar *left, gssize left_len, const gchar *right, gssize right_len)
+{
+  const gchar *nul;
+  gint cmp;
+
+  if ((nul = memchr(left, 0, left_len)))
+    left_len = nul - left;
+  if ((nul = memchr(right, 0, right_len)))
+    right_len = nul - right;
+
+  cmp = memcmp(left, right, MIN(left_len, right_len));
+  if (cmp != 0)
+    return cmp;
+  if (left_len == right_len)
+    return 0;
+  return left_len < right_len ? -1 : 1;
+}
+
+static void
+fop_cmp_operand_init(FilterCmpOperand *self, LogTemplate *template)
+{
+  self->template = template;
+
+  if (log_template_is_literal_string(template))
+    {
+      LogMessage *msg = log_msg_new_empty();
+
+      self->kind = FCMP_OPERAND_CONSTANT;
+      self->constant = g_string_sized_new(16);
+      log_template_format(template, msg, NULL, LTZ_LOCAL, 0, NULL, self->constant);
+      self->number = fop_cmp_parse_number(self->constant->str, self->constant->len);
+      log_msg_unref(msg);
+    }
+  else if ((self->value_handle = log_template_get_single_value_handle(template)))
+    {
+      self->kind = FCMP_OPERAND_VALUE;
+    }
+  else if (template->single_macro != M_NONE)
+    {
+      self->kind = FCMP_OPERAND_MACRO;
+    }
+  else
+    {
+      self->kind = FCMP_OPERAND_TEMPLATE;
+    }
+}
+
+static void
+fop_cmp_operand_deinit(FilterCmpOperand *self)
+{
+  if (self->constant)
+    g_string_free(self->constant, TRUE);
+  log_template_unref(self->template);
+}
+
+static const gchar *
+fop_cmp_operand_get_string(FilterCmpOperand *self, LogMessage **msgs, gint num_msg, gssize *len)
+{
+  const gchar *value;
+  GString *result;
+
+  switch (self->kind)
+    {
+    case FCMP_OPERAND_CONSTANT:
+      *len = self->constant->len;
+      return self->constant->str;
+
+    case FCMP_OPERAND_VALUE:
+      /* single value templates always use the last message, just like
+       * log_template_format_with_context() does */
+      value = log_msg_get_value(msgs[num_msg - 1], self->value_handle, len);
+      if (!value)
+        {
+          *len = 0;
+          return "";
+        }
+      return value;
+
+    default:
+      result = scratch_arena_gstring();
+      log_template_format_with_context(self->template, msgs, num_msg, NULL, LTZ_LOCAL, 0, NULL, result);
+      *len = result->len;
+      return result->str;
+    }
+}
+
+static gint64
+fop_cmp_operand_get_number(FilterCmpOperand *self, LogMessage **msgs, gint num_msg)
+{
+  const gchar *value;
+  gssize len;
+  gint64 number;
+
+  if (self->kind == FCMP_OPERAND_CONSTANT)
+    return self->number;
+
+  if (self->kind == FCMP_OPERAND_MACRO &&
+      log_template_format_int64(self->template, msgs[num_msg - 1], NULL, 0, &number))
+    return number;
+
+  value = fop_cmp_operand_get_string(self, msgs, num_msg, &len);
+  return fop_cmp_parse_number(value, len);
+}
+
 gboolean
 fop_cmp_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
 {
   FilterCmp *self = (FilterCmp *) s;
-  SBGString *left_buf = sb_gstring_acquire();
-  SBGString *right_buf = sb_gstring_acquire();
   gboolean result = FALSE;
   gint cmp;
 
-  log_template_format_with_context(self->left, msgs, num_msg, NULL, LTZ_LOCAL, 0, NULL, sb_gstring_string(left_buf));
-  log_template_format_with_context(self->right, msgs, num_msg, NULL, LTZ_LOCAL, 0, NULL, sb_gstring_string(right_buf));
-
   if (self->cmp_op & FCMP_NUM)
     {
-      gint l, r;
+      gint64 l, r;
 
-      l = atoi(sb_gstring_string(left_buf)->str);
-      r = atoi(sb_gstring_string(right_buf)->str);
+      l = fop_cmp_operand_get_number(&self->left, msgs, num_msg);
+      r = fop_cmp_operand_get_number(&self->right, msgs, num_msg);
       if (l == r)
         cmp = 0;
       else if (l < r)
@@ -68,7 +234,12 @@ fop_cmp_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
     }
   else
     {
-      cmp = strcmp(sb_gstring_string(left_buf)->str, sb_gstring_string(right_buf)->str);
+      const gchar *l, *r;
+      gssize l_len, r_len;
+
+      l = fop_cmp_operand_get_string(&self->left, msgs, num_msg, &l_len);
+      r = fop_cmp_operand_get_string(&self->right, msgs, num_msg, &r_len);
+      cmp = fop_cmp_compare_strings(l, l_len, r, r_len);
     }
 
   if (cmp == 0)
@@ -84,8 +255,6 @@ fop_cmp_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
       result = self->cmp_op & FCMP_GT || self->cmp_op == 0;
     }
 
-  sb_gstring_release(left_buf);
-  sb_gstring_release(right_buf);
   return result ^ s->comp;
 }
 
@@ -94,8 +263,8 @@ fop_cmp_free(FilterExprNode *s)
 {
   FilterCmp *self = (FilterCmp *) s;
 
-  log_template_unref(self->left);
-  log_template_unref(self->right);
+  fop_cmp_operand_deinit(&self->left);
+  fop_cmp_operand_deinit(&self->right);
 }
 
 FilterExprNode *
@@ -106,9 +275,11 @@ fop_cmp_new(LogTemplate *left, LogTemplate *right, gint op)
   filter_expr_node_init_instance(&self->super);
   self->super.eval = fop_cmp_eval;
   self->super.free_fn = fop_cmp_free;
-  self->left = left;
-  self->right = right;
+  fop_cmp_operand_init(&self->left, left);
+  fop_cmp_operand_init(&self->right, right);
   self->super.type = "CMP";
+  if (self->left.kind != FCMP_OPERAND_TEMPLATE && self->right.kind != FCMP_OPERAND_TEMPLATE)
+    self->super.cost = FILTER_COST_LOOKUP;
 
   switch (op)
     {
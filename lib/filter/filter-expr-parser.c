@@ -56,6 +56,8 @@ static CfgLexerKeyword filter_expr_keywords[] = {
   { "netmask",		  KW_NETMASK },
   { "tags",		  KW_TAGS },
   { "in_list",            KW_IN_LIST },
+  { "in_netmask_list",    KW_IN_NETMASK_LIST },
+  { "label_value",        KW_LABEL_VALUE },
 #if SYSLOG_NG_ENABLE_IPV6
   { "netmask6",     KW_NETMASK6 },
 #endif
@@ -23,6 +23,7 @@
  */
 
 #include "filter/filter-expr.h"
+#include "filter/filter-profile.h"
 #include "messages.h"
 
 /****************************************************************
@@ -33,6 +34,7 @@ void
 filter_expr_node_init_instance(FilterExprNode *self)
 {
   self->ref_cnt = 1;
+  self->cost = FILTER_COST_TEMPLATE;
 }
 
 /*
@@ -46,7 +48,10 @@ filter_expr_eval_with_context(FilterExprNode *self, LogMessage **msg, gint num_m
 {
   gboolean res;
 
-  res = self->eval(self, msg, num_msg);
+  if (G_UNLIKELY(self->profile))
+    res = filter_profile_eval(self, msg, num_msg);
+  else
+    res = self->eval(self, msg, num_msg);
   msg_debug("Filter node evaluation result",
             evt_tag_str("result", res ? "match" : "not-match"),
             evt_tag_str("type", self->type),
@@ -75,6 +80,54 @@ filter_expr_eval_root(FilterExprNode *self, LogMessage **msg, const LogPathOptio
   return filter_expr_eval_root_with_context(self, msg, 1, path_options);
 }
 
+/*
+ * Batch evaluation: unlike the functions above, @msgs is an array of
+ * independent messages.  The filter is evaluated on those selected in
+ * @selection and the bits of the ones that don't match are cleared.  All
+ * num_msg entries of @msgs have to be valid messages, as nodes with
+ * cheap predicates may look at unselected ones too, to avoid branching.
+ *
+ * Nodes without an eval_batch() implementation are evaluated one message
+ * at a time.
+ */
+void
+filter_expr_eval_batch(FilterExprNode *self, LogMessage **msgs, gint num_msg, guint32 *selection)
+{
+  gint i;
+
+  if (self->eval_batch)
+    {
+      if (G_UNLIKELY(self->profile))
+        filter_profile_eval_batch(self, msgs, num_msg, selection);
+      else
+        self->eval_batch(self, msgs, num_msg, selection);
+      return;
+    }
+
+  for (i = 0; i < num_msg; i++)
+    {
+      if (filter_selection_is_set(selection, i) && !filter_expr_eval_with_context(self, &msgs[i], 1))
+        filter_selection_clear(selection, i);
+    }
+}
+
+void
+filter_expr_eval_root_batch(FilterExprNode *self, LogMessage **msgs, gint num_msg, const LogPathOptions *path_options, guint32 *selection)
+{
+  gint i;
+
+  if (self->modify)
+    {
+      for (i = 0; i < num_msg; i++)
+        {
+          if (filter_selection_is_set(selection, i))
+            log_msg_make_writable(&msgs[i], path_options);
+        }
+    }
+
+  filter_expr_eval_batch(self, msgs, num_msg, selection);
+}
+
 FilterExprNode *
 filter_expr_ref(FilterExprNode *self)
 {
@@ -89,6 +142,8 @@ filter_expr_unref(FilterExprNode *self)
     {
       if (self->free_fn)
         self->free_fn(self);
+      if (self->profile)
+        filter_profile_free(self->profile);
       g_free(self);
     }
 }
@@ -30,18 +30,60 @@
 
 struct _GlobalConfig;
 typedef struct _FilterExprNode FilterExprNode;
+struct _FilterProfile;
+
+/* rough relative evaluation costs, used to order the operands of and/or */
+enum
+{
+  FILTER_COST_CHEAP = 1,      /* bitmask and address checks */
+  FILTER_COST_LOOKUP = 4,     /* string comparison or lookup of a single value */
+  FILTER_COST_TEMPLATE = 8,   /* formats templates, the default */
+  FILTER_COST_REGEXP = 16,
+};
 
 struct _FilterExprNode
 {
   guint32 ref_cnt;
   guint32 comp:1,   /* this not is negated */
           modify:1; /* this filter changes the log message */
+  guint32 cost;     /* FILTER_COST_*, the sum of the operands for and/or */
   const gchar *type;
   void (*init)(FilterExprNode *self, GlobalConfig *cfg);
   gboolean (*eval)(FilterExprNode *self, LogMessage **msg, gint num_msg);
+  /* optional, see filter_expr_eval_batch() */
+  void (*eval_batch)(FilterExprNode *self, LogMessage **msgs, gint num_msg, guint32 *selection);
+  /* optional, calls @func for the operands evaluated by this node */
+  void (*foreach_operand)(FilterExprNode *self, void (*func)(FilterExprNode *operand, gpointer user_data), gpointer user_data);
   void (*free_fn)(FilterExprNode *self);
+  /* NULL unless filter-profiling() is enabled */
+  struct _FilterProfile *profile;
 };
 
+/*
+ * Selection bitmaps for batch evaluation: bit (i % 32) of word (i / 32)
+ * corresponds to the i-th message of the batch.  Bits past the end of the
+ * batch must be zero.
+ */
+#define FILTER_SELECTION_WORDS(num_msg) (((num_msg) + 31) / 32)
+
+static inline gboolean
+filter_selection_is_set(const guint32 *selection, gint i)
+{
+  return (selection[i / 32] >> (i % 32)) & 1;
+}
+
+static inline void
+filter_selection_set(guint32 *selection, gint i)
+{
+  selection[i / 32] |= 1U << (i % 32);
+}
+
+static inline void
+filter_selection_clear(guint32 *selection, gint i)
+{
+  selection[i / 32] &= ~(1U << (i % 32));
+}
+
 static inline void
 filter_expr_init(FilterExprNode *self, GlobalConfig *cfg)
 {
@@ -53,6 +95,8 @@ gboolean filter_expr_eval(FilterExprNode *self, LogMessage *msg);
 gboolean filter_expr_eval_with_context(FilterExprNode *self, LogMessage **msgs, gint num_msg);
 gboolean filter_expr_eval_root(FilterExprNode *self, LogMessage **msg, const LogPathOptions *path_options);
 gboolean filter_expr_eval_root_with_context(FilterExprNode *self, LogMessage **msgs, gint num_msg, const LogPathOptions *path_options);
+void filter_expr_eval_batch(FilterExprNode *self, LogMessage **msgs, gint num_msg, guint32 *selection);
+void filter_expr_eval_root_batch(FilterExprNode *self, LogMessage **msgs, gint num_msg, const LogPathOptions *path_options, guint32 *selection);
 void filter_expr_node_init_instance(FilterExprNode *self);
 FilterExprNode *filter_expr_ref(FilterExprNode *self);
 void filter_expr_unref(FilterExprNode *self);
@@ -24,20 +24,66 @@
 
 #include "filter-in-list.h"
 #include "logmsg/logmsg.h"
-#include "str-utils.h"
 
 #include <errno.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
+/*
+ * The list is loaded into an open addressing hash table with linear
+ * probing.  The strings themselves are stored back-to-back in a single
+ * buffer, the table is sized to be at most half full.  Lookups are length
+ * aware, so the value doesn't need to be NUL terminated (or copied).
+ */
+typedef struct _FilterInListSlot
+{
+  guint32 hash;
+  guint32 length;
+  /* NULL for empty slots */
+  const gchar *value;
+} FilterInListSlot;
+
 typedef struct _FilterInList
 {
   FilterExprNode super;
   NVHandle value_handle;
-  GTree *tree;
+  GString *values;
+  FilterInListSlot *slots;
+  guint32 mask;
 } FilterInList;
 
+/* FNV-1a */
+static inline guint32
+filter_in_list_hash(const gchar *value, gsize length)
+{
+  guint32 hash = 2166136261U;
+  gsize i;
+
+  for (i = 0; i < length; i++)
+    {
+      hash ^= (guchar) value[i];
+      hash *= 16777619U;
+    }
+  return hash;
+}
+
+static FilterInListSlot *
+filter_in_list_lookup_slot(FilterInList *self, guint32 hash, const gchar *value, gsize length)
+{
+  guint32 i = hash & self->mask;
+
+  while (self->slots[i].value)
+    {
+      FilterInListSlot *slot = &self->slots[i];
+
+      if (slot->hash == hash && slot->length == length && memcmp(slot->value, value, length) == 0)
+        break;
+      i = (i + 1) & self->mask;
+    }
+  return &self->slots[i];
+}
+
 static gboolean
 filter_in_list_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
 {
@@ -47,9 +93,34 @@ filter_in_list_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
   gssize len = 0;
 
   value = log_msg_get_value(msg, self->value_handle, &len);
-  APPEND_ZERO(value, value, len);
 
-  return (g_tree_lookup(self->tree, value) != NULL) ^ s->comp;
+  return (filter_in_list_lookup_slot(self, filter_in_list_hash(value, len), value, len)->value != NULL) ^ s->comp;
+}
+
+static void
+filter_in_list_build_table(FilterInList *self, GArray *offsets)
+{
+  guint32 size = 8;
+  guint i;
+
+  while (size < 2 * offsets->len)
+    size <<= 1;
+
+  self->mask = size - 1;
+  self->slots = g_new0(FilterInListSlot, size);
+
+  for (i = 0; i < offsets->len; i++)
+    {
+      const gchar *value = self->values->str + g_array_index(offsets, gsize, i);
+      gsize length = strlen(value);
+      guint32 hash = filter_in_list_hash(value, length);
+      FilterInListSlot *slot = filter_in_list_lookup_slot(self, hash, value, length);
+
+      /* duplicates end up in the same slot */
+      slot->hash = hash;
+      slot->length = length;
+      slot->value = value;
+    }
 }
 
 static void
@@ -57,7 +128,8 @@ filter_in_list_free(FilterExprNode *s)
 {
   FilterInList *self = (FilterInList *)s;
 
-  g_tree_destroy(self->tree);
+  g_free(self->slots);
+  g_string_free(self->values, TRUE);
 }
 
 FilterExprNode *
@@ -66,6 +138,7 @@ filter_in_list_new(const gchar *list_file, const gchar *property)
   FilterInList *self;
   FILE *stream;
   gchar line[16384];
+  GArray *offsets;
 
   stream = fopen(list_file, "r");
   if (!stream)
@@ -80,17 +153,30 @@ filter_in_list_new(const gchar *list_file, const gchar *property)
   self = g_new0(FilterInList, 1);
   filter_expr_node_init_instance(&self->super);
   self->value_handle = log_msg_get_value_handle(property);
-  self->tree = g_tree_new_full((GCompareDataFunc)strcmp, NULL, g_free, NULL);
+  self->values = g_string_sized_new(4096);
 
+  /* the value buffer may be reallocated while loading, so remember offsets only */
+  offsets = g_array_new(FALSE, FALSE, sizeof(gsize));
   while (fgets(line, sizeof(line), stream) != NULL)
     {
-      line[strlen(line) - 1] = '\0';
-      if (line[0])
-        g_tree_insert(self->tree, g_strdup(line), GINT_TO_POINTER(1));
+      gsize length = strlen(line);
+
+      if (length > 0 && line[length - 1] == '\n')
+        line[--length] = '\0';
+      if (length == 0)
+        continue;
+
+      g_array_append_val(offsets, self->values->len);
+      g_string_append_len(self->values, line, length + 1);
     }
   fclose(stream);
 
+  filter_in_list_build_table(self, offsets);
+  g_array_free(offsets, TRUE);
+
   self->super.eval = filter_in_list_eval;
+  self->super.type = "in-list";
+  self->super.cost = FILTER_COST_LOOKUP;
   self->super.free_fn = filter_in_list_free;
   return &self->super;
 }
@@ -0,0 +1,343 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "filter-netmask-list.h"
+#include "gsocket.h"
+#include "logmsg/logmsg.h"
+#include "messages.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+/*
+ * in-netmask-list(): matches the sender address against networks loaded
+ * from a file, one "<address>[/<prefix>] [<label>]" per line.
+ *
+ * The networks are stored in two path compressed binary tries (one for
+ * IPv4, one for IPv6), so a lookup visits at most one node per distinct
+ * branching point on the path of the address, independent of the number
+ * of networks.  The most specific matching network wins; its label is
+ * stored in the value named by label-value(), if any.
+ */
+
+#define NETMASK_LIST_MAX_KEY_LEN 16
+
+typedef struct _NetmaskTrieNode NetmaskTrieNode;
+struct _NetmaskTrieNode
+{
+  NetmaskTrieNode *child[2];
+  guint8 key[NETMASK_LIST_MAX_KEY_LEN];
+  /* number of significant bits in key */
+  guint8 prefix_len;
+  /* this node is a network in the list, not just a branching point */
+  gboolean terminal;
+  gchar *label;
+};
+
+typedef struct _FilterNetmaskList
+{
+  FilterExprNode super;
+  NetmaskTrieNode *ipv4;
+  NetmaskTrieNode *ipv6;
+  NVHandle label_handle;
+} FilterNetmaskList;
+
+static inline gint
+_key_bit(const guint8 *key, gint bit)
+{
+  return (key[bit >> 3] >> (7 - (bit & 7))) & 1;
+}
+
+/* number of leading bits equal in a and b, at most max_bits */
+static gint
+_common_prefix_len(const guint8 *a, const guint8 *b, gint max_bits)
+{
+  gint i;
+
+  for (i = 0; i < max_bits >> 3; i++)
+    {
+      if (a[i] != b[i])
+        return (i << 3) + (__builtin_clz((guint) (a[i] ^ b[i])) - (sizeof(guint) * 8 - 8));
+    }
+  for (i <<= 3; i < max_bits; i++)
+    {
+      if (_key_bit(a, i) != _key_bit(b, i))
+        return i;
+    }
+  return max_bits;
+}
+
+static NetmaskTrieNode *
+_trie_node_new(const guint8 *key, gint prefix_len)
+{
+  NetmaskTrieNode *node = g_new0(NetmaskTrieNode, 1);
+  gint i;
+
+  memcpy(node->key, key, (prefix_len + 7) / 8);
+  /* clear the host bits */
+  if (prefix_len & 7)
+    node->key[prefix_len >> 3] &= 0xFF << (8 - (prefix_len & 7));
+  for (i = (prefix_len + 7) / 8; i < NETMASK_LIST_MAX_KEY_LEN; i++)
+    node->key[i] = 0;
+  node->prefix_len = prefix_len;
+  return node;
+}
+
+static void
+_trie_free(NetmaskTrieNode *node)
+{
+  if (!node)
+    return;
+  _trie_free(node->child[0]);
+  _trie_free(node->child[1]);
+  g_free(node->label);
+  g_free(node);
+}
+
+static void
+_trie_insert(NetmaskTrieNode **root, const guint8 *key, gint prefix_len, const gchar *label)
+{
+  NetmaskTrieNode **slot = root;
+  NetmaskTrieNode *node;
+  gint common;
+
+  while ((node = *slot))
+    {
+      common = _common_prefix_len(node->key, key, MIN(node->prefix_len, prefix_len));
+
+      if (common < node->prefix_len)
+        {
+          /* the new network branches off in the middle of this node */
+          NetmaskTrieNode *split = _trie_node_new(key, common);
+
+          split->child[_key_bit(node->key, common)] = node;
+          *slot = split;
+          node = split;
+        }
+
+      if (node->prefix_len == prefix_len)
+        break;
+
+      slot = &node->child[_key_bit(key, node->prefix_len)];
+    }
+
+  if (!node)
+    {
+      node = _trie_node_new(key, prefix_len);
+      *slot = node;
+    }
+
+  /* the first occurrence of a network determines its label */
+  if (!node->terminal)
+    {
+      node->terminal = TRUE;
+      node->label = g_strdup(label);
+    }
+}
+
+/* longest prefix match */
+static NetmaskTrieNode *
+_trie_lookup(NetmaskTrieNode *node, const guint8 *key, gint key_bits)
+{
+  NetmaskTrieNode *best = NULL;
+
+  while (node && _common_prefix_len(node->key, key, node->prefix_len) == node->prefix_len)
+    {
+      if (node->terminal)
+        best = node;
+      if (node->prefix_len == key_bits)
+        break;
+      node = node->child[_key_bit(key, node->prefix_len)];
+    }
+  return best;
+}
+
+static NetmaskTrieNode *
+filter_netmask_list_lookup(FilterNetmaskList *self, LogMessage *msg)
+{
+  static const guint8 ipv4_loopback[4] = { 127, 0, 0, 1 };
+
+  if (msg->saddr && g_sockaddr_inet_check(msg->saddr))
+    {
+      struct in_addr *addr = &((struct sockaddr_in *) &msg->saddr->sa)->sin_addr;
+
+      return _trie_lookup(self->ipv4, (const guint8 *) &addr->s_addr, 32);
+    }
+#if SYSLOG_NG_ENABLE_IPV6
+  if (msg->saddr && g_sockaddr_inet6_check(msg->saddr))
+    {
+      struct in6_addr *addr = &((struct sockaddr_in6 *) &msg->saddr->sa)->sin6_addr;
+
+      if (IN6_IS_ADDR_V4MAPPED(addr))
+        return _trie_lookup(self->ipv4, &addr->s6_addr[12], 32);
+      return _trie_lookup(self->ipv6, addr->s6_addr, 128);
+    }
+#endif
+  if (!msg->saddr || msg->saddr->sa.sa_family == AF_UNIX)
+    {
+      NetmaskTrieNode *match = _trie_lookup(self->ipv4, ipv4_loopback, 32);
+
+#if SYSLOG_NG_ENABLE_IPV6
+      if (!match)
+        match = _trie_lookup(self->ipv6, in6addr_loopback.s6_addr, 128);
+#endif
+      return match;
+    }
+
+  /* no address information */
+  return NULL;
+}
+
+static gboolean
+filter_netmask_list_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
+{
+  FilterNetmaskList *self = (FilterNetmaskList *) s;
+  LogMessage *msg = msgs[0];
+  NetmaskTrieNode *match;
+
+  match = filter_netmask_list_lookup(self, msg);
+  if (match && match->label && self->label_handle)
+    log_msg_set_value(msg, self->label_handle, match->label, -1);
+
+  return (match != NULL) ^ s->comp;
+}
+
+static gboolean
+filter_netmask_list_add_line(FilterNetmaskList *self, gchar *line)
+{
+  gchar *network, *label, *slash, *end;
+  guint8 key[NETMASK_LIST_MAX_KEY_LEN];
+  glong prefix_len;
+  gint max_prefix_len;
+  NetmaskTrieNode **root;
+
+  network = line + strspn(line, " \t");
+  network[strcspn(network, "\r\n")] = 0;
+  if (network[0] == 0 || network[0] == '#')
+    return TRUE;
+
+  label = network + strcspn(network, " \t");
+  if (*label)
+    {
+      *label++ = 0;
+      label += strspn(label, " \t");
+      end = label + strlen(label);
+      while (end > label && (end[-1] == ' ' || end[-1] == '\t'))
+        *--end = 0;
+    }
+  if (!*label)
+    label = NULL;
+
+  slash = strchr(network, '/');
+  if (slash)
+    *slash = 0;
+
+  if (inet_pton(AF_INET, network, key) == 1)
+    {
+      max_prefix_len = 32;
+      root = &self->ipv4;
+    }
+#if SYSLOG_NG_ENABLE_IPV6
+  else if (inet_pton(AF_INET6, network, key) == 1)
+    {
+      max_prefix_len = 128;
+      root = &self->ipv6;
+    }
+#endif
+  else
+    return FALSE;
+
+  prefix_len = max_prefix_len;
+  if (slash)
+    {
+      prefix_len = strtol(slash + 1, &end, 10);
+      if (end == slash + 1 || *end || prefix_len < 0 || prefix_len > max_prefix_len)
+        return FALSE;
+    }
+
+  _trie_insert(root, key, prefix_len, label);
+  return TRUE;
+}
+
+static void
+filter_netmask_list_free(FilterExprNode *s)
+{
+  FilterNetmaskList *self = (FilterNetmaskList *) s;
+
+  _trie_free(self->ipv4);
+  _trie_free(self->ipv6);
+}
+
+FilterExprNode *
+filter_netmask_list_new(const gchar *list_file, const gchar *label_value)
+{
+  FilterNetmaskList *self;
+  FILE *stream;
+  gchar line[1024];
+  gint lineno = 0;
+
+  stream = fopen(list_file, "r");
+  if (!stream)
+    {
+      msg_error("Error opening in-netmask-list filter list file",
+                evt_tag_str("file", list_file),
+                evt_tag_errno("errno", errno),
+                NULL);
+      return NULL;
+    }
+
+  self = g_new0(FilterNetmaskList, 1);
+  filter_expr_node_init_instance(&self->super);
+  self->super.eval = filter_netmask_list_eval;
+  self->super.type = "in-netmask-list";
+  self->super.free_fn = filter_netmask_list_free;
+  self->super.cost = FILTER_COST_CHEAP;
+  if (label_value)
+    {
+      self->label_handle = log_msg_get_value_handle(label_value);
+      self->super.modify = TRUE;
+    }
+
+  while (fgets(line, sizeof(line), stream) != NULL)
+    {
+      lineno++;
+      if (!filter_netmask_list_add_line(self, line))
+        {
+          msg_error("Invalid network in in-netmask-list filter list file",
+                    evt_tag_str("file", list_file),
+                    evt_tag_int("line", lineno),
+                    NULL);
+          fclose(stream);
+          filter_expr_unref(&self->super);
+          return NULL;
+        }
+    }
+  fclose(stream);
+
+  return &self->super;
+}
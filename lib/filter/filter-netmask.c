@@ -68,6 +68,7 @@ filter_netmask_new(gchar *cidr)
   gchar *slash;
 
   filter_expr_node_init_instance(&self->super);
+  self->super.cost = FILTER_COST_CHEAP;
   slash = strchr(cidr, '/');
   if (strlen(cidr) >= sizeof(buf) || !slash)
     {
@@ -94,5 +95,6 @@ filter_netmask_new(gchar *cidr)
     }
   self->address.s_addr &= self->netmask.s_addr;
   self->super.eval = filter_netmask_eval;
+  self->super.type = "netmask";
   return &self->super;
 }
@@ -130,6 +130,7 @@ filter_netmask6_new(gchar *cidr)
   gchar *slash = strchr(cidr, '/');
 
   filter_expr_node_init_instance(&self->super);
+  self->super.cost = FILTER_COST_CHEAP;
   if (strlen(cidr) >= INET6_ADDRSTRLEN + 5 || !slash)
     {
       strcpy(address, cidr);
@@ -152,6 +153,7 @@ filter_netmask6_new(gchar *cidr)
     self->address = in6addr_loopback;
 
   self->super.eval = _eval;
+  self->super.type = "netmask6";
   return &self->super;
 }
 #endif
@@ -22,11 +22,46 @@
  *
  */
 #include "filter-op.h"
+#include "filter-re.h"
+#include "filter-call.h"
+#include "filter-pri.h"
+#include "filter-tags.h"
+#include "multi-literal.h"
+
+#include <string.h>
+
+/* a chain of "or" operands using the "string" matcher on the same value */
+typedef struct _FilterOrLiterals
+{
+  NVHandle value_handle;
+  gboolean icase;
+  MultiLiteral *literals;
+} FilterOrLiterals;
+
+/* number of evaluations between reconsidering the operand order */
+#define FOP_REORDER_PERIOD 4096
 
 typedef struct _FilterOp
 {
   FilterExprNode super;
   FilterExprNode *left, *right;
+
+  /*
+   * Operands without side effects are evaluated in the order that is
+   * expected to be the cheapest: the one more likely to decide the result
+   * for its cost goes first.  The counters are statistics updated without
+   * locking, a lost update here and there doesn't matter.
+   */
+  gboolean reorder;
+  gint swapped;
+  guint32 num_evals;
+  guint32 operand_evals[2], operand_decisive[2];
+
+  /* this node is an operand of a parent with the same operator, which evaluates it */
+  gboolean absorbed;
+  /* see fop_merge_operands(), literal_groups is only used by "or" */
+  GArray *literal_groups;
+  GPtrArray *other_operands;
 } FilterOp;
 
 static void
@@ -39,6 +74,101 @@ fop_init(FilterExprNode *s, GlobalConfig *cfg)
   if (self->right && self->right->init)
     self->right->init(self->right, cfg);
   self->super.modify = self->left->modify || self->right->modify;
+  self->super.cost = self->left->cost + self->right->cost;
+
+  /* start with the cheaper operand, the counters will tell the rest */
+  self->reorder = !self->left->modify && !self->right->modify;
+  self->swapped = self->reorder && self->right->cost < self->left->cost;
+  self->num_evals = 0;
+  memset(self->operand_evals, 0, sizeof(self->operand_evals));
+  memset(self->operand_decisive, 0, sizeof(self->operand_decisive));
+}
+
+static inline FilterExprNode *
+fop_get_operand(FilterOp *self, gint operand)
+{
+  return operand == 0 ? self->left : self->right;
+}
+
+/* probability of the operand deciding the result, per unit of cost */
+static gdouble
+fop_get_operand_efficiency(FilterOp *self, gint operand)
+{
+  gdouble p = (self->operand_decisive[operand] + 1.0) / (self->operand_evals[operand] + 2.0);
+
+  return p / MAX(fop_get_operand(self, operand)->cost, 1);
+}
+
+static void
+fop_adjust_order(FilterOp *self)
+{
+  gint i;
+
+  g_atomic_int_set(&self->swapped, fop_get_operand_efficiency(self, 1) > fop_get_operand_efficiency(self, 0));
+
+  /* decay, so that a change in the traffic is followed */
+  for (i = 0; i < 2; i++)
+    {
+      self->operand_evals[i] /= 2;
+      self->operand_decisive[i] /= 2;
+    }
+}
+
+/*
+ * Evaluates the operands of an and/or node until one of them returns
+ * @decisive_result (FALSE for "and", TRUE for "or").
+ */
+static gboolean
+fop_eval_operands(FilterOp *self, LogMessage **msgs, gint num_msg, gboolean decisive_result)
+{
+  gint first;
+  gint i;
+
+  if (!self->reorder)
+    {
+      if (!!filter_expr_eval_with_context(self->left, msgs, num_msg) == decisive_result)
+        return decisive_result;
+      return !!filter_expr_eval_with_context(self->right, msgs, num_msg);
+    }
+
+  if ((++self->num_evals % FOP_REORDER_PERIOD) == 0)
+    fop_adjust_order(self);
+
+  first = g_atomic_int_get(&self->swapped);
+  for (i = 0; i < 2; i++)
+    {
+      gint operand = first ^ i;
+      gboolean result = !!filter_expr_eval_with_context(fop_get_operand(self, operand), msgs, num_msg);
+
+      self->operand_evals[operand]++;
+      if (result == decisive_result)
+        {
+          self->operand_decisive[operand]++;
+          return decisive_result;
+        }
+    }
+  return !decisive_result;
+}
+
+static void
+fop_free_merged_operands(FilterOp *self)
+{
+  gint i;
+
+  if (self->literal_groups)
+    {
+      for (i = 0; i < self->literal_groups->len; i++)
+        multi_literal_free(g_array_index(self->literal_groups, FilterOrLiterals, i).literals);
+      g_array_free(self->literal_groups, TRUE);
+      self->literal_groups = NULL;
+    }
+  if (self->other_operands)
+    {
+      for (i = 0; i < self->other_operands->len; i++)
+        filter_expr_unref(g_ptr_array_index(self->other_operands, i));
+      g_ptr_array_free(self->other_operands, TRUE);
+      self->other_operands = NULL;
+    }
 }
 
 static void
@@ -46,15 +176,36 @@ fop_free(FilterExprNode *s)
 {
   FilterOp *self = (FilterOp *) s;
 
+  fop_free_merged_operands(self);
   filter_expr_unref(self->left);
   filter_expr_unref(self->right);
 }
 
+/* merged chains evaluate other_operands instead of left and right */
+static void
+fop_foreach_operand(FilterExprNode *s, void (*func)(FilterExprNode *operand, gpointer user_data), gpointer user_data)
+{
+  FilterOp *self = (FilterOp *) s;
+  gint i;
+
+  if (self->other_operands)
+    {
+      for (i = 0; i < self->other_operands->len; i++)
+        func(g_ptr_array_index(self->other_operands, i), user_data);
+    }
+  else
+    {
+      func(self->left, user_data);
+      func(self->right, user_data);
+    }
+}
+
 static void
 fop_init_instance(FilterOp *self)
 {
   filter_expr_node_init_instance(&self->super);
   self->super.init = fop_init;
+  self->super.foreach_operand = fop_foreach_operand;
   self->super.free_fn = fop_free;
 }
 
@@ -63,7 +214,534 @@ fop_or_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
 {
   FilterOp *self = (FilterOp *) s;
 
-  return (filter_expr_eval_with_context(self->left, msgs, num_msg) || filter_expr_eval_with_context(self->right, msgs, num_msg)) ^ s->comp;
+  return fop_eval_operands(self, msgs, num_msg, TRUE) ^ s->comp;
+}
+
+static inline gint
+fop_get_first_operand(FilterOp *self)
+{
+  return self->reorder ? g_atomic_int_get(&self->swapped) : 0;
+}
+
+/* selection = candidates & ~selection */
+static inline void
+fop_negate_selection(guint32 *selection, const guint32 *candidates, gint words)
+{
+  gint i;
+
+  for (i = 0; i < words; i++)
+    selection[i] = candidates[i] & ~selection[i];
+}
+
+/* the second operand only sees the messages the first one didn't match */
+static void
+fop_or_eval_batch(FilterExprNode *s, LogMessage **msgs, gint num_msg, guint32 *selection)
+{
+  FilterOp *self = (FilterOp *) s;
+  gint words = FILTER_SELECTION_WORDS(num_msg);
+  guint32 *candidates = g_newa(guint32, words);
+  guint32 *rest = g_newa(guint32, words);
+  gint first = fop_get_first_operand(self);
+  gint i;
+
+  memcpy(candidates, selection, words * sizeof(guint32));
+  filter_expr_eval_batch(fop_get_operand(self, first), msgs, num_msg, selection);
+
+  for (i = 0; i < words; i++)
+    rest[i] = candidates[i] & ~selection[i];
+  filter_expr_eval_batch(fop_get_operand(self, !first), msgs, num_msg, rest);
+  for (i = 0; i < words; i++)
+    selection[i] |= rest[i];
+
+  if (s->comp)
+    fop_negate_selection(selection, candidates, words);
+}
+
+/*
+ * An "or" expression with several string matches on the same value, e.g.
+ *
+ *   message("foo" type(string) flags(substring)) or message("bar" type(string) flags(substring)) or ...
+ *
+ * looks up the value once and matches all of the literals in a single
+ * pass.  The remaining operands are evaluated after that, cheapest first.
+ * Reordering is only visible through side effects, so chains with operands
+ * modifying the message are left alone.
+ */
+static gboolean
+fop_and_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
+{
+  FilterOp *self = (FilterOp *) s;
+
+  return fop_eval_operands(self, msgs, num_msg, FALSE) ^ s->comp;
+}
+
+/* the second operand only sees the messages the first one matched */
+static void
+fop_and_eval_batch(FilterExprNode *s, LogMessage **msgs, gint num_msg, guint32 *selection)
+{
+  FilterOp *self = (FilterOp *) s;
+  gint words = FILTER_SELECTION_WORDS(num_msg);
+  guint32 *candidates = NULL;
+  gint first = fop_get_first_operand(self);
+
+  if (s->comp)
+    {
+      candidates = g_newa(guint32, words);
+      memcpy(candidates, selection, words * sizeof(guint32));
+    }
+
+  filter_expr_eval_batch(fop_get_operand(self, first), msgs, num_msg, selection);
+  filter_expr_eval_batch(fop_get_operand(self, !first), msgs, num_msg, selection);
+
+  if (s->comp)
+    fop_negate_selection(selection, candidates, words);
+}
+
+/*
+ * Chains of the same operator are flattened into a single list of operands
+ * at the outermost and/or, and some of them are merged:
+ *
+ *   - "or": several string matches on the same value, e.g.
+ *
+ *       message("foo" type(string) flags(substring)) or message("bar" type(string) flags(substring)) or ...
+ *
+ *     look up the value once and match all of the literals in a single
+ *     pass,
+ *
+ *   - facility() and level() operands become a single lookup in a table
+ *     indexed by the priority, whatever the operator and their negation,
+ *
+ *   - tags() operands become a single bitmask test, for "or" if they are
+ *     not negated, for "and" if they are (not A and not B == not (A or B)).
+ *
+ * The remaining operands are evaluated after that, cheapest first.
+ * Reordering is only visible through side effects, so chains with operands
+ * modifying the message are left alone.
+ */
+static inline gboolean
+fop_or_match_literals(FilterOp *self, LogMessage *msg)
+{
+  gint i;
+
+  for (i = 0; i < self->literal_groups->len; i++)
+    {
+      FilterOrLiterals *group = &g_array_index(self->literal_groups, FilterOrLiterals, i);
+      const gchar *value;
+      gssize value_len;
+
+      value = log_msg_get_value(msg, group->value_handle, &value_len);
+      if (multi_literal_match(group->literals, value, value_len))
+        return TRUE;
+    }
+  return FALSE;
+}
+
+static gboolean
+fop_or_eval_merged(FilterExprNode *s, LogMessage **msgs, gint num_msg)
+{
+  FilterOp *self = (FilterOp *) s;
+  gint i;
+
+  if (fop_or_match_literals(self, msgs[0]))
+    return !s->comp;
+
+  for (i = 0; i < self->other_operands->len; i++)
+    {
+      if (filter_expr_eval_with_context(g_ptr_array_index(self->other_operands, i), msgs, num_msg))
+        return !s->comp;
+    }
+  return s->comp;
+}
+
+static void
+fop_or_eval_merged_batch(FilterExprNode *s, LogMessage **msgs, gint num_msg, guint32 *selection)
+{
+  FilterOp *self = (FilterOp *) s;
+  gint words = FILTER_SELECTION_WORDS(num_msg);
+  guint32 *candidates = g_newa(guint32, words);
+  guint32 *rest = g_newa(guint32, words);
+  guint32 remaining;
+  gint i, j;
+
+  memcpy(candidates, selection, words * sizeof(guint32));
+  memset(selection, 0, words * sizeof(guint32));
+
+  if (self->literal_groups->len > 0)
+    {
+      for (i = 0; i < num_msg; i++)
+        {
+          if (filter_selection_is_set(candidates, i) && fop_or_match_literals(self, msgs[i]))
+            filter_selection_set(selection, i);
+        }
+    }
+
+  for (i = 0; i < self->other_operands->len; i++)
+    {
+      remaining = 0;
+      for (j = 0; j < words; j++)
+        {
+          rest[j] = candidates[j] & ~selection[j];
+          remaining |= rest[j];
+        }
+      if (!remaining)
+        break;
+
+      filter_expr_eval_batch(g_ptr_array_index(self->other_operands, i), msgs, num_msg, rest);
+      for (j = 0; j < words; j++)
+        selection[j] |= rest[j];
+    }
+
+  if (s->comp)
+    fop_negate_selection(selection, candidates, words);
+}
+
+static gboolean
+fop_and_eval_merged(FilterExprNode *s, LogMessage **msgs, gint num_msg)
+{
+  FilterOp *self = (FilterOp *) s;
+  gint i;
+
+  for (i = 0; i < self->other_operands->len; i++)
+    {
+      if (!filter_expr_eval_with_context(g_ptr_array_index(self->other_operands, i), msgs, num_msg))
+        return s->comp;
+    }
+  return !s->comp;
+}
+
+static void
+fop_and_eval_merged_batch(FilterExprNode *s, LogMessage **msgs, gint num_msg, guint32 *selection)
+{
+  FilterOp *self = (FilterOp *) s;
+  gint words = FILTER_SELECTION_WORDS(num_msg);
+  guint32 *candidates = NULL;
+  gint i;
+
+  if (s->comp)
+    {
+      candidates = g_newa(guint32, words);
+      memcpy(candidates, selection, words * sizeof(guint32));
+    }
+
+  for (i = 0; i < self->other_operands->len; i++)
+    filter_expr_eval_batch(g_ptr_array_index(self->other_operands, i), msgs, num_msg, selection);
+
+  if (s->comp)
+    fop_negate_selection(selection, candidates, words);
+}
+
+/* an operand that is evaluated by its parent, because it uses the same operator */
+static gboolean
+fop_is_absorbable(FilterExprNode *s, gboolean is_or)
+{
+  return s->eval == (is_or ? fop_or_eval : fop_and_eval) && !s->comp;
+}
+
+/* the root of a chain that is evaluated by itself, e.g. the expression of a named filter */
+static gboolean
+fop_is_chain_root(FilterExprNode *s, gboolean is_or)
+{
+  if (is_or)
+    return (s->eval == fop_or_eval || s->eval == fop_or_eval_merged) && !s->comp;
+  return (s->eval == fop_and_eval || s->eval == fop_and_eval_merged) && !s->comp;
+}
+
+static gint fop_collect_operands(FilterExprNode *s, gboolean is_or, GPtrArray *operands);
+
+/*
+ * filter() references are inlined: the operands of the referenced
+ * expression are collected as if they were written in place of the
+ * reference.  The referenced nodes are shared with the named filter, so
+ * they are only read here, never changed.
+ *
+ * Returns the number of references inlined.
+ */
+static gint
+fop_collect_operand(FilterExprNode *operand, gboolean is_or, GPtrArray *operands)
+{
+  FilterExprNode *called;
+  gint inlined = 0;
+
+  while ((called = filter_call_get_expr(operand)))
+    {
+      operand = called;
+      inlined++;
+    }
+
+  if (fop_is_absorbable(operand, is_or) || (inlined && fop_is_chain_root(operand, is_or)))
+    return inlined + fop_collect_operands(operand, is_or, operands);
+
+  g_ptr_array_add(operands, operand);
+  return inlined;
+}
+
+static gint
+fop_collect_operands(FilterExprNode *s, gboolean is_or, GPtrArray *operands)
+{
+  FilterOp *self = (FilterOp *) s;
+
+  return fop_collect_operand(self->left, is_or, operands) +
+         fop_collect_operand(self->right, is_or, operands);
+}
+
+static gboolean
+fop_or_get_literal(FilterExprNode *operand, NVHandle *value_handle, gboolean *icase, const gchar **literal, gsize *literal_len,
+                   MultiLiteralAnchor *anchor)
+{
+  gint flags;
+
+  if (!filter_re_get_literal(operand, value_handle, literal, literal_len, &flags))
+    return FALSE;
+
+  *icase = !!(flags & LMF_ICASE);
+  if (flags & LMF_PREFIX)
+    *anchor = MLA_PREFIX;
+  else if (flags & LMF_SUBSTRING)
+    *anchor = MLA_SUBSTRING;
+  else
+    *anchor = MLA_EXACT;
+  return TRUE;
+}
+
+static FilterOrLiterals *
+fop_or_lookup_literal_group(GArray *groups, NVHandle value_handle, gboolean icase)
+{
+  FilterOrLiterals new_group;
+  gint i;
+
+  for (i = 0; i < groups->len; i++)
+    {
+      FilterOrLiterals *group = &g_array_index(groups, FilterOrLiterals, i);
+
+      if (group->value_handle == value_handle && group->icase == icase)
+        return group;
+    }
+
+  new_group.value_handle = value_handle;
+  new_group.icase = icase;
+  new_group.literals = multi_literal_new(icase);
+  g_array_append_val(groups, new_group);
+  return &g_array_index(groups, FilterOrLiterals, groups->len - 1);
+}
+
+/* keeps @operands sorted by cost, operands of equal cost stay in order */
+static void
+fop_add_by_cost(GPtrArray *operands, FilterExprNode *operand)
+{
+  gint i;
+
+  g_ptr_array_add(operands, operand);
+  for (i = operands->len - 1; i > 0; i--)
+    {
+      FilterExprNode *prev = g_ptr_array_index(operands, i - 1);
+
+      if (prev->cost <= operand->cost)
+        break;
+      g_ptr_array_index(operands, i) = prev;
+      g_ptr_array_index(operands, i - 1) = operand;
+    }
+}
+
+/* returns the number of operands merged, they are removed from @operands */
+static gint
+fop_or_merge_literals(FilterOp *self, GPtrArray *operands)
+{
+  GArray *groups = g_array_new(FALSE, FALSE, sizeof(FilterOrLiterals));
+  FilterOrLiterals *group;
+  NVHandle value_handle;
+  gboolean icase;
+  const gchar *literal;
+  gsize literal_len;
+  MultiLiteralAnchor anchor;
+  gint i, j, merged = 0;
+
+  for (i = 0; i < operands->len; i++)
+    {
+      if (!fop_or_get_literal(g_ptr_array_index(operands, i), &value_handle, &icase, &literal, &literal_len, &anchor))
+        continue;
+
+      group = fop_or_lookup_literal_group(groups, value_handle, icase);
+      multi_literal_add(group->literals, literal, literal_len, anchor);
+    }
+
+  /* a single literal is matched just as fast by its own filter */
+  for (i = 0; i < groups->len; i++)
+    {
+      group = &g_array_index(groups, FilterOrLiterals, i);
+
+      if (multi_literal_get_num_literals(group->literals) < 2)
+        {
+          multi_literal_free(group->literals);
+          continue;
+        }
+      multi_literal_compile(group->literals);
+      g_array_append_val(self->literal_groups, *group);
+    }
+  g_array_free(groups, TRUE);
+
+  for (i = 0; i < operands->len; )
+    {
+      gboolean in_group = FALSE;
+
+      if (fop_or_get_literal(g_ptr_array_index(operands, i), &value_handle, &icase, &literal, &literal_len, &anchor))
+        {
+          for (j = 0; j < self->literal_groups->len; j++)
+            {
+              group = &g_array_index(self->literal_groups, FilterOrLiterals, j);
+              if (group->value_handle == value_handle && group->icase == icase)
+                in_group = TRUE;
+            }
+        }
+      if (in_group)
+        {
+          g_ptr_array_remove_index(operands, i);
+          merged++;
+        }
+      else
+        i++;
+    }
+  return merged;
+}
+
+/* merges the facility() and level() operands into @merged_operands */
+static gint
+fop_merge_pri(GPtrArray *operands, gboolean is_or, GPtrArray *merged_operands)
+{
+  guint32 table[FILTER_PRI_TABLE_WORDS], operand_table[FILTER_PRI_TABLE_WORDS];
+  gint i, j, num_merged = 0;
+
+  memset(table, is_or ? 0 : 0xFF, sizeof(table));
+  for (i = 0; i < operands->len; i++)
+    {
+      if (filter_pri_is_pri_filter(g_ptr_array_index(operands, i)))
+        num_merged++;
+    }
+  if (num_merged < 2)
+    return 0;
+
+  for (i = 0; i < operands->len; )
+    {
+      FilterExprNode *operand = g_ptr_array_index(operands, i);
+
+      if (!filter_pri_is_pri_filter(operand))
+        {
+          i++;
+          continue;
+        }
+
+      filter_pri_get_table(operand, operand_table);
+      for (j = 0; j < FILTER_PRI_TABLE_WORDS; j++)
+        {
+          if (is_or)
+            table[j] |= operand_table[j];
+          else
+            table[j] &= operand_table[j];
+        }
+      g_ptr_array_remove_index(operands, i);
+    }
+  fop_add_by_cost(merged_operands, filter_pri_table_new(table));
+  return num_merged;
+}
+
+/* merges tags(A) or tags(B) and not tags(A) and not tags(B) into @merged_operands */
+static gint
+fop_merge_tags(GPtrArray *operands, gboolean is_or, GPtrArray *merged_operands)
+{
+  FilterExprNode *merged;
+  gint i, num_merged = 0;
+
+  for (i = 0; i < operands->len; i++)
+    {
+      FilterExprNode *operand = g_ptr_array_index(operands, i);
+
+      if (filter_tags_is_tags_filter(operand) && operand->comp == !is_or)
+        num_merged++;
+    }
+  if (num_merged < 2)
+    return 0;
+
+  merged = filter_tags_new(NULL);
+  merged->comp = !is_or;
+  for (i = 0; i < operands->len; )
+    {
+      FilterExprNode *operand = g_ptr_array_index(operands, i);
+
+      if (!filter_tags_is_tags_filter(operand) || operand->comp != !is_or)
+        {
+          i++;
+          continue;
+        }
+      filter_tags_merge(merged, operand);
+      g_ptr_array_remove_index(operands, i);
+    }
+  fop_add_by_cost(merged_operands, merged);
+  return num_merged;
+}
+
+static gboolean
+fop_merge_operands(FilterOp *self, gboolean is_or)
+{
+  GPtrArray *operands = g_ptr_array_new();
+  gint i, merged;
+
+  /* inlining a filter() saves an indirection even if nothing is merged */
+  merged = fop_collect_operands(&self->super, is_or, operands);
+
+  self->literal_groups = g_array_new(FALSE, FALSE, sizeof(FilterOrLiterals));
+  self->other_operands = g_ptr_array_new();
+
+  if (is_or)
+    merged += fop_or_merge_literals(self, operands);
+  merged += fop_merge_pri(operands, is_or, self->other_operands);
+  merged += fop_merge_tags(operands, is_or, self->other_operands);
+
+  for (i = 0; i < operands->len; i++)
+    fop_add_by_cost(self->other_operands, filter_expr_ref(g_ptr_array_index(operands, i)));
+  g_ptr_array_free(operands, TRUE);
+
+  if (merged == 0)
+    {
+      fop_free_merged_operands(self);
+      return FALSE;
+    }
+  return TRUE;
+}
+
+static void
+fop_absorb_operand(FilterExprNode *operand, gboolean is_or)
+{
+  if (fop_is_absorbable(operand, is_or))
+    ((FilterOp *) operand)->absorbed = TRUE;
+}
+
+static void
+fop_chain_init(FilterExprNode *s, GlobalConfig *cfg, gboolean is_or)
+{
+  FilterOp *self = (FilterOp *) s;
+
+  /* nested operands with the same operator are merged into the outermost one */
+  fop_absorb_operand(self->left, is_or);
+  fop_absorb_operand(self->right, is_or);
+
+  fop_init(s, cfg);
+
+  fop_free_merged_operands(self);
+  s->eval = is_or ? fop_or_eval : fop_and_eval;
+  s->eval_batch = is_or ? fop_or_eval_batch : fop_and_eval_batch;
+  if (self->absorbed || s->modify)
+    return;
+
+  if (fop_merge_operands(self, is_or))
+    {
+      s->eval = is_or ? fop_or_eval_merged : fop_and_eval_merged;
+      s->eval_batch = is_or ? fop_or_eval_merged_batch : fop_and_eval_merged_batch;
+    }
+}
+
+static void
+fop_or_init(FilterExprNode *s, GlobalConfig *cfg)
+{
+  fop_chain_init(s, cfg, TRUE);
 }
 
 FilterExprNode *
@@ -72,19 +750,19 @@ fop_or_new(FilterExprNode *e1, FilterExprNode *e2)
   FilterOp *self = g_new0(FilterOp, 1);
 
   fop_init_instance(self);
+  self->super.init = fop_or_init;
   self->super.eval = fop_or_eval;
+  self->super.eval_batch = fop_or_eval_batch;
   self->left = e1;
   self->right = e2;
   self->super.type = "OR";
   return &self->super;
 }
 
-static gboolean
-fop_and_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
+static void
+fop_and_init(FilterExprNode *s, GlobalConfig *cfg)
 {
-  FilterOp *self = (FilterOp *) s;
-
-  return (filter_expr_eval_with_context(self->left, msgs, num_msg) && filter_expr_eval_with_context(self->right, msgs, num_msg)) ^ s->comp;
+  fop_chain_init(s, cfg, FALSE);
 }
 
 FilterExprNode *
@@ -93,7 +771,9 @@ fop_and_new(FilterExprNode *e1, FilterExprNode *e2)
   FilterOp *self = g_new0(FilterOp, 1);
 
   fop_init_instance(self);
+  self->super.init = fop_and_init;
   self->super.eval = fop_and_eval;
+  self->super.eval_batch = fop_and_eval_batch;
   self->left = e1;
   self->right = e2;
   self->super.type = "AND";
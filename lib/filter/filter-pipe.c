@@ -23,6 +23,8 @@
  */
 
 #include "filter/filter-pipe.h"
+#include "filter/filter-profile.h"
+#include "usdt-probes.h"
 
 /*******************************************************************
  * LogFilterPipe
@@ -37,11 +39,21 @@ log_filter_pipe_init(LogPipe *s)
   filter_expr_init(self->expr, log_pipe_get_config(s));
   if (!self->name)
     self->name = cfg_tree_get_rule_name(&cfg->tree, ENC_FILTER, s->expr_node);
+  if (cfg->filter_profiling)
+    {
+      gchar location[256];
+
+      if (s->expr_node)
+        log_expr_node_format_location(s->expr_node, location, sizeof(location));
+      else
+        g_strlcpy(location, "#unknown", sizeof(location));
+      filter_profile_register_tree(self->expr, self->name, location);
+    }
   return TRUE;
 }
 
-static void
-log_filter_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options, gpointer user_data)
+static gboolean
+log_filter_pipe_stage(LogPipe *s, LogMessage **pmsg, const LogPathOptions *path_options)
 {
   LogFilterPipe *self = (LogFilterPipe *) s;
   gboolean res;
@@ -51,22 +63,14 @@ log_filter_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_op
             log_pipe_location_tag(s),
             NULL);
 
-  res = filter_expr_eval_root(self->expr, &msg, path_options);
+  res = filter_expr_eval_root(self->expr, pmsg, path_options);
+  SYSLOG_NG_PROBE3(filter__result, self->name, *pmsg, res);
   msg_debug("Filter rule evaluation result",
             evt_tag_str("result", res ? "match" : "not-match"),
             evt_tag_str("rule", self->name),
             log_pipe_location_tag(s),
             NULL);
-  if (res)
-    {
-      log_pipe_forward_msg(s, msg, path_options);
-    }
-  else
-    {
-      if (path_options->matched)
-        (*path_options->matched) = FALSE;
-      log_msg_drop(msg, path_options, AT_PROCESSED);
-    }
+  return res;
 }
 
 static LogPipe *
@@ -94,7 +98,9 @@ log_filter_pipe_new(FilterExprNode *expr, GlobalConfig *cfg)
 
   log_pipe_init_instance(&self->super, cfg);
   self->super.init = log_filter_pipe_init;
-  self->super.queue = log_filter_pipe_queue;
+  self->super.queue = log_pipe_stage_queue_method;
+  self->super.queue_batch = log_pipe_stage_queue_batch_method;
+  self->super.stage = log_filter_pipe_stage;
   self->super.free_fn = log_filter_pipe_free;
   self->super.clone = log_filter_pipe_clone;
   self->expr = expr;
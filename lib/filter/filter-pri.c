@@ -26,6 +26,8 @@
 #include "syslog-names.h"
 #include "logmsg/logmsg.h"
 
+#include <string.h>
+
 typedef struct _FilterPri
 {
   FilterExprNode super;
@@ -51,6 +53,37 @@ filter_facility_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
   return self->super.comp;
 }
 
+/*
+ * The batch versions compute the result for 32 messages at a time without
+ * branching and mask the selection with it.
+ */
+static inline guint32
+filter_facility_matches(FilterPri *self, guint32 pri)
+{
+  guint32 fac_num = (pri & LOG_FACMASK) >> 3;
+
+  if (G_UNLIKELY(self->valid & 0x80000000))
+    return (self->valid & ~0x80000000) == fac_num;
+  return fac_num < 32 ? (self->valid >> fac_num) & 1 : 0;
+}
+
+static void
+filter_facility_eval_batch(FilterExprNode *s, LogMessage **msgs, gint num_msg, guint32 *selection)
+{
+  FilterPri *self = (FilterPri *) s;
+  gint i, j;
+
+  for (i = 0; i < num_msg; i += 32)
+    {
+      gint n = MIN(num_msg - i, 32);
+      guint32 matches = 0;
+
+      for (j = 0; j < n; j++)
+        matches |= filter_facility_matches(self, msgs[i + j]->pri) << j;
+      selection[i / 32] &= s->comp ? ~matches : matches;
+    }
+}
+
 FilterExprNode *
 filter_facility_new(guint32 facilities)
 {
@@ -58,6 +91,8 @@ filter_facility_new(guint32 facilities)
 
   filter_expr_node_init_instance(&self->super);
   self->super.eval = filter_facility_eval;
+  self->super.eval_batch = filter_facility_eval_batch;
+  self->super.cost = FILTER_COST_CHEAP;
   self->valid = facilities;
   self->super.type = "facility";
   return &self->super;
@@ -74,6 +109,29 @@ filter_level_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
   return !!((1 << pri) & self->valid) ^ self->super.comp;
 }
 
+static inline guint32
+filter_level_matches(FilterPri *self, guint32 pri)
+{
+  return (self->valid >> (pri & LOG_PRIMASK)) & 1;
+}
+
+static void
+filter_level_eval_batch(FilterExprNode *s, LogMessage **msgs, gint num_msg, guint32 *selection)
+{
+  FilterPri *self = (FilterPri *) s;
+  gint i, j;
+
+  for (i = 0; i < num_msg; i += 32)
+    {
+      gint n = MIN(num_msg - i, 32);
+      guint32 matches = 0;
+
+      for (j = 0; j < n; j++)
+        matches |= filter_level_matches(self, msgs[i + j]->pri) << j;
+      selection[i / 32] &= s->comp ? ~matches : matches;
+    }
+}
+
 FilterExprNode *
 filter_level_new(guint32 levels)
 {
@@ -81,7 +139,104 @@ filter_level_new(guint32 levels)
 
   filter_expr_node_init_instance(&self->super);
   self->super.eval = filter_level_eval;
+  self->super.eval_batch = filter_level_eval_batch;
+  self->super.cost = FILTER_COST_CHEAP;
   self->valid = levels;
   self->super.type = "level";
   return &self->super;
 }
+
+/*
+ * Any boolean combination of facility() and level() filters is a function
+ * of the facility and severity bits of the priority, so such operands of
+ * and/or are merged into a single table with one bit for each possible
+ * priority value.
+ */
+typedef struct _FilterPriTable
+{
+  FilterExprNode super;
+  guint32 table[FILTER_PRI_TABLE_WORDS];
+} FilterPriTable;
+
+static inline guint32
+filter_pri_table_matches(FilterPriTable *self, LogMessage *msg)
+{
+  guint32 pri = msg->pri & FILTER_PRI_MASK;
+
+  return (self->table[pri / 32] >> (pri % 32)) & 1;
+}
+
+static gboolean
+filter_pri_table_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
+{
+  FilterPriTable *self = (FilterPriTable *) s;
+
+  return filter_pri_table_matches(self, msgs[0]) ^ s->comp;
+}
+
+static void
+filter_pri_table_eval_batch(FilterExprNode *s, LogMessage **msgs, gint num_msg, guint32 *selection)
+{
+  FilterPriTable *self = (FilterPriTable *) s;
+  gint i, j;
+
+  for (i = 0; i < num_msg; i += 32)
+    {
+      gint n = MIN(num_msg - i, 32);
+      guint32 matches = 0;
+
+      for (j = 0; j < n; j++)
+        matches |= filter_pri_table_matches(self, msgs[i + j]) << j;
+      selection[i / 32] &= s->comp ? ~matches : matches;
+    }
+}
+
+FilterExprNode *
+filter_pri_table_new(const guint32 *table)
+{
+  FilterPriTable *self = g_new0(FilterPriTable, 1);
+
+  filter_expr_node_init_instance(&self->super);
+  self->super.eval = filter_pri_table_eval;
+  self->super.eval_batch = filter_pri_table_eval_batch;
+  self->super.cost = FILTER_COST_CHEAP;
+  memcpy(self->table, table, sizeof(self->table));
+  self->super.type = "pri";
+  return &self->super;
+}
+
+gboolean
+filter_pri_is_pri_filter(FilterExprNode *s)
+{
+  return s->eval == filter_facility_eval || s->eval == filter_level_eval || s->eval == filter_pri_table_eval;
+}
+
+/* fills @table with the result of @s for each priority value, negation included */
+void
+filter_pri_get_table(FilterExprNode *s, guint32 *table)
+{
+  guint32 pri, match;
+
+  g_assert(filter_pri_is_pri_filter(s));
+
+  if (s->eval == filter_pri_table_eval)
+    memcpy(table, ((FilterPriTable *) s)->table, FILTER_PRI_TABLE_WORDS * sizeof(guint32));
+  else
+    {
+      memset(table, 0, FILTER_PRI_TABLE_WORDS * sizeof(guint32));
+      for (pri = 0; pri <= FILTER_PRI_MASK; pri++)
+        {
+          if (s->eval == filter_facility_eval)
+            match = filter_facility_matches((FilterPri *) s, pri);
+          else
+            match = filter_level_matches((FilterPri *) s, pri);
+          table[pri / 32] |= match << (pri % 32);
+        }
+    }
+
+  if (s->comp)
+    {
+      for (pri = 0; pri < FILTER_PRI_TABLE_WORDS; pri++)
+        table[pri] = ~table[pri];
+    }
+}
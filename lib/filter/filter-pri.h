@@ -30,4 +30,12 @@
 FilterExprNode *filter_facility_new(guint32 facilities);
 FilterExprNode *filter_level_new(guint32 levels);
 
+/* the facility and severity bits of LogMessage->pri */
+#define FILTER_PRI_MASK 0x3FF
+#define FILTER_PRI_TABLE_WORDS ((FILTER_PRI_MASK + 1) / 32)
+
+FilterExprNode *filter_pri_table_new(const guint32 *table);
+gboolean filter_pri_is_pri_filter(FilterExprNode *s);
+void filter_pri_get_table(FilterExprNode *s, guint32 *table);
+
 #endif
@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "filter/filter-profile.h"
+
+#include <string.h>
+#include <time.h>
+
+/* all the profiled nodes, the ones of the old configuration are freed on reload */
+static GStaticMutex filter_profile_lock = G_STATIC_MUTEX_INIT;
+static GList *filter_profiles;
+
+/*
+ * The TSC is read directly where available, as it is much cheaper than a
+ * system call.  The unit of the results is platform dependent, they are
+ * only meant to be compared to each other.
+ */
+static inline guint64
+filter_profile_get_ticks(void)
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  guint32 lo, hi;
+
+  __asm__ __volatile__("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((guint64) hi << 32) | lo;
+#elif defined(SYSLOG_NG_HAVE_CLOCK_GETTIME)
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (guint64) ts.tv_sec * G_GUINT64_CONSTANT(1000000000) + ts.tv_nsec;
+#else
+  return 0;
+#endif
+}
+
+gboolean
+filter_profile_eval(FilterExprNode *node, LogMessage **msgs, gint num_msg)
+{
+  FilterProfile *self = node->profile;
+  gboolean sample = (self->evals++ % FILTER_PROFILE_SAMPLE_PERIOD) == 0;
+  guint64 start = 0;
+  gboolean res;
+
+  if (sample)
+    start = filter_profile_get_ticks();
+
+  res = node->eval(node, msgs, num_msg);
+
+  if (sample)
+    {
+      self->sampled_ticks += filter_profile_get_ticks() - start;
+      self->sampled_evals++;
+    }
+  if (res)
+    self->matches++;
+  return res;
+}
+
+static gint
+filter_profile_count_selected(const guint32 *selection, gint num_msg)
+{
+  gint i, count = 0;
+
+  for (i = 0; i < num_msg; i++)
+    count += filter_selection_is_set(selection, i);
+  return count;
+}
+
+/* a batch is timed as a whole, its messages count as sampled evaluations */
+void
+filter_profile_eval_batch(FilterExprNode *node, LogMessage **msgs, gint num_msg, guint32 *selection)
+{
+  FilterProfile *self = node->profile;
+  gint selected = filter_profile_count_selected(selection, num_msg);
+  guint64 start;
+
+  start = filter_profile_get_ticks();
+  node->eval_batch(node, msgs, num_msg, selection);
+  self->sampled_ticks += filter_profile_get_ticks() - start;
+
+  self->evals += selected;
+  self->sampled_evals += selected;
+  self->matches += filter_profile_count_selected(selection, num_msg);
+}
+
+static const gchar *
+filter_profile_get_node_type(FilterExprNode *node)
+{
+  return node->type ? node->type : "expr";
+}
+
+typedef struct _FilterProfileWalk
+{
+  const gchar *rule;
+  const gchar *location;
+  const gchar *parent_path;
+  gint index;
+} FilterProfileWalk;
+
+static void filter_profile_register_node(FilterExprNode *node, const gchar *rule, const gchar *location, const gchar *path);
+
+static void
+filter_profile_register_operand(FilterExprNode *operand, gpointer user_data)
+{
+  FilterProfileWalk *walk = (FilterProfileWalk *) user_data;
+  gchar *path;
+
+  path = g_strdup_printf("%s/%s[%d]", walk->parent_path, filter_profile_get_node_type(operand), walk->index++);
+  filter_profile_register_node(operand, walk->rule, walk->location, path);
+  g_free(path);
+}
+
+static void
+filter_profile_register_node(FilterExprNode *node, const gchar *rule, const gchar *location, const gchar *path)
+{
+  FilterProfileWalk walk;
+
+  /* nodes shared by several rules keep the name they were first registered with */
+  if (!node->profile)
+    {
+      FilterProfile *self = g_new0(FilterProfile, 1);
+
+      self->rule = g_strdup(rule);
+      self->location = g_strdup(location);
+      self->path = g_strdup(path);
+
+      g_static_mutex_lock(&filter_profile_lock);
+      filter_profiles = g_list_prepend(filter_profiles, self);
+      g_static_mutex_unlock(&filter_profile_lock);
+      node->profile = self;
+    }
+
+  if (node->foreach_operand)
+    {
+      walk.rule = rule;
+      walk.location = location;
+      walk.parent_path = path;
+      walk.index = 0;
+      node->foreach_operand(node, filter_profile_register_operand, &walk);
+    }
+}
+
+/* starts collecting statistics for all nodes of a filter expression */
+void
+filter_profile_register_tree(FilterExprNode *root, const gchar *rule, const gchar *location)
+{
+  filter_profile_register_node(root, rule, location, filter_profile_get_node_type(root));
+}
+
+void
+filter_profile_free(FilterProfile *self)
+{
+  g_static_mutex_lock(&filter_profile_lock);
+  filter_profiles = g_list_remove(filter_profiles, self);
+  g_static_mutex_unlock(&filter_profile_lock);
+
+  g_free(self->rule);
+  g_free(self->location);
+  g_free(self->path);
+  g_free(self);
+}
+
+static guint64
+filter_profile_get_avg_ticks(FilterProfile *self)
+{
+  return self->sampled_evals ? self->sampled_ticks / self->sampled_evals : 0;
+}
+
+static gint
+filter_profile_cmp_total_ticks(gconstpointer a, gconstpointer b)
+{
+  FilterProfile *pa = (FilterProfile *) a;
+  FilterProfile *pb = (FilterProfile *) b;
+  guint64 ta = filter_profile_get_avg_ticks(pa) * pa->evals;
+  guint64 tb = filter_profile_get_avg_ticks(pb) * pb->evals;
+
+  if (ta == tb)
+    return 0;
+  return ta > tb ? -1 : 1;
+}
+
+/*
+ * Returns the counters in CSV format, the most expensive nodes first.  The
+ * ticks of a node include those of its operands, total_ticks is estimated
+ * from the sampled evaluations.
+ */
+GString *
+filter_profile_format_stats(void)
+{
+  GString *result = g_string_sized_new(1024);
+  GList *sorted, *l;
+
+  g_string_append(result, "rule;location;node;evaluations;matches;avg_ticks;total_ticks\n");
+
+  g_static_mutex_lock(&filter_profile_lock);
+  sorted = g_list_sort(g_list_copy(filter_profiles), filter_profile_cmp_total_ticks);
+  for (l = sorted; l; l = l->next)
+    {
+      FilterProfile *self = (FilterProfile *) l->data;
+      guint64 avg_ticks = filter_profile_get_avg_ticks(self);
+
+      g_string_append_printf(result, "%s;%s;%s;%" G_GUINT64_FORMAT ";%" G_GUINT64_FORMAT ";%" G_GUINT64_FORMAT ";%" G_GUINT64_FORMAT "\n",
+                             self->rule, self->location, self->path,
+                             self->evals, self->matches, avg_ticks, avg_ticks * self->evals);
+    }
+  g_static_mutex_unlock(&filter_profile_lock);
+  g_list_free(sorted);
+  return result;
+}
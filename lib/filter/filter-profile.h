@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef FILTER_PROFILE_H_INCLUDED
+#define FILTER_PROFILE_H_INCLUDED
+
+#include "filter/filter-expr.h"
+
+/*
+ * Per-node evaluation counters, enabled by the filter-profiling() global
+ * option.  The counters are updated without locking, a lost update here
+ * and there doesn't matter for statistics.
+ */
+typedef struct _FilterProfile
+{
+  gchar *rule;
+  gchar *location;
+  gchar *path;
+  guint64 evals;
+  guint64 matches;
+  /* the time of every FILTER_PROFILE_SAMPLE_PERIOD-th evaluation is measured */
+  guint64 sampled_evals;
+  guint64 sampled_ticks;
+} FilterProfile;
+
+#define FILTER_PROFILE_SAMPLE_PERIOD 16
+
+void filter_profile_register_tree(FilterExprNode *root, const gchar *rule, const gchar *location);
+void filter_profile_free(FilterProfile *self);
+gboolean filter_profile_eval(FilterExprNode *node, LogMessage **msgs, gint num_msg);
+void filter_profile_eval_batch(FilterExprNode *node, LogMessage **msgs, gint num_msg, guint32 *selection);
+GString *filter_profile_format_stats(void);
+
+#endif
@@ -65,9 +65,16 @@ static void
 filter_re_init(FilterExprNode *s, GlobalConfig *cfg)
 {
   FilterRE *self = (FilterRE *) s;
+  const gchar *literal;
+  gsize literal_len;
 
   if (self->matcher_options.flags & LMF_STORE_MATCHES)
     self->super.modify = TRUE;
+
+  if (self->matcher && log_matcher_string_get_literal(self->matcher, &literal, &literal_len))
+    self->super.cost = FILTER_COST_LOOKUP;
+  else
+    self->super.cost = FILTER_COST_REGEXP;
 }
 
 gboolean
@@ -78,6 +85,26 @@ filter_re_compile_pattern(FilterRE *self, GlobalConfig *cfg, gchar *re, GError *
   return log_matcher_compile(self->matcher, re, error);
 }
 
+/*
+ * Returns the pattern of a non-negated filter using the "string" matcher,
+ * so that an "or" expression can merge these into a single automaton.
+ */
+gboolean
+filter_re_get_literal(FilterExprNode *s, NVHandle *value_handle, const gchar **literal, gsize *literal_len, gint *flags)
+{
+  FilterRE *self = (FilterRE *) s;
+
+  if (s->free_fn != filter_re_free || s->comp || !self->value_handle || !self->matcher)
+    return FALSE;
+
+  if (!log_matcher_string_get_literal(self->matcher, literal, literal_len))
+    return FALSE;
+
+  *value_handle = self->value_handle;
+  *flags = self->matcher->flags;
+  return TRUE;
+}
+
 static void
 filter_re_init_instance(FilterRE *self, NVHandle value_handle)
 {
@@ -85,6 +112,7 @@ filter_re_init_instance(FilterRE *self, NVHandle value_handle)
   self->value_handle = value_handle;
   self->super.init = filter_re_init;
   self->super.eval = filter_re_eval;
+  self->super.type = "match";
   self->super.free_fn = filter_re_free;
   log_matcher_options_defaults(&self->matcher_options);
   self->matcher_options.flags |= LMF_MATCH_ONLY;
@@ -39,6 +39,7 @@ typedef struct _FilterRE
 typedef struct _FilterMatch FilterMatch;
 
 gboolean filter_re_compile_pattern(FilterRE *self, GlobalConfig *cfg, gchar *re, GError **error);
+gboolean filter_re_get_literal(FilterExprNode *s, NVHandle *value_handle, const gchar **literal, gsize *literal_len, gint *flags);
 
 FilterRE *filter_re_new(NVHandle value_handle);
 FilterRE *filter_source_new(void);
@@ -26,10 +26,20 @@
 #include "filter-tags.h"
 #include "logmsg/logmsg.h"
 
+#include <string.h>
+
+#define FILTER_TAGS_WORD_BITS (sizeof(gulong) * 8)
+
+/*
+ * The tags are stored as a bitmask in the same layout as the tags of a
+ * LogMessage, so a match is a few AND operations, regardless of the number
+ * of tags listed.
+ */
 typedef struct _FilterTags
 {
   FilterExprNode super;
-  GArray *tags;
+  gulong *mask;
+  gint mask_words;
 } FilterTags;
 
 static gboolean
@@ -37,15 +47,43 @@ filter_tags_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
 {
   FilterTags *self = (FilterTags *)s;
   LogMessage *msg = msgs[0];
-  gint i;
 
-  for (i = 0; i < self->tags->len; i++)
+  return log_msg_is_any_tag_set(msg, self->mask, self->mask_words) ^ s->comp;
+}
+
+static void
+filter_tags_eval_batch(FilterExprNode *s, LogMessage **msgs, gint num_msg, guint32 *selection)
+{
+  FilterTags *self = (FilterTags *)s;
+  gint i, j;
+
+  for (i = 0; i < num_msg; i += 32)
     {
-      if (log_msg_is_tag_by_id(msg, g_array_index(self->tags, LogTagId, i)))
-        return TRUE ^ s->comp;
+      gint n = MIN(num_msg - i, 32);
+      guint32 matches = 0;
+
+      for (j = 0; j < n; j++)
+        matches |= (guint32) log_msg_is_any_tag_set(msgs[i + j], self->mask, self->mask_words) << j;
+      selection[i / 32] &= s->comp ? ~matches : matches;
     }
+}
+
+static void
+filter_tags_grow_mask(FilterTags *self, gint mask_words)
+{
+  if (mask_words <= self->mask_words)
+    return;
 
-  return FALSE ^ s->comp;
+  self->mask = g_renew(gulong, self->mask, mask_words);
+  memset(self->mask + self->mask_words, 0, (mask_words - self->mask_words) * sizeof(gulong));
+  self->mask_words = mask_words;
+}
+
+static void
+filter_tags_add_id(FilterTags *self, LogTagId id)
+{
+  filter_tags_grow_mask(self, id / FILTER_TAGS_WORD_BITS + 1);
+  self->mask[id / FILTER_TAGS_WORD_BITS] |= 1UL << (id % FILTER_TAGS_WORD_BITS);
 }
 
 void
@@ -59,16 +97,37 @@ filter_tags_add(FilterExprNode *s, GList *tags)
       id = log_tags_get_by_name((gchar *) tags->data);
       g_free(tags->data);
       tags = g_list_delete_link(tags, tags);
-      g_array_append_val(self->tags, id);
+      filter_tags_add_id(self, id);
     }
 }
 
+gboolean
+filter_tags_is_tags_filter(FilterExprNode *s)
+{
+  return s->eval == filter_tags_eval;
+}
+
+/* adds the tags of the tags() filter @other to @s, ignoring its negation */
+void
+filter_tags_merge(FilterExprNode *s, FilterExprNode *other)
+{
+  FilterTags *self = (FilterTags *)s;
+  FilterTags *o = (FilterTags *)other;
+  gint i;
+
+  g_assert(filter_tags_is_tags_filter(other));
+
+  filter_tags_grow_mask(self, o->mask_words);
+  for (i = 0; i < o->mask_words; i++)
+    self->mask[i] |= o->mask[i];
+}
+
 static void
 filter_tags_free(FilterExprNode *s)
 {
   FilterTags *self = (FilterTags *)s;
 
-  g_array_free(self->tags, TRUE);
+  g_free(self->mask);
 }
 
 FilterExprNode *
@@ -77,11 +136,13 @@ filter_tags_new(GList *tags)
   FilterTags *self = g_new0(FilterTags, 1);
 
   filter_expr_node_init_instance(&self->super);
-  self->tags = g_array_new(FALSE, FALSE, sizeof(LogTagId));
 
   filter_tags_add(&self->super, tags);
 
   self->super.eval = filter_tags_eval;
+  self->super.type = "tags";
+  self->super.eval_batch = filter_tags_eval_batch;
+  self->super.cost = FILTER_COST_CHEAP;
   self->super.free_fn = filter_tags_free;
   return &self->super;
 }
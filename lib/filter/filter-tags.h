@@ -29,5 +29,7 @@
 
 void filter_tags_add(FilterExprNode *s, GList *tags);
 FilterExprNode *filter_tags_new(GList *tags);
+gboolean filter_tags_is_tags_filter(FilterExprNode *s);
+void filter_tags_merge(FilterExprNode *s, FilterExprNode *other);
 
 #endif
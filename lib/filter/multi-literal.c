@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "multi-literal.h"
+
+#include <string.h>
+
+/*
+ * The literals are collected first and the automaton is built by
+ * multi_literal_compile() as a complete DFA: the failure links are folded
+ * into the transition table, so matching is a single table lookup per
+ * input byte, regardless of the number of literals.
+ *
+ * Bytes that do not occur in any of the literals share input class 0, so
+ * the table has one column per distinct byte of the literals instead of
+ * 256.  Case insensitive matching maps both cases of a letter to the same
+ * class, which makes folding the input free.
+ */
+
+enum
+{
+  MLS_SUBSTRING = 0x01,
+  MLS_PREFIX    = 0x02,
+  MLS_EXACT     = 0x04,
+};
+
+typedef struct _MultiLiteralEntry
+{
+  gchar *literal;
+  gsize literal_len;
+  MultiLiteralAnchor anchor;
+} MultiLiteralEntry;
+
+struct _MultiLiteral
+{
+  gboolean icase;
+  GArray *literals;
+
+  guint16 classes[256];
+  guint num_classes;
+  guint num_states;
+  /* num_states rows of num_classes next states */
+  guint32 *delta;
+  /* length of the trie path leading to the state */
+  guint32 *depth;
+  guint8 *flags;
+  gboolean has_substring;
+};
+
+static inline guchar
+_fold(MultiLiteral *self, guchar c)
+{
+  return self->icase ? g_ascii_tolower(c) : c;
+}
+
+static inline guint32 *
+_state_row(MultiLiteral *self, guint32 state)
+{
+  return &self->delta[state * self->num_classes];
+}
+
+static void
+_assign_classes(MultiLiteral *self)
+{
+  guint i;
+  gsize j;
+
+  memset(self->classes, 0, sizeof(self->classes));
+  self->num_classes = 1;
+  for (i = 0; i < self->literals->len; i++)
+    {
+      MultiLiteralEntry *entry = &g_array_index(self->literals, MultiLiteralEntry, i);
+
+      for (j = 0; j < entry->literal_len; j++)
+        {
+          guchar c = _fold(self, entry->literal[j]);
+
+          if (!self->classes[c])
+            self->classes[c] = self->num_classes++;
+        }
+    }
+
+  if (self->icase)
+    {
+      for (i = 'A'; i <= 'Z'; i++)
+        self->classes[i] = self->classes[g_ascii_tolower(i)];
+    }
+}
+
+static void
+_build_trie(MultiLiteral *self)
+{
+  guint i;
+  gsize j;
+
+  self->num_states = 1;
+  for (i = 0; i < self->literals->len; i++)
+    {
+      MultiLiteralEntry *entry = &g_array_index(self->literals, MultiLiteralEntry, i);
+      guint32 state = 0;
+
+      for (j = 0; j < entry->literal_len; j++)
+        {
+          guint32 *next = &_state_row(self, state)[self->classes[(guchar) entry->literal[j]]];
+
+          if (*next == 0)
+            {
+              *next = self->num_states++;
+              self->depth[*next] = j + 1;
+            }
+          state = *next;
+        }
+
+      switch (entry->anchor)
+        {
+        case MLA_SUBSTRING:
+          self->flags[state] |= MLS_SUBSTRING;
+          self->has_substring = TRUE;
+          break;
+        case MLA_PREFIX:
+          self->flags[state] |= MLS_PREFIX;
+          break;
+        case MLA_EXACT:
+          self->flags[state] |= MLS_EXACT;
+          break;
+        default:
+          g_assert_not_reached();
+        }
+    }
+}
+
+/*
+ * Breadth-first walk of the trie: by the time a state is visited, the rows
+ * of all shallower states (including that of its failure state) are
+ * complete, so a missing transition can simply be copied from there.
+ */
+static void
+_build_failure_links(MultiLiteral *self)
+{
+  guint32 *fail = g_new0(guint32, self->num_states);
+  guint32 *queue = g_new(guint32, self->num_states);
+  guint head = 0, tail = 0;
+  guint32 *row;
+  guint c;
+
+  row = _state_row(self, 0);
+  for (c = 0; c < self->num_classes; c++)
+    {
+      if (row[c])
+        queue[tail++] = row[c];
+    }
+
+  while (head < tail)
+    {
+      guint32 state = queue[head++];
+      guint32 *fail_row = _state_row(self, fail[state]);
+
+      row = _state_row(self, state);
+      for (c = 0; c < self->num_classes; c++)
+        {
+          guint32 next = row[c];
+
+          if (next)
+            {
+              fail[next] = fail_row[c];
+              /* a substring literal ending at the failure state ends here, too */
+              self->flags[next] |= self->flags[fail[next]] & MLS_SUBSTRING;
+              queue[tail++] = next;
+            }
+          else
+            {
+              row[c] = fail_row[c];
+            }
+        }
+    }
+
+  g_free(queue);
+  g_free(fail);
+}
+
+void
+multi_literal_compile(MultiLiteral *self)
+{
+  guint max_states = 1;
+  guint i;
+
+  g_assert(self->delta == NULL);
+
+  for (i = 0; i < self->literals->len; i++)
+    max_states += g_array_index(self->literals, MultiLiteralEntry, i).literal_len;
+
+  _assign_classes(self);
+  self->delta = g_new0(guint32, max_states * self->num_classes);
+  self->depth = g_new0(guint32, max_states);
+  self->flags = g_new0(guint8, max_states);
+
+  _build_trie(self);
+  _build_failure_links(self);
+
+  if (self->num_states < max_states)
+    {
+      self->delta = g_renew(guint32, self->delta, self->num_states * self->num_classes);
+      self->depth = g_renew(guint32, self->depth, self->num_states);
+      self->flags = g_renew(guint8, self->flags, self->num_states);
+    }
+}
+
+gboolean
+multi_literal_match(MultiLiteral *self, const gchar *value, gsize value_len)
+{
+  guint32 state = 0;
+  guint8 flags = self->flags[0];
+  gsize i;
+
+  /* empty literals */
+  if (flags & (MLS_SUBSTRING + MLS_PREFIX))
+    return TRUE;
+  if ((flags & MLS_EXACT) && value_len == 0)
+    return TRUE;
+
+  for (i = 0; i < value_len; i++)
+    {
+      state = self->delta[state * self->num_classes + self->classes[(guchar) value[i]]];
+      flags = self->flags[state];
+
+      if (G_UNLIKELY(flags))
+        {
+          if (flags & MLS_SUBSTRING)
+            return TRUE;
+
+          /* anchored literals only match on the trie path starting at the first byte */
+          if (self->depth[state] == i + 1)
+            {
+              if ((flags & MLS_PREFIX) || ((flags & MLS_EXACT) && i + 1 == value_len))
+                return TRUE;
+            }
+        }
+
+      /* we've left that path and there's nothing else to look for */
+      if (!self->has_substring && self->depth[state] != i + 1)
+        return FALSE;
+    }
+  return FALSE;
+}
+
+gint
+multi_literal_get_num_literals(MultiLiteral *self)
+{
+  return self->literals->len;
+}
+
+MultiLiteral *
+multi_literal_new(gboolean icase)
+{
+  MultiLiteral *self = g_new0(MultiLiteral, 1);
+
+  self->icase = icase;
+  self->literals = g_array_new(FALSE, FALSE, sizeof(MultiLiteralEntry));
+  return self;
+}
+
+void
+multi_literal_add(MultiLiteral *self, const gchar *literal, gsize literal_len, MultiLiteralAnchor anchor)
+{
+  MultiLiteralEntry entry;
+
+  g_assert(self->delta == NULL);
+
+  entry.literal = g_memdup(literal, literal_len);
+  entry.literal_len = literal_len;
+  entry.anchor = anchor;
+  g_array_append_val(self->literals, entry);
+}
+
+void
+multi_literal_free(MultiLiteral *self)
+{
+  guint i;
+
+  for (i = 0; i < self->literals->len; i++)
+    g_free(g_array_index(self->literals, MultiLiteralEntry, i).literal);
+  g_array_free(self->literals, TRUE);
+  g_free(self->delta);
+  g_free(self->depth);
+  g_free(self->flags);
+  g_free(self);
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef MULTI_LITERAL_H_INCLUDED
+#define MULTI_LITERAL_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/*
+ * Matches a value against a set of literal strings at once, using an
+ * Aho-Corasick automaton.  Each literal carries its own anchoring, with the
+ * same semantics as the "string" LogMatcher: match anywhere, match as a
+ * prefix or match the whole value.
+ */
+typedef enum
+{
+  MLA_EXACT,
+  MLA_PREFIX,
+  MLA_SUBSTRING,
+} MultiLiteralAnchor;
+
+typedef struct _MultiLiteral MultiLiteral;
+
+MultiLiteral *multi_literal_new(gboolean icase);
+void multi_literal_add(MultiLiteral *self, const gchar *literal, gsize literal_len, MultiLiteralAnchor anchor);
+void multi_literal_compile(MultiLiteral *self);
+gboolean multi_literal_match(MultiLiteral *self, const gchar *value, gsize value_len);
+gint multi_literal_get_num_literals(MultiLiteral *self);
+void multi_literal_free(MultiLiteral *self);
+
+#endif
@@ -29,6 +29,7 @@
 #include "filter/filter-op.h"
 #include "filter/filter-cmp.h"
 #include "filter/filter-tags.h"
+#include "filter/filter-profile.h"
 #include "filter/filter-re.h"
 #include "filter/filter-pri.h"
 #include "cfg.h"
@@ -112,6 +113,12 @@ create_pcre_regexp_match(gchar* regexp, gint flags)
   return compile_pattern(filter_match_new(), regexp, "pcre", flags);
 }
 
+FilterExprNode *
+create_string_filter(NVHandle handle, gchar *literal, gint flags)
+{
+  return compile_pattern(filter_re_new(handle), literal, "string", flags);
+}
+
 LogTemplate *
 create_template(const gchar *template)
 {
@@ -234,6 +241,224 @@ testcase_with_backref_chk(gchar *msg,
       exit(1);                                                  \
     }
 
+static void
+test_operand_reordering(void)
+{
+  gchar *msg = "<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized";
+  LogMessage *logmsg;
+  FilterExprNode *f;
+  gint i;
+
+  logmsg = log_msg_new(msg, strlen(msg), NULL, &parse_options);
+
+  f = fop_and_new(create_pcre_regexp_match("PTHREAD", 0), filter_facility_new(facility_bits("mail")));
+  filter_expr_init(f, configuration);
+  TEST_ASSERT(f->cost == FILTER_COST_REGEXP + FILTER_COST_CHEAP);
+
+  /* the result must not change while the operand order is being adjusted */
+  for (i = 0; i < 10000; i++)
+    TEST_ASSERT(filter_expr_eval(f, logmsg) == FALSE);
+  filter_expr_unref(f);
+
+  f = fop_or_new(create_pcre_regexp_match("PTHREAD", 0), filter_facility_new(facility_bits("mail")));
+  filter_expr_init(f, configuration);
+  for (i = 0; i < 10000; i++)
+    TEST_ASSERT(filter_expr_eval(f, logmsg) == TRUE);
+  filter_expr_unref(f);
+
+  log_msg_unref(logmsg);
+}
+
+/* batch evaluation has to agree with evaluating the messages one by one */
+static void
+assert_batch_matches_single(FilterExprNode *f, LogMessage **msgs, gint num_msg)
+{
+  guint32 selection[FILTER_SELECTION_WORDS(64)];
+  gint i;
+
+  filter_expr_init(f, configuration);
+
+  memset(selection, 0, sizeof(selection));
+  for (i = 0; i < num_msg; i++)
+    {
+      /* leave every third message out of the batch */
+      if (i % 3 != 2)
+        filter_selection_set(selection, i);
+    }
+
+  filter_expr_eval_batch(f, msgs, num_msg, selection);
+  for (i = 0; i < num_msg; i++)
+    {
+      gboolean expected = (i % 3 != 2) && filter_expr_eval(f, msgs[i]);
+
+      TEST_ASSERT(filter_selection_is_set(selection, i) == expected);
+    }
+  filter_expr_unref(f);
+}
+
+static void
+test_batch_evaluation(void)
+{
+  LogMessage *msgs[40];
+  FilterExprNode *f;
+  gchar buf[256];
+  gint i;
+
+  for (i = 0; i < 40; i++)
+    {
+      g_snprintf(buf, sizeof(buf), "<%d>Oct 15 16:17:01 host openvpn[2499]: message %d", i * 5, i);
+      msgs[i] = log_msg_new(buf, strlen(buf), NULL, &parse_options);
+      if (i % 4 == 0)
+        log_msg_set_tag_by_name(msgs[i], "even");
+    }
+
+  assert_batch_matches_single(filter_level_new(level_bits("notice") | level_bits("err")), msgs, 40);
+  assert_batch_matches_single(filter_facility_new(facility_bits("user")), msgs, 40);
+  assert_batch_matches_single(filter_facility_new(0x80000000 | 2), msgs, 40);
+  assert_batch_matches_single(fop_and_new(filter_level_new(level_range("emerg", "warning")),
+                                          create_pcre_regexp_match("message [0-9]*1$", 0)), msgs, 40);
+  assert_batch_matches_single(fop_or_new(filter_facility_new(facility_bits("kern")),
+                                         create_pcre_regexp_match("message 3", 0)), msgs, 40);
+  assert_batch_matches_single(filter_tags_new(g_list_append(NULL, g_strdup("even"))), msgs, 40);
+
+  f = fop_and_new(filter_tags_new(g_list_append(NULL, g_strdup("even"))), filter_level_new(level_bits("debug")));
+  f->comp = 1;
+  assert_batch_matches_single(f, msgs, 40);
+  f = fop_or_new(filter_level_new(level_bits("crit")), create_pcre_regexp_match("message 1", 0));
+  f->comp = 1;
+  assert_batch_matches_single(f, msgs, 40);
+
+  for (i = 0; i < 40; i++)
+    log_msg_unref(msgs[i]);
+}
+
+static FilterExprNode *
+create_tags_filter(const gchar *tag, gboolean negate)
+{
+  FilterExprNode *f = filter_tags_new(g_list_append(NULL, g_strdup(tag)));
+
+  f->comp = negate;
+  return f;
+}
+
+static FilterExprNode *
+negate(FilterExprNode *f)
+{
+  f->comp = !f->comp;
+  return f;
+}
+
+/* merged facility/level/tags operands have to give the same results as the original expression */
+static void
+assert_merged_filter_matches(FilterExprNode *f, LogMessage **msgs, gint num_msg, gboolean (*expected)(gint pri, gint i))
+{
+  gint i;
+
+  filter_expr_init(f, configuration);
+  for (i = 0; i < num_msg; i++)
+    TEST_ASSERT(filter_expr_eval(f, msgs[i]) == expected(msgs[i]->pri, i));
+  assert_batch_matches_single(f, msgs, num_msg);
+}
+
+static gboolean
+_kern_or_err_or_crit(gint pri, gint i)
+{
+  return LOG_FAC(pri) == 0 || LOG_PRI(pri) == LOG_ERR || LOG_PRI(pri) == LOG_CRIT;
+}
+
+static gboolean
+_warning_and_not_user_and_not_crit(gint pri, gint i)
+{
+  return LOG_PRI(pri) <= LOG_WARNING && LOG_FAC(pri) != 1 && LOG_PRI(pri) != LOG_CRIT;
+}
+
+static gboolean
+_even_or_debug_or_three(gint pri, gint i)
+{
+  return i % 4 == 0 || LOG_PRI(pri) == LOG_DEBUG || i % 3 == 0;
+}
+
+static gboolean
+_not_even_and_not_three_and_notice(gint pri, gint i)
+{
+  return i % 4 != 0 && i % 3 != 0 && LOG_PRI(pri) <= LOG_NOTICE;
+}
+
+static void
+test_bitmask_merging(void)
+{
+  LogMessage *msgs[40];
+  gchar buf[256];
+  gint i;
+
+  for (i = 0; i < 40; i++)
+    {
+      g_snprintf(buf, sizeof(buf), "<%d>Oct 15 16:17:01 host openvpn[2499]: message %d", i * 5, i);
+      msgs[i] = log_msg_new(buf, strlen(buf), NULL, &parse_options);
+      if (i % 4 == 0)
+        log_msg_set_tag_by_name(msgs[i], "even");
+      if (i % 3 == 0)
+        log_msg_set_tag_by_name(msgs[i], "three");
+    }
+
+  assert_merged_filter_matches(fop_or_new(fop_or_new(filter_facility_new(facility_bits("kern")),
+                                                     filter_level_new(level_bits("err"))),
+                                          filter_level_new(level_bits("crit"))),
+                               msgs, 40, _kern_or_err_or_crit);
+  assert_merged_filter_matches(fop_and_new(filter_level_new(level_range("emerg", "warning")),
+                                           fop_and_new(negate(filter_facility_new(facility_bits("user"))),
+                                                       negate(filter_level_new(level_bits("crit"))))),
+                               msgs, 40, _warning_and_not_user_and_not_crit);
+  assert_merged_filter_matches(fop_or_new(fop_or_new(create_tags_filter("even", FALSE),
+                                                     filter_level_new(level_bits("debug"))),
+                                          create_tags_filter("three", FALSE)),
+                               msgs, 40, _even_or_debug_or_three);
+  assert_merged_filter_matches(fop_and_new(fop_and_new(create_tags_filter("even", TRUE),
+                                                       create_tags_filter("three", TRUE)),
+                                           filter_level_new(level_range("emerg", "notice"))),
+                               msgs, 40, _not_even_and_not_three_and_notice);
+
+  for (i = 0; i < 40; i++)
+    log_msg_unref(msgs[i]);
+}
+
+static void
+test_filter_profiling(void)
+{
+  gchar *msg = "<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized";
+  LogMessage *logmsg;
+  FilterExprNode *f, *level;
+  GString *stats;
+  gint i;
+
+  logmsg = log_msg_new(msg, strlen(msg), NULL, &parse_options);
+
+  level = filter_level_new(level_bits("debug"));
+  f = fop_and_new(level, create_pcre_regexp_match("PTHREAD", 0));
+  filter_expr_init(f, configuration);
+  filter_profile_register_tree(f, "f_profiled", "test.conf:1:1");
+
+  for (i = 0; i < 100; i++)
+    TEST_ASSERT(filter_expr_eval(f, logmsg) == TRUE);
+
+  TEST_ASSERT(f->profile != NULL && level->profile != NULL);
+  TEST_ASSERT(f->profile->evals == 100 && f->profile->matches == 100);
+  TEST_ASSERT(f->profile->sampled_evals == 100 / FILTER_PROFILE_SAMPLE_PERIOD + 1);
+  TEST_ASSERT(level->profile->evals == 100);
+
+  stats = filter_profile_format_stats();
+  TEST_ASSERT(strstr(stats->str, "f_profiled;test.conf:1:1;AND;100;100;") != NULL);
+  TEST_ASSERT(strstr(stats->str, "f_profiled;test.conf:1:1;AND/level[0];100;100;") != NULL);
+  g_string_free(stats, TRUE);
+
+  filter_expr_unref(f);
+  stats = filter_profile_format_stats();
+  TEST_ASSERT(strstr(stats->str, "f_profiled") == NULL);
+  g_string_free(stats, TRUE);
+
+  log_msg_unref(logmsg);
+}
+
 int
 main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
 {
@@ -412,6 +637,16 @@ main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
   testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized", fop_cmp_new(create_template("alma"), create_template("alma"), KW_GE), 1);
   testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized", fop_cmp_new(create_template("alma"), create_template("alma"), KW_GT), 0);
 
+  testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized", fop_cmp_new(create_template("${PID}"), create_template("1000"), KW_NUM_GT), 1);
+  testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized", fop_cmp_new(create_template("${PID}"), create_template("2499"), KW_NUM_EQ), 1);
+  testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized", fop_cmp_new(create_template("${PID}"), create_template("10000000000"), KW_NUM_LT), 1);
+  testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized", fop_cmp_new(create_template("${PID}"), create_template(" -5"), KW_NUM_GT), 1);
+  testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized", fop_cmp_new(create_template("${PID}0"), create_template("24990"), KW_NUM_EQ), 1);
+  testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized", fop_cmp_new(create_template("${HOST}"), create_template("host"), KW_EQ), 1);
+  testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized", fop_cmp_new(create_template("${HOST}"), create_template("hos"), KW_GT), 1);
+  testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized", fop_cmp_new(create_template("${HOST}"), create_template("${PROGRAM}"), KW_LT), 1);
+  testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized", fop_cmp_new(create_template("${nonexistent}"), create_template(""), KW_EQ), 1);
+
 
   testcase_with_backref_chk("<15>Oct 15 16:17:01 host openvpn[2499]: al fa", create_posix_regexp_filter(LM_V_MESSAGE, "(a)(l) (fa)", LMF_STORE_MATCHES), 1, "1","a");
 
@@ -448,6 +683,35 @@ main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
   testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized", fop_or_new(create_pcre_regexp_match("^PTHREAD$", 0), create_pcre_regexp_match(" PTHREAD ", 0)), 1);
   testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized", fop_or_new(create_pcre_regexp_match(" PAD ", 0), create_pcre_regexp_match("^PTHREAD$", 0)), 0);
 
+  testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized",
+           fop_or_new(create_string_filter(LM_V_MESSAGE, "foo", LMF_SUBSTRING),
+                      fop_or_new(create_string_filter(LM_V_MESSAGE, "bar", LMF_SUBSTRING),
+                                 create_string_filter(LM_V_MESSAGE, "support", LMF_SUBSTRING))), 1);
+  testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized",
+           fop_or_new(fop_or_new(create_string_filter(LM_V_MESSAGE, "foo", LMF_SUBSTRING),
+                                 create_string_filter(LM_V_MESSAGE, "bar", LMF_SUBSTRING)),
+                      create_string_filter(LM_V_MESSAGE, "SUPPORT", LMF_SUBSTRING)), 0);
+  testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized",
+           fop_or_new(create_string_filter(LM_V_MESSAGE, "foo", LMF_SUBSTRING + LMF_ICASE),
+                      create_string_filter(LM_V_MESSAGE, "SUPPORT", LMF_SUBSTRING + LMF_ICASE)), 1);
+  testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized",
+           fop_or_new(create_string_filter(LM_V_MESSAGE, "support", LMF_PREFIX),
+                      create_string_filter(LM_V_MESSAGE, "PTHREAD support", LMF_PREFIX)), 1);
+  testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized",
+           fop_or_new(create_string_filter(LM_V_MESSAGE, "PTHREAD support", 0),
+                      create_string_filter(LM_V_MESSAGE, "initialized", 0)), 0);
+  testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized",
+           fop_or_new(create_string_filter(LM_V_PROGRAM, "openvpn", 0),
+                      create_string_filter(LM_V_MESSAGE, "foo", LMF_SUBSTRING)), 1);
+  testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized",
+           fop_or_new(create_string_filter(LM_V_MESSAGE, "foo", LMF_SUBSTRING),
+                      fop_or_new(create_pcre_regexp_match("^PTHREAD", 0),
+                                 create_string_filter(LM_V_MESSAGE, "bar", LMF_SUBSTRING))), 1);
+  testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized",
+           fop_or_new(create_string_filter(LM_V_MESSAGE, "foo", LMF_SUBSTRING),
+                      fop_and_new(create_string_filter(LM_V_MESSAGE, "PTHREAD", LMF_SUBSTRING),
+                                  create_string_filter(LM_V_MESSAGE, "bar", LMF_SUBSTRING))), 0);
+
   testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized", create_pcre_regexp_match(" PTHREAD ", 0), 1);
   testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized", create_pcre_regexp_match("^openvpn\\[2499\\]: PTHREAD", 0), 1);
   testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized", create_pcre_regexp_match("^PTHREAD$", 0), 0);
@@ -464,6 +728,11 @@ main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
   testcase_with_backref_chk("<15>Oct 15 16:17:01 host openvpn[2499]: al fa", create_pcre_regexp_filter(LM_V_MESSAGE, "(a)(l) (fa)", LMF_STORE_MATCHES), 1, "0","al fa");
   testcase_with_backref_chk("<15>Oct 15 16:17:01 host openvpn[2499]: al fa", create_pcre_regexp_filter(LM_V_MESSAGE, "(a)(l) (fa)", LMF_STORE_MATCHES), 1, "233",NULL);
 
+  test_operand_reordering();
+  test_batch_evaluation();
+  test_bitmask_merging();
+  test_filter_profiling();
+
   app_shutdown();
   return 0;
 }
@@ -140,6 +140,23 @@ test_filter_with_long_line(const char* top_srcdir)
   g_free(list_file_with_long_line);
 }
 
+void
+test_last_line_without_newline_and_duplicates(const char* top_srcdir)
+{
+  gchar* list_file = g_strdup_printf(LIST_FILE_DIR "no_trailing_newline.list", top_srcdir);
+
+  assert_gboolean(evaluate_testcase(MSG_1, filter_in_list_new(list_file, "PROGRAM")),
+                  TRUE,
+                  "in-list filter doesn't match the last line of the list");
+  assert_gboolean(evaluate_testcase(MSG_2, filter_in_list_new(list_file, "PROGRAM")),
+                  TRUE,
+                  "in-list filter doesn't match a line after a duplicate");
+  assert_gboolean(evaluate_testcase(MSG_1, filter_in_list_new(list_file, "HOST")),
+                  FALSE,
+                  "in-list filter matches");
+  g_free(list_file);
+}
+
 void
 run_testcases(const char* top_srcdir)
 {
@@ -151,6 +168,7 @@ run_testcases(const char* top_srcdir)
   test_list_file_contains_lot_of_lines(top_srcdir);
   test_filter_with_ip_address(top_srcdir);
   test_filter_with_long_line(top_srcdir);
+  test_last_line_without_newline_and_duplicates(top_srcdir);
 }
 
 int
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "testutils.h"
+#include "apphook.h"
+#include "gsockaddr.h"
+#include "logmsg/logmsg.h"
+#include "filter/filter-netmask-list.h"
+
+#include <stdlib.h>
+
+#define LIST_FILE_DIR "%s/lib/filter/tests/filters-in-list/"
+
+static FilterExprNode *networks;
+
+static void
+assert_network_match(GSockAddr *saddr, gboolean expected_result, const gchar *expected_label)
+{
+  LogMessage *msg = log_msg_new_empty();
+
+  msg->saddr = saddr;
+  assert_gboolean(filter_expr_eval(networks, msg), expected_result, "in-netmask-list() result mismatch");
+  assert_string(log_msg_get_value_by_name(msg, "NETWORK", NULL), expected_label, "Unexpected network label");
+  log_msg_unref(msg);
+}
+
+static void
+test_ipv4_networks(void)
+{
+  assert_network_match(g_sockaddr_inet_new("10.1.2.3", 514), TRUE, "internal");
+  assert_network_match(g_sockaddr_inet_new("10.20.3.4", 514), TRUE, "lab");
+  assert_network_match(g_sockaddr_inet_new("192.168.1.1", 514), TRUE, "gateway");
+  assert_network_match(g_sockaddr_inet_new("192.168.1.2", 514), FALSE, "");
+  assert_network_match(g_sockaddr_inet_new("172.31.255.255", 514), TRUE, "");
+  assert_network_match(g_sockaddr_inet_new("172.32.0.0", 514), FALSE, "");
+  assert_network_match(g_sockaddr_inet_new("11.0.0.1", 514), FALSE, "");
+  assert_network_match(NULL, FALSE, "");
+}
+
+static void
+test_ipv6_networks(void)
+{
+#if SYSLOG_NG_ENABLE_IPV6
+  assert_network_match(g_sockaddr_inet6_new("2001:db8::1", 514), TRUE, "documentation");
+  assert_network_match(g_sockaddr_inet6_new("2001:db8:1:2::1", 514), TRUE, "documentation-lab");
+  assert_network_match(g_sockaddr_inet6_new("2001:db9::1", 514), FALSE, "");
+  assert_network_match(g_sockaddr_inet6_new("::ffff:10.20.0.1", 514), TRUE, "lab");
+#endif
+}
+
+static void
+test_missing_list_file(const gchar *top_srcdir)
+{
+  gchar *list_file = g_strdup_printf(LIST_FILE_DIR "notexisting.list", top_srcdir);
+
+  assert_null(filter_netmask_list_new(list_file, NULL), "in-netmask-list() should fail when the list file does not exist");
+  g_free(list_file);
+}
+
+int
+main(int argc, char **argv)
+{
+  gchar *top_srcdir = getenv("top_srcdir");
+  gchar *list_file;
+
+  app_startup();
+
+  assert_not_null(top_srcdir, "The $top_srcdir environment variable MUST NOT be empty!");
+
+  list_file = g_strdup_printf(LIST_FILE_DIR "networks.list", top_srcdir);
+  networks = filter_netmask_list_new(list_file, "NETWORK");
+  assert_not_null(networks, "Error loading the list of networks");
+  g_free(list_file);
+
+  test_ipv4_networks();
+  test_ipv6_networks();
+  test_missing_list_file(top_srcdir);
+
+  filter_expr_unref(networks);
+  app_shutdown();
+  return 0;
+}
@@ -24,15 +24,90 @@
 #include "find-crlf.h"
 
 #include <string.h>
-/**
- * This is an optimized version of finding either a CR or LF or NUL
- * character in a buffer.  It is used to find these line terminators in
- * syslog traffic.
- *
- * It uses an algorithm very similar to what there's in libc memchr/strchr.
- **/
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define FIND_CRLF_SSE2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define FIND_CRLF_NEON 1
+#endif
+
+#if FIND_CRLF_SSE2 || FIND_CRLF_NEON
+
+/*
+ * SIMD implementation: looks for all the interesting characters in 16
+ * byte blocks at once, in a single pass over the data.  SSE2 and NEON are
+ * part of the baseline instruction set of x86_64 and aarch64
+ * respectively, so these are selected at compile time.
+ */
+#define FIND_CRLF_BLOCK_SIZE 16
+
+static inline const guchar *
+_find_first_of3(const guchar *s, gsize n, guchar c1, guchar c2, guchar c3)
+{
+#if FIND_CRLF_SSE2
+  const __m128i v1 = _mm_set1_epi8(c1);
+  const __m128i v2 = _mm_set1_epi8(c2);
+  const __m128i v3 = _mm_set1_epi8(c3);
+
+  while (n >= FIND_CRLF_BLOCK_SIZE)
+    {
+      __m128i block = _mm_loadu_si128((const __m128i *) s);
+      gint mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, v1),
+                                                              _mm_cmpeq_epi8(block, v2)),
+                                                 _mm_cmpeq_epi8(block, v3)));
+      if (mask)
+        return s + __builtin_ctz(mask);
+      s += FIND_CRLF_BLOCK_SIZE;
+      n -= FIND_CRLF_BLOCK_SIZE;
+    }
+#else
+  const uint8x16_t v1 = vdupq_n_u8(c1);
+  const uint8x16_t v2 = vdupq_n_u8(c2);
+  const uint8x16_t v3 = vdupq_n_u8(c3);
+
+  while (n >= FIND_CRLF_BLOCK_SIZE)
+    {
+      uint8x16_t block = vld1q_u8(s);
+      uint8x16_t match = vorrq_u8(vorrq_u8(vceqq_u8(block, v1), vceqq_u8(block, v2)), vceqq_u8(block, v3));
+
+      /* the exact position is located by the loop below */
+      if (vmaxvq_u8(match))
+        break;
+      s += FIND_CRLF_BLOCK_SIZE;
+      n -= FIND_CRLF_BLOCK_SIZE;
+    }
+#endif
+
+  for (; n > 0; s++, n--)
+    {
+      if (*s == c1 || *s == c2 || *s == c3)
+        return s;
+    }
+  return NULL;
+}
+
 gchar *
 find_cr_or_lf(gchar *s, gsize n)
+{
+  gchar *p = (gchar *) _find_first_of3((const guchar *) s, n, '\r', '\n', 0);
+
+  if (p && *p == 0)
+    return NULL;
+  return p;
+}
+
+const guchar *
+find_lf_or_nul(const guchar *s, gsize n)
+{
+  return _find_first_of3(s, n, '\n', 0, 0);
+}
+
+#else
+
+static gchar *
+_find_cr_or_lf_wordwise(gchar *s, gsize n)
 {
   gchar *char_ptr;
   gulong *longword_ptr;
@@ -97,3 +172,77 @@ find_cr_or_lf(gchar *s, gsize n)
 
   return NULL;
 }
+
+gchar *
+find_cr_or_lf(gchar *s, gsize n)
+{
+  return _find_cr_or_lf_wordwise(s, n);
+}
+
+static const guchar *
+_find_lf_or_nul_wordwise(const guchar *s, gsize n)
+{
+  const guchar *char_ptr;
+  const gulong *longword_ptr;
+  gulong longword, magic_bits, charmask;
+  gchar c;
+
+  c = '\n';
+
+  /* align input to long boundary */
+  for (char_ptr = s; n > 0 && ((gulong) char_ptr & (sizeof(longword) - 1)) != 0; ++char_ptr, n--)
+    {
+      if (*char_ptr == c || *char_ptr == '\0')
+        return char_ptr;
+    }
+
+  longword_ptr = (gulong *) char_ptr;
+
+#if GLIB_SIZEOF_LONG == 8
+  magic_bits = 0x7efefefefefefeffL;
+#elif GLIB_SIZEOF_LONG == 4
+  magic_bits = 0x7efefeffL;
+#else
+  #error "unknown architecture"
+#endif
+  memset(&charmask, c, sizeof(charmask));
+
+  while (n > sizeof(longword))
+    {
+      longword = *longword_ptr++;
+      if ((((longword + magic_bits) ^ ~longword) & ~magic_bits) != 0 ||
+          ((((longword ^ charmask) + magic_bits) ^ ~(longword ^ charmask)) & ~magic_bits) != 0)
+        {
+          gint i;
+
+          char_ptr = (const guchar *) (longword_ptr - 1);
+
+          for (i = 0; i < sizeof(longword); i++)
+            {
+              if (*char_ptr == c || *char_ptr == '\0')
+                return char_ptr;
+              char_ptr++;
+            }
+        }
+      n -= sizeof(longword);
+    }
+
+  char_ptr = (const guchar *) longword_ptr;
+
+  while (n-- > 0)
+    {
+      if (*char_ptr == c || *char_ptr == '\0')
+        return char_ptr;
+      ++char_ptr;
+    }
+
+  return NULL;
+}
+
+const guchar *
+find_lf_or_nul(const guchar *s, gsize n)
+{
+  return _find_lf_or_nul_wordwise(s, n);
+}
+
+#endif
@@ -26,6 +26,9 @@
 
 #include "syslog-ng.h"
 
+/* first CR or LF in @s, NULL if there's none or a NUL comes first */
 gchar *find_cr_or_lf(gchar *s, gsize n);
+/* first LF or NUL in @s, or NULL */
+const guchar *find_lf_or_nul(const guchar *s, gsize n);
 
 #endif
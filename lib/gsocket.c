@@ -23,6 +23,7 @@
  */
 
 #include "gsocket.h"
+#include "fdhelpers.h"
 
 #include <errno.h>
 #include <arpa/inet.h>
@@ -122,6 +123,52 @@ g_accept(int fd, int *newfd, GSockAddr **addr)
   return G_IO_STATUS_NORMAL;
 }
 
+/**
+ * g_accept_nonblock:
+ * @fd:         accept connection on this socket
+ * @newfd:      fd of the accepted connection
+ * @addr:       store the address of the client here
+ *
+ * Same as g_accept(), but the new fd is returned in non-blocking mode
+ * with close-on-exec set.  Where accept4() is available this saves two
+ * fcntl() pairs for each accepted connection.
+ *
+ *  Returns: glib style I/O error
+ **/
+GIOStatus
+g_accept_nonblock(int fd, int *newfd, GSockAddr **addr)
+{
+  GIOStatus status;
+#if SYSLOG_NG_HAVE_ACCEPT4
+  char sabuf[1024];
+  socklen_t salen = sizeof(sabuf);
+
+  do
+    {
+      *newfd = accept4(fd, (struct sockaddr *) sabuf, &salen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    }
+  while (*newfd == -1 && errno == EINTR);
+  if (*newfd != -1)
+    {
+      *addr = g_sockaddr_new((struct sockaddr *) sabuf, salen);
+      return G_IO_STATUS_NORMAL;
+    }
+  if (errno == EAGAIN)
+    return G_IO_STATUS_AGAIN;
+  /* the libc knows about accept4(), but the kernel does not */
+  if (errno != ENOSYS)
+    return G_IO_STATUS_ERROR;
+#endif
+
+  status = g_accept(fd, newfd, addr);
+  if (status == G_IO_STATUS_NORMAL)
+    {
+      g_fd_set_nonblock(*newfd, TRUE);
+      g_fd_set_cloexec(*newfd, TRUE);
+    }
+  return status;
+}
+
 /**
  * g_connect:
  * @fd: socket to connect 
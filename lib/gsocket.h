@@ -30,6 +30,7 @@
 
 GIOStatus g_bind(int fd, GSockAddr *addr);
 GIOStatus g_accept(int fd, int *newfd, GSockAddr **addr);
+GIOStatus g_accept_nonblock(int fd, int *newfd, GSockAddr **addr);
 GIOStatus g_connect(int fd, GSockAddr *remote);
 gchar *g_inet_ntoa(char *buf, size_t bufsize, struct in_addr a);
 gint g_inet_aton(char *buf, struct in_addr *a);
@@ -284,6 +284,16 @@ resolve_address_using_gethostbyaddr(GSockAddr *saddr, gchar *buf, gsize buf_len)
 
 #endif
 
+static const gchar *
+resolve_address(GSockAddr *saddr, gchar *buf, gsize buf_len)
+{
+#ifdef SYSLOG_NG_HAVE_GETNAMEINFO
+  return resolve_address_using_getnameinfo(saddr, buf, buf_len);
+#else
+  return resolve_address_using_gethostbyaddr(saddr, buf, buf_len);
+#endif
+}
+
 static void *
 sockaddr_to_dnscache_key(GSockAddr *saddr)
 {
@@ -295,6 +305,53 @@ sockaddr_to_dnscache_key(GSockAddr *saddr)
 #endif
 }
 
+/*
+ * Background resolution, use-dns(background)
+ *
+ * A cache miss doesn't block the caller: the address is returned as the
+ * hostname and is resolved on a small thread pool, the result is put
+ * into the shared part of the DNS cache, where later lookups find it.
+ * Failed resolutions are cached for dns-cache-expire-failed() seconds
+ * like with use-dns(yes).
+ */
+#define RESOLVER_MAX_THREADS 4
+#define RESOLVER_MAX_QUEUED  1024
+
+static GThreadPool *resolver_pool;
+G_LOCK_DEFINE_STATIC(resolver_pool_lock);
+
+static void
+resolver_pool_resolve(gpointer data, gpointer user_data)
+{
+  GSockAddr *saddr = (GSockAddr *) data;
+  gchar buf[256];
+  const gchar *hname;
+  gboolean positive;
+
+  hname = resolve_address(saddr, buf, sizeof(buf));
+  positive = (hname != NULL);
+  if (!hname)
+    hname = g_sockaddr_format(saddr, buf, sizeof(buf), GSA_ADDRESS_ONLY);
+
+  dns_cache_finish_resolution(saddr->sa.sa_family, sockaddr_to_dnscache_key(saddr), hname, positive);
+  g_sockaddr_unref(saddr);
+}
+
+static void
+resolve_sockaddr_in_background(GSockAddr *saddr)
+{
+  G_LOCK(resolver_pool_lock);
+  if (!resolver_pool)
+    resolver_pool = g_thread_pool_new(resolver_pool_resolve, NULL, RESOLVER_MAX_THREADS, FALSE, NULL);
+
+  /* if the resolver can't keep up, further addresses are retried on a later lookup */
+  if (resolver_pool &&
+      g_thread_pool_unprocessed(resolver_pool) < RESOLVER_MAX_QUEUED &&
+      dns_cache_start_resolution(saddr->sa.sa_family, sockaddr_to_dnscache_key(saddr)))
+    g_thread_pool_push(resolver_pool, g_sockaddr_ref(saddr), NULL);
+  G_UNLOCK(resolver_pool_lock);
+}
+
 static const gchar *
 resolve_sockaddr_to_inet_or_inet6_hostname(gsize *result_len, GSockAddr *saddr, const HostResolveOptions *host_resolve_options)
 {
@@ -308,19 +365,23 @@ resolve_sockaddr_to_inet_or_inet6_hostname(gsize *result_len, GSockAddr *saddr,
   hname = NULL;
   positive = FALSE;
 
-  if (host_resolve_options->use_dns_cache)
+  /* background resolution delivers its results through the cache */
+  if (host_resolve_options->use_dns_cache || host_resolve_options->use_dns == HOST_RESOLVE_DNS_BACKGROUND)
     {
       if (dns_cache_lookup(saddr->sa.sa_family, dnscache_key, (const gchar **) &hname, &hname_len, &positive))
         return hostname_apply_options_fqdn(hname_len, result_len, hname, positive, host_resolve_options);
     }
 
-  if (!hname && host_resolve_options->use_dns && host_resolve_options->use_dns != 2)
+  if (host_resolve_options->use_dns == HOST_RESOLVE_DNS_BACKGROUND)
     {
-#ifdef SYSLOG_NG_HAVE_GETNAMEINFO
-      hname = resolve_address_using_getnameinfo(saddr, hostname_buffer, sizeof(hostname_buffer));
-#else
-      hname = resolve_address_using_gethostbyaddr(saddr, hostname_buffer, sizeof(hostname_buffer));
-#endif
+      resolve_sockaddr_in_background(saddr);
+      hname = g_sockaddr_format(saddr, hostname_buffer, sizeof(hostname_buffer), GSA_ADDRESS_ONLY);
+      return hostname_apply_options(-1, result_len, hname, host_resolve_options);
+    }
+
+  if (!hname && host_resolve_options->use_dns && host_resolve_options->use_dns != HOST_RESOLVE_DNS_PERSIST_ONLY)
+    {
+      hname = resolve_address(saddr, hostname_buffer, sizeof(hostname_buffer));
       positive = (hname != NULL);
     }
 
@@ -391,3 +452,13 @@ void
 host_resolve_options_destroy(HostResolveOptions *options)
 {
 }
+
+void
+host_resolve_global_deinit(void)
+{
+  G_LOCK(resolver_pool_lock);
+  if (resolver_pool)
+    g_thread_pool_free(resolver_pool, TRUE, TRUE);
+  resolver_pool = NULL;
+  G_UNLOCK(resolver_pool_lock);
+}
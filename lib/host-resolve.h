@@ -26,6 +26,10 @@
 #include "syslog-ng.h"
 #include "gsockaddr.h"
 
+/* use_dns values besides TRUE and FALSE */
+#define HOST_RESOLVE_DNS_PERSIST_ONLY 2
+#define HOST_RESOLVE_DNS_BACKGROUND   3
+
 typedef struct _HostResolveOptions
 {
   gboolean use_dns;
@@ -43,4 +47,6 @@ void host_resolve_options_defaults(HostResolveOptions *options);
 void host_resolve_options_init(HostResolveOptions *options, GlobalConfig *cfg);
 void host_resolve_options_destroy(HostResolveOptions *options);
 
+void host_resolve_global_deinit(void);
+
 #endif
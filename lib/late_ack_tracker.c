@@ -30,7 +30,9 @@
 typedef struct _LateAckRecord
 {
   AckRecord super;
+  /* accessed atomically in the lockless variant */
   gboolean acked;
+  AckType ack_type;
   Bookmark bookmark;
 } LateAckRecord;
 
@@ -40,6 +42,15 @@ typedef struct LateAckTracker
   LateAckRecord *pending_ack_record;
   RingBuffer ack_record_storage;
   GStaticMutex storage_mutex;
+
+  /* lockless variant: ack_record_storage is only used as storage, its
+   * head/tail are replaced by these free running counters, accessed
+   * atomically. tail is only advanced by the source thread, head is only
+   * advanced by the thread owning the "advancing" flag. */
+  gboolean lockless;
+  guint32 head;
+  guint32 tail;
+  gint advancing;
 } LateAckTracker;
 
 static inline void
@@ -152,6 +163,149 @@ late_ack_tracker_manage_msg_ack(AckTracker *s, LogMessage *msg, AckType ack_type
   log_pipe_unref((LogPipe *)self->super.source);
 }
 
+/*
+ * Lockless variant
+ *
+ * Sources are single producers: request_bookmark() and track_msg() are
+ * called from the source thread only, which is the only one advancing the
+ * tail.  Acknowledgements may arrive from any number of destination
+ * threads: they mark their own record as acked and then try to grab the
+ * "advancing" flag.  The thread that succeeds drops the continuous range
+ * of acked records from the head, saves the bookmark of the last one and
+ * adjusts the window of the source.  Others return right away, as the
+ * advancing thread checks the head again after releasing the flag, so
+ * their records are not left behind.
+ */
+static inline LateAckRecord *
+_lockless_record_at(LateAckTracker *self, guint32 position)
+{
+  RingBuffer *storage = &self->ack_record_storage;
+
+  return (LateAckRecord *) (((gchar *) storage->buffer) + (position % storage->capacity) * storage->element_size);
+}
+
+static inline gboolean
+_lockless_is_acked(LateAckTracker *self, guint32 position)
+{
+  return g_atomic_int_get(&_lockless_record_at(self, position)->acked);
+}
+
+static inline guint32
+_lockless_get_continuous_range_length(LateAckTracker *self, guint32 head)
+{
+  guint32 tail = (guint32) g_atomic_int_get((gint *) &self->tail);
+  guint32 n = 0;
+
+  while (head + n != tail && _lockless_is_acked(self, head + n))
+    n++;
+  return n;
+}
+
+static void
+_lockless_drop_range(LateAckTracker *self, guint32 head, guint32 n)
+{
+  guint32 i;
+
+  for (i = 0; i < n; i++)
+    {
+      LateAckRecord *ack_rec = _lockless_record_at(self, head + i);
+
+      late_ack_record_destroy(ack_rec);
+      ack_rec->bookmark.save = NULL;
+      ack_rec->bookmark.destroy = NULL;
+      g_atomic_int_set(&ack_rec->acked, FALSE);
+    }
+  /* the slots can be reused by the source from this point */
+  g_atomic_int_set((gint *) &self->head, (gint) (head + n));
+}
+
+/* returns TRUE if the range has to be checked again */
+static gboolean
+_lockless_advance(LateAckTracker *self)
+{
+  guint32 head, ack_range_length;
+  LateAckRecord *last_in_range;
+  AckType ack_type;
+
+  if (!g_atomic_int_compare_and_exchange(&self->advancing, FALSE, TRUE))
+    return FALSE;
+
+  head = (guint32) g_atomic_int_get((gint *) &self->head);
+  ack_range_length = _lockless_get_continuous_range_length(self, head);
+  if (ack_range_length > 0)
+    {
+      last_in_range = _lockless_record_at(self, head + ack_range_length - 1);
+      ack_type = last_in_range->ack_type;
+      if (ack_type != AT_ABORTED)
+        {
+          Bookmark *bookmark = &(last_in_range->bookmark);
+          bookmark->save(bookmark);
+        }
+      _lockless_drop_range(self, head, ack_range_length);
+
+      if (ack_type == AT_SUSPENDED)
+        log_source_flow_control_suspend(self->super.source);
+      else
+        log_source_flow_control_adjust(self->super.source, ack_range_length);
+    }
+  g_atomic_int_set(&self->advancing, FALSE);
+
+  /* records acked while we were holding the flag */
+  head += ack_range_length;
+  return head != (guint32) g_atomic_int_get((gint *) &self->tail) && _lockless_is_acked(self, head);
+}
+
+static void
+late_ack_tracker_lockless_track_msg(AckTracker *s, LogMessage *msg)
+{
+  LateAckTracker *self = (LateAckTracker *)s;
+  LogSource *source = self->super.source;
+  guint32 tail = (guint32) g_atomic_int_get((gint *) &self->tail);
+
+  g_assert(self->pending_ack_record != NULL);
+  g_assert(self->pending_ack_record == _lockless_record_at(self, tail));
+
+  log_pipe_ref((LogPipe *)source);
+
+  msg->ack_record = (AckRecord *)self->pending_ack_record;
+  g_atomic_int_set((gint *) &self->tail, (gint) (tail + 1));
+
+  self->pending_ack_record = NULL;
+}
+
+static void
+late_ack_tracker_lockless_manage_msg_ack(AckTracker *s, LogMessage *msg, AckType ack_type)
+{
+  LateAckTracker *self = (LateAckTracker *)s;
+  LateAckRecord *ack_rec = (LateAckRecord *)msg->ack_record;
+
+  ack_rec->ack_type = ack_type;
+  g_atomic_int_set(&ack_rec->acked, TRUE);
+
+  while (_lockless_advance(self))
+    ;
+
+  log_msg_unref(msg);
+  log_pipe_unref((LogPipe *)self->super.source);
+}
+
+static Bookmark *
+late_ack_tracker_lockless_request_bookmark(AckTracker *s)
+{
+  LateAckTracker *self = (LateAckTracker *)s;
+  guint32 tail = (guint32) g_atomic_int_get((gint *) &self->tail);
+  guint32 head = (guint32) g_atomic_int_get((gint *) &self->head);
+
+  if (tail - head >= self->ack_record_storage.capacity)
+    return NULL;
+
+  self->pending_ack_record = _lockless_record_at(self, tail);
+  self->pending_ack_record->bookmark.persist_state = s->source->super.cfg->state;
+  self->pending_ack_record->super.tracker = (AckTracker *)self;
+
+  return &(self->pending_ack_record->bookmark);
+}
+
 static Bookmark *
 late_ack_tracker_request_bookmark(AckTracker *s)
 {
@@ -181,9 +335,19 @@ late_ack_tracker_init_instance(LateAckTracker *self, LogSource *source)
   self->super.late = TRUE;
   self->super.source = source;
   source->ack_tracker = (AckTracker *)self;
-  self->super.request_bookmark = late_ack_tracker_request_bookmark;
-  self->super.track_msg = late_ack_tracker_track_msg;
-  self->super.manage_msg_ack = late_ack_tracker_manage_msg_ack;
+  self->lockless = source->options->lockless_ack_tracker;
+  if (self->lockless)
+    {
+      self->super.request_bookmark = late_ack_tracker_lockless_request_bookmark;
+      self->super.track_msg = late_ack_tracker_lockless_track_msg;
+      self->super.manage_msg_ack = late_ack_tracker_lockless_manage_msg_ack;
+    }
+  else
+    {
+      self->super.request_bookmark = late_ack_tracker_request_bookmark;
+      self->super.track_msg = late_ack_tracker_track_msg;
+      self->super.manage_msg_ack = late_ack_tracker_manage_msg_ack;
+    }
   ring_buffer_alloc(&self->ack_record_storage, sizeof(LateAckRecord), log_source_get_init_window_size(source));
   g_static_mutex_init(&self->storage_mutex);
 }
@@ -206,7 +370,10 @@ late_ack_tracker_free(AckTracker *s)
 
   g_static_mutex_free(&self->storage_mutex);
 
-  _drop_range(self, count);
+  if (self->lockless)
+    _lockless_drop_range(self, self->head, self->tail - self->head);
+  else
+    _drop_range(self, count);
 
   ring_buffer_free(&self->ack_record_storage);
   g_free(self);
@@ -26,15 +26,195 @@
 #include "messages.h"
 #include "cfg.h"
 #include "str-utils.h"
+#include "utf8utils.h"
 #include "compat/string.h"
+#include "tls-support.h"
 
 #include <pcre.h>
 
+static gint log_matcher_last_cache_id;
+
 static void
 log_matcher_init(LogMatcher *self, const LogMatcherOptions *options)
 {
   self->ref_cnt = 1;
   self->flags = options->flags;
+  self->cache_id = g_atomic_int_exchange_and_add(&log_matcher_last_cache_id, 1) + 1;
+}
+
+/*
+ * Result cache, enabled by flags(cache).
+ *
+ * Meant for low cardinality values like $PROGRAM or $HOST: the outcome of
+ * match() and replace() is remembered per value, turning a repeated regexp
+ * evaluation into a hash lookup.  Results that depend on more than the
+ * value are never cached: with store-matches the captures are set in the
+ * message, and a replacement template may refer to the message as well,
+ * unless it is a literal string.
+ *
+ * The cache is per thread, so no locking is needed: a two-way set
+ * associative table shared by all matchers, keyed by the matcher's
+ * cache_id and the value.  The IDs are never reused, so entries of freed
+ * matchers are simply evicted over time.
+ */
+
+#define LOG_MATCHER_CACHE_SETS           512
+#define LOG_MATCHER_CACHE_WAYS           2
+#define LOG_MATCHER_CACHE_MAX_VALUE_LEN  256
+
+typedef struct _LogMatcherCacheEntry
+{
+  guint32 cache_id;
+  guint32 hash;
+  /* NULL for match() results */
+  LogTemplate *replacement;
+  gchar *value;
+  gsize value_len;
+  gboolean matched;
+  gchar *new_value;
+  gssize new_length;
+} LogMatcherCacheEntry;
+
+typedef struct _LogMatcherCacheSet
+{
+  LogMatcherCacheEntry ways[LOG_MATCHER_CACHE_WAYS];
+  /* the way to be replaced next */
+  gint victim;
+} LogMatcherCacheSet;
+
+TLS_BLOCK_START
+{
+  LogMatcherCacheSet *result_cache;
+#ifdef PCRE_STUDY_JIT_COMPILE
+  pcre_jit_stack *jit_stack;
+#endif
+}
+TLS_BLOCK_END;
+
+#define local_result_cache  __tls_deref(result_cache)
+#define local_jit_stack     __tls_deref(jit_stack)
+
+static guint32
+log_matcher_cache_hash(LogMatcher *s, LogTemplate *replacement, const gchar *value, gsize value_len)
+{
+  guint32 hash = 2166136261U ^ s->cache_id;
+  gsize i;
+
+  for (i = 0; i < value_len; i++)
+    {
+      hash ^= (guchar) value[i];
+      hash *= 16777619U;
+    }
+  return hash ^ GPOINTER_TO_UINT(replacement);
+}
+
+static void
+log_matcher_cache_entry_clear(LogMatcherCacheEntry *entry)
+{
+  g_free(entry->value);
+  g_free(entry->new_value);
+  memset(entry, 0, sizeof(*entry));
+}
+
+static LogMatcherCacheEntry *
+log_matcher_cache_lookup(LogMatcher *s, LogTemplate *replacement, const gchar *value, gsize value_len, guint32 *hash)
+{
+  LogMatcherCacheSet *set;
+  gint i;
+
+  if (!local_result_cache)
+    local_result_cache = g_new0(LogMatcherCacheSet, LOG_MATCHER_CACHE_SETS);
+
+  *hash = log_matcher_cache_hash(s, replacement, value, value_len);
+  set = &local_result_cache[*hash % LOG_MATCHER_CACHE_SETS];
+  for (i = 0; i < LOG_MATCHER_CACHE_WAYS; i++)
+    {
+      LogMatcherCacheEntry *entry = &set->ways[i];
+
+      if (entry->cache_id == s->cache_id && entry->hash == *hash && entry->replacement == replacement &&
+          entry->value_len == value_len && memcmp(entry->value, value, value_len) == 0)
+        {
+          /* the other way is the least recently used one */
+          set->victim = (i + 1) % LOG_MATCHER_CACHE_WAYS;
+          return entry;
+        }
+    }
+  return NULL;
+}
+
+static LogMatcherCacheEntry *
+log_matcher_cache_store(LogMatcher *s, LogTemplate *replacement, const gchar *value, gsize value_len, guint32 hash)
+{
+  LogMatcherCacheSet *set = &local_result_cache[hash % LOG_MATCHER_CACHE_SETS];
+  LogMatcherCacheEntry *entry = &set->ways[set->victim];
+
+  set->victim = (set->victim + 1) % LOG_MATCHER_CACHE_WAYS;
+  log_matcher_cache_entry_clear(entry);
+  entry->cache_id = s->cache_id;
+  entry->hash = hash;
+  entry->replacement = replacement;
+  entry->value = g_memdup(value, value_len);
+  entry->value_len = value_len;
+  return entry;
+}
+
+gboolean
+log_matcher_match_cached(LogMatcher *s, LogMessage *msg, gint value_handle, const gchar *value, gssize value_len)
+{
+  LogMatcherCacheEntry *entry;
+  guint32 hash;
+  gboolean matched;
+
+  if (value_len < 0)
+    value_len = strlen(value);
+
+  if ((s->flags & LMF_STORE_MATCHES) || value_len > LOG_MATCHER_CACHE_MAX_VALUE_LEN)
+    return s->match(s, msg, value_handle, value, value_len);
+
+  entry = log_matcher_cache_lookup(s, NULL, value, value_len, &hash);
+  if (entry)
+    return entry->matched;
+
+  matched = s->match(s, msg, value_handle, value, value_len);
+  entry = log_matcher_cache_store(s, NULL, value, value_len, hash);
+  entry->matched = matched;
+  return matched;
+}
+
+gchar *
+log_matcher_replace_cached(LogMatcher *s, LogMessage *msg, gint value_handle, const gchar *value, gssize value_len, LogTemplate *replacement, gssize *new_length)
+{
+  LogMatcherCacheEntry *entry;
+  guint32 hash;
+  gchar *new_value;
+
+  if (value_len < 0)
+    value_len = strlen(value);
+
+  if ((s->flags & LMF_STORE_MATCHES) || value_len > LOG_MATCHER_CACHE_MAX_VALUE_LEN ||
+      !replacement || !log_template_is_literal_string(replacement))
+    return s->replace(s, msg, value_handle, value, value_len, replacement, new_length);
+
+  entry = log_matcher_cache_lookup(s, replacement, value, value_len, &hash);
+  if (entry)
+    {
+      if (!entry->matched)
+        return NULL;
+      *new_length = entry->new_length;
+      return g_memdup(entry->new_value, entry->new_length + 1);
+    }
+
+  new_value = s->replace(s, msg, value_handle, value, value_len, replacement, new_length);
+  entry = log_matcher_cache_store(s, replacement, value, value_len, hash);
+  entry->matched = (new_value != NULL);
+  if (new_value)
+    {
+      if (*new_length < 0)
+        *new_length = strlen(new_value);
+      entry->new_length = *new_length;
+      entry->new_value = g_memdup(new_value, *new_length + 1);
+    }
+  return new_value;
 }
 
 typedef struct _LogMatcherPosixRe
@@ -235,6 +415,8 @@ typedef struct _LogMatcherString
   LogMatcher super;
   gchar *pattern;
   gint pattern_len;
+  /* only used with LMF_SUBSTRING */
+  StrSearch search;
 } LogMatcherString;
 
 static gboolean
@@ -246,6 +428,8 @@ log_matcher_string_compile(LogMatcher *s, const gchar *pattern, GError **error)
   
   self->pattern = g_strdup(pattern);
   self->pattern_len = strlen(self->pattern);
+  if (self->super.flags & LMF_SUBSTRING)
+    str_search_init(&self->search, self->pattern, self->pattern_len, self->super.flags & LMF_ICASE);
   return TRUE;
 }
 
@@ -273,20 +457,7 @@ log_matcher_string_match_string(LogMatcherString *self, const gchar *value, gsiz
     }
   else if (self->super.flags & LMF_SUBSTRING)
     {
-      if (self->super.flags & LMF_ICASE)
-        {
-          gchar *buf;
-          gchar *res;
-
-          APPEND_ZERO(buf, value, value_len);
-          res = strcasestr(buf, self->pattern);
-          if (res)
-            result = value + (res - buf);
-        }
-      else
-        {
-          result = g_strstr_len(value, value_len, self->pattern);
-        }
+      result = str_search_find(&self->search, value, value_len);
     }
 
   if (match && !result)
@@ -377,6 +548,7 @@ log_matcher_string_free(LogMatcher *s)
   LogMatcherString *self = (LogMatcherString *) s;
 
   g_free(self->pattern);
+  str_search_clear(&self->search);
 }
 
 LogMatcher *
@@ -393,12 +565,88 @@ log_matcher_string_new(const LogMatcherOptions *options)
   return &self->super;
 }
 
+/* returns the pattern of a compiled "string" matcher, FALSE for any other type */
+gboolean
+log_matcher_string_get_literal(LogMatcher *s, const gchar **literal, gsize *literal_len)
+{
+  LogMatcherString *self = (LogMatcherString *) s;
+
+  if (s->compile != log_matcher_string_compile || !self->pattern)
+    return FALSE;
+
+  *literal = self->pattern;
+  *literal_len = self->pattern_len;
+  return TRUE;
+}
+
+/*
+ * Most globs in practice are "prefix*", "*suffix", "prefix*suffix" or
+ * "*substring*".  These are matched with plain byte comparisons, only the
+ * rest goes to GPatternSpec.  Without '?' in the pattern, comparing bytes is
+ * equivalent to comparing utf8 characters.
+ */
+typedef enum
+{
+  LMG_GENERAL,
+  /* value is head + anything + tail, with head/tail possibly empty */
+  LMG_HEAD_TAIL,
+  /* no wildcards at all */
+  LMG_EXACT,
+  /* value contains the literal between the stars */
+  LMG_SUBSTRING,
+} LogMatcherGlobType;
+
 typedef struct _LogMatcherGlob
 {
   LogMatcher super;
+  LogMatcherGlobType type;
   GPatternSpec *pattern;
+  gchar *head, *tail;
+  gsize head_len, tail_len;
+  StrSearch search;
 } LogMatcherGlob;
 
+static void
+log_matcher_glob_analyze(LogMatcherGlob *self, const gchar *pattern)
+{
+  const gchar *first_star, *last_star, *middle, *middle_end;
+
+  self->type = LMG_GENERAL;
+  if (strchr(pattern, '?'))
+    return;
+
+  first_star = strchr(pattern, '*');
+  if (!first_star)
+    {
+      self->type = LMG_EXACT;
+      self->head = g_strdup(pattern);
+      self->head_len = strlen(pattern);
+      return;
+    }
+  last_star = strrchr(pattern, '*');
+
+  middle = first_star;
+  while (middle < last_star && *middle == '*')
+    middle++;
+  middle_end = last_star;
+  while (middle_end > middle && *(middle_end - 1) == '*')
+    middle_end--;
+
+  if (middle == last_star)
+    {
+      self->type = LMG_HEAD_TAIL;
+      self->head = g_strndup(pattern, first_star - pattern);
+      self->head_len = first_star - pattern;
+      self->tail = g_strdup(last_star + 1);
+      self->tail_len = strlen(last_star + 1);
+    }
+  else if (first_star == pattern && last_star[1] == 0 && !memchr(middle, '*', middle_end - middle))
+    {
+      self->type = LMG_SUBSTRING;
+      str_search_init(&self->search, middle, middle_end - middle, FALSE);
+    }
+}
+
 static gboolean
 log_matcher_glob_compile(LogMatcher *s, const gchar *pattern, GError **error)
 {
@@ -406,10 +654,33 @@ log_matcher_glob_compile(LogMatcher *s, const gchar *pattern, GError **error)
 
   g_return_val_if_fail(error == NULL || *error == NULL, FALSE);
 
-  self->pattern = g_pattern_spec_new(pattern);
+  log_matcher_glob_analyze(self, pattern);
+  if (self->type == LMG_GENERAL)
+    self->pattern = g_pattern_spec_new(pattern);
   return TRUE;
 }
 
+static gboolean
+log_matcher_glob_match_value(LogMatcherGlob *self, const gchar *value, gssize value_len)
+{
+  gchar *buf;
+
+  switch (self->type)
+    {
+    case LMG_EXACT:
+      return value_len == self->head_len && memcmp(value, self->head, value_len) == 0;
+    case LMG_HEAD_TAIL:
+      return value_len >= self->head_len + self->tail_len &&
+             memcmp(value, self->head, self->head_len) == 0 &&
+             memcmp(value + value_len - self->tail_len, self->tail, self->tail_len) == 0;
+    case LMG_SUBSTRING:
+      return str_search_find(&self->search, value, value_len) != NULL;
+    default:
+      APPEND_ZERO(buf, value, value_len);
+      return g_pattern_match(self->pattern, value_len, buf, NULL);
+    }
+}
+
 /* GPattern only works with utf8 strings, if the input is not utf8, we risk
  * a crash
  */
@@ -418,11 +689,10 @@ log_matcher_glob_match(LogMatcher *s, LogMessage *msg, gint value_handle, const
 {
   LogMatcherGlob *self =  (LogMatcherGlob *) s;
   
-  if (G_LIKELY((msg->flags & LF_UTF8) || g_utf8_validate(value, value_len, NULL)))
+  if (G_LIKELY((msg->flags & LF_UTF8) || utf8_validate(value, value_len)))
     {
       static gboolean warned = FALSE;
-      gchar *buf;
-      
+
       if (G_UNLIKELY(!warned && (msg->flags & LF_UTF8) == 0))
         {
           msg_warning("Input is valid utf8, but the log message is not tagged as such, this performs worse than enabling validate-utf8 flag on input", 
@@ -430,8 +700,7 @@ log_matcher_glob_match(LogMatcher *s, LogMessage *msg, gint value_handle, const
                       NULL);
           warned = TRUE;
         }
-      APPEND_ZERO(buf, value, value_len);
-      return g_pattern_match(self->pattern, value_len, buf, NULL);
+      return log_matcher_glob_match_value(self, value, value_len);
     }
   else
     {
@@ -446,7 +715,12 @@ static void
 log_matcher_glob_free(LogMatcher *s)
 {
   LogMatcherGlob *self = (LogMatcherGlob*)s;
-  g_pattern_spec_free(self->pattern);
+
+  if (self->pattern)
+    g_pattern_spec_free(self->pattern);
+  g_free(self->head);
+  g_free(self->tail);
+  str_search_clear(&self->search);
 }
 
 LogMatcher *
@@ -465,12 +739,47 @@ log_matcher_glob_new(const LogMatcherOptions *options)
 
 /* libpcre support */
 
+#ifdef PCRE_STUDY_JIT_COMPILE
+
+/*
+ * JIT compiled patterns run on a separate stack, which is 32k by default, on
+ * the stack of the calling thread.  Complex patterns run out of that
+ * quickly, so each thread gets its own, growable JIT stack that is shared by
+ * all patterns.
+ */
+#define PCRE_JIT_STACK_START_SIZE  (32 * 1024)
+#define PCRE_JIT_STACK_MAX_SIZE    (1024 * 1024)
+
+static pcre_jit_stack *
+log_matcher_pcre_get_jit_stack(void *user_data)
+{
+  if (!local_jit_stack)
+    local_jit_stack = pcre_jit_stack_alloc(PCRE_JIT_STACK_START_SIZE, PCRE_JIT_STACK_MAX_SIZE);
+
+  /* NULL makes PCRE fall back to the machine stack */
+  return local_jit_stack;
+}
+
+static void
+log_matcher_pcre_thread_deinit(void)
+{
+  if (local_jit_stack)
+    {
+      pcre_jit_stack_free(local_jit_stack);
+      local_jit_stack = NULL;
+    }
+}
+
+#endif
+
 typedef struct _LogMatcherPcreRe
 {
   LogMatcher super;
   pcre *pattern;
   pcre_extra *extra;
   gint match_options;
+  /* number of capturing subpatterns, capped at RE_MAX_MATCHES */
+  gint num_matches;
 } LogMatcherPcreRe;
 
 static gboolean
@@ -525,7 +834,8 @@ log_matcher_pcre_re_compile(LogMatcher *s, const gchar *re, GError **error)
     }
 
 #ifdef PCRE_STUDY_JIT_COMPILE
-  optflags = PCRE_STUDY_JIT_COMPILE;
+  if ((self->super.flags & LMF_DISABLE_JIT) == 0)
+    optflags = PCRE_STUDY_JIT_COMPILE;
 #endif
 
   /* optimize regexp */
@@ -536,6 +846,16 @@ log_matcher_pcre_re_compile(LogMatcher *s, const gchar *re, GError **error)
       return FALSE;
     }
 
+#ifdef PCRE_STUDY_JIT_COMPILE
+  if (self->extra && optflags)
+    pcre_assign_jit_stack(self->extra, log_matcher_pcre_get_jit_stack, NULL);
+#endif
+
+  if (pcre_fullinfo(self->pattern, self->extra, PCRE_INFO_CAPTURECOUNT, &self->num_matches) < 0)
+    g_assert_not_reached();
+  if (self->num_matches > RE_MAX_MATCHES)
+    self->num_matches = RE_MAX_MATCHES;
+
   return TRUE;
 }
 
@@ -594,19 +914,22 @@ log_matcher_pcre_re_match(LogMatcher *s, LogMessage *msg, gint value_handle, con
   LogMatcherPcreRe *self = (LogMatcherPcreRe *) s; 
   gint *matches;
   gsize matches_size;
-  gint num_matches;
   gint rc;
 
   if (value_len == -1)
     value_len = strlen(value);
 
-  if (pcre_fullinfo(self->pattern, self->extra, PCRE_INFO_CAPTURECOUNT, &num_matches) < 0)
-    g_assert_not_reached();
-  if (num_matches > RE_MAX_MATCHES)
-    num_matches = RE_MAX_MATCHES;
-
-  matches_size = 3 * (num_matches + 1);
-  matches = g_alloca(matches_size * sizeof(gint));
+  if ((s->flags & LMF_STORE_MATCHES) == 0)
+    {
+      /* nobody is interested in the substrings, let PCRE skip capturing */
+      matches = NULL;
+      matches_size = 0;
+    }
+  else
+    {
+      matches_size = 3 * (self->num_matches + 1);
+      matches = g_alloca(matches_size * sizeof(gint));
+    }
 
   rc = pcre_exec(self->pattern, self->extra,
                  value, value_len, 0, self->match_options, matches, matches_size);
@@ -626,6 +949,9 @@ log_matcher_pcre_re_match(LogMatcher *s, LogMessage *msg, gint value_handle, con
         }
       return FALSE;
     }
+  if (!matches)
+    return TRUE;
+
   if (rc == 0)
     {
       msg_error("Error while storing matching substrings", NULL);
@@ -648,18 +974,12 @@ log_matcher_pcre_re_replace(LogMatcher *s, LogMessage *msg, gint value_handle, c
   GString *new_value = NULL;
   gint *matches;
   gsize matches_size;
-  gint num_matches;
   gint rc;
   gint start_offset, last_offset;
   gint options;
   gboolean last_match_was_empty;
 
-  if (pcre_fullinfo(self->pattern, self->extra, PCRE_INFO_CAPTURECOUNT, &num_matches) < 0)
-    g_assert_not_reached();
-  if (num_matches > RE_MAX_MATCHES)
-    num_matches = RE_MAX_MATCHES;
-
-  matches_size = 3 * (num_matches + 1);
+  matches_size = 3 * (self->num_matches + 1);
   matches = g_alloca(matches_size * sizeof(gint));
 
   /* we need zero initialized offsets for the last match as the
@@ -776,7 +1096,12 @@ static void
 log_matcher_pcre_re_free(LogMatcher *s)
 {
   LogMatcherPcreRe *self = (LogMatcherPcreRe *) s;
+#ifdef PCRE_STUDY_JIT_COMPILE
+  if (self->extra)
+    pcre_free_study(self->extra);
+#else
   pcre_free(self->extra);
+#endif
   pcre_free(self->pattern);
 }
 
@@ -856,6 +1181,24 @@ log_matcher_unref(LogMatcher *s)
     }
 }
 
+void
+log_matcher_thread_deinit(void)
+{
+  gint i, j;
+
+  if (local_result_cache)
+    {
+      for (i = 0; i < LOG_MATCHER_CACHE_SETS; i++)
+        for (j = 0; j < LOG_MATCHER_CACHE_WAYS; j++)
+          log_matcher_cache_entry_clear(&local_result_cache[i].ways[j]);
+      g_free(local_result_cache);
+      local_result_cache = NULL;
+    }
+#ifdef PCRE_STUDY_JIT_COMPILE
+  log_matcher_pcre_thread_deinit();
+#endif
+}
+
 gboolean
 log_matcher_options_set_type(LogMatcherOptions *options, const gchar *type)
 {
@@ -884,6 +1227,8 @@ CfgFlagHandler log_matcher_flag_handlers[] =
   { "store-matches",   CFH_SET, offsetof(LogMatcherOptions, flags), LMF_STORE_MATCHES },
   { "substring",       CFH_SET, offsetof(LogMatcherOptions, flags), LMF_SUBSTRING     },
   { "prefix",          CFH_SET, offsetof(LogMatcherOptions, flags), LMF_PREFIX        },
+  { "disable-jit",     CFH_SET, offsetof(LogMatcherOptions, flags), LMF_DISABLE_JIT   },
+  { "cache",           CFH_SET, offsetof(LogMatcherOptions, flags), LMF_CACHE         },
 
   { NULL },
 };
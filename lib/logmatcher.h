@@ -44,12 +44,18 @@ enum
   LMF_NEWLINE= 0x0008,
   LMF_UTF8   = 0x0010,
   LMF_STORE_MATCHES = 0x0020,
-  LMF_VALID_REGEXP_FLAGS = 0x0037,
+  LMF_VALID_REGEXP_FLAGS = 0x0337,
 
   /* string flags */
   LMF_SUBSTRING = 0x0040,
   LMF_PREFIX = 0x0080,
-  LMF_VALID_STRING_FLAGS = 0x00C7,
+  LMF_VALID_STRING_FLAGS = 0x02C7,
+
+  /* PCRE flags */
+  LMF_DISABLE_JIT = 0x0100,
+
+  /* common flags */
+  LMF_CACHE = 0x0200,
 };
 
 typedef struct _LogMatcherOptions
@@ -64,6 +70,8 @@ struct _LogMatcher
 {
   gint ref_cnt;
   gint flags;
+  /* identifies the matcher in the result cache, see LMF_CACHE */
+  guint32 cache_id;
   gboolean (*compile)(LogMatcher *s, const gchar *re, GError **error);
   /* value_len can be -1 to indicate unknown length */
   gboolean (*match)(LogMatcher *s, LogMessage *msg, gint value_handle, const gchar *value, gssize value_len);
@@ -78,18 +86,25 @@ log_matcher_compile(LogMatcher *s, const gchar *re, GError **error)
   return s->compile(s, re, error);
 }
 
+gboolean log_matcher_match_cached(LogMatcher *s, LogMessage *msg, gint value_handle, const gchar *value, gssize value_len);
+gchar *log_matcher_replace_cached(LogMatcher *s, LogMessage *msg, gint value_handle, const gchar *value, gssize value_len, LogTemplate *replacement, gssize *new_length);
+
 static inline gboolean
 log_matcher_match(LogMatcher *s, LogMessage *msg, gint value_handle, const gchar *value, gssize value_len)
 {
+  if (G_UNLIKELY(s->flags & LMF_CACHE))
+    return log_matcher_match_cached(s, msg, value_handle, value, value_len);
   return s->match(s, msg, value_handle, value, value_len);
 }
 
 static inline gchar *
 log_matcher_replace(LogMatcher *s, LogMessage *msg, gint value_handle, const gchar *value, gssize value_len, LogTemplate *replacement, gssize *new_length)
 {
-  if (s->replace)
-    return s->replace(s, msg, value_handle, value, value_len, replacement, new_length);
-  return NULL;
+  if (!s->replace)
+    return NULL;
+  if (G_UNLIKELY(s->flags & LMF_CACHE))
+    return log_matcher_replace_cached(s, msg, value_handle, value, value_len, replacement, new_length);
+  return s->replace(s, msg, value_handle, value, value_len, replacement, new_length);
 }
 
 static inline void
@@ -109,6 +124,9 @@ LogMatcher *log_matcher_pcre_re_new(const LogMatcherOptions *options);
 LogMatcher *log_matcher_string_new(const LogMatcherOptions *options);
 LogMatcher *log_matcher_glob_new(const LogMatcherOptions *options);
 
+void log_matcher_thread_deinit(void);
+gboolean log_matcher_string_get_literal(LogMatcher *s, const gchar **literal, gsize *literal_len);
+
 LogMatcher *log_matcher_new(const LogMatcherOptions *options);
 LogMatcher *log_matcher_ref(LogMatcher *s);
 void log_matcher_unref(LogMatcher *s);
@@ -51,6 +51,10 @@ log_multiplexer_init(LogPipe *s)
         {
           self->fallback_exists = TRUE;
         }
+      if (branch_head->flags & PIF_BRANCH_FINAL)
+        {
+          self->final_exists = TRUE;
+        }
     }
   return TRUE;
 }
@@ -118,6 +122,54 @@ log_multiplexer_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_op
   log_pipe_forward_msg(s, msg, path_options);
 }
 
+/*
+ * Without fallback and final branches, whether a message was matched by
+ * the branches doesn't matter, so a batch can be passed to each of them
+ * as a whole.
+ */
+static void
+log_multiplexer_queue_batch(LogPipe *s, LogMessage **msgs, gint count, const LogPathOptions *path_options,
+                            gpointer user_data)
+{
+  LogMultiplexer *self = (LogMultiplexer *) s;
+  LogPathOptions local_options = *path_options;
+  LogMessage **branch_msgs;
+  gboolean last_delivery;
+  gint i, j;
+
+  if (self->fallback_exists || self->final_exists)
+    {
+      for (i = 0; i < count; i++)
+        log_multiplexer_queue(s, msgs[i], path_options, user_data);
+      return;
+    }
+
+  branch_msgs = g_new(LogMessage *, count);
+  for (i = 0; i < self->next_hops->len; i++)
+    {
+      LogPipe *next_hop = g_ptr_array_index(self->next_hops, i);
+
+      last_delivery = (self->super.pipe_next == NULL) && (i == self->next_hops->len - 1);
+      for (j = 0; j < count; j++)
+        {
+          log_msg_add_ack(msgs[j], &local_options);
+          if (!last_delivery)
+            log_msg_write_protect(msgs[j]);
+          branch_msgs[j] = log_msg_ref(msgs[j]);
+        }
+
+      log_pipe_queue_batch(next_hop, branch_msgs, count, &local_options);
+
+      if (!last_delivery)
+        {
+          for (j = 0; j < count; j++)
+            log_msg_write_unprotect(msgs[j]);
+        }
+    }
+  g_free(branch_msgs);
+  log_pipe_forward_msg_batch(s, msgs, count, path_options);
+}
+
 static void
 log_multiplexer_free(LogPipe *s)
 {
@@ -136,6 +188,7 @@ log_multiplexer_new(GlobalConfig *cfg)
   self->super.init = log_multiplexer_init;
   self->super.deinit = log_multiplexer_deinit;
   self->super.queue = log_multiplexer_queue;
+  self->super.queue_batch = log_multiplexer_queue_batch;
   self->super.free_fn = log_multiplexer_free;
   self->next_hops = g_ptr_array_new();
   return self;
@@ -55,29 +55,43 @@
 #define NV_TABLE_MAGIC_V2  "NVT2"
 #define NVT_SF_BE           0x1
 
+/*
+ * Versions:
+ *   26: fixed width fields, the NVTable is written as an NVT2 memory dump
+ *   27: compact format, varint lengths, NVTable written entry-by-entry
+ *       (see nv_table_serialize_compact()), no alloc_sdata
+ */
+#define LOGMSG_SERIALIZE_VERSION_NVT2     26
+#define LOGMSG_SERIALIZE_VERSION_COMPACT  27
+
+/* upper bound of the fixed part of a record: header, sockaddr, timestamps and tags */
+#define LOGMSG_SERIALIZE_FIXED_SIZE       256
+
 gboolean
 log_msg_serialize(LogMessage *self, SerializeArchive *sa)
 {
-  guint8 version = 26;
   gint i = 0;
 
-  serialize_write_uint8(sa, version);
-  serialize_write_uint64(sa, self->rcptid);
+  /* the whole record is allocated once, the fields are stored in place */
+  serialize_archive_reserve(sa, LOGMSG_SERIALIZE_FIXED_SIZE + self->num_sdata * 5 +
+                                nv_table_get_payload_size(self->payload));
+  serialize_write_uint8(sa, LOGMSG_SERIALIZE_VERSION_COMPACT);
+  serialize_write_varint(sa, self->rcptid);
   g_assert(sizeof(self->flags) == 4);
   serialize_write_uint32(sa, self->flags & ~LF_STATE_MASK);
-  serialize_write_uint16(sa, self->pri);
+  serialize_write_varint(sa, self->pri);
   g_sockaddr_serialize(sa, self->saddr);
   timestamp_serialize(sa, self->timestamps);
   serialize_write_uint32(sa, self->host_id);
-  tags_serialize(self, sa);
+  tags_serialize_compact(self, sa);
   serialize_write_uint8(sa, self->initial_parse);
   serialize_write_uint8(sa, self->num_matches);
   serialize_write_uint8(sa, self->num_sdata);
-  serialize_write_uint8(sa, self->alloc_sdata);
   for (i = 0; i < self->num_sdata; i++)
-    serialize_write_uint32(sa, self->sdata[i]);
-  nv_table_serialize(sa, self->payload);
-  return TRUE;
+    serialize_write_varint(sa, self->sdata[i]);
+  nv_table_serialize_compact(sa, self->payload);
+  serialize_archive_flush(sa);
+  return sa->error == NULL;
 }
 
 static gboolean
@@ -103,16 +117,61 @@ _deserialize_sdata(LogMessage *self, SerializeArchive *sa)
 }
 
 static gboolean
-_deserialize_message(LogMessage *self, SerializeArchive *sa)
+_deserialize_sdata_compact(LogMessage *self, SerializeArchive *sa)
+{
+  gint i;
+
+  if (!serialize_read_uint8(sa, &self->num_sdata))
+    return FALSE;
+
+  self->alloc_sdata = self->num_sdata;
+  self->sdata = (NVHandle *) g_malloc0(sizeof(NVHandle) * self->alloc_sdata);
+
+  for (i = 0; i < self->num_sdata; i++)
+    {
+      if (!serialize_read_varint32(sa, (guint32 *)(&self->sdata[i])))
+        return FALSE;
+    }
+  return TRUE;
+}
+
+/* SDATA handles that had no corresponding value in the payload are mapped to 0 */
+static void
+_drop_unmapped_sdata(LogMessage *self)
+{
+  gint i, j;
+
+  for (i = 0, j = 0; i < self->num_sdata; i++)
+    {
+      if (self->sdata[i])
+        self->sdata[j++] = self->sdata[i];
+    }
+  self->num_sdata = j;
+}
+
+static gboolean
+_deserialize_message(LogMessage *self, SerializeArchive *sa, guint8 version)
 {
   guint8 initial_parse = 0;
+  guint32 pri;
 
-  if (!serialize_read_uint64(sa, &self->rcptid))
+  if (version == LOGMSG_SERIALIZE_VERSION_COMPACT)
+    {
+      if (!serialize_read_varint(sa, &self->rcptid))
+        return FALSE;
+    }
+  else if (!serialize_read_uint64(sa, &self->rcptid))
      return FALSE;
   if (!serialize_read_uint32(sa, &self->flags))
      return FALSE;
   self->flags |= LF_STATE_MASK;
-  if (!serialize_read_uint16(sa, &self->pri))
+  if (version == LOGMSG_SERIALIZE_VERSION_COMPACT)
+    {
+      if (!serialize_read_varint32(sa, &pri) || pri > G_MAXUINT16)
+        return FALSE;
+      self->pri = pri;
+    }
+  else if (!serialize_read_uint16(sa, &self->pri))
      return FALSE;
   if (!g_sockaddr_deserialize(sa, &self->saddr))
      return FALSE;
@@ -121,7 +180,12 @@ _deserialize_message(LogMessage *self, SerializeArchive *sa)
   if (!serialize_read_uint32(sa, &self->host_id))
     return FALSE;
 
-  if (!tags_deserialize(self, sa))
+  if (version == LOGMSG_SERIALIZE_VERSION_COMPACT)
+    {
+      if (!tags_deserialize_compact(self, sa))
+        return FALSE;
+    }
+  else if (!tags_deserialize(self, sa))
     return FALSE;
 
   if (!serialize_read_uint8(sa, &initial_parse))
@@ -131,6 +195,20 @@ _deserialize_message(LogMessage *self, SerializeArchive *sa)
   if (!serialize_read_uint8(sa, &self->num_matches))
     return FALSE;
 
+  if (version == LOGMSG_SERIALIZE_VERSION_COMPACT)
+    {
+      if (!_deserialize_sdata_compact(self, sa))
+        return FALSE;
+
+      nv_table_unref(self->payload);
+      self->payload = nv_table_deserialize_compact(sa, logmsg_registry, self->sdata, self->num_sdata);
+      if (!self->payload)
+        return FALSE;
+
+      _drop_unmapped_sdata(self);
+      return TRUE;
+    }
+
   if (!_deserialize_sdata(self, sa))
     return FALSE;
 
@@ -144,16 +222,14 @@ _deserialize_message(LogMessage *self, SerializeArchive *sa)
 }
 
 static gboolean
-_check_msg_version(SerializeArchive *sa)
+_check_msg_version(SerializeArchive *sa, guint8 *version)
 {
-  guint8 version;
-
-  if (!serialize_read_uint8(sa, &version))
+  if (!serialize_read_uint8(sa, version))
     return FALSE;
-  if (version != 26)
+  if (*version != LOGMSG_SERIALIZE_VERSION_NVT2 && *version != LOGMSG_SERIALIZE_VERSION_COMPACT)
     {
       msg_error("Error deserializing log message, unsupported version",
-          evt_tag_int("version", version),
+          evt_tag_int("version", *version),
           NULL);
       return FALSE;
     }
@@ -163,9 +239,11 @@ _check_msg_version(SerializeArchive *sa)
 gboolean
 log_msg_deserialize(LogMessage *self, SerializeArchive *sa)
 {
-  if (!_check_msg_version(sa))
+  guint8 version;
+
+  if (!_check_msg_version(sa, &version))
     {
       return FALSE;
     }
-  return _deserialize_message(self, sa);
+  return _deserialize_message(self, sa, version);
 }
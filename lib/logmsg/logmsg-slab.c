@@ -0,0 +1,391 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logmsg/logmsg-slab.h"
+#include "tls-support.h"
+#include "memprof.h"
+
+#include <string.h>
+
+/*
+ * Per-thread LogMessage/NVTable chunk cache
+ *
+ * LogMessage instances (along with their embedded initial NVTable) are
+ * allocated in the source thread and are usually freed in one of the
+ * destination threads.  With a general purpose allocator this means that
+ * malloc() and free() contend for the same arena lock from different
+ * threads at very high rates.
+ *
+ * This module implements a simple magazine style cache on top of
+ * g_malloc():
+ *
+ *   - allocations up to LOG_MSG_SLAB_MAX_SIZE are rounded up to a
+ *     power-of-two size class
+ *
+ *   - each thread has its own LogMsgSlabCache, with one free list for
+ *     every size class, which is accessed without locking
+ *
+ *   - every chunk remembers the cache it was allocated from, if it is
+ *     freed in the same thread, it goes back to the local free list,
+ *     otherwise it is pushed to a lock-free "remote" stack of the
+ *     originating cache (a single CAS)
+ *
+ *   - the owner takes over the whole remote stack with a single atomic
+ *     exchange once its local free list becomes empty
+ *
+ * When a thread exits, its cache is put on an orphan list and is reused by
+ * the next thread that starts up, this way chunks still in flight always
+ * have a valid cache to be returned to.
+ */
+
+#define LOG_MSG_SLAB_MIN_SHIFT        9
+#define LOG_MSG_SLAB_NUM_CLASSES      4
+#define LOG_MSG_SLAB_MAX_SIZE         (1 << (LOG_MSG_SLAB_MIN_SHIFT + LOG_MSG_SLAB_NUM_CLASSES - 1))
+
+/* maximum number of free chunks kept per size class & thread */
+#define LOG_MSG_SLAB_MAGAZINE_SIZE    256
+
+typedef struct _LogMsgSlabCache LogMsgSlabCache;
+typedef struct _LogMsgSlabChunk LogMsgSlabChunk;
+
+struct _LogMsgSlabChunk
+{
+  /* the cache that allocated this chunk, NULL if it came directly from g_malloc() */
+  LogMsgSlabCache *owner;
+  gsize capacity;
+  union
+  {
+    /* only valid while the chunk is on one of the free lists */
+    LogMsgSlabChunk *next;
+    guint64 __dummy_for_alignment;
+    gchar data[0];
+  };
+};
+
+#define LOG_MSG_SLAB_CHUNK_HDR ((gsize) (&((LogMsgSlabChunk *) NULL)->data))
+
+struct _LogMsgSlabCache
+{
+  LogMsgSlabChunk *free_chunks[LOG_MSG_SLAB_NUM_CLASSES];
+  gint num_free_chunks[LOG_MSG_SLAB_NUM_CLASSES];
+
+  /* chunks freed by other threads, LogMsgSlabChunk pointers, accessed atomically */
+  gpointer remote_chunks[LOG_MSG_SLAB_NUM_CLASSES];
+
+  LogMsgSlabCache *next_orphan;
+};
+
+TLS_BLOCK_START
+{
+  LogMsgSlabCache *slab_cache;
+}
+TLS_BLOCK_END;
+
+#define local_slab_cache  __tls_deref(slab_cache)
+
+static gboolean log_msg_slab_enabled = FALSE;
+static GStaticMutex log_msg_slab_orphan_lock = G_STATIC_MUTEX_INIT;
+static LogMsgSlabCache *log_msg_slab_orphans;
+
+static inline gint
+_size_to_class(gsize size)
+{
+  gint size_class = 0;
+
+  while ((((gsize) 1) << (LOG_MSG_SLAB_MIN_SHIFT + size_class)) < size)
+    size_class++;
+  return size_class;
+}
+
+static inline gsize
+_class_to_size(gint size_class)
+{
+  return ((gsize) 1) << (LOG_MSG_SLAB_MIN_SHIFT + size_class);
+}
+
+static inline LogMsgSlabChunk *
+_chunk_from_ptr(gpointer ptr)
+{
+  return (LogMsgSlabChunk *) (((gchar *) ptr) - LOG_MSG_SLAB_CHUNK_HDR);
+}
+
+static LogMsgSlabChunk *
+_chunk_new(gsize capacity, LogMsgSlabCache *owner)
+{
+  LogMsgSlabChunk *chunk;
+
+  chunk = g_malloc(LOG_MSG_SLAB_CHUNK_HDR + capacity);
+  chunk->owner = owner;
+  chunk->capacity = capacity;
+  return chunk;
+}
+
+static void
+_free_chunk_list(LogMsgSlabChunk *chunk)
+{
+  while (chunk)
+    {
+      LogMsgSlabChunk *next = chunk->next;
+
+      g_free(chunk);
+      chunk = next;
+    }
+}
+
+static void
+_push_remote_chunk(LogMsgSlabCache *cache, gint size_class, LogMsgSlabChunk *chunk)
+{
+  gpointer head;
+
+  do
+    {
+      head = g_atomic_pointer_get(&cache->remote_chunks[size_class]);
+      chunk->next = (LogMsgSlabChunk *) head;
+    }
+  while (!g_atomic_pointer_compare_and_exchange(&cache->remote_chunks[size_class], head, chunk));
+}
+
+static LogMsgSlabChunk *
+_grab_remote_chunks(LogMsgSlabCache *cache, gint size_class)
+{
+  gpointer head;
+
+  do
+    {
+      head = g_atomic_pointer_get(&cache->remote_chunks[size_class]);
+    }
+  while (head && !g_atomic_pointer_compare_and_exchange(&cache->remote_chunks[size_class], head, NULL));
+  return (LogMsgSlabChunk *) head;
+}
+
+/* move chunks returned by other threads to the local free list */
+static void
+_refill_from_remote(LogMsgSlabCache *cache, gint size_class)
+{
+  LogMsgSlabChunk *chunk = _grab_remote_chunks(cache, size_class);
+
+  while (chunk && cache->num_free_chunks[size_class] < LOG_MSG_SLAB_MAGAZINE_SIZE)
+    {
+      LogMsgSlabChunk *next = chunk->next;
+
+      chunk->next = cache->free_chunks[size_class];
+      cache->free_chunks[size_class] = chunk;
+      cache->num_free_chunks[size_class]++;
+      chunk = next;
+    }
+  _free_chunk_list(chunk);
+}
+
+static gpointer
+_slab_alloc(gsize size)
+{
+  LogMsgSlabCache *cache = local_slab_cache;
+  LogMsgSlabChunk *chunk;
+  gint size_class;
+
+  if (!log_msg_slab_enabled || !cache || size > LOG_MSG_SLAB_MAX_SIZE)
+    return _chunk_new(size, NULL)->data;
+
+  size_class = _size_to_class(size);
+  if (!cache->free_chunks[size_class])
+    _refill_from_remote(cache, size_class);
+
+  chunk = cache->free_chunks[size_class];
+  if (chunk)
+    {
+      cache->free_chunks[size_class] = chunk->next;
+      cache->num_free_chunks[size_class]--;
+      return chunk->data;
+    }
+  return _chunk_new(_class_to_size(size_class), cache)->data;
+}
+
+static void
+_slab_free(gpointer ptr)
+{
+  LogMsgSlabChunk *chunk;
+  LogMsgSlabCache *cache;
+  gint size_class;
+
+  chunk = _chunk_from_ptr(ptr);
+  cache = chunk->owner;
+  if (!cache)
+    {
+      g_free(chunk);
+      return;
+    }
+
+  size_class = _size_to_class(chunk->capacity);
+  if (cache != local_slab_cache)
+    {
+      _push_remote_chunk(cache, size_class, chunk);
+      return;
+    }
+
+  if (cache->num_free_chunks[size_class] >= LOG_MSG_SLAB_MAGAZINE_SIZE)
+    {
+      g_free(chunk);
+      return;
+    }
+  chunk->next = cache->free_chunks[size_class];
+  cache->free_chunks[size_class] = chunk;
+  cache->num_free_chunks[size_class]++;
+}
+
+gpointer
+log_msg_slab_alloc(gsize size)
+{
+  gpointer ptr = _slab_alloc(size);
+
+  memprof_record_alloc(ptr, size);
+  return ptr;
+}
+
+void
+log_msg_slab_free(gpointer ptr)
+{
+  if (!ptr)
+    return;
+
+  memprof_record_free(ptr);
+  _slab_free(ptr);
+}
+
+gpointer
+log_msg_slab_realloc(gpointer ptr, gsize size)
+{
+  LogMsgSlabChunk *chunk;
+  gpointer new_ptr;
+
+  if (!ptr)
+    return log_msg_slab_alloc(size);
+
+  chunk = _chunk_from_ptr(ptr);
+  if (size <= chunk->capacity)
+    return ptr;
+
+  memprof_record_free(ptr);
+  if (!chunk->owner)
+    {
+      chunk = g_realloc(chunk, LOG_MSG_SLAB_CHUNK_HDR + size);
+      chunk->capacity = size;
+      new_ptr = chunk->data;
+    }
+  else
+    {
+      new_ptr = _slab_alloc(size);
+      memcpy(new_ptr, ptr, chunk->capacity);
+      _slab_free(ptr);
+    }
+  memprof_record_alloc(new_ptr, size);
+  return new_ptr;
+}
+
+gsize
+log_msg_slab_get_usable_size(gpointer ptr)
+{
+  return _chunk_from_ptr(ptr)->capacity;
+}
+
+void
+log_msg_slab_set_enabled(gboolean enabled)
+{
+  log_msg_slab_enabled = enabled;
+}
+
+gboolean
+log_msg_slab_is_enabled(void)
+{
+  return log_msg_slab_enabled;
+}
+
+void
+log_msg_slab_thread_init(void)
+{
+  LogMsgSlabCache *cache;
+
+  if (local_slab_cache)
+    return;
+
+  g_static_mutex_lock(&log_msg_slab_orphan_lock);
+  cache = log_msg_slab_orphans;
+  if (cache)
+    log_msg_slab_orphans = cache->next_orphan;
+  g_static_mutex_unlock(&log_msg_slab_orphan_lock);
+
+  if (!cache)
+    cache = g_new0(LogMsgSlabCache, 1);
+  cache->next_orphan = NULL;
+  local_slab_cache = cache;
+}
+
+void
+log_msg_slab_thread_deinit(void)
+{
+  LogMsgSlabCache *cache = local_slab_cache;
+  gint i;
+
+  if (!cache)
+    return;
+
+  for (i = 0; i < LOG_MSG_SLAB_NUM_CLASSES; i++)
+    {
+      _free_chunk_list(cache->free_chunks[i]);
+      cache->free_chunks[i] = NULL;
+      cache->num_free_chunks[i] = 0;
+    }
+  local_slab_cache = NULL;
+
+  /* chunks allocated by this thread may still be in flight and will be
+   * pushed to the remote lists of this cache, so we can't free it, it
+   * will be adopted by the next thread instead */
+  g_static_mutex_lock(&log_msg_slab_orphan_lock);
+  cache->next_orphan = log_msg_slab_orphans;
+  log_msg_slab_orphans = cache;
+  g_static_mutex_unlock(&log_msg_slab_orphan_lock);
+}
+
+void
+log_msg_slab_global_init(void)
+{
+  log_msg_slab_thread_init();
+}
+
+void
+log_msg_slab_global_deinit(void)
+{
+  LogMsgSlabCache *cache;
+  gint i;
+
+  log_msg_slab_thread_deinit();
+
+  /* NOTE: the cache structures themselves are not freed, as messages
+   * referenced by leftover objects could still return chunks to them */
+  g_static_mutex_lock(&log_msg_slab_orphan_lock);
+  for (cache = log_msg_slab_orphans; cache; cache = cache->next_orphan)
+    {
+      for (i = 0; i < LOG_MSG_SLAB_NUM_CLASSES; i++)
+        _free_chunk_list(_grab_remote_chunks(cache, i));
+    }
+  g_static_mutex_unlock(&log_msg_slab_orphan_lock);
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef LOGMSG_SLAB_H_INCLUDED
+#define LOGMSG_SLAB_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/*
+ * Per-thread chunk cache for LogMessage and NVTable allocations.
+ *
+ * Every chunk returned by log_msg_slab_alloc() carries a small header
+ * that records the thread cache it came from, so it has to be released
+ * using log_msg_slab_free(), regardless of whether the cache was enabled
+ * at allocation time or not.
+ */
+
+gpointer log_msg_slab_alloc(gsize size);
+gpointer log_msg_slab_realloc(gpointer ptr, gsize size);
+void log_msg_slab_free(gpointer ptr);
+gsize log_msg_slab_get_usable_size(gpointer ptr);
+
+void log_msg_slab_set_enabled(gboolean enabled);
+gboolean log_msg_slab_is_enabled(void);
+
+void log_msg_slab_thread_init(void);
+void log_msg_slab_thread_deinit(void);
+void log_msg_slab_global_init(void);
+void log_msg_slab_global_deinit(void);
+
+#endif
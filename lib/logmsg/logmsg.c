@@ -29,6 +29,7 @@
 #include "timeutils.h"
 #include "tags.h"
 #include "logmsg/nvtable.h"
+#include "logmsg/logmsg-slab.h"
 #include "stats/stats-registry.h"
 #include "template/templates.h"
 #include "tls-support.h"
@@ -37,6 +38,7 @@
 #include "template/macros.h"
 #include "lib/host-id.h"
 #include "ack_tracker.h"
+#include "usdt-probes.h"
 
 #include <sys/types.h>
 #include <time.h>
@@ -164,6 +166,28 @@ TLS_BLOCK_END;
  * LogMessage
  **********************************************************************/
 
+/*
+ * Compile time checks for the layout of struct _LogMessage, see the
+ * comment at its declaration.  A failing check results in a negative
+ * array size error.
+ */
+#define LOG_MSG_LAYOUT_CHECK(name, expr) typedef gchar log_msg_layout_check_ ## name[(expr) ? 1 : -1] G_GNUC_UNUSED
+
+#define LOG_MSG_CACHELINE_SIZE 64
+
+#define LOG_MSG_FIELD_END(field) (G_STRUCT_OFFSET(LogMessage, field) + sizeof(((LogMessage *) NULL)->field))
+
+LOG_MSG_LAYOUT_CHECK(small_counters_follow_the_refcounter,
+                     G_STRUCT_OFFSET(LogMessage, protect_cnt) < sizeof(gpointer));
+
+#if GLIB_SIZEOF_VOID_P == 8
+LOG_MSG_LAYOUT_CHECK(hot_fields_are_in_the_first_cacheline,
+                     LOG_MSG_FIELD_END(host_id) <= LOG_MSG_CACHELINE_SIZE);
+LOG_MSG_LAYOUT_CHECK(header_fits_two_cachelines,
+                     sizeof(LogMessage) <= 2 * LOG_MSG_CACHELINE_SIZE);
+#endif
+
+
 static inline gboolean
 log_msg_chk_flag(const LogMessage *self, gint32 flag)
 {
@@ -213,10 +237,17 @@ static StatsCounterItem *count_payload_reallocs;
 static StatsCounterItem *count_sdata_updates;
 static GStaticPrivate priv_macro_value = G_STATIC_PRIVATE_INIT;
 
-static inline gboolean
-log_msg_is_write_protected(const LogMessage *self)
+static void
+log_msg_clear_cached_values(LogMessage *self)
 {
-  return self->protect_cnt > 0;
+  LogMessageCachedValue *value, *next;
+
+  for (value = self->cached_values; value; value = next)
+    {
+      next = value->next;
+      value->free_fn(value);
+    }
+  self->cached_values = NULL;
 }
 
 void
@@ -229,6 +260,38 @@ void
 log_msg_write_unprotect(LogMessage *self)
 {
   self->protect_cnt--;
+
+  /* the message may be changed from now on, values derived from it
+   * cannot be trusted anymore */
+  if (self->protect_cnt == 0)
+    log_msg_clear_cached_values(self);
+}
+
+/*
+ * Attach a value derived from the message contents so that other
+ * consumers of the same message (e.g. destinations in parallel threads)
+ * can reuse it. As a write protected message cannot change, this is only
+ * possible for write protected messages,  the value is released when the
+ * message is freed.
+ *
+ * Entries are only ever prepended, so readers walking the list returned by
+ * log_msg_get_cached_values() need no locking.
+ *
+ * Returns FALSE if the value was not added, the caller retains ownership
+ * in that case.
+ */
+gboolean
+log_msg_add_cached_value(LogMessage *self, LogMessageCachedValue *value)
+{
+  if (!log_msg_is_write_protected(self))
+    return FALSE;
+
+  do
+    {
+      value->next = log_msg_get_cached_values(self);
+    }
+  while (!g_atomic_pointer_compare_and_exchange((gpointer *) &self->cached_values, value->next, value));
+  return TRUE;
 }
 
 LogMessage *
@@ -287,7 +350,7 @@ log_msg_update_sdata_slow(LogMessage *self, NVHandle handle, const gchar *name,
       sdata = g_malloc(alloc_sdata * sizeof(self->sdata[0]));
       if (self->num_sdata)
         memcpy(sdata, self->sdata, self->num_sdata * sizeof(self->sdata[0]));
-      memset(&sdata[self->num_sdata], 0, sizeof(self->sdata[0]) * (self->alloc_sdata - self->num_sdata));
+      memset(&sdata[self->num_sdata], 0, sizeof(self->sdata[0]) * (alloc_sdata - self->num_sdata));
       self->sdata = sdata;
       log_msg_set_flag(self, LF_STATE_OWN_SDATA);
     }
@@ -442,6 +505,7 @@ log_msg_init_queue_node(LogMessage *msg, LogMessageQueueNode *node, const LogPat
   INIT_IV_LIST_HEAD(&node->list);
   node->ack_needed = path_options->ack_needed;
   node->flow_control_requested = path_options->flow_control_requested;
+  node->memory_size = 0;
   node->msg = log_msg_ref(msg);
   log_msg_write_protect(msg);
 }
@@ -696,6 +760,26 @@ log_msg_get_bit(gulong *tags, gint index_)
   return !!(tags[index_ >> LOGMSG_TAGS_NDX_SHIFT] & ((gulong) (1UL << (index_ & LOGMSG_TAGS_NDX_MASK))));
 }
 
+/*
+ * Take a private copy of a tags array borrowed from our "original", sized
+ * so that @id fits, which saves a realloc() right after the copy.
+ */
+static void
+log_msg_tags_unshare(LogMessage *self, LogTagId id)
+{
+  gint num_tags = MAX(self->num_tags, (id / LOGMSG_TAGS_BITS) + 1);
+  gulong *tags;
+
+  if (G_UNLIKELY(8159 < id))
+    num_tags = self->num_tags;
+
+  tags = g_malloc(sizeof(tags[0]) * num_tags);
+  memcpy(tags, self->tags, sizeof(tags[0]) * self->num_tags);
+  memset(&tags[self->num_tags], 0, (num_tags - self->num_tags) * sizeof(tags[0]));
+  self->tags = tags;
+  self->num_tags = num_tags;
+}
+
 void
 log_msg_set_tag_by_id_onoff(LogMessage *self, LogTagId id, gboolean on)
 {
@@ -706,7 +790,11 @@ log_msg_set_tag_by_id_onoff(LogMessage *self, LogTagId id, gboolean on)
   g_assert(!log_msg_is_write_protected(self));
   if (!log_msg_chk_flag(self, LF_STATE_OWN_TAGS) && self->num_tags)
     {
-      self->tags = g_memdup(self->tags, sizeof(self->tags[0]) * self->num_tags);
+      /* the array is shared with our original, don't copy it if it
+       * already has the bit in the requested state */
+      if (log_msg_is_tag_by_id(self, id) == !!on)
+        goto update_counters;
+      log_msg_tags_unshare(self, id);
     }
   log_msg_set_flag(self, LF_STATE_OWN_TAGS);
 
@@ -744,6 +832,8 @@ log_msg_set_tag_by_id_onoff(LogMessage *self, LogTagId id, gboolean on)
 
       log_msg_set_bit(self->tags, id, on);
     }
+
+update_counters:
   if (on)
     {
       log_tags_inc_counter(id);
@@ -794,6 +884,37 @@ log_msg_is_tag_by_id(LogMessage *self, LogTagId id)
     return FALSE;
 }
 
+/*
+ * Checks whether any of the tags in @mask is set.  @mask uses the layout of
+ * the tags bitmap of the message: tag N is bit (N % bits-in-gulong) of word
+ * (N / bits-in-gulong).
+ */
+gboolean
+log_msg_is_any_tag_set(LogMessage *self, const gulong *mask, gint mask_words)
+{
+  gint i, num_words;
+  const gulong *tags;
+
+  if (self->num_tags == 0)
+    {
+      tags = (const gulong *) &self->tags;
+      num_words = 1;
+    }
+  else
+    {
+      tags = self->tags;
+      num_words = self->num_tags;
+    }
+
+  num_words = MIN(num_words, mask_words);
+  for (i = 0; i < num_words; i++)
+    {
+      if (tags[i] & mask[i])
+        return TRUE;
+    }
+  return FALSE;
+}
+
 gboolean
 log_msg_is_tag_by_name(LogMessage *self, const gchar *name)
 {
@@ -995,13 +1116,16 @@ log_msg_print_tags(const LogMessage *self, GString *result)
  * first. It is used internally by the log_msg_new function.
  **/
 static void
-log_msg_init(LogMessage *self, GSockAddr *saddr)
+log_msg_init_with_recvd(LogMessage *self, GSockAddr *saddr, const GTimeVal *recvd)
 {
   GTimeVal tv;
 
   /* ref is set to 1, ack is set to 0 */
   self->ack_and_ref_and_abort_and_suspended = LOGMSG_REFCACHE_REF_TO_VALUE(1);
-  cached_g_current_time(&tv);
+  if (recvd)
+    tv = *recvd;
+  else
+    cached_g_current_time(&tv);
   self->timestamps[LM_TS_RECVD].tv_sec = tv.tv_sec;
   self->timestamps[LM_TS_RECVD].tv_usec = tv.tv_usec;
   self->timestamps[LM_TS_RECVD].zone_offset = get_local_timezone_ofs(self->timestamps[LM_TS_RECVD].tv_sec);
@@ -1018,6 +1142,12 @@ log_msg_init(LogMessage *self, GSockAddr *saddr)
   log_msg_set_host_id(self);
 }
 
+static void
+log_msg_init(LogMessage *self, GSockAddr *saddr)
+{
+  log_msg_init_with_recvd(self, saddr, NULL);
+}
+
 void
 log_msg_clear(LogMessage *self)
 {
@@ -1057,6 +1187,7 @@ log_msg_clear(LogMessage *self)
       log_msg_unref(self->original);
       self->original = NULL;
     }
+  log_msg_clear_cached_values(self);
   self->flags |= LF_STATE_OWN_MASK;
 }
 
@@ -1078,14 +1209,19 @@ log_msg_alloc(gsize payload_size)
       payload_ofs = alloc_size;
       alloc_size += payload_space;
     }
-  msg = g_malloc(alloc_size);
+  msg = log_msg_slab_alloc(alloc_size);
 
   memset(msg, 0, sizeof(LogMessage));
 
   if (payload_size)
-    msg->payload = nv_table_init_borrowed(((gchar *) msg) + payload_ofs, payload_space, LM_V_MAX);
+    {
+      /* the allocator may round up the requested size, give the slack to the payload */
+      payload_space = MIN(log_msg_slab_get_usable_size(msg) - payload_ofs, NV_TABLE_MAX_BYTES);
+      msg->payload = nv_table_init_borrowed(((gchar *) msg) + payload_ofs, payload_space, LM_V_MAX);
+    }
 
   msg->num_nodes = nodes;
+  SYSLOG_NG_PROBE1(message__new, msg);
   return msg;
 }
 
@@ -1126,13 +1262,51 @@ log_msg_new(const gchar *msg, gint length,
             GSockAddr *saddr,
             MsgFormatOptions *parse_options)
 {
-  LogMessage *self = log_msg_alloc(length == 0 ? 256 : length * 2);
+  return log_msg_new_with_size_hint(msg, length, saddr, parse_options, 0);
+}
 
-  log_msg_init(self, saddr);
+/**
+ * log_msg_new_with_size_hint:
+ * @payload_size_hint: expected size of the payload once all parsing is
+ *                     done, 0 if unknown
+ *
+ * Same as log_msg_new(), but the payload is preallocated to at least
+ * @payload_size_hint bytes, so that values added later in the processing
+ * do not need to grow it.
+ **/
+LogMessage *
+log_msg_new_with_size_hint(const gchar *msg, gint length,
+                           GSockAddr *saddr,
+                           MsgFormatOptions *parse_options,
+                           gsize payload_size_hint)
+{
+  return log_msg_new_with_recvd(msg, length, saddr, parse_options, payload_size_hint, NULL);
+}
+
+/**
+ * log_msg_new_with_recvd:
+ * @recvd: the time the message was received, e.g. as reported by the
+ *         kernel, NULL to use the current time
+ *
+ * Same as log_msg_new_with_size_hint(), but with an explicit receive
+ * time, which is set before parsing, as parsers may fall back to it.
+ **/
+LogMessage *
+log_msg_new_with_recvd(const gchar *msg, gint length,
+                       GSockAddr *saddr,
+                       MsgFormatOptions *parse_options,
+                       gsize payload_size_hint,
+                       const GTimeVal *recvd)
+{
+  gsize payload_size = length == 0 ? 256 : length * 2;
+  LogMessage *self = log_msg_alloc(MIN(MAX(payload_size, payload_size_hint), NV_TABLE_MAX_BYTES));
+
+  log_msg_init_with_recvd(self, saddr, recvd);
 
   if (G_LIKELY(parse_options->format_handler))
     {
       parse_options->format_handler->parse(parse_options, (guchar *) msg, length, self);
+      SYSLOG_NG_PROBE2(message__parsed, self, length);
     }
   else
     {
@@ -1150,6 +1324,20 @@ log_msg_new_empty(void)
   return self;
 }
 
+/*
+ * Same as log_msg_new_empty(), but the payload is preallocated to at
+ * least @payload_size_hint bytes, for messages that are known to be
+ * filled with a larger set of values.
+ */
+LogMessage *
+log_msg_new_empty_with_size_hint(gsize payload_size_hint)
+{
+  LogMessage *self = log_msg_alloc(MIN(MAX(payload_size_hint, 256), NV_TABLE_MAX_BYTES));
+
+  log_msg_init(self, NULL);
+  return self;
+}
+
 static void
 log_msg_clone_ack(LogMessage *msg, AckType ack_type)
 {
@@ -1191,6 +1379,7 @@ log_msg_clone_cow(LogMessage *msg, const LogPathOptions *path_options)
   self->ack_and_ref_and_abort_and_suspended = LOGMSG_REFCACHE_REF_TO_VALUE(1) + LOGMSG_REFCACHE_ACK_TO_VALUE(0) + LOGMSG_REFCACHE_ABORT_TO_VALUE(0);
   self->cur_node = 0;
   self->protect_cnt = 0;
+  self->cached_values = NULL;
 
   log_msg_add_ack(self, path_options);
   if (!path_options->ack_needed)
@@ -1274,7 +1463,8 @@ log_msg_free(LogMessage *self)
   if (self->original)
     log_msg_unref(self->original);
 
-  g_free(self);
+  log_msg_clear_cached_values(self);
+  log_msg_slab_free(self);
 }
 
 /**
@@ -1311,6 +1501,18 @@ _ack_and_ref_and_abort_and_suspend_to_acktype(gint value)
  * of this file about ref/ack handling is strongly recommended.
  ***************************************************************************************/
 
+static inline gint
+log_msg_calc_ack_and_ref_and_abort_and_suspended(gint old_value, gint add_ref, gint add_ack, gint add_abort, gint add_suspend)
+{
+  gint new_value = old_value;
+
+  new_value = (new_value & ~LOGMSG_REFCACHE_REF_MASK)   + LOGMSG_REFCACHE_REF_TO_VALUE(  (LOGMSG_REFCACHE_VALUE_TO_REF(old_value)   + add_ref));
+  new_value = (new_value & ~LOGMSG_REFCACHE_ACK_MASK)   + LOGMSG_REFCACHE_ACK_TO_VALUE(  (LOGMSG_REFCACHE_VALUE_TO_ACK(old_value)   + add_ack));
+  new_value = (new_value & ~LOGMSG_REFCACHE_ABORT_MASK) + LOGMSG_REFCACHE_ABORT_TO_VALUE((LOGMSG_REFCACHE_VALUE_TO_ABORT(old_value) | add_abort));
+  new_value = (new_value & ~LOGMSG_REFCACHE_SUSPEND_MASK) + LOGMSG_REFCACHE_SUSPEND_TO_VALUE((LOGMSG_REFCACHE_VALUE_TO_SUSPEND(old_value) | add_suspend));
+  return new_value;
+}
+
 /* Function to update the combined ACK (with the abort flag) and REF counter. */
 static inline gint
 log_msg_update_ack_and_ref_and_abort_and_suspended(LogMessage *self, gint add_ref, gint add_ack, gint add_abort, gint add_suspend)
@@ -1318,11 +1520,8 @@ log_msg_update_ack_and_ref_and_abort_and_suspended(LogMessage *self, gint add_re
   gint old_value, new_value;
   do
     {
-      new_value = old_value = (volatile gint) self->ack_and_ref_and_abort_and_suspended;
-      new_value = (new_value & ~LOGMSG_REFCACHE_REF_MASK)   + LOGMSG_REFCACHE_REF_TO_VALUE(  (LOGMSG_REFCACHE_VALUE_TO_REF(old_value)   + add_ref));
-      new_value = (new_value & ~LOGMSG_REFCACHE_ACK_MASK)   + LOGMSG_REFCACHE_ACK_TO_VALUE(  (LOGMSG_REFCACHE_VALUE_TO_ACK(old_value)   + add_ack));
-      new_value = (new_value & ~LOGMSG_REFCACHE_ABORT_MASK) + LOGMSG_REFCACHE_ABORT_TO_VALUE((LOGMSG_REFCACHE_VALUE_TO_ABORT(old_value) | add_abort));
-      new_value = (new_value & ~LOGMSG_REFCACHE_SUSPEND_MASK) + LOGMSG_REFCACHE_SUSPEND_TO_VALUE((LOGMSG_REFCACHE_VALUE_TO_SUSPEND(old_value) | add_suspend));
+      old_value = (volatile gint) self->ack_and_ref_and_abort_and_suspended;
+      new_value = log_msg_calc_ack_and_ref_and_abort_and_suspended(old_value, add_ref, add_ack, add_abort, add_suspend);
     }
   while (!g_atomic_int_compare_and_exchange(&self->ack_and_ref_and_abort_and_suspended, old_value, new_value));
 
@@ -1455,6 +1654,166 @@ log_msg_ack(LogMessage *self, const LogPathOptions *path_options, AckType ack_ty
     }
 }
 
+/*
+ * Batched ack/unref support
+ *
+ * Queues release their backlog in bulk once a destination confirms
+ * delivery, which means an ack and an unref for every message, both CAS
+ * loops on the same counter, and if the message is a clone, another ack on
+ * its original.  log_msg_drop_batch() reduces this to:
+ *
+ *   - a single CAS per message: ref and ack are dropped together unless
+ *     this is the last ack, in which case our ref is kept so that the ack
+ *     callback can run safely, and the message is freed without another
+ *     atomic operation if we are the only owner afterwards
+ *
+ *   - a single CAS per run of clones sharing the same original: the acks
+ *     they would propagate are summed up and applied in one step, the first
+ *     clone of the run is kept alive (and with it the original) until then
+ */
+
+typedef struct _LogMsgAckBatch
+{
+  /* clone kept alive until the batch is flushed, it holds a ref to @original */
+  LogMessage *holder;
+  LogMessage *original;
+  gint acks;
+  gboolean abort;
+  gboolean suspend;
+} LogMsgAckBatch;
+
+/* drop a reference that was kept across an ack callback */
+static inline void
+log_msg_unref_after_ack(LogMessage *self)
+{
+  /* nobody else can change the ref counter if we are the sole owner */
+  if (LOGMSG_REFCACHE_VALUE_TO_REF(g_atomic_int_get(&self->ack_and_ref_and_abort_and_suspended)) == 1)
+    log_msg_free(self);
+  else
+    log_msg_unref(self);
+}
+
+static void
+log_msg_ack_many(LogMessage *self, gint num_acks, gboolean abort, gboolean suspend)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  AckType ack_type;
+  gint old_value;
+
+  if (G_UNLIKELY(logmsg_current == self))
+    {
+      /* ack processing of @self is cached, take the ordinary route */
+      path_options.ack_needed = TRUE;
+      ack_type = suspend ? AT_SUSPENDED : (abort ? AT_ABORTED : AT_PROCESSED);
+      while (num_acks--)
+        log_msg_ack(self, &path_options, ack_type);
+      return;
+    }
+
+  old_value = log_msg_update_ack_and_ref_and_abort_and_suspended(self, 0, -num_acks, abort, suspend);
+  if (LOGMSG_REFCACHE_VALUE_TO_ACK(old_value) == num_acks)
+    {
+      ack_type = _ack_and_ref_and_abort_and_suspend_to_acktype(old_value);
+      if (suspend)
+        ack_type = AT_SUSPENDED;
+      else if (abort)
+        ack_type = AT_ABORTED;
+      self->ack_func(self, ack_type);
+    }
+}
+
+static void
+log_msg_ack_batch_flush(LogMsgAckBatch *batch)
+{
+  if (!batch->original)
+    return;
+
+  log_msg_ack_many(batch->original, batch->acks, batch->abort, batch->suspend);
+  log_msg_unref_after_ack(batch->holder);
+  memset(batch, 0, sizeof(*batch));
+}
+
+/* returns TRUE if @self was consumed by @batch */
+static gboolean
+log_msg_ack_batch_add_clone(LogMsgAckBatch *batch, LogMessage *self, AckType ack_type)
+{
+  if (batch->original != self->original)
+    log_msg_ack_batch_flush(batch);
+
+  batch->acks++;
+  batch->abort |= IS_ACK_ABORTED(ack_type);
+  batch->suspend |= IS_ACK_SUSPENDED(ack_type);
+  if (batch->original)
+    return FALSE;
+
+  batch->original = self->original;
+  batch->holder = self;
+  return TRUE;
+}
+
+static void
+log_msg_drop_one_batched(LogMsgAckBatch *batch, LogMessage *self, gboolean ack_needed, AckType ack_type)
+{
+  gint old_value, new_value;
+  gboolean last_ack;
+
+  if (G_UNLIKELY(logmsg_current == self))
+    {
+      LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+      path_options.ack_needed = ack_needed;
+      log_msg_drop(self, &path_options, ack_type);
+      return;
+    }
+
+  do
+    {
+      old_value = (volatile gint) self->ack_and_ref_and_abort_and_suspended;
+      last_ack = ack_needed && LOGMSG_REFCACHE_VALUE_TO_ACK(old_value) == 1;
+      new_value = log_msg_calc_ack_and_ref_and_abort_and_suspended(old_value, last_ack ? 0 : -1, ack_needed ? -1 : 0,
+                                                                  IS_ACK_ABORTED(ack_type), IS_ACK_SUSPENDED(ack_type));
+    }
+  while (!g_atomic_int_compare_and_exchange(&self->ack_and_ref_and_abort_and_suspended, old_value, new_value));
+
+  if (!last_ack)
+    {
+      g_assert(LOGMSG_REFCACHE_VALUE_TO_REF(old_value) >= 1);
+      if (LOGMSG_REFCACHE_VALUE_TO_REF(old_value) == 1)
+        log_msg_free(self);
+      return;
+    }
+
+  /* we still hold our ref here */
+  /* aborts/suspends of earlier acks are recorded in the counter */
+  if (ack_type == AT_PROCESSED)
+    ack_type = _ack_and_ref_and_abort_and_suspend_to_acktype(old_value);
+
+  if (self->ack_func == log_msg_clone_ack)
+    {
+      if (log_msg_ack_batch_add_clone(batch, self, ack_type))
+        return;
+    }
+  else
+    self->ack_func(self, ack_type);
+  log_msg_unref_after_ack(self);
+}
+
+/*
+ * Ack and unref @num_msgs messages at once, equivalent to calling
+ * log_msg_drop() on each.  @ack_needed specifies for each message whether
+ * it needs to be acked.
+ */
+void
+log_msg_drop_batch(LogMessage **msgs, const gboolean *ack_needed, gint num_msgs, AckType ack_type)
+{
+  LogMsgAckBatch batch = { 0 };
+  gint i;
+
+  for (i = 0; i < num_msgs; i++)
+    log_msg_drop_one_batched(&batch, msgs[i], ack_needed[i], ack_type);
+  log_msg_ack_batch_flush(&batch);
+}
+
 /*
  * Break out of an acknowledgement chain. The incoming message is
  * ACKed and a new path options structure is returned that can be used
@@ -1675,6 +2034,7 @@ log_msg_registry_init(void)
       g_snprintf(buf, sizeof(buf), "%d", i);
       match_handles[i] = nv_registry_alloc_handle(logmsg_registry, buf);
     }
+  nv_registry_mark_builtin_handles(logmsg_registry);
 }
 
 void
@@ -1690,9 +2050,22 @@ log_msg_registry_foreach(GHFunc func, gpointer user_data)
   nv_registry_foreach(logmsg_registry, func, user_data);
 }
 
+void
+log_msg_registry_mark_config_handles(void)
+{
+  nv_registry_mark_config_handles(logmsg_registry);
+}
+
+void
+log_msg_registry_get_handle_counts(guint *builtin, guint *config, guint *runtime)
+{
+  nv_registry_get_handle_counts(logmsg_registry, builtin, config, runtime);
+}
+
 void
 log_msg_global_init(void)
 {
+  log_msg_slab_global_init();
   log_msg_registry_init();
   stats_lock();
   stats_register_counter(0, SCS_GLOBAL, "msg_clones", NULL, SC_TYPE_PROCESSED, &count_msg_clones);
@@ -1711,6 +2084,7 @@ void
 log_msg_global_deinit(void)
 {
   log_msg_registry_deinit();
+  log_msg_slab_global_deinit();
 }
 
 gint
@@ -69,6 +69,15 @@ typedef enum
   LM_TS_MAX
 } LogMessageTimeStamp;
 
+/* pipeline stages recorded in sampled messages, see stats/stats-trace.h */
+typedef enum
+{
+  LM_TRACE_POSTED = 0,
+  LM_TRACE_PARSED,
+  LM_TRACE_QUEUED,
+  LM_TRACE_MAX
+} LogMessageTraceStamp;
+
 /* builtin values */
 enum
 {
@@ -135,12 +144,27 @@ typedef struct _LogMessageQueueNode
   struct iv_list_head list;
   LogMessage *msg;
   gboolean ack_needed:1, embedded:1, flow_control_requested:1;
+  /* the memory accounted for this node, see log_queue_memory_usage_add() */
+  guint32 memory_size;
 } LogMessageQueueNode;
 
 
-/* NOTE: the members are ordered according to the presumed use frequency. 
- * The structure itself is 2 cachelines, the border is right after the "msg"
- * member */
+/* a value derived from a message (e.g. a formatted template), that can
+ * be reused as long as the message is write protected. */
+typedef struct _LogMessageCachedValue LogMessageCachedValue;
+struct _LogMessageCachedValue
+{
+  LogMessageCachedValue *next;
+  void (*free_fn)(LogMessageCachedValue *self);
+};
+
+/* NOTE: the members are ordered according to their use frequency on the
+ * fast path (ref/ack, value lookups, tags).  On 64 bit platforms the
+ * structure is less than 2 cachelines, the first one ends right after
+ * "host_id", everything that is needed to look up a value and to ref/ack
+ * the message is in that first cacheline.  The layout is verified by
+ * compile time checks in logmsg.c, please update those if you move fields
+ * around. */
 struct _LogMessage
 {
   /* if you change any of the fields here, be sure to adjust
@@ -152,14 +176,13 @@ struct _LogMessage
    * a lot of magic behind its implementation.  See the logmsg.c file, around
    * log_msg_ref/unref.
    */
-
-  /* FIXME: the structure has holes, but right now it's 1 byte short to make
-   * it smaller (it is possible to create a 7 byte contiguos block but 8
-   * byte alignment is needed. Let's check this with the inline-tags stuff */
-
   gint ack_and_ref_and_abort_and_suspended;
 
-  AckRecord *ack_record;
+  /* these fit into the 4 bytes following the 32 bit ack/ref counter */
+  guint8 num_nodes;
+  guint8 cur_node;
+  guint8 protect_cnt;
+
   LMAckFunc ack_func;
   LogMessage *original;
 
@@ -171,14 +194,10 @@ struct _LogMessage
    * correctly.
    */
   /* ==== start of directly copied part ==== */
-  LogStamp timestamps[LM_TS_MAX];
-  guint32 host_id;
+  NVTable *payload;
   gulong *tags;
   NVHandle *sdata;
 
-  GSockAddr *saddr;
-  NVTable *payload;
-
   guint32 flags;
   guint16 pri;
   guint8 initial_parse:1,
@@ -187,13 +206,20 @@ struct _LogMessage
   guint8 num_tags;
   guint8 alloc_sdata;
   guint8 num_sdata;
-  /* ==== end of directly copied part ==== */
+  guint32 host_id;
 
-  guint8 num_nodes;
-  guint8 cur_node;
-  guint8 protect_cnt;
+  /* second cacheline */
+  GSockAddr *saddr;
+  LogStamp timestamps[LM_TS_MAX];
+  /* usec timestamps of the pipeline stages, all zero unless the message
+   * was sampled for tracing */
+  gint64 trace_stamps[LM_TRACE_MAX];
+  /* ==== end of directly copied part ==== */
 
+  AckRecord *ack_record;
   guint64 rcptid;
+  /* see log_msg_add_cached_value() */
+  LogMessageCachedValue *cached_values;
 
   /* preallocated LogQueueNodes used to insert this message into a LogQueue */
   LogMessageQueueNode nodes[0];
@@ -210,6 +236,20 @@ LogMessage *log_msg_ref(LogMessage *m);
 void log_msg_unref(LogMessage *m);
 void log_msg_write_protect(LogMessage *m);
 void log_msg_write_unprotect(LogMessage *m);
+gboolean log_msg_add_cached_value(LogMessage *self, LogMessageCachedValue *value);
+
+static inline LogMessageCachedValue *
+log_msg_get_cached_values(LogMessage *self)
+{
+  return (LogMessageCachedValue *) g_atomic_pointer_get((gpointer *) &self->cached_values);
+}
+
+static inline gboolean
+log_msg_is_write_protected(const LogMessage *self)
+{
+  return self->protect_cnt > 0;
+}
+
 LogMessage *log_msg_clone_cow(LogMessage *msg, const LogPathOptions *path_options);
 LogMessage *log_msg_make_writable(LogMessage **pmsg, const LogPathOptions *path_options);
 
@@ -252,6 +292,12 @@ log_msg_get_value_by_name(const LogMessage *self, const gchar *name, gssize *val
   return log_msg_get_value(self, handle, value_len);
 }
 
+static inline gboolean
+log_msg_is_value_set(const LogMessage *self, NVHandle handle)
+{
+  return nv_table_is_value_set(self->payload, handle);
+}
+
 typedef gboolean (*LogMessageTagsForeachFunc)(const LogMessage *self, LogTagId tag_id, const gchar *name, gpointer user_data);
 
 void log_msg_set_value(LogMessage *self, NVHandle handle, const gchar *new_value, gssize length);
@@ -277,6 +323,7 @@ void log_msg_set_tag_by_name(LogMessage *self, const gchar *name);
 void log_msg_clear_tag_by_id(LogMessage *self, LogTagId id);
 void log_msg_clear_tag_by_name(LogMessage *self, const gchar *name);
 gboolean log_msg_is_tag_by_id(LogMessage *self, LogTagId id);
+gboolean log_msg_is_any_tag_set(LogMessage *self, const gulong *mask, gint mask_words);
 gboolean log_msg_is_tag_by_name(LogMessage *self, const gchar *name);
 void log_msg_tags_foreach(const LogMessage *self, LogMessageTagsForeachFunc callback, gpointer user_data);
 void log_msg_print_tags(const LogMessage *self, GString *result);
@@ -285,19 +332,37 @@ LogMessageQueueNode *log_msg_alloc_queue_node(LogMessage *msg, const LogPathOpti
 LogMessageQueueNode *log_msg_alloc_dynamic_queue_node(LogMessage *msg, const LogPathOptions *path_options);
 void log_msg_free_queue_node(LogMessageQueueNode *node);
 
+/* approximate memory footprint of the message, used for queue accounting */
+static inline gsize
+log_msg_get_memory_size(LogMessage *self)
+{
+  return sizeof(LogMessage) + (self->payload ? self->payload->size : 0);
+}
+
 void log_msg_clear(LogMessage *self);
 void log_msg_merge_context(LogMessage *self, LogMessage **context, gsize context_len);
 
 LogMessage *log_msg_new(const gchar *msg, gint length,
                         GSockAddr *saddr,
                         MsgFormatOptions *parse_options);
+LogMessage *log_msg_new_with_size_hint(const gchar *msg, gint length,
+                                       GSockAddr *saddr,
+                                       MsgFormatOptions *parse_options,
+                                       gsize payload_size_hint);
+LogMessage *log_msg_new_with_recvd(const gchar *msg, gint length,
+                                   GSockAddr *saddr,
+                                   MsgFormatOptions *parse_options,
+                                   gsize payload_size_hint,
+                                   const GTimeVal *recvd);
 LogMessage *log_msg_new_mark(void);
 LogMessage *log_msg_new_internal(gint prio, const gchar *msg);
 LogMessage *log_msg_new_empty(void);
+LogMessage *log_msg_new_empty_with_size_hint(gsize payload_size_hint);
 
 void log_msg_add_ack(LogMessage *msg, const LogPathOptions *path_options);
 void log_msg_ack(LogMessage *msg, const LogPathOptions *path_options, AckType ack_type);
 void log_msg_drop(LogMessage *msg, const LogPathOptions *path_options, AckType ack_type);
+void log_msg_drop_batch(LogMessage **msgs, const gboolean *ack_needed, gint num_msgs, AckType ack_type);
 const LogPathOptions *log_msg_break_ack(LogMessage *msg, const LogPathOptions *path_options, LogPathOptions *local_options);
 
 void log_msg_refcache_start_producer(LogMessage *self);
@@ -309,6 +374,8 @@ void log_msg_registry_deinit(void);
 void log_msg_global_init(void);
 void log_msg_global_deinit(void);
 void log_msg_registry_foreach(GHFunc func, gpointer user_data);
+void log_msg_registry_mark_config_handles(void);
+void log_msg_registry_get_handle_counts(guint *builtin, guint *config, guint *runtime);
 
 gint log_msg_lookup_time_stamp_name(const gchar *name);
 
@@ -30,6 +30,7 @@
 #include "string.h"
 #include "nvtable-serialize-endianutils.h"
 #include "logmsg/logmsg.h"
+#include "logmsg/logmsg-slab.h"
 
 #define NV_TABLE_MAGIC_V2  "NVT2"
 #define NVT_SF_BE           0x1
@@ -175,6 +176,7 @@ _update_dynamic_handles(NVTable *self, NVRegistry *logmsg_nv_registry,
   _copy_handles(handles_to_update, updated_handles, num_handles_to_update);
 
   qsort(dyn_entries, self->num_dyn_entries, sizeof(NVDynValue), _dyn_entry_cmp);
+  nv_table_rebuild_dyn_index(self);
   g_free(updated_handles);
 }
 
@@ -303,7 +305,7 @@ _read_header(SerializeArchive *sa, NVTable **nvtable)
 {
   g_assert(*nvtable == NULL);
 
-  NVTable *res = (NVTable *)g_malloc(sizeof(NVTable));
+  NVTable *res = (NVTable *)log_msg_slab_alloc(sizeof(NVTable));
   if (!serialize_read_uint32(sa, &res->size))
     {
       goto error;
@@ -321,15 +323,18 @@ _read_header(SerializeArchive *sa, NVTable **nvtable)
       goto error;
     }
 
-  res = (NVTable *)g_realloc(res, res->size);
+  res = (NVTable *)log_msg_slab_realloc(res, res->size);
   res->borrowed = FALSE;
   res->ref_cnt = 1;
+  /* the index is not part of the serialized format, it is rebuilt once the table is loaded */
+  res->dyn_index_size = 0;
+  res->__reserved = 0;
   *nvtable = res;
   return TRUE;
 
 error:
   if (res)
-    g_free(res);
+    log_msg_slab_free(res);
   return FALSE;
 }
 
@@ -370,11 +375,12 @@ nv_table_deserialize(SerializeArchive *sa)
       nv_table_data_swap_bytes(res);
     }
 
+  nv_table_rebuild_dyn_index(res);
   return res;
 
 error:
   if (res)
-    g_free(res);
+    log_msg_slab_free(res);
   return NULL;
 }
 
@@ -440,3 +446,259 @@ nv_table_serialize(SerializeArchive *sa, NVTable *self)
   _write_payload(sa, self);
   return TRUE;
 }
+
+/*
+ * Compact serialization format
+ *
+ * Unlike the NVT2 format above, which dumps the payload area as is
+ * (including fixed width offsets, alignment padding and the space occupied
+ * by values that were overwritten since), this one writes the name-value
+ * pairs one by one, using varints for handles and lengths:
+ *
+ *   "NVC1" || num_static || num_entries || payload_size || entries
+ *
+ *   entry: handle || flags || [name_len || name] || value_len || value
+ *   indirect entry: handle || flags || [name_len || name] || ref_handle || ofs || len || type
+ *
+ * Names are only written for dynamic values, their handles are allocated
+ * from the local registry when loading.  Direct values come first, so the
+ * targets of indirect values are already known when those are read.
+ */
+
+#define NV_TABLE_MAGIC_COMPACT  "NVC1"
+#define NVC_EF_INDIRECT         0x1
+
+typedef struct _NVTableCompactWriter
+{
+  SerializeArchive *sa;
+  NVTable *self;
+  gboolean indirect;
+  guint32 num_entries;
+  gsize payload_size;
+} NVTableCompactWriter;
+
+typedef struct _NVHandleMapping
+{
+  NVHandle old_handle;
+  NVHandle new_handle;
+} NVHandleMapping;
+
+static gboolean
+_compact_count_entry(NVHandle handle, NVEntry *entry, gpointer user_data)
+{
+  NVTableCompactWriter *writer = (NVTableCompactWriter *) user_data;
+
+  writer->num_entries++;
+  if (entry->indirect)
+    writer->payload_size += NV_TABLE_BOUND(NV_ENTRY_INDIRECT_HDR + entry->name_len + 1);
+  else
+    writer->payload_size += NV_TABLE_BOUND(NV_ENTRY_DIRECT_HDR + entry->name_len + entry->vdirect.value_len + 2);
+  return FALSE;
+}
+
+static gboolean
+_compact_write_entry(NVHandle handle, NVEntry *entry, gpointer user_data)
+{
+  NVTableCompactWriter *writer = (NVTableCompactWriter *) user_data;
+  SerializeArchive *sa = writer->sa;
+
+  if (!!entry->indirect != writer->indirect)
+    return FALSE;
+
+  serialize_write_varint(sa, handle);
+  serialize_write_uint8(sa, entry->indirect ? NVC_EF_INDIRECT : 0);
+  if (handle > writer->self->num_static_entries)
+    {
+      serialize_write_varint(sa, entry->name_len);
+      serialize_write_blob(sa, nv_entry_get_name(entry), entry->name_len);
+    }
+
+  if (entry->indirect)
+    {
+      serialize_write_varint(sa, entry->vindirect.handle);
+      serialize_write_varint(sa, entry->vindirect.ofs);
+      serialize_write_varint(sa, entry->vindirect.len);
+      serialize_write_uint8(sa, entry->vindirect.type);
+    }
+  else
+    {
+      serialize_write_varint(sa, entry->vdirect.value_len);
+      serialize_write_blob(sa, entry->vdirect.data + entry->name_len + 1, entry->vdirect.value_len);
+    }
+  return FALSE;
+}
+
+gboolean
+nv_table_serialize_compact(SerializeArchive *sa, NVTable *self)
+{
+  NVTableCompactWriter writer = { .sa = sa, .self = self };
+
+  nv_table_foreach_entry(self, _compact_count_entry, &writer);
+
+  serialize_write_blob(sa, NV_TABLE_MAGIC_COMPACT, 4);
+  serialize_write_varint(sa, self->num_static_entries);
+  serialize_write_varint(sa, writer.num_entries);
+  serialize_write_varint(sa, writer.payload_size);
+
+  writer.indirect = FALSE;
+  nv_table_foreach_entry(self, _compact_write_entry, &writer);
+  writer.indirect = TRUE;
+  nv_table_foreach_entry(self, _compact_write_entry, &writer);
+  return sa->error == NULL;
+}
+
+static NVHandle
+_compact_map_handle(GArray *mappings, NVHandle old_handle, guint8 num_static_entries)
+{
+  guint i;
+
+  if (old_handle <= num_static_entries)
+    return old_handle;
+
+  for (i = 0; i < mappings->len; i++)
+    {
+      NVHandleMapping *mapping = &g_array_index(mappings, NVHandleMapping, i);
+
+      if (mapping->old_handle == old_handle)
+        return mapping->new_handle;
+    }
+  return 0;
+}
+
+static gboolean
+_compact_store_value(NVTable **res, NVHandle handle, const gchar *name, gsize name_len,
+                     const gchar *value, gsize value_len)
+{
+  while (!nv_table_add_value(*res, handle, name, name_len, value, value_len, NULL))
+    {
+      if (!nv_table_realloc(*res, res))
+        return FALSE;
+    }
+  return TRUE;
+}
+
+static gboolean
+_compact_store_value_indirect(NVTable **res, NVHandle handle, const gchar *name, gsize name_len,
+                              NVHandle ref_handle, guint8 type, guint32 ofs, guint32 len)
+{
+  while (!nv_table_add_value_indirect(*res, handle, name, name_len, ref_handle, type, ofs, len, NULL))
+    {
+      if (!nv_table_realloc(*res, res))
+        return FALSE;
+    }
+  return TRUE;
+}
+
+static gboolean
+_compact_read_entry(SerializeArchive *sa, NVTable **res, NVRegistry *logmsg_nv_registry,
+                    GArray *mappings, GString *name, GString *value)
+{
+  guint32 handle, new_handle, name_len = 0;
+  guint8 flags;
+
+  if (!serialize_read_varint32(sa, &handle) ||
+      !serialize_read_uint8(sa, &flags))
+    return FALSE;
+
+  g_string_truncate(name, 0);
+  new_handle = handle;
+  if (handle > (*res)->num_static_entries)
+    {
+      NVHandleMapping mapping;
+
+      if (!serialize_read_varint32(sa, &name_len) || name_len > 255)
+        return FALSE;
+      g_string_set_size(name, name_len);
+      if (!serialize_read_blob(sa, name->str, name_len))
+        return FALSE;
+
+      new_handle = nv_registry_alloc_handle(logmsg_nv_registry, name->str);
+      if (!new_handle)
+        return FALSE;
+      mapping.old_handle = handle;
+      mapping.new_handle = new_handle;
+      g_array_append_val(mappings, mapping);
+    }
+  else if (handle == 0)
+    return FALSE;
+
+  if (flags & NVC_EF_INDIRECT)
+    {
+      guint32 ref_handle, ofs, len;
+      guint8 type;
+
+      if (!serialize_read_varint32(sa, &ref_handle) ||
+          !serialize_read_varint32(sa, &ofs) ||
+          !serialize_read_varint32(sa, &len) ||
+          !serialize_read_uint8(sa, &type))
+        return FALSE;
+
+      ref_handle = _compact_map_handle(mappings, ref_handle, (*res)->num_static_entries);
+      if (!ref_handle)
+        return FALSE;
+      return _compact_store_value_indirect(res, new_handle, name->str, name_len, ref_handle, type, ofs, len);
+    }
+  else
+    {
+      guint32 value_len;
+
+      if (!serialize_read_varint32(sa, &value_len) || value_len > NV_TABLE_MAX_BYTES)
+        return FALSE;
+      g_string_set_size(value, value_len);
+      if (!serialize_read_blob(sa, value->str, value_len))
+        return FALSE;
+      return _compact_store_value(res, new_handle, name->str, name_len, value->str, value_len);
+    }
+}
+
+NVTable *
+nv_table_deserialize_compact(SerializeArchive *sa, NVRegistry *logmsg_nv_registry,
+                             NVHandle *handles_to_update, guint8 num_handles_to_update)
+{
+  gchar magic[4];
+  guint32 num_static_entries, num_entries, payload_size, i;
+  NVTable *res = NULL;
+  GArray *mappings = NULL;
+  GString *name = NULL, *value = NULL;
+
+  if (!serialize_read_blob(sa, magic, 4) ||
+      memcmp(magic, NV_TABLE_MAGIC_COMPACT, 4) != 0)
+    return NULL;
+
+  if (!serialize_read_varint32(sa, &num_static_entries) ||
+      !serialize_read_varint32(sa, &num_entries) ||
+      !serialize_read_varint32(sa, &payload_size))
+    return NULL;
+
+  if (num_static_entries > 255 || num_entries > G_MAXUINT16 || payload_size > NV_TABLE_MAX_BYTES)
+    return NULL;
+
+  res = nv_table_new(num_static_entries, num_entries, payload_size);
+  mappings = g_array_sized_new(FALSE, FALSE, sizeof(NVHandleMapping), num_entries);
+  name = g_string_sized_new(64);
+  value = g_string_sized_new(256);
+
+  for (i = 0; i < num_entries; i++)
+    {
+      if (!_compact_read_entry(sa, &res, logmsg_nv_registry, mappings, name, value))
+        goto error;
+    }
+
+  for (i = 0; handles_to_update && i < num_handles_to_update; i++)
+    handles_to_update[i] = _compact_map_handle(mappings, handles_to_update[i], res->num_static_entries);
+
+  if (handles_to_update)
+    nv_table_foreach(res, logmsg_nv_registry, _update_sd_entries, NULL);
+
+  g_array_free(mappings, TRUE);
+  g_string_free(name, TRUE);
+  g_string_free(value, TRUE);
+  return res;
+
+error:
+  g_array_free(mappings, TRUE);
+  g_string_free(name, TRUE);
+  g_string_free(value, TRUE);
+  nv_table_unref(res);
+  return NULL;
+}
@@ -32,6 +32,9 @@
 
 NVTable *nv_table_deserialize(SerializeArchive *sa);
 gboolean nv_table_serialize(SerializeArchive *sa, NVTable *self);
+NVTable *nv_table_deserialize_compact(SerializeArchive *sa, NVRegistry *logmsg_nv_registry,
+                                      NVHandle *handles_to_update, guint8 num_handles_to_update);
+gboolean nv_table_serialize_compact(SerializeArchive *sa, NVTable *self);
 void nv_table_update_handles(NVTable *self, NVRegistry *logmsg_registry,
                          NVHandle *handles_to_update, guint8 num_handles_to_update);
 
@@ -22,6 +22,7 @@
  *
  */
 #include "logmsg/nvtable.h"
+#include "logmsg/logmsg-slab.h"
 #include "messages.h"
 
 #include <string.h>
@@ -31,15 +32,127 @@ GStaticMutex nv_registry_lock = G_STATIC_MUTEX_INIT;
 
 const gchar *null_string = "";
 
+/*
+ * Lock-free name lookup
+ *
+ * Name lookups happen on the fast path whenever a parser produces a name
+ * (e.g. JSON or kv keys), but names are only added rarely, so lookups go
+ * through an insert-only, open addressing hash table which can be read
+ * without locking:
+ *
+ *   - slots are filled in under nv_registry_lock, the name pointer is
+ *     published last, so a reader either sees an empty slot or a complete
+ *     entry
+ *
+ *   - once the table becomes half full, a new one with twice the size is
+ *     built and published with a single pointer store, the old one is
+ *     retired but kept until the registry is freed, as readers may still
+ *     be looking at it (its size is bounded by that of the live table)
+ *
+ * The names themselves are owned by name_map, which remains the
+ * authoritative copy.
+ */
+
+#define NV_REGISTRY_INDEX_INITIAL_SIZE 1024
+
+typedef struct _NVRegistryIndexEntry
+{
+  /* const gchar *, accessed atomically, NULL if the slot is empty */
+  gpointer name;
+  guint32 hash;
+  NVHandle handle;
+} NVRegistryIndexEntry;
+
+struct _NVRegistryIndex
+{
+  guint32 size;
+  guint32 num_entries;
+  NVRegistryIndexEntry entries[0];
+};
+
+static NVRegistryIndex *
+nv_registry_index_new(guint32 size)
+{
+  NVRegistryIndex *index;
+
+  index = g_malloc0(sizeof(NVRegistryIndex) + size * sizeof(NVRegistryIndexEntry));
+  index->size = size;
+  return index;
+}
+
+static NVRegistryIndexEntry *
+nv_registry_index_find_slot(NVRegistryIndex *index, const gchar *name, guint32 hash)
+{
+  guint32 mask = index->size - 1;
+  guint32 i = hash & mask;
+
+  while (1)
+    {
+      NVRegistryIndexEntry *entry = &index->entries[i];
+      const gchar *entry_name = (const gchar *) g_atomic_pointer_get(&entry->name);
+
+      if (!entry_name || (entry->hash == hash && strcmp(entry_name, name) == 0))
+        return entry;
+      i = (i + 1) & mask;
+    }
+}
+
+static NVHandle
+nv_registry_index_lookup(NVRegistry *self, const gchar *name)
+{
+  NVRegistryIndex *index = (NVRegistryIndex *) g_atomic_pointer_get(&self->index);
+  NVRegistryIndexEntry *entry;
+
+  entry = nv_registry_index_find_slot(index, name, g_str_hash(name));
+  if (!g_atomic_pointer_get(&entry->name))
+    return 0;
+  return entry->handle;
+}
+
+/* must be called with nv_registry_lock held */
+static void
+nv_registry_index_store(NVRegistryIndex *index, const gchar *name, guint32 hash, NVHandle handle)
+{
+  NVRegistryIndexEntry *entry = nv_registry_index_find_slot(index, name, hash);
+
+  entry->handle = handle;
+  if (!entry->name)
+    {
+      entry->hash = hash;
+      g_atomic_pointer_set(&entry->name, (gpointer) name);
+      index->num_entries++;
+    }
+}
+
+/* must be called with nv_registry_lock held, @name must be owned by name_map */
+static void
+nv_registry_index_insert(NVRegistry *self, const gchar *name, NVHandle handle)
+{
+  NVRegistryIndex *index = (NVRegistryIndex *) self->index;
+
+  if ((index->num_entries + 1) * 2 > index->size)
+    {
+      NVRegistryIndex *new_index = nv_registry_index_new(index->size * 2);
+      guint32 i;
+
+      for (i = 0; i < index->size; i++)
+        {
+          NVRegistryIndexEntry *entry = &index->entries[i];
+
+          if (entry->name)
+            nv_registry_index_store(new_index, entry->name, entry->hash, entry->handle);
+        }
+      g_atomic_pointer_set(&self->index, new_index);
+      self->retired_indexes = g_list_prepend(self->retired_indexes, index);
+      index = new_index;
+    }
+  nv_registry_index_store(index, name, g_str_hash(name), handle);
+}
+
 NVHandle
 nv_registry_get_handle(NVRegistry *self, const gchar *name)
 {
-  gpointer p;
-
-  p = g_hash_table_lookup(self->name_map, name);
-  if (p)
-    return GPOINTER_TO_UINT(p);
-  return 0;
+  return nv_registry_index_lookup(self, name);
 }
 
 NVHandle
@@ -50,6 +163,10 @@ nv_registry_alloc_handle(NVRegistry *self, const gchar *name)
   gsize len;
   NVHandle res = 0;
 
+  res = nv_registry_index_lookup(self, name);
+  if (res)
+    return res;
+
   g_static_mutex_lock(&nv_registry_lock);
   p = g_hash_table_lookup(self->name_map, name);
   if (p)
@@ -85,6 +202,7 @@ nv_registry_alloc_handle(NVRegistry *self, const gchar *name)
   g_array_append_val(self->names, stored);
   g_hash_table_insert(self->name_map, stored.name, GUINT_TO_POINTER(self->names->len));
   res = self->names->len;
+  nv_registry_index_insert(self, stored.name, res);
  exit:
   g_static_mutex_unlock(&nv_registry_lock);
   return res;
@@ -98,8 +216,13 @@ nv_registry_alloc_handle(NVRegistry *self, const gchar *name)
 void
 nv_registry_add_alias(NVRegistry *self, NVHandle handle, const gchar *alias)
 {
+  gpointer stored_alias;
+
   g_static_mutex_lock(&nv_registry_lock);
   g_hash_table_insert(self->name_map, g_strdup(alias), GUINT_TO_POINTER((glong) handle));
+  /* an already existing key is kept by g_hash_table_insert() */
+  g_hash_table_lookup_extended(self->name_map, alias, &stored_alias, NULL);
+  nv_registry_index_insert(self, stored_alias, handle);
   g_static_mutex_unlock(&nv_registry_lock);
 }
 
@@ -121,6 +244,44 @@ nv_registry_foreach(NVRegistry *self, GHFunc callback, gpointer user_data)
   g_hash_table_foreach(self->name_map, callback, user_data);
 }
 
+/*
+ * Handles allocated up to this point are considered to be built in: these
+ * are the ones registered by syslog-ng itself at startup.
+ */
+void
+nv_registry_mark_builtin_handles(NVRegistry *self)
+{
+  g_static_mutex_lock(&nv_registry_lock);
+  self->num_builtin_handles = self->names->len;
+  g_static_mutex_unlock(&nv_registry_lock);
+}
+
+/*
+ * Handles allocated up to this point are considered to be resolved at
+ * configuration time, everything allocated later was created at runtime,
+ * e.g. by parsers producing names that do not appear in the configuration.
+ */
+void
+nv_registry_mark_config_handles(NVRegistry *self)
+{
+  g_static_mutex_lock(&nv_registry_lock);
+  self->num_config_handles = self->names->len;
+  g_static_mutex_unlock(&nv_registry_lock);
+}
+
+void
+nv_registry_get_handle_counts(NVRegistry *self, guint *builtin, guint *config, guint *runtime)
+{
+  guint num_config_handles;
+
+  g_static_mutex_lock(&nv_registry_lock);
+  num_config_handles = MAX(self->num_config_handles, self->num_builtin_handles);
+  *builtin = self->num_builtin_handles;
+  *config = num_config_handles - self->num_builtin_handles;
+  *runtime = self->names->len - num_config_handles;
+  g_static_mutex_unlock(&nv_registry_lock);
+}
+
 NVRegistry *
 nv_registry_new(const gchar **static_names)
 {
@@ -129,6 +290,7 @@ nv_registry_new(const gchar **static_names)
 
   self->name_map = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
   self->names = g_array_new(FALSE, FALSE, sizeof(NVHandleDesc));
+  self->index = nv_registry_index_new(NV_REGISTRY_INDEX_INITIAL_SIZE);
   for (i = 0; static_names[i]; i++)
     {
       nv_registry_alloc_handle(self, static_names[i]);
@@ -139,6 +301,9 @@ nv_registry_new(const gchar **static_names)
 void
 nv_registry_free(NVRegistry *self)
 {
+  g_list_foreach(self->retired_indexes, (GFunc) g_free, NULL);
+  g_list_free(self->retired_indexes);
+  g_free(self->index);
   g_array_free(self->names, TRUE);
   g_hash_table_destroy(self->name_map);
   g_free(self);
@@ -152,11 +317,25 @@ nv_table_get_bottom(NVTable *self)
   return nv_table_get_top(self) - self->used;
 }
 
+static inline guint16 *
+nv_table_get_dyn_index(NVTable *self)
+{
+  return (guint16 *) &nv_table_get_dyn_entries(self)[self->num_dyn_entries];
+}
+
 static inline gchar *
 nv_table_get_ofs_table_top(NVTable *self)
 {
   return (gchar *) &self->data[self->num_static_entries * sizeof(self->static_entries[0]) +
-                               self->num_dyn_entries * sizeof(NVDynValue)];
+                               self->num_dyn_entries * sizeof(NVDynValue) +
+                               self->dyn_index_size * sizeof(guint16)];
+}
+
+/* size of the area that needs to be copied when a table is cloned: the struct, the offset tables & the index */
+static inline gsize
+nv_table_get_header_size(NVTable *self)
+{
+  return nv_table_get_ofs_table_top(self) - (gchar *) self;
 }
 
 static inline gboolean
@@ -167,6 +346,19 @@ nv_table_alloc_check(NVTable *self, gsize alloc_size)
   return TRUE;
 }
 
+/* the dynamic value index is only an accelerator, if we run out of space
+ * we rather drop it than fail the allocation */
+static inline gboolean
+nv_table_alloc_check_or_drop_index(NVTable *self, gsize alloc_size)
+{
+  if (nv_table_alloc_check(self, alloc_size))
+    return TRUE;
+  if (!self->dyn_index_size)
+    return FALSE;
+  self->dyn_index_size = 0;
+  return nv_table_alloc_check(self, alloc_size);
+}
+
 /* return the offset to a newly allocated payload string */
 static inline NVEntry *
 nv_table_alloc_value(NVTable *self, gsize alloc_size)
@@ -175,7 +367,7 @@ nv_table_alloc_value(NVTable *self, gsize alloc_size)
 
   alloc_size = NV_TABLE_BOUND(alloc_size);
   /* alloc error, NVTable should be realloced */
-  if (!nv_table_alloc_check(self, alloc_size))
+  if (!nv_table_alloc_check_or_drop_index(self, alloc_size))
     return NULL;
   self->used += alloc_size;
   entry = (NVEntry *) (nv_table_get_top(self) - (self->used));
@@ -220,6 +412,87 @@ nv_table_resolve_entry(NVTable *self, NVEntry *entry, gssize *length)
     return nv_table_resolve_indirect(self, entry, length);
 }
 
+static inline guint32
+nv_table_hash_handle(NVHandle handle)
+{
+  guint32 h = handle * 0x9E3779B1;
+
+  return h ^ (h >> 16);
+}
+
+static inline guint16
+nv_table_calc_dyn_index_size(gint num_dyn_entries)
+{
+  guint32 index_size = NV_TABLE_DYN_INDEX_THRESHOLD * 2;
+
+  if (num_dyn_entries < NV_TABLE_DYN_INDEX_THRESHOLD || num_dyn_entries > NV_TABLE_DYN_INDEX_MAX_ENTRIES)
+    return 0;
+
+  /* keep the load factor at or below 50% */
+  while (index_size < num_dyn_entries * 2)
+    index_size <<= 1;
+  return index_size;
+}
+
+static void
+nv_table_build_dyn_index(NVTable *self, guint16 index_size)
+{
+  NVDynValue *dyn_entries = nv_table_get_dyn_entries(self);
+  guint16 *dyn_index;
+  guint32 mask = index_size - 1;
+  gint i;
+
+  self->dyn_index_size = index_size;
+  if (!index_size)
+    return;
+
+  dyn_index = nv_table_get_dyn_index(self);
+  memset(dyn_index, 0xFF, index_size * sizeof(dyn_index[0]));
+  for (i = 0; i < self->num_dyn_entries; i++)
+    {
+      guint32 pos = nv_table_hash_handle(NV_TABLE_DYNVALUE_HANDLE(dyn_entries[i])) & mask;
+
+      while (dyn_index[pos] != NV_TABLE_DYN_INDEX_EMPTY)
+        pos = (pos + 1) & mask;
+      dyn_index[pos] = i;
+    }
+}
+
+/* recalculate the index from scratch, used after the dynamic value array
+ * was changed behind our back (e.g. when deserializing) */
+void
+nv_table_rebuild_dyn_index(NVTable *self)
+{
+  guint16 index_size = nv_table_calc_dyn_index_size(self->num_dyn_entries);
+
+  self->dyn_index_size = 0;
+  if (index_size && !nv_table_alloc_check(self, index_size * sizeof(guint16)))
+    index_size = 0;
+  nv_table_build_dyn_index(self, index_size);
+}
+
+static NVEntry *
+nv_table_get_entry_indexed(NVTable *self, NVHandle handle, NVDynValue **dyn_slot)
+{
+  NVDynValue *dyn_entries = nv_table_get_dyn_entries(self);
+  guint16 *dyn_index = nv_table_get_dyn_index(self);
+  guint32 mask = self->dyn_index_size - 1;
+  guint32 pos = nv_table_hash_handle(handle) & mask;
+  guint16 ndx;
+
+  while ((ndx = dyn_index[pos]) != NV_TABLE_DYN_INDEX_EMPTY)
+    {
+      if (NV_TABLE_DYNVALUE_HANDLE(dyn_entries[ndx]) == handle)
+        {
+          *dyn_slot = &dyn_entries[ndx];
+          return nv_table_get_entry_at_ofs(self, NV_TABLE_DYNVALUE_OFS(dyn_entries[ndx]));
+        }
+      pos = (pos + 1) & mask;
+    }
+  *dyn_slot = NULL;
+  return NULL;
+}
+
 NVEntry *
 nv_table_get_entry_slow(NVTable *self, NVHandle handle, NVDynValue **dyn_slot)
 {
@@ -234,6 +507,9 @@ nv_table_get_entry_slow(NVTable *self, NVHandle handle, NVDynValue **dyn_slot)
       return NULL;
     }
 
+  if (self->dyn_index_size)
+    return nv_table_get_entry_indexed(self, handle, dyn_slot);
+
   /* open-coded binary search */
   *dyn_slot = NULL;
   l = 0;
@@ -272,8 +548,9 @@ nv_table_reserve_table_entry(NVTable *self, NVHandle handle, NVDynValue **dyn_sl
       NVDynValue *dyn_entries = nv_table_get_dyn_entries(self);;
       gint l, h, m, ndx;
       gboolean found = FALSE;
+      guint16 new_index_size = self->dyn_index_size;
 
-      if (!nv_table_alloc_check(self, sizeof(dyn_entries[0])))
+      if (!nv_table_alloc_check_or_drop_index(self, sizeof(dyn_entries[0])))
         return FALSE;
 
       l = 0;
@@ -303,7 +580,18 @@ nv_table_reserve_table_entry(NVTable *self, NVHandle handle, NVDynValue **dyn_sl
         }
       /* if we find the proper slot we set that, if we don't, we insert a new entry */
       if (!found)
-        ndx = l;
+        {
+          ndx = l;
+
+          new_index_size = nv_table_calc_dyn_index_size(self->num_dyn_entries + 1);
+          if (new_index_size > self->dyn_index_size &&
+              !nv_table_alloc_check(self, sizeof(dyn_entries[0]) + (new_index_size - self->dyn_index_size) * sizeof(guint16)))
+            {
+              /* no space for a larger index, fall back to bisection
+               * until the table is grown */
+              new_index_size = 0;
+            }
+        }
 
       g_assert(ndx >= 0 && ndx <= self->num_dyn_entries);
       if (ndx < self->num_dyn_entries)
@@ -318,7 +606,10 @@ nv_table_reserve_table_entry(NVTable *self, NVHandle handle, NVDynValue **dyn_sl
       (**dyn_slot).handle = handle;
       (**dyn_slot).ofs    = 0;
       if (!found)
-        self->num_dyn_entries++;
+        {
+          self->num_dyn_entries++;
+          nv_table_build_dyn_index(self, new_index_size);
+        }
     }
   return TRUE;
 }
@@ -613,6 +904,7 @@ nv_table_clear(NVTable *self)
   g_assert(self->ref_cnt == 1);
   self->used = 0;
   self->num_dyn_entries = 0;
+  self->dyn_index_size = 0;
   memset(&self->static_entries[0], 0, self->num_static_entries * sizeof(self->static_entries[0]));
 }
 
@@ -626,6 +918,8 @@ nv_table_init(NVTable *self, gsize alloc_length, gint num_static_entries)
   self->num_static_entries = num_static_entries;
   self->ref_cnt = 1;
   self->borrowed = FALSE;
+  self->dyn_index_size = 0;
+  self->__reserved = 0;
   memset(&self->static_entries[0], 0, self->num_static_entries * sizeof(self->static_entries[0]));
 }
 
@@ -636,7 +930,7 @@ nv_table_new(gint num_static_entries, gint num_dyn_values, gint init_length)
   gsize alloc_length;
 
   alloc_length = nv_table_get_alloc_size(num_static_entries, num_dyn_values, init_length);
-  self = (NVTable *) g_malloc(alloc_length);
+  self = (NVTable *) log_msg_slab_alloc(alloc_length);
 
   nv_table_init(self, alloc_length, num_static_entries);
   return self;
@@ -670,7 +964,7 @@ nv_table_realloc(NVTable *self, NVTable **new)
 
   if (self->ref_cnt == 1 && !self->borrowed)
     {
-      *new = self = g_realloc(self, new_size);
+      *new = self = log_msg_slab_realloc(self, new_size);
 
       self->size = new_size;
       /* move the downwards growing region to the end of the new buffer */
@@ -680,10 +974,10 @@ nv_table_realloc(NVTable *self, NVTable **new)
     }
   else
     {
-      *new = g_malloc(new_size);
+      *new = log_msg_slab_alloc(new_size);
 
       /* we only copy the header first */
-      memcpy(*new, self, sizeof(NVTable) + self->num_static_entries * sizeof(self->static_entries[0]) + self->num_dyn_entries * sizeof(NVDynValue));
+      memcpy(*new, self, nv_table_get_header_size(self));
       (*new)->ref_cnt = 1;
       (*new)->borrowed = FALSE;
       (*new)->size = new_size;
@@ -709,7 +1003,7 @@ nv_table_unref(NVTable *self)
 {
   if ((--self->ref_cnt == 0) && !self->borrowed)
     {
-      g_free(self);
+      log_msg_slab_free(self);
     }
 }
 
@@ -734,8 +1028,8 @@ nv_table_clone(NVTable *self, gint additional_space)
   if (new_size > NV_TABLE_MAX_BYTES)
     new_size = NV_TABLE_MAX_BYTES;
 
-  new = g_malloc(new_size);
-  memcpy(new, self, sizeof(NVTable) + self->num_static_entries * sizeof(self->static_entries[0]) + self->num_dyn_entries * sizeof(NVDynValue));
+  new = log_msg_slab_alloc(new_size);
+  memcpy(new, self, nv_table_get_header_size(self));
   new->size = new_size;
   new->ref_cnt = 1;
   new->borrowed = FALSE;
@@ -49,12 +49,20 @@ struct _NVHandleDesc
   guint8 name_len;
 };
 
+typedef struct _NVRegistryIndex NVRegistryIndex;
+
 struct _NVRegistry
 {
   /* number of static names that are statically allocated in each payload */
   gint num_static_names;
   GArray *names;
   GHashTable *name_map;
+  /* lock-free lookup index of name_map, NVRegistryIndex, accessed atomically */
+  gpointer index;
+  GList *retired_indexes;
+  /* number of handles allocated before the corresponding nv_registry_mark_*() call */
+  guint32 num_builtin_handles;
+  guint32 num_config_handles;
 };
 
 extern const gchar *null_string;
@@ -64,6 +72,9 @@ NVHandle nv_registry_get_handle(NVRegistry *self, const gchar *name);
 NVHandle nv_registry_alloc_handle(NVRegistry *self, const gchar *name);
 void nv_registry_set_handle_flags(NVRegistry *self, NVHandle handle, guint16 flags);
 void nv_registry_foreach(NVRegistry *self, GHFunc callback, gpointer user_data);
+void nv_registry_mark_builtin_handles(NVRegistry *self);
+void nv_registry_mark_config_handles(NVRegistry *self);
+void nv_registry_get_handle_counts(NVRegistry *self, guint *builtin, guint *config, guint *runtime);
 NVRegistry *nv_registry_new(const gchar **static_names);
 void nv_registry_free(NVRegistry *self);
 
@@ -153,7 +164,7 @@ nv_entry_get_name(NVEntry *self)
  * Memory layout:
  * =============
  *
- *  || struct || static value offsets || dynamic value (id, offset) pairs || <free space> || stored (name, value)  ||
+ *  || struct || static value offsets || dynamic value (id, offset) pairs || dynamic value index || <free space> || stored (name, value)  ||
  *
  * Name value area:
  *   - the name-value area grows down (e.g. lower addresses) from the end of the struct
@@ -169,6 +180,17 @@ nv_entry_get_name(NVEntry *self)
  *   - a dynamically sized NVDynEntry array (contains ID + offset)
  *   - dynamic values are sorted by the global ID
  *
+ * Dynamic value index:
+ *   - once the number of dynamic values reaches NV_TABLE_DYN_INDEX_THRESHOLD,
+ *     an open-addressed hash table of guint16 positions into the dynamic
+ *     value array is maintained right after it, which makes lookups O(1)
+ *     instead of a bisection
+ *   - the index is rebuilt whenever a new dynamic value is inserted, its
+ *     size is stored in dyn_index_size, 0 means there's no index (either
+ *     because there are only a few dynamic values or because there was no
+ *     space for it)
+ *   - the index is not serialized, it is rebuilt when deserializing
+ *
  * Memory allocation
  * =================
  *   - the memory used by NVTable is managed by the caller, sometimes it is
@@ -196,6 +218,9 @@ struct _NVTable
   guint8 num_static_entries;
   guint8 ref_cnt:7,
     borrowed:1; /* specifies if the memory used by NVTable was borrowed from the container struct */
+  /* number of slots in the dynamic value index, 0 if there's none */
+  guint16 dyn_index_size;
+  guint16 __reserved;
 
   /* variable data, see memory layout in the comment above */
   union
@@ -211,6 +236,12 @@ struct _NVTable
 #define NV_TABLE_DYNVALUE_HANDLE(x) ((x).handle)
 #define NV_TABLE_DYNVALUE_OFS(x)    ((x).ofs)
 
+/* minimum number of dynamic values to maintain a hash index for them */
+#define NV_TABLE_DYN_INDEX_THRESHOLD   16
+/* don't bother with the index beyond this number of dynamic values, the guint16 slots would overflow */
+#define NV_TABLE_DYN_INDEX_MAX_ENTRIES 16384
+#define NV_TABLE_DYN_INDEX_EMPTY       0xFFFF
+
 /* 256MB, this is an artificial limit, but must be less than MAX_GUINT32 as
  * we want to compare a guint32 to this variable without overflow.  */
 #define NV_TABLE_MAX_BYTES  (256*1024*1024)
@@ -228,6 +259,7 @@ gboolean nv_table_realloc(NVTable *self, NVTable **new);
 NVTable *nv_table_clone(NVTable *self, gint additional_space);
 NVTable *nv_table_ref(NVTable *self);
 void nv_table_unref(NVTable *self);
+void nv_table_rebuild_dyn_index(NVTable *self);
 
 static inline gsize
 nv_table_get_alloc_size(gint num_static_entries, gint num_dyn_values, gint init_length)
@@ -243,6 +275,15 @@ nv_table_get_alloc_size(gint num_static_entries, gint num_dyn_values, gint init_
   return size;
 }
 
+/* the space used by values and dynamic value slots, excluding the header
+ * and the static entries, useful when sizing a new table for similar
+ * contents */
+static inline gsize
+nv_table_get_payload_size(NVTable *self)
+{
+  return self->used + self->num_dyn_entries * sizeof(NVDynValue) + self->dyn_index_size * sizeof(guint16);
+}
+
 static inline gchar *
 nv_table_get_top(NVTable *self)
 {
@@ -64,4 +64,49 @@ tags_serialize(LogMessage *msg, SerializeArchive *sa)
   return serialize_write_cstring(sa, "", 0);
 }
 
+/* same as above, but using varint lengths, used by the compact LogMessage format */
+gboolean
+tags_deserialize_compact(LogMessage *msg, SerializeArchive *sa)
+{
+  gchar *buf;
+  guint32 len;
+
+  while (1)
+    {
+      if (!serialize_read_varint32(sa, &len) || len > G_MAXUINT16)
+        return FALSE;
+      if (!len)
+        break;
+      buf = g_malloc(len + 1);
+      if (!serialize_read_blob(sa, buf, len))
+        {
+          g_free(buf);
+          return FALSE;
+        }
+      buf[len] = 0;
+      log_msg_set_tag_by_name(msg, buf);
+      g_free(buf);
+    }
+
+  msg->flags |= LF_STATE_OWN_TAGS;
+
+  return TRUE;
+}
+
+static gboolean
+_compact_callback(const LogMessage *msg, LogTagId tag_id, const gchar *name, gpointer user_data)
+{
+  SerializeArchive *sa = ( SerializeArchive *)user_data;
+  gsize len = strlen(name);
+
+  serialize_write_varint(sa, len);
+  serialize_write_blob(sa, name, len);
+  return TRUE;
+}
 
+gboolean
+tags_serialize_compact(LogMessage *msg, SerializeArchive *sa)
+{
+  log_msg_tags_foreach(msg, _compact_callback, (gpointer)sa);
+  return serialize_write_varint(sa, 0);
+}
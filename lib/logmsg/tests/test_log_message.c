@@ -302,9 +302,73 @@ test_log_msg_get_value_with_time_related_macro(void)
   log_msg_unref(msg);
 }
 
+static gint test_ack_count;
+static AckType test_last_ack_type;
+
+static void
+_count_acks(LogMessage *msg, AckType ack_type)
+{
+  test_ack_count++;
+  test_last_ack_type = ack_type;
+}
+
+static void
+test_log_msg_drop_batch_acks_the_original_once_all_clones_are_dropped(void)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *msg, *clones[3];
+  gboolean ack_needed[3] = { TRUE, TRUE, TRUE };
+  gint i;
+
+  test_ack_count = 0;
+  msg = construct_log_message();
+  msg->ack_func = _count_acks;
+  path_options.ack_needed = TRUE;
+  for (i = 0; i < 3; i++)
+    {
+      log_msg_add_ack(msg, &path_options);
+      clones[i] = log_msg_clone_cow(msg, &path_options);
+    }
+
+  log_msg_drop_batch(clones, ack_needed, 2, AT_PROCESSED);
+  assert_gint(test_ack_count, 0, "original acked before all of its clones were dropped");
+
+  log_msg_drop_batch(&clones[2], ack_needed, 1, AT_ABORTED);
+  assert_gint(test_ack_count, 1, "original was not acked exactly once");
+  assert_gint(test_last_ack_type, AT_ABORTED, "abort flag was not propagated to the original");
+  log_msg_unref(msg);
+}
+
+static void
+test_log_msg_drop_batch_keeps_the_earlier_abort_of_a_clone(void)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *msg, *clone;
+  gboolean ack_needed = TRUE;
+
+  test_ack_count = 0;
+  msg = construct_log_message();
+  msg->ack_func = _count_acks;
+  path_options.ack_needed = TRUE;
+  log_msg_add_ack(msg, &path_options);
+  clone = log_msg_clone_cow(msg, &path_options);
+
+  /* a second destination aborts its copy first */
+  log_msg_add_ack(clone, &path_options);
+  log_msg_ack(clone, &path_options, AT_ABORTED);
+  assert_gint(test_ack_count, 0, "original acked before the clone was dropped");
+
+  log_msg_drop_batch(&clone, &ack_needed, 1, AT_PROCESSED);
+  assert_gint(test_ack_count, 1, "original was not acked exactly once");
+  assert_gint(test_last_ack_type, AT_ABORTED, "earlier abort of the clone was lost");
+  log_msg_unref(msg);
+}
+
 static void
 test_misc_stuff(void)
 {
+  MSG_TESTCASE(test_log_msg_drop_batch_acks_the_original_once_all_clones_are_dropped);
+  MSG_TESTCASE(test_log_msg_drop_batch_keeps_the_earlier_abort_of_a_clone);
   MSG_TESTCASE(test_log_msg_get_value_with_time_related_macro);
   MSG_TESTCASE(test_log_msg_set_value_indirect_with_self_referencing_handle_results_in_a_nonindirect_value);
 }
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "testutils.h"
+#include "apphook.h"
+#include "logmsg/logmsg.h"
+#include "logmsg/logmsg-slab.h"
+
+#include <string.h>
+
+static void
+test_disabled_cache_returns_exact_size(void)
+{
+  gpointer p;
+
+  log_msg_slab_set_enabled(FALSE);
+  p = log_msg_slab_alloc(300);
+  assert_guint64(log_msg_slab_get_usable_size(p), 300, "Disabled cache should not round up allocations");
+  log_msg_slab_free(p);
+}
+
+static void
+test_freed_chunks_are_reused_in_the_same_thread(void)
+{
+  gpointer p, q;
+
+  log_msg_slab_set_enabled(TRUE);
+  p = log_msg_slab_alloc(300);
+  assert_guint64(log_msg_slab_get_usable_size(p), 512, "Allocation is not rounded up to its size class");
+  log_msg_slab_free(p);
+
+  q = log_msg_slab_alloc(400);
+  assert_gpointer(q, p, "Freed chunk was not reused from the per-thread cache");
+  log_msg_slab_free(q);
+  log_msg_slab_set_enabled(FALSE);
+}
+
+static void
+test_large_allocations_bypass_the_cache(void)
+{
+  gpointer p;
+
+  log_msg_slab_set_enabled(TRUE);
+  p = log_msg_slab_alloc(65536);
+  assert_guint64(log_msg_slab_get_usable_size(p), 65536, "Large allocations should not be rounded up");
+  log_msg_slab_free(p);
+  log_msg_slab_set_enabled(FALSE);
+}
+
+static void
+test_realloc_preserves_contents(void)
+{
+  gchar *p;
+
+  log_msg_slab_set_enabled(TRUE);
+  p = log_msg_slab_alloc(16);
+  strcpy(p, "0123456789");
+  p = log_msg_slab_realloc(p, 2000);
+  assert_guint64(log_msg_slab_get_usable_size(p), 2048, "Reallocated chunk has unexpected size");
+  assert_string(p, "0123456789", "Contents lost during realloc");
+  log_msg_slab_free(p);
+  log_msg_slab_set_enabled(FALSE);
+}
+
+static gpointer
+_free_in_other_thread(gpointer p)
+{
+  log_msg_slab_thread_init();
+  log_msg_slab_free(p);
+  log_msg_slab_thread_deinit();
+  return NULL;
+}
+
+static void
+test_chunks_freed_in_other_threads_return_to_their_origin(void)
+{
+  GThread *thread;
+  gpointer p, q;
+
+  log_msg_slab_set_enabled(TRUE);
+  p = log_msg_slab_alloc(1000);
+
+  thread = g_thread_create(_free_in_other_thread, p, TRUE, NULL);
+  g_thread_join(thread);
+
+  q = log_msg_slab_alloc(1000);
+  assert_gpointer(q, p, "Chunk freed in a remote thread was not handed back to its origin thread");
+  log_msg_slab_free(q);
+  log_msg_slab_set_enabled(FALSE);
+}
+
+static void
+test_log_messages_can_be_allocated_from_the_cache(void)
+{
+  LogMessage *msg, *clone;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  log_msg_slab_set_enabled(TRUE);
+  msg = log_msg_new_empty();
+  log_msg_set_value(msg, LM_V_HOST, "host", -1);
+  clone = log_msg_clone_cow(msg, &path_options);
+  log_msg_set_value(clone, LM_V_MESSAGE, "message", -1);
+
+  assert_string(log_msg_get_value(clone, LM_V_HOST, NULL), "host", "Cloned value mismatch");
+  assert_string(log_msg_get_value(clone, LM_V_MESSAGE, NULL), "message", "Clone value mismatch");
+
+  log_msg_unref(clone);
+  log_msg_unref(msg);
+  log_msg_slab_set_enabled(FALSE);
+}
+
+int
+main(int argc, char **argv)
+{
+  app_startup();
+
+  test_disabled_cache_returns_exact_size();
+  test_freed_chunks_are_reused_in_the_same_thread();
+  test_large_allocations_bypass_the_cache();
+  test_realloc_preserves_contents();
+  test_chunks_freed_in_other_threads_return_to_their_origin();
+  test_log_messages_can_be_allocated_from_the_cache();
+
+  app_shutdown();
+  return 0;
+}
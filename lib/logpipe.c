@@ -58,6 +58,42 @@ log_pipe_new(GlobalConfig *cfg)
   return self;
 }
 
+/* queue() method of pipes that implement stage() */
+void
+log_pipe_stage_queue_method(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options, gpointer user_data)
+{
+  if (s->stage(s, &msg, path_options))
+    {
+      log_pipe_forward_msg(s, msg, path_options);
+    }
+  else
+    {
+      if (path_options->matched)
+        (*path_options->matched) = FALSE;
+      log_msg_drop(msg, path_options, AT_PROCESSED);
+    }
+}
+
+/* runs stage() on each message, and forwards the ones that remain in one batch */
+void
+log_pipe_stage_queue_batch_method(LogPipe *s, LogMessage **msgs, gint count, const LogPathOptions *path_options,
+                                  gpointer user_data)
+{
+  gint i, kept = 0;
+
+  for (i = 0; i < count; i++)
+    {
+      LogMessage *msg = msgs[i];
+
+      if (s->stage(s, &msg, path_options))
+        msgs[kept++] = msg;
+      else
+        log_msg_drop(msg, path_options, AT_PROCESSED);
+    }
+  if (kept > 0)
+    log_pipe_forward_msg_batch(s, msgs, kept, path_options);
+}
+
 void
 log_pipe_free_method(LogPipe *self)
 {
@@ -218,6 +218,21 @@ struct _LogPipe
      by a plugin, see the explanation in the comment on the top. */
   gpointer queue_data;
   void (*queue)(LogPipe *self, LogMessage *msg, const LogPathOptions *path_options, gpointer user_data);
+  /* optional, slow part of init() (e.g. name resolution) that is run
+   * before init() on a worker thread, concurrently with other pipes.  It
+   * may only touch the pipe's own state, init() is still called on the
+   * main thread afterwards. */
+  gboolean (*pre_init)(LogPipe *self);
+  /* optional, the processing done by queue() without forwarding the
+   * message: returns FALSE if the message is to be dropped as not
+   * matching.  Pipes implementing it use log_pipe_stage_queue_method() as
+   * their queue(), which lets cfg_tree_start() fuse linear chains of
+   * them into a single queue() call. */
+  gboolean (*stage)(LogPipe *self, LogMessage **pmsg, const LogPathOptions *path_options);
+  /* optional, queue() for an array of messages sharing the same
+   * path_options, see log_pipe_queue_batch().  The array belongs to the
+   * caller, but its contents may be reordered or overwritten. */
+  void (*queue_batch)(LogPipe *self, LogMessage **msgs, gint count, const LogPathOptions *path_options, gpointer user_data);
   gboolean (*init)(LogPipe *self);
   gboolean (*deinit)(LogPipe *self);
 
@@ -258,6 +273,14 @@ log_pipe_reset_config(LogPipe *s)
   log_pipe_set_config(s, NULL);
 }
 
+static inline gboolean
+log_pipe_pre_init(LogPipe *s)
+{
+  if (!(s->flags & PIF_INITIALIZED) && s->pre_init)
+    return s->pre_init(s);
+  return TRUE;
+}
+
 static inline gboolean
 log_pipe_init(LogPipe *s)
 {
@@ -342,6 +365,60 @@ log_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
     }
 }
 
+static inline void
+log_pipe_queue_batch(LogPipe *s, LogMessage **msgs, gint count, const LogPathOptions *path_options);
+
+static inline void
+log_pipe_forward_msg_batch(LogPipe *self, LogMessage **msgs, gint count, const LogPathOptions *path_options)
+{
+  gint i;
+
+  if (self->pipe_next)
+    {
+      log_pipe_queue_batch(self->pipe_next, msgs, count, path_options);
+    }
+  else
+    {
+      for (i = 0; i < count; i++)
+        log_msg_drop(msgs[i], path_options, AT_PROCESSED);
+    }
+}
+
+/*
+ * Queues @count messages with the same @path_options.  Pipes that don't
+ * implement queue_batch() get the messages one-by-one.  So do all pipes
+ * if the caller wants to know whether each message was matched (as the
+ * single "matched" flag cannot tell that about a batch), or while the
+ * debugger is single stepping.
+ */
+static inline void
+log_pipe_queue_batch(LogPipe *s, LogMessage **msgs, gint count, const LogPathOptions *path_options)
+{
+  gint i;
+
+  g_assert((s->flags & PIF_INITIALIZED) != 0);
+
+  if (count == 0)
+    return;
+
+  if (!s->queue_batch || path_options->matched || G_UNLIKELY(pipe_single_step_hook))
+    {
+      for (i = 0; i < count; i++)
+        log_pipe_queue(s, msgs[i], path_options);
+      return;
+    }
+
+  if (G_UNLIKELY(s->flags & (PIF_HARD_FLOW_CONTROL)))
+    {
+      LogPathOptions local_path_options = *path_options;
+
+      local_path_options.flow_control_requested = 1;
+      path_options = &local_path_options;
+    }
+
+  s->queue_batch(s, msgs, count, path_options, s->queue_data);
+}
+
 static inline LogPipe *
 log_pipe_clone(LogPipe *self)
 {
@@ -363,6 +440,9 @@ log_pipe_append(LogPipe *s, LogPipe *next)
   s->pipe_next = next;
 }
 
+void log_pipe_stage_queue_method(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options, gpointer user_data);
+void log_pipe_stage_queue_batch_method(LogPipe *s, LogMessage **msgs, gint count, const LogPathOptions *path_options,
+                                       gpointer user_data);
 void log_pipe_free_method(LogPipe *s);
 
 #endif
@@ -61,13 +61,21 @@ log_proto_buffered_server_put_state(LogProtoBufferedServer *self)
     persist_state_unmap_entry(self->persist_state, self->persist_handle);
 }
 
+static inline gsize
+log_proto_buffered_server_convert(LogProtoBufferedServer *self, const guchar **in, gsize *in_len, guchar **out, gsize *out_len)
+{
+  if (self->fast_converter != LPFC_NONE)
+    return log_proto_fast_convert(self->fast_converter, in, in_len, out, out_len);
+  return g_iconv(self->convert, (gchar **) in, in_len, (gchar **) out, out_len);
+}
+
 static gboolean
 log_proto_buffered_server_convert_from_raw(LogProtoBufferedServer *self, const guchar *raw_buffer, gsize raw_buffer_len)
 {
   /* some data was read */
   gsize avail_in = raw_buffer_len;
   gsize avail_out;
-  gchar *out;
+  guchar *out;
   gint  ret = -1;
   gboolean success = FALSE;
   LogProtoBufferedServerState *state = log_proto_buffered_server_get_state(self);
@@ -75,9 +83,9 @@ log_proto_buffered_server_convert_from_raw(LogProtoBufferedServer *self, const g
   do
     {
       avail_out = state->buffer_size - state->pending_buffer_end;
-      out = (gchar *) self->buffer + state->pending_buffer_end;
+      out = self->buffer + state->pending_buffer_end;
 
-      ret = g_iconv(self->convert, (gchar **) &raw_buffer, &avail_in, (gchar **) &out, &avail_out);
+      ret = log_proto_buffered_server_convert(self, &raw_buffer, &avail_in, &out, &avail_out);
       if (ret == (gsize) -1)
         {
           switch (errno)
@@ -632,7 +640,7 @@ log_proto_buffered_server_fetch_into_buffer(LogProtoBufferedServer *self)
   if (G_UNLIKELY(!self->buffer))
     log_proto_buffered_server_allocate_buffer(self, state);
 
-  if (self->convert == (GIConv) -1)
+  if (!log_proto_buffered_server_needs_conversion(self))
     {
       /* no conversion, we read directly into our buffer */
       raw_buffer = self->buffer + state->pending_buffer_end;
@@ -689,7 +697,7 @@ log_proto_buffered_server_fetch_into_buffer(LogProtoBufferedServer *self)
       rc += state->raw_buffer_leftover_size;
       state->raw_buffer_leftover_size = 0;
 
-      if (self->convert == (GIConv) -1)
+      if (!log_proto_buffered_server_needs_conversion(self))
         {
           state->pending_buffer_end += rc;
         }
@@ -853,7 +861,7 @@ log_proto_buffered_server_validate_options_method(LogProtoServer *s)
 {
   LogProtoBufferedServer *self = (LogProtoBufferedServer *) s;
 
-  if (self->super.options->encoding && self->convert == (GIConv) -1)
+  if (self->super.options->encoding && !log_proto_buffered_server_needs_conversion(self))
     {
       msg_error("Unknown character set name specified",
                 evt_tag_str("encoding", self->super.options->encoding),
@@ -863,6 +871,48 @@ log_proto_buffered_server_validate_options_method(LogProtoServer *s)
   return log_proto_server_validate_options_method(s);
 }
 
+/*
+ * Collects complete messages from the buffer.  Only the first message is
+ * allowed to trigger a read, as reading may move data around in the
+ * buffer, invalidating the spans collected earlier.
+ */
+static LogProtoStatus
+log_proto_buffered_server_fetch_many(LogProtoServer *s, LogProtoServerSpan *spans, gint *num_spans, gboolean *may_read, LogTransportAuxData *aux)
+{
+  LogProtoBufferedServer *self = (LogProtoBufferedServer *) s;
+  LogProtoStatus result = LPS_SUCCESS;
+  gint max_spans = *num_spans;
+  gboolean no_read = FALSE;
+
+  *num_spans = 0;
+  while (*num_spans < max_spans)
+    {
+      LogProtoServerSpan *span = &spans[*num_spans];
+
+      span->msg = NULL;
+      bookmark_init(&span->bookmark);
+      log_transport_aux_data_reinit(aux);
+      result = log_proto_buffered_server_fetch(s, &span->msg, &span->msg_len,
+                                               *num_spans == 0 ? may_read : &no_read,
+                                               aux, &span->bookmark);
+      if (result != LPS_SUCCESS || !span->msg)
+        break;
+      (*num_spans)++;
+      self->batch_in_progress = TRUE;
+    }
+
+  if (self->batch_in_progress)
+    {
+      self->batch_in_progress = FALSE;
+
+      /* the buffer may have been left uncompacted, make sure the next
+       * fetch looks at it again before reading */
+      if (self->fetch_state == LPBSF_FETCHING_FROM_INPUT)
+        self->fetch_state = LPBSF_FETCHING_FROM_BUFFER;
+    }
+  return result;
+}
+
 void
 log_proto_buffered_server_free_method(LogProtoServer *s)
 {
@@ -886,6 +936,7 @@ log_proto_buffered_server_init(LogProtoBufferedServer *self, LogTransport *trans
   log_proto_server_init(&self->super, transport, options);
   self->super.prepare = log_proto_buffered_server_prepare;
   self->super.fetch = log_proto_buffered_server_fetch;
+  self->super.fetch_many = log_proto_buffered_server_fetch_many;
   self->super.free_fn = log_proto_buffered_server_free_method;
   self->super.transport = transport;
   self->super.restart_with_state = log_proto_buffered_server_restart_with_state;
@@ -895,8 +946,10 @@ log_proto_buffered_server_init(LogProtoBufferedServer *self, LogTransport *trans
   self->read_data = log_proto_buffered_server_read_data_method;
   self->io_status = G_IO_STATUS_NORMAL;
   if (options->encoding)
-    self->convert = g_iconv_open("utf-8", options->encoding);
-  else
-    self->convert = (GIConv) -1;
+    {
+      self->fast_converter = log_proto_fast_converter_lookup(options->encoding);
+      if (self->fast_converter == LPFC_NONE)
+        self->convert = g_iconv_open("utf-8", options->encoding);
+    }
   self->stream_based = TRUE;
 }
@@ -26,6 +26,7 @@
 
 #include "logproto-server.h"
 #include "persistable-state-header.h"
+#include "logproto-fast-convert.h"
 
 enum
 {
@@ -80,13 +81,19 @@ struct _LogProtoBufferedServer
      * or fixed-size records read from a file.  */
     stream_based:1,
 
-    no_multi_read:1;
+    no_multi_read:1,
+
+    /* messages returned by fetch_many() still point into our buffer, it
+     * must not be compacted */
+    batch_in_progress:1;
   gint fetch_state;
   GIOStatus io_status;
   LogProtoBufferedServerState *state1;
   PersistState *persist_state;
   PersistEntryHandle persist_handle;
   GIConv convert;
+  /* used instead of convert for the encodings we can handle ourselves */
+  LogProtoFastConverter fast_converter;
   guchar *buffer;
 
   /* auxiliary data (e.g. GSockAddr, other transport related meta
@@ -94,6 +101,12 @@ struct _LogProtoBufferedServer
   LogTransportAuxData buffer_aux;
 };
 
+static inline gboolean
+log_proto_buffered_server_needs_conversion(LogProtoBufferedServer *self)
+{
+  return self->convert != (GIConv) -1 || self->fast_converter != LPFC_NONE;
+}
+
 static inline gboolean
 log_proto_buffered_server_is_input_closed(LogProtoBufferedServer *self)
 {
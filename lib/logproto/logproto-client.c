@@ -54,6 +54,7 @@ log_proto_client_init(LogProtoClient *self, LogTransport *transport, const LogPr
 {
   self->validate_options = log_proto_client_validate_options_method;
   self->free_fn = log_proto_client_free_method;
+  self->msg_free = g_free;
   self->options = options;
   self->transport = transport;
 }
@@ -61,6 +62,8 @@ log_proto_client_init(LogProtoClient *self, LogTransport *transport, const LogPr
 void
 log_proto_client_options_defaults(LogProtoClientOptions *options)
 {
+  options->batch_lines = 0;
+  options->batch_bytes = 0;
 }
 
 void
@@ -34,6 +34,10 @@ typedef struct _LogProtoClient LogProtoClient;
 
 typedef struct _LogProtoClientOptions
 {
+  /* number of messages/bytes collected for a single vectored write, see
+   * LogProtoTextClient, 0 means disabled */
+  gint batch_lines;
+  gint batch_bytes;
 } LogProtoClientOptions;
 
 typedef union _LogProtoClientOptionsStorage
@@ -68,8 +72,16 @@ struct _LogProtoClient
   gboolean (*validate_options)(LogProtoClient *s);
   void (*free_fn)(LogProtoClient *s);
   LogProtoClientFlowControlFuncs flow_control_funcs;
+  /* releases the buffers passed to post(), g_free() by default */
+  GDestroyNotify msg_free;
 };
 
+static inline void
+log_proto_client_set_msg_free(LogProtoClient *self, GDestroyNotify msg_free)
+{
+  self->msg_free = msg_free;
+}
+
 static inline void
 log_proto_client_set_client_flow_control(LogProtoClient *self, LogProtoClientFlowControlFuncs *flow_control_funcs)
 {
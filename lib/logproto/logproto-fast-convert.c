@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logproto-fast-convert.h"
+
+#include <string.h>
+#include <errno.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define FAST_CONVERT_SSE2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON) && !defined(__AARCH64EB__)
+#include <arm_neon.h>
+#define FAST_CONVERT_NEON 1
+#endif
+
+static struct
+{
+  const gchar *name;
+  LogProtoFastConverter converter;
+} fast_converters[] =
+{
+  /* names are compared with '-' and '_' removed, case insensitively */
+  { "ascii", LPFC_ASCII },
+  { "usascii", LPFC_ASCII },
+  { "ansix3.41968", LPFC_ASCII },
+  { "latin1", LPFC_LATIN1 },
+  { "l1", LPFC_LATIN1 },
+  { "iso88591", LPFC_LATIN1 },
+  { "cp819", LPFC_LATIN1 },
+  { "utf16le", LPFC_UTF16LE },
+  { "utf16be", LPFC_UTF16BE },
+  { NULL, LPFC_NONE }
+};
+
+LogProtoFastConverter
+log_proto_fast_converter_lookup(const gchar *encoding)
+{
+  gchar normalized[32];
+  gint i, j;
+
+  for (i = 0, j = 0; encoding[i] && j < sizeof(normalized) - 1; i++)
+    {
+      if (encoding[i] != '-' && encoding[i] != '_')
+        normalized[j++] = g_ascii_tolower(encoding[i]);
+    }
+  if (encoding[i])
+    return LPFC_NONE;
+  normalized[j] = 0;
+
+  for (i = 0; fast_converters[i].name; i++)
+    {
+      if (strcmp(normalized, fast_converters[i].name) == 0)
+        return fast_converters[i].converter;
+    }
+  return LPFC_NONE;
+}
+
+static inline gsize
+_fail(gint error)
+{
+  errno = error;
+  return (gsize) -1;
+}
+
+/* the number of leading bytes below 0x80 in @s */
+static inline gsize
+_ascii_prefix_len(const guchar *s, gsize n)
+{
+  gsize i = 0;
+
+#if FAST_CONVERT_SSE2
+  for (; i + 16 <= n; i += 16)
+    {
+      gint mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) (s + i)));
+
+      if (mask)
+        return i + __builtin_ctz(mask);
+    }
+#elif FAST_CONVERT_NEON
+  for (; i + 16 <= n; i += 16)
+    {
+      if (vmaxvq_u8(vld1q_u8(s + i)) >= 0x80)
+        break;
+    }
+#endif
+  while (i < n && s[i] < 0x80)
+    i++;
+  return i;
+}
+
+static inline void
+_advance(const guchar **in, gsize *in_len, guchar **out, gsize *out_len, gsize consumed, gsize produced)
+{
+  *in += consumed;
+  *in_len -= consumed;
+  *out += produced;
+  *out_len -= produced;
+}
+
+static gsize
+_convert_ascii(const guchar **in, gsize *in_len, guchar **out, gsize *out_len)
+{
+  gsize len = _ascii_prefix_len(*in, MIN(*in_len, *out_len));
+
+  memcpy(*out, *in, len);
+  _advance(in, in_len, out, out_len, len, len);
+
+  if (*in_len == 0)
+    return 0;
+  if (**in >= 0x80)
+    return _fail(EILSEQ);
+  return _fail(E2BIG);
+}
+
+static gsize
+_convert_latin1(const guchar **in, gsize *in_len, guchar **out, gsize *out_len)
+{
+  while (*in_len > 0)
+    {
+      gsize len = _ascii_prefix_len(*in, MIN(*in_len, *out_len));
+      guchar c;
+
+      memcpy(*out, *in, len);
+      _advance(in, in_len, out, out_len, len, len);
+      if (*in_len == 0)
+        break;
+
+      c = **in;
+      if (c < 0x80 || *out_len < 2)
+        return _fail(E2BIG);
+
+      (*out)[0] = 0xc0 | (c >> 6);
+      (*out)[1] = 0x80 | (c & 0x3f);
+      _advance(in, in_len, out, out_len, 1, 2);
+    }
+  return 0;
+}
+
+/* converts runs of 8 code units below 0x80, returns the number of input bytes consumed */
+static inline gsize
+_utf16_ascii_blocks(const guchar *in, gsize in_len, guchar *out, gsize out_len, gboolean big_endian)
+{
+  gsize i = 0;
+
+#if FAST_CONVERT_SSE2
+  const __m128i non_ascii = _mm_set1_epi16((gshort) 0xff80);
+  const __m128i zero = _mm_setzero_si128();
+
+  for (; i + 16 <= in_len && i / 2 + 8 <= out_len; i += 16)
+    {
+      __m128i units = _mm_loadu_si128((const __m128i *) (in + i));
+
+      if (big_endian)
+        units = _mm_or_si128(_mm_slli_epi16(units, 8), _mm_srli_epi16(units, 8));
+      if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(units, non_ascii), zero)) != 0xffff)
+        break;
+      _mm_storel_epi64((__m128i *) (out + i / 2), _mm_packus_epi16(units, zero));
+    }
+#elif FAST_CONVERT_NEON
+  for (; i + 16 <= in_len && i / 2 + 8 <= out_len; i += 16)
+    {
+      uint8x16_t bytes = vld1q_u8(in + i);
+      uint16x8_t units;
+
+      if (big_endian)
+        bytes = vrev16q_u8(bytes);
+      units = vreinterpretq_u16_u8(bytes);
+      if (vmaxvq_u16(units) >= 0x80)
+        break;
+      vst1_u8(out + i / 2, vmovn_u16(units));
+    }
+#endif
+  return i;
+}
+
+static inline gunichar
+_utf16_unit(const guchar *p, gboolean big_endian)
+{
+  return big_endian ? ((p[0] << 8) | p[1]) : ((p[1] << 8) | p[0]);
+}
+
+static gsize
+_convert_utf16(const guchar **in, gsize *in_len, guchar **out, gsize *out_len, gboolean big_endian)
+{
+  while (*in_len >= 2)
+    {
+      gsize consumed = _utf16_ascii_blocks(*in, *in_len, *out, *out_len, big_endian);
+      gunichar c, low;
+      gsize unit_len = 2;
+
+      _advance(in, in_len, out, out_len, consumed, consumed / 2);
+      if (*in_len < 2)
+        break;
+
+      c = _utf16_unit(*in, big_endian);
+      if (c >= 0xdc00 && c < 0xe000)
+        return _fail(EILSEQ);
+      if (c >= 0xd800 && c < 0xdc00)
+        {
+          if (*in_len < 4)
+            return _fail(EINVAL);
+
+          low = _utf16_unit(*in + 2, big_endian);
+          if (low < 0xdc00 || low >= 0xe000)
+            return _fail(EILSEQ);
+          c = 0x10000 + ((c - 0xd800) << 10) + (low - 0xdc00);
+          unit_len = 4;
+        }
+
+      if (*out_len < g_unichar_to_utf8(c, NULL))
+        return _fail(E2BIG);
+      _advance(in, in_len, out, out_len, unit_len, g_unichar_to_utf8(c, (gchar *) *out));
+    }
+
+  if (*in_len > 0)
+    return _fail(EINVAL);
+  return 0;
+}
+
+gsize
+log_proto_fast_convert(LogProtoFastConverter converter,
+                       const guchar **in, gsize *in_len,
+                       guchar **out, gsize *out_len)
+{
+  switch (converter)
+    {
+    case LPFC_ASCII:
+      return _convert_ascii(in, in_len, out, out_len);
+    case LPFC_LATIN1:
+      return _convert_latin1(in, in_len, out, out_len);
+    case LPFC_UTF16LE:
+      return _convert_utf16(in, in_len, out, out_len, FALSE);
+    case LPFC_UTF16BE:
+      return _convert_utf16(in, in_len, out, out_len, TRUE);
+    default:
+      g_assert_not_reached();
+    }
+}
+
+gsize
+log_proto_fast_converter_get_raw_size(LogProtoFastConverter converter, const guchar *utf8, gsize utf8_len)
+{
+  gsize chars = 0, supplementary = 0;
+  gsize i;
+
+  for (i = 0; i < utf8_len; i++)
+    {
+      /* count lead bytes, continuation bytes are 10xxxxxx */
+      if ((utf8[i] & 0xc0) != 0x80)
+        {
+          chars++;
+          if (utf8[i] >= 0xf0)
+            supplementary++;
+        }
+    }
+
+  switch (converter)
+    {
+    case LPFC_ASCII:
+    case LPFC_LATIN1:
+      return chars;
+    case LPFC_UTF16LE:
+    case LPFC_UTF16BE:
+      /* supplementary characters are encoded as surrogate pairs */
+      return (chars + supplementary) * 2;
+    default:
+      g_assert_not_reached();
+    }
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef LOGPROTO_FAST_CONVERT_H_INCLUDED
+#define LOGPROTO_FAST_CONVERT_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/*
+ * Built-in converters to UTF-8 for the most common input encodings, used
+ * instead of iconv() when possible.  They are faster, and they make it
+ * cheap to calculate the size of the raw input that a piece of converted
+ * data corresponds to, which is needed for position tracking.
+ */
+typedef enum
+{
+  LPFC_NONE = 0,
+  LPFC_ASCII,
+  LPFC_LATIN1,
+  LPFC_UTF16LE,
+  LPFC_UTF16BE,
+} LogProtoFastConverter;
+
+LogProtoFastConverter log_proto_fast_converter_lookup(const gchar *encoding);
+
+/* same interface as g_iconv(), errno is set to E2BIG, EINVAL or EILSEQ */
+gsize log_proto_fast_convert(LogProtoFastConverter converter,
+                             const guchar **in, gsize *in_len,
+                             guchar **out, gsize *out_len);
+
+/* the number of bytes @utf8 was converted from */
+gsize log_proto_fast_converter_get_raw_size(LogProtoFastConverter converter, const guchar *utf8, gsize utf8_len);
+
+#endif
@@ -32,15 +32,16 @@ typedef struct _LogProtoFramedClient
 {
   LogProtoTextClient super;
   guchar frame_hdr_buf[9];
+
+  /* batching mode: frames (header & payload) rendered contiguously */
+  GString *batch;
+  gint batch_count, batch_lines;
+  gsize batch_bytes;
 } LogProtoFramedClient;
 
-static LogProtoStatus
-log_proto_framed_client_post(LogProtoClient *s, guchar *msg, gsize msg_len, gboolean *consumed)
+static gsize
+log_proto_framed_client_limit_msg_len(guchar *msg, gsize msg_len)
 {
-  LogProtoFramedClient *self = (LogProtoFramedClient *) s;
-  gint frame_hdr_len;
-  gint rc;
-
   if (msg_len > 9999999)
     {
       static const guchar *warn_msg;
@@ -54,6 +55,17 @@ log_proto_framed_client_post(LogProtoClient *s, guchar *msg, gsize msg_len, gboo
         }
       msg_len = 9999999;
     }
+  return msg_len;
+}
+
+static LogProtoStatus
+log_proto_framed_client_post(LogProtoClient *s, guchar *msg, gsize msg_len, gboolean *consumed)
+{
+  LogProtoFramedClient *self = (LogProtoFramedClient *) s;
+  gint frame_hdr_len;
+  gint rc;
+
+  msg_len = log_proto_framed_client_limit_msg_len(msg, msg_len);
 
   rc = LPS_SUCCESS;
   while (rc == LPS_SUCCESS && !(*consumed) && self->super.partial == NULL)
@@ -66,7 +78,7 @@ log_proto_framed_client_post(LogProtoClient *s, guchar *msg, gsize msg_len, gboo
           break;
         case LPFCS_MESSAGE_SEND:
           *consumed = TRUE;
-          rc = log_proto_text_client_submit_write(s, msg, msg_len, (GDestroyNotify) g_free, LPFCS_FRAME_SEND);
+          rc = log_proto_text_client_submit_write(s, msg, msg_len, s->msg_free, LPFCS_FRAME_SEND);
           break;
         default:
           g_assert_not_reached();
@@ -76,6 +88,86 @@ log_proto_framed_client_post(LogProtoClient *s, guchar *msg, gsize msg_len, gboo
   return rc;
 }
 
+/*
+ * Batching mode: instead of writing the frame header and the payload
+ * separately for every message, frames are rendered into a single buffer
+ * which is submitted once @batch_lines messages or @batch_bytes bytes are
+ * collected, or when the writer flushes.
+ */
+static LogProtoStatus
+log_proto_framed_client_flush_batch(LogProtoFramedClient *self)
+{
+  gint num_msgs = self->batch_count;
+  gsize len;
+  guchar *frames;
+
+  if (num_msgs == 0)
+    return LPS_SUCCESS;
+
+  len = self->batch->len;
+  frames = (guchar *) g_string_free(self->batch, FALSE);
+  self->batch = NULL;
+  self->batch_count = 0;
+  return log_proto_text_client_submit_batch(&self->super.super, frames, len, (GDestroyNotify) g_free, num_msgs);
+}
+
+static LogProtoStatus
+log_proto_framed_client_post_batched(LogProtoClient *s, guchar *msg, gsize msg_len, gboolean *consumed)
+{
+  LogProtoFramedClient *self = (LogProtoFramedClient *) s;
+  LogProtoStatus rc;
+
+  *consumed = FALSE;
+  rc = log_proto_text_client_flush(s);
+  if (rc != LPS_SUCCESS || self->super.partial)
+    return rc;
+
+  if (!self->batch)
+    self->batch = g_string_sized_new(self->batch_bytes > 0 ? self->batch_bytes + 16 : 4096);
+
+  msg_len = log_proto_framed_client_limit_msg_len(msg, msg_len);
+  g_string_append_printf(self->batch, "%" G_GSIZE_FORMAT " ", msg_len);
+  g_string_append_len(self->batch, (gchar *) msg, msg_len);
+  s->msg_free(msg);
+  *consumed = TRUE;
+  self->batch_count++;
+
+  if (self->batch_count >= self->batch_lines ||
+      (self->batch_bytes > 0 && self->batch->len >= self->batch_bytes))
+    return log_proto_framed_client_flush_batch(self);
+  return LPS_SUCCESS;
+}
+
+static LogProtoStatus
+log_proto_framed_client_flush(LogProtoClient *s)
+{
+  LogProtoFramedClient *self = (LogProtoFramedClient *) s;
+  LogProtoStatus rc;
+
+  rc = log_proto_text_client_flush(s);
+  if (rc != LPS_SUCCESS || self->super.partial)
+    return rc;
+  return log_proto_framed_client_flush_batch(self);
+}
+
+static gboolean
+log_proto_framed_client_prepare(LogProtoClient *s, gint *fd, GIOCondition *cond)
+{
+  LogProtoFramedClient *self = (LogProtoFramedClient *) s;
+
+  return log_proto_text_client_prepare(s, fd, cond) || self->batch_count > 0;
+}
+
+static void
+log_proto_framed_client_free(LogProtoClient *s)
+{
+  LogProtoFramedClient *self = (LogProtoFramedClient *) s;
+
+  if (self->batch)
+    g_string_free(self->batch, TRUE);
+  log_proto_text_client_free(s);
+}
+
 LogProtoClient *
 log_proto_framed_client_new(LogTransport *transport, const LogProtoClientOptions *options)
 {
@@ -84,5 +176,15 @@ log_proto_framed_client_new(LogTransport *transport, const LogProtoClientOptions
   log_proto_text_client_init(&self->super, transport, options);
   self->super.super.post = log_proto_framed_client_post;
   self->super.state = LPFCS_FRAME_SEND;
+
+  if (options->batch_lines > 1)
+    {
+      self->batch_lines = options->batch_lines;
+      self->batch_bytes = options->batch_bytes > 0 ? options->batch_bytes : 0;
+      self->super.super.post = log_proto_framed_client_post_batched;
+      self->super.super.flush = log_proto_framed_client_flush;
+      self->super.super.prepare = log_proto_framed_client_prepare;
+      self->super.super.free_fn = log_proto_framed_client_free;
+    }
   return &self->super.super;
 }
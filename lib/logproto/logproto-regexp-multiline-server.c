@@ -31,8 +31,96 @@ struct _MultiLineRegexp
 {
   pcre *pattern;
   pcre_extra *extra;
+  /* literal text any match has to start with, and whether that has to be at the start of the line */
+  gchar *literal_prefix;
+  gsize literal_prefix_len;
+  gboolean anchored;
 };
 
+/*
+ * Extract the literal characters at the start of the regexp, so that most
+ * of the lines can be rejected with a memcmp/memchr scan, without running
+ * PCRE on them.  This is important for prefix regexps, which are evaluated
+ * on every line, e.g. all the lines of a Java stack trace.
+ *
+ * The extraction is conservative: it stops at the first metacharacter or
+ * escape sequence with a special meaning, drops a character followed by a
+ * quantifier that allows zero repetitions and gives up on alternations,
+ * possibly losing an optimization, but never a match.
+ */
+static void
+_extract_literal_prefix(MultiLineRegexp *self, const gchar *regexp)
+{
+  GString *prefix;
+  const gchar *p = regexp;
+
+  if (strchr(regexp, '|'))
+    return;
+
+  if (*p == '^')
+    {
+      self->anchored = TRUE;
+      p++;
+    }
+
+  prefix = g_string_sized_new(16);
+  while (*p)
+    {
+      const gchar *next;
+      gchar c;
+
+      if (*p == '\\')
+        {
+          if (!p[1] || g_ascii_isalnum(p[1]))
+            break;
+          c = p[1];
+          next = p + 2;
+        }
+      else if (strchr("^$.[]()?*+{}", *p))
+        break;
+      else
+        {
+          c = *p;
+          next = p + 1;
+        }
+
+      if (*next == '?' || *next == '*' || *next == '{')
+        break;
+      g_string_append_c(prefix, c);
+      if (*next == '+')
+        break;
+      p = next;
+    }
+
+  self->literal_prefix_len = prefix->len;
+  self->literal_prefix = g_string_free(prefix, FALSE);
+}
+
+static gboolean
+_literal_prefix_may_match(MultiLineRegexp *self, const guchar *str, gsize len)
+{
+  const guchar *p, *end;
+
+  if (self->literal_prefix_len == 0)
+    return TRUE;
+
+  if (len < self->literal_prefix_len)
+    return FALSE;
+
+  if (self->anchored)
+    return memcmp(str, self->literal_prefix, self->literal_prefix_len) == 0;
+
+  p = str;
+  end = str + len - self->literal_prefix_len + 1;
+  while ((p = memchr(p, self->literal_prefix[0], end - p)) != NULL)
+    {
+      if (memcmp(p, self->literal_prefix, self->literal_prefix_len) == 0)
+        return TRUE;
+      p++;
+    }
+  return FALSE;
+}
+
 MultiLineRegexp *
 multi_line_regexp_compile(const gchar *regexp, GError **error)
 {
@@ -64,6 +152,7 @@ multi_line_regexp_compile(const gchar *regexp, GError **error)
       goto error;
     }
 
+  _extract_literal_prefix(self, regexp);
   return self;
  error:
   if (self->pattern)
@@ -81,6 +170,7 @@ multi_line_regexp_free(MultiLineRegexp *self)
         pcre_free(self->pattern);
       if (self->extra)
         pcre_free(self->extra);
+      g_free(self->literal_prefix);
       g_free(self);
     }
 }
@@ -102,6 +192,9 @@ _find_regexp(MultiLineRegexp *re, const guchar *str, gsize len, gint *matches, g
   if (!re)
     return -1;
 
+  if (!_literal_prefix_may_match(re, str, len))
+    return PCRE_ERROR_NOMATCH;
+
   rc = pcre_exec(re->pattern, re->extra, (const gchar *) str, len, 0, 0, matches, matches_num * 3);
   return rc;
 }
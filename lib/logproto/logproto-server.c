@@ -27,6 +27,8 @@
 #include "cfg.h"
 #include "plugin.h"
 #include "plugin-types.h"
+#include "find-crlf.h"
+#include "logproto-fast-convert.h"
 
 /**
  * Find the character terminating the buffer.
@@ -36,68 +38,14 @@
  * sure that there's no NUL left in the message. This function iterates over
  * the input data and returns a pointer to the first occurence of NL or NUL.
  *
- * It uses an algorithm similar to what there's in libc memchr/strchr.
+ * The actual scanning is implemented by find_lf_or_nul().
  *
  * NOTE: find_eom is not static as it is used by a unit test program.
  **/
 const guchar *
 find_eom(const guchar *s, gsize n)
 {
-  const guchar *char_ptr;
-  const gulong *longword_ptr;
-  gulong longword, magic_bits, charmask;
-  gchar c;
-
-  c = '\n';
-
-  /* align input to long boundary */
-  for (char_ptr = s; n > 0 && ((gulong) char_ptr & (sizeof(longword) - 1)) != 0; ++char_ptr, n--)
-    {
-      if (*char_ptr == c || *char_ptr == '\0')
-        return char_ptr;
-    }
-
-  longword_ptr = (gulong *) char_ptr;
-
-#if GLIB_SIZEOF_LONG == 8
-  magic_bits = 0x7efefefefefefeffL;
-#elif GLIB_SIZEOF_LONG == 4
-  magic_bits = 0x7efefeffL;
-#else
-  #error "unknown architecture"
-#endif
-  memset(&charmask, c, sizeof(charmask));
-
-  while (n > sizeof(longword))
-    {
-      longword = *longword_ptr++;
-      if ((((longword + magic_bits) ^ ~longword) & ~magic_bits) != 0 ||
-          ((((longword ^ charmask) + magic_bits) ^ ~(longword ^ charmask)) & ~magic_bits) != 0)
-        {
-          gint i;
-
-          char_ptr = (const guchar *) (longword_ptr - 1);
-
-          for (i = 0; i < sizeof(longword); i++)
-            {
-              if (*char_ptr == c || *char_ptr == '\0')
-                return char_ptr;
-              char_ptr++;
-            }
-        }
-      n -= sizeof(longword);
-    }
-
-  char_ptr = (const guchar *) longword_ptr;
-
-  while (n-- > 0)
-    {
-      if (*char_ptr == c || *char_ptr == '\0')
-        return char_ptr;
-      ++char_ptr;
-    }
-
-  return NULL;
+  return find_lf_or_nul(s, n);
 }
 
 gboolean
@@ -137,6 +85,9 @@ log_proto_server_options_set_encoding(LogProtoServerOptions *self, const gchar *
   g_free(self->encoding);
   self->encoding = g_strdup(encoding);
 
+  if (log_proto_fast_converter_lookup(encoding) != LPFC_NONE)
+    return TRUE;
+
   /* validate encoding */
   convert = g_iconv_open("utf8", encoding);
   if (convert == (GIConv) -1)
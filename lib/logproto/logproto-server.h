@@ -33,6 +33,14 @@
 typedef struct _LogProtoServer LogProtoServer;
 typedef struct _LogProtoServerOptions LogProtoServerOptions;
 
+/* a message returned by fetch_many(), along with its own bookmark */
+typedef struct _LogProtoServerSpan
+{
+  const guchar *msg;
+  gsize msg_len;
+  Bookmark bookmark;
+} LogProtoServerSpan;
+
 #define LOG_PROTO_SERVER_OPTIONS_SIZE 32
 
 struct _LogProtoServerOptions
@@ -69,6 +77,8 @@ struct _LogProtoServer
   gboolean (*is_preemptable)(LogProtoServer *s);
   gboolean (*restart_with_state)(LogProtoServer *s, PersistState *state, const gchar *persist_name);
   LogProtoStatus (*fetch)(LogProtoServer *s, const guchar **msg, gsize *msg_len, gboolean *may_read, LogTransportAuxData *aux, Bookmark *bookmark);
+  /* optional: fetch up to *num_spans messages at once, all sharing @aux */
+  LogProtoStatus (*fetch_many)(LogProtoServer *s, LogProtoServerSpan *spans, gint *num_spans, gboolean *may_read, LogTransportAuxData *aux);
   gboolean (*validate_options)(LogProtoServer *s);
   void (*free_fn)(LogProtoServer *s);
 };
@@ -115,6 +125,28 @@ log_proto_server_fetch(LogProtoServer *s, const guchar **msg, gsize *msg_len, gb
   return s->status;
 }
 
+static inline gboolean
+log_proto_server_supports_fetch_many(LogProtoServer *s)
+{
+  return s->fetch_many != NULL;
+}
+
+/*
+ * Fetches up to *num_spans messages in one go, *num_spans is updated to
+ * the number of messages returned.  The spans point into the buffer of
+ * the LogProtoServer and remain valid until the next fetch call.  Spans
+ * may be returned along with an error status, those are to be processed
+ * before handling the error.
+ */
+static inline LogProtoStatus
+log_proto_server_fetch_many(LogProtoServer *s, LogProtoServerSpan *spans, gint *num_spans, gboolean *may_read, LogTransportAuxData *aux)
+{
+  if (s->status == LPS_SUCCESS)
+    return s->fetch_many(s, spans, num_spans, may_read, aux);
+  *num_spans = 0;
+  return s->status;
+}
+
 static inline gint
 log_proto_server_get_fd(LogProtoServer *s)
 {
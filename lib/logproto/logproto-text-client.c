@@ -25,8 +25,10 @@
 #include "messages.h"
 
 #include <errno.h>
+#include <string.h>
+#include <limits.h>
 
-static gboolean
+gboolean
 log_proto_text_client_prepare(LogProtoClient *s, gint *fd, GIOCondition *cond)
 {
   LogProtoTextClient *self = (LogProtoTextClient *) s;
@@ -37,13 +39,12 @@ log_proto_text_client_prepare(LogProtoClient *s, gint *fd, GIOCondition *cond)
   /* if there's no pending I/O in the transport layer, then we want to do a write */
   if (*cond == 0)
     *cond = G_IO_OUT;
-  return self->partial != NULL;
+  return self->partial != NULL || self->batch_count > 0;
 }
 
 static LogProtoStatus
-log_proto_text_client_flush(LogProtoClient *s)
+log_proto_text_client_flush_partial(LogProtoTextClient *self)
 {
-  LogProtoTextClient *self = (LogProtoTextClient *) s;
   gint rc;
 
   /* attempt to flush previously buffered data */
@@ -71,8 +72,7 @@ log_proto_text_client_flush(LogProtoClient *s)
         }
       else
         {
-          if (self->partial_free)
-            self->partial_free(self->partial);
+          log_transport_release_buffer(self->super.transport, self->partial, self->partial_free);
           self->partial = NULL;
           if (self->next_state >= 0)
             {
@@ -80,7 +80,7 @@ log_proto_text_client_flush(LogProtoClient *s)
               self->next_state = -1;
             }
 
-          log_proto_client_msg_ack(&self->super, 1);
+          log_proto_client_msg_ack(&self->super, self->partial_acks);
 
           /* NOTE: we return here to give a chance to the framed protocol to send the frame header. */
           return LPS_SUCCESS;
@@ -89,8 +89,95 @@ log_proto_text_client_flush(LogProtoClient *s)
   return LPS_SUCCESS;
 }
 
+/*
+ * Writes the collected batch with a single vectored write. If the write
+ * stops in the middle of a message, that one (and the ones after it) are
+ * moved to the partial buffer, just like in the non-batching case.
+ */
+static LogProtoStatus
+log_proto_text_client_flush_batch(LogProtoTextClient *self)
+{
+  gssize rc;
+  gsize sum = 0, ofs;
+  gint i = 0, j;
+
+  rc = log_transport_writev(self->super.transport, self->batch, self->batch_count);
+  if (rc < 0)
+    {
+      if (errno != EAGAIN && errno != EINTR)
+        {
+          msg_error("I/O error occurred while writing",
+                    evt_tag_int("fd", self->super.transport->fd),
+                    evt_tag_errno(EVT_TAG_OSERROR, errno),
+                    NULL);
+          return LPS_ERROR;
+        }
+      return LPS_SUCCESS;
+    }
+
+  /* messages written completely */
+  while (i < self->batch_count && sum + self->batch[i].iov_len <= (gsize) rc)
+    {
+      sum += self->batch[i].iov_len;
+      log_transport_release_buffer(self->super.transport, self->batch[i].iov_base, self->super.msg_free);
+      i++;
+    }
+
+  if (i < self->batch_count && sum == (gsize) rc)
+    {
+      /* stopped at a message boundary (always the case with datagram
+       * transports), keep the rest in the batch as separate messages */
+      memmove(self->batch, &self->batch[i], (self->batch_count - i) * sizeof(self->batch[0]));
+      self->batch_count -= i;
+      self->batch_len -= sum;
+      if (i > 0)
+        log_proto_client_msg_ack(&self->super, i);
+      return LPS_SUCCESS;
+    }
+
+  if (i < self->batch_count)
+    {
+      ofs = rc - sum;
+      self->partial_len = self->batch_len - rc;
+      self->partial = g_malloc(self->partial_len);
+      self->partial_pos = 0;
+      self->partial_free = (GDestroyNotify) g_free;
+      self->partial_acks = self->batch_count - i;
+      self->next_state = -1;
+
+      memcpy(self->partial, ((guchar *) self->batch[i].iov_base) + ofs, self->batch[i].iov_len - ofs);
+      ofs = self->batch[i].iov_len - ofs;
+      log_transport_release_buffer(self->super.transport, self->batch[i].iov_base, self->super.msg_free);
+      for (j = i + 1; j < self->batch_count; j++)
+        {
+          memcpy(self->partial + ofs, self->batch[j].iov_base, self->batch[j].iov_len);
+          ofs += self->batch[j].iov_len;
+          self->super.msg_free(self->batch[j].iov_base);
+        }
+    }
+  self->batch_count = 0;
+  self->batch_len = 0;
+
+  if (i > 0)
+    log_proto_client_msg_ack(&self->super, i);
+  return LPS_SUCCESS;
+}
+
 LogProtoStatus
-log_proto_text_client_submit_write(LogProtoClient *s, guchar *msg, gsize msg_len, GDestroyNotify msg_free, gint next_state)
+log_proto_text_client_flush(LogProtoClient *s)
+{
+  LogProtoTextClient *self = (LogProtoTextClient *) s;
+  LogProtoStatus rc;
+
+  rc = log_proto_text_client_flush_partial(self);
+  if (rc != LPS_SUCCESS || self->partial || self->batch_count == 0)
+    return rc;
+  return log_proto_text_client_flush_batch(self);
+}
+
+static LogProtoStatus
+log_proto_text_client_submit(LogProtoClient *s, guchar *msg, gsize msg_len, GDestroyNotify msg_free,
+                             gint next_state, gint num_msgs)
 {
   LogProtoTextClient *self = (LogProtoTextClient *) s;
 
@@ -99,10 +186,24 @@ log_proto_text_client_submit_write(LogProtoClient *s, guchar *msg, gsize msg_len
   self->partial_len = msg_len;
   self->partial_pos = 0;
   self->partial_free = msg_free;
+  self->partial_acks = num_msgs;
   self->next_state = next_state;
   return log_proto_text_client_flush(s);
 }
 
+LogProtoStatus
+log_proto_text_client_submit_write(LogProtoClient *s, guchar *msg, gsize msg_len, GDestroyNotify msg_free, gint next_state)
+{
+  return log_proto_text_client_submit(s, msg, msg_len, msg_free, next_state, 1);
+}
+
+/* same as submit_write, but @msg contains @num_msgs messages, acked once all of it is written */
+LogProtoStatus
+log_proto_text_client_submit_batch(LogProtoClient *s, guchar *msg, gsize msg_len, GDestroyNotify msg_free, gint num_msgs)
+{
+  return log_proto_text_client_submit(s, msg, msg_len, msg_free, -1, num_msgs);
+}
+
 
 /*
  * log_proto_text_client_post:
@@ -121,9 +222,9 @@ log_proto_text_client_post(LogProtoClient *s, guchar *msg, gsize msg_len, gboole
   LogProtoTextClient *self = (LogProtoTextClient *) s;
   gint rc;
 
-  /* try to flush already buffered data */
+  /* try to flush already buffered data, the batch is only written once it is full */
   *consumed = FALSE;
-  rc = log_proto_text_client_flush(s);
+  rc = log_proto_text_client_flush_partial(self);
   if (rc == LPS_ERROR)
     {
       /* log_proto_flush() already logs in the case of an error */
@@ -146,17 +247,45 @@ log_proto_text_client_post(LogProtoClient *s, guchar *msg, gsize msg_len, gboole
       return rc;
     }
 
+  if (!self->batch)
+    {
+      *consumed = TRUE;
+      return log_proto_text_client_submit_write(s, msg, msg_len, self->super.msg_free, -1);
+    }
+
+  if (self->batch_count == self->batch_size)
+    {
+      /* the previous batch was not written completely */
+      rc = log_proto_text_client_flush_batch(self);
+      if (rc != LPS_SUCCESS || self->partial || self->batch_count == self->batch_size)
+        return rc;
+    }
+
   *consumed = TRUE;
-  return log_proto_text_client_submit_write(s, msg, msg_len, (GDestroyNotify) g_free, -1);
+  self->batch[self->batch_count].iov_base = msg;
+  self->batch[self->batch_count].iov_len = msg_len;
+  self->batch_count++;
+  self->batch_len += msg_len;
+
+  if (self->batch_count == self->batch_size ||
+      (self->batch_max_len > 0 && self->batch_len >= self->batch_max_len))
+    return log_proto_text_client_flush_batch(self);
+  return LPS_SUCCESS;
 }
 
 void
 log_proto_text_client_free(LogProtoClient *s)
 {
   LogProtoTextClient *self = (LogProtoTextClient *)s;
-  if (self->partial_free)
-    self->partial_free(self->partial);
+  gint i;
+
+  /* the partial buffer might have been written in part */
+  if (self->partial)
+    log_transport_release_buffer(self->super.transport, self->partial, self->partial_free);
   self->partial = NULL;
+  for (i = 0; i < self->batch_count; i++)
+    self->super.msg_free(self->batch[i].iov_base);
+  g_free(self->batch);
   log_proto_client_free_method(s);
 };
 
@@ -172,11 +301,33 @@ log_proto_text_client_init(LogProtoTextClient *self, LogTransport *transport, co
   self->next_state = -1;
 }
 
+/*
+ * Batching mode: messages are collected until either @batch_lines
+ * messages or @batch_bytes bytes are pending, or the writer flushes, and
+ * are then sent with a single vectored write. Only works if the transport
+ * supports vectored writes.
+ */
+void
+log_proto_text_client_set_batching(LogProtoTextClient *self, gint batch_lines, gint batch_bytes)
+{
+#ifdef IOV_MAX
+  if (batch_lines > IOV_MAX)
+    batch_lines = IOV_MAX;
+#endif
+  if (batch_lines <= 1 || !self->super.transport->writev)
+    return;
+
+  self->batch = g_new(struct iovec, batch_lines);
+  self->batch_size = batch_lines;
+  self->batch_max_len = batch_bytes > 0 ? batch_bytes : 0;
+}
+
 LogProtoClient *
 log_proto_text_client_new(LogTransport *transport, const LogProtoClientOptions *options)
 {
   LogProtoTextClient *self = g_new0(LogProtoTextClient, 1);
 
   log_proto_text_client_init(self, transport, options);
+  log_proto_text_client_set_batching(self, options->batch_lines, options->batch_bytes);
   return &self->super;
 }
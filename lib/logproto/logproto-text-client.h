@@ -33,9 +33,21 @@ typedef struct _LogProtoTextClient
   guchar *partial;
   GDestroyNotify partial_free;
   gsize partial_len, partial_pos;
+  /* number of messages to ack once the partial buffer is written */
+  gint partial_acks;
+
+  /* batching mode: messages collected for a single vectored write */
+  struct iovec *batch;
+  gint batch_size, batch_count;
+  gsize batch_len, batch_max_len;
 } LogProtoTextClient;
 
 LogProtoStatus log_proto_text_client_submit_write(LogProtoClient *s, guchar *msg, gsize msg_len, GDestroyNotify msg_free, gint next_state);
+LogProtoStatus log_proto_text_client_submit_batch(LogProtoClient *s, guchar *msg, gsize msg_len, GDestroyNotify msg_free, gint num_msgs);
+gboolean log_proto_text_client_prepare(LogProtoClient *s, gint *fd, GIOCondition *cond);
+LogProtoStatus log_proto_text_client_flush(LogProtoClient *s);
+void log_proto_text_client_free(LogProtoClient *s);
+void log_proto_text_client_set_batching(LogProtoTextClient *self, gint batch_lines, gint batch_bytes);
 void log_proto_text_client_init(LogProtoTextClient *self, LogTransport *transport, const LogProtoClientOptions *options);
 LogProtoClient *log_proto_text_client_new(LogTransport *transport, const LogProtoClientOptions *options);
 
@@ -133,6 +133,9 @@ log_proto_text_server_get_raw_size_of_buffer(LogProtoTextServer *self, const guc
   gsize avail_out, avail_in;
   gint ret;
 
+  if (self->super.fast_converter != LPFC_NONE)
+    return log_proto_fast_converter_get_raw_size(self->super.fast_converter, buffer, buffer_len);
+
   if (self->reverse_convert == ((GIConv) -1) && !self->convert_scale)
     {
       /* try to speed up raw size calculation by recognizing the most
@@ -193,6 +196,11 @@ log_proto_text_server_split_buffer(LogProtoTextServer *self, LogProtoBufferedSer
 {
   gsize raw_split_size;
 
+  /* earlier messages of the current batch still point into the buffer,
+   * the split is done by the next fetch */
+  if (self->super.batch_in_progress)
+    return;
+
   /* buffer is not full, but no EOL is present, move partial line
    * to the beginning of the buffer to make space for new data.
    */
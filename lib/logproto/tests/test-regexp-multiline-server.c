@@ -195,6 +195,32 @@ test_first_line_without_prefix(gboolean input_is_stream)
   multi_line_regexp_free(re);
 }
 
+static void
+test_prefix_with_quantified_literal(gboolean input_is_stream)
+{
+  LogProtoServer *proto;
+  MultiLineRegexp *re;
+
+  proto = log_proto_prefix_garbage_multiline_server_new(
+            (input_is_stream ? log_transport_mock_stream_new : log_transport_mock_records_new)(
+              "F[X first\n"
+              "Fooo[X second\n"
+              "F multi\n"
+              "Fo[X final\n", -1,
+              LTM_PADDING,
+              LTM_EOF),
+            get_inited_proto_server_options(),
+            re = multi_line_regexp_compile("^Fo*\\[X", NULL),
+            NULL);
+
+  assert_proto_server_fetch(proto, "F[X first", -1);
+  assert_proto_server_fetch(proto, "Fooo[X second\nF multi", -1);
+
+  log_proto_server_free(proto);
+  log_proto_server_options_destroy(&proto_server_options);
+  multi_line_regexp_free(re);
+}
+
 void
 test_log_proto_regexp_multiline_server(void)
 {
@@ -208,4 +234,6 @@ test_log_proto_regexp_multiline_server(void)
   PROTO_TESTCASE(test_lines_separated_with_garbage, TRUE);
   PROTO_TESTCASE(test_first_line_without_prefix, FALSE);
   PROTO_TESTCASE(test_first_line_without_prefix, TRUE);
+  PROTO_TESTCASE(test_prefix_with_quantified_literal, FALSE);
+  PROTO_TESTCASE(test_prefix_with_quantified_literal, TRUE);
 }
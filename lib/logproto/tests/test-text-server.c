@@ -228,6 +228,45 @@ test_log_proto_text_server_iso8859_2(void)
   log_proto_server_free(proto);
 }
 
+static void
+test_log_proto_text_server_latin1(void)
+{
+  LogProtoServer *proto;
+
+  log_proto_server_options_set_encoding(&proto_server_options, "latin1");
+  proto = construct_test_proto(
+            log_transport_mock_stream_new(
+              /* latin1, this one uses the built-in converter */
+              "\xe1\x72\x76\xed\x7a\x74\xfc\x72\xf5\x74\xfc\x6b\xf6\x72\x66\xfa"      /*  |árvíztürõtükörfú| */
+              "\x72\xf3\x67\xe9\x70\n", -1,                                           /*  |rógép|            */
+              LTM_EOF));
+
+  assert_true(log_proto_server_validate_options(proto), "validate_options() returned failure but it should have succeeded");
+  assert_proto_server_fetch(proto, "árvíztürõtükörfúrógép", -1);
+  assert_proto_server_fetch_failure(proto, LPS_EOF, NULL);
+  log_proto_server_free(proto);
+}
+
+static void
+test_log_proto_text_server_utf16le(void)
+{
+  LogProtoServer *proto;
+
+  log_proto_server_options_set_encoding(&proto_server_options, "UTF-16LE");
+  proto = construct_test_proto(
+            log_transport_mock_stream_new(
+              /* the surrogate pair of U+1F600 is split between the chunks */
+              "\xe1\x00r\x00v\x00\xed\x00z\x00\x3d\xd8", 12,
+              "\x00\xde\n\x00" "k\x00l\x00m\x00n\x00o\x00p\x00q\x00r\x00s\x00\n\x00", 24,
+              LTM_EOF));
+
+  assert_true(log_proto_server_validate_options(proto), "validate_options() returned failure but it should have succeeded");
+  assert_proto_server_fetch(proto, "árvíz\xf0\x9f\x98\x80", -1);
+  assert_proto_server_fetch(proto, "klmnopqrs", -1);
+  assert_proto_server_fetch_failure(proto, LPS_EOF, NULL);
+  log_proto_server_free(proto);
+}
+
 static void
 test_log_proto_text_server_invalid_encoding(void)
 {
@@ -297,6 +336,47 @@ test_log_proto_text_server_multi_read_not_allowed(void)
 #endif
 }
 
+static void
+assert_proto_server_fetch_many(LogProtoServer *proto, LogProtoStatus expected_status, const gchar **expected_msgs, gint expected_count)
+{
+  LogProtoServerSpan spans[8];
+  gint num_spans = G_N_ELEMENTS(spans);
+  LogTransportAuxData aux;
+  gboolean may_read = TRUE;
+  LogProtoStatus status;
+  gint i;
+
+  log_transport_aux_data_init(&aux);
+  status = log_proto_server_fetch_many(proto, spans, &num_spans, &may_read, &aux);
+  log_transport_aux_data_destroy(&aux);
+
+  assert_gint(status, expected_status, "LogProtoServer fetch_many() returned unexpected status");
+  assert_gint(num_spans, expected_count, "LogProtoServer fetch_many() returned unexpected number of messages");
+  for (i = 0; i < num_spans; i++)
+    assert_nstring((const gchar *) spans[i].msg, spans[i].msg_len, expected_msgs[i], -1, "LogProtoServer fetch_many() message mismatch");
+}
+
+static void
+test_log_proto_text_server_fetch_many_returns_the_lines_in_the_buffer(void)
+{
+  LogProtoServer *proto;
+  const gchar *first_batch[] = { "foo", "bar", "baz" };
+  const gchar *second_batch[] = { "partial" };
+
+  proto = construct_test_proto(
+            log_transport_mock_records_new(
+              "foo\nbar\nbaz\npart", -1,
+              /* the partial line must survive the first batch */
+              "ial\n", -1,
+              LTM_EOF));
+
+  assert_true(log_proto_server_supports_fetch_many(proto), "LogProtoTextServer should support fetch_many()");
+  assert_proto_server_fetch_many(proto, LPS_SUCCESS, first_batch, G_N_ELEMENTS(first_batch));
+  assert_proto_server_fetch_many(proto, LPS_SUCCESS, second_batch, G_N_ELEMENTS(second_batch));
+  assert_proto_server_fetch_many(proto, LPS_EOF, NULL, 0);
+  log_proto_server_free(proto);
+}
+
 LogProtoServer *
 construct_test_proto_with_accumulator(gint (*accumulator)(LogProtoTextServer *, const guchar *, gsize, gssize), LogTransport *transport)
 {
@@ -538,9 +618,12 @@ test_log_proto_text_server(void)
   PROTO_TESTCASE(test_log_proto_text_server_not_fixed_encoding);
   PROTO_TESTCASE(test_log_proto_text_server_ucs4);
   PROTO_TESTCASE(test_log_proto_text_server_iso8859_2);
+  PROTO_TESTCASE(test_log_proto_text_server_latin1);
+  PROTO_TESTCASE(test_log_proto_text_server_utf16le);
   PROTO_TESTCASE(test_log_proto_text_server_invalid_encoding);
   PROTO_TESTCASE(test_log_proto_text_server_multi_read);
   PROTO_TESTCASE(test_log_proto_text_server_multi_read_not_allowed);
+  PROTO_TESTCASE(test_log_proto_text_server_fetch_many_returns_the_lines_in_the_buffer);
   PROTO_TESTCASE(test_log_proto_text_server_is_not_fetching_input_as_long_as_there_is_an_eol_in_buffer);
   PROTO_TESTCASE(test_log_proto_text_server_accumulation_terminated_if_input_is_closed, FALSE);
   PROTO_TESTCASE(test_log_proto_text_server_accumulation_terminated_if_input_is_closed, TRUE);
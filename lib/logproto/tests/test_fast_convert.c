@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "testutils.h"
+#include "logproto/logproto-fast-convert.h"
+
+#include <string.h>
+#include <errno.h>
+
+static void
+assert_conversion(LogProtoFastConverter converter, const gchar *input, gsize input_len, const gchar *expected)
+{
+  guchar output[256];
+  const guchar *in = (const guchar *) input;
+  guchar *out = output;
+  gsize in_len = input_len, out_len = sizeof(output);
+
+  assert_guint64(log_proto_fast_convert(converter, &in, &in_len, &out, &out_len), 0,
+                 "Conversion failed, expected=%s", expected);
+  assert_guint64(in_len, 0, "Input was not consumed completely, expected=%s", expected);
+  assert_nstring((gchar *) output, out - output, expected, -1, "Conversion result mismatch");
+  assert_guint64(log_proto_fast_converter_get_raw_size(converter, output, out - output), input_len,
+                 "Raw size of the converted data mismatch, expected=%s", expected);
+}
+
+static void
+assert_conversion_fails(LogProtoFastConverter converter, const gchar *input, gsize input_len, gint expected_errno, gsize expected_in_len)
+{
+  guchar output[256];
+  const guchar *in = (const guchar *) input;
+  guchar *out = output;
+  gsize in_len = input_len, out_len = sizeof(output);
+
+  assert_guint64(log_proto_fast_convert(converter, &in, &in_len, &out, &out_len), (gsize) -1, "Conversion should have failed");
+  assert_gint(errno, expected_errno, "Conversion failed with an unexpected error");
+  assert_guint64(in_len, expected_in_len, "Conversion stopped at an unexpected position");
+}
+
+static void
+test_lookup(void)
+{
+  assert_gint(log_proto_fast_converter_lookup("US-ASCII"), LPFC_ASCII, "ASCII lookup failed");
+  assert_gint(log_proto_fast_converter_lookup("iso-8859-1"), LPFC_LATIN1, "latin1 lookup failed");
+  assert_gint(log_proto_fast_converter_lookup("ISO_8859-1"), LPFC_LATIN1, "latin1 lookup failed");
+  assert_gint(log_proto_fast_converter_lookup("utf16le"), LPFC_UTF16LE, "UTF-16LE lookup failed");
+  assert_gint(log_proto_fast_converter_lookup("UTF-16BE"), LPFC_UTF16BE, "UTF-16BE lookup failed");
+
+  /* byte order mark handling is left to iconv */
+  assert_gint(log_proto_fast_converter_lookup("UTF-16"), LPFC_NONE, "UTF-16 should not be handled");
+  assert_gint(log_proto_fast_converter_lookup("iso-8859-2"), LPFC_NONE, "latin2 should not be handled");
+}
+
+static void
+test_conversions(void)
+{
+  assert_conversion(LPFC_ASCII, "foobar, this is longer than sixteen bytes", 41, "foobar, this is longer than sixteen bytes");
+  assert_conversion(LPFC_LATIN1, "\xe1rv\xedzt\xfbr\xf5 t\xfck\xf6rf\xfar\xf3g\xe9p", 22, "árvízt\xc3\xbbrõ tükörfúrógép");
+  assert_conversion(LPFC_UTF16LE, "f\0o\0o\0b\0a\0r\0 \0l\0o\0n\0g\0e\0r\0 \0\xe1\0\x3d\xd8\x00\xde", 34,
+                    "foobar longer á\xf0\x9f\x98\x80");
+  assert_conversion(LPFC_UTF16BE, "\0f\0o\0o\0b\0a\0r\0 \0l\0o\0n\0g\0e\0r\0 \0\xe1\xd8\x3d\xde\x00", 34,
+                    "foobar longer á\xf0\x9f\x98\x80");
+}
+
+static void
+test_conversion_errors(void)
+{
+  assert_conversion_fails(LPFC_ASCII, "foo\xe1", 4, EILSEQ, 1);
+
+  /* incomplete characters at the end are left for the next chunk */
+  assert_conversion_fails(LPFC_UTF16LE, "f\0o", 3, EINVAL, 1);
+  assert_conversion_fails(LPFC_UTF16LE, "f\0\x3d\xd8", 4, EINVAL, 2);
+
+  /* unpaired surrogates */
+  assert_conversion_fails(LPFC_UTF16LE, "f\0\x00\xde", 4, EILSEQ, 2);
+  assert_conversion_fails(LPFC_UTF16LE, "\x3d\xd8" "f\0", 4, EILSEQ, 4);
+}
+
+static void
+test_output_buffer_full(void)
+{
+  guchar output[4];
+  const guchar *in = (const guchar *) "\xe1\xe1\xe1";
+  guchar *out = output;
+  gsize in_len = 3, out_len = sizeof(output);
+
+  assert_guint64(log_proto_fast_convert(LPFC_LATIN1, &in, &in_len, &out, &out_len), (gsize) -1, "Conversion should have failed");
+  assert_gint(errno, E2BIG, "Full output buffer should be reported with E2BIG");
+  assert_guint64(in_len, 1, "Complete characters should have been converted");
+  assert_guint64(out_len, 0, "Output buffer should have been filled");
+}
+
+int
+main(int argc, char *argv[])
+{
+  test_lookup();
+  test_conversions();
+  test_conversion_errors();
+  test_output_buffer_full();
+  return 0;
+}
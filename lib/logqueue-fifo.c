@@ -28,6 +28,9 @@
 #include "serialize.h"
 #include "stats/stats-registry.h"
 #include "mainloop-worker.h"
+#include "cpu-topology.h"
+#include "syslog-names.h"
+#include "usdt-probes.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -38,6 +41,11 @@
 
 const QueueType log_queue_fifo_type = "FIFO";
 
+/* number of backlog items released with a single log_msg_drop_batch() call */
+#define LOG_QUEUE_FIFO_ACK_BATCH_SIZE 64
+
+#define LOG_QUEUE_FIFO_MAX_LANES 3
+
 /*
  * LogFifo is a scalable first-in-first-output queue implementation, that:
  *
@@ -69,23 +77,93 @@ const QueueType log_queue_fifo_type = "FIFO";
  *   - the head of the queue is only manipulated from the output thread
  *   - the tail of the queue is only manipulated from the input threads
  *
+ * Lockless mode:
+ *
+ *   With a lot of input threads feeding the same destination, the wait
+ *   queue lock becomes contended.  In lockless mode the per-thread input
+ *   queues and the wait queue are replaced by a bounded multi-producer,
+ *   single-consumer ring of queue nodes:
+ *
+ *   - input threads reserve a slot by advancing the enqueue position with
+ *     a CAS, store the node and publish it by updating the per-slot
+ *     sequence number
+ *
+ *   - the output thread moves published nodes to the output queue once it
+ *     becomes depleted, without locking
+ *
+ *   - the ring is at least as large as the fifo size, so a full ring means
+ *     a full queue, in which case the message is dropped
+ *
+ *   - the lock is only taken to wake up an idle output thread
+ *
+ * NUMA mode:
+ *
+ *   This is the lockless mode with one input ring per NUMA node, input
+ *   threads push to the ring of the node they are running on, so the ring
+ *   positions are only contended within a node.  The output thread drains
+ *   the ring of its own node first and the remote ones after that.  The
+ *   order of messages is only kept within a node: a producer that migrates
+ *   between nodes may have its messages reordered, which is why this goes
+ *   together with binding the I/O worker threads to nodes.
+ *
+ * Priority lanes:
+ *
+ *   The output queue can be split into up to LOG_QUEUE_FIFO_MAX_LANES
+ *   lanes based on the priority of the messages, see
+ *   log_queue_fifo_get_lane().  Items are sorted into their lanes as they
+ *   are moved to the output queue, so the input side is unaffected.  The
+ *   output thread takes items either strictly from the most important
+ *   non-empty lane, or in a weighted round-robin fashion, where lane N
+ *   gets half the share of lane N-1 as long as both have items.  The
+ *   order of messages is only kept within a lane.
  */
 
+typedef struct _LogQueueFifoRingSlot
+{
+  /* position of the slot (+1 if it holds a published node), accessed atomically */
+  gint sequence;
+  LogMessageQueueNode *node;
+} LogQueueFifoRingSlot;
+
+typedef struct _LogQueueFifoRing
+{
+  guint32 mask;
+  /* accessed atomically, advanced by the input threads */
+  gint enqueue_pos;
+  /* only advanced by the output thread, read by the input threads */
+  gint dequeue_pos;
+  LogQueueFifoRingSlot slots[0];
+} LogQueueFifoRing;
+
 
 typedef struct _LogQueueFifo
 {
   LogQueue super;
   
   /* scalable qoverflow implementation */
-  struct iv_list_head qoverflow_output;
   struct iv_list_head qoverflow_wait;
   gint qoverflow_wait_len;
+  /* sum of the lengths of the output lanes */
   gint qoverflow_output_len;
+  struct
+  {
+    struct iv_list_head items;
+    gint len;
+    /* remaining items in the current weighted round */
+    gint credits;
+  } qoverflow_output[LOG_QUEUE_FIFO_MAX_LANES];
+  gint num_lanes;
+  gboolean weighted_lanes;
   gint qoverflow_size; /* in number of elements */
 
   struct iv_list_head qbacklog;    /* entries that were sent but not acked yet */
   gint qbacklog_len;
 
+  /* replace qoverflow_input and qoverflow_wait in lockless mode, one
+   * ring per NUMA node in NUMA mode */
+  LogQueueFifoRing **input_rings;
+  gint num_input_rings;
+
   struct
   {
     struct iv_list_head items;
@@ -103,12 +181,174 @@ typedef struct _LogQueueFifo
  * log_queue_fifo_push_head() or log_queue_fifo_rewind_backlog().
  *
  */
+static LogQueueFifoRing *
+log_queue_fifo_ring_new(gint min_size)
+{
+  LogQueueFifoRing *self;
+  guint32 size = 1, i;
+
+  while (size < min_size)
+    size <<= 1;
+
+  self = g_malloc0(sizeof(LogQueueFifoRing) + size * sizeof(self->slots[0]));
+  self->mask = size - 1;
+  for (i = 0; i < size; i++)
+    self->slots[i].sequence = i;
+  return self;
+}
+
+static inline gint
+log_queue_fifo_ring_get_length(LogQueueFifoRing *self)
+{
+  return g_atomic_int_get(&self->enqueue_pos) - g_atomic_int_get(&self->dequeue_pos);
+}
+
+/* can be called from any thread, returns FALSE if the ring is full */
+static gboolean
+log_queue_fifo_ring_push(LogQueueFifoRing *self, LogMessageQueueNode *node)
+{
+  LogQueueFifoRingSlot *slot;
+  gint pos, diff;
+
+  pos = g_atomic_int_get(&self->enqueue_pos);
+  while (1)
+    {
+      slot = &self->slots[pos & self->mask];
+      diff = g_atomic_int_get(&slot->sequence) - pos;
+      if (diff == 0)
+        {
+          if (g_atomic_int_compare_and_exchange(&self->enqueue_pos, pos, pos + 1))
+            break;
+        }
+      else if (diff < 0)
+        {
+          /* the slot still holds the node from the previous round */
+          return FALSE;
+        }
+      pos = g_atomic_int_get(&self->enqueue_pos);
+    }
+
+  slot->node = node;
+  g_atomic_int_set(&slot->sequence, pos + 1);
+  return TRUE;
+}
+
+/* output thread only, returns NULL if there's no published node at the head */
+static LogMessageQueueNode *
+log_queue_fifo_ring_pop(LogQueueFifoRing *self)
+{
+  gint pos = self->dequeue_pos;
+  LogQueueFifoRingSlot *slot = &self->slots[pos & self->mask];
+  LogMessageQueueNode *node;
+
+  if (g_atomic_int_get(&slot->sequence) - (pos + 1) < 0)
+    return NULL;
+
+  node = slot->node;
+  slot->node = NULL;
+  g_atomic_int_set(&slot->sequence, pos + self->mask + 1);
+  g_atomic_int_set(&self->dequeue_pos, pos + 1);
+  return node;
+}
+
 static gint64
 log_queue_fifo_get_length(LogQueue *s)
 {
   LogQueueFifo *self = (LogQueueFifo *) s;
+  gint64 len = self->qoverflow_wait_len + self->qoverflow_output_len;
+  gint i;
+
+  for (i = 0; i < self->num_input_rings; i++)
+    len += log_queue_fifo_ring_get_length(self->input_rings[i]);
+  return len;
+}
+
+/* lane 0 holds critical and security related messages, the last one
+ * informational and debug ones (the latter only with 3 lanes) */
+static inline gint
+log_queue_fifo_get_lane(LogQueueFifo *self, LogMessage *msg)
+{
+  gint severity = msg->pri & LOG_PRIMASK;
+  gint facility = msg->pri & LOG_FACMASK;
+
+  if (self->num_lanes == 1)
+    return 0;
+  if (severity <= LOG_CRIT || facility == LOG_AUTH)
+    return 0;
+#ifdef LOG_AUTHPRIV
+  if (facility == LOG_AUTHPRIV)
+    return 0;
+#endif
+  if (self->num_lanes == 3 && severity >= LOG_INFO)
+    return 2;
+  return 1;
+}
+
+static inline void
+log_queue_fifo_add_output_tail(LogQueueFifo *self, LogMessageQueueNode *node)
+{
+  gint lane = log_queue_fifo_get_lane(self, node->msg);
+
+  iv_list_add_tail(&node->list, &self->qoverflow_output[lane].items);
+  self->qoverflow_output[lane].len++;
+  self->qoverflow_output_len++;
+}
+
+static inline void
+log_queue_fifo_add_output_head(LogQueueFifo *self, LogMessageQueueNode *node)
+{
+  gint lane = log_queue_fifo_get_lane(self, node->msg);
+
+  iv_list_add(&node->list, &self->qoverflow_output[lane].items);
+  self->qoverflow_output[lane].len++;
+  self->qoverflow_output_len++;
+}
+
+/* moves all items of @q to the tail of their output lanes */
+static void
+log_queue_fifo_splice_to_output(LogQueueFifo *self, struct iv_list_head *q, gint len)
+{
+  if (self->num_lanes == 1)
+    {
+      iv_list_splice_tail_init(q, &self->qoverflow_output[0].items);
+      self->qoverflow_output[0].len += len;
+      self->qoverflow_output_len += len;
+      return;
+    }
 
-  return self->qoverflow_wait_len + self->qoverflow_output_len;
+  while (!iv_list_empty(q))
+    {
+      LogMessageQueueNode *node = iv_list_entry(q->next, LogMessageQueueNode, list);
+
+      iv_list_del(&node->list);
+      log_queue_fifo_add_output_tail(self, node);
+    }
+}
+
+/* returns the lane to take the next item from, the output must not be empty */
+static gint
+log_queue_fifo_select_output_lane(LogQueueFifo *self)
+{
+  gint lane;
+
+  for (lane = 0; lane < self->num_lanes; lane++)
+    {
+      if (self->qoverflow_output[lane].len > 0 &&
+          (!self->weighted_lanes || self->qoverflow_output[lane].credits > 0))
+        break;
+    }
+
+  if (lane == self->num_lanes)
+    {
+      /* all non-empty lanes have used up their share, start a new round */
+      for (lane = 0; lane < self->num_lanes; lane++)
+        self->qoverflow_output[lane].credits = 1 << (self->num_lanes - 1 - lane);
+      for (lane = 0; self->qoverflow_output[lane].len == 0; lane++)
+        ;
+    }
+
+  self->qoverflow_output[lane].credits--;
+  return lane;
 }
 
 gboolean
@@ -141,6 +381,60 @@ log_queue_fifo_keep_on_reload(LogQueue *s)
   return log_queue_fifo_get_length(s) > 0 || self->qbacklog_len > 0;
 }
 
+static gint64
+log_queue_fifo_get_backlog_length(LogQueue *s)
+{
+  LogQueueFifo *self = (LogQueueFifo *) s;
+
+  return self->qbacklog_len;
+}
+
+/* accounts the memory used by @node, if enabled for this queue */
+static inline LogMessageQueueNode *
+log_queue_fifo_account_node(LogQueueFifo *self, LogMessageQueueNode *node)
+{
+  if (log_queue_is_memory_accounted(&self->super))
+    {
+      node->memory_size = log_msg_get_memory_size(node->msg);
+      log_queue_memory_usage_add(&self->super, node->memory_size);
+    }
+  return node;
+}
+
+static inline void
+log_queue_fifo_free_node(LogQueueFifo *self, LogMessageQueueNode *node)
+{
+  if (node->memory_size)
+    log_queue_memory_usage_add(&self->super, -((gssize) node->memory_size));
+  log_msg_free_queue_node(node);
+}
+
+static inline gboolean
+log_queue_fifo_is_full(LogQueueFifo *self)
+{
+  return log_queue_fifo_get_length(&self->super) >= self->qoverflow_size ||
+         log_queue_is_over_memory_limit(&self->super);
+}
+
+static void
+log_queue_fifo_drop_input_head(LogQueueFifo *self, gint thread_id)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessageQueueNode *node = iv_list_entry(self->qoverflow_input[thread_id].items.next, LogMessageQueueNode, list);
+  LogMessage *msg = node->msg;
+
+  iv_list_del(&node->list);
+  self->qoverflow_input[thread_id].len--;
+  path_options.ack_needed = node->ack_needed;
+  path_options.flow_control_requested = node->flow_control_requested;
+  stats_counter_inc(self->super.dropped_messages);
+  log_queue_fifo_free_node(self, node);
+  if (path_options.flow_control_requested)
+    log_msg_drop(msg, &path_options, AT_SUSPENDED);
+  else
+    log_msg_drop(msg, &path_options, AT_PROCESSED);
+}
+
 /* move items from the per-thread input queue to the lock-protected "wait" queue */
 static void
 log_queue_fifo_move_input_unlocked(LogQueueFifo *self, gint thread_id)
@@ -165,7 +459,6 @@ log_queue_fifo_move_input_unlocked(LogQueueFifo *self, gint thread_id)
     {
       /* slow path, the input thread's queue would overflow the queue, let's drop some messages */
 
-      LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
       gint i;
       gint n;
 
@@ -174,21 +467,7 @@ log_queue_fifo_move_input_unlocked(LogQueueFifo *self, gint thread_id)
       n = self->qoverflow_input[thread_id].len - MAX(0, (self->qoverflow_size - queue_len));
 
       for (i = 0; i < n; i++)
-        {
-          LogMessageQueueNode *node = iv_list_entry(self->qoverflow_input[thread_id].items.next, LogMessageQueueNode, list);
-          LogMessage *msg = node->msg;
-
-          iv_list_del(&node->list);
-          self->qoverflow_input[thread_id].len--;
-          path_options.ack_needed = node->ack_needed;
-          path_options.flow_control_requested = node->flow_control_requested;
-          stats_counter_inc(self->super.dropped_messages);
-          log_msg_free_queue_node(node);
-          if (path_options.flow_control_requested)
-            log_msg_drop(msg, &path_options, AT_SUSPENDED);
-          else
-            log_msg_drop(msg, &path_options, AT_PROCESSED);
-        }
+        log_queue_fifo_drop_input_head(self, thread_id);
       msg_debug("Destination queue full, dropping messages",
                 evt_tag_int("queue_len", queue_len),
                 evt_tag_int("log_fifo_size", self->qoverflow_size),
@@ -196,6 +475,25 @@ log_queue_fifo_move_input_unlocked(LogQueueFifo *self, gint thread_id)
                 evt_tag_str("persist_name", self->super.persist_name),
                 NULL);
     }
+
+  /* the memory used by the input queue has already been accounted, drop
+   * its oldest items until it fits the byte limit */
+  if (log_queue_is_over_memory_limit(&self->super) && self->qoverflow_input[thread_id].len > 0)
+    {
+      gint n = 0;
+
+      while (log_queue_is_over_memory_limit(&self->super) && self->qoverflow_input[thread_id].len > 0)
+        {
+          log_queue_fifo_drop_input_head(self, thread_id);
+          n++;
+        }
+      msg_debug("Destination queue is over its byte limit, dropping messages",
+                evt_tag_long("memory_usage", (long) log_queue_get_memory_usage(&self->super)),
+                evt_tag_long("log_fifo_bytes", (long) self->super.memory_limit),
+                evt_tag_int("count", n),
+                evt_tag_str("persist_name", self->super.persist_name),
+                NULL);
+    }
   stats_counter_add(self->super.stored_messages, self->qoverflow_input[thread_id].len);
   iv_list_splice_tail_init(&self->qoverflow_input[thread_id].items, &self->qoverflow_wait);
   self->qoverflow_wait_len += self->qoverflow_input[thread_id].len;
@@ -236,6 +534,70 @@ log_queue_fifo_move_input(gpointer user_data)
  *
  * NOTE: It consumes the reference passed by the caller.
  **/
+static void
+log_queue_fifo_drop_message(LogQueueFifo *self, LogMessage *msg, const LogPathOptions *path_options)
+{
+  stats_counter_inc(self->super.dropped_messages);
+
+  if (path_options->flow_control_requested)
+    log_msg_drop(msg, path_options, AT_SUSPENDED);
+  else
+    log_msg_drop(msg, path_options, AT_PROCESSED);
+
+  msg_debug("Destination queue full, dropping message",
+            evt_tag_int("queue_len", log_queue_fifo_get_length(&self->super)),
+            evt_tag_int("log_fifo_size", self->qoverflow_size),
+            evt_tag_str("persist_name", self->super.persist_name),
+            NULL);
+}
+
+/*
+ * Lockless mode counterpart of log_queue_fifo_push_tail(), can be called
+ * from any thread.
+ *
+ * NOTE: It consumes the reference passed by the caller.
+ */
+static void
+log_queue_fifo_push_tail_lockless(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogQueueFifo *self = (LogQueueFifo *) s;
+  LogQueueFifoRing *ring;
+  LogMessageQueueNode *node;
+
+  /* racy, see the notes in log_queue_fifo_move_input_unlocked() */
+  if (log_queue_fifo_is_full(self))
+    {
+      log_queue_fifo_drop_message(self, msg, path_options);
+      return;
+    }
+
+  if (self->num_input_rings > 1)
+    ring = self->input_rings[cpu_topology_get_current_node() % self->num_input_rings];
+  else
+    ring = self->input_rings[0];
+
+  node = log_queue_fifo_account_node(self, log_msg_alloc_queue_node(msg, path_options));
+  if (!log_queue_fifo_ring_push(ring, node))
+    {
+      log_queue_fifo_free_node(self, node);
+      log_queue_fifo_drop_message(self, msg, path_options);
+      return;
+    }
+  SYSLOG_NG_PROBE2(queue__push, &self->super, msg);
+  stats_counter_inc(self->super.stored_messages);
+  log_msg_unref(msg);
+
+  /* the CAS in log_queue_fifo_ring_push() is a full barrier, if the output
+   * thread registered its callback after that, it will notice our item
+   * in log_queue_check_items() */
+  if (g_atomic_pointer_get((gpointer *) &self->super.parallel_push_notify))
+    {
+      g_static_mutex_lock(&self->super.lock);
+      log_queue_push_notify(&self->super);
+      g_static_mutex_unlock(&self->super.lock);
+    }
+}
+
 static void
 log_queue_fifo_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
 {
@@ -270,9 +632,10 @@ log_queue_fifo_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *pat
           self->qoverflow_input[thread_id].finish_cb_registered = TRUE;
         }
 
-      node = log_msg_alloc_queue_node(msg, path_options);
+      node = log_queue_fifo_account_node(self, log_msg_alloc_queue_node(msg, path_options));
       iv_list_add_tail(&node->list, &self->qoverflow_input[thread_id].items);
       self->qoverflow_input[thread_id].len++;
+      SYSLOG_NG_PROBE2(queue__push, &self->super, msg);
       log_msg_unref(msg);
       return;
     }
@@ -284,12 +647,13 @@ log_queue_fifo_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *pat
   if (thread_id >= 0)
     log_queue_fifo_move_input_unlocked(self, thread_id);
   
-  if (log_queue_fifo_get_length(s) < self->qoverflow_size)
+  if (!log_queue_fifo_is_full(self))
     {
-      node = log_msg_alloc_queue_node(msg, path_options);
+      node = log_queue_fifo_account_node(self, log_msg_alloc_queue_node(msg, path_options));
 
       iv_list_add_tail(&node->list, &self->qoverflow_wait);
       self->qoverflow_wait_len++;
+      SYSLOG_NG_PROBE2(queue__push, &self->super, msg);
       log_queue_push_notify(&self->super);
 
       stats_counter_inc(self->super.stored_messages);
@@ -299,19 +663,8 @@ log_queue_fifo_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *pat
     }
   else
     {
-      stats_counter_inc(self->super.dropped_messages);
       g_static_mutex_unlock(&self->super.lock);
-
-      if (path_options->flow_control_requested)
-        log_msg_drop(msg, path_options, AT_SUSPENDED);
-      else
-        log_msg_drop(msg, path_options, AT_PROCESSED);
-
-      msg_debug("Destination queue full, dropping message",
-                evt_tag_int("queue_len", log_queue_fifo_get_length(&self->super)),
-                evt_tag_int("log_fifo_size", self->qoverflow_size),
-                evt_tag_str("persist_name", self->super.persist_name),
-                NULL);
+      log_queue_fifo_drop_message(self, msg, path_options);
     }
   return;
 }
@@ -333,54 +686,91 @@ log_queue_fifo_push_head(LogQueue *s, LogMessage *msg, const LogPathOptions *pat
    * normally happens when we start processing an item, but at the end
    * can't deliver it. No checks, no drops either. */
 
-  node = log_msg_alloc_dynamic_queue_node(msg, path_options);
-  iv_list_add(&node->list, &self->qoverflow_output);
-  self->qoverflow_output_len++;
+  node = log_queue_fifo_account_node(self, log_msg_alloc_dynamic_queue_node(msg, path_options));
+  log_queue_fifo_add_output_head(self, node);
   log_msg_unref(msg);
 
   stats_counter_inc(self->super.stored_messages);
 }
 
-/*
- * Can only run from the output thread.
- *
- * NOTE: this returns a reference which the caller must take care to free.
- */
-static LogMessage *
-log_queue_fifo_pop_head(LogQueue *s, LogPathOptions *path_options)
+static void
+log_queue_fifo_drain_ring(LogQueueFifo *self, LogQueueFifoRing *ring)
 {
-  LogQueueFifo *self = (LogQueueFifo *) s;
   LogMessageQueueNode *node;
-  LogMessage *msg = NULL;
 
-  if (self->qoverflow_output_len == 0)
+  while ((node = log_queue_fifo_ring_pop(ring)))
+    log_queue_fifo_add_output_tail(self, node);
+}
+
+/* move items to the output queue, only runs from the output thread */
+static void
+log_queue_fifo_refill_output(LogQueueFifo *self)
+{
+  gint local_ring, i;
+
+  if (self->num_input_rings > 0)
+    {
+      /* lockless mode, move all published items from the input rings,
+       * starting with the one of our own NUMA node */
+      local_ring = self->num_input_rings > 1 ? cpu_topology_get_current_node() % self->num_input_rings : 0;
+      for (i = 0; i < self->num_input_rings; i++)
+        log_queue_fifo_drain_ring(self, self->input_rings[(local_ring + i) % self->num_input_rings]);
+    }
+  else
     {
-      /* slow path, output queue is empty, get some elements from the wait queue */
+      /* slow path, get some elements from the wait queue */
       g_static_mutex_lock(&self->super.lock);
-      iv_list_splice_tail_init(&self->qoverflow_wait, &self->qoverflow_output);
-      self->qoverflow_output_len = self->qoverflow_wait_len;
+      log_queue_fifo_splice_to_output(self, &self->qoverflow_wait, self->qoverflow_wait_len);
       self->qoverflow_wait_len = 0;
       g_static_mutex_unlock(&self->super.lock);
     }
+}
 
-  if (self->qoverflow_output_len > 0)
-    {
-      node = iv_list_entry(self->qoverflow_output.next, LogMessageQueueNode, list);
+/* remove the first item of a non-empty output queue, returns a reference */
+static LogMessage *
+log_queue_fifo_take_output_head(LogQueueFifo *self, LogPathOptions *path_options)
+{
+  LogMessageQueueNode *node;
+  LogMessage *msg;
+  gint lane = self->num_lanes == 1 ? 0 : log_queue_fifo_select_output_lane(self);
 
-      msg = node->msg;
-      path_options->ack_needed = node->ack_needed;
-      self->qoverflow_output_len--;
-      if (!self->super.use_backlog)
-        {
-          iv_list_del(&node->list);
-          log_msg_free_queue_node(node);
-        }
-      else
-        {
-          iv_list_del_init(&node->list);
-        }
+  node = iv_list_entry(self->qoverflow_output[lane].items.next, LogMessageQueueNode, list);
+
+  msg = node->msg;
+  path_options->ack_needed = node->ack_needed;
+  self->qoverflow_output[lane].len--;
+  self->qoverflow_output_len--;
+  if (!self->super.use_backlog)
+    {
+      iv_list_del(&node->list);
+      log_queue_fifo_free_node(self, node);
     }
   else
+    {
+      iv_list_del_init(&node->list);
+      log_msg_ref(msg);
+      iv_list_add_tail(&node->list, &self->qbacklog);
+      self->qbacklog_len++;
+    }
+  SYSLOG_NG_PROBE2(queue__pop, &self->super, msg);
+  return msg;
+}
+
+/*
+ * Can only run from the output thread.
+ *
+ * NOTE: this returns a reference which the caller must take care to free.
+ */
+static LogMessage *
+log_queue_fifo_pop_head(LogQueue *s, LogPathOptions *path_options)
+{
+  LogQueueFifo *self = (LogQueueFifo *) s;
+  LogMessage *msg;
+
+  if (self->qoverflow_output_len == 0)
+    log_queue_fifo_refill_output(self);
+
+  if (self->qoverflow_output_len == 0)
     {
       /* no items either on the wait queue nor the output queue.
        *
@@ -392,16 +782,36 @@ log_queue_fifo_pop_head(LogQueue *s, LogPathOptions *path_options)
        */
       return NULL;
     }
+
+  msg = log_queue_fifo_take_output_head(self, path_options);
   stats_counter_dec(self->super.stored_messages);
+  return msg;
+}
 
-  if (self->super.use_backlog)
+/*
+ * Can only run from the output thread. The wait queue lock is taken at
+ * most once, and the counters are updated once for the whole batch.
+ *
+ * NOTE: this returns references which the caller must take care to free.
+ */
+static gint
+log_queue_fifo_pop_head_batch(LogQueue *s, gint max_msgs, LogMessage **msgs, LogPathOptions *path_options)
+{
+  LogQueueFifo *self = (LogQueueFifo *) s;
+  gint num_msgs = 0;
+
+  if (self->qoverflow_output_len < max_msgs)
+    log_queue_fifo_refill_output(self);
+
+  while (num_msgs < max_msgs && self->qoverflow_output_len > 0)
     {
-      log_msg_ref(msg);
-      iv_list_add_tail(&node->list, &self->qbacklog);
-      self->qbacklog_len++;
+      msgs[num_msgs] = log_queue_fifo_take_output_head(self, &path_options[num_msgs]);
+      num_msgs++;
     }
 
-  return msg;
+  if (num_msgs)
+    stats_counter_add(self->super.stored_messages, -num_msgs);
+  return num_msgs;
 }
 
 /*
@@ -411,23 +821,30 @@ static void
 log_queue_fifo_ack_backlog(LogQueue *s, gint rewind_count)
 {
   LogQueueFifo *self = (LogQueueFifo *) s;
-  LogMessage *msg;
-  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
-  gint pos;
+  LogMessage *msgs[LOG_QUEUE_FIFO_ACK_BATCH_SIZE];
+  gboolean ack_needed[LOG_QUEUE_FIFO_ACK_BATCH_SIZE];
+  gint pos, num_msgs = 0;
 
   for (pos = 0; pos < rewind_count && self->qbacklog_len > 0; pos++)
     {
       LogMessageQueueNode *node;
       node = iv_list_entry(self->qbacklog.next, LogMessageQueueNode, list);
-      msg = node->msg;
+      msgs[num_msgs] = node->msg;
+      ack_needed[num_msgs] = node->ack_needed;
+      num_msgs++;
 
       iv_list_del(&node->list);
       self->qbacklog_len--;
-      path_options.ack_needed = node->ack_needed;
-      log_msg_ack(msg, &path_options, AT_PROCESSED);
-      log_msg_free_queue_node(node);
-      log_msg_unref(msg);
+      log_queue_fifo_free_node(self, node);
+
+      if (num_msgs == LOG_QUEUE_FIFO_ACK_BATCH_SIZE)
+        {
+          log_msg_drop_batch(msgs, ack_needed, num_msgs, AT_PROCESSED);
+          num_msgs = 0;
+        }
     }
+  if (num_msgs > 0)
+    log_msg_drop_batch(msgs, ack_needed, num_msgs, AT_PROCESSED);
 }
 
 
@@ -446,8 +863,7 @@ log_queue_fifo_rewind_backlog_all(LogQueue *s)
 {
   LogQueueFifo *self = (LogQueueFifo *) s;
 
-  iv_list_splice_tail_init(&self->qbacklog, &self->qoverflow_output);
-  self->qoverflow_output_len += self->qbacklog_len;
+  log_queue_fifo_splice_to_output(self, &self->qbacklog, self->qbacklog_len);
   stats_counter_add(self->super.stored_messages, self->qbacklog_len);
   self->qbacklog_len = 0;
 }
@@ -470,16 +886,15 @@ log_queue_fifo_rewind_backlog(LogQueue *s, guint rewind_count)
        * The rewind must decrease the ack and ref too
        */
       iv_list_del_init(&node->list);
-      iv_list_add(&node->list, &self->qoverflow_output);
+      log_queue_fifo_add_output_head(self, node);
 
       self->qbacklog_len--;
-      self->qoverflow_output_len++;
       stats_counter_inc(self->super.stored_messages);
     }
 }
 
 static void
-log_queue_fifo_free_queue(struct iv_list_head *q)
+log_queue_fifo_free_queue(LogQueueFifo *self, struct iv_list_head *q)
 {
   while (!iv_list_empty(q))
     {
@@ -492,7 +907,7 @@ log_queue_fifo_free_queue(struct iv_list_head *q)
 
       path_options.ack_needed = node->ack_needed;
       msg = node->msg;
-      log_msg_free_queue_node(node);
+      log_queue_fifo_free_node(self, node);
       log_msg_ack(msg, &path_options, AT_ABORTED);
       log_msg_unref(msg);
     }
@@ -505,11 +920,22 @@ log_queue_fifo_free(LogQueue *s)
   gint i;
 
   for (i = 0; i < log_queue_max_threads; i++)
-    log_queue_fifo_free_queue(&self->qoverflow_input[i].items);
+    log_queue_fifo_free_queue(self, &self->qoverflow_input[i].items);
+
+  for (i = 0; i < self->num_input_rings; i++)
+    {
+      LogMessageQueueNode *node;
 
-  log_queue_fifo_free_queue(&self->qoverflow_wait);
-  log_queue_fifo_free_queue(&self->qoverflow_output);
-  log_queue_fifo_free_queue(&self->qbacklog);
+      while ((node = log_queue_fifo_ring_pop(self->input_rings[i])))
+        iv_list_add_tail(&node->list, &self->qoverflow_wait);
+      g_free(self->input_rings[i]);
+    }
+  g_free(self->input_rings);
+
+  log_queue_fifo_free_queue(self, &self->qoverflow_wait);
+  for (i = 0; i < LOG_QUEUE_FIFO_MAX_LANES; i++)
+    log_queue_fifo_free_queue(self, &self->qoverflow_output[i].items);
+  log_queue_fifo_free_queue(self, &self->qbacklog);
   log_queue_free_method(s);
 }
 
@@ -530,9 +956,11 @@ log_queue_fifo_new(gint qoverflow_size, const gchar *persist_name)
   self->super.push_tail = log_queue_fifo_push_tail;
   self->super.push_head = log_queue_fifo_push_head;
   self->super.pop_head = log_queue_fifo_pop_head;
+  self->super.pop_head_batch = log_queue_fifo_pop_head_batch;
   self->super.ack_backlog = log_queue_fifo_ack_backlog;
   self->super.rewind_backlog = log_queue_fifo_rewind_backlog;
   self->super.rewind_backlog_all = log_queue_fifo_rewind_backlog_all;
+  self->super.get_backlog_length = log_queue_fifo_get_backlog_length;
 
   self->super.free_fn = log_queue_fifo_free;
   
@@ -544,9 +972,63 @@ log_queue_fifo_new(gint qoverflow_size, const gchar *persist_name)
       self->qoverflow_input[i].cb.func = log_queue_fifo_move_input;
     }
   INIT_IV_LIST_HEAD(&self->qoverflow_wait);
-  INIT_IV_LIST_HEAD(&self->qoverflow_output);
+  for (i = 0; i < LOG_QUEUE_FIFO_MAX_LANES; i++)
+    INIT_IV_LIST_HEAD(&self->qoverflow_output[i].items);
+  self->num_lanes = 1;
   INIT_IV_LIST_HEAD(&self->qbacklog);
 
   self->qoverflow_size = qoverflow_size;
   return &self->super;
 }
+
+/*
+ * Same as log_queue_fifo_new(), but input threads put items into a
+ * lock-free ring instead of per-thread input queues, see the comment at
+ * the top of this file.
+ */
+static LogQueue *
+log_queue_fifo_new_with_input_rings(gint qoverflow_size, const gchar *persist_name, gint num_input_rings)
+{
+  LogQueueFifo *self = (LogQueueFifo *) log_queue_fifo_new(qoverflow_size, persist_name);
+  gint i;
+
+  /* each ring can hold the whole queue, as the producers may all be on
+   * the same node */
+  self->input_rings = g_new0(LogQueueFifoRing *, num_input_rings);
+  for (i = 0; i < num_input_rings; i++)
+    self->input_rings[i] = log_queue_fifo_ring_new(MAX(qoverflow_size, 1));
+  self->num_input_rings = num_input_rings;
+  self->super.push_tail = log_queue_fifo_push_tail_lockless;
+  return &self->super;
+}
+
+LogQueue *
+log_queue_fifo_new_lockless(gint qoverflow_size, const gchar *persist_name)
+{
+  return log_queue_fifo_new_with_input_rings(qoverflow_size, persist_name, 1);
+}
+
+/*
+ * Splits the output queue into @num_lanes priority lanes, see the comment
+ * at the top of this file. Must be called before the queue is used.
+ */
+void
+log_queue_fifo_set_lanes(LogQueue *s, gint num_lanes, gboolean weighted)
+{
+  LogQueueFifo *self = (LogQueueFifo *) s;
+
+  g_assert(s->type == log_queue_fifo_type);
+
+  self->num_lanes = CLAMP(num_lanes, 1, LOG_QUEUE_FIFO_MAX_LANES);
+  self->weighted_lanes = weighted;
+}
+
+/*
+ * Lockless mode with one input ring per NUMA node, falls back to a single
+ * ring on non-NUMA systems.
+ */
+LogQueue *
+log_queue_fifo_new_numa(gint qoverflow_size, const gchar *persist_name)
+{
+  return log_queue_fifo_new_with_input_rings(qoverflow_size, persist_name, cpu_topology_get_num_nodes());
+}
@@ -28,5 +28,8 @@
 #include "logqueue.h"
 
 LogQueue *log_queue_fifo_new(gint qoverflow_size, const gchar *persist_name);
+LogQueue *log_queue_fifo_new_lockless(gint qoverflow_size, const gchar *persist_name);
+LogQueue *log_queue_fifo_new_numa(gint qoverflow_size, const gchar *persist_name);
+void log_queue_fifo_set_lanes(LogQueue *s, gint num_lanes, gboolean weighted);
 
 #endif
@@ -25,9 +25,94 @@
 #include "logqueue.h"
 #include "stats/stats-registry.h"
 #include "messages.h"
+#include "logsource.h"
+#include "timeutils.h"
+
+#include <iv.h>
 
 gint log_queue_max_threads = 0;
 
+/* bytes held by all queues of the process and the limit for that, both
+ * are accessed atomically */
+static gssize log_queue_global_memory_usage;
+static gssize log_queue_memory_budget;
+
+static inline gssize
+_atomic_gssize_get(gssize *value)
+{
+  return (gssize) GPOINTER_TO_SIZE(g_atomic_pointer_get((gpointer *) value));
+}
+
+/* returns the old value */
+static gssize
+_atomic_gssize_add(gssize *value, gssize delta)
+{
+  gssize old_value;
+
+  do
+    {
+      old_value = _atomic_gssize_get(value);
+    }
+  while (!g_atomic_pointer_compare_and_exchange((gpointer *) value,
+                                                GSIZE_TO_POINTER((gsize) old_value),
+                                                GSIZE_TO_POINTER((gsize) (old_value + delta))));
+  return old_value;
+}
+
+/*
+ * Memory accounting
+ *
+ * Queues account the approximate size of the messages they hold (see
+ * log_msg_get_memory_size()) if either they have a byte limit
+ * (log-fifo-bytes()) or a process wide budget is set
+ * (queue-memory-budget()).  A queue is expected to drop messages above its
+ * own limit, while the budget is enforced by the sources: they stop
+ * refilling their flow-control window until the usage drops below the
+ * budget again, see log_source_release_memory_budget().
+ */
+gboolean
+log_queue_is_memory_accounted(LogQueue *self)
+{
+  return self->memory_limit > 0 || self->stats.memory_usage || _atomic_gssize_get(&log_queue_memory_budget) > 0;
+}
+
+void
+log_queue_memory_usage_add(LogQueue *self, gssize delta)
+{
+  gssize budget, old_usage;
+
+  _atomic_gssize_add(&self->memory_usage, delta);
+  old_usage = _atomic_gssize_add(&log_queue_global_memory_usage, delta);
+
+  budget = _atomic_gssize_get(&log_queue_memory_budget);
+  if (budget > 0 && old_usage >= budget && old_usage + delta < budget)
+    log_source_release_memory_budget();
+}
+
+gboolean
+log_queue_is_memory_budget_exceeded(void)
+{
+  gssize budget = _atomic_gssize_get(&log_queue_memory_budget);
+
+  return budget > 0 && _atomic_gssize_get(&log_queue_global_memory_usage) >= budget;
+}
+
+gssize
+log_queue_get_global_memory_usage(void)
+{
+  return _atomic_gssize_get(&log_queue_global_memory_usage);
+}
+
+void
+log_queue_set_memory_budget(gssize memory_budget)
+{
+  g_atomic_pointer_set((gpointer *) &log_queue_memory_budget, GSIZE_TO_POINTER((gsize) memory_budget));
+
+  /* sources throttled by the previous budget would not be woken up otherwise */
+  if (!log_queue_is_memory_budget_exceeded())
+    log_source_release_memory_budget();
+}
+
 /*
  * When this is called, it is assumed that the output thread is currently
  * not running (since this is the function that wakes it up), thus we can
@@ -63,6 +148,38 @@ log_queue_push_notify(LogQueue *self)
     }
 }
 
+/*
+ * Puts back the unprocessed tail of a batch returned by
+ * log_queue_pop_head_batch(), consuming the references in @msgs.
+ *
+ * With a backlog, the rewind is positional: it returns the last
+ * @num_msgs backlog items.  This is right even if the message preceding
+ * @msgs has already been rewound on its own, as that rewind takes the
+ * last item of the backlog too, so the order is the same in the end.
+ * Without a backlog, this has to be called before the messages preceding
+ * @msgs are pushed back.
+ */
+void
+log_queue_unpop_batch(LogQueue *self, LogMessage **msgs, LogPathOptions *path_options, gint num_msgs)
+{
+  gint i;
+
+  if (self->use_backlog)
+    {
+      log_queue_rewind_backlog(self, num_msgs);
+      for (i = 0; i < num_msgs; i++)
+        log_msg_unref(msgs[i]);
+    }
+  else
+    {
+      for (i = num_msgs - 1; i >= 0; i--)
+        log_queue_push_head(self, msgs[i], &path_options[i]);
+    }
+
+  if (self->throttle)
+    self->throttle_buckets = MIN(self->throttle, self->throttle_buckets + num_msgs);
+}
+
 void
 log_queue_reset_parallel_push(LogQueue *self)
 {
@@ -102,11 +219,19 @@ log_queue_check_items(LogQueue *self, gint *timeout, LogQueuePushNotifyFunc para
   num_elements = log_queue_get_length(self);
   if (num_elements == 0)
     {
-      self->parallel_push_notify = parallel_push_notify;
       self->parallel_push_data = user_data;
       self->parallel_push_data_destroy = user_data_destroy;
-      g_static_mutex_unlock(&self->lock);
-      return FALSE;
+      g_atomic_pointer_set((gpointer *) &self->parallel_push_notify, (gpointer) parallel_push_notify);
+
+      /* lockless producers check parallel_push_notify without holding
+       * the lock after adding an item, check again so that an item added
+       * right before registering the callback is not missed */
+      num_elements = log_queue_get_length(self);
+      if (num_elements == 0)
+        {
+          g_static_mutex_unlock(&self->lock);
+          return FALSE;
+        }
     }
 
   /* consume the user_data reference as we won't use the callback */
@@ -175,6 +300,151 @@ log_queue_set_counters(LogQueue *self, StatsCounterItem *stored_messages, StatsC
   stats_counter_set(self->stored_messages, log_queue_get_length(self));
 }
 
+/*
+ * Queue gauges
+ *
+ * On top of the stored/dropped counters of the destination, queues
+ * maintain gauges of the memory used by the messages they hold, the size
+ * of the backlog and the push/pop rates, plus implementation specific ones
+ * (e.g. disk-buffer positions).  They are registered at stats-level(2)
+ * into the cluster of the destination and updated once a second from the
+ * main thread, so that the message path only pays for counting pops.  The
+ * push rate is derived from the pop rate and the change of the queue
+ * length, dropped messages are not pushed.
+ */
+#define LOG_QUEUE_STATS_UPDATE_FREQ 1000
+
+static GList *log_queue_stats_queues;
+static struct iv_timer log_queue_stats_timer;
+
+static void
+_update_rate(StatsCounterItem *counter, gint64 delta, gint64 elapsed_usec)
+{
+  if (elapsed_usec > 0)
+    stats_counter_set(counter, MAX(delta, 0) * G_USEC_PER_SEC / elapsed_usec);
+}
+
+void
+log_queue_update_stats_counters(LogQueue *self, const GTimeVal *now)
+{
+  guint popped = self->stats.popped;
+  gint64 length = log_queue_get_length(self);
+  gint64 popped_delta = (gint) (popped - self->stats.last_popped);
+
+  stats_counter_set(self->stats.memory_usage, log_queue_get_memory_usage(self));
+  if (self->get_backlog_length)
+    stats_counter_set(self->stats.backlog, self->get_backlog_length(self));
+
+  if (self->stats.last_update.tv_sec)
+    {
+      gint64 elapsed = g_time_val_diff((GTimeVal *) now, &self->stats.last_update);
+
+      _update_rate(self->stats.pop_rate, popped_delta, elapsed);
+      _update_rate(self->stats.push_rate, popped_delta + length - self->stats.last_length, elapsed);
+    }
+  self->stats.last_popped = popped;
+  self->stats.last_length = length;
+  self->stats.last_update = *now;
+
+  if (self->update_stats_counters)
+    self->update_stats_counters(self);
+}
+
+static void
+_stats_timer_rearm(void)
+{
+  iv_validate_now();
+  log_queue_stats_timer.expires = iv_now;
+  timespec_add_msec(&log_queue_stats_timer.expires, LOG_QUEUE_STATS_UPDATE_FREQ);
+  iv_timer_register(&log_queue_stats_timer);
+}
+
+static void
+_stats_timer_elapsed(gpointer user_data)
+{
+  GTimeVal now;
+  GList *l;
+
+  g_get_current_time(&now);
+  for (l = log_queue_stats_queues; l; l = l->next)
+    log_queue_update_stats_counters((LogQueue *) l->data, &now);
+  _stats_timer_rearm();
+}
+
+/*
+ * Registers the gauges of the queue into the stats cluster given, which is
+ * normally the one of the destination consuming the queue.  Must be
+ * called from the main thread, holding the stats lock.
+ */
+void
+log_queue_register_stats_counters(LogQueue *self, gint stats_level, gint component, const gchar *id, const gchar *instance)
+{
+  if (!stats_check_level(MAX(stats_level, STATS_LEVEL2)))
+    return;
+
+  stats_register_counter(STATS_LEVEL2, component, id, instance, SC_TYPE_MEMORY_USAGE, &self->stats.memory_usage);
+  if (self->get_backlog_length)
+    stats_register_counter(STATS_LEVEL2, component, id, instance, SC_TYPE_BACKLOG, &self->stats.backlog);
+  stats_register_counter(STATS_LEVEL2, component, id, instance, SC_TYPE_PUSH_RATE, &self->stats.push_rate);
+  stats_register_counter(STATS_LEVEL2, component, id, instance, SC_TYPE_POP_RATE, &self->stats.pop_rate);
+  if (self->register_stats_counters)
+    self->register_stats_counters(self, STATS_LEVEL2, component, id, instance);
+
+  self->stats.last_update.tv_sec = 0;
+  if (!log_queue_stats_queues)
+    {
+      IV_TIMER_INIT(&log_queue_stats_timer);
+      log_queue_stats_timer.handler = _stats_timer_elapsed;
+      _stats_timer_rearm();
+    }
+  log_queue_stats_queues = g_list_prepend(log_queue_stats_queues, self);
+}
+
+void
+log_queue_unregister_stats_counters(LogQueue *self, gint component, const gchar *id, const gchar *instance)
+{
+  if (!self->stats.pop_rate)
+    return;
+
+  stats_unregister_counter(component, id, instance, SC_TYPE_MEMORY_USAGE, &self->stats.memory_usage);
+  stats_unregister_counter(component, id, instance, SC_TYPE_BACKLOG, &self->stats.backlog);
+  stats_unregister_counter(component, id, instance, SC_TYPE_PUSH_RATE, &self->stats.push_rate);
+  stats_unregister_counter(component, id, instance, SC_TYPE_POP_RATE, &self->stats.pop_rate);
+  if (self->unregister_stats_counters)
+    self->unregister_stats_counters(self, component, id, instance);
+
+  log_queue_stats_queues = g_list_remove(log_queue_stats_queues, self);
+  if (!log_queue_stats_queues && iv_timer_registered(&log_queue_stats_timer))
+    iv_timer_unregister(&log_queue_stats_timer);
+}
+
+/*
+ * Called when a destination holds more flow-controlled messages than its
+ * flow-control-budget(). The message is acknowledged towards the source
+ * right away, so that a backed up destination does not stall the window
+ * of a source shared with other destinations. From this point on it is
+ * queued as if flow-control was not requested, e.g. it is dropped once
+ * the queue is full or it is spilled to the disk-buffer.
+ */
+const LogPathOptions *
+log_queue_release_flow_control(LogQueue *self, LogMessage *msg, const LogPathOptions *path_options, LogPathOptions *local_options)
+{
+  log_msg_ack(msg, path_options, AT_PROCESSED);
+
+  *local_options = *path_options;
+  local_options->ack_needed = FALSE;
+  local_options->flow_control_requested = FALSE;
+
+  if (G_UNLIKELY(debug_flag))
+    {
+      msg_debug("Destination is over its flow-control budget, releasing the source window",
+                evt_tag_int("flow_control_budget", self->flow_control_budget),
+                evt_tag_str("persist_name", self->persist_name),
+                NULL);
+    }
+  return local_options;
+}
+
 void
 log_queue_init_instance(LogQueue *self, const gchar *persist_name)
 {
@@ -27,6 +27,7 @@
 
 #include "logmsg/logmsg.h"
 #include "stats/stats-registry.h"
+#include "stats/stats-trace.h"
 
 extern gint log_queue_max_threads;
 
@@ -48,10 +49,35 @@ struct _LogQueue
   gint throttle_buckets;
   GTimeVal last_throttle_check;
 
+  /* number of queued messages above which flow-controlled messages stop
+   * holding the source window, 0 means unlimited */
+  gint flow_control_budget;
+
+  /* bytes used by the messages held by this queue and the limit for that,
+   * 0 meaning unlimited, accessed atomically */
+  gssize memory_usage;
+  gssize memory_limit;
+
   gchar *persist_name;
   StatsCounterItem *stored_messages;
   StatsCounterItem *dropped_messages;
 
+  /* see log_queue_register_stats_counters() */
+  struct
+  {
+    StatsCounterItem *memory_usage;
+    StatsCounterItem *backlog;
+    StatsCounterItem *push_rate;
+    StatsCounterItem *pop_rate;
+
+    /* messages taken by the consumer, minus the ones put back, only
+     * updated by the consumer thread */
+    guint popped;
+    guint last_popped;
+    gint64 last_length;
+    GTimeVal last_update;
+  } stats;
+
   GStaticMutex lock;
   LogQueuePushNotifyFunc parallel_push_notify;
   gpointer parallel_push_data;
@@ -64,9 +90,19 @@ struct _LogQueue
   void (*push_tail)(LogQueue *self, LogMessage *msg, const LogPathOptions *path_options);
   void (*push_head)(LogQueue *self, LogMessage *msg, const LogPathOptions *path_options);
   LogMessage *(*pop_head)(LogQueue *self, LogPathOptions *path_options);
+  /* optional, returns the number of messages stored in @msgs */
+  gint (*pop_head_batch)(LogQueue *self, gint max_msgs, LogMessage **msgs, LogPathOptions *path_options);
   void (*ack_backlog)(LogQueue *self, gint n);
   void (*rewind_backlog)(LogQueue *self, guint rewind_count);
   void (*rewind_backlog_all)(LogQueue *self);
+  /* optional, number of messages in the backlog */
+  gint64 (*get_backlog_length)(LogQueue *self);
+
+  /* optional, implementation specific gauges, same locking as
+   * log_queue_register_stats_counters() */
+  void (*register_stats_counters)(LogQueue *self, gint stats_level, gint component, const gchar *id, const gchar *instance);
+  void (*unregister_stats_counters)(LogQueue *self, gint component, const gchar *id, const gchar *instance);
+  void (*update_stats_counters)(LogQueue *self);
 
   void (*free_fn)(LogQueue *self);
 };
@@ -94,15 +130,25 @@ log_queue_is_empty_racy(LogQueue *self)
     return (self->get_length(self) == 0);
 }
 
+const LogPathOptions *log_queue_release_flow_control(LogQueue *self, LogMessage *msg,
+                                                    const LogPathOptions *path_options, LogPathOptions *local_options);
+
 static inline void
 log_queue_push_tail(LogQueue *self, LogMessage *msg, const LogPathOptions *path_options)
 {
+  LogPathOptions local_options;
+
+  if (G_UNLIKELY(self->flow_control_budget > 0 && path_options->ack_needed && path_options->flow_control_requested) &&
+      log_queue_get_length(self) >= self->flow_control_budget)
+    path_options = log_queue_release_flow_control(self, msg, path_options, &local_options);
+  stats_trace_message_queued(msg);
   self->push_tail(self, msg, path_options);
 }
 
 static inline void
 log_queue_push_head(LogQueue *self, LogMessage *msg, const LogPathOptions *path_options)
 {
+  self->stats.popped--;
   self->push_head(self, msg, path_options);
 }
 
@@ -115,8 +161,11 @@ log_queue_pop_head(LogQueue *self, LogPathOptions *path_options)
     return NULL;
 
   msg = self->pop_head(self, path_options);
+  if (!msg)
+    return NULL;
 
-  if (msg && self->throttle_buckets > 0)
+  self->stats.popped++;
+  if (self->throttle_buckets > 0)
     self->throttle_buckets--;
 
   return msg;
@@ -125,7 +174,53 @@ log_queue_pop_head(LogQueue *self, LogPathOptions *path_options)
 static inline LogMessage *
 log_queue_pop_head_ignore_throttle(LogQueue *self, LogPathOptions *path_options)
 {
-  return self->pop_head(self, path_options);
+  LogMessage *msg = self->pop_head(self, path_options);
+
+  if (msg)
+    self->stats.popped++;
+  return msg;
+}
+
+static inline gint
+log_queue_pop_head_batch_ignore_throttle(LogQueue *self, gint max_msgs, LogMessage **msgs, LogPathOptions *path_options)
+{
+  gint num_msgs = 0;
+
+  if (self->pop_head_batch)
+    {
+      num_msgs = self->pop_head_batch(self, max_msgs, msgs, path_options);
+    }
+  else
+    {
+      while (num_msgs < max_msgs &&
+             (msgs[num_msgs] = self->pop_head(self, &path_options[num_msgs])) != NULL)
+        num_msgs++;
+    }
+  self->stats.popped += num_msgs;
+  return num_msgs;
+}
+
+/*
+ * Removes up to @max_msgs messages from the head of the queue, each with
+ * its own element in @path_options.  Returns the number of messages
+ * popped, each of which is a reference the caller must take care of.
+ */
+static inline gint
+log_queue_pop_head_batch(LogQueue *self, gint max_msgs, LogMessage **msgs, LogPathOptions *path_options)
+{
+  gint num_msgs;
+
+  if (self->throttle)
+    max_msgs = MIN(max_msgs, self->throttle_buckets);
+  if (max_msgs <= 0)
+    return 0;
+
+  num_msgs = log_queue_pop_head_batch_ignore_throttle(self, max_msgs, msgs, path_options);
+
+  if (self->throttle_buckets > 0)
+    self->throttle_buckets = MAX(self->throttle_buckets - num_msgs, 0);
+
+  return num_msgs;
 }
 
 static inline void
@@ -134,6 +229,7 @@ log_queue_rewind_backlog(LogQueue *self, guint rewind_count)
   if (!self->use_backlog)
     return;
 
+  self->stats.popped -= rewind_count;
   self->rewind_backlog(self, rewind_count);
 }
 
@@ -184,6 +280,30 @@ log_queue_set_throttle(LogQueue *self, gint throttle)
   self->throttle_buckets = throttle;
 }
 
+static inline void
+log_queue_set_memory_limit(LogQueue *self, gssize memory_limit)
+{
+  self->memory_limit = memory_limit;
+}
+
+static inline gssize
+log_queue_get_memory_usage(LogQueue *self)
+{
+  return (gssize) GPOINTER_TO_SIZE(g_atomic_pointer_get((gpointer *) &self->memory_usage));
+}
+
+static inline gboolean
+log_queue_is_over_memory_limit(LogQueue *self)
+{
+  return self->memory_limit > 0 && log_queue_get_memory_usage(self) >= self->memory_limit;
+}
+
+static inline void
+log_queue_set_flow_control_budget(LogQueue *self, gint flow_control_budget)
+{
+  self->flow_control_budget = flow_control_budget;
+}
+
 static inline void
 log_queue_set_use_backlog(LogQueue *self, gboolean use_backlog)
 {
@@ -191,11 +311,21 @@ log_queue_set_use_backlog(LogQueue *self, gboolean use_backlog)
     self->use_backlog = use_backlog;
 }
 
+gboolean log_queue_is_memory_accounted(LogQueue *self);
+void log_queue_memory_usage_add(LogQueue *self, gssize delta);
+gboolean log_queue_is_memory_budget_exceeded(void);
+gssize log_queue_get_global_memory_usage(void);
+void log_queue_set_memory_budget(gssize memory_budget);
+
 void log_queue_push_notify(LogQueue *self);
+void log_queue_unpop_batch(LogQueue *self, LogMessage **msgs, LogPathOptions *path_options, gint num_msgs);
 void log_queue_reset_parallel_push(LogQueue *self);
 void log_queue_set_parallel_push(LogQueue *self, LogQueuePushNotifyFunc parallel_push_notify, gpointer user_data, GDestroyNotify user_data_destroy);
 gboolean log_queue_check_items(LogQueue *self, gint *timeout, LogQueuePushNotifyFunc parallel_push_notify, gpointer user_data, GDestroyNotify user_data_destroy);
 void log_queue_set_counters(LogQueue *self, StatsCounterItem *stored_messages, StatsCounterItem *dropped_messages);
+void log_queue_register_stats_counters(LogQueue *self, gint stats_level, gint component, const gchar *id, const gchar *instance);
+void log_queue_unregister_stats_counters(LogQueue *self, gint component, const gchar *id, const gchar *instance);
+void log_queue_update_stats_counters(LogQueue *self, const GTimeVal *now);
 void log_queue_init_instance(LogQueue *self, const gchar *persist_name);
 void log_queue_free_method(LogQueue *self);
 
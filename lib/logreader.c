@@ -26,8 +26,10 @@
 #include "mainloop-io-worker.h"
 #include "mainloop-call.h"
 #include "ack_tracker.h"
+#include "usdt-probes.h"
 
 #include <iv_event.h>
+#include <unistd.h>
 
 struct _LogReader
 {
@@ -61,8 +63,31 @@ struct _LogReader
   GStaticMutex pending_proto_lock;
   LogProtoServer *pending_proto;
   PollEvents *pending_poll_events;
+
+  /* batch being fetched, see log_reader_fetch_batches() */
+  gint batch_size;
+  LogProtoServerSpan *batch_spans;
+  LogMessage **batch_msgs;
+  Bookmark *batch_bookmarks;
+
+  /* parse jobs of the current batch still running in the parse pool */
+  GStaticMutex parse_lock;
+  GCond *parse_done_cond;
+  gint parse_jobs_pending;
 };
 
+typedef struct _LogReaderParseJob
+{
+  LogReader *reader;
+  LogProtoServerSpan *spans;
+  LogMessage **msgs;
+  gint count;
+  LogTransportAuxData *aux;
+} LogReaderParseJob;
+
+static GStaticMutex log_reader_parse_pool_lock = G_STATIC_MUTEX_INIT;
+static GThreadPool *log_reader_parse_pool;
+
 static gboolean log_reader_fetch_log(LogReader *self);
 
 static void log_reader_stop_watches(LogReader *self);
@@ -80,12 +105,39 @@ log_reader_apply_proto_and_poll_events(LogReader *self, LogProtoServer *proto, P
   self->poll_events = poll_events;
 }
 
+/* the number of fetch_limit sized rounds an I/O worker may run on a busy
+ * reader before handing it back to the main loop */
+#define LOG_READER_MAX_WORKER_ROUNDS 8
+
+/* NOTE: runs in the worker thread.  With lots of connections, every trip
+ * through the main loop (completion, updating the watches, polling and
+ * submitting a job again) is serialized on the main thread, so as long as
+ * fetch_limit() was hit, the window is open and nothing else needs the
+ * main thread's attention, the worker keeps on reading. */
+static gboolean
+log_reader_can_continue_in_worker(LogReader *self)
+{
+  return (self->options->flags & LR_THREADED) &&
+         self->immediate_check &&
+         !self->pending_proto_present &&
+         !main_loop_worker_job_quit() &&
+         log_source_free_to_send(&self->super);
+}
+
 static void
 log_reader_work_perform(void *s)
 {
   LogReader *self = (LogReader *) s;
+  gint rounds = 0;
 
   self->notify_code = log_reader_fetch_log(self);
+  while (self->notify_code == 0 &&
+         ++rounds < LOG_READER_MAX_WORKER_ROUNDS &&
+         log_reader_can_continue_in_worker(self))
+    {
+      self->immediate_check = FALSE;
+      self->notify_code = log_reader_fetch_log(self);
+    }
 }
 
 static void
@@ -301,45 +353,63 @@ _add_aux_nvpair(const gchar *name, const gchar *value, gsize value_len, gpointer
   log_msg_set_value_by_name(msg, name, value, value_len);;
 }
 
-static gboolean
-log_reader_handle_line(LogReader *self, const guchar *line, gint length, LogTransportAuxData *aux)
+static LogMessage *
+log_reader_construct_msg(LogReader *self, const guchar *line, gint length, LogTransportAuxData *aux)
 {
   LogMessage *m;
-  
-  msg_debug("Incoming log entry", 
+  GTimeVal recvd;
+
+  msg_debug("Incoming log entry",
             evt_tag_printf("line", "%.*s", length, line),
             NULL);
+
+  /* prefer the receive time reported by the kernel, it is more accurate
+   * than our cached time and saves reading the clock */
+  recvd.tv_sec = aux->timestamp.tv_sec;
+  recvd.tv_usec = aux->timestamp.tv_nsec / 1000;
+
   /* use the current time to get the time zone offset */
-  m = log_msg_new((gchar *) line, length,
-                  aux->peer_addr ? : self->peer_addr,
-                  &self->options->parse_options);
+  m = log_msg_new_with_recvd((gchar *) line, length,
+                             aux->peer_addr ? : self->peer_addr,
+                             &self->options->parse_options,
+                             log_source_get_payload_size_hint(&self->super),
+                             recvd.tv_sec ? &recvd : NULL);
 
-  log_msg_refcache_start_producer(m);
-  
   log_transport_aux_data_foreach(aux, _add_aux_nvpair, m);
+  return m;
+}
+
+static inline gboolean
+log_reader_is_dropped_early(LogReader *self, const guchar *line, gsize length)
+{
+  MsgFormatOptions *parse_options = &self->options->parse_options;
+
+  return early_drop_filter_matches(&self->options->early_drop, line, length,
+                                   !(parse_options->flags & LP_NOPARSE),
+                                   parse_options->default_pri);
+}
+
+static gboolean
+log_reader_handle_line(LogReader *self, const guchar *line, gint length, LogTransportAuxData *aux)
+{
+  LogMessage *m;
 
+  if (log_reader_is_dropped_early(self, line, length))
+    return log_source_free_to_send(&self->super);
+
+  m = log_reader_construct_msg(self, line, length, aux);
+  SYSLOG_NG_PROBE2(reader__message, self, m);
+
+  log_msg_refcache_start_producer(m);
   log_source_post(&self->super, m);
   log_msg_refcache_stop();
   return log_source_free_to_send(&self->super);
 }
 
-/* returns: notify_code (NC_XXXX) or 0 for success */
 static gint
-log_reader_fetch_log(LogReader *self)
+log_reader_fetch_messages(LogReader *self, gint *msg_count, gboolean *may_read, LogTransportAuxData *aux)
 {
-  gint msg_count = 0;
-  gboolean may_read = TRUE;
-  LogTransportAuxData aux;
-
-  if (self->waiting_for_preemption)
-    may_read = FALSE;
-
-  /* NOTE: this loop is here to decrease the load on the main loop, we try
-   * to fetch a couple of messages in a single run (but only up to
-   * fetch_limit).
-   */
-  log_transport_aux_data_init(&aux);
-  while (msg_count < self->options->fetch_limit && !main_loop_worker_job_quit())
+  while (*msg_count < self->options->fetch_limit && !main_loop_worker_job_quit())
     {
       Bookmark *bookmark;
       const guchar *msg;
@@ -354,14 +424,13 @@ log_reader_fetch_log(LogReader *self)
        * protocol, it resets may_read to FALSE after the first read was issued.
        */
 
-      log_transport_aux_data_reinit(&aux);
+      log_transport_aux_data_reinit(aux);
       bookmark = ack_tracker_request_bookmark(self->super.ack_tracker);
-      status = log_proto_server_fetch(self->proto, &msg, &msg_len, &may_read, &aux, bookmark);
+      status = log_proto_server_fetch(self->proto, &msg, &msg_len, may_read, aux, bookmark);
       switch (status)
         {
         case LPS_EOF:
         case LPS_ERROR:
-          g_sockaddr_unref(aux.peer_addr);
           return status == LPS_ERROR ? NC_READ_ERROR : NC_CLOSE;
         case LPS_SUCCESS:
           break;
@@ -377,16 +446,233 @@ log_reader_fetch_log(LogReader *self)
         }
       if (msg_len > 0 || (self->options->flags & LR_EMPTY_LINES))
         {
-          msg_count++;
+          (*msg_count)++;
 
-          if (!log_reader_handle_line(self, msg, msg_len, &aux))
+          if (!log_reader_handle_line(self, msg, msg_len, aux))
             {
               /* window is full, don't generate further messages */
               break;
             }
         }
     }
+  return 0;
+}
+
+#define LOG_READER_FETCH_BATCH 32
+#define LOG_READER_PARALLEL_FETCH_BATCH 256
+
+/* don't bother with handing over less than this many messages to another thread */
+#define LOG_READER_MIN_PARSE_JOB 16
+
+/* a NULL in @msgs means that the message was dropped */
+static void
+log_reader_parse_spans(LogReader *self, LogProtoServerSpan *spans, LogMessage **msgs, gint count, LogTransportAuxData *aux)
+{
+  gint i;
+
+  for (i = 0; i < count; i++)
+    {
+      if ((spans[i].msg_len > 0 || (self->options->flags & LR_EMPTY_LINES)) &&
+          !log_reader_is_dropped_early(self, spans[i].msg, spans[i].msg_len))
+        msgs[i] = log_reader_construct_msg(self, spans[i].msg, spans[i].msg_len, aux);
+      else
+        msgs[i] = NULL;
+    }
+}
+
+static void
+log_reader_parse_job_run(gpointer data, gpointer user_data)
+{
+  LogReaderParseJob *job = (LogReaderParseJob *) data;
+  LogReader *self = job->reader;
+
+  log_reader_parse_spans(self, job->spans, job->msgs, job->count, job->aux);
+
+  g_static_mutex_lock(&self->parse_lock);
+  if (--self->parse_jobs_pending == 0)
+    g_cond_signal(self->parse_done_cond);
+  g_static_mutex_unlock(&self->parse_lock);
+}
+
+static GThreadPool *
+log_reader_get_parse_pool(void)
+{
+  g_static_mutex_lock(&log_reader_parse_pool_lock);
+  if (!log_reader_parse_pool)
+    {
+      glong num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+      log_reader_parse_pool = g_thread_pool_new(log_reader_parse_job_run, NULL, MAX(num_cpus, 1), FALSE, NULL);
+    }
+  g_static_mutex_unlock(&log_reader_parse_pool_lock);
+  return log_reader_parse_pool;
+}
+
+/*
+ * Parses the messages of a batch, in parallel if parse-threads() is set.
+ *
+ * The batch is split into contiguous chunks, the first one is parsed by
+ * the current thread, the rest by the parse pool.  As we wait for all of
+ * them before posting, the order of messages is kept as it was in the
+ * input and the spans remain valid while being parsed.
+ */
+static void
+log_reader_parse_batch(LogReader *self, LogProtoServerSpan *spans, LogMessage **msgs, gint count, LogTransportAuxData *aux)
+{
+  LogReaderParseJob jobs[LOG_READER_MAX_PARSE_THREADS];
+  GThreadPool *pool;
+  gint num_jobs, chunk;
+  gint i;
+
+  num_jobs = MIN(self->options->parse_threads, count / LOG_READER_MIN_PARSE_JOB);
+  if (num_jobs <= 1)
+    {
+      log_reader_parse_spans(self, spans, msgs, count, aux);
+      return;
+    }
+
+  chunk = (count + num_jobs - 1) / num_jobs;
+  num_jobs = (count + chunk - 1) / chunk;
+
+  pool = log_reader_get_parse_pool();
+  self->parse_jobs_pending = num_jobs - 1;
+  for (i = 1; i < num_jobs; i++)
+    {
+      LogReaderParseJob *job = &jobs[i];
+
+      job->reader = self;
+      job->spans = spans + i * chunk;
+      job->msgs = msgs + i * chunk;
+      job->count = MIN(chunk, count - i * chunk);
+      job->aux = aux;
+      g_thread_pool_push(pool, job, NULL);
+    }
+
+  log_reader_parse_spans(self, spans, msgs, chunk, aux);
+
+  g_static_mutex_lock(&self->parse_lock);
+  while (self->parse_jobs_pending > 0)
+    g_cond_wait(self->parse_done_cond, g_static_mutex_get_mutex(&self->parse_lock));
+  g_static_mutex_unlock(&self->parse_lock);
+}
+
+static void
+log_reader_free_batch(LogReader *self)
+{
+  g_free(self->batch_spans);
+  g_free(self->batch_msgs);
+  g_free(self->batch_bookmarks);
+  self->batch_spans = NULL;
+  self->batch_msgs = NULL;
+  self->batch_bookmarks = NULL;
+}
+
+static void
+log_reader_alloc_batch(LogReader *self)
+{
+  if (self->batch_spans)
+    return;
+
+  self->batch_size = self->options->parse_threads > 1 ? LOG_READER_PARALLEL_FETCH_BATCH : LOG_READER_FETCH_BATCH;
+  self->batch_spans = g_new(LogProtoServerSpan, self->batch_size);
+  self->batch_msgs = g_new(LogMessage *, self->batch_size);
+  self->batch_bookmarks = g_new(Bookmark, self->batch_size);
+}
+
+/*
+ * Same as log_reader_fetch_messages(), but fetches the lines already in
+ * the buffer of the LogProto at once and posts them with a single window
+ * update.  Batches are limited by the free window, so posting never
+ * overflows it.
+ */
+static gint
+log_reader_fetch_batches(LogReader *self, gint *msg_count, gboolean *may_read, LogTransportAuxData *aux)
+{
+  LogProtoServerSpan *spans;
+  LogMessage **msgs;
+  Bookmark *bookmarks;
+
+  log_reader_alloc_batch(self);
+  spans = self->batch_spans;
+  msgs = self->batch_msgs;
+  bookmarks = self->batch_bookmarks;
+
+  while (*msg_count < self->options->fetch_limit && !main_loop_worker_job_quit())
+    {
+      LogProtoStatus status;
+      gint num_spans, num_msgs = 0;
+      gint i;
+
+      num_spans = MIN(self->batch_size, self->options->fetch_limit - *msg_count);
+      num_spans = MIN(num_spans, log_source_get_free_window(&self->super));
+      if (num_spans == 0)
+        {
+          /* window is full, don't generate further messages */
+          break;
+        }
+
+      status = log_proto_server_fetch_many(self->proto, spans, &num_spans, may_read, aux);
+
+      log_reader_parse_batch(self, spans, msgs, num_spans, aux);
+      for (i = 0; i < num_spans; i++)
+        {
+          if (msgs[i])
+            {
+              msgs[num_msgs] = msgs[i];
+              bookmarks[num_msgs] = spans[i].bookmark;
+              num_msgs++;
+            }
+        }
+      log_source_post_batch(&self->super, msgs, bookmarks, num_msgs);
+      *msg_count += num_msgs;
+
+      switch (status)
+        {
+        case LPS_EOF:
+        case LPS_ERROR:
+          return status == LPS_ERROR ? NC_READ_ERROR : NC_CLOSE;
+        case LPS_SUCCESS:
+          break;
+        default:
+          g_assert_not_reached();
+          break;
+        }
+
+      if (num_spans == 0)
+        {
+          /* no more messages for now */
+          break;
+        }
+    }
+  return 0;
+}
+
+/* returns: notify_code (NC_XXXX) or 0 for success */
+static gint
+log_reader_fetch_log(LogReader *self)
+{
+  gint msg_count = 0;
+  gboolean may_read = TRUE;
+  LogTransportAuxData aux;
+  gint notify_code;
+
+  if (self->waiting_for_preemption)
+    may_read = FALSE;
+
+  /* NOTE: the loops in these functions are here to decrease the load on
+   * the main loop, we try to fetch a couple of messages in a single run
+   * (but only up to fetch_limit).
+   */
+  log_transport_aux_data_init(&aux);
+  if (log_proto_server_supports_fetch_many(self->proto))
+    notify_code = log_reader_fetch_batches(self, &msg_count, &may_read, &aux);
+  else
+    notify_code = log_reader_fetch_messages(self, &msg_count, &may_read, &aux);
   log_transport_aux_data_destroy(&aux);
+
+  if (notify_code)
+    return notify_code;
+
   if (self->options->flags & LR_PREEMPT)
     {
       if (log_proto_server_is_preemptable(self->proto))
@@ -423,6 +709,9 @@ log_reader_init(LogPipe *s)
       return FALSE;
     }
 
+  /* reallocated on the next fetch, sized according to the current options */
+  log_reader_free_batch(self);
+
   poll_events_set_callback(self->poll_events, log_reader_io_process_input, self);
 
   log_reader_update_watches(self);
@@ -463,6 +752,9 @@ log_reader_free(LogPipe *s)
   g_sockaddr_unref(self->peer_addr);
   g_static_mutex_free(&self->pending_proto_lock);
   g_cond_free(self->pending_proto_cond);
+  g_static_mutex_free(&self->parse_lock);
+  g_cond_free(self->parse_done_cond);
+  log_reader_free_batch(self);
   log_source_free(s);
 }
 
@@ -553,6 +845,8 @@ log_reader_new(GlobalConfig *cfg)
   log_reader_init_watches(self);
   g_static_mutex_init(&self->pending_proto_lock);
   self->pending_proto_cond = g_cond_new();
+  g_static_mutex_init(&self->parse_lock);
+  self->parse_done_cond = g_cond_new();
   return self;
 }
 
@@ -571,6 +865,8 @@ log_reader_options_defaults(LogReaderOptions *options)
   log_proto_server_options_defaults(&options->proto_options.super);
   msg_format_options_defaults(&options->parse_options);
   options->fetch_limit = 10;
+  options->parse_threads = 1;
+  early_drop_filter_init(&options->early_drop);
   if (configuration && cfg_is_config_version_older(configuration, 0x0300))
     {
       msg_warning_once("WARNING: input: sources do not remove new-line characters from messages by default from " VERSION_3_0 ", please add 'no-multi-line' flag to your configuration if you want to retain this functionality",
@@ -639,6 +935,7 @@ log_reader_options_destroy(LogReaderOptions *options)
   log_source_options_destroy(&options->super);
   log_proto_server_options_destroy(&options->proto_options.super);
   msg_format_options_destroy(&options->parse_options);
+  early_drop_filter_destroy(&options->early_drop);
   options->initialized = FALSE;
 }
 
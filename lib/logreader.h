@@ -29,6 +29,7 @@
 #include "logproto/logproto-server.h"
 #include "poll-events.h"
 #include "timeutils.h"
+#include "early-drop-filter.h"
 
 /* flags */
 #define LR_KERNEL          0x0002
@@ -38,6 +39,8 @@
 #define LR_PREEMPT         0x0020
 #define LR_THREADED        0x0040
 
+#define LOG_READER_MAX_PARSE_THREADS 16
+
 /* options */
 
 typedef struct _LogReaderOptions
@@ -48,8 +51,11 @@ typedef struct _LogReaderOptions
   LogProtoServerOptionsStorage proto_options;
   guint32 flags;
   gint fetch_limit;
+  /* number of threads parsing the messages of a single connection */
+  gint parse_threads;
   const gchar *group_name;
   gboolean check_hostname;
+  EarlyDropFilter early_drop;
 } LogReaderOptions;
 
 typedef struct _LogReader LogReader;
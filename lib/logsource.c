@@ -28,8 +28,12 @@
 #include "timeutils.h"
 #include "stats/stats-registry.h"
 #include "stats/stats-syslog.h"
+#include "stats/stats-trace.h"
 #include "tags.h"
 #include "ack_tracker.h"
+#include "bookmark.h"
+#include "logqueue.h"
+#include "usdt-probes.h"
 
 #include <string.h>
 
@@ -42,14 +46,245 @@ log_source_wakeup(LogSource *self)
     self->wakeup(self);
 }
 
+/*
+ * Adaptive window
+ *
+ * If log-iw-size-max() is set, the window of the source is resized once
+ * every window-size acknowledgements (e.g. once per turnover), between
+ * log-iw-size-min() and log-iw-size-max():
+ *
+ *   - it grows by 1/4 if the window got full in the last period, while
+ *     the ack latency did not increase considerably, as the source is
+ *     limited by its window rather than by its destinations
+ *
+ *   - it shrinks by 1/4 if the ack latency jumped, as the destinations are
+ *     falling behind and a larger window would only hold more messages in
+ *     memory
+ *
+ *   - it shrinks by 1/8 if the window did not get full, e.g. the source
+ *     does not need that many slots
+ *
+ * Free slots are added along with the acknowledgement that triggered the
+ * adjustment when growing, while shrinking is done by withholding slots
+ * from subsequent acknowledgements.  Sources with position tracking never
+ * grow above log-iw-size(), as their ack tracker is sized accordingly.
+ */
+
+/* one in 2^N acks is used to measure the latency */
+#define LOG_SOURCE_ADAPTIVE_LATENCY_SAMPLE_SHIFT 6
+/* latency below this is considered noise */
+#define LOG_SOURCE_ADAPTIVE_LATENCY_MIN_MSEC 100
+
+static inline gboolean
+_adaptive_window_enabled(LogSource *self)
+{
+  return self->options && self->options->max_window_size > 0;
+}
+
+static gint
+_adaptive_window_get_max(LogSource *self)
+{
+  if (self->pos_tracked)
+    return MIN(self->options->max_window_size, self->options->init_window_size);
+  return self->options->max_window_size;
+}
+
+static gint
+_adaptive_window_get_min(LogSource *self)
+{
+  gint min_window_size = self->options->min_window_size;
+
+  if (min_window_size <= 0)
+    min_window_size = self->options->init_window_size / 4;
+  return CLAMP(min_window_size, 1, _adaptive_window_get_max(self));
+}
+
+/* removes the slots to be withheld from @window_size_increment */
+static guint32
+_adaptive_window_withhold(LogSource *self, guint32 window_size_increment)
+{
+  gint pending, withheld;
+
+  do
+    {
+      pending = g_atomic_int_get(&self->adaptive.shrink_pending);
+      if (pending <= 0)
+        return window_size_increment;
+      withheld = MIN(pending, (gint) window_size_increment);
+    }
+  while (!g_atomic_int_compare_and_exchange(&self->adaptive.shrink_pending, pending, pending - withheld));
+  return window_size_increment - withheld;
+}
+
+/* returns the number of free slots to be added to the window */
+static guint32
+_adaptive_window_resize(LogSource *self, gint capacity, gint new_capacity)
+{
+  guint32 growth = 0;
+
+  msg_debug("Adjusting adaptive flow-control window",
+            evt_tag_str("stats_id", self->stats_id ? self->stats_id : ""),
+            evt_tag_str("stats_instance", self->stats_instance ? self->stats_instance : ""),
+            evt_tag_int("window_size", new_capacity),
+            evt_tag_int("ack_latency_msec", g_atomic_int_get(&self->adaptive.latency_msec)),
+            NULL);
+
+  g_atomic_int_set(&self->adaptive.capacity, new_capacity);
+  if (new_capacity > capacity)
+    {
+      /* cancel a pending shrink first */
+      growth = _adaptive_window_withhold(self, new_capacity - capacity);
+    }
+  else
+    {
+      g_atomic_int_add(&self->adaptive.shrink_pending, capacity - new_capacity);
+    }
+  return growth;
+}
+
+/* returns the number of free slots to be added to the window */
+static guint32
+_adaptive_window_adjust(LogSource *self, guint32 acked)
+{
+  gint capacity = g_atomic_int_get(&self->adaptive.capacity);
+  gint latency, prev_latency, new_capacity;
+  gboolean window_full;
+
+  if (g_atomic_int_exchange_and_add(&self->adaptive.acks, acked) + (gint) acked < capacity)
+    return 0;
+
+  /* only the thread crossing the limit gets here, modulo lost races that
+   * merely cause an extra adjustment */
+  g_atomic_int_set(&self->adaptive.acks, 0);
+
+  window_full = g_atomic_int_get(&self->adaptive.window_full);
+  g_atomic_int_set(&self->adaptive.window_full, FALSE);
+  latency = g_atomic_int_get(&self->adaptive.latency_msec);
+  prev_latency = g_atomic_int_get(&self->adaptive.prev_latency_msec);
+  g_atomic_int_set(&self->adaptive.prev_latency_msec, latency);
+
+  if (latency > LOG_SOURCE_ADAPTIVE_LATENCY_MIN_MSEC && latency > 2 * prev_latency)
+    new_capacity = capacity - capacity / 4;
+  else if (window_full)
+    new_capacity = capacity + MAX(capacity / 4, 1);
+  else
+    new_capacity = capacity - capacity / 8;
+
+  new_capacity = CLAMP(new_capacity, _adaptive_window_get_min(self), _adaptive_window_get_max(self));
+  if (new_capacity == capacity)
+    return 0;
+  return _adaptive_window_resize(self, capacity, new_capacity);
+}
+
+/* runs in the destination threads, see log_source_msg_ack() */
+static void
+_adaptive_window_sample_latency(LogSource *self, LogMessage *msg)
+{
+  GTimeVal now;
+  gint latency, avg;
+
+  if ((g_atomic_int_exchange_and_add(&self->adaptive.samples, 1) & ((1 << LOG_SOURCE_ADAPTIVE_LATENCY_SAMPLE_SHIFT) - 1)) != 0)
+    return;
+
+  g_get_current_time(&now);
+  latency = (now.tv_sec - msg->timestamps[LM_TS_RECVD].tv_sec) * 1000 +
+            (now.tv_usec - msg->timestamps[LM_TS_RECVD].tv_usec) / 1000;
+  latency = MAX(latency, 0);
+
+  avg = g_atomic_int_get(&self->adaptive.latency_msec);
+  g_atomic_int_set(&self->adaptive.latency_msec, avg + (latency - avg) / 4);
+}
+
+/*
+ * Memory budget
+ *
+ * If the messages held by the queues exceed queue-memory-budget(), the
+ * acknowledged window slots are withheld instead of being returned to the
+ * source, so sources stop reading once their current window is used up.
+ * The slots are given back by log_source_release_memory_budget() when the
+ * usage drops below the budget again.
+ */
+static GStaticMutex memory_throttle_lock = G_STATIC_MUTEX_INIT;
+static GList *memory_throttled_sources;
+
+static gboolean
+_memory_budget_withhold(LogSource *self, guint32 window_size_increment)
+{
+  gboolean withheld = FALSE;
+
+  g_static_mutex_lock(&memory_throttle_lock);
+  /* recheck under the lock, so we don't miss a release running in parallel */
+  if (log_queue_is_memory_budget_exceeded())
+    {
+      self->memory_withheld += window_size_increment;
+      if (!self->memory_throttled)
+        {
+          self->memory_throttled = TRUE;
+          memory_throttled_sources = g_list_prepend(memory_throttled_sources, self);
+        }
+      withheld = TRUE;
+    }
+  g_static_mutex_unlock(&memory_throttle_lock);
+  return withheld;
+}
+
+void
+log_source_release_memory_budget(void)
+{
+  GList *l;
+
+  g_static_mutex_lock(&memory_throttle_lock);
+  for (l = memory_throttled_sources; l; l = l->next)
+    {
+      LogSource *self = (LogSource *) l->data;
+      guint32 old_window_size;
+
+      old_window_size = g_atomic_counter_exchange_and_add(&self->window_size, self->memory_withheld);
+      self->memory_withheld = 0;
+      self->memory_throttled = FALSE;
+      if (old_window_size == 0)
+        log_source_wakeup(self);
+    }
+  g_list_free(memory_throttled_sources);
+  memory_throttled_sources = NULL;
+  g_static_mutex_unlock(&memory_throttle_lock);
+}
+
+static void
+_memory_budget_forget(LogSource *self)
+{
+  g_static_mutex_lock(&memory_throttle_lock);
+  if (self->memory_throttled)
+    memory_throttled_sources = g_list_remove(memory_throttled_sources, self);
+  self->memory_throttled = FALSE;
+  g_static_mutex_unlock(&memory_throttle_lock);
+}
+
 static inline void
 _flow_control_window_size_adjust(LogSource *self, guint32 window_size_increment)
 {
   guint32 old_window_size;
 
-  window_size_increment += g_atomic_counter_get(&self->suspended_window_size);
+  if (_adaptive_window_enabled(self))
+    {
+      guint32 growth = _adaptive_window_adjust(self, window_size_increment);
+
+      window_size_increment = _adaptive_window_withhold(self, window_size_increment) + growth;
+    }
+
+  /* only written when there is something to take over, so that plain acks
+   * don't dirty the cacheline of the suspended window */
+  if (G_UNLIKELY(g_atomic_counter_get(&self->suspended_window_size)))
+    {
+      window_size_increment += g_atomic_counter_get(&self->suspended_window_size);
+      g_atomic_counter_set(&self->suspended_window_size, 0);
+    }
+
+  if (G_UNLIKELY(log_queue_is_memory_budget_exceeded()) &&
+      _memory_budget_withhold(self, window_size_increment))
+    return;
+
   old_window_size = g_atomic_counter_exchange_and_add(&self->window_size, window_size_increment);
-  g_atomic_counter_set(&self->suspended_window_size, 0);
 
   if (old_window_size == 0)
     log_source_wakeup(self);
@@ -131,13 +366,72 @@ log_source_flow_control_adjust(LogSource *self, guint32 window_size_increment)
  * This is running in the same thread as the _destination_, thus care must
  * be taken when manipulating the LogSource data structure.
  **/
+/* weight of a new sample in the payload size average is 1/2^SHIFT */
+#define LOG_SOURCE_PAYLOAD_SIZE_AVG_SHIFT 3
+
+/*
+ * Concurrent acks from multiple destination threads may lose an update
+ * here, which is fine for an estimate and is cheaper than a CAS loop.
+ */
+static void
+_update_payload_size_estimate(LogSource *self, LogMessage *msg)
+{
+  gint estimate = g_atomic_int_get(&self->payload_size_estimate);
+  gint size = MIN(nv_table_get_payload_size(msg->payload), NV_TABLE_MAX_BYTES);
+  gint new_estimate;
+
+  if (estimate == 0)
+    new_estimate = size;
+  else
+    new_estimate = estimate + (size - estimate) / (1 << LOG_SOURCE_PAYLOAD_SIZE_AVG_SHIFT);
+  /* messages of similar size leave it unchanged, skip the shared store then */
+  if (new_estimate != estimate)
+    g_atomic_int_set(&self->payload_size_estimate, new_estimate);
+}
+
+static inline void
+_msg_ack_sample(LogSource *self, LogMessage *msg)
+{
+  _update_payload_size_estimate(self, msg);
+  if (_adaptive_window_enabled(self))
+    _adaptive_window_sample_latency(self, msg);
+}
+
 static void
 log_source_msg_ack(LogMessage *msg, AckType ack_type)
 {
   AckTracker *ack_tracker = msg->ack_record->tracker;
+
+  SYSLOG_NG_PROBE2(source__ack, msg, ack_type);
+  _msg_ack_sample(ack_tracker->source, msg);
   ack_tracker_manage_msg_ack(ack_tracker, msg, ack_type);
 }
 
+/*
+ * Acknowledgement of sources without position tracking (e.g. UDP): there
+ * is nothing to track for them, the ack only frees a slot in the window,
+ * so it goes straight to the window counter instead of through the ack
+ * tracker.  The AckRecord of these messages is shared by all messages of
+ * the source (see early_ack_tracker_track_msg()), it is only used to find
+ * the source.
+ */
+static void
+log_source_msg_ack_early(LogMessage *msg, AckType ack_type)
+{
+  LogSource *self = msg->ack_record->tracker->source;
+
+  SYSLOG_NG_PROBE2(source__ack, msg, ack_type);
+  _msg_ack_sample(self, msg);
+
+  if (G_UNLIKELY(ack_type == AT_SUSPENDED))
+    log_source_flow_control_suspend(self);
+  else
+    log_source_flow_control_adjust(self, 1);
+
+  log_msg_unref(msg);
+  log_pipe_unref(&self->super);
+}
+
 void
 log_source_flow_control_suspend(LogSource *self)
 {
@@ -221,32 +515,86 @@ log_source_deinit(LogPipe *s)
   return TRUE;
 }
 
-void
-log_source_post(LogSource *self, LogMessage *msg)
+static void
+_log_source_track_and_queue(LogSource *self, LogMessage *msg)
 {
   LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
-  gint old_window_size;
 
+  SYSLOG_NG_PROBE2(source__post, self, msg);
+  stats_trace_message_posted(msg);
   ack_tracker_track_msg(self->ack_tracker, msg);
 
   /* NOTE: we start by enabling flow-control, thus we need an acknowledgement */
   path_options.ack_needed = TRUE;
   log_msg_ref(msg);
   log_msg_add_ack(msg, &path_options);
-  msg->ack_func = log_source_msg_ack;
+  msg->ack_func = ack_tracker_is_late(self->ack_tracker) ? log_source_msg_ack : log_source_msg_ack_early;
 
-  old_window_size = g_atomic_counter_exchange_and_add(&self->window_size, -1);
+  log_pipe_queue(&self->super, msg, &path_options);
+}
+
+static void
+_log_source_take_window(LogSource *self, gint count)
+{
+  gint old_window_size;
+
+  old_window_size = g_atomic_counter_exchange_and_add(&self->window_size, -count);
 
   /*
    * NOTE: this assertion validates that the source is not overflowing its
    * own flow-control window size, decreased above, by the atomic statement.
    *
-   * If the _old_ value is zero, that means that the decrement operation
-   * above has decreased the value to -1.
+   * If the _old_ value is less than @count, that means that the decrement
+   * operation above has decreased the value below zero.
    */
 
-  g_assert(old_window_size > 0);
-  log_pipe_queue(&self->super, msg, &path_options);
+  g_assert(old_window_size >= count);
+  if (old_window_size == count)
+    g_atomic_int_set(&self->adaptive.window_full, TRUE);
+}
+
+void
+log_source_post(LogSource *self, LogMessage *msg)
+{
+  _log_source_take_window(self, 1);
+  _log_source_track_and_queue(self, msg);
+}
+
+/*
+ * Posts @count messages, taking their window slots in one step.  The
+ * caller must make sure that there's enough room in the window.
+ * @bookmarks, if non-NULL, holds the bookmark of each message, which is
+ * handed over to the ack tracker.  Messages are consumed like in
+ * log_source_post(), the producer-side refcache is used for each.
+ */
+void
+log_source_post_batch(LogSource *self, LogMessage **msgs, Bookmark *bookmarks, gint count)
+{
+  gint i;
+
+  if (count == 0)
+    return;
+
+  /* an early ack tracker has a single bookmark shared by all messages,
+   * there's no point in filling it */
+  if (!ack_tracker_is_late(self->ack_tracker))
+    bookmarks = NULL;
+
+  _log_source_take_window(self, count);
+  for (i = 0; i < count; i++)
+    {
+      if (bookmarks)
+        {
+          Bookmark *bookmark = ack_tracker_request_bookmark(self->ack_tracker);
+
+          if (bookmark)
+            bookmark_copy(bookmark, &bookmarks[i]);
+        }
+
+      log_msg_refcache_start_producer(msgs[i]);
+      _log_source_track_and_queue(self, msgs[i]);
+      log_msg_refcache_stop();
+    }
 }
 
 static void
@@ -295,16 +643,12 @@ log_source_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options
   /* stats counters */
   if (stats_check_level(2))
     {
-      stats_lock();
-
-      stats_register_and_increment_dynamic_counter(2, SCS_HOST | SCS_SOURCE, NULL, log_msg_get_value(msg, LM_V_HOST, NULL), msg->timestamps[LM_TS_RECVD].tv_sec);
+      stats_increment_dynamic_counter_deferred(2, SCS_HOST | SCS_SOURCE, NULL, log_msg_get_value(msg, LM_V_HOST, NULL), msg->timestamps[LM_TS_RECVD].tv_sec);
       if (stats_check_level(3))
         {
-          stats_register_and_increment_dynamic_counter(3, SCS_SENDER | SCS_SOURCE, NULL, log_msg_get_value(msg, LM_V_HOST_FROM, NULL), msg->timestamps[LM_TS_RECVD].tv_sec);
-          stats_register_and_increment_dynamic_counter(3, SCS_PROGRAM | SCS_SOURCE, NULL, log_msg_get_value(msg, LM_V_PROGRAM, NULL), msg->timestamps[LM_TS_RECVD].tv_sec);
+          stats_increment_dynamic_counter_deferred(3, SCS_SENDER | SCS_SOURCE, NULL, log_msg_get_value(msg, LM_V_HOST_FROM, NULL), msg->timestamps[LM_TS_RECVD].tv_sec);
+          stats_increment_dynamic_counter_deferred(3, SCS_PROGRAM | SCS_SOURCE, NULL, log_msg_get_value(msg, LM_V_PROGRAM, NULL), msg->timestamps[LM_TS_RECVD].tv_sec);
         }
-
-      stats_unlock();
     }
   stats_syslog_process_message_pri(msg->pri);
 
@@ -349,7 +693,10 @@ log_source_set_options(LogSource *self, LogSourceOptions *options, gint stats_le
    * connections will not have their window_size changed. */
   
   if (g_atomic_counter_get(&self->window_size) == -1)
-    g_atomic_counter_set(&self->window_size, options->init_window_size);
+    {
+      g_atomic_counter_set(&self->window_size, options->init_window_size);
+      g_atomic_int_set(&self->adaptive.capacity, options->init_window_size);
+    }
   self->options = options;
   self->stats_level = stats_level;
   self->stats_source = stats_source;
@@ -375,6 +722,7 @@ log_source_init_instance(LogSource *self, GlobalConfig *cfg)
   self->super.deinit = log_source_deinit;
   g_atomic_counter_set(&self->window_size, -1);
   self->ack_tracker = NULL;
+  self->payload_size_estimate = 0;
 }
 
 void
@@ -382,6 +730,7 @@ log_source_free(LogPipe *s)
 {
   LogSource *self = (LogSource *) s;
   
+  _memory_budget_forget(self);
   g_free(self->stats_id);
   g_free(self->stats_instance);
   log_pipe_free_method(s);
@@ -393,6 +742,9 @@ void
 log_source_options_defaults(LogSourceOptions *options)
 {
   options->init_window_size = 100;
+  options->min_window_size = -1;
+  options->max_window_size = 0;
+  options->lockless_ack_tracker = FALSE;
   options->keep_hostname = -1;
   options->chain_hostnames = -1;
   options->keep_timestamp = -1;
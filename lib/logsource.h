@@ -31,6 +31,11 @@
 typedef struct _LogSourceOptions
 {
   gint init_window_size;
+  /* bounds of the adaptive window, disabled if max_window_size is 0 */
+  gint min_window_size;
+  gint max_window_size;
+  /* use the lockless variant of the late ack tracker */
+  gboolean lockless_ack_tracker;
   const gchar *group_name;
   gboolean keep_timestamp;
   gboolean keep_hostname;
@@ -73,6 +78,30 @@ struct _LogSource
   glong window_full_sleep_nsec;
   struct timespec last_ack_rate_time;
   AckTracker *ack_tracker;
+  /* running average of the final payload size of our messages, updated
+   * from destination threads when messages are acked, accessed atomically */
+  gint payload_size_estimate;
+
+  /* adaptive flow-control window, see _adaptive_window_adjust(), all
+   * members are accessed atomically */
+  struct
+  {
+    /* the current size of the window: free + in-flight slots */
+    gint capacity;
+    /* slots to be withheld from acknowledgements to shrink the window */
+    gint shrink_pending;
+    gint acks;
+    gint samples;
+    gboolean window_full;
+    /* running average of the ack latency in milliseconds */
+    gint latency_msec;
+    gint prev_latency_msec;
+  } adaptive;
+
+  /* window slots withheld while queue-memory-budget() is exceeded,
+   * protected by the lock of the throttled source list */
+  guint32 memory_withheld;
+  gboolean memory_throttled;
 
   void (*wakeup)(LogSource *s);
 };
@@ -83,6 +112,16 @@ log_source_free_to_send(LogSource *self)
   return g_atomic_counter_get(&self->window_size) > 0;
 }
 
+/* payload size to preallocate for new messages, 0 if we have no estimate yet */
+static inline gsize
+log_source_get_payload_size_hint(LogSource *self)
+{
+  gint estimate = g_atomic_int_get(&self->payload_size_estimate);
+
+  /* leave some room for messages above the average */
+  return estimate + estimate / 4;
+}
+
 static inline gint
 log_source_get_init_window_size(LogSource *self)
 {
@@ -93,6 +132,14 @@ gboolean log_source_init(LogPipe *s);
 gboolean log_source_deinit(LogPipe *s);
 
 void log_source_post(LogSource *self, LogMessage *msg);
+void log_source_post_batch(LogSource *self, LogMessage **msgs, Bookmark *bookmarks, gint count);
+
+/* the number of messages that can be posted right now */
+static inline gint
+log_source_get_free_window(LogSource *self)
+{
+  return MAX(g_atomic_counter_get(&self->window_size), 0);
+}
 
 void log_source_set_options(LogSource *self, LogSourceOptions *options, gint stats_level, gint stats_source, const gchar *stats_id, const gchar *stats_instance, gboolean threaded, gboolean pos_tracked, LogExprNode *expr_node);
 void log_source_mangle_hostname(LogSource *self, LogMessage *msg);
@@ -105,6 +152,7 @@ void log_source_free(LogPipe *s);
 void log_source_wakeup(LogSource *self);
 void log_source_flow_control_adjust(LogSource *self, guint32 window_size_increment);
 void log_source_flow_control_suspend(LogSource *self);
+void log_source_release_memory_budget(void);
 
 void log_source_global_init(void);
 
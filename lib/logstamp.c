@@ -26,50 +26,74 @@
 #include "messages.h"
 #include "timeutils.h"
 #include "str-format.h"
+#include "tls-support.h"
+
+#include <string.h>
 
 static void
 log_stamp_append_frac_digits(const LogStamp *stamp, GString *target, gint frac_digits)
 {
+  gchar buf[8];
   glong usecs;
+  gint i;
 
-  usecs = stamp->tv_usec % 1000000;
+  if (frac_digits <= 0)
+    return;
 
-  if (frac_digits > 0)
-    {
-      gulong x;
+  if (frac_digits > 6)
+    frac_digits = 6;
 
-      g_string_append_c(target, '.');
-      for (x = 100000; frac_digits && x; x = x / 10)
-        {
-          g_string_append_c(target, (usecs / x) + '0');
-          usecs = usecs % x;
-          frac_digits--;
-        }
+  /* format all six digits right to left and append the leading ones at once */
+  usecs = stamp->tv_usec % 1000000;
+  buf[0] = '.';
+  for (i = 6; i > 0; i--)
+    {
+      buf[i] = (usecs % 10) + '0';
+      usecs /= 10;
     }
+  g_string_append_len(target, buf, frac_digits + 1);
 }
 
-/** 
- * log_stamp_format:
- * @stamp: Timestamp to format
- * @target: Target storage for formatted timestamp
- * @ts_format: Specifies basic timestamp format (TS_FMT_BSD, TS_FMT_ISO)
- * @zone_offset: Specifies custom zone offset if @tz_convert == TZ_CNV_CUSTOM
+/*
+ * Per-thread cache of formatted timestamps
  *
- * Emits the formatted version of @stamp into @target as specified by
- * @ts_format and @tz_convert. 
- **/
-void
-log_stamp_append_format(const LogStamp *stamp, GString *target, gint ts_format, glong zone_offset, gint frac_digits)
+ * Messages in a burst mostly share the same second, so the part of the
+ * timestamp preceding the fractional digits (and the zone suffix in the
+ * ISO case) is remembered for the last seconds formatted, separately for
+ * each ts_format.  Only the fraction is formatted for each message.  Two
+ * entries are kept per format, so templates that use both the received
+ * and the sent timestamp (or two time zones) don't evict each other.
+ */
+#define TS_FMT_MAX 4
+#define LOG_STAMP_CACHE_WAYS 2
+#define LOG_STAMP_CACHE_PREFIX_MAX 32
+
+typedef struct _LogStampFormatCache
+{
+  gboolean valid;
+  time_t tv_sec;
+  glong zone_offset;
+  gint prefix_len;
+  gchar prefix[LOG_STAMP_CACHE_PREFIX_MAX];
+  gchar suffix[8];
+} LogStampFormatCache;
+
+TLS_BLOCK_START
+{
+  LogStampFormatCache stamp_format_cache[TS_FMT_MAX][LOG_STAMP_CACHE_WAYS];
+  gint stamp_format_cache_victim[TS_FMT_MAX];
+}
+TLS_BLOCK_END;
+
+#define stamp_format_cache __tls_deref(stamp_format_cache)
+#define stamp_format_cache_victim __tls_deref(stamp_format_cache_victim)
+
+/* appends the formatted seconds, everything that precedes the fractional digits */
+static void
+log_stamp_append_format_prefix(const LogStamp *stamp, GString *target, gint ts_format, glong target_zone_offset)
 {
-  glong target_zone_offset = 0;
   struct tm *tm, tm_storage;
-  char buf[8];
   time_t t;
-  
-  if (zone_offset != -1)
-    target_zone_offset = zone_offset;
-  else
-    target_zone_offset = stamp->zone_offset;
 
   t = stamp->tv_sec + target_zone_offset;
   cached_gmtime(&t, &tm_storage);
@@ -86,7 +110,6 @@ log_stamp_append_format(const LogStamp *stamp, GString *target, gint ts_format,
       format_uint32_padded(target, 2, '0', 10, tm->tm_min);
       g_string_append_c(target, ':');
       format_uint32_padded(target, 2, '0', 10, tm->tm_sec);
-      log_stamp_append_frac_digits(stamp, target, frac_digits);
       break;
     case TS_FMT_ISO:
       format_uint32_padded(target, 0, 0, 10, tm->tm_year + 1900);
@@ -100,10 +123,6 @@ log_stamp_append_format(const LogStamp *stamp, GString *target, gint ts_format,
       format_uint32_padded(target, 2, '0', 10, tm->tm_min);
       g_string_append_c(target, ':');
       format_uint32_padded(target, 2, '0', 10, tm->tm_sec);
-
-      log_stamp_append_frac_digits(stamp, target, frac_digits);
-      format_zone_info(buf, sizeof(buf), target_zone_offset);
-      g_string_append(target, buf);
       break;
     case TS_FMT_FULL:
       format_uint32_padded(target, 0, 0, 10, tm->tm_year + 1900);
@@ -117,12 +136,9 @@ log_stamp_append_format(const LogStamp *stamp, GString *target, gint ts_format,
       format_uint32_padded(target, 2, '0', 10, tm->tm_min);
       g_string_append_c(target, ':');
       format_uint32_padded(target, 2, '0', 10, tm->tm_sec);
-
-      log_stamp_append_frac_digits(stamp, target, frac_digits);
       break;
     case TS_FMT_UNIX:
       format_uint32_padded(target, 0, 0, 10, (int) stamp->tv_sec);
-      log_stamp_append_frac_digits(stamp, target, frac_digits);
       break;
     default:
       g_assert_not_reached();
@@ -130,6 +146,66 @@ log_stamp_append_format(const LogStamp *stamp, GString *target, gint ts_format,
     }
 }
 
+/** 
+ * log_stamp_format:
+ * @stamp: Timestamp to format
+ * @target: Target storage for formatted timestamp
+ * @ts_format: Specifies basic timestamp format (TS_FMT_BSD, TS_FMT_ISO)
+ * @zone_offset: Specifies custom zone offset if @tz_convert == TZ_CNV_CUSTOM
+ *
+ * Emits the formatted version of @stamp into @target as specified by
+ * @ts_format and @tz_convert. 
+ **/
+void
+log_stamp_append_format(const LogStamp *stamp, GString *target, gint ts_format, glong zone_offset, gint frac_digits)
+{
+  LogStampFormatCache *cache;
+  glong target_zone_offset = 0;
+  gsize prefix_start;
+  gint i;
+
+  if (zone_offset != -1)
+    target_zone_offset = zone_offset;
+  else
+    target_zone_offset = stamp->zone_offset;
+
+  g_assert(ts_format >= 0 && ts_format < TS_FMT_MAX);
+  for (i = 0; i < LOG_STAMP_CACHE_WAYS; i++)
+    {
+      cache = &stamp_format_cache[ts_format][i];
+      if (cache->valid && cache->tv_sec == stamp->tv_sec && cache->zone_offset == target_zone_offset)
+        {
+          g_string_append_len(target, cache->prefix, cache->prefix_len);
+          log_stamp_append_frac_digits(stamp, target, frac_digits);
+          if (ts_format == TS_FMT_ISO)
+            g_string_append(target, cache->suffix);
+          return;
+        }
+    }
+
+  cache = &stamp_format_cache[ts_format][stamp_format_cache_victim[ts_format]];
+  stamp_format_cache_victim[ts_format] = (stamp_format_cache_victim[ts_format] + 1) % LOG_STAMP_CACHE_WAYS;
+
+  prefix_start = target->len;
+  log_stamp_append_format_prefix(stamp, target, ts_format, target_zone_offset);
+
+  cache->valid = target->len - prefix_start <= sizeof(cache->prefix);
+  if (cache->valid)
+    {
+      cache->tv_sec = stamp->tv_sec;
+      cache->zone_offset = target_zone_offset;
+      cache->prefix_len = target->len - prefix_start;
+      memcpy(cache->prefix, target->str + prefix_start, cache->prefix_len);
+    }
+
+  log_stamp_append_frac_digits(stamp, target, frac_digits);
+  if (ts_format == TS_FMT_ISO)
+    {
+      format_zone_info(cache->suffix, sizeof(cache->suffix), target_zone_offset);
+      g_string_append(target, cache->suffix);
+    }
+}
+
 void
 log_stamp_format(LogStamp *stamp, GString *target, gint ts_format, glong zone_offset, gint frac_digits)
 {
@@ -24,8 +24,20 @@
 
 #include "logthrdestdrv.h"
 #include "seqnum.h"
+#include "scratch-buffers.h"
+#include "tls-support.h"
+#include "cpu-topology.h"
 
 #define MAX_RETRIES_OF_FAILED_INSERT_DEFAULT 3
+#define LOG_THREADED_DEST_DRIVER_BATCH_SIZE 64
+
+TLS_BLOCK_START
+{
+  LogThrDestWorker *current_worker;
+}
+TLS_BLOCK_END;
+
+#define current_worker  __tls_deref(current_worker)
 
 static gchar *
 log_threaded_dest_driver_format_seqnum_for_persist(LogThrDestDriver *self)
@@ -38,26 +50,73 @@ log_threaded_dest_driver_format_seqnum_for_persist(LogThrDestDriver *self)
   return persist_name;
 }
 
-void
-log_threaded_dest_driver_suspend(LogThrDestDriver *self)
+/* the first queue keeps its old name, so that it survives an upgrade */
+static gchar *
+log_threaded_dest_driver_format_queue_persist_name(LogThrDestDriver *self, gint index)
+{
+  static gchar persist_name[256];
+
+  if (index == 0)
+    return self->format.persist_name(self);
+
+  g_snprintf(persist_name, sizeof(persist_name),
+             "%s.worker.%d", self->format.persist_name(self), index);
+
+  return persist_name;
+}
+
+/* same for the queue gauges, so that each worker queue has its own cluster */
+static gchar *
+log_threaded_dest_driver_format_queue_stats_instance(LogThrDestDriver *self, gint index)
+{
+  static gchar stats_instance[256];
+
+  if (index == 0)
+    return self->format.stats_instance(self);
+
+  g_snprintf(stats_instance, sizeof(stats_instance),
+             "%s#%d", self->format.stats_instance(self), index);
+
+  return stats_instance;
+}
+
+/*
+ * Returns the worker running in the current thread, can be used by the
+ * callbacks of the driver to find their per-worker state.
+ */
+LogThrDestWorker *
+log_threaded_dest_driver_get_worker(LogThrDestDriver *self)
+{
+  g_assert(current_worker && current_worker->owner == self);
+  return current_worker;
+}
+
+static void
+log_threaded_dest_worker_suspend(LogThrDestWorker *self)
 {
   iv_validate_now();
   self->timer_reopen.expires  = iv_now;
-  self->timer_reopen.expires.tv_sec += self->time_reopen;
+  self->timer_reopen.expires.tv_sec += self->owner->time_reopen;
   iv_timer_register(&self->timer_reopen);
 }
 
+void
+log_threaded_dest_driver_suspend(LogThrDestDriver *self)
+{
+  log_threaded_dest_worker_suspend(log_threaded_dest_driver_get_worker(self));
+}
+
 static void
 log_threaded_dest_driver_message_became_available_in_the_queue(gpointer user_data)
 {
-  LogThrDestDriver *self = (LogThrDestDriver *) user_data;
+  LogThrDestWorker *self = (LogThrDestWorker *) user_data;
   iv_event_post(&self->wake_up_event);
 }
 
 static void
 log_threaded_dest_driver_wake_up(gpointer data)
 {
-  LogThrDestDriver *self = (LogThrDestDriver *)data;
+  LogThrDestWorker *self = (LogThrDestWorker *)data;
 
   if (!iv_task_registered(&self->do_work))
     {
@@ -66,13 +125,13 @@ log_threaded_dest_driver_wake_up(gpointer data)
 }
 
 static void
-log_threaded_dest_driver_start_watches(LogThrDestDriver* self)
+log_threaded_dest_driver_start_watches(LogThrDestWorker *self)
 {
   iv_task_register(&self->do_work);
 }
 
 static void
-log_threaded_dest_driver_stop_watches(LogThrDestDriver* self)
+log_threaded_dest_driver_stop_watches(LogThrDestWorker *self)
 {
   if (iv_task_registered(&self->do_work))
     {
@@ -91,25 +150,31 @@ log_threaded_dest_driver_stop_watches(LogThrDestDriver* self)
 static void
 log_threaded_dest_driver_shutdown(gpointer data)
 {
-  LogThrDestDriver *self = (LogThrDestDriver *)data;
+  LogThrDestWorker *self = (LogThrDestWorker *)data;
   log_threaded_dest_driver_stop_watches(self);
+  if (iv_timer_registered(&self->batch.timer))
+    {
+      iv_timer_unregister(&self->batch.timer);
+    }
   iv_quit();
 }
 
 
 static void
-__connect(LogThrDestDriver *self)
+__connect(LogThrDestWorker *self)
 {
-  self->worker.connected = TRUE;
-  if (self->worker.connect)
+  LogThrDestDriver *owner = self->owner;
+
+  self->connected = TRUE;
+  if (owner->worker.connect)
     {
-      self->worker.connected = self->worker.connect(self);
+      self->connected = owner->worker.connect(owner);
     }
 
-  if (!self->worker.connected)
+  if (!self->connected)
     {
       log_queue_reset_parallel_push(self->queue);
-      log_threaded_dest_driver_suspend(self);
+      log_threaded_dest_worker_suspend(self);
     }
   else
     {
@@ -118,89 +183,403 @@ __connect(LogThrDestDriver *self)
 }
 
 static void
-__disconnect(LogThrDestDriver *self)
+__disconnect(LogThrDestWorker *self)
 {
-  if (self->worker.disconnect)
+  LogThrDestDriver *owner = self->owner;
+
+  if (owner->worker.disconnect)
     {
-      self->worker.disconnect(self);
+      owner->worker.disconnect(owner);
     }
-  self->worker.connected = FALSE;
+  self->connected = FALSE;
 }
 
 
 
 static void
-_disconnect_and_suspend(LogThrDestDriver *self)
+_disconnect_and_suspend(LogThrDestWorker *self)
 {
   self->suspended = TRUE;
   __disconnect(self);
   log_queue_reset_parallel_push(self->queue);
-  log_threaded_dest_driver_suspend(self);
+  log_threaded_dest_worker_suspend(self);
 }
 
 static void
-log_threaded_dest_driver_do_insert(LogThrDestDriver *self)
+_message_accept(LogThrDestWorker *self, LogMessage *msg)
 {
-  LogMessage *msg;
-  worker_insert_result_t result;
-  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  self->retries_counter = 0;
+  step_sequence_number(self->seq_num);
+  stats_latency_counters_record_since(&self->owner->latency, &msg->timestamps[LM_TS_RECVD]);
+  log_queue_ack_backlog(self->queue, 1);
+  log_msg_unref(msg);
+}
+
+static void
+_message_drop(LogThrDestWorker *self, LogMessage *msg)
+{
+  stats_counter_inc(self->owner->dropped_messages);
+  _message_accept(self, msg);
+}
+
+static void
+_message_rewind(LogThrDestWorker *self, LogMessage *msg)
+{
+  log_queue_rewind_backlog(self->queue, 1);
+  log_msg_unref(msg);
+}
+
+/*
+ * Batching
+ *
+ * Messages handed over to a batching driver stay in the backlog of the
+ * queue until the driver reports the result of the batch, which is then
+ * acked or rewound as a whole.  As no other message gets acked or rewound
+ * in the meantime, the batch is always the oldest part of the backlog,
+ * while the tail of the current pop batch is the newest.
+ */
+static gint
+_batch_get_lines(LogThrDestWorker *self)
+{
+  return self->owner->batch.lines > 0 ? self->owner->batch.lines : 1;
+}
+
+static void
+_batch_add(LogThrDestWorker *self, LogMessage *msg)
+{
+  if (self->batch.num_queued == 0)
+    self->batch.seq_num = *self->seq_num;
 
-  while (!self->suspended &&
-         (msg = log_queue_pop_head(self->queue, &path_options)) != NULL)
+  self->batch.num_queued++;
+  step_sequence_number(self->seq_num);
+  if (stats_latency_counters_enabled(&self->owner->latency))
+    g_array_append_val(self->batch.received, msg->timestamps[LM_TS_RECVD]);
+  log_msg_unref(msg);
+}
+
+static void
+_batch_accept(LogThrDestWorker *self)
+{
+  guint i;
+
+  self->retries_counter = 0;
+  for (i = 0; i < self->batch.received->len; i++)
+    stats_latency_counters_record_since(&self->owner->latency, &g_array_index(self->batch.received, LogStamp, i));
+  log_queue_ack_backlog(self->queue, self->batch.num_queued);
+
+  self->batch.num_queued = 0;
+  self->batch.num_in_flight = 0;
+  g_array_set_size(self->batch.received, 0);
+}
+
+/*
+ * Called by batching drivers from flush() when only the tail of the batch
+ * failed: the first @num_messages messages are acked, the result returned
+ * by flush() applies to the rest.
+ */
+void
+log_threaded_dest_driver_accept_batch_prefix(LogThrDestDriver *s, gint num_messages)
+{
+  LogThrDestWorker *self = log_threaded_dest_driver_get_worker(s);
+  guint num_received;
+  gint i;
+
+  num_messages = MIN(num_messages, self->batch.num_queued);
+  if (num_messages <= 0)
+    return;
+
+  num_received = MIN((guint) num_messages, self->batch.received->len);
+  for (i = 0; i < (gint) num_received; i++)
+    stats_latency_counters_record_since(&s->latency, &g_array_index(self->batch.received, LogStamp, i));
+  g_array_remove_range(self->batch.received, 0, num_received);
+  log_queue_ack_backlog(self->queue, num_messages);
+
+  /* the rest keep their sequence numbers when rewound */
+  for (i = 0; i < num_messages; i++)
+    step_sequence_number(&self->batch.seq_num);
+  self->batch.num_queued -= num_messages;
+  self->batch.num_in_flight = MAX(self->batch.num_in_flight - num_messages, 0);
+}
+
+static void
+_batch_drop(LogThrDestWorker *self)
+{
+  stats_counter_add(self->owner->dropped_messages, self->batch.num_queued);
+  _batch_accept(self);
+}
+
+static void
+_batch_rewind(LogThrDestWorker *self)
+{
+  /* the messages get their sequence numbers again when resent */
+  *self->seq_num = self->batch.seq_num;
+  log_queue_rewind_backlog(self->queue, self->batch.num_queued);
+
+  self->batch.num_queued = 0;
+  self->batch.num_in_flight = 0;
+  g_array_set_size(self->batch.received, 0);
+}
+
+/*
+ * Same as the single message case in log_threaded_dest_driver_insert_one(),
+ * except that retry_over() is not called, as the messages of the batch are
+ * not at hand anymore.
+ */
+static gboolean
+_batch_process_result(LogThrDestWorker *self, worker_insert_result_t result)
+{
+  gboolean batch_continues = FALSE;
+
+  switch (result)
     {
-      msg_set_context(msg);
-      log_msg_refcache_start_consumer(msg, &path_options);
+    case WORKER_INSERT_RESULT_DROP:
+      _batch_drop(self);
+      _disconnect_and_suspend(self);
+      break;
 
-      result = self->worker.insert(self, msg);
+    case WORKER_INSERT_RESULT_ERROR:
+      self->retries_counter++;
 
-      switch (result)
+      if (self->retries_counter >= self->owner->retries.max)
         {
-        case WORKER_INSERT_RESULT_DROP:
-          log_threaded_dest_driver_message_drop(self, msg);
+          msg_error("Multiple failures while sending a batch of messages, dropping the batch",
+                    evt_tag_int("batch_size", self->batch.num_queued),
+                    evt_tag_str("driver", self->owner->super.super.id),
+                    NULL);
+          _batch_drop(self);
+          batch_continues = TRUE;
+        }
+      else
+        {
+          _batch_rewind(self);
           _disconnect_and_suspend(self);
-          break;
+        }
+      break;
+
+    case WORKER_INSERT_RESULT_NOT_CONNECTED:
+      _batch_rewind(self);
+      _disconnect_and_suspend(self);
+      break;
+
+    case WORKER_INSERT_RESULT_REWIND:
+      _batch_rewind(self);
+      break;
+
+    case WORKER_INSERT_RESULT_SUCCESS:
+      _batch_accept(self);
+      batch_continues = TRUE;
+      break;
+
+    case WORKER_INSERT_RESULT_QUEUED:
+      /* sent, the result is reported by the next flush() */
+      self->batch.num_in_flight = self->batch.num_queued;
+      batch_continues = TRUE;
+      break;
+
+    default:
+      batch_continues = TRUE;
+      break;
+    }
 
-        case WORKER_INSERT_RESULT_ERROR:
-          self->retries.counter++;
+  return batch_continues && !self->suspended;
+}
 
-          if (self->retries.counter >= self->retries.max)
-            {
-              if (self->messages.retry_over)
-                self->messages.retry_over(self, msg);
-              log_threaded_dest_driver_message_drop(self, msg);
-            }
-          else
-            {
-              log_threaded_dest_driver_message_rewind(self, msg);
-              _disconnect_and_suspend(self);
-            }
-          break;
+static gboolean
+_batch_add_and_flush_if_full(LogThrDestWorker *self, LogMessage *msg, worker_insert_result_t result)
+{
+  _batch_add(self, msg);
 
-        case WORKER_INSERT_RESULT_NOT_CONNECTED:
-          log_threaded_dest_driver_message_rewind(self, msg);
-          _disconnect_and_suspend(self);
-          break;
+  if (result == WORKER_INSERT_RESULT_QUEUED)
+    {
+      if (self->batch.num_queued - self->batch.num_in_flight < _batch_get_lines(self))
+        return TRUE;
+      result = self->owner->worker.flush(self->owner);
+    }
+  return _batch_process_result(self, result);
+}
+
+/* sends the batch and waits for its result, even if the driver keeps batches in flight */
+static worker_insert_result_t
+_batch_flush_and_resolve(LogThrDestWorker *self)
+{
+  worker_insert_result_t result = self->owner->worker.flush(self->owner);
+
+  if (result == WORKER_INSERT_RESULT_QUEUED)
+    result = self->owner->worker.flush(self->owner);
+  return result;
+}
+
+static void
+log_threaded_dest_driver_flush_batch(LogThrDestWorker *self)
+{
+  if (self->batch.num_queued == 0)
+    return;
+
+  _batch_process_result(self, _batch_flush_and_resolve(self));
+}
+
+static void
+log_threaded_dest_driver_batch_timeout(gpointer data)
+{
+  LogThrDestWorker *self = (LogThrDestWorker *) data;
+  LogThrDestDriver *owner = self->owner;
+
+  if (self->suspended || !self->connected)
+    return;
+
+  log_threaded_dest_driver_flush_batch(self);
+  if (!self->suspended && owner->worker.worker_message_queue_empty)
+    owner->worker.worker_message_queue_empty(owner);
+}
+
+/* the queue ran empty, flush now or arm the timer for batch-timeout() */
+static void
+log_threaded_dest_driver_schedule_batch_flush(LogThrDestWorker *self)
+{
+  if (self->batch.num_queued == 0)
+    return;
+
+  if (self->owner->batch.timeout <= 0)
+    {
+      log_threaded_dest_driver_flush_batch(self);
+      return;
+    }
+
+  if (!iv_timer_registered(&self->batch.timer))
+    {
+      iv_validate_now();
+      self->batch.timer.expires = iv_now;
+      timespec_add_msec(&self->batch.timer.expires, self->owner->batch.timeout);
+      iv_timer_register(&self->batch.timer);
+    }
+}
 
-        case WORKER_INSERT_RESULT_REWIND:
-          log_threaded_dest_driver_message_rewind(self, msg);
-          break;
+/* the worker thread is exiting, don't suspend, just resolve the batch */
+static void
+log_threaded_dest_driver_flush_batch_on_exit(LogThrDestWorker *self)
+{
+  worker_insert_result_t result = WORKER_INSERT_RESULT_NOT_CONNECTED;
+
+  if (self->batch.num_queued == 0)
+    return;
 
-        case WORKER_INSERT_RESULT_SUCCESS:
-          log_threaded_dest_driver_message_accept(self, msg);
-          break;
+  if (self->connected)
+    result = _batch_flush_and_resolve(self);
 
-        default:
-          break;
+  if (result == WORKER_INSERT_RESULT_SUCCESS)
+    _batch_accept(self);
+  else if (result == WORKER_INSERT_RESULT_DROP)
+    _batch_drop(self);
+  else
+    _batch_rewind(self);
+}
+
+/*
+ * Returns TRUE if the rest of the current batch can be inserted, FALSE if
+ * the message was rewound or the driver got suspended, in which case the
+ * unprocessed tail of the batch has to be put back to the queue.
+ */
+static gboolean
+log_threaded_dest_driver_insert_one(LogThrDestWorker *self, LogMessage *msg, LogPathOptions *path_options)
+{
+  LogThrDestDriver *owner = self->owner;
+  worker_insert_result_t result;
+  gboolean batch_continues = FALSE;
+
+  msg_set_context(msg);
+  log_msg_refcache_start_consumer(msg, path_options);
+
+  result = owner->worker.insert(owner, msg);
+
+  if (owner->worker.flush)
+    {
+      batch_continues = _batch_add_and_flush_if_full(self, msg, result);
+      goto exit;
+    }
+
+  switch (result)
+    {
+    case WORKER_INSERT_RESULT_DROP:
+      _message_drop(self, msg);
+      _disconnect_and_suspend(self);
+      break;
+
+    case WORKER_INSERT_RESULT_ERROR:
+      self->retries_counter++;
+
+      if (self->retries_counter >= owner->retries.max)
+        {
+          if (owner->messages.retry_over)
+            owner->messages.retry_over(owner, msg);
+          _message_drop(self, msg);
+          batch_continues = TRUE;
+        }
+      else
+        {
+          _message_rewind(self, msg);
+          _disconnect_and_suspend(self);
         }
+      break;
+
+    case WORKER_INSERT_RESULT_NOT_CONNECTED:
+      _message_rewind(self, msg);
+      _disconnect_and_suspend(self);
+      break;
+
+    case WORKER_INSERT_RESULT_REWIND:
+      _message_rewind(self, msg);
+      break;
 
-      msg_set_context(NULL);
-      log_msg_refcache_stop();
+    case WORKER_INSERT_RESULT_SUCCESS:
+      _message_accept(self, msg);
+      batch_continues = TRUE;
+      break;
+
+    default:
+      batch_continues = TRUE;
+      break;
     }
+
+exit:
+  msg_set_context(NULL);
+  log_msg_refcache_stop();
+  return batch_continues && !self->suspended;
+}
+
+static void
+log_threaded_dest_driver_do_insert(LogThrDestWorker *self)
+{
+  LogThrDestDriver *owner = self->owner;
+  LogMessage *msgs[LOG_THREADED_DEST_DRIVER_BATCH_SIZE];
+  LogPathOptions path_options[LOG_THREADED_DEST_DRIVER_BATCH_SIZE];
+  gint num_msgs, i;
+
+  while (!self->suspended)
+    {
+      for (i = 0; i < LOG_THREADED_DEST_DRIVER_BATCH_SIZE; i++)
+        path_options[i] = (LogPathOptions) LOG_PATH_OPTIONS_INIT;
+
+      num_msgs = log_queue_pop_head_batch(self->queue, LOG_THREADED_DEST_DRIVER_BATCH_SIZE, msgs, path_options);
+      if (num_msgs == 0)
+        break;
+
+      for (i = 0; i < num_msgs; i++)
+        {
+          if (!log_threaded_dest_driver_insert_one(self, msgs[i], &path_options[i]))
+            {
+              log_queue_unpop_batch(self->queue, &msgs[i + 1], &path_options[i + 1], num_msgs - i - 1);
+              break;
+            }
+        }
+    }
+  if (!self->suspended)
+    log_threaded_dest_driver_schedule_batch_flush(self);
+
   if (!self->suspended)
     {
-      if (self->worker.worker_message_queue_empty)
+      if (owner->worker.worker_message_queue_empty)
         {
-          self->worker.worker_message_queue_empty(self);
+          owner->worker.worker_message_queue_empty(owner);
         }
     }
 }
@@ -208,13 +587,14 @@ log_threaded_dest_driver_do_insert(LogThrDestDriver *self)
 static void
 log_threaded_dest_driver_do_work(gpointer data)
 {
-  LogThrDestDriver *self = (LogThrDestDriver *)data;
+  LogThrDestWorker *self = (LogThrDestWorker *)data;
   gint timeout_msec = 0;
 
+  main_loop_worker_busy_start();
   self->suspended = FALSE;
   log_threaded_dest_driver_stop_watches(self);
 
-  if (!self->worker.connected)
+  if (!self->connected)
     {
       __connect(self);
     }
@@ -235,10 +615,11 @@ log_threaded_dest_driver_do_work(gpointer data)
       timespec_add_msec(&self->timer_throttle.expires, timeout_msec);
       iv_timer_register(&self->timer_throttle);
     }
+  main_loop_worker_busy_end();
 }
 
 static void
-log_threaded_dest_driver_init_watches(LogThrDestDriver* self)
+log_threaded_dest_driver_init_watches(LogThrDestWorker* self)
 {
   IV_EVENT_INIT(&self->wake_up_event);
   self->wake_up_event.cookie = self;
@@ -258,6 +639,10 @@ log_threaded_dest_driver_init_watches(LogThrDestDriver* self)
   self->timer_throttle.cookie = self;
   self->timer_throttle.handler = log_threaded_dest_driver_do_work;
 
+  IV_TIMER_INIT(&self->batch.timer);
+  self->batch.timer.cookie = self;
+  self->batch.timer.handler = log_threaded_dest_driver_batch_timeout;
+
   IV_TASK_INIT(&self->do_work);
   self->do_work.cookie = self;
   self->do_work.handler = log_threaded_dest_driver_do_work;
@@ -266,12 +651,16 @@ log_threaded_dest_driver_init_watches(LogThrDestDriver* self)
 static void
 log_threaded_dest_driver_worker_thread_main(gpointer arg)
 {
-  LogThrDestDriver *self = (LogThrDestDriver *)arg;
+  LogThrDestWorker *self = (LogThrDestWorker *)arg;
+  LogThrDestDriver *owner = self->owner;
 
   iv_init();
 
+  current_worker = self;
+
   msg_debug("Worker thread started",
-            evt_tag_str("driver", self->super.super.id),
+            evt_tag_str("driver", owner->super.super.id),
+            evt_tag_int("worker", self->index),
             NULL);
 
   log_queue_set_use_backlog(self->queue, TRUE);
@@ -280,53 +669,106 @@ log_threaded_dest_driver_worker_thread_main(gpointer arg)
 
   log_threaded_dest_driver_start_watches(self);
 
-  if (self->worker.thread_init)
-    self->worker.thread_init(self);
+  if (owner->worker.thread_init)
+    owner->worker.thread_init(owner);
 
   iv_main();
 
+  log_threaded_dest_driver_flush_batch_on_exit(self);
   __disconnect(self);
-  if (self->worker.thread_deinit)
-    self->worker.thread_deinit(self);
+  if (owner->worker.thread_deinit)
+    owner->worker.thread_deinit(owner);
 
   msg_debug("Worker thread finished",
-            evt_tag_str("driver", self->super.super.id),
+            evt_tag_str("driver", owner->super.super.id),
+            evt_tag_int("worker", self->index),
             NULL);
+  current_worker = NULL;
   iv_deinit();
 }
 
 static void
 log_threaded_dest_driver_stop_thread(gpointer s)
 {
-  LogThrDestDriver *self = (LogThrDestDriver *) s;
+  LogThrDestWorker *self = (LogThrDestWorker *) s;
 
   iv_event_post(&self->shutdown_event);
 }
 
 static void
-log_threaded_dest_driver_start_thread(LogThrDestDriver *self)
+log_threaded_dest_driver_start_threads(LogThrDestDriver *self)
+{
+  gint i;
+
+  for (i = 0; i < self->num_workers; i++)
+    main_loop_create_worker_thread(log_threaded_dest_driver_worker_thread_main,
+                                   log_threaded_dest_driver_stop_thread,
+                                   &self->workers[i], &self->worker_options);
+}
+
+static void
+log_threaded_dest_driver_init_workers(LogThrDestDriver *self)
 {
-  main_loop_create_worker_thread(log_threaded_dest_driver_worker_thread_main,
-                                 log_threaded_dest_driver_stop_thread,
-                                 self, &self->worker_options);
+  gint i;
+
+  if (self->num_workers > 1 && !self->worker.multiple_workers_supported)
+    {
+      msg_warning("This destination does not support multiple workers, using a single one",
+                  evt_tag_int("workers", self->num_workers),
+                  evt_tag_str("driver", self->super.super.id),
+                  NULL);
+      self->num_workers = 1;
+    }
+  if (self->num_workers < 1)
+    self->num_workers = 1;
+
+  self->workers = g_new0(LogThrDestWorker, self->num_workers);
+  for (i = 0; i < self->num_workers; i++)
+    {
+      LogThrDestWorker *worker = &self->workers[i];
+
+      worker->owner = self;
+      worker->index = i;
+      worker->seq_num = (i == 0) ? &self->seq_num : &worker->own_seq_num;
+      worker->batch.received = g_array_new(FALSE, FALSE, sizeof(LogStamp));
+    }
 }
 
+static void
+log_threaded_dest_driver_free_workers(LogThrDestDriver *self)
+{
+  gint i;
+
+  for (i = 0; i < self->num_workers; i++)
+    g_array_free(self->workers[i].batch.received, TRUE);
+  g_free(self->workers);
+  self->workers = NULL;
+}
 
 gboolean
 log_threaded_dest_driver_start(LogPipe *s)
 {
   LogThrDestDriver *self = (LogThrDestDriver *)s;
   GlobalConfig *cfg = log_pipe_get_config(s);
+  gint i;
 
   if (cfg && self->time_reopen == -1)
     self->time_reopen = cfg->time_reopen;
 
-  self->queue = log_dest_driver_acquire_queue(&self->super,
-                                              self->format.persist_name(self));
+  log_threaded_dest_driver_init_workers(self);
 
-  if (self->queue == NULL)
+  for (i = 0; i < self->num_workers; i++)
     {
-      return FALSE;
+      LogThrDestWorker *worker = &self->workers[i];
+
+      worker->queue = log_dest_driver_acquire_queue(&self->super,
+                                                    log_threaded_dest_driver_format_queue_persist_name(self, i));
+
+      if (worker->queue == NULL)
+        {
+          log_threaded_dest_driver_free_workers(self);
+          return FALSE;
+        }
     }
 
   if (self->retries.max <= 0)
@@ -349,16 +791,25 @@ log_threaded_dest_driver_start(LogPipe *s)
   stats_register_counter(0, self->stats_source | SCS_DESTINATION, self->super.super.id,
                          self->format.stats_instance(self),
                          SC_TYPE_PROCESSED, &self->processed_messages);
+  stats_register_latency_counters(self->stats_source | SCS_DESTINATION, self->super.super.id,
+                                  self->format.stats_instance(self), &self->latency);
+  for (i = 0; i < self->num_workers; i++)
+    log_queue_register_stats_counters(self->workers[i].queue, 0, self->stats_source | SCS_DESTINATION,
+                                      self->super.super.id,
+                                      log_threaded_dest_driver_format_queue_stats_instance(self, i));
   stats_unlock();
 
-  log_queue_set_counters(self->queue, self->stored_messages,
-                         self->dropped_messages);
+  for (i = 0; i < self->num_workers; i++)
+    log_queue_set_counters(self->workers[i].queue, self->stored_messages,
+                           self->dropped_messages);
 
   self->seq_num = GPOINTER_TO_INT(cfg_persist_config_fetch(cfg, log_threaded_dest_driver_format_seqnum_for_persist(self)));
   if (!self->seq_num)
     init_sequence_number(&self->seq_num);
+  for (i = 1; i < self->num_workers; i++)
+    init_sequence_number(&self->workers[i].own_seq_num);
 
-  log_threaded_dest_driver_start_thread(self);
+  log_threaded_dest_driver_start_threads(self);
 
   return TRUE;
 }
@@ -367,10 +818,13 @@ gboolean
 log_threaded_dest_driver_deinit_method(LogPipe *s)
 {
   LogThrDestDriver *self = (LogThrDestDriver *)s;
+  gint i;
 
-  log_queue_reset_parallel_push(self->queue);
-
-  log_queue_set_counters(self->queue, NULL, NULL);
+  for (i = 0; i < self->num_workers; i++)
+    {
+      log_queue_reset_parallel_push(self->workers[i].queue);
+      log_queue_set_counters(self->workers[i].queue, NULL, NULL);
+    }
 
   cfg_persist_config_add(log_pipe_get_config(s),
                          log_threaded_dest_driver_format_seqnum_for_persist(self),
@@ -386,8 +840,17 @@ log_threaded_dest_driver_deinit_method(LogPipe *s)
   stats_unregister_counter(self->stats_source | SCS_DESTINATION, self->super.super.id,
                            self->format.stats_instance(self),
                            SC_TYPE_PROCESSED, &self->processed_messages);
+  stats_unregister_latency_counters(self->stats_source | SCS_DESTINATION, self->super.super.id,
+                                    self->format.stats_instance(self), &self->latency);
+  for (i = 0; i < self->num_workers; i++)
+    log_queue_unregister_stats_counters(self->workers[i].queue, self->stats_source | SCS_DESTINATION,
+                                        self->super.super.id,
+                                        log_threaded_dest_driver_format_queue_stats_instance(self, i));
   stats_unlock();
 
+  /* the worker threads have already exited at this point */
+  log_threaded_dest_driver_free_workers(self);
+
   if (!log_dest_driver_deinit_method(s))
     return FALSE;
 
@@ -399,15 +862,40 @@ log_threaded_dest_driver_free(LogPipe *s)
 {
   LogThrDestDriver *self = (LogThrDestDriver *)s;
 
+  log_template_unref(self->partition_key);
+  g_free(self->worker_options.cpu_affinity);
   log_dest_driver_free((LogPipe *)self);
 }
 
+static LogThrDestWorker *
+log_threaded_dest_driver_choose_worker(LogThrDestDriver *self, LogMessage *msg)
+{
+  GString *key;
+  guint index;
+
+  if (self->num_workers == 1)
+    return &self->workers[0];
+
+  if (!self->partition_key)
+    {
+      index = (guint) g_atomic_int_exchange_and_add((gint *) &self->next_worker, 1);
+      return &self->workers[index % self->num_workers];
+    }
+
+  key = scratch_arena_gstring();
+  log_template_format(self->partition_key, msg, NULL, LTZ_LOCAL, 0, NULL, key);
+  index = g_str_hash(key->str);
+
+  return &self->workers[index % self->num_workers];
+}
+
 static void
 log_threaded_dest_driver_queue(LogPipe *s, LogMessage *msg,
                                const LogPathOptions *path_options,
                                gpointer user_data)
 {
   LogThrDestDriver *self = (LogThrDestDriver *)s;
+  LogThrDestWorker *worker;
   LogPathOptions local_options;
 
   if (!path_options->flow_control_requested)
@@ -416,8 +904,9 @@ log_threaded_dest_driver_queue(LogPipe *s, LogMessage *msg,
   if (self->queue_method)
     self->queue_method(self);
 
+  worker = log_threaded_dest_driver_choose_worker(self, msg);
   log_msg_add_ack(msg, path_options);
-  log_queue_push_tail(self->queue, log_msg_ref(msg), path_options);
+  log_queue_push_tail(worker->queue, log_msg_ref(msg), path_options);
 
   stats_counter_inc(self->processed_messages);
 
@@ -438,32 +927,28 @@ log_threaded_dest_driver_init_instance(LogThrDestDriver *self, GlobalConfig *cfg
   self->time_reopen = -1;
 
   self->retries.max = MAX_RETRIES_OF_FAILED_INSERT_DEFAULT;
+  self->num_workers = 1;
 }
 
 void
 log_threaded_dest_driver_message_accept(LogThrDestDriver *self,
                                         LogMessage *msg)
 {
-  self->retries.counter = 0;
-  step_sequence_number(&self->seq_num);
-  log_queue_ack_backlog(self->queue, 1);
-  log_msg_unref(msg);
+  _message_accept(log_threaded_dest_driver_get_worker(self), msg);
 }
 
 void
 log_threaded_dest_driver_message_drop(LogThrDestDriver *self,
                                       LogMessage *msg)
 {
-  stats_counter_inc(self->dropped_messages);
-  log_threaded_dest_driver_message_accept(self, msg);
+  _message_drop(log_threaded_dest_driver_get_worker(self), msg);
 }
 
 void
 log_threaded_dest_driver_message_rewind(LogThrDestDriver *self,
                                         LogMessage *msg)
 {
-  log_queue_rewind_backlog(self->queue, 1);
-  log_msg_unref(msg);
+  _message_rewind(log_threaded_dest_driver_get_worker(self), msg);
 }
 
 void
@@ -473,3 +958,66 @@ log_threaded_dest_driver_set_max_retries(LogDriver *s, gint max_retries)
 
   self->retries.max = max_retries;
 }
+
+void
+log_threaded_dest_driver_set_batch_lines(LogDriver *s, gint batch_lines)
+{
+  LogThrDestDriver *self = (LogThrDestDriver *)s;
+
+  self->batch.lines = batch_lines;
+}
+
+void
+log_threaded_dest_driver_set_batch_timeout(LogDriver *s, gint batch_timeout)
+{
+  LogThrDestDriver *self = (LogThrDestDriver *)s;
+
+  self->batch.timeout = batch_timeout;
+}
+
+void
+log_threaded_dest_driver_set_workers(LogDriver *s, gint num_workers)
+{
+  LogThrDestDriver *self = (LogThrDestDriver *)s;
+
+  self->num_workers = num_workers;
+}
+
+void
+log_threaded_dest_driver_set_partition_key(LogDriver *s, LogTemplate *partition_key)
+{
+  LogThrDestDriver *self = (LogThrDestDriver *)s;
+
+  log_template_unref(self->partition_key);
+  self->partition_key = partition_key;
+}
+
+gboolean
+log_threaded_dest_driver_set_cpu_affinity(LogDriver *s, const gchar *cpu_affinity)
+{
+  LogThrDestDriver *self = (LogThrDestDriver *)s;
+
+  if (!cpu_topology_validate_cpu_list(cpu_affinity))
+    return FALSE;
+
+  g_free(self->worker_options.cpu_affinity);
+  self->worker_options.cpu_affinity = g_strdup(cpu_affinity);
+  return TRUE;
+}
+
+void
+log_threaded_dest_driver_set_nice(LogDriver *s, gint nice)
+{
+  LogThrDestDriver *self = (LogThrDestDriver *)s;
+
+  self->worker_options.nice = nice;
+  self->worker_options.nice_set = TRUE;
+}
+
+gboolean
+log_threaded_dest_driver_set_sched_policy(LogDriver *s, const gchar *policy)
+{
+  LogThrDestDriver *self = (LogThrDestDriver *)s;
+
+  return worker_options_set_sched_policy(&self->worker_options, policy);
+}
@@ -28,8 +28,10 @@
 #include "syslog-ng.h"
 #include "driver.h"
 #include "stats/stats-registry.h"
+#include "stats/stats-latency.h"
 #include "logqueue.h"
 #include "mainloop-worker.h"
+#include "template/templates.h"
 #include <iv.h>
 #include <iv_event.h>
 
@@ -39,10 +41,51 @@ typedef enum
   WORKER_INSERT_RESULT_ERROR,
   WORKER_INSERT_RESULT_REWIND,
   WORKER_INSERT_RESULT_SUCCESS,
-  WORKER_INSERT_RESULT_NOT_CONNECTED
+  WORKER_INSERT_RESULT_NOT_CONNECTED,
+  WORKER_INSERT_RESULT_QUEUED
 } worker_insert_result_t;
 
 typedef struct _LogThrDestDriver LogThrDestDriver;
+typedef struct _LogThrDestWorker LogThrDestWorker;
+
+/*
+ * State of one worker thread of a LogThrDestDriver, each worker has its
+ * own queue and its own connection to the destination.
+ */
+struct _LogThrDestWorker
+{
+  LogThrDestDriver *owner;
+  gint index;
+
+  LogQueue *queue;
+  gboolean connected;
+  gboolean suspended;
+  gint retries_counter;
+
+  /* points to the (persisted) seq_num of the driver in the first worker */
+  gint32 *seq_num;
+  gint32 own_seq_num;
+
+  struct
+  {
+    gint num_queued;
+    /* the oldest part of num_queued, sent by a flush() returning QUEUED */
+    gint num_in_flight;
+    gint32 seq_num;
+    GArray *received;
+    struct iv_timer timer;
+  } batch;
+
+  /* owned by the driver, e.g. the connection of the worker */
+  gpointer data;
+
+  struct iv_event wake_up_event;
+  struct iv_event shutdown_event;
+  struct iv_timer timer_reopen;
+  struct iv_timer timer_throttle;
+  struct iv_task  do_work;
+};
+
 struct _LogThrDestDriver
 {
   LogDestDriver super;
@@ -50,19 +93,42 @@ struct _LogThrDestDriver
   StatsCounterItem *dropped_messages;
   StatsCounterItem *stored_messages;
   StatsCounterItem *processed_messages;
+  StatsLatencyCounters latency;
 
-  gboolean suspended;
   time_t time_reopen;
 
-  LogQueue *queue;
+  LogThrDestWorker *workers;
+  gint num_workers;
+  LogTemplate *partition_key;
+  guint next_worker;
 
   /* Worker stuff */
   struct
   {
-    gboolean connected;
+    /*
+     * Drivers keeping their connection in the worker (see
+     * log_threaded_dest_driver_get_worker()) can run more than one worker
+     * thread, the others are restricted to workers(1).
+     */
+    gboolean multiple_workers_supported;
     void (*thread_init) (LogThrDestDriver *s);
     void (*thread_deinit) (LogThrDestDriver *s);
     worker_insert_result_t (*insert) (LogThrDestDriver *s, LogMessage *msg);
+    /*
+     * Batching drivers set flush() and return WORKER_INSERT_RESULT_QUEUED
+     * from insert() once the message is buffered.  flush() sends the
+     * buffered messages, its result applies to the whole batch, just like
+     * any non-QUEUED result of insert() does (the current message
+     * included).
+     *
+     * Drivers overlapping the sending of a batch with building the next
+     * one return WORKER_INSERT_RESULT_QUEUED from flush() once the batch
+     * is sent: it stays in flight, and a later flush() acks it with
+     * log_threaded_dest_driver_accept_batch_prefix() before sending the
+     * messages queued since.  A flush() without new messages must resolve
+     * the ones in flight, which is done when the queue runs empty.
+     */
+    worker_insert_result_t (*flush) (LogThrDestDriver *s);
     gboolean (*connect) (LogThrDestDriver *s);
     void (*worker_message_queue_empty)(LogThrDestDriver *s);
     void (*disconnect) (LogThrDestDriver *s);
@@ -83,17 +149,18 @@ struct _LogThrDestDriver
 
   struct
   {
-    gint counter;
     gint max;
   } retries;
 
+  struct
+  {
+    gint lines;
+    /* msec, 0 means flushing as soon as the queue becomes empty */
+    gint timeout;
+  } batch;
+
   void (*queue_method) (LogThrDestDriver *s);
   WorkerOptions worker_options;
-  struct iv_event wake_up_event;
-  struct iv_event shutdown_event;
-  struct iv_timer timer_reopen;
-  struct iv_timer timer_throttle;
-  struct iv_task  do_work;
 };
 
 gboolean log_threaded_dest_driver_deinit_method(LogPipe *s);
@@ -110,7 +177,23 @@ void log_threaded_dest_driver_message_drop(LogThrDestDriver *self,
                                            LogMessage *msg);
 void log_threaded_dest_driver_message_rewind(LogThrDestDriver *self,
                                              LogMessage *msg);
+void log_threaded_dest_driver_accept_batch_prefix(LogThrDestDriver *s, gint num_messages);
 
 void log_threaded_dest_driver_set_max_retries(LogDriver *s, gint max_retries);
+void log_threaded_dest_driver_set_batch_lines(LogDriver *s, gint batch_lines);
+void log_threaded_dest_driver_set_batch_timeout(LogDriver *s, gint batch_timeout);
+void log_threaded_dest_driver_set_workers(LogDriver *s, gint num_workers);
+void log_threaded_dest_driver_set_partition_key(LogDriver *s, LogTemplate *partition_key);
+gboolean log_threaded_dest_driver_set_cpu_affinity(LogDriver *s, const gchar *cpu_affinity);
+void log_threaded_dest_driver_set_nice(LogDriver *s, gint nice);
+gboolean log_threaded_dest_driver_set_sched_policy(LogDriver *s, const gchar *policy);
+
+LogThrDestWorker *log_threaded_dest_driver_get_worker(LogThrDestDriver *self);
+
+static inline gint32
+log_threaded_dest_worker_get_seq_num(LogThrDestWorker *self)
+{
+  return *self->seq_num;
+}
 
 #endif
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logwriter-arena.h"
+
+#include <string.h>
+
+#define LOG_WRITER_ARENA_CHUNK_SIZE     65536
+/* messages larger than this get a chunk of their own */
+#define LOG_WRITER_ARENA_MAX_BUFFER     (LOG_WRITER_ARENA_CHUNK_SIZE / 4)
+/* number of unused chunks kept for reuse */
+#define LOG_WRITER_ARENA_MAX_FREE       4
+
+typedef struct _LogWriterArenaChunk LogWriterArenaChunk;
+
+struct _LogWriterArenaChunk
+{
+  LogWriterArena *arena;
+  /* one reference for every buffer and one while the chunk is the current one */
+  gint ref_cnt;
+  gsize size, pos;
+  LogWriterArenaChunk *next_free;
+  union
+  {
+    gpointer __dummy_for_alignment;
+    gchar data[0];
+  };
+};
+
+struct _LogWriterArena
+{
+  gint ref_cnt;
+  LogWriterArenaChunk *current;
+  GStaticMutex lock;
+  LogWriterArenaChunk *free_chunks;
+  gint num_free_chunks;
+};
+
+/* every buffer is preceded by a pointer to its chunk */
+#define LOG_WRITER_ARENA_BUFFER_HDR     (sizeof(LogWriterArenaChunk *))
+#define LOG_WRITER_ARENA_ALIGN(x)       (((x) + sizeof(gpointer) - 1) & ~(sizeof(gpointer) - 1))
+
+static LogWriterArena *
+log_writer_arena_ref(LogWriterArena *self)
+{
+  g_atomic_int_inc(&self->ref_cnt);
+  return self;
+}
+
+static void
+log_writer_arena_unref(LogWriterArena *self)
+{
+  LogWriterArenaChunk *chunk;
+
+  if (!g_atomic_int_dec_and_test(&self->ref_cnt))
+    return;
+
+  while ((chunk = self->free_chunks))
+    {
+      self->free_chunks = chunk->next_free;
+      g_free(chunk);
+    }
+  g_static_mutex_free(&self->lock);
+  g_free(self);
+}
+
+static LogWriterArenaChunk *
+_chunk_new(LogWriterArena *self, gsize size)
+{
+  LogWriterArenaChunk *chunk = NULL;
+
+  if (size == LOG_WRITER_ARENA_CHUNK_SIZE)
+    {
+      g_static_mutex_lock(&self->lock);
+      chunk = self->free_chunks;
+      if (chunk)
+        {
+          self->free_chunks = chunk->next_free;
+          self->num_free_chunks--;
+        }
+      g_static_mutex_unlock(&self->lock);
+    }
+  if (!chunk)
+    {
+      chunk = g_malloc(sizeof(LogWriterArenaChunk) + size);
+      chunk->size = size;
+    }
+
+  chunk->arena = log_writer_arena_ref(self);
+  chunk->ref_cnt = 1;
+  chunk->pos = 0;
+  chunk->next_free = NULL;
+  return chunk;
+}
+
+static void
+_chunk_unref(LogWriterArenaChunk *chunk)
+{
+  LogWriterArena *self = chunk->arena;
+
+  if (!g_atomic_int_dec_and_test(&chunk->ref_cnt))
+    return;
+
+  g_static_mutex_lock(&self->lock);
+  if (chunk->size == LOG_WRITER_ARENA_CHUNK_SIZE && self->num_free_chunks < LOG_WRITER_ARENA_MAX_FREE)
+    {
+      chunk->next_free = self->free_chunks;
+      self->free_chunks = chunk;
+      self->num_free_chunks++;
+      chunk = NULL;
+    }
+  g_static_mutex_unlock(&self->lock);
+
+  g_free(chunk);
+  log_writer_arena_unref(self);
+}
+
+static gpointer
+_chunk_alloc(LogWriterArenaChunk *chunk, gsize size)
+{
+  gchar *buffer = chunk->data + chunk->pos;
+
+  *((LogWriterArenaChunk **) buffer) = chunk;
+  chunk->pos += LOG_WRITER_ARENA_ALIGN(size);
+  g_atomic_int_inc(&chunk->ref_cnt);
+  return buffer + LOG_WRITER_ARENA_BUFFER_HDR;
+}
+
+/* copies @data to the arena, the result is NUL terminated */
+guchar *
+log_writer_arena_store(LogWriterArena *self, const gchar *data, gsize len)
+{
+  gsize size = LOG_WRITER_ARENA_BUFFER_HDR + len + 1;
+  guchar *buffer;
+
+  if (size > LOG_WRITER_ARENA_MAX_BUFFER)
+    {
+      LogWriterArenaChunk *chunk = _chunk_new(self, LOG_WRITER_ARENA_ALIGN(size));
+
+      buffer = _chunk_alloc(chunk, size);
+      _chunk_unref(chunk);
+    }
+  else
+    {
+      if (self->current && self->current->pos + size > self->current->size)
+        {
+          _chunk_unref(self->current);
+          self->current = NULL;
+        }
+      if (!self->current)
+        self->current = _chunk_new(self, LOG_WRITER_ARENA_CHUNK_SIZE);
+      buffer = _chunk_alloc(self->current, size);
+    }
+
+  memcpy(buffer, data, len);
+  buffer[len] = 0;
+  return buffer;
+}
+
+void
+log_writer_arena_free_buffer(gpointer buffer)
+{
+  if (buffer)
+    _chunk_unref(*(LogWriterArenaChunk **) (((gchar *) buffer) - LOG_WRITER_ARENA_BUFFER_HDR));
+}
+
+LogWriterArena *
+log_writer_arena_new(void)
+{
+  LogWriterArena *self = g_new0(LogWriterArena, 1);
+
+  self->ref_cnt = 1;
+  g_static_mutex_init(&self->lock);
+  return self;
+}
+
+/* called by the owner, buffers still in use keep the arena alive */
+void
+log_writer_arena_free(LogWriterArena *self)
+{
+  if (self->current)
+    {
+      _chunk_unref(self->current);
+      self->current = NULL;
+    }
+  log_writer_arena_unref(self);
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef LOGWRITER_ARENA_H_INCLUDED
+#define LOGWRITER_ARENA_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/*
+ * Recyclable output buffer arena of LogWriter.
+ *
+ * Formatted messages are stored back-to-back in large chunks instead of
+ * being allocated one by one.  The buffers are handed over to the
+ * LogProtoClient, which releases them using log_writer_arena_free_buffer()
+ * once written; a chunk is recycled when all of its buffers are released.
+ */
+
+typedef struct _LogWriterArena LogWriterArena;
+
+guchar *log_writer_arena_store(LogWriterArena *self, const gchar *data, gsize len);
+void log_writer_arena_free_buffer(gpointer buffer);
+
+LogWriterArena *log_writer_arena_new(void);
+void log_writer_arena_free(LogWriterArena *self);
+
+#endif
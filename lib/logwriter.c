@@ -25,6 +25,8 @@
 #include "logwriter.h"
 #include "messages.h"
 #include "stats/stats-registry.h"
+#include "stats/stats-latency.h"
+#include "stats/stats-trace.h"
 #include "hostname.h"
 #include "host-resolve.h"
 #include "seqnum.h"
@@ -35,6 +37,8 @@
 #include "mainloop-call.h"
 #include "ml-batched-timer.h"
 #include "str-format.h"
+#include "logwriter-arena.h"
+#include "usdt-probes.h"
 
 #include <unistd.h>
 #include <assert.h>
@@ -46,6 +50,9 @@
 #include <iv_event.h>
 #include <iv_work.h>
 
+/* number of messages taken from the queue at once while flushing */
+#define LOG_WRITER_FLUSH_BATCH_SIZE 64
+
 typedef enum
 {
   /* flush modes */
@@ -66,11 +73,16 @@ struct _LogWriter
   StatsCounterItem *suppressed_messages;
   StatsCounterItem *processed_messages;
   StatsCounterItem *stored_messages;
+  StatsLatencyCounters latency;
+  StatsTraceCounters trace;
+  /* the time the current batch was popped, if tracing is enabled */
+  gint64 trace_popped;
   LogPipe *control;
   LogWriterOptions *options;
   LogMessage *last_msg;
   guint32 last_msg_count;
   GString *line_buffer;
+  LogWriterArena *arena;
 
   gint stats_level;
   guint16 stats_source;
@@ -85,6 +97,10 @@ struct _LogWriter
   GStaticMutex suppress_lock;
   MlBatchedTimer suppress_timer;
   MlBatchedTimer mark_timer;
+  /* write coalescing, see log_writer_coalesce_output(), accessed atomically */
+  MlBatchedTimer flush_timer;
+  gboolean flush_deadline_pending;
+  gboolean flush_deadline_expired;
   struct iv_timer reopen_timer;
   gboolean work_result;
   gint pollable_state;
@@ -133,6 +149,7 @@ static void
 log_writer_msg_ack(gint num_msg_acked, gpointer user_data)
 {
   LogWriter *self = (LogWriter *)user_data;
+  SYSLOG_NG_PROBE2(writer__ack, self, num_msg_acked);
   log_queue_ack_backlog(self->queue, num_msg_acked);
 }
 
@@ -428,12 +445,18 @@ log_writer_update_watches(LogWriter *self)
   gint fd;
   GIOCondition cond = 0;
   gint timeout_msec = 0;
+  gboolean output_pending;
 
   main_loop_assert_main_thread();
 
+  /* NOTE: buffered output is not written while it is being held back by
+   * write coalescing, flush_timer takes care of that */
+  output_pending = log_proto_client_prepare(self->proto, &fd, &cond) &&
+                   !g_atomic_int_get(&self->flush_deadline_pending);
+
   /* NOTE: we either start the suspend_timer or enable the fd_watch. The two MUST not happen at the same time. */
 
-  if (log_proto_client_prepare(self->proto, &fd, &cond) ||
+  if (output_pending ||
       self->waiting_for_throttle ||
       log_queue_check_items(self->queue, &timeout_msec,
                             (LogQueuePushNotifyFunc) log_writer_schedule_update_watches, self, NULL))
@@ -1068,14 +1091,6 @@ log_writer_broken(LogWriter *self, gint notify_code)
   log_pipe_notify(self->control, notify_code, self);
 }
 
-static void
-log_writer_realloc_line_buffer(LogWriter *self)
-{
-  self->line_buffer->str = g_malloc(self->line_buffer->allocated_len);
-  self->line_buffer->str[0] = 0;
-  self->line_buffer->len = 0;
-}
-
 /*
  * Write messages to the underlying file descriptor using the installed
  * LogProtoClient instance.  This is called whenever the output is ready to accept
@@ -1088,6 +1103,59 @@ log_writer_realloc_line_buffer(LogWriter *self)
  *
  */
 
+/*
+ * Write coalescing
+ *
+ * With flush-timeout-usec(), output buffered by the proto (e.g. less than
+ * flush-lines() messages in the case of files) is not flushed at the end of
+ * every write cycle, but is held back until either the proto flushes it by
+ * itself or the deadline passes.  The deadline is not moved by subsequent
+ * messages, so it bounds the latency of the first message held back.
+ *
+ * Returns TRUE if the flush should be skipped.
+ */
+static gboolean
+log_writer_coalesce_output(LogWriter *self)
+{
+  gint fd;
+  GIOCondition cond;
+
+  if (self->options->flush_timeout_usec <= 0)
+    return FALSE;
+
+  /* nothing is buffered, the flush is a noop anyway */
+  if (!log_proto_client_prepare(self->proto, &fd, &cond))
+    return FALSE;
+
+  if (g_atomic_int_get(&self->flush_deadline_expired))
+    {
+      g_atomic_int_set(&self->flush_deadline_expired, FALSE);
+      return FALSE;
+    }
+
+  if (!g_atomic_int_get(&self->flush_deadline_pending))
+    {
+      g_atomic_int_set(&self->flush_deadline_pending, TRUE);
+      ml_batched_timer_postpone_usec(&self->flush_timer, self->options->flush_timeout_usec);
+    }
+  return TRUE;
+}
+
+static void
+log_writer_flush_timeout(gpointer s)
+{
+  LogWriter *self = (LogWriter *) s;
+
+  main_loop_assert_main_thread();
+
+  g_atomic_int_set(&self->flush_deadline_expired, TRUE);
+  g_atomic_int_set(&self->flush_deadline_pending, FALSE);
+
+  /* if we are working right now, log_writer_work_finished() updates the watches */
+  if (self->watches_running)
+    log_writer_update_watches(self);
+}
+
 static gboolean
 log_writer_flush_finalize(LogWriter *self)
 {
@@ -1120,21 +1188,22 @@ log_writer_write_message(LogWriter *self, LogMessage *msg, LogPathOptions *path_
 
   if (self->line_buffer->len)
     {
-      LogProtoStatus status = log_proto_client_post(self->proto, (guchar *)self->line_buffer->str, self->line_buffer->len, &consumed);
+      /* the buffer is owned by the proto once consumed, the line buffer
+       * itself is reused for the next message */
+      guchar *buffer = log_writer_arena_store(self->arena, self->line_buffer->str, self->line_buffer->len);
+      LogProtoStatus status;
+
+      SYSLOG_NG_PROBE3(writer__write, self, msg, self->line_buffer->len);
+      status = log_proto_client_post(self->proto, buffer, self->line_buffer->len, &consumed);
 
-      if (consumed)
-        log_writer_realloc_line_buffer(self);
+      if (!consumed)
+        log_writer_arena_free_buffer(buffer);
 
       if (status == LPS_ERROR)
         {
           if ((self->options->options & LWO_IGNORE_ERRORS) != 0)
             {
-              if (!consumed)
-                {
-                  g_free(self->line_buffer->str);
-                  log_writer_realloc_line_buffer(self);
-                  consumed = TRUE;
-                }
+              consumed = TRUE;
             }
           else
             {
@@ -1155,6 +1224,9 @@ log_writer_write_message(LogWriter *self, LogMessage *msg, LogPathOptions *path_
       if (msg->flags & LF_LOCAL)
         step_sequence_number(&self->seq_num);
 
+      stats_latency_counters_record_since(&self->latency, &msg->timestamps[LM_TS_RECVD]);
+      stats_trace_counters_record(&self->trace, msg, self->trace_popped);
+
       log_msg_unref(msg);
       msg_set_context(NULL);
       log_msg_refcache_stop();
@@ -1177,13 +1249,13 @@ log_writer_write_message(LogWriter *self, LogMessage *msg, LogPathOptions *path_
     }
 }
 
-static inline LogMessage *
-log_writer_queue_pop_message(LogWriter *self, LogPathOptions *path_options, gboolean force_flush)
+static inline gint
+log_writer_queue_pop_messages(LogWriter *self, LogMessage **msgs, LogPathOptions *path_options, gboolean force_flush)
 {
   if (force_flush)
-    return log_queue_pop_head_ignore_throttle(self->queue, path_options);
+    return log_queue_pop_head_batch_ignore_throttle(self->queue, LOG_WRITER_FLUSH_BATCH_SIZE, msgs, path_options);
   else
-    return log_queue_pop_head(self->queue, path_options);
+    return log_queue_pop_head_batch(self->queue, LOG_WRITER_FLUSH_BATCH_SIZE, msgs, path_options);
 }
 
 /*
@@ -1198,7 +1270,11 @@ log_writer_queue_pop_message(LogWriter *self, LogPathOptions *path_options, gboo
 gboolean
 log_writer_flush(LogWriter *self, LogWriterFlushMode flush_mode)
 {
+  LogMessage *msgs[LOG_WRITER_FLUSH_BATCH_SIZE];
+  LogPathOptions path_options[LOG_WRITER_FLUSH_BATCH_SIZE];
   gboolean write_error = FALSE;
+  gboolean flushing = TRUE;
+  gint num_msgs, i;
 
   if (!self->proto)
     return FALSE;
@@ -1208,21 +1284,37 @@ log_writer_flush(LogWriter *self, LogWriterFlushMode flush_mode)
    * infinite loop, since the reader will cease to produce new messages when
    * main_loop_io_worker_job_quit() is set. */
 
-  while ((!main_loop_worker_job_quit() || flush_mode == LW_FLUSH_FORCE) && !write_error)
+  while (flushing && (!main_loop_worker_job_quit() || flush_mode == LW_FLUSH_FORCE))
     {
-      LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
-      LogMessage *msg = log_writer_queue_pop_message(self, &path_options, flush_mode == LW_FLUSH_FORCE);
+      for (i = 0; i < LOG_WRITER_FLUSH_BATCH_SIZE; i++)
+        path_options[i] = (LogPathOptions) LOG_PATH_OPTIONS_INIT;
 
-      if (!msg)
+      num_msgs = log_writer_queue_pop_messages(self, msgs, path_options, flush_mode == LW_FLUSH_FORCE);
+      if (num_msgs == 0)
         break;
 
-      if (!log_writer_write_message(self, msg, &path_options, &write_error))
-        break;
+      if (stats_trace_counters_enabled(&self->trace))
+        self->trace_popped = stats_trace_now();
+
+      for (i = 0; i < num_msgs; i++)
+        {
+          if (!log_writer_write_message(self, msgs[i], &path_options[i], &write_error) ||
+              (main_loop_worker_job_quit() && flush_mode != LW_FLUSH_FORCE))
+            {
+              /* a failed write has already rewound its own message */
+              log_queue_unpop_batch(self->queue, &msgs[i + 1], &path_options[i + 1], num_msgs - i - 1);
+              flushing = FALSE;
+              break;
+            }
+        }
     }
 
   if (write_error)
     return FALSE;
 
+  if (flush_mode == LW_FLUSH_NORMAL && log_writer_coalesce_output(self))
+    return TRUE;
+
   return log_writer_flush_finalize(self);
 }
 
@@ -1252,12 +1344,20 @@ log_writer_init_watches(LogWriter *self)
   self->suppress_timer.handler = (void (*)(void *)) log_writer_suppress_timeout;
   self->suppress_timer.ref_cookie = (gpointer (*)(gpointer)) log_pipe_ref;
   self->suppress_timer.unref_cookie = (void (*)(gpointer)) log_pipe_unref;
+  self->suppress_timer.coarse = TRUE;
 
   ml_batched_timer_init(&self->mark_timer);
   self->mark_timer.cookie = self;
   self->mark_timer.handler = (void (*)(void *)) log_writer_mark_timeout;
   self->mark_timer.ref_cookie = (gpointer (*)(gpointer)) log_pipe_ref;
   self->mark_timer.unref_cookie = (void (*)(gpointer)) log_pipe_unref;
+  self->mark_timer.coarse = TRUE;
+
+  ml_batched_timer_init(&self->flush_timer);
+  self->flush_timer.cookie = self;
+  self->flush_timer.handler = (void (*)(void *)) log_writer_flush_timeout;
+  self->flush_timer.ref_cookie = (gpointer (*)(gpointer)) log_pipe_ref;
+  self->flush_timer.unref_cookie = (void (*)(gpointer)) log_pipe_unref;
 
   IV_TIMER_INIT(&self->reopen_timer);
   self->reopen_timer.cookie = self;
@@ -1293,6 +1393,9 @@ log_writer_init(LogPipe *s)
       stats_register_counter(self->stats_level, self->stats_source | SCS_DESTINATION, self->stats_id, self->stats_instance, SC_TYPE_PROCESSED, &self->processed_messages);
       
       stats_register_counter(self->stats_level, self->stats_source | SCS_DESTINATION, self->stats_id, self->stats_instance, SC_TYPE_STORED, &self->stored_messages);
+      stats_register_latency_counters(self->stats_source | SCS_DESTINATION, self->stats_id, self->stats_instance, &self->latency);
+      stats_register_trace_counters(self->stats_id, &self->trace);
+      log_queue_register_stats_counters(self->queue, self->stats_level, self->stats_source | SCS_DESTINATION, self->stats_id, self->stats_instance);
       stats_unlock();
     }
   log_queue_set_counters(self->queue, self->stored_messages, self->dropped_messages);
@@ -1334,6 +1437,9 @@ log_writer_deinit(LogPipe *s)
 
   ml_batched_timer_unregister(&self->suppress_timer);
   ml_batched_timer_unregister(&self->mark_timer);
+  ml_batched_timer_unregister(&self->flush_timer);
+  self->flush_deadline_pending = FALSE;
+  self->flush_deadline_expired = FALSE;
 
   log_queue_set_counters(self->queue, NULL, NULL);
 
@@ -1342,6 +1448,9 @@ log_writer_deinit(LogPipe *s)
   stats_unregister_counter(self->stats_source | SCS_DESTINATION, self->stats_id, self->stats_instance, SC_TYPE_SUPPRESSED, &self->suppressed_messages);
   stats_unregister_counter(self->stats_source | SCS_DESTINATION, self->stats_id, self->stats_instance, SC_TYPE_PROCESSED, &self->processed_messages);
   stats_unregister_counter(self->stats_source | SCS_DESTINATION, self->stats_id, self->stats_instance, SC_TYPE_STORED, &self->stored_messages);
+  stats_unregister_latency_counters(self->stats_source | SCS_DESTINATION, self->stats_id, self->stats_instance, &self->latency);
+  stats_unregister_trace_counters(self->stats_id, &self->trace);
+  log_queue_unregister_stats_counters(self->queue, self->stats_source | SCS_DESTINATION, self->stats_id, self->stats_instance);
   stats_unlock();
   
   return TRUE;
@@ -1356,6 +1465,7 @@ log_writer_free(LogPipe *s)
 
   if (self->line_buffer)
     g_string_free(self->line_buffer, TRUE);
+  log_writer_arena_free(self->arena);
 
   log_queue_unref(self->queue);
   if (self->last_msg)
@@ -1363,6 +1473,7 @@ log_writer_free(LogPipe *s)
   g_free(self->stats_id);
   g_free(self->stats_instance);
   ml_batched_timer_free(&self->mark_timer);
+  ml_batched_timer_free(&self->flush_timer);
   ml_batched_timer_free(&self->suppress_timer);
   g_static_mutex_free(&self->suppress_lock);
   g_static_mutex_free(&self->pending_proto_lock);
@@ -1401,6 +1512,8 @@ log_writer_set_proto(LogWriter *self, LogProtoClient *proto)
 
   if (proto)
     {
+      log_proto_client_set_msg_free(proto, log_writer_arena_free_buffer);
+
       LogProtoClientFlowControlFuncs flow_control_funcs;
       flow_control_funcs.ack_callback = log_writer_msg_ack;
       flow_control_funcs.rewind_callback = log_writer_msg_rewind;
@@ -1536,6 +1649,7 @@ log_writer_new(guint32 flags, GlobalConfig *cfg)
   self->super.free_fn = log_writer_free;
   self->flags = flags;
   self->line_buffer = g_string_sized_new(128);
+  self->arena = log_writer_arena_new();
   self->pollable_state = -1;
   init_sequence_number(&self->seq_num);
 
@@ -1553,6 +1667,7 @@ log_writer_options_defaults(LogWriterOptions *options)
   options->template = NULL;
   options->flush_lines = -1;
   options->flush_timeout = -1;
+  options->flush_timeout_usec = 0;
   log_template_options_defaults(&options->template_options);
   options->time_reopen = -1;
   options->suppress = -1;
@@ -1560,6 +1675,7 @@ log_writer_options_defaults(LogWriterOptions *options)
   options->mark_mode = MM_GLOBAL;
   options->mark_freq = -1;
   host_resolve_options_defaults(&options->host_resolve_options);
+  log_proto_client_options_defaults(&options->proto_options.super);
 }
 
 void 
@@ -59,6 +59,9 @@ typedef struct _LogWriterOptions
   
   /* flush anyway if this time was elapsed */
   gint flush_timeout;
+  /* hold buffered output for at most this long instead of flushing it at
+   * the end of every write cycle, 0 means disabled */
+  gint flush_timeout_usec;
   LogTemplate *template;
   LogTemplate *file_template;
   LogTemplate *proto_template;
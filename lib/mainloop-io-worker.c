@@ -25,32 +25,118 @@
 #include "mainloop-worker.h"
 #include "mainloop-call.h"
 #include "logqueue.h"
+#include "cpu-topology.h"
+#include "messages.h"
 
 /************************************************************************************
  * I/O worker threads
+ *
+ * Each worker thread has its own queue of jobs, protected by its own lock
+ * instead of a single lock shared by the whole pool.  A job is queued to
+ * the thread that ran it last, as that thread is likely to still have the
+ * reader's/writer's state in its cache.  Threads run their own queue in
+ * submission order and when it is empty, they steal the most recently
+ * queued job from the others, so the work of a single busy thread is
+ * spread among the idle ones.
+ *
+ * Completions are handed back to the main thread through a per-thread
+ * list and iv_event, just like iv_work_pool did.
+ *
+ * A job is only submitted by the main thread while it is not working
+ * (see main_loop_io_worker_job_submit()) and it is marked as not working
+ * again in the main thread once its completion has run, so a job is never
+ * run concurrently with itself, whichever thread picks it up.
  ************************************************************************************/
 
-static struct iv_work_pool main_loop_io_workers;
+typedef struct _MainLoopIOWorkerThread
+{
+  gint index;
+  GThread *thread;
+  GStaticMutex lock;
+  /* queued jobs, the owner takes them from the head, others steal from the tail */
+  struct iv_list_head jobs;
+  /* set when the thread found nothing to do and waits for its wakeup event */
+  gboolean idle;
+  gboolean quit;
+  /* registered in the worker thread */
+  struct iv_event wakeup;
+
+  /* finished jobs, their completion is run by the main thread */
+  struct iv_list_head completed;
+  /* registered in the main thread */
+  struct iv_event completion;
+} MainLoopIOWorkerThread;
+
+static MainLoopIOWorkerThread *main_loop_io_workers;
+static gint main_loop_io_workers_max_threads;
+static gint main_loop_io_workers_next_thread;
+static gboolean main_loop_io_workers_numa_affinity;
+static WorkerOptions main_loop_io_workers_options;
+static gint main_loop_io_workers_nice = G_MININT;
+static gchar *main_loop_io_workers_sched_policy;
+
+static GStaticMutex main_loop_io_workers_startup_lock = G_STATIC_MUTEX_INIT;
+static GCond *main_loop_io_workers_startup_cond;
+static gint main_loop_io_workers_started;
+
+static void
+_wakeup_idle_thread(MainLoopIOWorkerThread *busy)
+{
+  gint i;
+
+  /* NOTE: idle is read without the lock, a stale value only causes a
+   * spurious wakeup or leaves the job to its owner */
+  for (i = 0; i < main_loop_io_workers_max_threads; i++)
+    {
+      MainLoopIOWorkerThread *thread = &main_loop_io_workers[i];
+
+      if (thread != busy && thread->idle)
+        {
+          iv_event_post(&thread->wakeup);
+          return;
+        }
+    }
+}
 
 /* NOTE: runs in the main thread */
 void
 main_loop_io_worker_job_submit(MainLoopIOWorkerJob *self)
 {
+  MainLoopIOWorkerThread *thread;
+  gboolean idle;
+
   g_assert(self->working == FALSE);
   if (main_loop_workers_quit)
     return;
   main_loop_worker_job_start();
   self->working = TRUE;
-  iv_work_pool_submit_work(&main_loop_io_workers, &self->work_item);
+
+  if (self->thread_index < 0)
+    {
+      self->thread_index = main_loop_io_workers_next_thread;
+      main_loop_io_workers_next_thread = (main_loop_io_workers_next_thread + 1) % main_loop_io_workers_max_threads;
+    }
+  thread = &main_loop_io_workers[self->thread_index];
+
+  g_static_mutex_lock(&thread->lock);
+  iv_list_add_tail(&self->list, &thread->jobs);
+  idle = thread->idle;
+  g_static_mutex_unlock(&thread->lock);
+
+  if (idle)
+    iv_event_post(&thread->wakeup);
+  else
+    _wakeup_idle_thread(thread);
 }
 
-/* NOTE: runs in the actual worker thread spawned by the
- * main_loop_io_workers thread pool */
+/* NOTE: runs in the actual worker thread */
 static void
 _work(MainLoopIOWorkerJob *self)
 {
+  main_loop_worker_busy_start();
   self->work(self->user_data);
   main_loop_worker_invoke_batch_callbacks();
+  main_loop_worker_busy_end();
 }
 
 /* NOTE: runs in the main thread */
@@ -62,13 +148,115 @@ _complete(MainLoopIOWorkerJob *self)
   main_loop_worker_job_complete();
 }
 
+static MainLoopIOWorkerJob *
+_pop_own_job(MainLoopIOWorkerThread *thread)
+{
+  MainLoopIOWorkerJob *job = NULL;
+
+  g_static_mutex_lock(&thread->lock);
+  if (!iv_list_empty(&thread->jobs))
+    {
+      job = iv_list_entry(thread->jobs.next, MainLoopIOWorkerJob, list);
+      iv_list_del_init(&job->list);
+    }
+  g_static_mutex_unlock(&thread->lock);
+  return job;
+}
+
+static MainLoopIOWorkerJob *
+_steal_job(MainLoopIOWorkerThread *thief)
+{
+  MainLoopIOWorkerJob *job = NULL;
+  gint i;
+
+  for (i = 1; i < main_loop_io_workers_max_threads && !job; i++)
+    {
+      MainLoopIOWorkerThread *victim = &main_loop_io_workers[(thief->index + i) % main_loop_io_workers_max_threads];
+
+      g_static_mutex_lock(&victim->lock);
+      if (!iv_list_empty(&victim->jobs))
+        {
+          job = iv_list_entry(victim->jobs.prev, MainLoopIOWorkerJob, list);
+          iv_list_del_init(&job->list);
+        }
+      g_static_mutex_unlock(&victim->lock);
+    }
+  return job;
+}
+
+/* returns TRUE if the thread went idle, FALSE if new work has arrived in the meantime */
+static gboolean
+_enter_idle(MainLoopIOWorkerThread *thread)
+{
+  gboolean empty;
+
+  g_static_mutex_lock(&thread->lock);
+  empty = iv_list_empty(&thread->jobs);
+  if (empty)
+    thread->idle = TRUE;
+  g_static_mutex_unlock(&thread->lock);
+  return empty;
+}
+
+/* NOTE: runs in the worker thread, as its wakeup event is triggered */
+static void
+_thread_run_jobs(gpointer s)
+{
+  MainLoopIOWorkerThread *thread = (MainLoopIOWorkerThread *) s;
+  MainLoopIOWorkerJob *job;
+
+  if (thread->quit)
+    {
+      iv_event_unregister(&thread->wakeup);
+      iv_quit();
+      return;
+    }
+
+  thread->idle = FALSE;
+  do
+    {
+      while ((job = _pop_own_job(thread)) || (job = _steal_job(thread)))
+        {
+          _work(job);
+
+          /* next time it goes to us, we have it in our cache */
+          job->thread_index = thread->index;
+
+          g_static_mutex_lock(&thread->lock);
+          iv_list_add_tail(&job->list, &thread->completed);
+          g_static_mutex_unlock(&thread->lock);
+          iv_event_post(&thread->completion);
+        }
+    }
+  while (!_enter_idle(thread));
+}
+
+/* NOTE: runs in the main thread */
+static void
+_thread_run_completions(gpointer s)
+{
+  MainLoopIOWorkerThread *thread = (MainLoopIOWorkerThread *) s;
+  struct iv_list_head completed;
+
+  INIT_IV_LIST_HEAD(&completed);
+  g_static_mutex_lock(&thread->lock);
+  iv_list_splice_tail_init(&thread->completed, &completed);
+  g_static_mutex_unlock(&thread->lock);
+
+  while (!iv_list_empty(&completed))
+    {
+      MainLoopIOWorkerJob *job = iv_list_entry(completed.next, MainLoopIOWorkerJob, list);
+
+      iv_list_del_init(&job->list);
+      _complete(job);
+    }
+}
+
 void
 main_loop_io_worker_job_init(MainLoopIOWorkerJob *self)
 {
-  IV_WORK_ITEM_INIT(&self->work_item);
-  self->work_item.cookie = self;
-  self->work_item.work = (void (*)(void *)) _work;
-  self->work_item.completion = (void (*)(void *)) _complete;
+  INIT_IV_LIST_HEAD(&self->list);
+  self->thread_index = -1;
 }
 
 static gint
@@ -81,30 +269,150 @@ get_processor_count(void)
 #endif
 }
 
+/* NOTE: runs in the worker thread as it starts up */
+static void
+_thread_start(void *cookie)
+{
+  gint node;
+
+  main_loop_worker_thread_start(cookie);
+  if (!main_loop_io_workers_numa_affinity || cpu_topology_get_num_nodes() == 1)
+    return;
+
+  /* spread the workers evenly, so that the per-node input rings of
+   * log-fifo-numa() queues all get their producers */
+  node = main_loop_worker_get_thread_id() % cpu_topology_get_num_nodes();
+  if (!cpu_topology_bind_thread_to_node(node))
+    msg_debug("Unable to bind I/O worker thread to NUMA node",
+              evt_tag_int("node", node),
+              NULL);
+}
+
+static gpointer
+_thread_main(gpointer s)
+{
+  MainLoopIOWorkerThread *thread = (MainLoopIOWorkerThread *) s;
+
+  iv_init();
+  _thread_start(&main_loop_io_workers_options);
+
+  IV_EVENT_INIT(&thread->wakeup);
+  thread->wakeup.cookie = thread;
+  thread->wakeup.handler = _thread_run_jobs;
+  iv_event_register(&thread->wakeup);
+
+  /* jobs may only be submitted once all wakeup events are registered */
+  g_static_mutex_lock(&main_loop_io_workers_startup_lock);
+  main_loop_io_workers_started++;
+  g_cond_signal(main_loop_io_workers_startup_cond);
+  g_static_mutex_unlock(&main_loop_io_workers_startup_lock);
+
+  iv_main();
+
+  main_loop_worker_thread_stop();
+  iv_deinit();
+  return NULL;
+}
+
+static void
+_create_threads(void)
+{
+  gint i;
+
+  main_loop_io_workers = g_new0(MainLoopIOWorkerThread, main_loop_io_workers_max_threads);
+  main_loop_io_workers_startup_cond = g_cond_new();
+  main_loop_io_workers_started = 0;
+
+  for (i = 0; i < main_loop_io_workers_max_threads; i++)
+    {
+      MainLoopIOWorkerThread *thread = &main_loop_io_workers[i];
+
+      thread->index = i;
+      g_static_mutex_init(&thread->lock);
+      INIT_IV_LIST_HEAD(&thread->jobs);
+      INIT_IV_LIST_HEAD(&thread->completed);
+      /* only set once the thread is in its iv_main(), but nothing has been
+       * submitted yet anyway */
+      thread->idle = TRUE;
+
+      IV_EVENT_INIT(&thread->completion);
+      thread->completion.cookie = thread;
+      thread->completion.handler = _thread_run_completions;
+      iv_event_register(&thread->completion);
+
+      thread->thread = g_thread_create_full(_thread_main, thread, 1024 * 1024, TRUE, TRUE, G_THREAD_PRIORITY_NORMAL, NULL);
+      g_assert(thread->thread != NULL);
+    }
+
+  g_static_mutex_lock(&main_loop_io_workers_startup_lock);
+  while (main_loop_io_workers_started < main_loop_io_workers_max_threads)
+    g_cond_wait(main_loop_io_workers_startup_cond, g_static_mutex_get_mutex(&main_loop_io_workers_startup_lock));
+  g_static_mutex_unlock(&main_loop_io_workers_startup_lock);
+}
+
 void
 main_loop_io_worker_init(void)
 {
-  if (main_loop_io_workers.max_threads == 0)
+  if (main_loop_io_workers_max_threads == 0)
     {
-      main_loop_io_workers.max_threads = MIN(MAX(MAIN_LOOP_MIN_WORKER_THREADS, get_processor_count()), MAIN_LOOP_MAX_WORKER_THREADS);
+      main_loop_io_workers_max_threads = MIN(MAX(MAIN_LOOP_MIN_WORKER_THREADS, get_processor_count()), MAIN_LOOP_MAX_WORKER_THREADS);
     }
 
-  main_loop_io_workers.thread_start = (void (*)(void *)) main_loop_worker_thread_start;
-  main_loop_io_workers.thread_stop = (void (*)(void *)) main_loop_worker_thread_stop;
-  iv_work_pool_create(&main_loop_io_workers);
-  
-  log_queue_set_max_threads(MIN(main_loop_io_workers.max_threads, MAIN_LOOP_MAX_WORKER_THREADS));
+  if (main_loop_io_workers_nice != G_MININT)
+    {
+      main_loop_io_workers_options.nice = main_loop_io_workers_nice;
+      main_loop_io_workers_options.nice_set = TRUE;
+    }
+  if (main_loop_io_workers_sched_policy &&
+      !worker_options_set_sched_policy(&main_loop_io_workers_options, main_loop_io_workers_sched_policy))
+    msg_warning("Unknown scheduling policy for I/O worker threads, ignoring",
+                evt_tag_str("policy", main_loop_io_workers_sched_policy),
+                NULL);
+  if (main_loop_io_workers_options.cpu_affinity &&
+      !cpu_topology_validate_cpu_list(main_loop_io_workers_options.cpu_affinity))
+    {
+      msg_warning("Invalid CPU list for I/O worker threads, ignoring",
+                  evt_tag_str("cpu_affinity", main_loop_io_workers_options.cpu_affinity),
+                  NULL);
+      main_loop_io_workers_options.cpu_affinity = NULL;
+    }
+
+  _create_threads();
+
+  log_queue_set_max_threads(MIN(main_loop_io_workers_max_threads, MAIN_LOOP_MAX_WORKER_THREADS));
 }
 
 void
 main_loop_io_worker_deinit(void)
 {
-  iv_work_pool_put(&main_loop_io_workers);
+  gint i;
+
+  for (i = 0; i < main_loop_io_workers_max_threads; i++)
+    {
+      main_loop_io_workers[i].quit = TRUE;
+      iv_event_post(&main_loop_io_workers[i].wakeup);
+    }
+
+  for (i = 0; i < main_loop_io_workers_max_threads; i++)
+    {
+      MainLoopIOWorkerThread *thread = &main_loop_io_workers[i];
+
+      g_thread_join(thread->thread);
+      iv_event_unregister(&thread->completion);
+      g_static_mutex_free(&thread->lock);
+    }
+  g_free(main_loop_io_workers);
+  main_loop_io_workers = NULL;
+  g_cond_free(main_loop_io_workers_startup_cond);
 }
 
 static GOptionEntry main_loop_io_worker_options[] =
 {
-  { "worker-threads",      0,         0, G_OPTION_ARG_INT, &main_loop_io_workers.max_threads, "Set the number of I/O worker threads", "<max>" },
+  { "worker-threads",      0,         0, G_OPTION_ARG_INT, &main_loop_io_workers_max_threads, "Set the number of I/O worker threads", "<max>" },
+  { "worker-numa-affinity", 0,       0, G_OPTION_ARG_NONE, &main_loop_io_workers_numa_affinity, "Bind I/O worker threads to NUMA nodes", NULL },
+  { "worker-cpu-affinity", 0,        0, G_OPTION_ARG_STRING, &main_loop_io_workers_options.cpu_affinity, "Bind I/O worker threads to a list of CPUs", "<cpu-list>" },
+  { "worker-nice",         0,        0, G_OPTION_ARG_INT, &main_loop_io_workers_nice, "Set the nice value of I/O worker threads", "<nice>" },
+  { "worker-sched-policy", 0,        0, G_OPTION_ARG_STRING, &main_loop_io_workers_sched_policy, "Set the scheduling policy of I/O worker threads (other, batch, idle)", "<policy>" },
   { NULL },
 };
 
@@ -26,7 +26,7 @@
 
 #include "mainloop-worker.h"
 
-#include <iv_work.h>
+#include <iv_list.h>
 
 typedef struct _MainLoopIOWorkerJob
 {
@@ -34,7 +34,10 @@ typedef struct _MainLoopIOWorkerJob
   void (*completion)(gpointer user_data);
   gpointer user_data;
   gboolean working:1;
-  struct iv_work_item work_item;
+  /* position in the queue of a worker thread or its completed list */
+  struct iv_list_head list;
+  /* the worker thread the job is queued to, the one that ran it last */
+  gint thread_index;
 } MainLoopIOWorkerJob;
 
 void main_loop_io_worker_job_init(MainLoopIOWorkerJob *self);
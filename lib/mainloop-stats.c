@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "mainloop-stats.h"
+#include "mainloop-worker.h"
+#include "stats/stats-registry.h"
+#include "timeutils.h"
+
+#include <iv.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+/*
+ * Thread utilisation and main loop lag
+ *
+ * A watchdog timer fires in the main thread every
+ * MAIN_LOOP_STATS_WATCHDOG_FREQ milliseconds, the delay it experiences is
+ * the lag of the main loop: a handler hogging the main thread delays every
+ * other event, including the ones feeding the workers.  The largest lag
+ * of the last second is published as lag_usec of the (thread, main)
+ * cluster.
+ *
+ * Once a second, the busy time accounted by main_loop_worker_busy_start()/
+ * main_loop_worker_busy_end() is published for every thread id ever used,
+ * into (thread, io|output, <thread id>) clusters: busy_usec and the number
+ * of jobs as counters, and utilization_percent, the share of the last
+ * second spent working.  Workers close to 100% mean that the work would be
+ * spread further with more --worker-threads (I/O workers) or workers()
+ * (threaded destinations).  The main thread reports its CPU time the same
+ * way, where the platform can measure it.
+ *
+ * The counters are registered at stats-level(1).
+ */
+#define MAIN_LOOP_STATS_WATCHDOG_FREQ 100
+#define MAIN_LOOP_STATS_PUBLISH_TICKS 10
+
+typedef struct _MainLoopThreadCounters
+{
+  StatsCounterItem *busy;
+  StatsCounterItem *jobs;
+  StatsCounterItem *utilization;
+  gint64 last_busy_usec;
+} MainLoopThreadCounters;
+
+static MainLoopThreadCounters main_loop_stats_workers[MAIN_LOOP_WORKER_USAGE_SLOTS];
+static MainLoopThreadCounters main_loop_stats_main_thread;
+static StatsCounterItem *main_loop_stats_lag;
+static gboolean main_loop_stats_registered;
+
+static struct iv_timer main_loop_stats_watchdog;
+static gint64 main_loop_stats_max_lag;
+static gint main_loop_stats_ticks;
+static gint64 main_loop_stats_last_publish;
+
+static gint64
+_timespec_to_usec(const struct timespec *ts)
+{
+  return (gint64) ts->tv_sec * G_USEC_PER_SEC + ts->tv_nsec / 1000;
+}
+
+/* returns FALSE if the CPU time of the main thread is not available */
+static gboolean
+_get_main_thread_cpu_usec(gint64 *cpu_usec)
+{
+#ifdef RUSAGE_THREAD
+  struct rusage usage;
+
+  if (getrusage(RUSAGE_THREAD, &usage) < 0)
+    return FALSE;
+
+  *cpu_usec = (gint64) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * G_USEC_PER_SEC +
+              usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+
+static void
+_format_worker_instance(gint thread_id, gchar *buf, gsize buf_len)
+{
+  g_snprintf(buf, buf_len, "%d", thread_id % MAIN_LOOP_MAX_WORKER_THREADS);
+}
+
+static void
+_register_thread_counters(MainLoopThreadCounters *self, const gchar *id, const gchar *instance, gboolean count_jobs)
+{
+  stats_register_counter(STATS_LEVEL1, SCS_THREAD, id, instance, SC_TYPE_BUSY_TIME, &self->busy);
+  stats_register_counter(STATS_LEVEL1, SCS_THREAD, id, instance, SC_TYPE_UTILIZATION, &self->utilization);
+  if (count_jobs)
+    stats_register_counter(STATS_LEVEL1, SCS_THREAD, id, instance, SC_TYPE_PROCESSED, &self->jobs);
+}
+
+static void
+_unregister_thread_counters(MainLoopThreadCounters *self, const gchar *id, const gchar *instance)
+{
+  if (!self->busy)
+    return;
+
+  stats_unregister_counter(SCS_THREAD, id, instance, SC_TYPE_BUSY_TIME, &self->busy);
+  stats_unregister_counter(SCS_THREAD, id, instance, SC_TYPE_UTILIZATION, &self->utilization);
+  stats_unregister_counter(SCS_THREAD, id, instance, SC_TYPE_PROCESSED, &self->jobs);
+}
+
+static void
+_unregister_counters(void)
+{
+  gchar instance[16];
+  gint i;
+
+  stats_lock();
+  for (i = 0; i < MAIN_LOOP_WORKER_USAGE_SLOTS; i++)
+    {
+      _format_worker_instance(i, instance, sizeof(instance));
+      _unregister_thread_counters(&main_loop_stats_workers[i], main_loop_worker_get_thread_kind(i), instance);
+    }
+  _unregister_thread_counters(&main_loop_stats_main_thread, "main", NULL);
+  stats_unregister_counter(SCS_THREAD, "main", NULL, SC_TYPE_LAG, &main_loop_stats_lag);
+  stats_unlock();
+  main_loop_stats_registered = FALSE;
+}
+
+/* the busy time is kept monotonic, see main_loop_worker_busy_end() */
+static void
+_publish_thread_usage(MainLoopThreadCounters *self, gint64 busy_usec, gint64 jobs, gint64 elapsed_usec)
+{
+  gint64 busy_delta;
+
+  busy_usec = MAX(busy_usec, self->last_busy_usec);
+  busy_delta = busy_usec - self->last_busy_usec;
+  self->last_busy_usec = busy_usec;
+
+  stats_counter_set(self->busy, busy_usec);
+  stats_counter_set(self->jobs, jobs);
+  if (elapsed_usec > 0)
+    stats_counter_set(self->utilization, MIN(busy_delta * 100 / elapsed_usec, 100));
+}
+
+static void
+_publish(gint64 now_usec)
+{
+  MainLoopWorkerUsage usage;
+  gint64 elapsed_usec = main_loop_stats_last_publish ? now_usec - main_loop_stats_last_publish : 0;
+  gint64 cpu_usec;
+  gchar instance[16];
+  gint i;
+
+  main_loop_stats_last_publish = now_usec;
+  if (!stats_check_level(STATS_LEVEL1))
+    {
+      if (main_loop_stats_registered)
+        _unregister_counters();
+      return;
+    }
+
+  stats_lock();
+  if (!main_loop_stats_registered)
+    {
+      stats_register_counter(STATS_LEVEL1, SCS_THREAD, "main", NULL, SC_TYPE_LAG, &main_loop_stats_lag);
+      if (_get_main_thread_cpu_usec(&cpu_usec))
+        _register_thread_counters(&main_loop_stats_main_thread, "main", NULL, FALSE);
+      main_loop_stats_registered = TRUE;
+    }
+
+  for (i = 0; i < MAIN_LOOP_WORKER_USAGE_SLOTS; i++)
+    {
+      MainLoopThreadCounters *counters = &main_loop_stats_workers[i];
+
+      if (!main_loop_worker_get_usage(i, &usage))
+        continue;
+
+      if (!counters->busy)
+        {
+          _format_worker_instance(i, instance, sizeof(instance));
+          _register_thread_counters(counters, main_loop_worker_get_thread_kind(i), instance, TRUE);
+        }
+      _publish_thread_usage(counters, usage.busy_usec, usage.jobs, elapsed_usec);
+    }
+  stats_unlock();
+
+  if (main_loop_stats_main_thread.busy && _get_main_thread_cpu_usec(&cpu_usec))
+    _publish_thread_usage(&main_loop_stats_main_thread, cpu_usec, 0, elapsed_usec);
+
+  stats_counter_set(main_loop_stats_lag, main_loop_stats_max_lag);
+  main_loop_stats_max_lag = 0;
+}
+
+static void
+_watchdog_rearm(void)
+{
+  main_loop_stats_watchdog.expires = iv_now;
+  timespec_add_msec(&main_loop_stats_watchdog.expires, MAIN_LOOP_STATS_WATCHDOG_FREQ);
+  iv_timer_register(&main_loop_stats_watchdog);
+}
+
+static void
+_watchdog_elapsed(gpointer user_data)
+{
+  gint64 now_usec, lag_usec;
+
+  iv_validate_now();
+  now_usec = _timespec_to_usec(&iv_now);
+  lag_usec = now_usec - _timespec_to_usec(&main_loop_stats_watchdog.expires);
+  main_loop_stats_max_lag = MAX(main_loop_stats_max_lag, lag_usec);
+
+  if (++main_loop_stats_ticks == MAIN_LOOP_STATS_PUBLISH_TICKS)
+    {
+      main_loop_stats_ticks = 0;
+      _publish(now_usec);
+    }
+  _watchdog_rearm();
+}
+
+void
+main_loop_stats_init(void)
+{
+  IV_TIMER_INIT(&main_loop_stats_watchdog);
+  main_loop_stats_watchdog.handler = _watchdog_elapsed;
+  iv_validate_now();
+  _watchdog_rearm();
+}
+
+void
+main_loop_stats_deinit(void)
+{
+  if (iv_timer_registered(&main_loop_stats_watchdog))
+    iv_timer_unregister(&main_loop_stats_watchdog);
+  if (main_loop_stats_registered)
+    _unregister_counters();
+}
@@ -25,8 +25,20 @@
 #include "mainloop-call.h"
 #include "tls-support.h"
 #include "apphook.h"
+#include "scratch-buffers.h"
+#include "cpu-topology.h"
+#include "messages.h"
 
 #include <iv.h>
+#include <errno.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 typedef enum { GENERAL_THREAD = 0, OUTPUT_THREAD, EXTERNAL_INPUT_THREAD, MAIN_LOOP_WORKER_TYPE_MAX} MainLoopWorkerType;
 
@@ -65,6 +77,17 @@ static GStaticMutex main_loop_workers_idmap_lock = G_STATIC_MUTEX_INIT;
 
 static guint64 main_loop_workers_idmap[MAIN_LOOP_WORKER_TYPE_MAX];
 
+/* busy time accounting, each slot is only written by the thread owning the
+ * id, and read by the main thread */
+typedef struct _MainLoopWorkerUsageSlot
+{
+  MainLoopWorkerUsage usage;
+  /* start of the current busy period, 0 if idle */
+  gint64 busy_since;
+} MainLoopWorkerUsageSlot;
+
+static MainLoopWorkerUsageSlot main_loop_workers_usage[MAIN_LOOP_WORKER_USAGE_SLOTS];
+
 static void
 _allocate_thread_id(void)
 {
@@ -121,6 +144,90 @@ main_loop_worker_get_thread_id(void)
   return main_loop_worker_id - 1;
 }
 
+static gint64
+_get_monotonic_usec(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (gint64) ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+static inline MainLoopWorkerUsageSlot *
+_get_usage_slot(void)
+{
+  gint thread_id = main_loop_worker_get_thread_id();
+
+  if (thread_id < 0 || thread_id >= MAIN_LOOP_WORKER_USAGE_SLOTS)
+    return NULL;
+  return &main_loop_workers_usage[thread_id];
+}
+
+void
+main_loop_worker_busy_start(void)
+{
+  MainLoopWorkerUsageSlot *slot = _get_usage_slot();
+
+  if (slot)
+    slot->busy_since = _get_monotonic_usec();
+}
+
+void
+main_loop_worker_busy_end(void)
+{
+  MainLoopWorkerUsageSlot *slot = _get_usage_slot();
+  gint64 busy_since;
+
+  if (!slot || !slot->busy_since)
+    return;
+
+  /* the reader may count the period twice for a moment, but never loses it */
+  busy_since = slot->busy_since;
+  slot->usage.busy_usec += _get_monotonic_usec() - busy_since;
+  slot->usage.jobs++;
+  slot->busy_since = 0;
+}
+
+/* the values only grow, reading twice protects against torn reads on 32 bit platforms */
+static gint64
+_read_usage_value(volatile gint64 *value)
+{
+  gint64 result;
+
+  do
+    result = *value;
+  while (result != *value);
+  return result;
+}
+
+/*
+ * Returns FALSE if the thread id has never been busy.  The current busy
+ * period of the thread is included, so that long running jobs show up as
+ * they go.
+ */
+gboolean
+main_loop_worker_get_usage(gint thread_id, MainLoopWorkerUsage *usage)
+{
+  MainLoopWorkerUsageSlot *slot;
+  gint64 busy_since;
+
+  g_assert(thread_id >= 0 && thread_id < MAIN_LOOP_WORKER_USAGE_SLOTS);
+
+  slot = &main_loop_workers_usage[thread_id];
+  busy_since = _read_usage_value(&slot->busy_since);
+  usage->busy_usec = _read_usage_value(&slot->usage.busy_usec);
+  usage->jobs = _read_usage_value(&slot->usage.jobs);
+  if (busy_since)
+    usage->busy_usec += MAX(_get_monotonic_usec() - busy_since, 0);
+  return usage->jobs > 0 || busy_since;
+}
+
+const gchar *
+main_loop_worker_get_thread_kind(gint thread_id)
+{
+  return (thread_id / MAIN_LOOP_MAX_WORKER_THREADS) == OUTPUT_THREAD ? "output" : "io";
+}
+
 typedef struct _WorkerExitNotification
 {
   WorkerExitNotificationFunc func;
@@ -156,6 +263,82 @@ _request_all_threads_to_exit(void)
   main_loop_workers_quit = TRUE;
 }
 
+gboolean
+worker_options_set_sched_policy(WorkerOptions *self, const gchar *policy)
+{
+  if (strcmp(policy, "default") == 0)
+    self->sched_policy = WORKER_SCHED_POLICY_DEFAULT;
+  else if (strcmp(policy, "other") == 0)
+    self->sched_policy = WORKER_SCHED_POLICY_OTHER;
+  else if (strcmp(policy, "batch") == 0)
+    self->sched_policy = WORKER_SCHED_POLICY_BATCH;
+  else if (strcmp(policy, "idle") == 0)
+    self->sched_policy = WORKER_SCHED_POLICY_IDLE;
+  else
+    return FALSE;
+  return TRUE;
+}
+
+static gint
+_get_sched_policy(WorkerSchedPolicy policy)
+{
+  switch (policy)
+    {
+#ifdef SCHED_BATCH
+    case WORKER_SCHED_POLICY_BATCH:
+      return SCHED_BATCH;
+#endif
+#ifdef SCHED_IDLE
+    case WORKER_SCHED_POLICY_IDLE:
+      return SCHED_IDLE;
+#endif
+    case WORKER_SCHED_POLICY_OTHER:
+      return SCHED_OTHER;
+    default:
+      return -1;
+    }
+}
+
+/* runs in the new thread, all of these only affect the calling thread */
+static void
+_apply_scheduling_options(WorkerOptions *worker_options)
+{
+  if (worker_options->cpu_affinity &&
+      !cpu_topology_bind_thread_to_cpu_list(worker_options->cpu_affinity))
+    msg_warning("Unable to set the CPU affinity of worker thread",
+                evt_tag_str("cpu_affinity", worker_options->cpu_affinity),
+                evt_tag_errno("error", errno),
+                NULL);
+
+  if (worker_options->sched_policy != WORKER_SCHED_POLICY_DEFAULT)
+    {
+      struct sched_param param = { 0 };
+      gint policy = _get_sched_policy(worker_options->sched_policy);
+
+      if (policy < 0 || sched_setscheduler(0, policy, &param) < 0)
+        msg_warning("Unable to set the scheduling policy of worker thread",
+                    evt_tag_int("policy", worker_options->sched_policy),
+                    evt_tag_errno("error", policy < 0 ? ENOSYS : errno),
+                    NULL);
+    }
+
+  if (worker_options->nice_set)
+    {
+#ifdef __linux__
+      /* on Linux the nice value is per-thread, addressed by the tid */
+      if (setpriority(PRIO_PROCESS, syscall(SYS_gettid), worker_options->nice) < 0)
+        msg_warning("Unable to set the nice value of worker thread",
+                    evt_tag_int("nice", worker_options->nice),
+                    evt_tag_errno("error", errno),
+                    NULL);
+#else
+      msg_warning("Setting the nice value of worker threads is not supported on this platform",
+                  evt_tag_int("nice", worker_options->nice),
+                  NULL);
+#endif
+    }
+}
+
 /* Call this function from worker threads, when you start up */
 void
 main_loop_worker_thread_start(void *cookie)
@@ -175,6 +358,9 @@ main_loop_worker_thread_start(void *cookie)
   _allocate_thread_id();
   INIT_IV_LIST_HEAD(&batch_callbacks);
   app_thread_start();
+
+  if (worker_options)
+    _apply_scheduling_options(worker_options);
 }
 
 /* Call this function from worker threads, when you stop */
@@ -270,6 +456,9 @@ main_loop_worker_invoke_batch_callbacks(void)
       cb->func(cb->user_data);
       iv_list_del_init(&cb->list);
     }
+
+  /* the batch is over, nothing may refer to the scratch arena anymore */
+  scratch_arena_reset();
 }
 
 typedef struct _WorkerThreadParams
@@ -48,12 +48,28 @@ typedef struct _WorkerBatchCallback
   gpointer user_data;
 } WorkerBatchCallback;
 
+typedef enum
+{
+  WORKER_SCHED_POLICY_DEFAULT = 0,
+  WORKER_SCHED_POLICY_OTHER,
+  WORKER_SCHED_POLICY_BATCH,
+  WORKER_SCHED_POLICY_IDLE,
+} WorkerSchedPolicy;
+
 typedef struct _WorkerOptions
 {
   gboolean is_output_thread;
   gboolean is_external_input;
+
+  /* applied by the thread itself as it starts, owned by the creator */
+  gchar *cpu_affinity;
+  gboolean nice_set;
+  gint nice;
+  WorkerSchedPolicy sched_policy;
 } WorkerOptions;
 
+gboolean worker_options_set_sched_policy(WorkerOptions *self, const gchar *policy);
+
 static inline void
 worker_batch_callback_init(WorkerBatchCallback *self)
 {
@@ -72,6 +88,29 @@ gint main_loop_worker_get_thread_id(void);
 void main_loop_worker_job_start(void);
 void main_loop_worker_job_complete(void);
 
+/*
+ * Busy time accounting
+ *
+ * Worker threads enclose the time they actually spend working (running an
+ * I/O job, a round of a threaded destination) between
+ * main_loop_worker_busy_start() and main_loop_worker_busy_end(), the rest
+ * of their life is considered idle.  The totals are kept per thread id and
+ * published by mainloop-stats.c.  Thread ids of different kinds don't
+ * overlap, so the kind of the thread can be told from its id.
+ */
+#define MAIN_LOOP_WORKER_USAGE_SLOTS (2 * MAIN_LOOP_MAX_WORKER_THREADS)
+
+typedef struct _MainLoopWorkerUsage
+{
+  gint64 busy_usec;
+  gint64 jobs;
+} MainLoopWorkerUsage;
+
+void main_loop_worker_busy_start(void);
+void main_loop_worker_busy_end(void);
+gboolean main_loop_worker_get_usage(gint thread_id, MainLoopWorkerUsage *usage);
+const gchar *main_loop_worker_get_thread_kind(gint thread_id);
+
 void main_loop_worker_thread_start(void *cookie);
 void main_loop_worker_thread_stop(void);
 
@@ -25,6 +25,7 @@
 #include "mainloop-worker.h"
 #include "mainloop-io-worker.h"
 #include "mainloop-call.h"
+#include "mainloop-stats.h"
 #include "apphook.h"
 #include "cfg.h"
 #include "stats/stats-registry.h"
@@ -277,6 +278,20 @@ main_loop_reload_config_initiate(void)
       service_management_publish_status("Error parsing new configuration, using the old config");
       return;
     }
+
+  if (main_loop_new_config->reload_skip_unchanged &&
+      cfg_is_preprocessed_config_equal(main_loop_old_config, main_loop_new_config))
+    {
+      /* nothing to do, keep the running pipeline, its connections and
+       * queues untouched, without stopping the worker threads */
+      cfg_free(main_loop_new_config);
+      main_loop_new_config = NULL;
+      main_loop_old_config = NULL;
+      msg_notice("Configuration reload request received, configuration unchanged, keeping the running one",
+                 NULL);
+      service_management_clear_status();
+      return;
+    }
   main_loop_worker_sync_call(main_loop_reload_config_apply);
 }
 
@@ -430,6 +445,7 @@ main_loop_init(void)
   main_loop_worker_init();
   main_loop_io_worker_init();
   main_loop_call_init();
+  main_loop_stats_init();
 
   main_loop_init_events();
   if (!syntax_only)
@@ -478,6 +494,7 @@ main_loop_deinit(void)
 
   iv_event_unregister(&exit_requested);
   iv_event_unregister(&reload_config_requested);
+  main_loop_stats_deinit();
   main_loop_call_deinit();
   main_loop_io_worker_deinit();
   main_loop_worker_deinit();
@@ -507,6 +524,7 @@ static GOptionEntry main_loop_options[] =
 {
   { "cfgfile",           'f',         0, G_OPTION_ARG_STRING, &resolvedConfigurablePaths.cfgfilename, "Set config file name, default=" PATH_SYSLOG_NG_CONF, "<config>" },
   { "persist-file",      'R',         0, G_OPTION_ARG_STRING, &resolvedConfigurablePaths.persist_file, "Set the name of the persistent configuration file, default=" PATH_PERSIST_CONFIG, "<fname>" },
+  { "plugin-cache",        0,         0, G_OPTION_ARG_STRING, &resolvedConfigurablePaths.plugin_cache_file, "Set the name of the plugin index cache, an empty string disables it, default=" PATH_PLUGIN_CACHE, "<fname>" },
   { "preprocess-into",     0,         0, G_OPTION_ARG_STRING, &preprocess_into, "Write the preprocessed configuration file to the file specified", "output" },
   { "syntax-only",       's',         0, G_OPTION_ARG_NONE, &syntax_only, "Only read and parse config file", NULL},
   { "control",           'c',         0, G_OPTION_ARG_STRING, &resolvedConfigurablePaths.ctlfilename, "Set syslog-ng control socket, default=" PATH_CONTROL_SOCKET, "<ctlpath>" },
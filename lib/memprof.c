@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "memprof.h"
+#include "tls-support.h"
+
+#include <string.h>
+#include <stdlib.h>
+#if SYSLOG_NG_HAVE_EXECINFO_H
+#include <execinfo.h>
+#endif
+
+#define MEMPROF_MAX_FRAMES 16
+/* memprof_sample_alloc() itself */
+#define MEMPROF_SKIP_FRAMES 1
+#define MEMPROF_REPORT_STACKS 32
+
+/*
+ * Frees are only looked up in the table of samples if the bucket of the
+ * pointer in this (lock-free) filter says that it may have been sampled,
+ * so that the frees of the vast majority of allocations remain cheap while
+ * the profiler is running.
+ */
+#define MEMPROF_FILTER_SIZE 4096
+
+typedef struct _MemProfStack
+{
+  gint num_frames;
+  gpointer frames[MEMPROF_MAX_FRAMES];
+  gint64 total_samples;
+  gint64 total_bytes;
+  gint64 live_samples;
+  gint64 live_bytes;
+} MemProfStack;
+
+typedef struct _MemProfSample
+{
+  MemProfStack *stack;
+  gint64 weight;
+} MemProfSample;
+
+TLS_BLOCK_START
+{
+  gint64 memprof_bytes_until_sample;
+}
+TLS_BLOCK_END;
+
+#define memprof_bytes_until_sample __tls_deref(memprof_bytes_until_sample)
+
+volatile gint memprof_sampling_rate;
+volatile gint memprof_live_samples;
+
+static GStaticMutex memprof_lock = G_STATIC_MUTEX_INIT;
+/* MemProfStack -> MemProfStack, keyed by the frames */
+static GHashTable *memprof_stacks;
+/* pointer -> MemProfSample */
+static GHashTable *memprof_samples;
+static gint memprof_filter[MEMPROF_FILTER_SIZE];
+
+static guint
+_stack_hash(gconstpointer s)
+{
+  const MemProfStack *stack = (const MemProfStack *) s;
+  guint hash = 5381;
+  gint i;
+
+  for (i = 0; i < stack->num_frames; i++)
+    hash = hash * 33 + GPOINTER_TO_UINT(stack->frames[i]);
+  return hash;
+}
+
+static gboolean
+_stack_equal(gconstpointer a, gconstpointer b)
+{
+  const MemProfStack *s1 = (const MemProfStack *) a;
+  const MemProfStack *s2 = (const MemProfStack *) b;
+
+  return s1->num_frames == s2->num_frames &&
+         memcmp(s1->frames, s2->frames, s1->num_frames * sizeof(s1->frames[0])) == 0;
+}
+
+static inline gint *
+_filter_bucket(gpointer ptr)
+{
+  return &memprof_filter[(GPOINTER_TO_SIZE(ptr) >> 4) % MEMPROF_FILTER_SIZE];
+}
+
+/* random intervals with a mean of the sampling rate, so that periodic allocation patterns don't skew the samples */
+static gint64
+_next_sample_interval(gint rate)
+{
+  return rate / 2 + g_random_int_range(0, rate) + 1;
+}
+
+void
+memprof_sample_alloc(gpointer ptr, gsize size)
+{
+  MemProfStack key, *stack;
+  MemProfSample *sample;
+#if SYSLOG_NG_HAVE_EXECINFO_H
+  gpointer frames[MEMPROF_MAX_FRAMES + MEMPROF_SKIP_FRAMES];
+  gint num_frames;
+#endif
+  gint rate = g_atomic_int_get(&memprof_sampling_rate);
+
+  if (!ptr || !rate)
+    return;
+
+  memprof_bytes_until_sample -= size;
+  if (memprof_bytes_until_sample > 0)
+    return;
+  memprof_bytes_until_sample = _next_sample_interval(rate);
+
+  /* NOTE: the stack has to be captured right here, for the frames to skip to be right */
+#if SYSLOG_NG_HAVE_EXECINFO_H
+  num_frames = backtrace(frames, G_N_ELEMENTS(frames));
+  key.num_frames = MAX(num_frames - MEMPROF_SKIP_FRAMES, 0);
+  memcpy(key.frames, frames + MEMPROF_SKIP_FRAMES, key.num_frames * sizeof(key.frames[0]));
+#else
+  key.num_frames = 1;
+  key.frames[0] = __builtin_return_address(0);
+#endif
+
+  g_static_mutex_lock(&memprof_lock);
+  if (!memprof_sampling_rate || g_hash_table_lookup(memprof_samples, ptr))
+    {
+      g_static_mutex_unlock(&memprof_lock);
+      return;
+    }
+
+  stack = g_hash_table_lookup(memprof_stacks, &key);
+  if (!stack)
+    {
+      stack = g_new0(MemProfStack, 1);
+      stack->num_frames = key.num_frames;
+      memcpy(stack->frames, key.frames, key.num_frames * sizeof(key.frames[0]));
+      g_hash_table_insert(memprof_stacks, stack, stack);
+    }
+
+  /* an allocation larger than the rate is always sampled, smaller ones
+   * stand for the rate bytes that were allocated around them */
+  sample = g_new(MemProfSample, 1);
+  sample->stack = stack;
+  sample->weight = MAX((gint64) size, rate);
+  g_hash_table_insert(memprof_samples, ptr, sample);
+
+  stack->total_samples++;
+  stack->total_bytes += sample->weight;
+  stack->live_samples++;
+  stack->live_bytes += sample->weight;
+
+  g_atomic_int_inc(_filter_bucket(ptr));
+  g_atomic_int_inc(&memprof_live_samples);
+  g_static_mutex_unlock(&memprof_lock);
+}
+
+void
+memprof_sample_free(gpointer ptr)
+{
+  MemProfSample *sample;
+  gint *bucket = _filter_bucket(ptr);
+
+  if (!ptr || !g_atomic_int_get(bucket))
+    return;
+
+  g_static_mutex_lock(&memprof_lock);
+  sample = memprof_samples ? g_hash_table_lookup(memprof_samples, ptr) : NULL;
+  if (sample)
+    {
+      sample->stack->live_samples--;
+      sample->stack->live_bytes -= sample->weight;
+      g_hash_table_remove(memprof_samples, ptr);
+
+      g_atomic_int_add(bucket, -1);
+      g_atomic_int_add(&memprof_live_samples, -1);
+    }
+  g_static_mutex_unlock(&memprof_lock);
+}
+
+/* NOTE: restarting the profiler keeps the allocations sampled so far */
+void
+memprof_start(gint sampling_rate)
+{
+  g_assert(sampling_rate > 0);
+
+  g_static_mutex_lock(&memprof_lock);
+  if (!memprof_stacks)
+    {
+      memprof_stacks = g_hash_table_new_full(_stack_hash, _stack_equal, g_free, NULL);
+      memprof_samples = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+    }
+  g_atomic_int_set(&memprof_sampling_rate, sampling_rate);
+  g_static_mutex_unlock(&memprof_lock);
+}
+
+void
+memprof_stop(void)
+{
+  g_static_mutex_lock(&memprof_lock);
+  g_atomic_int_set(&memprof_sampling_rate, 0);
+  g_atomic_int_set(&memprof_live_samples, 0);
+  memset(memprof_filter, 0, sizeof(memprof_filter));
+  if (memprof_stacks)
+    {
+      g_hash_table_destroy(memprof_samples);
+      g_hash_table_destroy(memprof_stacks);
+      memprof_samples = NULL;
+      memprof_stacks = NULL;
+    }
+  g_static_mutex_unlock(&memprof_lock);
+}
+
+static void
+_collect_stack(gpointer key, gpointer value, gpointer user_data)
+{
+  g_ptr_array_add((GPtrArray *) user_data, value);
+}
+
+static gint
+_compare_stacks_by_live_bytes(gconstpointer a, gconstpointer b)
+{
+  const MemProfStack *s1 = *(const MemProfStack **) a;
+  const MemProfStack *s2 = *(const MemProfStack **) b;
+
+  if (s1->live_bytes != s2->live_bytes)
+    return s1->live_bytes > s2->live_bytes ? -1 : 1;
+  return s1->total_bytes > s2->total_bytes ? -1 : s1->total_bytes < s2->total_bytes;
+}
+
+static void
+_format_stack_frames(GString *result, MemProfStack *stack)
+{
+#if SYSLOG_NG_HAVE_EXECINFO_H
+  gchar **symbols = backtrace_symbols(stack->frames, stack->num_frames);
+#else
+  gchar **symbols = NULL;
+#endif
+  gint i;
+
+  for (i = 0; i < stack->num_frames; i++)
+    {
+      if (symbols)
+        g_string_append_printf(result, "  #%d %s\n", i, symbols[i]);
+      else
+        g_string_append_printf(result, "  #%d %p\n", i, stack->frames[i]);
+    }
+  free(symbols);
+}
+
+/*
+ * The report lists the stacks holding the most memory, the byte values
+ * are estimates: every sample stands for sampling-rate bytes (or its own
+ * size, if larger).
+ */
+GString *
+memprof_format_report(void)
+{
+  GString *result = g_string_sized_new(4096);
+  GPtrArray *stacks;
+  guint i;
+
+  g_static_mutex_lock(&memprof_lock);
+  g_string_append_printf(result, "sampling_rate=%d\nlive_samples=%d\n",
+                         memprof_sampling_rate, memprof_live_samples);
+  if (!memprof_stacks)
+    {
+      g_static_mutex_unlock(&memprof_lock);
+      return result;
+    }
+
+  stacks = g_ptr_array_new();
+  g_hash_table_foreach(memprof_stacks, _collect_stack, stacks);
+  g_ptr_array_sort(stacks, _compare_stacks_by_live_bytes);
+
+  for (i = 0; i < stacks->len && i < MEMPROF_REPORT_STACKS; i++)
+    {
+      MemProfStack *stack = g_ptr_array_index(stacks, i);
+
+      g_string_append_printf(result, "stack=%08x live_bytes=%" G_GINT64_FORMAT
+                             " live_samples=%" G_GINT64_FORMAT
+                             " total_bytes=%" G_GINT64_FORMAT
+                             " total_samples=%" G_GINT64_FORMAT "\n",
+                             _stack_hash(stack), stack->live_bytes, stack->live_samples,
+                             stack->total_bytes, stack->total_samples);
+      _format_stack_frames(result, stack);
+    }
+  g_ptr_array_free(stacks, TRUE);
+  g_static_mutex_unlock(&memprof_lock);
+  return result;
+}
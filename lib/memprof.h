@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#ifndef MEMPROF_H_INCLUDED
+#define MEMPROF_H_INCLUDED 1
+
+#include "syslog-ng.h"
+
+/*
+ * Sampling allocation profiler
+ *
+ * Unlike memtrace, which replaces malloc() at compile time, this one is
+ * built in and can be turned on at runtime (syslog-ng-ctl memprof).  The
+ * allocation paths of LogMessage, NVTable and scratch buffers report their
+ * allocations through memprof_record_alloc()/memprof_record_free(), which
+ * is a single branch while the profiler is off.
+ *
+ * When enabled, roughly one allocation in every sampling-rate bytes
+ * allocated is sampled: its call stack is recorded, and it is tracked
+ * until it is freed.  The report lists the call stacks holding the most
+ * live memory, with estimates extrapolated from the samples.
+ */
+
+extern volatile gint memprof_sampling_rate;
+extern volatile gint memprof_live_samples;
+
+void memprof_sample_alloc(gpointer ptr, gsize size);
+void memprof_sample_free(gpointer ptr);
+
+static inline void
+memprof_record_alloc(gpointer ptr, gsize size)
+{
+  if (G_UNLIKELY(memprof_sampling_rate))
+    memprof_sample_alloc(ptr, size);
+}
+
+static inline void
+memprof_record_free(gpointer ptr)
+{
+  if (G_UNLIKELY(memprof_live_samples))
+    memprof_sample_free(ptr);
+}
+
+void memprof_start(gint sampling_rate);
+void memprof_stop(void);
+GString *memprof_format_report(void);
+
+#endif
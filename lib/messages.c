@@ -31,9 +31,16 @@
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include <evtlog.h>
 
+/* at most MSG_RATE_LIMIT_BURST messages of the same template are
+ * delivered in each MSG_RATE_LIMIT_INTERVAL seconds, see msg_limit_rate() */
+#define MSG_RATE_LIMIT_BURST     20
+#define MSG_RATE_LIMIT_INTERVAL  1
+#define MSG_RATE_LIMIT_SLOTS     256
+
 enum
 {
   /* processing a non-internal message, we're definitely not recursing */
@@ -44,6 +51,22 @@ enum
   RECURSE_STATE_SUPPRESS = 2
 };
 
+typedef struct _MsgRateLimitSlot
+{
+  gchar *desc;
+  gint prio;
+  time_t window_start;
+  gint count;
+  gint suppressed;
+} MsgRateLimitSlot;
+
+typedef struct _MsgSuppressionSummary
+{
+  gchar *desc;
+  gint prio;
+  gint suppressed;
+} MsgSuppressionSummary;
+
 typedef struct _MsgContext
 {
   guint16 recurse_state;
@@ -61,6 +84,8 @@ static MsgPostFunc msg_post_func;
 static EVTCONTEXT *evt_context;
 static GStaticPrivate msg_context_private = G_STATIC_PRIVATE_INIT;
 static GStaticMutex evtlog_lock = G_STATIC_MUTEX_INIT;
+static MsgRateLimitSlot rate_limit_slots[MSG_RATE_LIMIT_SLOTS];
+static GStaticMutex rate_limit_lock = G_STATIC_MUTEX_INIT;
 
 static MsgContext *
 msg_get_context(void)
@@ -120,6 +145,128 @@ msg_limit_internal_message(const gchar *msg)
   return TRUE;
 }
 
+static void
+msg_send_suppression_summary(MsgSuppressionSummary *summary)
+{
+  if (!summary->desc)
+    return;
+
+  if (summary->suppressed)
+    msg_event_send(
+      msg_event_create(summary->prio, "Internal messages were suppressed because of their rate",
+                       evt_tag_str("msg", summary->desc),
+                       evt_tag_int("suppressed", summary->suppressed),
+                       evt_tag_int("interval", MSG_RATE_LIMIT_INTERVAL),
+                       NULL));
+  g_free(summary->desc);
+  summary->desc = NULL;
+}
+
+/* moves the pending suppression summary of the slot to @summary, must be
+ * called with rate_limit_lock held */
+static void
+msg_rate_limit_slot_take_summary(MsgRateLimitSlot *slot, MsgSuppressionSummary *summary)
+{
+  if (!slot->suppressed)
+    return;
+  summary->desc = g_strdup(slot->desc);
+  summary->prio = slot->prio;
+  summary->suppressed = slot->suppressed;
+  slot->suppressed = 0;
+}
+
+/*
+ * msg_limit_rate:
+ *
+ * Returns whether a message of the template @desc may be sent: messages
+ * flowing to the internal() source are grouped by their template and
+ * only MSG_RATE_LIMIT_BURST of each are delivered per interval, the rest
+ * are counted and reported in a single summary once the interval is
+ * over.  This keeps error storms (e.g. a flapping destination) from
+ * flooding the log path right when it is overloaded already, the check
+ * happens before the message is formatted.
+ *
+ * Templates are hashed to a fixed number of slots, if two of them
+ * collide while both are active, the newcomer is not limited.
+ */
+gboolean
+msg_limit_rate(gint prio, const gchar *desc)
+{
+  MsgSuppressionSummary summary = { NULL, 0, 0 };
+  MsgRateLimitSlot *slot;
+  gboolean allowed = TRUE;
+  time_t now;
+
+  if (log_stderr || !msg_post_func || !desc)
+    return TRUE;
+
+  now = time(NULL);
+  slot = &rate_limit_slots[g_str_hash(desc) % MSG_RATE_LIMIT_SLOTS];
+
+  g_static_mutex_lock(&rate_limit_lock);
+  if (!slot->desc || strcmp(slot->desc, desc) != 0)
+    {
+      if (slot->desc && now < slot->window_start + MSG_RATE_LIMIT_INTERVAL)
+        goto exit;
+
+      msg_rate_limit_slot_take_summary(slot, &summary);
+      g_free(slot->desc);
+      slot->desc = g_strdup(desc);
+      slot->window_start = now;
+      slot->count = 0;
+    }
+  else if (now >= slot->window_start + MSG_RATE_LIMIT_INTERVAL)
+    {
+      msg_rate_limit_slot_take_summary(slot, &summary);
+      slot->window_start = now;
+      slot->count = 0;
+    }
+  slot->prio = prio;
+
+  if (slot->count < MSG_RATE_LIMIT_BURST)
+    slot->count++;
+  else
+    {
+      slot->suppressed++;
+      allowed = FALSE;
+    }
+exit:
+  g_static_mutex_unlock(&rate_limit_lock);
+
+  msg_send_suppression_summary(&summary);
+  return allowed;
+}
+
+/*
+ * Report the messages suppressed in intervals that are over, without
+ * waiting for the next message of the same template.  Called
+ * periodically by the internal() source.
+ */
+void
+msg_flush_suppressed_messages(void)
+{
+  MsgSuppressionSummary summaries[16];
+  gint i, num_summaries;
+  time_t now = time(NULL);
+  gint slot = 0;
+
+  while (slot < MSG_RATE_LIMIT_SLOTS)
+    {
+      num_summaries = 0;
+      g_static_mutex_lock(&rate_limit_lock);
+      for (; slot < MSG_RATE_LIMIT_SLOTS && num_summaries < G_N_ELEMENTS(summaries); slot++)
+        {
+          if (rate_limit_slots[slot].suppressed &&
+              now >= rate_limit_slots[slot].window_start + MSG_RATE_LIMIT_INTERVAL)
+            msg_rate_limit_slot_take_summary(&rate_limit_slots[slot], &summaries[num_summaries++]);
+        }
+      g_static_mutex_unlock(&rate_limit_lock);
+
+      for (i = 0; i < num_summaries; i++)
+        msg_send_suppression_summary(&summaries[i]);
+    }
+}
+
 static gchar *
 msg_format_timestamp(gchar *buf, gsize buflen)
 {
@@ -283,8 +430,16 @@ msg_init(gboolean interactive)
 void
 msg_deinit(void)
 {
+  gint i;
+
   evt_ctx_free(evt_context);
   log_stderr = TRUE;
+
+  for (i = 0; i < MSG_RATE_LIMIT_SLOTS; i++)
+    {
+      g_free(rate_limit_slots[i].desc);
+      rate_limit_slots[i].desc = NULL;
+    }
 }
 
 static GOptionEntry msg_option_entries[] =
@@ -42,6 +42,8 @@ EVTREC *msg_event_create_from_desc(gint prio, const char *desc);
 void msg_event_free(EVTREC *e);
 void msg_event_send(EVTREC *e);
 void msg_event_suppress_recursions_and_send(EVTREC *e);
+gboolean msg_limit_rate(gint prio, const gchar *desc);
+void msg_flush_suppressed_messages(void);
 
 
 void msg_set_post_func(MsgPostFunc func);
@@ -53,10 +55,19 @@ void msg_add_option_group(GOptionContext *ctx);
 /* fatal->warning goes out to the console during startup, notice and below
  * comes goes to the log even during startup */
 #define msg_fatal(desc, tag1, tags...)    msg_event_suppress_recursions_and_send(msg_event_create(EVT_PRI_CRIT, desc, tag1, ##tags ))
-#define msg_error(desc, tag1, tags...)    msg_event_suppress_recursions_and_send(msg_event_create(EVT_PRI_ERR, desc, tag1, ##tags ))
-#define msg_warning(desc, tag1, tags...)  msg_event_suppress_recursions_and_send(msg_event_create(EVT_PRI_WARNING, desc, tag1, ##tags ))
-#define msg_notice(desc, tag1, tags...)   msg_event_suppress_recursions_and_send(msg_event_create(EVT_PRI_NOTICE, desc, tag1, ##tags ))
-#define msg_info(desc, tag1, tags...)     msg_event_suppress_recursions_and_send(msg_event_create(EVT_PRI_INFO, desc, tag1, ##tags ))
+#define msg_error(desc, tag1, tags...)    msg_send_rate_limited(EVT_PRI_ERR, desc, tag1, ##tags )
+#define msg_warning(desc, tag1, tags...)  msg_send_rate_limited(EVT_PRI_WARNING, desc, tag1, ##tags )
+#define msg_notice(desc, tag1, tags...)   msg_send_rate_limited(EVT_PRI_NOTICE, desc, tag1, ##tags )
+#define msg_info(desc, tag1, tags...)     msg_send_rate_limited(EVT_PRI_INFO, desc, tag1, ##tags )
+
+/* the tags are not even evaluated if the message is suppressed, see msg_limit_rate() */
+#define msg_send_rate_limited(prio, desc, tag1, tags...)                         \
+        ({                                                                        \
+          const gchar *__desc = (desc);                                           \
+          if (msg_limit_rate(prio, __desc))                                       \
+            msg_event_suppress_recursions_and_send(                               \
+                  msg_event_create(prio, __desc, tag1, ##tags ));                 \
+        })
 
 /* just like msg_info, but prepends the message with a timestamp -- useful in interactive
  * tools with long running time to provide some feedback */
@@ -32,6 +32,134 @@ ml_batched_timer_handle(MlBatchedTimer *self)
   self->handler(self->cookie);
 }
 
+/*
+ * Coarse timers
+ *
+ * With lots of writers (e.g. per-host file destinations), registering an
+ * ivykis timer for each of their mark/suppress timers puts a lot of churn on
+ * the ivykis timer heap.  Coarse timers only have a one second resolution
+ * (which is what postpone() uses anyway), and are kept on a single hashed
+ * timer wheel instead, driven by one ivykis timer that ticks every second
+ * while there are timers on the wheel.  Adding/removing a timer is O(1).
+ *
+ * The wheel is only touched from the main thread.
+ */
+#define ML_TIMER_WHEEL_SIZE 256
+
+static struct
+{
+  struct iv_list_head buckets[ML_TIMER_WHEEL_SIZE];
+  struct iv_timer tick;
+  /* the next second to be processed */
+  time_t next_sec;
+  gint num_timers;
+  gboolean initialized;
+} ml_timer_wheel;
+
+static void ml_timer_wheel_tick(gpointer s);
+
+static void
+ml_timer_wheel_init(void)
+{
+  gint i;
+
+  if (ml_timer_wheel.initialized)
+    return;
+
+  for (i = 0; i < ML_TIMER_WHEEL_SIZE; i++)
+    INIT_IV_LIST_HEAD(&ml_timer_wheel.buckets[i]);
+  IV_TIMER_INIT(&ml_timer_wheel.tick);
+  ml_timer_wheel.tick.handler = ml_timer_wheel_tick;
+  ml_timer_wheel.initialized = TRUE;
+}
+
+static void
+ml_timer_wheel_rearm(void)
+{
+  if (iv_timer_registered(&ml_timer_wheel.tick) || ml_timer_wheel.num_timers == 0)
+    return;
+
+  ml_timer_wheel.tick.expires.tv_sec = ml_timer_wheel.next_sec;
+  ml_timer_wheel.tick.expires.tv_nsec = 0;
+  iv_timer_register(&ml_timer_wheel.tick);
+}
+
+static void
+ml_timer_wheel_add(MlBatchedTimer *self)
+{
+  time_t slot;
+
+  ml_timer_wheel_init();
+  if (ml_timer_wheel.num_timers == 0)
+    {
+      iv_validate_now();
+      ml_timer_wheel.next_sec = iv_now.tv_sec;
+    }
+
+  /* timers already in the past fire at the next tick */
+  slot = MAX(self->expires.tv_sec, ml_timer_wheel.next_sec);
+  iv_list_add_tail(&self->wheel_list, &ml_timer_wheel.buckets[slot % ML_TIMER_WHEEL_SIZE]);
+  ml_timer_wheel.num_timers++;
+  ml_timer_wheel_rearm();
+}
+
+static void
+ml_timer_wheel_remove(MlBatchedTimer *self)
+{
+  if (iv_list_empty(&self->wheel_list))
+    return;
+
+  iv_list_del_init(&self->wheel_list);
+  ml_timer_wheel.num_timers--;
+  if (ml_timer_wheel.num_timers == 0 && iv_timer_registered(&ml_timer_wheel.tick))
+    iv_timer_unregister(&ml_timer_wheel.tick);
+}
+
+static void
+ml_timer_wheel_expire_bucket(struct iv_list_head *bucket, time_t now)
+{
+  struct iv_list_head expiring;
+  MlBatchedTimer *timer;
+
+  /* handlers may add/remove timers, including ones on @expiring */
+  INIT_IV_LIST_HEAD(&expiring);
+  iv_list_splice_tail_init(bucket, &expiring);
+  while (!iv_list_empty(&expiring))
+    {
+      timer = iv_list_entry(expiring.next, MlBatchedTimer, wheel_list);
+      iv_list_del_init(&timer->wheel_list);
+
+      if (timer->expires.tv_sec > now)
+        {
+          /* due in a later round */
+          iv_list_add_tail(&timer->wheel_list, bucket);
+          continue;
+        }
+      ml_timer_wheel.num_timers--;
+      timer->handler(timer->cookie);
+    }
+}
+
+static void
+ml_timer_wheel_tick(gpointer s)
+{
+  time_t now;
+
+  iv_validate_now();
+  now = iv_now.tv_sec;
+
+  /* after a long stall (or a clock jump) each bucket is processed once */
+  if (now - ml_timer_wheel.next_sec >= ML_TIMER_WHEEL_SIZE)
+    ml_timer_wheel.next_sec = now - ML_TIMER_WHEEL_SIZE + 1;
+
+  while (ml_timer_wheel.next_sec <= now)
+    {
+      ml_timer_wheel_expire_bucket(&ml_timer_wheel.buckets[ml_timer_wheel.next_sec % ML_TIMER_WHEEL_SIZE], now);
+      ml_timer_wheel.next_sec++;
+    }
+  ml_timer_wheel_rearm();
+}
+
 /* function called using main_loop_call() in case the suppress timer needs
  * to be updated.  It is running in the main thread, thus is able to
  * reregister our ivykis timer */
@@ -40,6 +168,15 @@ ml_batched_timer_perform_update(MlBatchedTimer *self)
 {
   main_loop_assert_main_thread();
 
+  if (self->coarse)
+    {
+      ml_timer_wheel_remove(self);
+      if (self->expires.tv_sec > 0)
+        ml_timer_wheel_add(self);
+      self->unref_cookie(self->cookie);
+      return;
+    }
+
   if (iv_timer_registered(&self->timer))
     iv_timer_unregister(&self->timer);
 
@@ -126,6 +263,25 @@ ml_batched_timer_postpone(MlBatchedTimer *self, glong sec)
   ml_batched_timer_update(self, &next_expires);
 }
 
+/* Same as ml_batched_timer_postpone(), but with microsecond resolution,
+ * which means that updates are batched less effectively. */
+void
+ml_batched_timer_postpone_usec(MlBatchedTimer *self, glong usec)
+{
+  struct timespec next_expires;
+
+  iv_validate_now();
+
+  next_expires.tv_sec = iv_now.tv_sec + usec / 1000000;
+  next_expires.tv_nsec = iv_now.tv_nsec + (usec % 1000000) * 1000;
+  if (next_expires.tv_nsec >= 1000000000)
+    {
+      next_expires.tv_sec++;
+      next_expires.tv_nsec -= 1000000000;
+    }
+  ml_batched_timer_update(self, &next_expires);
+}
+
 /* cancel the timer for the time being. Can be invoked from any threads. */
 void
 ml_batched_timer_cancel(MlBatchedTimer *self)
@@ -143,6 +299,7 @@ ml_batched_timer_unregister(MlBatchedTimer *self)
 {
   main_loop_assert_main_thread();
 
+  ml_timer_wheel_remove(self);
   if (iv_timer_registered(&self->timer))
     iv_timer_unregister(&self->timer);
   self->expires.tv_sec = 0;
@@ -157,6 +314,7 @@ ml_batched_timer_init(MlBatchedTimer *self)
   IV_TIMER_INIT(&self->timer);
   self->timer.cookie = self;
   self->timer.handler = (void (*)(void *)) ml_batched_timer_handle;
+  INIT_IV_LIST_HEAD(&self->wheel_list);
 }
 
 /* Free MlBatchedTimer state. */
@@ -27,6 +27,7 @@
 
 #include "mainloop.h"
 #include <iv.h>
+#include <iv_list.h>
 
 
 /* timer which only updates */
@@ -34,6 +35,10 @@ typedef struct _MlBatchedTimer
 {
   GStaticMutex lock;
   struct iv_timer timer;
+  /* use the shared, one-second resolution timer wheel instead of a
+   * private ivykis timer, can only be used with ml_batched_timer_postpone() */
+  gboolean coarse;
+  struct iv_list_head wheel_list;
   struct timespec expires;
   gpointer cookie;
   void *(*ref_cookie)(gpointer self);
@@ -42,6 +47,7 @@ typedef struct _MlBatchedTimer
 } MlBatchedTimer;
 
 void ml_batched_timer_postpone(MlBatchedTimer *self, glong sec);
+void ml_batched_timer_postpone_usec(MlBatchedTimer *self, glong usec);
 void ml_batched_timer_cancel(MlBatchedTimer *self);
 
 void ml_batched_timer_unregister(MlBatchedTimer *self);
@@ -53,6 +53,8 @@ enum
   LP_EXPECT_HOSTNAME = 0x0100,
   /* message is locally generated and should be marked with LF_LOCAL */
   LP_LOCAL = 0x0200,
+  /* keep the unparsed message in RAWMSG and reference it from parsed fields where possible */
+  LP_STORE_RAW_MESSAGE = 0x0400,
 };
 
 typedef struct _MsgFormatHandler MsgFormatHandler;
@@ -25,6 +25,7 @@
 #include "parser/parser-expr.h"
 #include "template/templates.h"
 #include "logmatcher.h"
+#include "stats/stats-trace.h"
 
 #include <string.h>
 
@@ -36,10 +37,11 @@ log_parser_set_template(LogParser *self, LogTemplate *template)
   self->template = template;
 }
 
-static void
-log_parser_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options, gpointer user_data)
+static gboolean
+log_parser_stage(LogPipe *s, LogMessage **pmsg, const LogPathOptions *path_options)
 {
   LogParser *self = (LogParser *) s;
+  LogMessage *msg = *pmsg;
   gboolean success;
 
   if (G_LIKELY(!self->template))
@@ -75,15 +77,9 @@ log_parser_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options
             log_pipe_location_tag(s),
             NULL);
   if (success)
-    {
-      log_pipe_forward_msg(s, msg, path_options);
-    }
-  else
-    {
-      if (path_options->matched)
-        (*path_options->matched) = FALSE;
-      log_msg_drop(msg, path_options, AT_PROCESSED);
-    }
+    stats_trace_message_parsed(msg);
+  *pmsg = msg;
+  return success;
 }
 
 gboolean
@@ -113,5 +109,7 @@ log_parser_init_instance(LogParser *self, GlobalConfig *cfg)
   log_pipe_init_instance(&self->super, cfg);
   self->super.init = log_parser_init_method;
   self->super.free_fn = log_parser_free_method;
-  self->super.queue = log_parser_queue;
+  self->super.queue = log_pipe_stage_queue_method;
+  self->super.queue_batch = log_pipe_stage_queue_batch_method;
+  self->super.stage = log_parser_stage;
 }
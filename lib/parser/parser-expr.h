@@ -54,4 +54,18 @@ log_parser_process(LogParser *self, LogMessage **pmsg, const LogPathOptions *pat
   return self->process(self, pmsg, path_options, input, input_len);
 }
 
+/* stores a parsed value, unless nothing in the configuration reads it */
+static inline void
+log_parser_set_value(LogParser *self, LogMessage *msg, NVHandle handle, const gchar *value, gssize value_len)
+{
+  if (cfg_is_value_referenced(log_pipe_get_config(&self->super), handle))
+    log_msg_set_value(msg, handle, value, value_len);
+}
+
+static inline void
+log_parser_set_value_by_name(LogParser *self, LogMessage *msg, const gchar *name, const gchar *value, gssize value_len)
+{
+  log_parser_set_value(self, msg, log_msg_get_value_handle(name), value, value_len);
+}
+
 #endif
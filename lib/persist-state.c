@@ -26,6 +26,7 @@
 #include "serialize.h"
 #include "messages.h"
 #include "fdhelpers.h"
+#include "timeutils.h"
 
 #include <sys/types.h>
 #include <unistd.h>
@@ -33,6 +34,7 @@
 #include <sys/mman.h>
 #include <errno.h>
 #include <string.h>
+#include <iv.h>
 
 typedef struct _PersistFileHeader
 {
@@ -59,6 +61,9 @@ typedef struct _PersistFileHeader
 
 #define PERSIST_FILE_INITIAL_SIZE 16384
 #define PERSIST_STATE_KEY_BLOCK_SIZE 4096
+/* the file is grown geometrically up to this size, linearly above it */
+#define PERSIST_FILE_MAX_GROW_STEP (64 * 1024 * 1024)
+#define PERSIST_FILE_MAX_SIZE ((1LL << 31) - 1)
 
 /*
  * The syslog-ng persistent state is a set of name-value pairs,
@@ -116,6 +121,16 @@ typedef struct _PersistFileHeader
  * This way unused entries in the persist file are reaped when
  * syslog-ng restarts.
  *
+ * Syncing:
+ * --------
+ *
+ * Values are updated in place through the shared mapping, so the
+ * kernel writes them back on its own and a crashing syslog-ng loses
+ * nothing.  To bound what a power loss may lose, persist_state_set_sync_freq()
+ * can be used to msync() the whole mapping periodically from the main
+ * thread, which writes all entries changed since the previous sync in
+ * one batch.
+ *
  * Trusts:
  * -------
  *
@@ -146,6 +161,9 @@ struct _PersistState
   PersistEntryHandle current_key_block;
   gint current_key_ofs;
   gint current_key_size;
+
+  struct iv_timer sync_timer;
+  gint sync_freq;
 };
 
 typedef struct _PersistEntry
@@ -181,6 +199,16 @@ _grow_store(PersistState *self, guint32 new_size)
 
   _wait_until_map_release(self);
 
+  /* grow geometrically, otherwise loading a large file would remap it
+   * once for every page it occupies */
+  if (self->current_size && new_size > self->current_size)
+    {
+      guint32 step = MIN(self->current_size, PERSIST_FILE_MAX_GROW_STEP);
+
+      if (new_size < self->current_size + step && self->current_size + (gint64) step <= PERSIST_FILE_MAX_SIZE)
+        new_size = self->current_size + step;
+    }
+
   if ((new_size & (pgsize-1)) != 0)
     {
       new_size = ((new_size / pgsize) + 1) * pgsize;
@@ -926,6 +954,62 @@ persist_state_commit(PersistState *self)
   return TRUE;
 }
 
+/*
+ * Flushes all entries changed since the previous sync to disk.
+ *
+ * NOTE: must be called from the main thread, the only one that is
+ * allowed to remap the file.
+ */
+gboolean
+persist_state_sync(PersistState *self)
+{
+  if (!self->current_map)
+    return TRUE;
+
+  if (msync(self->current_map, self->current_size, MS_SYNC) < 0)
+    {
+      msg_error("Error syncing persistent state file",
+                evt_tag_str("filename", self->commited_filename),
+                evt_tag_errno("error", errno),
+                NULL);
+      return FALSE;
+    }
+  return TRUE;
+}
+
+static void
+_sync_timer_rearm(PersistState *self)
+{
+  iv_validate_now();
+  self->sync_timer.expires = iv_now;
+  timespec_add_msec(&self->sync_timer.expires, self->sync_freq * 1000);
+  iv_timer_register(&self->sync_timer);
+}
+
+static void
+_sync_timer_elapsed(gpointer s)
+{
+  PersistState *self = (PersistState *) s;
+
+  persist_state_sync(self);
+  _sync_timer_rearm(self);
+}
+
+/*
+ * Sets how often (in seconds) the state is synced to disk, 0 disables
+ * periodic syncing.  Requires a running main loop.
+ */
+void
+persist_state_set_sync_freq(PersistState *self, gint sync_freq)
+{
+  if (iv_timer_registered(&self->sync_timer))
+    iv_timer_unregister(&self->sync_timer);
+
+  self->sync_freq = sync_freq;
+  if (self->sync_freq > 0)
+    _sync_timer_rearm(self);
+}
+
 static void
 _destroy(PersistState *self)
 {
@@ -933,6 +1017,8 @@ _destroy(PersistState *self)
   g_assert(self->mapped_counter == 0);
   g_mutex_unlock(self->mapped_lock);
 
+  if (iv_timer_registered(&self->sync_timer))
+    iv_timer_unregister(&self->sync_timer);
   if (self->fd >= 0)
     close(self->fd);
   if (self->current_map)
@@ -957,6 +1043,10 @@ _init(PersistState* self, gchar* commited_filename, gchar* temp_filename)
   self->fd = -1;
   self->commited_filename = commited_filename;
   self->temp_filename = temp_filename;
+
+  IV_TIMER_INIT(&self->sync_timer);
+  self->sync_timer.handler = _sync_timer_elapsed;
+  self->sync_timer.cookie = self;
 }
 
 /*
@@ -53,6 +53,8 @@ gboolean persist_state_start_dump(PersistState *self);
 const gchar *persist_state_get_filename(PersistState *self);
 
 gboolean persist_state_commit(PersistState *self);
+gboolean persist_state_sync(PersistState *self);
+void persist_state_set_sync_freq(PersistState *self, gint sync_freq);
 void persist_state_cancel(PersistState *self);
 
 PersistState *persist_state_new(const gchar *filename);
@@ -32,6 +32,8 @@
 
 #include <gmodule.h>
 #include <string.h>
+#include <stdlib.h>
+#include <sys/stat.h>
 
 #ifdef _AIX
 #define G_MODULE_SUFFIX "a"
@@ -394,6 +396,175 @@ plugin_load_module(const gchar *module_name, GlobalConfig *cfg, CfgArgs *args)
   return result;
 }
 
+/*
+ * Plugin index cache
+ *
+ * Discovering candidate plugins requires dlopen()ing each module in the
+ * module path, which is slow and pulls in every library the modules link
+ * against.  The results are kept in a GKeyFile, one group per module
+ * file, keyed by the file's mtime and size, both in memory for reloads
+ * and on disk (plugin-cache) for subsequent startups.  Modules are only
+ * loaded once one of their plugins is referenced, see plugin_find().
+ */
+
+#define PLUGIN_CACHE_GROUP "syslog-ng"
+
+static GKeyFile *plugin_cache;
+static gboolean plugin_cache_dirty;
+
+static void
+plugin_cache_load(void)
+{
+  const gchar *filename = resolvedConfigurablePaths.plugin_cache_file;
+  gchar *version;
+
+  if (plugin_cache)
+    return;
+
+  plugin_cache = g_key_file_new();
+  if (!filename || !filename[0] ||
+      !g_key_file_load_from_file(plugin_cache, filename, G_KEY_FILE_NONE, NULL))
+    return;
+
+  /* plugin types are only meaningful for the same binary */
+  version = g_key_file_get_string(plugin_cache, PLUGIN_CACHE_GROUP, "version", NULL);
+  if (!version || strcmp(version, SYSLOG_NG_VERSION) != 0)
+    {
+      g_key_file_free(plugin_cache);
+      plugin_cache = g_key_file_new();
+    }
+  g_free(version);
+}
+
+static void
+plugin_cache_save(void)
+{
+  const gchar *filename = resolvedConfigurablePaths.plugin_cache_file;
+  GError *error = NULL;
+  gchar *data;
+  gsize len;
+
+  if (!plugin_cache_dirty || !filename || !filename[0])
+    return;
+
+  g_key_file_set_string(plugin_cache, PLUGIN_CACHE_GROUP, "version", SYSLOG_NG_VERSION);
+  data = g_key_file_to_data(plugin_cache, &len, NULL);
+  if (!g_file_set_contents(filename, data, len, &error))
+    {
+      msg_debug("Error saving plugin cache",
+                evt_tag_str("filename", filename),
+                evt_tag_str("error", error->message),
+                NULL);
+      g_clear_error(&error);
+    }
+  else
+    plugin_cache_dirty = FALSE;
+  g_free(data);
+}
+
+static gint64
+plugin_cache_get_int64(const gchar *group, const gchar *key)
+{
+  gchar *value;
+  gint64 result = -1;
+
+  value = g_key_file_get_value(plugin_cache, group, key, NULL);
+  if (value)
+    result = g_ascii_strtoll(value, NULL, 10);
+  g_free(value);
+  return result;
+}
+
+static void
+plugin_cache_set_int64(const gchar *group, const gchar *key, gint64 value)
+{
+  gchar buf[32];
+
+  g_snprintf(buf, sizeof(buf), "%" G_GINT64_FORMAT, value);
+  g_key_file_set_value(plugin_cache, group, key, buf);
+}
+
+static gboolean
+plugin_cache_is_entry_valid(const gchar *filename, struct stat *st)
+{
+  return g_key_file_has_group(plugin_cache, filename) &&
+         plugin_cache_get_int64(filename, "mtime") == (gint64) st->st_mtime &&
+         plugin_cache_get_int64(filename, "size") == (gint64) st->st_size;
+}
+
+static void
+plugin_cache_store_entry(const gchar *filename, struct stat *st, ModuleInfo *module_info)
+{
+  gchar **plugins;
+  gint i;
+
+  g_key_file_remove_group(plugin_cache, filename, NULL);
+  plugin_cache_set_int64(filename, "mtime", st->st_mtime);
+  plugin_cache_set_int64(filename, "size", st->st_size);
+
+  /* shared objects that are not syslog-ng modules are recorded with no plugins */
+  if (module_info)
+    {
+      plugins = g_new0(gchar *, module_info->plugins_len + 1);
+      for (i = 0; i < module_info->plugins_len; i++)
+        plugins[i] = g_strdup_printf("%d:%s", module_info->plugins[i].type, module_info->plugins[i].name);
+      g_key_file_set_integer(plugin_cache, filename, "preference", module_info->preference);
+      g_key_file_set_string_list(plugin_cache, filename, "plugins", (const gchar * const *) plugins, module_info->plugins_len);
+      g_strfreev(plugins);
+    }
+  plugin_cache_dirty = TRUE;
+}
+
+static void
+plugin_register_candidate(GlobalConfig *cfg, gint plugin_type, const gchar *plugin_name, const gchar *module_name, gint preference)
+{
+  PluginCandidate *candidate_plugin;
+
+  candidate_plugin = (PluginCandidate *) plugin_find_in_list(cfg, cfg->candidate_plugins, plugin_type, plugin_name);
+
+  msg_debug("Registering candidate plugin",
+            evt_tag_str("module", module_name),
+            evt_tag_str("context", cfg_lexer_lookup_context_name_by_type(plugin_type)),
+            evt_tag_str("name", plugin_name),
+            evt_tag_int("preference", preference),
+            NULL);
+  if (candidate_plugin)
+    {
+      if (candidate_plugin->preference < preference)
+        {
+          plugin_candidate_set_module_name(candidate_plugin, module_name);
+          plugin_candidate_set_preference(candidate_plugin, preference);
+        }
+    }
+  else
+    {
+      cfg->candidate_plugins = g_list_prepend(cfg->candidate_plugins, plugin_candidate_new(plugin_type, plugin_name, module_name, preference));
+    }
+}
+
+static void
+plugin_register_candidates_from_cache(GlobalConfig *cfg, const gchar *filename, const gchar *module_name)
+{
+  gchar **plugins;
+  gint preference;
+  gint i;
+
+  plugins = g_key_file_get_string_list(plugin_cache, filename, "plugins", NULL, NULL);
+  if (!plugins)
+    return;
+
+  preference = g_key_file_get_integer(plugin_cache, filename, "preference", NULL);
+  for (i = 0; plugins[i]; i++)
+    {
+      gchar *name = strchr(plugins[i], ':');
+
+      if (!name)
+        continue;
+      plugin_register_candidate(cfg, atoi(plugins[i]), name + 1, module_name, preference);
+    }
+  g_strfreev(plugins);
+}
+
 void
 plugin_load_candidate_modules(GlobalConfig *cfg)
 {
@@ -401,11 +572,13 @@ plugin_load_candidate_modules(GlobalConfig *cfg)
   gchar **mod_paths;
   gint i, j;
 
+  plugin_cache_load();
+
   mod_paths = g_strsplit(resolvedConfigurablePaths.initial_module_path ? : "", G_SEARCHPATH_SEPARATOR_S, 0);
   for (i = 0; mod_paths[i]; i++)
     {
       GDir *dir;
-      const gchar *fname;
+      const gchar *fname, *fname_full;
 
       msg_debug("Reading path for candidate modules",
                 evt_tag_str("path", mod_paths[i]),
@@ -417,9 +590,11 @@ plugin_load_candidate_modules(GlobalConfig *cfg)
         {
           if (g_str_has_suffix(fname, G_MODULE_SUFFIX))
             {
-              gchar *module_name;
+              gchar *module_name, *filename;
               ModuleInfo *module_info;
+              struct stat st;
 
+              fname_full = fname;
               if (g_str_has_prefix(fname, "lib"))
                 fname += 3;
               module_name = g_strndup(fname, (gint) (strlen(fname) - strlen(G_MODULE_SUFFIX) - 1));
@@ -429,6 +604,15 @@ plugin_load_candidate_modules(GlobalConfig *cfg)
                         evt_tag_str("fname", fname),
                         evt_tag_str("module", module_name),
                         NULL);
+              filename = g_build_filename(mod_paths[i], fname_full, NULL);
+              if (stat(filename, &st) == 0 && plugin_cache_is_entry_valid(filename, &st))
+                {
+                  plugin_register_candidates_from_cache(cfg, filename, module_name);
+                  g_free(filename);
+                  g_free(module_name);
+                  continue;
+                }
+
               mod = plugin_dlopen_module(module_name, resolvedConfigurablePaths.initial_module_path);
               module_info = plugin_get_module_info(mod);
 
@@ -437,40 +621,23 @@ plugin_load_candidate_modules(GlobalConfig *cfg)
                   for (j = 0; j < module_info->plugins_len; j++)
                     {
                       Plugin *plugin = &module_info->plugins[j];
-                      PluginCandidate *candidate_plugin;
 
-                      candidate_plugin = (PluginCandidate *) plugin_find_in_list(cfg, cfg->candidate_plugins, plugin->type, plugin->name);
-
-                      msg_debug("Registering candidate plugin",
-                                evt_tag_str("module", module_name),
-                                evt_tag_str("context", cfg_lexer_lookup_context_name_by_type(plugin->type)),
-                                evt_tag_str("name", plugin->name),
-                                evt_tag_int("preference", module_info->preference),
-                                NULL);
-                      if (candidate_plugin)
-                        {
-                          if (candidate_plugin->preference < module_info->preference)
-                            {
-                              plugin_candidate_set_module_name(candidate_plugin, module_name);
-                              plugin_candidate_set_preference(candidate_plugin, module_info->preference);
-                            }
-                        }
-                      else
-                        {
-                          cfg->candidate_plugins = g_list_prepend(cfg->candidate_plugins, plugin_candidate_new(plugin->type, plugin->name, module_name, module_info->preference));
-                        }
+                      plugin_register_candidate(cfg, plugin->type, plugin->name, module_name, module_info->preference);
                     }
                 }
+              /* failing to dlopen() may be temporary, e.g. a missing dependency */
+              if (mod && stat(filename, &st) == 0)
+                plugin_cache_store_entry(filename, &st, module_info);
+              g_free(filename);
               g_free(module_name);
               if (mod)
                 g_module_close(mod);
-              else
-                mod = NULL;
             }
         }
       g_dir_close(dir);
     }
   g_strfreev(mod_paths);
+  plugin_cache_save();
 }
 
 void
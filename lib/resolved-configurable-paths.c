@@ -34,4 +34,5 @@ resolved_configurable_paths_init(ResolvedConfigurablePaths *self)
   resolvedConfigurablePaths.persist_file = get_installation_path_for(PATH_PERSIST_CONFIG);
   resolvedConfigurablePaths.ctlfilename = get_installation_path_for(PATH_CONTROL_SOCKET);
   resolvedConfigurablePaths.initial_module_path = get_installation_path_for(SYSLOG_NG_MODULE_PATH);
+  resolvedConfigurablePaths.plugin_cache_file = get_installation_path_for(PATH_PLUGIN_CACHE);
 }
@@ -32,10 +32,11 @@ log_rewrite_set_condition(LogRewrite *self, FilterExprNode *condition)
   self->condition = condition;
 }
 
-static void
-log_rewrite_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options, gpointer user_data)
+static gboolean
+log_rewrite_stage(LogPipe *s, LogMessage **pmsg, const LogPathOptions *path_options)
 {
   LogRewrite *self = (LogRewrite *) s;
+  LogMessage *msg = *pmsg;
   gssize length;
   const gchar *value;
 
@@ -59,7 +60,8 @@ log_rewrite_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_option
                 log_pipe_location_tag(s),
                 NULL);
     }
-  log_pipe_forward_msg(s, msg, path_options);
+  *pmsg = msg;
+  return TRUE;
 }
 
 gboolean
@@ -93,7 +95,9 @@ log_rewrite_init_instance(LogRewrite *self, GlobalConfig *cfg)
   log_pipe_init_instance(&self->super, cfg);
   /* indicate that the rewrite rule is changing the message */
   self->super.free_fn = log_rewrite_free_method;
-  self->super.queue = log_rewrite_queue;
+  self->super.queue = log_pipe_stage_queue_method;
+  self->super.queue_batch = log_pipe_stage_queue_batch_method;
+  self->super.stage = log_rewrite_stage;
   self->super.init = log_rewrite_init_method;
   self->value_handle = LM_V_MESSAGE;
 }
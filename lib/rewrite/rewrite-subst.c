@@ -57,6 +57,12 @@ log_rewrite_subst_process(LogRewrite *s, LogMessage **pmsg, const LogPathOptions
 
   value = log_msg_get_value(*pmsg, self->super.value_handle, &length);
 
+  /* don't clone a shared message only to find that there's nothing to
+   * replace, unless matching itself would store the matches */
+  if (log_msg_is_write_protected(*pmsg) && (self->matcher->flags & LMF_STORE_MATCHES) == 0 &&
+      !log_matcher_match(self->matcher, *pmsg, self->super.value_handle, value, length))
+    return;
+
   log_msg_make_writable(pmsg, path_options);
   new_value = log_matcher_replace(self->matcher, *pmsg, self->super.value_handle, value, length, self->replacement, &new_length);
   if (new_value)
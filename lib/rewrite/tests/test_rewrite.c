@@ -186,6 +186,32 @@ void test_subst_field_exist_and_substring_substituted_when_regexp_matched()
   rewrite_teardown(msg);
 }
 
+void test_subst_does_not_clone_write_protected_message_without_match()
+{
+  LogRewrite *test_rewrite = create_rewrite_rule("subst(\"substring\" \"substitute\" value(\"field1\") type(string) flags(substring));");
+  LogMessage *msg = create_message_with_fields("field1", "nothing to replace here", NULL);
+  LogMessage *processed = log_msg_ref(msg);
+  LogPathOptions po = LOG_PATH_OPTIONS_INIT;
+
+  log_msg_write_protect(msg);
+  test_rewrite->process(test_rewrite, &processed, &po);
+  assert_gpointer(processed, msg, ASSERTION_ERROR("Message was cloned even though nothing matched"));
+  log_msg_unref(processed);
+  log_msg_write_unprotect(msg);
+
+  log_msg_set_value(msg, log_msg_get_value_handle("field1"), "a substring", -1);
+  processed = log_msg_ref(msg);
+  log_msg_write_protect(msg);
+  test_rewrite->process(test_rewrite, &processed, &po);
+  assert_false(processed == msg, ASSERTION_ERROR("Write protected message was not cloned before substitution"));
+  assert_msg_field_equals(processed, "field1", "a substitute", -1, ASSERTION_ERROR("Couldn't subst message field"));
+  assert_msg_field_equals(msg, "field1", "a substring", -1, ASSERTION_ERROR("Write protected message was changed"));
+  log_msg_unref(processed);
+  log_msg_write_unprotect(msg);
+
+  rewrite_teardown(msg);
+}
+
 void test_set_field_exist_and_group_set_literal_string()
 {
   LogRewrite *test_rewrite = create_rewrite_rule("groupset(\"value\" values(\"field1\") );");
@@ -302,6 +328,7 @@ main(int argc, char **argv)
   test_subst_field_exist_and_substring_substituted_only_once_without_global();
   test_subst_field_exist_and_substring_substituted_every_occurence_with_global();
   test_subst_field_exist_and_substring_substituted_when_regexp_matched();
+  test_subst_does_not_clone_write_protected_message_without_match();
   test_set_field_honors_time_zone();
   test_set_field_exist_and_group_set_literal_string();
   test_set_field_exist_and_group_set_multiple_fields_with_glob_pattern_literal_string();
@@ -25,15 +25,42 @@
 #include "tls-support.h"
 #include "scratch-buffers.h"
 #include "str-utils.h"
+#include "memprof.h"
+
+#include <iv.h>
+
+typedef struct _ScratchArenaChunk ScratchArenaChunk;
 
 TLS_BLOCK_START
 {
   GTrashStack *sb_gstrings;
   GTrashStack *sb_th_gstrings;
+  GTrashStack *sb_gstring_arrays;
   GList *sb_registry;
+  GPtrArray *sa_gstrings;
+  guint sa_gstrings_used;
+  ScratchArenaChunk *sa_chunks;
+  gboolean sa_dirty;
+  struct iv_task sa_reset_task;
 }
 TLS_BLOCK_END;
 
+/*
+ * Scratch buffers grow as needed and keep their size when they are put
+ * back, the allocation profiler is told about the buffer whenever it has
+ * grown during a use, so the stack recorded is the one that grew it.
+ */
+static inline void
+_profile_growth(gpointer sb, GString *s, gsize *profiled_len)
+{
+  if (s->allocated_len == *profiled_len)
+    return;
+
+  memprof_record_free(sb);
+  memprof_record_alloc(sb, s->allocated_len);
+  *profiled_len = s->allocated_len;
+}
+
 /* GStrings */
 
 #define local_sb_gstrings        __tls_deref(sb_gstrings)
@@ -48,6 +75,7 @@ sb_gstring_acquire_buffer(void)
     {
       sb = g_new(SBGString, 1);
       g_string_steal(sb_gstring_string(sb));
+      sb->profiled_len = 0;
     }
   else
     g_string_set_size(sb_gstring_string(sb), 0);
@@ -60,6 +88,7 @@ sb_gstring_release_buffer(GTrashStack *s)
 {
   SBGString *sb = (SBGString *) s;
 
+  _profile_growth(sb, sb_gstring_string(sb), &sb->profiled_len);
   g_trash_stack_push(&local_sb_gstrings, sb);
 }
 
@@ -70,6 +99,7 @@ sb_gstring_free_stack(void)
 
   while ((sb = g_trash_stack_pop(&local_sb_gstrings)) != NULL)
     {
+      memprof_record_free(sb);
       g_free(sb_gstring_string(sb)->str);
       g_free(sb);
     }
@@ -95,6 +125,7 @@ sb_th_gstring_acquire_buffer (void)
     {
       sb = g_new(SBTHGString, 1);
       g_string_steal(sb_th_gstring_string(sb));
+      sb->profiled_len = 0;
       sb->type_hint = TYPE_HINT_STRING;
     }
   else
@@ -106,6 +137,9 @@ sb_th_gstring_acquire_buffer (void)
 void
 sb_th_gstring_release_buffer(GTrashStack *s)
 {
+  SBTHGString *sb = (SBTHGString *) s;
+
+  _profile_growth(sb, sb_th_gstring_string(sb), &sb->profiled_len);
   g_trash_stack_push(&local_sb_th_gstrings, s);
 }
 
@@ -116,6 +150,7 @@ sb_th_gstring_free_stack(void)
 
   while ((sb = g_trash_stack_pop(&local_sb_th_gstrings)) != NULL)
     {
+      memprof_record_free(sb);
       g_free(sb_gstring_string(sb)->str);
       g_free(sb);
     }
@@ -127,6 +162,243 @@ ScratchBufferStack SBTHGStringStack = {
   .free_stack = sb_th_gstring_free_stack
 };
 
+/* Arrays of GStrings */
+
+#define local_sb_gstring_arrays        __tls_deref(sb_gstring_arrays)
+
+GTrashStack *
+sb_gstring_array_acquire_buffer(void)
+{
+  SBGStringArray *sb;
+
+  sb = g_trash_stack_pop(&local_sb_gstring_arrays);
+  if (!sb)
+    {
+      sb = g_new(SBGStringArray, 1);
+      sb->strings = g_ptr_array_sized_new(0);
+    }
+
+  return (GTrashStack *) sb;
+}
+
+void
+sb_gstring_array_release_buffer(GTrashStack *s)
+{
+  g_trash_stack_push(&local_sb_gstring_arrays, s);
+}
+
+void
+sb_gstring_array_free_stack(void)
+{
+  SBGStringArray *sb;
+  gint i;
+
+  while ((sb = g_trash_stack_pop(&local_sb_gstring_arrays)) != NULL)
+    {
+      for (i = 0; i < sb->strings->len; i++)
+        g_string_free(g_ptr_array_index(sb->strings, i), TRUE);
+      g_ptr_array_free(sb->strings, TRUE);
+      g_free(sb);
+    }
+}
+
+ScratchBufferStack SBGStringArrayStack = {
+  .acquire_buffer = sb_gstring_array_acquire_buffer,
+  .release_buffer = sb_gstring_array_release_buffer,
+  .free_stack = sb_gstring_array_free_stack
+};
+
+/* Scratch arena */
+
+#define local_sa_gstrings        __tls_deref(sa_gstrings)
+#define local_sa_gstrings_used   __tls_deref(sa_gstrings_used)
+#define local_sa_chunks          __tls_deref(sa_chunks)
+#define local_sa_dirty           __tls_deref(sa_dirty)
+#define local_sa_reset_task      __tls_deref(sa_reset_task)
+
+#define SCRATCH_ARENA_CHUNK_SIZE       16384
+/* GStrings that grew larger than this are not kept across resets */
+#define SCRATCH_ARENA_MAX_GSTRING_SIZE 65536
+
+struct _ScratchArenaChunk
+{
+  ScratchArenaChunk *next;
+  gsize size;
+  gsize used;
+};
+
+static inline gchar *
+_chunk_data(ScratchArenaChunk *chunk)
+{
+  return (gchar *) (chunk + 1);
+}
+
+static ScratchArenaChunk *
+_chunk_new(gsize size)
+{
+  ScratchArenaChunk *chunk = g_malloc(sizeof(ScratchArenaChunk) + size);
+
+  chunk->next = NULL;
+  chunk->size = size;
+  chunk->used = 0;
+  return chunk;
+}
+
+static void
+_arena_reset_task(gpointer user_data)
+{
+  scratch_arena_reset();
+}
+
+/* the first use after a reset schedules the next reset in threads running
+ * an ivykis loop, for the case they don't invoke batch callbacks */
+static inline void
+_arena_touch(void)
+{
+  if (local_sa_dirty)
+    return;
+
+  local_sa_dirty = TRUE;
+  if (iv_inited())
+    {
+      if (local_sa_reset_task.handler == NULL)
+        {
+          IV_TASK_INIT(&local_sa_reset_task);
+          local_sa_reset_task.handler = _arena_reset_task;
+        }
+      if (!iv_task_registered(&local_sa_reset_task))
+        iv_task_register(&local_sa_reset_task);
+    }
+}
+
+GString *
+scratch_arena_gstring(void)
+{
+  GString *s;
+
+  _arena_touch();
+  if (!local_sa_gstrings)
+    local_sa_gstrings = g_ptr_array_new();
+
+  if (local_sa_gstrings_used == local_sa_gstrings->len)
+    g_ptr_array_add(local_sa_gstrings, g_string_sized_new(256));
+
+  s = (GString *) g_ptr_array_index(local_sa_gstrings, local_sa_gstrings_used);
+  local_sa_gstrings_used++;
+  g_string_truncate(s, 0);
+  return s;
+}
+
+/* returns @size bytes, aligned for any basic type */
+gpointer
+scratch_arena_alloc(gsize size)
+{
+  ScratchArenaChunk *chunk = local_sa_chunks;
+  gpointer result;
+
+  _arena_touch();
+  size = (size + sizeof(gdouble) - 1) & ~(sizeof(gdouble) - 1);
+
+  if (size > SCRATCH_ARENA_CHUNK_SIZE / 4)
+    {
+      /* large slices get their own chunk, queued behind the current one,
+       * so that the rest of the current one can still be used */
+      ScratchArenaChunk *large = _chunk_new(size);
+
+      large->used = size;
+      if (chunk)
+        {
+          large->next = chunk->next;
+          chunk->next = large;
+        }
+      else
+        {
+          local_sa_chunks = large;
+        }
+      return _chunk_data(large);
+    }
+
+  if (!chunk || chunk->size - chunk->used < size)
+    {
+      chunk = _chunk_new(SCRATCH_ARENA_CHUNK_SIZE);
+      chunk->next = local_sa_chunks;
+      local_sa_chunks = chunk;
+    }
+
+  result = _chunk_data(chunk) + chunk->used;
+  chunk->used += size;
+  return result;
+}
+
+static void
+_arena_free_chunks(ScratchArenaChunk *chunk)
+{
+  while (chunk)
+    {
+      ScratchArenaChunk *next = chunk->next;
+
+      g_free(chunk);
+      chunk = next;
+    }
+}
+
+void
+scratch_arena_reset(void)
+{
+  ScratchArenaChunk *keep = NULL;
+  gint i;
+
+  if (!local_sa_dirty)
+    return;
+  local_sa_dirty = FALSE;
+  if (local_sa_reset_task.handler && iv_task_registered(&local_sa_reset_task))
+    iv_task_unregister(&local_sa_reset_task);
+
+  for (i = 0; i < local_sa_gstrings_used; i++)
+    {
+      GString *s = (GString *) g_ptr_array_index(local_sa_gstrings, i);
+
+      if (s->allocated_len > SCRATCH_ARENA_MAX_GSTRING_SIZE)
+        {
+          g_string_free(s, TRUE);
+          g_ptr_array_index(local_sa_gstrings, i) = g_string_sized_new(256);
+        }
+    }
+  local_sa_gstrings_used = 0;
+
+  /* keep a single regular sized chunk around for the next batch */
+  if (local_sa_chunks && local_sa_chunks->size == SCRATCH_ARENA_CHUNK_SIZE)
+    {
+      keep = local_sa_chunks;
+      local_sa_chunks = keep->next;
+      keep->next = NULL;
+      keep->used = 0;
+    }
+  _arena_free_chunks(local_sa_chunks);
+  local_sa_chunks = keep;
+}
+
+static void
+scratch_arena_free(void)
+{
+  gint i;
+
+  if (local_sa_reset_task.handler && iv_task_registered(&local_sa_reset_task))
+    iv_task_unregister(&local_sa_reset_task);
+  local_sa_dirty = FALSE;
+
+  if (local_sa_gstrings)
+    {
+      for (i = 0; i < local_sa_gstrings->len; i++)
+        g_string_free(g_ptr_array_index(local_sa_gstrings, i), TRUE);
+      g_ptr_array_free(local_sa_gstrings, TRUE);
+      local_sa_gstrings = NULL;
+    }
+  local_sa_gstrings_used = 0;
+  _arena_free_chunks(local_sa_chunks);
+  local_sa_chunks = NULL;
+}
+
 /* Global API */
 
 #define local_sb_registry  __tls_deref(sb_registry)
@@ -143,6 +415,7 @@ scratch_buffers_init(void)
   local_sb_registry = NULL;
   scratch_buffers_register(&SBGStringStack);
   scratch_buffers_register(&SBTHGStringStack);
+  scratch_buffers_register(&SBGStringArrayStack);
 }
 
 static void
@@ -158,4 +431,5 @@ scratch_buffers_free(void)
 {
   g_list_foreach(local_sb_registry, scratch_buffers_free_stack, NULL);
   g_list_free(local_sb_registry);
+  scratch_arena_free();
 }
@@ -59,6 +59,8 @@ typedef struct
 {
   GTrashStack stackp;
   GString s;
+  /* allocated_len of s as last reported to memprof */
+  gsize profiled_len;
 } SBGString;
 
 extern ScratchBufferStack SBGStringStack;
@@ -74,6 +76,7 @@ typedef struct
 {
   GTrashStack stackp;
   GString s;
+  gsize profiled_len;
   TypeHint type_hint;
 } SBTHGString;
 
@@ -84,4 +87,40 @@ extern ScratchBufferStack SBTHGStringStack;
 
 #define sb_th_gstring_string(buffer) (&buffer->s)
 
+/* Arrays of GStrings, the GStrings are kept across acquire/release cycles
+ * and are freed along with the array */
+
+typedef struct
+{
+  GTrashStack stackp;
+  GPtrArray *strings;
+} SBGStringArray;
+
+extern ScratchBufferStack SBGStringArrayStack;
+
+#define sb_gstring_array_acquire() ((SBGStringArray *)scratch_buffer_acquire(&SBGStringArrayStack))
+#define sb_gstring_array_release(b) (scratch_buffer_release(&SBGStringArrayStack, (GTrashStack *)b))
+
+#define sb_gstring_array_strings(buffer) (buffer->strings)
+
+/*
+ * Scratch arena
+ *
+ * Temporary GStrings and byte slices that don't have to be released one by
+ * one: everything taken from the arena of a thread is reclaimed in bulk
+ * when the thread finishes its current batch of messages, so the results
+ * must not be kept beyond that.  The arena is reset
+ *
+ *   - by main_loop_worker_invoke_batch_callbacks(), at the end of each I/O
+ *     job and each round of threaded destinations,
+ *   - by an ivykis task once the current event handler returns, in threads
+ *     running an ivykis loop (e.g. the main thread).
+ *
+ * Threads doing neither must call scratch_arena_reset() themselves.
+ */
+
+GString *scratch_arena_gstring(void);
+gpointer scratch_arena_alloc(gsize size);
+void scratch_arena_reset(void);
+
 #endif
@@ -40,6 +40,7 @@ typedef struct _SerializeStringArchive
   SerializeArchive super;
   gsize pos;
   GString *string;
+  gboolean buffered;
 } SerializeStringArchive;
 
 typedef struct _SerializeBufferArchive
@@ -48,10 +49,11 @@ typedef struct _SerializeBufferArchive
   gsize pos;
   gsize len;
   gchar *buff;
+  gboolean read_only;
 } SerializeBufferArchive;
 
 static gboolean
-serialize_archive_read_bytes(SerializeArchive *self, gchar *buf, gsize buflen)
+serialize_archive_read_bytes_slow(SerializeArchive *self, gchar *buf, gsize buflen)
 {
   if ((self->error == NULL) && !self->read_bytes(self, buf, buflen, &self->error))
     {
@@ -69,8 +71,20 @@ serialize_archive_read_bytes(SerializeArchive *self, gchar *buf, gsize buflen)
   return self->error == NULL;
 }
 
+static inline gboolean
+serialize_archive_read_bytes(SerializeArchive *self, gchar *buf, gsize buflen)
+{
+  if (G_LIKELY((gsize) (self->read_end - self->read_ptr) >= buflen && self->error == NULL))
+    {
+      memcpy(buf, self->read_ptr, buflen);
+      self->read_ptr += buflen;
+      return TRUE;
+    }
+  return serialize_archive_read_bytes_slow(self, buf, buflen);
+}
+
 static gboolean
-serialize_archive_write_bytes(SerializeArchive *self, const gchar *buf, gsize buflen)
+serialize_archive_write_bytes_slow(SerializeArchive *self, const gchar *buf, gsize buflen)
 {
   if ((self->error == NULL) && !self->write_bytes(self, buf, buflen, &self->error))
     {
@@ -88,10 +102,43 @@ serialize_archive_write_bytes(SerializeArchive *self, const gchar *buf, gsize bu
   return self->error == NULL;
 }
 
+static inline gboolean
+serialize_archive_write_bytes(SerializeArchive *self, const gchar *buf, gsize buflen)
+{
+  if (G_LIKELY((gsize) (self->write_end - self->write_ptr) >= buflen && self->error == NULL))
+    {
+      memcpy(self->write_ptr, buf, buflen);
+      self->write_ptr += buflen;
+      return TRUE;
+    }
+  return serialize_archive_write_bytes_slow(self, buf, buflen);
+}
+
+/*
+ * Tells the archive that about @count bytes are going to be written in one
+ * go (e.g. a complete record), so that it can allocate them at once.
+ * String archives stay in buffered mode until serialize_archive_flush() is
+ * called: the primitives are stored directly into the spare capacity of
+ * the GString, whose length is only updated when the archive is flushed.
+ */
+void
+serialize_archive_reserve(SerializeArchive *self, gsize count)
+{
+  if (self->reserve && self->error == NULL)
+    self->reserve(self, count);
+}
+
+void
+serialize_archive_flush(SerializeArchive *self)
+{
+  if (self->flush)
+    self->flush(self);
+}
 
 void
 serialize_archive_free(SerializeArchive *self)
 {
+  serialize_archive_flush(self);
   g_clear_error(&self->error);
   g_slice_free1(self->len, self);
 }
@@ -142,6 +189,31 @@ serialize_file_archive_new(FILE *f)
   return &self->super;
 }
 
+/* hand the data loaded/stored through the windows back to the GString */
+static void
+serialize_string_archive_close_windows(SerializeStringArchive *self)
+{
+  if (self->super.read_ptr)
+    {
+      self->pos = self->super.read_ptr - self->string->str;
+      self->super.read_ptr = self->super.read_end = NULL;
+    }
+  if (self->super.write_ptr)
+    {
+      self->string->len = self->super.write_ptr - self->string->str;
+      self->string->str[self->string->len] = 0;
+      self->super.write_ptr = self->super.write_end = NULL;
+    }
+}
+
+/* the spare capacity of the GString, leaving room for the terminating NUL */
+static void
+serialize_string_archive_open_write_window(SerializeStringArchive *self)
+{
+  self->super.write_ptr = self->string->str + self->string->len;
+  self->super.write_end = self->string->str + self->string->allocated_len - 1;
+}
+
 static gboolean 
 serialize_string_archive_read_bytes(SerializeArchive *s, gchar *buf, gsize buflen, GError **error)
 {
@@ -149,6 +221,7 @@ serialize_string_archive_read_bytes(SerializeArchive *s, gchar *buf, gsize bufle
   
   g_return_val_if_fail(error == NULL || (*error) == NULL, FALSE);
   
+  serialize_string_archive_close_windows(self);
   if ((gssize) self->pos + buflen > (gssize) self->string->len)
     {
       g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_IO, "Error reading from string, stored data too short");
@@ -156,6 +229,9 @@ serialize_string_archive_read_bytes(SerializeArchive *s, gchar *buf, gsize bufle
     }
   memcpy(buf, &self->string->str[self->pos], buflen);
   self->pos += buflen;
+
+  self->super.read_ptr = self->string->str + self->pos;
+  self->super.read_end = self->string->str + self->string->len;
   return TRUE;
 }
 
@@ -166,10 +242,39 @@ serialize_string_archive_write_bytes(SerializeArchive *s, const gchar *buf, gsiz
   
   g_return_val_if_fail(error == NULL || (*error) == NULL, FALSE);
   
+  serialize_string_archive_close_windows(self);
   g_string_append_len(self->string, buf, buflen);
+  if (self->buffered)
+    serialize_string_archive_open_write_window(self);
   return TRUE;
 }
 
+static void
+serialize_string_archive_reserve(SerializeArchive *s, gsize count)
+{
+  SerializeStringArchive *self = (SerializeStringArchive *) s;
+  gsize len;
+
+  serialize_string_archive_close_windows(self);
+  len = self->string->len;
+  if (self->string->allocated_len - len - 1 < count)
+    {
+      /* g_string_truncate() keeps the allocation */
+      g_string_set_size(self->string, len + count);
+      g_string_truncate(self->string, len);
+    }
+  self->buffered = TRUE;
+  serialize_string_archive_open_write_window(self);
+}
+
+static void
+serialize_string_archive_flush(SerializeArchive *s)
+{
+  SerializeStringArchive *self = (SerializeStringArchive *) s;
+
+  serialize_string_archive_close_windows(self);
+  self->buffered = FALSE;
+}
 
 SerializeArchive *
 serialize_string_archive_new(GString *str)
@@ -178,11 +283,25 @@ serialize_string_archive_new(GString *str)
 
   self->super.read_bytes = serialize_string_archive_read_bytes;
   self->super.write_bytes = serialize_string_archive_write_bytes;
+  self->super.reserve = serialize_string_archive_reserve;
+  self->super.flush = serialize_string_archive_flush;
   self->super.len = sizeof(SerializeStringArchive);
   self->string = str;
   return &self->super;
 }
 
+/* reads and writes share the position, so only one of the windows is open at a time */
+static void
+serialize_buffer_archive_close_windows(SerializeBufferArchive *self)
+{
+  if (self->super.read_ptr)
+    self->pos = self->super.read_ptr - self->buff;
+  if (self->super.write_ptr)
+    self->pos = self->super.write_ptr - self->buff;
+  self->super.read_ptr = self->super.read_end = NULL;
+  self->super.write_ptr = self->super.write_end = NULL;
+}
+
 static gboolean
 serialize_buffer_archive_read_bytes(SerializeArchive *s, gchar *buf, gsize buflen, GError **error)
 {
@@ -190,6 +309,7 @@ serialize_buffer_archive_read_bytes(SerializeArchive *s, gchar *buf, gsize bufle
 
   g_return_val_if_fail(error == NULL || (*error) == NULL, FALSE);
 
+  serialize_buffer_archive_close_windows(self);
   if ((gssize) self->pos + buflen > (gssize) self->len)
     {
       g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_IO, "Error reading from buffer, stored data too short");
@@ -197,6 +317,9 @@ serialize_buffer_archive_read_bytes(SerializeArchive *s, gchar *buf, gsize bufle
     }
   memcpy(buf, &self->buff[self->pos], buflen);
   self->pos += buflen;
+
+  self->super.read_ptr = self->buff + self->pos;
+  self->super.read_end = self->buff + self->len;
   return TRUE;
 }
 
@@ -207,6 +330,13 @@ serialize_buffer_archive_write_bytes(SerializeArchive *s, const gchar *buf, gsiz
 
   g_return_val_if_fail(error == NULL || (*error) == NULL, FALSE);
 
+  if (self->read_only)
+    {
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_IO, "Error writing to buffer, buffer is read-only");
+      return FALSE;
+    }
+
+  serialize_buffer_archive_close_windows(self);
   if (self->pos + buflen > self->len)
     {
       g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_IO, "Error writing to buffer, buffer is too small");
@@ -215,27 +345,63 @@ serialize_buffer_archive_write_bytes(SerializeArchive *s, const gchar *buf, gsiz
 
   memcpy(self->buff + self->pos, buf, buflen);
   self->pos += buflen;
+
+  self->super.write_ptr = self->buff + self->pos;
+  self->super.write_end = self->buff + self->len;
   return TRUE;
 }
 
+static void
+serialize_buffer_archive_flush(SerializeArchive *s)
+{
+  serialize_buffer_archive_close_windows((SerializeBufferArchive *) s);
+}
+
 gsize
 serialize_buffer_archive_get_pos(SerializeArchive *s)
 {
   SerializeBufferArchive *self = (SerializeBufferArchive *) s;
 
+  if (self->super.read_ptr)
+    return self->super.read_ptr - self->buff;
+  if (self->super.write_ptr)
+    return self->super.write_ptr - self->buff;
   return self->pos;
 }
 
-SerializeArchive *
-serialize_buffer_archive_new(gchar *buff, gsize len)
+static SerializeBufferArchive *
+serialize_buffer_archive_new_instance(gchar *buff, gsize len)
 {
   SerializeBufferArchive *self = g_slice_new0(SerializeBufferArchive);
 
   self->super.read_bytes = serialize_buffer_archive_read_bytes;
   self->super.write_bytes = serialize_buffer_archive_write_bytes;
+  self->super.flush = serialize_buffer_archive_flush;
   self->super.len = sizeof(SerializeBufferArchive);
   self->buff = buff;
   self->len = len;
+  return self;
+}
+
+SerializeArchive *
+serialize_buffer_archive_new(gchar *buff, gsize len)
+{
+  return &serialize_buffer_archive_new_instance(buff, len)->super;
+}
+
+/*
+ * Read-only archive over a memory region that the caller keeps mapped
+ * (e.g. a read-only mmap() of a file) while the archive is in use, the
+ * data is deserialized in place without copying it first.
+ */
+SerializeArchive *
+serialize_region_archive_new(const gchar *region, gsize len)
+{
+  SerializeBufferArchive *self = serialize_buffer_archive_new_instance((gchar *) region, len);
+
+  self->read_only = TRUE;
+  self->super.read_ptr = region;
+  self->super.read_end = region + len;
   return &self->super;
 }
 
@@ -402,4 +568,106 @@ serialize_read_uint8(SerializeArchive *archive, guint8 *value)
   return FALSE;
 }
 
+/* unsigned LEB128 encoding, 7 bits in every byte, MSB set if more bytes follow */
+#define SERIALIZE_VARINT_MAX_LEN 10
+
+static inline gsize
+serialize_encode_varint(guint8 *buf, guint64 value)
+{
+  gsize len = 0;
+
+  do
+    {
+      buf[len] = value & 0x7F;
+      value >>= 7;
+      if (value)
+        buf[len] |= 0x80;
+      len++;
+    }
+  while (value);
+  return len;
+}
+
+gboolean
+serialize_write_varint(SerializeArchive *archive, guint64 value)
+{
+  guint8 buf[SERIALIZE_VARINT_MAX_LEN];
+  gsize len;
+
+  if (G_LIKELY(archive->write_end - archive->write_ptr >= SERIALIZE_VARINT_MAX_LEN && archive->error == NULL))
+    {
+      archive->write_ptr += serialize_encode_varint((guint8 *) archive->write_ptr, value);
+      return TRUE;
+    }
+  len = serialize_encode_varint(buf, value);
+  return serialize_archive_write_bytes(archive, (gchar *) buf, len);
+}
+
+/* decodes a varint from the read window, the slow path handles truncated and invalid ones */
+static inline gboolean
+serialize_read_varint_direct(SerializeArchive *archive, guint64 *value)
+{
+  const guint8 *p = (const guint8 *) archive->read_ptr;
+  const guint8 *end = (const guint8 *) archive->read_end;
+  guint64 result = 0;
+  gint shift;
+
+  for (shift = 0; shift <= 63 && p < end; shift += 7)
+    {
+      guint8 n = *p++;
+
+      result |= ((guint64) (n & 0x7F)) << shift;
+      if (!(n & 0x80))
+        {
+          archive->read_ptr = (const gchar *) p;
+          *value = result;
+          return TRUE;
+        }
+    }
+  return FALSE;
+}
+
+gboolean
+serialize_read_varint(SerializeArchive *archive, guint64 *value)
+{
+  guint64 result = 0;
+  gint shift = 0;
+  guint8 n;
+
+  if (G_LIKELY(archive->read_ptr && archive->error == NULL) && serialize_read_varint_direct(archive, value))
+    return TRUE;
+
+  do
+    {
+      if (shift > 63)
+        {
+          g_set_error(&archive->error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Invalid varint in serialized data");
+          return FALSE;
+        }
+      if (!serialize_read_uint8(archive, &n))
+        return FALSE;
+      result |= ((guint64) (n & 0x7F)) << shift;
+      shift += 7;
+    }
+  while (n & 0x80);
+  *value = result;
+  return TRUE;
+}
+
+gboolean
+serialize_read_varint32(SerializeArchive *archive, guint32 *value)
+{
+  guint64 n;
+
+  if (!serialize_read_varint(archive, &n))
+    return FALSE;
+  if (n > G_MAXUINT32)
+    {
+      g_set_error(&archive->error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Serialized varint is out of range");
+      return FALSE;
+    }
+  *value = (guint32) n;
+  return TRUE;
+}
+
 
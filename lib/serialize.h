@@ -36,8 +36,16 @@ struct _SerializeArchive
   guint16 len;
   guint16 silent:1;
 
+  /* memory backed archives expose the part of their buffer that can be
+   * accessed in place: primitives are loaded from/stored to these windows
+   * directly and read_bytes/write_bytes are only called once they run out */
+  const gchar *read_ptr, *read_end;
+  gchar *write_ptr, *write_end;
+
   gboolean (*read_bytes)(SerializeArchive *archive, gchar *buf, gsize count, GError **error);
   gboolean (*write_bytes)(SerializeArchive *archive, const gchar *buf, gsize count, GError **error);
+  void (*reserve)(SerializeArchive *archive, gsize count);
+  void (*flush)(SerializeArchive *archive);
 };
 
 gboolean serialize_write_blob(SerializeArchive *archive, const void *blob, gsize len);
@@ -54,11 +62,17 @@ gboolean serialize_write_uint16(SerializeArchive *archive, guint16 value);
 gboolean serialize_read_uint16(SerializeArchive *archive, guint16 *value);
 gboolean serialize_write_uint8(SerializeArchive *archive, guint8 value);
 gboolean serialize_read_uint8(SerializeArchive *archive, guint8 *value);
+gboolean serialize_write_varint(SerializeArchive *archive, guint64 value);
+gboolean serialize_read_varint(SerializeArchive *archive, guint64 *value);
+gboolean serialize_read_varint32(SerializeArchive *archive, guint32 *value);
 
 SerializeArchive *serialize_file_archive_new(FILE *f);
 SerializeArchive *serialize_string_archive_new(GString *str);
 SerializeArchive *serialize_buffer_archive_new(gchar *buff, gsize len);
+SerializeArchive *serialize_region_archive_new(const gchar *region, gsize len);
 gsize serialize_buffer_archive_get_pos(SerializeArchive *self);
+void serialize_archive_reserve(SerializeArchive *self, gsize count);
+void serialize_archive_flush(SerializeArchive *self);
 void serialize_archive_free(SerializeArchive *self);
 
 #endif
@@ -34,7 +34,7 @@ stats_cluster_foreach_counter(StatsCluster *self, StatsForeachCounterFunc func,
     {
       if (self->live_mask & (1 << type))
         {
-          func(self, type, &self->counters[type], user_data);
+          func(self, type, stats_cluster_get_counter(self, type), user_data);
         }
     }
 }
@@ -49,6 +49,25 @@ stats_cluster_get_type_name(gint type)
     /* [SC_TYPE_STORED]   = */  "stored",
     /* [SC_TYPE_SUPPRESSED] = */ "suppressed",
     /* [SC_TYPE_STAMP] = */ "stamp",
+    /* [SC_TYPE_LATENCY_1MS] = */ "latency_1ms",
+    /* [SC_TYPE_LATENCY_10MS] = */ "latency_10ms",
+    /* [SC_TYPE_LATENCY_100MS] = */ "latency_100ms",
+    /* [SC_TYPE_LATENCY_1S] = */ "latency_1s",
+    /* [SC_TYPE_LATENCY_10S] = */ "latency_10s",
+    /* [SC_TYPE_LATENCY_SLOWER] = */ "latency_slower",
+    /* [SC_TYPE_EVICTED] = */ "evicted",
+    /* [SC_TYPE_MEMORY_USAGE] = */ "memory_usage",
+    /* [SC_TYPE_BACKLOG] = */ "backlog",
+    /* [SC_TYPE_PUSH_RATE] = */ "push_rate",
+    /* [SC_TYPE_POP_RATE] = */ "pop_rate",
+    /* [SC_TYPE_DISK_SIZE] = */ "disk_size",
+    /* [SC_TYPE_DISK_WRITER_HEAD] = */ "disk_writer_head",
+    /* [SC_TYPE_DISK_READER_HEAD] = */ "disk_reader_head",
+    /* [SC_TYPE_DISK_BACKLOG_HEAD] = */ "disk_backlog_head",
+    /* [SC_TYPE_SYNC_LATENCY] = */ "sync_latency_usec",
+    /* [SC_TYPE_BUSY_TIME] = */ "busy_usec",
+    /* [SC_TYPE_UTILIZATION] = */ "utilization_percent",
+    /* [SC_TYPE_LAG] = */ "lag_usec",
   };
 
   return tag_names[type];
@@ -94,7 +113,11 @@ _get_module_name(gint source)
     "snmp",
     "riemann",
     "journald",
-    "java"
+    "java",
+    "grouping-by",
+    "http",
+    "trace",
+    "thread"
   };
   return module_names[source & SCS_SOURCE_MASK];
 }
@@ -141,22 +164,62 @@ stats_cluster_hash(const StatsCluster *self)
   return g_str_hash(self->id) + g_str_hash(self->instance) + self->component;
 }
 
+/* counters of these types are set to the current value instead of being
+ * incremented */
+gboolean
+stats_cluster_is_gauge_type(gint type)
+{
+  switch (type)
+    {
+    case SC_TYPE_STORED:
+    case SC_TYPE_STAMP:
+    case SC_TYPE_MEMORY_USAGE:
+    case SC_TYPE_BACKLOG:
+    case SC_TYPE_PUSH_RATE:
+    case SC_TYPE_POP_RATE:
+    case SC_TYPE_DISK_SIZE:
+    case SC_TYPE_DISK_WRITER_HEAD:
+    case SC_TYPE_DISK_READER_HEAD:
+    case SC_TYPE_DISK_BACKLOG_HEAD:
+    case SC_TYPE_SYNC_LATENCY:
+    case SC_TYPE_UTILIZATION:
+    case SC_TYPE_LAG:
+      return TRUE;
+    default:
+      return FALSE;
+    }
+}
+
+/* gauges are set and decremented, they are not worth sharding */
+gboolean
+stats_cluster_is_counter_shardable(gint type)
+{
+  return !stats_cluster_is_gauge_type(type);
+}
+
 StatsCounterItem *
 stats_cluster_track_counter(StatsCluster *self, gint type)
 {
   gint type_mask = 1 << type;
 
+  StatsCounterItem *counter;
+
   g_assert(type < SC_TYPE_MAX);
 
+  if (type >= SC_TYPE_EXTENDED_MIN && !self->extended_counters)
+    self->extended_counters = g_new0(StatsCounterItem, SC_TYPE_EXTENDED_COUNT);
+
+  counter = stats_cluster_get_counter(self, type);
   self->live_mask |= type_mask;
   self->use_count++;
-  return &self->counters[type];
+  counter->shardable = stats_cluster_is_counter_shardable(type);
+  return counter;
 }
 
 void
 stats_cluster_untrack_counter(StatsCluster *self, gint type, StatsCounterItem **counter)
 {
-  g_assert(self && (self->live_mask & (1 << type)) && &self->counters[type] == (*counter));
+  g_assert(self && (self->live_mask & (1 << type)) && stats_cluster_get_counter(self, type) == (*counter));
   g_assert(self->use_count > 0);
 
   self->use_count--;
@@ -177,7 +240,17 @@ stats_cluster_new(gint component, const gchar *id, const gchar *instance)
 
 void
 stats_cluster_free(StatsCluster *self)
-{ 
+{
+  gint type;
+
+  for (type = 0; type < SC_TYPE_EXTENDED_MIN; type++)
+    stats_counter_free_shards(&self->counters[type]);
+  if (self->extended_counters)
+    {
+      for (type = 0; type < SC_TYPE_EXTENDED_COUNT; type++)
+        stats_counter_free_shards(&self->extended_counters[type]);
+      g_free(self->extended_counters);
+    }
   g_free(self->id);
   g_free(self->instance);
   g_free(self);
@@ -34,9 +34,36 @@ typedef enum
   SC_TYPE_STORED,    /* number of messages on disk */
   SC_TYPE_SUPPRESSED,/* number of messages suppressed */
   SC_TYPE_STAMP,     /* timestamp */
+  /* delivery latency histogram, see stats-latency.h */
+  SC_TYPE_LATENCY_1MS,
+  SC_TYPE_LATENCY_10MS,
+  SC_TYPE_LATENCY_100MS,
+  SC_TYPE_LATENCY_1S,
+  SC_TYPE_LATENCY_10S,
+  SC_TYPE_LATENCY_SLOWER,
+  /* the types below are used by a few clusters only, their counters are
+   * allocated on demand, see stats_cluster_get_counter() */
+  SC_TYPE_EXTENDED_MIN,
+  SC_TYPE_EVICTED = SC_TYPE_EXTENDED_MIN, /* number of states closed early to free up memory */
+  SC_TYPE_MEMORY_USAGE, /* bytes of memory used */
+  /* queue gauges, see log_queue_register_stats_counters() */
+  SC_TYPE_BACKLOG,   /* number of messages sent but not yet acknowledged */
+  SC_TYPE_PUSH_RATE, /* messages per second */
+  SC_TYPE_POP_RATE,  /* messages per second */
+  SC_TYPE_DISK_SIZE, /* bytes of the disk-buffer file */
+  SC_TYPE_DISK_WRITER_HEAD,
+  SC_TYPE_DISK_READER_HEAD,
+  SC_TYPE_DISK_BACKLOG_HEAD,
+  SC_TYPE_SYNC_LATENCY, /* usec, the slowest disk-buffer sync since the last update */
+
+  SC_TYPE_BUSY_TIME,   /* usec a thread spent working */
+  SC_TYPE_UTILIZATION, /* percentage of the last interval a thread spent working */
+  SC_TYPE_LAG,         /* usec, the largest main loop delay since the last update */
   SC_TYPE_MAX
 } StatsCounterType;
 
+#define SC_TYPE_EXTENDED_COUNT (SC_TYPE_MAX - SC_TYPE_EXTENDED_MIN)
+
 enum
 {
   /* direction bits, used to distinguish between source/destination drivers */
@@ -79,6 +106,10 @@ enum
   SCS_RIEMANN        = 33,
   SCS_JOURNALD       = 34,
   SCS_JAVA           = 35,
+  SCS_GROUPING_BY    = 36,
+  SCS_HTTP           = 37,
+  SCS_TRACE          = 38,
+  SCS_THREAD         = 39,
   SCS_MAX,
   SCS_SOURCE_MASK    = 0xff
 };
@@ -94,18 +125,29 @@ enum
  * be registered with a single hash lookup */
 typedef struct _StatsCluster
 {
-  StatsCounterItem counters[SC_TYPE_MAX];
+  StatsCounterItem counters[SC_TYPE_EXTENDED_MIN];
+  /* SC_TYPE_EXTENDED_COUNT items, allocated when the first one is tracked */
+  StatsCounterItem *extended_counters;
   guint16 use_count;
   /* syslog-ng component/driver/subsystem that registered this cluster */
   guint16 component;
   gchar *id;
   gchar *instance;
-  guint16 live_mask;
+  guint32 live_mask;
   guint16 dynamic:1;
 } StatsCluster;
 
 typedef void (*StatsForeachCounterFunc)(StatsCluster *sc, gint type, StatsCounterItem *counter, gpointer user_data);
 
+/* only valid for the types tracked in live_mask */
+static inline StatsCounterItem *
+stats_cluster_get_counter(StatsCluster *self, gint type)
+{
+  if (type < SC_TYPE_EXTENDED_MIN)
+    return &self->counters[type];
+  return &self->extended_counters[type - SC_TYPE_EXTENDED_MIN];
+}
+
 const gchar *stats_cluster_get_type_name(gint type);
 const gchar *stats_cluster_get_component_name(StatsCluster *self, gchar *buf, gsize buf_len);
 
@@ -114,6 +156,8 @@ void stats_cluster_foreach_counter(StatsCluster *self, StatsForeachCounterFunc f
 gboolean stats_cluster_equal(const StatsCluster *sc1, const StatsCluster *sc2);
 guint stats_cluster_hash(const StatsCluster *self);
 
+gboolean stats_cluster_is_gauge_type(gint type);
+gboolean stats_cluster_is_counter_shardable(gint type);
 StatsCounterItem *stats_cluster_track_counter(StatsCluster *self, gint type);
 void stats_cluster_untrack_counter(StatsCluster *self, gint type, StatsCounterItem **counter);
 
@@ -24,6 +24,55 @@
 #include "stats/stats-counter.h"
 #include "stats/stats-cluster.h"
 #include "stats/stats-registry.h"
+#include "mainloop-worker.h"
+
+static StatsCounterShard *
+_allocate_shards(StatsCounterItem *counter)
+{
+  gpointer mem = g_malloc0((STATS_COUNTER_NUM_SHARDS + 1) * STATS_COUNTER_CACHELINE_SIZE);
+  StatsCounterShard *shards;
+
+  shards = (StatsCounterShard *) (((gsize) mem + STATS_COUNTER_CACHELINE_SIZE - 1) & ~((gsize) STATS_COUNTER_CACHELINE_SIZE - 1));
+
+  /* another thread may have been faster, only the first one is kept */
+  if (!g_atomic_pointer_compare_and_exchange((gpointer *) &counter->shards_mem, NULL, mem))
+    {
+      g_free(mem);
+      while (!(shards = g_atomic_pointer_get((gpointer *) &counter->shards)))
+        ;
+      return shards;
+    }
+  g_atomic_pointer_set((gpointer *) &counter->shards, shards);
+  return shards;
+}
+
+/* the location the current thread adds its updates to */
+gint64 *
+stats_counter_get_slot(StatsCounterItem *counter)
+{
+  StatsCounterShard *shards;
+  gint thread_id;
+
+  if (!counter->shardable)
+    return &counter->value;
+
+  thread_id = main_loop_worker_get_thread_id();
+  if (thread_id < 0)
+    return &counter->value;
+
+  shards = g_atomic_pointer_get((gpointer *) &counter->shards);
+  if (G_UNLIKELY(!shards))
+    shards = _allocate_shards(counter);
+  return &shards[thread_id % STATS_COUNTER_NUM_SHARDS].value;
+}
+
+void
+stats_counter_free_shards(StatsCounterItem *counter)
+{
+  g_free(counter->shards_mem);
+  counter->shards_mem = NULL;
+  counter->shards = NULL;
+}
 
 static void
 _reset_counter(StatsCluster *sc, gint type, StatsCounterItem *counter, gpointer user_data)
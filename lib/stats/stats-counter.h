@@ -26,49 +26,94 @@
 
 #include "syslog-ng.h"
 
+/*
+ * Counters are 64 bits wide.  The ones that only ever grow (everything
+ * except gauges like "stored" and timestamps) are sharded: worker threads
+ * add to their own cacheline of the counter, indexed by their thread id,
+ * so that the threads feeding a shared destination don't contend on a
+ * single location.  The shards are allocated on the first update from a
+ * worker thread and summed up by stats_counter_get().
+ */
+
+#define STATS_COUNTER_NUM_SHARDS 16
+#define STATS_COUNTER_CACHELINE_SIZE 64
+
+typedef struct _StatsCounterShard
+{
+  gint64 value;
+  gchar pad[STATS_COUNTER_CACHELINE_SIZE - sizeof(gint64)];
+} StatsCounterShard;
+
 typedef struct _StatsCounterItem
 {
-  gint value;
+  gint64 value;
+  gboolean shardable;
+  /* STATS_COUNTER_NUM_SHARDS entries, cacheline aligned within shards_mem */
+  StatsCounterShard *shards;
+  gpointer shards_mem;
 } StatsCounterItem;
 
+gint64 *stats_counter_get_slot(StatsCounterItem *counter);
+void stats_counter_free_shards(StatsCounterItem *counter);
+
+static inline void
+stats_counter_atomic_add(gint64 *value, gint64 add)
+{
+  __sync_fetch_and_add(value, add);
+}
 
 static inline void
 stats_counter_add(StatsCounterItem *counter, gint add)
 {
   if (counter)
-    g_atomic_int_add(&counter->value, add);
+    stats_counter_atomic_add(stats_counter_get_slot(counter), add);
 }
 
 static inline void
 stats_counter_inc(StatsCounterItem *counter)
 {
-  if (counter)
-    g_atomic_int_inc(&counter->value);
+  stats_counter_add(counter, 1);
 }
 
 static inline void
 stats_counter_dec(StatsCounterItem *counter)
 {
-  if (counter)
-    g_atomic_int_add(&counter->value, -1);
+  stats_counter_add(counter, -1);
 }
 
 /* NOTE: this is _not_ atomic and doesn't have to be as sets would race anyway */
 static inline void
-stats_counter_set(StatsCounterItem *counter, guint32 value)
+stats_counter_set(StatsCounterItem *counter, gint64 value)
 {
-  if (counter)
-    counter->value = value;
+  gint i;
+
+  if (!counter)
+    return;
+
+  counter->value = value;
+  if (counter->shards)
+    {
+      for (i = 0; i < STATS_COUNTER_NUM_SHARDS; i++)
+        counter->shards[i].value = 0;
+    }
 }
 
 /* NOTE: this is _not_ atomic and doesn't have to be as sets would race anyway */
-static inline guint32
+static inline gint64
 stats_counter_get(StatsCounterItem *counter)
 {
-  guint32 result = 0;
+  gint64 result = 0;
+  gint i;
 
-  if (counter)
-    result = counter->value;
+  if (!counter)
+    return 0;
+
+  result = counter->value;
+  if (counter->shards)
+    {
+      for (i = 0; i < STATS_COUNTER_NUM_SHARDS; i++)
+        result += counter->shards[i].value;
+    }
   return result;
 }
 
@@ -57,10 +57,15 @@ stats_format_csv_escapevar(const gchar *var)
   return escaped_result;
 }
 
-static void
-stats_format_csv(StatsCluster *sc, gint type, StatsCounterItem *counter, gpointer user_data)
+void
+stats_csv_format_header(GString *csv)
+{
+  g_string_append_printf(csv, "%s;%s;%s;%s;%s;%s\n", "SourceName", "SourceId", "SourceInstance", "State", "Type", "Number");
+}
+
+void
+stats_csv_format_counter(GString *csv, StatsCluster *sc, gint type, gint64 value)
 {
-  GString *csv = (GString *) user_data;
   gchar *s_id, *s_instance, *tag_name;
   gchar buf[32];
   gchar state;
@@ -76,21 +81,29 @@ stats_format_csv(StatsCluster *sc, gint type, StatsCounterItem *counter, gpointe
     state = 'a';
 
   tag_name = stats_format_csv_escapevar(stats_cluster_get_type_name(type));
-  g_string_append_printf(csv, "%s;%s;%s;%c;%s;%u\n",
+  g_string_append_printf(csv, "%s;%s;%s;%c;%s;%" G_GINT64_FORMAT "\n",
                          stats_cluster_get_component_name(sc, buf, sizeof(buf)),
-                         s_id, s_instance, state, tag_name, stats_counter_get(&sc->counters[type]));
+                         s_id, s_instance, state, tag_name, value);
   g_free(tag_name);
   g_free(s_id);
   g_free(s_instance);
 }
 
+static void
+stats_format_csv(StatsCluster *sc, gint type, StatsCounterItem *counter, gpointer user_data)
+{
+  GString *csv = (GString *) user_data;
+
+  stats_csv_format_counter(csv, sc, type, stats_counter_get(counter));
+}
+
 
 gchar *
 stats_generate_csv(void)
 {
   GString *csv = g_string_sized_new(1024);
 
-  g_string_append_printf(csv, "%s;%s;%s;%s;%s;%s\n", "SourceName", "SourceId", "SourceInstance", "State", "Type", "Number");
+  stats_csv_format_header(csv);
   stats_lock();
   stats_foreach_counter(stats_format_csv, csv);
   stats_unlock();
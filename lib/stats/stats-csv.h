@@ -25,7 +25,10 @@
 #define STATS_CSV_H_INCLUDED 1
 
 #include "syslog-ng.h"
+#include "stats/stats-cluster.h"
 
+void stats_csv_format_header(GString *csv);
+void stats_csv_format_counter(GString *csv, StatsCluster *sc, gint type, gint64 value);
 gchar *stats_generate_csv(void);
 
 #endif
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "stats/stats-latency.h"
+#include "stats/stats-registry.h"
+#include "timeutils.h"
+
+/* the caller must hold the stats lock */
+void
+stats_register_latency_counters(gint component, const gchar *id, const gchar *instance, StatsLatencyCounters *self)
+{
+  gint i;
+
+  for (i = 0; i < STATS_LATENCY_BUCKETS; i++)
+    stats_register_counter(STATS_LEVEL3, component, id, instance, SC_TYPE_LATENCY_1MS + i, &self->buckets[i]);
+}
+
+/* the caller must hold the stats lock */
+void
+stats_unregister_latency_counters(gint component, const gchar *id, const gchar *instance, StatsLatencyCounters *self)
+{
+  gint i;
+
+  for (i = 0; i < STATS_LATENCY_BUCKETS; i++)
+    stats_unregister_counter(component, id, instance, SC_TYPE_LATENCY_1MS + i, &self->buckets[i]);
+}
+
+void
+stats_latency_counters_record(StatsLatencyCounters *self, glong latency_usec)
+{
+  glong limit = 1000;
+  gint i;
+
+  for (i = 0; i < STATS_LATENCY_BUCKETS - 1; i++)
+    {
+      if (latency_usec <= limit)
+        break;
+      limit *= 10;
+    }
+  stats_counter_inc(self->buckets[i]);
+}
+
+void
+stats_latency_counters_record_since(StatsLatencyCounters *self, const LogStamp *received)
+{
+  GTimeVal now, recvd;
+
+  if (!stats_latency_counters_enabled(self))
+    return;
+
+  cached_g_current_time(&now);
+  recvd.tv_sec = received->tv_sec;
+  recvd.tv_usec = received->tv_usec;
+  stats_latency_counters_record(self, MAX(g_time_val_diff(&now, &recvd), 0));
+}
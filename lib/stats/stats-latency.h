@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#ifndef STATS_LATENCY_H_INCLUDED
+#define STATS_LATENCY_H_INCLUDED 1
+
+#include "stats/stats-cluster.h"
+#include "logstamp.h"
+
+#define STATS_LATENCY_BUCKETS (SC_TYPE_LATENCY_SLOWER - SC_TYPE_LATENCY_1MS + 1)
+
+/*
+ * Delivery latency histogram
+ *
+ * Counts messages by the time elapsed between their reception and their
+ * delivery, using exponential (decimal) bucket boundaries from 1ms to 10s.
+ * Each bucket is a regular stats counter type in the destination's stats
+ * cluster, registered only at stats(level(3)), so the histogram costs
+ * nothing when disabled, and an atomic increment otherwise.
+ */
+typedef struct _StatsLatencyCounters
+{
+  StatsCounterItem *buckets[STATS_LATENCY_BUCKETS];
+} StatsLatencyCounters;
+
+void stats_register_latency_counters(gint component, const gchar *id, const gchar *instance, StatsLatencyCounters *self);
+void stats_unregister_latency_counters(gint component, const gchar *id, const gchar *instance, StatsLatencyCounters *self);
+void stats_latency_counters_record(StatsLatencyCounters *self, glong latency_usec);
+void stats_latency_counters_record_since(StatsLatencyCounters *self, const LogStamp *received);
+
+static inline gboolean
+stats_latency_counters_enabled(StatsLatencyCounters *self)
+{
+  return self->buckets[0] != NULL;
+}
+
+#endif
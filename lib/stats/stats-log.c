@@ -31,12 +31,12 @@ stats_log_format_counter(StatsCluster *sc, gint type, StatsCounterItem *item, gp
   EVTTAG *tag;
   gchar buf[32];
 
-  tag = evt_tag_printf(stats_cluster_get_type_name(type), "%s(%s%s%s)=%u", 
+  tag = evt_tag_printf(stats_cluster_get_type_name(type), "%s(%s%s%s)=%" G_GINT64_FORMAT, 
                        stats_cluster_get_component_name(sc, buf, sizeof(buf)),
                        sc->id,
                        (sc->id[0] && sc->instance[0]) ? "," : "",
                        sc->instance,
-                       stats_counter_get(&sc->counters[type]));
+                       stats_counter_get(stats_cluster_get_counter(sc, type)));
   evt_rec_add_tag(e, tag);
 }
 
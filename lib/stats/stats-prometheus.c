@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "stats/stats-prometheus.h"
+#include "stats/stats-registry.h"
+
+/*
+ * Prometheus/OpenMetrics text exposition of the counters.
+ *
+ * Each counter type becomes a metric family, with the cluster's
+ * component, id and instance as labels, e.g.:
+ *
+ *   # TYPE syslogng_processed counter
+ *   syslogng_processed_total{component="src.file",id="s_local#0",instance="/var/log/messages"} 1234
+ *
+ * The format requires the samples of a family to be adjacent, so the
+ * clusters are walked once per counter type.  The walk uses a snapshot of
+ * the registered clusters and produces the output in chunks, stats_lock()
+ * is only held while taking the snapshot.  With a lot of dynamic counters
+ * formatting takes much longer than that and would block the registration
+ * of counters in the worker threads otherwise.
+ */
+
+#define STATS_PROMETHEUS_CHUNK_CLUSTERS 1024
+
+struct _StatsPrometheusQuery
+{
+  GPtrArray *clusters;
+  gint type;
+  guint index;
+  gboolean family_started;
+};
+
+static void
+_append_label_value(GString *output, const gchar *value)
+{
+  const gchar *p = value;
+  gunichar c;
+
+  while (*p)
+    {
+      c = g_utf8_get_char_validated(p, -1);
+      if (c == (gunichar) -1 || c == (gunichar) -2)
+        {
+          /* the exposition format is UTF-8 only */
+          g_string_append_c(output, '?');
+          p++;
+          continue;
+        }
+
+      switch (c)
+        {
+        case '\\':
+          g_string_append(output, "\\\\");
+          break;
+        case '"':
+          g_string_append(output, "\\\"");
+          break;
+        case '\n':
+          g_string_append(output, "\\n");
+          break;
+        default:
+          g_string_append_len(output, p, g_utf8_next_char(p) - p);
+          break;
+        }
+      p = g_utf8_next_char(p);
+    }
+}
+
+static void
+_format_family_header(StatsPrometheusQuery *self, GString *output)
+{
+  g_string_append_printf(output, "# TYPE syslogng_%s %s\n",
+                         stats_cluster_get_type_name(self->type),
+                         stats_cluster_is_gauge_type(self->type) ? "gauge" : "counter");
+}
+
+static void
+_format_sample(StatsPrometheusQuery *self, StatsCluster *sc, GString *output)
+{
+  gchar buf[32];
+
+  g_string_append_printf(output, "syslogng_%s%s{component=\"",
+                         stats_cluster_get_type_name(self->type),
+                         stats_cluster_is_gauge_type(self->type) ? "" : "_total");
+  _append_label_value(output, stats_cluster_get_component_name(sc, buf, sizeof(buf)));
+  g_string_append(output, "\",id=\"");
+  _append_label_value(output, sc->id ? : "");
+  g_string_append(output, "\",instance=\"");
+  _append_label_value(output, sc->instance ? : "");
+  g_string_append_printf(output, "\"} %" G_GINT64_FORMAT "\n", stats_counter_get(stats_cluster_get_counter(sc, self->type)));
+}
+
+StatsPrometheusQuery *
+stats_prometheus_query_new(void)
+{
+  StatsPrometheusQuery *self = g_new0(StatsPrometheusQuery, 1);
+
+  stats_lock();
+  self->clusters = stats_registry_snapshot_clusters();
+  stats_unlock();
+  self->type = SC_TYPE_MIN;
+  return self;
+}
+
+/*
+ * Appends the next part of the output to @output, returns FALSE once the
+ * whole exposition (including the closing "# EOF" line) was produced.
+ * The counters themselves are read without locking, just like the worker
+ * threads update them.
+ */
+gboolean
+stats_prometheus_query_format_chunk(StatsPrometheusQuery *self, GString *output)
+{
+  StatsCluster *sc;
+  gint budget = STATS_PROMETHEUS_CHUNK_CLUSTERS;
+
+  while (self->type < SC_TYPE_MAX)
+    {
+      for (; self->index < self->clusters->len; self->index++)
+        {
+          if (budget-- == 0)
+            return TRUE;
+
+          sc = (StatsCluster *) g_ptr_array_index(self->clusters, self->index);
+          if ((sc->live_mask & (1 << self->type)) == 0)
+            continue;
+
+          if (!self->family_started)
+            {
+              _format_family_header(self, output);
+              self->family_started = TRUE;
+            }
+          _format_sample(self, sc, output);
+        }
+      self->type++;
+      self->index = 0;
+      self->family_started = FALSE;
+    }
+
+  g_string_append(output, "# EOF\n");
+  return FALSE;
+}
+
+void
+stats_prometheus_query_free(StatsPrometheusQuery *self)
+{
+  stats_registry_release_snapshot(self->clusters);
+  g_free(self);
+}
+
+gchar *
+stats_generate_prometheus(void)
+{
+  StatsPrometheusQuery *query = stats_prometheus_query_new();
+  GString *output = g_string_sized_new(1024);
+
+  while (stats_prometheus_query_format_chunk(query, output))
+    ;
+  stats_prometheus_query_free(query);
+  return g_string_free(output, FALSE);
+}
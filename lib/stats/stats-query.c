@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "stats/stats-query.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-csv.h"
+
+#include <string.h>
+
+/*
+ * Filtered stats queries
+ *
+ * A query pattern has the form
+ *
+ *   <component>;<id>;<instance>;<type>
+ *
+ * where each field is a glob pattern matched against the respective
+ * column of the STATS output, trailing fields may be omitted and match
+ * everything.  With a literal component and id, only the matching
+ * clusters are visited, thanks to the index of the registry, so a
+ * monitoring agent can poll a handful of counters cheaply, regardless of
+ * the number of dynamic counters registered.
+ *
+ * If a session name is given, the values of the counters are reported
+ * relative to the previous query of the same session (gauges are always
+ * reported as is), the session remembers the values of the counters
+ * matched by its last query only.
+ */
+
+#define STATS_QUERY_MAX_SESSIONS 64
+
+enum
+{
+  SQF_COMPONENT,
+  SQF_ID,
+  SQF_INSTANCE,
+  SQF_TYPE,
+  SQF_MAX
+};
+
+typedef struct _StatsQuery
+{
+  GPatternSpec *fields[SQF_MAX];
+  gchar *literal_id;
+  GHashTable *previous_values;
+  GHashTable *current_values;
+  GString *result;
+} StatsQuery;
+
+/* session name -> GHashTable of counter name -> gint64 value */
+static GHashTable *query_sessions;
+
+static gboolean
+_is_literal(const gchar *pattern)
+{
+  return strpbrk(pattern, "*?") == NULL;
+}
+
+static gboolean
+_field_matches(StatsQuery *self, gint field, const gchar *value)
+{
+  return !self->fields[field] || g_pattern_match_string(self->fields[field], value);
+}
+
+static GHashTable *
+_new_value_table(void)
+{
+  return g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+}
+
+static void
+_query_init(StatsQuery *self, const gchar *pattern)
+{
+  gchar **fields = g_strsplit(pattern, ";", SQF_MAX);
+  gint i;
+
+  memset(self, 0, sizeof(*self));
+  for (i = 0; i < SQF_MAX && fields[i]; i++)
+    {
+      if (fields[i][0] == 0 || strcmp(fields[i], "*") == 0)
+        continue;
+      self->fields[i] = g_pattern_spec_new(fields[i]);
+      if (i == SQF_ID && _is_literal(fields[i]))
+        self->literal_id = g_strdup(fields[i]);
+    }
+  g_strfreev(fields);
+  self->result = g_string_sized_new(1024);
+}
+
+static void
+_query_destroy(StatsQuery *self)
+{
+  gint i;
+
+  for (i = 0; i < SQF_MAX; i++)
+    {
+      if (self->fields[i])
+        g_pattern_spec_free(self->fields[i]);
+    }
+  g_free(self->literal_id);
+}
+
+static gboolean
+_component_matches(gint component, gpointer user_data)
+{
+  StatsQuery *self = (StatsQuery *) user_data;
+  StatsCluster key;
+  gchar buf[32];
+
+  if (!self->fields[SQF_COMPONENT])
+    return TRUE;
+  key.component = component;
+  return _field_matches(self, SQF_COMPONENT, stats_cluster_get_component_name(&key, buf, sizeof(buf)));
+}
+
+static gint64
+_get_reported_value(StatsQuery *self, StatsCluster *sc, gint type, gint64 value)
+{
+  gchar buf[32];
+  gchar *name;
+  gint64 *previous = NULL;
+  gint64 *current;
+
+  if (!self->current_values)
+    return value;
+
+  name = g_strdup_printf("%s;%s;%s;%s", stats_cluster_get_component_name(sc, buf, sizeof(buf)),
+                         sc->id, sc->instance, stats_cluster_get_type_name(type));
+  if (self->previous_values)
+    previous = g_hash_table_lookup(self->previous_values, name);
+
+  current = g_new(gint64, 1);
+  *current = value;
+  g_hash_table_insert(self->current_values, name, current);
+
+  /* counters going backwards were reset in the meantime */
+  if (previous && !stats_cluster_is_gauge_type(type) && value >= *previous)
+    return value - *previous;
+  return value;
+}
+
+static void
+_query_counter(StatsCluster *sc, gint type, StatsCounterItem *counter, gpointer user_data)
+{
+  StatsQuery *self = (StatsQuery *) user_data;
+  gint64 value;
+
+  if (!_field_matches(self, SQF_TYPE, stats_cluster_get_type_name(type)))
+    return;
+
+  value = _get_reported_value(self, sc, type, stats_counter_get(counter));
+  stats_csv_format_counter(self->result, sc, type, value);
+}
+
+static void
+_query_cluster(StatsCluster *sc, gpointer user_data)
+{
+  StatsQuery *self = (StatsQuery *) user_data;
+
+  if (!_field_matches(self, SQF_ID, sc->id) || !_field_matches(self, SQF_INSTANCE, sc->instance))
+    return;
+  stats_cluster_foreach_counter(sc, _query_counter, self);
+}
+
+static gboolean
+_query_start_session(StatsQuery *self, const gchar *session)
+{
+  if (!query_sessions)
+    query_sessions = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_hash_table_destroy);
+
+  self->previous_values = g_hash_table_lookup(query_sessions, session);
+  if (!self->previous_values && g_hash_table_size(query_sessions) >= STATS_QUERY_MAX_SESSIONS)
+    return FALSE;
+  self->current_values = _new_value_table();
+  return TRUE;
+}
+
+static void
+_query_finish_session(StatsQuery *self, const gchar *session)
+{
+  /* frees previous_values, counters not matched this time are forgotten */
+  g_hash_table_replace(query_sessions, g_strdup(session), self->current_values);
+}
+
+/*
+ * stats_query:
+ * @pattern: the counters to report, see above
+ * @session: report the changes since the previous query of this session,
+ *           NULL to report the current values
+ *
+ * Returns the matching counters in the same format as the STATS command.
+ */
+GString *
+stats_query(const gchar *pattern, const gchar *session)
+{
+  StatsQuery query;
+
+  _query_init(&query, pattern);
+
+  stats_lock();
+  if (session && !_query_start_session(&query, session))
+    {
+      stats_unlock();
+      g_string_assign(query.result, "Too many stats query sessions");
+      _query_destroy(&query);
+      return query.result;
+    }
+
+  stats_csv_format_header(query.result);
+  stats_foreach_cluster_indexed(_component_matches, query.literal_id, _query_cluster, &query);
+
+  if (session)
+    _query_finish_session(&query, session);
+  stats_unlock();
+
+  _query_destroy(&query);
+  return query.result;
+}
+
+void
+stats_query_deinit(void)
+{
+  if (query_sessions)
+    g_hash_table_destroy(query_sessions);
+  query_sessions = NULL;
+}
@@ -22,12 +22,41 @@
  *
  */
 #include "stats/stats-registry.h"
+#include "mainloop-worker.h"
+#include "tls-support.h"
 
 #include <string.h>
 
 static GHashTable *counter_hash;
+/* component -> id -> GPtrArray of the StatsCluster instances, so that
+ * queries need not walk counter_hash, see stats_foreach_cluster_indexed() */
+static GHashTable *cluster_index;
 static GStaticMutex stats_mutex = G_STATIC_MUTEX_INIT;
 gboolean stats_locked;
+/* number of cluster snapshots that are still being iterated */
+static gint cluster_snapshots;
+
+/* an increment of a dynamic counter, not yet applied to counter_hash */
+typedef struct _StatsPendingIncrement
+{
+  gint stats_level;
+  gint component;
+  gchar *id;
+  gchar *instance;
+  gint count;
+  time_t timestamp;
+} StatsPendingIncrement;
+
+TLS_BLOCK_START
+{
+  /* StatsPendingIncrement of the current worker batch, NULL outside of it */
+  GHashTable *pending_increments;
+  WorkerBatchCallback pending_increments_cb;
+}
+TLS_BLOCK_END;
+
+#define pending_increments     __tls_deref(pending_increments)
+#define pending_increments_cb  __tls_deref(pending_increments_cb)
 
 void
 stats_lock(void)
@@ -43,6 +72,51 @@ stats_unlock(void)
   g_static_mutex_unlock(&stats_mutex);
 }
 
+static void
+_free_cluster_array(GPtrArray *clusters)
+{
+  g_ptr_array_free(clusters, TRUE);
+}
+
+static void
+_index_cluster(StatsCluster *sc)
+{
+  GHashTable *ids;
+  GPtrArray *clusters;
+
+  ids = g_hash_table_lookup(cluster_index, GINT_TO_POINTER(sc->component));
+  if (!ids)
+    {
+      ids = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) _free_cluster_array);
+      g_hash_table_insert(cluster_index, GINT_TO_POINTER(sc->component), ids);
+    }
+
+  clusters = g_hash_table_lookup(ids, sc->id);
+  if (!clusters)
+    {
+      clusters = g_ptr_array_sized_new(1);
+      g_hash_table_insert(ids, g_strdup(sc->id), clusters);
+    }
+  g_ptr_array_add(clusters, sc);
+}
+
+static void
+_unindex_cluster(StatsCluster *sc)
+{
+  GHashTable *ids;
+  GPtrArray *clusters;
+
+  ids = g_hash_table_lookup(cluster_index, GINT_TO_POINTER(sc->component));
+  clusters = ids ? g_hash_table_lookup(ids, sc->id) : NULL;
+  g_assert(clusters);
+
+  g_ptr_array_remove_fast(clusters, sc);
+  if (clusters->len == 0)
+    g_hash_table_remove(ids, sc->id);
+  if (g_hash_table_size(ids) == 0)
+    g_hash_table_remove(cluster_index, GINT_TO_POINTER(sc->component));
+}
+
 static StatsCluster *
 _grab_cluster(gint stats_level, gint component, const gchar *id, const gchar *instance, gboolean dynamic)
 {
@@ -68,6 +142,7 @@ _grab_cluster(gint stats_level, gint component, const gchar *id, const gchar *in
       sc = stats_cluster_new(component, id, instance);
       sc->dynamic = dynamic;
       g_hash_table_insert(counter_hash, sc, sc);
+      _index_cluster(sc);
     }
   else
     {
@@ -149,6 +224,114 @@ stats_register_and_increment_dynamic_counter(gint stats_level, gint component, c
   stats_unregister_dynamic_counter(handle, SC_TYPE_PROCESSED, &counter);
 }
 
+static guint
+_pending_increment_hash(const StatsPendingIncrement *self)
+{
+  return g_str_hash(self->id) + g_str_hash(self->instance) + self->component;
+}
+
+static gboolean
+_pending_increment_equal(const StatsPendingIncrement *p1, const StatsPendingIncrement *p2)
+{
+  return p1->component == p2->component && strcmp(p1->id, p2->id) == 0 && strcmp(p1->instance, p2->instance) == 0;
+}
+
+static void
+_pending_increment_free(StatsPendingIncrement *self)
+{
+  g_free(self->id);
+  g_free(self->instance);
+  g_free(self);
+}
+
+static void
+_apply_pending_increment(gpointer key, gpointer value, gpointer user_data)
+{
+  StatsPendingIncrement *pending = (StatsPendingIncrement *) value;
+  StatsCounterItem *counter, *stamp;
+  StatsCluster *handle;
+
+  handle = stats_register_dynamic_counter(pending->stats_level, pending->component, pending->id, pending->instance,
+                                          SC_TYPE_PROCESSED, &counter);
+  stats_counter_add(counter, pending->count);
+  if (pending->timestamp >= 0)
+    {
+      stats_register_associated_counter(handle, SC_TYPE_STAMP, &stamp);
+      stats_counter_set(stamp, pending->timestamp);
+      stats_unregister_dynamic_counter(handle, SC_TYPE_STAMP, &stamp);
+    }
+  stats_unregister_dynamic_counter(handle, SC_TYPE_PROCESSED, &counter);
+}
+
+/* invoked at the end of the batch of the worker thread */
+static void
+_apply_pending_increments(gpointer user_data)
+{
+  GHashTable *pending = pending_increments;
+
+  pending_increments = NULL;
+
+  stats_lock();
+  g_hash_table_foreach(pending, _apply_pending_increment, NULL);
+  stats_unlock();
+  g_hash_table_destroy(pending);
+}
+
+/*
+ * stats_increment_dynamic_counter_deferred
+ *
+ * Same as stats_register_and_increment_dynamic_counter(), except that
+ * stats_lock() must not be held: in worker threads the increments are
+ * collected per-thread, without locking, and applied with a single
+ * stats_lock() at the end of the batch (see
+ * main_loop_worker_invoke_batch_callbacks()).  Counters are therefore
+ * registered and updated with a delay of at most one batch.
+ */
+void
+stats_increment_dynamic_counter_deferred(gint stats_level, gint component, const gchar *id, const gchar *instance, time_t timestamp)
+{
+  StatsPendingIncrement key, *pending;
+
+  if (!stats_check_level(stats_level))
+    return;
+
+  if (main_loop_worker_get_thread_id() < 0)
+    {
+      stats_lock();
+      stats_register_and_increment_dynamic_counter(stats_level, component, id, instance, timestamp);
+      stats_unlock();
+      return;
+    }
+
+  if (!pending_increments)
+    {
+      pending_increments = g_hash_table_new_full((GHashFunc) _pending_increment_hash,
+                                                 (GEqualFunc) _pending_increment_equal,
+                                                 NULL, (GDestroyNotify) _pending_increment_free);
+      worker_batch_callback_init(&pending_increments_cb);
+      pending_increments_cb.func = _apply_pending_increments;
+      main_loop_worker_register_batch_callback(&pending_increments_cb);
+    }
+
+  key.component = component;
+  key.id = (gchar *) (id ? : "");
+  key.instance = (gchar *) (instance ? : "");
+
+  pending = g_hash_table_lookup(pending_increments, &key);
+  if (!pending)
+    {
+      pending = g_new0(StatsPendingIncrement, 1);
+      pending->stats_level = stats_level;
+      pending->component = component;
+      pending->id = g_strdup(key.id);
+      pending->instance = g_strdup(key.instance);
+      pending->timestamp = timestamp;
+      g_hash_table_insert(pending_increments, pending, pending);
+    }
+  pending->count++;
+  pending->timestamp = MAX(pending->timestamp, timestamp);
+}
+
 /**
  * stats_register_associated_counter:
  * @sc: the dynamic counter that was registered with stats_register_dynamic_counter
@@ -225,6 +408,52 @@ stats_foreach_cluster(StatsForeachClusterFunc func, gpointer user_data)
   g_hash_table_foreach(counter_hash, _foreach_cluster_helper, args);
 }
 
+static void
+_snapshot_cluster(StatsCluster *sc, gpointer user_data)
+{
+  GPtrArray *snapshot = (GPtrArray *) user_data;
+
+  g_ptr_array_add(snapshot, sc);
+}
+
+/*
+ * stats_registry_snapshot_clusters
+ *
+ * Returns the list of currently registered clusters, so that a long
+ * running query can walk them without holding stats_lock() for the whole
+ * iteration.  Pruning is suspended until the snapshot is released with
+ * stats_registry_release_snapshot(), the StatsCluster pointers remain
+ * valid until then.  Must be called with stats_lock() held.
+ */
+GPtrArray *
+stats_registry_snapshot_clusters(void)
+{
+  GPtrArray *snapshot;
+
+  g_assert(stats_locked);
+  snapshot = g_ptr_array_sized_new(g_hash_table_size(counter_hash));
+  stats_foreach_cluster(_snapshot_cluster, snapshot);
+  cluster_snapshots++;
+  return snapshot;
+}
+
+void
+stats_registry_release_snapshot(GPtrArray *snapshot)
+{
+  stats_lock();
+  g_assert(cluster_snapshots > 0);
+  cluster_snapshots--;
+  stats_unlock();
+  g_ptr_array_free(snapshot, TRUE);
+}
+
+gboolean
+stats_registry_has_snapshots(void)
+{
+  g_assert(stats_locked);
+  return cluster_snapshots > 0;
+}
+
 static gboolean
 _foreach_cluster_remove_helper(gpointer key, gpointer value, gpointer user_data)
 {
@@ -233,7 +462,10 @@ _foreach_cluster_remove_helper(gpointer key, gpointer value, gpointer user_data)
   gpointer func_data = args[1];
   StatsCluster *sc = (StatsCluster *) value;
   
-  return func(sc, func_data);
+  if (!func(sc, func_data))
+    return FALSE;
+  _unindex_cluster(sc);
+  return TRUE;
 }
 
 void
@@ -243,6 +475,72 @@ stats_foreach_cluster_remove(StatsForeachClusterRemoveFunc func, gpointer user_d
   g_hash_table_foreach_remove(counter_hash, _foreach_cluster_remove_helper, args);
 }
 
+typedef struct _StatsIndexWalk
+{
+  StatsClusterComponentFilterFunc component_filter;
+  const gchar *id;
+  StatsForeachClusterFunc func;
+  gpointer user_data;
+} StatsIndexWalk;
+
+static void
+_walk_cluster_array(GPtrArray *clusters, StatsIndexWalk *walk)
+{
+  gint i;
+
+  for (i = 0; i < clusters->len; i++)
+    walk->func((StatsCluster *) g_ptr_array_index(clusters, i), walk->user_data);
+}
+
+static void
+_walk_id(gpointer key, gpointer value, gpointer user_data)
+{
+  _walk_cluster_array((GPtrArray *) value, (StatsIndexWalk *) user_data);
+}
+
+static void
+_walk_component(gpointer key, gpointer value, gpointer user_data)
+{
+  StatsIndexWalk *walk = (StatsIndexWalk *) user_data;
+  GHashTable *ids = (GHashTable *) value;
+  GPtrArray *clusters;
+
+  if (walk->component_filter && !walk->component_filter(GPOINTER_TO_INT(key), walk->user_data))
+    return;
+
+  if (walk->id)
+    {
+      clusters = g_hash_table_lookup(ids, walk->id);
+      if (clusters)
+        _walk_cluster_array(clusters, walk);
+    }
+  else
+    {
+      g_hash_table_foreach(ids, _walk_id, walk);
+    }
+}
+
+/*
+ * stats_foreach_cluster_indexed:
+ * @component_filter: called for each registered component, clusters of
+ *                    the component are only visited if it returns TRUE,
+ *                    NULL visits all components
+ * @id: only visit clusters with this id, NULL visits all of them
+ *
+ * Same as stats_foreach_cluster(), but uses the component/id index, so
+ * the cost depends on the number of matching clusters instead of the
+ * size of the registry.  Must be called with stats_lock() held.
+ */
+void
+stats_foreach_cluster_indexed(StatsClusterComponentFilterFunc component_filter, const gchar *id,
+                              StatsForeachClusterFunc func, gpointer user_data)
+{
+  StatsIndexWalk walk = { component_filter, id, func, user_data };
+
+  g_assert(stats_locked);
+  g_hash_table_foreach(cluster_index, _walk_component, &walk);
+}
+
 static void
 _foreach_counter_helper(StatsCluster *sc, gpointer user_data)
 {
@@ -266,12 +564,15 @@ void
 stats_registry_init(void)
 {
   counter_hash = g_hash_table_new_full((GHashFunc) stats_cluster_hash, (GEqualFunc) stats_cluster_equal, NULL, (GDestroyNotify) stats_cluster_free);
+  cluster_index = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) g_hash_table_destroy);
   g_static_mutex_init(&stats_mutex);
 }
 
 void
 stats_registry_deinit(void)
 {
+  g_hash_table_destroy(cluster_index);
+  cluster_index = NULL;
   g_hash_table_destroy(counter_hash);
   counter_hash = NULL;
   g_static_mutex_free(&stats_mutex);
@@ -29,6 +29,7 @@
 
 typedef void (*StatsForeachClusterFunc)(StatsCluster *sc, gpointer user_data);
 typedef gboolean (*StatsForeachClusterRemoveFunc)(StatsCluster *sc, gpointer user_data);
+typedef gboolean (*StatsClusterComponentFilterFunc)(gint component, gpointer user_data);
 
 void stats_lock(void);
 void stats_unlock(void);
@@ -36,6 +37,7 @@ gboolean stats_check_level(gint level);
 void stats_register_counter(gint level, gint component, const gchar *id, const gchar *instance, StatsCounterType type, StatsCounterItem **counter);
 StatsCluster *stats_register_dynamic_counter(gint stats_level, gint component, const gchar *id, const gchar *instance, StatsCounterType type, StatsCounterItem **counter);
 void stats_register_and_increment_dynamic_counter(gint stats_level, gint component, const gchar *id, const gchar *instance, time_t timestamp);
+void stats_increment_dynamic_counter_deferred(gint stats_level, gint component, const gchar *id, const gchar *instance, time_t timestamp);
 void stats_register_associated_counter(StatsCluster *handle, StatsCounterType type, StatsCounterItem **counter);
 void stats_unregister_counter(gint component, const gchar *id, const gchar *instance, StatsCounterType type, StatsCounterItem **counter);
 void stats_unregister_dynamic_counter(StatsCluster *handle, StatsCounterType type, StatsCounterItem **counter);
@@ -43,6 +45,12 @@ void stats_unregister_dynamic_counter(StatsCluster *handle, StatsCounterType typ
 void stats_foreach_counter(StatsForeachCounterFunc func, gpointer user_data);
 void stats_foreach_cluster(StatsForeachClusterFunc func, gpointer user_data);
 void stats_foreach_cluster_remove(StatsForeachClusterRemoveFunc func, gpointer user_data);
+void stats_foreach_cluster_indexed(StatsClusterComponentFilterFunc component_filter, const gchar *id,
+                                   StatsForeachClusterFunc func, gpointer user_data);
+
+GPtrArray *stats_registry_snapshot_clusters(void);
+void stats_registry_release_snapshot(GPtrArray *snapshot);
+gboolean stats_registry_has_snapshots(void);
 
 void stats_registry_init(void);
 void stats_registry_deinit(void);
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "stats/stats-trace.h"
+#include "stats/stats-registry.h"
+#include "tls-support.h"
+
+static gint stats_trace_sampling;
+
+TLS_BLOCK_START
+{
+  /* messages left until the next sampled one in this thread */
+  gint trace_countdown;
+}
+TLS_BLOCK_END;
+
+#define trace_countdown  __tls_deref(trace_countdown)
+
+static const gchar *stage_names[STATS_TRACE_STAGE_MAX] =
+{
+  /* [STATS_TRACE_STAGE_PARSE] = */ "parse",
+  /* [STATS_TRACE_STAGE_ROUTE] = */ "route",
+  /* [STATS_TRACE_STAGE_QUEUE] = */ "queue",
+  /* [STATS_TRACE_STAGE_WRITE] = */ "write",
+};
+
+void
+stats_trace_set_sampling(gint sampling)
+{
+  stats_trace_sampling = sampling;
+}
+
+gint64
+stats_trace_now(void)
+{
+  GTimeVal now;
+
+  /* not cached_g_current_time(), stages are usually well below the
+   * granularity of the cached time */
+  g_get_current_time(&now);
+  return (gint64) now.tv_sec * G_USEC_PER_SEC + now.tv_usec;
+}
+
+void
+stats_trace_message_posted(LogMessage *msg)
+{
+  gint sampling = stats_trace_sampling;
+
+  if (G_LIKELY(sampling == 0))
+    return;
+
+  if (--trace_countdown > 0)
+    return;
+  trace_countdown = sampling;
+
+  msg->trace_stamps[LM_TRACE_POSTED] = stats_trace_now();
+  msg->trace_stamps[LM_TRACE_PARSED] = 0;
+  msg->trace_stamps[LM_TRACE_QUEUED] = 0;
+}
+
+/* the caller must hold the stats lock */
+void
+stats_register_trace_counters(const gchar *id, StatsTraceCounters *self)
+{
+  gint stage, i;
+
+  if (stats_trace_sampling == 0)
+    return;
+
+  for (stage = 0; stage < STATS_TRACE_STAGE_MAX; stage++)
+    for (i = 0; i < STATS_LATENCY_BUCKETS; i++)
+      stats_register_counter(STATS_LEVEL0, SCS_TRACE, id, stage_names[stage],
+                             SC_TYPE_LATENCY_1MS + i, &self->stages[stage].buckets[i]);
+}
+
+/* the caller must hold the stats lock */
+void
+stats_unregister_trace_counters(const gchar *id, StatsTraceCounters *self)
+{
+  gint stage, i;
+
+  if (!stats_trace_counters_enabled(self))
+    return;
+
+  for (stage = 0; stage < STATS_TRACE_STAGE_MAX; stage++)
+    for (i = 0; i < STATS_LATENCY_BUCKETS; i++)
+      stats_unregister_counter(SCS_TRACE, id, stage_names[stage],
+                               SC_TYPE_LATENCY_1MS + i, &self->stages[stage].buckets[i]);
+}
+
+static void
+_record_stage(StatsTraceCounters *self, StatsTraceStage stage, gint64 start, gint64 end)
+{
+  stats_latency_counters_record(&self->stages[stage], (glong) MAX(end - start, 0));
+}
+
+/*
+ * Accounts a message written by a destination, @popped is the time the
+ * destination took it from its queue, 0 if unknown.
+ */
+void
+stats_trace_counters_record(StatsTraceCounters *self, LogMessage *msg, gint64 popped)
+{
+  gint64 *stamps = msg->trace_stamps;
+  gint64 last;
+
+  if (!stats_trace_is_traced(msg) || !stats_trace_counters_enabled(self))
+    return;
+
+  last = stamps[LM_TRACE_POSTED];
+  if (stamps[LM_TRACE_PARSED])
+    {
+      _record_stage(self, STATS_TRACE_STAGE_PARSE, last, stamps[LM_TRACE_PARSED]);
+      last = stamps[LM_TRACE_PARSED];
+    }
+  if (stamps[LM_TRACE_QUEUED])
+    {
+      _record_stage(self, STATS_TRACE_STAGE_ROUTE, last, stamps[LM_TRACE_QUEUED]);
+      last = stamps[LM_TRACE_QUEUED];
+    }
+  if (popped)
+    {
+      _record_stage(self, STATS_TRACE_STAGE_QUEUE, last, popped);
+      last = popped;
+    }
+  _record_stage(self, STATS_TRACE_STAGE_WRITE, last, stats_trace_now());
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef STATS_TRACE_H_INCLUDED
+#define STATS_TRACE_H_INCLUDED 1
+
+#include "stats/stats-latency.h"
+#include "logmsg/logmsg.h"
+
+/*
+ * Sampled pipeline latency tracing
+ *
+ * With stats-trace-sampling(N), every Nth message posted by a source
+ * (counted per thread) records the time it was posted, the time its last
+ * parser completed and the time it was first pushed into a destination
+ * queue.  The destination adds the time it popped the message and the
+ * time its write completed, and accounts the time spent in each stage in
+ * a latency histogram of its own:
+ *
+ *   parse: posted -> parsed
+ *   route: parsed (or posted if there were no parsers) -> queued
+ *   queue: queued -> popped
+ *   write: popped -> written
+ *
+ * The histograms are stats clusters with the "trace" component, the id of
+ * the destination and the stage as instance, using the latency counter
+ * types.  Messages not sampled cost a single branch at each stage.
+ */
+typedef enum
+{
+  STATS_TRACE_STAGE_PARSE,
+  STATS_TRACE_STAGE_ROUTE,
+  STATS_TRACE_STAGE_QUEUE,
+  STATS_TRACE_STAGE_WRITE,
+  STATS_TRACE_STAGE_MAX
+} StatsTraceStage;
+
+typedef struct _StatsTraceCounters
+{
+  StatsLatencyCounters stages[STATS_TRACE_STAGE_MAX];
+} StatsTraceCounters;
+
+void stats_trace_set_sampling(gint sampling);
+gint64 stats_trace_now(void);
+void stats_trace_message_posted(LogMessage *msg);
+
+void stats_register_trace_counters(const gchar *id, StatsTraceCounters *self);
+void stats_unregister_trace_counters(const gchar *id, StatsTraceCounters *self);
+void stats_trace_counters_record(StatsTraceCounters *self, LogMessage *msg, gint64 popped);
+
+static inline gboolean
+stats_trace_is_traced(LogMessage *msg)
+{
+  return G_UNLIKELY(msg->trace_stamps[LM_TRACE_POSTED] != 0);
+}
+
+static inline gboolean
+stats_trace_counters_enabled(StatsTraceCounters *self)
+{
+  return stats_latency_counters_enabled(&self->stages[0]);
+}
+
+static inline void
+stats_trace_message_parsed(LogMessage *msg)
+{
+  /* a write protected message is shared with other paths, leave it alone */
+  if (stats_trace_is_traced(msg) && msg->protect_cnt == 0)
+    msg->trace_stamps[LM_TRACE_PARSED] = stats_trace_now();
+}
+
+/* only the first queue push is recorded, which happens before the message
+ * becomes visible to any of the destinations */
+static inline void
+stats_trace_message_queued(LogMessage *msg)
+{
+  if (stats_trace_is_traced(msg) && msg->trace_stamps[LM_TRACE_QUEUED] == 0)
+    msg->trace_stamps[LM_TRACE_QUEUED] = stats_trace_now();
+}
+
+#endif
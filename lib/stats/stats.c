@@ -26,6 +26,8 @@
 #include "stats/stats-syslog.h"
 #include "stats/stats-registry.h"
 #include "stats/stats-log.h"
+#include "stats/stats-trace.h"
+#include "stats/stats-query.h"
 #include "timeutils.h"
 
 #include <string.h>
@@ -76,7 +78,8 @@
  * without acquiring stats_lock().
  *
  * Counters are updated atomically by the use of the stats_counter_inc/dec()
- * methods.
+ * methods.  Worker threads update their own shard of the counter (see
+ * stats-counter.h), the shards are summed up when the counter is read.
  */
 
 StatsOptions *stats_options;
@@ -119,6 +122,8 @@ typedef struct _StatsTimerState
   time_t oldest_counter;
   gint dropped_counters;
   EVTREC *stats_event;
+  /* a stats query still refers to the clusters, don't free any of them */
+  gboolean keep_clusters;
 } StatsTimerState;
 
 static gboolean
@@ -144,6 +149,8 @@ stats_format_and_prune_cluster(StatsCluster *sc, gpointer user_data)
 
   if (st->stats_event)
     stats_log_format_cluster(sc, st->stats_event);
+  if (st->keep_clusters)
+    return FALSE;
   return stats_prune_counter(sc, st);
 }
 
@@ -162,6 +169,7 @@ stats_publish_and_prune_counters(void)
     st.stats_event = msg_event_create(EVT_PRI_INFO, "Log statistics", NULL);
 
   stats_lock();
+  st.keep_clusters = stats_registry_has_snapshots();
   stats_foreach_cluster_remove(stats_format_and_prune_cluster, &st);
   stats_unlock();
 
@@ -237,6 +245,7 @@ void
 stats_reinit(StatsOptions *options)
 {
   stats_options = options;
+  stats_trace_set_sampling(options->trace_sampling);
   stats_syslog_reinit();
   stats_timer_reinit();
 }
@@ -250,6 +259,7 @@ stats_init(void)
 void
 stats_destroy(void)
 {
+  stats_query_deinit();
   stats_registry_deinit();
 }
 
@@ -259,4 +269,5 @@ stats_options_defaults(StatsOptions *options)
   options->level = 0;
   options->log_freq = 600;
   options->lifetime = 600;
+  options->trace_sampling = 0;
 }
@@ -33,6 +33,8 @@ typedef struct _StatsOptions
   gint log_freq;
   gint level;
   gint lifetime;
+  /* trace 1 in trace_sampling messages through the pipeline, 0 disables */
+  gint trace_sampling;
 } StatsOptions;
 
 enum
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "testutils.h"
+#include "apphook.h"
+#include "stats/stats-cluster.h"
+#include "stats/stats-counter.h"
+#include "mainloop-worker.h"
+
+#define NUM_THREADS 20
+#define NUM_INCREMENTS 10000
+
+static StatsCounterItem *
+_new_counter(StatsCluster **sc, gint type)
+{
+  *sc = stats_cluster_new(SCS_SOURCE | SCS_FILE, "id", "instance");
+  return stats_cluster_track_counter(*sc, type);
+}
+
+static void
+test_counters_are_64_bits_wide(void)
+{
+  StatsCluster *sc;
+  StatsCounterItem *counter = _new_counter(&sc, SC_TYPE_PROCESSED);
+
+  stats_counter_add(counter, G_MAXINT);
+  stats_counter_add(counter, G_MAXINT);
+  stats_counter_inc(counter);
+  stats_counter_inc(counter);
+  assert_gint64(stats_counter_get(counter), G_GINT64_CONSTANT(4294967296), "Counter wrapped around at 32 bits");
+  stats_cluster_free(sc);
+}
+
+static StatsCounterItem *shared_counter;
+
+static gpointer
+_increment_from_worker(gpointer user_data)
+{
+  StatsCounterItem *counter = shared_counter;
+  gint i;
+
+  main_loop_worker_set_thread_id(GPOINTER_TO_INT(user_data));
+  for (i = 0; i < NUM_INCREMENTS; i++)
+    stats_counter_inc(counter);
+  return NULL;
+}
+
+static void
+test_updates_from_worker_threads_are_summed_up(void)
+{
+  StatsCluster *sc;
+  StatsCounterItem *counter = _new_counter(&sc, SC_TYPE_PROCESSED);
+  GThread *threads[NUM_THREADS];
+  gint i;
+
+  stats_counter_add(counter, 5);
+  shared_counter = counter;
+  for (i = 0; i < NUM_THREADS; i++)
+    threads[i] = g_thread_create(_increment_from_worker, GINT_TO_POINTER(i), TRUE, NULL);
+  for (i = 0; i < NUM_THREADS; i++)
+    g_thread_join(threads[i]);
+
+  assert_true(counter->shards != NULL, "Updates from worker threads did not use the shards");
+  assert_gint64(stats_counter_get(counter), 5 + NUM_THREADS * NUM_INCREMENTS, "Sharded counter sum mismatch");
+
+  stats_counter_set(counter, 0);
+  assert_gint64(stats_counter_get(counter), 0, "Setting a sharded counter does not clear its shards");
+  stats_cluster_free(sc);
+}
+
+static void
+test_gauges_are_not_sharded(void)
+{
+  StatsCluster *sc;
+  StatsCounterItem *counter = _new_counter(&sc, SC_TYPE_STORED);
+  GThread *thread;
+
+  shared_counter = counter;
+  thread = g_thread_create(_increment_from_worker, GINT_TO_POINTER(0), TRUE, NULL);
+  g_thread_join(thread);
+
+  assert_true(counter->shards == NULL, "Gauges should not be sharded");
+  assert_gint64(stats_counter_get(counter), NUM_INCREMENTS, "Gauge value mismatch");
+  stats_cluster_free(sc);
+}
+
+int
+main(int argc, char *argv[])
+{
+  app_startup();
+
+  test_counters_are_64_bits_wide();
+  test_updates_from_worker_threads_are_summed_up();
+  test_gauges_are_not_sharded();
+
+  app_shutdown();
+  return 0;
+}
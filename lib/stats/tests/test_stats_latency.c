@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "testutils.h"
+#include "stats/stats-latency.h"
+
+#include <string.h>
+
+static StatsCounterItem bucket_items[STATS_LATENCY_BUCKETS];
+
+static void
+_setup_latency_counters(StatsLatencyCounters *latency)
+{
+  gint i;
+
+  memset(bucket_items, 0, sizeof(bucket_items));
+  for (i = 0; i < STATS_LATENCY_BUCKETS; i++)
+    latency->buckets[i] = &bucket_items[i];
+}
+
+static void
+assert_latency_lands_in_bucket(glong latency_usec, gint expected_bucket)
+{
+  StatsLatencyCounters latency;
+  gint i;
+
+  _setup_latency_counters(&latency);
+  stats_latency_counters_record(&latency, latency_usec);
+  for (i = 0; i < STATS_LATENCY_BUCKETS; i++)
+    assert_gint(stats_counter_get(&bucket_items[i]), i == expected_bucket ? 1 : 0,
+                "Latency recorded in the wrong bucket; latency_usec=%ld, bucket=%d", latency_usec, i);
+}
+
+static void
+test_latency_buckets_have_decimal_boundaries(void)
+{
+  assert_latency_lands_in_bucket(0, 0);
+  assert_latency_lands_in_bucket(1000, 0);
+  assert_latency_lands_in_bucket(1001, 1);
+  assert_latency_lands_in_bucket(10000, 1);
+  assert_latency_lands_in_bucket(99999, 2);
+  assert_latency_lands_in_bucket(1000000, 3);
+  assert_latency_lands_in_bucket(10000000, 4);
+  assert_latency_lands_in_bucket(10000001, 5);
+  assert_latency_lands_in_bucket(G_MAXLONG, 5);
+}
+
+static void
+test_disabled_latency_counters_are_not_updated(void)
+{
+  StatsLatencyCounters latency;
+  LogStamp received;
+
+  memset(&latency, 0, sizeof(latency));
+  memset(&received, 0, sizeof(received));
+  assert_false(stats_latency_counters_enabled(&latency), "Latency counters without registration should be disabled");
+  stats_latency_counters_record_since(&latency, &received);
+}
+
+int
+main(int argc, char *argv[])
+{
+  test_latency_buckets_have_decimal_boundaries();
+  test_disabled_latency_counters_are_not_updated();
+  return 0;
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "testutils.h"
+#include "apphook.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-prometheus.h"
+
+/* NOTE: clusters stay registered after their counters are unregistered,
+ * the order of multiple clusters in the output is unspecified, so a
+ * single cluster is used */
+#define TEST_INSTANCE "/var/log/\"a\\b\nc\xff"
+#define TEST_LABELS "{component=\"src.file\",id=\"s_file\",instance=\"/var/log/\\\"a\\\\b\\nc?\"}"
+
+static void
+test_counters_are_grouped_into_families(void)
+{
+  StatsCounterItem *processed, *dropped, *stored;
+  gchar *output;
+
+  stats_lock();
+  stats_register_counter(0, SCS_SOURCE | SCS_FILE, "s_file", TEST_INSTANCE, SC_TYPE_PROCESSED, &processed);
+  stats_register_counter(0, SCS_SOURCE | SCS_FILE, "s_file", TEST_INSTANCE, SC_TYPE_DROPPED, &dropped);
+  stats_register_counter(0, SCS_SOURCE | SCS_FILE, "s_file", TEST_INSTANCE, SC_TYPE_STORED, &stored);
+  stats_unlock();
+
+  stats_counter_add(processed, 42);
+  stats_counter_set(stored, 3);
+
+  output = stats_generate_prometheus();
+  assert_string(output,
+                "# TYPE syslogng_dropped counter\n"
+                "syslogng_dropped_total" TEST_LABELS " 0\n"
+                "# TYPE syslogng_processed counter\n"
+                "syslogng_processed_total" TEST_LABELS " 42\n"
+                "# TYPE syslogng_stored gauge\n"
+                "syslogng_stored" TEST_LABELS " 3\n"
+                "# EOF\n",
+                "Unexpected Prometheus output");
+  g_free(output);
+
+  stats_lock();
+  stats_unregister_counter(SCS_SOURCE | SCS_FILE, "s_file", TEST_INSTANCE, SC_TYPE_PROCESSED, &processed);
+  stats_unregister_counter(SCS_SOURCE | SCS_FILE, "s_file", TEST_INSTANCE, SC_TYPE_DROPPED, &dropped);
+  stats_unregister_counter(SCS_SOURCE | SCS_FILE, "s_file", TEST_INSTANCE, SC_TYPE_STORED, &stored);
+  stats_unlock();
+}
+
+static void
+test_empty_registry_produces_eof_only(void)
+{
+  StatsPrometheusQuery *query;
+  GString *output = g_string_new("");
+
+  stats_destroy();
+  stats_init();
+
+  query = stats_prometheus_query_new();
+  assert_false(stats_prometheus_query_format_chunk(query, output), "Empty registry should fit into a single chunk");
+  stats_prometheus_query_free(query);
+  assert_string(output->str, "# EOF\n", "Unexpected output for an empty registry");
+  g_string_free(output, TRUE);
+}
+
+int
+main(int argc, char *argv[])
+{
+  app_startup();
+
+  test_counters_are_grouped_into_families();
+  test_empty_registry_produces_eof_only();
+
+  app_shutdown();
+  return 0;
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "testutils.h"
+#include "apphook.h"
+#include "stats/stats-registry.h"
+#include "mainloop-worker.h"
+
+typedef struct _CounterLookup
+{
+  const gchar *instance;
+  gint64 value;
+  gboolean found;
+} CounterLookup;
+
+static void
+_find_processed_counter(StatsCluster *sc, gint type, StatsCounterItem *counter, gpointer user_data)
+{
+  CounterLookup *lookup = (CounterLookup *) user_data;
+
+  if (type == SC_TYPE_PROCESSED && g_strcmp0(sc->instance, lookup->instance) == 0)
+    {
+      lookup->found = TRUE;
+      lookup->value = stats_counter_get(counter);
+    }
+}
+
+static CounterLookup
+_lookup_dynamic_counter(const gchar *instance)
+{
+  CounterLookup lookup = { instance, 0, FALSE };
+
+  stats_lock();
+  stats_foreach_counter(_find_processed_counter, &lookup);
+  stats_unlock();
+  return lookup;
+}
+
+static void
+test_increments_from_the_main_thread_are_applied_immediately(void)
+{
+  CounterLookup lookup;
+
+  stats_increment_dynamic_counter_deferred(2, SCS_HOST | SCS_SOURCE, NULL, "main-host", 1);
+  lookup = _lookup_dynamic_counter("main-host");
+  assert_true(lookup.found, "Dynamic counter was not registered from the main thread");
+  assert_gint64(lookup.value, 1, "Dynamic counter value mismatch");
+}
+
+static gpointer
+_increment_in_a_worker_batch(gpointer user_data)
+{
+  CounterLookup lookup;
+
+  main_loop_worker_thread_start(NULL);
+
+  stats_increment_dynamic_counter_deferred(2, SCS_HOST | SCS_SOURCE, NULL, "worker-host", 1);
+  stats_increment_dynamic_counter_deferred(2, SCS_HOST | SCS_SOURCE, NULL, "worker-host", 2);
+  stats_increment_dynamic_counter_deferred(3, SCS_HOST | SCS_SOURCE, NULL, "filtered-host", 2);
+
+  lookup = _lookup_dynamic_counter("worker-host");
+  assert_false(lookup.found, "Dynamic counter was registered before the end of the batch");
+
+  main_loop_worker_invoke_batch_callbacks();
+
+  lookup = _lookup_dynamic_counter("worker-host");
+  assert_true(lookup.found, "Dynamic counter was not registered at the end of the batch");
+  assert_gint64(lookup.value, 2, "Increments of the batch were not summed up");
+
+  lookup = _lookup_dynamic_counter("filtered-host");
+  assert_false(lookup.found, "Dynamic counter above stats-level() was registered");
+
+  main_loop_worker_thread_stop();
+  return NULL;
+}
+
+static void
+test_increments_from_workers_are_applied_at_the_end_of_the_batch(void)
+{
+  GThread *thread;
+
+  thread = g_thread_create(_increment_in_a_worker_batch, NULL, TRUE, NULL);
+  g_thread_join(thread);
+}
+
+static void
+_count_cluster(StatsCluster *sc, gpointer user_data)
+{
+  (*(gint *) user_data)++;
+}
+
+static gboolean
+_only_sources(gint component, gpointer user_data)
+{
+  return (component & SCS_SOURCE) != 0;
+}
+
+static gboolean
+_remove_orphaned_cluster(StatsCluster *sc, gpointer user_data)
+{
+  return sc->use_count == 0 && g_str_equal(sc->id, "s_indexed");
+}
+
+static gint
+_count_indexed_clusters(StatsClusterComponentFilterFunc filter, const gchar *id)
+{
+  gint count = 0;
+
+  stats_lock();
+  stats_foreach_cluster_indexed(filter, id, _count_cluster, &count);
+  stats_unlock();
+  return count;
+}
+
+static void
+test_indexed_walk_visits_the_matching_clusters_only(void)
+{
+  StatsCounterItem *first, *second, *dest;
+
+  stats_lock();
+  stats_register_counter(0, SCS_SOURCE | SCS_FILE, "s_indexed", "first", SC_TYPE_PROCESSED, &first);
+  stats_register_counter(0, SCS_SOURCE | SCS_FILE, "s_indexed", "second", SC_TYPE_PROCESSED, &second);
+  stats_register_counter(0, SCS_DESTINATION | SCS_FILE, "s_indexed", "first", SC_TYPE_PROCESSED, &dest);
+  stats_unlock();
+
+  assert_gint(_count_indexed_clusters(NULL, "s_indexed"), 3, "Clusters with the same id were not all visited");
+  assert_gint(_count_indexed_clusters(_only_sources, "s_indexed"), 2, "Component filter was not applied");
+  assert_gint(_count_indexed_clusters(NULL, "no_such_id"), 0, "Nonexistent id matched");
+
+  stats_lock();
+  stats_unregister_counter(SCS_SOURCE | SCS_FILE, "s_indexed", "first", SC_TYPE_PROCESSED, &first);
+  stats_unregister_counter(SCS_SOURCE | SCS_FILE, "s_indexed", "second", SC_TYPE_PROCESSED, &second);
+  stats_unregister_counter(SCS_DESTINATION | SCS_FILE, "s_indexed", "first", SC_TYPE_PROCESSED, &dest);
+  stats_foreach_cluster_remove(_remove_orphaned_cluster, NULL);
+  stats_unlock();
+
+  assert_gint(_count_indexed_clusters(NULL, "s_indexed"), 0, "Removed clusters are still indexed");
+}
+
+int
+main(int argc, char *argv[])
+{
+  StatsOptions options;
+
+  app_startup();
+  stats_options_defaults(&options);
+  options.level = 2;
+  stats_reinit(&options);
+
+  test_increments_from_the_main_thread_are_applied_immediately();
+  test_increments_from_workers_are_applied_at_the_end_of_the_batch();
+  test_indexed_walk_visits_the_matching_clusters_only();
+
+  app_shutdown();
+  return 0;
+}
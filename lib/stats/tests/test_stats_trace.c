@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "testutils.h"
+#include "apphook.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-trace.h"
+
+static void
+test_one_in_n_messages_is_sampled(void)
+{
+  LogMessage *msgs[6];
+  gint i;
+
+  stats_trace_set_sampling(3);
+  for (i = 0; i < 6; i++)
+    {
+      msgs[i] = log_msg_new_empty();
+      stats_trace_message_posted(msgs[i]);
+    }
+
+  for (i = 0; i < 6; i++)
+    {
+      assert_gboolean(stats_trace_is_traced(msgs[i]), i % 3 == 0, "Unexpected sampling decision for message %d", i);
+      log_msg_unref(msgs[i]);
+    }
+  stats_trace_set_sampling(0);
+}
+
+static void
+test_disabled_tracing_does_not_sample(void)
+{
+  LogMessage *msg = log_msg_new_empty();
+
+  stats_trace_message_posted(msg);
+  stats_trace_message_parsed(msg);
+  stats_trace_message_queued(msg);
+  assert_false(stats_trace_is_traced(msg), "Message traced with tracing disabled");
+  assert_gint64(msg->trace_stamps[LM_TRACE_QUEUED], 0, "Untraced message got a queue timestamp");
+  log_msg_unref(msg);
+}
+
+static void
+test_stages_are_accounted_separately(void)
+{
+  StatsTraceCounters counters = { { { NULL } } };
+  LogMessage *msg = log_msg_new_empty();
+  gint64 posted = stats_trace_now() - 2 * G_USEC_PER_SEC;
+
+  stats_trace_set_sampling(1);
+  stats_lock();
+  stats_register_trace_counters("d_trace", &counters);
+  stats_unlock();
+  assert_true(stats_trace_counters_enabled(&counters), "Trace counters were not registered");
+
+  msg->trace_stamps[LM_TRACE_POSTED] = posted;
+  msg->trace_stamps[LM_TRACE_PARSED] = posted + 500;
+  msg->trace_stamps[LM_TRACE_QUEUED] = posted + 50500;
+  stats_trace_counters_record(&counters, msg, posted + 550500);
+
+  /* buckets: <=1ms, <=10ms, <=100ms, <=1s, <=10s, slower */
+  assert_gint64(stats_counter_get(counters.stages[STATS_TRACE_STAGE_PARSE].buckets[0]), 1, "parse stage mismatch");
+  assert_gint64(stats_counter_get(counters.stages[STATS_TRACE_STAGE_ROUTE].buckets[2]), 1, "route stage mismatch");
+  assert_gint64(stats_counter_get(counters.stages[STATS_TRACE_STAGE_QUEUE].buckets[3]), 1, "queue stage mismatch");
+  assert_gint64(stats_counter_get(counters.stages[STATS_TRACE_STAGE_WRITE].buckets[4]), 1, "write stage mismatch");
+
+  stats_lock();
+  stats_unregister_trace_counters("d_trace", &counters);
+  stats_unlock();
+  stats_trace_set_sampling(0);
+  log_msg_unref(msg);
+}
+
+int
+main(int argc, char *argv[])
+{
+  app_startup();
+
+  test_one_in_n_messages_is_sampled();
+  test_disabled_tracing_does_not_sample();
+  test_stages_are_accounted_separately();
+
+  app_shutdown();
+  return 0;
+}
@@ -23,6 +23,14 @@
  */
 #include "str-utils.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define STR_SEARCH_SSE2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define STR_SEARCH_NEON 1
+#endif
+
 GString *
 g_string_assign_len(GString *s, const gchar *val, gint len)
 {
@@ -60,3 +68,252 @@ __normalize_key(const gchar* buffer)
 {
   return str_replace_char(buffer, '-', '_');
 }
+
+/* at most this many stop characters are checked a word at a time */
+#define STR_SPAN_MAX_WORD_STOP_CHARS 4
+
+#define STR_SPAN_ONES  ((guint64) 0x0101010101010101ULL)
+#define STR_SPAN_HIGHS ((guint64) 0x8080808080808080ULL)
+
+/* non-zero if any of the bytes in w is less than n (n <= 128) */
+#define STR_SPAN_HAS_LESS(w, n) (((w) - STR_SPAN_ONES * (n)) & ~(w) & STR_SPAN_HIGHS)
+#define STR_SPAN_HAS_ZERO(w)    STR_SPAN_HAS_LESS(w, 1)
+
+static inline gboolean
+_is_plain_char(guchar c, const gchar *stop_chars, gboolean allow_8bit)
+{
+  if (c < 0x20 || (c >= 0x80 && !allow_8bit))
+    return FALSE;
+  return strchr(stop_chars, c) == NULL;
+}
+
+static inline gboolean
+_word_has_special_char(guint64 w, const guchar *stop_chars, gint num_stop_chars, gboolean allow_8bit)
+{
+  guint64 special;
+  gint i;
+
+  special = STR_SPAN_HAS_LESS(w, 0x20);
+  if (!allow_8bit)
+    special |= w & STR_SPAN_HIGHS;
+  for (i = 0; i < num_stop_chars; i++)
+    special |= STR_SPAN_HAS_ZERO(w ^ (STR_SPAN_ONES * stop_chars[i]));
+  return special != 0;
+}
+
+/*
+ * Returns the length of the initial segment of @str that consists of
+ * characters that don't need escaping: no control characters, none of
+ * @stop_chars and (unless @allow_8bit is set) no bytes above 0x7f.
+ *
+ * Escaping functions use this to copy long runs of such characters in bulk
+ * and to only process the rest character by character.  The input is
+ * checked 8 bytes at a time using the usual bit tricks, so this works on
+ * any platform without SIMD instructions.
+ */
+gsize
+str_span_plain_chars(const gchar *str, gsize len, const gchar *stop_chars, gboolean allow_8bit)
+{
+  const guchar *p = (const guchar *) str;
+  const guchar *end = p + len;
+  gint num_stop_chars = strlen(stop_chars);
+
+  if (num_stop_chars <= STR_SPAN_MAX_WORD_STOP_CHARS)
+    {
+      while (end - p >= sizeof(guint64))
+        {
+          guint64 w;
+
+          memcpy(&w, p, sizeof(w));
+          if (_word_has_special_char(w, (const guchar *) stop_chars, num_stop_chars, allow_8bit))
+            break;
+          p += sizeof(w);
+        }
+    }
+
+  while (p < end && _is_plain_char(*p, stop_chars, allow_8bit))
+    p++;
+  return p - (const guchar *) str;
+}
+
+/* needles shorter than this are looked up using memchr() on their first byte */
+#define STR_SEARCH_MEMCHR_MAX_NEEDLE 4
+
+void
+str_search_init(StrSearch *self, const gchar *needle, gsize needle_len, gboolean icase)
+{
+  gsize i;
+
+  self->needle = g_strndup(needle, needle_len);
+  self->needle_len = needle_len;
+  self->icase = icase;
+
+  if (icase)
+    {
+      for (i = 0; i < needle_len; i++)
+        self->needle[i] = g_ascii_tolower(self->needle[i]);
+    }
+
+  for (i = 0; i < G_N_ELEMENTS(self->skip); i++)
+    self->skip[i] = needle_len;
+  for (i = 0; i + 1 < needle_len; i++)
+    {
+      guchar c = self->needle[i];
+
+      self->skip[c] = needle_len - 1 - i;
+      if (icase)
+        self->skip[(guchar) g_ascii_toupper(c)] = needle_len - 1 - i;
+    }
+}
+
+void
+str_search_clear(StrSearch *self)
+{
+  g_free(self->needle);
+  self->needle = NULL;
+}
+
+static inline gboolean
+_str_search_equal(const StrSearch *self, const gchar *s, gsize len)
+{
+  gsize i;
+
+  if (!self->icase)
+    return memcmp(s, self->needle, len) == 0;
+
+  for (i = 0; i < len; i++)
+    {
+      if (g_ascii_tolower(s[i]) != self->needle[i])
+        return FALSE;
+    }
+  return TRUE;
+}
+
+/*
+ * Case sensitive needles of at least two bytes are looked for 16 positions
+ * at a time: a position is a candidate if both the first and the last byte
+ * of the needle are found there, only candidates are compared in full.
+ */
+#if STR_SEARCH_SSE2 || STR_SEARCH_NEON
+static inline gboolean
+_str_search_is_match_at(const StrSearch *self, const gchar *p)
+{
+  gsize n = self->needle_len;
+
+  return p[0] == self->needle[0] && p[n - 1] == self->needle[n - 1] &&
+         memcmp(p + 1, self->needle + 1, n - 2) == 0;
+}
+
+static const gchar *
+_str_search_find_vectorized(const StrSearch *self, const gchar *haystack, gsize haystack_len)
+{
+  gsize n = self->needle_len;
+  const gchar *p = haystack;
+  const gchar *last = haystack + haystack_len - n;
+
+#if STR_SEARCH_SSE2
+  const __m128i first_byte = _mm_set1_epi8(self->needle[0]);
+  const __m128i last_byte = _mm_set1_epi8(self->needle[n - 1]);
+
+  /* both loads stay within the haystack as long as p + 15 <= last */
+  for (; last - p >= 15; p += 16)
+    {
+      __m128i heads = _mm_loadu_si128((const __m128i *) p);
+      __m128i tails = _mm_loadu_si128((const __m128i *) (p + n - 1));
+      guint mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(heads, first_byte),
+                                                   _mm_cmpeq_epi8(tails, last_byte)));
+
+      while (mask)
+        {
+          gint i = __builtin_ctz(mask);
+
+          if (memcmp(p + i + 1, self->needle + 1, n - 2) == 0)
+            return p + i;
+          mask &= mask - 1;
+        }
+    }
+#elif STR_SEARCH_NEON
+  const uint8x16_t first_byte = vdupq_n_u8(self->needle[0]);
+  const uint8x16_t last_byte = vdupq_n_u8(self->needle[n - 1]);
+  gint i;
+
+  for (; last - p >= 15; p += 16)
+    {
+      uint8x16_t heads = vld1q_u8((const guint8 *) p);
+      uint8x16_t tails = vld1q_u8((const guint8 *) (p + n - 1));
+
+      if (!vmaxvq_u8(vandq_u8(vceqq_u8(heads, first_byte), vceqq_u8(tails, last_byte))))
+        continue;
+      for (i = 0; i < 16; i++)
+        {
+          if (_str_search_is_match_at(self, p + i))
+            return p + i;
+        }
+    }
+#endif
+
+  for (; p <= last; p++)
+    {
+      if (_str_search_is_match_at(self, p))
+        return p;
+    }
+  return NULL;
+}
+#endif
+
+/*
+ * Returns the first occurrence of the needle in @haystack, or NULL.  The
+ * haystack does not need to be NUL terminated.
+ *
+ * Case sensitive needles are matched with SSE2/NEON where available, see
+ * above.  Otherwise short case sensitive needles are found by scanning for
+ * their first byte with memchr(), which libc implements with vector
+ * instructions on most platforms.  Everything else uses Horspool's algorithm: the last byte of
+ * the current window indexes the skip table, so a mismatch usually skips
+ * ahead by the length of the needle.  Case insensitive matching only folds
+ * ASCII letters.
+ */
+const gchar *
+str_search_find(const StrSearch *self, const gchar *haystack, gsize haystack_len)
+{
+  gsize n = self->needle_len;
+  const gchar *p, *last;
+
+  if (n == 0)
+    return haystack;
+  if (n > haystack_len)
+    return NULL;
+
+#if STR_SEARCH_SSE2 || STR_SEARCH_NEON
+  if (!self->icase && n >= 2)
+    return _str_search_find_vectorized(self, haystack, haystack_len);
+#endif
+
+  last = haystack + haystack_len - n;
+  if (!self->icase && n < STR_SEARCH_MEMCHR_MAX_NEEDLE)
+    {
+      p = haystack;
+      while (p <= last)
+        {
+          p = memchr(p, self->needle[0], last - p + 1);
+          if (!p)
+            return NULL;
+          if (memcmp(p + 1, self->needle + 1, n - 1) == 0)
+            return p;
+          p++;
+        }
+      return NULL;
+    }
+
+  p = haystack;
+  while (p <= last)
+    {
+      guchar c = p[n - 1];
+
+      if ((guchar) (self->icase ? g_ascii_tolower(c) : c) == (guchar) self->needle[n - 1] &&
+          _str_search_equal(self, p, n - 1))
+        return p;
+      p += self->skip[c];
+    }
+  return NULL;
+}
@@ -72,6 +72,21 @@ void g_string_steal(GString *s);
 
 gchar *__normalize_key(const gchar* buffer);
 
+gsize str_span_plain_chars(const gchar *str, gsize len, const gchar *stop_chars, gboolean allow_8bit);
+
+/* a substring search with a precomputed skip table, see str_search_find() */
+typedef struct _StrSearch
+{
+  gchar *needle;
+  gsize needle_len;
+  gboolean icase;
+  guint32 skip[256];
+} StrSearch;
+
+void str_search_init(StrSearch *self, const gchar *needle, gsize needle_len, gboolean icase);
+void str_search_clear(StrSearch *self);
+const gchar *str_search_find(const StrSearch *self, const gchar *haystack, gsize haystack_len);
+
 
 /* This version of strchr() is optimized for cases where the string we are
  * looking up characters in is often zero or one character in length.  In
@@ -43,6 +43,7 @@
 #define PATH_SYSLOGNG           SYSLOG_NG_PATH_LIBEXECDIR "/syslog-ng"
 #endif
 #define PATH_PERSIST_CONFIG     SYSLOG_NG_PATH_LOCALSTATEDIR "/syslog-ng.persist"
+#define PATH_PLUGIN_CACHE       SYSLOG_NG_PATH_LOCALSTATEDIR "/syslog-ng-plugins.cache"
 
 typedef struct _LogPipe LogPipe;
 typedef struct _LogMessage LogMessage;
@@ -26,7 +26,10 @@
 #include "template/templates.h"
 #include "template/repr.h"
 #include "template/macros.h"
+#include "template/simple-function.h"
+#include "logmsg/logmsg.h"
 #include "plugin.h"
+#include "cfg.h"
 
 static void
 log_template_add_macro_elem(LogTemplateCompiler *self, guint macro, gchar *default_value)
@@ -41,6 +44,10 @@ log_template_add_macro_elem(LogTemplateCompiler *self, guint macro, gchar *defau
   e->default_value = default_value;
   e->msg_ref = self->msg_ref;
   self->result = g_list_prepend(self->result, e);
+
+  /* $SDATA formats whatever .SDATA. values the message has */
+  if (macro == M_SDATA)
+    cfg_reference_all_values(self->template->cfg);
 }
 
 static void
@@ -58,12 +65,67 @@ log_template_add_value_elem(LogTemplateCompiler *self, gchar *value_name, gsize
   str = g_strndup(value_name, value_name_len);
   e->value_handle = log_msg_get_value_handle(str);
   g_free(str);
+  cfg_reference_value(self->template->cfg, e->value_handle);
 
   e->default_value = default_value;
   e->msg_ref = self->msg_ref;
   self->result = g_list_prepend(self->result, e);
 }
 
+static void
+log_template_free_function_state(LogTemplateElem *e)
+{
+  if (e->func.state)
+    {
+      e->func.ops->free_state(e->func.state);
+      g_free(e->func.state);
+    }
+  if (e->func.ops->free_fn)
+    e->func.ops->free_fn(e->func.ops);
+}
+
+/*
+ * Evaluates calls of pure functions with literal arguments at compile
+ * time and turns them into literal text of the element. Adjacent literals
+ * are merged by log_template_compiler_merge_literals() afterwards.
+ */
+static void
+log_template_fold_function_call(LogTemplateCompiler *self, LogTemplateElem *e)
+{
+  LogMessage *msg;
+  GPtrArray *bufs;
+  GString *result;
+  LogTemplateInvokeArgs args = { NULL, &msg, 1, NULL, LTZ_LOCAL, 0, NULL };
+  gint i;
+
+  if (!e->func.ops->pure || !self->template->cfg ||
+      !tf_simple_func_has_literal_args(e->func.ops, e->func.state))
+    return;
+
+  msg = log_msg_new_empty();
+  bufs = g_ptr_array_new();
+  result = g_string_new_len(e->text, e->text_len);
+  args.bufs = bufs;
+  args.opts = &self->template->cfg->template_options;
+
+  if (e->func.ops->eval)
+    e->func.ops->eval(e->func.ops, e->func.state, &args);
+  e->func.ops->call(e->func.ops, e->func.state, &args, result);
+
+  for (i = 0; i < bufs->len; i++)
+    g_string_free((GString *) g_ptr_array_index(bufs, i), TRUE);
+  g_ptr_array_free(bufs, TRUE);
+  log_msg_unref(msg);
+
+  log_template_free_function_state(e);
+  g_free(e->text);
+  e->text_len = result->len;
+  e->text = g_string_free(result, FALSE);
+  e->type = LTE_MACRO;
+  e->macro = M_NONE;
+  e->msg_ref = 0;
+}
+
 static gboolean
 log_template_prepare_function_call(LogTemplateCompiler *self, Plugin *p, LogTemplateElem *e, gint argc, gchar *argv[], GError **error)
 {
@@ -77,16 +139,11 @@ log_template_prepare_function_call(LogTemplateCompiler *self, Plugin *p, LogTemp
   memcpy(argv_copy, argv, (argc + 1) * sizeof(argv[0]));
   if (!e->func.ops->prepare(e->func.ops, e->func.state, self->template, argc, argv_copy, error))
     {
-      if (e->func.state)
-        {
-          e->func.ops->free_state(e->func.state);
-          g_free(e->func.state);
-        }
-      if (e->func.ops->free_fn)
-        e->func.ops->free_fn(e->func.ops);
+      log_template_free_function_state(e);
       return FALSE;
     }
   g_strfreev(argv);
+  log_template_fold_function_call(self, e);
   self->result = g_list_prepend(self->result, e);
   return TRUE;
 }
@@ -476,6 +533,37 @@ log_template_compiler_free_result(LogTemplateCompiler *self)
   self->result = NULL;
 }
 
+/* prepends the text of literal elements (e.g. folded function calls) to the element following them */
+static GList *
+log_template_compiler_merge_literals(GList *elems)
+{
+  GList *p = elems, *next;
+
+  while (p && p->next)
+    {
+      LogTemplateElem *e = (LogTemplateElem *) p->data;
+      LogTemplateElem *n = (LogTemplateElem *) p->next->data;
+      gchar *text;
+
+      next = p->next;
+      if (e->type == LTE_MACRO && e->macro == M_NONE && !e->default_value)
+        {
+          text = g_malloc(e->text_len + n->text_len + 1);
+          memcpy(text, e->text, e->text_len);
+          memcpy(text + e->text_len, n->text, n->text_len);
+          text[e->text_len + n->text_len] = 0;
+          g_free(n->text);
+          n->text = text;
+          n->text_len += e->text_len;
+
+          log_template_elem_free(e);
+          elems = g_list_delete_link(elems, p);
+        }
+      p = next;
+    }
+  return elems;
+}
+
 gboolean
 log_template_compiler_compile(LogTemplateCompiler *self, GList **compiled_template, GError **error)
 {
@@ -497,7 +585,7 @@ log_template_compiler_compile(LogTemplateCompiler *self, GList **compiled_templa
     }
   result = TRUE;
  error:
-  *compiled_template = g_list_reverse(self->result);
+  *compiled_template = log_template_compiler_merge_literals(g_list_reverse(self->result));
   self->result = NULL;
   return result;
 }
@@ -24,6 +24,7 @@
 
 #include "template/escaping.h"
 #include "str-format.h"
+#include "str-utils.h"
 
 #include <string.h>
 
@@ -31,6 +32,7 @@ void
 result_append(GString *result, const gchar *sstr, gssize len, gboolean escape)
 {
   gint i;
+  gsize plain_len;
   const guchar *ustr = (const guchar *) sstr;
 
   if (len < 0)
@@ -40,6 +42,15 @@ result_append(GString *result, const gchar *sstr, gssize len, gboolean escape)
     {
       for (i = 0; i < len; i++)
         {
+          plain_len = str_span_plain_chars((const gchar *) &ustr[i], len - i, "'\"\\", TRUE);
+          if (plain_len)
+            {
+              g_string_append_len(result, (const gchar *) &ustr[i], plain_len);
+              i += plain_len;
+              if (i == len)
+                break;
+            }
+
           if (ustr[i] == '\'' || ustr[i] == '"' || ustr[i] == '\\')
             {
               g_string_append_c(result, '\\');
@@ -37,7 +37,10 @@ typedef struct _LogTemplateInvokeArgs
 {
   /* scratch buffers, stores GString *, elements are managed by the
    * function, storage/free is performed by the core. Can be used to
-   * avoid allocating GString buffers in the fast-path. */
+   * avoid allocating GString buffers in the fast-path.  The array is
+   * taken from a per-thread pool for the duration of a single
+   * invocation, it may contain more elements than the number of
+   * arguments. */
 
   GPtrArray *bufs;
 
@@ -79,6 +82,11 @@ struct _LogTemplateFunction
 
   /* generic argument that can be used to pass information from registration time */
   gpointer arg;
+
+  /* the result only depends on the arguments, not on the message or the
+   * time of the call: invocations with literal arguments are evaluated
+   * once, when the template is compiled */
+  gboolean pure;
 };
 
 #define TEMPLATE_FUNCTION_PROTOTYPE(prefix) \
@@ -91,7 +99,7 @@ struct _LogTemplateFunction
   TEMPLATE_FUNCTION_PROTOTYPE(prefix);
 
 /* helper macros for template function plugins */
-#define TEMPLATE_FUNCTION(state_struct, prefix, prepare, eval, call, free_state, arg) \
+#define TEMPLATE_FUNCTION_WITH_PURITY(state_struct, prefix, prepare, eval, call, free_state, arg, pure) \
   TEMPLATE_FUNCTION_PROTOTYPE(prefix) 					\
   {                                                                     \
     static LogTemplateFunction func = {                                 \
@@ -101,11 +109,18 @@ struct _LogTemplateFunction
       call,                                                             \
       free_state,                                                       \
       NULL,								\
-      arg                                                               \
+      arg,                                                              \
+      pure                                                              \
     };                                                                  \
     return &func;                                                       \
   }
 
+#define TEMPLATE_FUNCTION(state_struct, prefix, prepare, eval, call, free_state, arg) \
+  TEMPLATE_FUNCTION_WITH_PURITY(state_struct, prefix, prepare, eval, call, free_state, arg, FALSE)
+
+#define TEMPLATE_FUNCTION_PURE(state_struct, prefix, prepare, eval, call, free_state, arg) \
+  TEMPLATE_FUNCTION_WITH_PURITY(state_struct, prefix, prepare, eval, call, free_state, arg, TRUE)
+
 #define TEMPLATE_FUNCTION_PLUGIN(x, tf_name) \
   {                                     \
     .type = LL_CONTEXT_TEMPLATE_FUNC,   \
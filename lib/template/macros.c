@@ -483,6 +483,40 @@ log_macro_expand(GString *result, gint id, gboolean escape, const LogTemplateOpt
         if (zone_ofs == -1)
           zone_ofs = stamp->zone_offset;
 
+        /* these don't need the broken down time, and the formatted
+         * timestamps are cached per second by log_stamp_append_format() */
+        switch (id)
+          {
+          case M_DATE:
+          case M_STAMP:
+          case M_ISODATE:
+          case M_FULLDATE:
+          case M_UNIXTIME:
+            {
+              gint format = id == M_DATE ? TS_FMT_BSD :
+                            id == M_ISODATE ? TS_FMT_ISO :
+                            id == M_FULLDATE ? TS_FMT_FULL :
+                            id == M_UNIXTIME ? TS_FMT_UNIX :
+                            opts->ts_format;
+
+              log_stamp_append_format(stamp, result, format, zone_ofs, opts->frac_digits);
+              return TRUE;
+            }
+          case M_TZ:
+          case M_TZOFFSET:
+            length = format_zone_info(buf, sizeof(buf), zone_ofs);
+            g_string_append_len(result, buf, length);
+            return TRUE;
+          case M_MSEC:
+            format_uint32_padded(result, 3, '0', 10, stamp->tv_usec/1000);
+            return TRUE;
+          case M_USEC:
+            format_uint32_padded(result, 6, '0', 10, stamp->tv_usec);
+            return TRUE;
+          default:
+            break;
+          }
+
         t = stamp->tv_sec + zone_ofs;
 
         cached_gmtime(&t, &tm_storage);
@@ -542,35 +576,9 @@ log_macro_expand(GString *result, gint id, gboolean escape, const LogTemplateOpt
           case M_SEC:
             format_uint32_padded(result, 2, '0', 10, tm->tm_sec);
             break;
-          case M_MSEC:
-            format_uint32_padded(result, 3, '0', 10, stamp->tv_usec/1000);
-            break;
-          case M_USEC:
-            format_uint32_padded(result, 6, '0', 10, stamp->tv_usec);
-            break;
           case M_AMPM:
             g_string_append(result, tm->tm_hour < 12 ? "AM" : "PM");
             break;
-          case M_DATE:
-          case M_STAMP:
-          case M_ISODATE:
-          case M_FULLDATE:
-          case M_UNIXTIME:
-            {
-              gint format = id == M_DATE ? TS_FMT_BSD :
-                            id == M_ISODATE ? TS_FMT_ISO :
-                            id == M_FULLDATE ? TS_FMT_FULL :
-                            id == M_UNIXTIME ? TS_FMT_UNIX :
-                            opts->ts_format;
-
-              log_stamp_append_format(stamp, result, format, zone_ofs, opts->frac_digits);
-              break;
-            }
-          case M_TZ:
-          case M_TZOFFSET:
-            length = format_zone_info(buf, sizeof(buf), zone_ofs);
-            g_string_append_len(result, buf, length);
-            break;
           }
         break;
       }
@@ -578,6 +586,99 @@ log_macro_expand(GString *result, gint id, gboolean escape, const LogTemplateOpt
   return TRUE;
 }
 
+/* returns the timestamp the $UNIXTIME family of macros would format, NULL for other macros */
+static const LogStamp *
+log_macro_get_unixtime_stamp(gint id, const LogMessage *msg, LogStamp *storage)
+{
+  GTimeVal tv;
+
+  if (id == M_UNIXTIME || id == M_UNIXTIME + M_STAMP_OFS)
+    return &msg->timestamps[LM_TS_STAMP];
+  if (id == M_UNIXTIME + M_RECVD_OFS)
+    return &msg->timestamps[LM_TS_RECVD];
+  if (id == M_UNIXTIME + M_CSTAMP_OFS)
+    {
+      cached_g_current_time(&tv);
+      storage->tv_sec = tv.tv_sec;
+      storage->tv_usec = tv.tv_usec;
+      storage->zone_offset = -1;
+      return storage;
+    }
+  return NULL;
+}
+
+/*
+ * Returns the value of macros that expand to a single integer without
+ * formatting them.  FALSE is returned for everything else (including an
+ * unset $SEQNUM and $UNIXTIME with fractional digits), the caller is
+ * expected to fall back to log_macro_expand() in that case.
+ */
+gboolean
+log_macro_expand_int64(gint id, const LogTemplateOptions *opts, gint32 seq_num, const LogMessage *msg, gint64 *value)
+{
+  const LogStamp *stamp;
+  LogStamp sstamp;
+
+  switch (id)
+    {
+    case M_FACILITY_NUM:
+      *value = (msg->pri & LOG_FACMASK) >> 3;
+      return TRUE;
+    case M_LEVEL_NUM:
+      *value = msg->pri & LOG_PRIMASK;
+      return TRUE;
+    case M_PRI:
+      *value = msg->pri;
+      return TRUE;
+    case M_SEQNUM:
+      if (!seq_num)
+        return FALSE;
+      *value = (guint32) seq_num;
+      return TRUE;
+    default:
+      break;
+    }
+
+  if (opts->frac_digits != 0)
+    return FALSE;
+
+  stamp = log_macro_get_unixtime_stamp(id, msg, &sstamp);
+  if (!stamp)
+    return FALSE;
+  *value = (guint32) stamp->tv_sec;
+  return TRUE;
+}
+
+/*
+ * Returns the milliseconds since the epoch the $UNIXTIME family of macros
+ * represents, with the same precision type_cast_to_datetime_int() would
+ * parse out of the formatted value.
+ */
+gboolean
+log_macro_expand_datetime(gint id, const LogTemplateOptions *opts, const LogMessage *msg, guint64 *value)
+{
+  const LogStamp *stamp;
+  LogStamp sstamp;
+  glong msec = 0;
+  gint digits, i;
+
+  stamp = log_macro_get_unixtime_stamp(id, msg, &sstamp);
+  if (!stamp)
+    return FALSE;
+
+  digits = MIN(opts->frac_digits, 3);
+  if (digits > 0)
+    {
+      msec = stamp->tv_usec;
+      for (i = digits; i < 6; i++)
+        msec /= 10;
+      for (i = digits; i < 3; i++)
+        msec *= 10;
+    }
+  *value = (guint64) (guint32) stamp->tv_sec * 1000 + msec;
+  return TRUE;
+}
+
 gboolean
 log_macro_expand_simple(GString *result, gint id, const LogMessage *msg)
 {
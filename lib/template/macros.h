@@ -113,6 +113,8 @@ extern LogMacroDef macros[];
 guint log_macro_lookup(gchar *macro, gint len);
 gboolean log_macro_expand(GString *result, gint id, gboolean escape, const LogTemplateOptions *opts, gint tz, gint32 seq_num, const gchar *context_id, const LogMessage *msg);
 gboolean log_macro_expand_simple(GString *result, gint id, const LogMessage *msg);
+gboolean log_macro_expand_int64(gint id, const LogTemplateOptions *opts, gint32 seq_num, const LogMessage *msg, gint64 *value);
+gboolean log_macro_expand_datetime(gint id, const LogTemplateOptions *opts, const LogMessage *msg, guint64 *value);
 
 void log_macros_global_init(void);
 void log_macros_global_deinit(void);
@@ -54,6 +54,7 @@ typedef struct _LogTemplateElem
   };
 } LogTemplateElem;
 
+void log_template_elem_free(LogTemplateElem *e);
 void log_template_elem_free_list(GList *el);
 
 
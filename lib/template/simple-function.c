@@ -90,6 +90,42 @@ tf_simple_func_call(LogTemplateFunction *self, gpointer s, const LogTemplateInvo
   simple_func(args->messages[args->num_messages-1], state->argc, (GString **) args->bufs->pdata, result);
 }
 
+void
+tf_simple_func_call_in_place(LogTemplateFunction *self, gpointer s, const LogTemplateInvokeArgs *args, GString *result)
+{
+  TFSimpleInPlaceFunc simple_func = (TFSimpleInPlaceFunc) self->arg;
+  TFSimpleFuncState *state = (TFSimpleFuncState *) s;
+  gsize start = result->len;
+  gint i;
+
+  for (i = 0; i < state->argc; i++)
+    {
+      log_template_append_format_recursive(state->argv[i], args, result);
+      if (i < state->argc - 1)
+        g_string_append_c(result, ' ');
+    }
+
+  simple_func(args->messages[args->num_messages-1], result, start);
+}
+
+/* TRUE if the function is a simple function and none of its arguments depend on the message */
+gboolean
+tf_simple_func_has_literal_args(LogTemplateFunction *self, gpointer s)
+{
+  TFSimpleFuncState *state = (TFSimpleFuncState *) s;
+  gint i;
+
+  if (self->prepare != tf_simple_func_prepare)
+    return FALSE;
+
+  for (i = 0; i < state->argc; i++)
+    {
+      if (!log_template_is_literal_string(state->argv[i]))
+        return FALSE;
+    }
+  return TRUE;
+}
+
 void
 tf_simple_func_free_state(gpointer s)
 {
@@ -37,11 +37,23 @@ typedef struct _TFSimpleFuncState
 
 typedef void (*TFSimpleFunc)(LogMessage *msg, gint argc, GString *argv[], GString *result);
 
+/* functions that transform their arguments (joined by spaces) in place:
+ * the arguments are formatted straight into result, and the function is
+ * expected to rewrite result->str from start onwards */
+typedef void (*TFSimpleInPlaceFunc)(LogMessage *msg, GString *result, gsize start);
+
 gboolean tf_simple_func_prepare(LogTemplateFunction *self, gpointer state, LogTemplate *parent, gint argc, gchar *argv[], GError **error);
 void tf_simple_func_eval(LogTemplateFunction *self, gpointer state, const LogTemplateInvokeArgs *args);
 void tf_simple_func_call(LogTemplateFunction *self, gpointer state, const LogTemplateInvokeArgs *args, GString *result);
+void tf_simple_func_call_in_place(LogTemplateFunction *self, gpointer state, const LogTemplateInvokeArgs *args, GString *result);
 void tf_simple_func_free_state(gpointer state);
+gboolean tf_simple_func_has_literal_args(LogTemplateFunction *self, gpointer state);
 
 #define TEMPLATE_FUNCTION_SIMPLE(x) TEMPLATE_FUNCTION(TFSimpleFuncState, x, tf_simple_func_prepare, tf_simple_func_eval, tf_simple_func_call, tf_simple_func_free_state, x)
+#define TEMPLATE_FUNCTION_SIMPLE_IN_PLACE(x) TEMPLATE_FUNCTION(TFSimpleFuncState, x, tf_simple_func_prepare, NULL, tf_simple_func_call_in_place, tf_simple_func_free_state, x)
+
+/* same as above, for functions whose result only depends on their arguments */
+#define TEMPLATE_FUNCTION_SIMPLE_PURE(x) TEMPLATE_FUNCTION_PURE(TFSimpleFuncState, x, tf_simple_func_prepare, tf_simple_func_eval, tf_simple_func_call, tf_simple_func_free_state, x)
+#define TEMPLATE_FUNCTION_SIMPLE_IN_PLACE_PURE(x) TEMPLATE_FUNCTION_PURE(TFSimpleFuncState, x, tf_simple_func_prepare, NULL, tf_simple_func_call_in_place, tf_simple_func_free_state, x)
 
 #endif
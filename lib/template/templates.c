@@ -27,12 +27,189 @@
 #include "template/macros.h"
 #include "template/escaping.h"
 #include "cfg.h"
+#include "scratch-buffers.h"
+
+/* don't preallocate more than this, even if we've seen larger results */
+#define LOG_TEMPLATE_MAX_SIZE_HINT 8192
+/* maximum length of a template result stored in the message */
+#define LOG_TEMPLATE_MAX_CACHED_RESULT 8192
+
+/* a formatted template stored in the LogMessage it was formatted from */
+typedef struct _LogTemplateCachedResult
+{
+  LogMessageCachedValue super;
+  guint cache_id;
+  gint tz;
+  gint ts_format;
+  gint frac_digits;
+  gchar *time_zone;
+  gsize len;
+  gchar value[0];
+} LogTemplateCachedResult;
+
+static volatile gint log_template_next_cache_id;
 
 static void
 log_template_reset_compiled(LogTemplate *self)
 {
   log_template_elem_free_list(self->compiled_template);
   self->compiled_template = NULL;
+  g_free(self->compiled_elems);
+  self->compiled_elems = NULL;
+  self->compiled_elems_len = 0;
+  self->single_macro = M_NONE;
+  self->single_message = FALSE;
+  self->size_hint = 0;
+}
+
+/* names of the macros that depend on the call site and not only on the message */
+static const gchar *log_template_uncacheable_names[] =
+{
+  "SEQNUM",
+  "CONTEXT_ID",
+  "SYSUPTIME",
+  "C_",
+  NULL
+};
+
+static gboolean
+log_template_elem_is_cacheable(LogTemplate *self, LogTemplateElem *e)
+{
+  gint i;
+
+  if (e->msg_ref)
+    return FALSE;
+
+  switch (e->type)
+    {
+    case LTE_MACRO:
+      return e->macro != M_SEQNUM && e->macro != M_CONTEXT_ID && e->macro != M_SYSUPTIME &&
+             e->macro < M_TIME_FIRST + M_CSTAMP_OFS;
+    case LTE_FUNC:
+      /* the arguments of template functions are opaque to us, be
+       * conservative and look at the template source */
+      for (i = 0; log_template_uncacheable_names[i]; i++)
+        {
+          if (strstr(self->template, log_template_uncacheable_names[i]))
+            return FALSE;
+        }
+      return TRUE;
+    default:
+      return TRUE;
+    }
+}
+
+static void
+log_template_flatten_compiled(LogTemplate *self)
+{
+  GList *p;
+  gint i = 0;
+
+  self->compiled_elems_len = g_list_length(self->compiled_template);
+  self->compiled_elems = g_new(LogTemplateElem, self->compiled_elems_len);
+  self->cacheable = TRUE;
+  self->single_macro = M_NONE;
+  self->single_message = TRUE;
+  for (p = self->compiled_template; p; p = g_list_next(p))
+    {
+      self->compiled_elems[i] = *(LogTemplateElem *) p->data;
+      if (!log_template_elem_is_cacheable(self, &self->compiled_elems[i]))
+        self->cacheable = FALSE;
+      if (self->compiled_elems[i].type == LTE_FUNC || self->compiled_elems[i].msg_ref)
+        self->single_message = FALSE;
+      i++;
+    }
+
+  if (self->compiled_elems_len == 1)
+    {
+      LogTemplateElem *e = &self->compiled_elems[0];
+
+      if (e->type == LTE_MACRO && e->text_len == 0 && !e->default_value && !e->msg_ref)
+        self->single_macro = e->macro;
+    }
+}
+
+static void
+log_template_renew_cache_id(LogTemplate *self)
+{
+  self->cache_id = (guint) g_atomic_int_exchange_and_add(&log_template_next_cache_id, 1);
+}
+
+static void
+log_template_cached_result_free(LogMessageCachedValue *s)
+{
+  LogTemplateCachedResult *self = (LogTemplateCachedResult *) s;
+
+  g_free(self->time_zone);
+  g_free(self);
+}
+
+static inline gboolean
+log_template_cached_result_matches(LogTemplateCachedResult *self, LogTemplate *template, const LogTemplateOptions *opts, gint tz)
+{
+  return self->cache_id == template->cache_id &&
+         self->tz == tz &&
+         self->ts_format == opts->ts_format &&
+         self->frac_digits == opts->frac_digits &&
+         g_strcmp0(self->time_zone, opts->time_zone[tz]) == 0;
+}
+
+static LogTemplateCachedResult *
+log_template_lookup_cached_result(LogTemplate *self, LogMessage *msg, const LogTemplateOptions *opts, gint tz)
+{
+  LogMessageCachedValue *value;
+
+  for (value = log_msg_get_cached_values(msg); value; value = value->next)
+    {
+      if (value->free_fn == log_template_cached_result_free &&
+          log_template_cached_result_matches((LogTemplateCachedResult *) value, self, opts, tz))
+        return (LogTemplateCachedResult *) value;
+    }
+  return NULL;
+}
+
+static void
+log_template_store_cached_result(LogTemplate *self, LogMessage *msg, const LogTemplateOptions *opts, gint tz,
+                                 const gchar *value, gsize value_len)
+{
+  LogTemplateCachedResult *result;
+
+  if (value_len > LOG_TEMPLATE_MAX_CACHED_RESULT)
+    return;
+
+  result = g_malloc(sizeof(LogTemplateCachedResult) + value_len);
+  result->super.free_fn = log_template_cached_result_free;
+  result->cache_id = self->cache_id;
+  result->tz = tz;
+  result->ts_format = opts->ts_format;
+  result->frac_digits = opts->frac_digits;
+  result->time_zone = g_strdup(opts->time_zone[tz]);
+  result->len = value_len;
+  memcpy(result->value, value, value_len);
+
+  if (!log_msg_add_cached_value(msg, &result->super))
+    log_template_cached_result_free(&result->super);
+}
+
+static inline void
+log_template_reserve_result(LogTemplate *self, GString *result)
+{
+  gsize len = result->len;
+
+  if (self->size_hint <= 0 || result->allocated_len > len + self->size_hint)
+    return;
+
+  g_string_set_size(result, len + self->size_hint);
+  g_string_truncate(result, len);
+}
+
+static inline void
+log_template_update_size_hint(LogTemplate *self, gint size)
+{
+  /* NOTE: templates are formatted from multiple threads, but this is only
+   * a hint, a lost update does no harm */
+  if (size > self->size_hint)
+    self->size_hint = MIN(size, LOG_TEMPLATE_MAX_SIZE_HINT);
 }
 
 gboolean
@@ -51,13 +228,38 @@ log_template_compile(LogTemplate *self, const gchar *template, GError **error)
   log_template_compiler_init(&compiler, self);
   result = log_template_compiler_compile(&compiler, &self->compiled_template, error);
   log_template_compiler_clear(&compiler);
+  log_template_flatten_compiled(self);
+  log_template_renew_cache_id(self);
   return result;
 }
 
+/* TRUE if the template expands to the same text for every message */
+gboolean
+log_template_is_literal_string(const LogTemplate *self)
+{
+  gint i;
+
+  for (i = 0; i < self->compiled_elems_len; i++)
+    {
+      LogTemplateElem *e = &self->compiled_elems[i];
+
+      if (e->type != LTE_MACRO || e->macro != M_NONE || e->default_value)
+        return FALSE;
+    }
+  return TRUE;
+}
+
 void
 log_template_set_escape(LogTemplate *self, gboolean enable)
 {
   self->escape = enable;
+  log_template_renew_cache_id(self);
+}
+
+void
+log_template_set_cache_results(LogTemplate *self, gboolean enable)
+{
+  self->cache_results = enable;
 }
 
 gboolean
@@ -68,21 +270,107 @@ log_template_set_type_hint(LogTemplate *self, const gchar *type_hint, GError **e
   return type_hint_parse(type_hint, &self->type_hint, error);
 }
 
+/*
+ * Returns the handle of the name-value pair if the template is a single
+ * value reference (e.g. "${bytes}") that expands to the value as is, 0
+ * otherwise.  Such templates can be evaluated with log_msg_get_value().
+ */
+NVHandle
+log_template_get_single_value_handle(const LogTemplate *self)
+{
+  LogTemplateElem *e;
+
+  if (self->compiled_elems_len != 1 || self->escape)
+    return 0;
+
+  e = &self->compiled_elems[0];
+  if (e->type != LTE_VALUE || e->text_len != 0 || e->default_value || e->msg_ref)
+    return 0;
+  return e->value_handle;
+}
+
+gboolean
+log_template_format_int64(LogTemplate *self, LogMessage *lm, const LogTemplateOptions *opts, gint32 seq_num, gint64 *value)
+{
+  if (self->single_macro == M_NONE)
+    return FALSE;
+  if (!opts)
+    opts = &self->cfg->template_options;
+  return log_macro_expand_int64(self->single_macro, opts, seq_num, lm, value);
+}
+
+gboolean
+log_template_format_datetime(LogTemplate *self, LogMessage *lm, const LogTemplateOptions *opts, guint64 *value)
+{
+  if (self->single_macro == M_NONE)
+    return FALSE;
+  if (!opts)
+    opts = &self->cfg->template_options;
+  return log_macro_expand_datetime(self->single_macro, opts, lm, value);
+}
+
+/*
+ * Formatter for the most common kind of templates: literal text, macros
+ * and name-value pairs of a single message.  As there is nothing to
+ * resolve per element, the loop is reduced to the minimum and the
+ * escaping decision is hoisted out of it.
+ */
+static void
+log_template_append_format_single_message(LogTemplate *self, LogMessage *msg, const LogTemplateOptions *opts, gint tz, gint32 seq_num, const gchar *context_id, GString *result)
+{
+  LogTemplateElem *e, *end;
+  const gboolean escape = self->escape;
+
+  end = self->compiled_elems + self->compiled_elems_len;
+  for (e = self->compiled_elems; e < end; e++)
+    {
+      if (e->text_len)
+        g_string_append_len(result, e->text, e->text_len);
+
+      if (e->type == LTE_VALUE)
+        {
+          gssize value_len = -1;
+          const gchar *value = log_msg_get_value(msg, e->value_handle, &value_len);
+
+          if (value && value[0])
+            result_append(result, value, value_len, escape);
+          else if (e->default_value)
+            result_append(result, e->default_value, -1, escape);
+        }
+      else if (e->macro)
+        {
+          gsize len = result->len;
+
+          log_macro_expand(result, e->macro, escape, opts, tz, seq_num, context_id, msg);
+          if (len == result->len && e->default_value)
+            g_string_append(result, e->default_value);
+        }
+    }
+}
 
 void
 log_template_append_format_with_context(LogTemplate *self, LogMessage **messages, gint num_messages, const LogTemplateOptions *opts, gint tz, gint32 seq_num, const gchar *context_id, GString *result)
 {
-  GList *p;
-  LogTemplateElem *e;
+  LogTemplateElem *e, *end;
+  gsize start_len = result->len;
 
   if (!opts)
     opts = &self->cfg->template_options;
 
-  for (p = self->compiled_template; p; p = g_list_next(p))
+  log_template_reserve_result(self, result);
+  if (self->single_message && num_messages > 0)
+    {
+      /* without msg_refs every element uses the last message */
+      log_template_append_format_single_message(self, messages[num_messages - 1], opts, tz, seq_num, context_id, result);
+      log_template_update_size_hint(self, result->len - start_len);
+      return;
+    }
+
+  end = self->compiled_elems + self->compiled_elems_len;
+  for (e = self->compiled_elems; e < end; e++)
     {
       gint msg_ndx;
 
-      e = (LogTemplateElem *) p->data;
       if (e->text)
         {
           g_string_append_len(result, e->text, e->text_len);
@@ -122,7 +410,7 @@ log_template_append_format_with_context(LogTemplate *self, LogMessage **messages
 
             if (e->macro)
               {
-                log_macro_expand(result, e->macro, self->escape, opts ? opts : &self->cfg->template_options, tz, seq_num, context_id, messages[msg_ndx]);
+                log_macro_expand(result, e->macro, self->escape, opts, tz, seq_num, context_id, messages[msg_ndx]);
                 if (len == result->len && e->default_value)
                   g_string_append(result, e->default_value);
               }
@@ -130,38 +418,34 @@ log_template_append_format_with_context(LogTemplate *self, LogMessage **messages
           }
         case LTE_FUNC:
           {
-            g_static_mutex_lock(&self->arg_lock);
-            if (!self->arg_bufs)
-              self->arg_bufs = g_ptr_array_sized_new(0);
-
-            if (1)
+            /* argument buffers are taken per invocation, function
+             * arguments may recursively invoke template functions */
+            SBGStringArray *arg_bufs = sb_gstring_array_acquire();
+            LogTemplateInvokeArgs args =
               {
-                LogTemplateInvokeArgs args =
-                  {
-                    self->arg_bufs,
-                    e->msg_ref ? &messages[msg_ndx] : messages,
-                    e->msg_ref ? 1 : num_messages,
-                    opts,
-                    tz,
-                    seq_num,
-                    context_id
-                  };
-
-
-                /* if a function call is called with an msg_ref, we only
-                 * pass that given logmsg to argument resolution, otherwise
-                 * we pass the whole set so the arguments can individually
-                 * specify which message they want to resolve from
-                 */
-                if (e->func.ops->eval)
-                  e->func.ops->eval(e->func.ops, e->func.state, &args);
-                e->func.ops->call(e->func.ops, e->func.state, &args, result);
-              }
-            g_static_mutex_unlock(&self->arg_lock);
+                sb_gstring_array_strings(arg_bufs),
+                e->msg_ref ? &messages[msg_ndx] : messages,
+                e->msg_ref ? 1 : num_messages,
+                opts,
+                tz,
+                seq_num,
+                context_id
+              };
+
+            /* if a function call is called with an msg_ref, we only
+             * pass that given logmsg to argument resolution, otherwise
+             * we pass the whole set so the arguments can individually
+             * specify which message they want to resolve from
+             */
+            if (e->func.ops->eval)
+              e->func.ops->eval(e->func.ops, e->func.state, &args);
+            e->func.ops->call(e->func.ops, e->func.state, &args, result);
+            sb_gstring_array_release(arg_bufs);
             break;
           }
         }
     }
+  log_template_update_size_hint(self, result->len - start_len);
 }
 
 void
@@ -174,7 +458,28 @@ log_template_format_with_context(LogTemplate *self, LogMessage **messages, gint
 void
 log_template_append_format(LogTemplate *self, LogMessage *lm, const LogTemplateOptions *opts, gint tz, gint32 seq_num, const gchar *context_id, GString *result)
 {
+  LogTemplateCachedResult *cached;
+  gsize start_len;
+
+  if (!self->cache_results || !self->cacheable)
+    {
+      log_template_append_format_with_context(self, &lm, 1, opts, tz, seq_num, context_id, result);
+      return;
+    }
+
+  if (!opts)
+    opts = &self->cfg->template_options;
+
+  cached = log_template_lookup_cached_result(self, lm, opts, tz);
+  if (cached)
+    {
+      g_string_append_len(result, cached->value, cached->len);
+      return;
+    }
+
+  start_len = result->len;
   log_template_append_format_with_context(self, &lm, 1, opts, tz, seq_num, context_id, result);
+  log_template_store_cached_result(self, lm, opts, tz, result->str + start_len, result->len - start_len);
 }
 
 void
@@ -184,6 +489,42 @@ log_template_format(LogTemplate *self, LogMessage *lm, const LogTemplateOptions
   log_template_append_format(self, lm, opts, tz, seq_num, context_id, result);
 }
 
+/*
+ * Formats the template for each of the messages (as separate messages,
+ * not as a context), concatenated into result.  offsets[i] returns where
+ * the result of messages[i] starts, offsets[num_messages] is the end of
+ * the last one, so offsets needs num_messages + 1 items.  seq_num is
+ * incremented for each message, unless it is 0.
+ *
+ * This is meant for destinations building a bulk payload: the output is
+ * allocated once for the whole batch and the options are resolved only
+ * once.
+ */
+void
+log_template_format_batch(LogTemplate *self, LogMessage **messages, gint num_messages, const LogTemplateOptions *opts, gint tz, gint32 seq_num, const gchar *context_id, GString *result, gsize *offsets)
+{
+  gsize batch_hint;
+  gint i;
+
+  if (!opts)
+    opts = &self->cfg->template_options;
+
+  g_string_truncate(result, 0);
+  batch_hint = (gsize) self->size_hint * num_messages;
+  if (result->allocated_len <= batch_hint)
+    {
+      g_string_set_size(result, batch_hint);
+      g_string_truncate(result, 0);
+    }
+
+  for (i = 0; i < num_messages; i++)
+    {
+      offsets[i] = result->len;
+      log_template_append_format(self, messages[i], opts, tz, seq_num ? seq_num + i : 0, context_id, result);
+    }
+  offsets[num_messages] = result->len;
+}
+
 
 /* NOTE: we should completely get rid off the name property of templates,
  * we basically use it at two locations:
@@ -224,7 +565,7 @@ log_template_new(GlobalConfig *cfg, const gchar *name)
   log_template_set_name(self, name);
   self->ref_cnt = 1;
   self->cfg = cfg;
-  g_static_mutex_init(&self->arg_lock);
+  log_template_renew_cache_id(self);
   if (cfg_is_config_version_older(cfg, 0x0300))
     {
       msg_warning_once("WARNING: template: the default value for template-escape has changed to 'no' from " VERSION_3_0 ", please update your configuration file accordingly",
@@ -237,18 +578,9 @@ log_template_new(GlobalConfig *cfg, const gchar *name)
 static void
 log_template_free(LogTemplate *self)
 {
-  if (self->arg_bufs)
-    {
-      gint i;
-
-      for (i = 0; i < self->arg_bufs->len; i++)
-        g_string_free(g_ptr_array_index(self->arg_bufs, i), TRUE);
-      g_ptr_array_free(self->arg_bufs, TRUE);
-    }
   log_template_reset_compiled(self);
   g_free(self->name);
   g_free(self->template);
-  g_static_mutex_free(&self->arg_lock);
   g_free(self);
 }
 
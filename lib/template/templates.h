@@ -29,6 +29,7 @@
 #include "common-template-typedefs.h"
 #include "timeutils.h"
 #include "type-hinting.h"
+#include "logmsg/nvtable.h"
 
 #define LTZ_LOCAL 0
 #define LTZ_SEND  1
@@ -60,11 +61,25 @@ typedef struct _LogTemplate
   gchar *name;
   gchar *template;
   GList *compiled_template;
+  /* the elements of compiled_template copied into a single array, used
+   * when formatting, the pointers in them are owned by the list */
+  struct _LogTemplateElem *compiled_elems;
+  gint compiled_elems_len;
+  /* largest result produced so far, used to preallocate the output */
+  gint size_hint;
+  /* cache the results in the messages formatted, see template-cache() */
+  gboolean cache_results;
+  /* the compiled template only depends on the message and the options */
+  gboolean cacheable;
+  /* identifies the results of this template (and compilation) in the message cache */
+  guint cache_id;
+  /* no template functions and no message references, formatted by a specialized loop */
+  gboolean single_message;
+  /* the template is a single macro and nothing else, see log_template_format_int64() */
+  guint single_macro;
   gboolean escape;
   gboolean def_inline;
   GlobalConfig *cfg;
-  GStaticMutex arg_lock;
-  GPtrArray *arg_bufs;
   TypeHint type_hint;
 } LogTemplate;
 
@@ -91,14 +106,24 @@ struct _LogTemplateOptions
 /* appends the formatted output into result */
 
 void log_template_set_escape(LogTemplate *self, gboolean enable);
+void log_template_set_cache_results(LogTemplate *self, gboolean enable);
 gboolean log_template_set_type_hint(LogTemplate *self, const gchar *hint, GError **error);
 gboolean log_template_compile(LogTemplate *self, const gchar *template, GError **error);
+gboolean log_template_is_literal_string(const LogTemplate *self);
+NVHandle log_template_get_single_value_handle(const LogTemplate *self);
 void log_template_format(LogTemplate *self, LogMessage *lm, const LogTemplateOptions *opts, gint tz, gint32 seq_num, const gchar *context_id, GString *result);
 void log_template_append_format(LogTemplate *self, LogMessage *lm, const LogTemplateOptions *opts, gint tz, gint32 seq_num, const gchar *context_id, GString *result);
 void log_template_append_format_with_context(LogTemplate *self, LogMessage **messages, gint num_messages, const LogTemplateOptions *opts, gint tz, gint32 seq_num, const gchar *context_id, GString *result);
 void log_template_format_with_context(LogTemplate *self, LogMessage **messages, gint num_messages, const LogTemplateOptions *opts, gint tz, gint32 seq_num, const gchar *context_id, GString *result);
+void log_template_format_batch(LogTemplate *self, LogMessage **messages, gint num_messages, const LogTemplateOptions *opts, gint tz, gint32 seq_num, const gchar *context_id, GString *result, gsize *offsets);
 void log_template_set_name(LogTemplate *self, const gchar *name);
 
+/* typed results of templates consisting of a single numeric macro, without
+ * a format-then-parse roundtrip.  FALSE means the caller has to format the
+ * template and use the type_cast_*() functions instead */
+gboolean log_template_format_int64(LogTemplate *self, LogMessage *lm, const LogTemplateOptions *opts, gint32 seq_num, gint64 *value);
+gboolean log_template_format_datetime(LogTemplate *self, LogMessage *lm, const LogTemplateOptions *opts, guint64 *value);
+
 LogTemplate *log_template_new(GlobalConfig *cfg, const gchar *name);
 LogTemplate *log_template_ref(LogTemplate *s);
 void log_template_unref(LogTemplate *s);
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+/*
+ * Template rendering benchmark
+ *
+ * Formats a set of representative templates against synthetic messages
+ * and reports the time and the number of GLib heap allocations spent
+ * per message.  It is not run as part of "make check", build and run it
+ * explicitly:
+ *
+ *   make lib/template/tests/bench_templates
+ *   ./lib/template/tests/bench_templates [iterations]
+ */
+
+#include "syslog-ng.h"
+#include "logmsg/logmsg.h"
+#include "template/templates.h"
+#include "apphook.h"
+#include "cfg.h"
+#include "plugin.h"
+#include "timeutils.h"
+#include "bench.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define BENCH_DEFAULT_ITERATIONS 100000
+#define BENCH_WIDE_PAIRS 64
+
+#define BENCH_RFC3164_MSG "<155>2006-02-11T10:34:56.156+01:00 bzorp syslog-ng[23323]: árvíztűrőtükörfúrógép and some more text"
+#define BENCH_RFC5424_MSG "<155>1 2006-02-11T10:34:56.156+01:00 bzorp syslog-ng 23323 ID47 " \
+  "[exampleSDID@0 iut=\"3\" eventSource=\"Application\" eventID=\"1011\"][examplePriority@0 class=\"high\"] " \
+  "\xEF\xBB\xBF" "árvíztűrőtükörfúrógép and some more text"
+
+typedef struct _BenchCase
+{
+  const gchar *name;
+  const gchar *plugin;
+  const gchar *message;
+  gboolean syslog_proto;
+  const gchar *template;
+} BenchCase;
+
+static BenchCase bench_cases[] =
+{
+  { "rfc3164", NULL, BENCH_RFC3164_MSG, FALSE, "<$PRI>$DATE $HOST $MSGHDR$MSG\n" },
+  { "rfc3164-file", NULL, BENCH_RFC3164_MSG, FALSE, "$ISODATE $HOST $MSGHDR$MSG\n" },
+  { "rfc5424", NULL, BENCH_RFC5424_MSG, TRUE, "<$PRI>1 $ISODATE $HOST $PROGRAM $PID $MSGID $SDATA $MSG\n" },
+  { "rfc5424-defaults", NULL, BENCH_RFC5424_MSG, TRUE, "<$PRI>1 $ISODATE ${HOST:--} ${PROGRAM:--} ${PID:--} ${MSGID:--} ${SDATA:--} $MSG\n" },
+  { "functions", "basicfuncs", BENCH_RFC3164_MSG, FALSE, "$(substr $MSG 0 10) $(lowercase $HOST) $(+ $PID 1)\n" },
+  { "format-json-rfc5424", "json-plugin", BENCH_RFC5424_MSG, TRUE, "$(format-json --scope rfc5424)\n" },
+  { "format-json-wide", "json-plugin", BENCH_RFC3164_MSG, FALSE, "$(format-json --scope rfc5424 --scope nv-pairs)\n" },
+  { "cef", "cef", BENCH_RFC3164_MSG, FALSE, "CEF:0|Vendor|Product|1.0|100|$PROGRAM|5|$(format-cef-extension --subkeys .cef.)\n" },
+  { NULL }
+};
+
+static MsgFormatOptions parse_options;
+
+static LogMessage *
+bench_create_message(const BenchCase *bench)
+{
+  LogMessage *msg;
+  gchar name[32], value[32];
+  gint i;
+
+  if (bench->syslog_proto)
+    parse_options.flags |= LP_SYSLOG_PROTOCOL;
+  else
+    parse_options.flags &= ~LP_SYSLOG_PROTOCOL;
+
+  msg = log_msg_new(bench->message, strlen(bench->message), g_sockaddr_inet_new("10.10.10.10", 1010), &parse_options);
+  log_msg_set_value(msg, LM_V_HOST_FROM, "kismacska", -1);
+  log_msg_set_tag_by_name(msg, "alma");
+  log_msg_set_tag_by_name(msg, "korte");
+
+  for (i = 0; i < BENCH_WIDE_PAIRS; i++)
+    {
+      g_snprintf(name, sizeof(name), "app.field%d", i);
+      g_snprintf(value, sizeof(value), "value of field %d", i);
+      log_msg_set_value_by_name(msg, name, value, -1);
+    }
+
+  log_msg_set_value_by_name(msg, ".cef.act", "blocked", -1);
+  log_msg_set_value_by_name(msg, ".cef.src", "10.10.10.10", -1);
+  log_msg_set_value_by_name(msg, ".cef.dst", "192.168.1.1", -1);
+  log_msg_set_value_by_name(msg, ".cef.spt", "1010", -1);
+  log_msg_set_value_by_name(msg, ".cef.dpt", "443", -1);
+  log_msg_set_value_by_name(msg, ".cef.msg", "a message with = and \\ characters", -1);
+  log_msg_set_value_by_name(msg, ".cef.request", "https://example.com/index.html?q=1", -1);
+
+  return msg;
+}
+
+static void
+bench_run_template(const BenchCase *bench, gint iterations, gboolean count_allocations)
+{
+  LogTemplate *template;
+  LogMessage *msg;
+  GString *result = g_string_sized_new(4096);
+  GTimeVal start, end;
+  gint allocations, i;
+  GError *error = NULL;
+
+  if (bench->plugin && !plugin_load_module(bench->plugin, configuration, NULL))
+    {
+      printf("  %-22s skipped, %s could not be loaded\n", bench->name, bench->plugin);
+      return;
+    }
+
+  template = log_template_new(configuration, NULL);
+  if (!log_template_compile(template, bench->template, &error))
+    {
+      printf("  %-22s skipped, error compiling template: %s\n", bench->name, error->message);
+      g_clear_error(&error);
+      log_template_unref(template);
+      return;
+    }
+
+  msg = bench_create_message(bench);
+
+  /* warm up the caches and the size hint of the template */
+  log_template_format(template, msg, NULL, LTZ_LOCAL, 1, NULL, result);
+
+  allocations = bench_get_allocations();
+  g_get_current_time(&start);
+  for (i = 0; i < iterations; i++)
+    log_template_format(template, msg, NULL, LTZ_LOCAL, i + 1, NULL, result);
+  g_get_current_time(&end);
+  allocations = bench_get_allocations() - allocations;
+
+  if (count_allocations)
+    printf("  %-22s %10.1f ns/msg %8.2f allocs/msg %6" G_GSIZE_FORMAT " bytes\n",
+           bench->name, g_time_val_diff(&end, &start) * 1000.0 / iterations,
+           (gdouble) allocations / iterations, result->len);
+  else
+    printf("  %-22s %10.1f ns/msg %11s allocs/msg %6" G_GSIZE_FORMAT " bytes\n",
+           bench->name, g_time_val_diff(&end, &start) * 1000.0 / iterations,
+           "n/a", result->len);
+
+  log_msg_unref(msg);
+  log_template_unref(template);
+  g_string_free(result, TRUE);
+}
+
+int
+main(int argc, char *argv[])
+{
+  gint iterations;
+  gboolean count_allocations;
+  gint i;
+
+  /* has to precede any other GLib call */
+  bench_init();
+  count_allocations = bench_allocations_are_counted();
+  iterations = bench_get_iterations(argc, argv, BENCH_DEFAULT_ITERATIONS);
+
+  configuration = cfg_new(VERSION_VALUE);
+  app_startup();
+  putenv("TZ=MET-1METDST");
+  tzset();
+
+  plugin_load_module("syslogformat", configuration, NULL);
+  msg_format_options_defaults(&parse_options);
+  msg_format_options_init(&parse_options, configuration);
+
+  printf("Template rendering benchmark, %d iterations per template\n", iterations);
+  for (i = 0; bench_cases[i].name; i++)
+    bench_run_template(&bench_cases[i], iterations, count_allocations);
+
+  app_shutdown();
+  return 0;
+}
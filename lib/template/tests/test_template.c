@@ -297,6 +297,137 @@ test_user_template_function(void)
   log_template_unref(template);
 }
 
+static void
+test_recompiled_template_appends_the_new_elements(void)
+{
+  LogTemplate *template;
+  LogMessage *msg;
+  GString *res = g_string_new("prefix ");
+
+  msg = create_sample_message();
+  template = compile_template("$HOST $PID and a longer literal text", FALSE);
+  log_template_append_format(template, msg, NULL, LTZ_LOCAL, 0, NULL, res);
+  assert_string(res->str, "prefix bzorp 23323 and a longer literal text", "Formatted result mismatch");
+
+  assert_true(log_template_compile(template, "${PROGRAM}", NULL), "Recompiling template failed");
+  log_template_format(template, msg, NULL, LTZ_LOCAL, 0, NULL, res);
+  assert_string(res->str, "syslog-ng", "Recompiled template formats stale elements");
+
+  g_string_free(res, TRUE);
+  log_template_unref(template);
+  log_msg_unref(msg);
+}
+
+static void
+test_cached_results_are_reused_while_the_message_is_write_protected(void)
+{
+  LogTemplate *template, *seqnum_template;
+  LogMessage *msg;
+  GString *res = g_string_new("");
+
+  msg = create_sample_message();
+  template = compile_template("$HOST $PROGRAM", FALSE);
+  log_template_set_cache_results(template, TRUE);
+  seqnum_template = compile_template("$HOST $SEQNUM", FALSE);
+  log_template_set_cache_results(seqnum_template, TRUE);
+
+  log_template_format(template, msg, NULL, LTZ_LOCAL, 0, NULL, res);
+  assert_true(log_msg_get_cached_values(msg) == NULL, "Result of a writable message got cached");
+
+  log_msg_write_protect(msg);
+  log_template_format(template, msg, NULL, LTZ_LOCAL, 0, NULL, res);
+  assert_true(log_msg_get_cached_values(msg) != NULL, "Result of a write protected message was not cached");
+  log_template_format(template, msg, NULL, LTZ_LOCAL, 0, NULL, res);
+  assert_string(res->str, "bzorp syslog-ng", "Cached template result mismatch");
+
+  log_template_format(seqnum_template, msg, NULL, LTZ_LOCAL, 1, NULL, res);
+  log_template_format(seqnum_template, msg, NULL, LTZ_LOCAL, 2, NULL, res);
+  assert_string(res->str, "bzorp 2", "Template depending on $SEQNUM was cached");
+
+  log_msg_write_unprotect(msg);
+  assert_true(log_msg_get_cached_values(msg) == NULL, "Cached results were kept after the message became writable");
+
+  g_string_free(res, TRUE);
+  log_template_unref(seqnum_template);
+  log_template_unref(template);
+  log_msg_unref(msg);
+}
+
+static void
+test_single_numeric_macros_are_returned_without_formatting(void)
+{
+  LogTemplate *template;
+  LogMessage *msg;
+  LogTemplateOptions opts;
+  gint64 i;
+  guint64 t;
+
+  msg = create_sample_message();
+  log_template_options_defaults(&opts);
+  opts.frac_digits = 0;
+  log_template_options_init(&opts, configuration);
+
+  template = compile_template("$LEVEL_NUM", FALSE);
+  assert_true(log_template_format_int64(template, msg, &opts, 0, &i), "$LEVEL_NUM has no integer value");
+  assert_gint64(i, 3, "Integer value of $LEVEL_NUM mismatch");
+  assert_false(log_template_format_datetime(template, msg, &opts, &t), "$LEVEL_NUM should not be a datetime");
+  log_template_unref(template);
+
+  template = compile_template("$SEQNUM", FALSE);
+  assert_true(log_template_format_int64(template, msg, &opts, 999, &i), "$SEQNUM has no integer value");
+  assert_gint64(i, 999, "Integer value of $SEQNUM mismatch");
+  assert_false(log_template_format_int64(template, msg, &opts, 0, &i), "Unset $SEQNUM should fall back to formatting");
+  log_template_unref(template);
+
+  template = compile_template("$R_UNIXTIME", FALSE);
+  assert_true(log_template_format_int64(template, msg, &opts, 0, &i), "$R_UNIXTIME has no integer value");
+  assert_gint64(i, 1139684315, "Integer value of $R_UNIXTIME mismatch");
+  assert_true(log_template_format_datetime(template, msg, &opts, &t), "$R_UNIXTIME has no datetime value");
+  assert_guint64(t, 1139684315000ULL, "Datetime value of $R_UNIXTIME mismatch without frac_digits()");
+  assert_true(log_template_format_datetime(template, msg, NULL, &t), "$R_UNIXTIME has no datetime value");
+  assert_guint64(t, 1139684315639ULL, "Datetime value of $R_UNIXTIME mismatch with frac_digits(3)");
+  assert_false(log_template_format_int64(template, msg, NULL, 0, &i), "$R_UNIXTIME with fractions should not be an integer");
+  log_template_unref(template);
+
+  template = compile_template("$LEVEL_NUM ", FALSE);
+  assert_false(log_template_format_int64(template, msg, &opts, 0, &i), "Template with literal text returned an integer");
+  log_template_unref(template);
+
+  template = compile_template("$HOST", FALSE);
+  assert_false(log_template_format_int64(template, msg, &opts, 0, &i), "Non-numeric macro returned an integer");
+  log_template_unref(template);
+
+  log_template_options_destroy(&opts);
+  log_msg_unref(msg);
+}
+
+static void
+test_batch_formatting_returns_the_offsets_of_each_result(void)
+{
+  LogTemplate *template;
+  LogMessage *msgs[3];
+  gsize offsets[4];
+  GString *res = g_string_new("garbage");
+  gint i;
+
+  for (i = 0; i < 3; i++)
+    msgs[i] = create_sample_message();
+  log_msg_set_value(msgs[1], LM_V_HOST, "longerhost", -1);
+  template = compile_template("$HOST:$SEQNUM;", FALSE);
+
+  log_template_format_batch(template, msgs, 3, NULL, LTZ_LOCAL, 8, NULL, res, offsets);
+  assert_string(res->str, "bzorp:8;longerhost:9;bzorp:10;", "Batch formatting result mismatch");
+  assert_guint64(offsets[0], 0, "Offset of the first result mismatch");
+  assert_guint64(offsets[1], 8, "Offset of the second result mismatch");
+  assert_guint64(offsets[2], 21, "Offset of the third result mismatch");
+  assert_guint64(offsets[3], res->len, "End offset mismatch");
+
+  g_string_free(res, TRUE);
+  log_template_unref(template);
+  for (i = 0; i < 3; i++)
+    log_msg_unref(msgs[i]);
+}
+
 int
 main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
 {
@@ -320,6 +451,10 @@ main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
   test_multi_thread();
   test_escaping();
   test_user_template_function();
+  test_recompiled_template_appends_the_new_elements();
+  test_cached_results_are_reused_while_the_message_is_write_protected();
+  test_single_numeric_macros_are_returned_without_formatting();
+  test_batch_formatting_returns_the_offsets_of_each_result();
   /* multi-threaded expansion */
 
 
@@ -39,6 +39,16 @@ hello(LogMessage *msg, int argc, GString *argv[], GString *result)
 TEMPLATE_FUNCTION_SIMPLE(hello);
 Plugin hello_plugin = TEMPLATE_FUNCTION_PLUGIN(hello, "hello");
 
+static void
+constant(LogMessage *msg, int argc, GString *argv[], GString *result)
+{
+  if (argc > 0)
+    g_string_append_len(result, argv[0]->str, argv[0]->len);
+}
+
+TEMPLATE_FUNCTION_SIMPLE_PURE(constant);
+Plugin constant_plugin = TEMPLATE_FUNCTION_PLUGIN(constant, "constant");
+
 
 #define assert_common_element(expected) \
     assert_string(current_elem->text, expected.text, ASSERTION_ERROR("Bad compiled template text")); \
@@ -377,6 +387,29 @@ test_qouted_string_in_name_template_function(void)
   assert_compiled_template(text = "", default_value = NULL, func.ops = get_template_function_ops("hello"), type = LTE_FUNC, msg_ref = 0);
 }
 
+static void
+test_pure_function_with_literal_arguments_is_folded(void)
+{
+  assert_template_compile("$(constant foo)");
+  assert_compiled_template(text = "foo", default_value = NULL, macro = M_NONE, type = LTE_MACRO, msg_ref = 0);
+  assert_gpointer(current_elem_list->next, NULL, ASSERTION_ERROR("Folded template has more than one element"));
+}
+
+static void
+test_folded_function_is_merged_with_the_surrounding_text(void)
+{
+  assert_template_compile("x$(constant $(constant foo))y $DATE");
+  assert_compiled_template(text = "xfooy ", default_value = NULL, macro = M_DATE, type = LTE_MACRO, msg_ref = 0);
+  assert_gpointer(current_elem_list->next, NULL, ASSERTION_ERROR("Folded template has more than one element"));
+}
+
+static void
+test_pure_function_with_message_dependent_arguments_is_not_folded(void)
+{
+  assert_template_compile("$(constant $DATE)");
+  assert_compiled_template(text = "", default_value = NULL, func.ops = get_template_function_ops("constant"), type = LTE_FUNC, msg_ref = 0);
+}
+
 static void
 test_template_compile_func(void)
 {
@@ -384,6 +417,9 @@ test_template_compile_func(void)
   TEMPLATE_TESTCASE(test_complicated_template_function);
   TEMPLATE_TESTCASE(test_simple_template_function_with_additional_text);
   TEMPLATE_TESTCASE(test_qouted_string_in_name_template_function);
+  TEMPLATE_TESTCASE(test_pure_function_with_literal_arguments_is_folded);
+  TEMPLATE_TESTCASE(test_folded_function_is_merged_with_the_surrounding_text);
+  TEMPLATE_TESTCASE(test_pure_function_with_message_dependent_arguments_is_not_folded);
 }
 
 static void
@@ -449,6 +485,7 @@ int main(int argc, char **argv)
   log_msg_registry_init();
   log_template_global_init();
   plugin_register(configuration, &hello_plugin, 1);
+  plugin_register(configuration, &constant_plugin, 1);
 
   test_template_compile_macro();
   test_template_compile_value();
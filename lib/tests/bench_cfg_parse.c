@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+/*
+ * Configuration parsing benchmark
+ *
+ * Generates a large configuration similar to the output of config
+ * generators (many filters, templates, log paths and block references)
+ * and measures the time it takes to parse it.  It is not run as part of
+ * "make check", build and run it explicitly:
+ *
+ *   make lib/tests/bench_cfg_parse
+ *   ./lib/tests/bench_cfg_parse [objects]
+ */
+
+#include "syslog-ng.h"
+#include "cfg.h"
+#include "apphook.h"
+#include "timeutils.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#define BENCH_DEFAULT_OBJECTS 10000
+
+static GString *
+bench_generate_config(gint objects)
+{
+  GString *config = g_string_sized_new(objects * 256);
+  gint i;
+
+  g_string_append(config,
+                  "@version: " VERSION_CURRENT "\n"
+                  "block root bench_filter(id() program()) {\n"
+                  "  filter f_block_`id` { program(\"`program`\") and level(info..err); };\n"
+                  "};\n");
+
+  for (i = 0; i < objects; i++)
+    {
+      g_string_append_printf(config,
+                             "# object %d\n"
+                             "filter f_%d { program(\"program%d\") and level(info..err) and message(\"pattern%d\"); };\n"
+                             "template t_%d \"${ISODATE} ${HOST} ${PROGRAM}[${PID}]: ${MSG} %d\\n\";\n"
+                             "bench_filter(id(%d) program(\"block_program%d\"));\n"
+                             "log { filter(f_%d); filter(f_block_%d); flags(final); };\n",
+                             i, i, i, i, i, i, i, i, i, i);
+    }
+  return config;
+}
+
+static gint
+bench_count_lines(GString *config)
+{
+  gint lines = 0;
+  gsize i;
+
+  for (i = 0; i < config->len; i++)
+    {
+      if (config->str[i] == '\n')
+        lines++;
+    }
+  return lines;
+}
+
+int
+main(int argc, char *argv[])
+{
+  gint objects = BENCH_DEFAULT_OBJECTS;
+  GlobalConfig *cfg;
+  GString *config;
+  GTimeVal start, end;
+  gboolean success;
+
+  if (argc > 1)
+    objects = MAX(atoi(argv[1]), 1);
+
+  app_startup();
+
+  config = bench_generate_config(objects);
+
+  cfg = cfg_new(VERSION_VALUE);
+  g_get_current_time(&start);
+  success = cfg_load_config(cfg, config->str, TRUE, NULL);
+  g_get_current_time(&end);
+
+  if (!success)
+    {
+      fprintf(stderr, "Error parsing the generated configuration\n");
+      return 1;
+    }
+
+  printf("Configuration parsing benchmark, %d objects, %d lines, %" G_GSIZE_FORMAT " bytes: %.3f sec\n",
+         objects, bench_count_lines(config), config->len, g_time_val_diff(&end, &start) / 1e6);
+
+  cfg_free(cfg);
+  g_string_free(config, TRUE);
+  app_shutdown();
+  return 0;
+}
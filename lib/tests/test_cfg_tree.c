@@ -37,16 +37,30 @@ typedef struct
   LogPipe super;
 
   gboolean return_value;
+  gboolean pre_init_called;
   gboolean init_called;
+  gboolean init_called_after_pre_init;
   gboolean deinit_called;
 } AlmightyAlwaysPipe;
 
+static gboolean
+almighty_always_pipe_pre_init (LogPipe *s)
+{
+  AlmightyAlwaysPipe *self = (AlmightyAlwaysPipe *)s;
+
+  /* pretend to do something slow */
+  g_usleep (200000);
+  self->pre_init_called = TRUE;
+  return self->return_value;
+}
+
 static gboolean
 almighty_always_pipe_init (LogPipe *s)
 {
   AlmightyAlwaysPipe *self = (AlmightyAlwaysPipe *)s;
 
   self->init_called = TRUE;
+  self->init_called_after_pre_init = self->pre_init_called;
   return self->return_value;
 }
 
@@ -206,6 +220,230 @@ test_pipe_init_multi_with_bad_node (void)
 }
 
 
+static void
+test_pipe_pre_init_runs_in_parallel (void)
+{
+  AlmightyAlwaysPipe *pipes[4];
+  CfgTree tree;
+  GTimeVal start, end;
+  glong elapsed;
+  gint i;
+
+  testcase_begin ("Slow pre_init() methods run in parallel, before init()");
+
+  cfg_tree_init_instance (&tree, NULL);
+
+  for (i = 0; i < 4; i++)
+    {
+      pipes[i] = create_and_attach_almighty_pipe (&tree, TRUE);
+      pipes[i]->super.pre_init = almighty_always_pipe_pre_init;
+    }
+
+  g_get_current_time (&start);
+  assert_true (cfg_tree_start (&tree),
+               "Starting a tree with pre_init() methods works");
+  g_get_current_time (&end);
+
+  elapsed = (end.tv_sec - start.tv_sec) * G_USEC_PER_SEC + (end.tv_usec - start.tv_usec);
+  assert_true (elapsed < 4 * 200000,
+               "pre_init() methods were not run in parallel");
+
+  for (i = 0; i < 4; i++)
+    assert_true (pipes[i]->init_called_after_pre_init,
+                 "init() was called before pre_init() finished");
+
+  assert_true (cfg_tree_stop (&tree),
+               "Stopping a tree with pre_init() methods works");
+  cfg_tree_free_instance (&tree);
+
+  testcase_end ();
+}
+
+static void
+test_pipe_pre_init_fail (void)
+{
+  AlmightyAlwaysPipe *pipe1, *pipe2;
+  CfgTree tree;
+
+  testcase_begin ("A failing pre_init() prevents starting the tree");
+
+  cfg_tree_init_instance (&tree, NULL);
+
+  pipe1 = create_and_attach_almighty_pipe (&tree, TRUE);
+  pipe2 = create_and_attach_almighty_pipe (&tree, FALSE);
+  pipe1->super.pre_init = almighty_always_pipe_pre_init;
+  pipe2->super.pre_init = almighty_always_pipe_pre_init;
+
+  assert_false (cfg_tree_start (&tree),
+                "Starting a tree with a failing pre_init() works");
+  assert_false (pipe1->init_called,
+                "init() is not called if any pre_init() failed");
+
+  cfg_tree_free_instance (&tree);
+
+  testcase_end ();
+}
+
+/*
+ * Stage pipes, to test fusing linear chains
+ */
+
+typedef struct
+{
+  LogPipe super;
+
+  gboolean result;
+  gint stage_calls;
+  gint queue_calls;
+} CountingPipe;
+
+static gboolean
+counting_pipe_stage (LogPipe *s, LogMessage **pmsg, const LogPathOptions *path_options)
+{
+  CountingPipe *self = (CountingPipe *)s;
+
+  self->stage_calls++;
+  return self->result;
+}
+
+static void
+counting_pipe_queue (LogPipe *s, LogMessage *msg, const LogPathOptions *path_options, gpointer user_data)
+{
+  CountingPipe *self = (CountingPipe *)s;
+
+  self->queue_calls++;
+  log_msg_drop (msg, path_options, AT_PROCESSED);
+}
+
+static CountingPipe *
+counting_pipe_new (gboolean is_stage, gboolean result)
+{
+  CountingPipe *self = g_new0 (CountingPipe, 1);
+
+  log_pipe_init_instance (&self->super, NULL);
+  if (is_stage)
+    {
+      self->super.queue = log_pipe_stage_queue_method;
+      self->super.stage = counting_pipe_stage;
+    }
+  else
+    self->super.queue = counting_pipe_queue;
+  self->result = result;
+  return self;
+}
+
+static void
+assert_fused_chain (gboolean second_stage_result, gint expected_third_stage_calls, gint expected_sink_calls)
+{
+  CountingPipe *stages[3], *sink;
+  LogExprNode *children = NULL;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  CfgTree tree;
+  gint i;
+
+  cfg_tree_init_instance (&tree, NULL);
+
+  for (i = 0; i < 3; i++)
+    {
+      stages[i] = counting_pipe_new (TRUE, i == 1 ? second_stage_result : TRUE);
+      children = log_expr_node_append_tail (children, log_expr_node_new_pipe (&stages[i]->super, NULL));
+    }
+  sink = counting_pipe_new (FALSE, TRUE);
+  children = log_expr_node_append_tail (children, log_expr_node_new_pipe (&sink->super, NULL));
+  cfg_tree_add_object (&tree, log_expr_node_new_log (children, 0, NULL));
+
+  assert_true (cfg_tree_start (&tree),
+               "Starting a tree of stage pipes works");
+  assert_true (stages[0]->super.queue != log_pipe_stage_queue_method,
+               "The head of a linear chain of stages was not fused");
+
+  log_pipe_queue (&stages[0]->super, log_msg_new_empty (), &path_options);
+
+  assert_gint (stages[0]->stage_calls, 1, "first stage call count mismatch");
+  assert_gint (stages[1]->stage_calls, 1, "second stage call count mismatch");
+  assert_gint (stages[2]->stage_calls, expected_third_stage_calls, "third stage call count mismatch");
+  assert_gint (sink->queue_calls, expected_sink_calls, "message was not forwarded to the end of the chain");
+
+  assert_true (cfg_tree_stop (&tree),
+               "Stopping a tree of stage pipes works");
+  assert_true (stages[0]->super.queue == log_pipe_stage_queue_method,
+               "Stopping the tree did not restore the original queue method");
+  cfg_tree_free_instance (&tree);
+}
+
+static void
+test_linear_stage_chain_is_fused (void)
+{
+  testcase_begin ("A linear chain of stages is processed in a single queue() call");
+
+  assert_fused_chain (TRUE, 1, 1);
+
+  testcase_end ();
+}
+
+static void
+test_fused_chain_stops_at_failing_stage (void)
+{
+  testcase_begin ("A fused chain drops the message at the first failing stage");
+
+  assert_fused_chain (FALSE, 0, 0);
+
+  testcase_end ();
+}
+
+static void
+assert_batch_through_stages (gboolean stage_result, gint expected_sink_calls)
+{
+  CountingPipe *first, *second, *sink;
+  LogMessage *msgs[3];
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gint i;
+
+  first = counting_pipe_new (TRUE, TRUE);
+  second = counting_pipe_new (TRUE, stage_result);
+  sink = counting_pipe_new (FALSE, TRUE);
+  first->super.queue_batch = log_pipe_stage_queue_batch_method;
+  second->super.queue_batch = log_pipe_stage_queue_batch_method;
+  log_pipe_append (&first->super, &second->super);
+  log_pipe_append (&second->super, &sink->super);
+  log_pipe_init (&first->super);
+  log_pipe_init (&second->super);
+  log_pipe_init (&sink->super);
+
+  for (i = 0; i < 3; i++)
+    msgs[i] = log_msg_new_empty ();
+  log_pipe_queue_batch (&first->super, msgs, 3, &path_options);
+
+  assert_gint (first->stage_calls, 3, "first stage call count mismatch");
+  assert_gint (second->stage_calls, 3, "second stage call count mismatch");
+  assert_gint (sink->queue_calls, expected_sink_calls,
+               "pipe without queue_batch() did not get the messages one-by-one");
+
+  log_pipe_unref (&first->super);
+  log_pipe_unref (&second->super);
+  log_pipe_unref (&sink->super);
+}
+
+static void
+test_batch_passes_through_stages (void)
+{
+  testcase_begin ("A batch of messages is processed by stages and then queued one-by-one");
+
+  assert_batch_through_stages (TRUE, 3);
+
+  testcase_end ();
+}
+
+static void
+test_batch_is_dropped_by_failing_stage (void)
+{
+  testcase_begin ("A failing stage drops every message of a batch");
+
+  assert_batch_through_stages (FALSE, 0);
+
+  testcase_end ();
+}
+
 /*
  * The main program.
  */
@@ -219,6 +457,12 @@ main (void)
   test_pipe_init_fail ();
   test_pipe_init_multi_success ();
   test_pipe_init_multi_with_bad_node ();
+  test_pipe_pre_init_runs_in_parallel ();
+  test_pipe_pre_init_fail ();
+  test_linear_stage_chain_is_fused ();
+  test_fused_chain_stops_at_failing_stage ();
+  test_batch_passes_through_stages ();
+  test_batch_is_dropped_by_failing_stage ();
 
   app_shutdown ();
 
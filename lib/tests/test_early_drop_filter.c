@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "early-drop-filter.h"
+#include "testutils.h"
+
+#include <string.h>
+#include <syslog.h>
+
+#define assert_dropped(filter, line, parse_pri, expected) \
+  assert_gboolean(early_drop_filter_matches(filter, (const guchar *) line, strlen(line), parse_pri, LOG_USER | LOG_NOTICE), \
+                  expected, "unexpected early drop result for: %s", line)
+
+static void
+test_empty_filter_drops_nothing(void)
+{
+  EarlyDropFilter filter;
+
+  early_drop_filter_init(&filter);
+  assert_dropped(&filter, "<15>foo bar", TRUE, FALSE);
+  early_drop_filter_destroy(&filter);
+}
+
+static void
+test_pri_masks_use_the_default_pri_without_a_pri_header(void)
+{
+  EarlyDropFilter filter;
+
+  early_drop_filter_init(&filter);
+  filter.level_mask = 1 << LOG_DEBUG;
+  filter.facility_mask = 1 << (LOG_MAIL >> 3);
+
+  assert_dropped(&filter, "<15>foo", TRUE, TRUE);
+  assert_dropped(&filter, "<21>foo", TRUE, TRUE);
+  assert_dropped(&filter, "<13>foo", TRUE, FALSE);
+  assert_dropped(&filter, "<15>foo", FALSE, FALSE);
+  assert_dropped(&filter, "<999>foo", TRUE, FALSE);
+  assert_dropped(&filter, "foo", TRUE, FALSE);
+  early_drop_filter_destroy(&filter);
+}
+
+static void
+test_prefixes_match_after_the_pri_header_and_literals_anywhere(void)
+{
+  EarlyDropFilter filter;
+
+  early_drop_filter_init(&filter);
+  early_drop_filter_add_prefixes(&filter, g_list_append(NULL, g_strdup("DEBUG")));
+  early_drop_filter_add_literals(&filter, g_list_append(NULL, g_strdup("heartbeat")));
+
+  assert_dropped(&filter, "<13>DEBUG foo", TRUE, TRUE);
+  assert_dropped(&filter, "DEBUG foo", TRUE, TRUE);
+  assert_dropped(&filter, "<13>DEBUG foo", FALSE, FALSE);
+  assert_dropped(&filter, "<13>foo DEBUG", TRUE, FALSE);
+  assert_dropped(&filter, "<13>foo heartbeat bar", TRUE, TRUE);
+  assert_dropped(&filter, "<13>foo heartbea", TRUE, FALSE);
+  early_drop_filter_destroy(&filter);
+}
+
+int
+main(int argc, char **argv)
+{
+  test_empty_filter_drops_nothing();
+  test_pri_masks_use_the_default_pri_without_a_pri_header();
+  test_prefixes_match_after_the_pri_header_and_literals_anywhere();
+  return 0;
+}
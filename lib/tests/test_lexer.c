@@ -226,6 +226,51 @@ test_lexer_others(void)
   assert_parser_identifier("test_value");
 }
 
+#define assert_parser_keyword(expected) \
+  _next_token();                                                        \
+  assert_token_type(LL_TOKEN);                                         \
+  assert_gint(_current_token()->token, expected, "Bad keyword token at %s:%d", __FUNCTION__, __LINE__);
+
+static CfgLexerKeyword test_outer_keywords[] =
+{
+  { "outer_keyword", 1001 },
+  { "shared_keyword", 1002 },
+  { NULL }
+};
+
+static CfgLexerKeyword test_inner_keywords[] =
+{
+  { "inner_keyword", 1003 },
+  { "shared_keyword", 1004 },
+  { NULL }
+};
+
+static CfgLexerKeyword test_stop_keywords[] =
+{
+  { "stop_keyword", 1005 },
+  { CFG_KEYWORD_STOP },
+  { NULL }
+};
+
+static void
+test_lexer_keywords(void)
+{
+  _input("inner_keyword inner-keyword shared_keyword outer-keyword unknown-keyword");
+  cfg_lexer_push_context(parser->lexer, LL_CONTEXT_ROOT, test_outer_keywords, "outer");
+  cfg_lexer_push_context(parser->lexer, LL_CONTEXT_ROOT, test_inner_keywords, "inner");
+  assert_parser_keyword(1003);
+  assert_parser_keyword(1003);
+  assert_parser_keyword(1004);
+  assert_parser_keyword(1001);
+  assert_parser_identifier("unknown-keyword");
+
+  _input("stop-keyword outer_keyword");
+  cfg_lexer_push_context(parser->lexer, LL_CONTEXT_ROOT, test_outer_keywords, "outer");
+  cfg_lexer_push_context(parser->lexer, LL_CONTEXT_ROOT, test_stop_keywords, "stop");
+  assert_parser_keyword(1005);
+  assert_parser_identifier("outer_keyword");
+}
+
 int
 main(int argc, char **argv)
 {
@@ -233,5 +278,6 @@ main(int argc, char **argv)
   LEXER_TESTCASE(test_lexer_qstring);
   LEXER_TESTCASE(test_lexer_block);
   LEXER_TESTCASE(test_lexer_others);
+  LEXER_TESTCASE(test_lexer_keywords);
   return 0;
 }
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "testutils.h"
+#include "apphook.h"
+#include "memprof.h"
+
+#include <string.h>
+
+static gchar allocations[4][64];
+
+static void
+test_disabled_profiler_records_nothing(void)
+{
+  GString *report;
+
+  memprof_record_alloc(allocations[0], sizeof(allocations[0]));
+  assert_gint(memprof_live_samples, 0, "Allocation sampled while the profiler is off");
+
+  report = memprof_format_report();
+  assert_string(report->str, "sampling_rate=0\nlive_samples=0\n", "Report of the disabled profiler mismatch");
+  g_string_free(report, TRUE);
+}
+
+static void
+test_sampled_allocations_are_tracked_until_freed(void)
+{
+  GString *report;
+  gint i;
+
+  /* every allocation is at least as large as the rate, all are sampled */
+  memprof_start(1);
+  for (i = 0; i < 4; i++)
+    memprof_record_alloc(allocations[i], sizeof(allocations[i]));
+  assert_gint(memprof_live_samples, 4, "Not every allocation was sampled");
+
+  memprof_record_free(allocations[1]);
+  memprof_record_free(allocations[1]);
+  assert_gint(memprof_live_samples, 3, "Sampled allocation was not released on free");
+
+  report = memprof_format_report();
+  assert_true(strstr(report->str, "live_samples=3\n") != NULL, "Report header mismatch: %s", report->str);
+  assert_true(strstr(report->str, "live_bytes=192 live_samples=3 total_bytes=256 total_samples=4") != NULL,
+              "Stack statistics mismatch: %s", report->str);
+  g_string_free(report, TRUE);
+
+  memprof_stop();
+  assert_gint(memprof_live_samples, 0, "Samples were kept after the profiler was stopped");
+  memprof_record_free(allocations[0]);
+}
+
+int
+main(int argc, char **argv)
+{
+  app_startup();
+
+  test_disabled_profiler_records_nothing();
+  test_sampled_allocations_are_tracked_until_freed();
+
+  app_shutdown();
+  return 0;
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "testutils.h"
+#include "apphook.h"
+#include "messages.h"
+#include "logmsg/logmsg.h"
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static gint posted_messages;
+static GString *last_posted_message;
+
+static void
+_capture_posted_message(LogMessage *msg)
+{
+  posted_messages++;
+  g_string_assign(last_posted_message, log_msg_get_value(msg, LM_V_MESSAGE, NULL));
+  log_msg_unref(msg);
+}
+
+static void
+_wait_for_the_next_second(void)
+{
+  time_t start = time(NULL);
+
+  while (time(NULL) == start)
+    usleep(1000);
+}
+
+static void
+test_messages_above_the_burst_are_suppressed(void)
+{
+  gint i;
+
+  _wait_for_the_next_second();
+  posted_messages = 0;
+  for (i = 0; i < 30; i++)
+    msg_error("Rate limited test message", evt_tag_int("i", i), NULL);
+  assert_gint(posted_messages, 20, "Messages above the burst were not suppressed");
+
+  msg_error("Another test message", NULL);
+  assert_gint(posted_messages, 21, "Messages of other templates should not be limited");
+}
+
+static void
+test_suppressed_messages_are_summarized(void)
+{
+  _wait_for_the_next_second();
+  posted_messages = 0;
+  msg_flush_suppressed_messages();
+
+  assert_gint(posted_messages, 1, "Suppression summary was not sent");
+  assert_true(strstr(last_posted_message->str, "msg='Rate limited test message'") != NULL,
+              "Summary does not name the template: %s", last_posted_message->str);
+  assert_true(strstr(last_posted_message->str, "suppressed='10'") != NULL,
+              "Summary has a wrong count: %s", last_posted_message->str);
+
+  msg_flush_suppressed_messages();
+  assert_gint(posted_messages, 1, "Suppression summary was sent twice");
+}
+
+int
+main(int argc, char **argv)
+{
+  app_startup();
+  last_posted_message = g_string_new("");
+  msg_set_post_func(_capture_posted_message);
+
+  test_messages_above_the_burst_are_suppressed();
+  test_suppressed_messages_are_summarized();
+
+  msg_set_post_func(NULL);
+  g_string_free(last_posted_message, TRUE);
+  app_shutdown();
+  return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "testutils.h"
+#include "apphook.h"
+#include "scratch-buffers.h"
+#include "mainloop-worker.h"
+
+#include <string.h>
+
+static void
+test_gstrings_are_distinct_and_empty(void)
+{
+  GString *a, *b;
+
+  a = scratch_arena_gstring();
+  g_string_assign(a, "foo");
+  b = scratch_arena_gstring();
+
+  assert_true(a != b, "The arena handed out the same GString twice within a batch");
+  assert_gint(b->len, 0, "Fresh arena GString is not empty");
+  assert_string(a->str, "foo", "Arena GString was clobbered");
+  scratch_arena_reset();
+}
+
+static void
+test_gstrings_are_reused_after_reset(void)
+{
+  GString *a, *b;
+
+  a = scratch_arena_gstring();
+  g_string_assign(a, "foo");
+  scratch_arena_reset();
+  b = scratch_arena_gstring();
+
+  assert_true(a == b, "GString was not reused after the arena was reset");
+  assert_gint(b->len, 0, "Reused arena GString is not empty");
+  scratch_arena_reset();
+}
+
+static void
+test_slices_are_aligned_and_do_not_overlap(void)
+{
+  gchar *a, *b, *large;
+
+  a = scratch_arena_alloc(3);
+  b = scratch_arena_alloc(17);
+  large = scratch_arena_alloc(100000);
+
+  assert_true(((gsize) a % sizeof(gdouble)) == 0, "Arena slice is not aligned");
+  assert_true(((gsize) b % sizeof(gdouble)) == 0, "Arena slice is not aligned");
+  assert_true(b >= a + 3, "Arena slices overlap");
+
+  memset(a, 'a', 3);
+  memset(large, 'l', 100000);
+  memset(b, 'b', 17);
+  assert_nstring(a, 3, "aaa", 3, "Arena slice was clobbered by a later allocation");
+
+  /* the rest of the current chunk is still used after a large slice */
+  assert_true(scratch_arena_alloc(8) == b + 24, "Large slice did not leave the current chunk alone");
+  scratch_arena_reset();
+}
+
+static gpointer
+_use_arena_in_a_worker_batch(gpointer user_data)
+{
+  GString *a;
+
+  main_loop_worker_thread_start(NULL);
+
+  a = scratch_arena_gstring();
+  main_loop_worker_invoke_batch_callbacks();
+  assert_true(scratch_arena_gstring() == a, "The end of the batch did not reset the arena");
+
+  main_loop_worker_invoke_batch_callbacks();
+  main_loop_worker_thread_stop();
+  return NULL;
+}
+
+static void
+test_arena_is_reset_at_the_end_of_worker_batches(void)
+{
+  GThread *thread;
+
+  thread = g_thread_create(_use_arena_in_a_worker_batch, NULL, TRUE, NULL);
+  g_thread_join(thread);
+}
+
+int
+main(int argc, char **argv)
+{
+  app_startup();
+
+  test_gstrings_are_distinct_and_empty();
+  test_gstrings_are_reused_after_reset();
+  test_slices_are_aligned_and_do_not_overlap();
+  test_arena_is_reset_at_the_end_of_worker_batches();
+
+  app_shutdown();
+  return 0;
+}
@@ -47,6 +47,43 @@ assert_strchr_finds_character_at(const gchar *str, int c, int ofs)
   assert_gint((result - str), ofs, "Expected the strchr() return value to point right to the specified offset");
 }
 
+static void
+assert_str_search_finds_at(const gchar *haystack, const gchar *needle, gboolean icase, gint ofs)
+{
+  StrSearch search;
+  const gchar *result;
+
+  str_search_init(&search, needle, strlen(needle), icase);
+  result = str_search_find(&search, haystack, strlen(haystack));
+  if (ofs < 0)
+    assert_null(result, "expected no match for needle %s in %s", needle, haystack);
+  else
+    {
+      assert_not_null(result, "expected a match for needle %s in %s", needle, haystack);
+      assert_gint(result - haystack, ofs, "needle %s found at an unexpected offset in %s", needle, haystack);
+    }
+  str_search_clear(&search);
+}
+
+static void
+test_str_search(void)
+{
+  assert_str_search_finds_at("", "", FALSE, 0);
+  assert_str_search_finds_at("abc", "", FALSE, 0);
+  assert_str_search_finds_at("", "a", FALSE, -1);
+  assert_str_search_finds_at("ab", "abc", FALSE, -1);
+  assert_str_search_finds_at("abcabc", "c", FALSE, 2);
+  assert_str_search_finds_at("abcabc", "ca", FALSE, 2);
+  assert_str_search_finds_at("abcabc", "cb", FALSE, -1);
+  assert_str_search_finds_at("the quick brown fox", "brown", FALSE, 10);
+  assert_str_search_finds_at("the quick brown fox", "fox", FALSE, 16);
+  assert_str_search_finds_at("the quick brown fox", "BROWN", FALSE, -1);
+  assert_str_search_finds_at("the quick brown fox", "BROWN", TRUE, 10);
+  assert_str_search_finds_at("the quick Brown fox", "bROWN FOX", TRUE, 10);
+  assert_str_search_finds_at("aaaaaaaaab", "aaab", FALSE, 6);
+  assert_str_search_finds_at("aaaaaaaaab", "AAAB", TRUE, 6);
+}
+
 int
 main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
 {
@@ -65,5 +102,7 @@ main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
   assert_strchr_finds_character_at("0123456789abcdef", '7', 7);
   assert_strchr_finds_character_at("0123456789abcdef", 'f', 15);
 
+  test_str_search();
+
   return 0;
 }
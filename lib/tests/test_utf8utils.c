@@ -57,6 +57,13 @@ assert_escaped_text(const gchar *str, const gchar *expected_escaped_str)
   assert_escaped_text_with_unsafe_chars(str, expected_escaped_str, NULL);
 }
 
+void
+assert_utf8_validate_matches_glib(const gchar *str, gssize len)
+{
+  assert_gboolean(utf8_validate(str, len), g_utf8_validate(str, len, NULL),
+                  "utf8_validate() and g_utf8_validate() disagree, str=%s", str);
+}
+
 int
 main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
 {
@@ -88,5 +95,27 @@ main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
   assert_escaped_text_with_unsafe_chars("\"text\"", "\\\"text\\\"", "\"");
   assert_escaped_text_with_unsafe_chars("\"text\"", "\\\"te\\xt\\\"", "\"x");
 
+  /* long runs of plain characters are copied in bulk, check the boundaries */
+  assert_escaped_text_with_unsafe_chars("a plain text longer than a word with a \"quote\" in it\n",
+                                        "a plain text longer than a word with a \\\"quote\\\" in it\\n", "\"");
+  assert_escaped_text("0123456789abcdef\\0123456789abcdefárvíztűrő\x7",
+                      "0123456789abcdef\\\\0123456789abcdefárvíztűrő\\u0007");
+
+  /* characters below U+00C0 are reproduced as is too, not as a single byte */
+  assert_escaped_binary("\xc2\xa9 2016", "\xc2\xa9 2016");
+  assert_escaped_text("0123456789abcdef\xc2\xa9\xe2\x82\xac\xf0\x9f\x98\x80\xc0\xaf",
+                      "0123456789abcdef\xc2\xa9\xe2\x82\xac\xf0\x9f\x98\x80\\\\xc0\\\\xaf");
+
+  assert_utf8_validate_matches_glib("", 0);
+  assert_utf8_validate_matches_glib("plain ascii text, longer than sixteen bytes", -1);
+  assert_utf8_validate_matches_glib("árvíztűrőtükörfúrógép árvíztűrőtükörfúrógép", -1);
+  assert_utf8_validate_matches_glib("0123456789abcdef\xe2\x82\xac\xf0\x9f\x98\x80", -1);
+  assert_utf8_validate_matches_glib("0123456789abcdef\xad", -1);
+  assert_utf8_validate_matches_glib("0123456789abcdef\xc0\xaf", -1);
+  assert_utf8_validate_matches_glib("0123456789abcdef\xed\xa0\x80", -1);
+  assert_utf8_validate_matches_glib("0123456789abcdef\xf4\x90\x80\x80", -1);
+  assert_utf8_validate_matches_glib("0123456789abcdef\xe2\x82", -1);
+  assert_utf8_validate_matches_glib("0123456789abcdef\0after a NUL", 28);
+
   return 0;
 }
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "testutils.h"
+#include "apphook.h"
+#include "cfg.h"
+#include "template/templates.h"
+
+static GlobalConfig *
+_create_config_with_template(const gchar *template_string)
+{
+  GlobalConfig *cfg = cfg_new(VERSION_VALUE);
+  LogTemplate *template = log_template_new(cfg, NULL);
+
+  assert_true(log_template_compile(template, template_string, NULL), "Error compiling template");
+  log_template_unref(template);
+
+  /* this is what cfg_init() does once the configuration is started */
+  cfg->value_references_frozen = cfg->skip_unreferenced_values;
+  return cfg;
+}
+
+static void
+test_values_in_templates_are_referenced(void)
+{
+  GlobalConfig *cfg = _create_config_with_template("$referenced_value ${.json.foo}");
+
+  assert_true(cfg_is_value_referenced(cfg, log_msg_get_value_handle("referenced_value")),
+              "Value used in a template is not referenced");
+  assert_true(cfg_is_value_referenced(cfg, log_msg_get_value_handle(".json.foo")),
+              "Value used in a template is not referenced");
+  assert_false(cfg_is_value_referenced(cfg, log_msg_get_value_handle("unreferenced_value")),
+               "Value not used anywhere is referenced");
+  assert_true(cfg_is_value_referenced(cfg, LM_V_PROGRAM),
+              "Built-in values should always be referenced");
+  cfg_free(cfg);
+}
+
+static void
+test_everything_is_referenced_before_the_config_is_started(void)
+{
+  GlobalConfig *cfg = cfg_new(VERSION_VALUE);
+
+  assert_true(cfg_is_value_referenced(cfg, log_msg_get_value_handle("unreferenced_value")),
+              "Values should count as referenced while the configuration is being parsed");
+  cfg_free(cfg);
+}
+
+static void
+test_late_references_make_everything_referenced(void)
+{
+  GlobalConfig *cfg = _create_config_with_template("$referenced_value");
+
+  cfg_reference_value(cfg, log_msg_get_value_handle("late_value"));
+  assert_true(cfg_is_value_referenced(cfg, log_msg_get_value_handle("unreferenced_value")),
+              "A reference after starting the configuration should make all values referenced");
+  cfg_free(cfg);
+}
+
+static void
+test_sdata_macro_references_everything(void)
+{
+  GlobalConfig *cfg = _create_config_with_template("$SDATA");
+
+  assert_true(cfg_is_value_referenced(cfg, log_msg_get_value_handle(".SDATA.foo.bar")),
+              "$SDATA should make all values referenced");
+  cfg_free(cfg);
+}
+
+static void
+test_the_analysis_can_be_disabled(void)
+{
+  GlobalConfig *cfg = cfg_new(VERSION_VALUE);
+
+  cfg->skip_unreferenced_values = FALSE;
+  cfg->value_references_frozen = cfg->skip_unreferenced_values;
+  assert_true(cfg_is_value_referenced(cfg, log_msg_get_value_handle("unreferenced_value")),
+              "skip-unreferenced-values(no) should keep all values");
+  cfg_free(cfg);
+}
+
+int
+main(int argc, char **argv)
+{
+  app_startup();
+
+  test_values_in_templates_are_referenced();
+  test_everything_is_referenced_before_the_config_is_started();
+  test_late_references_make_everything_referenced();
+  test_sdata_macro_references_everything();
+  test_the_analysis_can_be_disabled();
+
+  app_shutdown();
+  return 0;
+}
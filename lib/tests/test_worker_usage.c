@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "testutils.h"
+#include "apphook.h"
+#include "mainloop-worker.h"
+
+#include <unistd.h>
+
+static void
+test_idle_thread_ids_report_no_usage(void)
+{
+  MainLoopWorkerUsage usage;
+
+  assert_false(main_loop_worker_get_usage(MAIN_LOOP_WORKER_USAGE_SLOTS - 1, &usage),
+               "Unused thread id reported usage");
+}
+
+static void
+test_busy_periods_are_accumulated(void)
+{
+  MainLoopWorkerUsage usage;
+
+  main_loop_worker_set_thread_id(3);
+  main_loop_worker_busy_start();
+  usleep(10000);
+  main_loop_worker_busy_end();
+  main_loop_worker_busy_start();
+  main_loop_worker_busy_end();
+
+  assert_true(main_loop_worker_get_usage(3, &usage), "Busy thread id reported no usage");
+  assert_gint64(usage.jobs, 2, "Number of busy periods mismatch");
+  assert_true(usage.busy_usec >= 10000, "Busy time too small: %" G_GINT64_FORMAT, usage.busy_usec);
+  assert_string(main_loop_worker_get_thread_kind(3), "io", "Thread kind mismatch");
+  assert_string(main_loop_worker_get_thread_kind(MAIN_LOOP_MAX_WORKER_THREADS + 3), "output", "Thread kind mismatch");
+}
+
+static void
+test_current_busy_period_is_included(void)
+{
+  MainLoopWorkerUsage usage;
+
+  main_loop_worker_set_thread_id(4);
+  main_loop_worker_busy_start();
+  usleep(10000);
+
+  assert_true(main_loop_worker_get_usage(4, &usage), "Thread id in a busy period reported no usage");
+  assert_gint64(usage.jobs, 0, "Number of busy periods mismatch");
+  assert_true(usage.busy_usec >= 10000, "Ongoing busy period is not accounted: %" G_GINT64_FORMAT, usage.busy_usec);
+  main_loop_worker_busy_end();
+}
+
+int
+main(int argc, char **argv)
+{
+  app_startup();
+
+  test_idle_thread_ids_report_no_usage();
+  test_busy_periods_are_accumulated();
+  test_current_busy_period_is_included();
+
+  app_shutdown();
+  return 0;
+}
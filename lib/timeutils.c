@@ -99,6 +99,8 @@ TLS_BLOCK_START
   TimeCache gm_time_cache[64];
   struct tm mktime_prev_tm;
   time_t mktime_prev_time;
+  time_t local_tz_window_start;
+  long local_tz_window_ofs;
 }
 TLS_BLOCK_END;
 
@@ -108,6 +110,8 @@ TLS_BLOCK_END;
 #define gm_time_cache        __tls_deref(gm_time_cache)
 #define mktime_prev_tm       __tls_deref(mktime_prev_tm)
 #define mktime_prev_time     __tls_deref(mktime_prev_time)
+#define local_tz_window_start __tls_deref(local_tz_window_start)
+#define local_tz_window_ofs  __tls_deref(local_tz_window_ofs)
 
 #if !defined(SYSLOG_NG_HAVE_LOCALTIME_R) || !defined(SYSLOG_NG_HAVE_GMTIME_R)
 static GStaticMutex localtime_lock = G_STATIC_MUTEX_INIT;
@@ -234,15 +238,8 @@ cached_gmtime(time_t *when, struct tm *tm)
     }
 }
 
-/**
- * get_local_timezone_ofs:
- * @when: time in UTC
- * 
- * Return the zone offset (measured in seconds) of @when expressed in local
- * time. The function also takes care about daylight saving.
- **/
-long
-get_local_timezone_ofs(time_t when)
+static long
+_get_local_timezone_ofs(time_t when)
 {
 #ifdef SYSLOG_NG_HAVE_STRUCT_TM_TM_GMTOFF
   struct tm ltm;
@@ -272,12 +269,50 @@ get_local_timezone_ofs(time_t when)
 #endif /* SYSLOG_NG_HAVE_STRUCT_TM_TM_GMTOFF */
 }
 
+/* zone offsets don't change more than once within this many seconds in any
+ * real-world time zone, and transitions happen at its multiples */
+#define LOCAL_TZ_WINDOW 900
+
+/**
+ * get_local_timezone_ofs:
+ * @when: time in UTC
+ *
+ * Return the zone offset (measured in seconds) of @when expressed in local
+ * time. The function also takes care about daylight saving.
+ *
+ * The offset is cached for the LOCAL_TZ_WINDOW aligned window around @when
+ * if it is the same at both ends of the window, so finding the offset is a
+ * range check for all messages but the first in each window.
+ **/
+long
+get_local_timezone_ofs(time_t when)
+{
+  time_t window_start = when - (when % LOCAL_TZ_WINDOW);
+  long ofs;
+
+  if (when < 0)
+    return _get_local_timezone_ofs(when);
+
+  if (local_tz_window_start != 0 && window_start == local_tz_window_start)
+    return local_tz_window_ofs;
+
+  ofs = _get_local_timezone_ofs(when);
+  if (_get_local_timezone_ofs(window_start) == ofs &&
+      _get_local_timezone_ofs(window_start + LOCAL_TZ_WINDOW - 1) == ofs)
+    {
+      local_tz_window_start = window_start;
+      local_tz_window_ofs = ofs;
+    }
+  return ofs;
+}
+
 
 void
 clean_time_cache(void)
 {
   memset(&gm_time_cache, 0, sizeof(gm_time_cache));
   memset(&local_time_cache, 0, sizeof(local_time_cache));
+  local_tz_window_start = 0;
 }
 
 int
@@ -355,7 +390,7 @@ timespec_add_msec(struct timespec *ts, glong msec)
 }
 
 glong
-timspec_diff_msec(struct timespec *t1, struct timespec *t2)
+timespec_diff_msec(struct timespec *t1, struct timespec *t2)
 {
   return (t1->tv_sec - t2->tv_sec) * 1e3 + (t1->tv_nsec - t2->tv_nsec) / 1e6;
 }
@@ -443,11 +478,24 @@ struct _ZoneInfo
 
 struct _TimeZoneInfo
 {
+  gint ref_cnt;
+  /* the key in time_zone_info_cache, NULL if not cached */
+  gchar *name;
   ZoneInfo *zone;
   ZoneInfo *zone64;
   glong zone_offset;
 };
 
+/*
+ * TimeZoneInfo instances are shared among everything (templates, parsers,
+ * sources) referring to the same time zone name, so a zone file is only
+ * parsed once and the offset window remembered by its ZoneInfo is shared
+ * too.  The cache is only consulted when a TimeZoneInfo is created or freed,
+ * i.e. at configuration time, the per-message lookups don't touch it.
+ */
+static GStaticMutex time_zone_info_cache_lock = G_STATIC_MUTEX_INIT;
+static GHashTable *time_zone_info_cache;
+
 /* Read zic-coded 32-bit integer from file*/
 static gint64
 readcoded32(unsigned char **input, gint64 minv, gint64 maxv)
@@ -806,32 +854,49 @@ error:
   return info;
 }
 
+/* returns TRUE if @timestamp falls into the validity window of transition @i */
+static inline gboolean
+zone_info_transition_covers(ZoneInfo *self, gint32 i, gint64 timestamp)
+{
+  if (self->transitions[i].time > timestamp && i > 0)
+    return FALSE;
+  return i == self->timecnt - 1 || timestamp < self->transitions[i + 1].time;
+}
+
+/*
+ * The transition found last is remembered, so that the lookup of the
+ * offsets of consecutive messages is a range check.  The transitions
+ * themselves are never changed after the ZoneInfo is loaded, so the index
+ * can be shared by all threads without locking.  Timestamps before the
+ * first transition use the first one.
+ */
 static gint64
 zone_info_get_offset(ZoneInfo *self, gint64 timestamp)
 {
-  gint32 i = 0;
+  gint32 i, lo, hi;
 
   if (self->transitions == NULL)
     return 0;
 
-  if (self->last_transitions_index != -1 && 
-     self->last_transitions_index < (self->timecnt - 1) && 
-     self->transitions[self->last_transitions_index].time < timestamp &&  
-     self->transitions[self->last_transitions_index + 1].time > timestamp)
-    {
-      return  self->transitions[ self->last_transitions_index ].gmtoffset;
-    }
-  else
+  i = g_atomic_int_get(&self->last_transitions_index);
+  if (i != -1 && zone_info_transition_covers(self, i, timestamp))
+    return self->transitions[i].gmtoffset;
+
+  /* the last transition whose time is not later than timestamp */
+  lo = 0;
+  hi = self->timecnt - 1;
+  while (lo < hi)
     {
-      for (i = 0; i < (self->timecnt - 1); i++)
-        if (self->transitions[i].time < timestamp && 
-            self->transitions[i+1].time > timestamp)
-          break;
- 
-      self->last_transitions_index  = i;
+      gint32 mid = lo + (hi - lo + 1) / 2;
+
+      if (self->transitions[mid].time <= timestamp)
+        lo = mid;
+      else
+        hi = mid - 1;
     }
- 
-  return self->transitions[self->last_transitions_index].gmtoffset;
+
+  g_atomic_int_set(&self->last_transitions_index, lo);
+  return self->transitions[lo].gmtoffset;
 }
 
 static gboolean
@@ -900,10 +965,11 @@ time_zone_info_get_offset(const TimeZoneInfo *self, time_t stamp)
   return -1;
 }
 
-TimeZoneInfo*
-time_zone_info_new(const gchar *tz)
+static TimeZoneInfo *
+_time_zone_info_new(const gchar *tz)
 {
   TimeZoneInfo *self = g_new0(TimeZoneInfo,1);
+  self->ref_cnt = 1;
   self->zone_offset = -1;
  
   /* if no time zone was specified return with an empty TimeZoneInfo pointer */  
@@ -933,7 +999,9 @@ time_zone_info_new(const gchar *tz)
       return self;
     }
 
-  time_zone_info_free(self);
+  zone_info_free(self->zone);
+  zone_info_free(self->zone64);
+  g_free(self);
 
   /* failed to read time zone data */
   msg_error("Bogus timezone spec, must be in the format [+-]HH:MM, offset must be less than 24:00",
@@ -942,12 +1010,54 @@ time_zone_info_new(const gchar *tz)
   return NULL;
 }
 
+TimeZoneInfo*
+time_zone_info_new(const gchar *tz)
+{
+  TimeZoneInfo *self;
+
+  if (!tz)
+    return _time_zone_info_new(NULL);
+
+  g_static_mutex_lock(&time_zone_info_cache_lock);
+  if (!time_zone_info_cache)
+    time_zone_info_cache = g_hash_table_new(g_str_hash, g_str_equal);
+
+  self = g_hash_table_lookup(time_zone_info_cache, tz);
+  if (self)
+    {
+      self->ref_cnt++;
+    }
+  else
+    {
+      self = _time_zone_info_new(tz);
+      if (self)
+        {
+          self->name = g_strdup(tz);
+          g_hash_table_insert(time_zone_info_cache, self->name, self);
+        }
+    }
+  g_static_mutex_unlock(&time_zone_info_cache_lock);
+  return self;
+}
+
 void 
 time_zone_info_free(TimeZoneInfo *self)
 {
   g_assert(self);
 
+  g_static_mutex_lock(&time_zone_info_cache_lock);
+  g_assert(self->ref_cnt > 0);
+  if (--self->ref_cnt > 0)
+    {
+      g_static_mutex_unlock(&time_zone_info_cache_lock);
+      return;
+    }
+  if (self->name)
+    g_hash_table_remove(time_zone_info_cache, self->name);
+  g_static_mutex_unlock(&time_zone_info_cache_lock);
+
   zone_info_free(self->zone);
   zone_info_free(self->zone64);
+  g_free(self->name);
   g_free(self);
 }
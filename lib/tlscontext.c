@@ -259,6 +259,50 @@ tls_session_free(TLSSession *self)
   g_free(self);
 }
 
+/* invoked by libssl in the thread performing the handshake, we keep the reference to @session */
+static int
+tls_context_new_client_session(SSL *ssl, SSL_SESSION *session)
+{
+  TLSSession *self = (TLSSession *) SSL_get_app_data(ssl);
+  TLSContext *ctx = self->ctx;
+  SSL_SESSION *old_session;
+
+  g_static_mutex_lock(&ctx->client_session_lock);
+  old_session = ctx->client_session;
+  ctx->client_session = session;
+  g_static_mutex_unlock(&ctx->client_session_lock);
+
+  if (old_session)
+    SSL_SESSION_free(old_session);
+  return 1;
+}
+
+static void
+tls_context_setup_session_cache(TLSContext *self)
+{
+  if (self->mode == TM_CLIENT)
+    {
+      SSL_CTX_set_session_cache_mode(self->ssl_ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+      SSL_CTX_sess_set_new_cb(self->ssl_ctx, tls_context_new_client_session);
+    }
+  else
+    {
+      /* session tickets are on by default, their keys are generated along
+       * with the SSL_CTX, thus they are rotated at every reload */
+      SSL_CTX_set_session_cache_mode(self->ssl_ctx, SSL_SESS_CACHE_SERVER);
+      SSL_CTX_set_session_id_context(self->ssl_ctx, (const guchar *) "syslog-ng", 9);
+    }
+}
+
+static void
+tls_context_resume_client_session(TLSContext *self, SSL *ssl)
+{
+  g_static_mutex_lock(&self->client_session_lock);
+  if (self->client_session)
+    SSL_set_session(ssl, self->client_session);
+  g_static_mutex_unlock(&self->client_session_lock);
+}
+
 static gboolean
 file_exists(const gchar *fname)
 {
@@ -361,12 +405,16 @@ tls_context_setup_session(TLSContext *self)
           if (!SSL_CTX_set_cipher_list(self->ssl_ctx, self->cipher_suite))
             goto error;
         }
+      tls_context_setup_session_cache(self);
     }
 
   ssl = SSL_new(self->ssl_ctx);
 
   if (self->mode == TM_CLIENT)
-    SSL_set_connect_state(ssl);
+    {
+      tls_context_resume_client_session(self, ssl);
+      SSL_set_connect_state(ssl);
+    }
   else
     SSL_set_accept_state(ssl);
 
@@ -396,12 +444,16 @@ tls_context_new(TLSMode mode)
   self->mode = mode;
   self->verify_mode = TVM_REQUIRED | TVM_TRUSTED;
   self->ssl_options = TSO_NOSSLv2;
+  g_static_mutex_init(&self->client_session_lock);
   return self;
 }
 
 void
 tls_context_free(TLSContext *self)
 {
+  if (self->client_session)
+    SSL_SESSION_free(self->client_session);
+  g_static_mutex_free(&self->client_session_lock);
   SSL_CTX_free(self->ssl_ctx);
   g_list_foreach(self->trusted_fingerpint_list, (GFunc) g_free, NULL);
   g_list_foreach(self->trusted_dn_list, (GFunc) g_free, NULL);
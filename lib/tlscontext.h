@@ -82,6 +82,11 @@ struct _TLSContext
   GList *trusted_fingerpint_list;
   GList *trusted_dn_list;
   gint ssl_options;
+
+  /* the last session negotiated by a client context, used to resume the
+   * session when reconnecting */
+  GStaticMutex client_session_lock;
+  SSL_SESSION *client_session;
 };
 
 
@@ -28,6 +28,8 @@
 #include "syslog-ng.h"
 #include "transport/transport-aux-data.h"
 
+#include <sys/uio.h>
+
 typedef struct _LogTransport LogTransport;
 
 struct _LogTransport
@@ -36,6 +38,13 @@ struct _LogTransport
   GIOCondition cond;
   gssize (*read)(LogTransport *self, gpointer buf, gsize count, LogTransportAuxData *aux);
   gssize (*write)(LogTransport *self, const gpointer buf, gsize count);
+  /* optional, transports without it only write the first buffer.
+   * Datagram transports send every buffer as a separate datagram and
+   * return the total length of the ones sent. */
+  gssize (*writev)(LogTransport *self, const struct iovec *iov, gint iov_count);
+  /* optional, used to free buffers that have been written, for
+   * transports that may still reference them after the write returned */
+  void (*release_buffer)(LogTransport *self, gpointer buf, GDestroyNotify buf_free);
   void (*free_fn)(LogTransport *self);
 };
 
@@ -45,6 +54,25 @@ log_transport_write(LogTransport *self, const gpointer buf, gsize count)
   return self->write(self, buf, count);
 }
 
+static inline gssize
+log_transport_writev(LogTransport *self, const struct iovec *iov, gint iov_count)
+{
+  if (!self->writev)
+    return self->write(self, iov[0].iov_base, iov[0].iov_len);
+  return self->writev(self, iov, iov_count);
+}
+
+static inline void
+log_transport_release_buffer(LogTransport *self, gpointer buf, GDestroyNotify buf_free)
+{
+  if (!buf_free)
+    return;
+  if (self->release_buffer)
+    self->release_buffer(self, buf, buf_free);
+  else
+    buf_free(buf);
+}
+
 static inline gssize
 log_transport_read(LogTransport *self, gpointer buf, gsize count, LogTransportAuxData *aux)
 {
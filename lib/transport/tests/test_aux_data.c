@@ -154,6 +154,24 @@ test_aux_data_copy_separates_the_copies(void)
   free_aux(aux);
 }
 
+static void
+test_aux_data_copy_keeps_the_timestamp_and_allows_appending(void)
+{
+  LogTransportAuxData *aux = construct_aux_with_some_data();
+  LogTransportAuxData aux_copy;
+  struct timespec ts = { 1234, 5678 };
+
+  log_transport_aux_data_set_timestamp(aux, &ts);
+  log_transport_aux_data_copy(&aux_copy, aux);
+  assert_gint(aux_copy.timestamp.tv_sec, 1234, "copy lost the timestamp");
+  assert_gint(aux_copy.timestamp.tv_nsec, 5678, "copy lost the timestamp");
+
+  log_transport_aux_data_add_nv_pair(&aux_copy, "super", "lativus");
+  assert_concatenated_nvpairs(&aux_copy, "foo=bar\nsuper=lativus\n");
+  log_transport_aux_data_destroy(&aux_copy);
+  free_aux(aux);
+}
+
 static void
 test_add_nv_pair_to_a_NULL_aux_data_will_do_nothing(void)
 {
@@ -167,6 +185,7 @@ test_aux_data(void)
   AUX_DATA_TESTCASE(test_aux_data_added_nvpairs_are_returned_by_foreach_in_order);
   AUX_DATA_TESTCASE(test_aux_data_copy_creates_an_identical_copy);
   AUX_DATA_TESTCASE(test_aux_data_copy_separates_the_copies);
+  AUX_DATA_TESTCASE(test_aux_data_copy_keeps_the_timestamp_and_allows_appending);
   AUX_DATA_TESTCASE(test_add_nv_pair_to_a_NULL_aux_data_will_do_nothing);
 }
 
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2002-2013 Balabit
+ * Copyright (c) 1998-2013 Balázs Scheidler
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ */
+#include "testutils.h"
+#include "transport/transport-file.h"
+#include "apphook.h"
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <errno.h>
+
+/* large enough to trigger catch-up mode, and not a multiple of the chunk size */
+#define BACKLOG_SIZE (3 * 1024 * 1024 + 12345)
+
+static guchar *
+construct_backlog(void)
+{
+  guchar *data = g_malloc(BACKLOG_SIZE);
+  gsize i;
+
+  for (i = 0; i < BACKLOG_SIZE; i++)
+    data[i] = (i * 7 + i / 1000) & 0xff;
+  return data;
+}
+
+static gsize
+read_until_eagain(LogTransport *transport, guchar *buf, gsize read_size)
+{
+  gsize total = 0;
+  gssize rc;
+
+  while ((rc = log_transport_read(transport, buf + total, read_size, NULL)) > 0)
+    total += rc;
+
+  assert_gint(rc, -1, "Reading the end of the file should fail");
+  assert_gint(errno, EAGAIN, "The end of the file should be reported with EAGAIN");
+  return total;
+}
+
+static void
+test_backlog_is_read_completely(gsize read_size)
+{
+  gchar filename[] = "test_transport_file.XXXXXX";
+  guchar *backlog = construct_backlog();
+  guchar *buf = g_malloc(BACKLOG_SIZE + 64);
+  LogTransport *transport;
+  gint wfd, fd;
+
+  wfd = mkstemp(filename);
+  assert_gint(write(wfd, backlog, BACKLOG_SIZE), BACKLOG_SIZE, "Error writing test file");
+
+  fd = open(filename, O_RDONLY | O_NONBLOCK);
+  transport = log_transport_file_new(fd);
+
+  assert_guint64(read_until_eagain(transport, buf, read_size), BACKLOG_SIZE,
+                 "Backlog was not read completely, read_size=%d", (gint) read_size);
+  assert_true(memcmp(buf, backlog, BACKLOG_SIZE) == 0, "Backlog was read incorrectly, read_size=%d", (gint) read_size);
+  assert_gint64(lseek(fd, 0, SEEK_CUR), BACKLOG_SIZE, "The fd position should match the data consumed once EAGAIN is returned");
+
+  /* back to normal mode, the file is now read as it's written */
+  assert_gint(write(wfd, "foobar\n", 7), 7, "Error writing test file");
+  assert_guint64(read_until_eagain(transport, buf, read_size), 7, "Appended data was not read");
+  assert_nstring((gchar *) buf, 7, "foobar\n", 7, "Appended data was read incorrectly");
+
+  log_transport_free(transport);
+  close(wfd);
+  unlink(filename);
+  g_free(buf);
+  g_free(backlog);
+}
+
+int
+main(int argc, char *argv[])
+{
+  app_startup();
+
+  test_backlog_is_read_completely(65536);
+  test_backlog_is_read_completely(300000);
+  test_backlog_is_read_completely(100);
+
+  app_shutdown();
+  return 0;
+}
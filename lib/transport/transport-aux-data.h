@@ -25,18 +25,25 @@
 
 #include "gsockaddr.h"
 #include <string.h>
+#include <stddef.h>
+#include <time.h>
 
 typedef struct _LogTransportAuxData
 {
   GSockAddr *peer_addr;
-  gchar data[1024];
+  /* receive time as reported by the kernel, tv_sec == 0 if unknown */
+  struct timespec timestamp;
   gsize end_ptr;
+  /* must be the last member, only its used part is copied */
+  gchar data[1024];
 } LogTransportAuxData;
 
 static inline void
 log_transport_aux_data_init(LogTransportAuxData *self)
 {
   self->peer_addr = NULL;
+  self->timestamp.tv_sec = 0;
+  self->timestamp.tv_nsec = 0;
   self->end_ptr = 0;
   self->data[0] = 0;
 }
@@ -57,7 +64,8 @@ log_transport_aux_data_reinit(LogTransportAuxData *self)
 static inline void
 log_transport_aux_data_copy(LogTransportAuxData *dst, LogTransportAuxData *src)
 {
-  gsize data_to_copy = sizeof(*src) - sizeof(src->data) + src->end_ptr;
+  /* the used part of data, including the terminating NUL */
+  gsize data_to_copy = offsetof(LogTransportAuxData, data) + src->end_ptr + 1;
 
   memcpy(dst, src, data_to_copy);
   g_sockaddr_ref(dst->peer_addr);
@@ -71,6 +79,13 @@ log_transport_aux_data_set_peer_addr_ref(LogTransportAuxData *self, GSockAddr *p
   self->peer_addr = peer_addr;
 }
 
+static inline void
+log_transport_aux_data_set_timestamp(LogTransportAuxData *self, const struct timespec *timestamp)
+{
+  if (self)
+    self->timestamp = *timestamp;
+}
+
 void log_transport_aux_data_add_nv_pair(LogTransportAuxData *self, const gchar *name, const gchar *value);
 void log_transport_aux_data_foreach(LogTransportAuxData *self, void (*func)(const gchar *, const gchar *, gsize, gpointer), gpointer user_data);
 
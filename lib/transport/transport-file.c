@@ -22,21 +22,167 @@
  */
 
 #include "transport-file.h"
+#include "messages.h"
 
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <string.h>
 #include <errno.h>
 #include <unistd.h>
 
+/*
+ * Catch-up mode
+ *
+ * When a followed file has a large backlog (e.g. after a restart), the
+ * file is read in CATCH_UP_CHUNK_SIZE chunks into a buffer of our own,
+ * and reads of the LogProto on top of us (bounded by log-msg-size()) are
+ * served from that.  The kernel is told to read ahead sequentially, and
+ * to fetch the next chunk while the current one is being processed.
+ *
+ * The buffer is always drained before we return EAGAIN, so whenever the
+ * reader goes back to polling the file, the fd position is the same as
+ * the position of the data consumed, just like without catch-up.
+ *
+ * We don't mmap() the file: the data is copied into the LogProto buffer
+ * anyway, and a mapping would SIGBUS if the file was truncated under us
+ * (copytruncate rotation).
+ */
+#define CATCH_UP_CHUNK_SIZE (256 * 1024)
+#define CATCH_UP_THRESHOLD  (1024 * 1024)
+
 static gssize
-log_transport_file_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
+_read_fd(gint fd, gpointer buf, gsize buflen)
 {
-  LogTransportFile *self = (LogTransportFile *) s;
-  gint rc;
-  
+  gssize rc;
+
   do
     {
-      rc = read(self->super.fd, buf, buflen);
+      rc = read(fd, buf, buflen);
     }
   while (rc == -1 && errno == EINTR);
+  return rc;
+}
+
+static void
+log_transport_file_start_catch_up(LogTransportFile *self)
+{
+  struct stat st;
+  off_t pos;
+
+  self->check_backlog = FALSE;
+
+  pos = lseek(self->super.fd, 0, SEEK_CUR);
+  if (pos == (off_t) -1 || fstat(self->super.fd, &st) < 0 || !S_ISREG(st.st_mode))
+    return;
+
+  if (st.st_size - pos < CATCH_UP_THRESHOLD)
+    return;
+
+  msg_debug("Catching up with the backlog of a followed file",
+            evt_tag_int("fd", self->super.fd),
+            evt_tag_long("backlog", (long) (st.st_size - pos)),
+            NULL);
+
+  self->catch_up_buffer = g_malloc(CATCH_UP_CHUNK_SIZE);
+  self->catching_up = TRUE;
+#if SYSLOG_NG_HAVE_POSIX_FADVISE
+  posix_fadvise(self->super.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
+static void
+log_transport_file_stop_catch_up(LogTransportFile *self)
+{
+  self->catching_up = FALSE;
+  g_free(self->catch_up_buffer);
+  self->catch_up_buffer = NULL;
+  self->catch_up_pos = self->catch_up_len = 0;
+#if SYSLOG_NG_HAVE_POSIX_FADVISE
+  posix_fadvise(self->super.fd, 0, 0, POSIX_FADV_NORMAL);
+#endif
+}
+
+static gssize
+log_transport_file_fill_catch_up_buffer(LogTransportFile *self)
+{
+  gssize rc;
+
+  rc = _read_fd(self->super.fd, self->catch_up_buffer, CATCH_UP_CHUNK_SIZE);
+  if (rc <= 0)
+    return rc;
+
+  self->catch_up_pos = 0;
+  self->catch_up_len = rc;
+  if (rc < CATCH_UP_CHUNK_SIZE)
+    {
+      /* we are close to the end, switch back once this chunk is consumed */
+      self->catching_up = FALSE;
+    }
+#if SYSLOG_NG_HAVE_POSIX_FADVISE
+  else
+    {
+      off_t pos = lseek(self->super.fd, 0, SEEK_CUR);
+
+      if (pos != (off_t) -1)
+        posix_fadvise(self->super.fd, pos, CATCH_UP_CHUNK_SIZE, POSIX_FADV_WILLNEED);
+    }
+#endif
+  return rc;
+}
+
+static gssize
+log_transport_file_read_catching_up(LogTransportFile *self, guchar *buf, gsize buflen)
+{
+  gsize total = 0, len;
+  gssize rc = 0;
+
+  while (total < buflen)
+    {
+      if (self->catch_up_pos == self->catch_up_len)
+        {
+          if (!self->catching_up)
+            break;
+
+          rc = log_transport_file_fill_catch_up_buffer(self);
+          if (rc <= 0)
+            break;
+        }
+
+      len = MIN(buflen - total, self->catch_up_len - self->catch_up_pos);
+      memcpy(buf + total, self->catch_up_buffer + self->catch_up_pos, len);
+      self->catch_up_pos += len;
+      total += len;
+    }
+
+  if (self->catch_up_pos == self->catch_up_len && (!self->catching_up || rc <= 0))
+    log_transport_file_stop_catch_up(self);
+
+  /* errors are reported once the data read before them is consumed */
+  return total > 0 ? (gssize) total : rc;
+}
+
+static gssize
+log_transport_file_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
+{
+  LogTransportFile *self = (LogTransportFile *) s;
+  gssize rc;
+
+  if (self->check_backlog && !self->catch_up_buffer)
+    log_transport_file_start_catch_up(self);
+
+  if (self->catch_up_buffer)
+    {
+      rc = log_transport_file_read_catching_up(self, buf, buflen);
+    }
+  else
+    {
+      rc = _read_fd(self->super.fd, buf, buflen);
+
+      /* a full read may mean there's a lot more to come */
+      if (self->catch_up_enabled && rc == (gssize) buflen)
+        self->check_backlog = TRUE;
+    }
 
   if (rc == 0)
     {
@@ -61,13 +207,37 @@ log_transport_file_write_method(LogTransport *s, const gpointer buf, gsize bufle
   return rc;
 }
 
+static gssize
+log_transport_file_writev_method(LogTransport *s, const struct iovec *iov, gint iov_count)
+{
+  LogTransportFile *self = (LogTransportFile *) s;
+  gssize rc;
+
+  do
+    {
+      rc = writev(self->super.fd, iov, iov_count);
+    }
+  while (rc == -1 && errno == EINTR);
+  return rc;
+}
+
+static void
+log_transport_file_free_method(LogTransport *s)
+{
+  LogTransportFile *self = (LogTransportFile *) s;
+
+  g_free(self->catch_up_buffer);
+  log_transport_free_method(s);
+}
+
 void
 log_transport_file_init_instance(LogTransportFile *self, gint fd)
 {
   log_transport_init_instance(&self->super, fd);
   self->super.read = log_transport_file_read_method;
   self->super.write = log_transport_file_write_method;
-  self->super.free_fn = log_transport_free_method;
+  self->super.writev = log_transport_file_writev_method;
+  self->super.free_fn = log_transport_file_free_method;
 }
 
 /* regular files */
@@ -77,5 +247,7 @@ log_transport_file_new(gint fd)
   LogTransportFile *self = g_new0(LogTransportFile, 1);
 
   log_transport_file_init_instance(self, fd);
+  self->catch_up_enabled = TRUE;
+  self->check_backlog = TRUE;
   return &self->super;
 }
@@ -32,6 +32,11 @@ typedef struct _LogTransportFile LogTransportFile;
 struct _LogTransportFile
 {
   LogTransport super;
+
+  /* catch-up mode, only used for regular files, see transport-file.c */
+  gboolean catch_up_enabled:1, check_backlog:1, catching_up:1;
+  guchar *catch_up_buffer;
+  gsize catch_up_pos, catch_up_len;
 };
 
 void log_transport_file_init_instance(LogTransportFile *self, gint fd);
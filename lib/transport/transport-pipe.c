@@ -76,5 +76,9 @@ log_transport_pipe_new(gint fd)
 
   log_transport_file_init_instance(self, fd);
   self->super.write = log_transport_pipe_write_method;
+#ifdef __aix__
+  /* AIX needs the size-decreasing retries of the write method */
+  self->super.writev = NULL;
+#endif
   return &self->super;
 }
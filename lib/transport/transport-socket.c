@@ -25,6 +25,14 @@
 
 #include <errno.h>
 #include <unistd.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#include <linux/errqueue.h>
+#define LOG_TRANSPORT_SOCKET_ZEROCOPY 1
+#endif
 
 static gssize
 log_transport_dgram_socket_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
@@ -52,6 +60,176 @@ log_transport_dgram_socket_read_method(LogTransport *s, gpointer buf, gsize bufl
   return rc;
 }
 
+#ifdef SYSLOG_NG_HAVE_RECVMMSG
+
+/*
+ * Datagrams are received in batches of up to
+ * LOG_TRANSPORT_DGRAM_SOCKET_RECV_BATCH with a single recvmmsg() call and
+ * handed out one by one by the read method, so a LogReader fetching a
+ * burst of messages does a syscall per batch instead of one per message.
+ *
+ * The read method only returns EAGAIN once the batch is used up, thus the
+ * LogReader never waits for the fd to become readable while there are
+ * received datagrams pending here.
+ */
+#define LOG_TRANSPORT_DGRAM_SOCKET_RECV_BATCH 8
+
+/*
+ * Where available, the kernel is asked to stamp each received datagram
+ * (SO_TIMESTAMPNS), the stamp is passed on in LogTransportAuxData and used
+ * as the receive time of the message: it is accurate per datagram,
+ * instead of being the time the batch is processed.
+ */
+#ifdef SO_TIMESTAMPNS
+#define LOG_TRANSPORT_DGRAM_SOCKET_TIMESTAMP_SIZE CMSG_SPACE(sizeof(struct timespec))
+#else
+#define LOG_TRANSPORT_DGRAM_SOCKET_TIMESTAMP_SIZE 0
+#endif
+
+struct _LogTransportDGramRecvBatch
+{
+  guchar *buffers;
+  gsize buffer_size;
+  guchar *controls;
+  gsize control_size;
+  gboolean timestamping;
+  struct mmsghdr msgs[LOG_TRANSPORT_DGRAM_SOCKET_RECV_BATCH];
+  struct iovec iov[LOG_TRANSPORT_DGRAM_SOCKET_RECV_BATCH];
+  struct sockaddr_storage addrs[LOG_TRANSPORT_DGRAM_SOCKET_RECV_BATCH];
+  gint count, pos;
+};
+
+/* only done for sockets we actually read from, it makes the kernel stamp every packet */
+static gboolean
+log_transport_dgram_socket_enable_timestamping(LogTransportSocket *self)
+{
+#ifdef SO_TIMESTAMPNS
+  gint on = 1;
+
+  return setsockopt(self->super.fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) == 0;
+#else
+  return FALSE;
+#endif
+}
+
+static void
+log_transport_dgram_socket_feed_timestamp(struct msghdr *msg, LogTransportAuxData *aux)
+{
+#ifdef SO_TIMESTAMPNS
+  struct cmsghdr *cmsg;
+
+  for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg))
+    {
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS)
+        {
+          struct timespec ts;
+
+          memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+          log_transport_aux_data_set_timestamp(aux, &ts);
+          break;
+        }
+    }
+#endif
+}
+
+static gint
+log_transport_dgram_socket_fill_recv_batch(LogTransportSocket *self, gsize buflen)
+{
+  LogTransportDGramRecvBatch *batch = self->recv_batch;
+  gint i, rc;
+
+  if (!batch)
+    {
+      batch = self->recv_batch = g_new0(LogTransportDGramRecvBatch, 1);
+      batch->timestamping = log_transport_dgram_socket_enable_timestamping(self);
+      batch->control_size = self->recv_control_size +
+                            (batch->timestamping ? LOG_TRANSPORT_DGRAM_SOCKET_TIMESTAMP_SIZE : 0);
+    }
+
+  if (batch->buffer_size < buflen)
+    {
+      g_free(batch->buffers);
+      batch->buffers = g_malloc(buflen * LOG_TRANSPORT_DGRAM_SOCKET_RECV_BATCH);
+      batch->buffer_size = buflen;
+    }
+
+  if (batch->control_size && !batch->controls)
+    batch->controls = g_malloc(batch->control_size * LOG_TRANSPORT_DGRAM_SOCKET_RECV_BATCH);
+
+  memset(batch->msgs, 0, sizeof(batch->msgs));
+  for (i = 0; i < LOG_TRANSPORT_DGRAM_SOCKET_RECV_BATCH; i++)
+    {
+      batch->iov[i].iov_base = batch->buffers + i * batch->buffer_size;
+      batch->iov[i].iov_len = batch->buffer_size;
+      batch->msgs[i].msg_hdr.msg_iov = &batch->iov[i];
+      batch->msgs[i].msg_hdr.msg_iovlen = 1;
+      batch->msgs[i].msg_hdr.msg_name = &batch->addrs[i];
+      batch->msgs[i].msg_hdr.msg_namelen = sizeof(batch->addrs[i]);
+      if (batch->controls)
+        {
+          batch->msgs[i].msg_hdr.msg_control = batch->controls + i * batch->control_size;
+          batch->msgs[i].msg_hdr.msg_controllen = batch->control_size;
+        }
+    }
+
+  do
+    {
+      rc = recvmmsg(self->super.fd, batch->msgs, LOG_TRANSPORT_DGRAM_SOCKET_RECV_BATCH, MSG_DONTWAIT, NULL);
+    }
+  while (rc == -1 && errno == EINTR);
+
+  batch->pos = 0;
+  batch->count = MAX(rc, 0);
+  return rc;
+}
+
+static gssize
+log_transport_dgram_socket_read_batched_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
+{
+  LogTransportSocket *self = (LogTransportSocket *) s;
+  LogTransportDGramRecvBatch *batch;
+  struct mmsghdr *msg;
+  gsize len;
+  gint rc;
+
+  while (1)
+    {
+      if (!self->recv_batch || self->recv_batch->pos == self->recv_batch->count)
+        {
+          rc = log_transport_dgram_socket_fill_recv_batch(self, buflen);
+          if (rc < 0)
+            return rc;
+          if (rc == 0)
+            {
+              /* DGRAM sockets should never return EOF, they just need to be read again */
+              errno = EAGAIN;
+              return -1;
+            }
+        }
+
+      batch = self->recv_batch;
+      msg = &batch->msgs[batch->pos];
+      batch->pos++;
+
+      /* skip empty datagrams, we must not return EAGAIN while the batch is not yet used up */
+      len = MIN(msg->msg_len, buflen);
+      if (len == 0)
+        continue;
+
+      memcpy(buf, msg->msg_hdr.msg_iov->iov_base, len);
+      if (msg->msg_hdr.msg_namelen && aux)
+        log_transport_aux_data_set_peer_addr_ref(aux, g_sockaddr_new((struct sockaddr *) msg->msg_hdr.msg_name,
+                                                                     msg->msg_hdr.msg_namelen));
+      if (batch->timestamping)
+        log_transport_dgram_socket_feed_timestamp(&msg->msg_hdr, aux);
+      if (self->process_recv_control)
+        self->process_recv_control(self, &msg->msg_hdr, aux);
+      return len;
+    }
+}
+
+#endif
+
 static gssize
 log_transport_dgram_socket_write_method(LogTransport *s, const gpointer buf, gsize buflen)
 {
@@ -78,12 +256,76 @@ log_transport_dgram_socket_write_method(LogTransport *s, const gpointer buf, gsi
   return rc;
 }
 
+#ifdef SYSLOG_NG_HAVE_SENDMMSG
+
+#define LOG_TRANSPORT_DGRAM_SOCKET_MAX_BATCH 64
+
+/* sends every buffer as a separate datagram with as few sendmmsg() calls as possible */
+static gssize
+log_transport_dgram_socket_writev_method(LogTransport *s, const struct iovec *iov, gint iov_count)
+{
+  LogTransportSocket *self = (LogTransportSocket *) s;
+  struct mmsghdr msgs[LOG_TRANSPORT_DGRAM_SOCKET_MAX_BATCH];
+  gint i, rc, count;
+  gssize len = 0;
+
+  count = MIN(iov_count, LOG_TRANSPORT_DGRAM_SOCKET_MAX_BATCH);
+  memset(msgs, 0, sizeof(msgs[0]) * count);
+  for (i = 0; i < count; i++)
+    {
+      msgs[i].msg_hdr.msg_iov = (struct iovec *) &iov[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+  do
+    {
+      rc = sendmmsg(self->super.fd, msgs, count, 0);
+    }
+  while (rc == -1 && errno == EINTR);
+
+  /* NOTE: ENOBUFS is handled as a success, see the comment in
+   * log_transport_dgram_socket_write_method() above */
+  if (rc < 0 && errno == ENOBUFS)
+    rc = 1;
+  if (rc < 0)
+    return rc;
+
+  for (i = 0; i < rc; i++)
+    len += iov[i].iov_len;
+  return len;
+}
+
+#endif
+
+void
+log_transport_dgram_socket_free_method(LogTransport *s)
+{
+#ifdef SYSLOG_NG_HAVE_RECVMMSG
+  LogTransportSocket *self = (LogTransportSocket *) s;
+
+  if (self->recv_batch)
+    {
+      g_free(self->recv_batch->buffers);
+      g_free(self->recv_batch->controls);
+      g_free(self->recv_batch);
+    }
+#endif
+  log_transport_free_method(s);
+}
+
 void
 log_transport_dgram_socket_init_instance(LogTransportSocket *self, gint fd)
 {
   log_transport_init_instance(&self->super, fd);
   self->super.read = log_transport_dgram_socket_read_method;
   self->super.write = log_transport_dgram_socket_write_method;
+  self->super.free_fn = log_transport_dgram_socket_free_method;
+#ifdef SYSLOG_NG_HAVE_RECVMMSG
+  self->super.read = log_transport_dgram_socket_read_batched_method;
+#endif
+#ifdef SYSLOG_NG_HAVE_SENDMMSG
+  self->super.writev = log_transport_dgram_socket_writev_method;
+#endif
 }
 
 LogTransport *
@@ -109,12 +351,175 @@ log_transport_stream_socket_read_method(LogTransport *s, gpointer buf, gsize buf
   return rc;
 }
 
+#if LOG_TRANSPORT_SOCKET_ZEROCOPY
+
+/*
+ * MSG_ZEROCOPY support
+ *
+ * Large writes are sent with MSG_ZEROCOPY, which means that the kernel
+ * references our buffers instead of copying them into the socket buffer.
+ * The buffers can only be freed once the kernel signals the completion of
+ * the send via the socket's error queue.  Buffers released by the LogProto
+ * are therefore kept on a queue, tagged with the id of the last zerocopy
+ * send, and freed when that send completes.  Small writes are not worth
+ * the page pinning and the completion notifications, they are copied as
+ * usual.
+ */
+#define LOG_TRANSPORT_SOCKET_ZEROCOPY_MIN_SIZE 16384
+
+typedef struct _ZerocopyBuffer
+{
+  guint32 id;
+  gpointer buf;
+  GDestroyNotify buf_free;
+} ZerocopyBuffer;
+
+static inline gboolean
+_zerocopy_id_before(guint32 id1, guint32 id2)
+{
+  return (gint32) (id1 - id2) < 0;
+}
+
+static void
+log_transport_stream_socket_free_completed_buffers(LogTransportSocket *self)
+{
+  ZerocopyBuffer *zb;
+
+  while ((zb = g_queue_peek_head(self->zerocopy_buffers)) &&
+         _zerocopy_id_before(zb->id, self->zerocopy_completed))
+    {
+      g_queue_pop_head(self->zerocopy_buffers);
+      zb->buf_free(zb->buf);
+      g_free(zb);
+    }
+}
+
+static void
+log_transport_stream_socket_reap_zerocopy_completions(LogTransportSocket *self)
+{
+  gchar control[128];
+  struct msghdr msg;
+  struct cmsghdr *cmsg;
+  struct sock_extended_err *serr;
+
+  while (self->zerocopy_completed != self->zerocopy_sent)
+    {
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      if (recvmsg(self->super.fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+        break;
+
+      for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+          if (!((cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_RECVERR) ||
+                (cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)))
+            continue;
+
+          serr = (struct sock_extended_err *) CMSG_DATA(cmsg);
+          if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+            continue;
+
+          /* sends [ee_info, ee_data] are completed, TCP completes them in order */
+          if (_zerocopy_id_before(self->zerocopy_completed, serr->ee_data + 1))
+            self->zerocopy_completed = serr->ee_data + 1;
+        }
+    }
+  log_transport_stream_socket_free_completed_buffers(self);
+}
+
+static gssize
+log_transport_stream_socket_send_zerocopy(LogTransportSocket *self, const struct iovec *iov, gint iov_count)
+{
+  struct msghdr msg;
+  gsize len = 0;
+  gssize rc;
+  gint i, flags = 0;
+
+  log_transport_stream_socket_reap_zerocopy_completions(self);
+
+  for (i = 0; i < iov_count; i++)
+    len += iov[i].iov_len;
+  if (len >= LOG_TRANSPORT_SOCKET_ZEROCOPY_MIN_SIZE)
+    flags = MSG_ZEROCOPY;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = (struct iovec *) iov;
+  msg.msg_iovlen = iov_count;
+  do
+    {
+      rc = sendmsg(self->super.fd, &msg, flags);
+
+      /* out of option memory for the notifications, copy this one */
+      if (rc == -1 && errno == ENOBUFS && flags)
+        {
+          flags = 0;
+          errno = EINTR;
+        }
+    }
+  while (rc == -1 && errno == EINTR);
+
+  if (rc > 0 && flags)
+    self->zerocopy_sent++;
+  return rc;
+}
+
+static void
+log_transport_stream_socket_release_buffer_method(LogTransport *s, gpointer buf, GDestroyNotify buf_free)
+{
+  LogTransportSocket *self = (LogTransportSocket *) s;
+  ZerocopyBuffer *zb;
+
+  if (self->zerocopy_completed == self->zerocopy_sent)
+    {
+      buf_free(buf);
+      return;
+    }
+
+  /* the buffer might be referenced by any of the sends in flight */
+  zb = g_new(ZerocopyBuffer, 1);
+  zb->id = self->zerocopy_sent - 1;
+  zb->buf = buf;
+  zb->buf_free = buf_free;
+  g_queue_push_tail(self->zerocopy_buffers, zb);
+}
+
+static void
+log_transport_stream_socket_free_zerocopy_buffers(LogTransportSocket *self)
+{
+  ZerocopyBuffer *zb;
+
+  log_transport_stream_socket_reap_zerocopy_completions(self);
+
+  /* the connection is going away, whatever is not completed by now is
+   * not going to be delivered anyway */
+  while ((zb = g_queue_pop_head(self->zerocopy_buffers)))
+    {
+      zb->buf_free(zb->buf);
+      g_free(zb);
+    }
+  g_queue_free(self->zerocopy_buffers);
+}
+
+#endif
+
 static gssize
 log_transport_stream_socket_write_method(LogTransport *s, const gpointer buf, gsize buflen)
 {
   LogTransportSocket *self = (LogTransportSocket *) s;
   gint rc;
 
+#if LOG_TRANSPORT_SOCKET_ZEROCOPY
+  if (self->zerocopy)
+    {
+      struct iovec iov;
+
+      iov.iov_base = buf;
+      iov.iov_len = buflen;
+      return log_transport_stream_socket_send_zerocopy(self, &iov, 1);
+    }
+#endif
+
   do
     {
       rc = send(self->super.fd, buf, buflen, 0);
@@ -123,19 +528,66 @@ log_transport_stream_socket_write_method(LogTransport *s, const gpointer buf, gs
   return rc;
 }
 
-static void
+static gssize
+log_transport_stream_socket_writev_method(LogTransport *s, const struct iovec *iov, gint iov_count)
+{
+  LogTransportSocket *self = (LogTransportSocket *) s;
+  gssize rc;
+
+#if LOG_TRANSPORT_SOCKET_ZEROCOPY
+  if (self->zerocopy)
+    return log_transport_stream_socket_send_zerocopy(self, iov, iov_count);
+#endif
+
+  do
+    {
+      rc = writev(self->super.fd, iov, iov_count);
+    }
+  while (rc == -1 && errno == EINTR);
+  return rc;
+}
+
+void
 log_transport_stream_socket_free_method(LogTransport *s)
 {
+#if LOG_TRANSPORT_SOCKET_ZEROCOPY
+  LogTransportSocket *self = (LogTransportSocket *) s;
+
+  if (self->zerocopy)
+    log_transport_stream_socket_free_zerocopy_buffers(self);
+#endif
   shutdown(s->fd, SHUT_RDWR);
   log_transport_free_method(s);
 }
 
+/* Send large writes with MSG_ZEROCOPY, returns FALSE if that's not
+ * supported by the platform or the socket. */
+gboolean
+log_transport_stream_socket_enable_zerocopy(LogTransport *s)
+{
+#if LOG_TRANSPORT_SOCKET_ZEROCOPY
+  LogTransportSocket *self = (LogTransportSocket *) s;
+  gint on = 1;
+
+  if (setsockopt(self->super.fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) < 0)
+    return FALSE;
+
+  self->zerocopy = TRUE;
+  self->zerocopy_buffers = g_queue_new();
+  self->super.release_buffer = log_transport_stream_socket_release_buffer_method;
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+
 void
 log_transport_stream_socket_init_instance(LogTransportSocket *self, gint fd)
 {
   log_transport_init_instance(&self->super, fd);
   self->super.read = log_transport_stream_socket_read_method;
   self->super.write = log_transport_stream_socket_write_method;
+  self->super.writev = log_transport_stream_socket_writev_method;
   self->super.free_fn = log_transport_stream_socket_free_method;
 }
 
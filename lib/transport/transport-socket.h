@@ -27,16 +27,34 @@
 
 #include "logtransport.h"
 
+#include <sys/socket.h>
+
 typedef struct _LogTransportSocket LogTransportSocket;
+typedef struct _LogTransportDGramRecvBatch LogTransportDGramRecvBatch;
 struct _LogTransportSocket
 {
   LogTransport super;
+
+  /* datagrams received by the last recvmmsg() call, not yet read */
+  LogTransportDGramRecvBatch *recv_batch;
+  /* ancillary data of received datagrams, for transports that need it */
+  gsize recv_control_size;
+  void (*process_recv_control)(LogTransportSocket *self, struct msghdr *msg, LogTransportAuxData *aux);
+
+  /* MSG_ZEROCOPY state of stream sockets */
+  gboolean zerocopy;
+  /* number of zerocopy sends so far, and the id of the first one not yet completed */
+  guint32 zerocopy_sent, zerocopy_completed;
+  GQueue *zerocopy_buffers;
 };
 
 void log_transport_dgram_socket_init_instance(LogTransportSocket *self, gint fd);
+void log_transport_dgram_socket_free_method(LogTransport *s);
 LogTransport *log_transport_dgram_socket_new(gint fd);
 
 void log_transport_stream_socket_init_instance(LogTransportSocket *self, gint fd);
+void log_transport_stream_socket_free_method(LogTransport *s);
 LogTransport *log_transport_stream_socket_new(gint fd);
+gboolean log_transport_stream_socket_enable_zerocopy(LogTransport *s);
 
 #endif
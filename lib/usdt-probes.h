@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#ifndef USDT_PROBES_H_INCLUDED
+#define USDT_PROBES_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/*
+ * Statically defined tracepoints (USDT) on the message hot paths.
+ *
+ * When compiled with --enable-usdt, every probe is a single nop
+ * instruction plus a note in the .note.stapsdt section, which perf,
+ * bpftrace or systemtap can attach to at runtime, e.g.
+ *
+ *   bpftrace -e 'usdt:/usr/sbin/syslog-ng:syslog_ng:queue__push { @[arg0] = count(); }'
+ *
+ * Without it, the macros expand to nothing.
+ *
+ * The provider is "syslog_ng", the probes and their arguments are:
+ *
+ *   message__new(LogMessage *msg)
+ *   message__parsed(LogMessage *msg, gsize length)
+ *   reader__message(LogReader *reader, LogMessage *msg)
+ *   source__post(LogSource *source, LogMessage *msg)
+ *   source__ack(LogMessage *msg, AckType ack_type)
+ *   filter__result(const gchar *rule_name, LogMessage *msg, gboolean result)
+ *   queue__push(LogQueue *queue, LogMessage *msg)
+ *   queue__pop(LogQueue *queue, LogMessage *msg)
+ *   writer__write(LogWriter *writer, LogMessage *msg, gsize length)
+ *   writer__ack(LogWriter *writer, gint num_msg_acked)
+ *
+ * Arguments are only evaluated when the probe is compiled in, so they
+ * must not have side effects.
+ */
+
+#if SYSLOG_NG_ENABLE_USDT
+
+#include <sys/sdt.h>
+
+#define SYSLOG_NG_PROBE0(name) \
+  DTRACE_PROBE(syslog_ng, name)
+#define SYSLOG_NG_PROBE1(name, a1) \
+  DTRACE_PROBE1(syslog_ng, name, a1)
+#define SYSLOG_NG_PROBE2(name, a1, a2) \
+  DTRACE_PROBE2(syslog_ng, name, a1, a2)
+#define SYSLOG_NG_PROBE3(name, a1, a2, a3) \
+  DTRACE_PROBE3(syslog_ng, name, a1, a2, a3)
+
+#else
+
+#define SYSLOG_NG_PROBE0(name) do { } while (0)
+#define SYSLOG_NG_PROBE1(name, a1) do { } while (0)
+#define SYSLOG_NG_PROBE2(name, a1, a2) do { } while (0)
+#define SYSLOG_NG_PROBE3(name, a1, a2, a3) do { } while (0)
+
+#endif
+
+#endif
@@ -24,6 +24,143 @@
 #include "utf8utils.h"
 #include "str-utils.h"
 
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define UTF8_ASCII_SSE2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define UTF8_ASCII_NEON 1
+#endif
+
+/*
+ * Returns the number of leading bytes in @str that are ASCII characters
+ * other than NUL, these need no decoding at all.
+ */
+static inline gsize
+_utf8_span_ascii(const guchar *str, gsize len)
+{
+  const guchar *p = str;
+  const guchar *end = str + len;
+
+#if UTF8_ASCII_SSE2
+  const __m128i zero = _mm_setzero_si128();
+
+  for (; end - p >= 16; p += 16)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i *) p);
+      guint mask = _mm_movemask_epi8(_mm_or_si128(v, _mm_cmpeq_epi8(v, zero)));
+
+      if (mask)
+        return p - str + __builtin_ctz(mask);
+    }
+#elif UTF8_ASCII_NEON
+  const uint8x16_t high_bit = vdupq_n_u8(0x80);
+
+  for (; end - p >= 16; p += 16)
+    {
+      uint8x16_t v = vld1q_u8(p);
+
+      if (vmaxvq_u8(vorrq_u8(vcgeq_u8(v, high_bit), vceqq_u8(v, vdupq_n_u8(0)))))
+        break;
+    }
+#else
+  for (; end - p >= sizeof(guint64); p += sizeof(guint64))
+    {
+      guint64 w;
+
+      memcpy(&w, p, sizeof(w));
+      /* any byte with its high bit set, or any zero byte */
+      if ((w | ((w - 0x0101010101010101ULL) & ~w)) & 0x8080808080808080ULL)
+        break;
+    }
+#endif
+
+  while (p < end && *p && *p < 0x80)
+    p++;
+  return p - str;
+}
+
+/*
+ * Returns the length of the well-formed multibyte sequence at @p (as per
+ * RFC 3629: no overlong forms, no surrogates, nothing above U+10FFFF) or 0
+ * if it is not one.
+ */
+static inline gsize
+_utf8_sequence_length(const guchar *p, gsize len)
+{
+  guchar c = p[0];
+
+  if (c >= 0xc2 && c <= 0xdf)
+    return (len >= 2 && (p[1] & 0xc0) == 0x80) ? 2 : 0;
+
+  if (c >= 0xe0 && c <= 0xef)
+    {
+      if (len < 3 || (p[1] & 0xc0) != 0x80 || (p[2] & 0xc0) != 0x80)
+        return 0;
+      if ((c == 0xe0 && p[1] < 0xa0) || (c == 0xed && p[1] >= 0xa0))
+        return 0;
+      return 3;
+    }
+
+  if (c >= 0xf0 && c <= 0xf4)
+    {
+      if (len < 4 || (p[1] & 0xc0) != 0x80 || (p[2] & 0xc0) != 0x80 || (p[3] & 0xc0) != 0x80)
+        return 0;
+      if ((c == 0xf0 && p[1] < 0x90) || (c == 0xf4 && p[1] >= 0x90))
+        return 0;
+      return 4;
+    }
+  return 0;
+}
+
+/* returns the number of leading bytes of @str forming well-formed multibyte sequences */
+static inline gsize
+_utf8_span_multibyte(const guchar *str, gsize len)
+{
+  const guchar *p = str;
+  const guchar *end = str + len;
+  gsize seq_len;
+
+  while (p < end && *p >= 0x80 && (seq_len = _utf8_sequence_length(p, end - p)))
+    p += seq_len;
+  return p - str;
+}
+
+/**
+ * utf8_validate:
+ *
+ * A drop-in replacement of g_utf8_validate(str, len, NULL) for the hot
+ * paths: just like that, it rejects NUL characters within @len.  Runs of
+ * ASCII characters are checked 16 (or 8) bytes at a time.
+ */
+gboolean
+utf8_validate(const gchar *str, gssize len)
+{
+  const guchar *p = (const guchar *) str;
+  const guchar *end;
+  gsize seq_len;
+
+  if (len < 0)
+    len = strlen(str);
+  end = p + len;
+
+  while (1)
+    {
+      p += _utf8_span_ascii(p, end - p);
+      if (p == end)
+        return TRUE;
+      if (*p == 0)
+        return FALSE;
+
+      seq_len = _utf8_sequence_length(p, end - p);
+      if (!seq_len)
+        return FALSE;
+      p += seq_len;
+    }
+}
+
 static inline gboolean
 _is_character_unsafe(gunichar uchar, const gchar *unsafe_chars)
 {
@@ -36,15 +173,6 @@ _is_character_unsafe(gunichar uchar, const gchar *unsafe_chars)
   return _strchr_optimized_for_single_char_haystack(unsafe_chars, (gchar) uchar) != NULL;
 }
 
-static inline void
-_append_unichar(GString *string, gunichar wc)
-{
-  if (wc < 0xc0)
-    g_string_append_c(string, (gchar) wc);
-  else
-    g_string_append_unichar(string, wc);
-}
-
 /**
  * This function escapes an unsanitized input (e.g. that can contain binary
  * characters, and produces an escaped format that can be deescaped in need,
@@ -102,14 +230,21 @@ _append_escaped_utf8_character(GString *escaped_output, const gchar **raw,
         else if (_is_character_unsafe(uchar, unsafe_chars))
           g_string_append_printf(escaped_output, "\\%c", (gchar) uchar);
         else
-          _append_unichar(escaped_output, uchar);
+          g_string_append_len(escaped_output, char_ptr, g_utf8_next_char(char_ptr) - char_ptr);
         break;
     }
   *raw = g_utf8_next_char(char_ptr);
   return *raw - char_ptr;
 }
 
+/* room for the backslash and the unsafe characters supplied by the caller */
+#define UTF8_ESCAPE_MAX_STOP_CHARS 8
+
 /**
+ * Runs of plain ASCII characters and runs of well-formed multibyte
+ * characters are copied in bulk, everything else is processed one
+ * character at a time.
+ *
  * @see _append_escaped_utf8_character()
  */
 static void
@@ -118,14 +253,39 @@ _append_unsafe_utf8_as_escaped(GString *escaped_output, const gchar *raw,
                                const gchar *control_format,
                                const gchar *invalid_format)
 {
+  gchar stop_chars[UTF8_ESCAPE_MAX_STOP_CHARS + 1] = "\\";
+  gboolean bulk_copy = TRUE;
+  gsize plain_len;
+
+  if (unsafe_chars)
+    {
+      if (strlen(unsafe_chars) < UTF8_ESCAPE_MAX_STOP_CHARS)
+        strcat(stop_chars, unsafe_chars);
+      else
+        bulk_copy = FALSE;
+    }
+
   if (raw_len < 0)
-      while (*raw)
-        _append_escaped_utf8_character(escaped_output, &raw, -1, unsafe_chars,
-                                       control_format, invalid_format);
-  else
-      while (raw_len)
-        raw_len -= _append_escaped_utf8_character(escaped_output, &raw, raw_len, unsafe_chars,
-                                                  control_format, invalid_format);
+    raw_len = strlen(raw);
+
+  while (raw_len)
+    {
+      if (bulk_copy)
+        {
+          plain_len = str_span_plain_chars(raw, raw_len, stop_chars, FALSE);
+          if (!plain_len)
+            plain_len = _utf8_span_multibyte((const guchar *) raw, raw_len);
+          if (plain_len)
+            {
+              g_string_append_len(escaped_output, raw, plain_len);
+              raw += plain_len;
+              raw_len -= plain_len;
+              continue;
+            }
+        }
+      raw_len -= _append_escaped_utf8_character(escaped_output, &raw, raw_len, unsafe_chars,
+                                                control_format, invalid_format);
+    }
 }
 
 /**
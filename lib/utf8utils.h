@@ -26,6 +26,8 @@
 
 #include "syslog-ng.h"
 
+gboolean utf8_validate(const gchar *str, gssize len);
+
 void append_unsafe_utf8_as_escaped_binary(GString *escaped_string, const gchar *str,
                                           gssize str_len, const gchar *unsafe_chars);
 gchar *convert_unsafe_utf8_to_escaped_binary(const gchar *str, gssize str_len,
@@ -22,6 +22,7 @@
  *
  */
 #include "value-pairs/cmdline.h"
+#include "cfg.h"
 
 #include <string.h>
 #include <stdlib.h>
@@ -395,6 +396,10 @@ value_pairs_new_from_cmdline (GlobalConfig *cfg,
       value_pairs_unref (vp);
       vp = NULL;
     }
+  else if (value_pairs_may_select_any_value(vp))
+    {
+      cfg_reference_all_values(cfg);
+    }
 
   return vp;
 }
@@ -46,6 +46,22 @@ typedef struct
   LogTemplate *template;
 } VPPairConf;
 
+/* whether a name-value pair is selected only depends on its name, so the
+ * decision is made once for each NVHandle and is stored in a bitmap, two
+ * bits per handle: whether the decision has been made and whether the
+ * pair is included.  The NVRegistry has at most 64k handles, with 16
+ * handles per word, that's 16k bytes, allocated when first used. */
+#define VP_SELECTION_HANDLES_PER_WORD 16
+#define VP_SELECTION_WORDS (65536 / VP_SELECTION_HANDLES_PER_WORD)
+#define VP_SELECTION_KNOWN    0x1
+#define VP_SELECTION_INCLUDED 0x2
+
+/* names after the transformations are stored in pages of pointers, only
+ * for the included pairs and only if there are transformations */
+#define VP_NAME_PAGE_BITS 8
+#define VP_NAME_PAGE_SIZE (1 << VP_NAME_PAGE_BITS)
+#define VP_NAME_PAGES (65536 >> VP_NAME_PAGE_BITS)
+
 struct _ValuePairs
 {
   GAtomicCounter ref_cnt;
@@ -56,8 +72,23 @@ struct _ValuePairs
 
   /* guint32 as CfgFlagHandler only supports 32 bit integers */
   guint32 scopes;
+
+  /* both of these are allocated on demand and updated atomically, as
+   * they are used from parallel formatting threads */
+  volatile gint *selection;
+  gchar **transformed_names[VP_NAME_PAGES];
 };
 
+/* one selected value, before sorting them by name */
+typedef struct
+{
+  const gchar *name;
+  /* non-NULL if the name was allocated for this result */
+  gchar *owned_name;
+  SBTHGString *value;
+  gint index;
+} VPResult;
+
 typedef enum
 {
   VPS_NV_PAIRS        = 0x01,
@@ -193,6 +224,29 @@ vp_transform_apply (ValuePairs *vp, gchar *key)
   return ckey;
 }
 
+static void
+vp_results_add(GArray *results, const gchar *name, gchar *owned_name, SBTHGString *value)
+{
+  VPResult result;
+
+  result.name = owned_name ? owned_name : name;
+  result.owned_name = owned_name;
+  result.value = value;
+  result.index = results->len;
+  g_array_append_val(results, result);
+}
+
+/* adds a value whose name still needs to go through the transformations,
+ * these are not cached as they are few and are not related to NVHandles */
+static void
+vp_results_add_transformed(ValuePairs *vp, GArray *results, const gchar *name, SBTHGString *value)
+{
+  if (vp->transforms->len == 0)
+    vp_results_add(results, name, NULL, value);
+  else
+    vp_results_add(results, NULL, vp_transform_apply(vp, (gchar *) name), value);
+}
+
 /* runs over the name-value pairs requested by the user (e.g. with value_pairs_add_pair) */
 static void
 vp_pairs_foreach(gpointer data, gpointer user_data)
@@ -200,7 +254,7 @@ vp_pairs_foreach(gpointer data, gpointer user_data)
   ValuePairs *vp = ((gpointer *)user_data)[0];
   LogMessage *msg = ((gpointer *)user_data)[2];
   gint32 seq_num = GPOINTER_TO_INT (((gpointer *)user_data)[3]);
-  GTree *scope_set = ((gpointer *)user_data)[5];
+  GArray *results = ((gpointer *)user_data)[5];
   const LogTemplateOptions *template_options = ((gpointer *)user_data)[6];
   SBTHGString *sb = sb_th_gstring_acquire();
   VPPairConf *vpc = (VPPairConf *)data;
@@ -217,7 +271,118 @@ vp_pairs_foreach(gpointer data, gpointer user_data)
       return;
     }
 
-  g_tree_insert(scope_set, vp_transform_apply(vp, vpc->name), sb);
+  vp_results_add_transformed(vp, results, vpc->name, sb);
+}
+
+static gboolean
+vp_is_handle_included(ValuePairs *vp, NVHandle handle, const gchar *name)
+{
+  gboolean include;
+  guint j;
+
+  include = (name[0] == '.' && (vp->scopes & VPS_DOT_NV_PAIRS)) ||
+            (name[0] != '.' && (vp->scopes & VPS_NV_PAIRS)) ||
+            (log_msg_is_handle_sdata(handle) && (vp->scopes & (VPS_SDATA + VPS_RFC5424)));
+
+  for (j = 0; j < vp->patterns->len; j++)
+    {
+      VPPatternSpec *vps = (VPPatternSpec *) g_ptr_array_index(vp->patterns, j);
+      if (vp_pattern_spec_eval(vps, name))
+        include = vps->include;
+    }
+  return include;
+}
+
+static volatile gint *
+vp_get_selection_bitmap(ValuePairs *vp)
+{
+  volatile gint *selection = (volatile gint *) g_atomic_pointer_get((gpointer *) &vp->selection);
+
+  if (G_UNLIKELY(!selection))
+    {
+      gint *new_selection = g_new0(gint, VP_SELECTION_WORDS);
+
+      if (!g_atomic_pointer_compare_and_exchange((gpointer *) &vp->selection, NULL, new_selection))
+        g_free(new_selection);
+      selection = (volatile gint *) g_atomic_pointer_get((gpointer *) &vp->selection);
+    }
+  return selection;
+}
+
+static gboolean
+vp_lookup_selection(ValuePairs *vp, NVHandle handle, const gchar *name)
+{
+  volatile gint *word;
+  gint shift, old_value;
+  guint bits;
+
+  g_assert(handle / VP_SELECTION_HANDLES_PER_WORD < VP_SELECTION_WORDS);
+
+  word = &vp_get_selection_bitmap(vp)[handle / VP_SELECTION_HANDLES_PER_WORD];
+  shift = (handle % VP_SELECTION_HANDLES_PER_WORD) * 2;
+  bits = ((guint) g_atomic_int_get(word) >> shift) & 0x3;
+  if (G_LIKELY(bits & VP_SELECTION_KNOWN))
+    return !!(bits & VP_SELECTION_INCLUDED);
+
+  bits = VP_SELECTION_KNOWN | (vp_is_handle_included(vp, handle, name) ? VP_SELECTION_INCLUDED : 0);
+  do
+    {
+      old_value = g_atomic_int_get(word);
+    }
+  while (!g_atomic_int_compare_and_exchange(word, old_value, (gint) ((guint) old_value | (bits << shift))));
+  return !!(bits & VP_SELECTION_INCLUDED);
+}
+
+static const gchar *
+vp_lookup_transformed_name(ValuePairs *vp, NVHandle handle, const gchar *name)
+{
+  gchar ***page_ref, **page, *transformed_name;
+  guint ndx = handle & (VP_NAME_PAGE_SIZE - 1);
+
+  page_ref = &vp->transformed_names[handle >> VP_NAME_PAGE_BITS];
+  page = (gchar **) g_atomic_pointer_get((gpointer *) page_ref);
+  if (G_UNLIKELY(!page))
+    {
+      gchar **new_page = g_new0(gchar *, VP_NAME_PAGE_SIZE);
+
+      if (!g_atomic_pointer_compare_and_exchange((gpointer *) page_ref, NULL, new_page))
+        g_free(new_page);
+      page = (gchar **) g_atomic_pointer_get((gpointer *) page_ref);
+    }
+
+  transformed_name = (gchar *) g_atomic_pointer_get((gpointer *) &page[ndx]);
+  if (G_UNLIKELY(!transformed_name))
+    {
+      gchar *new_name = vp_transform_apply(vp, (gchar *) name);
+
+      /* another thread may have been faster, its result is the same */
+      if (!g_atomic_pointer_compare_and_exchange((gpointer *) &page[ndx], NULL, new_name))
+        g_free(new_name);
+      transformed_name = (gchar *) g_atomic_pointer_get((gpointer *) &page[ndx]);
+    }
+  return transformed_name;
+}
+
+/* NOTE: only called while changing the configuration, when no message is
+ * being formatted */
+static void
+vp_reset_handle_cache(ValuePairs *vp)
+{
+  gint i, j;
+
+  g_free((gint *) vp->selection);
+  vp->selection = NULL;
+
+  for (i = 0; i < VP_NAME_PAGES; i++)
+    {
+      if (!vp->transformed_names[i])
+        continue;
+
+      for (j = 0; j < VP_NAME_PAGE_SIZE; j++)
+        g_free(vp->transformed_names[i][j]);
+      g_free(vp->transformed_names[i]);
+      vp->transformed_names[i] = NULL;
+    }
 }
 
 /* runs over the LogMessage nv-pairs, and inserts them unless excluded */
@@ -227,33 +392,23 @@ vp_msg_nvpairs_foreach(NVHandle handle, gchar *name,
                        gpointer user_data)
 {
   ValuePairs *vp = ((gpointer *)user_data)[0];
-  GTree *scope_set = ((gpointer *)user_data)[5];
-  guint j;
-  gboolean inc;
+  GArray *results = ((gpointer *)user_data)[5];
   SBTHGString *sb;
 
   if (value_len == 0)
     return FALSE;
 
-  inc = (name[0] == '.' && (vp->scopes & VPS_DOT_NV_PAIRS)) ||
-        (name[0] != '.' && (vp->scopes & VPS_NV_PAIRS)) ||
-        (log_msg_is_handle_sdata(handle) && (vp->scopes & (VPS_SDATA + VPS_RFC5424)));
-
-  for (j = 0; j < vp->patterns->len; j++)
-    {
-      VPPatternSpec *vps = (VPPatternSpec *) g_ptr_array_index(vp->patterns, j);
-      if (vp_pattern_spec_eval(vps, name))
-        inc = vps->include;
-    }
-
-  if (!inc)
+  if (!vp_lookup_selection(vp, handle, name))
     return FALSE;
 
   sb = sb_th_gstring_acquire();
 
   g_string_append_len(sb_th_gstring_string(sb), value, value_len);
   sb->type_hint = TYPE_HINT_STRING;
-  g_tree_insert(scope_set, vp_transform_apply(vp, name), sb);
+  if (vp->transforms->len == 0)
+    vp_results_add(results, name, NULL, sb);
+  else
+    vp_results_add(results, vp_lookup_transformed_name(vp, handle, name), NULL, sb);
 
   return FALSE;
 }
@@ -307,6 +462,7 @@ vp_merge_set(ValuePairs *vp, ValuePairSpec *set)
 static void
 vp_update_builtin_list_of_values(ValuePairs *vp)
 {
+  vp_reset_handle_cache(vp);
   g_ptr_array_set_size(vp->builtins, 0);
 
   if (vp->patterns->len > 0)
@@ -326,7 +482,7 @@ vp_update_builtin_list_of_values(ValuePairs *vp)
 }
 
 static void
-vp_merge_builtins(ValuePairs *vp, LogMessage *msg, gint32 seq_num, gint time_zone_mode, GTree *dest, const LogTemplateOptions *template_options)
+vp_merge_builtins(ValuePairs *vp, LogMessage *msg, gint32 seq_num, gint time_zone_mode, GArray *results, const LogTemplateOptions *template_options)
 {
   gint i;
   SBTHGString *sb;
@@ -362,30 +518,46 @@ vp_merge_builtins(ValuePairs *vp, LogMessage *msg, gint32 seq_num, gint time_zon
           continue;
         }
 
-      g_tree_insert(dest, vp_transform_apply(vp, spec->name), sb);
+      vp_results_add_transformed(vp, results, spec->name, sb);
     }
 }
 
-static gboolean
-vp_foreach_helper (const gchar *name, const SBTHGString *hinted_value,
-                   gpointer data)
+typedef struct
 {
-  VPForeachFunc func = ((gpointer *)data)[0];
-  gpointer user_data = ((gpointer *)data)[1];
-  gboolean *r = ((gpointer *)data)[2];
+  GCompareDataFunc compare_func;
+} VPResultsCompareArgs;
 
-  *r &= !func(name, hinted_value->type_hint,
-              sb_th_gstring_string(hinted_value)->str,
-              sb_th_gstring_string(hinted_value)->len, user_data);
-  return !*r;
+static gint
+vp_results_cmp(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  const VPResult *r1 = (const VPResult *) a;
+  const VPResult *r2 = (const VPResult *) b;
+  VPResultsCompareArgs *args = (VPResultsCompareArgs *) user_data;
+  gint result;
+
+  result = args->compare_func(r1->name, r2->name, NULL);
+  if (result == 0)
+    result = r1->index - r2->index;
+  return result;
 }
 
 static void
-vp_data_free (SBTHGString *s)
+vp_results_free(GArray *results)
 {
-  sb_th_gstring_release (s);
+  gint i;
+
+  for (i = 0; i < results->len; i++)
+    {
+      VPResult *r = &g_array_index(results, VPResult, i);
+
+      g_free(r->owned_name);
+      sb_th_gstring_release(r->value);
+    }
+  g_array_free(results, TRUE);
 }
 
+#define VP_RESULTS_INITIAL_SIZE 32
+
 gboolean
 value_pairs_foreach_sorted (ValuePairs *vp, VPForeachFunc func,
                             GCompareDataFunc compare_func,
@@ -397,14 +569,13 @@ value_pairs_foreach_sorted (ValuePairs *vp, VPForeachFunc func,
                       /* remove constness, we are not using that pointer non-const anyway */
                       (LogTemplateOptions *) template_options, GINT_TO_POINTER(time_zone_mode)
                     };
+  VPResultsCompareArgs compare_args = { compare_func };
   gboolean result = TRUE;
-  gpointer helper_args[] = { func, user_data, &result };
-  GTree *scope_set;
+  GArray *results;
+  gint i;
 
-  scope_set = g_tree_new_full((GCompareDataFunc)compare_func, NULL,
-                              (GDestroyNotify)g_free,
-                              (GDestroyNotify)vp_data_free);
-  args[5] = scope_set;
+  results = g_array_sized_new(FALSE, FALSE, sizeof(VPResult), VP_RESULTS_INITIAL_SIZE);
+  args[5] = results;
 
   /*
    * Build up the base set
@@ -414,15 +585,30 @@ value_pairs_foreach_sorted (ValuePairs *vp, VPForeachFunc func,
     nv_table_foreach(msg->payload, logmsg_registry,
                      (NVTableForeachFunc) vp_msg_nvpairs_foreach, args);
 
-  vp_merge_builtins(vp, msg, seq_num, time_zone_mode, scope_set, template_options);
+  vp_merge_builtins(vp, msg, seq_num, time_zone_mode, results, template_options);
 
   /* Merge the explicit key-value pairs too */
   g_ptr_array_foreach(vp->vpairs, (GFunc)vp_pairs_foreach, args);
 
+  /* sort by name, values with the same name are kept in the order they
+   * were added, of which only the last one is used */
+  g_qsort_with_data(results->data, results->len, sizeof(VPResult), vp_results_cmp, &compare_args);
+
   /* Aaand we run it through the callback! */
-  g_tree_foreach(scope_set, (GTraverseFunc)vp_foreach_helper, helper_args);
+  for (i = 0; i < results->len && result; i++)
+    {
+      VPResult *r = &g_array_index(results, VPResult, i);
+
+      if (i + 1 < results->len &&
+          compare_func(r->name, g_array_index(results, VPResult, i + 1).name, NULL) == 0)
+        continue;
 
-  g_tree_destroy(scope_set);
+      result = !func(r->name, r->value->type_hint,
+                     sb_th_gstring_string(r->value)->str,
+                     sb_th_gstring_string(r->value)->len, user_data);
+    }
+
+  vp_results_free(results);
 
   return result;
 }
@@ -768,6 +954,13 @@ value_pairs_walk(ValuePairs *vp,
   return result;
 }
 
+/* scopes and glob patterns select values that are not known in advance */
+gboolean
+value_pairs_may_select_any_value(ValuePairs *vp)
+{
+  return vp->scopes != 0 || vp->patterns->len > 0;
+}
+
 gboolean
 value_pairs_add_scope(ValuePairs *vp, const gchar *scope)
 {
@@ -837,6 +1030,7 @@ value_pairs_new_default(GlobalConfig *cfg)
   value_pairs_add_scope(vp, "selected-macros");
   value_pairs_add_scope(vp, "nv-pairs");
   value_pairs_add_scope(vp, "sdata");
+  cfg_reference_all_values(cfg);
   return vp;
 }
 
@@ -864,6 +1058,7 @@ value_pairs_free (ValuePairs *vp)
     }
   g_ptr_array_free(vp->transforms, TRUE);
   g_ptr_array_free(vp->builtins, TRUE);
+  vp_reset_handle_cache(vp);
   g_free(vp);
 }
 
@@ -52,6 +52,7 @@ void value_pairs_add_glob_patterns(ValuePairs *vp, GList *patterns, gboolean inc
 void value_pairs_add_pair(ValuePairs *vp, const gchar *key, LogTemplate *value);
 
 void value_pairs_add_transforms(ValuePairs *vp, ValuePairsTransformSet *vpts);
+gboolean value_pairs_may_select_any_value(ValuePairs *vp);
 
 gboolean value_pairs_foreach_sorted(ValuePairs *vp, VPForeachFunc func,
                                     GCompareDataFunc compare_func,
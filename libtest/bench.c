@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#include "bench.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+static volatile gint bench_allocations;
+static gboolean bench_allocations_counted;
+
+static gpointer
+bench_malloc(gsize n_bytes)
+{
+  g_atomic_int_inc(&bench_allocations);
+  return malloc(n_bytes);
+}
+
+static gpointer
+bench_realloc(gpointer mem, gsize n_bytes)
+{
+  g_atomic_int_inc(&bench_allocations);
+  return realloc(mem, n_bytes);
+}
+
+static gpointer
+bench_calloc(gsize n_blocks, gsize n_block_bytes)
+{
+  g_atomic_int_inc(&bench_allocations);
+  return calloc(n_blocks, n_block_bytes);
+}
+
+static GMemVTable bench_mem_vtable =
+{
+  bench_malloc,
+  bench_realloc,
+  free,
+  bench_calloc,
+  NULL,
+  NULL
+};
+
+void
+bench_init(void)
+{
+  gint before;
+
+  g_mem_set_vtable(&bench_mem_vtable);
+
+  before = g_atomic_int_get(&bench_allocations);
+  g_free(g_malloc(16));
+  bench_allocations_counted = g_atomic_int_get(&bench_allocations) != before;
+}
+
+gint
+bench_get_iterations(gint argc, gchar *argv[], gint default_iterations)
+{
+  if (argc > 1)
+    return MAX(atoi(argv[1]), 1);
+  return default_iterations;
+}
+
+gint
+bench_get_allocations(void)
+{
+  return g_atomic_int_get(&bench_allocations);
+}
+
+gboolean
+bench_allocations_are_counted(void)
+{
+  return bench_allocations_counted;
+}
+
+static gdouble
+bench_now_nsec(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static gint
+bench_compare_doubles(gconstpointer a, gconstpointer b)
+{
+  gdouble da = *(const gdouble *) a;
+  gdouble db = *(const gdouble *) b;
+
+  return (da > db) - (da < db);
+}
+
+void
+bench_run(const gchar *name, BenchFunc func, gpointer user_data, gint iterations)
+{
+  gdouble rounds[BENCH_ROUNDS];
+  gdouble start, median, spread;
+  gint allocations, i;
+
+  func(user_data, MAX(iterations / 10, 1));
+
+  allocations = bench_get_allocations();
+  for (i = 0; i < BENCH_ROUNDS; i++)
+    {
+      start = bench_now_nsec();
+      func(user_data, iterations);
+      rounds[i] = (bench_now_nsec() - start) / iterations;
+    }
+  allocations = bench_get_allocations() - allocations;
+
+  qsort(rounds, BENCH_ROUNDS, sizeof(rounds[0]), bench_compare_doubles);
+  median = rounds[BENCH_ROUNDS / 2];
+  spread = median > 0 ? (rounds[BENCH_ROUNDS - 1] - rounds[0]) * 100.0 / median : 0;
+
+  if (bench_allocations_are_counted())
+    printf("  %-36s %10.1f ns/op (+-%4.1f%%) %8.2f allocs/op\n",
+           name, median, spread / 2, (gdouble) allocations / (iterations * BENCH_ROUNDS));
+  else
+    printf("  %-36s %10.1f ns/op (+-%4.1f%%) %8s allocs/op\n",
+           name, median, spread / 2, "n/a");
+  fflush(stdout);
+}
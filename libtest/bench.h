@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+
+#ifndef LIBTEST_BENCH_H_INCLUDED
+#define LIBTEST_BENCH_H_INCLUDED 1
+
+#include <glib.h>
+
+/*
+ * Microbenchmark support
+ *
+ * A benchmark is a function running the measured operation @iterations
+ * times.  bench_run() calls it once for warming up the caches, then
+ * BENCH_ROUNDS times, and reports the median time per operation together
+ * with the number of GLib heap allocations per operation.  Using the
+ * median of several rounds keeps the results comparable between runs,
+ * so they can be used to track regressions.
+ *
+ * Allocations are counted through the GLib memory vtable, so
+ * bench_init() has to precede any other GLib call.  Newer GLib versions
+ * ignore the vtable, allocations are reported as "n/a" with those.
+ */
+
+#define BENCH_ROUNDS 5
+
+typedef void (*BenchFunc)(gpointer user_data, gint iterations);
+
+void bench_init(void);
+gint bench_get_iterations(gint argc, gchar *argv[], gint default_iterations);
+gint bench_get_allocations(void);
+gboolean bench_allocations_are_counted(void);
+void bench_run(const gchar *name, BenchFunc func, gpointer user_data, gint iterations);
+
+#endif
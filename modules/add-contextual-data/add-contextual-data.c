@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "add-contextual-data.h"
+#include "context-info-db.h"
+#include "messages.h"
+#include "str-utils.h"
+
+#include <errno.h>
+#include <string.h>
+
+/*
+ * add-contextual-data()
+ *
+ * Formats the selector template (the template() of the parser) and adds
+ * the name-value pairs listed for the result in the database to the
+ * message.  Messages without a matching selector get the pairs of the
+ * default selector, if there's one.  The database is loaded in init() and
+ * shared by our clones.
+ */
+typedef struct _AddContextualData
+{
+  LogParser super;
+  gchar *filename;
+  gchar *prefix;
+  gchar *default_selector;
+  ContextInfoDB *context_info_db;
+} AddContextualData;
+
+void
+add_contextual_data_set_filename(LogParser *s, const gchar *filename)
+{
+  AddContextualData *self = (AddContextualData *) s;
+
+  g_free(self->filename);
+  self->filename = g_strdup(filename);
+}
+
+void
+add_contextual_data_set_prefix(LogParser *s, const gchar *prefix)
+{
+  AddContextualData *self = (AddContextualData *) s;
+
+  g_free(self->prefix);
+  self->prefix = g_strdup(prefix);
+}
+
+void
+add_contextual_data_set_default_selector(LogParser *s, const gchar *default_selector)
+{
+  AddContextualData *self = (AddContextualData *) s;
+
+  g_free(self->default_selector);
+  self->default_selector = g_strdup(default_selector);
+}
+
+static gboolean
+add_contextual_data_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_options,
+                            const gchar *input, gsize input_len)
+{
+  AddContextualData *self = (AddContextualData *) s;
+  const ContextualDataRecord *records;
+  LogMessage *msg;
+  gsize n_records, i;
+
+  APPEND_ZERO(input, input, input_len);
+  records = context_info_db_lookup(self->context_info_db, input, &n_records);
+  if (!records && self->default_selector)
+    records = context_info_db_lookup(self->context_info_db, self->default_selector, &n_records);
+  if (!records)
+    return TRUE;
+
+  msg = log_msg_make_writable(pmsg, path_options);
+  for (i = 0; i < n_records; i++)
+    log_parser_set_value(s, msg, records[i].value_handle, records[i].value, records[i].value_len);
+  return TRUE;
+}
+
+static ContextInfoDB *
+_load_context_info_db(AddContextualData *self)
+{
+  ContextInfoDB *context_info_db;
+  GError *error = NULL;
+  FILE *fp;
+
+  fp = fopen(self->filename, "r");
+  if (!fp)
+    {
+      msg_error("Error opening add-contextual-data() database",
+                evt_tag_str("filename", self->filename),
+                evt_tag_errno("error", errno),
+                NULL);
+      return NULL;
+    }
+
+  context_info_db = context_info_db_new();
+  if (!context_info_db_import(context_info_db, fp, self->prefix, &error))
+    {
+      msg_error("Error loading add-contextual-data() database",
+                evt_tag_str("filename", self->filename),
+                evt_tag_str("error", error->message),
+                NULL);
+      g_clear_error(&error);
+      context_info_db_unref(context_info_db);
+      context_info_db = NULL;
+    }
+  else
+    {
+      msg_debug("add-contextual-data() database loaded",
+                evt_tag_str("filename", self->filename),
+                evt_tag_int("records", context_info_db_get_number_of_records(context_info_db)),
+                NULL);
+    }
+  fclose(fp);
+  return context_info_db;
+}
+
+static gboolean
+add_contextual_data_init(LogPipe *s)
+{
+  AddContextualData *self = (AddContextualData *) s;
+
+  if (!self->filename)
+    {
+      msg_error("add-contextual-data(): database() is mandatory",
+                log_pipe_location_tag(s),
+                NULL);
+      return FALSE;
+    }
+  if (!self->super.template)
+    {
+      msg_error("add-contextual-data(): selector() is mandatory",
+                log_pipe_location_tag(s),
+                NULL);
+      return FALSE;
+    }
+
+  /* clones share the database of the instance they were cloned from */
+  if (!self->context_info_db)
+    {
+      self->context_info_db = _load_context_info_db(self);
+      if (!self->context_info_db)
+        return FALSE;
+    }
+  return log_parser_init_method(s);
+}
+
+static LogPipe *
+add_contextual_data_clone(LogPipe *s)
+{
+  AddContextualData *self = (AddContextualData *) s;
+  AddContextualData *cloned;
+
+  cloned = (AddContextualData *) add_contextual_data_parser_new(log_pipe_get_config(s));
+  add_contextual_data_set_filename(&cloned->super, self->filename);
+  add_contextual_data_set_prefix(&cloned->super, self->prefix);
+  add_contextual_data_set_default_selector(&cloned->super, self->default_selector);
+  log_parser_set_template(&cloned->super, log_template_ref(self->super.template));
+  if (self->context_info_db)
+    cloned->context_info_db = context_info_db_ref(self->context_info_db);
+
+  return &cloned->super.super;
+}
+
+static void
+add_contextual_data_free(LogPipe *s)
+{
+  AddContextualData *self = (AddContextualData *) s;
+
+  context_info_db_unref(self->context_info_db);
+  g_free(self->filename);
+  g_free(self->prefix);
+  g_free(self->default_selector);
+  log_parser_free_method(s);
+}
+
+LogParser *
+add_contextual_data_parser_new(GlobalConfig *cfg)
+{
+  AddContextualData *self = g_new0(AddContextualData, 1);
+
+  log_parser_init_instance(&self->super, cfg);
+  self->super.super.init = add_contextual_data_init;
+  self->super.super.clone = add_contextual_data_clone;
+  self->super.super.free_fn = add_contextual_data_free;
+  self->super.process = add_contextual_data_process;
+
+  return &self->super;
+}
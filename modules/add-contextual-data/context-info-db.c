@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "context-info-db.h"
+
+#include <string.h>
+
+/*
+ * ContextInfoDB
+ *
+ * An immutable table of name-value pairs indexed by a selector, loaded
+ * from a CSV file with "selector,name,value" rows.  Once imported it is
+ * only read, so a single instance is shared by every clone of the parser
+ * and every thread without locking.  A reload builds a new instance along
+ * with the new configuration, the old one goes away with the old
+ * configuration.
+ *
+ * The records of a selector are stored next to each other in file order,
+ * the index maps the selector to the first one.  Selectors are interned
+ * in the string chunk, so the records belonging to the same selector share
+ * the same selector pointer.
+ */
+struct _ContextInfoDB
+{
+  gint ref_cnt;
+  GStringChunk *strings;
+  GArray *records;
+  GHashTable *index;
+};
+
+typedef struct _ContextualDataRow
+{
+  ContextualDataRecord record;
+  guint line;
+} ContextualDataRow;
+
+GQuark
+context_info_db_error_quark(void)
+{
+  return g_quark_from_static_string("context-info-db-error-quark");
+}
+
+static void
+_clear(ContextInfoDB *self)
+{
+  if (self->index)
+    g_hash_table_destroy(self->index);
+  if (self->records)
+    g_array_free(self->records, TRUE);
+  if (self->strings)
+    g_string_chunk_free(self->strings);
+  self->index = NULL;
+  self->records = NULL;
+  self->strings = NULL;
+}
+
+static void
+_init(ContextInfoDB *self)
+{
+  self->strings = g_string_chunk_new(4096);
+  self->records = g_array_new(FALSE, FALSE, sizeof(ContextualDataRecord));
+  self->index = g_hash_table_new(g_str_hash, g_str_equal);
+}
+
+/*
+ * Parses a single field, either unquoted, up to the next comma, or
+ * enclosed in double quotes, with "" standing for a quote character.
+ * Quoted fields cannot span lines.
+ */
+static gboolean
+_parse_field(const gchar **line, GString *field)
+{
+  const gchar *src = *line;
+  const gchar *end;
+
+  g_string_truncate(field, 0);
+  if (*src != '"')
+    {
+      end = strchr(src, ',');
+      if (!end)
+        end = src + strlen(src);
+      g_string_append_len(field, src, end - src);
+      *line = end;
+      return TRUE;
+    }
+
+  src++;
+  while (1)
+    {
+      end = strchr(src, '"');
+      if (!end)
+        return FALSE;
+      g_string_append_len(field, src, end - src);
+      if (end[1] != '"')
+        break;
+      g_string_append_c(field, '"');
+      src = end + 2;
+    }
+  *line = end + 1;
+  return TRUE;
+}
+
+static gboolean
+_parse_row(const gchar *line, GString *selector, GString *name, GString *value)
+{
+  if (!_parse_field(&line, selector) || *line != ',')
+    return FALSE;
+  line++;
+  if (!_parse_field(&line, name) || *line != ',')
+    return FALSE;
+  line++;
+  if (!_parse_field(&line, value) || *line != 0)
+    return FALSE;
+  return name->len > 0;
+}
+
+/* reads a whole line, regardless of its length, without the line terminator */
+static gboolean
+_read_line(FILE *fp, GString *line)
+{
+  gchar buf[1024];
+
+  g_string_truncate(line, 0);
+  while (fgets(buf, sizeof(buf), fp))
+    {
+      g_string_append(line, buf);
+      if (line->len > 0 && line->str[line->len - 1] == '\n')
+        break;
+    }
+  if (line->len == 0)
+    return FALSE;
+
+  while (line->len > 0 && (line->str[line->len - 1] == '\n' || line->str[line->len - 1] == '\r'))
+    g_string_truncate(line, line->len - 1);
+  return TRUE;
+}
+
+static gint
+_compare_rows(gconstpointer a, gconstpointer b)
+{
+  const ContextualDataRow *row_a = (const ContextualDataRow *) a;
+  const ContextualDataRow *row_b = (const ContextualDataRow *) b;
+  gint rc;
+
+  rc = strcmp(row_a->record.selector, row_b->record.selector);
+  if (rc != 0)
+    return rc;
+  return row_a->line < row_b->line ? -1 : (row_a->line > row_b->line);
+}
+
+static void
+_build_index(ContextInfoDB *self, GArray *rows)
+{
+  guint i;
+
+  g_array_sort(rows, _compare_rows);
+  for (i = 0; i < rows->len; i++)
+    {
+      ContextualDataRow *row = &g_array_index(rows, ContextualDataRow, i);
+
+      if (i == 0 || row->record.selector != g_array_index(rows, ContextualDataRow, i - 1).record.selector)
+        g_hash_table_insert(self->index, (gpointer) row->record.selector, GUINT_TO_POINTER(i));
+      g_array_append_val(self->records, row->record);
+    }
+}
+
+/*
+ * Loads the contents of @fp, replacing anything imported earlier.  Value
+ * names are prefixed with @name_prefix.
+ */
+gboolean
+context_info_db_import(ContextInfoDB *self, FILE *fp, const gchar *name_prefix, GError **error)
+{
+  GString *line = g_string_sized_new(256);
+  GString *selector = g_string_sized_new(64);
+  GString *name = g_string_sized_new(64);
+  GString *value = g_string_sized_new(128);
+  GArray *rows = g_array_new(FALSE, FALSE, sizeof(ContextualDataRow));
+  ContextualDataRow row;
+  guint line_number = 0;
+  gboolean success = TRUE;
+
+  _clear(self);
+  _init(self);
+
+  while (_read_line(fp, line))
+    {
+      line_number++;
+      if (line->len == 0)
+        continue;
+
+      if (!_parse_row(line->str, selector, name, value))
+        {
+          g_set_error(error, CONTEXT_INFO_DB_ERROR, 0,
+                      "Invalid line in contextual data, expected selector,name,value: line %u", line_number);
+          success = FALSE;
+          break;
+        }
+
+      row.record.selector = g_string_chunk_insert_const(self->strings, selector->str);
+      g_string_prepend(name, name_prefix ? name_prefix : "");
+      row.record.value_handle = log_msg_get_value_handle(name->str);
+      row.record.value = g_string_chunk_insert_len(self->strings, value->str, value->len);
+      row.record.value_len = value->len;
+      row.line = line_number;
+      g_array_append_val(rows, row);
+    }
+
+  if (success)
+    _build_index(self, rows);
+  else
+    {
+      _clear(self);
+      _init(self);
+    }
+
+  g_array_free(rows, TRUE);
+  g_string_free(line, TRUE);
+  g_string_free(selector, TRUE);
+  g_string_free(name, TRUE);
+  g_string_free(value, TRUE);
+  return success;
+}
+
+/*
+ * Returns the records of @selector, in the order they were found in the
+ * file, NULL if there's none.
+ */
+const ContextualDataRecord *
+context_info_db_lookup(ContextInfoDB *self, const gchar *selector, gsize *n_records)
+{
+  const ContextualDataRecord *records;
+  gpointer first;
+  guint i;
+
+  *n_records = 0;
+  if (!g_hash_table_lookup_extended(self->index, selector, NULL, &first))
+    return NULL;
+
+  records = &g_array_index(self->records, ContextualDataRecord, GPOINTER_TO_UINT(first));
+  for (i = GPOINTER_TO_UINT(first);
+       i < self->records->len && g_array_index(self->records, ContextualDataRecord, i).selector == records->selector;
+       i++)
+    (*n_records)++;
+  return records;
+}
+
+gsize
+context_info_db_get_number_of_records(ContextInfoDB *self)
+{
+  return self->records->len;
+}
+
+ContextInfoDB *
+context_info_db_new(void)
+{
+  ContextInfoDB *self = g_new0(ContextInfoDB, 1);
+
+  self->ref_cnt = 1;
+  _init(self);
+  return self;
+}
+
+ContextInfoDB *
+context_info_db_ref(ContextInfoDB *self)
+{
+  g_atomic_int_inc(&self->ref_cnt);
+  return self;
+}
+
+void
+context_info_db_unref(ContextInfoDB *self)
+{
+  if (self && g_atomic_int_dec_and_test(&self->ref_cnt))
+    {
+      _clear(self);
+      g_free(self);
+    }
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef CONTEXT_INFO_DB_H_INCLUDED
+#define CONTEXT_INFO_DB_H_INCLUDED
+
+#include "syslog-ng.h"
+#include "logmsg/logmsg.h"
+
+#include <stdio.h>
+
+#define CONTEXT_INFO_DB_ERROR context_info_db_error_quark()
+
+GQuark context_info_db_error_quark(void);
+
+/* a name-value pair to be added to messages matching the selector */
+typedef struct _ContextualDataRecord
+{
+  const gchar *selector;
+  NVHandle value_handle;
+  const gchar *value;
+  gsize value_len;
+} ContextualDataRecord;
+
+typedef struct _ContextInfoDB ContextInfoDB;
+
+ContextInfoDB *context_info_db_new(void);
+ContextInfoDB *context_info_db_ref(ContextInfoDB *self);
+void context_info_db_unref(ContextInfoDB *self);
+
+gboolean context_info_db_import(ContextInfoDB *self, FILE *fp, const gchar *name_prefix, GError **error);
+const ContextualDataRecord *context_info_db_lookup(ContextInfoDB *self, const gchar *selector, gsize *n_records);
+gsize context_info_db_get_number_of_records(ContextInfoDB *self);
+
+#endif
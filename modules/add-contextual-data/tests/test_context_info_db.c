@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "context-info-db.h"
+#include "apphook.h"
+#include "testutils.h"
+
+#include <string.h>
+
+static ContextInfoDB *
+_import(const gchar *contents, const gchar *prefix, gboolean expected_success)
+{
+  ContextInfoDB *db = context_info_db_new();
+  GError *error = NULL;
+  FILE *fp = tmpfile();
+  gboolean success;
+
+  fputs(contents, fp);
+  rewind(fp);
+  success = context_info_db_import(db, fp, prefix, &error);
+  fclose(fp);
+
+  assert_gboolean(success, expected_success, "unexpected import result for %s", contents);
+  if (!success)
+    {
+      assert_not_null(error, "failed import should set an error");
+      g_clear_error(&error);
+    }
+  return db;
+}
+
+static void
+assert_record(const ContextualDataRecord *record, const gchar *name, const gchar *value)
+{
+  assert_string(log_msg_get_value_name(record->value_handle, NULL), name, "record name mismatch");
+  assert_nstring(record->value, record->value_len, value, -1, "record value mismatch");
+}
+
+static void
+test_records_of_a_selector_are_returned_in_file_order(void)
+{
+  ContextInfoDB *db = _import("host1,owner,alice\n"
+                              "host2,owner,bob\n"
+                              "host1,team,network\r\n"
+                              "\n"
+                              "host1,site,\"Budapest, \"\"HQ\"\"\"\n",
+                              ".ctx.", TRUE);
+  const ContextualDataRecord *records;
+  gsize n;
+
+  assert_gint(context_info_db_get_number_of_records(db), 4, "number of records mismatch");
+
+  records = context_info_db_lookup(db, "host1", &n);
+  assert_gint(n, 3, "number of records of host1 mismatch");
+  assert_record(&records[0], ".ctx.owner", "alice");
+  assert_record(&records[1], ".ctx.team", "network");
+  assert_record(&records[2], ".ctx.site", "Budapest, \"HQ\"");
+
+  records = context_info_db_lookup(db, "host2", &n);
+  assert_gint(n, 1, "number of records of host2 mismatch");
+  assert_record(&records[0], ".ctx.owner", "bob");
+
+  records = context_info_db_lookup(db, "host3", &n);
+  assert_null(records, "unknown selector should have no records");
+  assert_gint(n, 0, "unknown selector should have no records");
+
+  context_info_db_unref(db);
+}
+
+static void
+test_invalid_lines_fail_the_import(void)
+{
+  context_info_db_unref(_import("host1,owner\n", NULL, FALSE));
+  context_info_db_unref(_import("host1,owner,alice,extra\n", NULL, FALSE));
+  context_info_db_unref(_import("host1,\"owner,alice\n", NULL, FALSE));
+  context_info_db_unref(_import("host1,,alice\n", NULL, FALSE));
+}
+
+int
+main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
+{
+  app_startup();
+
+  test_records_of_a_selector_are_returned_in_file_order();
+  test_invalid_lines_fail_the_import();
+
+  app_shutdown();
+  return 0;
+}
@@ -37,6 +37,8 @@
 #include <amqp_framing.h>
 #include <amqp_tcp_socket.h>
 
+#define AFAMQP_CONFIRM_BATCH_LINES_DEFAULT 100
+
 typedef struct
 {
   LogThrDestDriver super;
@@ -49,6 +51,7 @@ typedef struct
 
   gboolean declare;
   gint persistent;
+  gboolean publisher_confirms;
 
   gchar *vhost;
   gchar *host;
@@ -65,6 +68,13 @@ typedef struct
   amqp_socket_t* sockfd;
   amqp_table_entry_t *entries;
   gint32 max_entries;
+  /* backing store of the header keys/values in entries, reused between messages */
+  GString *headers;
+
+  /* publisher confirms: delivery tag of the last published and the last
+   * confirmed message, the difference is the batch in flight */
+  guint64 delivery_tag;
+  guint64 confirmed_tag;
 } AMQPDestDriver;
 
 /*
@@ -170,6 +180,14 @@ afamqp_dd_set_persistent(LogDriver *s, gboolean persistent)
     self->persistent = 1;
 }
 
+void
+afamqp_dd_set_publisher_confirms(LogDriver *s, gboolean publisher_confirms)
+{
+  AMQPDestDriver *self = (AMQPDestDriver *) s;
+
+  self->publisher_confirms = publisher_confirms;
+}
+
 void
 afamqp_dd_set_value_pairs(LogDriver *d, ValuePairs *vp)
 {
@@ -374,6 +392,18 @@ afamqp_dd_connect(AMQPDestDriver *self, gboolean reconnect)
       goto exception_amqp_dd_connect_failed_channel;
     }
 
+  if (self->publisher_confirms)
+    {
+      amqp_confirm_select(self->conn, 1);
+      ret = amqp_get_rpc_reply(self->conn);
+      if (!afamqp_is_ok(self, "Error enabling AMQP publisher confirms", ret))
+        {
+          goto exception_amqp_dd_connect_failed_exchange;
+        }
+      self->delivery_tag = 0;
+      self->confirmed_tag = 0;
+    }
+
   if (self->declare)
     {
       amqp_exchange_declare(self->conn, 1, amqp_cstring_bytes(self->exchange),
@@ -414,26 +444,47 @@ afamqp_vp_foreach(const gchar *name,
                   TypeHint type, const gchar *value, gsize value_len,
                   gpointer user_data)
 {
-  amqp_table_entry_t **entries = (amqp_table_entry_t **) ((gpointer *)user_data)[0];
+  AMQPDestDriver *self = (AMQPDestDriver *) ((gpointer *)user_data)[0];
   gint *pos = (gint *) ((gpointer *)user_data)[1];
-  gint32 *max_size = (gint32 *) ((gpointer *)user_data)[2];
+  amqp_table_entry_t *entry;
 
-  if (*pos == *max_size)
+  if (*pos == self->max_entries)
     {
-      *max_size *= 2;
-      *entries = g_renew(amqp_table_entry_t, *entries, *max_size);
+      self->max_entries *= 2;
+      self->entries = g_renew(amqp_table_entry_t, self->entries, self->max_entries);
     }
 
-  (*entries)[*pos].key = amqp_cstring_bytes(strdup(name));
-  (*entries)[*pos].value.kind = AMQP_FIELD_KIND_UTF8;
+  /* self->headers may be reallocated while appending, so only offsets are
+   * stored here, afamqp_worker_resolve_headers() turns them into pointers */
+  entry = &self->entries[*pos];
+  entry->key.len = strlen(name);
+  entry->key.bytes = GSIZE_TO_POINTER(self->headers->len);
+  g_string_append_len(self->headers, name, entry->key.len + 1);
 
-  (*entries)[*pos].value.value.bytes = amqp_cstring_bytes(strdup(value));
+  entry->value.kind = AMQP_FIELD_KIND_UTF8;
+  entry->value.value.bytes.len = strlen(value);
+  entry->value.value.bytes.bytes = GSIZE_TO_POINTER(self->headers->len);
+  g_string_append_len(self->headers, value, entry->value.value.bytes.len + 1);
 
   (*pos)++;
 
   return FALSE;
 }
 
+static void
+afamqp_worker_resolve_headers(AMQPDestDriver *self, gint num_entries)
+{
+  gint i;
+
+  for (i = 0; i < num_entries; i++)
+    {
+      amqp_table_entry_t *entry = &self->entries[i];
+
+      entry->key.bytes = self->headers->str + GPOINTER_TO_SIZE(entry->key.bytes);
+      entry->value.value.bytes.bytes = self->headers->str + GPOINTER_TO_SIZE(entry->value.value.bytes.bytes);
+    }
+}
+
 static gboolean
 afamqp_worker_publish(AMQPDestDriver *self, LogMessage *msg)
 {
@@ -445,11 +496,13 @@ afamqp_worker_publish(AMQPDestDriver *self, LogMessage *msg)
   SBGString *body = sb_gstring_acquire();
   amqp_bytes_t body_bytes = amqp_cstring_bytes("");
 
-  gpointer user_data[] = { &self->entries, &pos, &self->max_entries };
+  gpointer user_data[] = { self, &pos };
 
+  g_string_truncate(self->headers, 0);
   value_pairs_foreach(self->vp, afamqp_vp_foreach, msg,
                       self->super.seq_num,
                       LTZ_SEND, &self->template_options, user_data);
+  afamqp_worker_resolve_headers(self, pos);
 
   table.num_entries = pos;
   table.entries = self->entries;
@@ -488,13 +541,93 @@ afamqp_worker_publish(AMQPDestDriver *self, LogMessage *msg)
       success = FALSE;
     }
 
-  while (--pos >= 0)
+  return success;
+}
+
+/*
+ * With publisher-confirms(yes) messages are published as they come and
+ * returned as queued, the broker confirms them asynchronously on the
+ * channel.  flush() collects the confirms of the batch in flight, acking
+ * the messages to the queue as the confirms arrive.
+ *
+ * RabbitMQ confirms the messages of a channel in publishing order, so an
+ * ack covers everything published before it, whether "multiple" is set or
+ * not.
+ */
+static void
+afamqp_worker_confirm(AMQPDestDriver *self, guint64 delivery_tag)
+{
+  if (delivery_tag <= self->confirmed_tag || delivery_tag > self->delivery_tag)
+    return;
+
+  log_threaded_dest_driver_accept_batch_prefix(&self->super, (gint) (delivery_tag - self->confirmed_tag));
+  self->confirmed_tag = delivery_tag;
+}
+
+static worker_insert_result_t
+afamqp_worker_flush(LogThrDestDriver *s)
+{
+  AMQPDestDriver *self = (AMQPDestDriver *)s;
+  amqp_frame_t frame;
+  struct timeval timeout;
+  gint ret;
+
+  if (!self->conn)
+    return WORKER_INSERT_RESULT_NOT_CONNECTED;
+
+  while (self->confirmed_tag < self->delivery_tag)
     {
-      amqp_bytes_free(self->entries[pos].key);
-      amqp_bytes_free(self->entries[pos].value.value.bytes);
+      timeout.tv_sec = self->super.time_reopen;
+      timeout.tv_usec = 0;
+      ret = amqp_simple_wait_frame_noblock(self->conn, &frame, &timeout);
+      if (ret != AMQP_STATUS_OK)
+        {
+          msg_error("Error while waiting for AMQP publisher confirms",
+                    evt_tag_str("driver", self->super.super.super.id),
+                    evt_tag_str("error", amqp_error_string2(-ret)),
+                    evt_tag_int("time_reopen", self->super.time_reopen),
+                    NULL);
+          goto error;
+        }
+
+      if (frame.frame_type == AMQP_FRAME_METHOD)
+        {
+          switch (frame.payload.method.id)
+            {
+            case AMQP_BASIC_ACK_METHOD:
+              afamqp_worker_confirm(self, ((amqp_basic_ack_t *) frame.payload.method.decoded)->delivery_tag);
+              break;
+
+            case AMQP_BASIC_NACK_METHOD:
+              msg_error("AMQP server rejected a message",
+                        evt_tag_str("driver", self->super.super.super.id),
+                        evt_tag_printf("delivery_tag", "%" G_GUINT64_FORMAT,
+                                       (guint64) ((amqp_basic_nack_t *) frame.payload.method.decoded)->delivery_tag),
+                        NULL);
+              goto error;
+
+            case AMQP_CHANNEL_CLOSE_METHOD:
+            case AMQP_CONNECTION_CLOSE_METHOD:
+              msg_error("AMQP server closed the connection while waiting for publisher confirms",
+                        evt_tag_str("driver", self->super.super.super.id),
+                        evt_tag_int("time_reopen", self->super.time_reopen),
+                        NULL);
+              goto error;
+
+            default:
+              break;
+            }
+        }
+      amqp_maybe_release_buffers(self->conn);
     }
 
-  return success;
+  return WORKER_INSERT_RESULT_SUCCESS;
+
+ error:
+  /* delivery tags restart on the new channel, the unconfirmed part of the
+   * batch is rewound and published again */
+  _amqp_connection_disconnect(self);
+  return WORKER_INSERT_RESULT_ERROR;
 }
 
 static worker_insert_result_t
@@ -506,7 +639,17 @@ afamqp_worker_insert(LogThrDestDriver *s, LogMessage *msg)
     return WORKER_INSERT_RESULT_NOT_CONNECTED;
 
   if (!afamqp_worker_publish (self, msg))
-    return WORKER_INSERT_RESULT_ERROR;
+    {
+      if (self->publisher_confirms)
+        _amqp_connection_disconnect(self);
+      return WORKER_INSERT_RESULT_ERROR;
+    }
+
+  if (self->publisher_confirms)
+    {
+      self->delivery_tag++;
+      return WORKER_INSERT_RESULT_QUEUED;
+    }
 
   return WORKER_INSERT_RESULT_SUCCESS;
 }
@@ -542,6 +685,8 @@ afamqp_dd_init(LogPipe *s)
 
   log_template_options_init(&self->template_options, cfg);
 
+  self->super.worker.flush = self->publisher_confirms ? afamqp_worker_flush : NULL;
+
   msg_verbose("Initializing AMQP destination",
               evt_tag_str("vhost", self->vhost),
               evt_tag_str("host", self->host),
@@ -569,6 +714,7 @@ afamqp_dd_free(LogPipe *d)
   g_free(self->host);
   g_free(self->vhost);
   g_free(self->entries);
+  g_string_free(self->headers, TRUE);
   value_pairs_unref(self->vp);
 
   log_threaded_dest_driver_free(d);
@@ -609,6 +755,8 @@ afamqp_dd_new(GlobalConfig *cfg)
 
   self->max_entries = 256;
   self->entries = g_new(amqp_table_entry_t, self->max_entries);
+  self->headers = g_string_sized_new(1024);
+  log_threaded_dest_driver_set_batch_lines((LogDriver *)self, AFAMQP_CONFIRM_BATCH_LINES_DEFAULT);
 
   log_template_options_defaults(&self->template_options);
   afamqp_dd_set_value_pairs(&self->super.super.super, value_pairs_new_default(cfg));
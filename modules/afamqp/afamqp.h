@@ -41,6 +41,7 @@ void afamqp_dd_set_body(LogDriver *d, const gchar *body);
 void afamqp_dd_set_persistent(LogDriver *d, gboolean persistent);
 void afamqp_dd_set_user(LogDriver *d, const gchar *user);
 void afamqp_dd_set_password(LogDriver *d, const gchar *password);
+void afamqp_dd_set_publisher_confirms(LogDriver *d, gboolean publisher_confirms);
 void afamqp_dd_set_value_pairs(LogDriver *d, ValuePairs *vp);
 
 LogTemplateOptions *afamqp_dd_get_template_options(LogDriver *s);
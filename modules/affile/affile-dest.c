@@ -190,7 +190,8 @@ affile_dw_reopen(AFFileDestWriter *self)
                            ? log_proto_text_client_new(log_transport_pipe_new(fd), &self->owner->writer_options.proto_options.super)
                            : log_proto_file_writer_new(log_transport_file_new(fd), &self->owner->writer_options.proto_options.super,
                                                        self->owner->writer_options.flush_lines,
-                                                       self->owner->use_fsync);
+                                                       self->owner->use_fsync,
+                                                       self->owner->drop_cache);
 
       main_loop_call((void * (*)(void *)) affile_dw_arm_reaper, self, TRUE);
     }
@@ -393,6 +394,14 @@ affile_dd_set_fsync(LogDriver *s, gboolean use_fsync)
   self->use_fsync = use_fsync;
 }
 
+void
+affile_dd_set_drop_cache(LogDriver *s, gboolean drop_cache)
+{
+  AFFileDestDriver *self = (AFFileDestDriver *) s;
+
+  self->drop_cache = drop_cache;
+}
+
 static inline gchar *
 affile_dd_format_persist_name(AFFileDestDriver *self)
 {
@@ -38,7 +38,8 @@ typedef struct _AFFileDestDriver
   AFFileDestWriter *single_writer;
   gboolean filename_is_a_template:1,
     template_escape:1,
-    use_fsync:1;
+    use_fsync:1,
+    drop_cache:1;
   FilePermOptions file_perm_options;
   FileOpenOptions file_open_options;
   TimeZoneInfo *local_time_zone_info;
@@ -55,6 +56,7 @@ LogDriver *afpipe_dd_new(gchar *filename, GlobalConfig *cfg);
 
 void affile_dd_set_create_dirs(LogDriver *s, gboolean create_dirs);
 void affile_dd_set_fsync(LogDriver *s, gboolean enable);
+void affile_dd_set_drop_cache(LogDriver *s, gboolean enable);
 void affile_dd_set_overwrite_if_older(LogDriver *s, gint overwrite_if_older);
 void affile_dd_set_local_time_zone(LogDriver *s, const gchar *local_time_zone);
 
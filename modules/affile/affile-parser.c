@@ -35,13 +35,20 @@ static CfgLexerKeyword affile_keywords[] = {
   { "pipe",               KW_PIPE },
 
   { "fsync",              KW_FSYNC },
+  { "drop_cache",         KW_DROP_CACHE },
   { "remove_if_older",    KW_OVERWRITE_IF_OLDER, KWS_OBSOLETE, "overwrite_if_older" },
   { "overwrite_if_older", KW_OVERWRITE_IF_OLDER },
   { "follow_freq",        KW_FOLLOW_FREQ },
+  { "monitor_method",     KW_MONITOR_METHOD },
   { "multi_line_mode",    KW_MULTI_LINE_MODE  },
   { "multi_line_prefix",  KW_MULTI_LINE_PREFIX },
   { "multi_line_garbage", KW_MULTI_LINE_GARBAGE },
   { "multi_line_suffix",  KW_MULTI_LINE_GARBAGE },
+  { "wildcard_file",      KW_WILDCARD_FILE },
+  { "base_dir",           KW_BASE_DIR },
+  { "filename_pattern",   KW_FILENAME_PATTERN },
+  { "recursive",          KW_RECURSIVE },
+  { "max_files",          KW_MAX_FILES },
   { NULL }
 };
 
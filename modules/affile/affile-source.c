@@ -50,9 +50,6 @@
 
 #include <iv.h>
 
-#define DEFAULT_SD_OPEN_FLAGS (O_RDONLY | O_NOCTTY | O_NONBLOCK | O_LARGEFILE)
-#define DEFAULT_SD_OPEN_FLAGS_PIPE (O_RDWR | O_NOCTTY | O_NONBLOCK | O_LARGEFILE)
-
 gboolean
 affile_sd_set_multi_line_mode(LogDriver *s, const gchar *mode)
 {
@@ -99,6 +96,20 @@ affile_sd_set_follow_freq(LogDriver *s, gint follow_freq)
   self->follow_freq = follow_freq;
 }
 
+gboolean
+affile_sd_set_monitor_method(LogDriver *s, const gchar *method)
+{
+  AFFileSourceDriver *self = (AFFileSourceDriver *) s;
+
+  if (strcmp(method, "auto") == 0)
+    self->monitor_method = FMM_AUTO;
+  else if (strcmp(method, "poll") == 0)
+    self->monitor_method = FMM_POLL;
+  else
+    return FALSE;
+  return TRUE;
+}
+
 static inline gboolean
 affile_is_linux_proc_kmsg(const gchar *filename)
 {
@@ -136,26 +147,24 @@ affile_sd_open_file(AFFileSourceDriver *self, gchar *name, gint *fd)
 }
 
 static inline gchar *
-affile_sd_format_persist_name(AFFileSourceDriver *self)
+affile_sd_format_persist_name(const gchar *filename)
 {
   static gchar persist_name[1024];
   
-  g_snprintf(persist_name, sizeof(persist_name), "affile_sd_curpos(%s)", self->filename->str);
+  g_snprintf(persist_name, sizeof(persist_name), "affile_sd_curpos(%s)", filename);
   return persist_name;
 }
  
-static void
-affile_sd_recover_state(LogPipe *s, GlobalConfig *cfg, LogProtoServer *proto)
+void
+affile_sd_recover_state(AFFileSourceDriver *self, const gchar *filename, GlobalConfig *cfg, LogProtoServer *proto)
 {
-  AFFileSourceDriver *self = (AFFileSourceDriver *) s;
-
   if (self->file_open_options.is_pipe || self->follow_freq <= 0)
     return;
 
-  if (!log_proto_server_restart_with_state(proto, cfg->state, affile_sd_format_persist_name(self)))
+  if (!log_proto_server_restart_with_state(proto, cfg->state, affile_sd_format_persist_name(filename)))
     {
       msg_error("Error converting persistent state from on-disk format, losing file position information",
-                evt_tag_str("filename", self->filename->str),
+                evt_tag_str("filename", filename),
                 NULL);
       return;
     }
@@ -177,17 +186,18 @@ _is_fd_pollable(gint fd)
   return pollable;
 }
 
-static PollEvents *
-affile_sd_construct_poll_events(AFFileSourceDriver *self, gint fd)
+PollEvents *
+affile_sd_construct_poll_events(AFFileSourceDriver *self, const gchar *filename, gint fd, LogPipe *control)
 {
   if (self->follow_freq > 0)
-    return poll_file_changes_new(fd, self->filename->str, self->follow_freq, &self->super.super.super);
+    return poll_file_changes_new(fd, filename, self->follow_freq,
+                                 self->monitor_method == FMM_AUTO, control);
   else if (fd >= 0 && _is_fd_pollable(fd))
     return poll_fd_events_new(fd);
   else
     {
       msg_error("Unable to determine how to monitor this file, follow_freq() unset and it is not possible to poll it with the current ivykis polling method. Set follow-freq() for regular files or change IV_EXCLUDE_POLL_METHOD environment variable to override the automatically selected polling method",
-                evt_tag_str("filename", self->filename->str),
+                evt_tag_str("filename", filename),
                 evt_tag_int("fd", fd),
                 NULL);
       return NULL;
@@ -195,15 +205,15 @@ affile_sd_construct_poll_events(AFFileSourceDriver *self, gint fd)
 }
 
 static LogTransport *
-affile_sd_construct_transport(AFFileSourceDriver *self, gint fd)
+affile_sd_construct_transport(AFFileSourceDriver *self, const gchar *filename, gint fd)
 {
   if (self->file_open_options.is_pipe)
     return log_transport_pipe_new(fd);
   else if (self->follow_freq > 0)
     return log_transport_file_new(fd);
-  else if (affile_is_linux_proc_kmsg(self->filename->str))
+  else if (affile_is_linux_proc_kmsg(filename))
     return log_transport_device_new(fd, 10);
-  else if (affile_is_linux_dev_kmsg(self->filename->str))
+  else if (affile_is_linux_dev_kmsg(filename))
     {
       if (lseek(fd, 0, SEEK_END) < 0)
         {
@@ -217,14 +227,14 @@ affile_sd_construct_transport(AFFileSourceDriver *self, gint fd)
     return log_transport_pipe_new(fd);
 }
 
-static LogProtoServer *
-affile_sd_construct_proto(AFFileSourceDriver *self, gint fd)
+LogProtoServer *
+affile_sd_construct_proto(AFFileSourceDriver *self, const gchar *filename, gint fd)
 {
   LogProtoServerOptions *proto_options = &self->reader_options.proto_options.super;
   LogTransport *transport;
   MsgFormatHandler *format_handler;
 
-  transport = affile_sd_construct_transport(self, fd);
+  transport = affile_sd_construct_transport(self, filename, fd);
 
   format_handler = self->reader_options.parse_options.format_handler;
   if ((format_handler && format_handler->construct_proto))
@@ -234,9 +244,9 @@ affile_sd_construct_proto(AFFileSourceDriver *self, gint fd)
 
   if (self->pad_size)
     return log_proto_padded_record_server_new(transport, proto_options, self->pad_size);
-  else if (affile_is_linux_proc_kmsg(self->filename->str))
+  else if (affile_is_linux_proc_kmsg(filename))
     return log_proto_linux_proc_kmsg_reader_new(transport, proto_options);
-  else if (affile_is_linux_dev_kmsg(self->filename->str))
+  else if (affile_is_linux_dev_kmsg(filename))
     return log_proto_dgram_server_new(transport, proto_options);
   else
     {
@@ -279,11 +289,11 @@ affile_sd_notify(LogPipe *s, gint notify_code, gpointer user_data)
             LogProtoServer *proto;
             PollEvents *poll_events;
             
-            poll_events = affile_sd_construct_poll_events(self, fd);
+            poll_events = affile_sd_construct_poll_events(self, self->filename->str, fd, s);
             if (!poll_events)
               break;
 
-            proto = affile_sd_construct_proto(self, fd);
+            proto = affile_sd_construct_proto(self, self->filename->str, fd);
 
             self->reader = log_reader_new(self->super.super.super.cfg);
             log_reader_reopen(self->reader, proto, poll_events);
@@ -307,7 +317,7 @@ affile_sd_notify(LogPipe *s, gint notify_code, gpointer user_data)
                 self->reader = NULL;
                 close(fd);
               }
-            affile_sd_recover_state(s, cfg, proto);
+            affile_sd_recover_state(self, self->filename->str, cfg, proto);
           }
         break;
       }
@@ -330,15 +340,10 @@ affile_sd_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options,
   log_src_driver_queue_method(s, msg, path_options, user_data);
 }
 
-static gboolean
-affile_sd_init(LogPipe *s)
+gboolean
+affile_sd_init_options(AFFileSourceDriver *self, GlobalConfig *cfg)
 {
-  AFFileSourceDriver *self = (AFFileSourceDriver *) s;
-  GlobalConfig *cfg = log_pipe_get_config(s);
-  gint fd;
-  gboolean file_opened, open_deferred = FALSE;
-
-  if (!log_src_driver_init_method(s))
+  if (!log_src_driver_init_method(&self->super.super.super))
     return FALSE;
 
   log_reader_options_init(&self->reader_options, cfg, self->super.super.group);
@@ -348,6 +353,19 @@ affile_sd_init(LogPipe *s)
       msg_error("multi-line-prefix() and/or multi-line-garbage() specified but multi-line-mode() is not regexp based (prefix-garbage or prefix-suffix), please set multi-line-mode() properly", NULL);
       return FALSE;
     }
+  return TRUE;
+}
+
+static gboolean
+affile_sd_init(LogPipe *s)
+{
+  AFFileSourceDriver *self = (AFFileSourceDriver *) s;
+  GlobalConfig *cfg = log_pipe_get_config(s);
+  gint fd;
+  gboolean file_opened, open_deferred = FALSE;
+
+  if (!affile_sd_init_options(self, cfg))
+    return FALSE;
 
   file_opened = affile_sd_open_file(self, self->filename->str, &fd);
   if (!file_opened && self->follow_freq > 0)
@@ -364,14 +382,14 @@ affile_sd_init(LogPipe *s)
       LogProtoServer *proto;
       PollEvents *poll_events;
 
-      poll_events = affile_sd_construct_poll_events(self, fd);
+      poll_events = affile_sd_construct_poll_events(self, self->filename->str, fd, s);
       if (!poll_events)
         {
           close(fd);
           return FALSE;
         }
 
-      proto = affile_sd_construct_proto(self, fd);
+      proto = affile_sd_construct_proto(self, self->filename->str, fd);
       self->reader = log_reader_new(self->super.super.super.cfg);
       log_reader_reopen(self->reader, proto, poll_events);
 
@@ -397,7 +415,7 @@ affile_sd_init(LogPipe *s)
           close(fd);
           return FALSE;
         }
-      affile_sd_recover_state(s, cfg, proto);
+      affile_sd_recover_state(self, self->filename->str, cfg, proto);
     }
   else
     {
@@ -429,7 +447,7 @@ affile_sd_deinit(LogPipe *s)
   return TRUE;
 }
 
-static void
+void
 affile_sd_free(LogPipe *s)
 {
   AFFileSourceDriver *self = (AFFileSourceDriver *) s;
@@ -445,11 +463,9 @@ affile_sd_free(LogPipe *s)
   log_src_driver_free(s);
 }
 
-static AFFileSourceDriver *
-affile_sd_new_instance(gchar *filename, GlobalConfig *cfg)
+void
+affile_sd_init_instance(AFFileSourceDriver *self, gchar *filename, GlobalConfig *cfg)
 {
-  AFFileSourceDriver *self = g_new0(AFFileSourceDriver, 1);
-  
   log_src_driver_init_instance(&self->super, cfg);
   self->filename = g_string_new(filename);
   self->super.super.super.init = affile_sd_init;
@@ -463,6 +479,14 @@ affile_sd_new_instance(gchar *filename, GlobalConfig *cfg)
 
   if (affile_is_linux_proc_kmsg(filename))
     self->file_open_options.needs_privileges = TRUE;
+}
+
+static AFFileSourceDriver *
+affile_sd_new_instance(gchar *filename, GlobalConfig *cfg)
+{
+  AFFileSourceDriver *self = g_new0(AFFileSourceDriver, 1);
+
+  affile_sd_init_instance(self, filename, cfg);
   return self;
 }
 
@@ -28,7 +28,18 @@
 #include "logreader.h"
 #include "logproto/logproto-regexp-multiline-server.h"
 #include "affile-common.h"
+#include "compat/lfs.h"
 
+#include <fcntl.h>
+
+#define DEFAULT_SD_OPEN_FLAGS (O_RDONLY | O_NOCTTY | O_NONBLOCK | O_LARGEFILE)
+#define DEFAULT_SD_OPEN_FLAGS_PIPE (O_RDWR | O_NOCTTY | O_NONBLOCK | O_LARGEFILE)
+
+enum
+{
+  FMM_AUTO,
+  FMM_POLL,
+};
 
 enum
 {
@@ -48,6 +59,7 @@ typedef struct _AFFileSourceDriver
   FileOpenOptions file_open_options;
   gint pad_size;
   gint follow_freq;
+  gint monitor_method;
   gint multi_line_mode;
   MultiLineRegexp *multi_line_prefix, *multi_line_garbage;
   /* state information to follow a set of files using a wildcard expression */
@@ -56,6 +68,16 @@ typedef struct _AFFileSourceDriver
 LogDriver *affile_sd_new(gchar *filename, GlobalConfig *cfg);
 LogDriver *afpipe_sd_new(gchar *filename, GlobalConfig *cfg);
 
+/* for drivers reading a set of files using the options of a file() source */
+void affile_sd_init_instance(AFFileSourceDriver *self, gchar *filename, GlobalConfig *cfg);
+gboolean affile_sd_init_options(AFFileSourceDriver *self, GlobalConfig *cfg);
+void affile_sd_free(LogPipe *s);
+gboolean affile_sd_open_file(AFFileSourceDriver *self, gchar *name, gint *fd);
+PollEvents *affile_sd_construct_poll_events(AFFileSourceDriver *self, const gchar *filename, gint fd, LogPipe *control);
+LogProtoServer *affile_sd_construct_proto(AFFileSourceDriver *self, const gchar *filename, gint fd);
+void affile_sd_recover_state(AFFileSourceDriver *self, const gchar *filename, GlobalConfig *cfg, LogProtoServer *proto);
+
+gboolean affile_sd_set_monitor_method(LogDriver *s, const gchar *method);
 gboolean affile_sd_set_multi_line_prefix(LogDriver *s, const gchar *prefix_regexp, GError **error);
 gboolean affile_sd_set_multi_line_garbage(LogDriver *s, const gchar *garbage_regexp, GError **error);
 gboolean affile_sd_set_multi_line_mode(LogDriver *s, const gchar *mode);
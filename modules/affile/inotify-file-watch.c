@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "inotify-file-watch.h"
+#include "messages.h"
+
+#include <string.h>
+#include <errno.h>
+
+#if SYSLOG_NG_HAVE_SYS_INOTIFY_H
+
+#include <sys/inotify.h>
+#include <iv_inotify.h>
+
+/*
+ * Files are watched through their directory: that way we get events for
+ * files that are created or renamed in place (e.g. by logrotate) as well,
+ * not only for the inode that was open at the time the watch was added.
+ *
+ * The kernel returns the same watch descriptor if the same directory is
+ * added twice, so watches are shared by all files in a directory.  A
+ * single inotify instance is used for all of them, as the number of
+ * inotify instances per user is limited.
+ */
+
+#define INOTIFY_DIR_WATCH_MASK (IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+                                IN_DELETE_SELF | IN_MOVE_SELF)
+
+typedef struct _InotifyDirWatch
+{
+  struct iv_inotify_watch watch;
+  gchar *dirname;
+  GList *file_watches;
+  /* the kernel dropped the watch, e.g. the directory was removed */
+  gboolean lost;
+} InotifyDirWatch;
+
+struct _InotifyFileWatch
+{
+  InotifyDirWatch *dir_watch;
+  /* NULL if watching the whole directory */
+  gchar *basename;
+  InotifyFileWatchCallback callback;
+  gpointer user_data;
+};
+
+static struct iv_inotify inotify;
+static gboolean inotify_registered;
+static GHashTable *dir_watches;
+
+static void
+_dir_watch_handle_event(void *cookie, struct inotify_event *event)
+{
+  InotifyDirWatch *self = (InotifyDirWatch *) cookie;
+  GList *l;
+
+  if (event->mask & IN_IGNORED)
+    {
+      /* iv_inotify forgets about the watch by itself in this case */
+      msg_verbose("inotify watch of directory removed, falling back to polling",
+                  evt_tag_str("dirname", self->dirname),
+                  NULL);
+      self->lost = TRUE;
+      g_hash_table_remove(dir_watches, self->dirname);
+    }
+
+  for (l = self->file_watches; l; l = l->next)
+    {
+      InotifyFileWatch *file_watch = (InotifyFileWatch *) l->data;
+
+      /* events without a name are about the directory itself */
+      if (self->lost || event->len == 0)
+        file_watch->callback(file_watch->user_data, NULL);
+      else if (!file_watch->basename || strcmp(event->name, file_watch->basename) == 0)
+        file_watch->callback(file_watch->user_data, event->name);
+    }
+}
+
+static gboolean
+_inotify_ref(void)
+{
+  if (inotify_registered)
+    return TRUE;
+
+  IV_INOTIFY_INIT(&inotify);
+  if (iv_inotify_register(&inotify) != 0)
+    {
+      msg_verbose("Error initializing inotify, falling back to polling",
+                  evt_tag_errno("error", errno),
+                  NULL);
+      return FALSE;
+    }
+  dir_watches = g_hash_table_new(g_str_hash, g_str_equal);
+  inotify_registered = TRUE;
+  return TRUE;
+}
+
+static void
+_inotify_unref_if_unused(void)
+{
+  if (!inotify_registered || g_hash_table_size(dir_watches) > 0)
+    return;
+
+  g_hash_table_destroy(dir_watches);
+  dir_watches = NULL;
+  iv_inotify_unregister(&inotify);
+  inotify_registered = FALSE;
+}
+
+static InotifyDirWatch *
+_dir_watch_new(const gchar *dirname)
+{
+  InotifyDirWatch *self = g_new0(InotifyDirWatch, 1);
+
+  self->dirname = g_strdup(dirname);
+
+  IV_INOTIFY_WATCH_INIT(&self->watch);
+  self->watch.inotify = &inotify;
+  self->watch.pathname = self->dirname;
+  self->watch.mask = INOTIFY_DIR_WATCH_MASK;
+  self->watch.cookie = self;
+  self->watch.handler = _dir_watch_handle_event;
+
+  if (iv_inotify_watch_register(&self->watch) != 0)
+    {
+      msg_verbose("Error adding inotify watch, falling back to polling",
+                  evt_tag_str("dirname", dirname),
+                  evt_tag_errno("error", errno),
+                  NULL);
+      g_free(self->dirname);
+      g_free(self);
+      return NULL;
+    }
+  g_hash_table_insert(dir_watches, self->dirname, self);
+  return self;
+}
+
+static void
+_dir_watch_free(InotifyDirWatch *self)
+{
+  if (!self->lost)
+    {
+      g_hash_table_remove(dir_watches, self->dirname);
+      iv_inotify_watch_unregister(&self->watch);
+    }
+  g_free(self->dirname);
+  g_free(self);
+}
+
+static InotifyFileWatch *
+_file_watch_new(const gchar *dirname, const gchar *basename, InotifyFileWatchCallback callback, gpointer user_data)
+{
+  InotifyFileWatch *self;
+  InotifyDirWatch *dir_watch;
+
+  if (!_inotify_ref())
+    return NULL;
+
+  dir_watch = g_hash_table_lookup(dir_watches, dirname);
+  if (!dir_watch)
+    dir_watch = _dir_watch_new(dirname);
+
+  if (!dir_watch)
+    {
+      _inotify_unref_if_unused();
+      return NULL;
+    }
+
+  self = g_new0(InotifyFileWatch, 1);
+  self->dir_watch = dir_watch;
+  self->basename = g_strdup(basename);
+  self->callback = callback;
+  self->user_data = user_data;
+  dir_watch->file_watches = g_list_prepend(dir_watch->file_watches, self);
+  return self;
+}
+
+InotifyFileWatch *
+inotify_file_watch_new(const gchar *filename, InotifyFileWatchCallback callback, gpointer user_data)
+{
+  InotifyFileWatch *self;
+  gchar *dirname = g_path_get_dirname(filename);
+  gchar *basename = g_path_get_basename(filename);
+
+  self = _file_watch_new(dirname, basename, callback, user_data);
+  g_free(dirname);
+  g_free(basename);
+  return self;
+}
+
+InotifyFileWatch *
+inotify_file_watch_new_for_dir(const gchar *dirname, InotifyFileWatchCallback callback, gpointer user_data)
+{
+  return _file_watch_new(dirname, NULL, callback, user_data);
+}
+
+gboolean
+inotify_file_watch_is_alive(InotifyFileWatch *self)
+{
+  return !self->dir_watch->lost;
+}
+
+void
+inotify_file_watch_free(InotifyFileWatch *self)
+{
+  InotifyDirWatch *dir_watch = self->dir_watch;
+
+  dir_watch->file_watches = g_list_remove(dir_watch->file_watches, self);
+  if (!dir_watch->file_watches)
+    _dir_watch_free(dir_watch);
+  _inotify_unref_if_unused();
+
+  g_free(self->basename);
+  g_free(self);
+}
+
+#else
+
+InotifyFileWatch *
+inotify_file_watch_new(const gchar *filename, InotifyFileWatchCallback callback, gpointer user_data)
+{
+  return NULL;
+}
+
+InotifyFileWatch *
+inotify_file_watch_new_for_dir(const gchar *dirname, InotifyFileWatchCallback callback, gpointer user_data)
+{
+  return NULL;
+}
+
+gboolean
+inotify_file_watch_is_alive(InotifyFileWatch *self)
+{
+  return FALSE;
+}
+
+void
+inotify_file_watch_free(InotifyFileWatch *self)
+{
+}
+
+#endif
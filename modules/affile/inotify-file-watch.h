@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef INOTIFY_FILE_WATCH_H_INCLUDED
+#define INOTIFY_FILE_WATCH_H_INCLUDED
+
+#include "syslog-ng.h"
+
+typedef struct _InotifyFileWatch InotifyFileWatch;
+/* @name is the name of the file within its directory, NULL if the event
+ * is about the directory itself */
+typedef void (*InotifyFileWatchCallback)(gpointer user_data, const gchar *name);
+
+/*
+ * Watches a single file for changes (writes, truncation, rotation,
+ * creation) using inotify.  Returns NULL if the file cannot be watched,
+ * callers are to fall back to polling in that case.  Must be used from
+ * the main thread.
+ */
+InotifyFileWatch *inotify_file_watch_new(const gchar *filename, InotifyFileWatchCallback callback, gpointer user_data);
+/* same, but for all files in @dirname */
+InotifyFileWatch *inotify_file_watch_new_for_dir(const gchar *dirname, InotifyFileWatchCallback callback, gpointer user_data);
+gboolean inotify_file_watch_is_alive(InotifyFileWatch *self);
+void inotify_file_watch_free(InotifyFileWatch *self);
+
+#endif
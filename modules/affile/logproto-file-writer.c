@@ -28,6 +28,10 @@
 #include <errno.h>
 #include <sys/uio.h>
 #include <unistd.h>
+#include <fcntl.h>
+
+/* drop the written data from the page cache after this many bytes */
+#define LOG_PROTO_FILE_WRITER_DROP_CACHE_BYTES (1024 * 1024)
 
 typedef struct _LogProtoFileWriter
 {
@@ -39,9 +43,46 @@ typedef struct _LogProtoFileWriter
   gint fd;
   gint sum_len;
   gboolean fsync;
+  gboolean drop_cache;
+  gsize drop_cache_pending;
   struct iovec buffer[0];
 } LogProtoFileWriter;
 
+/*
+ * Archive files are rarely read back, so their pages only evict more
+ * useful data from the page cache. With drop_cache enabled we tell the
+ * kernel to drop the cached pages of the file every
+ * LOG_PROTO_FILE_WRITER_DROP_CACHE_BYTES bytes. Pages still under
+ * writeback are not dropped, those go away the next time
+ * around.
+ */
+static void
+log_proto_file_writer_drop_cache(LogProtoFileWriter *self, gint written)
+{
+#ifdef SYSLOG_NG_HAVE_POSIX_FADVISE
+  if (!self->drop_cache)
+    return;
+
+  self->drop_cache_pending += written;
+  if (self->drop_cache_pending < LOG_PROTO_FILE_WRITER_DROP_CACHE_BYTES)
+    return;
+
+  posix_fadvise(self->fd, 0, 0, POSIX_FADV_DONTNEED);
+  self->drop_cache_pending = 0;
+#endif
+}
+
+static void
+log_proto_file_writer_written(LogProtoFileWriter *self, gint rc)
+{
+  if (rc <= 0)
+    return;
+
+  if (self->fsync)
+    fsync(self->fd);
+  log_proto_file_writer_drop_cache(self, rc);
+}
+
 /*
  * log_proto_file_writer_flush:
  *
@@ -62,8 +103,7 @@ log_proto_file_writer_flush(LogProtoClient *s)
       gint len = self->partial_len - self->partial_pos;
 
       rc = write(self->fd, self->partial + self->partial_pos, len);
-      if (rc > 0 && self->fsync)
-        fsync(self->fd);
+      log_proto_file_writer_written(self, rc);
       if (rc < 0)
         {
           goto write_error;
@@ -85,8 +125,7 @@ log_proto_file_writer_flush(LogProtoClient *s)
     return LPS_SUCCESS;
 
   rc = writev(self->fd, self->buffer, self->buf_count);
-  if (rc > 0 && self->fsync)
-    fsync(self->fd);
+  log_proto_file_writer_written(self, rc);
 
   if (rc < 0)
     {
@@ -123,7 +162,7 @@ log_proto_file_writer_flush(LogProtoClient *s)
 
   /* free the previous message strings (the remaning part has been copied to the partial buffer) */
   for (i = 0; i < self->buf_count; ++i)
-    g_free(self->buffer[i].iov_base);
+    self->super.msg_free(self->buffer[i].iov_base);
   self->buf_count = 0;
   self->sum_len = 0;
 
@@ -208,7 +247,8 @@ log_proto_file_writer_prepare(LogProtoClient *s, gint *fd, GIOCondition *cond)
 }
 
 LogProtoClient *
-log_proto_file_writer_new(LogTransport *transport, const LogProtoClientOptions *options, gint flush_lines, gint fsync_)
+log_proto_file_writer_new(LogTransport *transport, const LogProtoClientOptions *options, gint flush_lines, gint fsync_,
+                          gboolean drop_cache)
 {
   if (flush_lines == 0)
     /* the flush-lines option has not been specified, use a default value */
@@ -226,6 +266,7 @@ log_proto_file_writer_new(LogTransport *transport, const LogProtoClientOptions *
   self->fd = transport->fd;
   self->buf_size = flush_lines;
   self->fsync = fsync_;
+  self->drop_cache = drop_cache;
   self->super.prepare = log_proto_file_writer_prepare;
   self->super.post = log_proto_file_writer_post;
   self->super.flush = log_proto_file_writer_flush;
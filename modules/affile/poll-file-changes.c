@@ -21,6 +21,7 @@
  *
  */
 #include "poll-file-changes.h"
+#include "inotify-file-watch.h"
 #include "logpipe.h"
 
 #include <sys/types.h>
@@ -45,8 +46,16 @@ typedef struct _PollFileChanges
   gint follow_freq;
   struct iv_timer follow_timer;
   LogPipe *control;
+  /* if set, follow_timer is only used to run checks when inotify says so */
+  InotifyFileWatch *inotify_watch;
 } PollFileChanges;
 
+/* an inotify watch may miss writes to a file already renamed by rotation,
+ * check it every once in a while nevertheless */
+#define POLL_FILE_CHANGES_INOTIFY_RECHECK_MSEC 30000
+
+static void poll_file_changes_wait(PollFileChanges *self);
+
 /* follow timer callback. Check if the file has new content, or deleted or
  * moved.  Ran every follow_freq seconds.  */
 static void
@@ -60,6 +69,13 @@ poll_file_changes_check_file(gpointer s)
   msg_trace("Checking if the followed file has new lines",
             evt_tag_str("follow_filename", self->follow_filename),
             NULL);
+
+  if (self->inotify_watch && !inotify_file_watch_is_alive(self->inotify_watch))
+    {
+      inotify_file_watch_free(self->inotify_watch);
+      self->inotify_watch = NULL;
+    }
+
   if (fd >= 0)
     {
       pos = lseek(fd, 0, SEEK_CUR);
@@ -141,7 +157,7 @@ poll_file_changes_check_file(gpointer s)
         }
     }
  reschedule:
-  poll_events_update_watches(s, G_IO_IN);
+  poll_file_changes_wait(self);
 }
 
 static void
@@ -154,14 +170,36 @@ poll_file_changes_stop_watches(PollEvents *s)
 }
 
 static void
-poll_file_changes_rearm_timer(PollFileChanges *self)
+poll_file_changes_rearm_timer(PollFileChanges *self, gint timeout_msec)
 {
   iv_validate_now();
   self->follow_timer.expires = iv_now;
-  timespec_add_msec(&self->follow_timer.expires, self->follow_freq);
+  timespec_add_msec(&self->follow_timer.expires, timeout_msec);
   iv_timer_register(&self->follow_timer);
 }
 
+/* there was nothing to do, wait for the file to change */
+static void
+poll_file_changes_wait(PollFileChanges *self)
+{
+  poll_file_changes_stop_watches(&self->super);
+  poll_file_changes_rearm_timer(self, self->inotify_watch ? POLL_FILE_CHANGES_INOTIFY_RECHECK_MSEC : self->follow_freq);
+}
+
+static void
+poll_file_changes_inotify_callback(gpointer s, const gchar *name)
+{
+  PollFileChanges *self = (PollFileChanges *) s;
+
+  /* if we are not waiting, the reader is busy with the file and will
+   * resume our watches once it's done, which triggers a check anyway */
+  if (!iv_timer_registered(&self->follow_timer))
+    return;
+
+  poll_file_changes_stop_watches(&self->super);
+  poll_file_changes_rearm_timer(self, 0);
+}
+
 static void
 poll_file_changes_update_watches(PollEvents *s, GIOCondition cond)
 {
@@ -172,8 +210,10 @@ poll_file_changes_update_watches(PollEvents *s, GIOCondition cond)
 
   poll_file_changes_stop_watches(s);
 
+  /* with inotify, check right away, changes that happened while the
+   * reader was busy would go unnoticed otherwise */
   if (cond & G_IO_IN)
-    poll_file_changes_rearm_timer(self);
+    poll_file_changes_rearm_timer(self, self->inotify_watch ? 0 : self->follow_freq);
 }
 
 static void
@@ -181,12 +221,14 @@ poll_file_changes_free(PollEvents *s)
 {
   PollFileChanges *self = (PollFileChanges *) s;
 
+  if (self->inotify_watch)
+    inotify_file_watch_free(self->inotify_watch);
   log_pipe_unref(self->control);
   g_free(self->follow_filename);
 }
 
 PollEvents *
-poll_file_changes_new(gint fd, const gchar *follow_filename, gint follow_freq, LogPipe *control)
+poll_file_changes_new(gint fd, const gchar *follow_filename, gint follow_freq, gboolean use_inotify, LogPipe *control)
 {
   PollFileChanges *self = g_new0(PollFileChanges, 1);
 
@@ -203,5 +245,8 @@ poll_file_changes_new(gint fd, const gchar *follow_filename, gint follow_freq, L
   self->follow_timer.cookie = self;
   self->follow_timer.handler = poll_file_changes_check_file;
 
+  if (use_inotify && follow_filename)
+    self->inotify_watch = inotify_file_watch_new(follow_filename, poll_file_changes_inotify_callback, self);
+
   return &self->super;
 }
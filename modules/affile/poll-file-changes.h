@@ -25,7 +25,8 @@
 
 #include "poll-events.h"
 
-PollEvents *poll_file_changes_new(gint fd, const gchar *follow_filename, gint follow_freq, LogPipe *control);
+/* with @use_inotify, changes are detected by inotify if possible, follow_freq is then unused */
+PollEvents *poll_file_changes_new(gint fd, const gchar *follow_filename, gint follow_freq, gboolean use_inotify, LogPipe *control);
 
 
 #endif
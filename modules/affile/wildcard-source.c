@@ -0,0 +1,744 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "wildcard-source.h"
+#include "inotify-file-watch.h"
+#include "messages.h"
+#include "timeutils.h"
+#include "stats/stats-registry.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+/*
+ * wildcard-file() source
+ *
+ * Follows all files matching filename-pattern() below base-dir().  Each
+ * file gets its own WildcardFileReader, but at most max-files() of them
+ * have their file open at any time.  Readers that are idle (e.g. they
+ * reached the end of their file) are closed in least-recently-idle order
+ * when others are waiting for a slot, and are reopened once their file is
+ * written again.  File positions are kept in the same persist entries as
+ * file() sources use, so closing and reopening a file (or converting a
+ * file() source into a wildcard one) doesn't lose the position.
+ *
+ * The directory tree is watched using inotify if possible, a periodic
+ * rescan is used otherwise, and as a safety net with inotify as well.
+ */
+
+#define WILDCARD_SD_DEFAULT_MAX_FILES 100
+#define WILDCARD_SD_INOTIFY_RESCAN_MSEC 30000
+
+typedef struct _WildcardFileReader
+{
+  LogPipe super;
+  WildcardSourceDriver *owner;
+  GString *filename;
+  LogReader *reader;
+
+  /* set when the reader reports EOF, cleared by incoming messages,
+   * accessed atomically */
+  gint eof;
+  /* actions requested by notifications, performed by the housekeeping task */
+  gboolean reopen_needed:1, close_needed:1, deleted:1, waiting:1;
+  /* mtime of the file when it was closed, to notice it being written again */
+  time_t closed_mtime;
+  guint scan_generation;
+} WildcardFileReader;
+
+static void wildcard_sd_schedule_housekeeping(WildcardSourceDriver *self);
+static void wildcard_sd_scan_dir(WildcardSourceDriver *self, const gchar *dirname);
+
+typedef struct _WildcardDirWatch
+{
+  WildcardSourceDriver *owner;
+  gchar *dirname;
+  /* NULL if inotify is not available */
+  InotifyFileWatch *watch;
+  guint scan_generation;
+} WildcardDirWatch;
+
+/* WildcardFileReader */
+
+static void
+wildcard_file_reader_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options, gpointer user_data)
+{
+  WildcardFileReader *self = (WildcardFileReader *) s;
+  static NVHandle filename_handle = 0;
+
+  if (!filename_handle)
+    filename_handle = log_msg_get_value_handle("FILE_NAME");
+
+  log_msg_set_value(msg, filename_handle, self->filename->str, self->filename->len);
+
+  if (g_atomic_int_get(&self->eof))
+    g_atomic_int_set(&self->eof, FALSE);
+
+  log_pipe_forward_msg(s, msg, path_options);
+}
+
+/* NOTE: runs in the main thread, the reader may be freed only once the
+ * notification returned, thus the housekeeping task */
+static void
+wildcard_file_reader_notify(LogPipe *s, gint notify_code, gpointer user_data)
+{
+  WildcardFileReader *self = (WildcardFileReader *) s;
+  WildcardSourceDriver *owner = self->owner;
+
+  switch (notify_code)
+    {
+    case NC_FILE_EOF:
+      if (!g_atomic_int_get(&self->eof))
+        {
+          g_atomic_int_set(&self->eof, TRUE);
+
+          /* first idle, first to be closed */
+          owner->open_readers = g_list_remove(owner->open_readers, self);
+          owner->open_readers = g_list_append(owner->open_readers, self);
+        }
+      if (self->deleted || !g_queue_is_empty(owner->waiting_readers))
+        wildcard_sd_schedule_housekeeping(owner);
+      break;
+    case NC_FILE_MOVED:
+      self->reopen_needed = TRUE;
+      wildcard_sd_schedule_housekeeping(owner);
+      break;
+    case NC_CLOSE:
+    case NC_READ_ERROR:
+      self->close_needed = TRUE;
+      wildcard_sd_schedule_housekeeping(owner);
+      break;
+    default:
+      break;
+    }
+}
+
+static gboolean
+wildcard_file_reader_open(WildcardFileReader *self)
+{
+  WildcardSourceDriver *owner = self->owner;
+  GlobalConfig *cfg = log_pipe_get_config(&owner->super.super.super.super);
+  LogProtoServer *proto;
+  PollEvents *poll_events;
+  gint fd;
+
+  g_assert(!self->reader);
+
+  if (!affile_sd_open_file(&owner->super, self->filename->str, &fd))
+    {
+      msg_error("Error opening file for reading",
+                evt_tag_str("filename", self->filename->str),
+                evt_tag_errno(EVT_TAG_OSERROR, errno),
+                NULL);
+      return FALSE;
+    }
+
+  poll_events = affile_sd_construct_poll_events(&owner->super, self->filename->str, fd, &self->super);
+  if (!poll_events)
+    {
+      close(fd);
+      return FALSE;
+    }
+
+  proto = affile_sd_construct_proto(&owner->super, self->filename->str, fd);
+  self->reader = log_reader_new(cfg);
+  log_reader_reopen(self->reader, proto, poll_events);
+  log_reader_set_options(self->reader,
+                         &self->super,
+                         &owner->super.reader_options,
+                         STATS_LEVEL1,
+                         SCS_FILE,
+                         owner->super.super.super.id,
+                         self->filename->str);
+  log_reader_set_immediate_check(self->reader);
+
+  log_pipe_append((LogPipe *) self->reader, &self->super);
+  if (!log_pipe_init((LogPipe *) self->reader))
+    {
+      msg_error("Error initializing log_reader, closing fd",
+                evt_tag_int("fd", fd),
+                NULL);
+      log_pipe_unref((LogPipe *) self->reader);
+      self->reader = NULL;
+      close(fd);
+      return FALSE;
+    }
+  affile_sd_recover_state(&owner->super, self->filename->str, cfg, proto);
+
+  msg_debug("Following file",
+            evt_tag_str("filename", self->filename->str),
+            NULL);
+
+  g_atomic_int_set(&self->eof, FALSE);
+  self->reopen_needed = self->close_needed = FALSE;
+  owner->open_readers = g_list_prepend(owner->open_readers, self);
+  owner->num_open_readers++;
+  return TRUE;
+}
+
+static void
+wildcard_file_reader_close(WildcardFileReader *self)
+{
+  WildcardSourceDriver *owner = self->owner;
+  struct stat st;
+
+  if (!self->reader)
+    return;
+
+  log_pipe_deinit((LogPipe *) self->reader);
+  log_pipe_unref((LogPipe *) self->reader);
+  self->reader = NULL;
+
+  self->closed_mtime = (stat(self->filename->str, &st) == 0) ? st.st_mtime : 0;
+  owner->open_readers = g_list_remove(owner->open_readers, self);
+  owner->num_open_readers--;
+}
+
+static void
+wildcard_file_reader_free(LogPipe *s)
+{
+  WildcardFileReader *self = (WildcardFileReader *) s;
+
+  g_assert(!self->reader);
+  g_string_free(self->filename, TRUE);
+  log_pipe_free_method(s);
+}
+
+static WildcardFileReader *
+wildcard_file_reader_new(WildcardSourceDriver *owner, const gchar *filename)
+{
+  WildcardFileReader *self = g_new0(WildcardFileReader, 1);
+
+  log_pipe_init_instance(&self->super, log_pipe_get_config(&owner->super.super.super.super));
+  self->super.queue = wildcard_file_reader_queue;
+  self->super.notify = wildcard_file_reader_notify;
+  self->super.free_fn = wildcard_file_reader_free;
+  self->super.expr_node = owner->super.super.super.super.expr_node;
+  self->owner = owner;
+  self->filename = g_string_new(filename);
+  /* never seen open, read it as soon as possible */
+  self->closed_mtime = -1;
+  log_pipe_append(&self->super, &owner->super.super.super.super);
+  return self;
+}
+
+/* WildcardSourceDriver */
+
+void
+wildcard_sd_set_base_dir(LogDriver *s, const gchar *base_dir)
+{
+  WildcardSourceDriver *self = (WildcardSourceDriver *) s;
+
+  g_free(self->base_dir);
+  self->base_dir = g_strdup(base_dir);
+}
+
+void
+wildcard_sd_set_filename_pattern(LogDriver *s, const gchar *filename_pattern)
+{
+  WildcardSourceDriver *self = (WildcardSourceDriver *) s;
+
+  g_free(self->filename_pattern);
+  self->filename_pattern = g_strdup(filename_pattern);
+}
+
+void
+wildcard_sd_set_recursive(LogDriver *s, gboolean recursive)
+{
+  WildcardSourceDriver *self = (WildcardSourceDriver *) s;
+
+  self->recursive = recursive;
+}
+
+void
+wildcard_sd_set_max_files(LogDriver *s, gint max_files)
+{
+  WildcardSourceDriver *self = (WildcardSourceDriver *) s;
+
+  self->max_files = max_files;
+}
+
+static void
+wildcard_sd_forget_reader(WildcardSourceDriver *self, WildcardFileReader *reader)
+{
+  wildcard_file_reader_close(reader);
+  if (reader->waiting)
+    g_queue_remove(self->waiting_readers, reader);
+  g_hash_table_remove(self->file_readers, reader->filename->str);
+}
+
+/* returns TRUE if a slot was freed */
+static gboolean
+wildcard_sd_close_idle_reader(WildcardSourceDriver *self)
+{
+  GList *l;
+
+  /* open_readers are ordered by the time they became idle */
+  for (l = self->open_readers; l; l = l->next)
+    {
+      WildcardFileReader *reader = (WildcardFileReader *) l->data;
+
+      if (g_atomic_int_get(&reader->eof))
+        {
+          msg_debug("Closing idle file to make room for others, max-files() reached",
+                    evt_tag_str("filename", reader->filename->str),
+                    evt_tag_int("max_files", self->max_files),
+                    NULL);
+          wildcard_file_reader_close(reader);
+          return TRUE;
+        }
+    }
+  return FALSE;
+}
+
+static void
+wildcard_sd_request_open(WildcardSourceDriver *self, WildcardFileReader *reader)
+{
+  if (reader->reader || reader->waiting)
+    return;
+
+  if (self->num_open_readers >= self->max_files && !wildcard_sd_close_idle_reader(self))
+    {
+      reader->waiting = TRUE;
+      g_queue_push_tail(self->waiting_readers, reader);
+      return;
+    }
+  wildcard_file_reader_open(reader);
+}
+
+static void
+wildcard_sd_open_waiting_readers(WildcardSourceDriver *self)
+{
+  while (!g_queue_is_empty(self->waiting_readers) &&
+         (self->num_open_readers < self->max_files || wildcard_sd_close_idle_reader(self)))
+    {
+      WildcardFileReader *reader = (WildcardFileReader *) g_queue_pop_head(self->waiting_readers);
+
+      reader->waiting = FALSE;
+      wildcard_file_reader_open(reader);
+    }
+}
+
+static void
+wildcard_sd_housekeeping(gpointer s)
+{
+  WildcardSourceDriver *self = (WildcardSourceDriver *) s;
+  GList *l, *next;
+
+  for (l = self->open_readers; l; l = next)
+    {
+      WildcardFileReader *reader = (WildcardFileReader *) l->data;
+
+      next = l->next;
+      if (reader->deleted && g_atomic_int_get(&reader->eof))
+        {
+          msg_verbose("Followed file was deleted, closing it",
+                      evt_tag_str("filename", reader->filename->str),
+                      NULL);
+          wildcard_sd_forget_reader(self, reader);
+        }
+      else if (reader->close_needed)
+        {
+          reader->close_needed = FALSE;
+          wildcard_file_reader_close(reader);
+        }
+      else if (reader->reopen_needed)
+        {
+          msg_verbose("Followed file moved, tracking of the new file is started",
+                      evt_tag_str("filename", reader->filename->str),
+                      NULL);
+          wildcard_file_reader_close(reader);
+          wildcard_file_reader_open(reader);
+        }
+    }
+  wildcard_sd_open_waiting_readers(self);
+}
+
+static void
+wildcard_sd_schedule_housekeeping(WildcardSourceDriver *self)
+{
+  if (!iv_task_registered(&self->housekeeping_task))
+    iv_task_register(&self->housekeeping_task);
+}
+
+static void
+wildcard_sd_file_seen(WildcardSourceDriver *self, const gchar *filename, struct stat *st)
+{
+  WildcardFileReader *reader;
+
+  reader = g_hash_table_lookup(self->file_readers, filename);
+  if (!reader)
+    {
+      reader = wildcard_file_reader_new(self, filename);
+      g_hash_table_insert(self->file_readers, reader->filename->str, reader);
+    }
+  reader->scan_generation = self->scan_generation;
+  reader->deleted = FALSE;
+
+  /* open readers notice changes by themselves */
+  if (!reader->reader && st->st_mtime != reader->closed_mtime)
+    wildcard_sd_request_open(self, reader);
+}
+
+static void
+wildcard_sd_file_gone(WildcardSourceDriver *self, const gchar *filename)
+{
+  WildcardFileReader *reader;
+
+  reader = g_hash_table_lookup(self->file_readers, filename);
+  if (!reader)
+    return;
+
+  if (!reader->reader)
+    {
+      wildcard_sd_forget_reader(self, reader);
+      return;
+    }
+
+  /* read what's left of it, see wildcard_sd_housekeeping() */
+  reader->deleted = TRUE;
+  if (g_atomic_int_get(&reader->eof))
+    wildcard_sd_schedule_housekeeping(self);
+}
+
+/* NOTE: @lst is the result of lstat(), to avoid looping on symlinked directories */
+static void
+wildcard_sd_check_path(WildcardSourceDriver *self, const gchar *path, const gchar *name, struct stat *lst)
+{
+  struct stat st;
+
+  if (S_ISDIR(lst->st_mode))
+    {
+      if (self->recursive)
+        wildcard_sd_scan_dir(self, path);
+      return;
+    }
+
+  if (!g_pattern_match_string(self->compiled_pattern, name))
+    return;
+
+  /* symlinks to files are followed, as in e.g. /var/log/containers */
+  if (stat(path, &st) < 0 || !S_ISREG(st.st_mode))
+    return;
+
+  wildcard_sd_file_seen(self, path, &st);
+}
+
+static void
+wildcard_dir_watch_handle_event(gpointer s, const gchar *name)
+{
+  WildcardDirWatch *dir_watch = (WildcardDirWatch *) s;
+  WildcardSourceDriver *self = dir_watch->owner;
+  WildcardDirWatch *subdir_watch;
+  gchar *path;
+  struct stat lst;
+
+  /* events about the directory itself are sorted out by the next rescan */
+  if (!name)
+    return;
+
+  path = g_build_filename(dir_watch->dirname, name, NULL);
+  if (lstat(path, &lst) < 0)
+    {
+      wildcard_sd_file_gone(self, path);
+    }
+  else if (S_ISDIR(lst.st_mode))
+    {
+      subdir_watch = g_hash_table_lookup(self->dir_watches, path);
+      if (!subdir_watch || !subdir_watch->watch || !inotify_file_watch_is_alive(subdir_watch->watch))
+        wildcard_sd_check_path(self, path, name, &lst);
+    }
+  else
+    {
+      wildcard_sd_check_path(self, path, name, &lst);
+    }
+  g_free(path);
+}
+
+static void
+wildcard_dir_watch_free(WildcardDirWatch *self)
+{
+  if (self->watch)
+    inotify_file_watch_free(self->watch);
+  g_free(self->dirname);
+  g_free(self);
+}
+
+static void
+wildcard_sd_watch_dir(WildcardSourceDriver *self, const gchar *dirname)
+{
+  WildcardDirWatch *dir_watch;
+
+  dir_watch = g_hash_table_lookup(self->dir_watches, dirname);
+  if (dir_watch && dir_watch->watch && !inotify_file_watch_is_alive(dir_watch->watch))
+    {
+      /* the directory was removed and possibly recreated since */
+      inotify_file_watch_free(dir_watch->watch);
+      dir_watch->watch = NULL;
+    }
+
+  if (!dir_watch)
+    {
+      dir_watch = g_new0(WildcardDirWatch, 1);
+      dir_watch->owner = self;
+      dir_watch->dirname = g_strdup(dirname);
+      g_hash_table_insert(self->dir_watches, dir_watch->dirname, dir_watch);
+    }
+
+  if (!dir_watch->watch && self->super.monitor_method == FMM_AUTO)
+    dir_watch->watch = inotify_file_watch_new_for_dir(dirname, wildcard_dir_watch_handle_event, dir_watch);
+  dir_watch->scan_generation = self->scan_generation;
+}
+
+static void
+wildcard_sd_scan_dir(WildcardSourceDriver *self, const gchar *dirname)
+{
+  GDir *dir;
+  GError *error = NULL;
+  const gchar *name;
+  gchar *path;
+  struct stat lst;
+
+  /* watch before reading the directory, so files created meanwhile are not missed */
+  wildcard_sd_watch_dir(self, dirname);
+
+  dir = g_dir_open(dirname, 0, &error);
+  if (!dir)
+    {
+      msg_verbose("Error opening directory for wildcard-file() source",
+                  evt_tag_str("dirname", dirname),
+                  evt_tag_str("error", error->message),
+                  NULL);
+      g_clear_error(&error);
+      return;
+    }
+
+  while ((name = g_dir_read_name(dir)))
+    {
+      path = g_build_filename(dirname, name, NULL);
+      if (lstat(path, &lst) == 0)
+        wildcard_sd_check_path(self, path, name, &lst);
+      g_free(path);
+    }
+  g_dir_close(dir);
+}
+
+static gboolean
+_is_stale_dir_watch(gpointer key, gpointer value, gpointer user_data)
+{
+  WildcardDirWatch *dir_watch = (WildcardDirWatch *) value;
+  WildcardSourceDriver *self = (WildcardSourceDriver *) user_data;
+
+  return dir_watch->scan_generation != self->scan_generation;
+}
+
+/* walk the whole tree, picks up anything inotify missed or could not watch */
+static void
+wildcard_sd_rescan(WildcardSourceDriver *self)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+  GList *gone = NULL, *l;
+
+  self->scan_generation++;
+  wildcard_sd_scan_dir(self, self->base_dir);
+
+  g_hash_table_iter_init(&iter, self->file_readers);
+  while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+      WildcardFileReader *reader = (WildcardFileReader *) value;
+
+      if (reader->scan_generation != self->scan_generation)
+        gone = g_list_prepend(gone, g_strdup(reader->filename->str));
+    }
+  for (l = gone; l; l = l->next)
+    {
+      wildcard_sd_file_gone(self, (gchar *) l->data);
+      g_free(l->data);
+    }
+  g_list_free(gone);
+
+  g_hash_table_foreach_remove(self->dir_watches, _is_stale_dir_watch, self);
+}
+
+static gint
+wildcard_sd_get_rescan_freq(WildcardSourceDriver *self)
+{
+  WildcardDirWatch *dir_watch = g_hash_table_lookup(self->dir_watches, self->base_dir);
+
+  if (dir_watch && dir_watch->watch && inotify_file_watch_is_alive(dir_watch->watch))
+    return WILDCARD_SD_INOTIFY_RESCAN_MSEC;
+  return self->super.follow_freq;
+}
+
+static void
+wildcard_sd_arm_rescan_timer(WildcardSourceDriver *self)
+{
+  iv_validate_now();
+  self->rescan_timer.expires = iv_now;
+  timespec_add_msec(&self->rescan_timer.expires, wildcard_sd_get_rescan_freq(self));
+  iv_timer_register(&self->rescan_timer);
+}
+
+static void
+wildcard_sd_rescan_timer_expired(gpointer s)
+{
+  WildcardSourceDriver *self = (WildcardSourceDriver *) s;
+
+  wildcard_sd_rescan(self);
+  wildcard_sd_housekeeping(self);
+  wildcard_sd_arm_rescan_timer(self);
+}
+
+static gboolean
+wildcard_sd_init(LogPipe *s)
+{
+  WildcardSourceDriver *self = (WildcardSourceDriver *) s;
+  GlobalConfig *cfg = log_pipe_get_config(s);
+
+  if (!affile_sd_init_options(&self->super, cfg))
+    return FALSE;
+
+  if (!self->base_dir || !self->filename_pattern)
+    {
+      msg_error("wildcard-file() source requires both base-dir() and filename-pattern() to be set",
+                NULL);
+      return FALSE;
+    }
+
+  if (self->super.follow_freq <= 0)
+    {
+      msg_warning("WARNING: wildcard-file() source can only follow files, setting follow-freq() to its default",
+                  evt_tag_str("base_dir", self->base_dir),
+                  NULL);
+      self->super.follow_freq = 1000;
+    }
+
+  if (self->max_files <= 0)
+    {
+      msg_error("Invalid max-files() value for wildcard-file() source, it must be a positive number",
+                evt_tag_int("max_files", self->max_files),
+                NULL);
+      return FALSE;
+    }
+
+  self->compiled_pattern = g_pattern_spec_new(self->filename_pattern);
+  self->file_readers = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify) log_pipe_unref);
+  self->dir_watches = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify) wildcard_dir_watch_free);
+  self->waiting_readers = g_queue_new();
+
+  wildcard_sd_rescan(self);
+  wildcard_sd_arm_rescan_timer(self);
+
+  msg_verbose("Wildcard file source started",
+              evt_tag_str("base_dir", self->base_dir),
+              evt_tag_str("filename_pattern", self->filename_pattern),
+              evt_tag_int("files", g_hash_table_size(self->file_readers)),
+              evt_tag_int("open_files", self->num_open_readers),
+              NULL);
+  return TRUE;
+}
+
+static void
+_close_reader(gpointer key, gpointer value, gpointer user_data)
+{
+  wildcard_file_reader_close((WildcardFileReader *) value);
+}
+
+static gboolean
+wildcard_sd_deinit(LogPipe *s)
+{
+  WildcardSourceDriver *self = (WildcardSourceDriver *) s;
+
+  if (iv_timer_registered(&self->rescan_timer))
+    iv_timer_unregister(&self->rescan_timer);
+  if (iv_task_registered(&self->housekeeping_task))
+    iv_task_unregister(&self->housekeeping_task);
+
+  if (self->file_readers)
+    {
+      g_hash_table_foreach(self->file_readers, _close_reader, NULL);
+      g_hash_table_destroy(self->file_readers);
+      self->file_readers = NULL;
+    }
+  g_assert(self->num_open_readers == 0 && !self->open_readers);
+
+  if (self->dir_watches)
+    {
+      g_hash_table_destroy(self->dir_watches);
+      self->dir_watches = NULL;
+    }
+  if (self->waiting_readers)
+    {
+      g_queue_free(self->waiting_readers);
+      self->waiting_readers = NULL;
+    }
+  if (self->compiled_pattern)
+    {
+      g_pattern_spec_free(self->compiled_pattern);
+      self->compiled_pattern = NULL;
+    }
+
+  return log_src_driver_deinit_method(s);
+}
+
+static void
+wildcard_sd_free(LogPipe *s)
+{
+  WildcardSourceDriver *self = (WildcardSourceDriver *) s;
+
+  g_free(self->base_dir);
+  g_free(self->filename_pattern);
+  affile_sd_free(s);
+}
+
+LogDriver *
+wildcard_sd_new(GlobalConfig *cfg)
+{
+  WildcardSourceDriver *self = g_new0(WildcardSourceDriver, 1);
+
+  affile_sd_init_instance(&self->super, "", cfg);
+  self->super.super.super.super.init = wildcard_sd_init;
+  self->super.super.super.super.deinit = wildcard_sd_deinit;
+  self->super.super.super.super.free_fn = wildcard_sd_free;
+  /* FILE_NAME is set by the individual file readers */
+  self->super.super.super.super.queue = log_src_driver_queue_method;
+  self->super.super.super.super.notify = NULL;
+
+  self->super.file_open_options.is_pipe = FALSE;
+  self->super.file_open_options.open_flags = DEFAULT_SD_OPEN_FLAGS;
+  self->super.follow_freq = 1000;
+  self->max_files = WILDCARD_SD_DEFAULT_MAX_FILES;
+
+  IV_TIMER_INIT(&self->rescan_timer);
+  self->rescan_timer.cookie = self;
+  self->rescan_timer.handler = wildcard_sd_rescan_timer_expired;
+
+  IV_TASK_INIT(&self->housekeeping_task);
+  self->housekeeping_task.cookie = self;
+  self->housekeeping_task.handler = wildcard_sd_housekeeping;
+
+  return &self->super.super.super;
+}
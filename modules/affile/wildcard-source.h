@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef WILDCARD_SOURCE_H_INCLUDED
+#define WILDCARD_SOURCE_H_INCLUDED
+
+#include "affile-source.h"
+
+#include <iv.h>
+
+typedef struct _WildcardSourceDriver
+{
+  AFFileSourceDriver super;
+  gchar *base_dir;
+  gchar *filename_pattern;
+  GPatternSpec *compiled_pattern;
+  gboolean recursive;
+  gint max_files;
+
+  /* WildcardFileReader instances by filename, both open and closed ones */
+  GHashTable *file_readers;
+  /* the open ones, the least recently idle first */
+  GList *open_readers;
+  gint num_open_readers;
+  /* readers that could not be opened because of max-files() */
+  GQueue *waiting_readers;
+
+  /* watched directories by name */
+  GHashTable *dir_watches;
+  guint scan_generation;
+  struct iv_timer rescan_timer;
+  struct iv_task housekeeping_task;
+} WildcardSourceDriver;
+
+LogDriver *wildcard_sd_new(GlobalConfig *cfg);
+
+void wildcard_sd_set_base_dir(LogDriver *s, const gchar *base_dir);
+void wildcard_sd_set_filename_pattern(LogDriver *s, const gchar *filename_pattern);
+void wildcard_sd_set_recursive(LogDriver *s, gboolean recursive);
+void wildcard_sd_set_max_files(LogDriver *s, gint max_files);
+
+#endif
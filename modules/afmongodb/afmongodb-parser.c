@@ -32,6 +32,9 @@ static CfgLexerKeyword afmongodb_keywords[] = {
   { "mongodb",			KW_MONGODB },
   { "uri",                      KW_URI },
   { "collection",		KW_COLLECTION },
+  { "bulk",			KW_BULK },
+  { "bulk_unordered",		KW_BULK_UNORDERED },
+  { "write_concern",		KW_WRITE_CONCERN },
   { NULL }
 };
 
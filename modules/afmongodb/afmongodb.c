@@ -38,6 +38,8 @@
 #include "mongoc.h"
 #include <time.h>
 
+#define AFMONGODB_BULK_LINES_DEFAULT 100
+
 typedef struct
 {
   gchar *name;
@@ -59,6 +61,10 @@ typedef struct
 
   ValuePairs *vp;
 
+  gboolean bulk;
+  gboolean bulk_unordered;
+  mongoc_write_concern_t *write_concern;
+
   /* Writer-only stuff */
   const gchar *db;
   mongoc_uri_t *uri_obj;
@@ -67,6 +73,7 @@ typedef struct
 
   GString *current_value;
   bson_t *bson;
+  mongoc_bulk_operation_t *bulk_op;
 } MongoDBDestDriver;
 
 /*
@@ -108,6 +115,43 @@ afmongodb_dd_set_value_pairs(LogDriver *d, ValuePairs *vp)
   self->vp = vp;
 }
 
+void
+afmongodb_dd_set_bulk(LogDriver *d, gboolean bulk)
+{
+  MongoDBDestDriver *self = (MongoDBDestDriver *)d;
+
+  self->bulk = bulk;
+}
+
+void
+afmongodb_dd_set_bulk_unordered(LogDriver *d, gboolean bulk_unordered)
+{
+  MongoDBDestDriver *self = (MongoDBDestDriver *)d;
+
+  self->bulk_unordered = bulk_unordered;
+}
+
+gboolean
+afmongodb_dd_set_write_concern(LogDriver *d, const gchar *write_concern)
+{
+  MongoDBDestDriver *self = (MongoDBDestDriver *)d;
+  gint w;
+
+  if (strcmp(write_concern, "unacknowledged") == 0)
+    w = MONGOC_WRITE_CONCERN_W_UNACKNOWLEDGED;
+  else if (strcmp(write_concern, "acknowledged") == 0)
+    w = MONGOC_WRITE_CONCERN_W_DEFAULT;
+  else if (strcmp(write_concern, "majority") == 0)
+    w = MONGOC_WRITE_CONCERN_W_MAJORITY;
+  else
+    return FALSE;
+
+  if (!self->write_concern)
+    self->write_concern = mongoc_write_concern_new();
+  mongoc_write_concern_set_w(self->write_concern, w);
+  return TRUE;
+}
+
 /*
  * Utilities
  */
@@ -137,6 +181,11 @@ afmongodb_dd_disconnect(LogThrDestDriver *s)
 {
   MongoDBDestDriver *self = (MongoDBDestDriver *)s;
 
+  if (self->bulk_op)
+    {
+      mongoc_bulk_operation_destroy(self->bulk_op);
+      self->bulk_op = NULL;
+    }
   mongoc_client_destroy(self->client);
   self->client = NULL;
 }
@@ -345,16 +394,12 @@ afmongodb_worker_retry_over_message(LogThrDestDriver *s, LogMessage *msg)
             NULL);
 }
 
-static worker_insert_result_t
-afmongodb_worker_insert (LogThrDestDriver *s, LogMessage *msg)
+static gboolean
+afmongodb_worker_format_message(MongoDBDestDriver *self, LogMessage *msg)
 {
-  MongoDBDestDriver *self = (MongoDBDestDriver *)s;
   gboolean success;
   gboolean drop_silently = self->template_options.on_error & ON_ERROR_SILENT;
 
-  if (!afmongodb_dd_connect(self, TRUE))
-    return WORKER_INSERT_RESULT_NOT_CONNECTED;
-
   bson_reinit (self->bson);
 
   success = value_pairs_walk(self->vp,
@@ -377,30 +422,113 @@ afmongodb_worker_insert (LogThrDestDriver *s, LogMessage *msg)
                     evt_tag_str("driver", self->super.super.super.id),
                     NULL);
         }
-      return WORKER_INSERT_RESULT_DROP;
+      return FALSE;
     }
-  else
+
+  msg_debug("Outgoing message to MongoDB destination",
+            evt_tag_value_pairs("message", self->vp, msg,
+                                self->super.seq_num,
+                                LTZ_SEND, &self->template_options),
+            evt_tag_str("driver", self->super.super.super.id),
+            NULL);
+  return TRUE;
+}
+
+static void
+afmongodb_worker_discard_bulk(MongoDBDestDriver *self)
+{
+  if (self->bulk_op)
+    {
+      mongoc_bulk_operation_destroy(self->bulk_op);
+      self->bulk_op = NULL;
+    }
+}
+
+/*
+ * bulk(yes): the documents are collected into a bulk operation, which is
+ * executed by afmongodb_worker_flush() when LogThrDestDriver says so.  Any
+ * result other than QUEUED applies to the whole batch, so the bulk
+ * operation is discarded then, the batch will be formatted again.
+ */
+static worker_insert_result_t
+afmongodb_worker_insert_bulk(MongoDBDestDriver *self, LogMessage *msg)
+{
+  if (!afmongodb_dd_connect(self, TRUE))
+    {
+      afmongodb_worker_discard_bulk(self);
+      return WORKER_INSERT_RESULT_NOT_CONNECTED;
+    }
+
+  /* leave the message out instead of dropping the whole batch */
+  if (!afmongodb_worker_format_message(self, msg))
+    {
+      stats_counter_inc(self->super.dropped_messages);
+      return WORKER_INSERT_RESULT_QUEUED;
+    }
+
+  if (!self->bulk_op)
+    self->bulk_op = mongoc_collection_create_bulk_operation(self->coll_obj, !self->bulk_unordered,
+                                                            self->write_concern);
+  mongoc_bulk_operation_insert(self->bulk_op, self->bson);
+  return WORKER_INSERT_RESULT_QUEUED;
+}
+
+static worker_insert_result_t
+afmongodb_worker_flush(LogThrDestDriver *s)
+{
+  MongoDBDestDriver *self = (MongoDBDestDriver *)s;
+  bson_error_t error;
+  bson_t reply;
+  gboolean success;
+
+  /* every message of the batch was dropped */
+  if (!self->bulk_op)
+    return WORKER_INSERT_RESULT_SUCCESS;
+
+  success = mongoc_bulk_operation_execute(self->bulk_op, &reply, &error) != 0;
+  bson_destroy(&reply);
+  afmongodb_worker_discard_bulk(self);
+
+  if (!success)
     {
-      bson_error_t error;
-      msg_debug("Outgoing message to MongoDB destination",
-                evt_tag_value_pairs("message", self->vp, msg,
-                                    self->super.seq_num,
-                                    LTZ_SEND, &self->template_options),
+      msg_error("Error while inserting a batch into MongoDB",
+                evt_tag_int("time_reopen", self->super.time_reopen),
+                evt_tag_str("reason", error.message),
                 evt_tag_str("driver", self->super.super.super.id),
                 NULL);
+      return WORKER_INSERT_RESULT_ERROR;
+    }
 
-      success = mongoc_collection_insert (self->coll_obj, MONGOC_INSERT_NONE,
-                                          (const bson_t *) self->bson,
-                                          NULL,
-                                          &error);
-      if (!success)
-        {
-          msg_error("Network error while inserting into MongoDB",
-                    evt_tag_int("time_reopen", self->super.time_reopen),
-                    evt_tag_str("reason", error.message),
-                    evt_tag_str("driver", self->super.super.super.id),
-                    NULL);
-        }
+  return WORKER_INSERT_RESULT_SUCCESS;
+}
+
+static worker_insert_result_t
+afmongodb_worker_insert (LogThrDestDriver *s, LogMessage *msg)
+{
+  MongoDBDestDriver *self = (MongoDBDestDriver *)s;
+  gboolean success;
+  bson_error_t error;
+
+  if (self->bulk)
+    return afmongodb_worker_insert_bulk(self, msg);
+
+  if (!afmongodb_dd_connect(self, TRUE))
+    return WORKER_INSERT_RESULT_NOT_CONNECTED;
+
+  if (!afmongodb_worker_format_message(self, msg))
+    return WORKER_INSERT_RESULT_DROP;
+
+  success = mongoc_collection_insert (self->coll_obj, MONGOC_INSERT_NONE,
+                                      (const bson_t *) self->bson,
+                                      self->write_concern,
+                                      &error);
+  if (!success)
+    {
+      msg_error("Network error while inserting into MongoDB",
+                evt_tag_int("time_reopen", self->super.time_reopen),
+                evt_tag_str("reason", error.message),
+                evt_tag_str("driver", self->super.super.super.id),
+                NULL);
     }
 
   if (!success && (errno == ENOTCONN))
@@ -431,6 +559,7 @@ afmongodb_worker_thread_deinit(LogThrDestDriver *d)
 
   g_string_free (self->current_value, TRUE);
 
+  afmongodb_worker_discard_bulk(self);
   bson_free (self->bson);
 }
 
@@ -482,6 +611,8 @@ afmongodb_dd_init(LogPipe *s)
       return FALSE;
     }
 
+  self->super.worker.flush = self->bulk ? afmongodb_worker_flush : NULL;
+
   msg_verbose("Initializing MongoDB destination",
               evt_tag_str ("uri", self->uri),
               evt_tag_str ("db", self->db),
@@ -503,6 +634,8 @@ afmongodb_dd_free(LogPipe *d)
   g_free(self->coll);
   value_pairs_unref(self->vp);
 
+  if (self->write_concern)
+    mongoc_write_concern_destroy(self->write_concern);
   mongoc_uri_destroy(self->uri_obj);
   mongoc_collection_destroy (self->coll_obj);
   mongoc_cleanup ();
@@ -544,6 +677,8 @@ afmongodb_dd_new(GlobalConfig *cfg)
   self->super.messages.retry_over = afmongodb_worker_retry_over_message;
 
   afmongodb_dd_set_collection((LogDriver *)self, "messages");
+  self->bulk = TRUE;
+  log_threaded_dest_driver_set_batch_lines((LogDriver *)self, AFMONGODB_BULK_LINES_DEFAULT);
 
   log_template_options_defaults(&self->template_options);
   afmongodb_dd_set_value_pairs(&self->super.super.super, value_pairs_new_default(cfg));
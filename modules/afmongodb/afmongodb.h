@@ -33,6 +33,9 @@ void afmongodb_dd_set_uri(LogDriver *d, const gchar *uri);
 void afmongodb_dd_set_collection(LogDriver *d, const gchar *collection);
 void afmongodb_dd_set_value_pairs(LogDriver *d, ValuePairs *vp);
 void afmongodb_dd_set_retries(LogDriver *d, gint retries);
+void afmongodb_dd_set_bulk(LogDriver *d, gboolean bulk);
+void afmongodb_dd_set_bulk_unordered(LogDriver *d, gboolean bulk_unordered);
+gboolean afmongodb_dd_set_write_concern(LogDriver *d, const gchar *write_concern);
 
 LogTemplateOptions *afmongodb_dd_get_template_options(LogDriver *s);
 
@@ -33,6 +33,8 @@ static CfgLexerKeyword afprog_keywords[] = {
   { "program",                 KW_PROGRAM },
   { "keep_alive",              KW_KEEP_ALIVE },
   { "inherit_environment",     KW_INHERIT_ENVIRONMENT },
+  { "pipe_size",               KW_PIPE_SIZE },
+  { "framed",                  KW_FRAMED },
   { NULL }
 };
 
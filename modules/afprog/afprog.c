@@ -31,6 +31,7 @@
 #include "transport/transport-pipe.h"
 #include "logproto/logproto-text-server.h"
 #include "logproto/logproto-text-client.h"
+#include "logproto/logproto-framed-client.h"
 #include "poll-fd-events.h"
 
 #include <sys/types.h>
@@ -356,6 +357,22 @@ afprogram_dd_kill_child(AFProgramDestDriver *self)
     }
 }
 
+static void
+afprogram_dd_set_pipe_capacity(AFProgramDestDriver *self, gint fd)
+{
+  if (self->pipe_size <= 0)
+    return;
+
+#ifdef F_SETPIPE_SZ
+  if (fcntl(fd, F_SETPIPE_SZ, self->pipe_size) < 0)
+    msg_warning("Error setting the capacity of the program pipe, using the default",
+                evt_tag_str("cmdline", self->process_info.cmdline->str),
+                evt_tag_int("pipe_size", self->pipe_size),
+                evt_tag_errno(EVT_TAG_OSERROR, errno),
+                NULL);
+#endif
+}
+
 static inline gboolean
 afprogram_dd_open_program(AFProgramDestDriver *self, int *fd)
 {
@@ -369,6 +386,7 @@ afprogram_dd_open_program(AFProgramDestDriver *self, int *fd)
         return FALSE;
 
       g_fd_set_nonblock(*fd, TRUE);
+      afprogram_dd_set_pipe_capacity(self, *fd);
     }
 
   child_manager_register(self->process_info.pid, afprogram_dd_exit, log_pipe_ref(&self->super.super.super), (GDestroyNotify)log_pipe_unref);
@@ -376,6 +394,16 @@ afprogram_dd_open_program(AFProgramDestDriver *self, int *fd)
   return TRUE;
 }
 
+static LogProtoClient *
+afprogram_dd_construct_proto(AFProgramDestDriver *self, gint fd)
+{
+  LogTransport *transport = log_transport_pipe_new(fd);
+
+  if (self->framed)
+    return log_proto_framed_client_new(transport, &self->writer_options.proto_options.super);
+  return log_proto_text_client_new(transport, &self->writer_options.proto_options.super);
+}
+
 static gboolean
 afprogram_dd_reopen(AFProgramDestDriver *self)
 {
@@ -386,7 +414,7 @@ afprogram_dd_reopen(AFProgramDestDriver *self)
   if (!afprogram_dd_open_program(self, &fd))
     return FALSE;
 
-  log_writer_reopen(self->writer, log_proto_text_client_new(log_transport_pipe_new(fd), &self->writer_options.proto_options.super));
+  log_writer_reopen(self->writer, afprogram_dd_construct_proto(self, fd));
   return TRUE;
 }
 
@@ -551,6 +579,23 @@ afprogram_dd_set_keep_alive(AFProgramDestDriver *self, gboolean keep_alive)
   self->keep_alive = keep_alive;
 }
 
+void
+afprogram_dd_set_pipe_size(AFProgramDestDriver *self, gint pipe_size)
+{
+#ifndef F_SETPIPE_SZ
+  if (pipe_size > 0)
+    msg_warning("WARNING: pipe-size() is not supported on this platform, ignoring",
+                NULL);
+#endif
+  self->pipe_size = pipe_size;
+}
+
+void
+afprogram_dd_set_framed(AFProgramDestDriver *self, gboolean framed)
+{
+  self->framed = framed;
+}
+
 void
 afprogram_set_inherit_environment(AFProgramProcessInfo *self, gboolean inherit_environment)
 {
@@ -49,6 +49,10 @@ typedef struct _AFProgramDestDriver
   AFProgramProcessInfo process_info;
   LogWriter *writer;
   gboolean keep_alive;
+  /* capacity of the pipe to the program, 0: system default */
+  gint pipe_size;
+  /* use octet counted framing (RFC6587), so batches can be split easily */
+  gboolean framed;
   LogWriterOptions writer_options;
 } AFProgramDestDriver;
 
@@ -56,6 +60,8 @@ LogDriver *afprogram_sd_new(gchar *cmdline, GlobalConfig *cfg);
 LogDriver *afprogram_dd_new(gchar *cmdline, GlobalConfig *cfg);
 
 void afprogram_dd_set_keep_alive(AFProgramDestDriver *self, gboolean keep_alive);
+void afprogram_dd_set_pipe_size(AFProgramDestDriver *self, gint pipe_size);
+void afprogram_dd_set_framed(AFProgramDestDriver *self, gboolean framed);
 void afprogram_set_inherit_environment(AFProgramProcessInfo *self, gboolean inherit_environment);
 
 #endif
@@ -62,9 +62,29 @@ typedef struct
   LogTemplate *subject_template;
   LogTemplate *body_template;
 
+  gboolean digest;
+
   /* Writer-only stuff */
   GString *str;
   LogTemplateOptions template_options;
+
+  /*
+   * The mails of a batch are sent in a single SMTP session, with
+   * digest(yes) the messages with the same envelope are merged into one
+   * mail.
+   */
+  struct
+  {
+    smtp_session_t session;
+    /* smtp_message_t, and the GString holding its body */
+    GPtrArray *mails;
+    GPtrArray *bodies;
+    /* index of the mail of each queued message, -1 if it is not sent */
+    GArray *message_mails;
+    /* envelope -> index of the mail + 1 */
+    GHashTable *digests;
+    GString *envelope;
+  } batch;
 } AFSMTPDriver;
 
 typedef struct
@@ -184,6 +204,14 @@ afsmtp_dd_add_header(LogDriver *d, const gchar *header, LogTemplate *value)
   return TRUE;
 }
 
+void
+afsmtp_dd_set_digest(LogDriver *d, gboolean digest)
+{
+  AFSMTPDriver *self = (AFSMTPDriver *)d;
+
+  self->digest = digest;
+}
+
 /*
  * Utilities
  */
@@ -391,7 +419,7 @@ __build_session(AFSMTPDriver *self, LogMessage *msg)
 }
 
 static smtp_message_t
-__build_message(AFSMTPDriver *self, LogMessage *msg, smtp_session_t session)
+__build_message(AFSMTPDriver *self, LogMessage *msg, smtp_session_t session, GString *body)
 {
   smtp_message_t message;
   gpointer args[] = { self, NULL, NULL };
@@ -426,14 +454,38 @@ __build_message(AFSMTPDriver *self, LogMessage *msg, smtp_session_t session)
    * We add a header to the body, otherwise libesmtp will not
    * recognise headers, and will append them to the end of the body.
    */
-  g_string_assign(self->str, "X-Mailer: syslog-ng " SYSLOG_NG_VERSION "\r\n\r\n");
+  g_string_assign(body, "X-Mailer: syslog-ng " SYSLOG_NG_VERSION "\r\n\r\n");
   log_template_append_format(self->body_template, msg, &self->template_options,
                              LTZ_SEND, self->super.seq_num,
-                             NULL, self->str);
-  smtp_set_message_str(message, self->str->str);
+                             NULL, body);
   return message;
 }
 
+static void
+__append_envelope_address(AFSMTPDriver *self, LogTemplate *template, LogMessage *msg)
+{
+  log_template_append_format(template, msg, &self->template_options, LTZ_SEND,
+                             self->super.seq_num, NULL, self->batch.envelope);
+  g_string_append_c(self->batch.envelope, '\n');
+}
+
+/* the reverse path and the recipients a message would be sent to */
+static void
+__format_envelope(AFSMTPDriver *self, LogMessage *msg)
+{
+  GList *l;
+
+  g_string_truncate(self->batch.envelope, 0);
+  __append_envelope_address(self, self->mail_from->template, msg);
+  for (l = self->rcpt_tos; l; l = l->next)
+    {
+      AFSMTPRecipient *rcpt = (AFSMTPRecipient *) l->data;
+
+      g_string_append_c(self->batch.envelope, '0' + rcpt->type);
+      __append_envelope_address(self, rcpt->template, msg);
+    }
+}
+
 static gboolean
 __check_transfer_status(AFSMTPDriver *self, smtp_message_t message)
 {
@@ -492,45 +544,144 @@ __worker_message_retry_over(LogThrDestDriver *self, LogMessage *msg)
   msg_error("Multiple failures while sending message in email to the server, "
             "message dropped",
             evt_tag_str("driver", self->super.super.id),
-            evt_tag_int("attempts", self->retries.counter),
+            evt_tag_int("attempts", log_threaded_dest_driver_get_worker(self)->retries_counter),
             evt_tag_int("max-attempts", self->retries.max),
             NULL);
 }
 
+static gboolean
+__remove_digest(gpointer key, gpointer value, gpointer user_data)
+{
+  return TRUE;
+}
+
+static void
+__batch_clear(AFSMTPDriver *self)
+{
+  gint i;
+
+  if (self->batch.session)
+    smtp_destroy_session(self->batch.session);
+  self->batch.session = NULL;
+
+  for (i = 0; i < self->batch.bodies->len; i++)
+    g_string_free((GString *) g_ptr_array_index(self->batch.bodies, i), TRUE);
+  g_ptr_array_set_size(self->batch.bodies, 0);
+  g_ptr_array_set_size(self->batch.mails, 0);
+  g_array_set_size(self->batch.message_mails, 0);
+  g_hash_table_foreach_remove(self->batch.digests, __remove_digest, NULL);
+}
+
+static gint
+__batch_find_digest(AFSMTPDriver *self, LogMessage *msg)
+{
+  gint index;
+  GString *body;
+
+  __format_envelope(self, msg);
+  index = GPOINTER_TO_INT(g_hash_table_lookup(self->batch.digests, self->batch.envelope->str)) - 1;
+  if (index < 0)
+    return -1;
+
+  body = (GString *) g_ptr_array_index(self->batch.bodies, index);
+  g_string_append(body, "\r\n");
+  log_template_append_format(self->body_template, msg, &self->template_options,
+                             LTZ_SEND, self->super.seq_num,
+                             NULL, body);
+  return index;
+}
+
 static worker_insert_result_t
 afsmtp_worker_insert(LogThrDestDriver *s, LogMessage *msg)
 {
   AFSMTPDriver *self = (AFSMTPDriver *)s;
-  gboolean success = TRUE;
-  gboolean message_sent = TRUE;
-  smtp_session_t session = NULL;
-  smtp_message_t message;
+  GString *body;
+  gint index = -1;
 
   if (msg->flags & LF_MARK)
     {
       msg_debug("Mark messages are dropped by SMTP destination",
                 evt_tag_str("driver", self->super.super.super.id),
                 NULL);
-      return WORKER_INSERT_RESULT_SUCCESS;
+      g_array_append_val(self->batch.message_mails, index);
+      return WORKER_INSERT_RESULT_QUEUED;
+    }
+
+  if (self->digest)
+    index = __batch_find_digest(self, msg);
+
+  if (index < 0)
+    {
+      if (!self->batch.session)
+        self->batch.session = __build_session(self, msg);
+
+      body = g_string_sized_new(1024);
+      g_ptr_array_add(self->batch.mails, __build_message(self, msg, self->batch.session, body));
+      g_ptr_array_add(self->batch.bodies, body);
+      index = self->batch.mails->len - 1;
+
+      if (self->digest)
+        g_hash_table_insert(self->batch.digests, g_strdup(self->batch.envelope->str),
+                            GINT_TO_POINTER(index + 1));
+    }
+
+  g_array_append_val(self->batch.message_mails, index);
+  return WORKER_INSERT_RESULT_QUEUED;
+}
+
+/* the number of messages in front of the first one that failed */
+static gint
+__batch_count_sent(AFSMTPDriver *self)
+{
+  gboolean *mail_sent;
+  gint i, num_sent;
+
+  mail_sent = g_new(gboolean, self->batch.mails->len);
+  for (i = 0; i < self->batch.mails->len; i++)
+    mail_sent[i] = __check_transfer_status(self, (smtp_message_t) g_ptr_array_index(self->batch.mails, i));
+
+  for (num_sent = 0; num_sent < self->batch.message_mails->len; num_sent++)
+    {
+      gint index = g_array_index(self->batch.message_mails, gint, num_sent);
+
+      if (index >= 0 && !mail_sent[index])
+        break;
     }
+  g_free(mail_sent);
+  return num_sent;
+}
+
+static worker_insert_result_t
+afsmtp_worker_flush(LogThrDestDriver *s)
+{
+  AFSMTPDriver *self = (AFSMTPDriver *)s;
+  worker_insert_result_t result = WORKER_INSERT_RESULT_SUCCESS;
+  gint i, num_sent;
 
-  session = __build_session(self, msg);
-  message = __build_message(self, msg, session);
+  if (!self->batch.session)
+    goto exit;
 
-  message_sent = __send_message(self, session);
-  success = message_sent && __check_transfer_status(self, message);
+  /* the bodies are complete now, libesmtp reads them while sending */
+  for (i = 0; i < self->batch.mails->len; i++)
+    smtp_set_message_str((smtp_message_t) g_ptr_array_index(self->batch.mails, i),
+                         ((GString *) g_ptr_array_index(self->batch.bodies, i))->str);
 
-  smtp_destroy_session(session);
+  if (!__send_message(self, self->batch.session))
+    {
+      result = WORKER_INSERT_RESULT_NOT_CONNECTED;
+      goto exit;
+    }
 
-  if (!success)
+  num_sent = __batch_count_sent(self);
+  if (num_sent < self->batch.message_mails->len)
     {
-      if (!message_sent)
-        return WORKER_INSERT_RESULT_NOT_CONNECTED;
-      else
-        return WORKER_INSERT_RESULT_ERROR;
+      log_threaded_dest_driver_accept_batch_prefix(s, num_sent);
+      result = WORKER_INSERT_RESULT_ERROR;
     }
 
-  return WORKER_INSERT_RESULT_SUCCESS;
+exit:
+  __batch_clear(self);
+  return result;
 }
 
 static void
@@ -539,6 +690,11 @@ afsmtp_worker_thread_init(LogThrDestDriver *d)
   AFSMTPDriver *self = (AFSMTPDriver *)d;
 
   self->str = g_string_sized_new(1024);
+  self->batch.mails = g_ptr_array_new();
+  self->batch.bodies = g_ptr_array_new();
+  self->batch.message_mails = g_array_new(FALSE, FALSE, sizeof(gint));
+  self->batch.digests = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  self->batch.envelope = g_string_sized_new(256);
 
   ignore_sigpipe();
 }
@@ -548,6 +704,12 @@ afsmtp_worker_thread_deinit(LogThrDestDriver *d)
 {
   AFSMTPDriver *self = (AFSMTPDriver *)d;
 
+  __batch_clear(self);
+  g_ptr_array_free(self->batch.mails, TRUE);
+  g_ptr_array_free(self->batch.bodies, TRUE);
+  g_array_free(self->batch.message_mails, TRUE);
+  g_hash_table_destroy(self->batch.digests);
+  g_string_free(self->batch.envelope, TRUE);
   g_string_free(self->str, TRUE);
 }
 
@@ -691,6 +853,7 @@ afsmtp_dd_new(GlobalConfig *cfg)
   self->super.worker.thread_init = afsmtp_worker_thread_init;
   self->super.worker.thread_deinit = afsmtp_worker_thread_deinit;
   self->super.worker.insert = afsmtp_worker_insert;
+  self->super.worker.flush = afsmtp_worker_flush;
 
   self->super.format.stats_instance = afsmtp_dd_format_stats_instance;
   self->super.format.persist_name = afsmtp_dd_format_persist_name;
@@ -48,6 +48,7 @@ void afsmtp_dd_add_rcpt(LogDriver *d, afsmtp_rcpt_type_t type,
 void afsmtp_dd_set_body(LogDriver *d, LogTemplate *body);
 gboolean afsmtp_dd_add_header(LogDriver *d, const gchar *header,
                               LogTemplate *value);
+void afsmtp_dd_set_digest(LogDriver *d, gboolean digest);
 LogTemplateOptions *afsmtp_dd_get_template_options(LogDriver *d);
 
 #endif
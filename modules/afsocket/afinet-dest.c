@@ -147,15 +147,12 @@ _determine_port(AFInetDestDriver *self)
 }
 
 static gboolean
-afinet_dd_setup_addresses(AFSocketDestDriver *s)
+afinet_dd_resolve_addresses(AFInetDestDriver *self)
 {
-  AFInetDestDriver *self = (AFInetDestDriver *) s;
-
-  if (!afsocket_dd_setup_addresses_method(s))
-    return FALSE;
-
   g_sockaddr_unref(self->super.bind_addr);
   g_sockaddr_unref(self->super.dest_addr);
+  self->super.bind_addr = NULL;
+  self->super.dest_addr = NULL;
 
   if (!resolve_hostname_to_sockaddr(&self->super.bind_addr, self->super.transport_mapper->address_family, self->bind_ip))
     return FALSE;
@@ -163,7 +160,19 @@ afinet_dd_setup_addresses(AFSocketDestDriver *s)
   if (self->bind_port)
     g_sockaddr_set_port(self->super.bind_addr, afinet_lookup_service(self->super.transport_mapper, self->bind_port));
 
-  if (!resolve_hostname_to_sockaddr(&self->super.dest_addr, self->super.transport_mapper->address_family, self->hostname))
+  return resolve_hostname_to_sockaddr(&self->super.dest_addr, self->super.transport_mapper->address_family, self->hostname);
+}
+
+static gboolean
+afinet_dd_setup_addresses(AFSocketDestDriver *s)
+{
+  AFInetDestDriver *self = (AFInetDestDriver *) s;
+
+  if (!afsocket_dd_setup_addresses_method(s))
+    return FALSE;
+
+  /* resolved in pre_init() already while we are being initialized */
+  if (!self->addresses_resolved && !afinet_dd_resolve_addresses(self))
     return FALSE;
 
   if (!self->dest_port)
@@ -196,17 +205,33 @@ afinet_dd_get_dest_name(AFSocketDestDriver *s)
   return buf;
 }
 
+/* runs in parallel with other pipes in cfg_tree_start(), name resolution
+ * can block for a long time */
+static gboolean
+afinet_dd_pre_init(LogPipe *s)
+{
+  AFInetDestDriver *self = (AFInetDestDriver *) s;
+
+  /* errors are reported by init() once it retries */
+  self->addresses_resolved = afinet_dd_resolve_addresses(self);
+  return TRUE;
+}
+
 static gboolean
 afinet_dd_init(LogPipe *s)
 {
   AFInetDestDriver *self G_GNUC_UNUSED = (AFInetDestDriver *) s;
+  gboolean success;
 
 #if SYSLOG_NG_ENABLE_SPOOF_SOURCE
   if (self->spoof_source)
     self->super.connections_kept_alive_accross_reloads = TRUE;
 #endif
 
-  if (!afsocket_dd_init(s))
+  success = afsocket_dd_init(s);
+  /* reconnects resolve the names again */
+  self->addresses_resolved = FALSE;
+  if (!success)
     return FALSE;
 
 #if SYSLOG_NG_ENABLE_SPOOF_SOURCE
@@ -357,7 +382,7 @@ afinet_dd_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options,
   /* NOTE: this code should probably become a LogTransport instance so that
    * spoofed packets are also going through the LogWriter queue */
 
-  if (self->spoof_source && self->lnet_ctx && msg->saddr && (msg->saddr->sa.sa_family == AF_INET || msg->saddr->sa.sa_family == AF_INET6) && log_writer_opened(self->super.writer))
+  if (self->spoof_source && self->lnet_ctx && msg->saddr && (msg->saddr->sa.sa_family == AF_INET || msg->saddr->sa.sa_family == AF_INET6) && log_writer_opened(self->super.connections[0].writer))
     {
       gboolean success = FALSE;
 
@@ -368,7 +393,7 @@ afinet_dd_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options,
       if (!self->lnet_buffer)
         self->lnet_buffer = g_string_sized_new(self->spoof_source_maxmsglen);
 
-      log_writer_format_log(self->super.writer, msg, self->lnet_buffer);
+      log_writer_format_log(self->super.connections[0].writer, msg, self->lnet_buffer);
       
       if (self->lnet_buffer->len > self->spoof_source_maxmsglen)
         g_string_truncate(self->lnet_buffer, self->spoof_source_maxmsglen);
@@ -434,6 +459,7 @@ afinet_dd_new_instance(TransportMapper *transport_mapper, gchar *hostname, Globa
   AFInetDestDriver *self = g_new0(AFInetDestDriver, 1);
 
   afsocket_dd_init_instance(&self->super, socket_options_inet_new(), transport_mapper, cfg);
+  self->super.super.super.super.pre_init = afinet_dd_pre_init;
   self->super.super.super.super.init = afinet_dd_init;
   self->super.super.super.super.queue = afinet_dd_queue;
   self->super.super.super.super.free_fn = afinet_dd_free;
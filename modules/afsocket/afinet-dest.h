@@ -53,6 +53,8 @@ typedef struct _AFInetDestDriver
   gchar *bind_ip;
   /* character as it can contain a service name from /etc/services */
   gchar *dest_port;
+  /* bind_addr/dest_addr were resolved by pre_init() */
+  gboolean addresses_resolved;
   /* destination hostname is stored in super.hostname */
 } AFInetDestDriver;
 
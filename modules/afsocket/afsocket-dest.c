@@ -20,13 +20,13 @@
  * COPYING for details.
  *
  */
-
 #include "afsocket-dest.h"
 #include "messages.h"
 #include "logwriter.h"
 #include "gsocket.h"
 #include "stats/stats-registry.h"
 #include "mainloop.h"
+#include "scratch-buffers.h"
 
 #include <string.h>
 #include <sys/types.h>
@@ -39,11 +39,11 @@ typedef struct _ReloadStoreItem
 } ReloadStoreItem;
 
 static ReloadStoreItem*
-_reload_store_item_new(AFSocketDestDriver *afsocket_dd)
+_reload_store_item_new(AFSocketDestConnection *connection)
 {
   ReloadStoreItem *item = g_new(ReloadStoreItem, 1);
-  item->proto_factory = afsocket_dd->proto_factory;
-  item->writer = afsocket_dd->writer;
+  item->proto_factory = connection->owner->proto_factory;
+  item->writer = connection->writer;
   return item;
 }
 
@@ -82,15 +82,52 @@ afsocket_dd_set_keep_alive(LogDriver *s, gboolean enable)
   self->connections_kept_alive_accross_reloads = enable;
 }
 
+void
+afsocket_dd_set_connections(LogDriver *s, gint connections)
+{
+  AFSocketDestDriver *self = (AFSocketDestDriver *) s;
+
+  self->num_connections = MAX(connections, 1);
+}
+
+void
+afsocket_dd_set_connection_key(LogDriver *s, LogTemplate *connection_key)
+{
+  AFSocketDestDriver *self = (AFSocketDestDriver *) s;
+
+  log_template_unref(self->connection_key);
+  self->connection_key = connection_key;
+}
+
+gboolean
+afsocket_dd_set_load_balance(LogDriver *s, const gchar *load_balance)
+{
+  AFSocketDestDriver *self = (AFSocketDestDriver *) s;
+
+  if (strcmp(load_balance, "round-robin") == 0 || strcmp(load_balance, "round_robin") == 0)
+    self->load_balance = AFSOCKET_DD_LB_ROUND_ROBIN;
+  else if (strcmp(load_balance, "least-queued") == 0 || strcmp(load_balance, "least_queued") == 0)
+    self->load_balance = AFSOCKET_DD_LB_LEAST_QUEUED;
+  else
+    return FALSE;
+  return TRUE;
+}
+
+/* the first connection uses the same names as a single connection destination does */
 static gchar *
-afsocket_dd_format_persist_name(AFSocketDestDriver *self, gboolean qfile)
+afsocket_dd_format_persist_name(AFSocketDestConnection *connection, gboolean qfile)
 {
+  AFSocketDestDriver *self = connection->owner;
   static gchar persist_name[256];
+  gchar index[16] = "";
+
+  if (connection->index > 0)
+    g_snprintf(index, sizeof(index), ",%d", connection->index);
 
   g_snprintf(persist_name, sizeof(persist_name),
-             qfile ? "afsocket_dd_qfile(%s,%s)" : "afsocket_dd_connection(%s,%s)",
+             qfile ? "afsocket_dd_qfile(%s,%s%s)" : "afsocket_dd_connection(%s,%s%s)",
              (self->transport_mapper->sock_type == SOCK_STREAM) ? "stream" : "dgram",
-             afsocket_dd_get_dest_name(self));
+             afsocket_dd_get_dest_name(self), index);
   return persist_name;
 }
 
@@ -103,66 +140,80 @@ afsocket_dd_stats_instance(AFSocketDestDriver *self)
   return buf;
 }
 
-static gboolean afsocket_dd_connected(AFSocketDestDriver *self);
-static void afsocket_dd_reconnect(AFSocketDestDriver *self);
-static void afsocket_dd_try_connect(AFSocketDestDriver *self);
-static gboolean afsocket_dd_setup_connection(AFSocketDestDriver *self);
+static gboolean afsocket_dd_connected(AFSocketDestConnection *connection);
+static void afsocket_dd_reconnect(AFSocketDestConnection *connection);
+static void afsocket_dd_try_connect(AFSocketDestConnection *connection);
+static gboolean afsocket_dd_setup_connection(AFSocketDestConnection *connection);
 
 static void
-afsocket_dd_init_watches(AFSocketDestDriver *self)
+afsocket_dd_init_watches(AFSocketDestConnection *connection)
 {
-  IV_FD_INIT(&self->connect_fd);
-  self->connect_fd.cookie = self;
-  self->connect_fd.handler_out = (void (*)(void *)) afsocket_dd_connected;
+  IV_FD_INIT(&connection->connect_fd);
+  connection->connect_fd.cookie = connection;
+  connection->connect_fd.handler_out = (void (*)(void *)) afsocket_dd_connected;
 
-  IV_TIMER_INIT(&self->reconnect_timer);
-  self->reconnect_timer.cookie = self;
+  IV_TIMER_INIT(&connection->reconnect_timer);
+  connection->reconnect_timer.cookie = connection;
   /* Using reinit as a handler before establishing the first successful connection.
    * We'll change this to afsocket_dd_reconnect when the initialization of the
    * connection succeeds.*/
-  self->reconnect_timer.handler = (void (*)(void *)) afsocket_dd_try_connect;
+  connection->reconnect_timer.handler = (void (*)(void *)) afsocket_dd_try_connect;
 }
 
 static void
-afsocket_dd_start_watches(AFSocketDestDriver *self)
+afsocket_dd_start_watches(AFSocketDestConnection *connection)
 {
   main_loop_assert_main_thread();
 
-  self->connect_fd.fd = self->fd;
-  iv_fd_register(&self->connect_fd);
+  connection->connect_fd.fd = connection->fd;
+  iv_fd_register(&connection->connect_fd);
 }
 
 static void
-afsocket_dd_stop_watches(AFSocketDestDriver *self)
+afsocket_dd_stop_watches(AFSocketDestConnection *connection)
 {
   main_loop_assert_main_thread();
 
-  if (iv_fd_registered(&self->connect_fd))
+  if (iv_fd_registered(&connection->connect_fd))
     {
-      iv_fd_unregister(&self->connect_fd);
+      iv_fd_unregister(&connection->connect_fd);
 
       /* need to close the fd in this case as it wasn't established yet */
       msg_verbose("Closing connecting fd",
-                  evt_tag_int("fd", self->fd),
+                  evt_tag_int("fd", connection->fd),
                   NULL);
-      close(self->fd);
+      close(connection->fd);
     }
-  if (iv_timer_registered(&self->reconnect_timer))
-    iv_timer_unregister(&self->reconnect_timer);
+  if (iv_timer_registered(&connection->reconnect_timer))
+    iv_timer_unregister(&connection->reconnect_timer);
 }
 
+/* maximum multiplier of time_reopen() for connections failing repeatedly */
+#define AFSOCKET_DD_MAX_RECONNECT_BACKOFF_SHIFT 3
+
 static void
-afsocket_dd_start_reconnect_timer(AFSocketDestDriver *self)
+afsocket_dd_start_reconnect_timer(AFSocketDestConnection *connection)
 {
+  AFSocketDestDriver *self = connection->owner;
+  glong time_reopen_msec = self->time_reopen * 1000;
+
   main_loop_assert_main_thread();
 
-  if (iv_timer_registered(&self->reconnect_timer))
-    iv_timer_unregister(&self->reconnect_timer);
+  if (iv_timer_registered(&connection->reconnect_timer))
+    iv_timer_unregister(&connection->reconnect_timer);
   iv_validate_now();
 
-  self->reconnect_timer.expires = iv_now;
-  timespec_add_msec(&self->reconnect_timer.expires, self->time_reopen * 1000);
-  iv_timer_register(&self->reconnect_timer);
+  /* with multiple connections the others take over the load, so a
+   * failing one is retried less and less often */
+  if (self->num_connections > 1)
+    {
+      time_reopen_msec <<= MIN(connection->reconnect_failures, AFSOCKET_DD_MAX_RECONNECT_BACKOFF_SHIFT);
+      connection->reconnect_failures++;
+    }
+
+  connection->reconnect_timer.expires = iv_now;
+  timespec_add_msec(&connection->reconnect_timer.expires, time_reopen_msec);
+  iv_timer_register(&connection->reconnect_timer);
 }
 
 static LogTransport *
@@ -172,8 +223,9 @@ afsocket_dd_construct_transport(AFSocketDestDriver *self, gint fd)
 }
 
 static gboolean
-afsocket_dd_connected(AFSocketDestDriver *self)
+afsocket_dd_connected(AFSocketDestConnection *connection)
 {
+  AFSocketDestDriver *self = connection->owner;
   gchar buf1[256], buf2[256];
   int error = 0;
   socklen_t errorlen = sizeof(error);
@@ -182,15 +234,15 @@ afsocket_dd_connected(AFSocketDestDriver *self)
 
   main_loop_assert_main_thread();
 
-  if (iv_fd_registered(&self->connect_fd))
-    iv_fd_unregister(&self->connect_fd);
+  if (iv_fd_registered(&connection->connect_fd))
+    iv_fd_unregister(&connection->connect_fd);
 
   if (self->transport_mapper->sock_type == SOCK_STREAM)
     {
-      if (getsockopt(self->fd, SOL_SOCKET, SO_ERROR, &error, &errorlen) == -1)
+      if (getsockopt(connection->fd, SOL_SOCKET, SO_ERROR, &error, &errorlen) == -1)
         {
           msg_error("getsockopt(SOL_SOCKET, SO_ERROR) failed for connecting socket",
-                    evt_tag_int("fd", self->fd),
+                    evt_tag_int("fd", connection->fd),
                     evt_tag_str("server", g_sockaddr_format(self->dest_addr, buf2, sizeof(buf2), GSA_FULL)),
                     evt_tag_errno(EVT_TAG_OSERROR, errno),
                     evt_tag_int("time_reopen", self->time_reopen),
@@ -200,7 +252,7 @@ afsocket_dd_connected(AFSocketDestDriver *self)
       if (error)
         {
           msg_error("Syslog connection failed",
-                    evt_tag_int("fd", self->fd),
+                    evt_tag_int("fd", connection->fd),
                     evt_tag_str("server", g_sockaddr_format(self->dest_addr, buf2, sizeof(buf2), GSA_FULL)),
                     evt_tag_errno(EVT_TAG_OSERROR, error),
                     evt_tag_int("time_reopen", self->time_reopen),
@@ -209,29 +261,31 @@ afsocket_dd_connected(AFSocketDestDriver *self)
         }
     }
   msg_notice("Syslog connection established",
-              evt_tag_int("fd", self->fd),
+              evt_tag_int("fd", connection->fd),
               evt_tag_str("server", g_sockaddr_format(self->dest_addr, buf2, sizeof(buf2), GSA_FULL)),
               evt_tag_str("local", g_sockaddr_format(self->bind_addr, buf1, sizeof(buf1), GSA_FULL)),
               NULL);
 
-  transport = afsocket_dd_construct_transport(self, self->fd);
+  transport = afsocket_dd_construct_transport(self, connection->fd);
   if (!transport)
     goto error_reconnect;
 
   proto = log_proto_client_factory_construct(self->proto_factory, transport, &self->writer_options.proto_options.super);
 
-  log_writer_reopen(self->writer, proto);
+  log_writer_reopen(connection->writer, proto);
+  connection->reconnect_failures = 0;
   return TRUE;
  error_reconnect:
-  close(self->fd);
-  self->fd = -1;
-  afsocket_dd_start_reconnect_timer(self);
+  close(connection->fd);
+  connection->fd = -1;
+  afsocket_dd_start_reconnect_timer(connection);
   return FALSE;
 }
 
 static gboolean
-afsocket_dd_start_connect(AFSocketDestDriver *self)
+afsocket_dd_start_connect(AFSocketDestConnection *connection)
 {
+  AFSocketDestDriver *self = connection->owner;
   int sock, rc;
   gchar buf1[MAX_SOCKADDR_STRING], buf2[MAX_SOCKADDR_STRING];
 
@@ -250,15 +304,15 @@ afsocket_dd_start_connect(AFSocketDestDriver *self)
   rc = g_connect(sock, self->dest_addr);
   if (rc == G_IO_STATUS_NORMAL)
     {
-      self->fd = sock;
-      afsocket_dd_connected(self);
+      connection->fd = sock;
+      afsocket_dd_connected(connection);
     }
   else if (rc == G_IO_STATUS_ERROR && errno == EINPROGRESS)
     {
       /* we must wait until connect succeeds */
 
-      self->fd = sock;
-      afsocket_dd_start_watches(self);
+      connection->fd = sock;
+      afsocket_dd_start_watches(connection);
     }
   else
     {
@@ -277,31 +331,35 @@ afsocket_dd_start_connect(AFSocketDestDriver *self)
 }
 
 static void
-afsocket_dd_reconnect(AFSocketDestDriver *self)
+afsocket_dd_reconnect(AFSocketDestConnection *connection)
 {
+  AFSocketDestDriver *self = connection->owner;
+
   if (!afsocket_dd_setup_addresses(self) ||
-      !afsocket_dd_start_connect(self))
+      !afsocket_dd_start_connect(connection))
     {
       msg_error("Initiating connection failed, reconnecting",
                 evt_tag_int("time_reopen", self->time_reopen),
                 NULL);
-      afsocket_dd_start_reconnect_timer(self);
+      afsocket_dd_start_reconnect_timer(connection);
     }
 }
 
 static void
-afsocket_dd_try_connect(AFSocketDestDriver *self)
+afsocket_dd_try_connect(AFSocketDestConnection *connection)
 {
+  AFSocketDestDriver *self = connection->owner;
+
   if (!afsocket_dd_setup_addresses(self) ||
-      !afsocket_dd_setup_connection(self))
+      !afsocket_dd_setup_connection(connection))
     {
       msg_error("Initiating connection failed, reconnecting",
                 evt_tag_int("time_reopen", self->time_reopen),
                 NULL);
-      afsocket_dd_start_reconnect_timer(self);
+      afsocket_dd_start_reconnect_timer(connection);
       return;
     }
-  self->reconnect_timer.handler = (void (*)(void *)) afsocket_dd_reconnect;
+  connection->reconnect_timer.handler = (void (*)(void *)) afsocket_dd_reconnect;
 }
 
 static gboolean
@@ -352,18 +410,19 @@ afsocket_dd_setup_addresses_method(AFSocketDestDriver *self)
 }
 
 static void
-afsocket_dd_restore_writer(AFSocketDestDriver *self)
+afsocket_dd_restore_writer(AFSocketDestConnection *connection)
 {
+  AFSocketDestDriver *self = connection->owner;
   GlobalConfig *cfg;
   ReloadStoreItem *item;
 
-  g_assert(self->writer == NULL);
+  g_assert(connection->writer == NULL);
 
   cfg = log_pipe_get_config(&self->super.super.super);
-  item = cfg_persist_config_fetch(cfg, afsocket_dd_format_persist_name(self, FALSE));
+  item = cfg_persist_config_fetch(cfg, afsocket_dd_format_persist_name(connection, FALSE));
 
   if (item && !_is_protocol_type_changed_during_reload(self, item))
-    self->writer = _reload_store_item_release_writer(item);
+    connection->writer = _reload_store_item_release_writer(item);
 
   _reload_store_item_free(item);
 }
@@ -381,46 +440,150 @@ afsocket_dd_construct_writer_method(AFSocketDestDriver *self)
 }
 
 static gboolean
-afsocket_dd_setup_writer(AFSocketDestDriver *self)
+afsocket_dd_setup_writer(AFSocketDestConnection *connection)
 {
-  afsocket_dd_restore_writer(self);
+  AFSocketDestDriver *self = connection->owner;
+
+  afsocket_dd_restore_writer(connection);
 
-  if (!self->writer)
+  if (!connection->writer)
     {
       /* NOTE: we open our writer with no fd, so we can send messages down there
        * even while the connection is not established */
 
-      self->writer = afsocket_dd_construct_writer(self);
+      connection->writer = afsocket_dd_construct_writer(self);
     }
-  log_writer_set_options(self->writer, &self->super.super.super,
+  log_writer_set_options(connection->writer, &self->super.super.super,
                          &self->writer_options,
                          STATS_LEVEL0,
                          self->transport_mapper->stats_source,
                          self->super.super.id,
                          afsocket_dd_stats_instance(self));
-  log_writer_set_queue(self->writer, log_dest_driver_acquire_queue(&self->super, afsocket_dd_format_persist_name(self, TRUE)));
+  log_writer_set_queue(connection->writer, log_dest_driver_acquire_queue(&self->super, afsocket_dd_format_persist_name(connection, TRUE)));
 
-  if (!log_pipe_init((LogPipe *) self->writer))
+  if (!log_pipe_init((LogPipe *) connection->writer))
     {
-      log_pipe_unref((LogPipe *) self->writer);
+      log_pipe_unref((LogPipe *) connection->writer);
+      connection->writer = NULL;
       return FALSE;
     }
+  return TRUE;
+}
+
+/*
+ * Without a connection_key, connections that are not established at the
+ * moment (e.g. broken and waiting for time-reopen()) are skipped, as long
+ * as there's at least one established connection.
+ */
+static AFSocketDestConnection *
+afsocket_dd_select_connection(AFSocketDestDriver *self)
+{
+  AFSocketDestConnection *connection, *best = NULL;
+  gint64 queued, best_queued = 0;
+  guint start;
+  gint i;
+
+  start = (guint) g_atomic_int_exchange_and_add(&self->next_connection, 1);
+  for (i = 0; i < self->num_connections; i++)
+    {
+      connection = &self->connections[(start + i) % self->num_connections];
+      if (!log_writer_opened(connection->writer))
+        continue;
+
+      if (self->load_balance == AFSOCKET_DD_LB_ROUND_ROBIN)
+        return connection;
+
+      queued = log_queue_get_length(log_writer_get_queue(connection->writer));
+      if (!best || queued < best_queued)
+        {
+          best = connection;
+          best_queued = queued;
+        }
+    }
 
-  log_pipe_append(&self->super.super.super, (LogPipe *) self->writer);
+  if (best)
+    return best;
+  return &self->connections[start % self->num_connections];
+}
+
+/*
+ * With connections(N), messages are distributed among the connections by
+ * this pipe. Messages with the same connection_key always go to the same
+ * connection, so their order is kept.
+ */
+static void
+afsocket_dd_dispatch(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options, gpointer user_data)
+{
+  AFSocketDestDriver *self = (AFSocketDestDriver *) user_data;
+  AFSocketDestConnection *connection;
+
+  if (self->connection_key)
+    {
+      GString *key = scratch_arena_gstring();
+
+      log_template_format(self->connection_key, msg, &self->writer_options.template_options, LTZ_SEND, 0, NULL, key);
+      connection = &self->connections[g_str_hash(key->str) % self->num_connections];
+    }
+  else
+    {
+      connection = afsocket_dd_select_connection(self);
+    }
+
+  log_pipe_queue((LogPipe *) connection->writer, msg, path_options);
+}
+
+static gboolean
+afsocket_dd_setup_writers(AFSocketDestDriver *self)
+{
+  gint i;
+
+  if (!self->connections)
+    {
+      self->connections = g_new0(AFSocketDestConnection, self->num_connections);
+      for (i = 0; i < self->num_connections; i++)
+        {
+          self->connections[i].owner = self;
+          self->connections[i].index = i;
+          self->connections[i].fd = -1;
+          afsocket_dd_init_watches(&self->connections[i]);
+        }
+    }
+
+  for (i = 0; i < self->num_connections; i++)
+    {
+      if (!afsocket_dd_setup_writer(&self->connections[i]))
+        return FALSE;
+    }
+
+  if (self->num_connections == 1)
+    {
+      log_pipe_append(&self->super.super.super, (LogPipe *) self->connections[0].writer);
+      return TRUE;
+    }
+
+  if (!self->dispatcher)
+    {
+      self->dispatcher = log_pipe_new(self->super.super.super.cfg);
+      self->dispatcher->queue = afsocket_dd_dispatch;
+      self->dispatcher->queue_data = self;
+    }
+  log_pipe_init(self->dispatcher);
+  log_pipe_append(&self->super.super.super, self->dispatcher);
   return TRUE;
 }
 
 static gboolean
-afsocket_dd_setup_connection(AFSocketDestDriver *self)
+afsocket_dd_setup_connection(AFSocketDestConnection *connection)
 {
+  AFSocketDestDriver *self = connection->owner;
   GlobalConfig *cfg = log_pipe_get_config(&self->super.super.super);
 
   self->time_reopen = cfg->time_reopen;
 
-  if (!log_writer_opened(self->writer))
-    afsocket_dd_reconnect(self);
+  if (!log_writer_opened(connection->writer))
+    afsocket_dd_reconnect(connection);
 
-  self->connection_initialized = TRUE;
+  connection->connection_initialized = TRUE;
   return TRUE;
 }
 
@@ -428,6 +591,7 @@ gboolean
 afsocket_dd_init(LogPipe *s)
 {
   AFSocketDestDriver *self = (AFSocketDestDriver *) s;
+  gint i;
 
   if (!log_dest_driver_init_method(s) ||
       !afsocket_dd_setup_transport(self))
@@ -435,30 +599,32 @@ afsocket_dd_init(LogPipe *s)
       return FALSE;
     }
 
-  if (!afsocket_dd_setup_writer(self))
+  if (!afsocket_dd_setup_writers(self))
     return FALSE;
 
-  afsocket_dd_try_connect(self);
+  for (i = 0; i < self->num_connections; i++)
+    afsocket_dd_try_connect(&self->connections[i]);
   return TRUE;
 }
 
 static void
-afsocket_dd_stop_writer(AFSocketDestDriver *self)
+afsocket_dd_stop_writer(AFSocketDestConnection *connection)
 {
-  if (self->writer)
-    log_pipe_deinit((LogPipe *) self->writer);
+  if (connection->writer)
+    log_pipe_deinit((LogPipe *) connection->writer);
 }
 
 static void
-afsocket_dd_save_connection(AFSocketDestDriver *self)
+afsocket_dd_save_connection(AFSocketDestConnection *connection)
 {
+  AFSocketDestDriver *self = connection->owner;
   GlobalConfig *cfg = log_pipe_get_config(&self->super.super.super);
 
   if (self->connections_kept_alive_accross_reloads)
     {
-      ReloadStoreItem *item = _reload_store_item_new(self);
-      cfg_persist_config_add(cfg, afsocket_dd_format_persist_name(self, FALSE), item, (GDestroyNotify) _reload_store_item_free, FALSE);
-      self->writer = NULL;
+      ReloadStoreItem *item = _reload_store_item_new(connection);
+      cfg_persist_config_add(cfg, afsocket_dd_format_persist_name(connection, FALSE), item, (GDestroyNotify) _reload_store_item_free, FALSE);
+      connection->writer = NULL;
     }
 }
 
@@ -466,36 +632,63 @@ gboolean
 afsocket_dd_deinit(LogPipe *s)
 {
   AFSocketDestDriver *self = (AFSocketDestDriver *) s;
+  gint i;
 
-  afsocket_dd_stop_watches(self);
-  afsocket_dd_stop_writer(self);
+  if (self->dispatcher)
+    log_pipe_deinit(self->dispatcher);
 
-  if (self->connection_initialized)
+  for (i = 0; self->connections && i < self->num_connections; i++)
     {
-      afsocket_dd_save_connection(self);
+      AFSocketDestConnection *connection = &self->connections[i];
+
+      afsocket_dd_stop_watches(connection);
+      afsocket_dd_stop_writer(connection);
+
+      if (connection->connection_initialized)
+        {
+          afsocket_dd_save_connection(connection);
+        }
     }
 
   return log_dest_driver_deinit_method(s);
 }
 
+static AFSocketDestConnection *
+afsocket_dd_lookup_connection(AFSocketDestDriver *self, LogWriter *writer)
+{
+  gint i;
+
+  for (i = 0; i < self->num_connections; i++)
+    {
+      if (self->connections[i].writer == writer)
+        return &self->connections[i];
+    }
+  return NULL;
+}
+
 static void
 afsocket_dd_notify(LogPipe *s, gint notify_code, gpointer user_data)
 {
   AFSocketDestDriver *self = (AFSocketDestDriver *) s;
+  AFSocketDestConnection *connection;
   gchar buf[MAX_SOCKADDR_STRING];
 
   switch (notify_code)
     {
     case NC_CLOSE:
     case NC_WRITE_ERROR:
-      log_writer_reopen(self->writer, NULL);
+      connection = afsocket_dd_lookup_connection(self, (LogWriter *) user_data);
+      if (!connection)
+        break;
+
+      log_writer_reopen(connection->writer, NULL);
 
       msg_notice("Syslog connection broken",
-                 evt_tag_int("fd", self->fd),
+                 evt_tag_int("fd", connection->fd),
                  evt_tag_str("server", g_sockaddr_format(self->dest_addr, buf, sizeof(buf), GSA_FULL)),
                  evt_tag_int("time_reopen", self->time_reopen),
                  NULL);
-      afsocket_dd_start_reconnect_timer(self);
+      afsocket_dd_start_reconnect_timer(connection);
       break;
     }
 }
@@ -504,11 +697,16 @@ void
 afsocket_dd_free(LogPipe *s)
 {
   AFSocketDestDriver *self = (AFSocketDestDriver *) s;
+  gint i;
 
   log_writer_options_destroy(&self->writer_options);
   g_sockaddr_unref(self->bind_addr);
   g_sockaddr_unref(self->dest_addr);
-  log_pipe_unref((LogPipe *) self->writer);
+  for (i = 0; self->connections && i < self->num_connections; i++)
+    log_pipe_unref((LogPipe *) self->connections[i].writer);
+  g_free(self->connections);
+  log_pipe_unref(self->dispatcher);
+  log_template_unref(self->connection_key);
   transport_mapper_free(self->transport_mapper);
   socket_options_free(self->socket_options);
   log_dest_driver_free(s);
@@ -535,9 +733,9 @@ afsocket_dd_init_instance(AFSocketDestDriver *self,
   self->socket_options = socket_options;
   self->connections_kept_alive_accross_reloads = TRUE;
   self->time_reopen = cfg->time_reopen;
-  self->connection_initialized = FALSE;
+  self->num_connections = 1;
+  self->load_balance = AFSOCKET_DD_LB_ROUND_ROBIN;
 
 
   self->writer_options.mark_mode = MM_GLOBAL;
-  afsocket_dd_init_watches(self);
 }
@@ -33,6 +33,27 @@
 #include <iv.h>
 
 typedef struct _AFSocketDestDriver AFSocketDestDriver;
+typedef struct _AFSocketDestConnection AFSocketDestConnection;
+
+typedef enum
+{
+  AFSOCKET_DD_LB_ROUND_ROBIN,
+  AFSOCKET_DD_LB_LEAST_QUEUED,
+} AFSocketDestLoadBalance;
+
+/* a single connection of the destination, each has its own LogWriter & queue */
+struct _AFSocketDestConnection
+{
+  AFSocketDestDriver *owner;
+  gint index;
+  gint fd;
+  LogWriter *writer;
+  gboolean connection_initialized;
+  /* consecutive failed connection attempts, used for the reconnect backoff */
+  gint reconnect_failures;
+  struct iv_fd connect_fd;
+  struct iv_timer reconnect_timer;
+};
 
 struct _AFSocketDestDriver
 {
@@ -40,17 +61,20 @@ struct _AFSocketDestDriver
 
   gboolean
     connections_kept_alive_accross_reloads:1;
-  gint fd;
-  LogWriter *writer;
+  AFSocketDestConnection *connections;
+  gint num_connections;
+  /* selects the connection for a message if num_connections > 1,
+   * messages are distributed in a round-robin fashion if NULL */
+  LogTemplate *connection_key;
+  AFSocketDestLoadBalance load_balance;
+  gint next_connection;
+  LogPipe *dispatcher;
   LogWriterOptions writer_options;
   LogProtoClientFactory *proto_factory;
 
   GSockAddr *bind_addr;
   GSockAddr *dest_addr;
   gint time_reopen;
-  gboolean connection_initialized;
-  struct iv_fd connect_fd;
-  struct iv_timer reconnect_timer;
   SocketOptions *socket_options;
   TransportMapper *transport_mapper;
 
@@ -80,6 +104,9 @@ afsocket_dd_get_dest_name(AFSocketDestDriver *s)
 LogWriter *afsocket_dd_construct_writer_method(AFSocketDestDriver *self);
 gboolean afsocket_dd_setup_addresses_method(AFSocketDestDriver *self);
 void afsocket_dd_set_keep_alive(LogDriver *self, gint enable);
+void afsocket_dd_set_connections(LogDriver *self, gint connections);
+void afsocket_dd_set_connection_key(LogDriver *self, LogTemplate *connection_key);
+gboolean afsocket_dd_set_load_balance(LogDriver *self, const gchar *load_balance);
 void afsocket_dd_init_instance(AFSocketDestDriver *self, SocketOptions *socket_options, TransportMapper *transport_mapper, GlobalConfig *cfg);
 LogTransport *afsocket_dd_construct_transport_method(AFSocketDestDriver *self, gint fd);
 
@@ -72,8 +72,15 @@ static CfgLexerKeyword afsocket_keywords[] = {
   { "spoof_source",       KW_SPOOF_SOURCE },
   { "transport",          KW_TRANSPORT },
   { "ip_protocol",        KW_IP_PROTOCOL },
+  { "compression",        KW_COMPRESSION },
+  { "zerocopy",           KW_ZEROCOPY },
   { "max_connections",    KW_MAX_CONNECTIONS },
+  { "listen_shards",      KW_LISTEN_SHARDS },
+  { "accept_rate",        KW_ACCEPT_RATE },
   { "keep_alive",         KW_KEEP_ALIVE },
+  { "connections",        KW_CONNECTIONS },
+  { "connection_key",     KW_CONNECTION_KEY },
+  { "load_balance",       KW_LOAD_BALANCE },
   { "systemd_syslog",     KW_SYSTEMD_SYSLOG  },
   { NULL }
 };
@@ -28,6 +28,7 @@
 #include "stats/stats-registry.h"
 #include "mainloop.h"
 #include "poll-fd-events.h"
+#include "timeutils.h"
 
 #include <string.h>
 #include <sys/types.h>
@@ -252,6 +253,22 @@ afsocket_sd_set_max_connections(LogDriver *s, gint max_connections)
   self->max_connections = max_connections;
 }
 
+void
+afsocket_sd_set_listen_shards(LogDriver *s, gint listen_shards)
+{
+  AFSocketSourceDriver *self = (AFSocketSourceDriver *) s;
+
+  self->listen_shards = listen_shards;
+}
+
+void
+afsocket_sd_set_accept_rate(LogDriver *s, gint accept_rate)
+{
+  AFSocketSourceDriver *self = (AFSocketSourceDriver *) s;
+
+  self->accept_rate = accept_rate;
+}
+
 static inline gchar *
 afsocket_sd_format_persist_name(AFSocketSourceDriver *self, gboolean listener_name)
 {
@@ -265,6 +282,20 @@ afsocket_sd_format_persist_name(AFSocketSourceDriver *self, gboolean listener_na
   return persist_name;
 }
 
+/* the first shard uses the same name as a non-sharded listener */
+static inline gchar *
+afsocket_sd_format_listener_persist_name(AFSocketSourceDriver *self, gint shard)
+{
+  static gchar persist_name[160];
+  gchar *name = afsocket_sd_format_persist_name(self, TRUE);
+
+  if (shard == 0)
+    return name;
+
+  g_snprintf(persist_name, sizeof(persist_name), "%s,%d", name, shard);
+  return persist_name;
+}
+
 static gboolean
 afsocket_sd_process_connection(AFSocketSourceDriver *self, GSockAddr *client_addr, GSockAddr *local_addr, gint fd)
 {
@@ -293,7 +324,7 @@ afsocket_sd_process_connection(AFSocketSourceDriver *self, GSockAddr *client_add
 
 #endif
 
-  if (self->num_connections >= self->max_connections)
+  if (self->transport_mapper->sock_type == SOCK_STREAM && self->num_connections >= self->max_connections)
     {
       msg_error("Number of allowed concurrent connections reached, rejecting connection",
                 evt_tag_str("client", g_sockaddr_format(client_addr, buf, sizeof(buf), GSA_FULL)),
@@ -325,10 +356,66 @@ afsocket_sd_process_connection(AFSocketSourceDriver *self, GSockAddr *client_add
 
 #define MAX_ACCEPTS_AT_A_TIME 30
 
+/*
+ * accept-rate() limits the number of connections accepted per second, so
+ * that a reconnect storm of thousands of clients does not monopolize the
+ * main loop setting up readers: once the limit is reached, the listeners
+ * are taken out of the poll set until the next one second window starts,
+ * pending clients wait in the listen backlog meanwhile.
+ */
+static gboolean
+afsocket_sd_accept_rate_exceeded(AFSocketSourceDriver *self)
+{
+  if (self->accept_rate <= 0)
+    return FALSE;
+
+  iv_validate_now();
+  if (timespec_diff_msec(&iv_now, &self->accept_window_start) >= 1000)
+    {
+      self->accept_window_start = iv_now;
+      self->accepts_in_window = 0;
+    }
+  return self->accepts_in_window >= self->accept_rate;
+}
+
 static void
-afsocket_sd_accept(gpointer s)
+afsocket_sd_pause_accepting(AFSocketSourceDriver *self)
+{
+  gint i;
+
+  msg_debug("Accept rate limit reached, pausing accepting new connections",
+            evt_tag_int("accept_rate", self->accept_rate),
+            NULL);
+
+  for (i = 0; i < self->num_listeners; i++)
+    {
+      if (iv_fd_registered(&self->listeners[i].listen_fd))
+        iv_fd_unregister(&self->listeners[i].listen_fd);
+    }
+
+  self->accept_resume_timer.expires = self->accept_window_start;
+  timespec_add_msec(&self->accept_resume_timer.expires, 1000);
+  iv_timer_register(&self->accept_resume_timer);
+}
+
+static void
+afsocket_sd_resume_accepting(gpointer s)
 {
   AFSocketSourceDriver *self = (AFSocketSourceDriver *) s;
+  gint i;
+
+  for (i = 0; i < self->num_listeners; i++)
+    {
+      if (!iv_fd_registered(&self->listeners[i].listen_fd))
+        iv_fd_register(&self->listeners[i].listen_fd);
+    }
+}
+
+static void
+afsocket_sd_accept(gpointer s)
+{
+  AFSocketSourceListener *listener = (AFSocketSourceListener *) s;
+  AFSocketSourceDriver *self = listener->owner;
   GSockAddr *peer_addr;
   gchar buf1[256], buf2[256];
   gint new_fd;
@@ -339,7 +426,13 @@ afsocket_sd_accept(gpointer s)
     {
       GIOStatus status;
 
-      status = g_accept(self->fd, &new_fd, &peer_addr);
+      if (afsocket_sd_accept_rate_exceeded(self))
+        {
+          afsocket_sd_pause_accepting(self);
+          break;
+        }
+
+      status = g_accept_nonblock(listener->fd, &new_fd, &peer_addr);
       if (status == G_IO_STATUS_AGAIN)
         {
           /* no more connections to accept */
@@ -353,9 +446,7 @@ afsocket_sd_accept(gpointer s)
           return;
         }
 
-      g_fd_set_nonblock(new_fd, TRUE);
-      g_fd_set_cloexec(new_fd, TRUE);
-
+      self->accepts_in_window++;
       res = afsocket_sd_process_connection(self, peer_addr, self->bind_addr, new_fd);
 
       if (res)
@@ -410,18 +501,32 @@ afsocket_sd_close_connection(AFSocketSourceDriver *self, AFSocketSourceConnectio
 static void
 afsocket_sd_start_watches(AFSocketSourceDriver *self)
 {
-  IV_FD_INIT(&self->listen_fd);
-  self->listen_fd.fd = self->fd;
-  self->listen_fd.cookie = self;
-  self->listen_fd.handler_in = afsocket_sd_accept;
-  iv_fd_register(&self->listen_fd);
+  AFSocketSourceListener *listener;
+  gint i;
+
+  for (i = 0; i < self->num_listeners; i++)
+    {
+      listener = &self->listeners[i];
+      IV_FD_INIT(&listener->listen_fd);
+      listener->listen_fd.fd = listener->fd;
+      listener->listen_fd.cookie = listener;
+      listener->listen_fd.handler_in = afsocket_sd_accept;
+      iv_fd_register(&listener->listen_fd);
+    }
 }
 
 static void
 afsocket_sd_stop_watches(AFSocketSourceDriver *self)
 {
-  if (iv_fd_registered (&self->listen_fd))
-    iv_fd_unregister(&self->listen_fd);
+  gint i;
+
+  for (i = 0; i < self->num_listeners; i++)
+    {
+      if (iv_fd_registered (&self->listeners[i].listen_fd))
+        iv_fd_unregister(&self->listeners[i].listen_fd);
+    }
+  if (iv_timer_registered(&self->accept_resume_timer))
+    iv_timer_unregister(&self->accept_resume_timer);
 }
 
 static gboolean
@@ -504,62 +609,167 @@ afsocket_sd_restore_kept_alive_connections(AFSocketSourceDriver *self)
   return TRUE;
 }
 
+/*
+ * With listen-shards(N), N sockets are bound to the same address with
+ * SO_REUSEPORT and the kernel spreads the incoming load between them: for
+ * stream sockets the new connections, for datagram sockets the datagrams,
+ * each datagram socket having its own LogReader, running in parallel in
+ * the worker threads.
+ *
+ * NOTE: when the number of shards is increased, the listeners kept alive
+ * from the previous configuration were bound without SO_REUSEPORT, a
+ * restart is needed in that case.
+ */
+static gint
+afsocket_sd_get_shard_count(AFSocketSourceDriver *self)
+{
+  if (self->listen_shards <= 1)
+    return 1;
+
+#ifndef SO_REUSEPORT
+  msg_warning("WARNING: listen-shards() is not supported on this platform, using a single socket",
+              evt_tag_int("listen_shards", self->listen_shards),
+              NULL);
+  return 1;
+#else
+  return self->listen_shards;
+#endif
+}
+
+static gint
+afsocket_sd_limit_shards_of_acquired_socket(AFSocketSourceDriver *self, gint num_shards)
+{
+  if (num_shards > 1)
+    msg_warning("WARNING: listen-shards() is ignored for sockets acquired from the environment",
+                evt_tag_int("listen_shards", self->listen_shards),
+                NULL);
+  return 1;
+}
+
+static void
+afsocket_sd_close_listeners(AFSocketSourceDriver *self)
+{
+  gint i;
+
+  for (i = 0; i < self->num_listeners; i++)
+    close(self->listeners[i].fd);
+  g_free(self->listeners);
+  self->listeners = NULL;
+  self->num_listeners = 0;
+}
+
 static gboolean
-afsocket_sd_open_listener(AFSocketSourceDriver *self)
+afsocket_sd_open_stream_listener(AFSocketSourceDriver *self, gint shard, gint *fd, gboolean *acquired)
 {
   GlobalConfig *cfg = log_pipe_get_config(&self->super.super.super);
-  gint sock;
-  gboolean res = FALSE;
+  gint sock = -1;
 
-  /* ok, we have connection list, check if we need to open a listener */
-  sock = -1;
-  if (self->transport_mapper->sock_type == SOCK_STREAM)
+  *fd = -1;
+  if (self->connections_kept_alive_accross_reloads)
     {
-      if (self->connections_kept_alive_accross_reloads)
-        {
-          /* NOTE: this assumes that fd 0 will never be used for listening fds,
-           * main.c opens fd 0 so this assumption can hold */
-          sock = GPOINTER_TO_UINT(cfg_persist_config_fetch(cfg, afsocket_sd_format_persist_name(self, TRUE))) - 1;
-        }
-
-      if (sock == -1)
-        {
-          if (!afsocket_sd_acquire_socket(self, &sock))
-            return self->super.super.optional;
-          if (sock == -1 && !transport_mapper_open_socket(self->transport_mapper, self->socket_options, self->bind_addr, AFSOCKET_DIR_RECV, &sock))
-            return self->super.super.optional;
-        }
+      /* NOTE: this assumes that fd 0 will never be used for listening fds,
+       * main.c opens fd 0 so this assumption can hold */
+      sock = GPOINTER_TO_UINT(cfg_persist_config_fetch(cfg, afsocket_sd_format_listener_persist_name(self, shard))) - 1;
+    }
 
-      /* set up listening source */
-      if (listen(sock, self->listen_backlog) < 0)
-        {
-          msg_error("Error during listen()",
-                    evt_tag_errno(EVT_TAG_OSERROR, errno),
-                    NULL);
-          close(sock);
-          return FALSE;
-        }
+  if (sock == -1 && shard == 0)
+    {
+      if (!afsocket_sd_acquire_socket(self, &sock))
+        return self->super.super.optional;
+      *acquired = (sock != -1);
+    }
+  if (sock == -1 && !transport_mapper_open_socket(self->transport_mapper, self->socket_options, self->bind_addr, AFSOCKET_DIR_RECV, &sock))
+    return self->super.super.optional;
 
-      self->fd = sock;
-      afsocket_sd_start_watches(self);
-      res = TRUE;
+  /* set up listening source */
+  if (listen(sock, self->listen_backlog) < 0)
+    {
+      msg_error("Error during listen()",
+                evt_tag_errno(EVT_TAG_OSERROR, errno),
+                NULL);
+      close(sock);
+      return FALSE;
     }
-  else
+  *fd = sock;
+  return TRUE;
+}
+
+static gboolean
+afsocket_sd_open_stream_listeners(AFSocketSourceDriver *self)
+{
+  gboolean acquired = FALSE;
+  gint num_shards, fd, i;
+
+  num_shards = afsocket_sd_get_shard_count(self);
+  self->transport_mapper->reuse_port = (num_shards > 1);
+  self->listeners = g_new0(AFSocketSourceListener, num_shards);
+
+  for (i = 0; i < num_shards; i++)
     {
-      if (!self->connections)
+      gboolean success = afsocket_sd_open_stream_listener(self, i, &fd, &acquired);
+
+      if (!success || fd == -1)
         {
-          if (!afsocket_sd_acquire_socket(self, &sock))
-            return self->super.super.optional;
-          if (sock == -1 && !transport_mapper_open_socket(self->transport_mapper, self->socket_options, self->bind_addr, AFSOCKET_DIR_RECV, &sock))
-            return self->super.super.optional;
+          /* the error is already logged, go on with the shards we have */
+          if (i > 0)
+            break;
+
+          /* fd == -1 with success means an optional() source */
+          afsocket_sd_close_listeners(self);
+          return success;
         }
-      self->fd = -1;
 
-      /* we either have self->connections != NULL, or sock contains a new fd */
-      if (self->connections || afsocket_sd_process_connection(self, NULL, self->bind_addr, sock))
-        res = TRUE;
+      self->listeners[i].owner = self;
+      self->listeners[i].fd = fd;
+      self->num_listeners++;
+
+      if (acquired)
+        num_shards = afsocket_sd_limit_shards_of_acquired_socket(self, num_shards);
     }
-  return res;
+
+  afsocket_sd_start_watches(self);
+  return TRUE;
+}
+
+static gboolean
+afsocket_sd_open_dgram_listeners(AFSocketSourceDriver *self)
+{
+  gint sock, num_shards, i;
+
+  /* restored from the previous configuration */
+  if (self->connections)
+    return TRUE;
+
+  if (!afsocket_sd_acquire_socket(self, &sock))
+    return self->super.super.optional;
+
+  num_shards = afsocket_sd_get_shard_count(self);
+  if (sock != -1)
+    num_shards = afsocket_sd_limit_shards_of_acquired_socket(self, num_shards);
+  self->transport_mapper->reuse_port = (num_shards > 1);
+
+  for (i = 0; i < num_shards; i++)
+    {
+      if (i > 0)
+        sock = -1;
+      /* as with stream sockets, go on with the shards we have if a later one fails */
+      if (sock == -1 && !transport_mapper_open_socket(self->transport_mapper, self->socket_options, self->bind_addr, AFSOCKET_DIR_RECV, &sock))
+        return i > 0 || self->super.super.optional;
+
+      if (!afsocket_sd_process_connection(self, NULL, self->bind_addr, sock))
+        return i > 0;
+    }
+  return TRUE;
+}
+
+static gboolean
+afsocket_sd_open_listener(AFSocketSourceDriver *self)
+{
+  /* ok, we have connection list, check if we need to open a listener */
+  if (self->transport_mapper->sock_type == SOCK_STREAM)
+    return afsocket_sd_open_stream_listeners(self);
+  else
+    return afsocket_sd_open_dgram_listeners(self);
 }
 
 static void
@@ -599,23 +809,32 @@ afsocket_sd_save_listener(AFSocketSourceDriver *self)
 {
   GlobalConfig *cfg = log_pipe_get_config(&self->super.super.super);
 
+  gint i;
+
   if (self->transport_mapper->sock_type == SOCK_STREAM)
     {
       afsocket_sd_stop_watches(self);
-      if (!self->connections_kept_alive_accross_reloads)
-        {
-          msg_verbose("Closing listener fd",
-                      evt_tag_int("fd", self->fd),
-                      NULL);
-          close(self->fd);
-        }
-      else
+      for (i = 0; i < self->num_listeners; i++)
         {
-          /* NOTE: the fd is incremented by one when added to persistent config
-           * as persist config cannot store NULL */
+          if (!self->connections_kept_alive_accross_reloads)
+            {
+              msg_verbose("Closing listener fd",
+                          evt_tag_int("fd", self->listeners[i].fd),
+                          NULL);
+              close(self->listeners[i].fd);
+            }
+          else
+            {
+              /* NOTE: the fd is incremented by one when added to persistent config
+               * as persist config cannot store NULL */
 
-          cfg_persist_config_add(cfg, afsocket_sd_format_persist_name(self, TRUE), GUINT_TO_POINTER(self->fd + 1), afsocket_sd_close_fd, FALSE);
+              cfg_persist_config_add(cfg, afsocket_sd_format_listener_persist_name(self, i),
+                                     GUINT_TO_POINTER(self->listeners[i].fd + 1), afsocket_sd_close_fd, FALSE);
+            }
         }
+      g_free(self->listeners);
+      self->listeners = NULL;
+      self->num_listeners = 0;
     }
 }
 
@@ -692,7 +911,11 @@ afsocket_sd_init_instance(AFSocketSourceDriver *self,
   self->socket_options = socket_options;
   self->transport_mapper = transport_mapper;
   self->max_connections = 10;
+  self->listen_shards = 1;
   self->listen_backlog = 255;
+  IV_TIMER_INIT(&self->accept_resume_timer);
+  self->accept_resume_timer.cookie = self;
+  self->accept_resume_timer.handler = afsocket_sd_resume_accepting;
   self->connections_kept_alive_accross_reloads = TRUE;
   log_reader_options_defaults(&self->reader_options);
 
@@ -36,6 +36,13 @@
 
 typedef struct _AFSocketSourceDriver AFSocketSourceDriver;
 
+typedef struct _AFSocketSourceListener
+{
+  AFSocketSourceDriver *owner;
+  struct iv_fd listen_fd;
+  gint fd;
+} AFSocketSourceListener;
+
 struct _AFSocketSourceDriver
 {
   LogSrcDriver super;
@@ -43,13 +50,20 @@ struct _AFSocketSourceDriver
     connections_kept_alive_accross_reloads:1,
     require_tls:1,
     window_size_initialized:1;
-  struct iv_fd listen_fd;
-  gint fd;
+  /* one per listen-shards(), for stream sockets */
+  AFSocketSourceListener *listeners;
+  gint num_listeners;
+  gint listen_shards;
   LogReaderOptions reader_options;
   LogProtoServerFactory *proto_factory;
   GSockAddr *bind_addr;
   gint max_connections;
   gint num_connections;
+  /* accept-rate(): new connections per second, 0 means unlimited */
+  gint accept_rate;
+  gint accepts_in_window;
+  struct timespec accept_window_start;
+  struct iv_timer accept_resume_timer;
   gint listen_backlog;
   GList *connections;
   SocketOptions *socket_options;
@@ -73,6 +87,8 @@ struct _AFSocketSourceDriver
 
 void afsocket_sd_set_keep_alive(LogDriver *self, gint enable);
 void afsocket_sd_set_max_connections(LogDriver *self, gint max_connections);
+void afsocket_sd_set_listen_shards(LogDriver *self, gint listen_shards);
+void afsocket_sd_set_accept_rate(LogDriver *self, gint accept_rate);
 
 static inline gboolean
 afsocket_sd_acquire_socket(AFSocketSourceDriver *s, gint *fd)
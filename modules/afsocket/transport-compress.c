@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "transport-compress.h"
+#include "messages.h"
+
+#include <errno.h>
+
+#if SYSLOG_NG_HAVE_ZLIB
+
+#include <zlib.h>
+
+/*
+ * Streaming compression transport
+ *
+ * Wraps another (stream) transport and runs everything written through a
+ * single deflate stream, and everything read through a single inflate
+ * stream, for the lifetime of the connection.
+ *
+ * Each write()/writev() call ends with a Z_SYNC_FLUSH, so the flush
+ * granularity is determined by the LogProto on top of us, e.g. with
+ * batch-lines()/batch-bytes() a whole batch is compressed together.
+ *
+ * Just like libssl, a write that fails with EAGAIN has to be retried with
+ * the same data: the compressed form of it is kept here and the retry
+ * only drains that, returning the length of the data originally passed
+ * in.  The LogProto implementations already behave this way because of
+ * the TLS transport.
+ */
+
+#define COMPRESS_READ_BUFFER_SIZE  16384
+#define COMPRESS_MIN_OUTPUT_SPACE  64
+
+typedef struct _LogTransportCompress
+{
+  LogTransport super;
+  LogTransport *transport;
+
+  z_stream deflate_stream;
+  gboolean deflate_initialized;
+  guchar *out_buf;
+  gsize out_size, out_len, out_pos;
+  /* number of uncompressed bytes out_buf corresponds to */
+  gsize out_consumed;
+
+  z_stream inflate_stream;
+  gboolean inflate_initialized;
+  /* inflate() filled the caller's buffer, it may hold more output */
+  gboolean inflate_output_pending;
+  guchar in_buf[COMPRESS_READ_BUFFER_SIZE];
+} LogTransportCompress;
+
+static void
+log_transport_compress_report_error(LogTransportCompress *self, const gchar *msg, z_stream *stream, gint rc)
+{
+  msg_error(msg,
+            evt_tag_int("fd", self->super.fd),
+            evt_tag_str("error", stream->msg ? stream->msg : zError(rc)),
+            NULL);
+}
+
+static gboolean
+log_transport_compress_drain_output(LogTransportCompress *self)
+{
+  gssize rc;
+
+  while (self->out_pos < self->out_len)
+    {
+      rc = log_transport_write(self->transport, self->out_buf + self->out_pos, self->out_len - self->out_pos);
+      self->super.cond = self->transport->cond;
+      if (rc < 0)
+        return FALSE;
+      if (rc == 0)
+        {
+          errno = EAGAIN;
+          return FALSE;
+        }
+      self->out_pos += rc;
+    }
+  return TRUE;
+}
+
+static gboolean
+log_transport_compress_deflate(LogTransportCompress *self, const struct iovec *iov, gint iov_count)
+{
+  z_stream *stream = &self->deflate_stream;
+  gint i, rc;
+
+  if (!self->deflate_initialized)
+    {
+      rc = deflateInit(stream, Z_DEFAULT_COMPRESSION);
+      if (rc != Z_OK)
+        {
+          log_transport_compress_report_error(self, "Error initializing compression", stream, rc);
+          return FALSE;
+        }
+      self->deflate_initialized = TRUE;
+    }
+
+  self->out_len = self->out_pos = 0;
+  self->out_consumed = 0;
+  for (i = 0; i < iov_count; i++)
+    {
+      stream->next_in = (Bytef *) iov[i].iov_base;
+      stream->avail_in = iov[i].iov_len;
+      self->out_consumed += iov[i].iov_len;
+
+      do
+        {
+          if (self->out_size - self->out_len < COMPRESS_MIN_OUTPUT_SPACE)
+            {
+              self->out_size = MAX(self->out_size * 2, COMPRESS_READ_BUFFER_SIZE);
+              self->out_buf = g_realloc(self->out_buf, self->out_size);
+            }
+          stream->next_out = self->out_buf + self->out_len;
+          stream->avail_out = self->out_size - self->out_len;
+
+          rc = deflate(stream, i == iov_count - 1 ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+          self->out_len = self->out_size - stream->avail_out;
+          if (rc == Z_STREAM_ERROR)
+            {
+              log_transport_compress_report_error(self, "Error compressing outgoing data", stream, rc);
+              return FALSE;
+            }
+        }
+      while (stream->avail_in > 0 || stream->avail_out == 0);
+    }
+  return TRUE;
+}
+
+static gssize
+log_transport_compress_writev_method(LogTransport *s, const struct iovec *iov, gint iov_count)
+{
+  LogTransportCompress *self = (LogTransportCompress *) s;
+
+  /* a retry of a previous write, we already have its compressed form */
+  if (self->out_pos < self->out_len)
+    {
+      if (!log_transport_compress_drain_output(self))
+        return -1;
+      return self->out_consumed;
+    }
+
+  if (!log_transport_compress_deflate(self, iov, iov_count))
+    {
+      errno = EPIPE;
+      return -1;
+    }
+
+  if (!log_transport_compress_drain_output(self))
+    return -1;
+  return self->out_consumed;
+}
+
+static gssize
+log_transport_compress_write_method(LogTransport *s, const gpointer buf, gsize buflen)
+{
+  struct iovec iov;
+
+  iov.iov_base = buf;
+  iov.iov_len = buflen;
+  return log_transport_compress_writev_method(s, &iov, 1);
+}
+
+static gssize
+log_transport_compress_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
+{
+  LogTransportCompress *self = (LogTransportCompress *) s;
+  z_stream *stream = &self->inflate_stream;
+  gssize rc;
+  gint z_rc;
+
+  if (!self->inflate_initialized)
+    {
+      z_rc = inflateInit(stream);
+      if (z_rc != Z_OK)
+        {
+          log_transport_compress_report_error(self, "Error initializing decompression", stream, z_rc);
+          errno = ECONNRESET;
+          return -1;
+        }
+      self->inflate_initialized = TRUE;
+    }
+
+  while (1)
+    {
+      if (stream->avail_in > 0 || self->inflate_output_pending)
+        {
+          stream->next_out = buf;
+          stream->avail_out = buflen;
+
+          z_rc = inflate(stream, Z_SYNC_FLUSH);
+          if (z_rc == Z_STREAM_END)
+            return 0;
+          if (z_rc != Z_OK && z_rc != Z_BUF_ERROR)
+            {
+              log_transport_compress_report_error(self, "Error decompressing incoming data", stream, z_rc);
+              errno = ECONNRESET;
+              return -1;
+            }
+
+          self->inflate_output_pending = (stream->avail_out == 0);
+          if (stream->avail_out < buflen)
+            return buflen - stream->avail_out;
+        }
+
+      rc = log_transport_read(self->transport, self->in_buf, sizeof(self->in_buf), aux);
+      self->super.cond = self->transport->cond;
+      if (rc <= 0)
+        return rc;
+
+      stream->next_in = self->in_buf;
+      stream->avail_in = rc;
+    }
+}
+
+static void
+log_transport_compress_free_method(LogTransport *s)
+{
+  LogTransportCompress *self = (LogTransportCompress *) s;
+
+  if (self->deflate_initialized)
+    deflateEnd(&self->deflate_stream);
+  if (self->inflate_initialized)
+    inflateEnd(&self->inflate_stream);
+  g_free(self->out_buf);
+
+  /* the fd is owned and closed by the wrapped transport */
+  log_transport_free(self->transport);
+}
+
+LogTransport *
+log_transport_compress_new(LogTransport *transport)
+{
+  LogTransportCompress *self = g_new0(LogTransportCompress, 1);
+
+  log_transport_init_instance(&self->super, transport->fd);
+  self->super.cond = transport->cond;
+  self->super.read = log_transport_compress_read_method;
+  self->super.write = log_transport_compress_write_method;
+  self->super.writev = log_transport_compress_writev_method;
+  self->super.free_fn = log_transport_compress_free_method;
+  self->transport = transport;
+  return &self->super;
+}
+
+#else
+
+/* compression() is refused at config time, see transport_mapper_inet_set_compression() */
+LogTransport *
+log_transport_compress_new(LogTransport *transport)
+{
+  return transport;
+}
+
+#endif
@@ -26,12 +26,15 @@
 #include "messages.h"
 #include "stats/stats-registry.h"
 #include "transport/transport-tls.h"
+#include "transport/transport-socket.h"
+#include "transport-compress.h"
 
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <string.h>
+#include <errno.h>
 
 #define UDP_PORT                  514
 #define TCP_PORT                  514
@@ -80,15 +83,29 @@ transport_mapper_inet_apply_transport_method(TransportMapper *s, GlobalConfig *c
 
   if (!transport_mapper_apply_transport_method(s, cfg))
     return FALSE;
+
+  if (self->compress && self->super.sock_type != SOCK_STREAM)
+    {
+      msg_error("compression() is only supported for stream based transports",
+                evt_tag_str("transport", self->super.transport),
+                NULL);
+      return FALSE;
+    }
+
+  if (self->zerocopy && (self->super.sock_type != SOCK_STREAM || self->compress || self->tls_context))
+    {
+      msg_error("zerocopy() is only supported for plain stream based transports, without TLS or compression",
+                evt_tag_str("transport", self->super.transport),
+                NULL);
+      return FALSE;
+    }
   
   return transport_mapper_inet_validate_tls_options(self);
 }
 
 static LogTransport *
-transport_mapper_inet_construct_log_transport(TransportMapper *s, gint fd)
+transport_mapper_inet_construct_plain_log_transport(TransportMapperInet *self, gint fd)
 {
-  TransportMapperInet *self = (TransportMapperInet *) s;
-
   if (self->tls_context)
     {
       TLSSession *tls_session;
@@ -101,7 +118,51 @@ transport_mapper_inet_construct_log_transport(TransportMapper *s, gint fd)
       return log_transport_tls_new(tls_session, fd);
     }
   else
-    return transport_mapper_construct_log_transport_method(s, fd);
+    {
+      LogTransport *transport = transport_mapper_construct_log_transport_method(&self->super, fd);
+
+      if (self->zerocopy && !log_transport_stream_socket_enable_zerocopy(transport))
+        msg_warning("Error enabling zerocopy() on the socket, sending messages the usual way",
+                    evt_tag_int("fd", fd),
+                    evt_tag_errno(EVT_TAG_OSERROR, errno),
+                    NULL);
+      return transport;
+    }
+}
+
+static LogTransport *
+transport_mapper_inet_construct_log_transport(TransportMapper *s, gint fd)
+{
+  TransportMapperInet *self = (TransportMapperInet *) s;
+  LogTransport *transport;
+
+  transport = transport_mapper_inet_construct_plain_log_transport(self, fd);
+  if (transport && self->compress)
+    transport = log_transport_compress_new(transport);
+  return transport;
+}
+
+void
+transport_mapper_inet_set_compression(TransportMapper *s, gboolean compress)
+{
+  TransportMapperInet *self = (TransportMapperInet *) s;
+
+#if !SYSLOG_NG_HAVE_ZLIB
+  if (compress)
+    {
+      msg_warning("WARNING: compression() is not supported, syslog-ng was compiled without zlib support", NULL);
+      compress = FALSE;
+    }
+#endif
+  self->compress = compress;
+}
+
+void
+transport_mapper_inet_set_zerocopy(TransportMapper *s, gboolean zerocopy)
+{
+  TransportMapperInet *self = (TransportMapperInet *) s;
+
+  self->zerocopy = zerocopy;
 }
 
 void
@@ -37,6 +37,8 @@ typedef struct _TransportMapperInet
   TLSContext *tls_context;
   TLSSessionVerifyFunc tls_verify_callback;
   gpointer tls_verify_data;
+  gboolean compress;
+  gboolean zerocopy;
 } TransportMapperInet;
 
 static inline gint
@@ -61,6 +63,8 @@ transport_mapper_inet_set_tls_context(TransportMapperInet *self, TLSContext *tls
   self->tls_verify_data = tls_verify_data;
 }
 
+void transport_mapper_inet_set_compression(TransportMapper *s, gboolean compress);
+void transport_mapper_inet_set_zerocopy(TransportMapper *s, gboolean zerocopy);
 void transport_mapper_inet_init_instance(TransportMapperInet *self, const gchar *transport);
 TransportMapper *transport_mapper_tcp_new(void);
 TransportMapper *transport_mapper_tcp6_new(void);
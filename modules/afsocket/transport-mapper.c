@@ -30,6 +30,7 @@
 #include "transport/transport-socket.h"
 
 #include <errno.h>
+#include <sys/socket.h>
 #include <unistd.h>
 
 static gboolean
@@ -69,6 +70,21 @@ transport_mapper_open_socket(TransportMapper *self,
   g_fd_set_nonblock(sock, TRUE);
   g_fd_set_cloexec(sock, TRUE);
 
+#ifdef SO_REUSEPORT
+  if (self->reuse_port)
+    {
+      gint on = 1;
+
+      if (setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0)
+        {
+          msg_error("Error setting SO_REUSEPORT on socket",
+                    evt_tag_errno(EVT_TAG_OSERROR, errno),
+                    NULL);
+          goto error_close;
+        }
+    }
+#endif
+
   if (!transport_mapper_privileged_bind(sock, bind_addr))
     {
       gchar buf[256];
@@ -45,6 +45,9 @@ struct _TransportMapper
   const gchar *logproto;
   gint stats_source;
 
+  /* set SO_REUSEPORT before binding, so that multiple sockets can share the same address */
+  gboolean reuse_port;
+
   gboolean (*apply_transport)(TransportMapper *self, GlobalConfig *cfg);
   LogTransport *(*construct_log_transport)(TransportMapper *self, gint fd);
   void (*free_fn)(TransportMapper *self);
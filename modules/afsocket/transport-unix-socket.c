@@ -26,6 +26,7 @@
 #include "scratch-buffers.h"
 #include "str-format.h"
 #include "unix-credentials.h"
+#include "timeutils.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -34,6 +35,33 @@
 #include <errno.h>
 #include <unistd.h>
 
+/*
+ * Reading the process information of the sender from /proc takes four
+ * open()/read()/close() rounds for every message, while busy local
+ * sockets usually get their messages from a handful of processes.  The
+ * results are therefore cached per transport for a second, keyed by the
+ * pid: within that time a changed command line (exec) or a reused pid
+ * may be reported with the previous values.
+ */
+#define PROC_INFO_CACHE_SIZE 16
+#define PROC_INFO_CACHE_TTL  1
+
+typedef struct _ProcInfoCacheEntry
+{
+  pid_t pid;
+  time_t stamp;
+  /* name-value pairs in the LogTransportAuxData format */
+  gchar *aux_data;
+} ProcInfoCacheEntry;
+
+typedef struct _LogTransportUnixSocket
+{
+  LogTransportSocket super;
+  ProcInfoCacheEntry *proc_info_cache;
+} LogTransportUnixSocket;
+
+#define UNIX_SOCKET_CONTROL_BUFFER_SIZE 32
+
 static void
 _add_nv_pair_int(LogTransportAuxData *aux, const gchar *name, gint value)
 {
@@ -182,19 +210,65 @@ _feed_aux_from_procfs(LogTransportAuxData *aux, pid_t pid)
 }
 #endif
 
+#if defined(CRED_PASS_SUPPORTED)
+static void
+_add_nv_pairs_from_aux_data(LogTransportAuxData *aux, const gchar *aux_data)
+{
+  const gchar *p = aux_data;
+
+  while (*p)
+    {
+      const gchar *name = p;
+      const gchar *value = name + strlen(name) + 1;
+
+      log_transport_aux_data_add_nv_pair(aux, name, value);
+      p = value + strlen(value) + 1;
+    }
+}
+
+static void
+_feed_aux_from_procfs_cached(LogTransportUnixSocket *self, LogTransportAuxData *aux, pid_t pid)
+{
+  ProcInfoCacheEntry *entry;
+  time_t now = cached_g_current_time_sec();
+
+  if (!self->proc_info_cache)
+    self->proc_info_cache = g_new0(ProcInfoCacheEntry, PROC_INFO_CACHE_SIZE);
+
+  entry = &self->proc_info_cache[pid % PROC_INFO_CACHE_SIZE];
+  if (!entry->aux_data || entry->pid != pid || now - entry->stamp >= PROC_INFO_CACHE_TTL)
+    {
+      LogTransportAuxData procfs_aux;
+
+      log_transport_aux_data_init(&procfs_aux);
+      _feed_aux_from_procfs(&procfs_aux, pid);
+
+      g_free(entry->aux_data);
+      entry->aux_data = g_memdup(procfs_aux.data, procfs_aux.end_ptr + 1);
+      entry->pid = pid;
+      entry->stamp = now;
+    }
+  _add_nv_pairs_from_aux_data(aux, entry->aux_data);
+}
+#endif
+
 static void
-_feed_credentials_from_cmsg(LogTransportAuxData *aux, struct msghdr *msg)
+_feed_credentials_from_cmsg(LogTransportUnixSocket *self, LogTransportAuxData *aux, struct msghdr *msg)
 {
 #if defined(CRED_PASS_SUPPORTED)
   struct cmsghdr *cmsg;
 
+  /* nobody would look at the result */
+  if (!aux)
+    return;
+
   for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) 
     {
       if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_CREDENTIALS)
         {
           cred_t *uc = (cred_t *) CMSG_DATA(cmsg);
 
-          _feed_aux_from_procfs(aux, cred_get(uc, pid));
+          _feed_aux_from_procfs_cached(self, aux, cred_get(uc, pid));
           _feed_aux_from_ucred(aux, uc);
           break;
         }
@@ -203,20 +277,22 @@ _feed_credentials_from_cmsg(LogTransportAuxData *aux, struct msghdr *msg)
 }
 
 static void
-_feed_aux_from_cmsg(LogTransportAuxData *aux, struct msghdr *msg)
+_feed_aux_from_cmsg(LogTransportSocket *s, struct msghdr *msg, LogTransportAuxData *aux)
 {
-  _feed_credentials_from_cmsg(aux, msg);
+  LogTransportUnixSocket *self = (LogTransportUnixSocket *) s;
+
+  _feed_credentials_from_cmsg(self, aux, msg);
 }
 
 static gssize
-_unix_socket_read(gint fd, gpointer buf, gsize buflen, LogTransportAuxData *aux)
+_unix_socket_read(LogTransportSocket *self, gpointer buf, gsize buflen, LogTransportAuxData *aux)
 {
   gint rc;
   struct msghdr msg;
   struct iovec iov[1];
   struct sockaddr_storage ss;
 #if defined(SYSLOG_NG_HAVE_CTRLBUF_IN_MSGHDR)
-  gchar ctlbuf[32];
+  gchar ctlbuf[UNIX_SOCKET_CONTROL_BUFFER_SIZE];
   msg.msg_control = ctlbuf;
   msg.msg_controllen = sizeof(ctlbuf);
 #endif
@@ -231,7 +307,7 @@ _unix_socket_read(gint fd, gpointer buf, gsize buflen, LogTransportAuxData *aux)
   iov[0].iov_len = buflen;
   do
     {
-      rc = recvmsg(fd, &msg, 0);
+      rc = recvmsg(self->super.fd, &msg, 0);
     }
   while (rc == -1 && errno == EINTR);
 
@@ -240,18 +316,33 @@ _unix_socket_read(gint fd, gpointer buf, gsize buflen, LogTransportAuxData *aux)
       if (msg.msg_namelen && aux)
         log_transport_aux_data_set_peer_addr_ref(aux, g_sockaddr_new((struct sockaddr *) &ss, msg.msg_namelen));
         
-      _feed_aux_from_cmsg(aux, &msg);
+      _feed_aux_from_cmsg(self, &msg, aux);
     }
 
   return rc;
 }
 
+static void
+log_transport_unix_socket_free_method(LogTransport *s)
+{
+  LogTransportUnixSocket *self = (LogTransportUnixSocket *) s;
+  gint i;
+
+  if (self->proc_info_cache)
+    {
+      for (i = 0; i < PROC_INFO_CACHE_SIZE; i++)
+        g_free(self->proc_info_cache[i].aux_data);
+      g_free(self->proc_info_cache);
+    }
+}
+
+#ifndef SYSLOG_NG_HAVE_RECVMMSG
 static gssize
 log_transport_unix_dgram_socket_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
 {
   gint rc;
 
-  rc = _unix_socket_read(s->fd, buf, buflen, aux);
+  rc = _unix_socket_read((LogTransportSocket *) s, buf, buflen, aux);
   if (rc == 0)
     {
       /* DGRAM sockets should never return EOF, they just need to be read again */
@@ -260,31 +351,56 @@ log_transport_unix_dgram_socket_read_method(LogTransport *s, gpointer buf, gsize
     }
   return rc;
 }
+#endif
+
+static void
+log_transport_unix_dgram_socket_free_method(LogTransport *s)
+{
+  log_transport_unix_socket_free_method(s);
+  log_transport_dgram_socket_free_method(s);
+}
 
 LogTransport *
 log_transport_unix_dgram_socket_new(gint fd)
 {
-  LogTransportSocket *self = g_new0(LogTransportSocket, 1);
+  LogTransportUnixSocket *self = g_new0(LogTransportUnixSocket, 1);
 
-  log_transport_dgram_socket_init_instance(self, fd);
-  self->super.read = log_transport_unix_dgram_socket_read_method;
+  log_transport_dgram_socket_init_instance(&self->super, fd);
+#ifdef SYSLOG_NG_HAVE_RECVMMSG
+  /* the batched read method of dgram sockets hands us the ancillary data */
+#if defined(SYSLOG_NG_HAVE_CTRLBUF_IN_MSGHDR)
+  self->super.recv_control_size = UNIX_SOCKET_CONTROL_BUFFER_SIZE;
+#endif
+  self->super.process_recv_control = _feed_aux_from_cmsg;
+#else
+  self->super.super.read = log_transport_unix_dgram_socket_read_method;
+#endif
+  self->super.super.free_fn = log_transport_unix_dgram_socket_free_method;
 
-  return &self->super;
+  return &self->super.super;
 }
 
 static gssize
 log_transport_unix_stream_socket_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
 {
-  return _unix_socket_read(s->fd, buf, buflen, aux);
+  return _unix_socket_read((LogTransportSocket *) s, buf, buflen, aux);
+}
+
+static void
+log_transport_unix_stream_socket_free_method(LogTransport *s)
+{
+  log_transport_unix_socket_free_method(s);
+  log_transport_stream_socket_free_method(s);
 }
 
 LogTransport *
 log_transport_unix_stream_socket_new(gint fd)
 {
-  LogTransportSocket *self = g_new0(LogTransportSocket, 1);
+  LogTransportUnixSocket *self = g_new0(LogTransportUnixSocket, 1);
 
-  log_transport_stream_socket_init_instance(self, fd);
-  self->super.read = log_transport_unix_stream_socket_read_method;
+  log_transport_stream_socket_init_instance(&self->super, fd);
+  self->super.super.read = log_transport_unix_stream_socket_read_method;
+  self->super.super.free_fn = log_transport_unix_stream_socket_free_method;
 
-  return &self->super;
+  return &self->super.super;
 }
@@ -35,6 +35,7 @@ static CfgLexerKeyword afsql_keywords[] = {
   { "password",           KW_PASSWORD },
   { "database",           KW_DATABASE },
   { "table",              KW_TABLE },
+  { "table_cache_size",   KW_TABLE_CACHE_SIZE },
 
   { "columns",            KW_COLUMNS },
   { "indexes",            KW_INDEXES },
@@ -195,6 +195,14 @@ afsql_dd_set_flush_lines(LogDriver *s, gint flush_lines)
   self->flush_lines = flush_lines;
 }
 
+void
+afsql_dd_set_table_cache_size(LogDriver *s, gint table_cache_size)
+{
+  AFSqlDestDriver *self = (AFSqlDestDriver *) s;
+
+  self->table_cache_size = table_cache_size;
+}
+
 void
 afsql_dd_set_flush_timeout(LogDriver *s, gint flush_timeout)
 {
@@ -274,6 +282,7 @@ afsql_dd_handle_transaction_error(AFSqlDestDriver *self)
 {
   log_queue_rewind_backlog_all(self->queue);
   self->flush_lines_queued = 0;
+  afsql_dd_reset_multi_row_insert(self);
 }
 
 /**
@@ -291,6 +300,14 @@ afsql_dd_commit_transaction(AFSqlDestDriver *self)
  if (!self->transaction_active)
     return TRUE;
 
+  if (!afsql_dd_flush_multi_row_insert(self))
+    {
+      msg_error("SQL multi-row INSERT failed, rewinding backlog and starting again",
+                NULL);
+      afsql_dd_handle_transaction_error(self);
+      return FALSE;
+    }
+
   success = afsql_dd_run_query(self, "COMMIT", FALSE, NULL);
   if (success)
     {
@@ -343,6 +360,7 @@ afsql_dd_rollback_transaction(AFSqlDestDriver *self)
     return TRUE;
 
   self->transaction_active = FALSE;
+  afsql_dd_reset_multi_row_insert(self);
 
   return afsql_dd_run_query(self, "ROLLBACK", FALSE, NULL);
 }
@@ -450,16 +468,57 @@ afsql_dd_create_index(AFSqlDestDriver *self, const gchar *table, const gchar *co
   return success;
 }
 
+/*
+ * The validated tables are kept in an LRU cache of table_cache_size
+ * entries: syslogng_conform_tables maps the table name to its link in
+ * syslogng_conform_tables_lru, whose data is the key of the hash table.
+ * An evicted table is simply validated again when used next time.
+ */
 static inline gboolean
 _is_table_syslogng_conform(AFSqlDestDriver *self, const gchar *table)
 {
-  return (g_hash_table_lookup(self->syslogng_conform_tables, table) != NULL);
+  GList *link = g_hash_table_lookup(self->syslogng_conform_tables, table);
+
+  if (!link)
+    return FALSE;
+
+  if (link != self->syslogng_conform_tables_lru->head)
+    {
+      g_queue_unlink(self->syslogng_conform_tables_lru, link);
+      g_queue_push_head_link(self->syslogng_conform_tables_lru, link);
+    }
+  return TRUE;
 }
 
 static inline void
 _remember_table_as_syslogng_conform(AFSqlDestDriver *self, const gchar *table)
 {
-  g_hash_table_insert(self->syslogng_conform_tables, g_strdup(table), GUINT_TO_POINTER(TRUE));
+  GList *link;
+  gchar *key = g_strdup(table);
+
+  g_queue_push_head(self->syslogng_conform_tables_lru, key);
+  g_hash_table_insert(self->syslogng_conform_tables, key, self->syslogng_conform_tables_lru->head);
+
+  while (self->table_cache_size > 0 &&
+         g_queue_get_length(self->syslogng_conform_tables_lru) > (guint) self->table_cache_size)
+    {
+      link = g_queue_pop_tail_link(self->syslogng_conform_tables_lru);
+      msg_debug("Evicting table from the validated table cache",
+                evt_tag_str("table", link->data),
+                NULL);
+      g_hash_table_remove(self->syslogng_conform_tables, link->data);
+      g_list_free_1(link);
+    }
+}
+
+static void
+_forget_syslogng_conform_tables(AFSqlDestDriver *self)
+{
+  GList *link;
+
+  while ((link = g_queue_pop_head_link(self->syslogng_conform_tables_lru)))
+    g_list_free_1(link);
+  g_hash_table_remove_all(self->syslogng_conform_tables);
 }
 
 static gboolean
@@ -680,7 +739,8 @@ afsql_dd_disconnect(AFSqlDestDriver *self)
 {
   dbi_conn_close(self->dbi_ctx);
   self->dbi_ctx = NULL;
-  g_hash_table_remove_all(self->syslogng_conform_tables);
+  _forget_syslogng_conform_tables(self);
+  afsql_dd_reset_multi_row_insert(self);
 }
 
 static void
@@ -791,14 +851,12 @@ afsql_dd_ensure_accessible_database_table(AFSqlDestDriver *self, LogMessage *msg
   return table;
 }
 
-static GString *
-afsql_dd_build_insert_command(AFSqlDestDriver *self, LogMessage *msg, GString *table)
+static void
+afsql_dd_append_insert_columns(AFSqlDestDriver *self, GString *table, GString *insert_command)
 {
-  GString *insert_command = g_string_sized_new(256);
-  GString *value = g_string_sized_new(512);
   gint i, j;
 
-  g_string_printf(insert_command, "INSERT INTO %s (", table->str);
+  g_string_append_printf(insert_command, "INSERT INTO %s (", table->str);
 
   for (i = 0; i < self->fields_len; i++)
     {
@@ -815,7 +873,16 @@ afsql_dd_build_insert_command(AFSqlDestDriver *self, LogMessage *msg, GString *t
         }
     }
 
-  g_string_append(insert_command, ") VALUES (");
+  g_string_append(insert_command, ") VALUES ");
+}
+
+static void
+afsql_dd_append_insert_values(AFSqlDestDriver *self, LogMessage *msg, GString *insert_command)
+{
+  GString *value = g_string_sized_new(512);
+  gint i, j;
+
+  g_string_append(insert_command, "(");
 
   for (i = 0; i < self->fields_len; i++)
     {
@@ -853,10 +920,77 @@ afsql_dd_build_insert_command(AFSqlDestDriver *self, LogMessage *msg, GString *t
   g_string_append(insert_command, ")");
 
   g_string_free(value, TRUE);
+}
+
+static GString *
+afsql_dd_build_insert_command(AFSqlDestDriver *self, LogMessage *msg, GString *table)
+{
+  GString *insert_command = g_string_sized_new(256);
+
+  afsql_dd_append_insert_columns(self, table, insert_command);
+  afsql_dd_append_insert_values(self, msg, insert_command);
 
   return insert_command;
 }
 
+/*
+ * multi-row-inserts: the rows of a transaction are collected into a single
+ * INSERT INTO ... VALUES (...), (...) statement, which is sent before the
+ * COMMIT, or when the table of the next message differs.
+ */
+static inline gboolean
+afsql_dd_is_multi_row_insert_enabled(const AFSqlDestDriver *self)
+{
+  return self->flags & AFSQL_DDF_MULTI_ROW_INSERTS;
+}
+
+static void
+afsql_dd_reset_multi_row_insert(AFSqlDestDriver *self)
+{
+  if (!self->multi_row_insert)
+    return;
+
+  g_string_truncate(self->multi_row_insert, 0);
+  g_string_truncate(self->multi_row_table, 0);
+  self->multi_row_count = 0;
+}
+
+static void
+afsql_dd_append_multi_row_insert(AFSqlDestDriver *self, LogMessage *msg, GString *table)
+{
+  if (self->multi_row_count == 0)
+    {
+      g_string_assign(self->multi_row_table, table->str);
+      afsql_dd_append_insert_columns(self, table, self->multi_row_insert);
+    }
+  else
+    {
+      g_string_append(self->multi_row_insert, ", ");
+    }
+
+  afsql_dd_append_insert_values(self, msg, self->multi_row_insert);
+  self->multi_row_count++;
+}
+
+static gboolean
+afsql_dd_is_multi_row_insert_for_other_table(AFSqlDestDriver *self, GString *table)
+{
+  return self->multi_row_count > 0 && strcmp(self->multi_row_table->str, table->str) != 0;
+}
+
+static gboolean
+afsql_dd_flush_multi_row_insert(AFSqlDestDriver *self)
+{
+  gboolean success;
+
+  if (!afsql_dd_is_multi_row_insert_enabled(self) || self->multi_row_count == 0)
+    return TRUE;
+
+  success = afsql_dd_run_query(self, self->multi_row_insert->str, FALSE, NULL);
+  afsql_dd_reset_multi_row_insert(self);
+  return success;
+}
+
 static inline gboolean
 afsql_dd_is_transaction_handling_enabled(const AFSqlDestDriver *self)
 {
@@ -963,8 +1097,26 @@ afsql_dd_insert_db(AFSqlDestDriver *self)
       goto out;
     }
 
-  insert_command = afsql_dd_build_insert_command(self, msg, table);
-  success = afsql_dd_run_query(self, insert_command->str, FALSE, NULL);
+  if (afsql_dd_is_multi_row_insert_enabled(self))
+    {
+      /* rows going to different tables can't share a statement */
+      if (afsql_dd_is_multi_row_insert_for_other_table(self, table) && !afsql_dd_flush_multi_row_insert(self))
+        {
+          /* the rows sent so far are lost along with the transaction */
+          afsql_dd_handle_transaction_error(self);
+          afsql_dd_rollback_transaction(self);
+          success = FALSE;
+        }
+      else
+        {
+          afsql_dd_append_multi_row_insert(self, msg, table);
+        }
+    }
+  else
+    {
+      insert_command = afsql_dd_build_insert_command(self, msg, table);
+      success = afsql_dd_run_query(self, insert_command->str, FALSE, NULL);
+    }
 
   if (success && self->flush_lines_queued != -1)
     {
@@ -975,7 +1127,6 @@ afsql_dd_insert_db(AFSqlDestDriver *self)
           /* Assuming that in case of error, the queue is rewound by afsql_dd_commit_transaction() */
           afsql_dd_rollback_transaction(self);
 
-          g_string_free(insert_command, TRUE);
           msg_set_context(NULL);
 
           success = FALSE;
@@ -1095,11 +1246,13 @@ afsql_dd_database_thread(gpointer arg)
       if (self->db_thread_terminate)
         break;
 
+      main_loop_worker_busy_start();
       if (!afsql_dd_insert_db(self))
         {
           afsql_dd_disconnect(self);
           afsql_dd_suspend(self);
         }
+      main_loop_worker_busy_end();
     }
 
   while (log_queue_get_length(self->queue) > 0)
@@ -1217,6 +1370,11 @@ afsql_dd_init(LogPipe *s)
         log_queue_set_use_backlog(self->queue, TRUE);
     }
   log_queue_set_counters(self->queue, self->stored_messages, self->dropped_messages);
+
+  stats_lock();
+  log_queue_register_stats_counters(self->queue, 0, SCS_SQL | SCS_DESTINATION, self->super.super.id, afsql_dd_format_stats_instance(self));
+  stats_unlock();
+
   if (!self->fields)
     {
       GList *col, *value;
@@ -1295,6 +1453,29 @@ afsql_dd_init(LogPipe *s)
   if ((self->flags & AFSQL_DDF_EXPLICIT_COMMITS) && (self->flush_lines > 0 || self->flush_timeout > 0))
     self->flush_lines_queued = 0;
 
+  if (afsql_dd_is_multi_row_insert_enabled(self))
+    {
+      if (!afsql_dd_is_transaction_handling_enabled(self))
+        {
+          msg_warning("WARNING: The multi-row-inserts flag requires explicit-commits and flush-lines(), ignoring it",
+                      evt_tag_str("driver", self->super.super.id),
+                      NULL);
+          self->flags &= ~AFSQL_DDF_MULTI_ROW_INSERTS;
+        }
+      else if (strcmp(self->type, s_oracle) == 0)
+        {
+          msg_warning("WARNING: Oracle does not support multi-row INSERT statements, ignoring the multi-row-inserts flag",
+                      evt_tag_str("driver", self->super.super.id),
+                      NULL);
+          self->flags &= ~AFSQL_DDF_MULTI_ROW_INSERTS;
+        }
+      else if (!self->multi_row_insert)
+        {
+          self->multi_row_insert = g_string_sized_new(4096);
+          self->multi_row_table = g_string_sized_new(32);
+        }
+    }
+
   if (!dbi_initialized)
     {
       gint rc = dbi_initialize_r(NULL, &dbi_instance);
@@ -1328,6 +1509,7 @@ afsql_dd_init(LogPipe *s)
   stats_lock();
   stats_unregister_counter(SCS_SQL | SCS_DESTINATION, self->super.super.id, afsql_dd_format_stats_instance(self), SC_TYPE_STORED, &self->stored_messages);
   stats_unregister_counter(SCS_SQL | SCS_DESTINATION, self->super.super.id, afsql_dd_format_stats_instance(self), SC_TYPE_DROPPED, &self->dropped_messages);
+  log_queue_unregister_stats_counters(self->queue, SCS_SQL | SCS_DESTINATION, self->super.super.id, afsql_dd_format_stats_instance(self));
   stats_unlock();
 
   return FALSE;
@@ -1346,6 +1528,7 @@ afsql_dd_deinit(LogPipe *s)
   stats_lock();
   stats_unregister_counter(SCS_SQL | SCS_DESTINATION, self->super.super.id, afsql_dd_format_stats_instance(self), SC_TYPE_STORED, &self->stored_messages);
   stats_unregister_counter(SCS_SQL | SCS_DESTINATION, self->super.super.id, afsql_dd_format_stats_instance(self), SC_TYPE_DROPPED, &self->dropped_messages);
+  log_queue_unregister_stats_counters(self->queue, SCS_SQL | SCS_DESTINATION, self->super.super.id, afsql_dd_format_stats_instance(self));
   stats_unlock();
 
   if (!log_dest_driver_deinit_method(s))
@@ -1396,11 +1579,18 @@ afsql_dd_free(LogPipe *s)
   string_list_free(self->indexes);
   string_list_free(self->values);
   log_template_unref(self->table);
+  _forget_syslogng_conform_tables(self);
   g_hash_table_destroy(self->syslogng_conform_tables);
+  g_queue_free(self->syslogng_conform_tables_lru);
   g_hash_table_destroy(self->dbd_options);
   g_hash_table_destroy(self->dbd_options_numeric);
   if (self->session_statements)
     string_list_free(self->session_statements);
+  if (self->multi_row_insert)
+    {
+      g_string_free(self->multi_row_insert, TRUE);
+      g_string_free(self->multi_row_table, TRUE);
+    }
   g_mutex_free(self->db_thread_mutex);
   g_cond_free(self->db_thread_wakeup_cond);
   log_dest_driver_free(s);
@@ -1438,6 +1628,8 @@ afsql_dd_new(GlobalConfig *cfg)
   self->num_retries = MAX_FAILED_ATTEMPTS;
 
   self->syslogng_conform_tables = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  self->syslogng_conform_tables_lru = g_queue_new();
+  self->table_cache_size = AFSQL_TABLE_CACHE_SIZE_DEFAULT;
   self->dbd_options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
   self->dbd_options_numeric = g_hash_table_new_full(g_str_hash, g_int_equal, g_free, NULL);
 
@@ -1457,6 +1649,8 @@ afsql_dd_lookup_flag(const gchar *flag)
     return AFSQL_DDF_EXPLICIT_COMMITS;
   else if (strcmp(flag, "dont-create-tables") == 0 || strcmp(flag, "dont_create_tables") == 0)
     return AFSQL_DDF_DONT_CREATE_TABLES;
+  else if (strcmp(flag, "multi-row-inserts") == 0 || strcmp(flag, "multi_row_inserts") == 0)
+    return AFSQL_DDF_MULTI_ROW_INSERTS;
   else
     msg_warning("Unknown SQL flag",
                 evt_tag_str("flag", flag),
@@ -35,6 +35,8 @@ enum
   AFSQL_COLUMN_DEFAULT = 1,
 };
 
+#define AFSQL_TABLE_CACHE_SIZE_DEFAULT 1024
+
 /* field flags */
 enum
 {
@@ -46,6 +48,7 @@ enum
 {
   AFSQL_DDF_EXPLICIT_COMMITS = 0x0001,
   AFSQL_DDF_DONT_CREATE_TABLES = 0x0002,
+  AFSQL_DDF_MULTI_ROW_INSERTS = 0x0004,
 };
 
 typedef struct _AFSqlField
@@ -112,9 +115,15 @@ typedef struct _AFSqlDestDriver
   gint32 seq_num;
   dbi_conn dbi_ctx;
   GHashTable *syslogng_conform_tables;
+  GQueue *syslogng_conform_tables_lru;
+  gint table_cache_size;
   guint32 failed_message_counter;
   WorkerOptions worker_options;
   gboolean transaction_active;
+  /* the pending INSERT of the multi-row-inserts mode, and its table */
+  GString *multi_row_insert;
+  GString *multi_row_table;
+  gint multi_row_count;
 } AFSqlDestDriver;
 
 
@@ -133,6 +142,7 @@ void afsql_dd_set_indexes(LogDriver *s, GList *indexes);
 void afsql_dd_set_retries(LogDriver *s, gint num_retries);
 void afsql_dd_set_flush_lines(LogDriver *s, gint flush_lines);
 void afsql_dd_set_flush_timeout(LogDriver *s, gint flush_timeout);
+void afsql_dd_set_table_cache_size(LogDriver *s, gint table_cache_size);
 void afsql_dd_set_session_statements(LogDriver *s, GList *session_statements);
 void afsql_dd_set_flags(LogDriver *s, gint flags);
 LogDriver *afsql_dd_new(GlobalConfig *cfg);
@@ -57,6 +57,8 @@ typedef struct {
   ValuePairs *vp;
 
   stomp_connection *conn;
+  /* SEND frames waiting for their RECEIPT */
+  gint pending_receipts;
 } STOMPDestDriver;
 
 /*
@@ -215,7 +217,13 @@ afstomp_dd_connect(STOMPDestDriver *self, gboolean reconnect)
       return FALSE;
     }
 
-  stomp_receive_frame(self->conn, &frame);
+  if (!stomp_receive_frame(self->conn, &frame))
+    {
+      msg_error("Error connecting to STOMP server, no response to CONNECT request", NULL);
+      stomp_disconnect(&self->conn);
+      return FALSE;
+    }
+
   if (strcmp(frame.command, "CONNECTED"))
     {
       msg_debug("Error connecting to STOMP server, stomp server did not accept CONNECT request", NULL);
@@ -239,6 +247,7 @@ afstomp_dd_disconnect(LogThrDestDriver *s)
 
   stomp_disconnect(&self->conn);
   self->conn = NULL;
+  self->pending_receipts = 0;
 }
 
 /* TODO escape '\0' when passing down the value */
@@ -246,31 +255,18 @@ static gboolean
 afstomp_vp_foreach(const gchar *name, TypeHint type, const gchar *value, gsize value_len,
                    gpointer user_data)
 {
-  stomp_frame *frame = (stomp_frame *) (user_data);
+  stomp_connection *conn = (stomp_connection *) (user_data);
 
-  stomp_frame_add_header(frame, name, value);
+  stomp_send_header(conn, name, value);
 
   return FALSE;
 }
 
-static void
-afstomp_set_frame_body(STOMPDestDriver *self, SBGString *body, stomp_frame* frame, LogMessage* msg)
-{
-  if (self->body_template)
-    {
-      log_template_format(self->body_template, msg, NULL, LTZ_LOCAL,
-                          self->super.seq_num, NULL, sb_gstring_string(body));
-      stomp_frame_set_body(frame, sb_gstring_string(body)->str, sb_gstring_string(body)->len);
-    }
-}
-
 static gboolean
 afstomp_worker_publish(STOMPDestDriver *self, LogMessage *msg)
 {
   gboolean success = TRUE;
   SBGString *body = NULL;
-  stomp_frame frame;
-  stomp_frame recv_frame;
   gchar seq_num[16];
 
   if (!self->conn)
@@ -279,39 +275,86 @@ afstomp_worker_publish(STOMPDestDriver *self, LogMessage *msg)
       return FALSE;
     }
 
+  /* without receipts, ERROR frames are only noticed here */
+  if (!self->ack_needed && !stomp_check_for_frame(self->conn))
+    return FALSE;
+
   body = sb_gstring_acquire();
-  stomp_frame_init(&frame, "SEND", sizeof("SEND"));
+  stomp_send_begin(self->conn, "SEND");
 
   if (self->persistent)
-    stomp_frame_add_header(&frame, "persistent", "true");
+    stomp_send_header(self->conn, "persistent", "true");
 
-  stomp_frame_add_header(&frame, "destination", self->destination);
+  stomp_send_header(self->conn, "destination", self->destination);
   if (self->ack_needed)
     {
       g_snprintf(seq_num, sizeof(seq_num), "%i", self->super.seq_num);
-      stomp_frame_add_header(&frame, "receipt", seq_num);
+      stomp_send_header(self->conn, "receipt", seq_num);
     };
 
   value_pairs_foreach(self->vp, afstomp_vp_foreach, msg,
                       self->super.seq_num, LTZ_SEND,
-                      &self->template_options, &frame);
+                      &self->template_options, self->conn);
 
-  afstomp_set_frame_body(self, body, &frame, msg);
+  if (self->body_template)
+    log_template_format(self->body_template, msg, NULL, LTZ_LOCAL,
+                        self->super.seq_num, NULL, sb_gstring_string(body));
 
-  if (!afstomp_send_frame(self, &frame))
+  if (!stomp_send_end(self->conn,
+                      self->body_template ? sb_gstring_string(body)->str : NULL,
+                      sb_gstring_string(body)->len))
     {
       msg_error("Error while inserting into STOMP server", NULL);
       success = FALSE;
     }
 
-  if (success && self->ack_needed)
-    success = stomp_receive_frame(self->conn, &recv_frame);
-
   sb_gstring_release(body);
 
   return success;
 }
 
+/*
+ * With ack(yes) the SEND frames are pipelined: up to batch-lines() of
+ * them are sent before flush() waits for their RECEIPTs.  Frames are
+ * processed by the server in order, so each RECEIPT acks the oldest
+ * message still waiting for one.
+ */
+static worker_insert_result_t
+afstomp_worker_flush(LogThrDestDriver *s)
+{
+  STOMPDestDriver *self = (STOMPDestDriver *)s;
+  stomp_frame frame;
+
+  while (self->pending_receipts > 0)
+    {
+      if (!self->conn || !stomp_receive_frame(self->conn, &frame))
+        {
+          msg_error("Error receiving RECEIPT frame from STOMP server", NULL);
+          goto error;
+        }
+
+      if (strcmp(frame.command, "RECEIPT"))
+        {
+          msg_error("Unexpected frame received from STOMP server while waiting for RECEIPT",
+                    evt_tag_str("command", frame.command),
+                    NULL);
+          stomp_frame_deinit(&frame);
+          goto error;
+        }
+      stomp_frame_deinit(&frame);
+
+      log_threaded_dest_driver_accept_batch_prefix(s, 1);
+      self->pending_receipts--;
+    }
+  return WORKER_INSERT_RESULT_SUCCESS;
+
+ error:
+  /* RECEIPTs of the rest of the batch would be mixed up with the ones
+   * sent after rewinding, start over on a new connection */
+  afstomp_dd_disconnect(s);
+  return WORKER_INSERT_RESULT_ERROR;
+}
+
 static worker_insert_result_t
 afstomp_worker_insert(LogThrDestDriver *s, LogMessage *msg)
 {
@@ -321,7 +364,17 @@ afstomp_worker_insert(LogThrDestDriver *s, LogMessage *msg)
     return WORKER_INSERT_RESULT_NOT_CONNECTED;
 
   if (!afstomp_worker_publish (self, msg))
-    return WORKER_INSERT_RESULT_ERROR;
+    {
+      if (self->ack_needed)
+        afstomp_dd_disconnect(s);
+      return WORKER_INSERT_RESULT_ERROR;
+    }
+
+  if (self->ack_needed)
+    {
+      self->pending_receipts++;
+      return WORKER_INSERT_RESULT_QUEUED;
+    }
 
   return WORKER_INSERT_RESULT_SUCCESS;
 }
@@ -346,6 +399,7 @@ afstomp_dd_init(LogPipe *s)
   log_template_options_init(&self->template_options, cfg);
 
   self->conn = NULL;
+  self->super.worker.flush = self->ack_needed ? afstomp_worker_flush : NULL;
 
   msg_verbose("Initializing STOMP destination",
               evt_tag_str("host", self->host),
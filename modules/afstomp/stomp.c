@@ -92,6 +92,8 @@ static void
 _stomp_connection_free(stomp_connection *conn)
 {
   g_sockaddr_unref(conn->remote_sa);
+  g_string_free(conn->read_buffer, TRUE);
+  g_string_free(conn->write_buffer, TRUE);
   g_free(conn);
 }
 
@@ -101,6 +103,8 @@ stomp_connect(stomp_connection **connection_ref, char *hostname, int port)
   stomp_connection *conn;
 
   conn = g_new0(stomp_connection, 1);
+  conn->read_buffer = g_string_sized_new(4096);
+  conn->write_buffer = g_string_sized_new(4096);
 
   conn->socket = socket(AF_INET, SOCK_STREAM, 0);
   if (conn->socket == -1)
@@ -193,15 +197,10 @@ stomp_read_data(stomp_connection *connection, GString *buffer)
   int res;
 
   res = read(connection->socket, tmp_buf, sizeof(tmp_buf));
-  if (res < 0)
+  if (res <= 0)
      return FALSE;
 
-  g_string_assign_len(buffer, tmp_buf, res);
-  while (res == sizeof(tmp_buf))
-    {
-      res = read(connection->socket, tmp_buf, sizeof(tmp_buf));
-      g_string_append_len(buffer, tmp_buf, res);
-    }
+  g_string_append_len(buffer, tmp_buf, res);
   return TRUE;
 }
 
@@ -246,55 +245,90 @@ stomp_parse_header(char *buffer, int buflen, stomp_frame *frame, char **out_pos)
   return STOMP_PARSE_HEADER;
 };
 
-int
-stomp_parse_frame(GString *data, stomp_frame *frame)
+static int
+stomp_parse_frame_len(char *data, int len, stomp_frame *frame)
 {
   char *pos;
   int res;
 
-  res = stomp_parse_command(data->str, data->len, frame, &pos);
+  res = stomp_parse_command(data, len, frame, &pos);
   if (!res)
     return FALSE;
 
-  res = stomp_parse_header(pos, data->str + data->len - pos, frame, &pos);
+  res = stomp_parse_header(pos, data + len - pos, frame, &pos);
   while (res == STOMP_PARSE_HEADER)
     {
-      res = stomp_parse_header(pos, data->str + data->len - pos, frame, &pos);
+      res = stomp_parse_header(pos, data + len - pos, frame, &pos);
     }
-  frame->body = g_strndup(pos, data->len - (pos - data->str));
+  frame->body = g_strndup(pos, len - (pos - data));
   return TRUE;
 }
 
+int
+stomp_parse_frame(GString *data, stomp_frame *frame)
+{
+  return stomp_parse_frame_len(data->str, data->len, frame);
+}
+
+/*
+ * Frames are NUL terminated and the server may send several of them in
+ * one go (e.g. RECEIPTs of pipelined SENDs), so the data read is kept in
+ * the read buffer of the connection and consumed one frame at a time.
+ */
 int
 stomp_receive_frame(stomp_connection *connection, stomp_frame *frame)
 {
-  GString* data = g_string_sized_new(4096);
+  GString *data = connection->read_buffer;
+  char *end;
+  gsize skip;
   int res;
 
-  if (!stomp_read_data(connection, data))
+  while (1)
     {
-      g_string_free(data, TRUE);
-      return FALSE;
+      /* EOLs may be sent as heart-beats between frames */
+      skip = 0;
+      while (skip < data->len && (data->str[skip] == '\n' || data->str[skip] == '\r'))
+        skip++;
+      g_string_erase(data, 0, skip);
+
+      end = memchr(data->str, '\0', data->len);
+      if (end)
+        break;
+
+      if (!stomp_read_data(connection, data))
+        return FALSE;
     }
 
-  res = stomp_parse_frame(data, frame);
+  res = stomp_parse_frame_len(data->str, end - data->str, frame);
+  g_string_erase(data, 0, end - data->str + 1);
+  if (!res)
+    return FALSE;
+
   msg_debug("Frame received",
             evt_tag_str("command",frame->command),
             NULL);
-  g_string_free(data, TRUE);
   return res;
 }
 
 static int
-stomp_check_for_frame(stomp_connection *connection)
+stomp_has_pending_data(stomp_connection *connection)
 {
   struct pollfd pfd;
 
+  if (connection->read_buffer->len > 0)
+    return TRUE;
+
   pfd.fd = connection->socket;
   pfd.events = POLLIN | POLLPRI;
 
   poll(&pfd, 1, 0);
-  if (pfd.revents & ( POLLIN | POLLPRI))
+  return !!(pfd.revents & (POLLIN | POLLPRI));
+}
+
+int
+stomp_check_for_frame(stomp_connection *connection)
+{
+  if (stomp_has_pending_data(connection))
     {
       stomp_frame frame;
 
@@ -317,11 +351,9 @@ stomp_check_for_frame(stomp_connection *connection)
   return TRUE;
 }
 
-GString *
-create_gstring_from_frame(stomp_frame *frame)
+void
+stomp_frame_format(stomp_frame *frame, GString *data)
 {
-  GString* data = g_string_new("");
-
   g_string_append(data, frame->command);
   g_string_append_c(data, '\n');
   g_hash_table_foreach(frame->headers, write_header_into_gstring, data);
@@ -329,27 +361,66 @@ create_gstring_from_frame(stomp_frame *frame)
   if (frame->body)
     g_string_append_len(data, frame->body, frame->body_length);
   g_string_append_c(data, 0);
+}
+
+GString *
+create_gstring_from_frame(stomp_frame *frame)
+{
+  GString* data = g_string_new("");
+
+  stomp_frame_format(frame, data);
   return data;
 }
 
 int
 stomp_write(stomp_connection *connection, stomp_frame *frame)
 {
-  GString *data;
-
   if (!stomp_check_for_frame(connection))
     return FALSE;
 
-  data = create_gstring_from_frame(frame);
-  if (!write_gstring_to_socket(connection->socket, data))
+  g_string_truncate(connection->write_buffer, 0);
+  stomp_frame_format(frame, connection->write_buffer);
+  stomp_frame_deinit(frame);
+  if (!write_gstring_to_socket(connection->socket, connection->write_buffer))
     {
       msg_error("Write error, partial write", NULL);
-      stomp_frame_deinit(frame);
-      g_string_free(data, TRUE);
       return FALSE;
     }
 
-  g_string_free(data, TRUE);
-  stomp_frame_deinit(frame);
+  return TRUE;
+}
+
+/*
+ * Building a frame directly into the write buffer of the connection,
+ * without the allocations of a stomp_frame.  Unlike stomp_write(), frames
+ * sent this way do not check for frames coming from the server, the
+ * caller is expected to receive them (e.g. RECEIPTs) itself.
+ */
+void
+stomp_send_begin(stomp_connection *connection, const char *command)
+{
+  g_string_assign(connection->write_buffer, command);
+  g_string_append_c(connection->write_buffer, '\n');
+}
+
+void
+stomp_send_header(stomp_connection *connection, const char *name, const char *value)
+{
+  write_header_into_gstring((gpointer) name, (gpointer) value, connection->write_buffer);
+}
+
+int
+stomp_send_end(stomp_connection *connection, const char *body, int body_len)
+{
+  g_string_append_c(connection->write_buffer, '\n');
+  if (body)
+    g_string_append_len(connection->write_buffer, body, body_len);
+  g_string_append_c(connection->write_buffer, 0);
+
+  if (!write_gstring_to_socket(connection->socket, connection->write_buffer))
+    {
+      msg_error("Write error, partial write", NULL);
+      return FALSE;
+    }
   return TRUE;
 }
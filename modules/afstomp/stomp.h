@@ -32,6 +32,8 @@ typedef struct stomp_connection
   int socket;
   GSockAddr *remote_sa;
   char *remote_ip;
+  GString *read_buffer;
+  GString *write_buffer;
 } stomp_connection;
 
 typedef struct stomp_frame
@@ -52,10 +54,15 @@ int stomp_connect(stomp_connection **connection_ref, char *hostname, int port);
 int stomp_disconnect(stomp_connection **connection_ref);
 
 int stomp_write(stomp_connection *connection, stomp_frame *frame);
+void stomp_send_begin(stomp_connection *connection, const char *command);
+void stomp_send_header(stomp_connection *connection, const char *name, const char *value);
+int stomp_send_end(stomp_connection *connection, const char *body, int body_len);
 int stomp_read(stomp_connection *connection, stomp_frame **frame);
 int stomp_parse_frame(GString *data, stomp_frame *frame);
 int stomp_receive_frame(stomp_connection *connection, stomp_frame *frame);
+int stomp_check_for_frame(stomp_connection *connection);
 
+void stomp_frame_format(stomp_frame *frame, GString *data);
 GString *create_gstring_from_frame(stomp_frame *frame);
 
 #endif
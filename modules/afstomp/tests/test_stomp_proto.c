@@ -24,6 +24,10 @@
 #include "stomp.h"
 #include "testutils.h"
 
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
 void
 assert_stomp_header(stomp_frame* frame, char* key, char* value)
 {
@@ -102,6 +106,73 @@ test_generate_gstring_from_frame()
   stomp_frame_deinit(&frame);
 };
 
+static void
+_init_socketpair_connection(stomp_connection *conn, int *peer)
+{
+  int fds[2];
+
+  socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+  memset(conn, 0, sizeof(*conn));
+  conn->socket = fds[0];
+  conn->read_buffer = g_string_new("");
+  conn->write_buffer = g_string_new("");
+  *peer = fds[1];
+}
+
+static void
+_deinit_socketpair_connection(stomp_connection *conn, int peer)
+{
+  close(conn->socket);
+  close(peer);
+  g_string_free(conn->read_buffer, TRUE);
+  g_string_free(conn->write_buffer, TRUE);
+}
+
+void
+test_pipelined_frames_are_received_one_by_one()
+{
+  const char receipts[] = "RECEIPT\nreceipt-id:1\n\n\0\nRECEIPT\nreceipt-id:2\n\n\0";
+  stomp_connection conn;
+  stomp_frame frame;
+  int peer;
+
+  _init_socketpair_connection(&conn, &peer);
+  write(peer, receipts, sizeof(receipts) - 1);
+
+  assert_true(stomp_receive_frame(&conn, &frame), "Receiving the first frame failed");
+  assert_stomp_command(&frame, "RECEIPT");
+  assert_stomp_header(&frame, "receipt-id", "1");
+  stomp_frame_deinit(&frame);
+
+  assert_true(stomp_receive_frame(&conn, &frame), "Receiving the second frame failed");
+  assert_stomp_command(&frame, "RECEIPT");
+  assert_stomp_header(&frame, "receipt-id", "2");
+  stomp_frame_deinit(&frame);
+
+  assert_gint(conn.read_buffer->len, 0, "Read buffer should be empty after consuming both frames");
+  _deinit_socketpair_connection(&conn, peer);
+}
+
+void
+test_send_builds_frame_into_write_buffer()
+{
+  const char expected[] = "SEND\ndestination:/topic/syslog\n\nbody";
+  stomp_connection conn;
+  char buf[256];
+  int peer, len;
+
+  _init_socketpair_connection(&conn, &peer);
+
+  stomp_send_begin(&conn, "SEND");
+  stomp_send_header(&conn, "destination", "/topic/syslog");
+  assert_true(stomp_send_end(&conn, "body", 4), "Sending frame failed");
+
+  len = read(peer, buf, sizeof(buf));
+  assert_gint(len, sizeof(expected), "Sent frame has unexpected length");
+  assert_string(buf, expected, "Sent frame does not match");
+  _deinit_socketpair_connection(&conn, peer);
+}
+
 int
 main(void)
 {
@@ -110,4 +181,6 @@ main(void)
   test_command_and_header_and_data();
   test_command_and_header();
   test_generate_gstring_from_frame();
+  test_pipelined_frames_are_received_one_by_one();
+  test_send_builds_frame_into_write_buffer();
 }
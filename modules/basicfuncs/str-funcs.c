@@ -38,7 +38,7 @@ tf_echo(LogMessage *msg, gint argc, GString *argv[], GString *result)
     }
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_echo);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_echo);
 
 static void
 tf_length(LogMessage *msg, gint argc, GString *argv[], GString *result)
@@ -53,7 +53,7 @@ tf_length(LogMessage *msg, gint argc, GString *argv[], GString *result)
     }
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_length);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_length);
 
 /*
  * $(substr $arg START [LEN])
@@ -156,7 +156,7 @@ tf_substr(LogMessage *msg, gint argc, GString *argv[], GString *result)
   g_string_append_len(result, argv[0]->str + start, len);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_substr);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_substr);
 
 /*
  * $(strip $arg1 $arg2 ...)
@@ -193,7 +193,7 @@ tf_strip(LogMessage *msg, gint argc, GString *argv[], GString *result)
     }
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_strip);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_strip);
 
 /*
  * $(sanitize [opts] $arg1 $arg2 ...)
@@ -267,7 +267,7 @@ tf_sanitize_call(LogTemplateFunction *self, gpointer s, const LogTemplateInvokeA
   gint i, pos;
 
   argv = (GString **) args->bufs->pdata;
-  argc = args->bufs->len;
+  argc = state->super.argc;
   for (i = 0; i < argc; i++)
     {
       for (pos = 0; pos < argv[i]->len; pos++)
@@ -298,83 +298,67 @@ TEMPLATE_FUNCTION(TFSanitizeState, tf_sanitize, tf_sanitize_prepare, tf_simple_f
 
 
 static void
-append_args(gint argc, GString *argv[], GString *result)
+tf_indent_multi_line(LogMessage *msg, GString *text, gsize start)
 {
-  gint i;
-
-  for (i = 0; i < argc; i++)
-    {
-      g_string_append_len(result, argv[i]->str, argv[i]->len);
-      if (i < argc - 1)
-        g_string_append_c(result, ' ');
-    }
-}
-
-void
-tf_indent_multi_line(LogMessage *msg, gint argc, GString *argv[], GString *text)
-{
-  gchar *p, *new_line;
-
-  /* append the message text(s) to the template string */
-  append_args(argc, argv, text);
+  gchar *new_line;
+  gsize pos = start;
 
   /* look up the \n-s and insert a \t after them */
-  p = text->str;
-  new_line = memchr(p, '\n', text->len);
-  while(new_line)
+  while ((new_line = memchr(text->str + pos, '\n', text->len - pos)))
     {
-      if (*(gchar *)(new_line + 1) != '\t')
-        {
-          g_string_insert_c(text, new_line - p + 1, '\t');
-        }
-      new_line = memchr(new_line + 1, '\n', p + text->len - new_line);
+      pos = new_line - text->str + 1;
+      if (text->str[pos] != '\t')
+        g_string_insert_c(text, pos, '\t');
     }
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_indent_multi_line);
+TEMPLATE_FUNCTION_SIMPLE_IN_PLACE_PURE(tf_indent_multi_line);
 
-void
-tf_lowercase(LogMessage *msg, gint argc, GString *argv[], GString *result)
+/* converts the text appended from start, without allocations as long as it is ASCII */
+static void
+_change_case_in_place(GString *text, gsize start, gchar (*ascii_func)(gchar c), gchar *(*utf8_func)(const gchar *str, gssize len))
 {
-  gint i;
+  gchar *converted;
+  gsize i;
 
-  for (i = 0; i < argc; i++)
+  for (i = start; i < text->len; i++)
     {
-      gchar *new = g_utf8_strdown(argv[i]->str, argv[i]->len);
+      if ((guchar) text->str[i] >= 0x80)
+        break;
+      text->str[i] = ascii_func(text->str[i]);
+    }
 
-      g_string_append(result, new);
-      if (i < argc - 1)
-        g_string_append_c(result, ' ');
+  if (i == text->len)
+    return;
 
-      g_free(new);
-    }
+  /* the length of non-ASCII characters may change during the conversion */
+  converted = utf8_func(text->str + i, text->len - i);
+  g_string_truncate(text, i);
+  g_string_append(text, converted);
+  g_free(converted);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_lowercase);
-
-void
-tf_uppercase(LogMessage *msg, gint argc, GString *argv[], GString *result)
+static void
+tf_lowercase(LogMessage *msg, GString *result, gsize start)
 {
-  gint i;
+  _change_case_in_place(result, start, g_ascii_tolower, g_utf8_strdown);
+}
 
-  for (i = 0; i < argc; i++)
-    {
-      gchar *new = g_utf8_strup(argv[i]->str, argv[i]->len);
+TEMPLATE_FUNCTION_SIMPLE_IN_PLACE_PURE(tf_lowercase);
 
-      g_string_append(result, new);
-      if (i < argc - 1)
-        g_string_append_c(result, ' ');
-
-      g_free(new);
-    }
+static void
+tf_uppercase(LogMessage *msg, GString *result, gsize start)
+{
+  _change_case_in_place(result, start, g_ascii_toupper, g_utf8_strup);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_uppercase);
+TEMPLATE_FUNCTION_SIMPLE_IN_PLACE_PURE(tf_uppercase);
 
 void
 tf_replace_delimiter(LogMessage *msg, gint argc, GString *argv[], GString *result)
 {
-  gchar *haystack, *delimiters, new_delimiter;
+  gchar *delimiters, new_delimiter;
+  gsize start;
 
   if (argc != 3)
     {
@@ -385,20 +369,20 @@ tf_replace_delimiter(LogMessage *msg, gint argc, GString *argv[], GString *resul
 
   delimiters = argv[0]->str;
   new_delimiter = argv[1]->str[0];
-  haystack = g_strdup(argv[2]->str);
-
-  g_string_append(result, g_strdelimit(haystack, delimiters, new_delimiter));
 
-  g_free(haystack);
+  start = result->len;
+  g_string_append_len(result, argv[2]->str, argv[2]->len);
+  g_strdelimit(result->str + start, delimiters, new_delimiter);
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_replace_delimiter);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_replace_delimiter);
 
 static void
 tf_string_padding(LogMessage *msg, gint argc, GString *argv[], GString *result)
 {
   GString *text = argv[0];
-  GString *padding;
+  const gchar *padding = " ";
+  gsize padding_len = 1;
   gint64 width, i;
 
   if (argc <= 1)
@@ -413,25 +397,21 @@ tf_string_padding(LogMessage *msg, gint argc, GString *argv[], GString *result)
       return;
     }
 
-  if (argc <= 2)
-    padding = g_string_new(" ");
-  else
-    padding = argv[2];
+  if (argc > 2)
+    {
+      padding = argv[2]->str;
+      padding_len = argv[2]->len;
+    }
 
   if (text->len < width)
     {
       for (i = 0; i < width - text->len; i++)
         {
-          g_string_append_c(result, *(padding->str + (i % padding->len)));
+          g_string_append_c(result, padding[i % padding_len]);
         }
     }
 
   g_string_append_len(result, text->str, text->len);
-
-  if (argc <= 2)
-    {
-      g_string_free(padding, TRUE);
-    }
 }
 
-TEMPLATE_FUNCTION_SIMPLE(tf_string_padding);
+TEMPLATE_FUNCTION_SIMPLE_PURE(tf_string_padding);
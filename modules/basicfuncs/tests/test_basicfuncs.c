@@ -107,9 +107,12 @@ test_str_funcs(void)
   assert_template_format("$(sanitize $HOST $PROGRAM)", "bzorp/syslog-ng");
 
   assert_template_format("$(indent-multi-line 'foo\nbar')", "foo\n\tbar");
+  assert_template_format("$HOST $(indent-multi-line 'foo\nbar\n\tbaz\n')", "bzorp foo\n\tbar\n\tbaz\n\t");
 
   assert_template_format("$(lowercase ŐRÜLT ÍRÓ)", "őrült író");
   assert_template_format("$(uppercase őrült író)", "ŐRÜLT ÍRÓ");
+  assert_template_format("$(lowercase $HOST BZORP ŐRÜLT)", "bzorp bzorp őrült");
+  assert_template_format("$(uppercase $HOST őrült bzorp)", "BZORP ŐRÜLT BZORP");
 
   assert_template_format("$(replace-delimiter \"\t\" \",\" \"hello\tworld\")", "hello,world");
 
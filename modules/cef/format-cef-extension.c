@@ -25,6 +25,7 @@
 #include "value-pairs/value-pairs.h"
 #include "value-pairs/cmdline.h"
 #include "syslog-ng.h"
+#include "str-utils.h"
 #include "format-cef-extension.h"
 
 typedef struct _TFCefState
@@ -54,13 +55,18 @@ typedef struct
   const LogTemplateOptions *template_options;
 } CefWalkerState;
 
-static gboolean
-tf_cef_is_valid_key(const gchar *str)
+/* returns the length of the key, or -1 if it contains non-alphanumeric characters */
+static gssize
+tf_cef_validate_key(const gchar *str)
 {
-  size_t end = strspn(str, "0123456789"
-                       "abcdefghijklmnopqrstuvwxyz"
-                       "ABCDEFGHIJKLMNOPQRSTUVWXYZ");
-  return str[end] == '\0';
+  const gchar *p;
+
+  for (p = str; *p; p++)
+    {
+      if (!g_ascii_isalnum(*p))
+        return -1;
+    }
+  return p - str;
 }
 
 static inline void
@@ -80,6 +86,15 @@ tf_cef_append_escaped(GString *escaped_string, const gchar *str, gsize str_len)
 
   while (str_len)
     {
+      /* copy the run of characters that need no escaping at once */
+      gsize plain_len = str_span_plain_chars(str, str_len, "=\\", FALSE);
+
+      g_string_append_len(escaped_string, str, plain_len);
+      str += plain_len;
+      str_len -= plain_len;
+      if (!str_len)
+        break;
+
       uchar = g_utf8_get_char_validated(str, str_len);
 
       switch (uchar)
@@ -116,13 +131,13 @@ tf_cef_append_escaped(GString *escaped_string, const gchar *str, gsize str_len)
 }
 
 static gboolean
-tf_cef_append_value(const gchar *name, const gchar *value, gsize value_len,
+tf_cef_append_value(const gchar *name, gsize name_len, const gchar *value, gsize value_len,
                      CefWalkerState *state)
 {
   if (state->need_separator)
     g_string_append_c(state->buffer, ' ');
 
-  g_string_append(state->buffer, name);
+  g_string_append_len(state->buffer, name, name_len);
 
   g_string_append_c(state->buffer, '=');
 
@@ -143,8 +158,9 @@ tf_cef_walker(const gchar *name, TypeHint type, const gchar *value, gsize value_
 {
   CefWalkerState *state = (CefWalkerState *)user_data;
   gint on_error = state->template_options->on_error;
+  gssize name_len = tf_cef_validate_key(name);
 
-  if (!tf_cef_is_valid_key(name))
+  if (name_len < 0)
     {
       if (!(on_error & ON_ERROR_SILENT))
         {
@@ -155,7 +171,7 @@ tf_cef_walker(const gchar *name, TypeHint type, const gchar *value, gsize value_
       return !!(on_error & ON_ERROR_DROP_MESSAGE);
     }
 
-  tf_cef_append_value(name, value, value_len, state);
+  tf_cef_append_value(name, name_len, value, value_len, state);
 
   state->need_separator = TRUE;
 
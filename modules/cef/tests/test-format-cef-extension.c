@@ -172,6 +172,8 @@ _test_escaping(void)
   _EXPECT_CEF_RESULT("act=\\n\\r", ".cef.act", "\n\r");
   _EXPECT_CEF_RESULT("act=this is a long value \\= something",
        ".cef.act", "this is a long value = something");
+  _EXPECT_CEF_RESULT("act=0123456789abcdef\\\\0123456789\\=\\n\xc3\xa1rv\xc3\xadzt\xc5\xb1r\xc5\x91 0123456789abcdef",
+       ".cef.act", "0123456789abcdef\\0123456789=\n\xc3\xa1rv\xc3\xadzt\xc5\xb1r\xc5\x91 0123456789abcdef");
 
   _EXPECT_DROP_MESSAGE(".cef.k=w", "v");
   _EXPECT_DROP_MESSAGE(".cef.k|w", "v");
@@ -116,7 +116,7 @@ tf_hash_call(LogTemplateFunction *self, gpointer s, const LogTemplateInvokeArgs
   guint md_len;
 
   argv = (GString **) args->bufs->pdata;
-  argc = args->bufs->len;
+  argc = state->super.argc;
 
   EVP_MD_CTX_init(&mdctx);
   EVP_DigestInit_ex(&mdctx, state->md, NULL);
@@ -26,6 +26,14 @@
 
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define CSV_SCANNER_SSE2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CSV_SCANNER_NEON 1
+#endif
+
 /************************************************************************
  * CSVScannerOptions
  ************************************************************************/
@@ -150,12 +158,24 @@ static void
 _switch_to_next_column(CSVScanner *self)
 {
   if (!self->current_column && self->src && self->src[0])
-    self->current_column = self->options->columns;
+    {
+      self->current_column = self->options->columns;
+      self->current_column_index = 0;
+    }
   else if (self->current_column)
-    self->current_column = self->current_column->next;
+    {
+      self->current_column = self->current_column->next;
+      self->current_column_index++;
+    }
   g_string_truncate(self->current_value, 0);
 }
 
+static gboolean
+_is_current_column_stored(CSVScanner *self)
+{
+  return !self->column_mask || self->column_mask[self->current_column_index];
+}
+
 static gboolean
 _is_last_column(CSVScanner *self)
 {
@@ -217,7 +237,8 @@ _parse_character_with_quotation(CSVScanner *self)
       self->src++;
       return;
     }
-  g_string_append_c(self->current_value, *self->src);
+  if (_is_current_column_stored(self))
+    g_string_append_c(self->current_value, *self->src);
   self->src++;
 }
 
@@ -284,13 +305,69 @@ _parse_delimiter(CSVScanner *self)
 static void
 _parse_unquoted_literal_character(CSVScanner *self)
 {
-  g_string_append_c(self->current_value, *self->src);
+  if (_is_current_column_stored(self))
+    g_string_append_c(self->current_value, *self->src);
   self->src++;
 }
 
+/* returns the first occurrence of @delimiter in [@src, @end), or @end */
+static const gchar *
+_find_single_char_delimiter(const gchar *src, const gchar *end, gchar delimiter)
+{
+#if CSV_SCANNER_SSE2
+  const __m128i pattern = _mm_set1_epi8(delimiter);
+
+  for (; src + 16 <= end; src += 16)
+    {
+      gint mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) src), pattern));
+
+      if (mask)
+        return src + __builtin_ctz(mask);
+    }
+#elif CSV_SCANNER_NEON
+  const uint8x16_t pattern = vdupq_n_u8(delimiter);
+
+  for (; src + 16 <= end; src += 16)
+    {
+      if (vmaxvq_u8(vceqq_u8(vld1q_u8((const guint8 *) src), pattern)))
+        break;
+    }
+#endif
+
+  while (src < end && *src != delimiter)
+    src++;
+  return src;
+}
+
+/*
+ * An unquoted value extends up to the first delimiter, with a single
+ * character delimiter (and no string delimiters) the whole value is
+ * located and copied at once.
+ */
+static gboolean
+_parse_unquoted_value_up_to_single_char_delimiter(CSVScanner *self)
+{
+  const gchar *delimiters = self->options->delimiters;
+  const gchar *end;
+
+  if (self->options->string_delimiters || !delimiters || !delimiters[0] || delimiters[1])
+    return FALSE;
+
+  end = _find_single_char_delimiter(self->src, self->src_end, delimiters[0]);
+  if (_is_current_column_stored(self))
+    g_string_append_len(self->current_value, self->src, end - self->src);
+  self->src = end;
+  if (self->src < self->src_end)
+    self->src++;
+  return TRUE;
+}
+
 static void
 _parse_value_with_whitespace_and_delimiter(CSVScanner *self)
 {
+  if (!self->current_quote && _parse_unquoted_value_up_to_single_char_delimiter(self))
+    return;
+
   while (*self->src)
     {
       if (self->current_quote)
@@ -405,15 +482,25 @@ void
 csv_scanner_input(CSVScanner *self, const gchar *input)
 {
   self->src = input;
+  self->src_end = input ? input + strlen(input) : NULL;
   self->current_column = NULL;
 }
 
+void
+csv_scanner_set_column_mask(CSVScanner *self, const guint8 *column_mask)
+{
+  self->column_mask = column_mask;
+}
+
 void
 csv_scanner_state_init(CSVScanner *self, CSVScannerOptions *options)
 {
   self->options = options;
   self->current_column = options->columns;
+  self->current_column_index = 0;
   self->src = NULL;
+  self->src_end = NULL;
+  self->column_mask = NULL;
   self->current_value = g_string_sized_new(128);
   self->current_quote = 0;
 }
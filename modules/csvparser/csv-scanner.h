@@ -67,9 +67,13 @@ typedef struct _CSVScanner
 {
   CSVScannerOptions *options;
   GList *current_column;
+  gint current_column_index;
   const gchar *src;
+  const gchar *src_end;
   GString *current_value;
   gchar current_quote;
+  /* if set, only columns with a non-zero entry get their value stored */
+  const guint8 *column_mask;
 } CSVScanner;
 
 const gchar *csv_scanner_get_current_name(CSVScanner *pstate);
@@ -79,6 +83,7 @@ gboolean csv_scanner_scan_next(CSVScanner *pstate);
 gboolean csv_scanner_is_scan_finished(CSVScanner *pstate);
 
 void csv_scanner_input(CSVScanner *pstate, const gchar *input);
+void csv_scanner_set_column_mask(CSVScanner *pstate, const guint8 *column_mask);
 gboolean csv_scanner_parse_input(CSVScanner *pstate);
 void csv_scanner_state_init(CSVScanner *pstate, CSVScannerOptions *options);
 void csv_scanner_state_clean(CSVScanner *pstate);
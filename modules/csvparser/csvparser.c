@@ -35,6 +35,10 @@ typedef struct _CSVParser
   GString *formatted_key;
   gchar *prefix;
   gint prefix_len;
+  /* the NVHandle of each column, resolved by the first message */
+  NVHandle *column_handles;
+  /* which columns are referenced by the configuration, see _setup_column_mask() */
+  guint8 *column_mask;
 } CSVParser;
 
 #define _ESCAPE_MODE_SHIFT 16
@@ -110,20 +114,59 @@ _get_formatted_key(CSVParser *self, const gchar *key)
   return self->formatted_key->str;
 }
 
+static void
+_resolve_column_handles(CSVParser *self)
+{
+  GList *l;
+  gint i;
+
+  if (self->column_handles)
+    return;
+
+  self->column_handles = g_new0(NVHandle, g_list_length(self->options.columns) + 1);
+  for (l = self->options.columns, i = 0; l; l = l->next, i++)
+    self->column_handles[i] = log_msg_get_value_handle(_get_formatted_key(self, (const gchar *) l->data));
+}
+
+/*
+ * The set of referenced values is only known once the whole configuration
+ * is initialized, so the mask is set up when the first message arrives
+ * after that.  Columns nothing reads are still scanned, but their values
+ * are neither copied nor stored.
+ */
+static void
+_setup_column_mask(CSVParser *self)
+{
+  GlobalConfig *cfg = log_pipe_get_config(&self->super.super);
+  gint i, num_columns;
+
+  if (self->column_mask || !cfg || !cfg->value_references_frozen)
+    return;
+
+  num_columns = g_list_length(self->options.columns);
+  self->column_mask = g_new0(guint8, num_columns + 1);
+  for (i = 0; i < num_columns; i++)
+    self->column_mask[i] = cfg_is_value_referenced(cfg, self->column_handles[i]);
+  csv_scanner_set_column_mask(&self->scanner, self->column_mask);
+}
+
 static gboolean
 csv_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_options, const gchar *input, gsize input_len)
 {
   CSVParser *self = (CSVParser *) s;
   LogMessage *msg = log_msg_make_writable(pmsg, path_options);
+  gint i = 0;
 
+  _resolve_column_handles(self);
+  _setup_column_mask(self);
   csv_scanner_input(&self->scanner, input);
   while (csv_scanner_scan_next(&self->scanner))
     {
-
-      log_msg_set_value_by_name(msg,
-                                _get_formatted_key(self, csv_scanner_get_current_name(&self->scanner)),
-                                csv_scanner_get_current_value(&self->scanner),
-                                csv_scanner_get_current_value_len(&self->scanner));
+      if (!self->column_mask || self->column_mask[i])
+        log_msg_set_value(msg, self->column_handles[i],
+                          csv_scanner_get_current_value(&self->scanner),
+                          csv_scanner_get_current_value_len(&self->scanner));
+      i++;
     }
 
   return csv_scanner_is_scan_finished(&self->scanner);
@@ -148,6 +191,8 @@ csv_parser_free(LogPipe *s)
   CSVParser *self = (CSVParser *) s;
 
   csv_scanner_options_clean(&self->options);
+  g_free(self->column_mask);
+  g_free(self->column_handles);
   csv_scanner_state_clean(&self->scanner);
   g_string_free(self->formatted_key, TRUE);
   g_free(self->prefix);
@@ -222,6 +222,10 @@ main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
   testcase("<15> openvpn[2499]: PTHREAD support initialized", 0, 2, CSV_SCANNER_ESCAPE_NONE, CSV_SCANNER_GREEDY, " ", NULL, NULL, NULL,
            "PTHREAD", "support initialized", NULL);
 
+  // single char delimiter with values crossing 16 byte blocks
+  testcase("<15> openvpn[2499]: 0123456789abcdefghij,,x,0123456789abcdef,  padded value  ,\"quoted,value\",last", 0, -1, CSV_SCANNER_ESCAPE_NONE, CSV_SCANNER_STRIP_WHITESPACE, ",", NULL, NULL, NULL,
+           "0123456789abcdefghij", "", "x", "0123456789abcdef", "padded value", "quoted,value", "last", NULL);
+
   testcase("<15> openvpn[2499]: PTHREAD support initialized", 0, -1, CSV_SCANNER_ESCAPE_NONE, 0, " ,;", NULL, NULL, NULL,
            "PTHREAD", "support", "initialized", NULL);
 
@@ -32,6 +32,8 @@ typedef struct _DateParser
   gchar *date_tz;
   LogMessageTimeStamp time_stamp;
   TimeZoneInfo *date_tz_info;
+  /* compiled form of date_format, NULL if it needs strptime_with_tz() */
+  StrptimePlan *date_plan;
 } DateParser;
 
 void
@@ -68,6 +70,10 @@ date_parser_init(LogPipe *s)
   if (self->date_tz_info)
     time_zone_info_free(self->date_tz_info);
   self->date_tz_info = self->date_tz ? time_zone_info_new(self->date_tz) : NULL;
+
+  if (self->date_plan)
+    strptime_plan_free(self->date_plan);
+  self->date_plan = strptime_plan_compile(self->date_format);
   return log_parser_init_method(s);
 }
 
@@ -84,7 +90,10 @@ _parse_timestamp_and_deduce_missing_parts(DateParser *self, struct tm *tm, glong
   current_year = tm->tm_year;
   tm->tm_year = 0;
   tm_gmtoff = -1;
-  remainder = strptime_with_tz(input, self->date_format, tm, &tm_gmtoff, &tm_zone);
+  if (self->date_plan)
+    remainder = strptime_plan_execute(self->date_plan, input, tm, &tm_gmtoff, &tm_zone);
+  else
+    remainder = strptime_with_tz(input, self->date_format, tm, &tm_gmtoff, &tm_zone);
   if (!remainder || remainder[0])
     return FALSE;
 
@@ -216,6 +225,8 @@ date_parser_free(LogPipe *s)
   g_free(self->date_tz);
   if (self->date_tz_info)
     time_zone_info_free(self->date_tz_info);
+  if (self->date_plan)
+    strptime_plan_free(self->date_plan);
 
   log_parser_free_method(s);
 }
@@ -57,6 +57,7 @@
 #include <ctype.h>
 #include <string.h>
 #include <stdint.h>
+#include <stdlib.h>
 
 typedef unsigned char u_char;
 typedef unsigned int uint;
@@ -197,6 +198,196 @@ first_wday_of(int yr)
 	    (isleap(yr) ? 6 : 0) + 1) % 7;
 }
 
+/*
+ * Parse the numeric or named zone of a %z conversion, returns the
+ * position after it or NULL.
+ */
+static const u_char *
+conv_zone(const u_char *bp, struct tm *tm, long *tm_gmtoff, const char **tm_zone)
+{
+	const unsigned char *ep;
+	int i, neg = 0, offs;
+
+	/*
+	 * We recognize all ISO 8601 formats:
+	 * Z	= Zulu time/UTC
+	 * [+-]hhmm
+	 * [+-]hh:mm
+	 * [+-]hh
+	 * We recognize all RFC-822/RFC-2822 formats:
+	 * UT|GMT
+	 *          North American : UTC offsets
+	 * E[DS]T = Eastern : -4 | -5
+	 * C[DS]T = Central : -5 | -6
+	 * M[DS]T = Mountain: -6 | -7
+	 * P[DS]T = Pacific : -7 | -8
+	 *          Military
+	 * [A-IL-M] = -1 ... -9 (J not used)
+	 * [N-Y]  = +1 ... +12
+	 */
+	while (isspace(*bp))
+		bp++;
+
+	switch (*bp++) {
+	case 'G':
+		if (*bp++ != 'M')
+			return NULL;
+		/*FALLTHROUGH*/
+	case 'U':
+		if (*bp++ != 'T')
+			return NULL;
+		/*FALLTHROUGH*/
+	case 'Z':
+		tm->tm_isdst = 0;
+		*tm_gmtoff = 0;
+		*tm_zone = utc;
+		return bp;
+	case '+':
+		neg = 0;
+		break;
+	case '-':
+		neg = 1;
+		break;
+	default:
+		--bp;
+		ep = find_string(bp, &i, nast, NULL, 4);
+		if (ep != NULL) {
+			*tm_gmtoff = (-5 - i) * 3600;
+			*tm_zone = __UNCONST(nast[i]);
+			bp = ep;
+			return bp;
+		}
+		ep = find_string(bp, &i, nadt, NULL, 4);
+		if (ep != NULL) {
+			tm->tm_isdst = 1;
+			*tm_gmtoff = (-4 - i) * 3600;
+			*tm_zone = __UNCONST(nadt[i]);
+			bp = ep;
+			return bp;
+		}
+
+		if ((*bp >= 'A' && *bp <= 'I') ||
+		    (*bp >= 'L' && *bp <= 'Y')) {
+			/* Argh! No 'J'! */
+			if (*bp >= 'A' && *bp <= 'I')
+				*tm_gmtoff =
+					(('A' - 1) - (int)*bp) * 3600;
+			else if (*bp >= 'L' && *bp <= 'M')
+				*tm_gmtoff = ('A' - (int)*bp) * 3600;
+			else if (*bp >= 'N' && *bp <= 'Y')
+				*tm_gmtoff = ((int)*bp - 'M') * 3600;
+			*tm_zone = utc; /* XXX */
+			bp++;
+			return bp;
+		}
+		return NULL;
+	}
+	offs = 0;
+	for (i = 0; i < 4; ) {
+		if (isdigit(*bp)) {
+			offs = offs * 10 + (*bp++ - '0');
+			i++;
+			continue;
+		}
+		if (i == 2 && *bp == ':') {
+			bp++;
+			continue;
+		}
+		break;
+	}
+	switch (i) {
+	case 2:
+		offs *= 100;
+		break;
+	case 4:
+		i = offs % 100;
+		if (i >= 60)
+			return NULL;
+		/* Convert minutes into decimal */
+		offs = (offs / 100) * 100 + (i * 50) / 30;
+		break;
+	default:
+		return NULL;
+	}
+	if (neg)
+		offs = -offs;
+	tm->tm_isdst = 0;	/* XXX */
+	*tm_gmtoff = (offs * 3600) / 100;
+	*tm_zone = utc;	/* XXX */
+	return bp;
+}
+
+/*
+ * Fill in the fields not parsed but derivable from the others.
+ */
+static void
+fixup_tm(struct tm *tm, int state, int day_offset, int week_offset)
+{
+	int i;
+
+	if (!HAVE_YDAY(state) && HAVE_YEAR(state)) {
+		if (HAVE_MON(state) && HAVE_MDAY(state)) {
+			/* calculate day of year (ordinal date) */
+			tm->tm_yday =  start_of_month[isleap_sum(tm->tm_year,
+			    TM_YEAR_BASE)][tm->tm_mon] + (tm->tm_mday - 1);
+			state |= S_YDAY;
+		} else if (day_offset != -1) {
+			/*
+			 * Set the date to the first Sunday (or Monday)
+			 * of the specified week of the year.
+			 */
+			if (!HAVE_WDAY(state)) {
+				tm->tm_wday = day_offset;
+				state |= S_WDAY;
+			}
+			tm->tm_yday = (7 -
+			    first_wday_of(tm->tm_year + TM_YEAR_BASE) +
+			    day_offset) % 7 + (week_offset - 1) * 7 +
+			    tm->tm_wday  - day_offset;
+			state |= S_YDAY;
+		}
+	}
+
+	if (HAVE_YDAY(state) && HAVE_YEAR(state)) {
+		int isleap;
+
+		if (!HAVE_MON(state)) {
+			/* calculate month of day of year */
+			i = 0;
+			isleap = isleap_sum(tm->tm_year, TM_YEAR_BASE);
+			while (tm->tm_yday >= start_of_month[isleap][i])
+				i++;
+			if (i > 12) {
+				i = 1;
+				tm->tm_yday -= start_of_month[isleap][12];
+				tm->tm_year++;
+			}
+			tm->tm_mon = i - 1;
+			state |= S_MON;
+		}
+
+		if (!HAVE_MDAY(state)) {
+			/* calculate day of month */
+			isleap = isleap_sum(tm->tm_year, TM_YEAR_BASE);
+			tm->tm_mday = tm->tm_yday -
+			    start_of_month[isleap][tm->tm_mon] + 1;
+			state |= S_MDAY;
+		}
+
+		if (!HAVE_WDAY(state)) {
+			/* calculate day of week */
+			i = 0;
+			week_offset = first_wday_of(tm->tm_year);
+			while (i++ <= tm->tm_yday) {
+				if (week_offset++ >= 6)
+					week_offset = 0;
+			}
+			tm->tm_wday = week_offset;
+			state |= S_WDAY;
+		}
+	}
+}
+
 /* standard strptime() doesn't support %z / %Z properly on all
  * platforms, especially those that don't have tm_gmtoff/tm_zone in
  * their struct tm. This is a slightly modified NetBSD strptime() with
@@ -206,8 +397,8 @@ strptime_with_tz(const char *buf, const char *fmt, struct tm *tm, long *tm_gmtof
 {
 	unsigned char c;
 	const unsigned char *bp, *ep;
-	int alt_format, i, split_year = 0, neg = 0, state = 0,
-	    day_offset = -1, week_offset = 0, offs;
+	int alt_format, i, split_year = 0, state = 0,
+	    day_offset = -1, week_offset = 0;
 	const char *new_fmt;
 
 	bp = (const u_char *)buf;
@@ -521,112 +712,9 @@ literal:
 			continue;
 
 		case 'z':
-			/*
-			 * We recognize all ISO 8601 formats:
-			 * Z	= Zulu time/UTC
-			 * [+-]hhmm
-			 * [+-]hh:mm
-			 * [+-]hh
-			 * We recognize all RFC-822/RFC-2822 formats:
-			 * UT|GMT
-			 *          North American : UTC offsets
-			 * E[DS]T = Eastern : -4 | -5
-			 * C[DS]T = Central : -5 | -6
-			 * M[DS]T = Mountain: -6 | -7
-			 * P[DS]T = Pacific : -7 | -8
-			 *          Military
-			 * [A-IL-M] = -1 ... -9 (J not used)
-			 * [N-Y]  = +1 ... +12
-			 */
-			while (isspace(*bp))
-				bp++;
-
-			switch (*bp++) {
-			case 'G':
-				if (*bp++ != 'M')
-					return NULL;
-				/*FALLTHROUGH*/
-			case 'U':
-				if (*bp++ != 'T')
-					return NULL;
-				/*FALLTHROUGH*/
-			case 'Z':
-				tm->tm_isdst = 0;
-				*tm_gmtoff = 0;
-				*tm_zone = utc;
-				continue;
-			case '+':
-				neg = 0;
-				break;
-			case '-':
-				neg = 1;
-				break;
-			default:
-				--bp;
-				ep = find_string(bp, &i, nast, NULL, 4);
-				if (ep != NULL) {
-					*tm_gmtoff = (-5 - i) * 3600;
-					*tm_zone = __UNCONST(nast[i]);
-					bp = ep;
-					continue;
-				}
-				ep = find_string(bp, &i, nadt, NULL, 4);
-				if (ep != NULL) {
-					tm->tm_isdst = 1;
-					*tm_gmtoff = (-4 - i) * 3600;
-					*tm_zone = __UNCONST(nadt[i]);
-					bp = ep;
-					continue;
-				}
-
-				if ((*bp >= 'A' && *bp <= 'I') ||
-				    (*bp >= 'L' && *bp <= 'Y')) {
-					/* Argh! No 'J'! */
-					if (*bp >= 'A' && *bp <= 'I')
-						*tm_gmtoff =
-							(('A' - 1) - (int)*bp) * 3600;
-					else if (*bp >= 'L' && *bp <= 'M')
-						*tm_gmtoff = ('A' - (int)*bp) * 3600;
-					else if (*bp >= 'N' && *bp <= 'Y')
-						*tm_gmtoff = ((int)*bp - 'M') * 3600;
-					*tm_zone = utc; /* XXX */
-					bp++;
-					continue;
-				}
+			bp = conv_zone(bp, tm, tm_gmtoff, tm_zone);
+			if (bp == NULL)
 				return NULL;
-			}
-			offs = 0;
-			for (i = 0; i < 4; ) {
-				if (isdigit(*bp)) {
-					offs = offs * 10 + (*bp++ - '0');
-					i++;
-					continue;
-				}
-				if (i == 2 && *bp == ':') {
-					bp++;
-					continue;
-				}
-				break;
-			}
-			switch (i) {
-			case 2:
-				offs *= 100;
-				break;
-			case 4:
-				i = offs % 100;
-				if (i >= 60)
-					return NULL;
-				/* Convert minutes into decimal */
-				offs = (offs / 100) * 100 + (i * 50) / 30;
-				break;
-			default:
-				return NULL;
-			}
-			if (neg)
-				offs = -offs;
-			tm->tm_isdst = 0;	/* XXX */
-			*tm_gmtoff = (offs * 3600) / 100;
-			*tm_zone = utc;	/* XXX */
 			continue;
 
 		/*
@@ -645,72 +733,228 @@ literal:
 		}
 	}
 
-	if (!HAVE_YDAY(state) && HAVE_YEAR(state)) {
-		if (HAVE_MON(state) && HAVE_MDAY(state)) {
-			/* calculate day of year (ordinal date) */
-			tm->tm_yday =  start_of_month[isleap_sum(tm->tm_year,
-			    TM_YEAR_BASE)][tm->tm_mon] + (tm->tm_mday - 1);
-			state |= S_YDAY;
-		} else if (day_offset != -1) {
-			/*
-			 * Set the date to the first Sunday (or Monday)
-			 * of the specified week of the year.
-			 */
-			if (!HAVE_WDAY(state)) {
-				tm->tm_wday = day_offset;
-				state |= S_WDAY;
-			}
-			tm->tm_yday = (7 -
-			    first_wday_of(tm->tm_year + TM_YEAR_BASE) +
-			    day_offset) % 7 + (week_offset - 1) * 7 +
-			    tm->tm_wday  - day_offset;
-			state |= S_YDAY;
+	fixup_tm(tm, state, day_offset, week_offset);
+	return __UNCONST(bp);
+}
+
+
+/*
+ * A compiled form of a format string, covering the conversions commonly
+ * used in timestamps.  Composite conversions (%F, %T, %R) are expanded at
+ * compile time, so executing the plan neither reparses the format nor
+ * recurses.  Formats using anything else are refused, the caller should
+ * use strptime_with_tz() for those.
+ */
+#define PLAN_LITERAL		'%'
+#define PLAN_SPACE		' '
+
+struct strptime_step {
+	unsigned char op;	/* conversion character or PLAN_* */
+	unsigned char c;	/* the character to match for PLAN_LITERAL */
+};
+
+struct _StrptimePlan {
+	int n_steps;
+	struct strptime_step steps[];
+};
+
+static void
+plan_add(StrptimePlan *plan, unsigned char op, unsigned char c)
+{
+	plan->steps[plan->n_steps].op = op;
+	plan->steps[plan->n_steps].c = c;
+	plan->n_steps++;
+}
+
+StrptimePlan *
+strptime_plan_compile(const char *fmt)
+{
+	StrptimePlan *plan;
+	unsigned char c;
+
+	/* %T is the longest expansion: 5 steps for 2 format characters */
+	plan = malloc(sizeof(*plan) +
+	    (3 * strlen(fmt) + 1) * sizeof(struct strptime_step));
+	if (plan == NULL)
+		return NULL;
+	plan->n_steps = 0;
+
+	while ((c = *fmt++) != '\0') {
+		if (isspace(c)) {
+			plan_add(plan, PLAN_SPACE, 0);
+			continue;
+		}
+		if (c != '%') {
+			plan_add(plan, PLAN_LITERAL, c);
+			continue;
+		}
+
+		switch (c = *fmt++) {
+		case '%':
+			plan_add(plan, PLAN_LITERAL, '%');
+			break;
+		case 'F':
+			plan_add(plan, 'Y', 0);
+			plan_add(plan, PLAN_LITERAL, '-');
+			plan_add(plan, 'm', 0);
+			plan_add(plan, PLAN_LITERAL, '-');
+			plan_add(plan, 'd', 0);
+			break;
+		case 'T':
+			plan_add(plan, 'H', 0);
+			plan_add(plan, PLAN_LITERAL, ':');
+			plan_add(plan, 'M', 0);
+			plan_add(plan, PLAN_LITERAL, ':');
+			plan_add(plan, 'S', 0);
+			break;
+		case 'R':
+			plan_add(plan, 'H', 0);
+			plan_add(plan, PLAN_LITERAL, ':');
+			plan_add(plan, 'M', 0);
+			break;
+		case 'n':
+		case 't':
+			plan_add(plan, PLAN_SPACE, 0);
+			break;
+		case 'e':
+			plan_add(plan, 'd', 0);
+			break;
+		case 'k':
+			plan_add(plan, 'H', 0);
+			break;
+		case 'A':
+			plan_add(plan, 'a', 0);
+			break;
+		case 'B':
+		case 'h':
+			plan_add(plan, 'b', 0);
+			break;
+		case 'a':
+		case 'b':
+		case 'd':
+		case 'H':
+		case 'M':
+		case 'm':
+		case 'S':
+		case 'Y':
+		case 'y':
+		case 'z':
+			plan_add(plan, c, 0);
+			break;
+		default:
+			/* unsupported, including '\0' after a trailing '%' */
+			free(plan);
+			return NULL;
 		}
 	}
+	return plan;
+}
 
-	if (HAVE_YDAY(state) && HAVE_YEAR(state)) {
-		int isleap;
+void
+strptime_plan_free(StrptimePlan *plan)
+{
+	free(plan);
+}
 
-		if (!HAVE_MON(state)) {
-			/* calculate month of day of year */
-			i = 0;
-			isleap = isleap_sum(tm->tm_year, TM_YEAR_BASE);
-			while (tm->tm_yday >= start_of_month[isleap][i])
-				i++;
-			if (i > 12) {
-				i = 1;
-				tm->tm_yday -= start_of_month[isleap][12];
-				tm->tm_year++;
-			}
-			tm->tm_mon = i - 1;
+/*
+ * Same as strptime_with_tz() with the format the plan was compiled from.
+ */
+char *
+strptime_plan_execute(const StrptimePlan *plan, const char *buf, struct tm *tm,
+    long *tm_gmtoff, const char **tm_zone)
+{
+	const struct strptime_step *step, *end;
+	const unsigned char *bp;
+	int i, split_year = 0, state = 0;
+
+	bp = (const u_char *)buf;
+	end = plan->steps + plan->n_steps;
+
+	for (step = plan->steps; bp != NULL && step < end; step++) {
+		switch (step->op) {
+		case PLAN_SPACE:
+			while (isspace(*bp))
+				bp++;
+			break;
+
+		case PLAN_LITERAL:
+			if (step->c != *bp++)
+				return NULL;
+			break;
+
+		case 'a':
+			bp = find_string(bp, &tm->tm_wday,
+			    _TIME_LOCALE(loc)->day, _TIME_LOCALE(loc)->abday, 7);
+			state |= S_WDAY;
+			break;
+
+		case 'b':
+			bp = find_string(bp, &tm->tm_mon,
+			    _TIME_LOCALE(loc)->mon, _TIME_LOCALE(loc)->abmon,
+			    12);
 			state |= S_MON;
-		}
+			break;
 
-		if (!HAVE_MDAY(state)) {
-			/* calculate day of month */
-			isleap = isleap_sum(tm->tm_year, TM_YEAR_BASE);
-			tm->tm_mday = tm->tm_yday -
-			    start_of_month[isleap][tm->tm_mon] + 1;
+		case 'd':
+			bp = conv_num(bp, &tm->tm_mday, 1, 31);
 			state |= S_MDAY;
-		}
+			break;
 
-		if (!HAVE_WDAY(state)) {
-			/* calculate day of week */
-			i = 0;
-			week_offset = first_wday_of(tm->tm_year);
-			while (i++ <= tm->tm_yday) {
-				if (week_offset++ >= 6)
-					week_offset = 0;
+		case 'H':
+			bp = conv_num(bp, &tm->tm_hour, 0, 23);
+			state |= S_HOUR;
+			break;
+
+		case 'M':
+			bp = conv_num(bp, &tm->tm_min, 0, 59);
+			break;
+
+		case 'm':
+			i = 1;
+			bp = conv_num(bp, &i, 1, 12);
+			tm->tm_mon = i - 1;
+			state |= S_MON;
+			break;
+
+		case 'S':
+			bp = conv_num(bp, &tm->tm_sec, 0, 61);
+			break;
+
+		case 'Y':
+			i = TM_YEAR_BASE;
+			bp = conv_num(bp, &i, 0, 9999);
+			tm->tm_year = i - TM_YEAR_BASE;
+			state |= S_YEAR;
+			break;
+
+		case 'y':
+			bp = conv_num(bp, &i, 0, 99);
+
+			if (split_year)
+				i += (tm->tm_year / 100) * 100;
+			else {
+				split_year = 1;
+				if (i <= 68)
+					i = i + 2000 - TM_YEAR_BASE;
+				else
+					i = i + 1900 - TM_YEAR_BASE;
 			}
-			tm->tm_wday = week_offset;
-			state |= S_WDAY;
+			tm->tm_year = i;
+			state |= S_YEAR;
+			break;
+
+		case 'z':
+			bp = conv_zone(bp, tm, tm_gmtoff, tm_zone);
+			if (bp == NULL)
+				return NULL;
+			break;
 		}
 	}
 
+	fixup_tm(tm, state, -1, 0);
 	return __UNCONST(bp);
 }
 
-
 static const u_char *
 conv_num(const unsigned char *buf, int *dest, uint llim, uint ulim)
 {
@@ -25,6 +25,12 @@
 
 #include <time.h>
 
+typedef struct _StrptimePlan StrptimePlan;
+
 char *strptime_with_tz(const char *buf, const char *fmt, struct tm *tm, long *tm_gmtoff, const char **tm_zone);
 
+StrptimePlan *strptime_plan_compile(const char *fmt);
+char *strptime_plan_execute(const StrptimePlan *plan, const char *buf, struct tm *tm, long *tm_gmtoff, const char **tm_zone);
+void strptime_plan_free(StrptimePlan *plan);
+
 #endif
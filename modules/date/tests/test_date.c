@@ -162,6 +162,12 @@ int main()
   assert_parsed_date_equals("01/Nov:00:40:07 +0500", NULL, "%d/%b:%T %z", "2015-11-01T00:40:07+05:00");
 
 
+  /* Formats with conversions the compiled plans don't cover, and their equivalents */
+  assert_parsed_date_equals("01/27/15 11:48:46 +0200", NULL, "%D %T %z", "2015-01-27T11:48:46+02:00");
+  assert_parsed_date_equals("01/27/15 11:48:46 +0200", NULL, "%m/%d/%y %T %z", "2015-01-27T11:48:46+02:00");
+  assert_parsed_date_equals("Jan 27 11:48:46 AM", NULL, "%b %e %r", "2016-01-27T11:48:46+01:00");
+  assert_parsed_date_equals("Jan  7 11:48:46", NULL, "%b %e %H:%M:%S", "2016-01-07T11:48:46+01:00");
+
   assert_parsed_date_equals("1446128356 +01:00", NULL, "%s %z", "2015-10-29T15:19:16+01:00");
   assert_parsed_date_equals("1446128356", "Europe/Budapest", "%s", "2015-10-29T15:19:16+01:00");
 
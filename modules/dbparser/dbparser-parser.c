@@ -32,6 +32,7 @@ int dbparser_parse(CfgLexer *lexer, LogParser **instance, gpointer arg);
 static CfgLexerKeyword dbparser_keywords[] =
 {
   { "db_parser",          KW_DB_PARSER, 0x0300 },
+  { "profile_sample_rate", KW_PROFILE_SAMPLE_RATE, 0x0308 },
   { "grouping_by",        KW_GROUPING_BY, 0x0307 },
 
   /* correllate options */
@@ -44,6 +45,10 @@ static CfgLexerKeyword dbparser_keywords[] =
   { "where",              KW_WHERE, 0x0307 },
   { "having",             KW_HAVING, 0x0307 },
   { "trigger",            KW_TRIGGER, 0x0307 },
+  { "max_context_memory", KW_MAX_CONTEXT_MEMORY, 0x0308 },
+  { "eviction_policy",    KW_EVICTION_POLICY, 0x0308 },
+  { "linux_audit_assembler", KW_LINUX_AUDIT_ASSEMBLER, 0x0308 },
+  { "max_events",         KW_MAX_EVENTS, 0x0308 },
   { NULL }
 };
 
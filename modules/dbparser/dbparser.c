@@ -44,8 +44,96 @@ struct _LogDBParser
   ino_t db_file_inode;
   time_t db_file_mtime;
   gboolean db_file_reloading;
+  /* loads the new database in the background, see log_db_parser_start_reload() */
+  GThread *reload_thread;
+  guint profile_sample_rate;
 };
 
+#define LOG_DB_PARSER_PROFILE_REPORT_SIZE 10
+
+typedef struct _LogDBParserProfileItem
+{
+  gchar *rule_id;
+  gchar *program;
+  RProfileEntry entry;
+} LogDBParserProfileItem;
+
+static void
+_collect_profile_item(const gchar *program, const gchar *path, PDBRule *rule, RProfileEntry *entry, gpointer user_data)
+{
+  GArray *items = (GArray *) user_data;
+  LogDBParserProfileItem item;
+
+  /* the per-rule totals are stored on the nodes the rules are attached to */
+  if (!rule || !entry->matches)
+    return;
+
+  item.rule_id = g_strdup(rule->rule_id);
+  item.program = g_strdup(program);
+  item.entry = *entry;
+  g_array_append_val(items, item);
+}
+
+static gint
+_compare_profile_items(gconstpointer a, gconstpointer b)
+{
+  const RProfileEntry *entry_a = &((const LogDBParserProfileItem *) a)->entry;
+  const RProfileEntry *entry_b = &((const LogDBParserProfileItem *) b)->entry;
+
+  if (entry_a->match_parser_failures != entry_b->match_parser_failures)
+    return entry_a->match_parser_failures < entry_b->match_parser_failures ? 1 : -1;
+  if (entry_a->match_parser_attempts != entry_b->match_parser_attempts)
+    return entry_a->match_parser_attempts < entry_b->match_parser_attempts ? 1 : -1;
+  return 0;
+}
+
+/*
+ * Logs the rules whose lookups took the most failed parser runs, as
+ * sampled using profile-sample-rate(), then starts a new profile.  Called
+ * when the database is reloaded and when the parser is deinitialized.
+ */
+static void
+log_db_parser_report_profile(LogDBParser *self)
+{
+  GArray *items;
+  guint64 lookups, failed_lookups;
+  gint i;
+
+  if (!self->profile_sample_rate)
+    return;
+
+  lookups = pattern_db_get_profiled_lookups(self->db, &failed_lookups);
+  if (!lookups)
+    return;
+
+  items = g_array_new(FALSE, FALSE, sizeof(LogDBParserProfileItem));
+  pattern_db_foreach_profile_entry(self->db, _collect_profile_item, items);
+  g_array_sort(items, _compare_profile_items);
+
+  msg_notice("db-parser() lookup profile",
+             evt_tag_str("file", self->db_file),
+             evt_tag_printf("sampled_lookups", "%" G_GUINT64_FORMAT, lookups),
+             evt_tag_printf("unmatched_lookups", "%" G_GUINT64_FORMAT, failed_lookups),
+             NULL);
+  for (i = 0; i < items->len; i++)
+    {
+      LogDBParserProfileItem *item = &g_array_index(items, LogDBParserProfileItem, i);
+
+      if (i < LOG_DB_PARSER_PROFILE_REPORT_SIZE)
+        msg_notice("db-parser() expensive rule",
+                   evt_tag_str("rule_id", item->rule_id),
+                   evt_tag_str("program", item->program),
+                   evt_tag_printf("matches", "%" G_GUINT64_FORMAT, item->entry.matches),
+                   evt_tag_printf("parser_attempts", "%" G_GUINT64_FORMAT, item->entry.match_parser_attempts),
+                   evt_tag_printf("parser_failures", "%" G_GUINT64_FORMAT, item->entry.match_parser_failures),
+                   NULL);
+      g_free(item->rule_id);
+      g_free(item->program);
+    }
+  g_array_free(items, TRUE);
+  pattern_db_reset_profile(self->db);
+}
+
 static void
 log_db_parser_emit(LogMessage *msg, gboolean synthetic, gpointer user_data)
 {
@@ -81,6 +169,7 @@ log_db_parser_reload_database(LogDBParser *self)
   self->db_file_inode = st.st_ino;
   self->db_file_mtime = st.st_mtime;
 
+  log_db_parser_report_profile(self);
   if (!pattern_db_reload_ruleset(self->db, cfg, self->db_file))
     {
       msg_error("Error reloading pattern database, no automatic reload will be performed", NULL);
@@ -97,6 +186,48 @@ log_db_parser_reload_database(LogDBParser *self)
 
 }
 
+static gpointer
+log_db_parser_reload_thread(gpointer s)
+{
+  LogDBParser *self = (LogDBParser *) s;
+
+  log_db_parser_reload_database(self);
+
+  g_static_mutex_lock(&self->lock);
+  self->db_file_reloading = FALSE;
+  g_static_mutex_unlock(&self->lock);
+  return NULL;
+}
+
+/*
+ * Loading a large pattern database takes a while, so it is done in a
+ * separate thread, while messages continue to be classified by the old
+ * ruleset.  pattern_db_reload_ruleset() swaps in the new one once it is
+ * completely built.
+ *
+ * NOTE: must be called with db_file_reloading set
+ */
+static void
+log_db_parser_start_reload(LogDBParser *self)
+{
+  if (self->reload_thread)
+    g_thread_join(self->reload_thread);
+
+  self->reload_thread = g_thread_create(log_db_parser_reload_thread, self, TRUE, NULL);
+  if (!self->reload_thread)
+    log_db_parser_reload_thread(self);
+}
+
+static void
+log_db_parser_wait_for_reload(LogDBParser *self)
+{
+  if (self->reload_thread)
+    {
+      g_thread_join(self->reload_thread);
+      self->reload_thread = NULL;
+    }
+}
+
 static void
 log_db_parser_timer_tick(gpointer s)
 {
@@ -148,7 +279,10 @@ log_db_parser_init(LogPipe *s)
       log_db_parser_reload_database(self);
     }
   if (self->db)
-    pattern_db_set_emit_func(self->db, log_db_parser_emit, self);
+    {
+      pattern_db_set_emit_func(self->db, log_db_parser_emit, self);
+      pattern_db_set_profile_sample_rate(self->db, self->profile_sample_rate);
+    }
   iv_validate_now();
   IV_TIMER_INIT(&self->tick);
   self->tick.cookie = self;
@@ -173,6 +307,8 @@ log_db_parser_deinit(LogPipe *s)
       iv_timer_unregister(&self->tick);
     }
 
+  log_db_parser_wait_for_reload(self);
+  log_db_parser_report_profile(self);
   cfg_persist_config_add(cfg, log_db_parser_format_persist_name(self), self->db, (GDestroyNotify) pattern_db_free, FALSE);
   self->db = NULL;
   return TRUE;
@@ -197,11 +333,11 @@ log_db_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *pat
           self->db_file_reloading = TRUE;
           g_static_mutex_unlock(&self->lock);
 
-          /* only one thread may come here, the others may continue to use self->db, until we update it here. */
-          log_db_parser_reload_database(self);
+          /* only one thread may come here, the others may continue to use
+           * self->db, the reload thread clears db_file_reloading when done. */
+          log_db_parser_start_reload(self);
 
           g_static_mutex_lock(&self->lock);
-          self->db_file_reloading = FALSE;
         }
       g_static_mutex_unlock(&self->lock);
     }
@@ -225,6 +361,12 @@ log_db_parser_set_db_file(LogDBParser *self, const gchar *db_file)
   self->db_file = g_strdup(db_file);
 }
 
+void
+log_db_parser_set_profile_sample_rate(LogDBParser *self, guint sample_rate)
+{
+  self->profile_sample_rate = sample_rate;
+}
+
 /*
  * NOTE: we could be smarter than this by sharing the radix tree in this case.
  */
@@ -236,6 +378,7 @@ log_db_parser_clone(LogPipe *s)
 
   cloned = (LogDBParser *) log_db_parser_new(s->cfg);
   log_db_parser_set_db_file(cloned, self->db_file);
+  log_db_parser_set_profile_sample_rate(cloned, self->profile_sample_rate);
   return &cloned->super.super.super;
 }
 
@@ -244,6 +387,7 @@ log_db_parser_free(LogPipe *s)
 {
   LogDBParser *self = (LogDBParser *) s;
 
+  log_db_parser_wait_for_reload(self);
   g_static_mutex_free(&self->lock);
 
   if (self->db)
@@ -33,6 +33,7 @@
 typedef struct _LogDBParser LogDBParser;
 
 void log_db_parser_set_db_file(LogDBParser *self, const gchar *db_file);
+void log_db_parser_set_profile_sample_rate(LogDBParser *self, guint sample_rate);
 LogParser *log_db_parser_new(GlobalConfig *cfg);
 
 void log_pattern_database_init(void);
@@ -27,7 +27,33 @@
 #include "messages.h"
 #include "str-utils.h"
 #include "filter/filter-expr.h"
+#include "stats/stats-registry.h"
 #include <iv.h>
+#include <iv_list.h>
+#include <string.h>
+
+/*
+ * Memory budget
+ * =============
+ *
+ * With max-context-memory() set, the memory held by the open contexts (the
+ * context itself and the messages collected into it) is accounted and once
+ * it exceeds the budget, contexts are closed early, emitting their
+ * aggregate just as if they had timed out.  The victim is chosen by
+ * eviction-policy(): the context opened first ("oldest") or the one that
+ * received a message the longest time ago ("lru").
+ *
+ * Contexts inherited from a previous configuration through the persistent
+ * config are not accounted.
+ */
+
+typedef struct _GroupingByContext
+{
+  CorrellationContext super;
+  /* position in GroupingBy->contexts, empty if not accounted */
+  struct iv_list_head list;
+  gsize memory_size;
+} GroupingByContext;
 
 typedef struct _GroupingBy
 {
@@ -45,6 +71,14 @@ typedef struct _GroupingBy
   FilterExprNode *trigger_condition_expr;
   FilterExprNode *where_condition_expr;
   FilterExprNode *having_condition_expr;
+  gsize max_context_memory;
+  GroupingByEvictionPolicy eviction_policy;
+  /* accounted contexts in eviction order */
+  struct iv_list_head contexts;
+  gsize context_memory;
+  StatsCounterItem *active_contexts;
+  StatsCounterItem *evicted_contexts;
+  StatsCounterItem *context_memory_usage;
 } GroupingBy;
 
 static NVHandle context_id_handle = 0;
@@ -106,6 +140,32 @@ grouping_by_set_having_condition(LogParser *s, FilterExprNode *filter_expr)
   self->having_condition_expr = filter_expr;
 }
 
+void
+grouping_by_set_max_context_memory(LogParser *s, gsize max_context_memory)
+{
+  GroupingBy *self = (GroupingBy *) s;
+
+  self->max_context_memory = max_context_memory;
+}
+
+void
+grouping_by_set_eviction_policy(LogParser *s, GroupingByEvictionPolicy eviction_policy)
+{
+  GroupingBy *self = (GroupingBy *) s;
+
+  self->eviction_policy = eviction_policy;
+}
+
+gint
+grouping_by_lookup_eviction_policy(const gchar *eviction_policy)
+{
+  if (strcasecmp(eviction_policy, "oldest") == 0)
+    return GBE_OLDEST;
+  else if (strcasecmp(eviction_policy, "lru") == 0)
+    return GBE_LRU;
+  return -1;
+}
+
 void
 grouping_by_set_synthetic_message(LogParser *s, SyntheticMessage *message)
 {
@@ -229,6 +289,88 @@ grouping_by_emit_synthetic(GroupingBy *self, CorrellationContext *context)
     }
 }
 
+static GroupingByContext *
+grouping_by_context_new(GroupingBy *self, CorrellationKey *key)
+{
+  GroupingByContext *context = g_new0(GroupingByContext, 1);
+
+  correllation_context_init(&context->super, key);
+  INIT_IV_LIST_HEAD(&context->list);
+  context->memory_size = sizeof(*context) + strlen(key->session_id);
+
+  iv_list_add_tail(&context->list, &self->contexts);
+  self->context_memory += context->memory_size;
+  stats_counter_inc(self->active_contexts);
+  return context;
+}
+
+static void
+_untrack_context(GroupingBy *self, GroupingByContext *context)
+{
+  if (iv_list_empty(&context->list))
+    return;
+
+  iv_list_del_init(&context->list);
+  self->context_memory -= context->memory_size;
+  stats_counter_dec(self->active_contexts);
+  stats_counter_set(self->context_memory_usage, self->context_memory);
+}
+
+static void
+_account_message(GroupingBy *self, GroupingByContext *context, LogMessage *msg)
+{
+  gsize size;
+
+  if (iv_list_empty(&context->list))
+    return;
+
+  size = sizeof(gpointer) + log_msg_get_memory_size(msg);
+  context->memory_size += size;
+  self->context_memory += size;
+  stats_counter_set(self->context_memory_usage, self->context_memory);
+
+  if (self->eviction_policy == GBE_LRU)
+    {
+      iv_list_del(&context->list);
+      iv_list_add_tail(&context->list, &self->contexts);
+    }
+}
+
+static void grouping_by_expire_entry(TimerWheel *wheel, guint64 now, gpointer user_data);
+
+/* closes contexts other than @current until the memory held by the
+ * contexts gets below max-context-memory() */
+static void
+_enforce_context_memory_budget(GroupingBy *self, GroupingByContext *current)
+{
+  gchar buf[256];
+
+  while (self->max_context_memory && self->context_memory > self->max_context_memory)
+    {
+      struct iv_list_head *victim_link = self->contexts.next;
+      GroupingByContext *victim;
+
+      if (victim_link == &current->list)
+        victim_link = victim_link->next;
+      if (victim_link == &self->contexts)
+        break;
+
+      victim = iv_list_entry(victim_link, GroupingByContext, list);
+      msg_debug("groupingby() memory budget exceeded, closing context early",
+                evt_tag_str("key", victim->super.key.session_id),
+                evt_tag_long("context_memory", (long) self->context_memory),
+                evt_tag_long("max_context_memory", (long) self->max_context_memory),
+                evt_tag_str("location",
+                            log_expr_node_format_location(self->super.super.super.expr_node,
+                                                          buf, sizeof(buf))),
+                NULL);
+      stats_counter_inc(self->evicted_contexts);
+      if (victim->super.timer)
+        timer_wheel_del_timer(self->timer_wheel, victim->super.timer);
+      grouping_by_expire_entry(self->timer_wheel, timer_wheel_get_time(self->timer_wheel), &victim->super);
+    }
+}
+
 static void
 grouping_by_expire_entry(TimerWheel *wheel, guint64 now, gpointer user_data)
 {
@@ -244,6 +386,7 @@ grouping_by_expire_entry(TimerWheel *wheel, guint64 now, gpointer user_data)
                                                       buf, sizeof(buf))),
             NULL);
   grouping_by_emit_synthetic(self, context);
+  _untrack_context(self, (GroupingByContext *) context);
   g_hash_table_remove(self->correllation->state, &context->key);
 
   /* correllation_context_free is automatically called when returning from
@@ -289,7 +432,7 @@ _perform_groupby(GroupingBy *self, LogMessage *msg)
                                 log_expr_node_format_location(self->super.super.super.expr_node,
                                                               buf, sizeof(buf))),
                     NULL);
-          context = correllation_context_new(&key);
+          context = &grouping_by_context_new(self, &key)->super;
           g_hash_table_insert(self->correllation->state, &context->key, context);
           g_string_steal(buffer);
         }
@@ -307,6 +450,8 @@ _perform_groupby(GroupingBy *self, LogMessage *msg)
         }
 
       g_ptr_array_add(context->messages, log_msg_ref(msg));
+      _account_message(self, (GroupingByContext *) context, msg);
+      _enforce_context_memory_budget(self, (GroupingByContext *) context);
 
       if (self->trigger_condition_expr &&
           filter_expr_eval(self->trigger_condition_expr, msg))
@@ -375,6 +520,7 @@ grouping_by_init(LogPipe *s)
 {
   GroupingBy *self = (GroupingBy *) s;
   GlobalConfig *cfg = log_pipe_get_config(s);
+  gchar buf[256];
 
   self->correllation = cfg_persist_config_fetch(cfg, grouping_by_format_persist_name(self));
   if (!self->correllation)
@@ -389,6 +535,13 @@ grouping_by_init(LogPipe *s)
   self->tick.expires.tv_sec++;
   self->tick.expires.tv_nsec = 0;
   iv_timer_register(&self->tick);
+
+  stats_lock();
+  log_expr_node_format_location(self->super.super.super.expr_node, buf, sizeof(buf));
+  stats_register_counter(0, SCS_GROUPING_BY, NULL, buf, SC_TYPE_STORED, &self->active_contexts);
+  stats_register_counter(0, SCS_GROUPING_BY, NULL, buf, SC_TYPE_EVICTED, &self->evicted_contexts);
+  stats_register_counter(0, SCS_GROUPING_BY, NULL, buf, SC_TYPE_MEMORY_USAGE, &self->context_memory_usage);
+  stats_unlock();
   return TRUE;
 }
 
@@ -397,12 +550,24 @@ grouping_by_deinit(LogPipe *s)
 {
   GroupingBy *self = (GroupingBy *) s;
   GlobalConfig *cfg = log_pipe_get_config(s);
+  gchar buf[256];
 
   if (iv_timer_registered(&self->tick))
     {
       iv_timer_unregister(&self->tick);
     }
 
+  /* the contexts outlive us in the persistent config, stop accounting them */
+  while (!iv_list_empty(&self->contexts))
+    _untrack_context(self, iv_list_entry(self->contexts.next, GroupingByContext, list));
+
+  stats_lock();
+  log_expr_node_format_location(self->super.super.super.expr_node, buf, sizeof(buf));
+  stats_unregister_counter(SCS_GROUPING_BY, NULL, buf, SC_TYPE_STORED, &self->active_contexts);
+  stats_unregister_counter(SCS_GROUPING_BY, NULL, buf, SC_TYPE_EVICTED, &self->evicted_contexts);
+  stats_unregister_counter(SCS_GROUPING_BY, NULL, buf, SC_TYPE_MEMORY_USAGE, &self->context_memory_usage);
+  stats_unlock();
+
   cfg_persist_config_add(cfg, grouping_by_format_persist_name(self), self->correllation, (GDestroyNotify) correllation_state_free, FALSE);
   self->correllation = NULL;
   return TRUE;
@@ -418,6 +583,8 @@ grouping_by_clone(LogPipe *s)
   cloned = grouping_by_new(s->cfg);
   grouping_by_set_key_template(cloned, self->key_template);
   grouping_by_set_timeout(cloned, self->timeout);
+  grouping_by_set_max_context_memory(cloned, self->max_context_memory);
+  grouping_by_set_eviction_policy(cloned, self->eviction_policy);
   return &cloned->super;
 }
 
@@ -448,6 +615,8 @@ grouping_by_new(GlobalConfig *cfg)
   g_static_mutex_init(&self->lock);
   self->scope = RCS_GLOBAL;
   self->synthetic_message_inherit_mode = RAC_MSG_INHERIT_CONTEXT;
+  self->eviction_policy = GBE_OLDEST;
+  INIT_IV_LIST_HEAD(&self->contexts);
   self->timer_wheel = timer_wheel_new();
   timer_wheel_set_associated_data(self->timer_wheel, self, NULL);
   cached_g_current_time(&self->last_tick);
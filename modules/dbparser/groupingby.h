@@ -26,6 +26,12 @@
 #include "synthetic-message.h"
 #include "filter/filter-expr.h"
 
+typedef enum
+{
+  GBE_OLDEST,
+  GBE_LRU,
+} GroupingByEvictionPolicy;
+
 void grouping_by_set_key_template(LogParser *s, LogTemplate *context_id);
 void grouping_by_set_timeout(LogParser *s, gint timeout);
 void grouping_by_set_scope(LogParser *s, CorrellationScope scope);
@@ -34,6 +40,9 @@ void grouping_by_set_trigger_condition(LogParser *s, FilterExprNode *filter_expr
 void grouping_by_set_where_condition(LogParser *s, FilterExprNode *filter_expr);
 void grouping_by_set_having_condition(LogParser *s, FilterExprNode *filter_expr);
 void grouping_by_set_inherit_properties(LogParser *s, SyntheticMessageInheritMode inherit_mode);
+void grouping_by_set_max_context_memory(LogParser *s, gsize max_context_memory);
+void grouping_by_set_eviction_policy(LogParser *s, GroupingByEvictionPolicy eviction_policy);
+gint grouping_by_lookup_eviction_policy(const gchar *eviction_policy);
 LogParser *grouping_by_new(GlobalConfig *cfg);
 void grouping_by_global_init(void);
 
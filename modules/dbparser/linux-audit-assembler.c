@@ -0,0 +1,475 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "linux-audit-assembler.h"
+#include "timerwheel.h"
+#include "timeutils.h"
+#include "messages.h"
+#include <iv.h>
+#include <iv_list.h>
+#include <string.h>
+
+/*
+ * linux-audit-assembler()
+ * =======================
+ *
+ * The kernel emits a single audit event as a series of records (SYSCALL,
+ * CWD, PATH, ...), all carrying the same "audit(<timestamp>:<serial>)"
+ * identifier and, for multi-record events, terminated by an EOE record.
+ * This parser collects the records of an event and emits them as one
+ * message once the EOE record arrives, the event times out or it is
+ * evicted to make room for a new one.  The records themselves are
+ * absorbed (the parser returns FALSE for them), messages without an audit
+ * identifier are passed through untouched.
+ *
+ * The emitted message is a copy of the first record with $MESSAGE set to
+ * the records joined by newlines, ${.audit.event_id} set to the event
+ * identifier and ${.audit.records} to the number of records.
+ *
+ * Locking
+ * =======
+ *
+ * Just like the correllation state of db-parser(), the open events are
+ * split into shards by the hash of their identifier, each shard having its
+ * own lock, hash table, timer wheel and eviction list.  Records of
+ * different events are thus assembled in parallel, as opposed to
+ * grouping-by(), which serializes all its messages on a single lock.
+ * Shard locks are never nested.
+ *
+ * Closed events are only unlinked while the shard lock is held, they are
+ * emitted once it is released, see linux_audit_assembler_unlock_shard().
+ */
+
+#define LINUX_AUDIT_ASSEMBLER_SHARDS 16
+#define LINUX_AUDIT_MAX_EVENT_ID_LEN 64
+
+typedef struct _LinuxAuditAssembler LinuxAuditAssembler;
+
+typedef struct _LinuxAuditEvent
+{
+  /* position in LinuxAuditShard->events_by_age */
+  struct iv_list_head list;
+  gchar *event_id;
+  TWEntry *timer;
+  /* the first record, the emitted message is based on it */
+  LogMessage *first;
+  GString *records;
+  gint num_records;
+} LinuxAuditEvent;
+
+typedef struct _LinuxAuditShard
+{
+  GStaticMutex lock;
+  GHashTable *events;
+  TimerWheel *timer_wheel;
+  /* open events in the order they were opened, the head is evicted first */
+  struct iv_list_head events_by_age;
+  gint num_events;
+  /* closed events yet to be emitted */
+  GPtrArray *closed;
+} LinuxAuditShard;
+
+struct _LinuxAuditAssembler
+{
+  StatefulParser super;
+  struct iv_timer tick;
+  gint timeout;
+  gint max_events;
+  LinuxAuditShard shards[LINUX_AUDIT_ASSEMBLER_SHARDS];
+};
+
+static NVHandle event_id_handle;
+static NVHandle records_handle;
+
+void
+linux_audit_assembler_set_timeout(LogParser *s, gint timeout)
+{
+  LinuxAuditAssembler *self = (LinuxAuditAssembler *) s;
+
+  self->timeout = timeout;
+}
+
+void
+linux_audit_assembler_set_max_events(LogParser *s, gint max_events)
+{
+  LinuxAuditAssembler *self = (LinuxAuditAssembler *) s;
+
+  self->max_events = max_events;
+}
+
+/*
+ * Finds the "audit(...)" identifier in @record and tells whether it is the
+ * EOE record closing a multi-record event.  Both the auditd log format
+ * ("type=EOE msg=audit(...): ") and the kernel's own ("audit: type=1320
+ * audit(...): ") are recognized.
+ */
+static gboolean
+_extract_event_id(const gchar *record, gsize record_len, gchar *event_id, gboolean *end_of_event)
+{
+  const gchar *start, *end, *type;
+  gsize len;
+
+  start = g_strstr_len(record, record_len, "audit(");
+  if (!start)
+    return FALSE;
+  start += 6;
+
+  end = memchr(start, ')', record_len - (start - record));
+  if (!end)
+    return FALSE;
+
+  len = end - start;
+  if (len == 0 || len >= LINUX_AUDIT_MAX_EVENT_ID_LEN || !memchr(start, ':', len))
+    return FALSE;
+
+  memcpy(event_id, start, len);
+  event_id[len] = 0;
+
+  *end_of_event = FALSE;
+  type = g_strstr_len(record, start - record, "type=");
+  if (type)
+    {
+      type += 5;
+      *end_of_event = (strncmp(type, "EOE ", 4) == 0 || strncmp(type, "1320 ", 5) == 0);
+    }
+  return TRUE;
+}
+
+static void
+_free_event(LinuxAuditEvent *event)
+{
+  log_msg_unref(event->first);
+  g_string_free(event->records, TRUE);
+  g_free(event->event_id);
+  g_free(event);
+}
+
+/* NOTE: requires the lock of @shard to be held */
+static void
+_close_event(LinuxAuditShard *shard, LinuxAuditEvent *event)
+{
+  if (event->timer)
+    {
+      timer_wheel_del_timer(shard->timer_wheel, event->timer);
+      event->timer = NULL;
+    }
+  g_hash_table_remove(shard->events, event->event_id);
+  iv_list_del_init(&event->list);
+  shard->num_events--;
+  g_ptr_array_add(shard->closed, event);
+}
+
+/* NOTE: called from timer_wheel_set_time(), with the shard lock held */
+static void
+_expire_event(TimerWheel *wheel, guint64 now, gpointer user_data)
+{
+  LinuxAuditShard *shard = (LinuxAuditShard *) timer_wheel_get_associated_data(wheel);
+  LinuxAuditEvent *event = (LinuxAuditEvent *) user_data;
+
+  msg_debug("Linux audit event timed out, emitting it without an EOE record",
+            evt_tag_str("event_id", event->event_id),
+            evt_tag_int("records", event->num_records),
+            NULL);
+
+  /* the timer entry is freed by the timer wheel once we return */
+  event->timer = NULL;
+  _close_event(shard, event);
+}
+
+static void
+_emit_event(LinuxAuditAssembler *self, LinuxAuditEvent *event)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *msg;
+  gchar buf[16];
+
+  msg = log_msg_clone_cow(event->first, &path_options);
+  log_msg_set_value(msg, LM_V_MESSAGE, event->records->str, event->records->len);
+  log_msg_set_value(msg, event_id_handle, event->event_id, -1);
+  g_snprintf(buf, sizeof(buf), "%d", event->num_records);
+  log_msg_set_value(msg, records_handle, buf, -1);
+
+  stateful_parser_emit_synthetic(&self->super, msg);
+  log_msg_unref(msg);
+}
+
+static LinuxAuditShard *
+linux_audit_assembler_lookup_shard(LinuxAuditAssembler *self, const gchar *event_id)
+{
+  guint hash = g_str_hash(event_id);
+
+  hash ^= hash >> 16;
+  return &self->shards[hash % LINUX_AUDIT_ASSEMBLER_SHARDS];
+}
+
+/* locks @shard and brings its timer wheel up to date */
+static void
+linux_audit_assembler_lock_shard(LinuxAuditAssembler *self, LinuxAuditShard *shard)
+{
+  g_static_mutex_lock(&shard->lock);
+  timer_wheel_set_time(shard->timer_wheel, cached_g_current_time_sec());
+}
+
+/* unlocks @shard and emits the events that were closed while it was held */
+static void
+linux_audit_assembler_unlock_shard(LinuxAuditAssembler *self, LinuxAuditShard *shard)
+{
+  GPtrArray *closed = NULL;
+  gint i;
+
+  if (shard->closed->len > 0)
+    {
+      closed = shard->closed;
+      shard->closed = g_ptr_array_new();
+    }
+  g_static_mutex_unlock(&shard->lock);
+
+  if (!closed)
+    return;
+
+  for (i = 0; i < closed->len; i++)
+    {
+      LinuxAuditEvent *event = (LinuxAuditEvent *) g_ptr_array_index(closed, i);
+
+      _emit_event(self, event);
+      _free_event(event);
+    }
+  g_ptr_array_free(closed, TRUE);
+}
+
+static LinuxAuditEvent *
+_open_event(LinuxAuditAssembler *self, LinuxAuditShard *shard, const gchar *event_id, LogMessage *msg)
+{
+  LinuxAuditEvent *event;
+  gint max_events_per_shard = MAX(self->max_events / LINUX_AUDIT_ASSEMBLER_SHARDS, 1);
+
+  while (shard->num_events >= max_events_per_shard)
+    {
+      LinuxAuditEvent *oldest = iv_list_entry(shard->events_by_age.next, LinuxAuditEvent, list);
+
+      msg_debug("Too many open Linux audit events, emitting the oldest one early",
+                evt_tag_str("event_id", oldest->event_id),
+                evt_tag_int("max_events", self->max_events),
+                NULL);
+      _close_event(shard, oldest);
+    }
+
+  event = g_new0(LinuxAuditEvent, 1);
+  INIT_IV_LIST_HEAD(&event->list);
+  event->event_id = g_strdup(event_id);
+  event->first = log_msg_ref(msg);
+  event->records = g_string_sized_new(1024);
+  event->timer = timer_wheel_add_timer(shard->timer_wheel, self->timeout, _expire_event, event, NULL);
+
+  g_hash_table_insert(shard->events, event->event_id, event);
+  iv_list_add_tail(&event->list, &shard->events_by_age);
+  shard->num_events++;
+  return event;
+}
+
+static gboolean
+linux_audit_assembler_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_options, const gchar *input, gsize input_len)
+{
+  LinuxAuditAssembler *self = (LinuxAuditAssembler *) s;
+  LinuxAuditShard *shard;
+  LinuxAuditEvent *event;
+  gchar event_id[LINUX_AUDIT_MAX_EVENT_ID_LEN];
+  gboolean end_of_event;
+  gboolean opened = FALSE;
+
+  if (!_extract_event_id(input, input_len, event_id, &end_of_event))
+    return TRUE;
+
+  shard = linux_audit_assembler_lookup_shard(self, event_id);
+  linux_audit_assembler_lock_shard(self, shard);
+
+  event = g_hash_table_lookup(shard->events, event_id);
+  if (end_of_event)
+    {
+      /* the EOE record carries no data, it only closes the event */
+      if (event)
+        _close_event(shard, event);
+    }
+  else
+    {
+      if (!event)
+        {
+          event = _open_event(self, shard, event_id, *pmsg);
+          opened = TRUE;
+        }
+      else
+        {
+          g_string_append_c(event->records, '\n');
+        }
+      g_string_append_len(event->records, input, input_len);
+      event->num_records++;
+    }
+
+  linux_audit_assembler_unlock_shard(self, shard);
+
+  /* the first record is kept as the base of the emitted message, others in
+   * the pipeline must not change it under us */
+  if (opened)
+    log_msg_write_protect(*pmsg);
+  return FALSE;
+}
+
+/* closes all open events, used when the configuration is torn down so that
+ * no records are lost */
+static void
+linux_audit_assembler_flush(LinuxAuditAssembler *self)
+{
+  gint i;
+
+  for (i = 0; i < LINUX_AUDIT_ASSEMBLER_SHARDS; i++)
+    {
+      LinuxAuditShard *shard = &self->shards[i];
+
+      g_static_mutex_lock(&shard->lock);
+      while (!iv_list_empty(&shard->events_by_age))
+        _close_event(shard, iv_list_entry(shard->events_by_age.next, LinuxAuditEvent, list));
+      linux_audit_assembler_unlock_shard(self, shard);
+    }
+}
+
+static void
+linux_audit_assembler_timer_tick(gpointer s)
+{
+  LinuxAuditAssembler *self = (LinuxAuditAssembler *) s;
+  gint i;
+
+  for (i = 0; i < LINUX_AUDIT_ASSEMBLER_SHARDS; i++)
+    {
+      linux_audit_assembler_lock_shard(self, &self->shards[i]);
+      linux_audit_assembler_unlock_shard(self, &self->shards[i]);
+    }
+
+  iv_validate_now();
+  self->tick.expires = iv_now;
+  self->tick.expires.tv_sec++;
+  iv_timer_register(&self->tick);
+}
+
+static gboolean
+linux_audit_assembler_init(LogPipe *s)
+{
+  LinuxAuditAssembler *self = (LinuxAuditAssembler *) s;
+
+  iv_validate_now();
+  IV_TIMER_INIT(&self->tick);
+  self->tick.cookie = self;
+  self->tick.handler = linux_audit_assembler_timer_tick;
+  self->tick.expires = iv_now;
+  self->tick.expires.tv_sec++;
+  self->tick.expires.tv_nsec = 0;
+  iv_timer_register(&self->tick);
+  return TRUE;
+}
+
+static gboolean
+linux_audit_assembler_deinit(LogPipe *s)
+{
+  LinuxAuditAssembler *self = (LinuxAuditAssembler *) s;
+
+  if (iv_timer_registered(&self->tick))
+    {
+      iv_timer_unregister(&self->tick);
+    }
+  linux_audit_assembler_flush(self);
+  return TRUE;
+}
+
+static LogPipe *
+linux_audit_assembler_clone(LogPipe *s)
+{
+  LinuxAuditAssembler *self = (LinuxAuditAssembler *) s;
+  LogParser *cloned;
+
+  cloned = linux_audit_assembler_new(s->cfg);
+  log_parser_set_template(cloned, log_template_ref(self->super.super.template));
+  stateful_parser_set_inject_mode(&((LinuxAuditAssembler *) cloned)->super, self->super.inject_mode);
+  linux_audit_assembler_set_timeout(cloned, self->timeout);
+  linux_audit_assembler_set_max_events(cloned, self->max_events);
+  return &cloned->super;
+}
+
+static void
+linux_audit_assembler_free(LogPipe *s)
+{
+  LinuxAuditAssembler *self = (LinuxAuditAssembler *) s;
+  gint i;
+
+  for (i = 0; i < LINUX_AUDIT_ASSEMBLER_SHARDS; i++)
+    {
+      LinuxAuditShard *shard = &self->shards[i];
+
+      /* deinit has already emitted the open events, drop whatever is left */
+      while (!iv_list_empty(&shard->events_by_age))
+        {
+          LinuxAuditEvent *event = iv_list_entry(shard->events_by_age.next, LinuxAuditEvent, list);
+
+          iv_list_del(&event->list);
+          _free_event(event);
+        }
+      timer_wheel_free(shard->timer_wheel);
+      g_hash_table_destroy(shard->events);
+      g_ptr_array_free(shard->closed, TRUE);
+      g_static_mutex_free(&shard->lock);
+    }
+  stateful_parser_free_method(s);
+}
+
+LogParser *
+linux_audit_assembler_new(GlobalConfig *cfg)
+{
+  LinuxAuditAssembler *self = g_new0(LinuxAuditAssembler, 1);
+  gint i;
+
+  stateful_parser_init_instance(&self->super, cfg);
+  self->super.super.super.free_fn = linux_audit_assembler_free;
+  self->super.super.super.init = linux_audit_assembler_init;
+  self->super.super.super.deinit = linux_audit_assembler_deinit;
+  self->super.super.super.clone = linux_audit_assembler_clone;
+  self->super.super.process = linux_audit_assembler_process;
+  self->timeout = 2;
+  self->max_events = 4096;
+
+  for (i = 0; i < LINUX_AUDIT_ASSEMBLER_SHARDS; i++)
+    {
+      LinuxAuditShard *shard = &self->shards[i];
+
+      g_static_mutex_init(&shard->lock);
+      shard->events = g_hash_table_new(g_str_hash, g_str_equal);
+      shard->timer_wheel = timer_wheel_new();
+      timer_wheel_set_associated_data(shard->timer_wheel, shard, NULL);
+      INIT_IV_LIST_HEAD(&shard->events_by_age);
+      shard->closed = g_ptr_array_new();
+    }
+  return &self->super.super;
+}
+
+void
+linux_audit_assembler_global_init(void)
+{
+  event_id_handle = log_msg_get_value_handle(".audit.event_id");
+  records_handle = log_msg_get_value_handle(".audit.records");
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#ifndef PATTERNDB_LINUX_AUDIT_ASSEMBLER_H_INCLUDED
+#define PATTERNDB_LINUX_AUDIT_ASSEMBLER_H_INCLUDED
+
+#include "stateful-parser.h"
+
+void linux_audit_assembler_set_timeout(LogParser *s, gint timeout);
+void linux_audit_assembler_set_max_events(LogParser *s, gint max_events);
+LogParser *linux_audit_assembler_new(GlobalConfig *cfg);
+void linux_audit_assembler_global_init(void);
+
+#endif
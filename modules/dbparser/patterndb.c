@@ -34,6 +34,7 @@
 #include "str-utils.h"
 #include "filter/filter-expr-parser.h"
 #include "logpipe.h"
+#include "tls-support.h"
 
 #include <string.h>
 #include <stdio.h>
@@ -56,16 +57,71 @@ struct _PDBLookupParams
   gssize message_len;
 };
 
+/*
+ * Locking
+ * =======
+ *
+ * The correllation state is split into shards by the hash of the context
+ * key, each shard having its own lock, hash table and timer wheel, so that
+ * messages belonging to different contexts can be processed in parallel.
+ *
+ * The remaining locks are:
+ *
+ *    - ruleset_lock: protects the ruleset pointer, it is only write-locked
+ *      when the ruleset is reloaded, lookups take it for reading, so they
+ *      don't serialize with each other or with the correllation state
+ *
+ *    - time_lock: protects the current time of the correllation engine
+ *      (see below) and last_tick, no other lock is acquired while holding
+ *      it
+ *
+ *    - rate_limits_lock: protects rate_limits, it may be taken while a
+ *      shard lock is held, but no other lock is acquired while holding it
+ *
+ *    - profile_lock: serializes the sampled lookups updating profile, it
+ *      is taken while ruleset_lock is held for reading, no other lock is
+ *      acquired while holding it
+ *
+ * Shard locks are never nested.
+ *
+ * Expiration
+ * ==========
+ *
+ * Timer wheel callbacks only unlink the expired contexts from the shard and
+ * collect them into the shard's expired array, their timeout actions (and
+ * the synthetic messages they emit) are run in a batch once the shard lock
+ * is released, see pattern_db_unlock_shard().
+ */
+
+#define PATTERN_DB_STATE_SHARDS 16
+
+typedef struct _PDBStateShard
+{
+  GStaticMutex lock;
+  PatternDB *pdb;
+  CorrellationState correllation;
+  TimerWheel *timer_wheel;
+  /* expired contexts whose timeout actions are yet to be run */
+  GPtrArray *expired;
+} PDBStateShard;
+
 struct _PatternDB
 {
-  GStaticRWLock lock;
+  GStaticRWLock ruleset_lock;
   PDBRuleSet *ruleset;
-  CorrellationState correllation;
+  PDBStateShard shards[PATTERN_DB_STATE_SHARDS];
+  GStaticMutex rate_limits_lock;
   GHashTable *rate_limits;
-  TimerWheel *timer_wheel;
+  GStaticMutex time_lock;
+  guint64 now;
   GTimeVal last_tick;
   PatternDBEmitFunc emit;
   gpointer emit_data;
+  /* every profile_sample_rate-th lookup is profiled, 0 disables it */
+  guint profile_sample_rate;
+  gint profile_counter;
+  GStaticMutex profile_lock;
+  RProfile *profile;
 };
 
 /*
@@ -99,8 +155,26 @@ struct _PatternDB
  *    2) process an incoming message stream on-line, expiring correllation
  *    states even if there are no incoming messages
  *
+ * The current time is kept in PatternDB.  An incoming message only brings
+ * the timer wheel of the shard it is correllated in up to date, in order
+ * not to expire the contexts of all the other shards on the ingest path.
+ * The timer wheels of all shards are advanced by the timer tick, the
+ * difference of the current time and the wheels is the expiry lag, see
+ * pattern_db_get_expiry_lag().
+ *
  */
 
+static guint64
+pattern_db_get_time(PatternDB *self)
+{
+  guint64 now;
+
+  g_static_mutex_lock(&self->time_lock);
+  now = self->now;
+  g_static_mutex_unlock(&self->time_lock);
+  return now;
+}
+
 
 /**************************************************************************
  * PDBContext, represents a correllation state in the state hash table, is
@@ -187,6 +261,7 @@ pdb_check_action_rate_limit(PDBAction *self, PDBRule *rule, PatternDB *db, LogMe
   CorrellationKey key;
   PDBRateLimit *rl;
   guint64 now;
+  gboolean result = FALSE;
 
   if (self->rate == 0)
     return TRUE;
@@ -194,6 +269,9 @@ pdb_check_action_rate_limit(PDBAction *self, PDBRule *rule, PatternDB *db, LogMe
   g_string_printf(buffer, "%s:%d", rule->rule_id, self->id);
   correllation_key_setup(&key, rule->context_scope, msg, buffer->str);
 
+  now = pattern_db_get_time(db);
+
+  g_static_mutex_lock(&db->rate_limits_lock);
   rl = g_hash_table_lookup(db->rate_limits, &key);
   if (!rl)
     {
@@ -201,7 +279,6 @@ pdb_check_action_rate_limit(PDBAction *self, PDBRule *rule, PatternDB *db, LogMe
       g_hash_table_insert(db->rate_limits, &rl->key, rl);
       g_string_steal(buffer);
     }
-  now = timer_wheel_get_time(db->timer_wheel);
   if (rl->last_check == 0)
     {
       rl->last_check = now;
@@ -225,9 +302,10 @@ pdb_check_action_rate_limit(PDBAction *self, PDBRule *rule, PatternDB *db, LogMe
   if (rl->buckets)
     {
       rl->buckets--;
-      return TRUE;
+      result = TRUE;
     }
-  return FALSE;
+  g_static_mutex_unlock(&db->rate_limits_lock);
+  return result;
 }
 
 gboolean
@@ -313,22 +391,29 @@ pdb_run_rule_actions(PDBRule *self, PatternDB *db, PDBActionTrigger trigger, PDB
  * Adds the values from the given GArray of RParserMatch entries to the NVTable
  * of the passed LogMessage.
  *
+ * @cfg: the configuration of the ruleset, matches nothing refers to are skipped
  * @msg: the LogMessage to add the matches to
  * @matches: an array of RParserMatch entries
  * @ref_handle: if the matches are indirect matches, they are referenced based on this handle (eg. LM_V_MESSAGE)
  **/
 void
-_add_matches_to_message(LogMessage *msg, GArray *matches, NVHandle ref_handle, const gchar *input_string)
+_add_matches_to_message(GlobalConfig *cfg, LogMessage *msg, GArray *matches, NVHandle ref_handle, const gchar *input_string)
 {
   gint i;
   for (i = 0; i < matches->len; i++)
     {
       RParserMatch *match = &g_array_index(matches, RParserMatch, i);
 
-      if (match->match)
+      if (!cfg_is_value_referenced(cfg, match->handle))
+        {
+          g_free(match->match);
+          match->match = NULL;
+        }
+      else if (match->match)
         {
           log_msg_set_value(msg, match->handle, match->match, match->len);
           g_free(match->match);
+          match->match = NULL;
         }
       else if (ref_handle != LM_V_NONE && log_msg_is_handle_settable_with_an_indirect_value(match->handle))
         {
@@ -342,44 +427,151 @@ _add_matches_to_message(LogMessage *msg, GArray *matches, NVHandle ref_handle, c
 }
 
 /*
- * Looks up a matching rule in the ruleset.
+ * Program lookup cache
  *
- * NOTE: it also modifies @msg to store the name-value pairs found during lookup, so
+ * Most messages come from a small number of programs, so the result of
+ * the program tree lookup is cached per thread, in a small direct-mapped
+ * table keyed by the $PROGRAM value and the generation of the ruleset.
+ * A reload creates a new ruleset with a new generation, which
+ * invalidates all the entries without having to touch the other
+ * threads.
+ *
+ * Lookups that extracted name-value pairs from the program name (e.g.
+ * because of a parser in a program pattern) are not cached, as those
+ * would have to be added to the message.  Failed lookups are cached.
+ *
+ * The entries are only dereferenced while the ruleset lock is held, and
+ * only if the ruleset is still of the same generation.
  */
-PDBRule *
-pdb_lookup_ruleset(PDBRuleSet *self, PDBLookupParams *lookup, GArray *dbg_list)
+#define PDB_PROGRAM_CACHE_SIZE 64
+#define PDB_PROGRAM_CACHE_MAX_PROGRAM_LEN 48
+
+typedef struct _PDBProgramCacheEntry
 {
-  RNode *node;
-  LogMessage *msg = lookup->msg;
-  GArray *prg_matches, *matches;
+  gint generation;
+  guint8 program_len;
+  gchar program[PDB_PROGRAM_CACHE_MAX_PROGRAM_LEN];
+  PDBProgram *value;
+} PDBProgramCacheEntry;
+
+TLS_BLOCK_START
+{
+  PDBProgramCacheEntry program_cache[PDB_PROGRAM_CACHE_SIZE];
+  GArray *lookup_matches;
+}
+TLS_BLOCK_END;
+
+#define program_cache __tls_deref(program_cache)
+#define local_lookup_matches __tls_deref(lookup_matches)
+
+/*
+ * The arrays holding the matches of the radix lookups are kept per thread
+ * and reused by the next lookup, instead of allocating a new one for each
+ * program and rule lookup.  A lookup is finished (and its matches added
+ * to the message) before anything else could use the array, e.g. another
+ * db-parser() processing the synthetic messages generated by the rule.
+ */
+static GArray *
+_get_lookup_matches(void)
+{
+  if (!local_lookup_matches)
+    {
+      /* NOTE: We're not using g_array_sized_new as that does not
+       * correctly zero-initialize the new items even if clear_ is TRUE
+       */
+      local_lookup_matches = g_array_new(FALSE, TRUE, sizeof(RParserMatch));
+    }
+  else
+    {
+      g_array_set_size(local_lookup_matches, 0);
+    }
+  return local_lookup_matches;
+}
+
+static inline PDBProgramCacheEntry *
+_lookup_program_cache_entry(const gchar *program, gssize program_len)
+{
+  /* FNV-1a */
+  guint32 hash = 2166136261U;
+  gssize i;
+
+  for (i = 0; i < program_len; i++)
+    {
+      hash ^= (guchar) program[i];
+      hash *= 16777619U;
+    }
+  return &program_cache[hash & (PDB_PROGRAM_CACHE_SIZE - 1)];
+}
+
+/*
+ * Looks up the PDBProgram for the program name of @msg, adds the
+ * name-value pairs extracted from the program name to @msg.
+ */
+static PDBProgram *
+pdb_lookup_program(PDBRuleSet *self, LogMessage *msg, NVHandle program_handle)
+{
+  PDBProgramCacheEntry *entry = NULL;
+  PDBProgram *program = NULL;
   const gchar *program_value;
   gssize program_len;
+  GArray *prg_matches;
+  RNode *node;
 
-  if (G_UNLIKELY(!self->programs))
-    return FALSE;
+  program_value = log_msg_get_value(msg, program_handle, &program_len);
 
-  program_value = log_msg_get_value(msg, lookup->program_handle, &program_len);
-  prg_matches = g_array_new(FALSE, TRUE, sizeof(RParserMatch));
+  if (self->generation && program_len <= PDB_PROGRAM_CACHE_MAX_PROGRAM_LEN)
+    {
+      entry = _lookup_program_cache_entry(program_value, program_len);
+      if (entry->generation == self->generation &&
+          entry->program_len == program_len &&
+          memcmp(entry->program, program_value, program_len) == 0)
+        return entry->value;
+    }
+
+  prg_matches = _get_lookup_matches();
   node = r_find_node(self->programs, (guint8 *) program_value, program_len, prg_matches);
 
   if (node)
     {
-      _add_matches_to_message(msg, prg_matches, lookup->program_handle, program_value);
-      g_array_free(prg_matches, TRUE);
+      program = (PDBProgram *) node->value;
+      _add_matches_to_message(self->cfg, msg, prg_matches, program_handle, program_value);
+    }
+
+  if (entry && prg_matches->len == 0)
+    {
+      entry->generation = self->generation;
+      entry->program_len = program_len;
+      memcpy(entry->program, program_value, program_len);
+      entry->value = program;
+    }
+  return program;
+}
 
-      PDBProgram *program = (PDBProgram *) node->value;
+/*
+ * Looks up a matching rule in the ruleset.
+ *
+ * NOTE: it also modifies @msg to store the name-value pairs found during lookup, so
+ */
+PDBRule *
+pdb_lookup_ruleset(PDBRuleSet *self, PDBLookupParams *lookup, GArray *dbg_list, RProfile *profile)
+{
+  LogMessage *msg = lookup->msg;
+  GArray *matches;
+  PDBProgram *program;
 
+  if (G_UNLIKELY(!self->programs))
+    return FALSE;
+
+  program = pdb_lookup_program(self, msg, lookup->program_handle);
+  if (program)
+    {
       if (program->rules)
         {
           RNode *msg_node;
           const gchar *message;
           gssize message_len;
 
-          /* NOTE: We're not using g_array_sized_new as that does not
-           * correctly zero-initialize the new items even if clear_ is TRUE
-           */
-
-          matches = g_array_new(FALSE, TRUE, sizeof(RParserMatch));
+          matches = _get_lookup_matches();
           g_array_set_size(matches, 1);
 
           if (lookup->message_handle)
@@ -394,13 +586,14 @@ pdb_lookup_ruleset(PDBRuleSet *self, PDBLookupParams *lookup, GArray *dbg_list)
 
           if (G_UNLIKELY(dbg_list))
             msg_node = r_find_node_dbg(program->rules, (guint8 *) message, message_len, matches, dbg_list);
+          else if (G_UNLIKELY(profile))
+            msg_node = r_find_node_prof(program->rules, (guint8 *) message, message_len, matches, profile);
           else
             msg_node = r_find_node(program->rules, (guint8 *) message, message_len, matches);
 
           if (msg_node)
             {
               PDBRule *rule = (PDBRule *) msg_node->value;
-              GString *buffer = g_string_sized_new(32);
 
               msg_debug("patterndb rule matches",
                         evt_tag_str("rule_id", rule->rule_id),
@@ -408,15 +601,13 @@ pdb_lookup_ruleset(PDBRuleSet *self, PDBLookupParams *lookup, GArray *dbg_list)
               log_msg_set_value(msg, class_handle, rule->class ? rule->class : "system", -1);
               log_msg_set_value(msg, rule_id_handle, rule->rule_id, -1);
 
-              _add_matches_to_message(msg, matches, lookup->message_handle, message);
-              g_array_free(matches, TRUE);
+              _add_matches_to_message(self->cfg, msg, matches, lookup->message_handle, message);
 
               if (!rule->class)
                 {
                   log_msg_set_tag_by_id(msg, system_tag);
                 }
               log_msg_clear_tag_by_id(msg, unknown_tag);
-              g_string_free(buffer, TRUE);
               pdb_rule_ref(rule);
               return rule;
             }
@@ -425,13 +616,8 @@ pdb_lookup_ruleset(PDBRuleSet *self, PDBLookupParams *lookup, GArray *dbg_list)
               log_msg_set_value(msg, class_handle, "unknown", 7);
               log_msg_set_tag_by_id(msg, unknown_tag);
             }
-          g_array_free(matches, TRUE);
         }
     }
-  else
-    {
-      g_array_free(prg_matches, TRUE);
-    }
 
   return NULL;
 
@@ -441,8 +627,8 @@ pdb_lookup_ruleset(PDBRuleSet *self, PDBLookupParams *lookup, GArray *dbg_list)
  * PatternDB
  *********************************************************/
 
-/* NOTE: this function requires PatternDB reader/writer lock to be
- * write-locked.
+/* NOTE: this function requires the lock of the shard owning @wheel to be
+ * held.
  *
  * Currently, it is, as timer_wheel_set_time() is only called with that
  * precondition, and timer-wheel callbacks are only called from within
@@ -453,22 +639,87 @@ static void
 pattern_db_expire_entry(TimerWheel *wheel, guint64 now, gpointer user_data)
 {
   PDBContext *context = user_data;
-  PatternDB *pdb = (PatternDB *) timer_wheel_get_associated_data(wheel);
-  GString *buffer = g_string_sized_new(256);
-  LogMessage *msg = correllation_context_get_last_message(&context->super);
+  PDBStateShard *shard = (PDBStateShard *) timer_wheel_get_associated_data(wheel);
 
   msg_debug("Expiring patterndb correllation context",
             evt_tag_str("last_rule", context->rule->rule_id),
-            evt_tag_long("utc", timer_wheel_get_time(pdb->timer_wheel)),
+            evt_tag_long("utc", timer_wheel_get_time(wheel)),
             NULL);
-  if (pdb->emit)
-    pdb_run_rule_actions(context->rule, pdb, RAT_TIMEOUT, context, msg, buffer);
-  g_hash_table_remove(pdb->correllation.state, &context->super.key);
-  g_string_free(buffer, TRUE);
+  g_ptr_array_add(shard->expired, correllation_context_ref(&context->super));
+  g_hash_table_remove(shard->correllation.state, &context->super.key);
 
-  /* pdb_context_free is automatically called when returning from
+  /* the reference held by the timer is dropped when returning from
      this function by the timerwheel code as a destroy notify
-     callback. */
+     callback, the one in shard->expired is dropped once the timeout
+     actions are run. */
+}
+
+/* runs the timeout actions of a batch of expired contexts, must be called
+ * without holding any shard locks */
+static void
+pattern_db_run_expired_actions(PatternDB *self, GPtrArray *expired)
+{
+  GString *buffer = g_string_sized_new(256);
+  gint i;
+
+  for (i = 0; i < expired->len; i++)
+    {
+      PDBContext *context = (PDBContext *) g_ptr_array_index(expired, i);
+      LogMessage *msg = correllation_context_get_last_message(&context->super);
+
+      if (self->emit)
+        pdb_run_rule_actions(context->rule, self, RAT_TIMEOUT, context, msg, buffer);
+      correllation_context_unref(&context->super);
+    }
+  g_ptr_array_free(expired, TRUE);
+  g_string_free(buffer, TRUE);
+}
+
+static PDBStateShard *
+pattern_db_lookup_shard(PatternDB *self, CorrellationKey *key)
+{
+  guint hash = correllation_key_hash(key);
+
+  hash ^= hash >> 16;
+  return &self->shards[hash % PATTERN_DB_STATE_SHARDS];
+}
+
+/* locks @shard and brings its timer wheel up to date */
+static void
+pattern_db_lock_shard(PatternDB *self, PDBStateShard *shard)
+{
+  g_static_mutex_lock(&shard->lock);
+  timer_wheel_set_time(shard->timer_wheel, pattern_db_get_time(self));
+}
+
+/* unlocks @shard and runs the timeout actions of the contexts that expired
+ * while it was held */
+static void
+pattern_db_unlock_shard(PatternDB *self, PDBStateShard *shard)
+{
+  GPtrArray *expired = NULL;
+
+  if (shard->expired->len > 0)
+    {
+      expired = shard->expired;
+      shard->expired = g_ptr_array_new();
+    }
+  g_static_mutex_unlock(&shard->lock);
+
+  if (expired)
+    pattern_db_run_expired_actions(self, expired);
+}
+
+static void
+pattern_db_advance_shards(PatternDB *self)
+{
+  gint i;
+
+  for (i = 0; i < PATTERN_DB_STATE_SHARDS; i++)
+    {
+      pattern_db_lock_shard(self, &self->shards[i]);
+      pattern_db_unlock_shard(self, &self->shards[i]);
+    }
 }
 
 /*
@@ -485,7 +736,7 @@ pattern_db_timer_tick(PatternDB *self)
   GTimeVal now;
   glong diff;
 
-  g_static_rw_lock_writer_lock(&self->lock);
+  g_static_mutex_lock(&self->time_lock);
   cached_g_current_time(&now);
   diff = g_time_val_diff(&now, &self->last_tick);
 
@@ -493,9 +744,9 @@ pattern_db_timer_tick(PatternDB *self)
     {
       glong diff_sec = diff / 1e6;
 
-      timer_wheel_set_time(self->timer_wheel, timer_wheel_get_time(self->timer_wheel) + diff_sec);
+      self->now += diff_sec;
       msg_debug("Advancing patterndb current time because of timer tick",
-                evt_tag_long("utc", timer_wheel_get_time(self->timer_wheel)),
+                evt_tag_long("utc", self->now),
                 NULL);
       /* update last_tick, take the fraction of the seconds not calculated into this update into account */
 
@@ -510,10 +761,25 @@ pattern_db_timer_tick(PatternDB *self)
        */
       self->last_tick = now;
     }
-  g_static_rw_lock_writer_unlock(&self->lock);
+  g_static_mutex_unlock(&self->time_lock);
+
+  /* incoming messages may have moved the time too, which only advanced
+   * the shards they touched */
+  pattern_db_advance_shards(self);
+}
+
+/* moves the correllation time forward by @timeout seconds, used by the unit tests */
+void
+pattern_db_advance_time(PatternDB *self, gint timeout)
+{
+  g_static_mutex_lock(&self->time_lock);
+  self->now += timeout;
+  g_static_mutex_unlock(&self->time_lock);
+
+  pattern_db_advance_shards(self);
 }
 
-/* NOTE: lock should be acquired for writing before calling this function. */
+/* NOTE: no shard locks may be held when calling this function. */
 void
 pattern_db_set_time(PatternDB *self, const LogStamp *ls)
 {
@@ -524,16 +790,52 @@ pattern_db_set_time(PatternDB *self, const LogStamp *ls)
    * that incorrect clocks do not skew the current time know by the
    * correllation engine too much. */
 
+  g_static_mutex_lock(&self->time_lock);
   cached_g_current_time(&now);
   self->last_tick = now;
 
   if (ls->tv_sec < now.tv_sec)
     now.tv_sec = ls->tv_sec;
 
-  timer_wheel_set_time(self->timer_wheel, now.tv_sec);
-  msg_debug("Advancing patterndb current time because of an incoming message",
-            evt_tag_long("utc", timer_wheel_get_time(self->timer_wheel)),
-            NULL);
+  /* time is not allowed to go backwards, just like in the timer wheels */
+  if (now.tv_sec > self->now)
+    {
+      self->now = now.tv_sec;
+      msg_debug("Advancing patterndb current time because of an incoming message",
+                evt_tag_long("utc", self->now),
+                NULL);
+    }
+  g_static_mutex_unlock(&self->time_lock);
+}
+
+/*
+ * Returns the number of seconds the expiration of correllation contexts
+ * is behind the current time of the correllation engine, e.g. the largest
+ * difference between the current time and the timer wheel of a shard that
+ * has contexts in it.  It is usually below the interval of the timer tick.
+ */
+guint64
+pattern_db_get_expiry_lag(PatternDB *self)
+{
+  guint64 now = pattern_db_get_time(self);
+  guint64 lag = 0;
+  gint i;
+
+  for (i = 0; i < PATTERN_DB_STATE_SHARDS; i++)
+    {
+      PDBStateShard *shard = &self->shards[i];
+      guint64 wheel_now;
+
+      g_static_mutex_lock(&shard->lock);
+      if (g_hash_table_size(shard->correllation.state) > 0)
+        {
+          wheel_now = timer_wheel_get_time(shard->timer_wheel);
+          if (now > wheel_now && now - wheel_now > lag)
+            lag = now - wheel_now;
+        }
+      g_static_mutex_unlock(&shard->lock);
+    }
+  return lag;
 }
 
 gboolean
@@ -549,11 +851,12 @@ pattern_db_reload_ruleset(PatternDB *self, GlobalConfig *cfg, const gchar *pdb_f
     }
   else
     {
-      g_static_rw_lock_writer_lock(&self->lock);
+      g_static_rw_lock_writer_lock(&self->ruleset_lock);
       if (self->ruleset)
         pdb_rule_set_free(self->ruleset);
       self->ruleset = new_ruleset;
-      g_static_rw_lock_writer_unlock(&self->lock);
+      pattern_db_reset_profile(self);
+      g_static_rw_lock_writer_unlock(&self->ruleset_lock);
       return TRUE;
     }
 }
@@ -584,10 +887,133 @@ pattern_db_get_ruleset(PatternDB *self)
   return self->ruleset;
 }
 
-TimerWheel *
-pattern_db_get_timer_wheel(PatternDB *self)
+/*
+ * Profiling
+ * =========
+ *
+ * If a sample rate is set, every Nth rule lookup is done using
+ * r_find_node_prof(), counting the visits and the parser runs per radix
+ * tree node in self->profile.  Sampled lookups are serialized by
+ * profile_lock, the rest of the lookups are not affected.  The profile
+ * refers to the nodes of the current ruleset, so it is reset whenever the
+ * ruleset is reloaded.
+ */
+
+void
+pattern_db_set_profile_sample_rate(PatternDB *self, guint sample_rate)
+{
+  g_static_rw_lock_writer_lock(&self->ruleset_lock);
+  self->profile_sample_rate = sample_rate;
+  if (sample_rate && !self->profile)
+    self->profile = r_profile_new();
+  g_static_rw_lock_writer_unlock(&self->ruleset_lock);
+}
+
+static inline gboolean
+_pattern_db_is_lookup_sampled(PatternDB *self)
+{
+  guint rate = self->profile_sample_rate;
+
+  if (G_LIKELY(!rate))
+    return FALSE;
+  return rate == 1 || ((guint) g_atomic_int_exchange_and_add(&self->profile_counter, 1)) % rate == 0;
+}
+
+typedef struct _PDBProfileWalkState
+{
+  PatternDB *self;
+  const gchar *program;
+  PatternDBProfileFunc func;
+  gpointer user_data;
+} PDBProfileWalkState;
+
+static void
+_pattern_db_report_rule_node(RNode *node, const gchar *path, gpointer user_data)
+{
+  PDBProfileWalkState *state = (PDBProfileWalkState *) user_data;
+  RProfileEntry *entry = r_profile_lookup(state->self->profile, node);
+
+  if (entry)
+    state->func(state->program, path, (PDBRule *) node->value, entry, state->user_data);
+}
+
+static void
+_pattern_db_report_program_node(RNode *node, const gchar *path, gpointer user_data)
+{
+  PDBProfileWalkState *state = (PDBProfileWalkState *) user_data;
+  PDBProgram *program = (PDBProgram *) node->value;
+
+  if (!program || !program->rules)
+    return;
+
+  state->program = path;
+  r_walk_tree(program->rules, _pattern_db_report_rule_node, state);
+}
+
+/*
+ * Calls @func for each radix tree node that was visited by a sampled
+ * lookup, along with the program name pattern and the path of the node,
+ * @rule is set for the nodes a rule is attached to.
+ */
+void
+pattern_db_foreach_profile_entry(PatternDB *self, PatternDBProfileFunc func, gpointer user_data)
+{
+  PDBProfileWalkState state = { self, NULL, func, user_data };
+
+  g_static_rw_lock_reader_lock(&self->ruleset_lock);
+  if (self->profile && self->ruleset->programs)
+    {
+      g_static_mutex_lock(&self->profile_lock);
+      r_walk_tree(self->ruleset->programs, _pattern_db_report_program_node, &state);
+      g_static_mutex_unlock(&self->profile_lock);
+    }
+  g_static_rw_lock_reader_unlock(&self->ruleset_lock);
+}
+
+void
+pattern_db_reset_profile(PatternDB *self)
+{
+  g_static_mutex_lock(&self->profile_lock);
+  if (self->profile)
+    r_profile_reset(self->profile);
+  g_static_mutex_unlock(&self->profile_lock);
+}
+
+/* returns the number of sampled lookups, and the number of them not matching any rules */
+guint64
+pattern_db_get_profiled_lookups(PatternDB *self, guint64 *failed_lookups)
+{
+  guint64 lookups = 0;
+
+  *failed_lookups = 0;
+  g_static_mutex_lock(&self->profile_lock);
+  if (self->profile)
+    {
+      lookups = self->profile->lookups;
+      *failed_lookups = self->profile->failed_lookups;
+    }
+  g_static_mutex_unlock(&self->profile_lock);
+  return lookups;
+}
+
+static PDBRule *
+_pattern_db_lookup_rule(PatternDB *self, PDBLookupParams *lookup, GArray *dbg_list)
 {
-  return self->timer_wheel;
+  PDBRule *rule;
+
+  g_static_rw_lock_reader_lock(&self->ruleset_lock);
+  if (G_UNLIKELY(!dbg_list && _pattern_db_is_lookup_sampled(self)))
+    {
+      g_static_mutex_lock(&self->profile_lock);
+      rule = pdb_lookup_ruleset(self->ruleset, lookup, NULL, self->profile);
+      g_static_mutex_unlock(&self->profile_lock);
+    }
+  else
+    {
+      rule = pdb_lookup_ruleset(self->ruleset, lookup, dbg_list, NULL);
+    }
+  g_static_rw_lock_reader_unlock(&self->ruleset_lock);
+  return rule;
 }
 
 static gboolean
@@ -599,16 +1025,15 @@ _pattern_db_process(PatternDB *self, PDBLookupParams *lookup, GArray *dbg_list)
   if (G_UNLIKELY(!self->ruleset))
     return FALSE;
 
-  g_static_rw_lock_reader_lock(&self->lock);
-  rule = pdb_lookup_ruleset(self->ruleset, lookup, dbg_list);
-  g_static_rw_lock_reader_unlock(&self->lock);
+  rule = _pattern_db_lookup_rule(self, lookup, dbg_list);
+
+  pattern_db_set_time(self, &msg->timestamps[LM_TS_STAMP]);
   if (rule)
     {
+      PDBStateShard *shard = NULL;
       PDBContext *context = NULL;
       GString *buffer = g_string_sized_new(32);
 
-      g_static_rw_lock_writer_lock(&self->lock);
-      pattern_db_set_time(self, &msg->timestamps[LM_TS_STAMP]);
       if (rule->context_id_template)
         {
           CorrellationKey key;
@@ -617,17 +1042,20 @@ _pattern_db_process(PatternDB *self, PDBLookupParams *lookup, GArray *dbg_list)
           log_msg_set_value(msg, context_id_handle, buffer->str, -1);
 
           correllation_key_setup(&key, rule->context_scope, msg, buffer->str);
-          context = g_hash_table_lookup(self->correllation.state, &key);
+          shard = pattern_db_lookup_shard(self, &key);
+          pattern_db_lock_shard(self, shard);
+
+          context = g_hash_table_lookup(shard->correllation.state, &key);
           if (!context)
             {
               msg_debug("Correllation context lookup failure, starting a new context",
                         evt_tag_str("rule", rule->rule_id),
                         evt_tag_str("context", buffer->str),
                         evt_tag_int("context_timeout", rule->context_timeout),
-                        evt_tag_int("context_expiration", timer_wheel_get_time(self->timer_wheel) + rule->context_timeout),
+                        evt_tag_int("context_expiration", timer_wheel_get_time(shard->timer_wheel) + rule->context_timeout),
                         NULL);
               context = pdb_context_new(&key);
-              g_hash_table_insert(self->correllation.state, &context->super.key, context);
+              g_hash_table_insert(shard->correllation.state, &context->super.key, context);
               g_string_steal(buffer);
             }
           else
@@ -636,7 +1064,7 @@ _pattern_db_process(PatternDB *self, PDBLookupParams *lookup, GArray *dbg_list)
                         evt_tag_str("rule", rule->rule_id),
                         evt_tag_str("context", buffer->str),
                         evt_tag_int("context_timeout", rule->context_timeout),
-                        evt_tag_int("context_expiration", timer_wheel_get_time(self->timer_wheel) + rule->context_timeout),
+                        evt_tag_int("context_expiration", timer_wheel_get_time(shard->timer_wheel) + rule->context_timeout),
                         evt_tag_int("num_messages", context->super.messages->len),
                         NULL);
             }
@@ -645,11 +1073,11 @@ _pattern_db_process(PatternDB *self, PDBLookupParams *lookup, GArray *dbg_list)
 
           if (context->super.timer)
             {
-              timer_wheel_mod_timer(self->timer_wheel, context->super.timer, rule->context_timeout);
+              timer_wheel_mod_timer(shard->timer_wheel, context->super.timer, rule->context_timeout);
             }
           else
             {
-              context->super.timer = timer_wheel_add_timer(self->timer_wheel, rule->context_timeout, pattern_db_expire_entry,
+              context->super.timer = timer_wheel_add_timer(shard->timer_wheel, rule->context_timeout, pattern_db_expire_entry,
                                                      correllation_context_ref(&context->super),
                                                      (GDestroyNotify) correllation_context_unref);
             }
@@ -666,26 +1094,31 @@ _pattern_db_process(PatternDB *self, PDBLookupParams *lookup, GArray *dbg_list)
         }
 
       synthetic_message_apply(&rule->msg, &context->super, msg, buffer);
+
+      /* the context may expire in another thread as soon as we release
+       * the shard, keep it alive until the actions are run */
+      if (context)
+        correllation_context_ref(&context->super);
+      if (shard)
+        pattern_db_unlock_shard(self, shard);
+
       if (self->emit)
         {
-          g_static_rw_lock_writer_unlock(&self->lock);
           self->emit(msg, FALSE, self->emit_data);
           pdb_run_rule_actions(rule, self, RAT_MATCH, context, msg, buffer);
-          g_static_rw_lock_writer_lock(&self->lock);
         }
       pdb_rule_unref(rule);
-      g_static_rw_lock_writer_unlock(&self->lock);
 
       if (context)
-        log_msg_write_protect(msg);
+        {
+          log_msg_write_protect(msg);
+          correllation_context_unref(&context->super);
+        }
 
       g_string_free(buffer, TRUE);
     }
   else
     {
-      g_static_rw_lock_writer_lock(&self->lock);
-      pattern_db_set_time(self, &msg->timestamps[LM_TS_STAMP]);
-      g_static_rw_lock_writer_unlock(&self->lock);
       if (self->emit)
         self->emit(msg, FALSE, self->emit_data);
     }
@@ -734,58 +1167,102 @@ pattern_db_debug_ruleset(PatternDB *self, LogMessage *msg, GArray *dbg_list)
 void
 pattern_db_expire_state(PatternDB *self)
 {
-  g_static_rw_lock_writer_lock(&self->lock);
-  timer_wheel_expire_all(self->timer_wheel);
-  g_static_rw_lock_writer_unlock(&self->lock);
+  gint i;
+
+  for (i = 0; i < PATTERN_DB_STATE_SHARDS; i++)
+    {
+      PDBStateShard *shard = &self->shards[i];
+
+      pattern_db_lock_shard(self, shard);
+      timer_wheel_expire_all(shard->timer_wheel);
+      pattern_db_unlock_shard(self, shard);
+    }
 }
 
 static void
-_init_state(PatternDB *self)
+_init_shard_state(PatternDB *self, PDBStateShard *shard)
 {
-  self->rate_limits = g_hash_table_new_full(correllation_key_hash, correllation_key_equal, NULL, (GDestroyNotify) pdb_rate_limit_free);
-  correllation_state_init_instance(&self->correllation);
-  self->timer_wheel = timer_wheel_new();
-  timer_wheel_set_associated_data(self->timer_wheel, self, NULL);
+  correllation_state_init_instance(&shard->correllation);
+  shard->timer_wheel = timer_wheel_new();
+  timer_wheel_set_associated_data(shard->timer_wheel, shard, NULL);
+  timer_wheel_set_time(shard->timer_wheel, pattern_db_get_time(self));
+  shard->expired = g_ptr_array_new();
 }
 
 static void
-_destroy_state(PatternDB *self)
+_destroy_shard_state(PDBStateShard *shard)
 {
-  if (self->timer_wheel)
-    timer_wheel_free(self->timer_wheel);
-
-  g_hash_table_destroy(self->rate_limits);
-  correllation_state_deinit_instance(&self->correllation);
+  if (shard->timer_wheel)
+    timer_wheel_free(shard->timer_wheel);
+  if (shard->expired)
+    {
+      g_ptr_array_foreach(shard->expired, (GFunc) correllation_context_unref, NULL);
+      g_ptr_array_free(shard->expired, TRUE);
+    }
+  correllation_state_deinit_instance(&shard->correllation);
 }
 
 void
 pattern_db_forget_state(PatternDB *self)
 {
-  g_static_rw_lock_writer_lock(&self->lock);
-  _destroy_state(self);
-  _init_state(self);
-  g_static_rw_lock_writer_unlock(&self->lock);
+  gint i;
+
+  for (i = 0; i < PATTERN_DB_STATE_SHARDS; i++)
+    {
+      PDBStateShard *shard = &self->shards[i];
+
+      g_static_mutex_lock(&shard->lock);
+      _destroy_shard_state(shard);
+      _init_shard_state(self, shard);
+      g_static_mutex_unlock(&shard->lock);
+    }
+
+  g_static_mutex_lock(&self->rate_limits_lock);
+  g_hash_table_remove_all(self->rate_limits);
+  g_static_mutex_unlock(&self->rate_limits_lock);
 }
 
 PatternDB *
 pattern_db_new(void)
 {
   PatternDB *self = g_new0(PatternDB, 1);
+  gint i;
 
   self->ruleset = pdb_rule_set_new();
-  _init_state(self);
+  self->rate_limits = g_hash_table_new_full(correllation_key_hash, correllation_key_equal, NULL, (GDestroyNotify) pdb_rate_limit_free);
+  for (i = 0; i < PATTERN_DB_STATE_SHARDS; i++)
+    {
+      g_static_mutex_init(&self->shards[i].lock);
+      self->shards[i].pdb = self;
+      _init_shard_state(self, &self->shards[i]);
+    }
   cached_g_current_time(&self->last_tick);
-  g_static_rw_lock_init(&self->lock);
+  g_static_rw_lock_init(&self->ruleset_lock);
+  g_static_mutex_init(&self->rate_limits_lock);
+  g_static_mutex_init(&self->time_lock);
+  g_static_mutex_init(&self->profile_lock);
   return self;
 }
 
 void
 pattern_db_free(PatternDB *self)
 {
+  gint i;
+
   if (self->ruleset)
     pdb_rule_set_free(self->ruleset);
-  _destroy_state(self);
-  g_static_rw_lock_free(&self->lock);
+  for (i = 0; i < PATTERN_DB_STATE_SHARDS; i++)
+    {
+      _destroy_shard_state(&self->shards[i]);
+      g_static_mutex_free(&self->shards[i].lock);
+    }
+  g_hash_table_destroy(self->rate_limits);
+  g_static_rw_lock_free(&self->ruleset_lock);
+  g_static_mutex_free(&self->rate_limits_lock);
+  g_static_mutex_free(&self->time_lock);
+  if (self->profile)
+    r_profile_free(self->profile);
+  g_static_mutex_free(&self->profile_lock);
   g_free(self);
 }
 
@@ -26,6 +26,7 @@
 
 #include "syslog-ng.h"
 #include "pdb-ruleset.h"
+#include "pdb-rule.h"
 #include "timerwheel.h"
 
 typedef struct _PatternDB PatternDB;
@@ -34,12 +35,20 @@ typedef void (*PatternDBEmitFunc)(LogMessage *msg, gboolean synthetic, gpointer
 void pattern_db_set_emit_func(PatternDB *self, PatternDBEmitFunc emit_func, gpointer emit_data);
 
 PDBRuleSet *pattern_db_get_ruleset(PatternDB *self);
-TimerWheel *pattern_db_get_timer_wheel(PatternDB *self);
 const gchar *pattern_db_get_ruleset_version(PatternDB *self);
 const gchar *pattern_db_get_ruleset_pub_date(PatternDB *self);
 gboolean pattern_db_reload_ruleset(PatternDB *self, GlobalConfig *cfg, const gchar *pdb_file);
 
 void pattern_db_timer_tick(PatternDB *self);
+void pattern_db_advance_time(PatternDB *self, gint timeout);
+guint64 pattern_db_get_expiry_lag(PatternDB *self);
+
+typedef void (*PatternDBProfileFunc)(const gchar *program, const gchar *path, PDBRule *rule, RProfileEntry *entry,
+                                     gpointer user_data);
+void pattern_db_set_profile_sample_rate(PatternDB *self, guint sample_rate);
+void pattern_db_foreach_profile_entry(PatternDB *self, PatternDBProfileFunc func, gpointer user_data);
+guint64 pattern_db_get_profiled_lookups(PatternDB *self, guint64 *failed_lookups);
+void pattern_db_reset_profile(PatternDB *self);
 gboolean pattern_db_process(PatternDB *self, LogMessage *msg);
 gboolean pattern_db_process_with_custom_message(PatternDB *self, LogMessage *msg, const gchar *message, gssize message_len);
 void pattern_db_debug_ruleset(PatternDB *self, LogMessage *msg, GArray *dbg_list);
@@ -41,6 +41,7 @@
 #define PTZ_MAXWORDS 512      /* maximum number of words in one line */
 #define PTZ_LOGTABLE_ALLOC_BASE 3000
 #define PTZ_WORDLIST_CACHE 3 /* FIXME: make this a commandline parameter? */
+#define PTZ_STREAMING_BATCH 65536 /* number of lines processed at once in streaming mode */
 
 static LogTagId cluster_tag_id;
 
@@ -90,27 +91,305 @@ ptz_find_delimiters(gchar *str, gchar *delimdef)
   return g_string_free(delimiters, FALSE);
 }
 
+/*
+ * Input
+ *
+ * The counting passes below iterate over a PtzInput, which is either the
+ * messages kept in memory or, in streaming mode, the input files, which are
+ * read again in each pass in PTZ_STREAMING_BATCH sized batches.
+ *
+ * Each batch is split into num_of_threads contiguous ranges, one for each
+ * worker thread.  Every worker has its own state (count tables and
+ * clusters), which are merged once the pass is finished, so the results
+ * are the same regardless of the number of threads.
+ */
+
+typedef struct _PtzInputFile
+{
+  gchar *filename;
+  gboolean no_parse;
+} PtzInputFile;
+
+typedef struct _PtzInput
+{
+  GPtrArray *logs;
+  GPtrArray *files;
+  guint num_of_lines;
+  guint num_of_threads;
+} PtzInput;
+
+typedef void (*PtzProcessFunc)(LogMessage *msg, gpointer user_data);
+
+typedef struct _PtzWorker
+{
+  GPtrArray *logs;
+  guint start, end;
+  PtzProcessFunc func;
+  gpointer user_data;
+} PtzWorker;
+
+static FILE *
+ptz_open_file(const gchar *input_file, GError **error)
+{
+  FILE *file;
+
+  if (strcmp(input_file, "-") == 0)
+    return stdin;
+
+  if (!(file = fopen(input_file, "r")))
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_IO, "Error opening input file %s", input_file);
+  return file;
+}
+
+static void
+ptz_init_parse_options(MsgFormatOptions *parse_options, gboolean no_parse)
+{
+  memset(parse_options, 0, sizeof(*parse_options));
+  msg_format_options_defaults(parse_options);
+  if (no_parse)
+    parse_options->flags |= LP_NOPARSE;
+  else
+    parse_options->flags |= LP_SYSLOG_PROTOCOL;
+  msg_format_options_init(parse_options, configuration);
+}
+
+static LogMessage *
+ptz_parse_line(gchar *line, MsgFormatOptions *parse_options)
+{
+  int len;
+
+  len = strlen(line);
+  if (line[len-1] == '\n')
+    line[len-1] = 0;
+
+  return log_msg_new(line, len, NULL, parse_options);
+}
+
+static gpointer
+ptz_worker_run(gpointer s)
+{
+  PtzWorker *self = (PtzWorker *) s;
+  guint i;
+
+  for (i = self->start; i < self->end; i++)
+    self->func((LogMessage *) g_ptr_array_index(self->logs, i), self->user_data);
+  return NULL;
+}
+
+static void
+ptz_process_batch(GPtrArray *logs, guint num_of_threads, PtzProcessFunc func, gpointer *worker_data)
+{
+  PtzWorker *workers = g_new(PtzWorker, num_of_threads);
+  GThread **threads = g_new(GThread *, num_of_threads);
+  guint chunk, i;
+
+  chunk = (logs->len + num_of_threads - 1) / num_of_threads;
+  for (i = 0; i < num_of_threads; i++)
+    {
+      workers[i].logs = logs;
+      workers[i].start = MIN(i * chunk, logs->len);
+      workers[i].end = MIN((i + 1) * chunk, logs->len);
+      workers[i].func = func;
+      workers[i].user_data = worker_data[i];
+
+      threads[i] = NULL;
+      if (i > 0 && workers[i].start < workers[i].end)
+        threads[i] = g_thread_create(ptz_worker_run, &workers[i], TRUE, NULL);
+      if (i > 0 && !threads[i])
+        ptz_worker_run(&workers[i]);
+    }
+
+  /* the first range is processed by the calling thread */
+  ptz_worker_run(&workers[0]);
+
+  for (i = 1; i < num_of_threads; i++)
+    {
+      if (threads[i])
+        g_thread_join(threads[i]);
+    }
+  g_free(threads);
+  g_free(workers);
+}
+
+static void
+ptz_free_batch(GPtrArray *batch)
+{
+  guint i;
+
+  for (i = 0; i < batch->len; i++)
+    log_msg_unref((LogMessage *) g_ptr_array_index(batch, i));
+  g_ptr_array_set_size(batch, 0);
+}
+
+static gboolean
+ptz_input_foreach(PtzInput *self, PtzProcessFunc func, gpointer *worker_data)
+{
+  GPtrArray *batch;
+  MsgFormatOptions parse_options;
+  gchar line[PTZ_MAXLINELEN];
+  GError *error = NULL;
+  FILE *file;
+  guint i;
+
+  if (self->logs)
+    {
+      ptz_process_batch(self->logs, self->num_of_threads, func, worker_data);
+      return TRUE;
+    }
+
+  batch = g_ptr_array_sized_new(PTZ_STREAMING_BATCH);
+  for (i = 0; i < self->files->len; i++)
+    {
+      PtzInputFile *input_file = (PtzInputFile *) g_ptr_array_index(self->files, i);
+
+      if (!(file = ptz_open_file(input_file->filename, &error)))
+        {
+          msg_error("Error reading patternize input",
+                    evt_tag_str("error", error->message),
+                    NULL);
+          g_clear_error(&error);
+          g_ptr_array_free(batch, TRUE);
+          return FALSE;
+        }
+
+      ptz_init_parse_options(&parse_options, input_file->no_parse);
+      while (fgets(line, PTZ_MAXLINELEN, file))
+        {
+          g_ptr_array_add(batch, ptz_parse_line(line, &parse_options));
+          if (batch->len == PTZ_STREAMING_BATCH)
+            {
+              ptz_process_batch(batch, self->num_of_threads, func, worker_data);
+              ptz_free_batch(batch);
+            }
+        }
+      msg_format_options_destroy(&parse_options);
+      fclose(file);
+    }
+
+  ptz_process_batch(batch, self->num_of_threads, func, worker_data);
+  ptz_free_batch(batch);
+  g_ptr_array_free(batch, TRUE);
+  return TRUE;
+}
+
+static void
+ptz_input_init_logs(PtzInput *self, GPtrArray *logs, guint num_of_threads)
+{
+  self->logs = logs;
+  self->files = NULL;
+  self->num_of_lines = logs->len;
+  self->num_of_threads = MAX(num_of_threads, 1);
+}
+
+/*
+ * Frequent words
+ */
+
+typedef struct _PtzWordCounter
+{
+  gint pass;
+  gboolean two_pass;
+  guint support;
+  gchar *delimiters;
+  /* shared between the workers */
+  gint *wordlist_cache;
+  guint cachesize, cacheseed;
+  GHashTable *wordlist;
+} PtzWordCounter;
+
 gboolean
 ptz_find_frequent_words_remove_key_predicate(gpointer key, gpointer value, gpointer support)
 {
   return (*((guint *) value) < GPOINTER_TO_UINT(support));
 }
 
-GHashTable *
-ptz_find_frequent_words(GPtrArray *logs, guint support, gchar *delimiters, gboolean two_pass)
+static void
+ptz_count_words(LogMessage *msg, gpointer user_data)
 {
-  int i, j, pass;
+  PtzWordCounter *self = (PtzWordCounter *) user_data;
   guint *curr_count;
-  LogMessage *msg;
   gchar *msgstr;
   gssize msglen;
   gchar **words;
+  gchar *hash_key;
+  guint cacheindex = 0;
+  int j;
+
+  msgstr = (gchar *) log_msg_get_value(msg, LM_V_MESSAGE, &msglen);
+
+  words = g_strsplit_set(msgstr, self->delimiters, PTZ_MAXWORDS);
+
+  for (j = 0; words[j]; ++j)
+    {
+      /* NOTE: to calculate the key for the hash, we prefix a word with
+       * its position in the row and a space -- as we always split at
+       * spaces, this should not create confusion
+       */
+      hash_key = g_strdup_printf("%d %s", j, words[j]);
+
+      if (self->two_pass)
+        cacheindex = ptz_str2hash(hash_key, self->cachesize, self->cacheseed);
+
+      if (self->pass == 1)
+        {
+          g_atomic_int_inc(&self->wordlist_cache[cacheindex]);
+        }
+      else if (self->pass == 2)
+        {
+          if (!self->two_pass || self->wordlist_cache[cacheindex] >= self->support)
+            {
+              curr_count = (guint *) g_hash_table_lookup(self->wordlist, hash_key);
+              if (!curr_count)
+                {
+                  guint *currcount_ref = g_new(guint, 1);
+                  (*currcount_ref) = 1;
+                  g_hash_table_insert(self->wordlist, hash_key, currcount_ref);
+                  hash_key = NULL;
+                }
+              else
+                {
+                  (*curr_count)++;
+                }
+            }
+        }
+
+      g_free(hash_key);
+    }
+
+  g_strfreev(words);
+}
+
+/* callback function for g_hash_table_foreach_steal to sum the word counts of a worker into the final one */
+static gboolean
+ptz_merge_word_counts(gpointer _key, gpointer _value, gpointer _target)
+{
+  guint *count = _value;
+  GHashTable *target = _target;
+  guint *target_count;
+
+  target_count = (guint *) g_hash_table_lookup(target, _key);
+  if (!target_count)
+    {
+      g_hash_table_insert(target, _key, count);
+      return TRUE;
+    }
+  (*target_count) += (*count);
+  g_free(_key);
+  g_free(count);
+  return TRUE;
+}
+
+static GHashTable *
+_ptz_find_frequent_words(PtzInput *input, guint support, gchar *delimiters, gboolean two_pass)
+{
+  int i, pass;
   GHashTable *wordlist;
+  PtzWordCounter *counters = g_new(PtzWordCounter, input->num_of_threads);
+  gpointer *worker_data = g_new(gpointer, input->num_of_threads);
   int *wordlist_cache = NULL;
-  guint cachesize = 0, cacheseed = 0, cacheindex = 0;
-  gchar *hash_key;
+  guint cachesize = 0, cacheseed = 0;
 
-  wordlist = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  wordlist = NULL;
 
   for (pass = (two_pass ? 1 : 2); pass <= 2; ++pass)
     {
@@ -120,7 +399,7 @@ ptz_find_frequent_words(GPtrArray *logs, guint support, gchar *delimiters, gbool
                        evt_tag_str("phase", "caching"),
                        NULL);
           srand(time(NULL));
-          cachesize = (guint) ((logs->len * PTZ_WORDLIST_CACHE));
+          cachesize = MAX((guint) ((input->num_of_lines * PTZ_WORDLIST_CACHE)), 1);
           cacheseed = rand();
           wordlist_cache = g_new0(int, cachesize);
         }
@@ -131,64 +410,76 @@ ptz_find_frequent_words(GPtrArray *logs, guint support, gchar *delimiters, gbool
                        NULL);
         }
 
-      for (i = 0; i < logs->len; ++i)
+      for (i = 0; i < input->num_of_threads; i++)
         {
-          msg = (LogMessage *) g_ptr_array_index(logs, i);
-          msgstr = (gchar *) log_msg_get_value(msg, LM_V_MESSAGE, &msglen);
-
-          words = g_strsplit_set(msgstr, delimiters, PTZ_MAXWORDS);
-
-          for (j = 0; words[j]; ++j)
-            {
-              /* NOTE: to calculate the key for the hash, we prefix a word with
-               * its position in the row and a space -- as we always split at
-               * spaces, this should not create confusion
-               */
-              hash_key = g_strdup_printf("%d %s", j, words[j]);
-
-              if (two_pass)
-                cacheindex = ptz_str2hash(hash_key, cachesize, cacheseed);
-
-              if (pass == 1)
-                {
-                  wordlist_cache[cacheindex]++;
-                }
-              else if (pass == 2)
-                {
-                  if (!two_pass || wordlist_cache[cacheindex] >= support)
-                    {
-                      curr_count = (guint *) g_hash_table_lookup(wordlist, hash_key);
-                      if (!curr_count)
-                        {
-                          guint *currcount_ref = g_new(guint, 1);
-                          (*currcount_ref) = 1;
-                          g_hash_table_insert(wordlist, g_strdup(hash_key), currcount_ref);
-                        }
-                      else
-                        {
-                          (*curr_count)++;
-                        }
-                    }
-                }
-
-              g_free(hash_key);
+          counters[i].pass = pass;
+          counters[i].two_pass = two_pass;
+          counters[i].support = support;
+          counters[i].delimiters = delimiters;
+          counters[i].wordlist_cache = wordlist_cache;
+          counters[i].cachesize = cachesize;
+          counters[i].cacheseed = cacheseed;
+          counters[i].wordlist = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+          worker_data[i] = &counters[i];
+        }
 
-            }
+      if (!ptz_input_foreach(input, ptz_count_words, worker_data))
+        {
+          for (i = 0; i < input->num_of_threads; i++)
+            g_hash_table_unref(counters[i].wordlist);
+          wordlist = NULL;
+          break;
+        }
 
-          g_strfreev(words);
+      wordlist = counters[0].wordlist;
+      for (i = 1; i < input->num_of_threads; i++)
+        {
+          g_hash_table_foreach_steal(counters[i].wordlist, ptz_merge_word_counts, wordlist);
+          g_hash_table_unref(counters[i].wordlist);
         }
 
       /* g_hash_table_foreach(wordlist, _ptz_debug_print_word, NULL); */
 
       g_hash_table_foreach_remove(wordlist, ptz_find_frequent_words_remove_key_predicate, GUINT_TO_POINTER(support));
+      if (pass == 1)
+        {
+          g_hash_table_unref(wordlist);
+          wordlist = NULL;
+        }
     }
 
   if (wordlist_cache)
     g_free(wordlist_cache);
+  g_free(worker_data);
+  g_free(counters);
 
   return wordlist;
 }
 
+GHashTable *
+ptz_find_frequent_words(GPtrArray *logs, guint support, gchar *delimiters, gboolean two_pass, guint num_of_threads)
+{
+  PtzInput input;
+
+  ptz_input_init_logs(&input, logs, num_of_threads);
+  return _ptz_find_frequent_words(&input, support, delimiters, two_pass);
+}
+
+/*
+ * Clusters
+ */
+
+typedef struct _PtzClusterFinder
+{
+  /* shared between the workers */
+  GHashTable *wordlist;
+  gchar *delimiters;
+  guint num_of_samples;
+  gboolean keep_loglines;
+  GHashTable *clusters;
+  GString *cluster_key;
+} PtzClusterFinder;
+
 gboolean
 ptz_find_clusters_remove_cluster_predicate(gpointer key, gpointer value, gpointer data)
 {
@@ -200,8 +491,8 @@ ptz_find_clusters_remove_cluster_predicate(gpointer key, gpointer value, gpointe
 
   support = GPOINTER_TO_UINT(data);
 
-  ret = (val->loglines->len < support);
-  if (ret)
+  ret = (val->support < support);
+  if (ret && val->loglines)
     {
       /* remove cluster reference from the relevant logs */
       for (i = 0; i < val->loglines->len; ++i)
@@ -227,113 +518,199 @@ cluster_free(Cluster *cluster)
 
       g_ptr_array_free(cluster->samples, TRUE);
     }
-  g_ptr_array_free(cluster->loglines, TRUE);
+  if (cluster->loglines)
+    g_ptr_array_free(cluster->loglines, TRUE);
   g_strfreev(cluster->words);
   g_free(cluster);
 }
 
-GHashTable *
-ptz_find_clusters_slct(GPtrArray *logs, guint support, gchar *delimiters, guint num_of_samples)
+static void
+ptz_cluster_message(LogMessage *msg, gpointer user_data)
 {
-  GHashTable *wordlist;
-  GHashTable *clusters;
-  int i, j;
-  LogMessage *msg;
+  PtzClusterFinder *self = (PtzClusterFinder *) user_data;
+  GString *cluster_key = self->cluster_key;
+  int j;
   gchar *msgstr;
   gssize msglen;
   gchar **words;
   gchar *hash_key;
   gboolean is_candidate;
   Cluster *cluster;
-  GString *cluster_key;
   gchar * msgdelimiters;
 
-  /* get the frequent word list */
-  wordlist = ptz_find_frequent_words(logs, support, delimiters, TRUE);
-  /* g_hash_table_foreach(wordlist, _ptz_debug_print_word, NULL); */
+  msgstr = (gchar *) log_msg_get_value(msg, LM_V_MESSAGE, &msglen);
 
-  /* find the cluster candidates */
-  clusters = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) cluster_free);
-  cluster_key = g_string_sized_new(0);
-  for (i = 0; i < logs->len; ++i)
-    {
-      msg = (LogMessage *) g_ptr_array_index(logs, i);
-      msgstr = (gchar *) log_msg_get_value(msg, LM_V_MESSAGE, &msglen);
+  g_string_truncate(cluster_key, 0);
 
-      g_string_truncate(cluster_key, 0);
+  words = g_strsplit_set(msgstr, self->delimiters, PTZ_MAXWORDS);
+  msgdelimiters = ptz_find_delimiters(msgstr, self->delimiters);
 
-      words = g_strsplit_set(msgstr, delimiters, PTZ_MAXWORDS);
-      msgdelimiters = ptz_find_delimiters(msgstr, delimiters);
+  is_candidate = FALSE;
+  for (j = 0; words[j]; ++j)
+    {
+      hash_key = g_strdup_printf("%d %s", j, words[j]);
 
-      is_candidate = FALSE;
-      for (j = 0; words[j]; ++j)
+      if (g_hash_table_lookup(self->wordlist, hash_key))
+        {
+          is_candidate = TRUE;
+          g_string_append(cluster_key, hash_key);
+          g_string_append_c(cluster_key, PTZ_SEPARATOR_CHAR);
+        }
+      else
         {
-          hash_key = g_strdup_printf("%d %s", j, words[j]);
+          g_string_append_printf(cluster_key, "%d %c%c", j, PTZ_PARSER_MARKER_CHAR, PTZ_SEPARATOR_CHAR);
+        }
 
-          if (g_hash_table_lookup(wordlist, hash_key))
-            {
-              is_candidate = TRUE;
-              g_string_append(cluster_key, hash_key);
-              g_string_append_c(cluster_key, PTZ_SEPARATOR_CHAR);
-            }
-          else
-            {
-              g_string_append_printf(cluster_key, "%d %c%c", j, PTZ_PARSER_MARKER_CHAR, PTZ_SEPARATOR_CHAR);
-            }
+      g_free(hash_key);
+    }
 
-          g_free(hash_key);
-        }
+  /* append the delimiters of the message to the cluster key to assure unicity
+   * otherwise the same words with different delimiters would still show as the
+   * same cluster
+   */
+  g_string_append_printf(cluster_key, "%s%c", msgdelimiters, PTZ_SEPARATOR_CHAR);
+  g_free(msgdelimiters);
 
-      /* append the delimiters of the message to the cluster key to assure unicity
-       * otherwise the same words with different delimiters would still show as the
-       * same cluster
-       */
-      g_string_append_printf(cluster_key, "%s%c", msgdelimiters, PTZ_SEPARATOR_CHAR);
-      g_free(msgdelimiters);
+  if (is_candidate)
+    {
+      cluster = (Cluster*) g_hash_table_lookup(self->clusters, cluster_key->str);
 
-      if (is_candidate)
-        {
-          cluster = (Cluster*) g_hash_table_lookup(clusters, cluster_key->str);
+      if (!cluster)
+         {
+           cluster = g_new0(Cluster, 1);
 
-          if (!cluster)
+           if (self->num_of_samples > 0)
+             {
+               cluster->samples = g_ptr_array_sized_new(5);
+               g_ptr_array_add(cluster->samples, g_strdup(msgstr));
+             }
+           if (self->keep_loglines)
              {
-               cluster = g_new0(Cluster, 1);
-
-               if (num_of_samples > 0)
-                 {
-                   cluster->samples = g_ptr_array_sized_new(5);
-                   g_ptr_array_add(cluster->samples, g_strdup(msgstr));
-                 }
                cluster->loglines = g_ptr_array_sized_new(64);
                g_ptr_array_add(cluster->loglines, (gpointer) msg);
-               cluster->words = g_strdupv(words);
-
-               g_hash_table_insert(clusters, g_strdup(cluster_key->str), (gpointer) cluster);
              }
-           else
+           cluster->support = 1;
+           cluster->words = g_strdupv(words);
+
+           g_hash_table_insert(self->clusters, g_strdup(cluster_key->str), (gpointer) cluster);
+         }
+       else
+         {
+           if (cluster->loglines)
+             g_ptr_array_add(cluster->loglines, (gpointer) msg);
+           cluster->support++;
+           if (cluster->samples && cluster->samples->len < self->num_of_samples)
              {
-               g_ptr_array_add(cluster->loglines, (gpointer) msg);
-               if (cluster->samples && cluster->samples->len < num_of_samples)
-                 {
-                   g_ptr_array_add(cluster->samples, g_strdup(msgstr));
-                 }
+               g_ptr_array_add(cluster->samples, g_strdup(msgstr));
              }
-          log_msg_set_tag_by_id(msg, cluster_tag_id);
+         }
+      if (self->keep_loglines)
+        log_msg_set_tag_by_id(msg, cluster_tag_id);
+    }
+
+  g_strfreev(words);
+}
+
+/* callback function for g_hash_table_foreach_steal to merge the clusters of a worker into the final ones */
+static gboolean
+ptz_merge_worker_clusters(gpointer _key, gpointer _value, gpointer _target)
+{
+  Cluster *cluster = _value;
+  PtzClusterFinder *target = _target;
+  Cluster *target_cluster;
+  gint i;
+
+  target_cluster = (Cluster *) g_hash_table_lookup(target->clusters, _key);
+  if (!target_cluster)
+    {
+      g_hash_table_insert(target->clusters, _key, cluster);
+      return TRUE;
+    }
+
+  target_cluster->support += cluster->support;
+  if (target_cluster->loglines)
+    {
+      for (i = 0; i < cluster->loglines->len; i++)
+        g_ptr_array_add(target_cluster->loglines, g_ptr_array_index(cluster->loglines, i));
+    }
+  if (target_cluster->samples)
+    {
+      for (i = 0; i < cluster->samples->len && target_cluster->samples->len < target->num_of_samples; i++)
+        {
+          g_ptr_array_add(target_cluster->samples, g_ptr_array_index(cluster->samples, i));
+          g_ptr_array_index(cluster->samples, i) = NULL;
         }
+    }
+  cluster_free(cluster);
+  g_free(_key);
+  return TRUE;
+}
 
-      g_strfreev(words);
+static GHashTable *
+_ptz_find_clusters_slct(PtzInput *input, guint support, gchar *delimiters, guint num_of_samples)
+{
+  GHashTable *wordlist;
+  GHashTable *clusters = NULL;
+  PtzClusterFinder *finders;
+  gpointer *worker_data;
+  gboolean success;
+  int i;
+
+  /* get the frequent word list */
+  wordlist = _ptz_find_frequent_words(input, support, delimiters, TRUE);
+  if (!wordlist)
+    return NULL;
+  /* g_hash_table_foreach(wordlist, _ptz_debug_print_word, NULL); */
+
+  /* find the cluster candidates */
+  finders = g_new(PtzClusterFinder, input->num_of_threads);
+  worker_data = g_new(gpointer, input->num_of_threads);
+  for (i = 0; i < input->num_of_threads; i++)
+    {
+      finders[i].wordlist = wordlist;
+      finders[i].delimiters = delimiters;
+      finders[i].num_of_samples = num_of_samples;
+      finders[i].keep_loglines = input->logs != NULL;
+      finders[i].clusters = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) cluster_free);
+      finders[i].cluster_key = g_string_sized_new(0);
+      worker_data[i] = &finders[i];
     }
 
-  g_hash_table_foreach_remove(clusters, ptz_find_clusters_remove_cluster_predicate, GUINT_TO_POINTER(support));
+  success = ptz_input_foreach(input, ptz_cluster_message, worker_data);
+
+  for (i = 0; i < input->num_of_threads; i++)
+    {
+      if (success && i > 0)
+        g_hash_table_foreach_steal(finders[i].clusters, ptz_merge_worker_clusters, &finders[0]);
+      if (!success || i > 0)
+        g_hash_table_unref(finders[i].clusters);
+      g_string_free(finders[i].cluster_key, TRUE);
+    }
+
+  if (success)
+    {
+      clusters = finders[0].clusters;
+      g_hash_table_foreach_remove(clusters, ptz_find_clusters_remove_cluster_predicate, GUINT_TO_POINTER(support));
+    }
 
   /* g_hash_table_foreach(clusters, _ptz_debug_print_cluster, NULL); */
 
   g_hash_table_unref(wordlist);
-  g_string_free(cluster_key, TRUE);
+  g_free(worker_data);
+  g_free(finders);
 
   return clusters;
 }
 
+GHashTable *
+ptz_find_clusters_slct(GPtrArray *logs, guint support, gchar *delimiters, guint num_of_samples, guint num_of_threads)
+{
+  PtzInput input;
+
+  ptz_input_init_logs(&input, logs, num_of_threads);
+  return _ptz_find_clusters_slct(&input, support, delimiters, num_of_samples);
+}
+
 /* callback function for g_hash_table_foreach_steal to migrate elements from one hash to the other */
 static gboolean
 ptz_merge_clusterlists(gpointer _key, gpointer _value, gpointer _target)
@@ -349,9 +726,23 @@ ptz_merge_clusterlists(gpointer _key, gpointer _value, gpointer _target)
 GHashTable *
 ptz_find_clusters_step(Patternizer *self, GPtrArray *logs, guint support, guint num_of_samples)
 {
-  msg_progress("Searching clusters", evt_tag_int("input lines", logs->len), NULL);
+  PtzInput input;
+
+  if (self->streaming)
+    {
+      input.logs = NULL;
+      input.files = self->input_files;
+      input.num_of_lines = self->num_of_lines;
+      input.num_of_threads = MAX(self->num_of_threads, 1);
+    }
+  else
+    {
+      ptz_input_init_logs(&input, logs, self->num_of_threads);
+    }
+
+  msg_progress("Searching clusters", evt_tag_int("input lines", input.num_of_lines), NULL);
   if (self->algo == PTZ_ALGO_SLCT)
-    return ptz_find_clusters_slct(logs, support, self->delimiters, num_of_samples);
+    return _ptz_find_clusters_slct(&input, support, self->delimiters, num_of_samples);
   else
     {
       msg_error("Unknown clustering algorithm", evt_tag_int("algo_id", self->algo));
@@ -378,6 +769,12 @@ ptz_find_clusters(Patternizer *self)
   if (self->iterate == PTZ_ITERATE_NONE)
     return ptz_find_clusters_step(self, self->logs, self->support, self->num_of_samples);
 
+  if (self->streaming)
+    {
+      msg_error("Iterating over the outliers is not supported in streaming mode", NULL);
+      return NULL;
+    }
+
   if (self->iterate == PTZ_ITERATE_OUTLIERS)
     {
       ret_clusters =  g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) cluster_free);
@@ -460,7 +857,7 @@ ptz_print_patterndb_rule(gpointer key, gpointer value, gpointer user_data)
   uuid_gen_random(uuid_string, sizeof(uuid_string));
 
   printf("      <rule id='%s' class='system' provider='patternize'>\n", uuid_string);
-  printf("        <!-- support: %d -->\n", cluster->loglines->len);
+  printf("        <!-- support: %d -->\n", cluster->support);
   printf("        <patterns>\n");
   printf("          <pattern>");
 
@@ -579,10 +976,9 @@ gboolean
 ptz_load_file(Patternizer *self, gchar *input_file, gboolean no_parse, GError **error)
 {
   FILE *file;
-  int len;
   MsgFormatOptions parse_options;
   gchar line[PTZ_MAXLINELEN];
-  LogMessage *msg;
+  PtzInputFile *streamed_file;
 
   if (!input_file)
     {
@@ -590,42 +986,55 @@ ptz_load_file(Patternizer *self, gchar *input_file, gboolean no_parse, GError **
       return FALSE;
     }
 
-  if (strcmp(input_file, "-") != 0)
+  if (self->streaming && strcmp(input_file, "-") == 0)
     {
-      if (!(file = fopen(input_file, "r")))
-        {
-          g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_IO, "Error opening input file %s", input_file);
-          return FALSE;
-        }
-    }
-  else
-    {
-      file = stdin;
+      g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_IO, "Streaming mode needs to read its input several times, it can't use stdin");
+      return FALSE;
     }
 
-  memset(&parse_options, 0, sizeof(parse_options));
-  msg_format_options_defaults(&parse_options);
-  if (no_parse)
-    parse_options.flags |= LP_NOPARSE;
-  else
-    parse_options.flags |= LP_SYSLOG_PROTOCOL;
-  msg_format_options_init(&parse_options, configuration);
+  if (!(file = ptz_open_file(input_file, error)))
+    return FALSE;
 
-  while (fgets(line, PTZ_MAXLINELEN, file))
+  if (self->streaming)
     {
-      len = strlen(line);
-      if (line[len-1] == '\n')
-        line[len-1] = 0;
-
-      msg = log_msg_new(line, len, NULL, &parse_options);
-      g_ptr_array_add(self->logs, msg);
+      /* only count the lines here, they are read again in each pass */
+      while (fgets(line, PTZ_MAXLINELEN, file))
+        self->num_of_lines++;
+      fclose(file);
+
+      streamed_file = g_new0(PtzInputFile, 1);
+      streamed_file->filename = g_strdup(input_file);
+      streamed_file->no_parse = no_parse;
+      g_ptr_array_add(self->input_files, streamed_file);
+
+      self->support = (self->num_of_lines * (self->support_treshold / 100.0));
+      return TRUE;
     }
 
+  ptz_init_parse_options(&parse_options, no_parse);
+  while (fgets(line, PTZ_MAXLINELEN, file))
+    g_ptr_array_add(self->logs, ptz_parse_line(line, &parse_options));
+
+  self->num_of_lines = self->logs->len;
   self->support = (self->logs->len * (self->support_treshold / 100.0));
   msg_format_options_destroy(&parse_options);
+  if (file != stdin)
+    fclose(file);
   return TRUE;
 }
 
+void
+ptz_set_num_of_threads(Patternizer *self, guint num_of_threads)
+{
+  self->num_of_threads = num_of_threads;
+}
+
+void
+ptz_set_streaming(Patternizer *self, gboolean streaming)
+{
+  self->streaming = streaming;
+}
+
 Patternizer *
 ptz_new(gdouble support_treshold, guint algo, guint iterate, guint num_of_samples, gchar *delimiters)
 {
@@ -638,6 +1047,8 @@ ptz_new(gdouble support_treshold, guint algo, guint iterate, guint num_of_sample
   self->num_of_samples = num_of_samples;
   self->delimiters = delimiters;
   self->logs = g_ptr_array_sized_new(PTZ_LOGTABLE_ALLOC_BASE);
+  self->input_files = g_ptr_array_new();
+  self->num_of_threads = 1;
 
   cluster_tag_id = log_tags_get_by_name(".in_patternize_cluster");
   return self;
@@ -652,5 +1063,14 @@ ptz_free(Patternizer *self)
     log_msg_unref((LogMessage *) (LogMessage *) g_ptr_array_index(self->logs, i));
 
   g_ptr_array_free(self->logs, TRUE);
+
+  for (i = 0; i < self->input_files->len; ++i)
+    {
+      PtzInputFile *input_file = (PtzInputFile *) g_ptr_array_index(self->input_files, i);
+
+      g_free(input_file->filename);
+      g_free(input_file);
+    }
+  g_ptr_array_free(self->input_files, TRUE);
   g_free(self);
 }
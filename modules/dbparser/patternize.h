@@ -47,30 +47,38 @@ typedef struct _Patternizer
   guint num_of_samples;
   gdouble support_treshold;
   gchar *delimiters;
+  guint num_of_threads;
+  guint num_of_lines;
 
-  // NOTE: for now, we store all logs read in in the memory.
-  // This brings in some obvious constraints and should be solved
-  // in a more optimized way later.
+  // NOTE: unless streaming is enabled, we store all logs read in in the
+  // memory.  In streaming mode only the names of the input files are
+  // stored and they are read again in every pass.
+  gboolean streaming;
   GPtrArray *logs;
+  GPtrArray *input_files;
 
 } Patternizer;
 
 typedef struct _Cluster
 {
+  /* NULL in streaming mode */
   GPtrArray *loglines;
+  guint support;
   char **words;
   GPtrArray *samples;
 } Cluster;
 
 /* only declared for the test program */
-GHashTable *ptz_find_frequent_words(GPtrArray *logs, guint support, gchar *delimiters, gboolean two_pass);
-GHashTable *ptz_find_clusters_slct(GPtrArray *logs, guint support, gchar *delimiters, guint num_of_samples);
+GHashTable *ptz_find_frequent_words(GPtrArray *logs, guint support, gchar *delimiters, gboolean two_pass, guint num_of_threads);
+GHashTable *ptz_find_clusters_slct(GPtrArray *logs, guint support, gchar *delimiters, guint num_of_samples, guint num_of_threads);
 
 
 GHashTable *ptz_find_clusters(Patternizer *self);
 void ptz_print_patterndb(GHashTable *clusters, gchar *delimiters, gboolean named_parsers);
 
 gboolean ptz_load_file(Patternizer *self, gchar *input_file, gboolean no_parse, GError **error);
+void ptz_set_num_of_threads(Patternizer *self, guint num_of_threads);
+void ptz_set_streaming(Patternizer *self, gboolean streaming);
 
 Patternizer *ptz_new(gdouble support_treshold, guint algo, guint iterate, guint num_of_samples, gchar *delimiters);
 void ptz_free(Patternizer *self);
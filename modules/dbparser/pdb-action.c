@@ -29,6 +29,9 @@ pdb_action_set_condition(PDBAction *self, GlobalConfig *cfg, const gchar *filter
 {
   CfgLexer *lexer;
 
+  g_free(self->condition_string);
+  self->condition_string = g_strdup(filter_string);
+
   lexer = cfg_lexer_new_buffer(filter_string, strlen(filter_string));
   if (!cfg_run_parser(cfg, lexer, &filter_expr_parser, (gpointer *) &self->condition, NULL))
     {
@@ -109,6 +112,7 @@ pdb_action_free(PDBAction *self)
 {
   if (self->condition)
     filter_expr_unref(self->condition);
+  g_free(self->condition_string);
   if (self->content_type == RAC_MESSAGE)
     synthetic_message_deinit(&self->content.message);
   g_free(self);
@@ -45,6 +45,8 @@ typedef enum
 typedef struct _PDBAction
 {
   FilterExprNode *condition;
+  /* the source of @condition, kept for the patterndb cache */
+  gchar *condition_string;
   PDBActionTrigger trigger;
   PDBActionContentType content_type;
   guint32 rate_quantum;
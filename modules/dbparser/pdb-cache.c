@@ -0,0 +1,676 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "pdb-cache.h"
+#include "pdb-program.h"
+#include "pdb-rule.h"
+#include "pdb-action.h"
+#include "serialize.h"
+#include "messages.h"
+#include "tags.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+
+/*
+ * Precompiled patterndb cache
+ *
+ * The cache stores a loaded PDBRuleSet: the rules with their actions,
+ * the programs and the radix trees in the form they have after loading
+ * the XML file, so that the XML parsing and the radix tree building
+ * (r_insert_node() for every pattern) can be skipped.
+ *
+ * Templates and filter expressions are stored as source strings and are
+ * compiled again while loading, as they depend on the configuration, just
+ * like the parser nodes of the radix trees (see r_deserialize_tree()).
+ *
+ * The cache records the size and FNV-1a hash of the XML file it was
+ * generated from, and it is only used if these still match.  It is
+ * generated by "pdbtool compile".
+ *
+ * Layout:
+ *   magic, format version, source size, source hash
+ *   ruleset version, pub_date
+ *   rules (referenced by their index from the trees)
+ *   programs, each followed by its rule tree
+ *   the program tree (referencing programs by their index)
+ */
+
+#define PDB_CACHE_MAGIC "PDBC"
+#define PDB_CACHE_MAGIC_LEN 4
+#define PDB_CACHE_VERSION 1
+
+typedef struct _PDBCacheHeader
+{
+  guint32 version;
+  guint64 source_size;
+  guint64 source_hash;
+} PDBCacheHeader;
+
+/* objects shared by the trees, numbered in the order they are stored */
+typedef struct _PDBCacheIndex
+{
+  GHashTable *index;
+  GPtrArray *objects;
+} PDBCacheIndex;
+
+static void
+pdb_cache_index_init(PDBCacheIndex *self)
+{
+  self->index = g_hash_table_new(g_direct_hash, g_direct_equal);
+  self->objects = g_ptr_array_new();
+}
+
+static void
+pdb_cache_index_destroy(PDBCacheIndex *self)
+{
+  g_hash_table_destroy(self->index);
+  g_ptr_array_free(self->objects, TRUE);
+}
+
+static void
+pdb_cache_index_add(PDBCacheIndex *self, gpointer object)
+{
+  if (g_hash_table_lookup(self->index, object))
+    return;
+
+  g_ptr_array_add(self->objects, object);
+  g_hash_table_insert(self->index, object, GUINT_TO_POINTER(self->objects->len));
+}
+
+static gboolean
+pdb_cache_index_write_reference(SerializeArchive *sa, gpointer object, gpointer user_data)
+{
+  PDBCacheIndex *self = (PDBCacheIndex *) user_data;
+  guint index = GPOINTER_TO_UINT(g_hash_table_lookup(self->index, object));
+
+  g_assert(index > 0);
+  return serialize_write_varint(sa, index - 1);
+}
+
+static void
+_collect_tree_values(RNode *node, PDBCacheIndex *index)
+{
+  gint i;
+
+  if (node->value)
+    pdb_cache_index_add(index, node->value);
+
+  for (i = 0; i < node->num_children; i++)
+    _collect_tree_values(node->children[i], index);
+  for (i = 0; i < node->num_pchildren; i++)
+    _collect_tree_values(node->pchildren[i], index);
+}
+
+static gboolean
+_hash_source_file(const gchar *source_file, guint64 *size, guint64 *hash)
+{
+  gchar *contents;
+  gsize length, i;
+  GError *error = NULL;
+
+  if (!g_file_get_contents(source_file, &contents, &length, &error))
+    {
+      msg_error("Error reading patterndb file",
+                evt_tag_str(EVT_TAG_FILENAME, source_file),
+                evt_tag_str("error", error->message),
+                NULL);
+      g_error_free(error);
+      return FALSE;
+    }
+
+  /* FNV-1a */
+  *hash = G_GUINT64_CONSTANT(14695981039346656037);
+  for (i = 0; i < length; i++)
+    {
+      *hash ^= (guchar) contents[i];
+      *hash *= G_GUINT64_CONSTANT(1099511628211);
+    }
+  *size = length;
+  g_free(contents);
+  return TRUE;
+}
+
+static gboolean
+_write_optional_string(SerializeArchive *sa, const gchar *str)
+{
+  if (!serialize_write_uint8(sa, !!str))
+    return FALSE;
+  return !str || serialize_write_cstring(sa, str, -1);
+}
+
+static gboolean
+_read_optional_string(SerializeArchive *sa, gchar **str)
+{
+  guint8 present;
+
+  *str = NULL;
+  if (!serialize_read_uint8(sa, &present))
+    return FALSE;
+  return !present || serialize_read_cstring(sa, str, NULL);
+}
+
+/**************************************************************
+ * Writing the cache
+ **************************************************************/
+
+static gboolean
+_write_synthetic_message(SerializeArchive *sa, SyntheticMessage *msg)
+{
+  gint i;
+
+  if (!serialize_write_varint(sa, msg->tags ? msg->tags->len : 0))
+    return FALSE;
+  for (i = 0; msg->tags && i < msg->tags->len; i++)
+    {
+      if (!serialize_write_cstring(sa, log_tags_get_by_id(g_array_index(msg->tags, LogTagId, i)), -1))
+        return FALSE;
+    }
+
+  if (!serialize_write_varint(sa, msg->values ? msg->values->len : 0))
+    return FALSE;
+  for (i = 0; msg->values && i < msg->values->len; i++)
+    {
+      LogTemplate *value = (LogTemplate *) g_ptr_array_index(msg->values, i);
+
+      if (!serialize_write_cstring(sa, value->name, -1) ||
+          !serialize_write_cstring(sa, value->template, -1))
+        return FALSE;
+    }
+  return TRUE;
+}
+
+static gboolean
+_write_action(SerializeArchive *sa, PDBAction *action)
+{
+  if (!serialize_write_uint8(sa, action->id) ||
+      !_write_optional_string(sa, action->condition_string) ||
+      !serialize_write_uint8(sa, action->trigger) ||
+      !serialize_write_uint16(sa, action->rate) ||
+      !serialize_write_uint32(sa, action->rate_quantum) ||
+      !serialize_write_uint8(sa, action->content_type))
+    return FALSE;
+
+  if (action->content_type == RAC_MESSAGE)
+    {
+      if (!serialize_write_uint8(sa, action->content.inherit_mode) ||
+          !_write_synthetic_message(sa, &action->content.message))
+        return FALSE;
+    }
+  return TRUE;
+}
+
+static gboolean
+_write_rule(SerializeArchive *sa, PDBRule *rule)
+{
+  gint i;
+
+  if (!_write_optional_string(sa, rule->class) ||
+      !serialize_write_cstring(sa, rule->rule_id, -1) ||
+      !serialize_write_uint32(sa, rule->context_timeout) ||
+      !serialize_write_uint8(sa, rule->context_scope) ||
+      !_write_optional_string(sa, rule->context_id_template ? rule->context_id_template->template : NULL) ||
+      !_write_synthetic_message(sa, &rule->msg))
+    return FALSE;
+
+  if (!serialize_write_varint(sa, rule->actions ? rule->actions->len : 0))
+    return FALSE;
+  for (i = 0; rule->actions && i < rule->actions->len; i++)
+    {
+      if (!_write_action(sa, (PDBAction *) g_ptr_array_index(rule->actions, i)))
+        return FALSE;
+    }
+  return TRUE;
+}
+
+static gboolean
+_write_cache(PDBRuleSet *self, SerializeArchive *sa, PDBCacheHeader *header)
+{
+  PDBCacheIndex programs, rules;
+  gboolean success = FALSE;
+  gint i;
+
+  pdb_cache_index_init(&programs);
+  pdb_cache_index_init(&rules);
+
+  _collect_tree_values(self->programs, &programs);
+  for (i = 0; i < programs.objects->len; i++)
+    _collect_tree_values(((PDBProgram *) g_ptr_array_index(programs.objects, i))->rules, &rules);
+
+  if (!serialize_write_blob(sa, PDB_CACHE_MAGIC, PDB_CACHE_MAGIC_LEN) ||
+      !serialize_write_uint32(sa, header->version) ||
+      !serialize_write_uint64(sa, header->source_size) ||
+      !serialize_write_uint64(sa, header->source_hash) ||
+      !serialize_write_cstring(sa, self->version, -1) ||
+      !_write_optional_string(sa, self->pub_date))
+    goto exit;
+
+  if (!serialize_write_varint(sa, rules.objects->len))
+    goto exit;
+  for (i = 0; i < rules.objects->len; i++)
+    {
+      if (!_write_rule(sa, (PDBRule *) g_ptr_array_index(rules.objects, i)))
+        goto exit;
+    }
+
+  if (!serialize_write_varint(sa, programs.objects->len))
+    goto exit;
+  for (i = 0; i < programs.objects->len; i++)
+    {
+      PDBProgram *program = (PDBProgram *) g_ptr_array_index(programs.objects, i);
+
+      if (!r_serialize_tree(program->rules, sa, pdb_cache_index_write_reference, &rules))
+        goto exit;
+    }
+
+  success = r_serialize_tree(self->programs, sa, pdb_cache_index_write_reference, &programs);
+
+ exit:
+  pdb_cache_index_destroy(&programs);
+  pdb_cache_index_destroy(&rules);
+  return success;
+}
+
+gboolean
+pdb_rule_set_save_cache(PDBRuleSet *self, const gchar *cache_file, const gchar *source_file)
+{
+  PDBCacheHeader header = { .version = PDB_CACHE_VERSION };
+  SerializeArchive *sa;
+  FILE *f;
+  gchar *tmp_file;
+  gboolean success;
+
+  if (!_hash_source_file(source_file, &header.source_size, &header.source_hash))
+    return FALSE;
+
+  /* write to a temporary file first, so that a concurrent reader never sees a partial cache */
+  tmp_file = g_strdup_printf("%s.tmp", cache_file);
+  if ((f = fopen(tmp_file, "w")) == NULL)
+    {
+      msg_error("Error creating patterndb cache file",
+                evt_tag_str(EVT_TAG_FILENAME, tmp_file),
+                evt_tag_errno(EVT_TAG_OSERROR, errno),
+                NULL);
+      g_free(tmp_file);
+      return FALSE;
+    }
+
+  sa = serialize_file_archive_new(f);
+  success = _write_cache(self, sa, &header);
+  serialize_archive_free(sa);
+
+  if (fclose(f) != 0)
+    success = FALSE;
+
+  if (success && rename(tmp_file, cache_file) < 0)
+    success = FALSE;
+
+  if (!success)
+    {
+      msg_error("Error writing patterndb cache file",
+                evt_tag_str(EVT_TAG_FILENAME, cache_file),
+                evt_tag_errno(EVT_TAG_OSERROR, errno),
+                NULL);
+      unlink(tmp_file);
+    }
+  g_free(tmp_file);
+  return success;
+}
+
+/**************************************************************
+ * Loading the cache
+ **************************************************************/
+
+typedef struct _PDBCacheLoader
+{
+  GlobalConfig *cfg;
+  const gchar *cache_file;
+  GPtrArray *rules;
+  GPtrArray *programs;
+} PDBCacheLoader;
+
+static void
+pdb_cache_loader_report_error(PDBCacheLoader *self, const gchar *error)
+{
+  msg_warning("Error loading patterndb cache file, falling back to the XML file",
+              evt_tag_str(EVT_TAG_FILENAME, self->cache_file),
+              evt_tag_str("error", error),
+              NULL);
+}
+
+static gboolean
+_read_reference(SerializeArchive *sa, GPtrArray *objects, gpointer *object)
+{
+  guint32 index;
+
+  if (!serialize_read_varint32(sa, &index) || index >= objects->len)
+    return FALSE;
+  *object = g_ptr_array_index(objects, index);
+  return TRUE;
+}
+
+static gboolean
+_read_rule_reference(SerializeArchive *sa, gpointer *value, gpointer user_data)
+{
+  PDBCacheLoader *self = (PDBCacheLoader *) user_data;
+
+  if (!_read_reference(sa, self->rules, value))
+    return FALSE;
+  pdb_rule_ref((PDBRule *) *value);
+  return TRUE;
+}
+
+static gboolean
+_read_program_reference(SerializeArchive *sa, gpointer *value, gpointer user_data)
+{
+  PDBCacheLoader *self = (PDBCacheLoader *) user_data;
+
+  if (!_read_reference(sa, self->programs, value))
+    return FALSE;
+  pdb_program_ref((PDBProgram *) *value);
+  return TRUE;
+}
+
+static gboolean
+_read_synthetic_message(PDBCacheLoader *self, SerializeArchive *sa, SyntheticMessage *msg)
+{
+  guint32 num_tags, num_values, i;
+  gchar *name = NULL, *value = NULL;
+  GError *error = NULL;
+  gboolean success;
+
+  if (!serialize_read_varint32(sa, &num_tags))
+    return FALSE;
+  for (i = 0; i < num_tags; i++)
+    {
+      success = serialize_read_cstring(sa, &name, NULL);
+      if (success)
+        synthetic_message_add_tag(msg, name);
+      g_free(name);
+      if (!success)
+        return FALSE;
+    }
+
+  if (!serialize_read_varint32(sa, &num_values))
+    return FALSE;
+  for (i = 0; i < num_values; i++)
+    {
+      name = value = NULL;
+      success = serialize_read_cstring(sa, &name, NULL) &&
+                serialize_read_cstring(sa, &value, NULL);
+
+      if (success && !synthetic_message_add_value_template_string(msg, self->cfg, name, value, &error))
+        {
+          pdb_cache_loader_report_error(self, error->message);
+          g_clear_error(&error);
+          success = FALSE;
+        }
+      g_free(name);
+      g_free(value);
+      if (!success)
+        return FALSE;
+    }
+  return TRUE;
+}
+
+static gboolean
+_read_action(PDBCacheLoader *self, SerializeArchive *sa, PDBRule *rule)
+{
+  PDBAction *action;
+  guint8 id, trigger, content_type, inherit_mode;
+  gchar *condition;
+  GError *error = NULL;
+
+  if (!serialize_read_uint8(sa, &id))
+    return FALSE;
+
+  action = pdb_action_new(id);
+  pdb_rule_add_action(rule, action);
+
+  if (!_read_optional_string(sa, &condition))
+    {
+      g_free(condition);
+      return FALSE;
+    }
+  if (condition)
+    {
+      pdb_action_set_condition(action, self->cfg, condition, &error);
+      g_free(condition);
+      if (error)
+        {
+          pdb_cache_loader_report_error(self, error->message);
+          g_clear_error(&error);
+          return FALSE;
+        }
+    }
+
+  if (!serialize_read_uint8(sa, &trigger) ||
+      !serialize_read_uint16(sa, &action->rate) ||
+      !serialize_read_uint32(sa, &action->rate_quantum) ||
+      !serialize_read_uint8(sa, &content_type))
+    return FALSE;
+
+  if ((trigger != RAT_MATCH && trigger != RAT_TIMEOUT) ||
+      (content_type != RAC_NONE && content_type != RAC_MESSAGE))
+    return FALSE;
+  action->trigger = trigger;
+
+  if (content_type == RAC_MESSAGE)
+    {
+      action->content_type = RAC_MESSAGE;
+      if (!serialize_read_uint8(sa, &inherit_mode) || inherit_mode > RAC_MSG_INHERIT_CONTEXT)
+        return FALSE;
+      action->content.inherit_mode = inherit_mode;
+      if (!_read_synthetic_message(self, sa, &action->content.message))
+        return FALSE;
+    }
+  return TRUE;
+}
+
+static PDBRule *
+_read_rule(PDBCacheLoader *self, SerializeArchive *sa)
+{
+  PDBRule *rule = pdb_rule_new();
+  guint32 context_timeout, num_actions, i;
+  guint8 context_scope;
+  gchar *context_id = NULL;
+
+  /* the class is set directly, its classifier tag is stored among the tags */
+  if (!_read_optional_string(sa, &rule->class) ||
+      !serialize_read_cstring(sa, &rule->rule_id, NULL) ||
+      !serialize_read_uint32(sa, &context_timeout) ||
+      !serialize_read_uint8(sa, &context_scope) ||
+      context_scope > RCS_PROCESS)
+    goto error;
+
+  rule->context_timeout = context_timeout;
+  rule->context_scope = context_scope;
+
+  if (!_read_optional_string(sa, &context_id))
+    goto error;
+  if (context_id)
+    {
+      LogTemplate *template;
+
+      template = log_template_new(self->cfg, NULL);
+      log_template_compile(template, context_id, NULL);
+      pdb_rule_set_context_id_template(rule, template);
+      g_free(context_id);
+      context_id = NULL;
+    }
+
+  if (!_read_synthetic_message(self, sa, &rule->msg) ||
+      !serialize_read_varint32(sa, &num_actions))
+    goto error;
+
+  for (i = 0; i < num_actions; i++)
+    {
+      if (!_read_action(self, sa, rule))
+        goto error;
+    }
+  return rule;
+
+ error:
+  g_free(context_id);
+  pdb_rule_unref(rule);
+  return NULL;
+}
+
+static gboolean
+_read_header(SerializeArchive *sa, PDBCacheHeader *header)
+{
+  gchar magic[PDB_CACHE_MAGIC_LEN];
+
+  return serialize_read_blob(sa, magic, PDB_CACHE_MAGIC_LEN) &&
+         memcmp(magic, PDB_CACHE_MAGIC, PDB_CACHE_MAGIC_LEN) == 0 &&
+         serialize_read_uint32(sa, &header->version) &&
+         serialize_read_uint64(sa, &header->source_size) &&
+         serialize_read_uint64(sa, &header->source_hash);
+}
+
+static gboolean
+_read_body(PDBCacheLoader *self, SerializeArchive *sa, PDBRuleSet *ruleset)
+{
+  guint32 num_rules, num_programs, i;
+
+  if (!serialize_read_cstring(sa, &ruleset->version, NULL) ||
+      !_read_optional_string(sa, &ruleset->pub_date) ||
+      !serialize_read_varint32(sa, &num_rules))
+    return FALSE;
+
+  for (i = 0; i < num_rules; i++)
+    {
+      PDBRule *rule = _read_rule(self, sa);
+
+      if (!rule)
+        return FALSE;
+      g_ptr_array_add(self->rules, rule);
+    }
+
+  if (!serialize_read_varint32(sa, &num_programs))
+    return FALSE;
+
+  for (i = 0; i < num_programs; i++)
+    {
+      PDBProgram *program = pdb_program_new();
+
+      g_ptr_array_add(self->programs, program);
+      r_free_node(program->rules, NULL);
+      program->rules = r_deserialize_tree(sa, _read_rule_reference, self, (GDestroyNotify) pdb_rule_unref);
+      if (!program->rules)
+        return FALSE;
+      program->rules = r_freeze_tree(program->rules);
+    }
+
+  ruleset->programs = r_deserialize_tree(sa, _read_program_reference, self, (GDestroyNotify) pdb_program_unref);
+  if (!ruleset->programs)
+    return FALSE;
+  ruleset->programs = r_freeze_tree(ruleset->programs);
+  return TRUE;
+}
+
+gchar *
+pdb_rule_set_get_cache_filename(const gchar *source_file)
+{
+  return g_strdup_printf("%s.cache", source_file);
+}
+
+/*
+ * Loads @self from @cache_file if it was generated from the current
+ * contents of @source_file.  Returns FALSE without touching @self if the
+ * cache does not exist, is out of date or cannot be loaded, the caller
+ * is expected to load the XML file in this case.
+ */
+gboolean
+pdb_rule_set_load_cache(PDBRuleSet *self, GlobalConfig *cfg, const gchar *cache_file, const gchar *source_file)
+{
+  PDBCacheLoader loader = { .cfg = cfg, .cache_file = cache_file };
+  PDBCacheHeader header;
+  PDBRuleSet loaded = { 0 };
+  SerializeArchive *sa;
+  GError *error = NULL;
+  gchar *contents;
+  gsize length;
+  guint64 source_size, source_hash;
+  gboolean success = FALSE;
+
+  if (!g_file_get_contents(cache_file, &contents, &length, &error))
+    {
+      if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        pdb_cache_loader_report_error(&loader, error->message);
+      g_error_free(error);
+      return FALSE;
+    }
+
+  sa = serialize_buffer_archive_new(contents, length);
+  if (!_read_header(sa, &header) || header.version != PDB_CACHE_VERSION)
+    {
+      pdb_cache_loader_report_error(&loader, "Unknown file format or version");
+      goto exit;
+    }
+
+  if (!_hash_source_file(source_file, &source_size, &source_hash))
+    goto exit;
+
+  if (header.source_size != source_size || header.source_hash != source_hash)
+    {
+      msg_info("Patterndb cache file is out of date, loading the XML file instead",
+               evt_tag_str(EVT_TAG_FILENAME, cache_file),
+               evt_tag_str("source", source_file),
+               NULL);
+      goto exit;
+    }
+
+  loader.rules = g_ptr_array_new();
+  loader.programs = g_ptr_array_new();
+  success = _read_body(&loader, sa, &loaded);
+
+  /* the trees hold their own references */
+  g_ptr_array_foreach(loader.rules, (GFunc) pdb_rule_unref, NULL);
+  g_ptr_array_free(loader.rules, TRUE);
+  g_ptr_array_foreach(loader.programs, (GFunc) pdb_program_unref, NULL);
+  g_ptr_array_free(loader.programs, TRUE);
+
+  if (!success)
+    {
+      pdb_cache_loader_report_error(&loader, "Truncated or corrupt file");
+      if (loaded.programs)
+        r_free_node(loaded.programs, (GDestroyNotify) pdb_program_unref);
+      g_free(loaded.version);
+      g_free(loaded.pub_date);
+      goto exit;
+    }
+
+  self->programs = loaded.programs;
+  self->version = loaded.version;
+  self->pub_date = loaded.pub_date;
+  msg_debug("Patterndb loaded from its cache file",
+            evt_tag_str(EVT_TAG_FILENAME, cache_file),
+            NULL);
+
+ exit:
+  serialize_archive_free(sa);
+  g_free(contents);
+  return success;
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef PATTERNDB_PDB_CACHE_H_INCLUDED
+#define PATTERNDB_PDB_CACHE_H_INCLUDED
+
+#include "syslog-ng.h"
+#include "pdb-ruleset.h"
+#include "cfg.h"
+
+gchar *pdb_rule_set_get_cache_filename(const gchar *source_file);
+gboolean pdb_rule_set_save_cache(PDBRuleSet *self, const gchar *cache_file, const gchar *source_file);
+gboolean pdb_rule_set_load_cache(PDBRuleSet *self, GlobalConfig *cfg, const gchar *cache_file, const gchar *source_file);
+
+#endif
@@ -26,10 +26,12 @@
 #include "pdb-action.h"
 #include "pdb-example.h"
 #include "pdb-ruleset.h"
+#include "pdb-cache.h"
 
 #include <string.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <unistd.h>
 
 /* arguments passed to the markup parser functions */
 typedef struct _PDBLoader
@@ -58,6 +60,8 @@ typedef struct _PDBLoader
   gint action_id;
   GHashTable *ruleset_patterns;
   GArray *program_patterns;
+  /* PDBProgram -> GArray of PDBProgramPattern, inserted once parsing is finished */
+  GHashTable *pending_rules;
 } PDBLoader;
 
 typedef struct _PDBProgramPattern
@@ -270,9 +274,8 @@ void
 pdb_loader_end_element(GMarkupParseContext *context, const gchar *element_name, gpointer user_data, GError **error)
 {
   PDBLoader *state = (PDBLoader *) user_data;
-  PDBProgramPattern *program_pattern;
   PDBProgram *program;
-  int i;
+  GArray *pending;
 
 
   if (strcmp(element_name, "patterndb") == 0)
@@ -290,17 +293,16 @@ pdb_loader_end_element(GMarkupParseContext *context, const gchar *element_name,
 
       program = (state->current_program ? state->current_program : state->root_program);
 
-      /* Copy stored rules into current program */
-      for (i = 0; i < state->program_patterns->len; i++)
+      /* Queue the stored rules for the current program, the radix trees
+       * are built once the whole file is parsed, see
+       * _build_program_rules() */
+      pending = g_hash_table_lookup(state->pending_rules, program);
+      if (!pending)
         {
-          program_pattern = &g_array_index(state->program_patterns, PDBProgramPattern, i);
-
-          r_insert_node(program->rules,
-                        program_pattern->pattern,
-                        program_pattern->rule,
-                        (RNodeGetValueFunc) pdb_rule_get_name);
-          g_free(program_pattern->pattern);
+          pending = g_array_new(FALSE, FALSE, sizeof(PDBProgramPattern));
+          g_hash_table_insert(state->pending_rules, program, pending);
         }
+      g_array_append_vals(pending, state->program_patterns->data, state->program_patterns->len);
 
       state->current_program = NULL;
       state->in_ruleset = FALSE;
@@ -487,6 +489,112 @@ GMarkupParser db_parser =
   .error = NULL
 };
 
+static void
+_free_pending_rules(GArray *pending)
+{
+  gint i;
+
+  for (i = 0; i < pending->len; i++)
+    {
+      PDBProgramPattern *program_pattern = &g_array_index(pending, PDBProgramPattern, i);
+
+      g_free(program_pattern->pattern);
+      pdb_rule_unref(program_pattern->rule);
+    }
+  g_array_free(pending, TRUE);
+}
+
+typedef struct _PDBProgramBuildJob
+{
+  PDBProgram *program;
+  GArray *pending;
+} PDBProgramBuildJob;
+
+/* the trees of the programs are independent, so they are built in parallel */
+static void
+_build_program_rules(gpointer data, gpointer user_data)
+{
+  PDBProgramBuildJob *job = (PDBProgramBuildJob *) data;
+  gint i;
+
+  for (i = 0; i < job->pending->len; i++)
+    {
+      PDBProgramPattern *program_pattern = &g_array_index(job->pending, PDBProgramPattern, i);
+
+      r_insert_node(job->program->rules,
+                    program_pattern->pattern,
+                    program_pattern->rule,
+                    (RNodeGetValueFunc) pdb_rule_get_name);
+      g_free(program_pattern->pattern);
+    }
+  job->program->rules = r_freeze_tree(job->program->rules);
+  g_array_free(job->pending, TRUE);
+}
+
+static void
+_build_rules(PDBLoader *state)
+{
+  GHashTableIter iter;
+  gpointer program, pending;
+  PDBProgramBuildJob *jobs;
+  GThreadPool *pool = NULL;
+  glong num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  gint num_jobs, i = 0;
+
+  num_jobs = g_hash_table_size(state->pending_rules);
+  jobs = g_new(PDBProgramBuildJob, num_jobs);
+  if (num_jobs > 1 && num_cpus > 1)
+    pool = g_thread_pool_new(_build_program_rules, NULL, MIN(num_cpus, num_jobs), TRUE, NULL);
+
+  g_hash_table_iter_init(&iter, state->pending_rules);
+  while (g_hash_table_iter_next(&iter, &program, &pending))
+    {
+      jobs[i].program = (PDBProgram *) program;
+      jobs[i].pending = (GArray *) pending;
+      if (pool)
+        g_thread_pool_push(pool, &jobs[i], NULL);
+      else
+        _build_program_rules(&jobs[i], NULL);
+      i++;
+    }
+  g_hash_table_steal_all(state->pending_rules);
+
+  /* waits for the queued jobs to finish */
+  if (pool)
+    g_thread_pool_free(pool, FALSE, TRUE);
+  g_free(jobs);
+}
+
+static void
+_freeze_program_rules(RNode *node, GHashTable *frozen_programs)
+{
+  PDBProgram *program = (PDBProgram *) node->value;
+  gint i;
+
+  /* the same program may be referenced from several nodes */
+  if (program && program->rules && !g_hash_table_lookup(frozen_programs, program))
+    {
+      program->rules = r_freeze_tree(program->rules);
+      g_hash_table_insert(frozen_programs, program, program);
+    }
+
+  for (i = 0; i < node->num_children; i++)
+    _freeze_program_rules(node->children[i], frozen_programs);
+  for (i = 0; i < node->num_pchildren; i++)
+    _freeze_program_rules(node->pchildren[i], frozen_programs);
+}
+
+/* the trees are not modified after loading, compile them for faster lookups */
+static void
+_freeze_ruleset(PDBRuleSet *self)
+{
+  GHashTable *frozen_programs = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+  self->programs = r_freeze_tree(self->programs);
+  _freeze_program_rules(self->programs, frozen_programs);
+  g_hash_table_destroy(frozen_programs);
+}
+
 gboolean
 pdb_rule_set_load(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, GList **examples)
 {
@@ -495,9 +603,22 @@ pdb_rule_set_load(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, GLis
   GError *error = NULL;
   FILE *dbfile = NULL;
   gint bytes_read;
+
+  self->cfg = cfg;
   gchar buff[4096];
   gboolean success = FALSE;
 
+  /* examples are not stored in the cache */
+  if (!examples)
+    {
+      gchar *cache_file = pdb_rule_set_get_cache_filename(config);
+
+      success = pdb_rule_set_load_cache(self, cfg, cache_file, config);
+      g_free(cache_file);
+      if (success)
+        return TRUE;
+    }
+
   if ((dbfile = fopen(config, "r")) == NULL)
     {
       msg_error("Error opening classifier configuration file",
@@ -513,6 +634,7 @@ pdb_rule_set_load(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, GLis
   state.root_program = pdb_program_new();
   state.load_examples = !!examples;
   state.ruleset_patterns = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify) pdb_program_unref);
+  state.pending_rules = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) _free_pending_rules);
   state.cfg = cfg;
 
   self->programs = r_new_node("", state.root_program);
@@ -545,6 +667,8 @@ pdb_rule_set_load(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, GLis
   if (state.load_examples)
     *examples = state.examples;
 
+  _build_rules(&state);
+  _freeze_ruleset(self);
   success = TRUE;
 
  error:
@@ -553,5 +677,6 @@ pdb_rule_set_load(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, GLis
   if (parse_ctx)
     g_markup_parse_context_free(parse_ctx);
   g_hash_table_unref(state.ruleset_patterns);
+  g_hash_table_unref(state.pending_rules);
   return success;
 }
@@ -23,11 +23,14 @@
 #include "pdb-ruleset.h"
 #include "pdb-program.h"
 
+static gint pdb_rule_set_last_generation;
+
 PDBRuleSet *
 pdb_rule_set_new(void)
 {
   PDBRuleSet *self = g_new0(PDBRuleSet, 1);
 
+  self->generation = g_atomic_int_exchange_and_add(&pdb_rule_set_last_generation, 1) + 1;
   return self;
 }
 
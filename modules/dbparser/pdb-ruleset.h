@@ -32,6 +32,10 @@ typedef struct _PDBRuleSet
   RNode *programs;
   gchar *version;
   gchar *pub_date;
+  /* unique among the rulesets allocated by pdb_rule_set_new(), 0 otherwise */
+  gint generation;
+  /* the configuration it was loaded for, matches nothing reads are not stored */
+  GlobalConfig *cfg;
 } PDBRuleSet;
 
 PDBRuleSet *pdb_rule_set_new(void);
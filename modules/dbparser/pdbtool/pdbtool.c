@@ -35,6 +35,7 @@
 #include "pdb-example.h"
 #include "pdb-program.h"
 #include "pdb-load.h"
+#include "pdb-cache.h"
 #include "apphook.h"
 #include "transport/transport-file.h"
 #include "logproto/logproto-text-server.h"
@@ -353,6 +354,7 @@ static gchar *template_string = NULL;
 static gchar *filter_string = NULL;
 static gboolean debug_pattern = FALSE;
 static gboolean debug_pattern_parse = FALSE;
+static gboolean match_profile = FALSE;
 
 gboolean
 pdbtool_match_values(NVHandle handle, const gchar *name, const gchar *value, gssize length, gpointer user_data)
@@ -399,6 +401,128 @@ pdbtool_pdb_emit(LogMessage *msg, gboolean synthetic, gpointer user_data)
     }
 }
 
+typedef struct _PdbtoolProfileItem
+{
+  gchar *program;
+  gchar *path;
+  const gchar *rule_id;
+  RProfileEntry entry;
+} PdbtoolProfileItem;
+
+static void
+pdbtool_append_profile_item(GArray *items, const gchar *program, const gchar *path, PDBRule *rule, RProfileEntry *entry)
+{
+  PdbtoolProfileItem item;
+
+  item.program = g_strdup(program);
+  item.path = g_strdup(path);
+  item.rule_id = rule ? rule->rule_id : NULL;
+  item.entry = *entry;
+  g_array_append_val(items, item);
+}
+
+static void
+pdbtool_collect_profile_item(const gchar *program, const gchar *path, PDBRule *rule, RProfileEntry *entry, gpointer user_data)
+{
+  GArray **items = (GArray **) user_data;
+
+  if (rule && entry->matches)
+    pdbtool_append_profile_item(items[0], program, path, rule, entry);
+  if (entry->parser_attempts)
+    pdbtool_append_profile_item(items[1], program, path, rule, entry);
+}
+
+static gint
+pdbtool_compare_rule_profiles(gconstpointer a, gconstpointer b)
+{
+  const RProfileEntry *entry_a = &((const PdbtoolProfileItem *) a)->entry;
+  const RProfileEntry *entry_b = &((const PdbtoolProfileItem *) b)->entry;
+
+  if (entry_a->match_parser_failures != entry_b->match_parser_failures)
+    return entry_a->match_parser_failures < entry_b->match_parser_failures ? 1 : -1;
+  if (entry_a->match_parser_attempts != entry_b->match_parser_attempts)
+    return entry_a->match_parser_attempts < entry_b->match_parser_attempts ? 1 : -1;
+  return 0;
+}
+
+static gint
+pdbtool_compare_node_profiles(gconstpointer a, gconstpointer b)
+{
+  const RProfileEntry *entry_a = &((const PdbtoolProfileItem *) a)->entry;
+  const RProfileEntry *entry_b = &((const PdbtoolProfileItem *) b)->entry;
+  guint64 failures_a = entry_a->parser_failures + entry_a->parser_dead_ends;
+  guint64 failures_b = entry_b->parser_failures + entry_b->parser_dead_ends;
+
+  if (failures_a != failures_b)
+    return failures_a < failures_b ? 1 : -1;
+  if (entry_a->parser_attempts != entry_b->parser_attempts)
+    return entry_a->parser_attempts < entry_b->parser_attempts ? 1 : -1;
+  return 0;
+}
+
+static void
+pdbtool_free_profile_items(GArray *items)
+{
+  gint i;
+
+  for (i = 0; i < items->len; i++)
+    {
+      PdbtoolProfileItem *item = &g_array_index(items, PdbtoolProfileItem, i);
+
+      g_free(item->program);
+      g_free(item->path);
+    }
+  g_array_free(items, TRUE);
+}
+
+/*
+ * Prints the cost of the lookups per rule, and per parser node, the most
+ * expensive ones first.  A parser failure is either a parser that could
+ * not parse the input, or one that did but ended up in a dead end, making
+ * the lookup backtrack.
+ */
+static void
+pdbtool_print_profile(PatternDB *patterndb)
+{
+  GArray *items[2];
+  guint64 lookups, failed_lookups;
+  gint i;
+
+  items[0] = g_array_new(FALSE, FALSE, sizeof(PdbtoolProfileItem));
+  items[1] = g_array_new(FALSE, FALSE, sizeof(PdbtoolProfileItem));
+  pattern_db_foreach_profile_entry(patterndb, pdbtool_collect_profile_item, items);
+  lookups = pattern_db_get_profiled_lookups(patterndb, &failed_lookups);
+
+  printf("Lookups: %" G_GUINT64_FORMAT ", unmatched: %" G_GUINT64_FORMAT "\n", lookups, failed_lookups);
+
+  g_array_sort(items[0], pdbtool_compare_rule_profiles);
+  printf("\nRules by parser failures:\n");
+  printf("%12s %12s %10s  %s\n", "failures", "attempts", "matches", "rule_id (program)");
+  for (i = 0; i < items[0]->len; i++)
+    {
+      PdbtoolProfileItem *item = &g_array_index(items[0], PdbtoolProfileItem, i);
+
+      printf("%12" G_GUINT64_FORMAT " %12" G_GUINT64_FORMAT " %10" G_GUINT64_FORMAT "  %s (%s)\n",
+             item->entry.match_parser_failures, item->entry.match_parser_attempts, item->entry.matches,
+             item->rule_id, item->program);
+    }
+
+  g_array_sort(items[1], pdbtool_compare_node_profiles);
+  printf("\nParser nodes by failures:\n");
+  printf("%12s %12s %12s %12s  %s\n", "failures", "dead_ends", "attempts", "visits", "pattern (program)");
+  for (i = 0; i < items[1]->len; i++)
+    {
+      PdbtoolProfileItem *item = &g_array_index(items[1], PdbtoolProfileItem, i);
+
+      printf("%12" G_GUINT64_FORMAT " %12" G_GUINT64_FORMAT " %12" G_GUINT64_FORMAT " %12" G_GUINT64_FORMAT "  %s (%s)\n",
+             item->entry.parser_failures, item->entry.parser_dead_ends, item->entry.parser_attempts, item->entry.visits,
+             item->path, item->program);
+    }
+
+  pdbtool_free_profile_items(items[0]);
+  pdbtool_free_profile_items(items[1]);
+}
+
 static gint
 pdbtool_match(int argc, char *argv[])
 {
@@ -430,6 +554,12 @@ pdbtool_match(int argc, char *argv[])
       return ret;
     }
 
+  if (match_profile && debug_pattern)
+    {
+      fprintf(stderr, "The --profile and --debug-pattern options cannot be used together\n");
+      return ret;
+    }
+
   if (template_string)
     {
       gchar *t;
@@ -468,6 +598,8 @@ pdbtool_match(int argc, char *argv[])
     {
       goto error;
     }
+  if (match_profile)
+    pattern_db_set_profile_sample_rate(patterndb, 1);
 
   msg = log_msg_new_empty();
   if (!match_file)
@@ -620,6 +752,8 @@ pdbtool_match(int argc, char *argv[])
         }
     }
   pattern_db_expire_state(patterndb);
+  if (match_profile)
+    pdbtool_print_profile(patterndb);
  error:
   if (proto)
     log_proto_server_free(proto);
@@ -649,6 +783,8 @@ static GOptionEntry match_options[] =
     "Output debuging information in parseable format", NULL },
   { "color-out", 'c', 0, G_OPTION_ARG_NONE, &color_out,
     "Color terminal output", NULL },
+  { "profile", 0, 0, G_OPTION_ARG_NONE, &match_profile,
+    "Print the cost of the lookups per rule and parser node after matching", NULL },
   { "template", 'T', 0, G_OPTION_ARG_STRING, &template_string,
     "Template string to be used to format the output", "template" },
   { "file", 'f', 0, G_OPTION_ARG_STRING, &match_file,
@@ -1014,6 +1150,37 @@ pdbtool_dictionary(int argc, char *argv[])
   return 0;
 }
 
+static gchar *compile_output = NULL;
+
+static GOptionEntry compile_options[] =
+{
+  { "pdb",       'p', 0, G_OPTION_ARG_STRING, &patterndb_file,
+    "Name of the patterndb file", "<patterndb_file>" },
+  { "output",    'o', 0, G_OPTION_ARG_STRING, &compile_output,
+    "Name of the cache file to generate, defaults to <patterndb_file>.cache", "<cache_file>" },
+  { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL }
+};
+
+static gint
+pdbtool_compile(int argc, char *argv[])
+{
+  PDBRuleSet rule_set;
+  gchar *cache_file;
+  gint ret = 0;
+
+  memset(&rule_set, 0x0, sizeof(PDBRuleSet));
+
+  if (!pdb_rule_set_load(&rule_set, configuration, patterndb_file, NULL))
+    return 1;
+
+  cache_file = compile_output ? g_strdup(compile_output) : pdb_rule_set_get_cache_filename(patterndb_file);
+  if (!pdb_rule_set_save_cache(&rule_set, cache_file, patterndb_file))
+    ret = 1;
+
+  g_free(cache_file);
+  return ret;
+}
+
 static gboolean
 pdbtool_load_module(const gchar *option_name, const gchar *value, gpointer data, GError **error)
 {
@@ -1024,6 +1191,8 @@ static gchar *input_logfile = NULL;
 static gboolean no_parse = FALSE;
 static gdouble support_treshold = 4.0;
 static gboolean iterate_outliers = FALSE;
+static gint patternize_threads = 0;
+static gboolean patternize_streaming = FALSE;
 static gboolean named_parsers = FALSE;
 static gint num_of_samples = 1;
 static gchar *delimiters = " :&~?![]=,;()'\"";
@@ -1041,6 +1210,15 @@ pdbtool_patternize(int argc, char *argv[])
   if (iterate_outliers)
     iterate = PTZ_ITERATE_OUTLIERS;
 
+  if (iterate_outliers && patternize_streaming)
+    {
+      fprintf(stderr, "The --iterate-outliers and --streaming options cannot be used together\n");
+      return 1;
+    }
+
+  if (patternize_threads <= 0)
+    patternize_threads = MAX(sysconf(_SC_NPROCESSORS_ONLN), 1);
+
   /* make sure that every character is unique in the delimiter list */
   for (i = 0; delimiters[i]; i++)
     {
@@ -1054,6 +1232,8 @@ pdbtool_patternize(int argc, char *argv[])
     {
       return 1;
     }
+  ptz_set_num_of_threads(ptz, patternize_threads);
+  ptz_set_streaming(ptz, patternize_streaming);
 
   argv[0] = input_logfile;
   for (i = 0; i < argc; i++)
@@ -1067,6 +1247,11 @@ pdbtool_patternize(int argc, char *argv[])
     }
 
   clusters = ptz_find_clusters(ptz);
+  if (!clusters)
+    {
+      ptz_free(ptz);
+      return 1;
+    }
   ptz_print_patterndb(clusters, delimiters, named_parsers);
   g_hash_table_destroy(clusters);
 
@@ -1092,6 +1277,10 @@ static GOptionEntry patternize_options[] =
     "Set of characters based on which the log messages are tokenized, defaults to :&~?![]=,;()'\"", "<delimiters>" },
   { "samples",           0, 0, G_OPTION_ARG_INT, &num_of_samples,
     "Number of example lines to add for the patterns (default: 1)", "<samples>" },
+  { "threads",          't', 0, G_OPTION_ARG_INT, &patternize_threads,
+    "Number of threads to count the words and clusters with (default: number of CPUs)", "<threads>" },
+  { "streaming",         0, 0, G_OPTION_ARG_NONE, &patternize_streaming,
+    "Read the input files again in each pass instead of keeping all messages in memory", NULL },
   { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL }
 };
 
@@ -1142,6 +1331,7 @@ static struct
   { "test", test_options, "Test pattern databases", pdbtool_test },
   { "patternize", patternize_options, "Create a pattern database from logs", pdbtool_patternize },
   { "dictionary", dictionary_options, "Dump pattern dictionary", pdbtool_dictionary },
+  { "compile", compile_options, "Precompile a pattern database into a cache file", pdbtool_compile },
   { NULL, NULL },
 };
 
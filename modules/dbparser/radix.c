@@ -34,13 +34,50 @@
 
 /* FIXME: maybe we should return gchar with the result */
 
+/*
+ * Character classes of the STRING and SET parsers, compiled into a 256
+ * entry table when the parser node is created.  This replaces a
+ * strchr(param) call for every character of the input, and the NUL
+ * terminator is never part of a class.
+ */
+static gpointer
+r_parser_char_class_new(gboolean alnum, const gchar *param)
+{
+  guint8 *char_class = g_new0(guint8, 256);
+  gint c;
+
+  if (alnum)
+    {
+      for (c = 0; c < 256; c++)
+        char_class[c] = g_ascii_isalnum(c);
+    }
+  for (; param && *param; param++)
+    char_class[(guint8) *param] = TRUE;
+  return char_class;
+}
+
+static inline gint
+r_parser_char_class_span(const guint8 *str, const guint8 *char_class)
+{
+  gint len = 0;
+
+  while (char_class[str[len]])
+    len++;
+  return len;
+}
+
 gboolean
 r_parser_string(guint8 *str, gint *len, const gchar *param, gpointer state, RParserMatch *match)
 {
   *len = 0;
 
-  while (str[*len] && (g_ascii_isalnum(str[*len]) || (param && strchr(param, str[*len]))))
-    (*len)++;
+  if (state)
+    *len = r_parser_char_class_span(str, (const guint8 *) state);
+  else
+    {
+      while (str[*len] && (g_ascii_isalnum(str[*len]) || (param && strchr(param, str[*len]))))
+        (*len)++;
+    }
 
   if (*len > 0)
     {
@@ -210,8 +247,13 @@ r_parser_set(guint8 *str, gint *len, const gchar *param, gpointer state, RParser
   if (!param)
     return FALSE;
 
-  while (strchr(param, str[*len]))
-    (*len)++;
+  if (state)
+    *len = r_parser_char_class_span(str, (const guint8 *) state);
+  else
+    {
+      while (str[*len] && strchr(param, str[*len]))
+        (*len)++;
+    }
 
   if (*len > 0)
     {
@@ -376,12 +418,21 @@ r_parser_ipv4(guint8 *str, gint *len, const gchar *param, gpointer state, RParse
 {
   gint dots = 0;
   gint octet = -1;
-
-  *len = 0;
+  guint digit;
+  gint i = 0;
 
   while (1)
     {
-      if (str[*len] == '.')
+      digit = str[i] - '0';
+      if (digit < 10)
+        {
+          /* saturate, anything above 255 is rejected anyway */
+          if (octet == -1)
+            octet = digit;
+          else if (octet <= 255)
+            octet = octet * 10 + digit;
+        }
+      else if (str[i] == '.')
         {
           if (octet > 255 || octet == -1)
             return FALSE;
@@ -392,21 +443,13 @@ r_parser_ipv4(guint8 *str, gint *len, const gchar *param, gpointer state, RParse
           dots++;
           octet = -1;
         }
-      else if (g_ascii_isdigit(str[*len]))
-        {
-          if (octet == -1)
-            octet = 0;
-          else
-            octet *= 10;
-
-          octet += g_ascii_digit_value(str[*len]);
-        }
       else
         break;
 
-      (*len)++;
+      i++;
     }
 
+  *len = i;
   if (dots != 3 || octet > 255 || octet == -1)
     return FALSE;
 
@@ -525,7 +568,7 @@ r_parser_number(guint8 *str, gint *len, const gchar *param, gpointer state, RPar
 {
   gint min_len = 1;
 
-  if (g_str_has_prefix(str, "0x") || g_str_has_prefix(str, "0X"))
+  if (str[0] == '0' && (str[1] == 'x' || str[1] == 'X'))
     {
       *len = 2;
       min_len += 2;
@@ -544,7 +587,7 @@ r_parser_number(guint8 *str, gint *len, const gchar *param, gpointer state, RPar
           min_len++;
         }
 
-      while (g_ascii_isdigit(str[*len]))
+      while ((guint) (str[*len] - '0') < 10)
         (*len)++;
     }
 
@@ -611,6 +654,8 @@ r_new_pnode(guint8 *key)
     {
       parser_node->parse = r_parser_string;
       parser_node->type = RPT_STRING;
+      parser_node->state = r_parser_char_class_new(TRUE, params_len == 3 ? params[2] : NULL);
+      parser_node->free_state = g_free;
     }
   else if (strcmp(params[0], "ESTRING") == 0)
     {
@@ -679,6 +724,8 @@ r_new_pnode(guint8 *key)
         {
           parser_node->parse = r_parser_set;
           parser_node->type = RPT_SET;
+          parser_node->state = r_parser_char_class_new(FALSE, params[2]);
+          parser_node->free_state = g_free;
         }
       else
         {
@@ -751,15 +798,20 @@ r_new_pnode(guint8 *key)
 }
 
 
-void
-r_free_pnode_only(RParserNode *parser)
+static void
+r_free_pnode_params(RParserNode *parser)
 {
   if (parser->param)
     g_free(parser->param);
 
   if (parser->state && parser->free_state)
     parser->free_state(parser->state);
+}
 
+void
+r_free_pnode_only(RParserNode *parser)
+{
+  r_free_pnode_params(parser);
   g_free(parser);
 }
 
@@ -875,10 +927,16 @@ r_find_pchild(RNode *parent, RParserNode *parser_node)
 }
 
 RNode *
-r_find_child_by_first_character(RNode *root, char key)
+r_find_child_by_first_character(RNode *root, guint8 key)
 {
   register gint l, u, idx;
-  register char k = key;
+  register guint8 k = key;
+
+  if (root->child_index)
+    {
+      idx = root->child_index[k];
+      return idx ? root->children[idx - 1] : NULL;
+    }
 
   l = 0;
   u = root->num_children;
@@ -906,6 +964,8 @@ r_insert_node(RNode *root, guint8 *key, gpointer value, RNodeGetValueFunc value_
   gint nodelen = root->keylen;
   gint i = 0;
 
+  g_assert(!root->frozen);
+
   if (key[0] == '@')
     {
       guint8 *end;
@@ -1103,10 +1163,71 @@ typedef struct _RFindNodeState
   GArray *stored_matches;
   GArray *dbg_list;
   GPtrArray *applicable_nodes;
+  RProfile *profile;
+  /* parser runs during this lookup, only counted if profile is set */
+  guint64 parser_attempts;
+  guint64 parser_failures;
 } RFindNodeState;
 
 static RNode *_find_node_recursively(RFindNodeState *state, RNode *root, guint8 *key, gint keylen);
 
+static RProfileEntry *
+_profile_get_entry(RProfile *profile, RNode *node)
+{
+  RProfileEntry *entry = g_hash_table_lookup(profile->entries, node);
+
+  if (!entry)
+    {
+      entry = g_new0(RProfileEntry, 1);
+      g_hash_table_insert(profile->entries, node, entry);
+    }
+  return entry;
+}
+
+static inline void
+_profile_visit(RFindNodeState *state, RNode *node)
+{
+  if (G_UNLIKELY(state->profile))
+    _profile_get_entry(state->profile, node)->visits++;
+}
+
+static void
+_profile_parser_attempt(RFindNodeState *state, RNode *node, gboolean parsed, RNode *ret)
+{
+  RProfileEntry *entry = _profile_get_entry(state->profile, node);
+
+  entry->parser_attempts++;
+  state->parser_attempts++;
+  if (!parsed)
+    {
+      entry->parser_failures++;
+      state->parser_failures++;
+    }
+  else if (!ret)
+    {
+      entry->parser_dead_ends++;
+      state->parser_failures++;
+    }
+}
+
+static void
+_profile_lookup_finished(RFindNodeState *state, RNode *ret)
+{
+  RProfileEntry *entry;
+
+  state->profile->lookups++;
+  if (!ret)
+    {
+      state->profile->failed_lookups++;
+      return;
+    }
+
+  entry = _profile_get_entry(state->profile, ret);
+  entry->matches++;
+  entry->match_parser_attempts += state->parser_attempts;
+  entry->match_parser_failures += state->parser_failures;
+}
+
 static void
 _add_debug_info(RFindNodeState *state, RNode *node, RParserNode *pnode, gint i, gint match_off, gint match_len)
 {
@@ -1299,10 +1420,12 @@ _try_parse_with_a_given_child(RFindNodeState *state, RNode *root, gint parser_nd
   RParserMatch *match_slot = NULL;
   gint extracted_match_len;
   RNode *ret = NULL;
+  gboolean parsed;
 
   match_slot = _clear_match_slot(state, matches_slot_index);
 
-  if (_pnode_try_parse(parser_node, remaining_key, &extracted_match_len, match_slot))
+  parsed = _pnode_try_parse(parser_node, remaining_key, &extracted_match_len, match_slot);
+  if (parsed)
     {
 
       /* FIXME: we don't try to find the longest match in case
@@ -1328,6 +1451,8 @@ _try_parse_with_a_given_child(RFindNodeState *state, RNode *root, gint parser_nd
             _clear_match_content(match_slot);
         }
     }
+  if (G_UNLIKELY(state->profile))
+    _profile_parser_attempt(state, child_node, parsed, ret);
   return ret;
 
 }
@@ -1363,6 +1488,7 @@ _find_node_recursively(RFindNodeState *state, RNode *root, guint8 *key, gint key
                                 &literal_prefix_inputlen,
                                 &literal_prefix_radixlen);
   _add_literal_match_to_debug_info(state, root, literal_prefix_inputlen);
+  _profile_visit(state, root);
 
   msg_trace("Looking up node in the radix tree",
             evt_tag_int("literal_prefix_inputlen", literal_prefix_inputlen),
@@ -1427,6 +1553,8 @@ _find_node_with_state(RFindNodeState *state, RNode *root, guint8 *key, gint keyl
       state->require_complete_match = FALSE;
       ret = _find_node_recursively(state, root, key, keylen);
     }
+  if (state->profile)
+    _profile_lookup_finished(state, ret);
   return ret;
 }
 
@@ -1453,6 +1581,24 @@ r_find_node_dbg(RNode *root, guint8 *key, gint keylen, GArray *stored_matches, G
   return _find_node_with_state(&state, root, key, keylen);
 }
 
+/*
+ * Same as r_find_node(), but also counts the nodes visited and the parser
+ * runs in @profile.  The counters are not protected by any locks, so
+ * concurrent lookups with the same @profile need to be serialized by the
+ * caller.
+ */
+RNode *
+r_find_node_prof(RNode *root, guint8 *key, gint keylen, GArray *stored_matches, RProfile *profile)
+{
+  RFindNodeState state = {
+    .whole_key = key,
+    .stored_matches = stored_matches,
+    .profile = profile,
+  };
+
+  return _find_node_with_state(&state, root, key, keylen);
+}
+
 gchar **
 r_find_all_applicable_nodes(RNode *root, guint8 *key, gint keylen, RNodeGetValueFunc value_func)
 {
@@ -1496,14 +1642,43 @@ r_new_node(guint8 *key, gpointer value)
   node->num_pchildren = 0;
   node->pchildren = NULL;
 
+  node->child_index = NULL;
+  node->frozen = FALSE;
+
   return node;
 }
 
+static void
+r_free_frozen_node_contents(RNode *node, void (*free_fn)(gpointer data))
+{
+  gint i;
+
+  for (i = 0; i < node->num_children; i++)
+    r_free_frozen_node_contents(node->children[i], free_fn);
+
+  for (i = 0; i < node->num_pchildren; i++)
+    r_free_frozen_node_contents(node->pchildren[i], free_fn);
+
+  if (node->parser)
+    r_free_pnode_params(node->parser);
+
+  if (node->value && free_fn)
+    free_fn(node->value);
+}
+
 void
 r_free_node(RNode *node, void (*free_fn)(gpointer data))
 {
   gint i;
 
+  if (node->frozen)
+    {
+      /* the whole tree lives in a single block starting with the root */
+      r_free_frozen_node_contents(node, free_fn);
+      g_free(node);
+      return;
+    }
+
   for (i = 0; i < node->num_children; i++)
     r_free_node(node->children[i], free_fn);
 
@@ -1524,3 +1699,455 @@ r_free_node(RNode *node, void (*free_fn)(gpointer data))
 
   g_free(node);
 }
+
+/**************************************************************
+ * Frozen trees
+ *
+ * Once a tree is fully built, r_freeze_tree() copies it into a single
+ * memory block, laid out in depth-first order: each node is immediately
+ * followed by its parser, its child pointers, its child index and its
+ * key, then by the subtrees of its children.  A lookup therefore walks
+ * a mostly contiguous piece of memory instead of chasing separately
+ * allocated arrays.
+ *
+ * Nodes with many literal children also get a 256 entry table, indexed
+ * by the first character of the child keys, replacing the binary search
+ * in r_find_child_by_first_character().
+ *
+ * The layout uses the same RNode/RParserNode structures, so lookups (and
+ * the code walking the tree) work unchanged, but frozen trees cannot be
+ * modified anymore.
+ **************************************************************/
+
+#define R_FROZEN_ALIGN(size) (((size) + G_MEM_ALIGN - 1) & ~((gsize) G_MEM_ALIGN - 1))
+
+/* the index stores child positions + 1 in a guint8 */
+#define R_CHILD_INDEX_MIN_CHILDREN 8
+#define R_CHILD_INDEX_MAX_CHILDREN 255
+
+static gboolean
+_frozen_node_needs_child_index(RNode *node)
+{
+  return node->num_children >= R_CHILD_INDEX_MIN_CHILDREN &&
+         node->num_children <= R_CHILD_INDEX_MAX_CHILDREN;
+}
+
+static gsize
+_frozen_node_size(RNode *node)
+{
+  gsize size = R_FROZEN_ALIGN(sizeof(RNode));
+
+  if (node->parser)
+    size += R_FROZEN_ALIGN(sizeof(RParserNode));
+  size += R_FROZEN_ALIGN(sizeof(RNode *) * (node->num_children + node->num_pchildren));
+  if (_frozen_node_needs_child_index(node))
+    size += R_FROZEN_ALIGN(256);
+  if (node->key)
+    size += R_FROZEN_ALIGN(node->keylen + 1);
+  return size;
+}
+
+static gsize
+_frozen_tree_size(RNode *node)
+{
+  gsize size = _frozen_node_size(node);
+  gint i;
+
+  for (i = 0; i < node->num_children; i++)
+    size += _frozen_tree_size(node->children[i]);
+  for (i = 0; i < node->num_pchildren; i++)
+    size += _frozen_tree_size(node->pchildren[i]);
+  return size;
+}
+
+static gpointer
+_frozen_alloc(guint8 **pos, gsize size)
+{
+  gpointer p = *pos;
+
+  *pos += R_FROZEN_ALIGN(size);
+  return p;
+}
+
+static RNode *
+_freeze_node(RNode *node, guint8 **pos)
+{
+  RNode *frozen = _frozen_alloc(pos, sizeof(RNode));
+  RNode **child_ptrs;
+  gint i;
+
+  *frozen = *node;
+  frozen->frozen = TRUE;
+
+  if (node->parser)
+    {
+      frozen->parser = _frozen_alloc(pos, sizeof(RParserNode));
+      *frozen->parser = *node->parser;
+    }
+
+  child_ptrs = _frozen_alloc(pos, sizeof(RNode *) * (node->num_children + node->num_pchildren));
+  frozen->children = node->num_children ? child_ptrs : NULL;
+  frozen->pchildren = node->num_pchildren ? child_ptrs + node->num_children : NULL;
+
+  if (_frozen_node_needs_child_index(node))
+    {
+      frozen->child_index = _frozen_alloc(pos, 256);
+      memset(frozen->child_index, 0, 256);
+      for (i = 0; i < node->num_children; i++)
+        frozen->child_index[node->children[i]->key[0]] = i + 1;
+    }
+
+  if (node->key)
+    {
+      frozen->key = _frozen_alloc(pos, node->keylen + 1);
+      memcpy(frozen->key, node->key, node->keylen + 1);
+    }
+
+  for (i = 0; i < node->num_children; i++)
+    frozen->children[i] = _freeze_node(node->children[i], pos);
+  for (i = 0; i < node->num_pchildren; i++)
+    frozen->pchildren[i] = _freeze_node(node->pchildren[i], pos);
+
+  return frozen;
+}
+
+/* frees the structure of a tree, whose contents were moved to a frozen copy */
+static void
+_free_unfrozen_skeleton(RNode *node)
+{
+  gint i;
+
+  for (i = 0; i < node->num_children; i++)
+    _free_unfrozen_skeleton(node->children[i]);
+  for (i = 0; i < node->num_pchildren; i++)
+    _free_unfrozen_skeleton(node->pchildren[i]);
+
+  g_free(node->children);
+  g_free(node->pchildren);
+  g_free(node->parser);
+  g_free(node->key);
+  g_free(node);
+}
+
+/*
+ * Compiles @root into its frozen form (see above) and returns the new
+ * root, @root itself is freed.  The values and parser states are moved
+ * over to the new tree.
+ */
+RNode *
+r_freeze_tree(RNode *root)
+{
+  RNode *frozen;
+  guint8 *block, *pos;
+  gsize size;
+
+  if (root->frozen)
+    return root;
+
+  size = _frozen_tree_size(root);
+  block = pos = g_malloc(size);
+  frozen = _freeze_node(root, &pos);
+  g_assert(pos == block + size);
+
+  _free_unfrozen_skeleton(root);
+  return frozen;
+}
+
+/**************************************************************
+ * Serialization
+ *
+ * r_serialize_tree() writes a tree in depth-first order, one record per
+ * node, so that r_deserialize_tree() can rebuild the same structure
+ * without going through r_insert_node() again.  Parser nodes are stored
+ * in their textual form ("TYPE:name:param") and are recreated using
+ * r_new_pnode(), as their state (e.g. a compiled PCRE) cannot be stored.
+ * The values are written and read by the caller supplied callbacks.
+ **************************************************************/
+
+#define R_SERIALIZED_KEY     0x01
+#define R_SERIALIZED_PARSER  0x02
+#define R_SERIALIZED_VALUE   0x04
+
+/* the literal children of a node differ in their first character */
+#define R_SERIALIZED_MAX_CHILDREN   256
+#define R_SERIALIZED_MAX_PCHILDREN  65535
+
+static const gchar *
+r_parser_spec_name(guint8 type)
+{
+  switch (type)
+    {
+      case RPT_STRING:
+        return "STRING";
+      case RPT_QSTRING:
+        return "QSTRING";
+      case RPT_ESTRING:
+        return "ESTRING";
+      case RPT_IPV4:
+        return "IPv4";
+      case RPT_NUMBER:
+        return "NUMBER";
+      case RPT_ANYSTRING:
+        return "ANYSTRING";
+      case RPT_IPV6:
+        return "IPv6";
+      case RPT_IP:
+        return "IPvANY";
+      case RPT_FLOAT:
+        return "FLOAT";
+      case RPT_SET:
+        return "SET";
+      case RPT_MACADDR:
+        return "MACADDR";
+      case RPT_PCRE:
+        return "PCRE";
+      case RPT_EMAIL:
+        return "EMAIL";
+      case RPT_HOSTNAME:
+        return "HOSTNAME";
+      case RPT_LLADDR:
+        return "LLADDR";
+      case RPT_NLSTRING:
+        return "NLSTRING";
+      default:
+        g_assert_not_reached();
+        return NULL;
+    }
+}
+
+static gchar *
+r_format_pnode_spec(RParserNode *parser)
+{
+  const gchar *name = parser->handle ? log_msg_get_value_name(parser->handle, NULL) : "";
+
+  if (parser->param)
+    return g_strdup_printf("%s:%s:%s", r_parser_spec_name(parser->type), name, parser->param);
+  return g_strdup_printf("%s:%s", r_parser_spec_name(parser->type), name);
+}
+
+gboolean
+r_serialize_tree(RNode *root, SerializeArchive *sa, RNodeSerializeValueFunc value_func, gpointer user_data)
+{
+  guint8 flags = 0;
+  gint i;
+
+  if (root->key)
+    flags |= R_SERIALIZED_KEY;
+  if (root->parser)
+    flags |= R_SERIALIZED_PARSER;
+  if (root->value)
+    flags |= R_SERIALIZED_VALUE;
+
+  if (!serialize_write_uint8(sa, flags))
+    return FALSE;
+
+  if (root->key && !serialize_write_cstring(sa, (gchar *) root->key, root->keylen))
+    return FALSE;
+
+  if (root->parser)
+    {
+      gchar *spec = r_format_pnode_spec(root->parser);
+      gboolean success = serialize_write_cstring(sa, spec, -1);
+
+      g_free(spec);
+      if (!success)
+        return FALSE;
+    }
+
+  if (root->value && !value_func(sa, root->value, user_data))
+    return FALSE;
+
+  if (!serialize_write_varint(sa, root->num_children) ||
+      !serialize_write_varint(sa, root->num_pchildren))
+    return FALSE;
+
+  for (i = 0; i < root->num_children; i++)
+    {
+      if (!r_serialize_tree(root->children[i], sa, value_func, user_data))
+        return FALSE;
+    }
+  for (i = 0; i < root->num_pchildren; i++)
+    {
+      if (!r_serialize_tree(root->pchildren[i], sa, value_func, user_data))
+        return FALSE;
+    }
+  return TRUE;
+}
+
+/*
+ * Reads back a tree written by r_serialize_tree().  The children are
+ * stored in the order r_insert_node() keeps them, so they are simply
+ * appended.  Returns NULL if the archive is truncated or corrupt, in which
+ * case the values read so far are freed using @free_fn.
+ */
+RNode *
+r_deserialize_tree(SerializeArchive *sa, RNodeDeserializeValueFunc value_func, gpointer user_data,
+                   void (*free_fn)(gpointer data))
+{
+  RNode *node, *child;
+  guint8 flags;
+  gchar *key = NULL;
+  guint32 num_children, num_pchildren;
+  gint i;
+
+  if (!serialize_read_uint8(sa, &flags))
+    return NULL;
+
+  /* parser nodes have no key */
+  if ((flags & R_SERIALIZED_KEY) && (flags & R_SERIALIZED_PARSER))
+    return NULL;
+
+  if ((flags & R_SERIALIZED_KEY) && !serialize_read_cstring(sa, &key, NULL))
+    {
+      g_free(key);
+      return NULL;
+    }
+
+  node = r_new_node((guint8 *) key, NULL);
+  g_free(key);
+
+  if (flags & R_SERIALIZED_PARSER)
+    {
+      gchar *spec = NULL;
+
+      if (!serialize_read_cstring(sa, &spec, NULL))
+        {
+          g_free(spec);
+          goto error;
+        }
+      node->parser = r_new_pnode((guint8 *) spec);
+      g_free(spec);
+      if (!node->parser)
+        goto error;
+    }
+
+  if ((flags & R_SERIALIZED_VALUE) && !value_func(sa, &node->value, user_data))
+    goto error;
+
+  if (!serialize_read_varint32(sa, &num_children) ||
+      !serialize_read_varint32(sa, &num_pchildren) ||
+      num_children > R_SERIALIZED_MAX_CHILDREN ||
+      num_pchildren > R_SERIALIZED_MAX_PCHILDREN)
+    goto error;
+
+  if (num_children)
+    node->children = g_new0(RNode *, num_children);
+  for (i = 0; i < num_children; i++)
+    {
+      child = r_deserialize_tree(sa, value_func, user_data, free_fn);
+      if (!child)
+        goto error;
+      if (!child->key || child->keylen == 0)
+        {
+          r_free_node(child, free_fn);
+          goto error;
+        }
+      node->children[node->num_children++] = child;
+    }
+
+  if (num_pchildren)
+    node->pchildren = g_new0(RNode *, num_pchildren);
+  for (i = 0; i < num_pchildren; i++)
+    {
+      child = r_deserialize_tree(sa, value_func, user_data, free_fn);
+      if (!child)
+        goto error;
+      if (!child->parser)
+        {
+          r_free_node(child, free_fn);
+          goto error;
+        }
+      node->pchildren[node->num_pchildren++] = child;
+    }
+  return node;
+
+ error:
+  /* the parser of a node is normally freed by its parent, see r_free_pnode() */
+  if (node->parser)
+    {
+      r_free_pnode_only(node->parser);
+      node->parser = NULL;
+    }
+  r_free_node(node, free_fn);
+  return NULL;
+}
+
+/**************************************************************
+ * Profiling
+ *
+ * r_find_node_prof() collects its counters in an RProfile, keyed by the
+ * nodes of the tree.  r_walk_tree() can be used to map the nodes back to
+ * the patterns they were built from: the path of a node is the
+ * concatenation of the literals and parsers (in "@TYPE:name:param@"
+ * form) from the root down to the node.
+ **************************************************************/
+
+static void
+_walk_tree(RNode *node, GString *path, RNodeWalkFunc func, gpointer user_data)
+{
+  gsize path_len = path->len;
+  gint i;
+
+  if (node->parser)
+    {
+      gchar *spec = r_format_pnode_spec(node->parser);
+
+      g_string_append_c(path, '@');
+      g_string_append(path, spec);
+      g_string_append_c(path, '@');
+      g_free(spec);
+    }
+  else if (node->key)
+    {
+      g_string_append_len(path, (gchar *) node->key, node->keylen);
+    }
+
+  func(node, path->str, user_data);
+
+  for (i = 0; i < node->num_children; i++)
+    _walk_tree(node->children[i], path, func, user_data);
+  for (i = 0; i < node->num_pchildren; i++)
+    _walk_tree(node->pchildren[i], path, func, user_data);
+
+  g_string_truncate(path, path_len);
+}
+
+void
+r_walk_tree(RNode *root, RNodeWalkFunc func, gpointer user_data)
+{
+  GString *path = g_string_sized_new(128);
+
+  _walk_tree(root, path, func, user_data);
+  g_string_free(path, TRUE);
+}
+
+RProfile *
+r_profile_new(void)
+{
+  RProfile *self = g_new0(RProfile, 1);
+
+  self->entries = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+  return self;
+}
+
+/* needs to be called whenever the nodes the profile refers to are freed */
+void
+r_profile_reset(RProfile *self)
+{
+  g_hash_table_remove_all(self->entries);
+  self->lookups = 0;
+  self->failed_lookups = 0;
+}
+
+void
+r_profile_free(RProfile *self)
+{
+  g_hash_table_destroy(self->entries);
+  g_free(self);
+}
+
+RProfileEntry *
+r_profile_lookup(RProfile *self, RNode *node)
+{
+  return g_hash_table_lookup(self->entries, node);
+}
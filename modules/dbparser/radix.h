@@ -26,6 +26,7 @@
 
 #include "logmsg/logmsg.h"
 #include "messages.h"
+#include "serialize.h"
 
 /* parser types, these are saved in the serialized log message along with
  * the match information thus they have to remain the same in order to keep
@@ -83,6 +84,8 @@ typedef struct _RParserNode
 } RParserNode;
 
 typedef gchar *(*RNodeGetValueFunc) (gpointer value);
+typedef gboolean (*RNodeSerializeValueFunc) (SerializeArchive *sa, gpointer value, gpointer user_data);
+typedef gboolean (*RNodeDeserializeValueFunc) (SerializeArchive *sa, gpointer *value, gpointer user_data);
 
 typedef struct _RNode RNode;
 
@@ -97,6 +100,12 @@ struct _RNode
 
   guint num_pchildren;
   RNode **pchildren;
+
+  /* the fields below are only set in trees compiled by r_freeze_tree() */
+
+  /* maps the first character of the children's keys to their index + 1 */
+  guint8 *child_index;
+  gboolean frozen;
 };
 
 typedef struct _RDebugInfo
@@ -108,6 +117,34 @@ typedef struct _RDebugInfo
   gint match_len;
 } RDebugInfo;
 
+/* cost counters collected by r_find_node_prof(), one per tree node */
+typedef struct _RProfileEntry
+{
+  /* number of times a lookup got to this node */
+  guint64 visits;
+  /* parser nodes only: number of times the parser was run here, how
+   * many of those runs failed to parse the input and how many parsed it
+   * but led to a dead end further down the tree */
+  guint64 parser_attempts;
+  guint64 parser_failures;
+  guint64 parser_dead_ends;
+  /* number of lookups that returned this node and the parser runs they
+   * took in total, successful or not */
+  guint64 matches;
+  guint64 match_parser_attempts;
+  guint64 match_parser_failures;
+} RProfileEntry;
+
+typedef struct _RProfile
+{
+  /* RNode * -> RProfileEntry */
+  GHashTable *entries;
+  guint64 lookups;
+  guint64 failed_lookups;
+} RProfile;
+
+typedef void (*RNodeWalkFunc)(RNode *node, const gchar *path, gpointer user_data);
+
 static inline gchar *
 r_parser_type_name(guint8 type)
 {
@@ -149,9 +186,20 @@ r_parser_type_name(guint8 type)
 RNode *r_new_node(guint8 *key, gpointer value);
 void r_free_node(RNode *node, void (*free_fn)(gpointer data));
 void r_insert_node(RNode *root, guint8 *key, gpointer value, RNodeGetValueFunc value_func);
+RNode *r_freeze_tree(RNode *root);
+gboolean r_serialize_tree(RNode *root, SerializeArchive *sa, RNodeSerializeValueFunc value_func, gpointer user_data);
+RNode *r_deserialize_tree(SerializeArchive *sa, RNodeDeserializeValueFunc value_func, gpointer user_data,
+                          void (*free_fn)(gpointer data));
 RNode *r_find_node(RNode *root, guint8 *key, gint keylen, GArray *matches);
 RNode *r_find_node_dbg(RNode *root, guint8 *key, gint keylen, GArray *matches, GArray *dbg_list);
+RNode *r_find_node_prof(RNode *root, guint8 *key, gint keylen, GArray *matches, RProfile *profile);
 gchar **r_find_all_applicable_nodes(RNode *root, guint8 *key, gint keylen, RNodeGetValueFunc value_func);
+void r_walk_tree(RNode *root, RNodeWalkFunc func, gpointer user_data);
+
+RProfile *r_profile_new(void);
+void r_profile_reset(RProfile *self);
+void r_profile_free(RProfile *self);
+RProfileEntry *r_profile_lookup(RProfile *self, RNode *node);
 
 #endif
 
@@ -55,15 +55,39 @@ synthetic_message_add_value_template_string(SyntheticMessage *self, GlobalConfig
   return result;
 }
 
+/*
+ * The values are applied to every message matching a rule and to every
+ * message generated by an action, so the name-value handle is resolved
+ * here, once, and templates without macros are expanded right away, so
+ * that applying them is a plain log_msg_set_value().
+ */
 void
 synthetic_message_add_value_template(SyntheticMessage *self, const gchar *name, LogTemplate *value)
 {
+  SyntheticMessageValue plan_entry = { 0 };
+
   if (!self->values)
-    self->values = g_ptr_array_new();
+    {
+      self->values = g_ptr_array_new();
+      self->value_plan = g_array_new(FALSE, FALSE, sizeof(SyntheticMessageValue));
+    }
 
   /* NOTE: we shouldn't use the name property for LogTemplate structs, see the comment at log_template_set_name() */
   log_template_set_name(value, name);
   g_ptr_array_add(self->values, log_template_ref(value));
+
+  plan_entry.handle = log_msg_get_value_handle(name);
+  if (log_template_is_literal_string(value))
+    {
+      LogMessage *msg = log_msg_new_empty();
+      GString *literal = g_string_sized_new(32);
+
+      log_template_format(value, msg, NULL, LTZ_LOCAL, 0, NULL, literal);
+      plan_entry.literal_len = literal->len;
+      plan_entry.literal = g_string_free(literal, FALSE);
+      log_msg_unref(msg);
+    }
+  g_array_append_val(self->value_plan, plan_entry);
 }
 
 void
@@ -81,19 +105,55 @@ synthetic_message_apply(SyntheticMessage *self, CorrellationContext *context, Lo
     {
       for (i = 0; i < self->values->len; i++)
         {
+          SyntheticMessageValue *plan_entry = &g_array_index(self->value_plan, SyntheticMessageValue, i);
+
+          if (plan_entry->literal)
+            {
+              log_msg_set_value(msg, plan_entry->handle, plan_entry->literal, plan_entry->literal_len);
+              continue;
+            }
+
           log_template_format_with_context(g_ptr_array_index(self->values, i),
                                            context ? (LogMessage **) context->messages->pdata : &msg,
                                            context ? context->messages->len : 1,
                                            NULL, LTZ_LOCAL, 0, context ? context->key.session_id : NULL, buffer);
-          log_msg_set_value_by_name(msg,
-                                    ((LogTemplate *) g_ptr_array_index(self->values, i))->name,
-                                    buffer->str,
-                                    buffer->len);
+          log_msg_set_value(msg, plan_entry->handle, buffer->str, buffer->len);
         }
     }
 
 }
 
+/* weight of a new sample in the payload size average is 1/2^SHIFT */
+#define SYNTHETIC_MESSAGE_PAYLOAD_SIZE_AVG_SHIFT 3
+
+/*
+ * Messages generated from scratch start with a payload sized after the
+ * earlier messages of the same action, so that the values added to them
+ * don't need to grow it step by step.  Concurrent updates may lose a
+ * sample, which is fine for an estimate.
+ */
+static void
+_update_payload_size_estimate(SyntheticMessage *self, LogMessage *genmsg)
+{
+  gint estimate = g_atomic_int_get(&self->payload_size_estimate);
+  gint size = MIN(nv_table_get_payload_size(genmsg->payload), NV_TABLE_MAX_BYTES);
+
+  if (estimate == 0)
+    estimate = size;
+  else
+    estimate += (size - estimate) / (1 << SYNTHETIC_MESSAGE_PAYLOAD_SIZE_AVG_SHIFT);
+  g_atomic_int_set(&self->payload_size_estimate, estimate);
+}
+
+static void
+_apply_to_generated_message(SyntheticMessage *self, SyntheticMessageInheritMode inherit_mode,
+                            CorrellationContext *context, LogMessage *genmsg, GString *buffer)
+{
+  synthetic_message_apply(self, context, genmsg, buffer);
+  if (inherit_mode == RAC_MSG_INHERIT_NONE)
+    _update_payload_size_estimate(self, genmsg);
+}
+
 static LogMessage *
 _generate_message_inheriting_properties_from_the_last_message(LogMessage *msg)
 {
@@ -104,11 +164,11 @@ _generate_message_inheriting_properties_from_the_last_message(LogMessage *msg)
 }
 
 static LogMessage *
-_generate_new_message_with_timestamp_of_the_triggering_message(LogStamp *msgstamp)
+_generate_new_message_with_timestamp_of_the_triggering_message(SyntheticMessage *self, LogStamp *msgstamp)
 {
   LogMessage *genmsg;
 
-  genmsg = log_msg_new_empty();
+  genmsg = log_msg_new_empty_with_size_hint(g_atomic_int_get(&self->payload_size_estimate));
   genmsg->flags |= LF_LOCAL;
   genmsg->timestamps[LM_TS_STAMP] = *msgstamp;
   return genmsg;
@@ -124,7 +184,7 @@ _generate_message_inheriting_properties_from_the_entire_context(CorrellationCont
 }
 
 static LogMessage *
-_generate_default_message(SyntheticMessageInheritMode inherit_mode, LogMessage *triggering_msg)
+_generate_default_message(SyntheticMessage *self, SyntheticMessageInheritMode inherit_mode, LogMessage *triggering_msg)
 {
   switch (inherit_mode)
     {
@@ -132,19 +192,19 @@ _generate_default_message(SyntheticMessageInheritMode inherit_mode, LogMessage *
     case RAC_MSG_INHERIT_CONTEXT:
       return _generate_message_inheriting_properties_from_the_last_message(triggering_msg);
     case RAC_MSG_INHERIT_NONE:
-      return _generate_new_message_with_timestamp_of_the_triggering_message(&triggering_msg->timestamps[LM_TS_STAMP]);
+      return _generate_new_message_with_timestamp_of_the_triggering_message(self, &triggering_msg->timestamps[LM_TS_STAMP]);
     default:
       g_assert_not_reached();
     }
 }
 
 static LogMessage *
-_generate_default_message_from_context(SyntheticMessageInheritMode inherit_mode, CorrellationContext *context)
+_generate_default_message_from_context(SyntheticMessage *self, SyntheticMessageInheritMode inherit_mode, CorrellationContext *context)
 {
   LogMessage *triggering_msg = correllation_context_get_last_message(context);
 
   if (inherit_mode != RAC_MSG_INHERIT_CONTEXT)
-    return _generate_default_message(inherit_mode, triggering_msg);
+    return _generate_default_message(self, inherit_mode, triggering_msg);
 
   return _generate_message_inheriting_properties_from_the_entire_context(context);
 }
@@ -154,7 +214,7 @@ synthetic_message_generate_with_context(SyntheticMessage *self, SyntheticMessage
 {
   LogMessage *genmsg;
 
-  genmsg = _generate_default_message_from_context(inherit_mode, context);
+  genmsg = _generate_default_message_from_context(self, inherit_mode, context);
   switch (context->key.scope)
     {
       case RCS_PROCESS:
@@ -170,7 +230,7 @@ synthetic_message_generate_with_context(SyntheticMessage *self, SyntheticMessage
       break;
     }
   g_ptr_array_add(context->messages, genmsg);
-  synthetic_message_apply(self, context, genmsg, buffer);
+  _apply_to_generated_message(self, inherit_mode, context, genmsg, buffer);
   g_ptr_array_remove_index_fast(context->messages, context->messages->len - 1);
   return genmsg;
 }
@@ -180,7 +240,7 @@ synthetic_message_generate_without_context(SyntheticMessage *self, SyntheticMess
 {
   LogMessage *genmsg;
 
-  genmsg = _generate_default_message(inherit_mode, msg);
+  genmsg = _generate_default_message(self, inherit_mode, msg);
 
   /* no context, which means no correllation. The action
    * rule contains the generated message at @0 and the one
@@ -194,7 +254,7 @@ synthetic_message_generate_without_context(SyntheticMessage *self, SyntheticMess
   GPtrArray dummy_ptr_array = { .pdata = (void **) dummy_msgs, .len = 2 };
   CorrellationContext dummy_context = { .messages = &dummy_ptr_array, 0 };
 
-  synthetic_message_apply(self, &dummy_context, genmsg, buffer);
+  _apply_to_generated_message(self, inherit_mode, &dummy_context, genmsg, buffer);
   return genmsg;
 }
 
@@ -215,9 +275,13 @@ synthetic_message_deinit(SyntheticMessage *self)
   if (self->values)
     {
       for (i = 0; i < self->values->len; i++)
-        log_template_unref(g_ptr_array_index(self->values, i));
+        {
+          log_template_unref(g_ptr_array_index(self->values, i));
+          g_free(g_array_index(self->value_plan, SyntheticMessageValue, i).literal);
+        }
 
       g_ptr_array_free(self->values, TRUE);
+      g_array_free(self->value_plan, TRUE);
     }
 }
 
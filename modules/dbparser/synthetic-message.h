@@ -34,10 +34,23 @@ typedef enum
   RAC_MSG_INHERIT_CONTEXT
 } SyntheticMessageInheritMode;
 
+/* the precompiled form of a value, see synthetic_message_add_value_template() */
+typedef struct _SyntheticMessageValue
+{
+  NVHandle handle;
+  /* the expanded value, if the template contains no macros */
+  gchar *literal;
+  gsize literal_len;
+} SyntheticMessageValue;
+
 typedef struct _SyntheticMessage
 {
   GArray *tags;
   GPtrArray *values;
+  /* SyntheticMessageValue entries, in the same order as values */
+  GArray *value_plan;
+  /* running average of the payload size of the messages generated from scratch */
+  gint payload_size_estimate;
 } SyntheticMessage;
 
 LogMessage *synthetic_message_generate_without_context(SyntheticMessage *self, SyntheticMessageInheritMode inherit_mode, LogMessage *msg, GString *buffer);
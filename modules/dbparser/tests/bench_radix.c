@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+/*
+ * Radix tree benchmark
+ *
+ * Builds a tree of a thousand literal patterns and a few patterns with
+ * parsers, and measures lookups with and without collecting the matches,
+ * both before and after freezing the tree.  It is not run as part of
+ * "make check", build and run it explicitly:
+ *
+ *   make modules/dbparser/tests/bench_radix
+ *   ./modules/dbparser/tests/bench_radix [iterations]
+ */
+
+#include "apphook.h"
+#include "radix.h"
+#include "messages.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define BENCH_DEFAULT_ITERATIONS 1000000
+#define BENCH_LITERALS 1000
+
+static gchar *bench_patterns[] =
+{
+  "Accepted password for @ESTRING:user: @from @IPv4:ip@ port @NUMBER:port@ ssh2",
+  "Failed password for invalid user @ESTRING:user: @from @IPv4:ip@ port @NUMBER:port@ ssh2",
+  "session opened for user @ESTRING:user: @by (uid=@NUMBER:uid@)",
+  "connection from @IPvANY:client@ (@QSTRING:name:()@) closed after @FLOAT:duration@ seconds",
+  NULL
+};
+
+static gchar *bench_keys[] =
+{
+  "literal message 500 of the benchmark",
+  "Accepted password for bazsi from 10.10.10.10 port 52311 ssh2",
+  "connection from 192.168.1.1 (gateway) closed after 1.5 seconds",
+  NULL
+};
+
+typedef struct _BenchRadix
+{
+  RNode *root;
+  gchar *key;
+  gint key_len;
+  GArray *matches;
+} BenchRadix;
+
+static void
+bench_find(gpointer user_data, gint iterations)
+{
+  BenchRadix *self = (BenchRadix *) user_data;
+  gint i;
+
+  for (i = 0; i < iterations; i++)
+    r_find_node(self->root, (guint8 *) self->key, self->key_len, NULL);
+}
+
+static void
+bench_find_with_matches(gpointer user_data, gint iterations)
+{
+  BenchRadix *self = (BenchRadix *) user_data;
+  RParserMatch *match;
+  gint i, j;
+
+  for (i = 0; i < iterations; i++)
+    {
+      g_array_set_size(self->matches, 1);
+      r_find_node(self->root, (guint8 *) self->key, self->key_len, self->matches);
+
+      for (j = 0; j < self->matches->len; j++)
+        {
+          match = &g_array_index(self->matches, RParserMatch, j);
+          g_free(match->match);
+          match->match = NULL;
+        }
+    }
+}
+
+static void
+bench_insert(RNode *root, const gchar *key)
+{
+  /* r_insert_node() modifies its input */
+  gchar *dup = g_strdup(key);
+
+  r_insert_node(root, (guint8 *) dup, (gpointer) key, NULL);
+  g_free(dup);
+}
+
+static RNode *
+bench_build_tree(gchar literals[][64])
+{
+  RNode *root = r_new_node((guint8 *) "", NULL);
+  gint i;
+
+  for (i = 0; i < BENCH_LITERALS; i++)
+    {
+      g_snprintf(literals[i], 64, "literal message %d of the benchmark", i);
+      bench_insert(root, literals[i]);
+    }
+  for (i = 0; bench_patterns[i]; i++)
+    bench_insert(root, bench_patterns[i]);
+  return root;
+}
+
+static void
+bench_lookups(BenchRadix *bench, const gchar *tree_name, gint iterations)
+{
+  gchar title[128];
+  gint i;
+
+  for (i = 0; bench_keys[i]; i++)
+    {
+      bench->key = bench_keys[i];
+      bench->key_len = strlen(bench_keys[i]);
+
+      g_snprintf(title, sizeof(title), "%s/find/%.16s", tree_name, bench->key);
+      bench_run(title, bench_find, bench, iterations);
+      g_snprintf(title, sizeof(title), "%s/find+matches/%.16s", tree_name, bench->key);
+      bench_run(title, bench_find_with_matches, bench, iterations);
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+  static gchar literals[BENCH_LITERALS][64];
+  BenchRadix bench;
+  gint iterations;
+
+  bench_init();
+  iterations = bench_get_iterations(argc, argv, BENCH_DEFAULT_ITERATIONS);
+
+  app_startup();
+  msg_init(TRUE);
+
+  bench.matches = g_array_new(FALSE, TRUE, sizeof(RParserMatch));
+  bench.root = bench_build_tree(literals);
+
+  printf("Radix tree benchmark, %d patterns, %d iterations per round\n",
+         BENCH_LITERALS + (gint) (G_N_ELEMENTS(bench_patterns) - 1), iterations);
+  bench_lookups(&bench, "tree", iterations);
+
+  bench.root = r_freeze_tree(bench.root);
+  bench_lookups(&bench, "frozen", iterations);
+
+  r_free_node(bench.root, NULL);
+  g_array_free(bench.matches, TRUE);
+  app_shutdown();
+  return 0;
+}
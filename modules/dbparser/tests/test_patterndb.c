@@ -30,6 +30,8 @@
 #include "plugin.h"
 #include "cfg.h"
 #include "timerwheel.h"
+#include "pdb-ruleset.h"
+#include "pdb-cache.h"
 #include "libtest/msg_parse_lib.h"
 
 #include <stdio.h>
@@ -114,7 +116,7 @@ static void
 _advance_time(gint timeout)
 {
   if (timeout)
-    timer_wheel_set_time(pattern_db_get_timer_wheel(patterndb), timer_wheel_get_time(pattern_db_get_timer_wheel(patterndb)) + timeout + 1);
+    pattern_db_advance_time(patterndb, timeout + 1);
 }
 
 static LogMessage *
@@ -406,10 +408,9 @@ gchar *pdb_ruletest_skeleton = "<patterndb version='3' pub_date='2010-02-22'>\
  </ruleset>\
 </patterndb>";
 
-void
-test_patterndb_rule(void)
+static void
+_assert_ruletest_skeleton_rules(void)
 {
-  _load_pattern_db_from_string(pdb_ruletest_skeleton);
   assert_msg_matches_and_has_tag("pattern11", "tag11-1", TRUE);
   assert_msg_matches_and_has_tag("pattern11", ".classifier.system", TRUE);
   assert_msg_matches_and_has_tag("pattern11", "tag11-2", TRUE);
@@ -453,7 +454,51 @@ test_patterndb_rule(void)
 
   assert_msg_matches_and_output_message_nvpair_equals("contextlesstest value1", 1, "MESSAGE",  "message1");
   assert_msg_matches_and_output_message_nvpair_equals("contextlesstest value2", 1, "MESSAGE",  "message2");
+}
+
+void
+test_patterndb_rule(void)
+{
+  _load_pattern_db_from_string(pdb_ruletest_skeleton);
+  _assert_ruletest_skeleton_rules();
+  _destroy_pattern_db();
+}
+
+void
+test_patterndb_rule_loaded_from_cache(void)
+{
+  PDBRuleSet *ruleset;
+  gchar *cache_file;
+
+  _load_pattern_db_from_string(pdb_ruletest_skeleton);
+  cache_file = pdb_rule_set_get_cache_filename(filename);
+  assert_true(pdb_rule_set_save_cache(pattern_db_get_ruleset(patterndb), cache_file, filename),
+              "Error saving patterndb cache");
+
+  ruleset = pdb_rule_set_new();
+  assert_true(pdb_rule_set_load_cache(ruleset, configuration, cache_file, filename),
+              "Error loading patterndb cache");
+  pdb_rule_set_free(ruleset);
+
+  /* the cache is picked up for the same file */
+  assert_true(pattern_db_reload_ruleset(patterndb, configuration, filename), "Error reloading ruleset");
+  assert_string(pattern_db_get_ruleset_version(patterndb), "3", "Invalid version");
+  assert_string(pattern_db_get_ruleset_pub_date(patterndb), "2010-02-22", "Invalid pubdate");
+  _assert_ruletest_skeleton_rules();
+
+  /* but not after the XML file changes */
+  g_file_set_contents(filename, pdb_conflicting_rules_with_the_same_parsers,
+                      strlen(pdb_conflicting_rules_with_the_same_parsers), NULL);
+  ruleset = pdb_rule_set_new();
+  assert_false(pdb_rule_set_load_cache(ruleset, configuration, cache_file, filename),
+               "Out of date patterndb cache was loaded");
+  pdb_rule_set_free(ruleset);
+
+  assert_true(pattern_db_reload_ruleset(patterndb, configuration, filename), "Error reloading ruleset");
+  assert_msg_matches_and_nvpair_equals("pattern foobar tail", ".classifier.rule_id", "12");
 
+  g_unlink(cache_file);
+  g_free(cache_file);
   _destroy_pattern_db();
 }
 
@@ -574,7 +619,9 @@ test_patterndb_message_property_inheritance_context(void)
 
   _feed_message_to_correllation_state("prog2", "pattern-with-inheritance-context", "merged1", "merged1");
   _feed_message_to_correllation_state("prog2", "pattern-with-inheritance-context", "merged2", "merged2");
+  assert_guint64(pattern_db_get_expiry_lag(patterndb), 0, "The shard of the context should be up to date");
   _advance_time(60);
+  assert_guint64(pattern_db_get_expiry_lag(patterndb), 0, "Advancing the time should expire all shards");
 
   assert_output_message_nvpair_equals(2, "MESSAGE", "action message");
   assert_output_message_nvpair_equals(2, "merged1", "merged1");
@@ -703,6 +750,7 @@ main(int argc, char *argv[])
   test_conflicting_rules_with_different_parsers();
   test_conflicting_rules_with_the_same_parsers();
   test_patterndb_rule();
+  test_patterndb_rule_loaded_from_cache();
   test_patterndb_parsers();
   test_patterndb_message_property_inheritance();
   test_patterndb_context_length();
@@ -87,7 +87,7 @@ testcase_get_logmessages(gchar *logs)
 }
 
 void
-testcase_frequent_words(gchar* logs, guint support, gchar *expected)
+testcase_frequent_words(gchar* logs, guint support, gchar *expected, guint num_of_threads)
 {
   int i, twopass;
   gchar **expecteds;
@@ -101,7 +101,7 @@ testcase_frequent_words(gchar* logs, guint support, gchar *expected)
 
   for (twopass = 1; twopass <= 2; ++twopass)
     {
-      wordlist = ptz_find_frequent_words(logmessages->logmessages, support, delimiters, twopass == 1);
+      wordlist = ptz_find_frequent_words(logmessages->logmessages, support, delimiters, twopass == 1, num_of_threads);
 
       for (i = 0; expecteds[i]; ++i)
         {
@@ -129,8 +129,8 @@ testcase_frequent_words(gchar* logs, guint support, gchar *expected)
           if (ret != (guint) expected_occurance)
             {
               fail = TRUE;
-              fprintf(stderr, "Frequent words test case failed; word: '%s', expected=%d, got=%d, support=%d\n",
-                  expected_word, expected_occurance, ret, support);
+              fprintf(stderr, "Frequent words test case failed; word: '%s', expected=%d, got=%d, support=%d, threads=%d\n",
+                  expected_word, expected_occurance, ret, support, num_of_threads);
 
               fprintf(stderr, "Input:\n%s\n", logs);
               fprintf(stderr, "Full results:\n");
@@ -152,59 +152,59 @@ testcase_frequent_words(gchar* logs, guint support, gchar *expected)
 }
 
 void
-frequent_words_tests()
+frequent_words_tests(guint num_of_threads)
 {
 
   /* simple tests */
 
   testcase_frequent_words(
       "a\n", 0,
-      "0 a:1");
+      "0 a:1", num_of_threads);
 
   testcase_frequent_words(
       "a b\n", 0,
       "0 a:1,"
-      "1 b:1");
+      "1 b:1", num_of_threads);
 
   testcase_frequent_words(
       "a a\n"
       "b b", 0,
       "0 a:1,1 a:1,"
-      "0 b:1,1 b:1");
+      "0 b:1,1 b:1", num_of_threads);
 
   testcase_frequent_words(
       "a b\n"
       "b a", 0,
       "0 a:1,1 a:1,"
-      "0 b:1,1 b:1");
+      "0 b:1,1 b:1", num_of_threads);
 
   testcase_frequent_words(
       "a b\n"
       "a b", 0,
       "0 a:2,"
-      "1 b:2");
+      "1 b:2", num_of_threads);
 
   /* support threshold tests */
 
   testcase_frequent_words(
       "a\n", 1,
-      "");
+      "", num_of_threads);
 
   testcase_frequent_words(
       "a b\n", 1,
-      "");
+      "", num_of_threads);
 
   testcase_frequent_words(
       "a b\n"
       "b a", 1,
       "0 a:1,1 a:1,"
-      "0 b:1,1 b:1");
+      "0 b:1,1 b:1", num_of_threads);
 
   testcase_frequent_words(
       "a b\n"
       "b a\n"
       "a c", 2,
-      "0 a:2");
+      "0 a:2", num_of_threads);
 }
 
 typedef struct _clusterfindData
@@ -297,7 +297,7 @@ test_clusters_find(gpointer key, gpointer value, gpointer user_data)
 }
 
 void
-testcase_find_clusters_slct(gchar* logs, guint support, gchar *expected)
+testcase_find_clusters_slct(gchar* logs, guint support, gchar *expected, guint num_of_threads)
 {
   int i,j;
   gchar **expecteds;
@@ -309,7 +309,7 @@ testcase_find_clusters_slct(gchar* logs, guint support, gchar *expected)
 
   logmessages = testcase_get_logmessages(logs);
 
-  clusters = ptz_find_clusters_slct(logmessages->logmessages, support, delimiters, 0);
+  clusters = ptz_find_clusters_slct(logmessages->logmessages, support, delimiters, 0, num_of_threads);
 
   expecteds = g_strsplit(expected, "|", 0);
   for (i = 0; expecteds[i]; ++i)
@@ -367,30 +367,30 @@ testcase_find_clusters_slct(gchar* logs, guint support, gchar *expected)
 }
 
 void
-find_clusters_slct_tests()
+find_clusters_slct_tests(guint num_of_threads)
 {
   testcase_find_clusters_slct(
       "a\n", 0,
-      "0:1");
+      "0:1", num_of_threads);
 
   testcase_find_clusters_slct(
       "a\n"
       "b\n", 0,
-      "0:1|1:1");
+      "0:1|1:1", num_of_threads);
 
   testcase_find_clusters_slct(
       "a\n"
       "b\n"
       "a\n"
       "b\n", 2,
-      "0,2:2|1,3:2");
+      "0,2:2|1,3:2", num_of_threads);
 
   testcase_find_clusters_slct(
       "alma korte korte alma\n"
       "alma korte\n"
       "bela korte\n"
       "alma\n", 1,
-      "0:1|1:1|2:1|3:1");
+      "0:1|1:1|2:1|3:1", num_of_threads);
 
   /*
   testcase_find_clusters_slct(
@@ -398,14 +398,14 @@ find_clusters_slct_tests()
       "alma korte\n"
       "bela korte\n"
       "alma\n", 2,
-      "0,1:2");
+      "0,1:2", num_of_threads);
 
   testcase_find_clusters_slct(
       "alma korte korte alma\n"
       "alma korte\n"
       "bela korte\n"
       "alma\n", 3,
-      "0,1,3:3"); // FIXME: will this happen this way?
+      "0,1,3:3", num_of_threads); // FIXME: will this happen this way?
 
       */
 
@@ -417,7 +417,7 @@ find_clusters_slct_tests()
       "bela korte\n"
       "bela korte\n"
       "alma\n", 2,
-      "0,1,2,3:4|4,5:2");
+      "0,1,2,3:4|4,5:2", num_of_threads);
 
   testcase_find_clusters_slct(
       "alma korte\n"
@@ -427,21 +427,21 @@ find_clusters_slct_tests()
       "bela korte\n"
       "bela korte\n"
       "alma\n", 3,
-      "0,1,2,3:4");
+      "0,1,2,3:4", num_of_threads);
 
   testcase_find_clusters_slct(
       "alma korte asdf1 labda\n"
       "alma korte asdf2 labda\n"
       "alma korte asdf3 labda\n"
       "sallala\n", 3,
-      "0,1,2:3");
+      "0,1,2:3", num_of_threads);
 
   testcase_find_clusters_slct(
       "alma korte asdf1 labda qwe1\n"
       "alma korte asdf2 labda qwe2\n"
       "alma korte asdf3 labda qwe3\n"
       "sallala\n", 3,
-      "0,1,2:3");
+      "0,1,2:3", num_of_threads);
 }
 
 int
@@ -453,8 +453,10 @@ main()
   msg_format_options_defaults(&parse_options);
   msg_format_options_init(&parse_options, configuration);
 
-  frequent_words_tests();
-  find_clusters_slct_tests();
+  frequent_words_tests(1);
+  find_clusters_slct_tests(1);
+  frequent_words_tests(4);
+  find_clusters_slct_tests(4);
   log_tags_global_deinit();
 
   return  (fail ? 1 : 0);
@@ -454,6 +454,8 @@ test_matches(void)
   test_search_matches(root, "bbb4 192.168.1.huhuhu", NULL);
   test_search_matches(root, "bbb4 192.168.1 huhuhu", NULL);
   test_search_matches(root, "bbb4 192.168.1. huhuhu", NULL);
+  test_search_matches(root, "bbb4 192.168.1.256 huhuhu", NULL);
+  test_search_matches(root, "bbb4 192.168.1.42949672961 huhuhu", NULL);
   test_search_matches(root, "bbb 192.168.1huhuhu", NULL);
   test_search_matches(root, "bbb 192.168.1.huhuhu", NULL);
   test_search_matches(root, "bbb 192.168.1 huhuhu", NULL);
@@ -663,6 +665,7 @@ test_matches(void)
   test_search_matches(root, "ggg  aaa", "set", " ", NULL);
   test_search_matches(root, "ggg   aaa", "set", "  ", NULL);
   test_search_matches(root, "ggg 	aaa", "set", "	", NULL);
+  test_search_matches(root, "ggg   ", "set", "  ", NULL);
   test_search_matches(root, "iii 82:63:25:93:eb:51.iii", "macaddr", "82:63:25:93:eb:51", NULL);
   test_search_matches(root, "iii 82:63:25:93:EB:51.iii", "macaddr", "82:63:25:93:EB:51", NULL);
   test_search_matches(root, "jjj abcabcd", "regexp", "abcabc", NULL);
@@ -687,6 +690,145 @@ test_matches(void)
   r_free_node(root, NULL);
 }
 
+void
+test_frozen_tree(void)
+{
+  RNode *root = r_new_node("", NULL);
+  gchar *keys[] = { "afoo", "bfoo", "cfoo", "dfoo", "efoo", "ffoo", "gfoo", "hfoo", "nfoo", "zfoo", NULL };
+  gint i;
+
+  /* enough children to get a first character index */
+  for (i = 0; keys[i]; i++)
+    insert_node(root, keys[i]);
+  insert_node(root, "\xc3\xa1rv\xc3\xadzt\xc5\xb1r\xc5\x91");
+  insert_node(root, "\xc3\xa9v");
+  insert_node(root, "num@NUMBER:number@ ok");
+  insert_node(root, "num@NUMBER:number@");
+  insert_node(root, "str@ESTRING:first: @@ANYSTRING:rest@");
+
+  root = r_freeze_tree(root);
+  if (!root->frozen || !root->child_index)
+    {
+      printf("FAIL: tree is not frozen as expected\n");
+      fail = TRUE;
+    }
+
+  test_search(root, "afoo", TRUE);
+  test_search(root, "nfoo", TRUE);
+  test_search(root, "zfoo", TRUE);
+  test_search(root, "zfo", FALSE);
+  test_search(root, "Afoo", FALSE);
+  test_search(root, "\xc3\xa1rv\xc3\xadzt\xc5\xb1r\xc5\x91", TRUE);
+  test_search(root, "\xc3\xa9v", TRUE);
+  test_search_value(root, "num 123", NULL);
+  test_search_value(root, "num123 ok", "num@NUMBER:number@ ok");
+  test_search_matches(root, "num123", "number", "123", NULL);
+  test_search_matches(root, "strfoo bar baz", "first", "foo", "rest", "bar baz", NULL);
+
+  r_free_node(root, NULL);
+}
+
+typedef struct _TestProfilePath
+{
+  const gchar *path;
+  RNode *node;
+} TestProfilePath;
+
+static void
+_find_node_by_path(RNode *node, const gchar *path, gpointer user_data)
+{
+  TestProfilePath *lookup = (TestProfilePath *) user_data;
+
+  if (strcmp(path, lookup->path) == 0)
+    lookup->node = node;
+}
+
+static RProfileEntry *
+_lookup_profile_entry(RNode *root, RProfile *profile, const gchar *path)
+{
+  TestProfilePath lookup = { path, NULL };
+  RProfileEntry *entry;
+
+  r_walk_tree(root, _find_node_by_path, &lookup);
+  if (!lookup.node)
+    {
+      printf("FAIL: no node found with path: '%s'\n", path);
+      fail = TRUE;
+      return NULL;
+    }
+  entry = r_profile_lookup(profile, lookup.node);
+  if (!entry)
+    {
+      printf("FAIL: node was not profiled: '%s'\n", path);
+      fail = TRUE;
+    }
+  return entry;
+}
+
+static void
+_assert_profile_counter(guint64 value, guint64 expected, const gchar *name)
+{
+  if (value != expected)
+    {
+      printf("FAIL: unexpected profile counter %s: %" G_GUINT64_FORMAT " <> %" G_GUINT64_FORMAT "\n", name, value, expected);
+      fail = TRUE;
+    }
+}
+
+void
+test_profile(void)
+{
+  RNode *root = r_new_node("", NULL);
+  RProfile *profile = r_profile_new();
+  RProfileEntry *entry;
+
+  insert_node(root, "a @ESTRING:x: @end");
+
+  if (!r_find_node_prof(root, "a foo end", 9, NULL, profile))
+    {
+      printf("FAIL: profiled lookup did not find the expected node\n");
+      fail = TRUE;
+    }
+  /* the parser matches, but leads to a dead end */
+  r_find_node_prof(root, "a foo bar", 9, NULL, profile);
+  /* the parser fails */
+  r_find_node_prof(root, "a foo", 5, NULL, profile);
+
+  _assert_profile_counter(profile->lookups, 3, "lookups");
+  _assert_profile_counter(profile->failed_lookups, 2, "failed_lookups");
+
+  entry = _lookup_profile_entry(root, profile, "a @ESTRING:x: @");
+  if (entry)
+    {
+      _assert_profile_counter(entry->parser_attempts, 3, "parser_attempts");
+      _assert_profile_counter(entry->parser_failures, 1, "parser_failures");
+      _assert_profile_counter(entry->parser_dead_ends, 1, "parser_dead_ends");
+    }
+
+  entry = _lookup_profile_entry(root, profile, "a @ESTRING:x: @end");
+  if (entry)
+    {
+      _assert_profile_counter(entry->visits, 1, "visits");
+      _assert_profile_counter(entry->matches, 1, "matches");
+      _assert_profile_counter(entry->match_parser_attempts, 1, "match_parser_attempts");
+      _assert_profile_counter(entry->match_parser_failures, 0, "match_parser_failures");
+    }
+
+  entry = _lookup_profile_entry(root, profile, "a ");
+  if (entry)
+    _assert_profile_counter(entry->visits, 3, "visits");
+
+  r_profile_reset(profile);
+  if (profile->lookups || r_profile_lookup(profile, root))
+    {
+      printf("FAIL: profile was not reset\n");
+      fail = TRUE;
+    }
+
+  r_profile_free(profile);
+  r_free_node(root, NULL);
+}
+
 void
 test_zorp_logs(void)
 {
@@ -720,6 +862,8 @@ main(int argc, char *argv[])
   test_literals();
   test_parsers();
   test_matches();
+  test_frozen_tree();
+  test_profile();
   test_zorp_logs();
 
   app_shutdown();
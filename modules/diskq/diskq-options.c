@@ -78,6 +78,55 @@ disk_queue_options_mem_buf_length_set(DiskQueueOptions *self, gint mem_buf_lengt
   self->mem_buf_length = mem_buf_length;
 }
 
+void
+disk_queue_options_use_mmap_set(DiskQueueOptions *self, gboolean use_mmap)
+{
+  self->use_mmap = use_mmap;
+}
+
+void
+disk_queue_options_sync_max_latency_set(DiskQueueOptions *self, gint sync_max_latency)
+{
+  self->sync_max_latency = sync_max_latency;
+}
+
+void
+disk_queue_options_sync_max_bytes_set(DiskQueueOptions *self, gint64 sync_max_bytes)
+{
+  self->sync_max_bytes = sync_max_bytes;
+}
+
+void
+disk_queue_options_async_io_set(DiskQueueOptions *self, gboolean async_io)
+{
+  self->async_io = async_io;
+}
+
+void
+disk_queue_options_compress_set(DiskQueueOptions *self, gboolean compress)
+{
+#if !SYSLOG_NG_HAVE_ZLIB
+  if (compress)
+    {
+      msg_warning("WARNING: disk-buffer: compress() is not supported, syslog-ng was compiled without zlib support", NULL);
+      compress = FALSE;
+    }
+#endif
+  self->compress = compress;
+}
+
+void
+disk_queue_options_hybrid_set(DiskQueueOptions *self, gboolean hybrid)
+{
+  self->hybrid = hybrid;
+}
+
+void
+disk_queue_options_use_index_set(DiskQueueOptions *self, gboolean use_index)
+{
+  self->use_index = use_index;
+}
+
 void
 disk_queue_options_check_plugin_settings(DiskQueueOptions *self)
 {
@@ -87,6 +136,23 @@ disk_queue_options_check_plugin_settings(DiskQueueOptions *self)
         {
           msg_warning("WARNING: Reliable queue: the mem-buf-length parameter is omitted", NULL);
         }
+      if (self->sync_max_bytes > 0 && self->sync_max_latency <= 0)
+        {
+          msg_warning("WARNING: Reliable queue: sync-max-bytes() is set without sync-max-latency(), using the default latency",
+                      evt_tag_int("sync_max_latency", DISK_QUEUE_DEFAULT_SYNC_MAX_LATENCY),
+                      NULL);
+          self->sync_max_latency = DISK_QUEUE_DEFAULT_SYNC_MAX_LATENCY;
+        }
+      if (self->async_io)
+        {
+          msg_warning("WARNING: Reliable queue: the async-io() parameter is omitted", NULL);
+          self->async_io = FALSE;
+        }
+      if (self->hybrid)
+        {
+          msg_warning("WARNING: Reliable queue: the hybrid() parameter is omitted", NULL);
+          self->hybrid = FALSE;
+        }
     }
   else
     {
@@ -94,6 +160,17 @@ disk_queue_options_check_plugin_settings(DiskQueueOptions *self)
         {
           msg_warning("WARNING: Non-reliable queue: the mem-buf-size parameter is omitted", NULL);
         }
+      if (self->sync_max_latency > 0 || self->sync_max_bytes > 0)
+        {
+          msg_warning("WARNING: Non-reliable queue: the sync-max-latency() and sync-max-bytes() parameters are omitted", NULL);
+          self->sync_max_latency = 0;
+          self->sync_max_bytes = 0;
+        }
+      if (self->hybrid && self->async_io)
+        {
+          msg_warning("WARNING: Non-reliable queue: the async-io() parameter is omitted in hybrid mode", NULL);
+          self->async_io = FALSE;
+        }
     }
 }
 
@@ -115,6 +192,13 @@ disk_queue_options_set_default_options(DiskQueueOptions *self)
   self->reliable = FALSE;
   self->mem_buf_size = -1;
   self->qout_size = -1;
+  self->use_mmap = FALSE;
+  self->sync_max_latency = 0;
+  self->sync_max_bytes = 0;
+  self->async_io = FALSE;
+  self->compress = FALSE;
+  self->hybrid = FALSE;
+  self->use_index = FALSE;
   self->dir = g_strdup(get_installation_path_for(SYSLOG_NG_PATH_LOCALSTATEDIR));
 }
 
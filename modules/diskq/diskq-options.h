@@ -29,6 +29,9 @@
 
 #define MIN_DISK_BUF_SIZE 1024*1024
 
+/* in milliseconds, used if only sync-max-bytes() is set */
+#define DISK_QUEUE_DEFAULT_SYNC_MAX_LATENCY 100
+
 typedef struct _DiskQueueOptions
 {
   gint64 disk_buf_size;
@@ -37,6 +40,13 @@ typedef struct _DiskQueueOptions
   gboolean reliable;
   gint mem_buf_size;
   gint mem_buf_length;
+  gboolean use_mmap;
+  gint sync_max_latency;
+  gint64 sync_max_bytes;
+  gboolean async_io;
+  gboolean compress;
+  gboolean hybrid;
+  gboolean use_index;
   gchar *dir;
 } DiskQueueOptions;
 
@@ -45,6 +55,13 @@ void disk_queue_options_disk_buf_size_set(DiskQueueOptions *self, gint64 disk_bu
 void disk_queue_options_reliable_set(DiskQueueOptions *self, gboolean reliable);
 void disk_queue_options_mem_buf_size_set(DiskQueueOptions *self, gint mem_buf_size);
 void disk_queue_options_mem_buf_length_set(DiskQueueOptions *self, gint mem_buf_length);
+void disk_queue_options_use_mmap_set(DiskQueueOptions *self, gboolean use_mmap);
+void disk_queue_options_sync_max_latency_set(DiskQueueOptions *self, gint sync_max_latency);
+void disk_queue_options_sync_max_bytes_set(DiskQueueOptions *self, gint64 sync_max_bytes);
+void disk_queue_options_async_io_set(DiskQueueOptions *self, gboolean async_io);
+void disk_queue_options_compress_set(DiskQueueOptions *self, gboolean compress);
+void disk_queue_options_hybrid_set(DiskQueueOptions *self, gboolean hybrid);
+void disk_queue_options_use_index_set(DiskQueueOptions *self, gboolean use_index);
 void disk_queue_options_check_plugin_settings(DiskQueueOptions *self);
 void disk_queue_options_set_dir(DiskQueueOptions *self, const gchar *dir);
 void disk_queue_options_set_default_options(DiskQueueOptions *self);
@@ -36,6 +36,13 @@ static CfgLexerKeyword diskq_keywords[] = {
   { "mem_buf_size",      KW_MEM_BUF_SIZE },
   { "qout_size",         KW_QOUT_SIZE },
   { "dir",               KW_DIR },
+  { "mmap",              KW_MMAP },
+  { "sync_max_latency",  KW_SYNC_MAX_LATENCY },
+  { "sync_max_bytes",    KW_SYNC_MAX_BYTES },
+  { "async_io",          KW_ASYNC_IO },
+  { "compress",          KW_COMPRESS },
+  { "hybrid",            KW_HYBRID },
+  { "index",             KW_INDEX },
   { NULL }
 };
 
@@ -58,27 +58,25 @@ _acquire_queue(LogDestDriver *dd, gchar *persist_name, gpointer user_data)
       else
         queue = log_queue_disk_non_reliable_new(&self->options);
       log_queue_set_throttle(queue, dd->throttle);
+      log_queue_set_flow_control_budget(queue, dd->flow_control_budget);
       queue->persist_name = g_strdup(persist_name);
     }
 
   qfile_name = persist_state_lookup_string(cfg->state, persist_name, NULL, NULL);
-  success = log_queue_disk_load_queue(queue, qfile_name);
+  if (qfile_name)
+    {
+      /* recovering an existing queue file can take long, it is done in
+       * parallel with the other queues, a new file is started if it fails */
+      log_queue_disk_load_queue_async(queue, qfile_name);
+      g_free(qfile_name);
+      return queue;
+    }
+
+  success = log_queue_disk_load_queue(queue, NULL);
   if (!success)
     {
-      if (qfile_name && log_queue_disk_load_queue(queue, NULL))
-        {
-          msg_error("Error opening disk-queue file, a new one started",
-                    evt_tag_str("old_filename", qfile_name),
-                    evt_tag_str("new_filename", log_queue_disk_get_filename(queue)),
-                    NULL);
-          g_free(qfile_name);
-        }
-      else
-        {
-          g_free(qfile_name);
-          msg_error("Error initializing log queue", NULL);
-          return NULL;
-        }
+      msg_error("Error initializing log queue", NULL);
+      return NULL;
     }
 
   if (persist_name)
@@ -99,6 +97,12 @@ _release_queue(LogDestDriver *dd, LogQueue *queue, gpointer user_data)
 {
   GlobalConfig *cfg = log_pipe_get_config(&dd->super.super);
   gboolean persistent;
+  const gchar *qfile_name;
+
+  /* a new file might have been started by the asynchronous recovery */
+  qfile_name = log_queue_disk_get_filename(queue);
+  if (queue->persist_name && qfile_name)
+    persist_state_alloc_string(cfg->state, queue->persist_name, qfile_name, -1);
 
   log_queue_disk_save_queue(queue, &persistent);
   if (queue->persist_name)
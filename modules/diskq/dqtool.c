@@ -32,6 +32,7 @@
 #include "logqueue-disk-reliable.h"
 #include "logqueue-disk-non-reliable.h"
 #include "logmsg/logmsg-serialize.h"
+#include "serialize.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -39,6 +40,10 @@
 #include <unistd.h>
 
 gchar *template_string;
+gint skip_records;
+gint count_records = -1;
+gint export_jobs = 1;
+gchar *since_string;
 gboolean display_version;
 gboolean debug_flag;
 gboolean verbose_flag;
@@ -47,6 +52,14 @@ static GOptionEntry cat_options[] =
 {
   { "template",  't', 0, G_OPTION_ARG_STRING, &template_string,
     "Template to format the serialized messages", "<template>" },
+  { "skip",      's', 0, G_OPTION_ARG_INT, &skip_records,
+    "Skip the first N records stored on disk", "<N>" },
+  { "count",     'c', 0, G_OPTION_ARG_INT, &count_records,
+    "Print at most N records stored on disk", "<N>" },
+  { "since",     'S', 0, G_OPTION_ARG_STRING, &since_string,
+    "Print records received at or after the given UNIX timestamp", "<timestamp>" },
+  { "jobs",      'j', 0, G_OPTION_ARG_INT, &export_jobs,
+    "Number of threads decoding records in parallel", "<N>" },
   { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL }
 };
 
@@ -86,7 +99,7 @@ open_queue(char *filename, LogQueue **lq, DiskQueueOptions *options)
   else
     {
       options->disk_buf_size = 1;
-      options->mem_buf_size = 128;
+      options->mem_buf_length = 128;
       options->qout_size = 128;
       *lq = log_queue_disk_non_reliable_new(options);
     }
@@ -100,6 +113,205 @@ open_queue(char *filename, LogQueue **lq, DiskQueueOptions *options)
   return TRUE;
 }
 
+/*
+ * Range export
+ *
+ * --skip, --count, --since and --jobs operate on the records stored in the
+ * disk part of the queue, without going through the LogQueue interface.
+ * If the queue was written with index(yes), the sparse index next to the
+ * queue file is used to seek close to the first record to be printed,
+ * instead of walking through the file from its read head.
+ */
+
+#define DQTOOL_EXPORT_RECORDS_PER_JOB 1024
+
+typedef struct _DqtoolExportJob
+{
+  QDisk *qdisk;
+  LogTemplate *template;
+  gint64 since;
+  gint64 *positions;
+  gint num_positions;
+  GString *output;
+  gboolean failed;
+} DqtoolExportJob;
+
+static gboolean
+_is_range_export(void)
+{
+  return skip_records > 0 || count_records >= 0 || since_string || export_jobs > 1;
+}
+
+/* returns the index entry to start reading from, or NULL */
+static QDiskIndexEntry *
+_find_start_in_index(QDiskIndexEntry *entries, gint num_entries, gint64 first_seq, gint64 target_seq, gint64 since)
+{
+  QDiskIndexEntry *start = NULL;
+  gint i;
+
+  for (i = 0; i < num_entries; i++)
+    {
+      gint64 seq = GINT64_FROM_BE(entries[i].seq);
+
+      if (seq > target_seq)
+        break;
+
+      /* entries older than the read head point to overwritten data */
+      if (seq < first_seq || GINT64_FROM_BE(entries[i].position) < QDISK_RESERVED_SPACE)
+        continue;
+
+      /* everything before an entry written earlier than --since was received earlier too */
+      if (since && GINT64_FROM_BE(entries[i].stamp) >= since)
+        break;
+      start = &entries[i];
+    }
+  return start;
+}
+
+static gint64
+_seek_to_first_record(QDisk *qdisk, const gchar *filename, gint64 target_seq, gint64 since)
+{
+  gint64 first_seq = qdisk_get_push_count(qdisk) - qdisk_get_length(qdisk);
+  gint64 seq = first_seq;
+  gint64 position = qdisk_get_reader_head(qdisk);
+  gchar *index_filename = qdisk_get_index_filename(filename);
+  gchar *index = NULL;
+  gsize index_len;
+
+  if (g_file_get_contents(index_filename, &index, &index_len, NULL))
+    {
+      QDiskIndexEntry *start = _find_start_in_index((QDiskIndexEntry *) index, index_len / sizeof(QDiskIndexEntry),
+                                                    first_seq, target_seq, since);
+
+      if (start)
+        {
+          seq = GINT64_FROM_BE(start->seq);
+          position = GINT64_FROM_BE(start->position);
+        }
+      g_free(index);
+    }
+  g_free(index_filename);
+
+  for (; seq < target_seq && position >= 0; seq++)
+    position = qdisk_read_record(qdisk, position, NULL);
+  return position;
+}
+
+static gpointer
+_export_records(gpointer user_data)
+{
+  DqtoolExportJob *job = (DqtoolExportJob *) user_data;
+  GString *record = g_string_sized_new(1024);
+  GString *formatted = g_string_sized_new(128);
+  gint i;
+
+  for (i = 0; i < job->num_positions; i++)
+    {
+      SerializeArchive *sa;
+      LogMessage *msg;
+
+      if (qdisk_read_record(job->qdisk, job->positions[i], record) < 0)
+        {
+          job->failed = TRUE;
+          break;
+        }
+
+      sa = serialize_string_archive_new(record);
+      msg = log_msg_new_empty();
+      if (!log_msg_deserialize(msg, sa))
+        {
+          fprintf(stderr, "Error deserializing message, record skipped\n");
+        }
+      else if (msg->timestamps[LM_TS_RECVD].tv_sec >= job->since)
+        {
+          log_template_format(job->template, msg, &configuration->template_options, LTZ_LOCAL, 0, NULL, formatted);
+          g_string_append_len(job->output, formatted->str, formatted->len);
+        }
+      serialize_archive_free(sa);
+      log_msg_unref(msg);
+    }
+  g_string_free(formatted, TRUE);
+  g_string_free(record, TRUE);
+  return NULL;
+}
+
+static void
+dqtool_cat_range(LogQueue *lq, const gchar *filename, LogTemplate *template)
+{
+  QDisk *qdisk = ((LogQueueDisk *) lq)->qdisk;
+  gint64 since = since_string ? g_ascii_strtoll(since_string, NULL, 10) : 0;
+  gint64 remaining = MAX(qdisk_get_length(qdisk) - skip_records, 0);
+  gint jobs = CLAMP(export_jobs, 1, 64);
+  DqtoolExportJob job[64];
+  GThread *threads[64];
+  gint64 position;
+  gint i, j;
+
+  if (count_records >= 0)
+    remaining = MIN(remaining, count_records);
+  if (remaining == 0)
+    return;
+
+  position = _seek_to_first_record(qdisk, filename,
+                                   qdisk_get_push_count(qdisk) - qdisk_get_length(qdisk) + skip_records, since);
+
+  for (i = 0; i < jobs; i++)
+    {
+      job[i].qdisk = qdisk;
+      job[i].template = template;
+      job[i].since = since;
+      job[i].positions = g_new(gint64, DQTOOL_EXPORT_RECORDS_PER_JOB);
+      job[i].output = g_string_sized_new(DQTOOL_EXPORT_RECORDS_PER_JOB * 128);
+    }
+
+  /* the main thread only walks the record headers, decoding and
+   * formatting is done by the jobs, output is printed in queue order */
+  while (remaining > 0 && position >= 0)
+    {
+      gint active_jobs = 0;
+
+      for (i = 0; i < jobs && remaining > 0 && position >= 0; i++)
+        {
+          job[i].num_positions = 0;
+          job[i].failed = FALSE;
+          g_string_truncate(job[i].output, 0);
+          for (j = 0; j < DQTOOL_EXPORT_RECORDS_PER_JOB && remaining > 0 && position >= 0; j++, remaining--)
+            {
+              job[i].positions[j] = position;
+              job[i].num_positions++;
+              position = qdisk_read_record(qdisk, position, NULL);
+            }
+          active_jobs++;
+        }
+
+      if (active_jobs == 1)
+        _export_records(&job[0]);
+      else
+        {
+          for (i = 0; i < active_jobs; i++)
+            threads[i] = g_thread_create(_export_records, &job[i], TRUE, NULL);
+          for (i = 0; i < active_jobs; i++)
+            g_thread_join(threads[i]);
+        }
+
+      for (i = 0; i < active_jobs; i++)
+        {
+          fwrite(job[i].output->str, 1, job[i].output->len, stdout);
+          if (job[i].failed)
+            position = -1;
+        }
+    }
+
+  if (position < 0)
+    fprintf(stderr, "Error reading disk queue file, export stopped: %s\n", filename);
+
+  for (i = 0; i < jobs; i++)
+    {
+      g_free(job[i].positions);
+      g_string_free(job[i].output, TRUE);
+    }
+}
+
 static gint
 dqtool_cat(int argc, char *argv[])
 {
@@ -138,6 +350,13 @@ dqtool_cat(int argc, char *argv[])
       if (!open_queue(argv[i], &lq, &options))
         continue;
 
+      if (_is_range_export())
+        {
+          dqtool_cat_range(lq, argv[i], template);
+          log_queue_unref(lq);
+          continue;
+        }
+
       while ((log_msg = log_queue_pop_head(lq, &local_options)) != NULL)
         {
           /* format log */
@@ -286,6 +505,7 @@ main(int argc, char *argv[])
   configuration->template_options.frac_digits = 3;
   configuration->template_options.time_zone_info[LTZ_LOCAL] = time_zone_info_new(NULL);
 
+  g_thread_init(NULL);
   msg_init(TRUE);
   log_template_global_init();
   log_msg_registry_init();
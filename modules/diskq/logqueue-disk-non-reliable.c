@@ -25,9 +25,17 @@
 #include "logpipe.h"
 #include "messages.h"
 #include "syslog-ng.h"
+#include "serialize.h"
 
 #define ITEM_NUMBER_PER_MESSAGE 2
 
+/* maximum number of messages the I/O thread serializes in one go */
+#define ASYNC_IO_BATCH_SIZE 64
+
+/* hybrid(yes): number of messages collected in qoverflow before being
+ * spilled to disk at once */
+#define HYBRID_SPILL_BATCH_SIZE 256
+
 static gboolean
 _start(LogQueueDisk *s, const gchar *filename)
 {
@@ -49,7 +57,37 @@ _get_length (LogQueueDisk *s)
   LogQueueDiskNonReliable *self = (LogQueueDiskNonReliable *) s;
   return _get_message_number_in_queue(self->qout)
          + qdisk_get_length (s->qdisk)
-         + _get_message_number_in_queue(self->qoverflow);
+         + _get_message_number_in_queue(self->qoverflow)
+         + self->io.in_flight;
+}
+
+static gint64
+_get_backlog_length (LogQueueDisk *s)
+{
+  LogQueueDiskNonReliable *self = (LogQueueDiskNonReliable *) s;
+  return _get_message_number_in_queue(self->qbacklog);
+}
+
+static inline gboolean
+_is_async_io_running(LogQueueDiskNonReliable *self)
+{
+  return self->io.thread != NULL;
+}
+
+/* qoverflow is not written to disk as soon as possible, but by the I/O
+ * thread or in batches */
+static inline gboolean
+_is_overflow_deferred(LogQueueDiskNonReliable *self)
+{
+  return _is_async_io_running(self) || self->hybrid;
+}
+
+/* messages being written by the I/O thread are older than anything in
+ * qoverflow, nothing may overtake them on the way to qout */
+static inline gboolean
+_is_disk_empty(LogQueueDiskNonReliable *self)
+{
+  return qdisk_get_length (self->super.qdisk) == 0 && self->io.in_flight == 0;
 }
 
 static LogMessage *
@@ -62,7 +100,7 @@ _get_next_message(LogQueueDiskNonReliable *self, LogPathOptions *path_options)
       result = self->super.read_message(&self->super, path_options);
       path_options->ack_needed = FALSE;
     }
-  else if (self->qoverflow->length > 0)
+  else if (self->qoverflow->length > 0 && self->io.in_flight == 0)
     {
       result = g_queue_pop_head (self->qoverflow);
       POINTER_TO_LOG_PATH_OPTIONS (g_queue_pop_head (self->qoverflow), path_options);
@@ -92,22 +130,25 @@ static inline gboolean
 _has_movable_message(LogQueueDiskNonReliable *self)
 {
   return self->qoverflow->length > 0
-      && ((HAS_SPACE_IN_QUEUE(self->qout) && qdisk_get_length (self->super.qdisk) == 0)
+      && ((HAS_SPACE_IN_QUEUE(self->qout) && _is_disk_empty(self))
           || qdisk_is_space_avail (self->super.qdisk, 4096));
 }
 
 static void
-_move_messages_from_overflow(LogQueueDiskNonReliable *self)
+_move_messages_from_overflow(LogQueueDiskNonReliable *self, gboolean write_to_disk)
 {
   LogMessage *msg;
   LogPathOptions path_options;
   /* move away as much entries from the overflow area as possible */
   while (_has_movable_message(self))
     {
+      if (!write_to_disk && !(_is_disk_empty(self) && HAS_SPACE_IN_QUEUE(self->qout)))
+        break;
+
       msg = g_queue_pop_head (self->qoverflow);
       POINTER_TO_LOG_PATH_OPTIONS (g_queue_pop_head (self->qoverflow), &path_options);
 
-      if (qdisk_get_length (self->super.qdisk) == 0 && HAS_SPACE_IN_QUEUE(self->qout))
+      if (_is_disk_empty(self) && HAS_SPACE_IN_QUEUE(self->qout))
         {
           /* we can skip qdisk, go straight to qout */
           g_queue_push_tail (self->qout, msg);
@@ -133,6 +174,15 @@ _move_messages_from_overflow(LogQueueDiskNonReliable *self)
     }
 }
 
+static inline gboolean
+_should_refill_qout(LogQueueDiskNonReliable *self)
+{
+  /* in hybrid mode qout is topped up once it drains below half */
+  if (self->hybrid)
+    return _could_move_into_qout(self);
+  return self->qout->length == 0;
+}
+
 static void
 _move_disk (LogQueueDiskNonReliable *self)
 {
@@ -144,7 +194,7 @@ _move_disk (LogQueueDiskNonReliable *self)
 
   /* stupid message mover between queues */
 
-  if (self->qout->length == 0 && self->qout_size > 0)
+  if (_should_refill_qout(self) && self->qout_size > 0)
     {
       do
         {
@@ -155,9 +205,169 @@ _move_disk (LogQueueDiskNonReliable *self)
               _add_message_to_qout(self, msg, &path_options);
             }
         }
-      while (msg && _could_move_into_qout(self));
+      while (msg && (self->hybrid ? HAS_SPACE_IN_QUEUE(self->qout) : _could_move_into_qout(self)));
     }
-  _move_messages_from_overflow(self);
+
+  /* with async-io(yes) only the I/O thread writes to the disk */
+  _move_messages_from_overflow(self, !_is_overflow_deferred(self));
+}
+
+static inline gboolean
+_could_prefetch(LogQueueDiskNonReliable *self)
+{
+  return self->qout_size > 0
+         && qdisk_get_length (self->super.qdisk) > 0
+         && _could_move_into_qout(self);
+}
+
+static inline gboolean
+_has_io_work(LogQueueDiskNonReliable *self)
+{
+  if (qdisk_is_read_only (self->super.qdisk))
+    return FALSE;
+  return _could_prefetch(self) || (!self->io.stalled && _has_movable_message(self));
+}
+
+static void
+_wakeup_io_thread(LogQueueDiskNonReliable *self)
+{
+  if (_is_async_io_running(self) && _has_io_work(self))
+    g_cond_signal(self->io.cond);
+}
+
+/* read ahead from the disk, so that the consumer finds its messages in qout */
+static void
+_prefetch_into_qout(LogQueueDiskNonReliable *self)
+{
+  LogMessage *msg;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  while (_could_prefetch(self))
+    {
+      msg = self->super.read_message(&self->super, &path_options);
+      if (!msg)
+        break;
+      path_options.ack_needed = FALSE;
+      _add_message_to_qout(self, msg, &path_options);
+    }
+}
+
+static GString *
+_serialize_message(LogMessage *msg)
+{
+  GString *serialized = g_string_sized_new(64);
+  SerializeArchive *sa = serialize_string_archive_new(serialized);
+
+  log_msg_serialize(msg, sa);
+  serialize_archive_free(sa);
+  return serialized;
+}
+
+/* Takes a batch of messages from qoverflow and writes them to the disk.
+ * Serialization is done without holding the queue lock, the batch is
+ * accounted in io.in_flight meanwhile. Called with the lock held. */
+static void
+_write_overflow_batch(LogQueueDiskNonReliable *self)
+{
+  LogMessage *msgs[ASYNC_IO_BATCH_SIZE];
+  LogPathOptions path_options[ASYNC_IO_BATCH_SIZE];
+  GString *records[ASYNC_IO_BATCH_SIZE];
+  gint num_msgs = 0, num_written = 0, i;
+
+  _move_messages_from_overflow(self, FALSE);
+
+  while (num_msgs < ASYNC_IO_BATCH_SIZE && _has_movable_message(self))
+    {
+      msgs[num_msgs] = g_queue_pop_head (self->qoverflow);
+      POINTER_TO_LOG_PATH_OPTIONS (g_queue_pop_head (self->qoverflow), &path_options[num_msgs]);
+      num_msgs++;
+    }
+  if (num_msgs == 0)
+    return;
+
+  self->io.in_flight = num_msgs;
+  g_static_mutex_unlock(&self->super.super.lock);
+
+  for (i = 0; i < num_msgs; i++)
+    records[i] = _serialize_message(msgs[i]);
+
+  g_static_mutex_lock(&self->super.super.lock);
+
+  while (num_written < num_msgs
+         && qdisk_initialized (self->super.qdisk)
+         && qdisk_push_tail (self->super.qdisk, records[num_written]))
+    num_written++;
+
+  /* no space left after all, put the rest back in order and wait for the
+   * consumer to free up some space */
+  for (i = num_msgs - 1; i >= num_written; i--)
+    {
+      g_queue_push_head (self->qoverflow, LOG_PATH_OPTIONS_TO_POINTER (&path_options[i]));
+      g_queue_push_head (self->qoverflow, msgs[i]);
+    }
+  if (num_written < num_msgs)
+    self->io.stalled = TRUE;
+
+  self->io.in_flight = 0;
+
+  for (i = 0; i < num_written; i++)
+    {
+      log_msg_ack (msgs[i], &path_options[i], AT_PROCESSED);
+      log_msg_unref (msgs[i]);
+    }
+  for (i = 0; i < num_msgs; i++)
+    g_string_free(records[i], TRUE);
+}
+
+static gpointer
+_io_thread(gpointer s)
+{
+  LogQueueDiskNonReliable *self = (LogQueueDiskNonReliable *) s;
+
+  g_static_mutex_lock(&self->super.super.lock);
+  while (!self->io.quit)
+    {
+      if (!_has_io_work(self))
+        {
+          g_cond_wait(self->io.cond, g_static_mutex_get_mutex(&self->super.super.lock));
+          continue;
+        }
+
+      _prefetch_into_qout(self);
+      _write_overflow_batch(self);
+      g_cond_broadcast(self->io.done_cond);
+    }
+  g_static_mutex_unlock(&self->super.super.lock);
+  return NULL;
+}
+
+static void
+_start_io_thread(LogQueueDiskNonReliable *self)
+{
+  if (!self->io.enabled || self->io.thread || !qdisk_initialized (self->super.qdisk)
+      || qdisk_is_read_only (self->super.qdisk))
+    return;
+
+  self->io.quit = FALSE;
+  self->io.stalled = FALSE;
+  self->io.thread = g_thread_create(_io_thread, self, TRUE, NULL);
+}
+
+static void
+_stop_io_thread(LogQueueDiskNonReliable *self)
+{
+  GThread *thread = self->io.thread;
+
+  if (!thread)
+    return;
+
+  g_static_mutex_lock(&self->super.super.lock);
+  self->io.quit = TRUE;
+  g_cond_signal(self->io.cond);
+  g_static_mutex_unlock(&self->super.super.lock);
+
+  g_thread_join(thread);
+  self->io.thread = NULL;
 }
 
 static void
@@ -205,6 +415,11 @@ _pop_head (LogQueueDisk *s, LogPathOptions *path_options)
   LogQueueDiskNonReliable *self = (LogQueueDiskNonReliable *) s;
   LogMessage *msg = NULL;
 
+  /* everything older than qoverflow is being written by the I/O thread,
+   * wait for it instead of returning NULL for a non-empty queue */
+  while (self->qout->length == 0 && qdisk_get_length (self->super.qdisk) == 0 && self->io.in_flight > 0)
+    g_cond_wait(self->io.done_cond, g_static_mutex_get_mutex(&self->super.super.lock));
+
   if (self->qout->length > 0)
     {
       msg = g_queue_pop_head (self->qout);
@@ -220,7 +435,8 @@ _pop_head (LogQueueDisk *s, LogPathOptions *path_options)
     }
   if (msg == NULL)
     {
-      if (self->qoverflow->length > 0 && qdisk_is_read_only (self->super.qdisk))
+      if (self->qoverflow->length > 0
+          && (qdisk_is_read_only (self->super.qdisk) || (_is_overflow_deferred(self) && self->io.in_flight == 0)))
         {
           msg = g_queue_pop_head (self->qoverflow);
           POINTER_TO_LOG_PATH_OPTIONS (g_queue_pop_head (self->qoverflow), path_options);
@@ -235,7 +451,9 @@ _pop_head (LogQueueDisk *s, LogPathOptions *path_options)
           g_queue_push_tail (self->qbacklog, msg);
           g_queue_push_tail (self->qbacklog, LOG_PATH_OPTIONS_TO_POINTER (path_options));
         }
+      self->io.stalled = FALSE;
       _move_disk (self);
+      _wakeup_io_thread (self);
     }
   return msg;
 }
@@ -257,7 +475,8 @@ _push_tail (LogQueueDisk *s, LogMessage *msg, LogPathOptions *local_options, con
 {
   LogQueueDiskNonReliable *self = (LogQueueDiskNonReliable *) s;
 
-  if (HAS_SPACE_IN_QUEUE(self->qout) && qdisk_get_length (self->super.qdisk) == 0)
+  if (HAS_SPACE_IN_QUEUE(self->qout) && _is_disk_empty(self)
+      && (!_is_overflow_deferred(self) || self->qoverflow->length == 0))
     {
       /* simple push never generates flow-control enabled entries to qout, they only get there
        * when rewinding the backlog */
@@ -266,6 +485,25 @@ _push_tail (LogQueueDisk *s, LogMessage *msg, LogPathOptions *local_options, con
       g_queue_push_tail (self->qout, LOG_PATH_OPTIONS_FOR_BACKLOG);
       log_msg_ref (msg);
     }
+  else if (_is_async_io_running(self) && HAS_SPACE_IN_QUEUE(self->qoverflow))
+    {
+      /* acked once the I/O thread has written it to disk */
+      g_queue_push_tail (self->qoverflow, msg);
+      g_queue_push_tail (self->qoverflow, LOG_PATH_OPTIONS_TO_POINTER (path_options));
+      log_msg_ref (msg);
+      local_options->ack_needed = FALSE;
+      _wakeup_io_thread (self);
+    }
+  else if (self->hybrid && HAS_SPACE_IN_QUEUE(self->qoverflow))
+    {
+      /* acked once spilled to disk or moved to qout */
+      g_queue_push_tail (self->qoverflow, msg);
+      g_queue_push_tail (self->qoverflow, LOG_PATH_OPTIONS_TO_POINTER (path_options));
+      log_msg_ref (msg);
+      local_options->ack_needed = FALSE;
+      if (!HAS_SPACE_IN_QUEUE(self->qoverflow))
+        _move_messages_from_overflow(self, TRUE);
+    }
   else
     {
       if (self->qoverflow->length != 0 || !s->write_message(s, msg))
@@ -313,6 +551,10 @@ static void
 _freefn (LogQueueDisk *s)
 {
   LogQueueDiskNonReliable *self = (LogQueueDiskNonReliable *) s;
+
+  _stop_io_thread (self);
+  g_cond_free (self->io.cond);
+  g_cond_free (self->io.done_cond);
   _free_queue (self->qoverflow);
   self->qoverflow = NULL;
   _free_queue (self->qout);
@@ -327,13 +569,20 @@ _load_queue (LogQueueDisk *s, const gchar *filename)
   /* qdisk portion is not yet started when this happens */
   g_assert(!qdisk_initialized (s->qdisk));
 
-  return _start(s, filename);
+  if (!_start(s, filename))
+    return FALSE;
+
+  _start_io_thread ((LogQueueDiskNonReliable *) s);
+  return TRUE;
 }
 
 static gboolean
 _save_queue (LogQueueDisk *s, gboolean *persistent)
 {
   LogQueueDiskNonReliable *self = (LogQueueDiskNonReliable *) s;
+
+  /* whatever the I/O thread did not write yet is saved along with qoverflow */
+  _stop_io_thread (self);
   if (qdisk_save_state (s->qdisk, self->qout, self->qbacklog, self->qoverflow))
     {
       *persistent = TRUE;
@@ -347,6 +596,7 @@ static void
 _set_virtual_functions (LogQueueDisk *self)
 {
   self->get_length = _get_length;
+  self->get_backlog_length = _get_backlog_length;
   self->ack_backlog = _ack_backlog;
   self->rewind_backlog = _rewind_backlog;
   self->pop_head = _pop_head;
@@ -368,8 +618,20 @@ log_queue_disk_non_reliable_new(DiskQueueOptions *options)
   self->qbacklog = g_queue_new ();
   self->qout = g_queue_new ();
   self->qoverflow = g_queue_new ();
-  self->qout_size = options->qout_size;
-  self->qoverflow_size = options->mem_buf_size;
+  self->hybrid = options->hybrid;
+  if (self->hybrid)
+    {
+      self->qout_size = options->mem_buf_length;
+      self->qoverflow_size = HYBRID_SPILL_BATCH_SIZE;
+    }
+  else
+    {
+      self->qout_size = options->qout_size;
+      self->qoverflow_size = options->mem_buf_length;
+    }
+  self->io.enabled = options->async_io;
+  self->io.cond = g_cond_new ();
+  self->io.done_cond = g_cond_new ();
   _set_virtual_functions (&self->super);
   return &self->super.super;
 }
@@ -34,6 +34,21 @@ typedef struct _LogQueueDiskNonReliable
   GQueue *qbacklog;
   gint qoverflow_size;
   gint qout_size;
+  /* hybrid(yes): qout is the in-memory queue, spilled to disk in batches */
+  gboolean hybrid;
+
+  /* async-io(yes): disk writes and read-ahead are done by a dedicated thread */
+  struct
+  {
+    gboolean enabled;
+    GThread *thread;
+    GCond *cond;
+    GCond *done_cond;
+    gboolean quit;
+    gboolean stalled;
+    /* messages taken from qoverflow that are being written to disk */
+    gint in_flight;
+  } io;
 } LogQueueDiskNonReliable;
 
 LogQueue *log_queue_disk_non_reliable_new(DiskQueueOptions *options);
@@ -26,11 +26,162 @@
 #include "logpipe.h"
 #include "logqueue-disk-reliable.h"
 #include "messages.h"
+#include "timeutils.h"
+
+#include <unistd.h>
+
+/*
+ * Group commit
+ *
+ * Without sync-max-latency() records only reach the page cache and the
+ * message is acked as soon as it is written.  With group commit enabled,
+ * the ack of the written messages is held back, and a per-queue sync
+ * thread flushes the file to stable storage once the oldest pending
+ * message is sync-max-latency() milliseconds old, or sync-max-bytes()
+ * were written, whichever comes first.  All messages written in that
+ * window are acked after that single sync, so flow-controlled sources
+ * are only resumed once their messages are durable.
+ */
+
+static gboolean
+_is_group_commit_enabled(LogQueueDiskReliable *self)
+{
+  return self->sync.max_latency > 0;
+}
+
+static void
+_sync_and_ack_pending(LogQueueDiskReliable *self, GQueue *pending)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *msg;
+  gint fd;
+
+  g_static_mutex_lock(&self->super.super.lock);
+  fd = qdisk_dup_fd(self->super.qdisk);
+  g_static_mutex_unlock(&self->super.super.lock);
+
+  /* the messages are acked even if the sync fails, the data is written to
+   * the file already, we just don't know whether it is durable */
+  if (fd >= 0)
+    {
+      GTimeVal start, end;
+
+      g_get_current_time(&start);
+      qdisk_sync_fd(fd);
+      g_get_current_time(&end);
+      close(fd);
+      log_queue_disk_record_sync_latency(&self->super, g_time_val_diff(&end, &start));
+    }
+  while ((msg = g_queue_pop_head(pending)))
+    {
+      POINTER_TO_LOG_PATH_OPTIONS(g_queue_pop_head(pending), &path_options);
+      log_msg_drop(msg, &path_options, AT_PROCESSED);
+    }
+}
+
+static gboolean
+_is_sync_due(LogQueueDiskReliable *self, GTimeVal *deadline)
+{
+  GTimeVal now;
+
+  if (self->sync.quit)
+    return TRUE;
+  if (self->sync.max_bytes > 0 && self->sync.pending_bytes >= self->sync.max_bytes)
+    return TRUE;
+
+  g_get_current_time(&now);
+  return now.tv_sec > deadline->tv_sec || (now.tv_sec == deadline->tv_sec && now.tv_usec >= deadline->tv_usec);
+}
+
+static gpointer
+_sync_thread(gpointer s)
+{
+  LogQueueDiskReliable *self = (LogQueueDiskReliable *) s;
+  GQueue *batch = g_queue_new();
+  GTimeVal deadline;
+
+  g_mutex_lock(self->sync.lock);
+  while (!self->sync.quit || self->sync.pending->length > 0)
+    {
+      if (self->sync.pending->length == 0)
+        {
+          g_cond_wait(self->sync.cond, self->sync.lock);
+          continue;
+        }
+
+      deadline = self->sync.first_pending_time;
+      g_time_val_add(&deadline, self->sync.max_latency * 1000);
+      while (!_is_sync_due(self, &deadline))
+        g_cond_timed_wait(self->sync.cond, self->sync.lock, &deadline);
+
+      /* swap the queues, producers go on filling the next batch while we sync */
+      g_queue_free(batch);
+      batch = self->sync.pending;
+      self->sync.pending = g_queue_new();
+      self->sync.pending_bytes = 0;
+      g_mutex_unlock(self->sync.lock);
+
+      _sync_and_ack_pending(self, batch);
+
+      g_mutex_lock(self->sync.lock);
+    }
+  g_mutex_unlock(self->sync.lock);
+  g_queue_free(batch);
+  return NULL;
+}
+
+/* NOTE: called with the queue lock held */
+static void
+_add_pending_sync(LogQueueDiskReliable *self, LogMessage *msg, const LogPathOptions *path_options, gint64 written_bytes)
+{
+  g_mutex_lock(self->sync.lock);
+  if (self->sync.pending->length == 0)
+    g_get_current_time(&self->sync.first_pending_time);
+  g_queue_push_tail(self->sync.pending, log_msg_ref(msg));
+  g_queue_push_tail(self->sync.pending, LOG_PATH_OPTIONS_TO_POINTER(path_options));
+  self->sync.pending_bytes += written_bytes;
+
+  if (self->sync.pending->length == 2 ||
+      (self->sync.max_bytes > 0 && self->sync.pending_bytes >= self->sync.max_bytes))
+    g_cond_signal(self->sync.cond);
+  g_mutex_unlock(self->sync.lock);
+}
+
+static void
+_start_sync_thread(LogQueueDiskReliable *self)
+{
+  if (!_is_group_commit_enabled(self) || self->sync.thread || !qdisk_initialized(self->super.qdisk))
+    return;
+
+  self->sync.quit = FALSE;
+  self->sync.thread = g_thread_create(_sync_thread, self, TRUE, NULL);
+}
+
+/* syncs and acks everything still pending */
+static void
+_stop_sync_thread(LogQueueDiskReliable *self)
+{
+  if (!self->sync.thread)
+    return;
+
+  g_mutex_lock(self->sync.lock);
+  self->sync.quit = TRUE;
+  g_cond_signal(self->sync.cond);
+  g_mutex_unlock(self->sync.lock);
+
+  g_thread_join(self->sync.thread);
+  self->sync.thread = NULL;
+}
 
 static gboolean
 _start(LogQueueDisk *s, const gchar *filename)
 {
-  return qdisk_start(s->qdisk, filename, NULL, NULL, NULL);
+  LogQueueDiskReliable *self = (LogQueueDiskReliable *) s;
+
+  if (!qdisk_start(s->qdisk, filename, NULL, NULL, NULL))
+    return FALSE;
+  _start_sync_thread(self);
+  return TRUE;
 }
 
 static gboolean
@@ -78,6 +229,12 @@ _get_length(LogQueueDisk *self)
   return qdisk_get_length(self->qdisk);
 }
 
+static gint64
+_get_backlog_length(LogQueueDisk *self)
+{
+  return qdisk_get_backlog_count(self->qdisk);
+}
+
 static void
 _ack_backlog(LogQueueDisk *s, guint num_msg_to_ack)
 {
@@ -291,6 +448,12 @@ _push_tail(LogQueueDisk *s, LogMessage *msg, LogPathOptions *local_options, cons
 
       local_options->ack_needed = FALSE;
     }
+  else if (_is_group_commit_enabled(self) && local_options->ack_needed)
+    {
+      /* the message is acked by the sync thread once it is durable */
+      _add_pending_sync(self, msg, path_options, wpos > last_wpos ? wpos - last_wpos : wpos - QDISK_RESERVED_SPACE);
+      local_options->ack_needed = FALSE;
+    }
 
   return TRUE;
 }
@@ -299,6 +462,12 @@ static void
 _free_queue(LogQueueDisk *s)
 {
   LogQueueDiskReliable *self = (LogQueueDiskReliable *) s;
+
+  _stop_sync_thread(self);
+  g_queue_free(self->sync.pending);
+  g_cond_free(self->sync.cond);
+  g_mutex_free(self->sync.lock);
+
   _empty_queue(self->qreliable);
   _empty_queue(self->qbacklog);
   g_queue_free(self->qreliable);
@@ -312,12 +481,18 @@ _load_queue(LogQueueDisk *s, const gchar *filename)
 {
   LogQueueDiskReliable *self = (LogQueueDiskReliable *) s;
   _empty_queue(self->qreliable);
-  return qdisk_start(s->qdisk, filename, NULL, NULL, NULL);
+  if (!qdisk_start(s->qdisk, filename, NULL, NULL, NULL))
+    return FALSE;
+  _start_sync_thread(self);
+  return TRUE;
 }
 
 static gboolean
 _save_queue (LogQueueDisk *s, gboolean *persistent)
 {
+  LogQueueDiskReliable *self = (LogQueueDiskReliable *) s;
+
+  _stop_sync_thread(self);
   *persistent = TRUE;
   qdisk_deinit (s->qdisk);
   return TRUE;
@@ -328,6 +503,7 @@ static void
 _set_virtual_functions(LogQueueDisk *self)
 {
   self->get_length = _get_length;
+  self->get_backlog_length = _get_backlog_length;
   self->ack_backlog = _ack_backlog;
   self->rewind_backlog = _rewind_backlog;
   self->pop_head = _pop_head;
@@ -347,6 +523,11 @@ log_queue_disk_reliable_new(DiskQueueOptions *options)
   qdisk_init(self->super.qdisk, options);
   self->qreliable = g_queue_new();
   self->qbacklog = g_queue_new();
+  self->sync.max_latency = options->sync_max_latency;
+  self->sync.max_bytes = options->sync_max_bytes;
+  self->sync.lock = g_mutex_new();
+  self->sync.cond = g_cond_new();
+  self->sync.pending = g_queue_new();
   _set_virtual_functions(&self->super);
   return &self->super.super;
 }
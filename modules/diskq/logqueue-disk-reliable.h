@@ -31,6 +31,21 @@ typedef struct _LogQueueDiskReliable
   LogQueueDisk super;
   GQueue *qreliable;
   GQueue *qbacklog;
+
+  /* group commit, enabled by sync-max-latency() */
+  struct
+  {
+    gint max_latency;
+    gint64 max_bytes;
+    GThread *thread;
+    GMutex *lock;
+    GCond *cond;
+    /* messages waiting for the sync, with their path options */
+    GQueue *pending;
+    gint64 pending_bytes;
+    GTimeVal first_pending_time;
+    gboolean quit;
+  } sync;
 } LogQueueDiskReliable;
 
 LogQueue *log_queue_disk_reliable_new(DiskQueueOptions *options);
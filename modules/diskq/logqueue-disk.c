@@ -42,26 +42,69 @@
 
 const QueueType log_queue_disk_type = "DISK";
 
+/*
+ * Asynchronous recovery
+ *
+ * Loading a large queue file (deserializing the saved in-memory queues)
+ * can take a long time. log_queue_disk_load_queue_async() performs it on
+ * a shared thread pool, so that the queues of different destinations are
+ * recovered in parallel and initialization can go on in the meanwhile.
+ *
+ * While the load is pending, the queue reports itself as empty and any
+ * other operation waits for it to finish. Once loaded, the consumer is
+ * woken up the same way as if a message was pushed.
+ */
+
+static GStaticMutex recovery_pool_lock = G_STATIC_MUTEX_INIT;
+static GThreadPool *recovery_pool;
+
+static inline void
+_wait_for_recovery(LogQueueDisk *self)
+{
+  while (self->recovery.pending)
+    g_cond_wait(self->recovery.cond, g_static_mutex_get_mutex(&self->super.lock));
+}
+
+static inline gboolean
+_is_usable(LogQueueDisk *self)
+{
+  _wait_for_recovery(self);
+  return !self->recovery.failed;
+}
+
 static gint64
 _get_length(LogQueue *s)
 {
   LogQueueDisk *self = (LogQueueDisk *) s;
   gint64 qdisk_length = 0;
 
-  if (qdisk_initialized(self->qdisk) && self->get_length)
+  if (!g_atomic_int_get(&self->recovery.pending) && qdisk_initialized(self->qdisk) && self->get_length)
     {
       qdisk_length = self->get_length(self);
     }
   return qdisk_length;
 }
 
+static gint64
+_get_backlog_length(LogQueue *s)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+  gint64 backlog_length = 0;
+
+  g_static_mutex_lock(&self->super.lock);
+  if (!self->recovery.pending && qdisk_initialized(self->qdisk) && self->get_backlog_length)
+    backlog_length = self->get_backlog_length(self);
+  g_static_mutex_unlock(&self->super.lock);
+  return backlog_length;
+}
+
 static void
 _push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
 {
   LogQueueDisk *self = (LogQueueDisk *) s;
   LogPathOptions local_options = *path_options;
   g_static_mutex_lock(&self->super.lock);
-  if (self->push_tail)
+  if (self->push_tail && _is_usable(self))
     {
       if (self->push_tail(self, msg, &local_options, path_options))
         {
@@ -89,7 +132,7 @@ _push_head(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
   LogQueueDisk *self = (LogQueueDisk *) s;
 
   g_static_mutex_lock(&self->super.lock);
-  if (self->push_head)
+  if (self->push_head && _is_usable(self))
     {
       self->push_head(self, msg, path_options);
     }
@@ -104,7 +147,7 @@ _pop_head(LogQueue *s, LogPathOptions *path_options)
 
   msg = NULL;
   g_static_mutex_lock(&self->super.lock);
-  if (self->pop_head)
+  if (self->pop_head && _is_usable(self))
     {
       msg = self->pop_head(self, path_options);
     }
@@ -116,6 +159,27 @@ _pop_head(LogQueue *s, LogPathOptions *path_options)
   return msg;
 }
 
+static gint
+_pop_head_batch(LogQueue *s, gint max_msgs, LogMessage **msgs, LogPathOptions *path_options)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+  gint num_msgs = 0;
+
+  g_static_mutex_lock(&self->super.lock);
+  if (self->pop_head && _is_usable(self))
+    {
+      while (num_msgs < max_msgs &&
+             (msgs[num_msgs] = self->pop_head(self, &path_options[num_msgs])) != NULL)
+        num_msgs++;
+    }
+  if (num_msgs > 0)
+    {
+      stats_counter_add(self->super.stored_messages, -num_msgs);
+    }
+  g_static_mutex_unlock(&self->super.lock);
+  return num_msgs;
+}
+
 static void
 _ack_backlog(LogQueue *s, gint num_msg_to_ack)
 {
@@ -123,7 +187,7 @@ _ack_backlog(LogQueue *s, gint num_msg_to_ack)
 
   g_static_mutex_lock(&self->super.lock);
 
-  if (self->ack_backlog)
+  if (self->ack_backlog && _is_usable(self))
     {
       self->ack_backlog(self, num_msg_to_ack);
     }
@@ -138,7 +202,7 @@ _rewind_backlog(LogQueue *s, guint rewind_count)
 
   g_static_mutex_lock(&self->super.lock);
 
-  if (self->rewind_backlog)
+  if (self->rewind_backlog && _is_usable(self))
     {
       self->rewind_backlog (self, rewind_count);
     }
@@ -153,7 +217,7 @@ _backlog_all(LogQueue *s)
 
   g_static_mutex_lock(&self->super.lock);
 
-  if (self->rewind_backlog)
+  if (self->rewind_backlog && _is_usable(self))
     {
       self->rewind_backlog(self, -1);
     }
@@ -166,6 +230,10 @@ log_queue_disk_save_queue(LogQueue *s, gboolean *persistent)
 {
   LogQueueDisk *self = (LogQueueDisk *) s;
 
+  g_static_mutex_lock(&self->super.lock);
+  _wait_for_recovery(self);
+  g_static_mutex_unlock(&self->super.lock);
+
   if (!qdisk_initialized(self->qdisk))
     {
       *persistent = FALSE;
@@ -190,6 +258,72 @@ log_queue_disk_load_queue(LogQueue *s, const gchar *filename)
   return FALSE;
 }
 
+static void
+_recover_queue(gpointer data, gpointer user_data)
+{
+  LogQueueDisk *self = (LogQueueDisk *) data;
+  gboolean failed = FALSE;
+
+  if (!log_queue_disk_load_queue(&self->super, self->recovery.filename))
+    {
+      if (log_queue_disk_load_queue(&self->super, NULL))
+        {
+          msg_error("Error opening disk-queue file, a new one started",
+                    evt_tag_str("old_filename", self->recovery.filename),
+                    evt_tag_str("new_filename", log_queue_disk_get_filename(&self->super)),
+                    NULL);
+        }
+      else
+        {
+          msg_error("Error initializing log queue, dropping messages",
+                    evt_tag_str("filename", self->recovery.filename),
+                    evt_tag_str("persist_name", self->super.persist_name),
+                    NULL);
+          failed = TRUE;
+        }
+    }
+
+  g_static_mutex_lock(&self->super.lock);
+  g_free(self->recovery.filename);
+  self->recovery.filename = NULL;
+  self->recovery.failed = failed;
+  g_atomic_int_set(&self->recovery.pending, FALSE);
+  g_cond_broadcast(self->recovery.cond);
+  if (!failed)
+    log_queue_push_notify(&self->super);
+  g_static_mutex_unlock(&self->super.lock);
+}
+
+static GThreadPool *
+_get_recovery_pool(void)
+{
+  g_static_mutex_lock(&recovery_pool_lock);
+  if (!recovery_pool)
+    {
+      glong num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+      recovery_pool = g_thread_pool_new(_recover_queue, NULL, MAX(num_cpus, 1), FALSE, NULL);
+    }
+  g_static_mutex_unlock(&recovery_pool_lock);
+  return recovery_pool;
+}
+
+/* Loads an existing queue file in the background, see the comment at the
+ * top of this file. If the file cannot be loaded, a new one is started,
+ * the same as log_queue_disk_load_queue() callers do. */
+void
+log_queue_disk_load_queue_async(LogQueue *s, const gchar *filename)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+
+  g_assert(!qdisk_initialized(self->qdisk) && !self->recovery.pending);
+
+  self->recovery.filename = g_strdup(filename);
+  self->recovery.failed = FALSE;
+  g_atomic_int_set(&self->recovery.pending, TRUE);
+  g_thread_pool_push(_get_recovery_pool(), self, NULL);
+}
+
 gboolean
 log_queue_disk_is_reliable(LogQueue *s)
 {
@@ -203,14 +337,87 @@ const gchar *
 log_queue_disk_get_filename(LogQueue *s)
 {
   LogQueueDisk *self = (LogQueueDisk *) s;
+
+  g_static_mutex_lock(&self->super.lock);
+  _wait_for_recovery(self);
+  g_static_mutex_unlock(&self->super.lock);
   return qdisk_get_filename(self->qdisk);
 }
 
+/* may be called from any thread, the gauge reports the maximum since the last update */
+void
+log_queue_disk_record_sync_latency(LogQueueDisk *self, gint64 latency_usec)
+{
+  gint latency = (gint) MIN(latency_usec, G_MAXINT);
+  gint current;
+
+  do
+    {
+      current = g_atomic_int_get(&self->disk_stats.max_sync_latency);
+      if (latency <= current)
+        return;
+    }
+  while (!g_atomic_int_compare_and_exchange(&self->disk_stats.max_sync_latency, current, latency));
+}
+
+static void
+_register_stats_counters(LogQueue *s, gint stats_level, gint component, const gchar *id, const gchar *instance)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+
+  stats_register_counter(stats_level, component, id, instance, SC_TYPE_DISK_SIZE, &self->disk_stats.disk_size);
+  stats_register_counter(stats_level, component, id, instance, SC_TYPE_DISK_WRITER_HEAD, &self->disk_stats.writer_head);
+  stats_register_counter(stats_level, component, id, instance, SC_TYPE_DISK_READER_HEAD, &self->disk_stats.reader_head);
+  stats_register_counter(stats_level, component, id, instance, SC_TYPE_DISK_BACKLOG_HEAD, &self->disk_stats.backlog_head);
+  /* stays zero unless the queue syncs explicitly, see sync-max-latency() */
+  stats_register_counter(stats_level, component, id, instance, SC_TYPE_SYNC_LATENCY, &self->disk_stats.sync_latency);
+}
+
+static void
+_unregister_stats_counters(LogQueue *s, gint component, const gchar *id, const gchar *instance)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+
+  stats_unregister_counter(component, id, instance, SC_TYPE_DISK_SIZE, &self->disk_stats.disk_size);
+  stats_unregister_counter(component, id, instance, SC_TYPE_DISK_WRITER_HEAD, &self->disk_stats.writer_head);
+  stats_unregister_counter(component, id, instance, SC_TYPE_DISK_READER_HEAD, &self->disk_stats.reader_head);
+  stats_unregister_counter(component, id, instance, SC_TYPE_DISK_BACKLOG_HEAD, &self->disk_stats.backlog_head);
+  stats_unregister_counter(component, id, instance, SC_TYPE_SYNC_LATENCY, &self->disk_stats.sync_latency);
+}
+
+static void
+_update_stats_counters(LogQueue *s)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+  gint max_sync_latency;
+
+  g_static_mutex_lock(&self->super.lock);
+  if (!self->recovery.pending && qdisk_initialized(self->qdisk))
+    {
+      stats_counter_set(self->disk_stats.disk_size, qdisk_get_file_size(self->qdisk));
+      stats_counter_set(self->disk_stats.writer_head, qdisk_get_writer_head(self->qdisk));
+      stats_counter_set(self->disk_stats.reader_head, qdisk_get_reader_head(self->qdisk));
+      stats_counter_set(self->disk_stats.backlog_head, qdisk_get_backlog_head(self->qdisk));
+    }
+  g_static_mutex_unlock(&self->super.lock);
+
+  do
+    max_sync_latency = g_atomic_int_get(&self->disk_stats.max_sync_latency);
+  while (!g_atomic_int_compare_and_exchange(&self->disk_stats.max_sync_latency, max_sync_latency, 0));
+  stats_counter_set(self->disk_stats.sync_latency, max_sync_latency);
+}
+
 static void
 _free(LogQueue *s)
 {
   LogQueueDisk *self = (LogQueueDisk *) s;
 
+  g_static_mutex_lock(&self->super.lock);
+  _wait_for_recovery(self);
+  g_static_mutex_unlock(&self->super.lock);
+  g_cond_free(self->recovery.cond);
+  g_free(self->recovery.filename);
+
   if (self->free_fn)
     self->free_fn(self);
 
@@ -336,14 +543,20 @@ log_queue_disk_init_instance(LogQueueDisk *self)
 {
   log_queue_init_instance(&self->super,NULL);
   self->qdisk = qdisk_new();
+  self->recovery.cond = g_cond_new();
 
   self->super.get_length = _get_length;
   self->super.push_tail = _push_tail;
   self->super.push_head = _push_head;
   self->super.pop_head = _pop_head;
+  self->super.pop_head_batch = _pop_head_batch;
   self->super.ack_backlog = _ack_backlog;
   self->super.rewind_backlog = _rewind_backlog;
   self->super.rewind_backlog_all = _backlog_all;
+  self->super.get_backlog_length = _get_backlog_length;
+  self->super.register_stats_counters = _register_stats_counters;
+  self->super.unregister_stats_counters = _unregister_stats_counters;
+  self->super.update_stats_counters = _update_stats_counters;
   self->super.free_fn = _free;
 
   self->read_message = _read_message;
@@ -38,6 +38,7 @@ struct _LogQueueDisk
   LogQueue super;
   QDisk *qdisk;         /* disk based queue */
   gint64 (*get_length)(LogQueueDisk *s);
+  gint64 (*get_backlog_length)(LogQueueDisk *s);
   gboolean (*push_tail)(LogQueueDisk *s, LogMessage *msg, LogPathOptions *local_options, const LogPathOptions *path_options);
   void (*push_head)(LogQueueDisk *s, LogMessage *msg, const LogPathOptions *path_options);
   LogMessage *(*pop_head)(LogQueueDisk *s, LogPathOptions *path_options);
@@ -52,6 +53,27 @@ struct _LogQueueDisk
   gboolean (*write_message)(LogQueueDisk *self, LogMessage *msg);
   void (*restart)(LogQueueDisk *self);
   void (*restart_corrupted)(LogQueueDisk *self);
+
+  /* see log_queue_disk_load_queue_async() */
+  struct
+  {
+    GCond *cond;
+    gboolean pending;
+    gboolean failed;
+    gchar *filename;
+  } recovery;
+
+  /* disk-buffer gauges, see log_queue_register_stats_counters() */
+  struct
+  {
+    StatsCounterItem *disk_size;
+    StatsCounterItem *writer_head;
+    StatsCounterItem *reader_head;
+    StatsCounterItem *backlog_head;
+    StatsCounterItem *sync_latency;
+    /* the slowest sync since the last update, in microseconds */
+    gint max_sync_latency;
+  } disk_stats;
 };
 
 extern const QueueType log_queue_disk_type;
@@ -60,6 +82,8 @@ gboolean log_queue_disk_is_reliable(LogQueue *s);
 const gchar *log_queue_disk_get_filename(LogQueue *self);
 gboolean log_queue_disk_save_queue(LogQueue *self, gboolean *persistent);
 gboolean log_queue_disk_load_queue(LogQueue *self, const gchar *filename);
+void log_queue_disk_load_queue_async(LogQueue *self, const gchar *filename);
+void log_queue_disk_record_sync_latency(LogQueueDisk *self, gint64 latency_usec);
 void log_queue_disk_init_instance(LogQueueDisk *self);
 
 #endif
@@ -36,6 +36,11 @@
 #include <errno.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <string.h>
+#include <time.h>
+#if SYSLOG_NG_HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 /* MADV_RANDOM not defined on legacy Linux systems. Could be removed in the
  * future, when support for Glibc 2.1.X drops.*/
@@ -48,6 +53,23 @@
 
 #define PATH_QDISK              PATH_LOCALSTATEDIR
 
+/* records longer than this are considered to be corrupt */
+#define QDISK_MAX_RECORD_SIZE   (10 * 1024 * 1024)
+
+/* the most significant bit of the record length marks compressed records,
+ * their payload is the uncompressed length followed by zlib data */
+#define QDISK_RECORD_COMPRESSED 0x80000000U
+#define QDISK_RECORD_LEN_MASK   (~QDISK_RECORD_COMPRESSED)
+
+/* records shorter than this are not worth compressing */
+#define QDISK_COMPRESS_MIN_SIZE 128
+
+/* QDiskFileHeader flags */
+#define QDISK_HDR_FLAG_COMPRESSED 0x01
+
+/* the file is extended in steps of this size in mmap mode */
+#define QDISK_MMAP_GROW_STEP    (1024 * 1024)
+
 typedef union _QDiskFileHeader
 {
   struct
@@ -55,7 +77,8 @@ typedef union _QDiskFileHeader
     gchar magic[4];
     guint8 version;
     guint8 big_endian;
-    guint8 _pad1;
+    /* QDISK_HDR_FLAG_*, zero in files written by earlier versions */
+    guint8 flags;
 
     gint64 read_head;
     gint64 write_head;
@@ -72,6 +95,8 @@ typedef union _QDiskFileHeader
     gint32 qoverflow_count;
     gint64 backlog_head;
     gint64 backlog_len;
+    /* number of records ever written into this file, see QDiskIndexEntry */
+    gint64 push_count;
   };
   gchar _pad2[QDISK_RESERVED_SPACE];
 } QDiskFileHeader;
@@ -87,6 +112,17 @@ struct _QDisk
   gint64 file_size;
   QDiskFileHeader *hdr;
   DiskQueueOptions *options;
+
+  /* mmap mode, see the comment above _mmap_start() */
+  gchar *map;
+  gint64 map_size;
+  /* the size of the file on disk, which can be larger than data_end */
+  gint64 map_file_length;
+  /* the logical end of the file, reads past it return EOF */
+  gint64 data_end;
+
+  /* index(yes), see _index_append() */
+  gint index_fd;
 };
 
 static gboolean
@@ -109,6 +145,71 @@ pwrite_strict(gint fd, const void *buf, size_t count, off_t offset)
   return result;
 }
 
+/* extend the file in mmap mode, so that the range up to @end is backed by the file */
+static gboolean
+_mmap_ensure_file_length(QDisk *self, gint64 end)
+{
+  gint64 new_length;
+
+  if (end <= self->map_file_length)
+    return TRUE;
+
+  new_length = MIN(((end + QDISK_MMAP_GROW_STEP - 1) / QDISK_MMAP_GROW_STEP) * QDISK_MMAP_GROW_STEP, self->map_size);
+  if (ftruncate(self->fd, (glong) new_length) < 0)
+    {
+      msg_error("Error extending disk-queue file",
+                evt_tag_errno("error", errno),
+                evt_tag_str("filename", self->filename),
+                evt_tag_int("newsize", new_length),
+                NULL);
+      return FALSE;
+    }
+  self->map_file_length = new_length;
+  return TRUE;
+}
+
+/*
+ * pwrite() equivalent that writes through the mapping in mmap mode,
+ * ranges not covered by the mapping fall back to pwrite().
+ */
+static gboolean
+_write_at(QDisk *self, const void *buf, size_t count, gint64 offset)
+{
+  if (!self->map || offset + count > self->map_size)
+    {
+      if (!pwrite_strict(self->fd, buf, count, offset))
+        return FALSE;
+    }
+  else
+    {
+      if (!_mmap_ensure_file_length(self, offset + count))
+        return FALSE;
+      memcpy(self->map + offset, buf, count);
+    }
+  if (self->map)
+    {
+      self->data_end = MAX(self->data_end, offset + count);
+      self->map_file_length = MAX(self->map_file_length, offset + count);
+    }
+  return TRUE;
+}
+
+/* pread() equivalent, in mmap mode data_end is the end of file */
+static gssize
+_read_at(QDisk *self, gpointer buf, gsize count, gint64 offset)
+{
+  if (!self->map)
+    return pread(self->fd, buf, count, offset);
+
+  if (offset >= self->data_end)
+    return 0;
+  count = MIN(count, self->data_end - offset);
+  if (offset + count > self->map_size)
+    return pread(self->fd, buf, count, offset);
+
+  memcpy(buf, self->map + offset, count);
+  return count;
+}
 
 static gboolean
 _is_position_eof(QDisk *self, gint64 position)
@@ -204,6 +305,17 @@ _truncate_file(QDisk *self, gint64 new_size)
 {
   gboolean success = TRUE;
 
+  if (self->map)
+    {
+      /* only a logical truncation, the file is not shrunk in mmap mode.  A
+       * zero record length is put at the new end of file, in case the
+       * file is reopened after a crash, with the stale data still there. */
+      self->data_end = new_size;
+      if (new_size + sizeof(guint32) <= MIN(self->map_file_length, self->map_size))
+        memset(self->map + new_size, 0, sizeof(guint32));
+      return TRUE;
+    }
+
   if (ftruncate(self->fd, (glong)new_size) < 0)
     {
       success = FALSE;
@@ -218,10 +330,151 @@ _truncate_file(QDisk *self, gint64 new_size)
   return success;
 }
 
-gboolean
-qdisk_push_tail(QDisk *self, GString *record)
+#if SYSLOG_NG_HAVE_ZLIB
+
+/* returns the compressed form of record or NULL if it is not worth it */
+static GString *
+_compress_record(GString *record)
 {
-  guint32 n = GUINT32_TO_BE(record->len);
+  GString *compressed;
+  uLongf compressed_len;
+  guint32 orig_len;
+
+  if (record->len < QDISK_COMPRESS_MIN_SIZE)
+    return NULL;
+
+  compressed_len = compressBound(record->len);
+  compressed = g_string_sized_new(sizeof(orig_len) + compressed_len);
+  g_string_set_size(compressed, sizeof(orig_len) + compressed_len);
+
+  orig_len = GUINT32_TO_BE(record->len);
+  memcpy(compressed->str, &orig_len, sizeof(orig_len));
+  if (compress2((Bytef *) compressed->str + sizeof(orig_len), &compressed_len,
+                (const Bytef *) record->str, record->len, Z_BEST_SPEED) != Z_OK ||
+      sizeof(orig_len) + compressed_len >= record->len)
+    {
+      g_string_free(compressed, TRUE);
+      return NULL;
+    }
+  g_string_set_size(compressed, sizeof(orig_len) + compressed_len);
+  return compressed;
+}
+
+static gboolean
+_decompress_record(QDisk *self, GString *compressed, GString *record)
+{
+  guint32 orig_len;
+  uLongf len;
+
+  if (compressed->len < sizeof(orig_len))
+    return FALSE;
+
+  memcpy(&orig_len, compressed->str, sizeof(orig_len));
+  orig_len = GUINT32_FROM_BE(orig_len);
+  if (orig_len == 0 || orig_len > QDISK_MAX_RECORD_SIZE)
+    return FALSE;
+
+  len = orig_len;
+  g_string_set_size(record, orig_len);
+  if (uncompress((Bytef *) record->str, &len,
+                 (const Bytef *) compressed->str + sizeof(orig_len), compressed->len - sizeof(orig_len)) != Z_OK ||
+      len != orig_len)
+    return FALSE;
+  return TRUE;
+}
+
+#else
+
+static GString *
+_compress_record(GString *record)
+{
+  return NULL;
+}
+
+static gboolean
+_decompress_record(QDisk *self, GString *compressed, GString *record)
+{
+  msg_error("Disk-queue file contains compressed records, but syslog-ng was compiled without zlib support",
+            evt_tag_str("filename", self->filename),
+            NULL);
+  return FALSE;
+}
+
+#endif
+
+gchar *
+qdisk_get_index_filename(const gchar *filename)
+{
+  return g_strdup_printf("%s.idx", filename);
+}
+
+static void
+_index_open(QDisk *self, gboolean new_file)
+{
+  gchar *index_filename;
+
+  if (!self->options->use_index || self->options->read_only)
+    return;
+
+  index_filename = qdisk_get_index_filename(self->filename);
+  self->index_fd = open(index_filename, O_WRONLY | O_CREAT | O_APPEND | (new_file ? O_TRUNC : 0), 0600);
+  if (self->index_fd < 0)
+    {
+      msg_error("Error opening disk-queue index file, continuing without an index",
+                evt_tag_str("filename", index_filename),
+                evt_tag_errno("error", errno),
+                NULL);
+    }
+  g_free(index_filename);
+}
+
+static void
+_index_close(QDisk *self)
+{
+  if (self->index_fd >= 0)
+    {
+      close(self->index_fd);
+      self->index_fd = -1;
+    }
+}
+
+/* The index is a sparse, append-only list of record positions, one for
+ * every QDISK_INDEX_INTERVAL-th record written. As the queue file is
+ * circular, entries only describe live records if their sequence number
+ * is not older than push_count - length, readers have to check that. */
+static void
+_index_append(QDisk *self, gint64 position)
+{
+  QDiskIndexEntry entry;
+
+  if (self->index_fd < 0 || (self->hdr->push_count % QDISK_INDEX_INTERVAL) != 0)
+    return;
+
+  entry.seq = GINT64_TO_BE(self->hdr->push_count);
+  entry.position = GINT64_TO_BE(position);
+  entry.stamp = GINT64_TO_BE((gint64) time(NULL));
+  if (write(self->index_fd, &entry, sizeof(entry)) != sizeof(entry))
+    {
+      msg_error("Error writing disk-queue index file, continuing without an index",
+                evt_tag_str("filename", self->filename),
+                evt_tag_errno("error", errno),
+                NULL);
+      _index_close(self);
+    }
+}
+
+static void
+_index_reset(QDisk *self)
+{
+  if (self->index_fd >= 0 && ftruncate(self->index_fd, 0) < 0)
+    _index_close(self);
+}
+
+static gboolean
+_push_tail_record(QDisk *self, GString *record, guint32 flags)
+{
+  guint32 n = GUINT32_TO_BE(record->len | flags);
+  gint64 position = self->hdr->write_head;
 
   /* write follows read (e.g. we are appending to the file) OR
    * there's enough space between write and read.
@@ -241,8 +494,8 @@ qdisk_push_tail(QDisk *self, GString *record)
       return FALSE;
     }
 
-  if (!pwrite_strict(self->fd, (gchar *) &n, sizeof(n), self->hdr->write_head) ||
-      !pwrite_strict(self->fd, record->str, record->len, self->hdr->write_head + sizeof(n)))
+  if (!_write_at(self, (gchar *) &n, sizeof(n), self->hdr->write_head) ||
+      !_write_at(self, record->str, record->len, self->hdr->write_head + sizeof(n)))
     {
       msg_error("Error writing disk-queue file",
           evt_tag_errno("error", errno),
@@ -295,54 +548,86 @@ qdisk_push_tail(QDisk *self, GString *record)
           self->hdr->write_head = QDISK_RESERVED_SPACE;
         }
     }
+  _index_append(self, position);
+  self->hdr->push_count++;
   self->hdr->length++;
   return TRUE;
 }
 
 gboolean
-qdisk_pop_head(QDisk *self, GString *record)
+qdisk_push_tail(QDisk *self, GString *record)
 {
-  if (self->hdr->read_head != self->hdr->write_head)
-    {
-      guint32 n;
-      gssize res;
-      res = pread(self->fd, (gchar *) &n, sizeof(n), self->hdr->read_head);
+  GString *compressed = NULL;
+  gboolean result;
 
-      if (res == 0)
-        {
-          /* hmm, we are either at EOF or at hdr->qout_ofs, we need to wrap */
-          self->hdr->read_head = QDISK_RESERVED_SPACE;
-          res = pread(self->fd, (gchar *) &n, sizeof(n), self->hdr->read_head);
-        }
-      if (res != sizeof(n))
-        {
-          msg_error("Error reading disk-queue file",
-                    evt_tag_str("error", res < 0 ? g_strerror(errno) : "short read"),
-                    evt_tag_str("filename", self->filename),
-                    NULL);
-          return FALSE;
-        }
+  if (self->options->compress)
+    compressed = _compress_record(record);
 
-      n = GUINT32_FROM_BE(n);
-      if (n > 10 * 1024 * 1024)
-        {
-          msg_warning("Disk-queue file contains possibly invalid record-length",
-                    evt_tag_int("rec_length", n),
-                    evt_tag_str("filename", self->filename),
-                    NULL);
-          return FALSE;
-        }
-      else if (n == 0)
-        {
-          msg_error("Disk-queue file contains empty record",
-                    evt_tag_int("rec_length", n),
-                    evt_tag_str("filename", self->filename),
-                    NULL);
-          return FALSE;
-        }
+  if (!compressed)
+    return _push_tail_record(self, record, 0);
+
+  result = _push_tail_record(self, compressed, QDISK_RECORD_COMPRESSED);
+  if (result)
+    self->hdr->flags |= QDISK_HDR_FLAG_COMPRESSED;
+  g_string_free(compressed, TRUE);
+  return result;
+}
+
+/* Reads the record at position, wrapping around to the start of the file
+ * at its end. If record is NULL, the record is only skipped. Returns the
+ * position of the next record or -1 on error, the header is left untouched. */
+static gint64
+_read_record(QDisk *self, gint64 position, GString *record)
+{
+  guint32 n;
+  gssize res;
+  gboolean compressed;
+  GString *payload;
+
+  res = _read_at(self, (gchar *) &n, sizeof(n), position);
+
+  if (res == 0 || (res == sizeof(n) && n == 0 && position > self->hdr->write_head))
+    {
+      /* hmm, we are either at EOF or at hdr->qout_ofs, we need to wrap.
+       * A zero length past the write head is a logical end of file
+       * left behind in mmap mode. */
+      position = QDISK_RESERVED_SPACE;
+      res = _read_at(self, (gchar *) &n, sizeof(n), position);
+    }
+  if (res != sizeof(n))
+    {
+      msg_error("Error reading disk-queue file",
+                evt_tag_str("error", res < 0 ? g_strerror(errno) : "short read"),
+                evt_tag_str("filename", self->filename),
+                NULL);
+      return -1;
+    }
 
-      g_string_set_size(record, n);
-      res = pread(self->fd, record->str, n, self->hdr->read_head + sizeof(n));
+  n = GUINT32_FROM_BE(n);
+  compressed = !!(n & QDISK_RECORD_COMPRESSED);
+  n &= QDISK_RECORD_LEN_MASK;
+  if (n > QDISK_MAX_RECORD_SIZE)
+    {
+      msg_warning("Disk-queue file contains possibly invalid record-length",
+                evt_tag_int("rec_length", n),
+                evt_tag_str("filename", self->filename),
+                NULL);
+      return -1;
+    }
+  else if (n == 0)
+    {
+      msg_error("Disk-queue file contains empty record",
+                evt_tag_int("rec_length", n),
+                evt_tag_str("filename", self->filename),
+                NULL);
+      return -1;
+    }
+
+  if (record)
+    {
+      payload = compressed ? g_string_sized_new(n) : record;
+      g_string_set_size(payload, n);
+      res = _read_at(self, payload->str, n, position + sizeof(n));
       if (res != n)
         {
           msg_error("Error reading disk-queue file",
@@ -350,15 +635,45 @@ qdisk_pop_head(QDisk *self, GString *record)
                     evt_tag_str("error", res < 0 ? g_strerror(errno) : "short read"),
                     evt_tag_int("read_length", n),
                     NULL);
-          return FALSE;
+          if (compressed)
+            g_string_free(payload, TRUE);
+          return -1;
         }
-
-      self->hdr->read_head = self->hdr->read_head + record->len + sizeof(n);
-
-      if (self->hdr->read_head > self->hdr->write_head)
+      if (compressed)
         {
-          self->hdr->read_head = _correct_position_if_eof(self, &self->hdr->read_head);
+          gboolean success = _decompress_record(self, payload, record);
+
+          g_string_free(payload, TRUE);
+          if (!success)
+            {
+              msg_error("Error decompressing disk-queue record",
+                        evt_tag_str("filename", self->filename),
+                        evt_tag_int("rec_length", n),
+                        NULL);
+              return -1;
+            }
         }
+    }
+
+  position = position + n + sizeof(n);
+
+  if (position > self->hdr->write_head)
+    {
+      position = _correct_position_if_eof(self, &position);
+    }
+  return position;
+}
+
+gboolean
+qdisk_pop_head(QDisk *self, GString *record)
+{
+  if (self->hdr->read_head != self->hdr->write_head)
+    {
+      gint64 next_position = _read_record(self, self->hdr->read_head, record);
+
+      if (next_position < 0)
+        return FALSE;
+      self->hdr->read_head = next_position;
 
       self->hdr->length--;
       if (!self->options->reliable)
@@ -379,6 +694,7 @@ qdisk_pop_head(QDisk *self, GString *record)
             }
           self->hdr->length = 0;
           _truncate_file(self, self->hdr->write_head);
+          _index_reset(self);
         }
       return TRUE;
 
@@ -386,17 +702,76 @@ qdisk_pop_head(QDisk *self, GString *record)
   return FALSE;
 }
 
+static void
+_deserialize_queue(QDisk *self, GQueue *q, SerializeArchive *sa, gint32 q_count)
+{
+  gint i;
+
+  for (i = 0; i < q_count; i++)
+    {
+      LogMessage *msg;
+
+      msg = log_msg_new_empty();
+      if (log_msg_deserialize(msg, sa))
+        {
+          g_queue_push_tail(q, msg);
+          /* we restore the queue without ACKs */
+          g_queue_push_tail(q, GINT_TO_POINTER(0x80000000));
+        }
+      else
+        {
+          msg_error("Error reading message from disk-queue file (maybe currupted file) some messages will be lost",
+                        evt_tag_str("filename", self->filename),
+                        evt_tag_int("lost messages", q_count - i),
+                        NULL);
+          log_msg_unref(msg);
+          break;
+        }
+    }
+}
+
+/*
+ * The saved in-memory queues are deserialized directly from a read-only
+ * mapping of the file, reading them into a buffer first is only a fallback
+ * when the range can not be mapped.
+ */
+static gboolean
+_load_queue_mapped(QDisk *self, GQueue *q, gint64 q_ofs, gint32 q_len, gint32 q_count)
+{
+  struct stat st;
+  gint64 map_ofs = q_ofs - (q_ofs % getpagesize());
+  gsize map_len = q_len + (q_ofs - map_ofs);
+  SerializeArchive *sa;
+  gchar *p;
+
+  /* accessing a mapping past the end of file raises SIGBUS */
+  if (fstat(self->fd, &st) < 0 || q_ofs + q_len > st.st_size)
+    return FALSE;
+
+  p = mmap(0, map_len, PROT_READ, MAP_PRIVATE, self->fd, map_ofs);
+  if (p == MAP_FAILED)
+    return FALSE;
+
+  sa = serialize_region_archive_new(p + (q_ofs - map_ofs), q_len);
+  _deserialize_queue(self, q, sa, q_count);
+  serialize_archive_free(sa);
+  munmap(p, map_len);
+  return TRUE;
+}
+
 static gboolean
 _load_queue(QDisk *self, GQueue *q, gint64 q_ofs, gint32 q_len, gint32 q_count)
 {
   GString *serialized;
   SerializeArchive *sa;
-  gint i;
 
   if (q_ofs)
     {
       gssize read_len;
 
+      if (_load_queue_mapped(self, q, q_ofs, q_len, q_count))
+        return TRUE;
+
       serialized = g_string_sized_new(q_len);
       g_string_set_size(serialized, q_len);
       read_len = pread(self->fd, serialized->str, q_len, q_ofs);
@@ -409,30 +784,10 @@ _load_queue(QDisk *self, GQueue *q, gint64 q_ofs, gint32 q_len, gint32 q_count)
           g_string_free(serialized, TRUE);
           return FALSE;
         }
-      sa = serialize_string_archive_new(serialized);
-      for (i = 0; i < q_count; i++)
-        {
-          LogMessage *msg;
-
-          msg = log_msg_new_empty();
-          if (log_msg_deserialize(msg, sa))
-            {
-              g_queue_push_tail(q, msg);
-              /* we restore the queue without ACKs */
-              g_queue_push_tail(q, GINT_TO_POINTER(0x80000000));
-            }
-          else
-            {
-              msg_error("Error reading message from disk-queue file (maybe currupted file) some messages will be lost",
-                            evt_tag_str("filename", self->filename),
-                            evt_tag_int("lost messages", q_count - i),
-                            NULL);
-              log_msg_unref(msg);
-              break;
-            }
-        }
-      g_string_free(serialized, TRUE);
+      sa = serialize_region_archive_new(serialized->str, serialized->len);
+      _deserialize_queue(self, q, sa, q_count);
       serialize_archive_free(sa);
+      g_string_free(serialized, TRUE);
     }
   return TRUE;
 }
@@ -609,6 +964,119 @@ _save_queue(QDisk *self, GQueue *q, gint64 *q_ofs, gint32 *q_len)
   return TRUE;
 }
 
+/*
+ * Shrink the file to its logical size and flush the mapping, after this
+ * the file is the same as if it had been written with pwrite().
+ */
+static gboolean
+_mmap_sync(QDisk *self)
+{
+  if (self->map_file_length > self->data_end)
+    {
+      if (ftruncate(self->fd, (glong) self->data_end) < 0)
+        {
+          msg_error("Error truncating disk-queue file",
+                    evt_tag_errno("error", errno),
+                    evt_tag_str("filename", self->filename),
+                    evt_tag_int("newsize", self->data_end),
+                    NULL);
+          return FALSE;
+        }
+      self->map_file_length = self->data_end;
+    }
+  if (msync(self->map, MIN(self->map_file_length, self->map_size), MS_SYNC) < 0)
+    {
+      msg_error("Error syncing disk-queue file",
+                evt_tag_errno("error", errno),
+                evt_tag_str("filename", self->filename),
+                NULL);
+      return FALSE;
+    }
+  return TRUE;
+}
+
+static void
+_mmap_stop(QDisk *self)
+{
+  _mmap_sync(self);
+  munmap(self->map, self->map_size);
+  self->map = NULL;
+  self->map_size = 0;
+}
+
+/*
+ * In mmap mode (mmap(yes)) the data area of the queue file is accessed
+ * through a shared mapping instead of pread()/pwrite(), the file is
+ * extended in QDISK_MMAP_GROW_STEP steps and truncations only move the
+ * logical end of file.  The layout of the file is unchanged, the file is
+ * truncated to its logical size when the state is saved.
+ *
+ * The mapping covers the configured disk_buf_size, plus a maximum sized
+ * record, as the write head may go past the limit by one record.  If the
+ * mapping can not be created (e.g. not enough address space), the queue
+ * falls back to pread()/pwrite().
+ */
+static void
+_mmap_start(QDisk *self)
+{
+  struct stat st;
+  gpointer p;
+
+  if (fstat(self->fd, &st) < 0)
+    return;
+
+  self->map_size = MAX(self->options->disk_buf_size, st.st_size) + QDISK_MAX_RECORD_SIZE + sizeof(guint32);
+  p = mmap(0, self->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, self->fd, 0);
+  if (p == MAP_FAILED)
+    {
+      msg_warning("Error mapping disk-queue file, falling back to regular file I/O",
+                  evt_tag_errno("error", errno),
+                  evt_tag_str("filename", self->filename),
+                  evt_tag_int("size", self->map_size),
+                  NULL);
+      self->map_size = 0;
+      return;
+    }
+  self->map = p;
+  self->map_file_length = st.st_size;
+  self->data_end = st.st_size;
+}
+
+/*
+ * Flushes the records written so far to stable storage using @fd, a
+ * duplicate of the queue file descriptor returned by qdisk_dup_fd().
+ * This way the sync can run in a separate thread without holding the
+ * queue lock, even if the queue file is reopened in the meantime.  In
+ * mmap mode, dirty pages of the shared mapping are flushed by fdatasync()
+ * too, as they are in the same page cache.
+ */
+gboolean
+qdisk_sync_fd(gint fd)
+{
+#ifdef SYSLOG_NG_HAVE_FDATASYNC
+  gint rc = fdatasync(fd);
+#else
+  gint rc = fsync(fd);
+#endif
+
+  if (rc < 0)
+    {
+      msg_error("Error syncing disk-queue file",
+                evt_tag_errno("error", errno),
+                NULL);
+      return FALSE;
+    }
+  return TRUE;
+}
+
+gint
+qdisk_dup_fd(QDisk *self)
+{
+  if (self->fd < 0)
+    return -1;
+  return dup(self->fd);
+}
+
 gboolean
 qdisk_save_state(QDisk *self, GQueue *qout, GQueue *qbacklog, GQueue *qoverflow)
 {
@@ -622,6 +1090,9 @@ qdisk_save_state(QDisk *self, GQueue *qout, GQueue *qbacklog, GQueue *qoverflow)
   gint32 qoverflow_len = 0;
   gint32 qoverflow_count = 0;
 
+  if (self->map && !_mmap_sync(self))
+    return FALSE;
+
   if (!self->options->reliable)
     {
       qout_count = qout->length / 2;
@@ -813,8 +1284,22 @@ qdisk_start(QDisk *self, const gchar *filename, GQueue *qout, GQueue *qbacklog,
           self->hdr->qoverflow_count = GUINT32_SWAP_LE_BE(self->hdr->qoverflow_count);
           self->hdr->backlog_head = GUINT64_SWAP_LE_BE(self->hdr->backlog_head);
           self->hdr->backlog_len = GUINT64_SWAP_LE_BE(self->hdr->backlog_len);
+          self->hdr->push_count = GUINT64_SWAP_LE_BE(self->hdr->push_count);
           self->hdr->big_endian = (G_BYTE_ORDER == G_BIG_ENDIAN);
         }
+#if !SYSLOG_NG_HAVE_ZLIB
+      if (self->hdr->flags & QDISK_HDR_FLAG_COMPRESSED)
+        {
+          msg_error("Error loading disk-queue file, it contains compressed records, but syslog-ng was compiled without zlib support",
+                    evt_tag_str("filename", self->filename),
+                    NULL);
+          munmap((void *)self->hdr, sizeof(QDiskFileHeader));
+          self->hdr = NULL;
+          close(self->fd);
+          self->fd = -1;
+          return FALSE;
+        }
+#endif
       if (!_load_state(self, qout, qbacklog, qoverflow))
         {
           munmap((void *)self->hdr, sizeof(QDiskFileHeader));
@@ -825,6 +1310,10 @@ qdisk_start(QDisk *self, const gchar *filename, GQueue *qout, GQueue *qbacklog,
         }
 
     }
+
+  if (self->options->use_mmap && !self->options->read_only)
+    _mmap_start(self);
+  _index_open(self, new_file);
   return TRUE;
 }
 
@@ -832,6 +1321,7 @@ void
 qdisk_init(QDisk *self, DiskQueueOptions *options)
 {
   self->fd = -1;
+  self->index_fd = -1;
   self->options = options;
   if (!self->options->reliable)
     self->file_id = "SLQF";
@@ -854,6 +1344,11 @@ qdisk_deinit(QDisk *self)
       self->filename = NULL;
     }
 
+  if (self->map)
+    _mmap_stop(self);
+
+  _index_close(self);
+
   if (self->hdr)
     {
       if (self->options->read_only)
@@ -876,11 +1371,11 @@ gssize
 qdisk_read_from_backlog(QDisk *self, gpointer buffer, gsize bytes_to_read)
 {
   gssize res;
-  res = pread(self->fd, buffer, bytes_to_read, self->hdr->backlog_head);
+  res = _read_at(self, buffer, bytes_to_read, self->hdr->backlog_head);
   if (res == 0)
     {
       self->hdr->backlog_head = QDISK_RESERVED_SPACE;
-      res = pread(self->fd, buffer, bytes_to_read, self->hdr->backlog_head);
+      res = _read_at(self, buffer, bytes_to_read, self->hdr->backlog_head);
     }
   if (res != bytes_to_read)
     {
@@ -900,7 +1395,7 @@ gssize
 qdisk_read(QDisk *self, gpointer buffer, gsize bytes_to_read, gint64 position)
 {
   gssize res;
-  res = pread(self->fd, buffer, bytes_to_read, position);
+  res = _read_at(self, buffer, bytes_to_read, position);
   if (res <= 0)
     {
       msg_error("Error reading disk-queue file",
@@ -917,7 +1412,7 @@ qdisk_skip_record(QDisk *self, guint64 position)
   guint64 new_position = position;
   guint32 s;
   qdisk_read (self, (gchar *) &s, sizeof(s), position);
-  s = GUINT32_FROM_BE(s);
+  s = GUINT32_FROM_BE(s) & QDISK_RECORD_LEN_MASK;
   new_position += s + sizeof(s);
   if (new_position > self->hdr->write_head)
     {
@@ -941,9 +1436,22 @@ qdisk_reset_file_if_possible(QDisk *self)
       self->hdr->write_head = QDISK_RESERVED_SPACE;
       self->hdr->backlog_head = QDISK_RESERVED_SPACE;
       _truncate_file (self, QDISK_RESERVED_SPACE);
+      _index_reset(self);
     }
 }
 
+gint64
+qdisk_read_record(QDisk *self, gint64 position, GString *record)
+{
+  return _read_record(self, position, record);
+}
+
+gint64
+qdisk_get_push_count(QDisk *self)
+{
+  return self->hdr->push_count;
+}
+
 gint64
 qdisk_get_length(QDisk *self)
 {
@@ -962,6 +1470,14 @@ qdisk_get_size(QDisk *self)
   return self->options->disk_buf_size;
 }
 
+/* file_size is only maintained when the file is truncated/loaded, until
+ * that the file grows by appending at the write head */
+gint64
+qdisk_get_file_size(QDisk *self)
+{
+  return MAX(self->file_size, self->hdr->write_head);
+}
+
 const gchar *
 qdisk_get_filename(QDisk *self)
 {
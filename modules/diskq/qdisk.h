@@ -38,6 +38,20 @@
 
 typedef struct _QDisk QDisk;
 
+/* index(yes): an entry is written into "<queue file>.idx" for every
+ * QDISK_INDEX_INTERVAL-th record, all fields are big endian */
+#define QDISK_INDEX_INTERVAL 1024
+
+typedef struct _QDiskIndexEntry
+{
+  /* sequence number of the record, see qdisk_get_push_count() */
+  gint64 seq;
+  /* offset of the record in the queue file */
+  gint64 position;
+  /* the time the record was written, in seconds since the epoch */
+  gint64 stamp;
+} QDiskIndexEntry;
+
 QDisk *qdisk_new();
 
 gboolean qdisk_is_space_avail(QDisk *self, gint at_least);
@@ -51,10 +65,13 @@ gboolean qdisk_initialized(QDisk *self);
 void qdisk_free(QDisk *self);
 
 gboolean qdisk_save_state(QDisk *self, GQueue *qout, GQueue *qbacklog, GQueue *qoverflow);
+gint qdisk_dup_fd(QDisk *self);
+gboolean qdisk_sync_fd(gint fd);
 
 gint64 qdisk_get_length(QDisk *self);
 void qdisk_set_length(QDisk *self, gint64 new_value);
 gint64 qdisk_get_size(QDisk *self);
+gint64 qdisk_get_file_size(QDisk *self);
 gint64 qdisk_get_writer_head(QDisk *self);
 gint64 qdisk_get_reader_head(QDisk *self);
 void qdisk_set_reader_head(QDisk *self, gint64 new_value);
@@ -71,5 +88,8 @@ const gchar *qdisk_get_filename(QDisk *self);
 gssize qdisk_read_from_backlog(QDisk *self, gpointer buffer, gsize bytes_to_read);
 gssize qdisk_read(QDisk *self, gpointer buffer, gsize bytes_to_read, gint64 position);
 guint64 qdisk_skip_record(QDisk *self, guint64 position);
+gint64 qdisk_read_record(QDisk *self, gint64 position, GString *record);
+gint64 qdisk_get_push_count(QDisk *self);
+gchar *qdisk_get_index_filename(const gchar *filename);
 
 #endif /* QDISK_H_ */
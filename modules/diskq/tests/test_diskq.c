@@ -25,6 +25,7 @@
 #include "logqueue-fifo.h"
 #include "logqueue-disk.h"
 #include "logqueue-disk-reliable.h"
+#include "logqueue-disk-non-reliable.h"
 #include "diskq.h"
 #include "logpipe.h"
 #include "apphook.h"
@@ -152,6 +153,287 @@ testcase_ack_and_rewind_messages()
   disk_queue_options_destroy(&options);
 }
 
+static void
+testcase_mmap_queue_file_can_be_reopened_without_mmap()
+{
+  LogQueue *q;
+  GString *filename;
+  DiskQueueOptions options = {0};
+
+  _construct_options(&options, 10000000, 100000, TRUE);
+  options.use_mmap = TRUE;
+
+  q = log_queue_disk_reliable_new(&options);
+  log_queue_set_use_backlog(q, TRUE);
+
+  filename = g_string_sized_new(32);
+  g_string_sprintf(filename,"test-mmap.qf");
+  unlink(filename->str);
+  log_queue_disk_load_queue(q,filename->str);
+
+  fed_messages = 0;
+  acked_messages = 0;
+  feed_some_messages(q, 100, &parse_options);
+  send_some_messages(q, 50);
+  app_ack_some_messages(q, 50);
+  log_queue_unref(q);
+  disk_queue_options_destroy(&options);
+
+  _construct_options(&options, 10000000, 100000, TRUE);
+  q = log_queue_disk_reliable_new(&options);
+  log_queue_set_use_backlog(q, TRUE);
+  log_queue_disk_load_queue(q,filename->str);
+  assert_gint(log_queue_get_length(q), 50, "%s: messages written in mmap mode were not restored\n", __FUNCTION__);
+
+  send_some_messages(q, 50);
+  app_ack_some_messages(q, 50);
+  assert_gint(log_queue_get_length(q), 0, "%s: queue should be empty\n", __FUNCTION__);
+
+  log_queue_unref(q);
+  unlink(filename->str);
+  g_string_free(filename,TRUE);
+  disk_queue_options_destroy(&options);
+}
+
+static void
+testcase_compressed_queue_file_can_be_reopened()
+{
+  LogQueue *q;
+  GString *filename;
+  DiskQueueOptions options = {0};
+
+  _construct_options(&options, 10000000, 100000, TRUE);
+  options.compress = TRUE;
+
+  q = log_queue_disk_reliable_new(&options);
+  log_queue_set_use_backlog(q, TRUE);
+
+  filename = g_string_sized_new(32);
+  g_string_sprintf(filename,"test-compress.qf");
+  unlink(filename->str);
+  log_queue_disk_load_queue(q,filename->str);
+
+  fed_messages = 0;
+  acked_messages = 0;
+  feed_some_messages(q, 100, &parse_options);
+  send_some_messages(q, 20);
+  app_rewind_some_messages(q, 20);
+  send_some_messages(q, 50);
+  app_ack_some_messages(q, 50);
+  log_queue_unref(q);
+  disk_queue_options_destroy(&options);
+
+  /* compressed records are recognized regardless of the compress() setting */
+  _construct_options(&options, 10000000, 100000, TRUE);
+  q = log_queue_disk_reliable_new(&options);
+  log_queue_set_use_backlog(q, TRUE);
+  log_queue_disk_load_queue(q,filename->str);
+  assert_gint(log_queue_get_length(q), 50, "%s: compressed messages were not restored\n", __FUNCTION__);
+
+  send_some_messages(q, 50);
+  app_ack_some_messages(q, 50);
+  assert_gint(log_queue_get_length(q), 0, "%s: queue should be empty\n", __FUNCTION__);
+
+  log_queue_unref(q);
+  unlink(filename->str);
+  g_string_free(filename,TRUE);
+  disk_queue_options_destroy(&options);
+}
+
+static void
+testcase_async_recovery_waits_for_the_queue_to_load()
+{
+  LogQueue *q;
+  GString *filename;
+  DiskQueueOptions options = {0};
+  gboolean persistent;
+
+  _construct_options(&options, 10000000, 100000, FALSE);
+  options.qout_size = 64;
+
+  q = log_queue_disk_non_reliable_new(&options);
+  log_queue_set_use_backlog(q, TRUE);
+
+  filename = g_string_sized_new(32);
+  g_string_sprintf(filename,"test-async_recovery.qf");
+  unlink(filename->str);
+  log_queue_disk_load_queue(q,filename->str);
+
+  fed_messages = 0;
+  acked_messages = 0;
+  feed_some_messages(q, 1000, &parse_options);
+  log_queue_disk_save_queue(q, &persistent);
+  log_queue_unref(q);
+
+  q = log_queue_disk_non_reliable_new(&options);
+  log_queue_set_use_backlog(q, TRUE);
+  log_queue_disk_load_queue_async(q, filename->str);
+
+  /* operations block until the queue file is loaded */
+  send_some_messages(q, 1000);
+  app_ack_some_messages(q, 1000);
+  assert_gint(log_queue_get_length(q), 0, "%s: queue should be empty\n", __FUNCTION__);
+
+  log_queue_unref(q);
+  unlink(filename->str);
+  g_string_free(filename,TRUE);
+  disk_queue_options_destroy(&options);
+}
+
+static void
+testcase_hybrid_queue_spills_only_above_the_watermark()
+{
+  LogQueue *q;
+  GString *filename;
+  DiskQueueOptions options = {0};
+
+  _construct_options(&options, 10000000, 500, FALSE);
+  options.hybrid = TRUE;
+
+  q = log_queue_disk_non_reliable_new(&options);
+  log_queue_set_use_backlog(q, TRUE);
+
+  filename = g_string_sized_new(32);
+  g_string_sprintf(filename,"test-hybrid.qf");
+  unlink(filename->str);
+  log_queue_disk_load_queue(q,filename->str);
+
+  fed_messages = 0;
+  acked_messages = 0;
+  feed_some_messages(q, 500, &parse_options);
+  assert_gint(qdisk_get_length(((LogQueueDisk *) q)->qdisk), 0, "%s: messages below the watermark were written to disk\n", __FUNCTION__);
+
+  feed_some_messages(q, 1000, &parse_options);
+  assert_true(qdisk_get_length(((LogQueueDisk *) q)->qdisk) > 0, "%s: messages above the watermark were not spilled\n", __FUNCTION__);
+
+  send_some_messages(q, fed_messages);
+  app_ack_some_messages(q, fed_messages);
+  assert_gint(fed_messages, acked_messages, "%s: did not receive enough acknowledgements: fed_messages=%d, acked_messages=%d\n", __FUNCTION__, fed_messages, acked_messages);
+  assert_gint(log_queue_get_length(q), 0, "%s: queue should be empty\n", __FUNCTION__);
+
+  log_queue_unref(q);
+  unlink(filename->str);
+  g_string_free(filename,TRUE);
+  disk_queue_options_destroy(&options);
+}
+
+static void
+testcase_index_points_to_every_nth_record()
+{
+  LogQueue *q;
+  GString *filename;
+  GString *record;
+  gchar *index_filename;
+  QDiskIndexEntry *entries;
+  gsize index_len;
+  DiskQueueOptions options = {0};
+
+  _construct_options(&options, 10000000, 100000, TRUE);
+  options.use_index = TRUE;
+
+  q = log_queue_disk_reliable_new(&options);
+  log_queue_set_use_backlog(q, TRUE);
+
+  filename = g_string_sized_new(32);
+  g_string_sprintf(filename,"test-index.rqf");
+  index_filename = qdisk_get_index_filename(filename->str);
+  unlink(filename->str);
+  unlink(index_filename);
+  log_queue_disk_load_queue(q,filename->str);
+
+  fed_messages = 0;
+  acked_messages = 0;
+  feed_some_messages(q, 2 * QDISK_INDEX_INTERVAL + 1, &parse_options);
+
+  assert_true(g_file_get_contents(index_filename, (gchar **) &entries, &index_len, NULL), "%s: index file was not created\n", __FUNCTION__);
+  assert_gint(index_len, 3 * sizeof(QDiskIndexEntry), "%s: unexpected number of index entries\n", __FUNCTION__);
+  assert_gint(GINT64_FROM_BE(entries[0].position), QDISK_RESERVED_SPACE, "%s: the first entry does not point to the first record\n", __FUNCTION__);
+  assert_gint(GINT64_FROM_BE(entries[2].seq), 2 * QDISK_INDEX_INTERVAL, "%s: unexpected sequence number\n", __FUNCTION__);
+
+  record = g_string_sized_new(128);
+  assert_true(qdisk_read_record(((LogQueueDisk *) q)->qdisk, GINT64_FROM_BE(entries[2].position), record) > 0, "%s: indexed record could not be read\n", __FUNCTION__);
+  g_string_free(record, TRUE);
+  g_free(entries);
+
+  send_some_messages(q, fed_messages);
+  app_ack_some_messages(q, fed_messages);
+  assert_gint(fed_messages, acked_messages, "%s: did not receive enough acknowledgements: fed_messages=%d, acked_messages=%d\n", __FUNCTION__, fed_messages, acked_messages);
+
+  log_queue_unref(q);
+  unlink(filename->str);
+  unlink(index_filename);
+  g_free(index_filename);
+  g_string_free(filename,TRUE);
+  disk_queue_options_destroy(&options);
+}
+
+static void
+testcase_group_commit_acks_after_sync()
+{
+  LogQueue *q;
+  GString *filename;
+  DiskQueueOptions options = {0};
+
+  _construct_options(&options, 10000000, 100000, TRUE);
+  options.sync_max_latency = 60000;
+
+  q = log_queue_disk_reliable_new(&options);
+  log_queue_set_use_backlog(q, TRUE);
+
+  filename = g_string_sized_new(32);
+  g_string_sprintf(filename,"test-group_commit.qf");
+  unlink(filename->str);
+  log_queue_disk_load_queue(q,filename->str);
+
+  fed_messages = 0;
+  acked_messages = 0;
+  feed_some_messages(q, 100, &parse_options);
+  assert_gint(acked_messages, 0, "%s: messages were acked before being synced\n", __FUNCTION__);
+
+  /* stopping the queue syncs and acks the pending messages */
+  log_queue_unref(q);
+  assert_gint(fed_messages, acked_messages, "%s: did not receive enough acknowledgements: fed_messages=%d, acked_messages=%d\n", __FUNCTION__, fed_messages, acked_messages);
+
+  unlink(filename->str);
+  g_string_free(filename,TRUE);
+  disk_queue_options_destroy(&options);
+}
+
+static void
+testcase_async_io_delivers_all_messages()
+{
+  LogQueue *q;
+  GString *filename;
+  DiskQueueOptions options = {0};
+
+  _construct_options(&options, 10000000, 100000, FALSE);
+  options.qout_size = 64;
+  options.async_io = TRUE;
+
+  q = log_queue_disk_non_reliable_new(&options);
+  log_queue_set_use_backlog(q, TRUE);
+
+  filename = g_string_sized_new(32);
+  g_string_sprintf(filename,"test-async_io.qf");
+  unlink(filename->str);
+  log_queue_disk_load_queue(q,filename->str);
+
+  fed_messages = 0;
+  acked_messages = 0;
+  feed_some_messages(q, 1000, &parse_options);
+  assert_gint(log_queue_get_length(q), 1000, "%s: messages were lost while being written\n", __FUNCTION__);
+
+  send_some_messages(q, fed_messages);
+  app_ack_some_messages(q, fed_messages);
+  assert_gint(fed_messages, acked_messages, "%s: did not receive enough acknowledgements: fed_messages=%d, acked_messages=%d\n", __FUNCTION__, fed_messages, acked_messages);
+  assert_gint(log_queue_get_length(q), 0, "%s: queue should be empty\n", __FUNCTION__);
+
+  log_queue_unref(q);
+  unlink(filename->str);
+  g_string_free(filename,TRUE);
+  disk_queue_options_destroy(&options);
+}
+
 #define FEEDERS 1
 #define MESSAGES_PER_FEEDER 10000
 #define MESSAGES_SUM (FEEDERS * MESSAGES_PER_FEEDER)
@@ -312,6 +594,13 @@ main()
 
   testcase_zero_diskbuf_alternating_send_acks();
   testcase_zero_diskbuf_and_normal_acks();
+  testcase_mmap_queue_file_can_be_reopened_without_mmap();
+  testcase_compressed_queue_file_can_be_reopened();
+  testcase_group_commit_acks_after_sync();
+  testcase_async_io_delivers_all_messages();
+  testcase_async_recovery_waits_for_the_queue_to_load();
+  testcase_hybrid_queue_spills_only_above_the_watermark();
+  testcase_index_points_to_every_nth_record();
 
   return 0;
 }
@@ -23,9 +23,11 @@
 
 #include "geoip-parser.h"
 #include "parser/parser-expr.h"
-#include "scratch-buffers.h"
+#include "str-utils.h"
+#include "tls-support.h"
 
 #include <GeoIPCity.h>
+#include <string.h>
 
 typedef struct
 {
@@ -41,8 +43,53 @@ typedef struct
     gchar *longitude;
     gchar *latitude;
   } dest;
+  struct
+  {
+    NVHandle country_code;
+    NVHandle longitude;
+    NVHandle latitude;
+  } handles;
+
+  /* identifies our entries in the per-thread result cache */
+  guint32 cache_id;
 } GeoIPParser;
 
+/*
+ * Per-thread cache of lookup results.
+ *
+ * Traffic is usually dominated by a handful of source addresses, so the
+ * results of the most recent lookups are kept, including the misses.  The
+ * cache is set associative, the least recently used entry of a set is
+ * replaced.  Entries are tagged with the cache_id of the parser that made
+ * the lookup, as different parsers may use different databases.
+ */
+#define GEOIP_CACHE_SETS      64
+#define GEOIP_CACHE_WAYS      4
+#define GEOIP_CACHE_KEY_MAX   48
+
+typedef struct _GeoIPCacheEntry
+{
+  guint32 cache_id;
+  guint32 last_used;
+  gchar address[GEOIP_CACHE_KEY_MAX];
+  gchar country_code[8];
+  gchar latitude[24];
+  gchar longitude[24];
+  gboolean has_location;
+} GeoIPCacheEntry;
+
+TLS_BLOCK_START
+{
+  GeoIPCacheEntry geoip_cache[GEOIP_CACHE_SETS][GEOIP_CACHE_WAYS];
+  guint32 geoip_cache_clock;
+}
+TLS_BLOCK_END;
+
+#define geoip_cache        __tls_deref(geoip_cache)
+#define geoip_cache_clock  __tls_deref(geoip_cache_clock)
+
+static gint geoip_parser_last_cache_id;
+
 void
 geoip_parser_set_prefix(LogParser *s, const gchar *prefix)
 {
@@ -63,6 +110,10 @@ geoip_parser_reset_fields(GeoIPParser *self)
 
   g_free(self->dest.latitude);
   self->dest.latitude = g_strdup_printf("%slatitude", self->prefix);
+
+  self->handles.country_code = log_msg_get_value_handle(self->dest.country_code);
+  self->handles.longitude = log_msg_get_value_handle(self->dest.longitude);
+  self->handles.latitude = log_msg_get_value_handle(self->dest.latitude);
 }
 
 void
@@ -74,6 +125,72 @@ geoip_parser_set_database(LogParser *s, const gchar *database)
   self->database = g_strdup(database);
 }
 
+static void
+geoip_parser_lookup(GeoIPParser *self, const gchar *input, GeoIPCacheEntry *result)
+{
+  GeoIPRecord *record;
+  const gchar *country;
+
+  result->country_code[0] = 0;
+  result->has_location = FALSE;
+
+  record = GeoIP_record_by_name(self->gi, input);
+  if (!record)
+    {
+      country = GeoIP_country_code_by_name(self->gi, input);
+      if (country)
+        g_strlcpy(result->country_code, country, sizeof(result->country_code));
+      return;
+    }
+
+  if (record->country_code)
+    g_strlcpy(result->country_code, record->country_code, sizeof(result->country_code));
+  g_snprintf(result->latitude, sizeof(result->latitude), "%f", record->latitude);
+  g_snprintf(result->longitude, sizeof(result->longitude), "%f", record->longitude);
+  result->has_location = TRUE;
+  GeoIPRecord_delete(record);
+}
+
+static guint
+geoip_parser_hash_address(const gchar *input, gsize input_len)
+{
+  guint hash = 2166136261U;
+  gsize i;
+
+  for (i = 0; i < input_len; i++)
+    hash = (hash ^ (guchar) input[i]) * 16777619U;
+  return hash;
+}
+
+static const GeoIPCacheEntry *
+geoip_parser_lookup_cached(GeoIPParser *self, const gchar *input, gsize input_len)
+{
+  GeoIPCacheEntry *set, *victim;
+  gint i;
+
+  set = geoip_cache[geoip_parser_hash_address(input, input_len) % GEOIP_CACHE_SETS];
+  victim = &set[0];
+  for (i = 0; i < GEOIP_CACHE_WAYS; i++)
+    {
+      GeoIPCacheEntry *entry = &set[i];
+
+      if (entry->cache_id == self->cache_id &&
+          strncmp(entry->address, input, sizeof(entry->address)) == 0)
+        {
+          entry->last_used = ++geoip_cache_clock;
+          return entry;
+        }
+      if (entry->last_used < victim->last_used)
+        victim = entry;
+    }
+
+  geoip_parser_lookup(self, input, victim);
+  memcpy(victim->address, input, input_len + 1);
+  victim->cache_id = self->cache_id;
+  victim->last_used = ++geoip_cache_clock;
+  return victim;
+}
+
 static gboolean
 geoip_parser_process(LogParser *s, LogMessage **pmsg,
                      const LogPathOptions *path_options,
@@ -81,51 +198,36 @@ geoip_parser_process(LogParser *s, LogMessage **pmsg,
 {
   GeoIPParser *self = (GeoIPParser *) s;
   LogMessage *msg = log_msg_make_writable(pmsg, path_options);
-  GeoIPRecord *record;
-  SBGString *value;
+  const GeoIPCacheEntry *result;
+  GeoIPCacheEntry uncached;
 
   if (!self->dest.country_code &&
       !self->dest.latitude &&
       !self->dest.longitude)
     return TRUE;
 
-  record = GeoIP_record_by_name(self->gi, input);
-
-  if (!record)
+  APPEND_ZERO(input, input, input_len);
+  if (input_len < GEOIP_CACHE_KEY_MAX)
     {
-      const char *country;
-
-      country = GeoIP_country_code_by_name(self->gi, input);
-      if (country)
-        log_msg_set_value_by_name(msg, self->dest.country_code,
-                                  country,
-                                  strlen(country));
-
-      return TRUE;
+      result = geoip_parser_lookup_cached(self, input, input_len);
+    }
+  else
+    {
+      geoip_parser_lookup(self, input, &uncached);
+      result = &uncached;
     }
 
-  if (record->country_code)
-    log_msg_set_value_by_name(msg, self->dest.country_code,
-                              record->country_code,
-                              strlen(record->country_code));
-
-  value = sb_gstring_acquire();
-
-  g_string_printf(sb_gstring_string(value), "%f",
-                  record->latitude);
-  log_msg_set_value_by_name(msg, self->dest.latitude,
-                            sb_gstring_string(value)->str,
-                            sb_gstring_string(value)->len);
-
-  g_string_printf(sb_gstring_string(value), "%f",
-                  record->longitude);
-  log_msg_set_value_by_name(msg, self->dest.longitude,
-                            sb_gstring_string(value)->str,
-                            sb_gstring_string(value)->len);
+  if (result->country_code[0])
+    log_parser_set_value(s, msg, self->handles.country_code,
+                         result->country_code, -1);
 
-  GeoIPRecord_delete(record);
-  sb_gstring_release(value);
+  if (!result->has_location)
+    return TRUE;
 
+  log_parser_set_value(s, msg, self->handles.latitude,
+                       result->latitude, -1);
+  log_parser_set_value(s, msg, self->handles.longitude,
+                       result->longitude, -1);
   return TRUE;
 }
 
@@ -155,7 +257,8 @@ geoip_parser_free(LogPipe *s)
   g_free(self->database);
   g_free(self->prefix);
 
-  GeoIP_delete(self->gi);
+  if (self->gi)
+    GeoIP_delete(self->gi);
 
   log_parser_free_method(s);
 }
@@ -167,10 +270,15 @@ geoip_parser_init(LogPipe *s)
 
   geoip_parser_reset_fields(self);
 
+  if (self->gi)
+    GeoIP_delete(self->gi);
   self->gi = GeoIP_open(self->database, GEOIP_MMAP_CACHE);
 
   if (!self->gi)
     return FALSE;
+
+  /* a new database may have been opened, start over with the cache */
+  self->cache_id = g_atomic_int_exchange_and_add(&geoip_parser_last_cache_id, 1) + 1;
   return log_parser_init_method(s);
 }
 
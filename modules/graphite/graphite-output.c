@@ -26,10 +26,49 @@
 #include "value-pairs/value-pairs.h"
 #include "value-pairs/cmdline.h"
 
+#include <stdlib.h>
+#include <string.h>
+
+enum
+{
+  TF_GRAPHITE_AGGREGATE_NONE,
+  TF_GRAPHITE_AGGREGATE_SUM,
+  TF_GRAPHITE_AGGREGATE_COUNT,
+  TF_GRAPHITE_AGGREGATE_LAST,
+  TF_GRAPHITE_AGGREGATE_MIN,
+  TF_GRAPHITE_AGGREGATE_MAX,
+};
+
+#define TF_GRAPHITE_AGGREGATE_INTERVAL_DEFAULT 60
+
+typedef struct _TFGraphiteMetric
+{
+  gchar *name;
+  gdouble value;
+  guint64 count;
+} TFGraphiteMetric;
+
 typedef struct _TFGraphiteState
 {
   ValuePairs *vp;
   LogTemplate *timestamp_template;
+
+  /*
+   * With --aggregate, the values of each metric are aggregated over
+   * --interval seconds long windows (based on the timestamp) and nothing
+   * is returned until a message of a later window arrives, which returns
+   * the lines of the finished window, one per metric.
+   */
+  struct
+  {
+    gint function;
+    gint interval;
+    GStaticMutex lock;
+    glong window;
+    GHashTable *index;
+    /* TFGraphiteMetric, in the order of their first appearance */
+    GQueue metrics;
+  } aggregate;
 } TFGraphiteState;
 
 typedef struct _TFGraphiteArgumentsUserData
@@ -50,16 +89,39 @@ tf_graphite_set_timestamp(const gchar *option_name, const gchar *value,
 };
 
 static gboolean
-tf_graphite_parse_command_line_arguments(TFGraphiteState *self, gint *argc, gchar ***argv, LogTemplate *parent)
+tf_graphite_set_aggregate(const gchar *option_name, const gchar *value,
+                          gpointer data, GError **error)
+{
+  TFGraphiteArgumentsUserData *args = (TFGraphiteArgumentsUserData *) data;
+  static const gchar *functions[] = { "sum", "count", "last", "min", "max", NULL };
+  gint i;
+
+  for (i = 0; functions[i]; i++)
+    {
+      if (strcmp(value, functions[i]) == 0)
+        {
+          args->state->aggregate.function = TF_GRAPHITE_AGGREGATE_SUM + i;
+          return TRUE;
+        }
+    }
+
+  g_set_error(error, LOG_TEMPLATE_ERROR, LOG_TEMPLATE_ERROR_COMPILE,
+              "graphite-output: unknown aggregate function: %s, expected sum, count, last, min or max", value);
+  return FALSE;
+}
+
+static gboolean
+tf_graphite_parse_command_line_arguments(TFGraphiteState *self, gint *argc, gchar ***argv, LogTemplate *parent, GError **error)
 {
   GOptionContext *ctx;
   GOptionGroup *og; 
   TFGraphiteArgumentsUserData userdata;
   gboolean success;
-  GError *error = NULL;
 
   GOptionEntry graphite_options[] = {
      { "timestamp", 't', 0, G_OPTION_ARG_CALLBACK, tf_graphite_set_timestamp, NULL, NULL }, 
+     { "aggregate", 'a', 0, G_OPTION_ARG_CALLBACK, tf_graphite_set_aggregate, NULL, NULL },
+     { "interval", 'i', 0, G_OPTION_ARG_INT, &self->aggregate.interval, NULL, NULL },
      { NULL },
   };
 
@@ -72,7 +134,7 @@ tf_graphite_parse_command_line_arguments(TFGraphiteState *self, gint *argc, gcha
   g_option_context_set_main_group(ctx, og); 
   g_option_context_set_ignore_unknown_options(ctx, TRUE);
 
-  success = g_option_context_parse (ctx, argc, argv, &error);
+  success = g_option_context_parse (ctx, argc, argv, error);
   g_option_context_free (ctx);
 
   return success;
@@ -86,9 +148,25 @@ tf_graphite_prepare(LogTemplateFunction *self, gpointer s, LogTemplate *parent,
   TFGraphiteState *state = (TFGraphiteState *)s;
   ValuePairsTransformSet *vpts;
 
-  if (!tf_graphite_parse_command_line_arguments(state, &argc, &argv, parent))
+  state->aggregate.interval = TF_GRAPHITE_AGGREGATE_INTERVAL_DEFAULT;
+  if (!tf_graphite_parse_command_line_arguments(state, &argc, &argv, parent, error))
     return FALSE;
 
+  if (state->aggregate.interval <= 0)
+    {
+      g_set_error(error, LOG_TEMPLATE_ERROR, LOG_TEMPLATE_ERROR_COMPILE,
+                  "graphite-output: --interval must be positive");
+      return FALSE;
+    }
+
+  if (state->aggregate.function != TF_GRAPHITE_AGGREGATE_NONE)
+    {
+      g_static_mutex_init(&state->aggregate.lock);
+      state->aggregate.window = -1;
+      state->aggregate.index = g_hash_table_new(g_str_hash, g_str_equal);
+      g_queue_init(&state->aggregate.metrics);
+    }
+
   if (!state->timestamp_template)
    {
      state->timestamp_template = log_template_new(parent->cfg, "graphite_timestamp_template");
@@ -146,6 +224,129 @@ tf_graphite_format(GString *result, ValuePairs *vp, LogMessage *msg, const LogTe
   return return_value;
 }
 
+/*
+ * Aggregation
+ */
+
+static void
+tf_graphite_metric_free(TFGraphiteMetric *metric)
+{
+  g_free(metric->name);
+  g_free(metric);
+}
+
+static gboolean
+tf_graphite_metric_remove(gpointer key, gpointer value, gpointer user_data)
+{
+  return TRUE;
+}
+
+static void
+tf_graphite_aggregate_update(TFGraphiteState *state, TFGraphiteMetric *metric, gdouble value)
+{
+  switch (state->aggregate.function)
+    {
+    case TF_GRAPHITE_AGGREGATE_SUM:
+      metric->value += value;
+      break;
+    case TF_GRAPHITE_AGGREGATE_MIN:
+      if (metric->count == 0 || value < metric->value)
+        metric->value = value;
+      break;
+    case TF_GRAPHITE_AGGREGATE_MAX:
+      if (metric->count == 0 || value > metric->value)
+        metric->value = value;
+      break;
+    case TF_GRAPHITE_AGGREGATE_LAST:
+      metric->value = value;
+      break;
+    default:
+      break;
+    }
+  metric->count++;
+}
+
+/* TODO escape '\0' when passing down the value */
+static gboolean
+tf_graphite_aggregate_foreach_func(const gchar *name, TypeHint type, const gchar *value,
+                                   gsize value_len, gpointer user_data)
+{
+  TFGraphiteState *state = (TFGraphiteState *) user_data;
+  TFGraphiteMetric *metric;
+  gdouble d;
+  gchar *endptr;
+
+  d = g_ascii_strtod(value, &endptr);
+  if (endptr == value)
+    {
+      /* count() does not need the value to be a number */
+      if (state->aggregate.function != TF_GRAPHITE_AGGREGATE_COUNT)
+        return FALSE;
+      d = 0;
+    }
+
+  metric = g_hash_table_lookup(state->aggregate.index, name);
+  if (!metric)
+    {
+      metric = g_new0(TFGraphiteMetric, 1);
+      metric->name = g_strdup(name);
+      g_hash_table_insert(state->aggregate.index, metric->name, metric);
+      g_queue_push_tail(&state->aggregate.metrics, metric);
+    }
+  tf_graphite_aggregate_update(state, metric, d);
+  return FALSE;
+}
+
+static void
+tf_graphite_aggregate_flush(TFGraphiteState *state, GString *result)
+{
+  TFGraphiteMetric *metric;
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+
+  while ((metric = g_queue_pop_head(&state->aggregate.metrics)))
+    {
+      g_string_append(result, metric->name);
+      g_string_append_c(result, ' ');
+      if (state->aggregate.function == TF_GRAPHITE_AGGREGATE_COUNT)
+        g_string_append_printf(result, "%" G_GUINT64_FORMAT, metric->count);
+      else
+        g_string_append(result, g_ascii_dtostr(buf, sizeof(buf), metric->value));
+      g_string_append_printf(result, " %ld\n", state->aggregate.window);
+      tf_graphite_metric_free(metric);
+    }
+  g_hash_table_foreach_remove(state->aggregate.index, (GHRFunc) tf_graphite_metric_remove, NULL);
+}
+
+static gboolean
+tf_graphite_aggregate(TFGraphiteState *state, GString *result, LogMessage *msg,
+                      const LogTemplateOptions *template_options, gint time_zone_mode)
+{
+  GString *formatted_unixtime = g_string_sized_new(16);
+  gboolean return_value;
+  glong window;
+
+  log_template_format(state->timestamp_template, msg, NULL, 0, 0, NULL, formatted_unixtime);
+  window = strtol(formatted_unixtime->str, NULL, 10);
+  window -= window % state->aggregate.interval;
+  g_string_free(formatted_unixtime, TRUE);
+
+  g_static_mutex_lock(&state->aggregate.lock);
+
+  /* late messages are counted into the current window */
+  if (window > state->aggregate.window)
+    {
+      if (state->aggregate.window >= 0)
+        tf_graphite_aggregate_flush(state, result);
+      state->aggregate.window = window;
+    }
+
+  return_value = value_pairs_foreach(state->vp, tf_graphite_aggregate_foreach_func, msg, 0,
+                                     time_zone_mode, template_options, state);
+
+  g_static_mutex_unlock(&state->aggregate.lock);
+  return return_value;
+}
+
 static void
 tf_graphite_call(LogTemplateFunction *self, gpointer s,
        const LogTemplateInvokeArgs *args, GString *result)
@@ -155,6 +356,13 @@ tf_graphite_call(LogTemplateFunction *self, gpointer s,
   gboolean r = TRUE;
   gsize orig_size = result->len;
 
+  if (state->aggregate.function != TF_GRAPHITE_AGGREGATE_NONE)
+    {
+      for (i = 0; i < args->num_messages; i++)
+        tf_graphite_aggregate(state, result, args->messages[i], args->opts, args->tz);
+      return;
+    }
+
   for (i = 0; i < args->num_messages; i++)
     r &= tf_graphite_format(result, state->vp, args->messages[i], args->opts, state->timestamp_template, args->tz);
 
@@ -169,6 +377,16 @@ tf_graphite_free_state(gpointer s)
 
   value_pairs_unref(state->vp);
   log_template_unref(state->timestamp_template);
+
+  if (state->aggregate.index)
+    {
+      TFGraphiteMetric *metric;
+
+      while ((metric = g_queue_pop_head(&state->aggregate.metrics)))
+        tf_graphite_metric_free(metric);
+      g_hash_table_destroy(state->aggregate.index);
+      g_static_mutex_free(&state->aggregate.lock);
+    }
 }
 
 TEMPLATE_FUNCTION(TFGraphiteState, tf_graphite, tf_graphite_prepare, NULL, tf_graphite_call,
@@ -0,0 +1,640 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "http.h"
+#include "http-parser.h"
+#include "plugin.h"
+#include "messages.h"
+#include "stats/stats-registry.h"
+#include "logqueue.h"
+#include "plugin-types.h"
+#include "logthrdestdrv.h"
+#include "string-list.h"
+
+#include <curl/curl.h>
+#include <string.h>
+
+#if SYSLOG_NG_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+/*
+ * HTTP destination
+ *
+ * Every worker has its own curl handle, which keeps its connection open
+ * between requests, so workers() is the size of the connection pool.
+ * The messages of a batch (batch-lines(), batch-timeout()) are sent in the
+ * body of a single request: the body-prefix() of the first message, the
+ * body() of each message separated by delimiter(), then the body-suffix()
+ * of the last one.
+ */
+
+#define HTTP_RESPONSE_ACTION_DEFAULT 0
+
+/* the connection and the request being built of each worker thread */
+typedef struct
+{
+  CURL *curl;
+  gchar error[CURL_ERROR_SIZE];
+
+  GString *body;
+  GString *compressed;
+  gint num_messages;
+  /* the body-suffix() is formatted on the last message of the batch */
+  LogMessage *last_msg;
+} HTTPWorker;
+
+typedef struct
+{
+  LogThrDestDriver super;
+
+  gchar *url;
+  gchar *method;
+  GList *headers;
+  gchar *user;
+  gchar *password;
+  gchar *user_agent;
+  gchar *ca_file;
+  gboolean peer_verify;
+  glong timeout;
+  glong http_version;
+  gboolean compression;
+
+  LogTemplate *body_template;
+  LogTemplate *body_prefix_template;
+  LogTemplate *body_suffix_template;
+  gchar *delimiter;
+
+  /* status code -> worker_insert_result_t + 1 */
+  GHashTable *response_actions;
+
+  LogTemplateOptions template_options;
+
+  /* built by init(), only read by the workers */
+  struct curl_slist *header_list;
+} HTTPDestDriver;
+
+/*
+ * Configuration
+ */
+
+void
+http_dd_set_url(LogDriver *d, const gchar *url)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  g_free(self->url);
+  self->url = g_strdup(url);
+}
+
+void
+http_dd_set_method(LogDriver *d, const gchar *method)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  g_free(self->method);
+  self->method = g_ascii_strup(method, -1);
+}
+
+void
+http_dd_set_headers(LogDriver *d, GList *headers)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  string_list_free(self->headers);
+  self->headers = headers;
+}
+
+void
+http_dd_set_user(LogDriver *d, const gchar *user)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  g_free(self->user);
+  self->user = g_strdup(user);
+}
+
+void
+http_dd_set_password(LogDriver *d, const gchar *password)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  g_free(self->password);
+  self->password = g_strdup(password);
+}
+
+void
+http_dd_set_user_agent(LogDriver *d, const gchar *user_agent)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  g_free(self->user_agent);
+  self->user_agent = g_strdup(user_agent);
+}
+
+void
+http_dd_set_ca_file(LogDriver *d, const gchar *ca_file)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  g_free(self->ca_file);
+  self->ca_file = g_strdup(ca_file);
+}
+
+void
+http_dd_set_peer_verify(LogDriver *d, gboolean verify)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  self->peer_verify = verify;
+}
+
+void
+http_dd_set_timeout(LogDriver *d, glong timeout)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  self->timeout = timeout;
+}
+
+gboolean
+http_dd_set_http_version(LogDriver *d, const gchar *version)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  if (strcmp(version, "1.0") == 0)
+    self->http_version = CURL_HTTP_VERSION_1_0;
+  else if (strcmp(version, "1.1") == 0)
+    self->http_version = CURL_HTTP_VERSION_1_1;
+#ifdef CURL_HTTP_VERSION_2_0
+  else if (strcmp(version, "2") == 0 || strcmp(version, "2.0") == 0)
+    self->http_version = CURL_HTTP_VERSION_2_0;
+#endif
+  else
+    return FALSE;
+  return TRUE;
+}
+
+gboolean
+http_dd_set_compression(LogDriver *d, gboolean compress)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+#if SYSLOG_NG_HAVE_ZLIB
+  self->compression = compress;
+  return TRUE;
+#else
+  self->compression = FALSE;
+  return !compress;
+#endif
+}
+
+void
+http_dd_set_body(LogDriver *d, LogTemplate *body)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  log_template_unref(self->body_template);
+  self->body_template = log_template_ref(body);
+}
+
+void
+http_dd_set_body_prefix(LogDriver *d, LogTemplate *prefix)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  log_template_unref(self->body_prefix_template);
+  self->body_prefix_template = log_template_ref(prefix);
+}
+
+void
+http_dd_set_body_suffix(LogDriver *d, LogTemplate *suffix)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  log_template_unref(self->body_suffix_template);
+  self->body_suffix_template = log_template_ref(suffix);
+}
+
+void
+http_dd_set_delimiter(LogDriver *d, const gchar *delimiter)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  g_free(self->delimiter);
+  self->delimiter = g_strdup(delimiter);
+}
+
+gboolean
+http_dd_add_response_action(LogDriver *d, gint status_code, const gchar *action)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+  worker_insert_result_t result;
+
+  if (strcmp(action, "success") == 0)
+    result = WORKER_INSERT_RESULT_SUCCESS;
+  else if (strcmp(action, "retry") == 0)
+    result = WORKER_INSERT_RESULT_ERROR;
+  else if (strcmp(action, "drop") == 0)
+    result = WORKER_INSERT_RESULT_DROP;
+  else
+    return FALSE;
+
+  g_hash_table_insert(self->response_actions, GINT_TO_POINTER(status_code), GINT_TO_POINTER(result + 1));
+  return TRUE;
+}
+
+LogTemplateOptions *
+http_dd_get_template_options(LogDriver *d)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  return &self->template_options;
+}
+
+/*
+ * Utilities
+ */
+
+static gchar *
+http_dd_format_stats_instance(LogThrDestDriver *d)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+  static gchar persist_name[1024];
+
+  g_snprintf(persist_name, sizeof(persist_name),
+             "http,%s", self->url);
+  return persist_name;
+}
+
+static gchar *
+http_dd_format_persist_name(LogThrDestDriver *d)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+  static gchar persist_name[1024];
+
+  g_snprintf(persist_name, sizeof(persist_name),
+             "http(%s)", self->url);
+  return persist_name;
+}
+
+static HTTPWorker *
+http_dd_get_worker(HTTPDestDriver *self)
+{
+  return (HTTPWorker *) log_threaded_dest_driver_get_worker(&self->super)->data;
+}
+
+/*
+ * Worker thread
+ */
+
+static size_t
+_discard_response(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+  return size * nmemb;
+}
+
+static void
+_setup_curl(HTTPDestDriver *self, HTTPWorker *worker)
+{
+  CURL *curl = worker->curl;
+
+  curl_easy_setopt(curl, CURLOPT_URL, self->url);
+  curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, self->method);
+  curl_easy_setopt(curl, CURLOPT_HTTPHEADER, self->header_list);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, _discard_response);
+  curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, worker->error);
+  curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, self->http_version);
+#ifdef CURLOPT_TCP_KEEPALIVE
+  curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+#endif
+
+  if (self->user)
+    curl_easy_setopt(curl, CURLOPT_USERNAME, self->user);
+  if (self->password)
+    curl_easy_setopt(curl, CURLOPT_PASSWORD, self->password);
+  if (self->user_agent)
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, self->user_agent);
+  if (self->ca_file)
+    curl_easy_setopt(curl, CURLOPT_CAINFO, self->ca_file);
+  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, self->peer_verify ? 1L : 0L);
+  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, self->peer_verify ? 2L : 0L);
+  if (self->timeout)
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, self->timeout);
+}
+
+static void
+_batch_clear(HTTPWorker *worker)
+{
+  g_string_truncate(worker->body, 0);
+  worker->num_messages = 0;
+  if (worker->last_msg)
+    log_msg_unref(worker->last_msg);
+  worker->last_msg = NULL;
+}
+
+#if SYSLOG_NG_HAVE_ZLIB
+
+static gboolean
+_compress_body(HTTPDestDriver *self, HTTPWorker *worker)
+{
+  z_stream stream;
+  gint rc;
+
+  memset(&stream, 0, sizeof(stream));
+  /* 16 + MAX_WBITS: gzip header and trailer instead of zlib ones */
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    return FALSE;
+
+  g_string_set_size(worker->compressed, deflateBound(&stream, worker->body->len));
+  stream.next_in = (Bytef *) worker->body->str;
+  stream.avail_in = worker->body->len;
+  stream.next_out = (Bytef *) worker->compressed->str;
+  stream.avail_out = worker->compressed->len;
+
+  rc = deflate(&stream, Z_FINISH);
+  g_string_set_size(worker->compressed, stream.total_out);
+  deflateEnd(&stream);
+
+  if (rc != Z_STREAM_END)
+    {
+      msg_error("Error compressing HTTP request body",
+                evt_tag_str("driver", self->super.super.super.id),
+                evt_tag_str("error", stream.msg ? stream.msg : zError(rc)),
+                NULL);
+      return FALSE;
+    }
+  return TRUE;
+}
+
+#endif
+
+static worker_insert_result_t
+_map_status_code(HTTPDestDriver *self, glong status_code)
+{
+  gint action = GPOINTER_TO_INT(g_hash_table_lookup(self->response_actions, GINT_TO_POINTER(status_code)));
+
+  if (action != HTTP_RESPONSE_ACTION_DEFAULT)
+    return (worker_insert_result_t) (action - 1);
+
+  if (status_code >= 200 && status_code < 300)
+    return WORKER_INSERT_RESULT_SUCCESS;
+
+  /* the server is busy or timed out, the same request may succeed later */
+  if (status_code == 408 || status_code == 429 || status_code >= 500)
+    return WORKER_INSERT_RESULT_ERROR;
+
+  return WORKER_INSERT_RESULT_DROP;
+}
+
+static worker_insert_result_t
+http_worker_insert(LogThrDestDriver *s, LogMessage *msg)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)s;
+  HTTPWorker *worker = http_dd_get_worker(self);
+
+  if (worker->num_messages == 0)
+    {
+      if (self->body_prefix_template)
+        log_template_append_format(self->body_prefix_template, msg, &self->template_options, LTZ_SEND,
+                                   self->super.seq_num, NULL, worker->body);
+    }
+  else
+    {
+      g_string_append(worker->body, self->delimiter);
+    }
+
+  log_template_append_format(self->body_template, msg, &self->template_options, LTZ_SEND,
+                             self->super.seq_num, NULL, worker->body);
+
+  if (worker->last_msg)
+    log_msg_unref(worker->last_msg);
+  worker->last_msg = log_msg_ref(msg);
+  worker->num_messages++;
+
+  return WORKER_INSERT_RESULT_QUEUED;
+}
+
+static worker_insert_result_t
+http_worker_flush(LogThrDestDriver *s)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)s;
+  HTTPWorker *worker = http_dd_get_worker(self);
+  worker_insert_result_t result;
+  GString *request_body = worker->body;
+  CURLcode rc;
+  glong status_code = 0;
+
+  if (worker->num_messages == 0)
+    return WORKER_INSERT_RESULT_SUCCESS;
+
+  if (self->body_suffix_template)
+    log_template_append_format(self->body_suffix_template, worker->last_msg, &self->template_options, LTZ_SEND,
+                               self->super.seq_num, NULL, worker->body);
+
+#if SYSLOG_NG_HAVE_ZLIB
+  if (self->compression)
+    {
+      if (!_compress_body(self, worker))
+        {
+          _batch_clear(worker);
+          return WORKER_INSERT_RESULT_DROP;
+        }
+      request_body = worker->compressed;
+    }
+#endif
+
+  curl_easy_setopt(worker->curl, CURLOPT_POSTFIELDS, request_body->str);
+  curl_easy_setopt(worker->curl, CURLOPT_POSTFIELDSIZE, (long) request_body->len);
+
+  rc = curl_easy_perform(worker->curl);
+  if (rc != CURLE_OK)
+    {
+      msg_error("Error sending HTTP request",
+                evt_tag_str("driver", self->super.super.super.id),
+                evt_tag_str("url", self->url),
+                evt_tag_str("error", worker->error[0] ? worker->error : curl_easy_strerror(rc)),
+                evt_tag_int("batch_size", worker->num_messages),
+                evt_tag_int("time_reopen", self->super.time_reopen),
+                NULL);
+      _batch_clear(worker);
+      return WORKER_INSERT_RESULT_NOT_CONNECTED;
+    }
+
+  curl_easy_getinfo(worker->curl, CURLINFO_RESPONSE_CODE, &status_code);
+  result = _map_status_code(self, status_code);
+  if (result != WORKER_INSERT_RESULT_SUCCESS)
+    msg_error(result == WORKER_INSERT_RESULT_DROP
+              ? "HTTP request rejected by the server, dropping the batch"
+              : "HTTP request failed, retrying the batch",
+              evt_tag_str("driver", self->super.super.super.id),
+              evt_tag_str("url", self->url),
+              evt_tag_int("status_code", status_code),
+              evt_tag_int("batch_size", worker->num_messages),
+              NULL);
+  else
+    msg_debug("HTTP request sent",
+              evt_tag_str("driver", self->super.super.super.id),
+              evt_tag_int("status_code", status_code),
+              evt_tag_int("batch_size", worker->num_messages),
+              NULL);
+
+  _batch_clear(worker);
+  return result;
+}
+
+static void
+http_worker_thread_init(LogThrDestDriver *d)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+  HTTPWorker *worker = g_new0(HTTPWorker, 1);
+
+  worker->curl = curl_easy_init();
+  worker->body = g_string_sized_new(4096);
+  worker->compressed = g_string_sized_new(0);
+  log_threaded_dest_driver_get_worker(d)->data = worker;
+
+  _setup_curl(self, worker);
+}
+
+static void
+http_worker_thread_deinit(LogThrDestDriver *d)
+{
+  LogThrDestWorker *thr_worker = log_threaded_dest_driver_get_worker(d);
+  HTTPWorker *worker = (HTTPWorker *) thr_worker->data;
+
+  _batch_clear(worker);
+  curl_easy_cleanup(worker->curl);
+  g_string_free(worker->body, TRUE);
+  g_string_free(worker->compressed, TRUE);
+  g_free(worker);
+  thr_worker->data = NULL;
+}
+
+/*
+ * Main thread
+ */
+
+static void
+_build_header_list(HTTPDestDriver *self)
+{
+  GList *l;
+
+  curl_slist_free_all(self->header_list);
+  self->header_list = NULL;
+
+  for (l = self->headers; l; l = l->next)
+    self->header_list = curl_slist_append(self->header_list, (const gchar *) l->data);
+
+  /* don't wait a round trip for "100 Continue" before sending the body */
+  self->header_list = curl_slist_append(self->header_list, "Expect:");
+  if (self->compression)
+    self->header_list = curl_slist_append(self->header_list, "Content-Encoding: gzip");
+}
+
+static gboolean
+http_dd_init(LogPipe *s)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)s;
+  GlobalConfig *cfg = log_pipe_get_config(s);
+
+  if (!log_dest_driver_init_method(s))
+    return FALSE;
+
+  log_template_options_init(&self->template_options, cfg);
+
+  if (!self->body_template)
+    {
+      self->body_template = log_template_new(cfg, NULL);
+      log_template_compile(self->body_template, "${MESSAGE}", NULL);
+    }
+
+  _build_header_list(self);
+
+  msg_verbose("Initializing HTTP destination",
+              evt_tag_str("driver", self->super.super.super.id),
+              evt_tag_str("url", self->url),
+              evt_tag_str("method", self->method),
+              NULL);
+
+  return log_threaded_dest_driver_start(s);
+}
+
+static void
+http_dd_free(LogPipe *d)
+{
+  HTTPDestDriver *self = (HTTPDestDriver *)d;
+
+  log_template_options_destroy(&self->template_options);
+
+  g_free(self->url);
+  g_free(self->method);
+  string_list_free(self->headers);
+  g_free(self->user);
+  g_free(self->password);
+  g_free(self->user_agent);
+  g_free(self->ca_file);
+  log_template_unref(self->body_template);
+  log_template_unref(self->body_prefix_template);
+  log_template_unref(self->body_suffix_template);
+  g_free(self->delimiter);
+  g_hash_table_destroy(self->response_actions);
+  curl_slist_free_all(self->header_list);
+
+  log_threaded_dest_driver_free(d);
+}
+
+/*
+ * Plugin glue.
+ */
+
+LogDriver *
+http_dd_new(GlobalConfig *cfg)
+{
+  HTTPDestDriver *self = g_new0(HTTPDestDriver, 1);
+
+  log_threaded_dest_driver_init_instance(&self->super, cfg);
+  self->super.super.super.super.init = http_dd_init;
+  self->super.super.super.super.free_fn = http_dd_free;
+
+  self->super.worker.multiple_workers_supported = TRUE;
+  self->super.worker.thread_init = http_worker_thread_init;
+  self->super.worker.thread_deinit = http_worker_thread_deinit;
+  self->super.worker.insert = http_worker_insert;
+  self->super.worker.flush = http_worker_flush;
+
+  self->super.format.stats_instance = http_dd_format_stats_instance;
+  self->super.format.persist_name = http_dd_format_persist_name;
+  self->super.stats_source = SCS_HTTP;
+
+  http_dd_set_url((LogDriver *)self, "http://localhost/");
+  http_dd_set_method((LogDriver *)self, "POST");
+  http_dd_set_delimiter((LogDriver *)self, "\n");
+  self->peer_verify = TRUE;
+  self->http_version = CURL_HTTP_VERSION_1_1;
+  self->response_actions = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+  log_template_options_defaults(&self->template_options);
+
+  return (LogDriver *)self;
+}
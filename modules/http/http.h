@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef SNG_HTTP_H_INCLUDED
+#define SNG_HTTP_H_INCLUDED
+
+#include "driver.h"
+
+LogDriver *http_dd_new(GlobalConfig *cfg);
+
+void http_dd_set_url(LogDriver *d, const gchar *url);
+void http_dd_set_method(LogDriver *d, const gchar *method);
+void http_dd_set_headers(LogDriver *d, GList *headers);
+void http_dd_set_user(LogDriver *d, const gchar *user);
+void http_dd_set_password(LogDriver *d, const gchar *password);
+void http_dd_set_user_agent(LogDriver *d, const gchar *user_agent);
+void http_dd_set_ca_file(LogDriver *d, const gchar *ca_file);
+void http_dd_set_peer_verify(LogDriver *d, gboolean verify);
+void http_dd_set_timeout(LogDriver *d, glong timeout);
+gboolean http_dd_set_http_version(LogDriver *d, const gchar *version);
+gboolean http_dd_set_compression(LogDriver *d, gboolean compress);
+void http_dd_set_body(LogDriver *d, LogTemplate *body);
+void http_dd_set_body_prefix(LogDriver *d, LogTemplate *prefix);
+void http_dd_set_body_suffix(LogDriver *d, LogTemplate *suffix);
+void http_dd_set_delimiter(LogDriver *d, const gchar *delimiter);
+gboolean http_dd_add_response_action(LogDriver *d, gint status_code, const gchar *action);
+LogTemplateOptions *http_dd_get_template_options(LogDriver *d);
+
+#endif
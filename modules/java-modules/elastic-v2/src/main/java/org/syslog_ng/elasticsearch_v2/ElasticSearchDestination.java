@@ -105,6 +105,19 @@ public class ElasticSearchDestination extends StructuredLogDestination {
 		return msgProcessor.send(createIndexRequest(msg));
 	}
 
+	@Override
+	protected int sendBatch(LogMessage[] msgs) {
+		if (!client.isOpened()) {
+			close();
+			return 0;
+		}
+
+		IndexRequest[] reqs = new IndexRequest[msgs.length];
+		for (int i = 0; i < msgs.length; i++)
+			reqs[i] = createIndexRequest(msgs[i]);
+		return msgProcessor.send(reqs);
+	}
+
 	@Override
 	protected void close() {
 		if (opened) {
@@ -70,6 +70,13 @@ public class ESBulkMessageProcessor extends ESMessageProcessor {
 		return true;
 	}
 
+	@Override
+	public int send(IndexRequest[] reqs) {
+		for (IndexRequest req : reqs)
+			bulkProcessor.add(req);
+		return reqs.length;
+	}
+
 	@Override
 	public void flush() {
 		bulkProcessor.flush();
@@ -54,4 +54,15 @@ public abstract class ESMessageProcessor {
 
 	public abstract boolean send(IndexRequest req);
 
+	/* returns the number of requests sent, counting from the first one */
+	public int send(IndexRequest[] reqs) {
+		int i;
+
+		for (i = 0; i < reqs.length; i++) {
+			if (!send(reqs[i]))
+				break;
+		}
+		return i;
+	}
+
 }
@@ -103,6 +103,8 @@ java_dd_set_template_string(LogDriver *s, const gchar *template_string)
   self->template_string = g_strdup(template_string);
 }
 
+static worker_insert_result_t java_worker_flush(LogThrDestDriver *s);
+
 gboolean
 java_dd_init(LogPipe *s)
 {
@@ -132,6 +134,8 @@ java_dd_init(LogPipe *s)
   if (!java_destination_proxy_init(self->proxy))
     return FALSE;
 
+  self->super.worker.flush = java_destination_proxy_supports_batch(self->proxy) ? java_worker_flush : NULL;
+
   return log_threaded_dest_driver_start(s);
 }
 
@@ -177,13 +181,40 @@ java_worker_insert(LogThrDestDriver *s, LogMessage *msg)
 
   if (!java_dd_open(s))
     {
+      /* the whole batch is rewound */
+      java_destination_proxy_batch_clear(self->proxy);
       return WORKER_INSERT_RESULT_NOT_CONNECTED;
     }
 
+  if (self->super.worker.flush)
+    {
+      java_destination_proxy_batch_add(self->proxy, msg);
+      return WORKER_INSERT_RESULT_QUEUED;
+    }
+
   gboolean sent = java_dd_send_to_object(self, msg);
   return sent ? WORKER_INSERT_RESULT_SUCCESS : WORKER_INSERT_RESULT_ERROR;
 }
 
+/*
+ * The batch is sent with one call into the JVM, the Java side reports how
+ * many messages it managed to send, the rest is rewound.
+ */
+static worker_insert_result_t
+java_worker_flush(LogThrDestDriver *s)
+{
+  JavaDestDriver *self = (JavaDestDriver *)s;
+  gint num_messages = java_destination_proxy_batch_get_length(self->proxy);
+  gint sent;
+
+  sent = java_destination_proxy_batch_send(self->proxy);
+  if (sent >= num_messages)
+    return WORKER_INSERT_RESULT_SUCCESS;
+
+  log_threaded_dest_driver_accept_batch_prefix(s, sent);
+  return WORKER_INSERT_RESULT_ERROR;
+}
+
 static void
 java_worker_message_queue_empty(LogThrDestDriver *d)
 {
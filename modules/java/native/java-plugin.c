@@ -31,6 +31,7 @@
 #include "logqueue.h"
 #include "driver.h"
 #include "plugin-types.h"
+#include "cfg.h"
 
 
 extern CfgParser java_parser;
@@ -48,6 +49,8 @@ gboolean
 java_module_init(GlobalConfig *cfg, CfgArgs *args)
 {
   plugin_register(cfg, java_plugins, G_N_ELEMENTS(java_plugins));
+  /* Java code may read any value of the messages it gets */
+  cfg_reference_all_values(cfg);
   return TRUE;
 }
 
@@ -27,6 +27,7 @@
 #include "java-logmsg-proxy.h"
 #include "java-class-loader.h"
 #include "messages.h"
+#include "logmsg/logmsg.h"
 #include <string.h>
 
 
@@ -38,6 +39,8 @@ typedef struct _JavaDestinationImpl
   jmethodID mi_deinit;
   jmethodID mi_send;
   jmethodID mi_send_msg;
+  jmethodID mi_send_batch;
+  jmethodID mi_send_msg_batch;
   jmethodID mi_open;
   jmethodID mi_close;
   jmethodID mi_is_opened;
@@ -54,8 +57,31 @@ struct _JavaDestinationProxy
   GString *formatted_message; 
   JavaLogMessageProxy *msg_builder;
   gchar *name_by_uniq_options;
+
+  /*
+   * Messages collected for the next sendBatchProxy() call: formatted
+   * messages are concatenated into buffer, offsets holds the start of
+   * each and the end of the last one; LogMessage references taken for
+   * structured destinations are in handles, they are released by Java.
+   */
+  struct
+  {
+    GString *buffer;
+    GArray *offsets;
+    GArray *handles;
+  } batch;
 };
 
+static jmethodID
+__get_optional_method(JNIEnv *java_env, jclass loaded_class, const gchar *name, const gchar *signature)
+{
+  jmethodID method = CALL_JAVA_FUNCTION(java_env, GetMethodID, loaded_class, name, signature);
+
+  if (!method)
+    CALL_JAVA_FUNCTION(java_env, ExceptionClear);
+  return method;
+}
+
 static gboolean
 __load_destination_object(JavaDestinationProxy *self, const gchar *class_name, const gchar *class_path, gpointer handle)
 {
@@ -92,8 +118,10 @@ __load_destination_object(JavaDestinationProxy *self, const gchar *class_name, c
       return FALSE;
   }
 
-  self->dest_impl.mi_send = CALL_JAVA_FUNCTION(java_env, GetMethodID, self->loaded_class, "sendProxy", "(Ljava/lang/String;)Z");
-  self->dest_impl.mi_send_msg = CALL_JAVA_FUNCTION(java_env, GetMethodID, self->loaded_class, "sendProxy", "(Lorg/syslog_ng/LogMessage;)Z");
+  self->dest_impl.mi_send = __get_optional_method(java_env, self->loaded_class, "sendProxy", "(Ljava/lang/String;)Z");
+  self->dest_impl.mi_send_msg = __get_optional_method(java_env, self->loaded_class, "sendProxy", "(Lorg/syslog_ng/LogMessage;)Z");
+  self->dest_impl.mi_send_batch = __get_optional_method(java_env, self->loaded_class, "sendBatchProxy", "(Ljava/nio/ByteBuffer;[II)I");
+  self->dest_impl.mi_send_msg_batch = __get_optional_method(java_env, self->loaded_class, "sendBatchProxy", "([JI)I");
 
   if (!self->dest_impl.mi_send_msg && !self->dest_impl.mi_send)
     {
@@ -182,6 +210,11 @@ java_destination_proxy_free(JavaDestinationProxy *self)
     {
       java_log_message_proxy_free(self->msg_builder);
     }
+  java_destination_proxy_batch_clear(self);
+  g_string_free(self->batch.buffer, TRUE);
+  g_array_free(self->batch.offsets, TRUE);
+  g_array_free(self->batch.handles, TRUE);
+
   java_machine_unref(self->java_machine);
   g_string_free(self->formatted_message, TRUE);
   g_free(self->name_by_uniq_options);
@@ -196,6 +229,10 @@ java_destination_proxy_new(const gchar *class_name, const gchar *class_path, gpo
   self->java_machine = java_machine_ref();
   self->formatted_message = g_string_sized_new(1024);
   self->template = log_template_ref(template);
+  self->batch.buffer = g_string_sized_new(4096);
+  self->batch.offsets = g_array_new(FALSE, FALSE, sizeof(jint));
+  self->batch.handles = g_array_new(FALSE, FALSE, sizeof(jlong));
+  java_destination_proxy_batch_clear(self);
 
   if (!java_machine_start(self->java_machine))
       goto error;
@@ -255,6 +292,124 @@ java_destination_proxy_send(JavaDestinationProxy *self, LogMessage *msg)
     }
 }
 
+/*
+ * Batches are passed to Java in a single call: formatted messages as a
+ * direct ByteBuffer over our buffer plus an offsets array, LogMessages as
+ * an array of handles wrapped into LogMessage objects on the Java side.
+ */
+gboolean
+java_destination_proxy_supports_batch(JavaDestinationProxy *self)
+{
+  if (self->dest_impl.mi_send_msg != 0)
+    return self->dest_impl.mi_send_msg_batch != 0;
+  return self->dest_impl.mi_send_batch != 0;
+}
+
+void
+java_destination_proxy_batch_add(JavaDestinationProxy *self, LogMessage *msg)
+{
+  jint end;
+
+  if (self->dest_impl.mi_send_msg != 0)
+    {
+      jlong handle = (jlong) log_msg_ref(msg);
+
+      g_array_append_val(self->batch.handles, handle);
+      return;
+    }
+
+  log_template_append_format(self->template, msg, NULL, LTZ_LOCAL, 0, NULL, self->batch.buffer);
+  end = self->batch.buffer->len;
+  g_array_append_val(self->batch.offsets, end);
+}
+
+guint
+java_destination_proxy_batch_get_length(JavaDestinationProxy *self)
+{
+  if (self->dest_impl.mi_send_msg != 0)
+    return self->batch.handles->len;
+  return self->batch.offsets->len - 1;
+}
+
+void
+java_destination_proxy_batch_clear(JavaDestinationProxy *self)
+{
+  jint start = 0;
+  guint i;
+
+  for (i = 0; i < self->batch.handles->len; i++)
+    log_msg_unref((LogMessage *) g_array_index(self->batch.handles, jlong, i));
+  g_array_set_size(self->batch.handles, 0);
+
+  g_string_truncate(self->batch.buffer, 0);
+  g_array_set_size(self->batch.offsets, 0);
+  g_array_append_val(self->batch.offsets, start);
+}
+
+static gint
+__send_native_batch(JavaDestinationProxy *self, JNIEnv *env)
+{
+  jint count = self->batch.handles->len;
+  jlongArray handles;
+  jint sent;
+
+  handles = CALL_JAVA_FUNCTION(env, NewLongArray, count);
+  if (!handles)
+    return 0;
+  CALL_JAVA_FUNCTION(env, SetLongArrayRegion, handles, 0, count, (jlong *) self->batch.handles->data);
+
+  sent = CALL_JAVA_FUNCTION(env, CallIntMethod, self->dest_impl.dest_object, self->dest_impl.mi_send_msg_batch,
+                            handles, count);
+
+  /* the references are released by Java, whatever the result */
+  g_array_set_size(self->batch.handles, 0);
+  CALL_JAVA_FUNCTION(env, DeleteLocalRef, handles);
+  return sent;
+}
+
+static gint
+__send_formatted_batch(JavaDestinationProxy *self, JNIEnv *env)
+{
+  jint count = self->batch.offsets->len - 1;
+  jobject buffer;
+  jintArray offsets;
+  jint sent = 0;
+
+  buffer = CALL_JAVA_FUNCTION(env, NewDirectByteBuffer, self->batch.buffer->str, self->batch.buffer->len);
+  offsets = CALL_JAVA_FUNCTION(env, NewIntArray, count + 1);
+  if (buffer && offsets)
+    {
+      CALL_JAVA_FUNCTION(env, SetIntArrayRegion, offsets, 0, count + 1, (jint *) self->batch.offsets->data);
+      sent = CALL_JAVA_FUNCTION(env, CallIntMethod, self->dest_impl.dest_object, self->dest_impl.mi_send_batch,
+                                buffer, offsets, count);
+    }
+
+  if (buffer)
+    CALL_JAVA_FUNCTION(env, DeleteLocalRef, buffer);
+  if (offsets)
+    CALL_JAVA_FUNCTION(env, DeleteLocalRef, offsets);
+  return sent;
+}
+
+/* returns the number of messages sent from the start of the batch, the batch is cleared */
+gint
+java_destination_proxy_batch_send(JavaDestinationProxy *self)
+{
+  JNIEnv *env = java_machine_get_env(self->java_machine, &env);
+  gint sent;
+
+  if (java_destination_proxy_batch_get_length(self) == 0)
+    return 0;
+
+  if (self->dest_impl.mi_send_msg != 0)
+    sent = __send_native_batch(self, env);
+  else
+    sent = __send_formatted_batch(self, env);
+
+  java_destination_proxy_batch_clear(self);
+  return sent;
+}
+
 gchar *
 java_destination_proxy_get_name_by_uniq_options(JavaDestinationProxy *self)
 {
@@ -40,6 +40,12 @@ void java_destination_proxy_deinit(JavaDestinationProxy *self);
 void java_destination_proxy_on_message_queue_empty(JavaDestinationProxy *self);
 gchar *java_destination_proxy_get_name_by_uniq_options(JavaDestinationProxy *self);
 gboolean java_destination_proxy_send(JavaDestinationProxy *self, LogMessage *msg);
+
+gboolean java_destination_proxy_supports_batch(JavaDestinationProxy *self);
+void java_destination_proxy_batch_add(JavaDestinationProxy *self, LogMessage *msg);
+guint java_destination_proxy_batch_get_length(JavaDestinationProxy *self);
+void java_destination_proxy_batch_clear(JavaDestinationProxy *self);
+gint java_destination_proxy_batch_send(JavaDestinationProxy *self);
 gboolean java_destination_proxy_open(JavaDestinationProxy *self);
 void java_destination_proxy_close(JavaDestinationProxy *self);
 gboolean java_destination_proxy_is_opened(JavaDestinationProxy *self);
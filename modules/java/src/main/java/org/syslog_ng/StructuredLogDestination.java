@@ -42,4 +42,39 @@ public abstract class StructuredLogDestination extends LogDestination {
 			msg.release();
 		}
 	}
+
+	/*
+	 * A batch of messages; returns the number of messages sent, counting
+	 * from the first one, the rest are retried.  The messages are released
+	 * once it returns.  Destinations able to handle a batch at once can
+	 * override it, by default send() is called for each message.
+	 */
+	protected int sendBatch(LogMessage[] msgs) {
+		int i;
+
+		for (i = 0; i < msgs.length; i++) {
+			if (!send(msgs[i]))
+				break;
+		}
+		return i;
+	}
+
+	public int sendBatchProxy(long[] handles, int count) {
+		LogMessage[] msgs = new LogMessage[count];
+
+		for (int i = 0; i < count; i++)
+			msgs[i] = new LogMessage(handles[i]);
+
+		try {
+			return sendBatch(msgs);
+		}
+		catch (Exception e) {
+			sendExceptionMessage(e);
+			return 0;
+		}
+		finally {
+			for (LogMessage msg : msgs)
+				msg.release();
+		}
+	}
 }
\ No newline at end of file
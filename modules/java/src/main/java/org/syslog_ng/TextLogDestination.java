@@ -24,7 +24,12 @@
 
 package org.syslog_ng;
 
+import java.nio.ByteBuffer;
+import java.nio.charset.Charset;
+
 public abstract class TextLogDestination extends LogDestination {
+	private static final Charset UTF8 = Charset.forName("UTF-8");
+
 	public TextLogDestination(long handle) {
 		super(handle);
 	}
@@ -39,4 +44,41 @@ public abstract class TextLogDestination extends LogDestination {
 			return false;
 		}
 	}
+
+	/*
+	 * A batch of formatted messages, the i-th message is the UTF-8 encoded
+	 * range [offsets[i], offsets[i + 1]) of messages.  The buffer points to
+	 * native memory that is only valid during the call.
+	 *
+	 * Returns the number of messages sent, counting from the first one,
+	 * the rest are retried.  Destinations able to handle a batch at once
+	 * can override it, by default send() is called for each message.
+	 */
+	protected int sendBatch(ByteBuffer messages, int[] offsets, int count) {
+		int i;
+
+		for (i = 0; i < count; i++) {
+			if (!send(getMessage(messages, offsets, i)))
+				break;
+		}
+		return i;
+	}
+
+	protected static String getMessage(ByteBuffer messages, int[] offsets, int index) {
+		ByteBuffer message = messages.duplicate();
+
+		message.limit(offsets[index + 1]);
+		message.position(offsets[index]);
+		return UTF8.decode(message).toString();
+	}
+
+	public int sendBatchProxy(ByteBuffer messages, int[] offsets, int count) {
+		try {
+			return sendBatch(messages, offsets, count);
+		}
+		catch (Exception e) {
+			sendExceptionMessage(e);
+			return 0;
+		}
+	}
 }
\ No newline at end of file
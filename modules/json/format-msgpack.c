@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "format-msgpack.h"
+#include "value-pairs/cmdline.h"
+#include "type-hinting.h"
+#include "cfg.h"
+
+#include <string.h>
+
+/*
+ * $(format-msgpack) formats the selected name-value pairs as a MessagePack
+ * map, nested the same way as $(format-json) does.  Type hints are mapped
+ * to native MessagePack types: integers, floats, booleans, and datetime to
+ * the timestamp extension type (-1).
+ *
+ * The output is binary (it may contain NUL and newline characters), so it
+ * should be sent over a framed transport, e.g. transport("framed") in
+ * network() or syslog().
+ *
+ * Maps are emitted with a map32 header whose element count is patched
+ * when the object is closed, as the number of elements is not known in
+ * advance while walking the value-pairs.
+ */
+
+typedef struct _TFMsgPackState
+{
+  TFSimpleFuncState super;
+  ValuePairs *vp;
+} TFMsgPackState;
+
+typedef struct
+{
+  GString *buffer;
+  /* offsets of the headers of the maps currently open */
+  GArray *maps;
+  const LogTemplateOptions *template_options;
+} MsgPackWalkerState;
+
+typedef struct
+{
+  gsize header_offset;
+  guint32 count;
+} MsgPackMap;
+
+static gboolean
+tf_msgpack_prepare(LogTemplateFunction *self, gpointer s, LogTemplate *parent,
+                   gint argc, gchar *argv[],
+                   GError **error)
+{
+  TFMsgPackState *state = (TFMsgPackState *) s;
+  ValuePairsTransformSet *vpts;
+
+  state->vp = value_pairs_new_from_cmdline(parent->cfg, argc, argv, error);
+  if (!state->vp)
+    return FALSE;
+
+  /* same as $(format-json): replace a leading dot with an underscore */
+  vpts = value_pairs_transform_set_new(".*");
+  value_pairs_transform_set_add_func(vpts, value_pairs_new_transform_replace_prefix(".", "_"));
+  value_pairs_add_transforms(state->vp, vpts);
+
+  return TRUE;
+}
+
+static inline void
+msgpack_append_be(GString *buffer, guint64 value, gint size)
+{
+  gchar buf[8];
+  gint i;
+
+  for (i = size - 1; i >= 0; i--)
+    {
+      buf[i] = (gchar) (value & 0xff);
+      value >>= 8;
+    }
+  g_string_append_len(buffer, buf, size);
+}
+
+static inline void
+msgpack_append_tag(GString *buffer, guchar tag)
+{
+  g_string_append_c(buffer, (gchar) tag);
+}
+
+static void
+msgpack_append_str(GString *buffer, const gchar *str, gssize len)
+{
+  if (len < 0)
+    len = strlen(str);
+
+  if (len < 32)
+    msgpack_append_tag(buffer, 0xa0 | len);
+  else if (len <= G_MAXUINT8)
+    {
+      msgpack_append_tag(buffer, 0xd9);
+      msgpack_append_be(buffer, len, 1);
+    }
+  else if (len <= G_MAXUINT16)
+    {
+      msgpack_append_tag(buffer, 0xda);
+      msgpack_append_be(buffer, len, 2);
+    }
+  else
+    {
+      msgpack_append_tag(buffer, 0xdb);
+      msgpack_append_be(buffer, len, 4);
+    }
+  g_string_append_len(buffer, str, len);
+}
+
+static void
+msgpack_append_int(GString *buffer, gint64 value)
+{
+  if (value >= -32 && value <= 127)
+    msgpack_append_tag(buffer, (guchar) (gint8) value);
+  else if (value >= G_MININT8 && value <= G_MAXINT8)
+    {
+      msgpack_append_tag(buffer, 0xd0);
+      msgpack_append_be(buffer, (guint64) value, 1);
+    }
+  else if (value >= G_MININT16 && value <= G_MAXINT16)
+    {
+      msgpack_append_tag(buffer, 0xd1);
+      msgpack_append_be(buffer, (guint64) value, 2);
+    }
+  else if (value >= G_MININT32 && value <= G_MAXINT32)
+    {
+      msgpack_append_tag(buffer, 0xd2);
+      msgpack_append_be(buffer, (guint64) value, 4);
+    }
+  else
+    {
+      msgpack_append_tag(buffer, 0xd3);
+      msgpack_append_be(buffer, (guint64) value, 8);
+    }
+}
+
+static void
+msgpack_append_double(GString *buffer, gdouble value)
+{
+  union
+  {
+    gdouble d;
+    guint64 u;
+  } v;
+
+  v.d = value;
+  msgpack_append_tag(buffer, 0xcb);
+  msgpack_append_be(buffer, v.u, 8);
+}
+
+/* timestamp 96 extension: nanoseconds (32 bit) followed by seconds (64 bit) */
+static void
+msgpack_append_timestamp(GString *buffer, guint64 msec)
+{
+  msgpack_append_tag(buffer, 0xc7);
+  msgpack_append_tag(buffer, 12);
+  msgpack_append_tag(buffer, 0xff);
+  msgpack_append_be(buffer, (msec % 1000) * 1000000, 4);
+  msgpack_append_be(buffer, msec / 1000, 8);
+}
+
+static void
+tf_msgpack_count_element(MsgPackWalkerState *state)
+{
+  if (state->maps->len > 0)
+    g_array_index(state->maps, MsgPackMap, state->maps->len - 1).count++;
+}
+
+static gboolean
+tf_msgpack_obj_start(const gchar *name,
+                     const gchar *prefix, gpointer *prefix_data,
+                     const gchar *prev, gpointer *prev_data,
+                     gpointer user_data)
+{
+  MsgPackWalkerState *state = (MsgPackWalkerState *) user_data;
+  MsgPackMap map;
+
+  if (name)
+    {
+      tf_msgpack_count_element(state);
+      msgpack_append_str(state->buffer, name, -1);
+    }
+
+  map.header_offset = state->buffer->len;
+  map.count = 0;
+  g_array_append_val(state->maps, map);
+
+  msgpack_append_tag(state->buffer, 0xdf);
+  msgpack_append_be(state->buffer, 0, 4);
+  return FALSE;
+}
+
+static gboolean
+tf_msgpack_obj_end(const gchar *name,
+                   const gchar *prefix, gpointer *prefix_data,
+                   const gchar *prev, gpointer *prev_data,
+                   gpointer user_data)
+{
+  MsgPackWalkerState *state = (MsgPackWalkerState *) user_data;
+  MsgPackMap *map;
+  guchar *count;
+
+  g_assert(state->maps->len > 0);
+  map = &g_array_index(state->maps, MsgPackMap, state->maps->len - 1);
+  count = (guchar *) state->buffer->str + map->header_offset + 1;
+  count[0] = (map->count >> 24) & 0xff;
+  count[1] = (map->count >> 16) & 0xff;
+  count[2] = (map->count >> 8) & 0xff;
+  count[3] = map->count & 0xff;
+  g_array_set_size(state->maps, state->maps->len - 1);
+  return FALSE;
+}
+
+static gboolean
+tf_msgpack_value(const gchar *name, const gchar *prefix,
+                 TypeHint type, const gchar *value, gsize value_len,
+                 gpointer *prefix_data, gpointer user_data)
+{
+  MsgPackWalkerState *state = (MsgPackWalkerState *) user_data;
+  gint on_error = state->template_options->on_error;
+  gint32 i32;
+  gint64 i64;
+  guint64 msec;
+  gdouble d;
+  gboolean b;
+  gboolean fail = FALSE, r = FALSE;
+  gsize header_len = state->buffer->len;
+
+  msgpack_append_str(state->buffer, name, -1);
+  switch (type)
+    {
+    case TYPE_HINT_INT32:
+      if (!(fail = !type_cast_to_int32(value, &i32, NULL)))
+        msgpack_append_int(state->buffer, i32);
+      else
+        r = type_cast_drop_helper(on_error, value, "int32");
+      break;
+    case TYPE_HINT_INT64:
+      if (!(fail = !type_cast_to_int64(value, &i64, NULL)))
+        msgpack_append_int(state->buffer, i64);
+      else
+        r = type_cast_drop_helper(on_error, value, "int64");
+      break;
+    case TYPE_HINT_DOUBLE:
+      if (!(fail = !type_cast_to_double(value, &d, NULL)))
+        msgpack_append_double(state->buffer, d);
+      else
+        r = type_cast_drop_helper(on_error, value, "double");
+      break;
+    case TYPE_HINT_BOOLEAN:
+      if (!(fail = !type_cast_to_boolean(value, &b, NULL)))
+        msgpack_append_tag(state->buffer, b ? 0xc3 : 0xc2);
+      else
+        r = type_cast_drop_helper(on_error, value, "boolean");
+      break;
+    case TYPE_HINT_DATETIME:
+      if (!(fail = !type_cast_to_datetime_int(value, &msec, NULL)))
+        msgpack_append_timestamp(state->buffer, msec);
+      else
+        r = type_cast_drop_helper(on_error, value, "datetime");
+      break;
+    case TYPE_HINT_STRING:
+    case TYPE_HINT_LITERAL:
+    default:
+      msgpack_append_str(state->buffer, value, value_len);
+      break;
+    }
+
+  if (fail)
+    {
+      if (!(on_error & ON_ERROR_FALLBACK_TO_STRING))
+        {
+          g_string_truncate(state->buffer, header_len);
+          return r;
+        }
+      msgpack_append_str(state->buffer, value, value_len);
+    }
+
+  tf_msgpack_count_element(state);
+  return FALSE;
+}
+
+static gboolean
+tf_msgpack_append(GString *result, ValuePairs *vp, LogMessage *msg,
+                  const LogTemplateOptions *template_options, gint32 seq_num, gint time_zone_mode)
+{
+  MsgPackWalkerState state;
+  gboolean r;
+
+  state.buffer = result;
+  state.maps = g_array_sized_new(FALSE, FALSE, sizeof(MsgPackMap), 4);
+  state.template_options = template_options;
+
+  r = value_pairs_walk(vp,
+                       tf_msgpack_obj_start, tf_msgpack_value, tf_msgpack_obj_end,
+                       msg, seq_num, time_zone_mode,
+                       template_options,
+                       &state);
+  g_array_free(state.maps, TRUE);
+  return r;
+}
+
+static void
+tf_msgpack_call(LogTemplateFunction *self, gpointer s,
+                const LogTemplateInvokeArgs *args, GString *result)
+{
+  TFMsgPackState *state = (TFMsgPackState *) s;
+  gint i;
+  gboolean r = TRUE;
+  gsize orig_size = result->len;
+
+  for (i = 0; i < args->num_messages; i++)
+    r &= tf_msgpack_append(result, state->vp, args->messages[i], args->opts, args->seq_num, args->tz);
+
+  if (!r && (args->opts->on_error & ON_ERROR_DROP_MESSAGE))
+    g_string_set_size(result, orig_size);
+}
+
+static void
+tf_msgpack_free_state(gpointer s)
+{
+  TFMsgPackState *state = (TFMsgPackState *) s;
+
+  value_pairs_unref(state->vp);
+  tf_simple_func_free_state(&state->super);
+}
+
+TEMPLATE_FUNCTION(TFMsgPackState, tf_msgpack, tf_msgpack_prepare, NULL, tf_msgpack_call,
+                  tf_msgpack_free_state, NULL);
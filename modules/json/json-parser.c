@@ -22,9 +22,11 @@
 
 #include "json-parser.h"
 #include "dot-notation.h"
+#include "json-tokenizer.h"
 #include "scratch-buffers.h"
 
 #include <string.h>
+#include <stdlib.h>
 #include <ctype.h>
 
 #include <json.h>
@@ -68,12 +70,14 @@ json_parser_set_extract_prefix(LogParser *s, const gchar *extract_prefix)
 }
 
 static void
-json_parser_process_object(struct json_object *jso,
+json_parser_process_object(JSONParser *self,
+                                struct json_object *jso,
                                 const gchar *prefix,
                                 LogMessage *msg);
 
 static void
-json_parser_process_single(struct json_object *jso,
+json_parser_process_single(JSONParser *self,
+                                struct json_object *jso,
                                 const gchar *prefix,
                                 const gchar *obj_key,
                                 LogMessage *msg)
@@ -116,7 +120,7 @@ json_parser_process_single(struct json_object *jso,
         g_string_assign(sb_gstring_string(key), prefix);
       g_string_append(sb_gstring_string(key), obj_key);
       g_string_append_c(sb_gstring_string(key), '.');
-      json_parser_process_object(jso, sb_gstring_string(key)->str, msg);
+      json_parser_process_object(self, jso, sb_gstring_string(key)->str, msg);
       break;
     case json_type_array:
       {
@@ -130,7 +134,7 @@ json_parser_process_single(struct json_object *jso,
           {
             g_string_truncate(sb_gstring_string(key), plen);
             g_string_append_printf(sb_gstring_string(key), "[%d]", i);
-            json_parser_process_single(json_object_array_get_idx(jso, i),
+            json_parser_process_single(self, json_object_array_get_idx(jso, i),
                                             prefix,
                                             sb_gstring_string(key)->str, msg);
           }
@@ -150,13 +154,13 @@ json_parser_process_single(struct json_object *jso,
         {
           g_string_assign(sb_gstring_string(key), prefix);
           g_string_append(sb_gstring_string(key), obj_key);
-          log_msg_set_value_by_name(msg,
+          log_parser_set_value_by_name(&self->super, msg,
                              sb_gstring_string(key)->str,
                              sb_gstring_string(value)->str,
                              sb_gstring_string(value)->len);
         }
       else
-        log_msg_set_value_by_name(msg,
+        log_parser_set_value_by_name(&self->super, msg,
                            obj_key,
                            sb_gstring_string(value)->str,
                            sb_gstring_string(value)->len);
@@ -167,7 +171,8 @@ json_parser_process_single(struct json_object *jso,
 }
 
 static void
-json_parser_process_object(struct json_object *jso,
+json_parser_process_object(JSONParser *self,
+                                struct json_object *jso,
                                 const gchar *prefix,
                                 LogMessage *msg)
 {
@@ -175,7 +180,7 @@ json_parser_process_object(struct json_object *jso,
 
   json_object_object_foreachC(jso, itr)
     {
-      json_parser_process_single(itr.val, prefix, itr.key, msg);
+      json_parser_process_single(self, itr.val, prefix, itr.key, msg);
     }
 }
 
@@ -190,10 +195,154 @@ json_parser_extract(JSONParser *self, struct json_object *jso, LogMessage *msg)
       return FALSE;
     }
   
-  json_parser_process_object(jso, self->prefix, msg);
+  json_parser_process_object(self, jso, self->prefix, msg);
   return TRUE;
 }
 
+/*
+ * Token based processing, producing the same name-value pairs as
+ * json_parser_process_single() above but without building json_objects.
+ * @name holds the prefixed name of the value being processed.
+ */
+static gint json_parser_process_token(JSONParser *self, const gchar *input, const JSONToken *tokens, gint pos,
+                                      GString *name, GString *value, LogMessage *msg);
+
+static gint
+json_parser_process_object_tokens(JSONParser *self, const gchar *input, const JSONToken *tokens, gint pos,
+                                  GString *name, GString *value, LogMessage *msg)
+{
+  gsize name_len = name->len;
+
+  while (tokens[pos].type != JSON_TOKEN_OBJECT_END)
+    {
+      g_string_truncate(name, name_len);
+      json_token_append_string(input, &tokens[pos], name);
+      pos = json_parser_process_token(self, input, tokens, pos + 1, name, value, msg);
+    }
+  g_string_truncate(name, name_len);
+  return pos + 1;
+}
+
+static gint
+json_parser_process_array_tokens(JSONParser *self, const gchar *input, const JSONToken *tokens, gint pos,
+                                 GString *name, GString *value, LogMessage *msg)
+{
+  gsize name_len = name->len;
+  gint i;
+
+  for (i = 0; tokens[pos].type != JSON_TOKEN_ARRAY_END; i++)
+    {
+      g_string_truncate(name, name_len);
+      g_string_append_printf(name, "[%d]", i);
+      pos = json_parser_process_token(self, input, tokens, pos, name, value, msg);
+    }
+  g_string_truncate(name, name_len);
+  return pos + 1;
+}
+
+static void
+json_parser_format_int_token(const gchar *input, const JSONToken *token, GString *value)
+{
+  const gchar *digits = input + token->offset;
+  gint len = token->len;
+  struct json_object *jso;
+  gint i, number = 0;
+
+  if (*digits == '-')
+    {
+      digits++;
+      len--;
+    }
+
+  if (len <= 9)
+    {
+      for (i = 0; i < len; i++)
+        number = number * 10 + digits[i] - '0';
+      g_string_printf(value, "%i", input[token->offset] == '-' ? -number : number);
+      return;
+    }
+
+  /* let json-c decide how it clamps values outside of the range of an int */
+  g_string_assign_len(value, input + token->offset, token->len);
+  jso = json_tokener_parse(value->str);
+  g_string_printf(value, "%i", json_object_get_int(jso));
+  json_object_put(jso);
+}
+
+static gint
+json_parser_process_token(JSONParser *self, const gchar *input, const JSONToken *tokens, gint pos,
+                          GString *name, GString *value, LogMessage *msg)
+{
+  const JSONToken *token = &tokens[pos];
+
+  switch (token->type)
+    {
+    case JSON_TOKEN_OBJECT:
+      g_string_append_c(name, '.');
+      return json_parser_process_object_tokens(self, input, tokens, pos + 1, name, value, msg);
+    case JSON_TOKEN_ARRAY:
+      return json_parser_process_array_tokens(self, input, tokens, pos + 1, name, value, msg);
+    case JSON_TOKEN_NULL:
+      return pos + 1;
+    case JSON_TOKEN_STRING:
+      g_string_truncate(value, 0);
+      json_token_append_string(input, token, value);
+      break;
+    case JSON_TOKEN_INT:
+      json_parser_format_int_token(input, token, value);
+      break;
+    case JSON_TOKEN_DOUBLE:
+      g_string_printf(value, "%f", strtod(input + token->offset, NULL));
+      break;
+    case JSON_TOKEN_TRUE:
+      g_string_assign(value, "true");
+      break;
+    case JSON_TOKEN_FALSE:
+      g_string_assign(value, "false");
+      break;
+    default:
+      g_assert_not_reached();
+    }
+
+  log_parser_set_value_by_name(&self->super, msg, name->str, value->str, value->len);
+  return pos + 1;
+}
+
+/*
+ * Documents consisting of strict JSON are processed based on their
+ * tokens, anything else (including errors) is left to json-c.  The
+ * extract-prefix() option needs the object tree, so it always uses json-c.
+ */
+static gboolean
+json_parser_process_tokenized(JSONParser *self, LogMessage **pmsg, const LogPathOptions *path_options,
+                              const gchar *input)
+{
+  SBGString *tokens, *name, *value;
+  gboolean success = FALSE;
+
+  if (self->extract_prefix)
+    return FALSE;
+
+  tokens = sb_gstring_acquire();
+  if (json_tokenize_object(input, sb_gstring_string(tokens)))
+    {
+      name = sb_gstring_acquire();
+      value = sb_gstring_acquire();
+      if (self->prefix)
+        g_string_assign(sb_gstring_string(name), self->prefix);
+
+      log_msg_make_writable(pmsg, path_options);
+      /* the first token is the opening brace of the top-level object */
+      json_parser_process_object_tokens(self, input, json_tokens(sb_gstring_string(tokens)), 1,
+                                        sb_gstring_string(name), sb_gstring_string(value), *pmsg);
+      sb_gstring_release(name);
+      sb_gstring_release(value);
+      success = TRUE;
+    }
+  sb_gstring_release(tokens);
+  return success;
+}
+
 #ifndef JSON_C_VERSION
 const char *
 json_tokener_error_desc(enum json_tokener_error err)
@@ -206,6 +355,7 @@ static gboolean
 json_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_options, const gchar *input, gsize input_len)
 {
   JSONParser *self = (JSONParser *) s;
+  const gchar *start = input;
   struct json_object *jso;
   struct json_tokener *tok;
 
@@ -219,6 +369,10 @@ json_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_
         input++;
     }
 
+  /* json-c only sees input_len bytes, the tokenizer runs up to the NUL */
+  if (start[input_len] == 0 && json_parser_process_tokenized(self, pmsg, path_options, input))
+    return TRUE;
+
   tok = json_tokener_new();
   jso = json_tokener_parse_ex(tok, input, input_len);
   if (tok->err != json_tokener_success || !jso)
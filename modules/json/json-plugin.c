@@ -21,6 +21,7 @@
  */
 #include "json-parser.h"
 #include "format-json.h"
+#include "format-msgpack.h"
 #include "json-parser-parser.h"
 #include "plugin.h"
 #include "plugin-types.h"
@@ -35,6 +36,7 @@ static Plugin json_plugins[] =
     .parser = &json_parser_parser,
   },
   TEMPLATE_FUNCTION_PLUGIN(tf_json, "format_json"),
+  TEMPLATE_FUNCTION_PLUGIN(tf_msgpack, "format_msgpack"),
 };
 
 gboolean
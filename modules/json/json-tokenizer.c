@@ -0,0 +1,378 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "json-tokenizer.h"
+
+#include <string.h>
+
+/* json-c limits the nesting to 32 levels, stay well below that and let it decide */
+#define JSON_TOKENIZER_MAX_DEPTH 16
+
+typedef struct _JSONTokenizer
+{
+  const gchar *input;
+  const gchar *pos;
+  GString *tokens;
+} JSONTokenizer;
+
+static void
+_skip_whitespace(JSONTokenizer *self)
+{
+  while (*self->pos == ' ' || *self->pos == '\t' || *self->pos == '\n' || *self->pos == '\r')
+    self->pos++;
+}
+
+static void
+_add_token(JSONTokenizer *self, JSONTokenType type, const gchar *start, gint len, gboolean escaped)
+{
+  JSONToken token;
+
+  token.type = type;
+  token.escaped = escaped;
+  token.offset = start - self->input;
+  token.len = len;
+  g_string_append_len(self->tokens, (const gchar *) &token, sizeof(token));
+}
+
+static gint
+_hex_value(gchar c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+static gint
+_parse_unicode_escape(const gchar *hex)
+{
+  gint i, value = 0;
+
+  for (i = 0; i < 4; i++)
+    {
+      gint digit = _hex_value(hex[i]);
+
+      if (digit < 0)
+        return -1;
+      value = (value << 4) + digit;
+    }
+  return value;
+}
+
+static gboolean
+_tokenize_string(JSONTokenizer *self)
+{
+  const gchar *start;
+  gboolean escaped = FALSE;
+
+  /* opening quote */
+  self->pos++;
+  start = self->pos;
+  while (*self->pos != '"')
+    {
+      guchar c = *self->pos;
+
+      if (c < 0x20)
+        return FALSE;
+
+      if (c == '\\')
+        {
+          escaped = TRUE;
+          self->pos++;
+          switch (*self->pos)
+            {
+            case '"':
+            case '\\':
+            case '/':
+            case 'b':
+            case 'f':
+            case 'n':
+            case 'r':
+            case 't':
+              break;
+            case 'u':
+              {
+                gint value = _parse_unicode_escape(self->pos + 1);
+
+                /* NUL and surrogates are handled differently by the various json-c versions */
+                if (value <= 0 || (value >= 0xD800 && value <= 0xDFFF))
+                  return FALSE;
+                self->pos += 4;
+                break;
+              }
+            default:
+              return FALSE;
+            }
+        }
+      self->pos++;
+    }
+  _add_token(self, JSON_TOKEN_STRING, start, self->pos - start, escaped);
+  /* closing quote */
+  self->pos++;
+  return TRUE;
+}
+
+static gboolean
+_skip_digits(JSONTokenizer *self)
+{
+  const gchar *start = self->pos;
+
+  while (*self->pos >= '0' && *self->pos <= '9')
+    self->pos++;
+  return self->pos > start;
+}
+
+static gboolean
+_tokenize_number(JSONTokenizer *self)
+{
+  const gchar *start = self->pos;
+  JSONTokenType type = JSON_TOKEN_INT;
+
+  if (*self->pos == '-')
+    self->pos++;
+
+  if (*self->pos == '0')
+    self->pos++;
+  else if (!_skip_digits(self))
+    return FALSE;
+
+  if (*self->pos == '.')
+    {
+      type = JSON_TOKEN_DOUBLE;
+      self->pos++;
+      if (!_skip_digits(self))
+        return FALSE;
+    }
+  if (*self->pos == 'e' || *self->pos == 'E')
+    {
+      type = JSON_TOKEN_DOUBLE;
+      self->pos++;
+      if (*self->pos == '+' || *self->pos == '-')
+        self->pos++;
+      if (!_skip_digits(self))
+        return FALSE;
+    }
+  _add_token(self, type, start, self->pos - start, FALSE);
+  return TRUE;
+}
+
+static gboolean
+_tokenize_literal(JSONTokenizer *self, const gchar *literal, gint literal_len, JSONTokenType type)
+{
+  if (strncmp(self->pos, literal, literal_len) != 0)
+    return FALSE;
+  _add_token(self, type, self->pos, literal_len, FALSE);
+  self->pos += literal_len;
+  return TRUE;
+}
+
+static gboolean _tokenize_value(JSONTokenizer *self, gint depth);
+
+static gboolean
+_tokenize_object(JSONTokenizer *self, gint depth)
+{
+  if (depth > JSON_TOKENIZER_MAX_DEPTH)
+    return FALSE;
+
+  _add_token(self, JSON_TOKEN_OBJECT, self->pos, 1, FALSE);
+  self->pos++;
+  _skip_whitespace(self);
+  if (*self->pos == '}')
+    goto finish;
+
+  while (1)
+    {
+      if (*self->pos != '"' || !_tokenize_string(self))
+        return FALSE;
+      _skip_whitespace(self);
+      if (*self->pos != ':')
+        return FALSE;
+      self->pos++;
+      _skip_whitespace(self);
+      if (!_tokenize_value(self, depth))
+        return FALSE;
+      _skip_whitespace(self);
+      if (*self->pos == '}')
+        break;
+      if (*self->pos != ',')
+        return FALSE;
+      self->pos++;
+      _skip_whitespace(self);
+    }
+
+finish:
+  _add_token(self, JSON_TOKEN_OBJECT_END, self->pos, 1, FALSE);
+  self->pos++;
+  return TRUE;
+}
+
+static gboolean
+_tokenize_array(JSONTokenizer *self, gint depth)
+{
+  if (depth > JSON_TOKENIZER_MAX_DEPTH)
+    return FALSE;
+
+  _add_token(self, JSON_TOKEN_ARRAY, self->pos, 1, FALSE);
+  self->pos++;
+  _skip_whitespace(self);
+  if (*self->pos == ']')
+    goto finish;
+
+  while (1)
+    {
+      if (!_tokenize_value(self, depth))
+        return FALSE;
+      _skip_whitespace(self);
+      if (*self->pos == ']')
+        break;
+      if (*self->pos != ',')
+        return FALSE;
+      self->pos++;
+      _skip_whitespace(self);
+    }
+
+finish:
+  _add_token(self, JSON_TOKEN_ARRAY_END, self->pos, 1, FALSE);
+  self->pos++;
+  return TRUE;
+}
+
+static gboolean
+_tokenize_value(JSONTokenizer *self, gint depth)
+{
+  switch (*self->pos)
+    {
+    case '{':
+      return _tokenize_object(self, depth + 1);
+    case '[':
+      return _tokenize_array(self, depth + 1);
+    case '"':
+      return _tokenize_string(self);
+    case 't':
+      return _tokenize_literal(self, "true", 4, JSON_TOKEN_TRUE);
+    case 'f':
+      return _tokenize_literal(self, "false", 5, JSON_TOKEN_FALSE);
+    case 'n':
+      return _tokenize_literal(self, "null", 4, JSON_TOKEN_NULL);
+    default:
+      if (*self->pos == '-' || (*self->pos >= '0' && *self->pos <= '9'))
+        return _tokenize_number(self);
+      return FALSE;
+    }
+}
+
+/*
+ * Tokenizes a NUL terminated document consisting of a single object,
+ * optionally surrounded by whitespace.
+ */
+gboolean
+json_tokenize_object(const gchar *input, GString *tokens)
+{
+  JSONTokenizer self;
+
+  self.input = input;
+  self.pos = input;
+  self.tokens = tokens;
+  g_string_truncate(tokens, 0);
+
+  _skip_whitespace(&self);
+  if (*self.pos != '{' || !_tokenize_object(&self, 1))
+    return FALSE;
+  _skip_whitespace(&self);
+  return *self.pos == 0;
+}
+
+static void
+_append_utf8(GString *result, gint c)
+{
+  if (c < 0x80)
+    {
+      g_string_append_c(result, c);
+    }
+  else if (c < 0x800)
+    {
+      g_string_append_c(result, 0xC0 | (c >> 6));
+      g_string_append_c(result, 0x80 | (c & 0x3F));
+    }
+  else
+    {
+      g_string_append_c(result, 0xE0 | (c >> 12));
+      g_string_append_c(result, 0x80 | ((c >> 6) & 0x3F));
+      g_string_append_c(result, 0x80 | (c & 0x3F));
+    }
+}
+
+void
+json_token_append_string(const gchar *input, const JSONToken *token, GString *result)
+{
+  const gchar *src = input + token->offset;
+  const gchar *end = src + token->len;
+
+  if (!token->escaped)
+    {
+      g_string_append_len(result, src, token->len);
+      return;
+    }
+
+  while (src < end)
+    {
+      const gchar *backslash = memchr(src, '\\', end - src);
+
+      if (!backslash)
+        {
+          g_string_append_len(result, src, end - src);
+          break;
+        }
+      g_string_append_len(result, src, backslash - src);
+      src = backslash + 1;
+      switch (*src)
+        {
+        case 'b':
+          g_string_append_c(result, '\b');
+          break;
+        case 'f':
+          g_string_append_c(result, '\f');
+          break;
+        case 'n':
+          g_string_append_c(result, '\n');
+          break;
+        case 'r':
+          g_string_append_c(result, '\r');
+          break;
+        case 't':
+          g_string_append_c(result, '\t');
+          break;
+        case 'u':
+          _append_utf8(result, _parse_unicode_escape(src + 1));
+          src += 4;
+          break;
+        default:
+          /* '"', '\\' and '/' stand for themselves */
+          g_string_append_c(result, *src);
+          break;
+        }
+      src++;
+    }
+}
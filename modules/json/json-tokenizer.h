@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef JSON_TOKENIZER_H_INCLUDED
+#define JSON_TOKENIZER_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/*
+ * A strict JSON tokenizer that records the structure of a document as a
+ * flat array of tokens pointing back into the input, without allocating
+ * anything per value.  It deliberately only accepts the part of JSON that
+ * json-c would turn into the same values; for anything else (json-c
+ * extensions like single quoted strings, surrogate escapes, deep nesting,
+ * or invalid input) it fails and the caller is expected to use json-c.
+ */
+typedef enum
+{
+  JSON_TOKEN_OBJECT,
+  JSON_TOKEN_OBJECT_END,
+  JSON_TOKEN_ARRAY,
+  JSON_TOKEN_ARRAY_END,
+  JSON_TOKEN_STRING,
+  JSON_TOKEN_INT,
+  JSON_TOKEN_DOUBLE,
+  JSON_TOKEN_TRUE,
+  JSON_TOKEN_FALSE,
+  JSON_TOKEN_NULL
+} JSONTokenType;
+
+typedef struct _JSONToken
+{
+  guint8 type;
+  /* strings only: contains backslash escapes */
+  guint8 escaped;
+  /* offset and length within the input, strings without the quotes */
+  gint32 offset;
+  gint32 len;
+} JSONToken;
+
+/* the tokens are stored in @tokens, which is used as a byte buffer, so scratch GStrings can be used */
+gboolean json_tokenize_object(const gchar *input, GString *tokens);
+void json_token_append_string(const gchar *input, const JSONToken *token, GString *result);
+
+static inline const JSONToken *
+json_tokens(GString *tokens)
+{
+  return (const JSONToken *) tokens->str;
+}
+
+static inline gint
+json_tokens_count(GString *tokens)
+{
+  return tokens->len / sizeof(JSONToken);
+}
+
+#endif
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "template_lib.h"
+#include "apphook.h"
+#include "plugin.h"
+#include "cfg.h"
+
+#include <string.h>
+
+static void
+assert_msgpack_format(const gchar *template_str, const gchar *expected, gsize expected_len)
+{
+  LogTemplate *template = compile_template(template_str, FALSE);
+  LogMessage *msg = create_sample_message();
+  GString *res = g_string_new("");
+
+  log_template_format(template, msg, NULL, LTZ_LOCAL, 0, NULL, res);
+  assert_guint64(res->len, expected_len, "Length of the formatted msgpack mismatch; template=%s", template_str);
+  assert_true(memcmp(res->str, expected, expected_len) == 0, "Formatted msgpack mismatch; template=%s", template_str);
+
+  g_string_free(res, TRUE);
+  log_msg_unref(msg);
+  log_template_unref(template);
+}
+
+#define ASSERT_MSGPACK(template, expected) assert_msgpack_format(template, expected, sizeof(expected) - 1)
+
+static void
+test_format_msgpack(void)
+{
+  ASSERT_MSGPACK("$(format-msgpack x=y)", "\xdf\x00\x00\x00\x01" "\xa1x" "\xa1y");
+  ASSERT_MSGPACK("$(format-msgpack MSG=$MSG)",
+                 "\xdf\x00\x00\x00\x01" "\xa3MSG" "\xbe" "árvíztűrőtükörfúrógép");
+  ASSERT_MSGPACK("$(format-msgpack c=boolean(true) a.b=int32(-5))",
+                 "\xdf\x00\x00\x00\x02" "\xa1" "c" "\xc3" "\xa1" "a" "\xdf\x00\x00\x00\x01" "\xa1" "b" "\xfb");
+}
+
+static void
+test_format_msgpack_with_type_hints(void)
+{
+  ASSERT_MSGPACK("$(format-msgpack n=int64(300))", "\xdf\x00\x00\x00\x01" "\xa1n" "\xd1\x01\x2c");
+  ASSERT_MSGPACK("$(format-msgpack n=int32(-70000))", "\xdf\x00\x00\x00\x01" "\xa1n" "\xd2\xff\xfe\xee\x90");
+  ASSERT_MSGPACK("$(format-msgpack d=double(1.5))", "\xdf\x00\x00\x00\x01" "\xa1" "d" "\xcb\x3f\xf8\x00\x00\x00\x00\x00\x00");
+  ASSERT_MSGPACK("$(format-msgpack b=boolean(false))", "\xdf\x00\x00\x00\x01" "\xa1" "b" "\xc2");
+  ASSERT_MSGPACK("$(format-msgpack t=datetime(1139684315.639))",
+                 "\xdf\x00\x00\x00\x01" "\xa1t" "\xc7\x0c\xff" "\x26\x16\x5d\xc0" "\x00\x00\x00\x00\x43\xee\x33\xdb");
+}
+
+static void
+test_format_msgpack_on_error(void)
+{
+  configuration->template_options.on_error = ON_ERROR_DROP_PROPERTY | ON_ERROR_SILENT;
+  ASSERT_MSGPACK("$(format-msgpack x=y bad=int32(blah))", "\xdf\x00\x00\x00\x01" "\xa1x" "\xa1y");
+
+  configuration->template_options.on_error = ON_ERROR_FALLBACK_TO_STRING | ON_ERROR_SILENT;
+  ASSERT_MSGPACK("$(format-msgpack bad=int32(blah))", "\xdf\x00\x00\x00\x01" "\xa3" "bad" "\xa4" "blah");
+
+  configuration->template_options.on_error = ON_ERROR_DROP_MESSAGE | ON_ERROR_SILENT;
+  assert_msgpack_format("$(format-msgpack x=y bad=int32(blah))", "", 0);
+}
+
+int
+main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
+{
+  app_startup();
+  putenv("TZ=UTC");
+  tzset();
+  init_template_tests();
+  plugin_load_module("json-plugin", configuration, NULL);
+
+  test_format_msgpack();
+  test_format_msgpack_with_type_hints();
+  test_format_msgpack_on_error();
+
+  deinit_template_tests();
+  app_shutdown();
+  return 0;
+}
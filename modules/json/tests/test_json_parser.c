@@ -151,6 +151,38 @@ test_json_parser_validate_type_representation(void)
   log_msg_unref(msg);
 }
 
+static void
+test_json_parser_strict_json_is_represented_the_same_way(void)
+{
+  LogMessage *msg, *json_parsed;
+
+  /* strict JSON is processed by the tokenizer, the json-c extensions (single quotes) are not */
+  json_parser_set_prefix(json_parser, ".prefix.");
+  msg = parse_json_into_log_message("{\"int\": -123, \"big\": 12345678901, \"double\": 1.5e1, \"bool\": true, "
+                                    "\"str\": \"a\\\"b\\u00e9\\n\", \"null\": null, "
+                                    "\"object\": {\"member\": {\"inner\": \"foo\"}, \"empty\": {}}, "
+                                    "\"array\": [[1, 2], {\"key\": \"value\"}, \"last\"]}");
+  assert_log_message_value(msg, log_msg_get_value_handle(".prefix.int"), "-123");
+  assert_log_message_value(msg, log_msg_get_value_handle(".prefix.double"), "15.000000");
+  assert_log_message_value(msg, log_msg_get_value_handle(".prefix.bool"), "true");
+  assert_log_message_value(msg, log_msg_get_value_handle(".prefix.str"), "a\"b\xc3\xa9\n");
+  assert_log_message_value(msg, log_msg_get_value_handle(".prefix.object.member.inner"), "foo");
+  assert_log_message_value(msg, log_msg_get_value_handle(".prefix.array[0][0]"), "1");
+  assert_log_message_value(msg, log_msg_get_value_handle(".prefix.array[0][1]"), "2");
+  assert_log_message_value(msg, log_msg_get_value_handle(".prefix.array[1].key"), "value");
+  assert_log_message_value(msg, log_msg_get_value_handle(".prefix.array[2]"), "last");
+  assert_false(log_msg_is_value_set(msg, log_msg_get_value_handle(".prefix.null")), "null values should not be set");
+  log_msg_unref(msg);
+
+  /* out of range integers are converted the way json-c does it */
+  msg = parse_json_into_log_message("{\"big\": 12345678901}");
+  json_parsed = parse_json_into_log_message("{'big': 12345678901}");
+  assert_log_message_value(msg, log_msg_get_value_handle(".prefix.big"),
+                           log_msg_get_value(json_parsed, log_msg_get_value_handle(".prefix.big"), NULL));
+  log_msg_unref(json_parsed);
+  log_msg_unref(msg);
+}
+
 static void
 test_json_parser_fails_for_non_object_top_element(void)
 {
@@ -178,6 +210,7 @@ test_json_parser(void)
   JSON_PARSER_TESTCASE(test_json_parser_fails_when_marker_is_not_present);
   JSON_PARSER_TESTCASE(test_json_parser_fails_for_invalid_json);
   JSON_PARSER_TESTCASE(test_json_parser_validate_type_representation);
+  JSON_PARSER_TESTCASE(test_json_parser_strict_json_is_represented_the_same_way);
   JSON_PARSER_TESTCASE(test_json_parser_fails_for_non_object_top_element);
   JSON_PARSER_TESTCASE(test_json_parser_extracts_subobjects_if_extract_prefix_is_specified);
 }
@@ -51,7 +51,7 @@ tf_format_welf_foreach(const gchar *name, TypeHint type, const gchar *value,
   GString *result = (GString *) user_data;
 
   if (result->len > 0)
-    g_string_append(result, " ");
+    g_string_append_c(result, ' ');
   g_string_append(result, name);
   g_string_append_c(result, '=');
   if (memchr(value, ' ', value_len) == NULL)
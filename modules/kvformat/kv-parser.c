@@ -29,14 +29,22 @@ typedef struct _KVParser
   gsize prefix_len;
   GString *formatted_key;
   KVScanner *kv_scanner;
+  /* key as found in the input -> NVHandle of the prefixed name */
+  GHashTable *key_handles;
 } KVParser;
 
+/* keys come from the input, don't let a stream of random ones grow the cache indefinitely */
+#define KV_PARSER_KEY_HANDLES_MAX 1024
+
 void
 kv_parser_set_prefix(LogParser *p, const gchar *prefix)
 {
   KVParser *self = (KVParser *)p;
 
   g_free(self->prefix);
+  /* cached handles include the old prefix */
+  g_hash_table_destroy(self->key_handles);
+  self->key_handles = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
   if (prefix)
     {
       self->prefix = g_strdup(prefix);
@@ -62,6 +70,22 @@ _get_formatted_key(KVParser *self, const gchar *key)
   return self->formatted_key->str;
 }
 
+static NVHandle
+_lookup_key_handle(KVParser *self, const gchar *key)
+{
+  gpointer cached;
+  NVHandle handle;
+
+  cached = g_hash_table_lookup(self->key_handles, key);
+  if (cached)
+    return GPOINTER_TO_UINT(cached);
+
+  handle = log_msg_get_value_handle(_get_formatted_key(self, key));
+  if (g_hash_table_size(self->key_handles) < KV_PARSER_KEY_HANDLES_MAX)
+    g_hash_table_insert(self->key_handles, g_strdup(key), GUINT_TO_POINTER(handle));
+  return handle;
+}
+
 static gboolean
 kv_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_options, const gchar *input, gsize input_len)
 {
@@ -74,9 +98,9 @@ kv_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_op
     {
 
       /* FIXME: value length */
-      log_msg_set_value_by_name(*pmsg,
-                                _get_formatted_key(self, kv_scanner_get_current_key(self->kv_scanner)),
-                                kv_scanner_get_current_value(self->kv_scanner), -1);
+      log_parser_set_value(s, *pmsg,
+                           _lookup_key_handle(self, kv_scanner_get_current_key(self->kv_scanner)),
+                           kv_scanner_get_current_value(self->kv_scanner), -1);
     }
   return TRUE;
 }
@@ -100,6 +124,7 @@ kv_parser_free(LogPipe *s)
 
   kv_scanner_free(self->kv_scanner);
   g_string_free(self->formatted_key, TRUE);
+  g_hash_table_destroy(self->key_handles);
   g_free(self->prefix);
   log_parser_free_method(s);
 }
@@ -116,5 +141,6 @@ kv_parser_new(GlobalConfig *cfg, KVScanner *kv_scanner)
 
   self->kv_scanner = kv_scanner;
   self->formatted_key = g_string_sized_new(32);
+  self->key_handles = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
   return &self->super;
 }
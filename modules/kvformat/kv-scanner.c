@@ -25,6 +25,14 @@
 
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define KV_SCANNER_SSE2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define KV_SCANNER_NEON 1
+#endif
+
 enum {
   KV_QUOTE_INITIAL = 0,
   KV_QUOTE_STRING,
@@ -78,21 +86,71 @@ _kv_scanner_extract_key(KVScanner *self)
   return TRUE;
 }
 
+/*
+ * Returns the first character in [@cur, @end) that is one of @c1 .. @c4,
+ * or @end.  Used to copy runs of ordinary characters in one go, the
+ * interesting ones are left to the state machine below.
+ */
+static const gchar *
+_find_first_of(const gchar *cur, const gchar *end, gchar c1, gchar c2, gchar c3, gchar c4)
+{
+#if KV_SCANNER_SSE2
+  const __m128i p1 = _mm_set1_epi8(c1), p2 = _mm_set1_epi8(c2);
+  const __m128i p3 = _mm_set1_epi8(c3), p4 = _mm_set1_epi8(c4);
+
+  for (; cur + 16 <= end; cur += 16)
+    {
+      __m128i block = _mm_loadu_si128((const __m128i *) cur);
+      __m128i match = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, p1), _mm_cmpeq_epi8(block, p2)),
+                                   _mm_or_si128(_mm_cmpeq_epi8(block, p3), _mm_cmpeq_epi8(block, p4)));
+      gint mask = _mm_movemask_epi8(match);
+
+      if (mask)
+        return cur + __builtin_ctz(mask);
+    }
+#elif KV_SCANNER_NEON
+  const uint8x16_t p1 = vdupq_n_u8(c1), p2 = vdupq_n_u8(c2);
+  const uint8x16_t p3 = vdupq_n_u8(c3), p4 = vdupq_n_u8(c4);
+
+  for (; cur + 16 <= end; cur += 16)
+    {
+      uint8x16_t block = vld1q_u8((const guint8 *) cur);
+      uint8x16_t match = vorrq_u8(vorrq_u8(vceqq_u8(block, p1), vceqq_u8(block, p2)),
+                                  vorrq_u8(vceqq_u8(block, p3), vceqq_u8(block, p4)));
+
+      if (vmaxvq_u8(match))
+        break;
+    }
+#endif
+
+  while (cur < end && *cur != c1 && *cur != c2 && *cur != c3 && *cur != c4)
+    cur++;
+  return cur;
+}
+
 static gboolean
 _kv_scanner_extract_value(KVScanner *self)
 {
-  const gchar *cur;
+  const gchar *cur, *end, *span_end;
   gchar control;
 
   g_string_truncate(self->value, 0);
   self->quote_state = KV_QUOTE_INITIAL;
   self->value_was_quoted = FALSE;
   cur = &self->input[self->input_pos];
+  end = &self->input[self->input_len];
   while (*cur && self->quote_state != KV_QUOTE_FINISH)
     {
       switch (self->quote_state)
         {
         case KV_QUOTE_INITIAL:
+          span_end = _find_first_of(cur, end, ' ', ',', '\"', '\'');
+          if (span_end > cur)
+            {
+              g_string_append_len(self->value, cur, span_end - cur);
+              cur = span_end;
+              continue;
+            }
           if (*cur == ' ' || strncmp(cur, ", ", 2) == 0)
             {
               self->quote_state = KV_QUOTE_FINISH;
@@ -109,6 +167,13 @@ _kv_scanner_extract_value(KVScanner *self)
           g_string_append_c(self->value, *cur);
           break;
         case KV_QUOTE_STRING:
+          span_end = _find_first_of(cur, end, self->quote_char, '\\', self->quote_char, '\\');
+          if (span_end > cur)
+            {
+              g_string_append_len(self->value, cur, span_end - cur);
+              cur = span_end;
+              continue;
+            }
           if (*cur == self->quote_char)
             {
               self->quote_state = KV_QUOTE_INITIAL;
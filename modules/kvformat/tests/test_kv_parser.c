@@ -92,6 +92,25 @@ test_kv_parser_basics(void)
   log_msg_unref(msg);
 }
 
+static void
+test_kv_parser_repeated_keys(void)
+{
+  LogMessage *msg;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  msg = log_msg_new_empty();
+  assert_true(log_parser_process(kv_parser, &msg, &path_options, "foo=bar", -1), "kv-parser failed");
+  assert_true(log_parser_process(kv_parser, &msg, &path_options, "foo=baz bar=foo", -1), "kv-parser failed");
+  assert_log_message_value(msg, log_msg_get_value_handle("foo"), "baz");
+  assert_log_message_value(msg, log_msg_get_value_handle("bar"), "foo");
+
+  kv_parser_set_prefix(kv_parser, ".prefix.");
+  assert_true(log_parser_process(kv_parser, &msg, &path_options, "foo=prefixed", -1), "kv-parser failed");
+  assert_log_message_value(msg, log_msg_get_value_handle(".prefix.foo"), "prefixed");
+  assert_log_message_value(msg, log_msg_get_value_handle("foo"), "baz");
+  log_msg_unref(msg);
+}
+
 static void
 test_kv_parser_audit(void)
 {
@@ -125,6 +144,7 @@ test_kv_parser(void)
 {
   KV_PARSER_TESTCASE(test_kv_parser_basics);
   KV_PARSER_TESTCASE(test_kv_parser_audit);
+  KV_PARSER_TESTCASE(test_kv_parser_repeated_keys);
 }
 
 int
@@ -164,6 +164,16 @@ test_kv_scanner_with_comma_separated_values(void)
   assert_no_more_tokens();
 }
 
+static void
+test_kv_scanner_long_values_are_split_at_the_same_places(void)
+{
+  kv_scanner_input(kv_scanner, "key1=0123456789abcdef0123456789,abcdef, key2=\"0123456789abcdef \\\"0123456789\\\" abcdef\" key3=x");
+  assert_next_kv_is("key1", "0123456789abcdef0123456789,abcdef");
+  assert_next_kv_is("key2", "0123456789abcdef \"0123456789\" abcdef");
+  assert_next_kv_is("key3", "x");
+  assert_no_more_tokens();
+}
+
 static void
 test_kv_scanner_quoted_values_are_unquoted_like_c_strings(void)
 {
@@ -256,6 +266,7 @@ test_kv_scanner(void)
   KV_SCANNER_TESTCASE(test_kv_scanner_with_multiple_key_values_return_multiple_pairs);
   KV_SCANNER_TESTCASE(test_kv_scanner_spaces_between_values_are_ignored);
   KV_SCANNER_TESTCASE(test_kv_scanner_with_comma_separated_values);
+  KV_SCANNER_TESTCASE(test_kv_scanner_long_values_are_split_at_the_same_places);
   KV_SCANNER_TESTCASE(test_kv_scanner_quoted_values_are_unquoted_like_c_strings);
   KV_SCANNER_TESTCASE(test_kv_scanner_transforms_values_if_parse_value_is_set);
   KV_SCANNER_TESTCASE(test_kv_scanner_quotation_is_stored_in_the_was_quoted_value_member);
@@ -36,6 +36,8 @@
 #define SCS_PYTHON 0
 #endif
 
+#define PYTHON_DD_BATCH_LINES_DEFAULT 100
+
 typedef struct
 {
   LogThrDestDriver super;
@@ -47,12 +49,21 @@ typedef struct
   GHashTable *options;
   ValuePairs *vp;
 
+  /* messages waiting to be passed to Python, prepared without the GIL */
+  struct
+  {
+    PyValuePairsBatch *values;
+    /* LogMessage references when value-pairs() is not set */
+    GPtrArray *messages;
+  } batch;
+
   struct
   {
     PyObject *class;
     PyObject *instance;
     PyObject *is_opened;
     PyObject *send;
+    PyObject *send_batch;
   } py;
 } PythonDestDriver;
 
@@ -322,14 +333,16 @@ _py_init_bindings(PythonDestDriver *self)
   /* these are fast paths, store references to be faster */
   self->py.is_opened = _py_get_attr_or_null(self->py.instance, "is_opened");
   self->py.send = _py_get_attr_or_null(self->py.instance, "send");
-  if (!self->py.send)
+  self->py.send_batch = _py_get_attr_or_null(self->py.instance, "send_batch");
+  if (!self->py.send && !self->py.send_batch)
     {
-      msg_error("Error initializing Python destination, class does not have a send() method",
+      msg_error("Error initializing Python destination, class does not have a send() or send_batch() method",
                 evt_tag_str("driver", self->super.super.super.id),
                 evt_tag_str("class", self->class),
                 NULL);
+      return FALSE;
     }
-  return self->py.send != NULL;
+  return TRUE;
 }
 
 static void
@@ -339,6 +352,7 @@ _py_free_bindings(PythonDestDriver *self)
   Py_CLEAR(self->py.instance);
   Py_CLEAR(self->py.is_opened);
   Py_CLEAR(self->py.send);
+  Py_CLEAR(self->py.send_batch);
 }
 
 static gboolean
@@ -355,36 +369,99 @@ _py_init_object(PythonDestDriver *self)
   return TRUE;
 }
 
+/*
+ * Messages are converted to Python objects in batches: templates and
+ * value-pairs() are rendered by python_dd_insert() without the GIL, which
+ * is only taken in python_dd_flush() to build the objects and to call the
+ * driver.  If the class has a send_batch() method, it gets a list of up to
+ * batch-lines() messages per GIL acquisition, otherwise send() is called
+ * for each message.
+ */
+
+static gboolean
+python_dd_batch_add(PythonDestDriver *self, LogMessage *msg)
+{
+  if (self->vp)
+    return py_value_pairs_batch_add(self->batch.values, self->vp, &self->template_options,
+                                    self->super.seq_num, msg);
+
+  g_ptr_array_add(self->batch.messages, log_msg_ref(msg));
+  return TRUE;
+}
+
+static guint
+python_dd_batch_get_length(PythonDestDriver *self)
+{
+  if (self->vp)
+    return py_value_pairs_batch_get_length(self->batch.values);
+  return self->batch.messages->len;
+}
+
+static void
+python_dd_batch_clear(PythonDestDriver *self)
+{
+  g_ptr_array_foreach(self->batch.messages, (GFunc) log_msg_unref, NULL);
+  g_ptr_array_set_size(self->batch.messages, 0);
+  py_value_pairs_batch_clear(self->batch.values);
+}
+
+/* LogMessage objects are lazy, values are only converted when accessed from Python */
+static PyObject *
+_py_batch_get_item(PythonDestDriver *self, guint index)
+{
+  if (self->vp)
+    return py_value_pairs_batch_get_dict(self->batch.values, index);
+  return py_log_message_new(g_ptr_array_index(self->batch.messages, index));
+}
+
+static gboolean
+_py_invoke_send_batch(PythonDestDriver *self)
+{
+  PyObject *list;
+  gboolean success;
+  guint i, len = python_dd_batch_get_length(self);
+
+  list = PyList_New(len);
+  for (i = 0; i < len; i++)
+    PyList_SET_ITEM(list, i, _py_batch_get_item(self, i));
+
+  success = _py_invoke_bool_function(self, self->py.send_batch, list);
+  Py_DECREF(list);
+  return success;
+}
+
+static gboolean
+_py_invoke_send_each(PythonDestDriver *self)
+{
+  PyObject *msg_object;
+  gboolean success = TRUE;
+  guint i, len = python_dd_batch_get_length(self);
+
+  for (i = 0; success && i < len; i++)
+    {
+      msg_object = _py_batch_get_item(self, i);
+      success = _py_invoke_send(self, msg_object);
+      Py_DECREF(msg_object);
+    }
+  return success;
+}
+
 static worker_insert_result_t
-python_dd_insert(LogThrDestDriver *d, LogMessage *msg)
+python_dd_flush(LogThrDestDriver *d)
 {
   PythonDestDriver *self = (PythonDestDriver *)d;
   worker_insert_result_t result = WORKER_INSERT_RESULT_ERROR;
-  gboolean success;
-  PyObject *msg_object;
   PyGILState_STATE gstate;
 
+  if (python_dd_batch_get_length(self) == 0)
+    return WORKER_INSERT_RESULT_SUCCESS;
+
   gstate = PyGILState_Ensure();
   if (!_py_invoke_is_opened(self))
     {
       result = WORKER_INSERT_RESULT_NOT_CONNECTED;
-      goto exit;
     }
-  if (self->vp)
-    {
-      success = py_value_pairs_apply(self->vp, &self->template_options, self->super.seq_num, msg, &msg_object);
-      if (!success && (self->template_options.on_error & ON_ERROR_DROP_MESSAGE))
-        {
-          goto exit;
-        }
-    }
-  else
-    {
-      msg_object = py_log_message_new(msg);
-    }
-
-  success = _py_invoke_send(self, msg_object);
-  if (success)
+  else if (self->py.send_batch ? _py_invoke_send_batch(self) : _py_invoke_send_each(self))
     {
       result = WORKER_INSERT_RESULT_SUCCESS;
     }
@@ -393,16 +470,36 @@ python_dd_insert(LogThrDestDriver *d, LogMessage *msg)
       msg_error("Python send() method returned failure, suspending destination for time_reopen()",
                 evt_tag_str("driver", self->super.super.super.id),
                 evt_tag_str("class", self->class),
+                evt_tag_str("method", self->py.send_batch ? "send_batch" : "send"),
                 evt_tag_int("time_reopen", self->super.time_reopen),
                 NULL);
     }
-  Py_DECREF(msg_object);
-
- exit:
   PyGILState_Release(gstate);
+
+  /* a failed batch is rewound and added again message by message */
+  python_dd_batch_clear(self);
   return result;
 }
 
+static worker_insert_result_t
+python_dd_insert(LogThrDestDriver *d, LogMessage *msg)
+{
+  PythonDestDriver *self = (PythonDestDriver *)d;
+
+  if (!python_dd_batch_add(self, msg))
+    {
+      /* on-error(drop-message): skip it, the rest of the batch goes on */
+      if (self->py.send_batch)
+        return WORKER_INSERT_RESULT_QUEUED;
+      return WORKER_INSERT_RESULT_ERROR;
+    }
+
+  if (self->py.send_batch)
+    return WORKER_INSERT_RESULT_QUEUED;
+
+  return python_dd_flush(d);
+}
+
 static void
 python_dd_open(PythonDestDriver *self)
 {
@@ -480,6 +577,17 @@ python_dd_init(LogPipe *d)
 
   PyGILState_Release(gstate);
 
+  if (self->py.send_batch)
+    {
+      self->super.worker.flush = python_dd_flush;
+      if (self->super.batch.lines == 0)
+        log_threaded_dest_driver_set_batch_lines(d, PYTHON_DD_BATCH_LINES_DEFAULT);
+    }
+  else
+    {
+      self->super.worker.flush = NULL;
+    }
+
   msg_verbose("Python destination initialized",
               evt_tag_str("driver", self->super.super.super.id),
               evt_tag_str("class", self->class),
@@ -519,6 +627,10 @@ python_dd_free(LogPipe *d)
 
   g_free(self->class);
 
+  python_dd_batch_clear(self);
+  g_ptr_array_free(self->batch.messages, TRUE);
+  py_value_pairs_batch_free(self->batch.values);
+
   value_pairs_unref(self->vp);
 
   if (self->options)
@@ -549,6 +661,8 @@ python_dd_new(GlobalConfig *cfg)
   self->super.stats_source = SCS_PYTHON;
 
   self->options = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  self->batch.values = py_value_pairs_batch_new();
+  self->batch.messages = g_ptr_array_new();
 
   return (LogDriver *)self;
 }
@@ -31,6 +31,7 @@
 
 #include "plugin.h"
 #include "plugin-types.h"
+#include "cfg.h"
 
 extern CfgParser python_parser;
 
@@ -73,6 +74,8 @@ python_module_init(GlobalConfig *cfg, CfgArgs *args G_GNUC_UNUSED)
   _py_init_interpreter();
   python_debugger_init();
   plugin_register(cfg, python_plugins, G_N_ELEMENTS(python_plugins));
+  /* Python code may read any value of the messages it gets */
+  cfg_reference_all_values(cfg);
   return TRUE;
 }
 
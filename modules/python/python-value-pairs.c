@@ -26,14 +26,38 @@
 
 /** Value pairs **/
 
+/*
+ * value-pairs() are rendered into a plain C buffer first, which needs no
+ * Python objects and thus no GIL, and turned into dicts once the GIL is
+ * taken, possibly for a whole batch of messages at once.
+ */
+
+typedef struct _PyRenderedValue
+{
+  /* offsets into PyValuePairsBatch->strings */
+  gsize name;
+  gsize value;
+  gboolean is_int;
+  gint64 int_value;
+} PyRenderedValue;
+
+struct _PyValuePairsBatch
+{
+  GString *strings;
+  GArray *values;
+  /* index of the first value of each message */
+  GArray *messages;
+};
+
 /* TODO escape '\0' when passing down the value */
 static gboolean
-python_worker_vp_add_one(const gchar *name,
-                       TypeHint type, const gchar *value, gsize value_len,
-                       gpointer user_data)
+python_worker_vp_render_one(const gchar *name,
+                            TypeHint type, const gchar *value, gsize value_len,
+                            gpointer user_data)
 {
   const LogTemplateOptions *template_options = (const LogTemplateOptions *)((gpointer *)user_data)[0];
-  PyObject *dict = (PyObject *)((gpointer *)user_data)[1];
+  PyValuePairsBatch *self = (PyValuePairsBatch *)((gpointer *)user_data)[1];
+  PyRenderedValue rendered = { 0 };
   gboolean need_drop = FALSE;
   gboolean fallback = template_options->on_error & ON_ERROR_FALLBACK_TO_STRING;
 
@@ -41,52 +65,119 @@ python_worker_vp_add_one(const gchar *name,
     {
     case TYPE_HINT_INT32:
     case TYPE_HINT_INT64:
-      {
-        gint64 i;
-
-        if (type_cast_to_int64(value, &i, NULL))
-          PyDict_SetItemString(dict, name, PyLong_FromLong(i));
-        else
-          {
-            need_drop = type_cast_drop_helper(template_options->on_error,
-                                              value, "int");
-
-            if (fallback)
-              PyDict_SetItemString(dict, name, PyUnicode_FromString(value));
-          }
-        break;
-      }
+      if (type_cast_to_int64(value, &rendered.int_value, NULL))
+        rendered.is_int = TRUE;
+      else
+        {
+          need_drop = type_cast_drop_helper(template_options->on_error,
+                                            value, "int");
+
+          if (!fallback)
+            return need_drop;
+        }
+      break;
     case TYPE_HINT_STRING:
-      PyDict_SetItemString(dict, name, PyUnicode_FromString(value));
       break;
     default:
-      need_drop = type_cast_drop_helper(template_options->on_error,
-                                        value, "<unknown>");
-      break;
+      return type_cast_drop_helper(template_options->on_error,
+                                   value, "<unknown>");
     }
+
+  rendered.name = self->strings->len;
+  g_string_append_len(self->strings, name, strlen(name) + 1);
+  if (!rendered.is_int)
+    {
+      rendered.value = self->strings->len;
+      g_string_append_len(self->strings, value, value_len);
+      g_string_append_c(self->strings, 0);
+    }
+  g_array_append_val(self->values, rendered);
   return need_drop;
 }
 
 /** Main code **/
 
 gboolean
-py_value_pairs_apply(ValuePairs *vp, const LogTemplateOptions *template_options, guint32 seq_num, LogMessage *msg, PyObject **dict)
+py_value_pairs_batch_add(PyValuePairsBatch *self, ValuePairs *vp, const LogTemplateOptions *template_options,
+                         guint32 seq_num, LogMessage *msg)
 {
   gpointer args[2];
-  gboolean vp_ok;
-
-  *dict = PyDict_New();
+  guint first_value = self->values->len;
+  gsize strings_len = self->strings->len;
 
   args[0] = (gpointer) template_options;
-  args[1] = *dict;
+  args[1] = self;
+
+  if (!value_pairs_foreach(vp, python_worker_vp_render_one,
+                           msg, seq_num, LTZ_LOCAL, template_options,
+                           args))
+    {
+      g_array_set_size(self->values, first_value);
+      g_string_truncate(self->strings, strings_len);
+      return FALSE;
+    }
+
+  g_array_append_val(self->messages, first_value);
+  return TRUE;
+}
 
-  vp_ok = value_pairs_foreach(vp, python_worker_vp_add_one,
-                              msg, seq_num, LTZ_LOCAL, template_options,
-                              args);
-  if (!vp_ok)
+guint
+py_value_pairs_batch_get_length(PyValuePairsBatch *self)
+{
+  return self->messages->len;
+}
+
+PyObject *
+py_value_pairs_batch_get_dict(PyValuePairsBatch *self, guint index)
+{
+  PyObject *dict, *value;
+  guint first, last, i;
+
+  first = g_array_index(self->messages, guint, index);
+  if (index + 1 < self->messages->len)
+    last = g_array_index(self->messages, guint, index + 1);
+  else
+    last = self->values->len;
+
+  dict = PyDict_New();
+  for (i = first; i < last; i++)
     {
-      Py_DECREF(*dict);
-      *dict = NULL;
+      PyRenderedValue *rendered = &g_array_index(self->values, PyRenderedValue, i);
+
+      if (rendered->is_int)
+        value = PyLong_FromLongLong(rendered->int_value);
+      else
+        value = PyUnicode_FromString(self->strings->str + rendered->value);
+      PyDict_SetItemString(dict, self->strings->str + rendered->name, value);
+      Py_DECREF(value);
     }
-  return vp_ok;
+  return dict;
+}
+
+void
+py_value_pairs_batch_clear(PyValuePairsBatch *self)
+{
+  g_string_truncate(self->strings, 0);
+  g_array_set_size(self->values, 0);
+  g_array_set_size(self->messages, 0);
+}
+
+PyValuePairsBatch *
+py_value_pairs_batch_new(void)
+{
+  PyValuePairsBatch *self = g_new0(PyValuePairsBatch, 1);
+
+  self->strings = g_string_sized_new(1024);
+  self->values = g_array_new(FALSE, FALSE, sizeof(PyRenderedValue));
+  self->messages = g_array_new(FALSE, FALSE, sizeof(guint));
+  return self;
+}
+
+void
+py_value_pairs_batch_free(PyValuePairsBatch *self)
+{
+  g_string_free(self->strings, TRUE);
+  g_array_free(self->values, TRUE);
+  g_array_free(self->messages, TRUE);
+  g_free(self);
 }
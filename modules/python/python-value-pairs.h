@@ -28,6 +28,18 @@
 #include "python-module.h"
 #include "value-pairs/value-pairs.h"
 
-gboolean py_value_pairs_apply(ValuePairs *vp, const LogTemplateOptions *template_options, guint32 seq_num, LogMessage *msg, PyObject **result);
+typedef struct _PyValuePairsBatch PyValuePairsBatch;
+
+/* does not need the GIL */
+gboolean py_value_pairs_batch_add(PyValuePairsBatch *self, ValuePairs *vp, const LogTemplateOptions *template_options,
+                                  guint32 seq_num, LogMessage *msg);
+guint py_value_pairs_batch_get_length(PyValuePairsBatch *self);
+void py_value_pairs_batch_clear(PyValuePairsBatch *self);
+
+/* needs the GIL */
+PyObject *py_value_pairs_batch_get_dict(PyValuePairsBatch *self, guint index);
+
+PyValuePairsBatch *py_value_pairs_batch_new(void);
+void py_value_pairs_batch_free(PyValuePairsBatch *self);
 
 #endif
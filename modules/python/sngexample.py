@@ -24,7 +24,11 @@ class LogDestination(object):
         """Send a message to the target service
 
         It should return True to indicate success, False will suspend the
-        destination for a period specified by the time-reopen() option."""
+        destination for a period specified by the time-reopen() option.
+
+        Instead of send(), a send_batch(self, msgs) method may be defined:
+        it receives a list of up to batch-lines() messages at once and its
+        return value applies to the whole list."""
         pass
 
 
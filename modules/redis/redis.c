@@ -34,6 +34,17 @@
 #include "plugin-types.h"
 #include "logthrdestdrv.h"
 
+/* the connection and the formatting buffers of each worker thread */
+typedef struct
+{
+  redisContext *c;
+  GString *key_str;
+  GString *param1_str;
+  GString *param2_str;
+  /* commands sent, but whose reply has not been read yet */
+  gint pending;
+} RedisWorker;
+
 typedef struct
 {
   LogThrDestDriver super;
@@ -45,13 +56,8 @@ typedef struct
 
   GString *command;
   LogTemplate *key;
-  GString *key_str;
   LogTemplate *param1;
-  GString *param1_str;
   LogTemplate *param2;
-  GString *param2_str;
-
-  redisContext *c;
 } RedisDriver;
 
 /*
@@ -128,31 +134,41 @@ redis_dd_format_persist_name(LogThrDestDriver *d)
   return persist_name;
 }
 
+static RedisWorker *
+redis_dd_get_worker(RedisDriver *self)
+{
+  return (RedisWorker *) log_threaded_dest_driver_get_worker(&self->super)->data;
+}
+
 static gboolean
 redis_dd_connect(RedisDriver *self, gboolean reconnect)
 {
+  RedisWorker *worker = redis_dd_get_worker(self);
   redisReply *reply;
-  
-  if (reconnect && (self->c != NULL))
+
+  if (reconnect && (worker->c != NULL))
     {
-      reply = redisCommand(self->c, "ping");
+      reply = redisCommand(worker->c, "ping");
 
       if (reply)
         freeReplyObject(reply);
 
-      if (!self->c->err)
+      if (!worker->c->err)
         return TRUE;
       else
-        self->c = redisConnect(self->host, self->port);
+        {
+          redisFree(worker->c);
+          worker->c = redisConnect(self->host, self->port);
+        }
     }
   else
-    self->c = redisConnect(self->host, self->port);
+    worker->c = redisConnect(self->host, self->port);
 
-  if (self->c->err)
+  if (worker->c->err)
     {
       msg_error("REDIS server error, suspending",
                 evt_tag_str("driver", self->super.super.super.id),
-                evt_tag_str("error", self->c->errstr),
+                evt_tag_str("error", worker->c->errstr),
                 evt_tag_int("time_reopen", self->super.time_reopen),
                 NULL);
       return FALSE;
@@ -167,85 +183,129 @@ redis_dd_connect(RedisDriver *self, gboolean reconnect)
 static void
 redis_dd_disconnect(LogThrDestDriver *s)
 {
-  RedisDriver *self = (RedisDriver *)s;
+  RedisWorker *worker = redis_dd_get_worker((RedisDriver *)s);
 
-  if (self->c)
-    redisFree(self->c);
-  self->c = NULL;
+  if (worker->c)
+    redisFree(worker->c);
+  worker->c = NULL;
+  worker->pending = 0;
 }
 
 /*
  * Worker thread
  */
 
+/*
+ * The commands are pipelined: insert() only appends them to the output
+ * buffer of hiredis, and flush() sends them at once and reads the replies.
+ * The number of commands in flight is set by batch-lines().
+ */
 static worker_insert_result_t
 redis_worker_insert(LogThrDestDriver *s, LogMessage *msg)
 {
   RedisDriver *self = (RedisDriver *)s;
-  redisReply *reply;
+  LogThrDestWorker *thr_worker = log_threaded_dest_driver_get_worker(s);
+  RedisWorker *worker = (RedisWorker *) thr_worker->data;
+  gint32 seq_num = log_threaded_dest_worker_get_seq_num(thr_worker);
   const char *argv[5];
   size_t argvlen[5];
   int argc = 2;
 
-  if (!redis_dd_connect(self, TRUE))
+  /* a ping would read the reply of a pipelined command */
+  if (worker->pending == 0 && !redis_dd_connect(self, TRUE))
     return WORKER_INSERT_RESULT_NOT_CONNECTED;
 
-  if (self->c->err)
+  if (worker->c->err)
     return WORKER_INSERT_RESULT_ERROR;
 
   log_template_format(self->key, msg, &self->template_options, LTZ_SEND,
-                      self->super.seq_num, NULL, self->key_str);
+                      seq_num, NULL, worker->key_str);
 
   if (self->param1)
     log_template_format(self->param1, msg, &self->template_options, LTZ_SEND,
-                        self->super.seq_num, NULL, self->param1_str);
+                        seq_num, NULL, worker->param1_str);
   if (self->param2)
     log_template_format(self->param2, msg, &self->template_options, LTZ_SEND,
-                        self->super.seq_num, NULL, self->param2_str);
+                        seq_num, NULL, worker->param2_str);
 
   argv[0] = self->command->str;
   argvlen[0] = self->command->len;
-  argv[1] = self->key_str->str;
-  argvlen[1] = self->key_str->len;
+  argv[1] = worker->key_str->str;
+  argvlen[1] = worker->key_str->len;
 
   if (self->param1)
     {
-      argv[2] = self->param1_str->str;
-      argvlen[2] = self->param1_str->len;
+      argv[2] = worker->param1_str->str;
+      argvlen[2] = worker->param1_str->len;
       argc++;
     }
 
   if (self->param2)
     {
-      argv[3] = self->param2_str->str;
-      argvlen[3] = self->param2_str->len;
+      argv[3] = worker->param2_str->str;
+      argvlen[3] = worker->param2_str->len;
       argc++;
     }
 
-  reply = redisCommandArgv(self->c, argc, argv, argvlen);
-
-  if (!reply)
+  if (redisAppendCommandArgv(worker->c, argc, argv, argvlen) != REDIS_OK)
     {
       msg_error("REDIS server error, suspending",
                 evt_tag_str("driver", self->super.super.super.id),
                 evt_tag_str("command", self->command->str),
-                evt_tag_str("key", self->key_str->str),
-                evt_tag_str("param1", self->param1_str->str),
-                evt_tag_str("param2", self->param2_str->str),
-                evt_tag_str("error", self->c->errstr),
+                evt_tag_str("key", worker->key_str->str),
+                evt_tag_str("error", worker->c->errstr),
                 evt_tag_int("time_reopen", self->super.time_reopen),
                 NULL);
       return WORKER_INSERT_RESULT_ERROR;
     }
+  worker->pending++;
 
-  msg_debug("REDIS command sent",
+  msg_debug("REDIS command queued",
             evt_tag_str("driver", self->super.super.super.id),
             evt_tag_str("command", self->command->str),
-            evt_tag_str("key", self->key_str->str),
-            evt_tag_str("param1", self->param1_str->str),
-            evt_tag_str("param2", self->param2_str->str),
+            evt_tag_str("key", worker->key_str->str),
+            evt_tag_str("param1", worker->param1_str->str),
+            evt_tag_str("param2", worker->param2_str->str),
             NULL);
-  freeReplyObject(reply);
+
+  return WORKER_INSERT_RESULT_QUEUED;
+}
+
+static worker_insert_result_t
+redis_worker_flush(LogThrDestDriver *s)
+{
+  RedisDriver *self = (RedisDriver *)s;
+  RedisWorker *worker = redis_dd_get_worker(self);
+  redisReply *reply;
+  gint i, pending = worker->pending;
+
+  worker->pending = 0;
+  for (i = 0; i < pending; i++)
+    {
+      if (redisGetReply(worker->c, (void **) &reply) != REDIS_OK)
+        {
+          msg_error("REDIS server error, suspending",
+                    evt_tag_str("driver", self->super.super.super.id),
+                    evt_tag_str("command", self->command->str),
+                    evt_tag_str("error", worker->c->errstr),
+                    evt_tag_int("replies_received", i),
+                    evt_tag_int("commands_sent", pending),
+                    evt_tag_int("time_reopen", self->super.time_reopen),
+                    NULL);
+          /* the commands replied to so far are done, the rest is retried */
+          log_threaded_dest_driver_accept_batch_prefix(s, i);
+          return WORKER_INSERT_RESULT_ERROR;
+        }
+
+      /* the command was executed, retrying would not help */
+      if (reply->type == REDIS_REPLY_ERROR)
+        msg_error("REDIS command failed",
+                  evt_tag_str("driver", self->super.super.super.id),
+                  evt_tag_str("command", self->command->str),
+                  evt_tag_str("error", reply->str),
+                  NULL);
+      freeReplyObject(reply);
+    }
 
   return WORKER_INSERT_RESULT_SUCCESS;
 }
@@ -254,14 +314,16 @@ static void
 redis_worker_thread_init(LogThrDestDriver *d)
 {
   RedisDriver *self = (RedisDriver *)d;
+  RedisWorker *worker = g_new0(RedisWorker, 1);
 
   msg_debug("Worker thread started",
             evt_tag_str("driver", self->super.super.super.id),
             NULL);
 
-  self->key_str = g_string_sized_new(1024);
-  self->param1_str = g_string_sized_new(1024);
-  self->param2_str = g_string_sized_new(1024);
+  worker->key_str = g_string_sized_new(1024);
+  worker->param1_str = g_string_sized_new(1024);
+  worker->param2_str = g_string_sized_new(1024);
+  log_threaded_dest_driver_get_worker(d)->data = worker;
 
   redis_dd_connect(self, FALSE);
 }
@@ -269,11 +331,14 @@ redis_worker_thread_init(LogThrDestDriver *d)
 static void
 redis_worker_thread_deinit(LogThrDestDriver *d)
 {
-  RedisDriver *self = (RedisDriver *)d;
-
-  g_string_free(self->key_str, TRUE);
-  g_string_free(self->param1_str, TRUE);
-  g_string_free(self->param2_str, TRUE);
+  LogThrDestWorker *thr_worker = log_threaded_dest_driver_get_worker(d);
+  RedisWorker *worker = (RedisWorker *) thr_worker->data;
+
+  g_string_free(worker->key_str, TRUE);
+  g_string_free(worker->param1_str, TRUE);
+  g_string_free(worker->param2_str, TRUE);
+  g_free(worker);
+  thr_worker->data = NULL;
 }
 
 /*
@@ -312,8 +377,6 @@ redis_dd_free(LogPipe *d)
   log_template_unref(self->key);
   log_template_unref(self->param1);
   log_template_unref(self->param2);
-  if (self->c)
-    redisFree(self->c);
 
   log_threaded_dest_driver_free(d);
 }
@@ -331,10 +394,12 @@ redis_dd_new(GlobalConfig *cfg)
   self->super.super.super.super.init = redis_dd_init;
   self->super.super.super.super.free_fn = redis_dd_free;
 
+  self->super.worker.multiple_workers_supported = TRUE;
   self->super.worker.thread_init = redis_worker_thread_init;
   self->super.worker.thread_deinit = redis_worker_thread_deinit;
   self->super.worker.disconnect = redis_dd_disconnect;
   self->super.worker.insert = redis_worker_insert;
+  self->super.worker.flush = redis_worker_flush;
 
   self->super.format.stats_instance = redis_dd_format_stats_instance;
   self->super.format.persist_name = redis_dd_format_persist_name;
@@ -40,6 +40,7 @@ static CfgLexerKeyword riemann_keywords[] = {
   { "metric",                   KW_METRIC },
   { "ttl",                      KW_TTL },
   { "attributes",               KW_ATTRIBUTES },
+  { "pipelining",               KW_PIPELINING },
 
   { "ca_file",                  KW_CA_FILE },
   { "cert_file",                KW_CERT_FILE },
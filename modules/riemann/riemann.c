@@ -40,6 +40,7 @@ typedef struct
   gint port;
   riemann_client_type_t type;
   guint timeout;
+  gboolean pipelining;
 
   struct
   {
@@ -67,7 +68,10 @@ typedef struct
   {
     riemann_event_t **list;
     gint n;
-    gint batch_size_max;
+    /* messages in the batch, including the ones left out of it */
+    gint num_messages;
+    /* with pipelining(yes): messages sent without reading the reply yet */
+    gint num_in_flight;
     GStaticMutex lock;
   } event;
 } RiemannDestDriver;
@@ -161,9 +165,7 @@ riemann_dd_set_field_attributes(LogDriver *d, ValuePairs *vp)
 void
 riemann_dd_set_flush_lines(LogDriver *d, gint lines)
 {
-  RiemannDestDriver *self = (RiemannDestDriver *)d;
-
-  self->event.batch_size_max = lines;
+  log_threaded_dest_driver_set_batch_lines(d, lines);
 }
 
 gboolean
@@ -190,6 +192,13 @@ riemann_dd_set_timeout(LogDriver *d, guint timeout)
   self->timeout = timeout;
 }
 
+void
+riemann_dd_set_pipelining(LogDriver *d, gboolean pipelining)
+{
+  RiemannDestDriver *self = (RiemannDestDriver *)d;
+  self->pipelining = pipelining;
+}
+
 void
 riemann_dd_set_tls_cacert(LogDriver *d, const gchar *path)
 {
@@ -258,6 +267,8 @@ riemann_dd_disconnect(LogThrDestDriver *s)
 
   riemann_client_disconnect(self->client);
   self->client = NULL;
+  /* the replies are lost, the batch in flight is rewound */
+  self->event.num_in_flight = 0;
 }
 
 static void
@@ -347,10 +358,18 @@ riemann_worker_init(LogPipe *s)
 
   _value_pairs_always_exclude_properties(self);
 
-  if (self->event.batch_size_max <= 0)
-    self->event.batch_size_max = 1;
+  if (self->pipelining && self->type == RIEMANN_CLIENT_UDP)
+    {
+      msg_error("Riemann pipelining(yes) needs a tcp or tls connection, replies are not sent over udp",
+                evt_tag_str("driver", self->super.super.super.id),
+                NULL);
+      return FALSE;
+    }
+
+  if (self->super.batch.lines <= 0)
+    self->super.batch.lines = 1;
   self->event.list = (riemann_event_t **)malloc (sizeof (riemann_event_t *) *
-                                                 self->event.batch_size_max);
+                                                 self->super.batch.lines);
 
   msg_verbose("Initializing Riemann destination",
               evt_tag_str("driver", self->super.super.super.id),
@@ -418,6 +437,18 @@ riemann_dd_field_add_attribute_vp(const gchar *name,
 static gboolean
 riemann_add_metric_to_event(RiemannDestDriver *self, riemann_event_t *event, LogMessage *msg, SBGString *str)
 {
+  gint64 metric;
+
+  if ((self->fields.metric->type_hint == TYPE_HINT_INT32 ||
+       self->fields.metric->type_hint == TYPE_HINT_INT64) &&
+      log_template_format_int64(self->fields.metric, msg, &self->template_options,
+                                self->super.seq_num, &metric))
+    {
+      riemann_event_set(event, RIEMANN_EVENT_FIELD_METRIC_S64, metric,
+                        RIEMANN_EVENT_FIELD_NONE);
+      return FALSE;
+    }
+
   log_template_format(self->fields.metric, msg, &self->template_options,
 		    LTZ_SEND, self->super.seq_num, NULL, sb_gstring_string(str));
 
@@ -548,26 +579,45 @@ riemann_worker_insert_one(RiemannDestDriver *self, LogMessage *msg)
       _append_event(self, event);
     }
 
+  self->event.num_messages++;
   sb_gstring_release(str);
 
+  /*
+   * A DROP would drop the whole batch, so the message is just left out of
+   * it, and acked along with the rest of the batch.
+   */
   if (need_drop)
-    return WORKER_INSERT_RESULT_DROP;
+    {
+      riemann_event_free(event);
+      stats_counter_inc(self->super.dropped_messages);
+      return WORKER_INSERT_RESULT_QUEUED;
+    }
 
   if (success)
-    return WORKER_INSERT_RESULT_SUCCESS;
+    return WORKER_INSERT_RESULT_QUEUED;
   else
     return WORKER_INSERT_RESULT_ERROR;
 }
 
+static void
+_free_events(RiemannDestDriver *self)
+{
+  gint i;
+
+  g_static_mutex_lock(&self->event.lock);
+  for (i = 0; i < self->event.n; i++)
+    riemann_event_free(self->event.list[i]);
+  self->event.n = 0;
+  self->event.num_messages = 0;
+  g_static_mutex_unlock(&self->event.lock);
+}
+
 static worker_insert_result_t
-riemann_worker_batch_flush(RiemannDestDriver *self)
+riemann_worker_batch_flush_oneshot(RiemannDestDriver *self)
 {
   riemann_message_t *message;
   int r;
 
-  if (!riemann_dd_connect(self, TRUE))
-    return WORKER_INSERT_RESULT_ERROR;
-
   message = riemann_message_new();
 
   g_static_mutex_lock(&self->event.lock);
@@ -581,39 +631,138 @@ riemann_worker_batch_flush(RiemannDestDriver *self)
    * and save as many messages as possible.
    */
   self->event.n = 0;
+  self->event.num_messages = 0;
   self->event.list = (riemann_event_t **)malloc (sizeof (riemann_event_t *) *
-                                                 self->event.batch_size_max);
+                                                 self->super.batch.lines);
   g_static_mutex_unlock(&self->event.lock);
 
+  /* the events are gone, but the batch is rewound and formatted again */
   if (r != 0)
-    return WORKER_INSERT_RESULT_DROP;
+    return WORKER_INSERT_RESULT_ERROR;
   else
     return WORKER_INSERT_RESULT_SUCCESS;
 }
 
+/*
+ * With pipelining(yes) the reply to a batch is only read by the next
+ * flush, so the next batch is built while the server processes the
+ * previous one.  The events are detached from the message before freeing
+ * it, so that the event list is kept for the next batch.
+ */
+static gboolean
+_send_events(RiemannDestDriver *self)
+{
+  riemann_message_t *message;
+  int r;
+
+  message = riemann_message_new();
+
+  g_static_mutex_lock(&self->event.lock);
+  riemann_message_set_events_n(message, self->event.n, self->event.list);
+  r = riemann_client_send_message(self->client, message);
+  message->n_events = 0;
+  message->events = NULL;
+  g_static_mutex_unlock(&self->event.lock);
+
+  riemann_message_free(message);
+
+  if (r != 0)
+    {
+      msg_error("Error sending events to Riemann",
+                evt_tag_str("driver", self->super.super.super.id),
+                evt_tag_errno("errno", -r),
+                NULL);
+      return FALSE;
+    }
+  return TRUE;
+}
+
+static gboolean
+_receive_reply(RiemannDestDriver *self)
+{
+  riemann_message_t *reply;
+  gboolean ok;
+
+  reply = riemann_client_recv_message(self->client);
+  if (!reply)
+    {
+      msg_error("Error receiving reply from Riemann",
+                evt_tag_str("driver", self->super.super.super.id),
+                evt_tag_errno("errno", errno),
+                NULL);
+      return FALSE;
+    }
+
+  ok = reply->has_ok && reply->ok;
+  if (!ok)
+    msg_error("Riemann server rejected the events",
+              evt_tag_str("driver", self->super.super.super.id),
+              evt_tag_str("error", reply->error ? reply->error : "unknown"),
+              NULL);
+  riemann_message_free(reply);
+  return ok;
+}
+
 static worker_insert_result_t
-riemann_worker_insert(LogThrDestDriver *s, LogMessage *msg)
+riemann_worker_batch_flush_pipelined(RiemannDestDriver *self)
 {
-  RiemannDestDriver *self = (RiemannDestDriver *)s;
-  worker_insert_result_t result;
+  gint num_messages;
 
-  result = riemann_worker_insert_one(self, msg);
+  if (self->event.num_in_flight > 0)
+    {
+      if (!_receive_reply(self))
+        goto error;
+
+      log_threaded_dest_driver_accept_batch_prefix(&self->super, self->event.num_in_flight);
+      self->event.num_in_flight = 0;
+    }
+
+  if (self->event.n == 0)
+    {
+      /* all messages of the batch were left out */
+      self->event.num_messages = 0;
+      return WORKER_INSERT_RESULT_SUCCESS;
+    }
 
-  if (self->event.n < self->event.batch_size_max)
-    return result;
+  num_messages = self->event.num_messages;
+  if (!_send_events(self))
+    goto error;
 
-  if (result != WORKER_INSERT_RESULT_SUCCESS)
-    return result;
+  _free_events(self);
+  self->event.num_in_flight = num_messages;
+  return WORKER_INSERT_RESULT_QUEUED;
 
-  return riemann_worker_batch_flush(self);
+ error:
+  _free_events(self);
+  self->event.num_in_flight = 0;
+  return WORKER_INSERT_RESULT_ERROR;
 }
 
-static void
-riemann_worker_thread_deinit(LogThrDestDriver *s)
+static worker_insert_result_t
+riemann_worker_batch_flush(RiemannDestDriver *self)
 {
-  RiemannDestDriver *self = (RiemannDestDriver *)s;
+  if (!riemann_dd_connect(self, TRUE))
+    {
+      /* the batch is rewound and formatted again */
+      _free_events(self);
+      return WORKER_INSERT_RESULT_ERROR;
+    }
+
+  if (self->pipelining)
+    return riemann_worker_batch_flush_pipelined(self);
+  return riemann_worker_batch_flush_oneshot(self);
+}
+
+static worker_insert_result_t
+riemann_worker_insert(LogThrDestDriver *s, LogMessage *msg)
+{
+  return riemann_worker_insert_one((RiemannDestDriver *)s, msg);
+}
 
-  riemann_worker_batch_flush(self);
+static worker_insert_result_t
+riemann_worker_flush(LogThrDestDriver *s)
+{
+  return riemann_worker_batch_flush((RiemannDestDriver *)s);
 }
 
 /*
@@ -633,6 +782,11 @@ riemann_dd_free(LogPipe *d)
   log_template_options_destroy(&self->template_options);
 
   riemann_client_free(self->client);
+  if (self->event.list)
+    {
+      _free_events(self);
+      free(self->event.list);
+    }
 
   log_template_unref(self->fields.host);
   log_template_unref(self->fields.service);
@@ -658,7 +812,7 @@ riemann_dd_new(GlobalConfig *cfg)
 
   self->super.worker.disconnect = riemann_dd_disconnect;
   self->super.worker.insert = riemann_worker_insert;
-  self->super.worker.thread_deinit = riemann_worker_thread_deinit;
+  self->super.worker.flush = riemann_worker_flush;
 
   self->super.format.stats_instance = riemann_dd_format_stats_instance;
   self->super.format.persist_name = riemann_dd_format_persist_name;
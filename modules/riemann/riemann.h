@@ -47,5 +47,6 @@ void riemann_dd_set_tls_cert(LogDriver *d, const gchar *path);
 void riemann_dd_set_tls_key(LogDriver *d, const gchar *path);
 void riemann_dd_set_flush_lines(LogDriver *d, gint lines);
 void riemann_dd_set_timeout(LogDriver *d, guint timeout);
+void riemann_dd_set_pipelining(LogDriver *d, gboolean pipelining);
 
 #endif
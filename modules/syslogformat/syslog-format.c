@@ -30,15 +30,75 @@
 #include "str-format.h"
 #include "utf8utils.h"
 #include "str-utils.h"
+#include "tls-support.h"
 
 #include <regex.h>
 #include <ctype.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define HEADER_SPACES_SSE2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define HEADER_SPACES_NEON 1
+#endif
+
 static const char aix_fwd_string[] = "Message forwarded from ";
 static const char repeat_msg_string[] = "last message repeated";
 static NVHandle is_synced;
 static NVHandle cisco_seqid;
+static NVHandle raw_message;
+
+/*
+ * Per-thread, direct mapped cache of (SD-ID, PARAM-NAME) -> NVHandle, so
+ * that the SD elements sent in every message are resolved without
+ * building their .SDATA.<id>.<param> name and looking it up in the
+ * registry.  Handles are never freed while the registry exists, so
+ * entries need not be invalidated.
+ */
+#define SD_HANDLE_CACHE_SIZE 64
+
+typedef struct _SDHandleCacheEntry
+{
+  NVHandle handle;
+  guint8 sd_id_len;
+  guint8 sd_param_len;
+  /* SD-ID followed by the PARAM-NAME, both at most 32 characters */
+  gchar key[64];
+} SDHandleCacheEntry;
+
+/*
+ * The last timestamp parsed by this thread, keyed on its raw bytes.  The
+ * key extends DATE_CACHE_LOOKAHEAD bytes beyond the parsed timestamp (or
+ * up to the end of the message), which covers the lookahead of all the
+ * timestamp scanners, so a matching key produces the same result.  The
+ * result of a BSD timestamp depends on the current time (year and DST
+ * guessing), so entries are only valid within the same second.
+ */
+#define DATE_CACHE_LOOKAHEAD 8
+#define DATE_CACHE_KEY_MAX 64
+
+typedef struct _DateCacheEntry
+{
+  glong now;
+  glong assume_timezone;
+  guint parse_flags;
+  gint consumed;
+  gint key_len;
+  guchar key[DATE_CACHE_KEY_MAX];
+  LogStamp stamp;
+} DateCacheEntry;
+
+TLS_BLOCK_START
+{
+  SDHandleCacheEntry sd_handle_cache[SD_HANDLE_CACHE_SIZE];
+  DateCacheEntry date_cache;
+}
+TLS_BLOCK_END;
+
+#define sd_handle_cache __tls_deref(sd_handle_cache)
+#define date_cache      __tls_deref(date_cache)
 
 static gboolean
 log_msg_parse_pri(LogMessage *self, const guchar **data, gint *length, guint flags, guint16 default_pri)
@@ -143,15 +203,102 @@ log_msg_parse_skip_chars_until(LogMessage *self, const guchar **data, gint *leng
   return num_skipped;
 }
 
+/*
+ * The RFC5424 header fields after the timestamp are separated by single
+ * spaces, their positions within the first HEADER_SPACES_MAX bytes are
+ * found in one pass and stored in a bitmap, so that each field is then
+ * located without scanning it again.
+ */
+#define HEADER_SPACES_MAX 128
+
+typedef struct _HeaderSpaces
+{
+  const guchar *base, *end;
+  gint len;
+  guint64 mask[HEADER_SPACES_MAX / 64];
+} HeaderSpaces;
+
+static void
+header_spaces_find(HeaderSpaces *self, const guchar *data, gint length)
+{
+  gint i = 0;
+
+  self->base = data;
+  self->end = data + length;
+  self->len = MIN(length, HEADER_SPACES_MAX);
+  memset(self->mask, 0, sizeof(self->mask));
+
+#if HEADER_SPACES_SSE2
+  {
+    const __m128i space = _mm_set1_epi8(' ');
+
+    for (; i + 16 <= self->len; i += 16)
+      {
+        __m128i block = _mm_loadu_si128((const __m128i *) (data + i));
+        guint64 bits = (guint16) _mm_movemask_epi8(_mm_cmpeq_epi8(block, space));
+
+        self->mask[i / 64] |= bits << (i % 64);
+      }
+  }
+#elif HEADER_SPACES_NEON
+  {
+    static const guint8 bit_weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    const uint8x16_t space = vdupq_n_u8(' ');
+    const uint8x16_t weights = vld1q_u8(bit_weights);
+
+    for (; i + 16 <= self->len; i += 16)
+      {
+        uint8x16_t match = vandq_u8(vceqq_u8(vld1q_u8(data + i), space), weights);
+        guint64 bits = vaddv_u8(vget_low_u8(match)) | (vaddv_u8(vget_high_u8(match)) << 8);
+
+        self->mask[i / 64] |= bits << (i % 64);
+      }
+  }
+#endif
+
+  for (; i < self->len; i++)
+    {
+      if (data[i] == ' ')
+        self->mask[i / 64] |= G_GUINT64_CONSTANT(1) << (i % 64);
+    }
+}
+
+/* returns the first space at or after @p, falling back to memchr() beyond the scanned part */
+static const guchar *
+header_spaces_next(HeaderSpaces *self, const guchar *p)
+{
+  gint pos = p - self->base;
+
+  while (pos < self->len)
+    {
+      guint64 word = self->mask[pos / 64] >> (pos % 64);
+
+      if (word)
+        {
+          pos += __builtin_ctzll(word);
+          if (pos < self->len)
+            return self->base + pos;
+          break;
+        }
+      pos = (pos / 64 + 1) * 64;
+    }
+
+  p = MAX(p, self->base + self->len);
+  if (p >= self->end)
+    return NULL;
+  return memchr(p, ' ', self->end - p);
+}
+
 static void
-log_msg_parse_column(LogMessage *self, NVHandle handle, const guchar **data, gint *length, gint max_length)
+log_msg_parse_column(LogMessage *self, NVHandle handle, HeaderSpaces *spaces,
+                     const guchar **data, gint *length, gint max_length)
 {
   const guchar *src, *space;
   gint left;
 
   src = *data;
   left = *length;
-  space = memchr(src, ' ', left);
+  space = header_spaces_next(spaces, src);
   if (space)
     {
       left -= space - src;
@@ -233,6 +380,38 @@ __is_iso_stamp(const gchar *stamp, gint length)
          );
 }
 
+#define __iso_digits2(p) (((p)[0] - '0') * 10 + (p)[1] - '0')
+
+/*
+ * YYYY-MM-DDTHH:MM:SS with all digits present, the separators are
+ * already checked by __is_iso_stamp().  Anything else (e.g. space padded
+ * fields) is left to scan_iso_timestamp().
+ */
+static gboolean
+__scan_iso_stamp_fixed(const guchar **data, gint *length, struct tm *tm)
+{
+  static const guint8 digit_offsets[] = { 0, 1, 2, 3, 5, 6, 8, 9, 11, 12, 14, 15, 17, 18 };
+  const guchar *src = *data;
+  gint i;
+
+  for (i = 0; i < G_N_ELEMENTS(digit_offsets); i++)
+    {
+      if ((guchar) (src[digit_offsets[i]] - '0') > 9)
+        return FALSE;
+    }
+
+  tm->tm_year = __iso_digits2(src) * 100 + __iso_digits2(src + 2) - 1900;
+  tm->tm_mon = __iso_digits2(src + 5) - 1;
+  tm->tm_mday = __iso_digits2(src + 8);
+  tm->tm_hour = __iso_digits2(src + 11);
+  tm->tm_min = __iso_digits2(src + 14);
+  tm->tm_sec = __iso_digits2(src + 17);
+
+  *data = src + 19;
+  *length -= 19;
+  return TRUE;
+}
+
 static guint32
 __parse_usec(const guchar **data, gint *length)
 {
@@ -292,7 +471,8 @@ __parse_iso_stamp(const GTimeVal *now, LogMessage *self, struct tm* tm, const gu
    * time-zone barriers */
 
   cached_localtime(&now_tv_sec, tm);
-  if (!scan_iso_timestamp((const gchar **) &src, length, tm))
+  if (!__scan_iso_stamp_fixed(&src, length, tm) &&
+      !scan_iso_timestamp((const gchar **) &src, length, tm))
     {
       return FALSE;
     }
@@ -419,12 +599,58 @@ __get_normalized_time(LogStamp const timestamp, gint const normalized_hour, gint
          - timestamp.zone_offset;
 }
 
+static gboolean
+__lookup_cached_date(LogMessage *self, const guchar **data, gint *length, guint parse_flags,
+                     glong assume_timezone, const GTimeVal *now)
+{
+  DateCacheEntry *entry = &date_cache;
+
+  if (entry->key_len == 0 ||
+      entry->now != now->tv_sec ||
+      entry->assume_timezone != assume_timezone ||
+      entry->parse_flags != (parse_flags & LP_SYSLOG_PROTOCOL) ||
+      self->timestamps[LM_TS_STAMP].zone_offset != -1)
+    return FALSE;
+
+  if (entry->key_len > *length ||
+      (entry->key_len < entry->consumed + DATE_CACHE_LOOKAHEAD && entry->key_len != *length) ||
+      memcmp(entry->key, *data, entry->key_len) != 0)
+    return FALSE;
+
+  self->timestamps[LM_TS_STAMP] = entry->stamp;
+  *data += entry->consumed;
+  *length -= entry->consumed;
+  return TRUE;
+}
+
+static void
+__store_cached_date(LogMessage *self, const guchar *date, gint date_len, gint consumed, guint parse_flags,
+                    glong assume_timezone, const GTimeVal *now)
+{
+  DateCacheEntry *entry = &date_cache;
+  gint key_len = MIN(consumed + DATE_CACHE_LOOKAHEAD, date_len);
+
+  if (key_len > DATE_CACHE_KEY_MAX)
+    return;
+
+  entry->now = now->tv_sec;
+  entry->assume_timezone = assume_timezone;
+  entry->parse_flags = parse_flags & LP_SYSLOG_PROTOCOL;
+  entry->consumed = consumed;
+  entry->key_len = key_len;
+  memcpy(entry->key, date, key_len);
+  entry->stamp = self->timestamps[LM_TS_STAMP];
+}
+
 /* FIXME: this function should really be exploded to a lot of smaller functions... (Bazsi) */
 static gboolean
 log_msg_parse_date(LogMessage *self, const guchar **data, gint *length, guint parse_flags, glong assume_timezone)
 {
   const guchar *src = *data;
   gint left = *length;
+  const guchar *date_start;
+  gint date_len;
+  gboolean cacheable;
   GTimeVal now;
   struct tm tm;
   gint unnormalized_hour;
@@ -448,6 +674,17 @@ log_msg_parse_date(LogMessage *self, const guchar **data, gint *length, guint pa
           left--;
         }
     }
+
+  if (__lookup_cached_date(self, &src, &left, parse_flags, assume_timezone, &now))
+    {
+      *data = src;
+      *length = left;
+      return TRUE;
+    }
+  date_start = src;
+  date_len = left;
+  cacheable = (self->timestamps[LM_TS_STAMP].zone_offset == -1);
+
   /* If the next chars look like a date, then read them as a date. */
   if (__is_iso_stamp((const gchar *)src, left))
     {
@@ -481,6 +718,9 @@ log_msg_parse_date(LogMessage *self, const guchar **data, gint *length, guint pa
   __set_zone_offset(&(self->timestamps[LM_TS_STAMP]), assume_timezone);
   self->timestamps[LM_TS_STAMP].tv_sec = __get_normalized_time(self->timestamps[LM_TS_STAMP], tm.tm_hour, unnormalized_hour);
 
+  if (cacheable)
+    __store_cached_date(self, date_start, date_len, date_len - left, parse_flags, assume_timezone, &now);
+
   *data = src;
   *length = left;
   return TRUE;
@@ -672,8 +912,69 @@ sd_step_and_store(LogMessage *self, const guchar **data, gint *left)
  * message for structured data elements and store the parsed information
  * in @self.values and dup the SD string. Parsing is affected by the bits set @flags argument.
  **/
+
+/* see the description of sd_handle_cache at the top of the file */
+static NVHandle
+log_msg_lookup_sd_handle(const gchar *sd_id, gsize sd_id_len, const gchar *sd_param, gsize sd_param_len)
+{
+  SDHandleCacheEntry *entry;
+  /* .SDATA. prefix, SD-ID, '.', PARAM-NAME and the terminating NUL */
+  gchar sd_value_name[7 + 32 + 1 + 32 + 1];
+  guint32 hash = 2166136261U;
+  gsize i;
+
+  for (i = 0; i < sd_id_len; i++)
+    hash = (hash ^ (guchar) sd_id[i]) * 16777619U;
+  hash = (hash ^ '.') * 16777619U;
+  for (i = 0; i < sd_param_len; i++)
+    hash = (hash ^ (guchar) sd_param[i]) * 16777619U;
+
+  entry = &sd_handle_cache[hash % SD_HANDLE_CACHE_SIZE];
+  if (entry->handle &&
+      entry->sd_id_len == sd_id_len && entry->sd_param_len == sd_param_len &&
+      memcmp(entry->key, sd_id, sd_id_len) == 0 &&
+      memcmp(entry->key + sd_id_len, sd_param, sd_param_len) == 0)
+    return entry->handle;
+
+  memcpy(sd_value_name, logmsg_sd_prefix, logmsg_sd_prefix_len);
+  memcpy(sd_value_name + logmsg_sd_prefix_len, sd_id, sd_id_len);
+  i = logmsg_sd_prefix_len + sd_id_len;
+  if (sd_param_len)
+    {
+      sd_value_name[i++] = '.';
+      memcpy(sd_value_name + i, sd_param, sd_param_len);
+      i += sd_param_len;
+    }
+  sd_value_name[i] = 0;
+
+  entry->handle = log_msg_get_value_handle(sd_value_name);
+  entry->sd_id_len = sd_id_len;
+  entry->sd_param_len = sd_param_len;
+  memcpy(entry->key, sd_id, sd_id_len);
+  memcpy(entry->key + sd_id_len, sd_param, sd_param_len);
+  return entry->handle;
+}
+
+/*
+ * If the raw message was stored in RAWMSG, SDATA values that need no
+ * unescaping are stored as indirect values pointing into it instead of
+ * copying them once more.
+ */
+static void
+log_msg_set_sd_param_value(LogMessage *self, NVHandle handle,
+                           const gchar *value, gsize value_len,
+                           const guchar *raw_data, const guchar *raw_value, gboolean escaped)
+{
+  if (raw_data && !escaped && (raw_value - raw_data) + value_len <= G_MAXUINT16)
+    log_msg_set_value_indirect(self, handle, raw_message, 0,
+                               raw_value - raw_data, value_len);
+  else
+    log_msg_set_value(self, handle, value, value_len);
+}
+
 static gboolean
-log_msg_parse_sd(LogMessage *self, const guchar **data, gint *length, const MsgFormatOptions *options)
+log_msg_parse_sd(LogMessage *self, const guchar **data, gint *length, const MsgFormatOptions *options,
+                 const guchar *raw_data)
 {
   /*
    * STRUCTURED-DATA = NILVALUE / 1*SD-ELEMENT
@@ -697,11 +998,13 @@ log_msg_parse_sd(LogMessage *self, const guchar **data, gint *length, const MsgF
   gchar sd_id_name[33];
   gsize sd_id_len;
   gchar sd_param_name[33];
+  gsize sd_param_len;
 
   /* UTF-8 string */
   gchar sd_param_value[options->sdata_param_value_max + 1];
   gsize sd_param_value_len;
-  gchar sd_value_name[66];
+  const guchar *sd_param_value_start = NULL;
+  gboolean sd_param_value_escaped = FALSE;
 
   guint open_sd = 0;
   gint left = *length, pos;
@@ -749,17 +1052,8 @@ log_msg_parse_sd(LogMessage *self, const guchar **data, gint *length, const MsgF
 
           sd_id_name[pos] = 0;
           sd_id_len = pos;
-          strcpy(sd_value_name, logmsg_sd_prefix);
-          /* this strcat is safe, as sd_id_name is at most 32 chars */
-          strncpy(sd_value_name + logmsg_sd_prefix_len, sd_id_name, sizeof(sd_value_name) - logmsg_sd_prefix_len);
           if (*src == ']')
-            {
-              log_msg_set_value_by_name(self, sd_value_name, "", 0);
-            }
-          else
-            {
-              sd_value_name[logmsg_sd_prefix_len + pos] = '.';
-            }
+            log_msg_set_value(self, log_msg_lookup_sd_handle(sd_id_name, sd_id_len, NULL, 0), "", 0);
 
           /* read sd-element */
           while (left && *src != ']')
@@ -793,7 +1087,7 @@ log_msg_parse_sd(LogMessage *self, const guchar **data, gint *length, const MsgF
                   sd_step_and_store(self, &src, &left);
                 }
               sd_param_name[pos] = 0;
-              strncpy(&sd_value_name[logmsg_sd_prefix_len + 1 + sd_id_len], sd_param_name, sizeof(sd_value_name) - logmsg_sd_prefix_len - 1 - sd_id_len);
+              sd_param_len = pos;
 
               if (left && *src == '=')
                 sd_step_and_store(self, &src, &left);
@@ -808,12 +1102,15 @@ log_msg_parse_sd(LogMessage *self, const guchar **data, gint *length, const MsgF
                   /* opening quote */
                   sd_step_and_store(self, &src, &left);
                   pos = 0;
+                  sd_param_value_start = src;
+                  sd_param_value_escaped = FALSE;
 
                   while (left && (*src != '"' || quote))
                     {
                       if (!quote && *src == '\\')
                         {
                           quote = TRUE;
+                          sd_param_value_escaped = TRUE;
                         }
                       else
                        {
@@ -848,7 +1145,10 @@ log_msg_parse_sd(LogMessage *self, const guchar **data, gint *length, const MsgF
                   goto error;
                 }
 
-              log_msg_set_value_by_name(self, sd_value_name, sd_param_value, sd_param_value_len);
+              log_msg_set_sd_param_value(self,
+                                         log_msg_lookup_sd_handle(sd_id_name, sd_id_len, sd_param_name, sd_param_len),
+                                         sd_param_value, sd_param_value_len,
+                                         raw_data, sd_param_value_start, sd_param_value_escaped);
             }
 
           if (left && *src == ']')
@@ -982,7 +1282,7 @@ log_msg_parse_legacy(const MsgFormatOptions *parse_options,
       self->timestamps[LM_TS_STAMP] = self->timestamps[LM_TS_RECVD];
     }
 
-  if (parse_options->flags & LP_SANITIZE_UTF8 && !g_utf8_validate((gchar *) src, left, NULL))
+  if (parse_options->flags & LP_SANITIZE_UTF8 && !utf8_validate((gchar *) src, left))
     {
       GString sanitized_message;
       gchar buf[left * 6 + 1];
@@ -1006,7 +1306,7 @@ log_msg_parse_legacy(const MsgFormatOptions *parse_options,
       /* we don't need revalidation if sanitize already said it was valid utf8 */
       if ((parse_options->flags & LP_VALIDATE_UTF8) &&
           ((parse_options->flags & LP_SANITIZE_UTF8) == 0) &&
-          g_utf8_validate((gchar *) src, left, NULL))
+          utf8_validate((gchar *) src, left))
         self->flags |= LF_UTF8;
     }
 
@@ -1035,6 +1335,8 @@ log_msg_parse_syslog_proto(const MsgFormatOptions *parse_options, const guchar *
   gint left;
   const guchar *hostname_start = NULL;
   gint hostname_len = 0;
+  const guchar *raw_data = NULL;
+  HeaderSpaces spaces;
 
   src = (guchar *) data;
   left = length;
@@ -1069,23 +1371,27 @@ log_msg_parse_syslog_proto(const MsgFormatOptions *parse_options, const guchar *
       log_msg_set_value(self, LM_V_HOST, (gchar *) hostname_start, hostname_len);
     }
 
+  header_spaces_find(&spaces, src, left);
+
   /* application name 48 ascii*/
-  log_msg_parse_column(self, LM_V_PROGRAM, &src, &left, 48);
+  log_msg_parse_column(self, LM_V_PROGRAM, &spaces, &src, &left, 48);
   if (!log_msg_parse_skip_space(self, &src, &left))
     return FALSE;
 
   /* process id 128 ascii */
-  log_msg_parse_column(self, LM_V_PID, &src, &left, 128);
+  log_msg_parse_column(self, LM_V_PID, &spaces, &src, &left, 128);
   if (!log_msg_parse_skip_space(self, &src, &left))
     return FALSE;
 
   /* message id 32 ascii */
-  log_msg_parse_column(self, LM_V_MSGID, &src, &left, 32);
+  log_msg_parse_column(self, LM_V_MSGID, &spaces, &src, &left, 32);
   if (!log_msg_parse_skip_space(self, &src, &left))
     return FALSE;
 
   /* structured data part */
-  if (!log_msg_parse_sd(self, &src, &left, parse_options))
+  if ((parse_options->flags & LP_STORE_RAW_MESSAGE) && log_msg_is_value_set(self, raw_message))
+    raw_data = data;
+  if (!log_msg_parse_sd(self, &src, &left, parse_options, raw_data))
     return FALSE;
 
   /* checking if there are remaining data in log message */
@@ -1108,7 +1414,7 @@ log_msg_parse_syslog_proto(const MsgFormatOptions *parse_options, const guchar *
       src += 3;
       left -= 3;
     }
-  else if ((parse_options->flags & LP_VALIDATE_UTF8) && g_utf8_validate((gchar *) src, left, NULL))
+  else if ((parse_options->flags & LP_VALIDATE_UTF8) && utf8_validate((gchar *) src, left))
     {
       self->flags |= LF_UTF8;
     }
@@ -1128,6 +1434,9 @@ syslog_format_handler(const MsgFormatOptions *parse_options,
   while (length > 0 && (data[length - 1] == '\n' || data[length - 1] == '\0'))
     length--;
 
+  if (parse_options->flags & LP_STORE_RAW_MESSAGE)
+    log_msg_set_value(self, raw_message, (gchar *) data, length);
+
   if (parse_options->flags & LP_NOPARSE)
     {
       log_msg_set_value(self, LM_V_MESSAGE, (gchar *) data, length);
@@ -1178,6 +1487,7 @@ syslog_format_init(void)
     {
       is_synced = log_msg_get_value_handle(".SDATA.timeQuality.isSynced");
       cisco_seqid = log_msg_get_value_handle(".SDATA.meta.sequenceId");
+      raw_message = log_msg_get_value_handle("RAWMSG");
       handles_initialized = TRUE;
     }
 }
@@ -43,6 +43,9 @@
 #define DEFAULT_PRIO (LOG_LOCAL0 | LOG_NOTICE)
 #define DEFAULT_FETCH_LIMIT 10
 
+/* upper limit on the number of distinct journal field names we cache handles for */
+#define MAX_CACHED_FIELDS 1024
+
 static gboolean journal_reader_initialized = FALSE;
 
 typedef struct _JournalReaderState {
@@ -56,6 +59,23 @@ typedef struct _JournalBookmarkData
   gchar *cursor;
 } JournalBookmarkData;
 
+typedef enum
+{
+  JF_NONE,
+  JF_MESSAGE,
+  JF_HOSTNAME,
+  JF_PID,
+  JF_FACILITY,
+  JF_PRIORITY,
+} JournalFieldKind;
+
+/* what we know about a journal field name, kept across entries */
+typedef struct _JournalFieldMapping
+{
+  NVHandle handle;
+  JournalFieldKind kind;
+} JournalFieldMapping;
+
 struct _JournalReader {
   LogSource super;
   LogPipe *control;
@@ -72,6 +92,11 @@ struct _JournalReader {
   PersistState *persist_state;
   PersistEntryHandle persist_handle;
   gchar *persist_name;
+
+  /* field name -> JournalFieldMapping, only accessed by the fetching thread */
+  GHashTable *field_mappings;
+  NVHandle syslog_identifier_handle;
+  NVHandle comm_handle;
 };
 
 static void
@@ -150,31 +175,47 @@ _reader_wakeup(LogSource *s)
     iv_event_post(&self->schedule_wakeup);
 }
 
-static void
-_map_key_value_pairs_to_syslog_macros(LogMessage *msg, gchar *key, gchar *value, gssize value_len)
+static JournalFieldKind
+_get_field_kind(const gchar *key)
 {
   if (strcmp(key, "MESSAGE") == 0)
+    return JF_MESSAGE;
+  else if (strcmp(key, "_HOSTNAME") == 0)
+    return JF_HOSTNAME;
+  else if (strcmp(key, "_PID") == 0)
+    return JF_PID;
+  else if (strcmp(key, "SYSLOG_FACILITY") == 0)
+    return JF_FACILITY;
+  else if (strcmp(key, "PRIORITY") == 0)
+    return JF_PRIORITY;
+  return JF_NONE;
+}
+
+static void
+_map_key_value_pairs_to_syslog_macros(LogMessage *msg, JournalFieldKind kind, gchar *value, gssize value_len)
+{
+  switch (kind)
     {
+    case JF_MESSAGE:
       log_msg_set_value(msg, LM_V_MESSAGE, value, value_len);
       msg_debug("Incoming log entry from journal",
                 evt_tag_printf("message", "%.*s", (int)value_len, value),
                 NULL);
-    }
-  else if (strcmp(key, "_HOSTNAME") == 0)
-    {
+      break;
+    case JF_HOSTNAME:
       log_msg_set_value(msg, LM_V_HOST, value, value_len);
-    }
-  else if (strcmp(key, "_PID") == 0)
-    {
+      break;
+    case JF_PID:
       log_msg_set_value(msg, LM_V_PID, value, value_len);
-    }
-  else if (strcmp(key, "SYSLOG_FACILITY") == 0)
-    {
+      break;
+    case JF_FACILITY:
       msg->pri = (msg->pri & 7) | atoi(value) << 3;
-    }
-  else if (strcmp(key, "PRIORITY") == 0)
-    {
+      break;
+    case JF_PRIORITY:
       msg->pri = (msg->pri & ~7) | atoi(value);
+      break;
+    default:
+      break;
     }
 }
 
@@ -188,22 +229,40 @@ _format_value_name_with_prefix(gchar *buf, gsize buf_len, JournalReaderOptions *
   g_strlcpy(buf + cont, key, buf_len - cont);
 }
 
-static void
-_set_value_in_message(JournalReaderOptions *options, LogMessage *msg, gchar *key, gchar *value, gssize value_len)
+static NVHandle
+_get_value_handle_with_prefix(JournalReaderOptions *options, const gchar *key)
 {
   gchar name_with_prefix[256];
 
   _format_value_name_with_prefix(name_with_prefix, sizeof(name_with_prefix), options, key);
-  log_msg_set_value_by_name(msg, name_with_prefix, value, value_len);
+  return log_msg_get_value_handle(name_with_prefix);
 }
 
-static const gchar*
-_get_value_from_message(JournalReaderOptions *options, LogMessage *msg,  gchar *key, gssize *value_length)
+/*
+ * The same few dozen field names occur in every journal entry: resolve
+ * each of them to its NVHandle (which takes the lock of the registry)
+ * and its meaning only once, instead of for every entry.
+ */
+static JournalFieldMapping *
+_lookup_field_mapping(JournalReader *self, const gchar *key, JournalFieldMapping *uncached)
 {
-  gchar name_with_prefix[256];
+  JournalFieldMapping *mapping;
 
-  _format_value_name_with_prefix(name_with_prefix, sizeof(name_with_prefix), options, key);
-  return log_msg_get_value_by_name(msg, name_with_prefix, value_length);
+  mapping = g_hash_table_lookup(self->field_mappings, key);
+  if (mapping)
+    return mapping;
+
+  if (g_hash_table_size(self->field_mappings) < MAX_CACHED_FIELDS)
+    {
+      mapping = g_new0(JournalFieldMapping, 1);
+      g_hash_table_insert(self->field_mappings, g_strdup(key), mapping);
+    }
+  else
+    mapping = uncached;
+
+  mapping->handle = _get_value_handle_with_prefix(self->options, key);
+  mapping->kind = _get_field_kind(key);
+  return mapping;
 }
 
 static void
@@ -212,18 +271,20 @@ _handle_data(gchar *key, gchar *value, gpointer user_data)
   gpointer *args = user_data;
 
   LogMessage *msg = args[0];
-  JournalReaderOptions *options = args[1];
-  gssize value_len = MIN(strlen(value), options->max_field_size);
+  JournalReader *self = args[1];
+  JournalFieldMapping uncached;
+  JournalFieldMapping *mapping = _lookup_field_mapping(self, key, &uncached);
+  gssize value_len = MIN(strlen(value), self->options->max_field_size);
 
-  _map_key_value_pairs_to_syslog_macros(msg, key, value, value_len);
-  _set_value_in_message(options, msg, key, value, value_len);
+  _map_key_value_pairs_to_syslog_macros(msg, mapping->kind, value, value_len);
+  log_msg_set_value(msg, mapping->handle, value, value_len);
 }
 
 static void
-_set_program(JournalReaderOptions *options, LogMessage *msg)
+_set_program(JournalReader *self, LogMessage *msg)
 {
   gssize value_length = 0;
-  const gchar *value = _get_value_from_message(options, msg, "SYSLOG_IDENTIFIER", &value_length);
+  const gchar *value = log_msg_get_value(msg, self->syslog_identifier_handle, &value_length);
 
   if (value_length > 0)
     {
@@ -231,7 +292,7 @@ _set_program(JournalReaderOptions *options, LogMessage *msg)
     }
   else
     {
-      value = _get_value_from_message(options, msg, "_COMM", &value_length);
+      value = log_msg_get_value(msg, self->comm_handle, &value_length);
       log_msg_set_value(msg, LM_V_PROGRAM, value, value_length);
     }
 }
@@ -258,11 +319,11 @@ _handle_message(JournalReader *self)
 
   msg->pri = self->options->default_pri;
 
-  gpointer args[] = {msg, self->options};
+  gpointer args[] = {msg, self};
 
   journald_foreach_data(self->journal, _handle_data, args);
   _set_message_timestamp(self, msg);
-  _set_program(self->options, msg);
+  _set_program(self, msg);
 
   log_source_post(&self->super, msg);
   return log_source_free_to_send(&self->super);
@@ -562,6 +623,7 @@ _free(LogPipe *s)
   log_pipe_unref(self->control);
   log_source_free(&self->super.super);
   g_free(self->persist_name);
+  g_hash_table_destroy(self->field_mappings);
   return;
 }
 
@@ -576,6 +638,11 @@ journal_reader_set_options(LogPipe *s, LogPipe *control, JournalReaderOptions *o
   log_pipe_ref(control);
   self->control = control;
   self->options = options;
+
+  /* the cached handles depend on prefix() */
+  g_hash_table_remove_all(self->field_mappings);
+  self->syslog_identifier_handle = _get_value_handle_with_prefix(options, "SYSLOG_IDENTIFIER");
+  self->comm_handle = _get_value_handle_with_prefix(options, "_COMM");
 }
 
 static void
@@ -607,6 +674,7 @@ journal_reader_new(GlobalConfig *cfg, Journald *journal)
   self->super.super.free_fn = _free;
   self->persist_name = g_strdup("systemd-journal");
   self->journal = journal;
+  self->field_mappings = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
   _init_watches(self);
   return self;
 }
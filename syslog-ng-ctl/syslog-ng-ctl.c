@@ -96,10 +96,18 @@ slng_verbose(int argc, char *argv[], const gchar *mode)
 }
 
 static gboolean stats_options_reset_is_set = FALSE;
+static gboolean stats_options_prometheus_is_set = FALSE;
+static gchar *stats_options_query = NULL;
+static gchar *stats_options_session = NULL;
 
 static GOptionEntry stats_options[] =
 {
   { "reset", 'r', 0, G_OPTION_ARG_NONE, &stats_options_reset_is_set, "reset counters", NULL },
+  { "prometheus", 'p', 0, G_OPTION_ARG_NONE, &stats_options_prometheus_is_set, "use the Prometheus/OpenMetrics text format", NULL },
+  { "query", 'q', 0, G_OPTION_ARG_STRING, &stats_options_query,
+    "only list the matching counters", "<component;id;instance;type>" },
+  { "session", 0, 0, G_OPTION_ARG_STRING, &stats_options_session,
+    "with --query, list the changes since the previous query of this session", "<name>" },
   { NULL,    0,   0, G_OPTION_ARG_NONE, NULL,                        NULL,             NULL }
 };
 
@@ -111,17 +119,90 @@ static GOptionEntry verbose_options[] =
 };
 
 
-static const gchar *
+static gchar *
 _stats_command_builder()
 {
-  return stats_options_reset_is_set ? "RESET_STATS\n" : "STATS\n";
+  if (stats_options_reset_is_set)
+    return g_strdup("RESET_STATS\n");
+  if (stats_options_query)
+    return g_strdup_printf("STATS QUERY %s%s%s\n", stats_options_query,
+                           stats_options_session ? " " : "", stats_options_session ? : "");
+  return g_strdup(stats_options_prometheus_is_set ? "PROMETHEUS_STATS\n" : "STATS\n");
 }
 
 static gint
 slng_stats(int argc, char *argv[], const gchar *mode)
 {
-  GString *rsp = slng_run_command(_stats_command_builder());
+  gchar *command = _stats_command_builder();
+  GString *rsp = slng_run_command(command);
 
+  g_free(command);
+
+  if (rsp == NULL)
+    return 1;
+
+  printf("%s\n", rsp->str);
+
+  g_string_free(rsp, TRUE);
+
+  return 0;
+}
+
+static gint
+slng_handles(int argc, char *argv[], const gchar *mode)
+{
+  GString *rsp = slng_run_command("HANDLE_STATS\n");
+
+  if (rsp == NULL)
+    return 1;
+
+  printf("%s\n", rsp->str);
+
+  g_string_free(rsp, TRUE);
+
+  return 0;
+}
+
+static gint
+slng_filter_stats(int argc, char *argv[], const gchar *mode)
+{
+  GString *rsp = slng_run_command("FILTER_STATS\n");
+
+  if (rsp == NULL)
+    return 1;
+
+  printf("%s\n", rsp->str);
+
+  g_string_free(rsp, TRUE);
+
+  return 0;
+}
+
+static gint memprof_start_rate = 0;
+static gboolean memprof_stop_is_set = FALSE;
+
+static GOptionEntry memprof_options[] =
+{
+  { "start", 0, 0, G_OPTION_ARG_INT, &memprof_start_rate,
+    "start sampling one allocation in every <bytes> bytes allocated", "<bytes>" },
+  { "stop", 0, 0, G_OPTION_ARG_NONE, &memprof_stop_is_set, "stop profiling and drop the samples", NULL },
+  { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL }
+};
+
+static gint
+slng_memprof(int argc, char *argv[], const gchar *mode)
+{
+  GString *rsp;
+  gchar buff[64];
+
+  if (memprof_stop_is_set)
+    g_strlcpy(buff, "MEMPROF STOP\n", sizeof(buff));
+  else if (memprof_start_rate > 0)
+    g_snprintf(buff, sizeof(buff), "MEMPROF START %d\n", memprof_start_rate);
+  else
+    g_strlcpy(buff, "MEMPROF\n", sizeof(buff));
+
+  rsp = slng_run_command(buff);
   if (rsp == NULL)
     return 1;
 
@@ -202,6 +283,9 @@ static struct
 } modes[] =
 {
   { "stats", stats_options, "Query/reset syslog-ng statistics", slng_stats },
+  { "filter-stats", no_options, "Query the evaluation counters of filters, needs filter-profiling(yes)", slng_filter_stats },
+  { "memprof", memprof_options, "Start/stop the allocation profiler or query the allocations it sampled", slng_memprof },
+  { "handles", no_options, "Query the number of name-value handles allocated at config time and at runtime", slng_handles },
   { "verbose", verbose_options, "Enable/query verbose messages", slng_verbose },
   { "debug", verbose_options, "Enable/query debug messages", slng_verbose },
   { "trace", verbose_options, "Enable/query trace messages", slng_verbose },
@@ -0,0 +1,284 @@
+#!/usr/bin/env python
+#
+# End-to-end pipeline benchmark: starts syslog-ng with a set of reference
+# configurations, drives each of them with loggen and records throughput,
+# latency, CPU usage and memory footprint into bench-report.json.
+#
+# loggen sends the messages to syslog-ng and receives them back on
+# receive_port, so every scenario measures the whole pipeline including
+# the destination side.
+#
+# Tunables (environment variables):
+#   BENCH_DURATION      seconds to run loggen for in each scenario (default: 30)
+#   BENCH_CONNECTIONS   number of active loggen connections (default: 4)
+#   BENCH_RATE          msg/sec per connection, 0 for unlimited (default: 0)
+#   BENCH_SIZE          size of the messages in bytes (default: 256)
+#   BENCH_REPORT        path of the report (default: bench-report.json)
+#   LOGGEN_BINARY       loggen to use (default: ../loggen/loggen)
+#
+# The command line arguments select the scenarios to run, all of them are
+# run if none is specified.
+
+import os, sys, re, time, signal, socket, json
+
+sys.path.insert(0, os.path.join(os.environ.get('top_srcdir', '../..'), 'tests', 'functional'))
+from globals import get_syslog_ng_binary, get_module_path, port_number
+
+duration = int(os.getenv('BENCH_DURATION', '30'))
+connections = int(os.getenv('BENCH_CONNECTIONS', '4'))
+rate = int(os.getenv('BENCH_RATE', '0'))
+message_size = int(os.getenv('BENCH_SIZE', '256'))
+report_file = os.getenv('BENCH_REPORT', 'bench-report.json')
+loggen_binary = os.getenv('LOGGEN_BINARY', '../loggen/loggen')
+
+src_dir = os.environ.get('srcdir', os.path.dirname(os.path.abspath(__file__)))
+ssl_dir = os.path.join(os.path.dirname(src_dir), 'functional')
+
+receive_port = port_number + 10
+
+common_config = """@version: 3.8
+
+options {
+  threaded(yes);
+  keep-hostname(yes);
+  chain-hostnames(no);
+  time-reopen(1);
+  log-fifo-size(100000);
+  stats-freq(0);
+};
+
+source s_int { internal(); };
+destination d_int { file("bench-internal.log"); };
+log { source(s_int); destination(d_int); };
+"""
+
+scenarios = [
+  ('plain-relay', [], """
+source s_bench { tcp(port(%(port)d) max-connections(1000) log-iw-size(1000000)); };
+destination d_bench { tcp("127.0.0.1" port(%(receive_port)d)); };
+
+log { source(s_bench); destination(d_bench); flags(flow-control); };
+"""),
+  ('parse-json', ['--json'], """
+source s_bench { tcp(port(%(port)d) max-connections(1000) log-iw-size(1000000)); };
+parser p_json { json-parser(prefix(".json.")); };
+destination d_bench { tcp("127.0.0.1" port(%(receive_port)d) template("$(format-json --scope rfc5424 --key .json.*)\\n")); };
+
+log { source(s_bench); parser(p_json); destination(d_bench); flags(flow-control); };
+"""),
+  ('patterndb', [], """
+source s_bench { tcp(port(%(port)d) max-connections(1000) log-iw-size(1000000)); };
+parser p_patterndb { db-parser(file("bench-patterndb.xml")); };
+destination d_bench { tcp("127.0.0.1" port(%(receive_port)d) template("${.classifier.rule_id} ${seq} $MSG\\n")); };
+
+log { source(s_bench); parser(p_patterndb); destination(d_bench); flags(flow-control); };
+"""),
+  ('disk-buffer-reliable', [], """
+source s_bench { tcp(port(%(port)d) max-connections(1000) log-iw-size(1000000)); };
+destination d_bench {
+  tcp("127.0.0.1" port(%(receive_port)d)
+      disk-buffer(reliable(yes) dir(".") mem-buf-size(16777216) disk-buf-size(1073741824)));
+};
+
+log { source(s_bench); destination(d_bench); flags(flow-control); };
+"""),
+  ('tls', ['--use-ssl'], """
+source s_bench {
+  tcp(port(%(port)d) max-connections(1000) log-iw-size(1000000)
+      tls(peer-verify(none) cert-file("%(ssl_dir)s/ssl.crt") key-file("%(ssl_dir)s/ssl.key")));
+};
+destination d_bench { tcp("127.0.0.1" port(%(receive_port)d)); };
+
+log { source(s_bench); destination(d_bench); flags(flow-control); };
+"""),
+]
+
+patterndb = """<?xml version='1.0' encoding='UTF-8'?>
+<patterndb version='4' pub_date='2016-01-01'>
+  <ruleset name='loggen' id='loggen'>
+    <patterns>
+%(programs)s
+    </patterns>
+    <rules>
+      <rule provider='bench' id='loggen-message' class='system'>
+        <patterns>
+          <pattern>seq: @NUMBER:seq@, thread: @NUMBER:thread@, runid: @ESTRING:runid:,@ stamp: @ESTRING:stamp: @sendts: @NUMBER:sendts@ @ANYSTRING:padding@</pattern>
+        </patterns>
+      </rule>
+    </rules>
+  </ruleset>
+</patterndb>
+"""
+
+def write_patterndb():
+    programs = '\n'.join(['      <pattern>prg%05d</pattern>' % i for i in range(connections)])
+    f = open('bench-patterndb.xml', 'w')
+    f.write(patterndb % {'programs': programs})
+    f.close()
+
+def cleanup_work_files():
+    for name in os.listdir('.'):
+        if (name.startswith('syslog-ng-') and name.endswith('.rqf')) or name in ('syslog-ng.persist', 'bench-internal.log'):
+            os.unlink(name)
+
+def wait_for_port(port, timeout=10):
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        s = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        try:
+            try:
+                s.connect(('127.0.0.1', port))
+                return True
+            except socket.error:
+                time.sleep(0.1)
+        finally:
+            s.close()
+    return False
+
+def start_syslogng(config):
+    f = open('bench.conf', 'w')
+    f.write(config)
+    f.close()
+
+    pid = os.fork()
+    if pid == 0:
+        binary = get_syslog_ng_binary()
+        os.execl(binary, binary, '-f', 'bench.conf', '--fd-limit', '65536', '-F', '-e',
+                 '-p', 'syslog-ng.pid', '-R', 'syslog-ng.persist', '--no-caps',
+                 '--module-path', get_module_path())
+        os._exit(1)
+    return pid
+
+def read_proc_usage(pid):
+    """Returns (cpu seconds, peak RSS in kB) of a running process, or None if /proc is unavailable."""
+    try:
+        f = open('/proc/%d/stat' % pid)
+        fields = f.read().rsplit(')', 1)[1].split()
+        f.close()
+        ticks = float(os.sysconf('SC_CLK_TCK'))
+        cpu = (int(fields[11]) + int(fields[12])) / ticks
+
+        rss = 0
+        f = open('/proc/%d/status' % pid)
+        for line in f:
+            if line.startswith('VmHWM:'):
+                rss = int(line.split()[1])
+        f.close()
+        return (cpu, rss)
+    except (IOError, OSError, IndexError, ValueError):
+        return None
+
+def stop_syslogng(pid):
+    """Stops syslog-ng and returns (exit status, cpu seconds, peak RSS in kB) from its rusage."""
+    try:
+        os.kill(pid, signal.SIGTERM)
+    except OSError:
+        pass
+    (pid, status, rusage) = os.wait4(pid, 0)
+    rss = rusage.ru_maxrss
+    if sys.platform == 'darwin':
+        rss //= 1024
+    return (status, rusage.ru_utime + rusage.ru_stime, rss)
+
+def parse_loggen_output(out):
+    result = {}
+    m = re.search(r'average rate = ([0-9.]+) msg/sec, count=([0-9]+)', out)
+    if m:
+        result['sent_rate'] = float(m.group(1))
+        result['sent'] = int(m.group(2))
+    m = re.search(r'latency: received=([0-9]+), lost=(-?[0-9]+), min=([0-9.]+) ms, avg=([0-9.]+) ms, max=([0-9.]+) ms, '
+                  r'p50<([0-9.]+) ms, p90<([0-9.]+) ms, p99<([0-9.]+) ms, p99.9<([0-9.]+) ms', out)
+    if m:
+        result['received'] = int(m.group(1))
+        result['lost'] = int(m.group(2))
+        result['latency_ms'] = {
+            'min': float(m.group(3)), 'avg': float(m.group(4)), 'max': float(m.group(5)),
+            'p50': float(m.group(6)), 'p90': float(m.group(7)),
+            'p99': float(m.group(8)), 'p99.9': float(m.group(9)),
+        }
+    return result
+
+def run_scenario(name, loggen_args, config_template):
+    print("### Running scenario: %s" % name)
+    cleanup_work_files()
+    config = common_config + config_template % {'port': port_number, 'receive_port': receive_port, 'ssl_dir': ssl_dir}
+
+    pid = start_syslogng(config)
+    if not wait_for_port(port_number):
+        stop_syslogng(pid)
+        return {'scenario': name, 'error': 'syslog-ng failed to start'}
+
+    usage_before = read_proc_usage(pid)
+    cmd = [loggen_binary, '-i', '-S', '-Q', '-r', str(rate), '-s', str(message_size), '-I', str(duration),
+           '--active-connections', str(connections), '--receive-port', str(receive_port)] + loggen_args + \
+          ['127.0.0.1', str(port_number)]
+    start = time.time()
+    out = os.popen(' '.join(cmd) + ' 2>&1', 'r').read()
+    elapsed = time.time() - start
+    usage_after = read_proc_usage(pid)
+
+    (status, cpu, rss) = stop_syslogng(pid)
+    # prefer the numbers covering the loggen run only, startup excluded
+    if usage_before and usage_after:
+        cpu = usage_after[0] - usage_before[0]
+        rss = usage_after[1]
+
+    result = {'scenario': name, 'elapsed': elapsed, 'cpu_seconds': cpu, 'max_rss_kb': rss}
+    result.update(parse_loggen_output(out))
+    if 'received' not in result:
+        result['error'] = 'unable to parse loggen output: %s' % out.strip()
+    else:
+        result['throughput'] = result['received'] / elapsed
+        if result['received']:
+            result['cpu_usec_per_msg'] = cpu * 1e6 / result['received']
+    if status != 0:
+        result['error'] = 'syslog-ng exited with status %d' % status
+    cleanup_work_files()
+    return result
+
+def print_result(result):
+    if 'error' in result:
+        print("    %-22s ERROR: %s" % (result['scenario'], result['error']))
+        return
+    print("    %-22s %10.0f msg/sec  p99 < %8.1f ms  %8.2f usec CPU/msg  %8d kB RSS  (lost %d)" %
+          (result['scenario'], result['throughput'], result['latency_ms']['p99'],
+           result.get('cpu_usec_per_msg', 0), result['max_rss_kb'], result['lost']))
+
+def get_version():
+    return os.popen('%s --version 2>/dev/null | head -1' % get_syslog_ng_binary(), 'r').read().strip()
+
+def main(argv):
+    selected = argv[1:]
+    unknown = [s for s in selected if s not in [name for (name, args, config) in scenarios]]
+    if unknown:
+        print("Unknown scenario(s): %s" % ', '.join(unknown))
+        return 1
+
+    write_patterndb()
+    results = []
+    for (name, loggen_args, config) in scenarios:
+        if selected and name not in selected:
+            continue
+        results.append(run_scenario(name, loggen_args, config))
+
+    report = {
+        'version': get_version(),
+        'hostname': os.uname()[1],
+        'timestamp': time.strftime('%Y-%m-%dT%H:%M:%S%z'),
+        'parameters': {'duration': duration, 'connections': connections, 'rate': rate, 'message_size': message_size},
+        'results': results,
+    }
+    f = open(report_file, 'w')
+    json.dump(report, f, indent=2, sort_keys=True)
+    f.close()
+
+    print("### Results (%s)" % report_file)
+    for result in results:
+        print_result(result)
+
+    if [r for r in results if 'error' in r]:
+        return 1
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
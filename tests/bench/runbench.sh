@@ -0,0 +1,14 @@
+#! /bin/sh
+set -e
+
+top_srcdir=$(cd ${top_srcdir}; pwd)
+top_builddir=$(cd ${top_builddir}; pwd)
+srcdir="${top_srcdir}/tests/bench"
+
+export top_srcdir
+export top_builddir
+export srcdir
+
+install -d ${top_builddir}/tests/bench
+cd ${top_builddir}/tests/bench
+${top_srcdir}/tests/bench/bench.py "$@"
@@ -38,6 +38,7 @@
 #include <string.h>
 #include <glib.h>
 #include <signal.h>
+#include <poll.h>
 
 #include <openssl/crypto.h>
 #include <openssl/x509.h>
@@ -51,6 +52,11 @@
 
 #define USEC_PER_SEC      1000000
 
+/* latency histogram: 100us wide buckets up to 10 seconds */
+#define LATENCY_BUCKET_USEC      100
+#define LATENCY_BUCKETS          100000
+#define LATENCY_MAX_CONNECTIONS  64
+
 #ifndef MIN
 #define MIN(a, b)    ((a) < (b) ? (a) : (b))
 #endif
@@ -82,12 +88,22 @@ int dont_parse = 0;
 static gint display_version;
 char *sdata_value = NULL;
 int permanent = 0;
+int json_payload = 0;
+int receive_port = 0;
+int receive_timeout = 5;
 
 /* results */
 guint64 sum_count;
 struct timeval sum_time;
 gint raw_message_length;
 
+/* latency results, only touched by the receiver thread until it exits */
+guint64 latency_count;
+guint64 latency_sum_usec;
+guint64 latency_min_usec = G_MAXUINT64;
+guint64 latency_max_usec;
+guint64 latency_histogram[LATENCY_BUCKETS + 1];
+
 typedef ssize_t (*send_data_t)(void *user_data, void *buf, size_t length);
 
 static ssize_t
@@ -160,6 +176,58 @@ time_val_add_time_val(struct timeval *res, const struct timeval *t1, const struc
     }
 }
 
+/*
+ * Token bucket used to shape the outgoing rate of a single connection.
+ * Tokens are refilled continuously at @rate per second and at most 10ms
+ * worth of them can be accumulated, so the rate stays precise even at
+ * very high rates while short hiccups of the sender are smoothed out.
+ */
+typedef struct _TokenBucket
+{
+  double tokens;
+  double capacity;
+  struct timeval last_refill;
+} TokenBucket;
+
+static void
+token_bucket_init(TokenBucket *self, const struct timeval *now)
+{
+  self->capacity = MAX(1.0, rate / 100.0);
+  self->tokens = 1.0;
+  self->last_refill = *now;
+}
+
+/* returns 0 if a message can be sent, otherwise the number of usecs to wait */
+static long
+token_bucket_take(TokenBucket *self, struct timeval *now)
+{
+  if (rate <= 0)
+    return 0;
+
+  self->tokens += (double) time_val_diff_in_usec(now, &self->last_refill) * rate / USEC_PER_SEC;
+  if (self->tokens > self->capacity)
+    self->tokens = self->capacity;
+  self->last_refill = *now;
+
+  if (self->tokens >= 1.0)
+    {
+      self->tokens -= 1.0;
+      return 0;
+    }
+  return (long) ((1.0 - self->tokens) * USEC_PER_SEC / rate) + 1;
+}
+
+static void
+sleep_usec(long usec)
+{
+  struct timespec tspec;
+
+  tspec.tv_sec = usec / USEC_PER_SEC;
+  tspec.tv_nsec = (usec % USEC_PER_SEC) * 1000;
+  while (nanosleep(&tspec, &tspec) < 0 && errno == EINTR)
+    ;
+}
+
 static ssize_t
 write_chunk(send_data_t send_func, void *send_func_ud, void *buf, size_t buf_len)
 {
@@ -359,25 +427,27 @@ format_timezone_offset_with_colon(char *timestamp, int timestamp_size, struct tm
 static guint64
 gen_messages(send_data_t send_func, void *send_func_ud, int thread_id, FILE *readfrom)
 {
-  struct timeval now, start, last_ts_format, last_throttle_check;
+  struct timeval now, start, last_ts_format;
   char linebuf[MAX_MESSAGE_LENGTH + 1];
+  char body[256];
   char stamp[32];
-  char intbuf[16];
+  char intbuf[24];
   int linelen = 0;
   int i, run_id;
   unsigned long count = 0, last_count = 0;
   char padding[] = "PADD";
-  long buckets = rate - (rate / 10);
+  TokenBucket bucket;
+  long wait_usec;
   double diff_usec;
   struct timeval diff_tv;
-  int pos_timestamp1 = 0, pos_timestamp2 = 0, pos_seq = 0;
-  int rc, hdr_len = 0;
+  int pos_timestamp1 = 0, pos_timestamp2 = 0, pos_seq = 0, pos_sendts = -1;
+  int rc, hdr_len = 0, body_pos;
   gint64 sum_linelen = 0;
   char *testsdata = NULL;
 
   gettimeofday(&start, NULL);
   now = start;
-  last_throttle_check = now;
+  token_bucket_init(&bucket, &now);
   run_id = start.tv_sec;
 
   /* force reformat of the timestamp */
@@ -395,28 +465,50 @@ gen_messages(send_data_t send_func, void *send_func_ud, int thread_id, FILE *rea
 
   if (!readfrom)
     {
+      const gchar *seq_marker, *stamp_marker, *sendts_marker;
+
+      if (json_payload)
+        {
+          seq_marker = "\"seq\":\"";
+          stamp_marker = "\"stamp\":\"";
+          sendts_marker = "\"sendts\":\"";
+          snprintf(body, sizeof(body), "{\"seq\":\"%010d\",\"thread\":\"%04d\",\"runid\":\"%-10d\",\"stamp\":\"%-19s\"%s,\"padding\":\"",
+                   0, thread_id, run_id, "", receive_port ? ",\"sendts\":\"0000000000000000\"" : "");
+        }
+      else
+        {
+          seq_marker = "seq: ";
+          stamp_marker = "stamp: ";
+          sendts_marker = "sendts: ";
+          snprintf(body, sizeof(body), "seq: %010d, thread: %04d, runid: %-10d, stamp: %-19s %s",
+                   0, thread_id, run_id, "", receive_port ? "sendts: 0000000000000000 " : "");
+        }
+
       if (syslog_proto)
         {
           if (sock_type == SOCK_STREAM && framing)
             hdr_len = snprintf(linebuf, sizeof(linebuf), "%d ", message_length);
 
-          linelen = snprintf(linebuf + hdr_len, sizeof(linebuf) - hdr_len, "<38>1 2007-12-24T12:28:51+02:00 localhost prg%05d 1234 - %s \xEF\xBB\xBFseq: %010d, thread: %04d, runid: %-10d, stamp: %-19s ", thread_id, testsdata, 0, thread_id, run_id, "");
-
+          linelen = snprintf(linebuf + hdr_len, sizeof(linebuf) - hdr_len, "<38>1 2007-12-24T12:28:51+02:00 localhost prg%05d 1234 - %s \xEF\xBB\xBF%s", thread_id, testsdata, body);
           pos_timestamp1 = 6 + hdr_len;
-          pos_seq = 68 + hdr_len + strlen(testsdata) - 1;
-          pos_timestamp2 = 120 + hdr_len + strlen(testsdata) - 1;
         }
       else
         {
-          linelen = snprintf(linebuf, sizeof(linebuf), "<38>2007-12-24T12:28:51 localhost prg%05d[1234]: seq: %010d, thread: %04d, runid: %-10d, stamp: %-19s ", thread_id, 0, thread_id, run_id, "");
+          linelen = snprintf(linebuf, sizeof(linebuf), "<38>2007-12-24T12:28:51 localhost prg%05d[1234]: %s", thread_id, body);
           pos_timestamp1 = 4;
-          pos_seq = 55;
-          pos_timestamp2 = 107;
         }
 
-      if (linelen > message_length)
+      /* the fields to be updated are looked up in the body, as sdata may contain anything */
+      body_pos = hdr_len + linelen - strlen(body);
+      pos_seq = strstr(linebuf + body_pos, seq_marker) - linebuf + strlen(seq_marker);
+      pos_timestamp2 = strstr(linebuf + body_pos, stamp_marker) - linebuf + strlen(stamp_marker);
+      if (receive_port)
+        pos_sendts = strstr(linebuf + body_pos, sendts_marker) - linebuf + strlen(sendts_marker);
+
+      /* the JSON payload needs room for the closing quote, brace and the newline */
+      if (linelen + (json_payload ? 3 : 0) > message_length)
         {
-          fprintf(stderr, "Warning: message length is too small, the minimum is %d bytes\n", linelen);
+          fprintf(stderr, "Warning: message length is too small, the minimum is %d bytes\n", linelen + (json_payload ? 3 : 0));
           return 0;
         }
     }
@@ -424,6 +516,11 @@ gen_messages(send_data_t send_func, void *send_func_ud, int thread_id, FILE *rea
     {
       linebuf[i + hdr_len] = padding[(i - linelen) % (sizeof(padding) - 1)];
     }
+  if (!readfrom && json_payload)
+    {
+      linebuf[hdr_len + message_length - 3] = '"';
+      linebuf[hdr_len + message_length - 2] = '}';
+    }
   linebuf[hdr_len + message_length - 1] = '\n';
   linebuf[hdr_len + message_length] = 0;
 
@@ -437,29 +534,10 @@ gen_messages(send_data_t send_func, void *send_func_ud, int thread_id, FILE *rea
         }
       gettimeofday(&now, NULL);
 
-      diff_usec = time_val_diff_in_usec(&now, &last_throttle_check);
-      if (buckets == 0 || diff_usec > 1e5)
+      wait_usec = token_bucket_take(&bucket, &now);
+      if (wait_usec)
         {
-          /* check rate every 0.1sec */
-          long new_buckets;
-
-          new_buckets = (rate * diff_usec) / USEC_PER_SEC;
-          if (new_buckets)
-            {
-              buckets = MIN(rate, buckets + new_buckets);
-              last_throttle_check = now;
-            }
-        }
-
-      if (buckets == 0)
-        {
-          struct timespec tspec;
-          long msec = (1000 / rate) + 1;
-
-          tspec.tv_sec = msec / 1000;
-          tspec.tv_nsec = (msec % 1000) * 1e6;
-          while (nanosleep(&tspec, &tspec) < 0 && errno == EINTR)
-            ;
+          sleep_usec(wait_usec);
           continue;
         }
 
@@ -515,6 +593,12 @@ gen_messages(send_data_t send_func, void *send_func_ud, int thread_id, FILE *rea
           /* add sequence number */
           snprintf(intbuf, sizeof(intbuf), "%010ld", count);
           memcpy(&linebuf[pos_seq], intbuf, 10);
+
+          if (pos_sendts >= 0)
+            {
+              snprintf(intbuf, sizeof(intbuf), "%016" G_GINT64_FORMAT, (gint64) now.tv_sec * USEC_PER_SEC + now.tv_usec);
+              memcpy(&linebuf[pos_sendts], intbuf, 16);
+            }
         }
 
       rc = write_chunk(send_func, send_func_ud, linebuf, linelen);
@@ -523,7 +607,6 @@ gen_messages(send_data_t send_func, void *send_func_ud, int thread_id, FILE *rea
           fprintf(stderr, "Send error %s, results may be skewed.\n", strerror(errno));
           break;
         }
-      buckets--;
       count++;
     }
 
@@ -598,6 +681,8 @@ gboolean threads_stop;
 gint active_finished;
 gint connect_finished;
 guint64 sum_count;
+gboolean senders_finished;
+struct timeval receive_deadline;
 
 gpointer
 idle_thread(gpointer st)
@@ -699,8 +784,219 @@ error:
   return NULL;
 }
 
+static int
+open_receive_socket(void)
+{
+  int sock, on = 1;
+  struct sockaddr_in s_in;
+  struct sockaddr_in6 s_in6;
+  struct sockaddr *addr;
+  socklen_t addr_len;
+
+  if (use_ipv6)
+    {
+      memset(&s_in6, 0, sizeof(s_in6));
+      s_in6.sin6_family = AF_INET6;
+      s_in6.sin6_addr = in6addr_any;
+      s_in6.sin6_port = htons(receive_port);
+      addr = (struct sockaddr *) &s_in6;
+      addr_len = sizeof(s_in6);
+    }
+  else
+    {
+      memset(&s_in, 0, sizeof(s_in));
+      s_in.sin_family = AF_INET;
+      s_in.sin_addr.s_addr = htonl(INADDR_ANY);
+      s_in.sin_port = htons(receive_port);
+      addr = (struct sockaddr *) &s_in;
+      addr_len = sizeof(s_in);
+    }
+
+  sock = socket(addr->sa_family, SOCK_STREAM, 0);
+  if (sock < 0)
+    {
+      fprintf(stderr, "Error creating receive socket: %s\n", g_strerror(errno));
+      return -1;
+    }
+  setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  if (bind(sock, addr, addr_len) < 0 || listen(sock, LATENCY_MAX_CONNECTIONS) < 0)
+    {
+      fprintf(stderr, "Error binding receive socket: %s\n", g_strerror(errno));
+      close(sock);
+      return -1;
+    }
+  return sock;
+}
+
+static void
+record_latency(gint64 sent_usec, const struct timeval *now)
+{
+  gint64 latency = (gint64) now->tv_sec * USEC_PER_SEC + now->tv_usec - sent_usec;
+
+  /* clocks of the sender and the receiver are the same, but be careful anyway */
+  if (latency < 0)
+    latency = 0;
+
+  latency_count++;
+  latency_sum_usec += latency;
+  latency_min_usec = MIN(latency_min_usec, (guint64) latency);
+  latency_max_usec = MAX(latency_max_usec, (guint64) latency);
+  latency_histogram[MIN(latency / LATENCY_BUCKET_USEC, LATENCY_BUCKETS)]++;
+}
+
+/*
+ * Scans @buf for send timestamps and records their latency.  Messages are
+ * not split into lines, so that both newline terminated and framed
+ * messages can be received.  Returns the number of bytes consumed, the
+ * rest may contain an incomplete timestamp and is retained by the caller.
+ */
+static gsize
+process_received_data(gchar *buf, gsize len, const struct timeval *now)
+{
+  const gsize max_field_len = 6 + 3 + 16;
+  gsize pos = 0;
+  gchar *marker;
+
+  while ((marker = g_strstr_len(buf + pos, len - pos, "sendts")))
+    {
+      gchar *p = marker + 6;
+      gchar *end = buf + len;
+      gint64 sent_usec = 0;
+      gint i;
+
+      while (p < end && p < marker + 9 && (*p == '"' || *p == ':' || *p == ' '))
+        p++;
+      if (end - p < 16)
+        return marker - buf;
+
+      for (i = 0; i < 16 && g_ascii_isdigit(p[i]); i++)
+        sent_usec = sent_usec * 10 + p[i] - '0';
+      if (i == 16)
+        record_latency(sent_usec, now);
+      pos = p + i - buf;
+    }
+  return MAX(pos, len > max_field_len ? len - max_field_len : 0);
+}
+
+static gboolean
+receiver_should_stop(void)
+{
+  gboolean stop;
+  struct timeval now;
+
+  gettimeofday(&now, NULL);
+  g_mutex_lock(thread_lock);
+  stop = senders_finished && (latency_count >= sum_count || timercmp(&now, &receive_deadline, >=));
+  g_mutex_unlock(thread_lock);
+  return stop;
+}
+
+gpointer
+receiver_thread(gpointer st)
+{
+  struct pollfd fds[LATENCY_MAX_CONNECTIONS + 1];
+  gchar *bufs[LATENCY_MAX_CONNECTIONS + 1];
+  gsize buf_lens[LATENCY_MAX_CONNECTIONS + 1];
+  const gsize buf_size = 2 * MAX_MESSAGE_LENGTH;
+  nfds_t nfds = 1;
+  struct timeval now;
+  nfds_t i;
+
+  fds[0].fd = GPOINTER_TO_INT(st);
+  fds[0].events = POLLIN;
+
+  while (!receiver_should_stop())
+    {
+      if (poll(fds, nfds, 100) <= 0)
+        continue;
+
+      gettimeofday(&now, NULL);
+      if ((fds[0].revents & POLLIN) && nfds <= LATENCY_MAX_CONNECTIONS)
+        {
+          int sock = accept(fds[0].fd, NULL, NULL);
+
+          if (sock >= 0)
+            {
+              fds[nfds].fd = sock;
+              fds[nfds].events = POLLIN;
+              fds[nfds].revents = 0;
+              bufs[nfds] = g_malloc(buf_size);
+              buf_lens[nfds] = 0;
+              nfds++;
+            }
+        }
+
+      for (i = 1; i < nfds; i++)
+        {
+          gssize rc;
+          gsize consumed;
+
+          if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+            continue;
+
+          rc = read(fds[i].fd, bufs[i] + buf_lens[i], buf_size - buf_lens[i]);
+          if (rc <= 0)
+            {
+              close(fds[i].fd);
+              g_free(bufs[i]);
+              nfds--;
+              fds[i] = fds[nfds];
+              bufs[i] = bufs[nfds];
+              buf_lens[i] = buf_lens[nfds];
+              i--;
+              continue;
+            }
+          buf_lens[i] += rc;
+          consumed = process_received_data(bufs[i], buf_lens[i], &now);
+          memmove(bufs[i], bufs[i] + consumed, buf_lens[i] - consumed);
+          buf_lens[i] -= consumed;
+        }
+    }
+
+  for (i = 1; i < nfds; i++)
+    {
+      close(fds[i].fd);
+      g_free(bufs[i]);
+    }
+  close(fds[0].fd);
+  return NULL;
+}
+
+static guint64
+latency_percentile(double percentile)
+{
+  guint64 target = (guint64) (latency_count * percentile / 100.0);
+  guint64 seen = 0;
+  gint i;
+
+  for (i = 0; i <= LATENCY_BUCKETS; i++)
+    {
+      seen += latency_histogram[i];
+      if (seen > target)
+        return (guint64) (i + 1) * LATENCY_BUCKET_USEC;
+    }
+  return latency_max_usec;
+}
+
+static void
+print_latency_results(void)
+{
+  if (latency_count == 0)
+    {
+      fprintf(stderr, "latency: no messages received\n");
+      return;
+    }
+
+  fprintf(stderr, "latency: received=%" G_GUINT64_FORMAT ", lost=%" G_GINT64_FORMAT ", min=%.3lf ms, avg=%.3lf ms, max=%.3lf ms, "
+          "p50<%.1lf ms, p90<%.1lf ms, p99<%.1lf ms, p99.9<%.1lf ms\n",
+          latency_count, (gint64) (sum_count - latency_count),
+          latency_min_usec / 1000.0, (double) latency_sum_usec / latency_count / 1000.0, latency_max_usec / 1000.0,
+          latency_percentile(50) / 1000.0, latency_percentile(90) / 1000.0,
+          latency_percentile(99) / 1000.0, latency_percentile(99.9) / 1000.0);
+}
+
 static GOptionEntry loggen_options[] = {
-  { "rate", 'r', 0, G_OPTION_ARG_INT, &rate, "Number of messages to generate per second", "<msg/sec/active connection>" },
+  { "rate", 'r', 0, G_OPTION_ARG_INT, &rate, "Number of messages to generate per second, 0 for unlimited", "<msg/sec/active connection>" },
   { "inet", 'i', 0, G_OPTION_ARG_NONE, &unix_socket_i, "Use IP-based transport (TCP, UDP)", NULL },
   { "unix", 'x', 0, G_OPTION_ARG_NONE, &unix_socket_x, "Use UNIX domain socket transport", NULL },
   { "stream", 'S', 0, G_OPTION_ARG_NONE, &sock_type_s, "Use stream socket (TCP and unix-stream)", NULL },
@@ -712,6 +1008,9 @@ static GOptionEntry loggen_options[] = {
   { "syslog-proto", 'P', 0, G_OPTION_ARG_NONE, &syslog_proto, "Use the new syslog-protocol message format (see also framing)", NULL },
   { "sdata", 'p', 0, G_OPTION_ARG_STRING, &sdata_value, "Send the given sdata (e.g. \"[test name=\\\"value\\\"]\") in case of syslog-proto", NULL },
   { "no-framing", 'F', G_OPTION_FLAG_REVERSE, G_OPTION_ARG_NONE, &framing, "Don't use syslog-protocol style framing, even if syslog-proto is set", NULL },
+  { "json", 'j', 0, G_OPTION_ARG_NONE, &json_payload, "Send the message payload as a JSON object", NULL },
+  { "receive-port", 0, 0, G_OPTION_ARG_INT, &receive_port, "Measure end-to-end latency by embedding send timestamps and reading the messages back on this TCP port", "<port>" },
+  { "receive-timeout", 0, 0, G_OPTION_ARG_INT, &receive_timeout, "Seconds to wait for messages still in flight once sending finished (default = 5)", "<sec>" },
   { "active-connections", 0, 0, G_OPTION_ARG_INT, &active_connections, "Number of active connections to the server (default = 1)", "<number>" },
   { "idle-connections", 0, 0, G_OPTION_ARG_INT, &idle_connections, "Number of inactive connections to the server (default = 0)", "<number>" },
   { "use-ssl", 'U', 0, G_OPTION_ARG_NONE, &usessl, "Use ssl layer", NULL },
@@ -749,6 +1048,7 @@ main(int argc, char *argv[])
   int i;
   guint64 diff_usec;
   GOptionGroup *group;
+  GThread *receiver = NULL;
 
   g_thread_init(NULL);
   tzset();
@@ -797,6 +1097,12 @@ main(int argc, char *argv[])
       message_length = MAX_MESSAGE_LENGTH;
     }
 
+  if (receive_port && read_file != NULL)
+    {
+      fprintf(stderr, "Error: latency measurement is not possible with messages read from a file\n");
+      return 1;
+    }
+
   if (read_file != NULL)
     {
       if (read_file[0] == '-' && read_file[1] == '\0')
@@ -907,6 +1213,20 @@ main(int argc, char *argv[])
       printf("ThreadId;Time;Rate;Count\n");
     }
 
+  if (receive_port)
+    {
+      int receive_sock = open_receive_socket();
+
+      if (receive_sock < 0)
+        return 2;
+      receiver = g_thread_create(receiver_thread, GINT_TO_POINTER(receive_sock), TRUE, NULL);
+      if (!receiver)
+        {
+          close(receive_sock);
+          goto stop_and_exit;
+        }
+    }
+
   for (i = 0; i < idle_connections; i++)
     {
       if (!g_thread_create_full(idle_thread, NULL, 1024 * 64, FALSE, FALSE, G_THREAD_PRIORITY_NORMAL, NULL))
@@ -933,8 +1253,20 @@ main(int argc, char *argv[])
   /* tell inactive ones to exit (active ones exit automatically) */
   threads_stop = TRUE;
   g_cond_broadcast(thread_cond);
+
+  /* let the receiver wait for the messages still in flight */
+  gettimeofday(&receive_deadline, NULL);
+  receive_deadline.tv_sec += receive_timeout;
+  senders_finished = TRUE;
   g_mutex_unlock(thread_lock);
 
+  if (receiver)
+    {
+      g_thread_join(receiver);
+      receiver = NULL;
+      print_latency_results();
+    }
+
   sum_time.tv_sec /= active_connections;
   sum_time.tv_usec /= active_connections;
   diff_usec = sum_time.tv_sec * USEC_PER_SEC + sum_time.tv_usec;
@@ -949,7 +1281,12 @@ stop_and_exit:
   threads_stop = TRUE;
   g_mutex_lock(thread_lock);
   g_cond_broadcast(thread_cond);
+  /* don't wait for a receiver if the senders couldn't be started */
+  senders_finished = TRUE;
+  receive_deadline.tv_sec = 0;
   g_mutex_unlock(thread_lock);
+  if (receiver)
+    g_thread_join(receiver);
 
   return ret;
 }
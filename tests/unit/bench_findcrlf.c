@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+/*
+ * find-crlf benchmark
+ *
+ * Measures the scanning speed of find_cr_or_lf() and find_lf_or_nul()
+ * over typical message lengths, with the terminator at the end of the
+ * buffer, so every call scans the whole buffer.  It is not run as part of
+ * "make check", build and run it explicitly:
+ *
+ *   make tests/unit/bench_findcrlf
+ *   ./tests/unit/bench_findcrlf [iterations]
+ */
+
+#include "find-crlf.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define BENCH_DEFAULT_ITERATIONS 1000000
+
+typedef struct _BenchBuffer
+{
+  gchar *data;
+  gsize len;
+} BenchBuffer;
+
+static volatile gsize bench_sink;
+
+static void
+bench_find_cr_or_lf(gpointer user_data, gint iterations)
+{
+  BenchBuffer *buffer = (BenchBuffer *) user_data;
+  gint i;
+
+  for (i = 0; i < iterations; i++)
+    bench_sink += find_cr_or_lf(buffer->data, buffer->len) - buffer->data;
+}
+
+static void
+bench_find_lf_or_nul(gpointer user_data, gint iterations)
+{
+  BenchBuffer *buffer = (BenchBuffer *) user_data;
+  gint i;
+
+  for (i = 0; i < iterations; i++)
+    bench_sink += find_lf_or_nul((guchar *) buffer->data, buffer->len) - (guchar *) buffer->data;
+}
+
+int
+main(int argc, char *argv[])
+{
+  static const gsize lengths[] = { 16, 64, 256, 1024, 8192 };
+  BenchBuffer buffer;
+  gchar title[64];
+  gint iterations, i;
+
+  bench_init();
+  iterations = bench_get_iterations(argc, argv, BENCH_DEFAULT_ITERATIONS);
+
+  printf("find-crlf benchmark, %d iterations per round\n", iterations);
+  for (i = 0; i < G_N_ELEMENTS(lengths); i++)
+    {
+      buffer.len = lengths[i];
+      buffer.data = g_malloc(buffer.len);
+      memset(buffer.data, 'a', buffer.len - 1);
+      buffer.data[buffer.len - 1] = '\n';
+
+      g_snprintf(title, sizeof(title), "find_cr_or_lf/%" G_GSIZE_FORMAT, buffer.len);
+      bench_run(title, bench_find_cr_or_lf, &buffer, iterations);
+      g_snprintf(title, sizeof(title), "find_lf_or_nul/%" G_GSIZE_FORMAT, buffer.len);
+      bench_run(title, bench_find_lf_or_nul, &buffer, iterations);
+
+      g_free(buffer.data);
+    }
+  return 0;
+}
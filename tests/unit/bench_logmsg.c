@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+/*
+ * Microbenchmarks for the LogMessage fast path.  The runtime of each
+ * operation is printed, so that changes in the layout of LogMessage show
+ * up as numbers.
+ */
+
+#include "testutils.h"
+#include "msg_parse_lib.h"
+#include "logmsg/logmsg.h"
+#include "apphook.h"
+#include "logpipe.h"
+
+#include <string.h>
+#include <stdio.h>
+
+#define ITERATIONS 500000
+
+static const gchar *raw_msg = "<34>1 2016-01-01T12:00:00+01:00 mymachine.example.com su 1234 ID47 [exampleSDID@0 iut=\"3\" eventSource=\"Application\"] 'su root' failed for lonvick on /dev/pts/8";
+
+static void
+print_layout(void)
+{
+  printf("LogMessage layout: sizeof=%" G_GSIZE_FORMAT ", payload=%ld, flags=%ld, host_id=%ld, saddr=%ld, timestamps=%ld, rcptid=%ld\n",
+         sizeof(LogMessage),
+         G_STRUCT_OFFSET(LogMessage, payload),
+         G_STRUCT_OFFSET(LogMessage, flags),
+         G_STRUCT_OFFSET(LogMessage, host_id),
+         G_STRUCT_OFFSET(LogMessage, saddr),
+         G_STRUCT_OFFSET(LogMessage, timestamps),
+         G_STRUCT_OFFSET(LogMessage, rcptid));
+}
+
+static void
+bench_log_msg_new(void)
+{
+  gint i;
+  gsize raw_msg_len = strlen(raw_msg);
+
+  start_stopwatch();
+  for (i = 0; i < ITERATIONS; i++)
+    log_msg_unref(log_msg_new(raw_msg, raw_msg_len, NULL, &parse_options));
+  stop_stopwatch_and_display_result("log_msg_new() + log_msg_unref(), %d iterations", ITERATIONS);
+}
+
+static void
+bench_log_msg_clone(void)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *msg = log_msg_new(raw_msg, strlen(raw_msg), NULL, &parse_options);
+  gint i;
+
+  start_stopwatch();
+  for (i = 0; i < ITERATIONS; i++)
+    {
+      LogMessage *clone = log_msg_clone_cow(msg, &path_options);
+
+      log_msg_set_value(clone, LM_V_HOST, "newhost", -1);
+      log_msg_unref(clone);
+    }
+  stop_stopwatch_and_display_result("log_msg_clone_cow() + log_msg_set_value() + log_msg_unref(), %d iterations", ITERATIONS);
+  log_msg_unref(msg);
+}
+
+static void
+bench_log_msg_set_value(void)
+{
+  LogMessage *msg = log_msg_new_empty();
+  NVHandle handles[8];
+  gint i;
+
+  for (i = 0; i < 8; i++)
+    {
+      gchar name[32];
+
+      g_snprintf(name, sizeof(name), "perf.value%d", i);
+      handles[i] = log_msg_get_value_handle(name);
+    }
+
+  start_stopwatch();
+  for (i = 0; i < ITERATIONS; i++)
+    {
+      log_msg_set_value(msg, LM_V_PROGRAM, "program", 7);
+      log_msg_set_value(msg, handles[i % 8], "value", 5);
+    }
+  stop_stopwatch_and_display_result("log_msg_set_value(), %d iterations", ITERATIONS * 2);
+  log_msg_unref(msg);
+}
+
+static void
+bench_log_msg_get_value(void)
+{
+  LogMessage *msg = log_msg_new(raw_msg, strlen(raw_msg), NULL, &parse_options);
+  NVHandle sd_handle = log_msg_get_value_handle(".SDATA.exampleSDID@0.iut");
+  gsize len = 0;
+  gssize value_len;
+  gint i;
+
+  start_stopwatch();
+  for (i = 0; i < ITERATIONS; i++)
+    {
+      log_msg_get_value(msg, LM_V_HOST, &value_len);
+      len += value_len;
+      log_msg_get_value(msg, LM_V_MESSAGE, &value_len);
+      len += value_len;
+      log_msg_get_value(msg, sd_handle, &value_len);
+      len += value_len;
+    }
+  stop_stopwatch_and_display_result("log_msg_get_value(), %d iterations", ITERATIONS * 3);
+  assert_guint64(len, (guint64) ITERATIONS * (21 + 42 + 1), "Unexpected value lengths");
+  log_msg_unref(msg);
+}
+
+int
+main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
+{
+  app_startup();
+  init_and_load_syslogformat_module();
+  parse_options.flags |= LP_SYSLOG_PROTOCOL;
+
+  print_layout();
+  bench_log_msg_new();
+  bench_log_msg_clone();
+  bench_log_msg_set_value();
+  bench_log_msg_get_value();
+
+  deinit_syslogformat_module();
+  app_shutdown();
+  return 0;
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+/*
+ * LogQueueFifo benchmark
+ *
+ * Measures pushing and popping messages through the in-memory queue
+ * implementations, one message at a time and in batches, without and
+ * with a backlog.  It is not run as part of "make check", build and run
+ * it explicitly:
+ *
+ *   make tests/unit/bench_logqueue_fifo
+ *   ./tests/unit/bench_logqueue_fifo [iterations]
+ */
+
+#include "logqueue.h"
+#include "logqueue-fifo.h"
+#include "logmsg/logmsg.h"
+#include "apphook.h"
+#include "cfg.h"
+#include "bench.h"
+
+#define BENCH_DEFAULT_ITERATIONS 1000000
+#define BENCH_QUEUE_SIZE 100000
+#define BENCH_BATCH_SIZE 64
+
+typedef struct _BenchQueue
+{
+  LogQueue *queue;
+  LogMessage *msg;
+} BenchQueue;
+
+static void
+bench_push(BenchQueue *self)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  path_options.ack_needed = FALSE;
+  log_queue_push_tail(self->queue, log_msg_ref(self->msg), &path_options);
+}
+
+static void
+bench_push_pop(gpointer user_data, gint iterations)
+{
+  BenchQueue *self = (BenchQueue *) user_data;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gint i;
+
+  for (i = 0; i < iterations; i++)
+    {
+      bench_push(self);
+      log_msg_unref(log_queue_pop_head(self->queue, &path_options));
+    }
+}
+
+static void
+bench_push_pop_batch(gpointer user_data, gint iterations)
+{
+  BenchQueue *self = (BenchQueue *) user_data;
+  LogPathOptions path_options[BENCH_BATCH_SIZE];
+  LogMessage *msgs[BENCH_BATCH_SIZE];
+  gint i, j, n;
+
+  for (i = 0; i < iterations; i += BENCH_BATCH_SIZE)
+    {
+      n = MIN(BENCH_BATCH_SIZE, iterations - i);
+      for (j = 0; j < n; j++)
+        bench_push(self);
+
+      n = log_queue_pop_head_batch(self->queue, n, msgs, path_options);
+      for (j = 0; j < n; j++)
+        log_msg_unref(msgs[j]);
+    }
+}
+
+static void
+bench_push_pop_backlog(gpointer user_data, gint iterations)
+{
+  BenchQueue *self = (BenchQueue *) user_data;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gint i, j, n;
+
+  for (i = 0; i < iterations; i += BENCH_BATCH_SIZE)
+    {
+      n = MIN(BENCH_BATCH_SIZE, iterations - i);
+      for (j = 0; j < n; j++)
+        bench_push(self);
+      for (j = 0; j < n; j++)
+        log_msg_unref(log_queue_pop_head(self->queue, &path_options));
+      log_queue_ack_backlog(self->queue, n);
+    }
+}
+
+static void
+bench_queue(const gchar *name, LogQueue *(*construct)(gint qoverflow_size, const gchar *persist_name), gint iterations)
+{
+  BenchQueue bench;
+  gchar title[64];
+
+  bench.msg = log_msg_new_empty();
+
+  bench.queue = construct(BENCH_QUEUE_SIZE, NULL);
+  g_snprintf(title, sizeof(title), "%s/push+pop", name);
+  bench_run(title, bench_push_pop, &bench, iterations);
+  g_snprintf(title, sizeof(title), "%s/push+pop-batch", name);
+  bench_run(title, bench_push_pop_batch, &bench, iterations);
+
+  log_queue_set_use_backlog(bench.queue, TRUE);
+  g_snprintf(title, sizeof(title), "%s/push+pop+ack-backlog", name);
+  bench_run(title, bench_push_pop_backlog, &bench, iterations);
+  log_queue_unref(bench.queue);
+
+  log_msg_unref(bench.msg);
+}
+
+int
+main(int argc, char *argv[])
+{
+  gint iterations;
+
+  bench_init();
+  iterations = bench_get_iterations(argc, argv, BENCH_DEFAULT_ITERATIONS);
+
+  app_startup();
+  configuration = cfg_new(VERSION_VALUE);
+
+  printf("LogQueueFifo benchmark, %d iterations per round\n", iterations);
+  bench_queue("fifo", log_queue_fifo_new, iterations);
+  bench_queue("fifo-lockless", log_queue_fifo_new_lockless, iterations);
+  bench_queue("fifo-numa", log_queue_fifo_new_numa, iterations);
+
+  cfg_free(configuration);
+  app_shutdown();
+  return 0;
+}
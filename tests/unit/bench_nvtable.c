@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+/*
+ * NVTable benchmark
+ *
+ * Measures adding, overwriting and looking up static and dynamic values,
+ * cloning a populated table and looking up handles in the registry.  It
+ * is not run as part of "make check", build and run it explicitly:
+ *
+ *   make tests/unit/bench_nvtable
+ *   ./tests/unit/bench_nvtable [iterations]
+ */
+
+#include "logmsg/nvtable.h"
+#include "apphook.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define BENCH_DEFAULT_ITERATIONS 10000000
+#define BENCH_STATIC_VALUES 8
+#define BENCH_DYN_VALUES 64
+#define BENCH_VALUE "a typical value of a name-value pair"
+
+static const gchar *bench_static_names[] = { "S1", "S2", "S3", "S4", "S5", "S6", "S7", "S8", NULL };
+
+typedef struct _BenchNVTable
+{
+  NVTable *table;
+  NVRegistry *registry;
+  NVHandle handles[BENCH_DYN_VALUES];
+  gchar names[BENCH_DYN_VALUES][16];
+} BenchNVTable;
+
+static void
+bench_add_value(BenchNVTable *self, gint i)
+{
+  NVHandle handle;
+  const gchar *name;
+  gsize name_len;
+
+  if (i < BENCH_STATIC_VALUES)
+    {
+      handle = i + 1;
+      name = bench_static_names[i];
+      name_len = strlen(name);
+    }
+  else
+    {
+      handle = self->handles[i - BENCH_STATIC_VALUES];
+      name = self->names[i - BENCH_STATIC_VALUES];
+      name_len = strlen(name);
+    }
+  nv_table_add_value(self->table, handle, name, name_len, BENCH_VALUE, sizeof(BENCH_VALUE) - 1, NULL);
+}
+
+static void
+bench_populate(BenchNVTable *self)
+{
+  gint i;
+
+  nv_table_clear(self->table);
+  for (i = 0; i < BENCH_STATIC_VALUES + BENCH_DYN_VALUES; i++)
+    bench_add_value(self, i);
+}
+
+static void
+bench_add_static(gpointer user_data, gint iterations)
+{
+  BenchNVTable *self = (BenchNVTable *) user_data;
+  gint i;
+
+  for (i = 0; i < iterations; i++)
+    {
+      if (i % BENCH_STATIC_VALUES == 0)
+        nv_table_clear(self->table);
+      bench_add_value(self, i % BENCH_STATIC_VALUES);
+    }
+}
+
+static void
+bench_add_dynamic(gpointer user_data, gint iterations)
+{
+  BenchNVTable *self = (BenchNVTable *) user_data;
+  gint i;
+
+  for (i = 0; i < iterations; i++)
+    {
+      if (i % BENCH_DYN_VALUES == 0)
+        nv_table_clear(self->table);
+      bench_add_value(self, BENCH_STATIC_VALUES + i % BENCH_DYN_VALUES);
+    }
+}
+
+static void
+bench_overwrite_dynamic(gpointer user_data, gint iterations)
+{
+  BenchNVTable *self = (BenchNVTable *) user_data;
+  gint i;
+
+  bench_populate(self);
+  for (i = 0; i < iterations; i++)
+    bench_add_value(self, BENCH_STATIC_VALUES + i % BENCH_DYN_VALUES);
+}
+
+static volatile gssize bench_sink;
+
+static void
+bench_get_static(gpointer user_data, gint iterations)
+{
+  BenchNVTable *self = (BenchNVTable *) user_data;
+  gssize len;
+  gint i;
+
+  bench_populate(self);
+  for (i = 0; i < iterations; i++)
+    {
+      nv_table_get_value(self->table, i % BENCH_STATIC_VALUES + 1, &len);
+      bench_sink += len;
+    }
+}
+
+static void
+bench_get_dynamic(gpointer user_data, gint iterations)
+{
+  BenchNVTable *self = (BenchNVTable *) user_data;
+  gssize len;
+  gint i;
+
+  bench_populate(self);
+  for (i = 0; i < iterations; i++)
+    {
+      nv_table_get_value(self->table, self->handles[i % BENCH_DYN_VALUES], &len);
+      bench_sink += len;
+    }
+}
+
+static void
+bench_clone(gpointer user_data, gint iterations)
+{
+  BenchNVTable *self = (BenchNVTable *) user_data;
+  gint i;
+
+  bench_populate(self);
+  for (i = 0; i < iterations; i++)
+    nv_table_unref(nv_table_clone(self->table, 256));
+}
+
+static void
+bench_registry_lookup(gpointer user_data, gint iterations)
+{
+  BenchNVTable *self = (BenchNVTable *) user_data;
+  gint i;
+
+  for (i = 0; i < iterations; i++)
+    bench_sink += nv_registry_alloc_handle(self->registry, self->names[i % BENCH_DYN_VALUES]);
+}
+
+int
+main(int argc, char *argv[])
+{
+  BenchNVTable bench;
+  gint iterations, i;
+
+  bench_init();
+  iterations = bench_get_iterations(argc, argv, BENCH_DEFAULT_ITERATIONS);
+  app_startup();
+
+  bench.registry = nv_registry_new(bench_static_names);
+  for (i = 0; i < BENCH_DYN_VALUES; i++)
+    {
+      g_snprintf(bench.names[i], sizeof(bench.names[i]), "app.field%d", i);
+      bench.handles[i] = nv_registry_alloc_handle(bench.registry, bench.names[i]);
+    }
+  bench.table = nv_table_new(BENCH_STATIC_VALUES, BENCH_DYN_VALUES, 8192);
+
+  printf("NVTable benchmark, %d iterations per round\n", iterations);
+  bench_run("add-static", bench_add_static, &bench, iterations);
+  bench_run("add-dynamic", bench_add_dynamic, &bench, iterations);
+  bench_run("overwrite-dynamic", bench_overwrite_dynamic, &bench, iterations);
+  bench_run("get-static", bench_get_static, &bench, iterations);
+  bench_run("get-dynamic", bench_get_dynamic, &bench, iterations);
+  bench_run("clone", bench_clone, &bench, MAX(iterations / 10, 1));
+  bench_run("registry-lookup", bench_registry_lookup, &bench, iterations);
+
+  nv_table_unref(bench.table);
+  nv_registry_free(bench.registry);
+  app_shutdown();
+  return 0;
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+/*
+ * RingBuffer benchmark
+ *
+ * Measures pushing and popping elements, both interleaved and filling up
+ * the buffer first, and scanning the continual range at the head.  It is
+ * not run as part of "make check", build and run it explicitly:
+ *
+ *   make tests/unit/bench_ringbuffer
+ *   ./tests/unit/bench_ringbuffer [iterations]
+ */
+
+#include "ringbuffer.h"
+#include "bench.h"
+
+#include <stdio.h>
+
+#define BENCH_DEFAULT_ITERATIONS 10000000
+#define BENCH_CAPACITY 1024
+
+typedef struct _BenchElement
+{
+  gint id;
+  gboolean acked;
+} BenchElement;
+
+static void
+bench_push_pop(gpointer user_data, gint iterations)
+{
+  RingBuffer *rb = (RingBuffer *) user_data;
+  BenchElement *element;
+  gint i;
+
+  for (i = 0; i < iterations; i++)
+    {
+      element = ring_buffer_push(rb);
+      element->id = i;
+      ring_buffer_pop(rb);
+    }
+}
+
+static void
+bench_fill_drain(gpointer user_data, gint iterations)
+{
+  RingBuffer *rb = (RingBuffer *) user_data;
+  BenchElement *element;
+  gint i = 0;
+
+  while (i < iterations)
+    {
+      while (i < iterations && !ring_buffer_is_full(rb))
+        {
+          element = ring_buffer_push(rb);
+          element->id = i++;
+        }
+      while (!ring_buffer_is_empty(rb))
+        ring_buffer_pop(rb);
+    }
+}
+
+static gboolean
+bench_is_acked(gpointer element)
+{
+  return ((BenchElement *) element)->acked;
+}
+
+static void
+bench_continual_range(gpointer user_data, gint iterations)
+{
+  RingBuffer *rb = (RingBuffer *) user_data;
+  BenchElement *element;
+  gint i;
+
+  while (!ring_buffer_is_full(rb))
+    {
+      element = ring_buffer_push(rb);
+      element->acked = TRUE;
+    }
+
+  /* one operation is checking one element of the range */
+  for (i = 0; i < iterations; i += BENCH_CAPACITY)
+    ring_buffer_get_continual_range_length(rb, bench_is_acked);
+
+  ring_buffer_drop(rb, ring_buffer_count(rb));
+}
+
+int
+main(int argc, char *argv[])
+{
+  RingBuffer rb;
+  gint iterations;
+
+  bench_init();
+  iterations = bench_get_iterations(argc, argv, BENCH_DEFAULT_ITERATIONS);
+
+  ring_buffer_init(&rb);
+  ring_buffer_alloc(&rb, sizeof(BenchElement), BENCH_CAPACITY);
+
+  printf("RingBuffer benchmark, %d iterations per round\n", iterations);
+  bench_run("push+pop", bench_push_pop, &rb, iterations);
+  bench_run("fill+drain", bench_fill_drain, &rb, iterations);
+  bench_run("continual-range/element", bench_continual_range, &rb, iterations);
+
+  ring_buffer_free(&rb);
+  return 0;
+}
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+/*
+ * Serialization benchmark
+ *
+ * Measures writing and reading a record of typical fields (integers,
+ * varints and a string) through the string and buffer archives, and the
+ * serialization of a complete LogMessage as done by disk queues.  It is
+ * not run as part of "make check", build and run it explicitly:
+ *
+ *   make tests/unit/bench_serialize
+ *   ./tests/unit/bench_serialize [iterations]
+ */
+
+#include "serialize.h"
+#include "logmsg/logmsg.h"
+#include "logmsg/logmsg-serialize.h"
+#include "apphook.h"
+#include "cfg.h"
+#include "bench.h"
+
+#include <stdio.h>
+
+#define BENCH_DEFAULT_ITERATIONS 1000000
+#define BENCH_RECORDS_PER_ARCHIVE 1024
+#define BENCH_BUFFER_SIZE (BENCH_RECORDS_PER_ARCHIVE * 64)
+
+typedef struct _BenchSerialize
+{
+  GString *stream;
+  gchar *buffer;
+  LogMessage *msg;
+} BenchSerialize;
+
+static void
+bench_write_record(SerializeArchive *sa, guint32 i)
+{
+  serialize_write_uint32(sa, i);
+  serialize_write_uint64(sa, (guint64) i << 20);
+  serialize_write_varint(sa, i);
+  serialize_write_cstring(sa, "some.name.value-pair: the value", -1);
+}
+
+static void
+bench_read_record(SerializeArchive *sa)
+{
+  guint32 u32;
+  guint64 u64;
+  gchar *str;
+  gsize len;
+
+  serialize_read_uint32(sa, &u32);
+  serialize_read_uint64(sa, &u64);
+  serialize_read_varint(sa, &u64);
+  serialize_read_cstring(sa, &str, &len);
+  g_free(str);
+}
+
+static void
+bench_string_archive_write(gpointer user_data, gint iterations)
+{
+  BenchSerialize *self = (BenchSerialize *) user_data;
+  SerializeArchive *sa = NULL;
+  gint i;
+
+  for (i = 0; i < iterations; i++)
+    {
+      if (i % BENCH_RECORDS_PER_ARCHIVE == 0)
+        {
+          if (sa)
+            serialize_archive_free(sa);
+          g_string_truncate(self->stream, 0);
+          sa = serialize_string_archive_new(self->stream);
+        }
+      bench_write_record(sa, i);
+    }
+  serialize_archive_free(sa);
+}
+
+static void
+bench_string_archive_read(gpointer user_data, gint iterations)
+{
+  BenchSerialize *self = (BenchSerialize *) user_data;
+  SerializeArchive *sa = NULL;
+  gint i;
+
+  g_string_truncate(self->stream, 0);
+  sa = serialize_string_archive_new(self->stream);
+  for (i = 0; i < BENCH_RECORDS_PER_ARCHIVE; i++)
+    bench_write_record(sa, i);
+  serialize_archive_free(sa);
+  sa = NULL;
+
+  for (i = 0; i < iterations; i++)
+    {
+      if (i % BENCH_RECORDS_PER_ARCHIVE == 0)
+        {
+          if (sa)
+            serialize_archive_free(sa);
+          sa = serialize_string_archive_new(self->stream);
+        }
+      bench_read_record(sa);
+    }
+  serialize_archive_free(sa);
+}
+
+static void
+bench_buffer_archive_write(gpointer user_data, gint iterations)
+{
+  BenchSerialize *self = (BenchSerialize *) user_data;
+  SerializeArchive *sa = NULL;
+  gint i;
+
+  for (i = 0; i < iterations; i++)
+    {
+      if (i % BENCH_RECORDS_PER_ARCHIVE == 0)
+        {
+          if (sa)
+            serialize_archive_free(sa);
+          sa = serialize_buffer_archive_new(self->buffer, BENCH_BUFFER_SIZE);
+        }
+      bench_write_record(sa, i);
+    }
+  serialize_archive_free(sa);
+}
+
+static void
+bench_log_msg_serialize(gpointer user_data, gint iterations)
+{
+  BenchSerialize *self = (BenchSerialize *) user_data;
+  SerializeArchive *sa;
+  gint i;
+
+  for (i = 0; i < iterations; i++)
+    {
+      g_string_truncate(self->stream, 0);
+      sa = serialize_string_archive_new(self->stream);
+      log_msg_serialize(self->msg, sa);
+      serialize_archive_free(sa);
+    }
+}
+
+static void
+bench_log_msg_deserialize(gpointer user_data, gint iterations)
+{
+  BenchSerialize *self = (BenchSerialize *) user_data;
+  SerializeArchive *sa;
+  LogMessage *msg;
+  gint i;
+
+  g_string_truncate(self->stream, 0);
+  sa = serialize_string_archive_new(self->stream);
+  log_msg_serialize(self->msg, sa);
+  serialize_archive_free(sa);
+
+  for (i = 0; i < iterations; i++)
+    {
+      msg = log_msg_new_empty();
+      sa = serialize_string_archive_new(self->stream);
+      log_msg_deserialize(msg, sa);
+      serialize_archive_free(sa);
+      log_msg_unref(msg);
+    }
+}
+
+static LogMessage *
+bench_create_message(void)
+{
+  LogMessage *msg = log_msg_new_empty();
+  gchar name[32], value[32];
+  gint i;
+
+  log_msg_set_value(msg, LM_V_HOST, "bzorp", -1);
+  log_msg_set_value(msg, LM_V_PROGRAM, "syslog-ng", -1);
+  log_msg_set_value(msg, LM_V_PID, "23323", -1);
+  log_msg_set_value(msg, LM_V_MESSAGE, "árvíztűrőtükörfúrógép and some more text to make up a typical message", -1);
+  log_msg_set_tag_by_name(msg, "alma");
+  for (i = 0; i < 16; i++)
+    {
+      g_snprintf(name, sizeof(name), "app.field%d", i);
+      g_snprintf(value, sizeof(value), "value of field %d", i);
+      log_msg_set_value_by_name(msg, name, value, -1);
+    }
+  return msg;
+}
+
+int
+main(int argc, char *argv[])
+{
+  BenchSerialize bench;
+  gint iterations;
+
+  bench_init();
+  iterations = bench_get_iterations(argc, argv, BENCH_DEFAULT_ITERATIONS);
+
+  app_startup();
+  configuration = cfg_new(VERSION_VALUE);
+
+  bench.stream = g_string_sized_new(BENCH_BUFFER_SIZE);
+  bench.buffer = g_malloc(BENCH_BUFFER_SIZE);
+  bench.msg = bench_create_message();
+
+  printf("Serialization benchmark, %d iterations per round\n", iterations);
+  bench_run("string-archive/write-record", bench_string_archive_write, &bench, iterations);
+  bench_run("string-archive/read-record", bench_string_archive_read, &bench, iterations);
+  bench_run("buffer-archive/write-record", bench_buffer_archive_write, &bench, iterations);
+  bench_run("log_msg_serialize", bench_log_msg_serialize, &bench, MAX(iterations / 10, 1));
+  bench_run("log_msg_deserialize", bench_log_msg_deserialize, &bench, MAX(iterations / 10, 1));
+
+  log_msg_unref(bench.msg);
+  g_free(bench.buffer);
+  g_string_free(bench.stream, TRUE);
+  cfg_free(configuration);
+  app_shutdown();
+  return 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2016 Balabit
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "testutils.h"
+#include "cpu-topology.h"
+#include "apphook.h"
+
+static void
+test_cpu_lists_are_mapped_to_nodes(void)
+{
+  assert_true(cpu_topology_parse_cpu_list("0-3,8\n", 0), "Error parsing CPU list");
+  assert_true(cpu_topology_parse_cpu_list("4-7,9-11", 1), "Error parsing CPU list");
+
+  assert_gint(cpu_topology_get_num_nodes(), 2, "Unexpected number of NUMA nodes");
+  assert_gint(cpu_topology_get_node_of_cpu(0), 0, "CPU mapped to the wrong node");
+  assert_gint(cpu_topology_get_node_of_cpu(3), 0, "CPU mapped to the wrong node");
+  assert_gint(cpu_topology_get_node_of_cpu(5), 1, "CPU mapped to the wrong node");
+  assert_gint(cpu_topology_get_node_of_cpu(8), 0, "CPU mapped to the wrong node");
+  assert_gint(cpu_topology_get_node_of_cpu(10), 1, "CPU mapped to the wrong node");
+  assert_gint(cpu_topology_get_node_of_cpu(4096), 0, "Unknown CPUs should be on node 0");
+}
+
+static void
+test_invalid_cpu_lists_are_rejected(void)
+{
+  assert_false(cpu_topology_parse_cpu_list("foo", 0), "Invalid CPU list accepted");
+  assert_false(cpu_topology_parse_cpu_list("3-1", 0), "Invalid CPU range accepted");
+  assert_false(cpu_topology_parse_cpu_list("0-1", 1024), "Invalid node accepted");
+}
+
+int
+main(int argc, char **argv)
+{
+  app_startup();
+
+  test_cpu_lists_are_mapped_to_nodes();
+  test_invalid_cpu_lists_are_rejected();
+
+  /* restore the real topology */
+  cpu_topology_global_init();
+  app_shutdown();
+  return 0;
+}
@@ -131,6 +131,68 @@ test_expiration(void)
     }
 }
 
+static gpointer
+_lookup_in_other_thread(gpointer user_data)
+{
+  guint32 ni = htonl(GPOINTER_TO_UINT(user_data));
+  const gchar *hn = NULL;
+  gsize hn_len;
+  gboolean positive = FALSE;
+  gboolean found;
+
+  dns_cache_thread_init();
+  found = dns_cache_lookup(AF_INET, (void *) &ni, &hn, &hn_len, &positive) && positive && strcmp(hn, "shared") == 0;
+  dns_cache_thread_deinit();
+  return GINT_TO_POINTER(found);
+}
+
+void
+test_entries_are_shared_between_threads(void)
+{
+  guint32 ni = htonl(20000);
+  GThread *thread;
+
+  dns_cache_set_params(50000, 600, 300, NULL);
+  dns_cache_store_dynamic(AF_INET, (void *) &ni, "shared", TRUE);
+
+  thread = g_thread_create(_lookup_in_other_thread, GUINT_TO_POINTER(20000), TRUE, NULL);
+  if (!GPOINTER_TO_INT(g_thread_join(thread)))
+    {
+      fprintf(stderr, "hmm, an entry stored by one thread is not found by another one\n");
+      exit(1);
+    }
+}
+
+void
+test_background_resolution_results(void)
+{
+  guint32 ni = htonl(30000);
+  const gchar *hn = NULL;
+  gsize hn_len;
+  gboolean positive;
+
+  dns_cache_set_params(50000, 600, 300, NULL);
+
+  if (!dns_cache_start_resolution(AF_INET, (void *) &ni) || dns_cache_start_resolution(AF_INET, (void *) &ni))
+    {
+      fprintf(stderr, "hmm, a second resolution of the same address was started\n");
+      exit(1);
+    }
+  dns_cache_finish_resolution(AF_INET, (void *) &ni, "0.0.117.48", FALSE);
+
+  if (!dns_cache_lookup(AF_INET, (void *) &ni, &hn, &hn_len, &positive) || positive || strcmp(hn, "0.0.117.48") != 0)
+    {
+      fprintf(stderr, "hmm, the result of a background resolution is not in the cache\n");
+      exit(1);
+    }
+  if (!dns_cache_start_resolution(AF_INET, (void *) &ni))
+    {
+      fprintf(stderr, "hmm, a finished resolution is still pending\n");
+      exit(1);
+    }
+  dns_cache_finish_resolution(AF_INET, (void *) &ni, "0.0.117.48", FALSE);
+}
+
 void
 test_dns_cache_benchmark(void)
 {
@@ -171,6 +233,8 @@ main()
   app_startup();
 
   test_expiration();
+  test_entries_are_shared_between_threads();
+  test_background_resolution_results();
   test_dns_cache_benchmark();
 
   app_shutdown();
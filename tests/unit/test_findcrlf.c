@@ -23,6 +23,7 @@
 #include "find-crlf.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 static void
 testcase(gchar *msg, gsize msg_len, gsize eom_ofs)
@@ -46,6 +47,28 @@ testcase(gchar *msg, gsize msg_len, gsize eom_ofs)
     }
 }
 
+/* exercise every position in and around the 16 byte blocks of the vectorized scanner */
+static void
+testcase_long_buffers(void)
+{
+  gchar buf[100];
+  gint eom_ofs;
+
+  for (eom_ofs = 0; eom_ofs < sizeof(buf); eom_ofs++)
+    {
+      memset(buf, 'a', sizeof(buf));
+      buf[eom_ofs] = '\n';
+      testcase(buf, sizeof(buf), eom_ofs);
+      testcase(buf, eom_ofs, -1);
+
+      buf[eom_ofs] = '\r';
+      testcase(buf, sizeof(buf), eom_ofs);
+
+      buf[eom_ofs] = '\0';
+      testcase(buf, sizeof(buf), -1);
+    }
+}
+
 int
 main()
 {
@@ -130,5 +153,11 @@ main()
   testcase("abcdefghijklmnopqrstuvwxy", 25, -1);
   testcase("abcdefghijklmnopqrstuvwxyz", 26, -1);
 
+  testcase("ab\0\nc\n", 6, -1);
+  testcase("abcdefghijklmnopqrs\0\rb\n", 22, -1);
+  testcase("abcdefghijklmnopqrs\rb\0", 22, 19);
+
+  testcase_long_buffers();
+
   return 0;
 }
@@ -29,6 +29,8 @@
 #include "tls-support.h"
 #include "mainloop-io-worker.h"
 #include "libtest/queue_utils_lib.h"
+#include "stats/stats.h"
+#include "stats/stats-registry.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -91,13 +93,251 @@ testcase_zero_diskbuf_alternating_send_acks()
   log_queue_unref(q);
 }
 
-#define FEEDERS 1
+#define POP_BATCH_SIZE 64
+
+void
+testcase_pop_head_batch_and_unpop()
+{
+  LogQueue *q;
+  LogMessage *msgs[POP_BATCH_SIZE];
+  LogPathOptions path_options[POP_BATCH_SIZE];
+  gint i, num_msgs;
+
+  q = log_queue_fifo_new(OVERFLOW_SIZE, NULL);
+  log_queue_set_use_backlog(q, TRUE);
+
+  fed_messages = 0;
+  acked_messages = 0;
+  feed_some_messages(q, 100, &parse_options);
+
+  for (i = 0; i < POP_BATCH_SIZE; i++)
+    path_options[i] = (LogPathOptions) LOG_PATH_OPTIONS_INIT;
+  num_msgs = log_queue_pop_head_batch(q, POP_BATCH_SIZE, msgs, path_options);
+  if (num_msgs != POP_BATCH_SIZE || log_queue_get_length(q) != 100 - POP_BATCH_SIZE)
+    {
+      fprintf(stderr, "pop_head_batch returned an unexpected number of messages: num_msgs=%d, queue_length=%d\n",
+              num_msgs, (gint) log_queue_get_length(q));
+      exit(1);
+    }
+
+  log_queue_unpop_batch(q, &msgs[32], &path_options[32], num_msgs - 32);
+  if (log_queue_get_length(q) != 100 - 32)
+    {
+      fprintf(stderr, "unpop_batch did not put back the unprocessed messages: queue_length=%d\n",
+              (gint) log_queue_get_length(q));
+      exit(1);
+    }
+
+  for (i = 0; i < 32; i++)
+    {
+      log_msg_ack(msgs[i], &path_options[i], AT_PROCESSED);
+      log_msg_unref(msgs[i]);
+    }
+  send_some_messages(q, 100 - 32);
+  app_ack_some_messages(q, 100);
+  if (fed_messages != acked_messages)
+    {
+      fprintf(stderr, "did not receive enough acknowledgements: fed_messages=%d, acked_messages=%d\n", fed_messages, acked_messages);
+      exit(1);
+    }
+
+  log_queue_unref(q);
+}
+
+void
+testcase_flow_control_budget_releases_the_window()
+{
+  LogQueue *q;
+
+  q = log_queue_fifo_new(OVERFLOW_SIZE, NULL);
+  log_queue_set_use_backlog(q, TRUE);
+  log_queue_set_flow_control_budget(q, 20);
+
+  fed_messages = 0;
+  acked_messages = 0;
+  feed_some_messages(q, 100, &parse_options);
+  if (acked_messages != 80 || log_queue_get_length(q) != 100)
+    {
+      fprintf(stderr, "messages over the flow-control budget were not acked early: acked_messages=%d, queue_length=%d\n",
+              acked_messages, (gint) log_queue_get_length(q));
+      exit(1);
+    }
+
+  send_some_messages(q, fed_messages);
+  app_ack_some_messages(q, fed_messages);
+  if (fed_messages != acked_messages)
+    {
+      fprintf(stderr, "did not receive enough acknowledgements: fed_messages=%d, acked_messages=%d\n", fed_messages, acked_messages);
+      exit(1);
+    }
+
+  log_queue_unref(q);
+}
+
+static void
+_push_message_with_pri(LogQueue *q, guint16 pri)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *msg = log_msg_new_empty();
+
+  msg->pri = pri;
+  log_queue_push_tail(q, msg, &path_options);
+}
+
+static gint
+_pop_message_pri(LogQueue *q)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *msg = log_queue_pop_head(q, &path_options);
+  gint pri = msg->pri;
+
+  log_msg_unref(msg);
+  return pri;
+}
+
+void
+testcase_priority_lanes()
+{
+  LogQueue *q;
+  gint i, pri;
+
+  q = log_queue_fifo_new(OVERFLOW_SIZE, NULL);
+  log_queue_fifo_set_lanes(q, 3, FALSE);
+
+  _push_message_with_pri(q, LOG_LOCAL0 | LOG_DEBUG);
+  _push_message_with_pri(q, LOG_LOCAL0 | LOG_WARNING);
+  _push_message_with_pri(q, LOG_AUTH | LOG_INFO);
+  _push_message_with_pri(q, LOG_LOCAL0 | LOG_EMERG);
+
+  if ((pri = _pop_message_pri(q)) != (LOG_AUTH | LOG_INFO) ||
+      (pri = _pop_message_pri(q)) != (LOG_LOCAL0 | LOG_EMERG) ||
+      (pri = _pop_message_pri(q)) != (LOG_LOCAL0 | LOG_WARNING) ||
+      (pri = _pop_message_pri(q)) != (LOG_LOCAL0 | LOG_DEBUG))
+    {
+      fprintf(stderr, "strict priority lanes returned messages in the wrong order: pri=%d\n", pri);
+      exit(1);
+    }
+  log_queue_unref(q);
+
+  q = log_queue_fifo_new(OVERFLOW_SIZE, NULL);
+  log_queue_fifo_set_lanes(q, 2, TRUE);
+  for (i = 0; i < 4; i++)
+    _push_message_with_pri(q, LOG_LOCAL0 | LOG_DEBUG);
+  for (i = 0; i < 4; i++)
+    _push_message_with_pri(q, LOG_LOCAL0 | LOG_CRIT);
+
+  /* lane 0 gets two items for each one of lane 1 */
+  for (i = 0; i < 6; i++)
+    {
+      pri = _pop_message_pri(q);
+      if ((pri == (LOG_LOCAL0 | LOG_DEBUG)) != (i % 3 == 2))
+        {
+          fprintf(stderr, "weighted priority lanes returned messages in the wrong order: i=%d, pri=%d\n", i, pri);
+          exit(1);
+        }
+    }
+  if (log_queue_get_length(q) != 2)
+    {
+      fprintf(stderr, "weighted priority lanes lost messages: queue_length=%d\n", (gint) log_queue_get_length(q));
+      exit(1);
+    }
+  log_queue_unref(q);
+}
+
+void
+testcase_fifo_bytes_limit()
+{
+  LogQueue *q;
+  LogMessage *msg;
+  gsize msg_size;
+  gint i;
+
+  msg = log_msg_new_empty();
+  msg_size = log_msg_get_memory_size(msg);
+  log_msg_unref(msg);
+
+  q = log_queue_fifo_new(OVERFLOW_SIZE, NULL);
+  log_queue_set_memory_limit(q, 5 * msg_size);
+  for (i = 0; i < 10; i++)
+    _push_message_with_pri(q, LOG_LOCAL0 | LOG_INFO);
+
+  if (log_queue_get_length(q) != 5 || (gsize) log_queue_get_memory_usage(q) != 5 * msg_size)
+    {
+      fprintf(stderr, "log-fifo-bytes() was not enforced: queue_length=%d, memory_usage=%d\n",
+              (gint) log_queue_get_length(q), (gint) log_queue_get_memory_usage(q));
+      exit(1);
+    }
+
+  for (i = 0; i < 5; i++)
+    _pop_message_pri(q);
+  if (log_queue_get_memory_usage(q) != 0)
+    {
+      fprintf(stderr, "memory usage is not released when messages leave the queue: memory_usage=%d\n",
+              (gint) log_queue_get_memory_usage(q));
+      exit(1);
+    }
+  log_queue_unref(q);
+}
+
+void
+testcase_queue_gauges()
+{
+  static StatsOptions options;
+  LogQueue *q;
+  GTimeVal now;
+  gint i;
+
+  stats_options_defaults(&options);
+  options.level = 2;
+  stats_reinit(&options);
+
+  q = log_queue_fifo_new(OVERFLOW_SIZE, NULL);
+  log_queue_set_use_backlog(q, TRUE);
+
+  stats_lock();
+  log_queue_register_stats_counters(q, 0, SCS_DESTINATION, "test_queue_gauges", NULL);
+  stats_unlock();
+
+  g_get_current_time(&now);
+  log_queue_update_stats_counters(q, &now);
+
+  for (i = 0; i < 10; i++)
+    _push_message_with_pri(q, LOG_LOCAL0 | LOG_INFO);
+  for (i = 0; i < 4; i++)
+    _pop_message_pri(q);
+
+  g_time_val_add(&now, G_USEC_PER_SEC);
+  log_queue_update_stats_counters(q, &now);
+
+  if (stats_counter_get(q->stats.push_rate) != 10 ||
+      stats_counter_get(q->stats.pop_rate) != 4 ||
+      stats_counter_get(q->stats.backlog) != 4 ||
+      stats_counter_get(q->stats.memory_usage) != log_queue_get_memory_usage(q) ||
+      log_queue_get_memory_usage(q) == 0)
+    {
+      fprintf(stderr, "queue gauges mismatch: push_rate=%d, pop_rate=%d, backlog=%d, memory_usage=%d\n",
+              (gint) stats_counter_get(q->stats.push_rate), (gint) stats_counter_get(q->stats.pop_rate),
+              (gint) stats_counter_get(q->stats.backlog), (gint) stats_counter_get(q->stats.memory_usage));
+      exit(1);
+    }
+
+  log_queue_ack_backlog(q, 4);
+  stats_lock();
+  log_queue_unregister_stats_counters(q, SCS_DESTINATION, "test_queue_gauges", NULL);
+  stats_unlock();
+  log_queue_unref(q);
+}
+
+#define MAX_FEEDERS 16
 #define MESSAGES_PER_FEEDER 30000
-#define MESSAGES_SUM (FEEDERS * MESSAGES_PER_FEEDER)
+#define MESSAGES_SUM (num_feeders * MESSAGES_PER_FEEDER)
 #define TEST_RUNS 10
 
+typedef LogQueue *(*LogQueueConstructor)(gint qoverflow_size, const gchar *persist_name);
+
 GStaticMutex tlock;
 glong sum_time;
+gint num_feeders;
 
 gpointer
 threaded_feed(gpointer args)
@@ -215,21 +455,23 @@ output_thread(gpointer args)
 
 
 void
-testcase_with_threads()
+testcase_with_threads(LogQueueConstructor queue_new, gint feeders, const gchar *queue_type)
 {
   LogQueue *q;
-  GThread *thread_feed[FEEDERS], *thread_consume;
-  GThread *other_threads[FEEDERS];
+  GThread *thread_feed[MAX_FEEDERS], *thread_consume;
+  GThread *other_threads[MAX_FEEDERS];
   gint i, j;
 
-  log_queue_set_max_threads(FEEDERS);
+  num_feeders = feeders;
+  sum_time = 0;
+  log_queue_set_max_threads(num_feeders);
   for (i = 0; i < TEST_RUNS; i++)
     {
       fprintf(stderr,"starting testrun: %d\n",i);
-      q = log_queue_fifo_new(MESSAGES_SUM, NULL);
+      q = queue_new(MESSAGES_SUM, NULL);
       log_queue_set_use_backlog(q, TRUE);
 
-      for (j = 0; j < FEEDERS; j++)
+      for (j = 0; j < num_feeders; j++)
         {
           fprintf(stderr,"starting feed thread %d\n",j);
           other_threads[j] = g_thread_create(output_thread, NULL, TRUE, NULL);
@@ -238,17 +480,23 @@ testcase_with_threads()
 
       thread_consume = g_thread_create(threaded_consume, q, TRUE, NULL);
 
-      for (j = 0; j < FEEDERS; j++)
+      for (j = 0; j < num_feeders; j++)
       {
         fprintf(stderr,"waiting for feed thread %d\n",j);
         g_thread_join(thread_feed[j]);
         g_thread_join(other_threads[j]);
       }
-      g_thread_join(thread_consume);
+      if (g_thread_join(thread_consume))
+        {
+          fprintf(stderr, "consumer thread failed, queue_type=%s, feeders=%d\n", queue_type, num_feeders);
+          exit(1);
+        }
 
       log_queue_unref(q);
     }
-  fprintf(stderr, "Feed speed: %.2lf\n", (double) TEST_RUNS * MESSAGES_SUM * 1000000 / sum_time);
+  /* sum_time is the sum of the feeder runtimes, so this is the per-feeder rate */
+  fprintf(stderr, "Feed speed: %.2lf, queue_type=%s, feeders=%d\n",
+          (double) TEST_RUNS * MESSAGES_SUM * 1000000 / sum_time, queue_type, num_feeders);
 }
 
 int
@@ -264,13 +512,29 @@ main()
   msg_format_options_init(&parse_options, configuration);
 
   fprintf(stderr,"Start testcase_with_threads\n");
-  testcase_with_threads();
+  testcase_with_threads(log_queue_fifo_new, 1, "fifo");
+
+  /* contention benchmark, many input threads feeding a single queue */
+  testcase_with_threads(log_queue_fifo_new, MAX_FEEDERS, "fifo");
+  testcase_with_threads(log_queue_fifo_new_lockless, 1, "fifo-lockless");
+  testcase_with_threads(log_queue_fifo_new_lockless, MAX_FEEDERS, "fifo-lockless");
+  testcase_with_threads(log_queue_fifo_new_numa, MAX_FEEDERS, "fifo-numa");
 
 #if 1
   fprintf(stderr,"Start testcase_zero_diskbuf_alternating_send_acks\n");
   testcase_zero_diskbuf_alternating_send_acks();
   fprintf(stderr,"Start testcase_zero_diskbuf_and_normal_acks\n");
   testcase_zero_diskbuf_and_normal_acks();
+  fprintf(stderr,"Start testcase_pop_head_batch_and_unpop\n");
+  testcase_pop_head_batch_and_unpop();
+  fprintf(stderr,"Start testcase_flow_control_budget_releases_the_window\n");
+  testcase_flow_control_budget_releases_the_window();
+  fprintf(stderr,"Start testcase_priority_lanes\n");
+  testcase_priority_lanes();
+  fprintf(stderr,"Start testcase_fifo_bytes_limit\n");
+  testcase_fifo_bytes_limit();
+  fprintf(stderr,"Start testcase_queue_gauges\n");
+  testcase_queue_gauges();
 #endif
   return 0;
 }
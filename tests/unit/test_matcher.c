@@ -129,6 +129,76 @@ testcase_replace(const gchar *log, const gchar *re, gchar *replacement, const gc
   return 0;
 }
 
+static void
+assert_cached_match(LogMatcher *m, LogMessage *msg, const gchar *value, gboolean expected_result)
+{
+  gint i;
+
+  /* the second round is answered from the cache */
+  for (i = 0; i < 2; i++)
+    {
+      if (log_matcher_match(m, msg, LM_V_PROGRAM, value, -1) != expected_result)
+        {
+          fprintf(stderr, "Cached match failure. value=%s, round=%d, expected=%d\n", value, i, expected_result);
+          exit(1);
+        }
+    }
+}
+
+static void
+assert_cached_replace(LogMatcher *m, LogMessage *msg, const gchar *value, LogTemplate *replacement, const gchar *expected_result)
+{
+  gchar *result;
+  gssize length;
+  gint i;
+
+  for (i = 0; i < 2; i++)
+    {
+      length = -1;
+      result = log_matcher_replace(m, msg, LM_V_PROGRAM, value, -1, replacement, &length);
+      if ((result == NULL) != (expected_result == NULL) ||
+          (result && (length != strlen(expected_result) || memcmp(result, expected_result, length) != 0)))
+        {
+          fprintf(stderr, "Cached replace failure. value=%s, round=%d, result=%s, expected=%s\n",
+                  value, i, result ? result : "(null)", expected_result ? expected_result : "(null)");
+          exit(1);
+        }
+      g_free(result);
+    }
+}
+
+static void
+test_result_cache(void)
+{
+  LogMessage *msg = log_msg_new_empty();
+  LogTemplate *replacement;
+  LogMatcher *m;
+
+  m = construct_matcher(LMF_CACHE, log_matcher_pcre_re_new);
+  log_matcher_compile(m, "^ssh", NULL);
+  assert_cached_match(m, msg, "sshd", TRUE);
+  assert_cached_match(m, msg, "cron", FALSE);
+  assert_cached_match(m, msg, "sshd", TRUE);
+
+  replacement = log_template_new(configuration, NULL);
+  log_template_compile(replacement, "openssh", NULL);
+  assert_cached_replace(m, msg, "sshd", replacement, "opensshd");
+  assert_cached_replace(m, msg, "cron", replacement, NULL);
+  log_template_unref(replacement);
+
+  /* a replacement referring to the message is not cached */
+  replacement = log_template_new(configuration, NULL);
+  log_template_compile(replacement, "$HOST", NULL);
+  log_msg_set_value(msg, LM_V_HOST, "bzorp", -1);
+  assert_cached_replace(m, msg, "sshd", replacement, "bzorpd");
+  log_msg_set_value(msg, LM_V_HOST, "foo", -1);
+  assert_cached_replace(m, msg, "sshd", replacement, "food");
+  log_template_unref(replacement);
+
+  log_matcher_unref(m);
+  log_msg_unref(msg);
+}
+
 int
 main()
 {
@@ -171,6 +241,8 @@ main()
   testcase_match("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: match", "match", TRUE, construct_matcher(0, log_matcher_string_new));
   testcase_match("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: match", "ma", TRUE, construct_matcher(LMF_PREFIX, log_matcher_string_new));
   testcase_match("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: match", "tch", TRUE, construct_matcher(LMF_SUBSTRING, log_matcher_string_new));
+  testcase_match("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: enough to skip ahead", "SKIP AHEAD", TRUE, construct_matcher(LMF_SUBSTRING | LMF_ICASE, log_matcher_string_new));
+  testcase_match("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: enough to skip ahead", "skip aheaD", FALSE, construct_matcher(LMF_SUBSTRING, log_matcher_string_new));
 
   testcase_replace("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: abcdef", "ABCDEF", "qwerty", "qwerty", construct_matcher(LMF_PREFIX | LMF_ICASE, log_matcher_string_new));
   testcase_replace("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: abcdef", "BCD", "qwerty", "aqwertyef", construct_matcher(LMF_SUBSTRING | LMF_ICASE, log_matcher_string_new));
@@ -182,6 +254,24 @@ main()
   testcase_match("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: árvíztűrőtükörfúrógép", "*fúró*", TRUE, construct_matcher(0, log_matcher_glob_new));
   testcase_match("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: árvíztűrőtükörfúrógép", "tükör", FALSE, construct_matcher(0, log_matcher_glob_new));
   testcase_match("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: árvíztűrőtükörfúrógép", "viziló", FALSE, construct_matcher(0, log_matcher_glob_new));
+  testcase_match("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: árvíztűrőtükörfúrógép", "árvíztűrőtükörfúrógép", TRUE, construct_matcher(0, log_matcher_glob_new));
+  testcase_match("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: árvíztűrőtükörfúrógép", "árvíz**gép", TRUE, construct_matcher(0, log_matcher_glob_new));
+  testcase_match("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: árvíztűrőtükörfúrógép", "árvíz*árvíz", FALSE, construct_matcher(0, log_matcher_glob_new));
+  testcase_match("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: árvíz", "árvíz*víz", FALSE, construct_matcher(0, log_matcher_glob_new));
+  testcase_match("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: árvíztűrőtükörfúrógép", "**tükörfúró**", TRUE, construct_matcher(0, log_matcher_glob_new));
+  testcase_match("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: árvíztűrőtükörfúrógép", "*", TRUE, construct_matcher(0, log_matcher_glob_new));
+  testcase_match("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: árvíztűrőtükörfúrógép", "?rvíz*fúró*", TRUE, construct_matcher(0, log_matcher_glob_new));
+  testcase_match("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: árvíztűrőtükörfúrógép", "*víz*fúró*", TRUE, construct_matcher(0, log_matcher_glob_new));
+
+  /* pcre match, with and without capturing substrings or JIT */
+
+  testcase_match("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: wikiwiki", "(wiki)\\1$", TRUE, construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_match("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: wikiwiki", "(wiki)\\1$", TRUE, construct_matcher(LMF_STORE_MATCHES, log_matcher_pcre_re_new));
+  testcase_match("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: wikiwiki", "(wiki)\\1$", TRUE, construct_matcher(LMF_DISABLE_JIT, log_matcher_pcre_re_new));
+  testcase_match("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: wikiwiki", "^kiki", FALSE, construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_match("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: wikiwiki", "^kiki", FALSE, construct_matcher(LMF_STORE_MATCHES, log_matcher_pcre_re_new));
+
+  test_result_cache();
 
   /* match in iso-8859-2 never matches */
   testcase_match("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: \xe1rv\xedzt\xfbr\xf5t\xfck\xf6rf\xfar\xf3g\xe9p", "\xe1rv\xed*", FALSE, construct_matcher(0, log_matcher_glob_new));
@@ -892,6 +892,121 @@ testcase("<132>1 2006-10-29T01:59:59.156+01:00 mymachine evntslog - - [a i=\"]ok
 /*############################*/
 }
 
+static void
+assert_log_message_nvalue_by_name(LogMessage *message, const gchar *name, const gchar *expected_value)
+{
+  const gchar *value;
+  gssize value_len;
+
+  value = log_msg_get_value_by_name(message, name, &value_len);
+  assert_nstring(value, value_len, expected_value, -1, "Unexpected value for %s", name);
+}
+
+void
+test_raw_message_is_stored_and_referenced()
+{
+  gchar *raw = "<7>1 2006-10-29T01:59:59.156Z mymachine evntslog - ID47 [exampleSDID@0 iut=\"3\" eventSource=\"Appl\\\"ication\"] message";
+  LogMessage *message;
+
+  testcase_begin("Testing store-raw-message; msg='%s'", raw);
+
+  message = parse_log_message(raw, LP_SYSLOG_PROTOCOL | LP_STORE_RAW_MESSAGE, NULL);
+  assert_log_message_nvalue_by_name(message, "RAWMSG", raw);
+  assert_log_message_nvalue_by_name(message, ".SDATA.exampleSDID@0.iut", "3");
+  assert_log_message_nvalue_by_name(message, ".SDATA.exampleSDID@0.eventSource", "Appl\"ication");
+  assert_log_message_value(message, LM_V_MESSAGE, "message");
+  log_msg_unref(message);
+
+  message = parse_log_message(raw, LP_SYSLOG_PROTOCOL, NULL);
+  assert_false(log_msg_is_value_set(message, log_msg_get_value_handle("RAWMSG")),
+               "RAWMSG should only be stored if store-raw-message is set");
+  log_msg_unref(message);
+
+  testcase_end();
+}
+
+void
+test_header_fields_beyond_the_scanned_prefix()
+{
+  GString *raw = g_string_new("<7>1 2006-10-29T01:59:59Z mymachine ");
+  gchar app[41], pid[101];
+  LogMessage *message;
+
+  memset(app, 'a', sizeof(app) - 1);
+  app[sizeof(app) - 1] = 0;
+  memset(pid, '1', sizeof(pid) - 1);
+  pid[sizeof(pid) - 1] = 0;
+  g_string_append_printf(raw, "%s %s ID47 - message", app, pid);
+
+  testcase_begin("Testing RFC5424 header fields that extend past the first 128 bytes; msg='%s'", raw->str);
+
+  message = parse_log_message(raw->str, LP_SYSLOG_PROTOCOL, NULL);
+  assert_log_message_value(message, LM_V_HOST, "mymachine");
+  assert_log_message_value(message, LM_V_PROGRAM, app);
+  assert_log_message_value(message, LM_V_PID, pid);
+  assert_log_message_value(message, LM_V_MSGID, "ID47");
+  assert_log_message_value(message, LM_V_MESSAGE, "message");
+  assert_guint(message->timestamps[LM_TS_STAMP].tv_sec, 1162087199, "Unexpected timestamp");
+  log_msg_unref(message);
+
+  testcase_end();
+  g_string_free(raw, TRUE);
+}
+
+void
+test_repeated_sd_elements_resolve_to_the_same_values()
+{
+  gchar *raw = "<7>1 2006-10-29T01:59:59Z mymachine evntslog - ID47 [origin ip=\"1.2.3.4\"][meta sequenceId=\"1\"][nosdnvpair] message";
+  LogMessage *message;
+  gint i;
+
+  testcase_begin("Testing SD handle lookups on repeated messages; msg='%s'", raw);
+
+  for (i = 0; i < 3; i++)
+    {
+      message = parse_log_message(raw, LP_SYSLOG_PROTOCOL, NULL);
+      assert_log_message_nvalue_by_name(message, ".SDATA.origin.ip", "1.2.3.4");
+      assert_log_message_nvalue_by_name(message, ".SDATA.meta.sequenceId", "1");
+      assert_true(log_msg_is_value_set(message, log_msg_get_value_handle(".SDATA.nosdnvpair")),
+                  "SD-ID without parameters is not set");
+      assert_log_message_value(message, LM_V_MESSAGE, "message");
+      log_msg_unref(message);
+    }
+
+  testcase_end();
+}
+
+static void
+assert_parsed_stamp(const gchar *raw, gint parse_flags, glong expected_sec, glong expected_usec, glong expected_ofs)
+{
+  LogMessage *message;
+
+  message = parse_log_message((gchar *) raw, parse_flags, NULL);
+  assert_guint(message->timestamps[LM_TS_STAMP].tv_sec, expected_sec, "Unexpected timestamp; msg='%s'", raw);
+  assert_guint32(message->timestamps[LM_TS_STAMP].tv_usec, expected_usec, "Unexpected microseconds; msg='%s'", raw);
+  assert_guint32(message->timestamps[LM_TS_STAMP].zone_offset, expected_ofs, "Unexpected timezone offset; msg='%s'", raw);
+  log_msg_unref(message);
+}
+
+void
+test_cached_timestamps_match_their_raw_form()
+{
+  testcase_begin("Testing that timestamps sharing a prefix are not mixed up by the timestamp cache");
+
+  assert_parsed_stamp("<7>2006-10-29T01:59:59.156+01:00 bzorp openvpn[2499]: msg", LP_EXPECT_HOSTNAME,
+                      1162083599, 156000, 3600);
+  assert_parsed_stamp("<7>2006-10-29T01:59:59.156+01:00 bzorp openvpn[2499]: msg", LP_EXPECT_HOSTNAME,
+                      1162083599, 156000, 3600);
+  assert_parsed_stamp("<7>2006-10-29T01:59:59.156+02:00 bzorp openvpn[2499]: msg", LP_EXPECT_HOSTNAME,
+                      1162079999, 156000, 7200);
+  assert_parsed_stamp("<7>2006-10-29T01:59:59.157+02:00 bzorp openvpn[2499]: msg", LP_EXPECT_HOSTNAME,
+                      1162079999, 157000, 7200);
+  assert_parsed_stamp("<7>2006-10-29T01:59:59.157+02:00", LP_EXPECT_HOSTNAME,
+                      1162079999, 157000, 7200);
+
+  testcase_end();
+}
+
 int
 main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
 {
@@ -901,6 +1016,10 @@ main(int argc G_GNUC_UNUSED, char *argv[] G_GNUC_UNUSED)
   init_and_load_syslogformat_module();
 
   test_log_messages_can_be_parsed();
+  test_raw_message_is_stored_and_referenced();
+  test_header_fields_beyond_the_scanned_prefix();
+  test_repeated_sd_elements_resolve_to_the_same_values();
+  test_cached_timestamps_match_their_raw_form();
 
   deinit_syslogformat_module();
   app_shutdown();
@@ -124,6 +124,31 @@ test_nv_registry()
   nv_registry_free(reg);
 }
 
+static void
+test_nv_registry_handle_counts()
+{
+  NVRegistry *reg;
+  guint builtin, config, runtime;
+  const gchar *builtins[] = { "BUILTIN1", "BUILTIN2", NULL };
+
+  reg = nv_registry_new(builtins);
+  nv_registry_mark_builtin_handles(reg);
+  nv_registry_alloc_handle(reg, "CONFIG1");
+  nv_registry_mark_config_handles(reg);
+  nv_registry_alloc_handle(reg, "RUNTIME1");
+  nv_registry_alloc_handle(reg, "RUNTIME2");
+  nv_registry_alloc_handle(reg, "CONFIG1");
+  nv_registry_add_alias(reg, 1, "ALIAS1");
+  TEST_ASSERT(nv_registry_get_handle(reg, "ALIAS1") == 1);
+  TEST_ASSERT(nv_registry_get_handle(reg, "UNKNOWN") == 0);
+
+  nv_registry_get_handle_counts(reg, &builtin, &config, &runtime);
+  TEST_ASSERT(builtin == 2);
+  TEST_ASSERT(config == 1);
+  TEST_ASSERT(runtime == 2);
+  nv_registry_free(reg);
+}
+
 /*
  * NVTable:
  *
@@ -755,6 +780,58 @@ test_nvtable_lookup()
     }
 }
 
+static void
+test_nvtable_lookup_with_dyn_index()
+{
+  NVTable *tab, *tab_clone;
+  NVHandle handle;
+  gchar name[16];
+  gboolean success;
+  gint i;
+
+  tab = nv_table_new(STATIC_VALUES, 256, 16384);
+  for (i = 0; i < 200; i++)
+    {
+      handle = STATIC_VALUES + 1 + i * 7;
+      g_snprintf(name, sizeof(name), "VAL%d", handle);
+      success = nv_table_add_value(tab, handle, name, strlen(name), name, strlen(name), NULL);
+      TEST_ASSERT(success == TRUE);
+    }
+  TEST_ASSERT(tab->num_dyn_entries == 200);
+  TEST_ASSERT(tab->dyn_index_size >= 400);
+
+  tab_clone = nv_table_clone(tab, 1024);
+  TEST_ASSERT(tab_clone->dyn_index_size == tab->dyn_index_size);
+  for (i = 0; i < 200; i++)
+    {
+      handle = STATIC_VALUES + 1 + i * 7;
+      g_snprintf(name, sizeof(name), "VAL%d", handle);
+      TEST_NVTABLE_ASSERT(tab, handle, name, strlen(name));
+      TEST_NVTABLE_ASSERT(tab_clone, handle, name, strlen(name));
+      TEST_ASSERT(nv_table_is_value_set(tab_clone, handle + 1) == FALSE);
+    }
+  nv_table_unref(tab_clone);
+  nv_table_unref(tab);
+
+  /* the index is dropped if it would prevent storing a value */
+  tab = nv_table_new(STATIC_VALUES, 16, 1024);
+  for (i = 0; success; i++)
+    {
+      handle = STATIC_VALUES + 1 + i;
+      g_snprintf(name, sizeof(name), "VAL%d", handle);
+      success = nv_table_add_value(tab, handle, name, strlen(name), name, strlen(name), NULL);
+    }
+  TEST_ASSERT(tab->num_dyn_entries > NV_TABLE_DYN_INDEX_THRESHOLD);
+  TEST_ASSERT(tab->dyn_index_size == 0);
+  for (i = 0; i < tab->num_dyn_entries - 1; i++)
+    {
+      handle = STATIC_VALUES + 1 + i;
+      g_snprintf(name, sizeof(name), "VAL%d", handle);
+      TEST_NVTABLE_ASSERT(tab, handle, name, strlen(name));
+    }
+  nv_table_unref(tab);
+}
+
 static void
 test_nvtable_clone_grows_the_cloned_structure(void)
 {
@@ -904,6 +981,7 @@ test_nvtable(void)
   test_nvtable_indirect();
   test_nvtable_others();
   test_nvtable_lookup();
+  test_nvtable_lookup_with_dyn_index();
   test_nvtable_clone();
   test_nvtable_realloc();
 }
@@ -913,6 +991,7 @@ main(int argc, char *argv[])
 {
   app_startup();
   test_nv_registry();
+  test_nv_registry_handle_counts();
   test_nvtable();
   app_shutdown();
   return 0;
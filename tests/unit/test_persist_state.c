@@ -296,6 +296,47 @@ test_values(void)
   cancel_and_destroy_persist_state(state);
 }
 
+void
+test_persist_state_large_file_survives_restart(void)
+{
+  PersistState *state;
+  PersistEntryHandle handle;
+  TestState *test_state;
+  gsize size;
+  guint8 version;
+  gchar buf[32];
+  gint i;
+
+  state = clean_and_create_persist_state_for_test("test_persist_state_large_file.persist");
+
+  /* spans a couple of megabytes, so the store is grown many times */
+  for (i = 0; i < 20000; i++)
+    {
+      g_snprintf(buf, sizeof(buf), "large_key%d", i);
+      handle = persist_state_alloc_entry(state, buf, 100);
+      assert_true(handle != 0, "allocating a persist entry failed");
+      test_state = persist_state_map_entry(state, handle);
+      test_state->value = i;
+      persist_state_unmap_entry(state, handle);
+    }
+  assert_true(persist_state_sync(state), "syncing the persist file failed");
+
+  state = restart_persist_state(state);
+
+  for (i = 0; i < 20000; i++)
+    {
+      g_snprintf(buf, sizeof(buf), "large_key%d", i);
+      handle = persist_state_lookup_entry(state, buf, &size, &version);
+      assert_true(handle != 0, "lookup failed after restart");
+      assert_gint(size, 100, "persist entry size mismatch");
+      test_state = persist_state_map_entry(state, handle);
+      assert_gint(test_state->value, i, "persist entry contents mismatch");
+      persist_state_unmap_entry(state, handle);
+    }
+
+  cancel_and_destroy_persist_state(state);
+}
+
 void
 test_persist_state_temp_file_cleanup_on_cancel()
 {
@@ -331,6 +372,7 @@ main(int argc, char *argv[])
 #endif
   app_startup();
   test_values();
+  test_persist_state_large_file_survives_restart();
   test_persist_state_remove_entry();
   test_persist_state_temp_file_cleanup_on_cancel();
   test_persist_state_temp_file_cleanup_on_commit_destroy();
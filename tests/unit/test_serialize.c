@@ -33,6 +33,109 @@
      } \
   } while (0)
 
+static void
+_write_records(SerializeArchive *a, gint first, gint count)
+{
+  gint i;
+
+  for (i = first; i < first + count; i++)
+    {
+      serialize_write_uint8(a, i);
+      serialize_write_uint32(a, i * 65537);
+      serialize_write_uint64(a, G_GUINT64_CONSTANT(0x0102030405060708) * i);
+      serialize_write_varint(a, G_GUINT64_CONSTANT(1) << (i & 63));
+      serialize_write_cstring(a, "kismacska", -1);
+    }
+}
+
+static gint
+_read_records(SerializeArchive *a, gint count)
+{
+  GString *value = g_string_new("");
+  guint8 num8;
+  guint32 num;
+  guint64 num64;
+  gint i;
+
+  for (i = 0; i < count; i++)
+    {
+      TEST_ASSERT(serialize_read_uint8(a, &num8) && num8 == (guint8) i);
+      TEST_ASSERT(serialize_read_uint32(a, &num) && num == i * 65537);
+      TEST_ASSERT(serialize_read_uint64(a, &num64) && num64 == G_GUINT64_CONSTANT(0x0102030405060708) * i);
+      TEST_ASSERT(serialize_read_varint(a, &num64) && num64 == G_GUINT64_CONSTANT(1) << (i & 63));
+      TEST_ASSERT(serialize_read_string(a, value) && strcmp(value->str, "kismacska") == 0);
+    }
+  g_string_free(value, TRUE);
+  return 0;
+}
+
+static gint
+test_buffered_archives(void)
+{
+  GString *plain = g_string_new("");
+  GString *buffered = g_string_new("");
+  SerializeArchive *a;
+  gchar buf[4096];
+  guint8 num8;
+  guint64 num64;
+
+  a = serialize_string_archive_new(plain);
+  _write_records(a, 0, 100);
+  serialize_archive_free(a);
+
+  /* reserving less than what is written makes the archive grow the string */
+  a = serialize_string_archive_new(buffered);
+  serialize_archive_reserve(a, 16);
+  _write_records(a, 0, 50);
+  serialize_archive_flush(a);
+  TEST_ASSERT(buffered->len > 0 && buffered->str[buffered->len] == 0);
+  serialize_archive_reserve(a, 65536);
+  _write_records(a, 50, 50);
+  serialize_archive_free(a);
+  TEST_ASSERT(buffered->len == plain->len);
+  TEST_ASSERT(memcmp(buffered->str, plain->str, plain->len) == 0);
+
+  a = serialize_string_archive_new(buffered);
+  TEST_ASSERT(_read_records(a, 100) == 0);
+  a->silent = TRUE;
+  TEST_ASSERT(!serialize_read_uint8(a, &num8));
+  serialize_archive_free(a);
+
+  /* the position of buffer archives follows the direct stores */
+  a = serialize_buffer_archive_new(buf, sizeof(buf));
+  _write_records(a, 0, 100);
+  TEST_ASSERT(serialize_buffer_archive_get_pos(a) == plain->len);
+  a->silent = TRUE;
+  TEST_ASSERT(!serialize_write_blob(a, plain->str, plain->len));
+  serialize_archive_free(a);
+  TEST_ASSERT(memcmp(buf, plain->str, plain->len) == 0);
+
+  a = serialize_region_archive_new(plain->str, plain->len);
+  TEST_ASSERT(_read_records(a, 100) == 0);
+  TEST_ASSERT(serialize_buffer_archive_get_pos(a) == plain->len);
+  serialize_archive_free(a);
+
+  /* region archives are read-only */
+  a = serialize_region_archive_new(plain->str, plain->len);
+  a->silent = TRUE;
+  TEST_ASSERT(!serialize_write_uint8(a, 0));
+  serialize_archive_free(a);
+
+  /* a varint cut at the end of the region */
+  g_string_truncate(plain, 0);
+  a = serialize_string_archive_new(plain);
+  serialize_write_varint(a, G_MAXUINT64);
+  serialize_archive_free(a);
+  a = serialize_region_archive_new(plain->str, plain->len - 1);
+  a->silent = TRUE;
+  TEST_ASSERT(!serialize_read_varint(a, &num64));
+  serialize_archive_free(a);
+
+  g_string_free(plain, TRUE);
+  g_string_free(buffered, TRUE);
+  return 0;
+}
+
 int
 main()
 {
@@ -41,6 +144,7 @@ main()
   SerializeArchive *a;
   gchar buf[256];
   guint32 num;
+  guint64 num64;
 
   app_startup();
 
@@ -52,6 +156,10 @@ main()
   serialize_write_uint32(a, 0xdeadbeaf);
   serialize_write_cstring(a, "kismacska", -1);
   serialize_write_cstring(a, "tarkabarka", 10);
+  serialize_write_varint(a, 0);
+  serialize_write_varint(a, 127);
+  serialize_write_varint(a, 300);
+  serialize_write_varint(a, G_MAXUINT64);
 
   serialize_archive_free(a);
 
@@ -64,6 +172,15 @@ main()
   TEST_ASSERT(strcmp(value->str, "kismacska") == 0);
   serialize_read_string(a, value);
   TEST_ASSERT(strcmp(value->str, "tarkabarka") == 0);
+  TEST_ASSERT(serialize_read_varint32(a, &num) && num == 0);
+  TEST_ASSERT(serialize_read_varint32(a, &num) && num == 127);
+  TEST_ASSERT(serialize_read_varint(a, &num64) && num64 == 300);
+  TEST_ASSERT(serialize_read_varint(a, &num64) && num64 == G_MAXUINT64);
+  /* 0 + 127 take 1 byte each, 300 takes 2 and G_MAXUINT64 takes 10 */
+  TEST_ASSERT(stream->len == 5 + 4 + 4 + 9 + 4 + 10 + 1 + 1 + 2 + 10);
+  serialize_archive_free(a);
+
+  TEST_ASSERT(test_buffered_archives() == 0);
 
   app_shutdown();
   return 0;
@@ -159,6 +159,34 @@ test_msg_tags()
 
 }
 
+void
+test_cloned_msg_tags(void)
+{
+  LogMessage *msg, *clone;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  test_msg("=== clone tests ===\n");
+
+  msg = log_msg_new_empty();
+  log_msg_set_tag_by_id(msg, 100);
+  clone = log_msg_clone_cow(msg, &path_options);
+
+  log_msg_set_tag_by_id(clone, 100);
+  if (clone->tags != msg->tags)
+    test_fail("Setting an already set tag should not copy the shared tags array\n");
+
+  log_msg_set_tag_by_id(clone, 200);
+  if (clone->tags == msg->tags)
+    test_fail("Setting a new tag should copy the shared tags array\n");
+  if (!log_msg_is_tag_by_id(clone, 100) || !log_msg_is_tag_by_id(clone, 200))
+    test_fail("Cloned message lost its tags\n");
+  if (log_msg_is_tag_by_id(msg, 200))
+    test_fail("Setting a tag on the clone changed the original message\n");
+
+  log_msg_unref(clone);
+  log_msg_unref(msg);
+}
+
 void
 test_filters(gboolean not)
 {
@@ -205,6 +233,7 @@ main(int argc, char *argv[])
   
   test_tags();
   test_msg_tags();
+  test_cloned_msg_tags();
   test_filters(FALSE);
   test_filters(TRUE);
 
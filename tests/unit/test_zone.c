@@ -760,6 +760,39 @@ test_zones(void)
   return rc;
 }
 
+int
+test_zone_info_cache(void)
+{
+  TimeZoneInfo *info, *info2;
+  time_t stamp;
+  gint rc = 0;
+
+  if (!timezone_exists("Europe/Budapest"))
+    {
+      printf("SKIP: Europe/Budapest\n");
+      return 0;
+    }
+
+  info = time_zone_info_new("Europe/Budapest");
+  info2 = time_zone_info_new("Europe/Budapest");
+  TEST_ASSERT(info == info2);
+  time_zone_info_free(info2);
+
+  /* walk back and forth across the 2015 DST changes, so that lookups both
+   * hit and miss the last transition found */
+  set_tz("Europe/Budapest");
+  for (stamp = 1427590800 - 7200; stamp < 1445734800 + 7200; stamp += 1800 * 97)
+    {
+      TEST_ASSERT(time_zone_info_get_offset(info, stamp) == get_local_timezone_ofs(stamp));
+      TEST_ASSERT(time_zone_info_get_offset(info, 1427590800 - 1) == 3600);
+      TEST_ASSERT(time_zone_info_get_offset(info, 1427590800) == 7200);
+      TEST_ASSERT(time_zone_info_get_offset(info, 1445734800 - 1) == 7200);
+      TEST_ASSERT(time_zone_info_get_offset(info, 1445734800) == 3600);
+    }
+  time_zone_info_free(info);
+  return rc;
+}
+
 int
 test_logstamp(void)
 {
@@ -789,6 +822,18 @@ test_logstamp(void)
   log_stamp_format(&stamp, target, TS_FMT_ISO, -5400, 3);
   TEST_ASSERT(strcmp(target->str, "2005-10-14T18:17:37.123-01:30") == 0);
 
+  /* same second, formatted from the per-thread cache */
+  stamp.tv_usec = 987654;
+  log_stamp_format(&stamp, target, TS_FMT_ISO, -5400, 6);
+  TEST_ASSERT(strcmp(target->str, "2005-10-14T18:17:37.987654-01:30") == 0);
+  log_stamp_format(&stamp, target, TS_FMT_ISO, 3600, 0);
+  TEST_ASSERT(strcmp(target->str, "2005-10-14T20:47:37+01:00") == 0);
+  log_stamp_format(&stamp, target, TS_FMT_BSD, 3600, 1);
+  TEST_ASSERT(strcmp(target->str, "Oct 14 20:47:37.9") == 0);
+  stamp.tv_sec++;
+  log_stamp_format(&stamp, target, TS_FMT_BSD, 3600, 1);
+  TEST_ASSERT(strcmp(target->str, "Oct 14 20:47:38.9") == 0);
+
   /* boundary testing */
   stamp.tv_sec = 0;
   stamp.tv_usec = 0;
@@ -805,7 +850,7 @@ main(int argc, char *argv[])
   gint rc;
   app_startup();
 
-  rc = test_logstamp() | test_zones();;
+  rc = test_logstamp() | test_zones() | test_zone_info_cache();
   app_shutdown();
   return rc;
 }